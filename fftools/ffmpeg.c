@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <limits.h>
+#include <setjmp.h>
 #include <stdatomic.h>
 #include <stdint.h>
 
@@ -63,6 +64,7 @@
 #include "libavutil/time.h"
 #include "libavutil/thread.h"
 #include "libavutil/threadmessage.h"
+#include "libavutil/trace.h"
 #include "libavcodec/mathops.h"
 #include "libavformat/os_support.h"
 
@@ -137,10 +139,28 @@ static unsigned dup_warning = 1000;
 static int nb_frames_drop = 0;
 static int64_t decode_error_stat[2];
 
+/* -overload_lag: how much work is shed, each level includes the previous ones */
+enum OverloadLevel {
+    OVERLOAD_NONE,
+    OVERLOAD_FILTERS,   /* expensive filters are disabled */
+    OVERLOAD_ENCODER,   /* video encoders use faster settings */
+    OVERLOAD_DECODER,   /* non-reference frames are not decoded */
+    OVERLOAD_NB
+};
+static const char *const overload_level_names[OVERLOAD_NB] = {
+    "none", "filters", "encoder", "decoder"
+};
+static int overload_level;
+static int64_t overload_level_time;  /* when overload_level was last changed */
+static int64_t overload_max_lag;
+static int overload_changes;
+static uint64_t overload_packets[OVERLOAD_NB];
+
 static int want_sdp = 1;
 
 static BenchmarkTimeStamps current_time;
 AVIOContext *progress_avio = NULL;
+AVIOContext *stats_report_avio = NULL;
 
 static uint8_t *subtitle_out;
 
@@ -166,6 +186,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_thread(OutputStream *ost);
 #endif
 
 /* sub2video hack:
@@ -345,6 +366,11 @@ static atomic_int transcode_init_done = ATOMIC_VAR_INIT(0);
 static volatile int ffmpeg_exited = 0;
 static int main_return_code = 0;
 
+/* -worker: jobs return here instead of exiting the process */
+static jmp_buf worker_jmp;
+static int worker_job_running;
+static int worker_job_status;
+
 static void
 sigterm_handler(int sig)
 {
@@ -497,8 +523,16 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_THREADS
+    for (i = 0; i < nb_output_streams; i++)
+        if (output_streams[i])
+            free_encoder_thread(output_streams[i]);
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
+        print_filtergraph_stats(fg);
+        fg_shed_filters(fg, 0);
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             InputFilter *ifilter = fg->inputs[j];
@@ -582,6 +616,10 @@ static void ffmpeg_cleanup(int ret)
 
         avcodec_free_context(&ost->enc_ctx);
         avcodec_parameters_free(&ost->ref_par);
+#if HAVE_THREADS
+        avcodec_free_context(&ost->chunk_enc_template);
+        av_dict_free(&ost->chunk_enc_opts);
+#endif
 
         if (ost->muxing_queue) {
             while (av_fifo_size(ost->muxing_queue)) {
@@ -606,6 +644,8 @@ static void ffmpeg_cleanup(int ret)
 
         av_frame_free(&ist->decoded_frame);
         av_frame_free(&ist->filter_frame);
+        avfilter_graph_free(&ist->conv_graph);
+        av_frame_free(&ist->conv_frame);
         av_dict_free(&ist->decoder_opts);
         avsubtitle_free(&ist->prev_sub.subtitle);
         av_frame_free(&ist->sub2video.frame);
@@ -623,6 +663,7 @@ static void ffmpeg_cleanup(int ret)
             av_log(NULL, AV_LOG_ERROR,
                    "Error closing vstats file, loss of information possible: %s\n",
                    av_err2str(AVERROR(errno)));
+        vstats_file = NULL;
     }
     av_freep(&vstats_filename);
 
@@ -630,10 +671,18 @@ static void ffmpeg_cleanup(int ret)
     av_freep(&input_files);
     av_freep(&output_streams);
     av_freep(&output_files);
+    nb_input_streams  = nb_input_files  = 0;
+    nb_output_streams = nb_output_files = 0;
+    nb_filtergraphs   = 0;
+
+    if ((i = av_trace_stop()) < 0)
+        av_log(NULL, AV_LOG_ERROR, "Error writing the trace: %s\n",
+               av_err2str(i));
 
     uninit_opts();
 
-    avformat_network_deinit();
+    if (!worker_job_running)
+        avformat_network_deinit();
 
     if (received_sigterm) {
         av_log(NULL, AV_LOG_INFO, "Exiting normally, received signal %d.\n",
@@ -668,6 +717,50 @@ static void abort_codec_experimental(AVCodec *c, int encoder)
     exit_program(1);
 }
 
+/* start and end timing a stage, only when -stats_report is used */
+static int64_t stage_start(void)
+{
+    return stats_report_avio ? av_gettime_relative() : 0;
+}
+
+static int64_t stage_elapsed(int64_t start)
+{
+    return stats_report_avio ? av_gettime_relative() - start : 0;
+}
+
+static int encode_send_frame(OutputStream *ost, const AVFrame *frame)
+{
+    int fast = atomic_load(&ost->overload_fast);
+    int64_t start;
+    int ret;
+
+    /* encoders supporting it pick the flag up on the next frame */
+    if (fast != ost->overload_fast_applied) {
+        if (fast) {
+            ost->overload_user_fast = ost->enc_ctx->flags2 & AV_CODEC_FLAG2_FAST;
+            ost->enc_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+        } else if (!ost->overload_user_fast) {
+            ost->enc_ctx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+        }
+        ost->overload_fast_applied = fast;
+    }
+
+    start = stage_start();
+    ret = avcodec_send_frame(ost->enc_ctx, frame);
+
+    atomic_fetch_add(&ost->encode_time, stage_elapsed(start));
+    return ret;
+}
+
+static int encode_receive_packet(OutputStream *ost, AVPacket *pkt)
+{
+    int64_t start = stage_start();
+    int ret = avcodec_receive_packet(ost->enc_ctx, pkt);
+
+    atomic_fetch_add(&ost->encode_time, stage_elapsed(start));
+    return ret;
+}
+
 static void update_benchmark(const char *fmt, ...)
 {
     if (do_benchmark_all) {
@@ -702,6 +795,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
+    int64_t mux_start;
     int ret;
 
     /*
@@ -826,7 +920,9 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
+    mux_start = stage_start();
     ret = av_interleaved_write_frame(s, pkt);
+    ost->mux_time += stage_elapsed(mux_start);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
@@ -888,7 +984,7 @@ static int check_recording_time(OutputStream *ost)
     OutputFile *of = output_files[ost->file_index];
 
     if (of->recording_time != INT64_MAX &&
-        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, of->recording_time,
+        av_compare_ts(ost->sync_opts - ost->first_pts, ost->enc_par.time_base, of->recording_time,
                       AV_TIME_BASE_Q) >= 0) {
         close_output_stream(ost);
         return 0;
@@ -896,10 +992,683 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
+#if HAVE_THREADS
+static int enc_thread_receive_packets(OutputStream *ost, int64_t pts)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket pkt;
+    int ret;
+
+    for (;;) {
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+
+        ret = encode_receive_packet(ost, &pkt);
+        if (ret == AVERROR(EAGAIN))
+            return 0;
+        if (ret < 0)
+            return ret;
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+            pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+            pkt.pts = pts;
+
+        /* if two pass, output log */
+        if (ost->logfile && enc->stats_out)
+            fprintf(ost->logfile, "%s", enc->stats_out);
+
+        pthread_mutex_lock(&ost->enc_lock);
+        if (!av_fifo_space(ost->enc_packets) &&
+            (ret = av_fifo_grow(ost->enc_packets, av_fifo_size(ost->enc_packets))) < 0) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            av_packet_unref(&pkt);
+            return ret;
+        }
+        av_fifo_generic_write(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+        pthread_cond_broadcast(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+    }
+}
+
+/*
+ * Encode the frames queued by the main thread. The packets are handed back
+ * to the main thread, which does all the muxing.
+ */
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    AVFrame *frame;
+    int aborted, ret = 0;
+
+    for (;;) {
+        int64_t pts;
+
+        pthread_mutex_lock(&ost->enc_lock);
+        while (!av_fifo_size(ost->enc_frames) && !ost->enc_eof && !ost->enc_abort)
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+        aborted = ost->enc_abort;
+        if (aborted || !av_fifo_size(ost->enc_frames)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            break;
+        }
+        av_fifo_generic_read(ost->enc_frames, &frame, sizeof(frame), NULL);
+        pthread_cond_broadcast(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        pts = frame->pts;
+        ret = encode_send_frame(ost, frame);
+        av_frame_free(&frame);
+        if (ret < 0 || (ret = enc_thread_receive_packets(ost, pts)) < 0)
+            goto finish;
+    }
+
+    if (!aborted) {
+        ret = encode_send_frame(ost, NULL);
+        if (ret >= 0)
+            ret = enc_thread_receive_packets(ost, AV_NOPTS_VALUE);
+        if (ost->logfile && enc->stats_out)
+            fprintf(ost->logfile, "%s", enc->stats_out);
+    }
+
+finish:
+    pthread_mutex_lock(&ost->enc_lock);
+    if (ret < 0 && ret != AVERROR_EOF)
+        ost->enc_error = ret;
+    ost->enc_done = 1;
+    pthread_cond_broadcast(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    return NULL;
+}
+
+static void mux_encoded_packet(OutputFile *of, OutputStream *ost, AVPacket *pkt)
+{
+    EncoderParams *enc = &ost->enc_par;
+    int pkt_size;
+
+    if (ost->finished & MUXER_FINISHED) {
+        av_packet_unref(pkt);
+        return;
+    }
+
+    av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+               "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+               av_get_media_type_string(enc->codec_type),
+               av_ts2str(pkt->pts), av_ts2timestr(pkt->pts, &ost->mux_timebase),
+               av_ts2str(pkt->dts), av_ts2timestr(pkt->dts, &ost->mux_timebase));
+    }
+
+    pkt_size = pkt->size;
+    output_packet(of, pkt, ost, 0);
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename)
+        do_video_stats(ost, pkt_size);
+}
+
+static void free_enc_chunk(EncChunk **pchunk)
+{
+    EncChunk *chunk = *pchunk;
+    AVFrame *frame;
+    AVPacket pkt;
+
+    if (!chunk)
+        return;
+
+    while (chunk->frames && av_fifo_size(chunk->frames)) {
+        av_fifo_generic_read(chunk->frames, &frame, sizeof(frame), NULL);
+        av_frame_free(&frame);
+    }
+    while (chunk->packets && av_fifo_size(chunk->packets)) {
+        av_fifo_generic_read(chunk->packets, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(&chunk->frames);
+    av_fifo_freep(&chunk->packets);
+    avcodec_free_context(&chunk->enc_ctx);
+    av_freep(pchunk);
+}
+
+#define COPY_ARRAY(field, size) do {                                     \
+    if (src->field && (size) > 0) {                                     \
+        if (!(dst->field = av_memdup(src->field, size)))                \
+            return AVERROR(ENOMEM);                                     \
+    }                                                                   \
+} while (0)
+
+/*
+ * Copy the configuration of an encoder context that has not been opened:
+ * the stream parameters, the generic and private options and the fields
+ * ffmpeg sets directly.
+ */
+static int copy_encoder_config(AVCodecContext *dst, const AVCodecContext *src)
+{
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    int ret;
+
+    if (!par)
+        return AVERROR(ENOMEM);
+    ret = avcodec_parameters_from_context(par, src);
+    if (ret >= 0)
+        ret = avcodec_parameters_to_context(dst, par);
+    avcodec_parameters_free(&par);
+    if (ret < 0)
+        return ret;
+
+    if ((ret = av_opt_copy(dst, src)) < 0)
+        return ret;
+    if (src->priv_data && dst->priv_data && src->codec == dst->codec &&
+        src->codec && src->codec->priv_class &&
+        (ret = av_opt_copy(dst->priv_data, src->priv_data)) < 0)
+        return ret;
+
+    dst->time_base   = src->time_base;
+    dst->framerate   = src->framerate;
+    dst->rc_override_count = src->rc_override_count;
+    COPY_ARRAY(intra_matrix, 64 * sizeof(*src->intra_matrix));
+    COPY_ARRAY(inter_matrix, 64 * sizeof(*src->inter_matrix));
+    COPY_ARRAY(rc_override,  src->rc_override_count * sizeof(*src->rc_override));
+
+    if (src->hw_device_ctx &&
+        !(dst->hw_device_ctx = av_buffer_ref(src->hw_device_ctx)))
+        return AVERROR(ENOMEM);
+    if (src->hw_frames_ctx &&
+        !(dst->hw_frames_ctx = av_buffer_ref(src->hw_frames_ctx)))
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+#undef COPY_ARRAY
+
+/*
+ * Keep a copy of the encoder context as it is before being opened, every
+ * chunk opens an encoder of its own from it.
+ */
+static int init_chunk_template(OutputStream *ost)
+{
+    int ret;
+
+    ost->chunk_enc_template = avcodec_alloc_context3(ost->enc);
+    if (!ost->chunk_enc_template)
+        return AVERROR(ENOMEM);
+    ret = copy_encoder_config(ost->chunk_enc_template, ost->enc_ctx);
+    if (ret < 0)
+        return ret;
+
+    return av_dict_copy(&ost->chunk_enc_opts, ost->encoder_opts, 0);
+}
+
+static int open_chunk_encoder(OutputStream *ost, EncChunk *chunk, const AVFrame *frame)
+{
+    AVDictionary *opts = NULL;
+    AVCodecContext *enc;
+    int ret;
+
+    enc = chunk->enc_ctx = avcodec_alloc_context3(ost->enc);
+    if (!enc)
+        return AVERROR(ENOMEM);
+    ret = copy_encoder_config(enc, ost->chunk_enc_template);
+    if (ret < 0)
+        return ret;
+    if (!ost->frame_aspect_ratio.num)
+        enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+    ret = av_dict_copy(&opts, ost->chunk_enc_opts, 0);
+    if (ret >= 0)
+        ret = avcodec_open2(enc, ost->enc, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/* Encode a frame of a chunk, or drain its encoder if frame is NULL. */
+static int encode_chunk_frame(OutputStream *ost, EncChunk *chunk, const AVFrame *frame)
+{
+    int64_t start = stage_start();
+    AVPacket pkt;
+    int ret;
+
+    ret = avcodec_send_frame(chunk->enc_ctx, frame);
+    while (ret >= 0) {
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+
+        ret = avcodec_receive_packet(chunk->enc_ctx, &pkt);
+        if (ret < 0)
+            break;
+        if (frame && pkt.pts == AV_NOPTS_VALUE &&
+            !(ost->enc->capabilities & AV_CODEC_CAP_DELAY))
+            pkt.pts = frame->pts;
+
+        pthread_mutex_lock(&ost->enc_lock);
+        if (!av_fifo_space(chunk->packets))
+            ret = av_fifo_grow(chunk->packets, av_fifo_size(chunk->packets));
+        if (ret >= 0) {
+            av_fifo_generic_write(chunk->packets, &pkt, sizeof(pkt), NULL);
+            pthread_cond_broadcast(&ost->enc_cond);
+        } else {
+            av_packet_unref(&pkt);
+        }
+        pthread_mutex_unlock(&ost->enc_lock);
+    }
+    atomic_fetch_add(&ost->encode_time, stage_elapsed(start));
+
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int encode_chunk(OutputStream *ost, EncChunk *chunk)
+{
+    AVFrame *frame;
+    int aborted, ret = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&ost->enc_lock);
+        while (!av_fifo_size(chunk->frames) && !chunk->closed && !ost->enc_abort)
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+        aborted = ost->enc_abort;
+        if (aborted || !av_fifo_size(chunk->frames)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            break;
+        }
+        av_fifo_generic_read(chunk->frames, &frame, sizeof(frame), NULL);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        if (!chunk->enc_ctx)
+            ret = open_chunk_encoder(ost, chunk, frame);
+        if (ret >= 0)
+            ret = encode_chunk_frame(ost, chunk, frame);
+        av_frame_free(&frame);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (!aborted && chunk->enc_ctx)
+        ret = encode_chunk_frame(ost, chunk, NULL);
+    avcodec_free_context(&chunk->enc_ctx);
+
+    return ret;
+}
+
+/*
+ * Take the oldest chunk no other thread has taken yet, and encode it. The
+ * main thread muxes the packets of the chunks in their order.
+ */
+static void *chunk_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    int i, ret;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    while (!ost->enc_abort && !ost->enc_error) {
+        EncChunk *chunk = NULL;
+
+        for (i = 0; i < ost->nb_chunks && !chunk; i++)
+            if (!ost->chunks[i]->started)
+                chunk = ost->chunks[i];
+        if (!chunk) {
+            if (ost->enc_eof)
+                break;
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+            continue;
+        }
+        chunk->started = 1;
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        ret = encode_chunk(ost, chunk);
+
+        pthread_mutex_lock(&ost->enc_lock);
+        if (ret < 0 && !ost->enc_error)
+            ost->enc_error = ret;
+        chunk->done = 1;
+        pthread_cond_broadcast(&ost->enc_cond);
+    }
+    if (++ost->nb_chunk_threads_done == ost->nb_chunk_threads)
+        ost->enc_done = 1;
+    pthread_cond_broadcast(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    return NULL;
+}
+
+/* Must be called with enc_lock held. */
+static int enc_thread_has_packets(OutputStream *ost)
+{
+    if (ost->chunk_threads)
+        return ost->nb_chunks &&
+               (av_fifo_size(ost->chunks[0]->packets) || ost->chunks[0]->done);
+    return av_fifo_size(ost->enc_packets);
+}
+
+/* Must be called with enc_lock held. */
+static int enc_thread_queued_frames(OutputStream *ost)
+{
+    int i, nb_frames = 0;
+
+    if (!ost->chunk_threads)
+        return av_fifo_size(ost->enc_frames) / sizeof(AVFrame *);
+    for (i = 0; i < ost->nb_chunks; i++)
+        nb_frames += av_fifo_size(ost->chunks[i]->frames) / sizeof(AVFrame *);
+    return nb_frames;
+}
+
+static void chunk_reap_packets(OutputFile *of, OutputStream *ost)
+{
+    EncChunk *chunk;
+    AVPacket pkt;
+    int err;
+
+    for (;;) {
+        pthread_mutex_lock(&ost->enc_lock);
+        err   = ost->enc_error;
+        chunk = ost->nb_chunks ? ost->chunks[0] : NULL;
+        if (!chunk || (!av_fifo_size(chunk->packets) && !chunk->done)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            break;
+        }
+        if (!av_fifo_size(chunk->packets)) {
+            /* all the packets of the oldest chunk are muxed */
+            memmove(ost->chunks, ost->chunks + 1,
+                    --ost->nb_chunks * sizeof(*ost->chunks));
+            pthread_mutex_unlock(&ost->enc_lock);
+            free_enc_chunk(&chunk);
+            continue;
+        }
+        av_fifo_generic_read(chunk->packets, &pkt, sizeof(pkt), NULL);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        mux_encoded_packet(of, ost, &pkt);
+    }
+
+    if (err < 0) {
+        av_log(NULL, AV_LOG_FATAL, "video encoding failed: %s\n", av_err2str(err));
+        exit_program(1);
+    }
+}
+
+/*
+ * Queue a frame to the newest chunk. A new chunk starts at the first keyframe
+ * after enc_chunk_frames frames, or after twice as many frames without one.
+ */
+static void chunk_send_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    EncChunk *chunk;
+    AVFrame *f = av_frame_clone(frame);
+    int i, ret = 0;
+
+    if (!f) {
+        av_log(NULL, AV_LOG_FATAL, "Could not queue a frame for encoding\n");
+        exit_program(1);
+    }
+
+    pthread_mutex_lock(&ost->enc_lock);
+    chunk = ost->nb_chunks ? ost->chunks[ost->nb_chunks - 1] : NULL;
+    if (!chunk ||
+        (chunk->nb_frames >= ost->enc_chunk_frames &&
+         (frame->key_frame || frame->pict_type == AV_PICTURE_TYPE_I)) ||
+        chunk->nb_frames >= 2 * ost->enc_chunk_frames) {
+        if (chunk) {
+            chunk->closed = 1;
+            pthread_cond_broadcast(&ost->enc_cond);
+        }
+
+        /* wait for a thread to be available for the new chunk */
+        for (;;) {
+            int nb_encoding = 0;
+
+            for (i = 0; i < ost->nb_chunks; i++)
+                nb_encoding += !ost->chunks[i]->done;
+            if (nb_encoding < ost->nb_chunk_threads || ost->enc_done || ost->enc_error)
+                break;
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+        }
+
+        chunk = av_mallocz(sizeof(*chunk));
+        if (!chunk ||
+            !(chunk->frames  = av_fifo_alloc(ost->enc_chunk_frames * sizeof(AVFrame *))) ||
+            !(chunk->packets = av_fifo_alloc(8 * sizeof(AVPacket))) ||
+            av_dynarray_add_nofree(&ost->chunks, &ost->nb_chunks, chunk) < 0) {
+            free_enc_chunk(&chunk);
+            ret = AVERROR(ENOMEM);
+        }
+    }
+    if (ret >= 0 && !av_fifo_space(chunk->frames))
+        ret = av_fifo_grow(chunk->frames, av_fifo_size(chunk->frames));
+    if (ret >= 0) {
+        av_fifo_generic_write(chunk->frames, &f, sizeof(f), NULL);
+        chunk->nb_frames++;
+        f = NULL;
+        pthread_cond_broadcast(&ost->enc_cond);
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    av_frame_free(&f);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Could not queue a frame for encoding\n");
+        exit_program(1);
+    }
+    chunk_reap_packets(of, ost);
+}
+
+/*
+ * Mux the packets returned by the encoder thread so far, and exit if the
+ * encoder failed.
+ */
+static void enc_thread_reap_packets(OutputFile *of, OutputStream *ost)
+{
+    EncoderParams *enc = &ost->enc_par;
+    AVPacket pkt;
+    int err;
+
+    if (ost->chunk_threads) {
+        chunk_reap_packets(of, ost);
+        return;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&ost->enc_lock);
+        err = ost->enc_error;
+        if (!av_fifo_size(ost->enc_packets)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            break;
+        }
+        av_fifo_generic_read(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        mux_encoded_packet(of, ost, &pkt);
+    }
+
+    if (err < 0) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+               av_get_media_type_string(enc->codec_type), av_err2str(err));
+        exit_program(1);
+    }
+}
+
+static void enc_thread_send_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *f;
+
+    if (ost->chunk_threads) {
+        chunk_send_frame(of, ost, frame);
+        return;
+    }
+
+    f = av_frame_clone(frame);
+    if (!f) {
+        av_log(NULL, AV_LOG_FATAL, "Could not queue a frame for encoding\n");
+        exit_program(1);
+    }
+
+    pthread_mutex_lock(&ost->enc_lock);
+    while (!av_fifo_space(ost->enc_frames) && !ost->enc_done) {
+        /* keep the encoder from waiting on the muxer while the queue is full */
+        if (av_fifo_size(ost->enc_packets)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            enc_thread_reap_packets(of, ost);
+            pthread_mutex_lock(&ost->enc_lock);
+            continue;
+        }
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    }
+    if (!ost->enc_done) {
+        av_fifo_generic_write(ost->enc_frames, &f, sizeof(f), NULL);
+        f = NULL;
+        pthread_cond_broadcast(&ost->enc_cond);
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    av_frame_free(&f);
+    enc_thread_reap_packets(of, ost);
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    AVFrame *frame;
+    AVPacket pkt;
+    int i;
+
+    if (!ost->enc_thread_started)
+        return;
+
+    pthread_mutex_lock(&ost->enc_lock);
+    ost->enc_abort = 1;
+    pthread_cond_broadcast(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+    if (ost->chunk_threads) {
+        for (i = 0; i < ost->nb_chunk_threads; i++)
+            pthread_join(ost->chunk_threads[i], NULL);
+        for (i = 0; i < ost->nb_chunks; i++)
+            free_enc_chunk(&ost->chunks[i]);
+        av_freep(&ost->chunks);
+        av_freep(&ost->chunk_threads);
+        ost->nb_chunks = ost->nb_chunk_threads = 0;
+    } else {
+        pthread_join(ost->enc_thread, NULL);
+    }
+    ost->enc_thread_started = 0;
+
+    while (ost->enc_frames && av_fifo_size(ost->enc_frames)) {
+        av_fifo_generic_read(ost->enc_frames, &frame, sizeof(frame), NULL);
+        av_frame_free(&frame);
+    }
+    while (ost->enc_packets && av_fifo_size(ost->enc_packets)) {
+        av_fifo_generic_read(ost->enc_packets, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(&ost->enc_frames);
+    av_fifo_freep(&ost->enc_packets);
+    pthread_cond_destroy(&ost->enc_cond);
+    pthread_mutex_destroy(&ost->enc_lock);
+}
+
+/*
+ * Drain the encoder and mux all remaining packets.
+ */
+static void enc_thread_flush(OutputFile *of, OutputStream *ost)
+{
+    pthread_mutex_lock(&ost->enc_lock);
+    if (ost->nb_chunks)
+        ost->chunks[ost->nb_chunks - 1]->closed = 1;
+    ost->enc_eof = 1;
+    pthread_cond_broadcast(&ost->enc_cond);
+    while (!ost->enc_done) {
+        if (enc_thread_has_packets(ost)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            enc_thread_reap_packets(of, ost);
+            pthread_mutex_lock(&ost->enc_lock);
+            continue;
+        }
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    }
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    enc_thread_reap_packets(of, ost);
+    free_encoder_thread(ost);
+}
+
+/*
+ * Start the threads of chunked encoding: the stream is cut into chunks which
+ * are encoded in parallel, each of them by an encoder of its own.
+ */
+static int init_chunk_threads(OutputStream *ost)
+{
+    int i, ret;
+
+    if (ost->logfile || ost->enc_ctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+        av_log(NULL, AV_LOG_ERROR, "Chunked encoding does not support two-pass encoding\n");
+        return AVERROR(EINVAL);
+    }
+    if (ost->enc_ctx->has_b_frames) {
+        av_log(NULL, AV_LOG_ERROR, "Chunked encoding needs an encoder which does not "
+               "reorder frames, try disabling B-frames with -bf 0\n");
+        return AVERROR(EINVAL);
+    }
+
+    ost->chunk_threads = av_calloc(ost->enc_chunks, sizeof(*ost->chunk_threads));
+    if (!ost->chunk_threads)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&ost->enc_lock, NULL);
+    pthread_cond_init(&ost->enc_cond, NULL);
+    ost->enc_thread_started = 1;
+
+    for (i = 0; i < ost->enc_chunks; i++) {
+        if ((ret = pthread_create(&ost->chunk_threads[i], NULL, chunk_thread, ost))) {
+            av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+            return AVERROR(ret);
+        }
+        ost->nb_chunk_threads++;
+    }
+
+    return 0;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    if (ost->chunk_enc_template)
+        return init_chunk_threads(ost);
+
+    if (enc_thread_queue_size <= 0 ||
+        (ost->enc->type != AVMEDIA_TYPE_AUDIO && ost->enc->type != AVMEDIA_TYPE_VIDEO))
+        return 0;
+
+    ost->enc_frames  = av_fifo_alloc(enc_thread_queue_size * sizeof(AVFrame *));
+    ost->enc_packets = av_fifo_alloc(8 * sizeof(AVPacket));
+    if (!ost->enc_frames || !ost->enc_packets) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    pthread_mutex_init(&ost->enc_lock, NULL);
+    pthread_cond_init(&ost->enc_cond, NULL);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_cond_destroy(&ost->enc_cond);
+        pthread_mutex_destroy(&ost->enc_lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ost->enc_thread_started = 1;
+
+    return 0;
+fail:
+    av_fifo_freep(&ost->enc_frames);
+    av_fifo_freep(&ost->enc_packets);
+    return ret;
+}
+#endif
+
 static void do_audio_out(OutputFile *of, OutputStream *ost,
                          AVFrame *frame)
 {
-    AVCodecContext *enc = ost->enc_ctx;
+    EncoderParams *enc = &ost->enc_par;
     AVPacket pkt;
     int ret;
 
@@ -925,12 +1694,19 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
-    ret = avcodec_send_frame(enc, frame);
+#if HAVE_THREADS
+    if (ost->enc_thread_started) {
+        enc_thread_send_frame(of, ost, frame);
+        return;
+    }
+#endif
+
+    ret = encode_send_frame(ost, frame);
     if (ret < 0)
         goto error;
 
     while (1) {
-        ret = avcodec_receive_packet(enc, &pkt);
+        ret = encode_receive_packet(ost, &pkt);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -1046,7 +1822,7 @@ static void do_video_out(OutputFile *of,
 {
     int ret, format_video_sync;
     AVPacket pkt;
-    AVCodecContext *enc = ost->enc_ctx;
+    EncoderParams *enc = &ost->enc_par;
     AVCodecParameters *mux_par = ost->st->codecpar;
     AVRational frame_rate;
     int nb_frames, nb0_frames, i;
@@ -1274,45 +2050,53 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
-        if (ret < 0)
-            goto error;
-        // Make sure Closed Captions will not be duplicated
-        av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
+#if HAVE_THREADS
+        if (ost->enc_thread_started) {
+            enc_thread_send_frame(of, ost, in_picture);
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
+        } else
+#endif
+        {
+            ret = encode_send_frame(ost, in_picture);
             if (ret < 0)
                 goto error;
+            // Make sure Closed Captions will not be duplicated
+            av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
+            while (1) {
+                ret = encode_receive_packet(ost, &pkt);
+                update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                if (ret < 0)
+                    goto error;
 
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                           "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                           av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                           av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+                }
 
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+                if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                    pkt.pts = ost->sync_opts;
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
-            }
+                av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
 
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                        "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                        av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
+                        av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
+                }
 
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
+                frame_size = pkt.size;
+                output_packet(of, &pkt, ost, 0);
+
+                /* if two pass, output log */
+                if (ost->logfile && ost->enc_ctx->stats_out) {
+                    fprintf(ost->logfile, "%s", ost->enc_ctx->stats_out);
+                }
             }
         }
         ost->sync_opts++;
@@ -1348,7 +2132,7 @@ static double psnr(double d)
 
 static void do_video_stats(OutputStream *ost, int frame_size)
 {
-    AVCodecContext *enc;
+    EncoderParams *enc;
     int frame_number;
     double ti1, bitrate, avg_bitrate;
 
@@ -1361,7 +2145,7 @@ static void do_video_stats(OutputStream *ost, int frame_size)
         }
     }
 
-    enc = ost->enc_ctx;
+    enc = &ost->enc_par;
     if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
         frame_number = ost->st->nb_frames;
         if (vstats_version <= 1) {
@@ -1420,7 +2204,7 @@ static int reap_filters(int flush)
         OutputStream *ost = output_streams[i];
         OutputFile    *of = output_files[ost->file_index];
         AVFilterContext *filter;
-        AVCodecContext *enc = ost->enc_ctx;
+        EncoderParams *enc = &ost->enc_par;
         int ret = 0;
 
         if (!ost->filter || !ost->filter->graph->graph)
@@ -1444,8 +2228,10 @@ static int reap_filters(int flush)
 
         while (1) {
             double float_pts = AV_NOPTS_VALUE; // this is identical to filtered_frame.pts but with higher precision
+            int64_t start = stage_start();
             ret = av_buffersink_get_frame_flags(filter, filtered_frame,
                                                AV_BUFFERSINK_FLAG_NO_REQUEST);
+            ost->filter->graph->filter_time += stage_elapsed(start);
             if (ret < 0) {
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
@@ -1481,8 +2267,9 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+                /* the encoder thread takes it from the frame itself */
+                if (!ost->frame_aspect_ratio.num && !ost->enc_thread_started)
+                    ost->enc_ctx->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 if (debug_ts) {
                     av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
@@ -1509,6 +2296,11 @@ static int reap_filters(int flush)
 
             av_frame_unref(filtered_frame);
         }
+
+#if HAVE_THREADS
+        if (ost->enc_thread_started)
+            enc_thread_reap_packets(of, ost);
+#endif
     }
 
     return 0;
@@ -1553,6 +2345,14 @@ static void print_final_stats(int64_t total_size)
         av_log(NULL, AV_LOG_INFO, "unknown");
     av_log(NULL, AV_LOG_INFO, "\n");
 
+    if (overload_lag > 0) {
+        av_log(NULL, AV_LOG_INFO, "Overload control: max lag %.3fs, %d level changes, video packets per level:",
+               overload_max_lag / 1000000.0, overload_changes);
+        for (i = 0; i < OVERLOAD_NB; i++)
+            av_log(NULL, AV_LOG_INFO, " %s=%"PRIu64, overload_level_names[i], overload_packets[i]);
+        av_log(NULL, AV_LOG_INFO, "\n");
+    }
+
     /* print verbose per-stream stats */
     for (i = 0; i < nb_input_files; i++) {
         InputFile *f = input_files[i];
@@ -1631,6 +2431,119 @@ static void print_final_stats(int64_t total_size)
     }
 }
 
+/*
+ * Write one line of JSON with the time spent in each stage and the queue
+ * fill levels to the -stats_report URL.
+ */
+static void print_stats_report(int is_last_report, double t, double speed, int64_t pts)
+{
+    AVBPrint buf;
+    int i, j, ret;
+
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    av_bprintf(&buf, "{\"time\":%.3f,\"out_time_us\":", t);
+    if (pts == INT64_MIN + 1)
+        av_bprintf(&buf, "null");
+    else
+        av_bprintf(&buf, "%"PRId64, pts);
+    av_bprintf(&buf, ",\"speed\":");
+    if (speed < 0)
+        av_bprintf(&buf, "null");
+    else
+        av_bprintf(&buf, "%.3f", speed);
+    av_bprintf(&buf, ",\"dup_frames\":%d,\"drop_frames\":%d,\"progress\":\"%s\"",
+               nb_frames_dup, nb_frames_drop, is_last_report ? "end" : "continue");
+
+    if (overload_lag > 0) {
+        int64_t lag = 0;
+
+        for (i = 0; i < nb_input_streams; i++)
+            lag = FFMAX(lag, input_streams[i]->overload_lag);
+        av_bprintf(&buf, ",\"overload\":{\"level\":\"%s\",\"lag_us\":%"PRId64",\"max_lag_us\":%"PRId64","
+                   "\"changes\":%d,\"packets\":{",
+                   overload_level_names[overload_level], lag, overload_max_lag, overload_changes);
+        for (i = 0; i < OVERLOAD_NB; i++)
+            av_bprintf(&buf, "%s\"%s\":%"PRIu64, i ? "," : "",
+                       overload_level_names[i], overload_packets[i]);
+        av_bprintf(&buf, "}}");
+    }
+
+    av_bprintf(&buf, ",\"inputs\":[");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+        int queued = 0, queue_size = 0;
+
+#if HAVE_THREADS
+        if (f->in_thread_queue) {
+            queued     = av_thread_message_queue_nb_elems(f->in_thread_queue);
+            queue_size = f->thread_queue_size;
+        }
+#endif
+        av_bprintf(&buf, "%s{\"file\":%d,\"demux_us\":%"PRId64",\"queued\":%d,\"queue_size\":%d,\"streams\":[",
+                   i ? "," : "", i, (int64_t)atomic_load(&f->demux_time), queued, queue_size);
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+            const char *type = av_get_media_type_string(ist->st->codecpar->codec_type);
+
+            av_bprintf(&buf, "%s{\"index\":%d,\"type\":\"%s\",\"packets\":%"PRIu64",\"frames\":%"PRIu64",\"decode_us\":%"PRId64"}",
+                       j ? "," : "", ist->st->index, type ? type : "unknown",
+                       ist->nb_packets, ist->frames_decoded, ist->decode_time);
+        }
+        av_bprintf(&buf, "]}");
+    }
+
+    av_bprintf(&buf, "],\"filtergraphs\":[");
+    for (i = 0; i < nb_filtergraphs; i++)
+        av_bprintf(&buf, "%s{\"index\":%d,\"filter_us\":%"PRId64"}",
+                   i ? "," : "", filtergraphs[i]->index, filtergraphs[i]->filter_time);
+
+    av_bprintf(&buf, "],\"outputs\":[");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        int64_t size = of->ctx->pb ? avio_size(of->ctx->pb) : -1;
+
+        if (of->ctx->pb && size <= 0)
+            size = avio_tell(of->ctx->pb);
+        av_bprintf(&buf, "%s{\"file\":%d,\"size\":%"PRId64",\"streams\":[",
+                   i ? "," : "", i, size);
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            OutputStream *ost = output_streams[of->ost_index + j];
+            const char *type = av_get_media_type_string(ost->st->codecpar->codec_type);
+            int queued = 0, queue_size = 0;
+
+#if HAVE_THREADS
+            if (ost->enc_thread_started) {
+                pthread_mutex_lock(&ost->enc_lock);
+                queued = enc_thread_queued_frames(ost);
+                pthread_mutex_unlock(&ost->enc_lock);
+                queue_size = ost->chunk_threads ? 0 : enc_thread_queue_size;
+            }
+#endif
+            av_bprintf(&buf, "%s{\"index\":%d,\"type\":\"%s\",\"frames\":%"PRIu64",\"packets\":%"PRIu64","
+                       "\"encode_us\":%"PRId64",\"mux_us\":%"PRId64",\"queued\":%d,\"queue_size\":%d}",
+                       j ? "," : "", ost->index, type ? type : "unknown",
+                       ost->frames_encoded, ost->packets_written,
+                       (int64_t)atomic_load(&ost->encode_time), ost->mux_time,
+                       queued, queue_size);
+        }
+        av_bprintf(&buf, "]}");
+    }
+    av_bprintf(&buf, "]}\n");
+
+    if (av_bprint_is_complete(&buf)) {
+        avio_write(stats_report_avio, buf.str, buf.len);
+        avio_flush(stats_report_avio);
+    }
+    av_bprint_finalize(&buf, NULL);
+
+    if (is_last_report) {
+        if ((ret = avio_closep(&stats_report_avio)) < 0)
+            av_log(NULL, AV_LOG_ERROR,
+                   "Error closing stats report, loss of information possible: %s\n", av_err2str(ret));
+    }
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time)
 {
     AVBPrint buf, buf_script;
@@ -1649,7 +2562,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int ret;
     float t;
 
-    if (!print_stats && !is_last_report && !progress_avio)
+    if (!print_stats && !is_last_report && !progress_avio && !stats_report_avio)
         return;
 
     if (!is_last_report) {
@@ -1657,7 +2570,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             last_time = cur_time;
             return;
         }
-        if ((cur_time - last_time) < 500000)
+        if ((cur_time - last_time) < stats_period)
             return;
         last_time = cur_time;
     }
@@ -1708,7 +2621,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                     av_bprintf(&buf, "%X", av_log2(qp_histogram[j] + 1));
             }
 
-            if ((enc->flags & AV_CODEC_FLAG_PSNR) && (ost->pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
+            if ((ost->enc_par.flags & AV_CODEC_FLAG_PSNR) && (ost->pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
                 int j;
                 double error, error_sum = 0;
                 double scale, scale_sum = 0;
@@ -1716,12 +2629,13 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                 char type[3] = { 'Y','U','V' };
                 av_bprintf(&buf, "PSNR=");
                 for (j = 0; j < 3; j++) {
+                    /* the encoder threads have finished for the last report */
                     if (is_last_report) {
                         error = enc->error[j];
-                        scale = enc->width * enc->height * 255.0 * 255.0 * frame_number;
+                        scale = ost->enc_par.width * ost->enc_par.height * 255.0 * 255.0 * frame_number;
                     } else {
                         error = ost->error[j];
-                        scale = enc->width * enc->height * 255.0 * 255.0;
+                        scale = ost->enc_par.width * ost->enc_par.height * 255.0 * 255.0;
                     }
                     if (j)
                         scale /= 4;
@@ -1793,6 +2707,12 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprintf(&buf_script, "dup_frames=%d\n", nb_frames_dup);
     av_bprintf(&buf_script, "drop_frames=%d\n", nb_frames_drop);
 
+    if (overload_lag > 0) {
+        if (overload_level)
+            av_bprintf(&buf, " shed=%s", overload_level_names[overload_level]);
+        av_bprintf(&buf_script, "overload=%s\n", overload_level_names[overload_level]);
+    }
+
     if (speed < 0) {
         av_bprintf(&buf, " speed=N/A");
         av_bprintf(&buf_script, "speed=N/A\n");
@@ -1826,6 +2746,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         }
     }
 
+    if (stats_report_avio)
+        print_stats_report(is_last_report, t, speed, pts);
+
     if (is_last_report)
         print_final_stats(total_size);
 }
@@ -1896,6 +2819,16 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_thread_started) {
+            AVPacket pkt = { 0 };
+
+            enc_thread_flush(of, ost);
+            output_packet(of, &pkt, ost, 1);
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket pkt;
@@ -1918,8 +2851,8 @@ static void flush_encoders(void)
 
             update_benchmark(NULL);
 
-            while ((ret = avcodec_receive_packet(enc, &pkt)) == AVERROR(EAGAIN)) {
-                ret = avcodec_send_frame(enc, NULL);
+            while ((ret = encode_receive_packet(ost, &pkt)) == AVERROR(EAGAIN)) {
+                ret = encode_send_frame(ost, NULL);
                 if (ret < 0) {
                     av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
                            desc,
@@ -2106,6 +3039,7 @@ static int ifilter_has_all_input_formats(FilterGraph *fg)
 static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
 {
     FilterGraph *fg = ifilter->graph;
+    int64_t start;
     int need_reinit, ret, i;
 
     /* determine if the parameters for this input changed */
@@ -2130,6 +3064,10 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         (ifilter->hw_frames_ctx && ifilter->hw_frames_ctx->data != frame->hw_frames_ctx->data))
         need_reinit = 1;
 
+    /* try to keep the graph when only the video dimensions changed */
+    if (need_reinit && fg->graph && ifilter_reconfigure(ifilter, frame) >= 0)
+        need_reinit = 0;
+
     if (need_reinit) {
         ret = ifilter_parameters_from_frame(ifilter, frame);
         if (ret < 0)
@@ -2170,7 +3108,9 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+    start = stage_start();
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+    fg->filter_time += stage_elapsed(start);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -2235,6 +3175,34 @@ static int send_frame_to_filters(InputStream *ist, AVFrame *decoded_frame)
     int i, ret;
     AVFrame *f;
 
+    /* the filtergraphs are reconfigured for the new parameters instead */
+    if (ist->conv_graph) {
+        AVFilterLink *in = ist->conv_src->outputs[0];
+        if (decoded_frame->format != in->format ||
+            decoded_frame->width  != in->w ||
+            decoded_frame->height != in->h ||
+            decoded_frame->hw_frames_ctx)
+            avfilter_graph_free(&ist->conv_graph);
+    }
+    if (!ist->conv_checked) {
+        ist->conv_checked = 1;
+        ret = configure_shared_conversion(ist, decoded_frame);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error configuring filters: %s\n", av_err2str(ret));
+            return ret;
+        }
+    }
+    if (ist->conv_graph) {
+        ret = av_buffersrc_add_frame_flags(ist->conv_src, decoded_frame, 0);
+        if (ret >= 0)
+            ret = av_buffersink_get_frame(ist->conv_sink, ist->conv_frame);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error converting frame: %s\n", av_err2str(ret));
+            return ret;
+        }
+        av_frame_move_ref(decoded_frame, ist->conv_frame);
+    }
+
     av_assert1(ist->nb_filters > 0); /* ensure ret is initialized */
     for (i = 0; i < ist->nb_filters; i++) {
         if (i < ist->nb_filters - 1) {
@@ -2261,6 +3229,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
 {
     AVFrame *decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
+    int64_t start;
     int ret, err = 0;
     AVRational decoded_frame_tb;
 
@@ -2271,7 +3240,9 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
+    start = stage_start();
     ret = decode(avctx, decoded_frame, got_output, pkt);
+    ist->decode_time += stage_elapsed(start);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2323,6 +3294,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
 {
     AVFrame *decoded_frame;
     int i, ret = 0, err = 0;
+    int64_t start;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
     AVPacket avpkt;
@@ -2356,7 +3328,9 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
+    start = stage_start();
     ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt ? &avpkt : NULL);
+    ist->decode_time += stage_elapsed(start);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2544,6 +3518,82 @@ static int send_filter_eof(InputStream *ist)
 }
 
 /* pkt = NULL means EOF (needed to flush decoder buffers) */
+static void set_overload_level(int level, int64_t lag, int64_t now)
+{
+    int i;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        InputStream *ist = input_streams[i];
+
+        if (!ist->decoding_needed || ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO)
+            continue;
+        if (level >= OVERLOAD_DECODER && overload_level < OVERLOAD_DECODER) {
+            ist->overload_skip_frame = ist->dec_ctx->skip_frame;
+            ist->dec_ctx->skip_frame = FFMAX(ist->dec_ctx->skip_frame, AVDISCARD_NONREF);
+        } else if (level < OVERLOAD_DECODER && overload_level >= OVERLOAD_DECODER) {
+            ist->dec_ctx->skip_frame = ist->overload_skip_frame;
+        }
+    }
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (ost->encoding_needed && ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+            atomic_store(&ost->overload_fast, level >= OVERLOAD_ENCODER);
+    }
+
+    av_log(NULL, level > overload_level ? AV_LOG_WARNING : AV_LOG_INFO,
+           "%.3fs behind real time, shedding load: %s\n",
+           lag / 1000000.0, overload_level_names[level]);
+    overload_level      = level;
+    overload_level_time = now;
+    overload_changes++;
+}
+
+/*
+ * Track how far a video input is behind its deadline, i.e. the wall clock
+ * time its timestamps were anchored to plus the timestamp difference, and
+ * shed load in steps when the lag exceeds 1, 2 and 4 times -overload_lag.
+ * A level is left once the lag drops below half of its threshold, but not
+ * before it has been held for a second, so that shedding does not flap.
+ */
+static void update_overload(InputStream *ist)
+{
+    int64_t threshold = overload_lag * AV_TIME_BASE;
+    int64_t now = av_gettime_relative();
+    int64_t lag = (now - ist->overload_wall) - (ist->dts - ist->overload_dts);
+    int i, level = OVERLOAD_NONE;
+
+    /* anchor to the packet which arrived the earliest, so that jitter and
+     * initial buffering of live inputs do not count as lag */
+    if (!ist->overload_wall || lag < 0) {
+        ist->overload_wall = now;
+        ist->overload_dts  = ist->dts;
+        lag = 0;
+    }
+    ist->overload_lag = lag;
+
+    for (i = 0; i < nb_input_streams; i++)
+        lag = FFMAX(lag, input_streams[i]->overload_lag);
+    overload_max_lag = FFMAX(overload_max_lag, lag);
+
+    while (level < OVERLOAD_DECODER && lag > threshold << level)
+        level++;
+    if (level > overload_level)
+        set_overload_level(level, lag, now);
+    else if (overload_level && lag < threshold << (overload_level - 1) >> 1 &&
+             now - overload_level_time > AV_TIME_BASE)
+        set_overload_level(overload_level - 1, lag, now);
+    overload_packets[overload_level]++;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        int ret = fg_shed_filters(filtergraphs[i], overload_level >= OVERLOAD_FILTERS);
+        if (ret < 0)
+            av_log(NULL, AV_LOG_WARNING, "Could not %s filters of graph %d: %s\n",
+                   overload_level ? "disable" : "re-enable", i, av_err2str(ret));
+    }
+}
+
 static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eof)
 {
     int ret = 0, i;
@@ -2579,6 +3629,10 @@ static int process_input_packet(InputStream *ist, const AVPacket *pkt, int no_eo
         ist->next_dts = ist->dts = av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
         if (ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO || !ist->decoding_needed)
             ist->next_pts = ist->pts = ist->dts;
+
+        if (overload_lag > 0 && ist->decoding_needed &&
+            ist->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+            update_overload(ist);
     }
 
     // while we have more to decode or while the decoder did output something on EOF
@@ -3473,6 +4527,14 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             }
         }
 
+#if HAVE_THREADS
+        if (ost->enc_chunks > 1 && (ret = init_chunk_template(ost)) < 0) {
+            snprintf(error, error_len, "Could not set up chunked encoding "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
+
         if ((ret = avcodec_open2(ost->enc_ctx, codec, &ost->encoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 1);
@@ -3550,6 +4612,24 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
 
         ost->st->codec->codec= ost->enc_ctx->codec;
+
+        ost->enc_par.codec_type     = ost->enc_ctx->codec_type;
+        ost->enc_par.codec          = ost->enc_ctx->codec;
+        ost->enc_par.time_base      = ost->enc_ctx->time_base;
+        ost->enc_par.flags          = ost->enc_ctx->flags;
+        ost->enc_par.global_quality = ost->enc_ctx->global_quality;
+        ost->enc_par.width          = ost->enc_ctx->width;
+        ost->enc_par.height         = ost->enc_ctx->height;
+        ost->enc_par.channels       = ost->enc_ctx->channels;
+
+#if HAVE_THREADS
+        ret = init_encoder_thread(ost);
+        if (ret < 0) {
+            snprintf(error, error_len, "Could not start the encoder thread "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3989,7 +5069,10 @@ static void *input_thread(void *arg)
 
     while (1) {
         AVPacket pkt;
+        int64_t start = stage_start();
+
         ret = av_read_frame(f->ctx, &pkt);
+        atomic_fetch_add(&f->demux_time, stage_elapsed(start));
 
         if (ret == AVERROR(EAGAIN)) {
             av_usleep(10000);
@@ -4051,14 +5134,24 @@ static int init_input_thread(int i)
     int ret;
     InputFile *f = input_files[i];
 
-    if (nb_input_files == 1)
+    /* a single input is read on the main thread unless a queue size is set */
+    if (f->thread_queue_size < 0) {
+        if (nb_input_files == 1)
+            return 0;
+        f->thread_queue_size = 8;
+    }
+    if (!f->thread_queue_size)
         return 0;
 
-    if (f->ctx->pb ? !f->ctx->pb->seekable :
-        strcmp(f->ctx->iformat->name, "lavfi"))
+    /* with a single input there is nothing else to do while waiting */
+    if (nb_input_files > 1 &&
+        (f->ctx->pb ? !f->ctx->pb->seekable :
+         strcmp(f->ctx->iformat->name, "lavfi")))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(AVPacket));
+    ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                         f->thread_queue_size, sizeof(AVPacket),
+                                         AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER |
+                                         AV_THREAD_MESSAGE_QUEUE_SINGLE_PRODUCER);
     if (ret < 0)
         return ret;
 
@@ -4093,6 +5186,9 @@ static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 
 static int get_input_packet(InputFile *f, AVPacket *pkt)
 {
+    int64_t start;
+    int ret;
+
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
@@ -4105,10 +5201,13 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     }
 
 #if HAVE_THREADS
-    if (nb_input_files > 1)
+    if (f->in_thread_queue)
         return get_input_packet_mt(f, pkt);
 #endif
-    return av_read_frame(f->ctx, pkt);
+    start = stage_start();
+    ret = av_read_frame(f->ctx, pkt);
+    atomic_fetch_add(&f->demux_time, stage_elapsed(start));
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4507,11 +5606,14 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
 {
     int i, ret;
     int nb_requests, nb_requests_max = 0;
+    int64_t start;
     InputFilter *ifilter;
     InputStream *ist;
 
     *best_ist = NULL;
+    start = stage_start();
     ret = avfilter_graph_request_oldest(graph->graph);
+    graph->filter_time += stage_elapsed(start);
     if (ret >= 0)
         return reap_filters(0);
 
@@ -4734,7 +5836,9 @@ static int transcode(void)
         }
     }
 
-    hw_device_free_all();
+    /* a worker keeps the devices for the next jobs */
+    if (!worker_job_running)
+        hw_device_free_all();
 
     /* finished ! */
     ret = 0;
@@ -4816,38 +5920,11 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 {
 }
 
-int main(int argc, char **argv)
+/* run the transcoding set up by the parsed options, returns the exit status */
+static int transcode_main(void)
 {
-    int i, ret;
     BenchmarkTimeStamps ti;
-
-    init_dynload();
-
-    register_exit(ffmpeg_cleanup);
-
-    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
-
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
-    parse_loglevel(argc, argv, options);
-
-    if(argc>1 && !strcmp(argv[1], "-d")){
-        run_as_daemon=1;
-        av_log_set_callback(log_callback_null);
-        argc--;
-        argv++;
-    }
-
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avformat_network_init();
-
-    show_banner(argc, argv, options);
-
-    /* parse options and open all input/output files */
-    ret = ffmpeg_parse_options(argc, argv);
-    if (ret < 0)
-        exit_program(1);
+    int i;
 
     if (nb_output_files <= 0 && nb_input_files == 0) {
         show_usage();
@@ -4882,8 +5959,199 @@ int main(int argc, char **argv)
     av_log(NULL, AV_LOG_DEBUG, "%"PRIu64" frames successfully decoded, %"PRIu64" decoding errors\n",
            decode_error_stat[0], decode_error_stat[1]);
     if ((decode_error_stat[0] + decode_error_stat[1]) * max_error_rate < decode_error_stat[1])
-        exit_program(69);
+        return 69;
+
+    return received_nb_signals ? 255 : main_return_code;
+}
+
+static void worker_job_exit(int ret)
+{
+    ffmpeg_cleanup(ret);
+    worker_job_status = ret;
+    longjmp(worker_jmp, 1);
+}
+
+/* run one job in the state the worker was started with */
+static int run_worker_job(int argc, char **argv)
+{
+    int log_level = av_log_get_level();
+
+    avio_closep(&progress_avio);
+    avio_closep(&stats_report_avio);
+    nb_frames_dup  = nb_frames_drop = 0;
+    dup_warning    = 1000;
+    overload_level = OVERLOAD_NONE;
+    overload_level_time = 0;
+    overload_max_lag = 0;
+    overload_changes = 0;
+    memset(overload_packets, 0, sizeof(overload_packets));
+    decode_error_stat[0] = decode_error_stat[1] = 0;
+    want_sdp       = 1;
+    main_return_code = 0;
+    ffmpeg_exited  = 0;
+    atomic_store(&transcode_init_done, 0);
+
+    worker_job_running = 1;
+    register_exit(worker_job_exit);
+    if (!setjmp(worker_jmp)) {
+        if (restore_global_options() < 0)
+            exit_program(1);
+        parse_loglevel(argc, argv, options);
+        if (ffmpeg_parse_options(argc, argv) < 0)
+            exit_program(1);
+        exit_program(transcode_main());
+    }
+    register_exit(ffmpeg_cleanup);
+    worker_job_running = 0;
+
+    hw_device_keep_all();
+    av_log_set_level(log_level);
+    return worker_job_status;
+}
+
+/* split a job line into arguments, with the quoting of av_get_token() */
+static int split_job_line(const char *line, int *argc_out, char ***argv_out)
+{
+    char **argv = NULL, *arg;
+    int argc = 0;
+
+    arg = av_strdup(program_name);
+    while (arg) {
+        if (av_dynarray_add_nofree(&argv, &argc, arg) < 0) {
+            av_free(arg);
+            break;
+        }
+        line += strspn(line, " \t\r\n");
+        if (!*line) {
+            *argc_out = argc;
+            *argv_out = argv;
+            return 0;
+        }
+        arg = av_get_token(&line, " \t\r\n");
+    }
+
+    while (argc)
+        av_free(argv[--argc]);
+    av_free(argv);
+    return AVERROR(ENOMEM);
+}
+
+/*
+ * Read job command lines from worker_url and run them one after the other,
+ * keeping the hardware devices and the network state of the process.
+ */
+static int run_worker(void)
+{
+    AVIOContext *in = NULL, *status = NULL;
+    AVBPrint line;
+    int ret, nb_jobs = 0;
+
+    if (nb_input_files || nb_output_files) {
+        av_log(NULL, AV_LOG_FATAL, "-worker cannot be used with input or output files\n");
+        return 1;
+    }
+
+    /* the jobs may be read from stdin */
+    stdin_interaction = 0;
+
+    ret = avio_open2(&in, strcmp(worker_url, "-") ? worker_url : "pipe:",
+                     AVIO_FLAG_READ, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Failed to open worker URL \"%s\": %s\n",
+               worker_url, av_err2str(ret));
+        return 1;
+    }
+    if (worker_status_url) {
+        ret = avio_open2(&status, worker_status_url, AVIO_FLAG_WRITE, &int_cb, NULL);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Failed to open worker status URL \"%s\": %s\n",
+                   worker_status_url, av_err2str(ret));
+            avio_closep(&in);
+            return 1;
+        }
+    }
+    if ((ret = save_global_options()) < 0) {
+        avio_closep(&in);
+        avio_closep(&status);
+        return 1;
+    }
+
+    av_bprint_init(&line, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while (!received_sigterm) {
+        char **argv;
+        int c, argc;
+
+        av_bprint_clear(&line);
+        while ((c = avio_r8(in)) && c != '\n')
+            av_bprint_chars(&line, c, 1);
+        if (!c && avio_feof(in) && !line.len)
+            break;
+        if (!av_bprint_is_complete(&line)) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        if (line.str[strspn(line.str, " \t\r")] == '#' ||
+            !line.str[strspn(line.str, " \t\r")])
+            continue;
+
+        if ((ret = split_job_line(line.str, &argc, &argv)) < 0)
+            break;
+        nb_jobs++;
+        av_log(NULL, AV_LOG_INFO, "Starting job %d: %s\n", nb_jobs, line.str);
+        ret = run_worker_job(argc, argv);
+        av_log(NULL, AV_LOG_INFO, "Job %d finished with status %d\n", nb_jobs, ret);
+        if (status) {
+            avio_printf(status, "%d %d\n", nb_jobs, ret);
+            avio_flush(status);
+        }
+        while (argc)
+            av_free(argv[--argc]);
+        av_free(argv);
+    }
+    av_bprint_finalize(&line, NULL);
+
+    avio_closep(&in);
+    avio_closep(&status);
+    free_saved_global_options();
+    hw_device_free_all();
+    return received_nb_signals ? 255 : ret < 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret;
+
+    init_dynload();
+
+    register_exit(ffmpeg_cleanup);
+
+    setvbuf(stderr,NULL,_IONBF,0); /* win32 runtime needs this */
+
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    parse_loglevel(argc, argv, options);
+
+    if(argc>1 && !strcmp(argv[1], "-d")){
+        run_as_daemon=1;
+        av_log_set_callback(log_callback_null);
+        argc--;
+        argv++;
+    }
+
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avformat_network_init();
+
+    show_banner(argc, argv, options);
+
+    /* parse options and open all input/output files */
+    ret = ffmpeg_parse_options(argc, argv);
+    if (ret < 0)
+        exit_program(1);
+
+    if (worker_url)
+        exit_program(run_worker());
 
-    exit_program(received_nb_signals ? 255 : main_return_code);
+    exit_program(transcode_main());
     return main_return_code;
 }
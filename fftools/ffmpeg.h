@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -74,6 +75,8 @@ typedef struct HWDevice {
     const char *name;
     enum AVHWDeviceType type;
     AVBufferRef *device_ref;
+    char *spec;     ///< -init_hw_device argument the device was created from
+    int kept;       ///< kept from a previous worker job, see hw_device_keep_all()
 } HWDevice;
 
 /* select an input stream for an output stream */
@@ -231,6 +234,10 @@ typedef struct OptionsContext {
     int        nb_enc_time_bases;
     SpecifierOpt *autoscale;
     int        nb_autoscale;
+    SpecifierOpt *enc_chunks;
+    int        nb_enc_chunks;
+    SpecifierOpt *enc_chunk_frames;
+    int        nb_enc_chunk_frames;
 } OptionsContext;
 
 typedef struct InputFilter {
@@ -286,6 +293,14 @@ typedef struct FilterGraph {
 
     AVFilterGraph *graph;
     int reconfiguration;
+    int64_t filter_time;  /* microseconds spent filtering, for -stats_report */
+    int hw_pipeline;      /* video frames stay in device memory, see -hwaccel auto-pipeline */
+
+    /* -overload_lag: the expensive filters are disabled, their original
+     * 'enable' expressions are kept here indexed like graph->filters */
+    int overload_shed;
+    char **overload_enable;
+    int nb_overload_enable;
 
     InputFilter   **inputs;
     int          nb_inputs;
@@ -360,6 +375,14 @@ typedef struct InputStream {
     InputFilter **filters;
     int        nb_filters;
 
+    /* pixel format conversion done once for all the filters above, when
+     * they all start with the same one */
+    AVFilterGraph   *conv_graph;
+    AVFilterContext *conv_src;
+    AVFilterContext *conv_sink;
+    AVFrame         *conv_frame;
+    int              conv_checked;
+
     int reinit_filters;
 
     /* hwaccel options */
@@ -367,6 +390,7 @@ typedef struct InputStream {
     enum AVHWDeviceType hwaccel_device_type;
     char  *hwaccel_device;
     enum AVPixelFormat hwaccel_output_format;
+    int    hwaccel_pipeline;
 
     /* hwaccel context */
     void  *hwaccel_ctx;
@@ -385,6 +409,14 @@ typedef struct InputStream {
     // number of frames/samples retrieved from the decoder
     uint64_t frames_decoded;
     uint64_t samples_decoded;
+    // microseconds spent decoding, for -stats_report
+    int64_t decode_time;
+
+    /* -overload_lag: wall clock time and dts the deadlines are anchored to */
+    int64_t overload_wall;
+    int64_t overload_dts;
+    int64_t overload_lag;        /* how late the last packet was, in microseconds */
+    int overload_skip_frame;     /* skip_frame to restore once the lag is gone */
 
     int64_t *dts_buffer;
     int nb_dts_buffer;
@@ -402,6 +434,7 @@ typedef struct InputFile {
                              at the moment when looping happens */
     AVRational time_base; /* time base of the duration */
     int64_t input_ts_offset;
+    atomic_int_least64_t demux_time; /* microseconds spent reading packets, for -stats_report */
 
     int64_t ts_offset;
     int64_t last_ts;
@@ -442,6 +475,31 @@ typedef enum {
     MUXER_FINISHED = 2,
 } OSTFinished ;
 
+/* a run of frames encoded by an encoder of its own, see -enc_chunks */
+typedef struct EncChunk {
+    AVCodecContext *enc_ctx;
+    AVFifoBuffer *frames;       /* frames not yet sent to the encoder */
+    AVFifoBuffer *packets;      /* packets not yet muxed */
+    int nb_frames;              /* frames queued in total */
+    int closed;                 /* all the frames of the chunk are queued */
+    int started;                /* taken by a chunk thread */
+    int done;                   /* the encoder has been drained */
+} EncChunk;
+
+/*
+ * The encoder parameters the main thread uses once the encoder is opened.
+ * They are copied from enc_ctx before an encoder thread takes it over.
+ */
+typedef struct EncoderParams {
+    enum AVMediaType codec_type;
+    const AVCodec *codec;
+    AVRational time_base;
+    int flags;
+    int global_quality;
+    int width, height;
+    int channels;
+} EncoderParams;
+
 typedef struct OutputStream {
     int file_index;          /* file index */
     int index;               /* stream index in the output file */
@@ -465,6 +523,7 @@ typedef struct OutputStream {
     AVBSFContext            *bsf_ctx;
 
     AVCodecContext *enc_ctx;
+    EncoderParams enc_par;   /* copy of the enc_ctx parameters, see EncoderParams */
     AVCodecParameters *ref_par; /* associated input codec parameters with encoders options applied */
     AVCodec *enc;
     int64_t max_frames;
@@ -538,6 +597,15 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // microseconds spent encoding and muxing, for -stats_report
+    atomic_int_least64_t encode_time;
+    int64_t mux_time;
+
+    /* -overload_lag: set by the main thread to make the encoder trade
+     * quality for speed, applied by the thread sending the frames */
+    atomic_int overload_fast;
+    int overload_fast_applied;
+    int overload_user_fast;     /* AV_CODEC_FLAG2_FAST was set by the user */
 
     /* packet quality factor */
     int quality;
@@ -552,6 +620,30 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    int enc_thread_started;     /* frames are encoded by enc_thread */
+#if HAVE_THREADS
+    pthread_t enc_thread;       /* thread running the encoder */
+    pthread_mutex_t enc_lock;   /* protects the fields below */
+    pthread_cond_t enc_cond;
+    AVFifoBuffer *enc_frames;   /* frames queued for the encoder thread */
+    AVFifoBuffer *enc_packets;  /* packets returned by the encoder thread */
+    int enc_eof;                /* no more frames will be queued */
+    int enc_abort;              /* stop without flushing the encoder */
+    int enc_done;               /* the encoder thread has finished */
+    int enc_error;              /* error the encoder thread failed with */
+
+    /* chunked encoding: enc_lock and enc_cond also protect the chunks */
+    pthread_t *chunk_threads;
+    int nb_chunk_threads;
+    int nb_chunk_threads_done;
+    AVCodecContext *chunk_enc_template; /* enc_ctx before it was opened */
+    AVDictionary *chunk_enc_opts;
+    EncChunk **chunks;          /* chunks not yet muxed, oldest first */
+    int nb_chunks;
+#endif
+    int enc_chunks;             /* number of chunks encoded in parallel */
+    int enc_chunk_frames;       /* minimum number of frames in a chunk */
 } OutputStream;
 
 typedef struct OutputFile {
@@ -591,8 +683,11 @@ extern int audio_volume;
 extern int audio_sync_method;
 extern int video_sync_method;
 extern float frame_drop_threshold;
+extern float overload_lag;
+extern char *overload_filters;
 extern int do_benchmark;
 extern int do_benchmark_all;
+extern int filter_stats;
 extern int do_deinterlace;
 extern int do_hex_dump;
 extern int do_pkt_dump;
@@ -607,11 +702,18 @@ extern int qp_hist;
 extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
+extern AVIOContext *stats_report_avio;
+extern int64_t stats_period;
+extern char *worker_url;
+extern char *worker_status_url;
 extern float max_error_rate;
 extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_pipeline_nbthreads;
+extern int filter_numa_node;
+extern int enc_thread_queue_size;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
@@ -641,6 +743,8 @@ enum AVPixelFormat choose_pixel_fmt(AVStream *st, AVCodecContext *avctx, AVCodec
 void choose_sample_fmt(AVStream *st, AVCodec *codec);
 
 int configure_filtergraph(FilterGraph *fg);
+int fg_shed_filters(FilterGraph *fg, int shed);
+void print_filtergraph_stats(FilterGraph *fg);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 void check_filter_outputs(void);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
@@ -651,20 +755,41 @@ int init_complex_filtergraph(FilterGraph *fg);
 void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
 
 int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame);
+/**
+ * Apply a change of the video dimensions of the input frames to the running
+ * filtergraph in place, keeping the state of the filters not affected.
+ * @return AVERROR(ENOSYS) if the graph must be configured again instead
+ */
+int ifilter_reconfigure(InputFilter *ifilter, const AVFrame *frame);
+int configure_shared_conversion(InputStream *ist, const AVFrame *frame);
 
 int ffmpeg_parse_options(int argc, char **argv);
 
+/**
+ * Save the current values of the global options, restore them with
+ * restore_global_options() before parsing the command line of a worker job.
+ */
+int save_global_options(void);
+int restore_global_options(void);
+void free_saved_global_options(void);
+
 int videotoolbox_init(AVCodecContext *s);
 int qsv_init(AVCodecContext *s);
 
 HWDevice *hw_device_get_by_name(const char *name);
 int hw_device_init_from_string(const char *arg, HWDevice **dev);
 void hw_device_free_all(void);
+void hw_device_keep_all(void);
 
 int hw_device_setup_for_decode(InputStream *ist);
 int hw_device_setup_for_encode(OutputStream *ost);
 int hw_device_setup_for_filter(FilterGraph *fg);
 
+int hw_pipeline_setup_for_decode(InputStream *ist);
+AVCodec *hw_pipeline_find_encoder(InputStream *ist, enum AVCodecID codec_id);
+int hw_pipeline_setup_for_filter(FilterGraph *fg, const char *graph_desc,
+                                 char **hw_graph_desc);
+
 int hwaccel_decode_init(AVCodecContext *avctx);
 
 #endif /* FFTOOLS_FFMPEG_H */
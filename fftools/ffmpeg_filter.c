@@ -459,7 +459,7 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     OutputFile    *of = output_files[ost->file_index];
     AVFilterContext *last_filter = out->filter_ctx;
     int pad_idx = out->pad_idx;
-    int ret;
+    int ret, hw_scaled = 0;
     char name[255];
 
     snprintf(name, sizeof(name), "out_%d_%d", ost->file_index, ost->index);
@@ -470,7 +470,44 @@ static int configure_output_video_filter(FilterGraph *fg, OutputFilter *ofilter,
     if (ret < 0)
         return ret;
 
-    if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale) {
+    if (fg->hw_pipeline && ost->enc) {
+        AVHWFramesContext *frames = NULL;
+        const enum AVPixelFormat *p;
+        int i, scale = (ofilter->width || ofilter->height) && ost->autoscale;
+        char hw_scale[64];
+
+        for (i = 0; i < fg->nb_inputs && !frames; i++)
+            if (fg->inputs[i]->hw_frames_ctx)
+                frames = (AVHWFramesContext*)fg->inputs[i]->hw_frames_ctx->data;
+
+        if (frames) {
+            snprintf(hw_scale, sizeof(hw_scale), "scale_%s",
+                     av_hwdevice_get_type_name(frames->device_ctx->type));
+            for (p = ost->enc->pix_fmts; p && *p != AV_PIX_FMT_NONE; p++)
+                if (*p == frames->format)
+                    break;
+
+            if (!p || *p == AV_PIX_FMT_NONE ||
+                (scale && !avfilter_get_by_name(hw_scale))) {
+                av_log(NULL, AV_LOG_WARNING, "Copying frames to host memory for "
+                       "output stream #%d:%d (encoder %s).\n",
+                       ost->file_index, ost->index, ost->enc->name);
+                if ((ret = insert_filter(&last_filter, &pad_idx, "hwdownload", NULL)) < 0 ||
+                    (ret = insert_filter(&last_filter, &pad_idx, "format",
+                                         av_get_pix_fmt_name(frames->sw_format))) < 0)
+                    return ret;
+            } else if (scale) {
+                char args[64];
+
+                snprintf(args, sizeof(args), "%d:%d", ofilter->width, ofilter->height);
+                if ((ret = insert_filter(&last_filter, &pad_idx, hw_scale, args)) < 0)
+                    return ret;
+                hw_scaled = 1;
+            }
+        }
+    }
+
+    if ((ofilter->width || ofilter->height) && ofilter->ost->autoscale && !hw_scaled) {
         char args[255];
         AVFilterContext *filter;
         AVDictionaryEntry *e = NULL;
@@ -812,6 +849,18 @@ static int configure_input_video_filter(FilterGraph *fg, InputFilter *ifilter,
     av_freep(&par);
     last_filter = ifilter->filter;
 
+    if (ist->hwaccel_pipeline && ifilter->hw_frames_ctx && !fg->hw_pipeline) {
+        AVHWFramesContext *frames = (AVHWFramesContext*)ifilter->hw_frames_ctx->data;
+
+        av_log(NULL, AV_LOG_WARNING, "Copying frames of stream #%d:%d to host "
+               "memory for filtergraph %d.\n", ist->file_index, ist->st->index,
+               fg->index);
+        if ((ret = insert_filter(&last_filter, &pad_idx, "hwdownload", NULL)) < 0 ||
+            (ret = insert_filter(&last_filter, &pad_idx, "format",
+                                 av_get_pix_fmt_name(frames->sw_format))) < 0)
+            return ret;
+    }
+
     if (ist->autorotate) {
         double theta = get_rotation(ist->st);
 
@@ -998,6 +1047,101 @@ static int configure_input_filter(FilterGraph *fg, InputFilter *ifilter,
     }
 }
 
+void print_filtergraph_stats(FilterGraph *fg)
+{
+    int i;
+    unsigned j;
+
+    if (!fg->graph || !fg->graph->nb_filters || !(filter_stats || do_benchmark_all))
+        return;
+
+    av_log(NULL, AV_LOG_INFO, "Filtergraph #%d statistics:\n", fg->index);
+    for (i = 0; i < fg->graph->nb_filters; i++) {
+        AVFilterContext *f = fg->graph->filters[i];
+        AVFilterStats stats;
+
+        if (avfilter_get_stats(f, &stats) < 0)
+            continue;
+        av_log(NULL, AV_LOG_INFO,
+               "  %-24s activations=%-8"PRId64" time=%"PRId64"us frames_in=%"PRId64" frames_out=%"PRId64"\n",
+               f->name, stats.nb_activations, stats.activate_time,
+               stats.frames_in, stats.frames_out);
+        for (j = 0; j < f->nb_outputs; j++) {
+            AVFilterLink *link = f->outputs[j];
+            AVFilterLinkStats lstats;
+
+            if (!link || avfilter_link_get_stats(link, &lstats) < 0)
+                continue;
+            av_log(NULL, AV_LOG_INFO,
+                   "    -> %-21s frames=%-8"PRId64" queued=%d max_queued=%d avg_queued=%.2f\n",
+                   link->dst->name, lstats.frames, lstats.queued,
+                   lstats.max_queued, lstats.avg_queued);
+        }
+    }
+}
+
+/* the filters -overload_lag disables by default: DNN inference and denoisers */
+#define OVERLOAD_FILTERS_DEFAULT "dnn_processing,nlmeans,bm3d,hqdn3d,atadenoise," \
+                                 "vaguedenoiser,owdenoise,fftdnoiz,dctdnoiz,derain"
+
+static void free_overload_state(FilterGraph *fg)
+{
+    int i;
+
+    for (i = 0; i < fg->nb_overload_enable; i++)
+        av_freep(&fg->overload_enable[i]);
+    av_freep(&fg->overload_enable);
+    fg->nb_overload_enable = 0;
+    fg->overload_shed      = 0;
+}
+
+/*
+ * Disable (shed != 0) or re-enable the expensive filters of the graph
+ * through their timeline, frames then pass through them unprocessed.
+ * Filters without timeline support are left alone.
+ */
+int fg_shed_filters(FilterGraph *fg, int shed)
+{
+    const char *names = overload_filters ? overload_filters : OVERLOAD_FILTERS_DEFAULT;
+    int i, ret = 0;
+
+    if (!fg->graph || fg->overload_shed == shed)
+        return 0;
+
+    if (!shed) {
+        for (i = 0; i < fg->nb_overload_enable; i++) {
+            if (!fg->overload_enable[i])
+                continue;
+            ret = avfilter_process_command(fg->graph->filters[i], "enable",
+                                           fg->overload_enable[i], NULL, 0, 0);
+            if (ret < 0)
+                break;
+        }
+        free_overload_state(fg);
+        return ret;
+    }
+
+    fg->overload_enable = av_mallocz_array(fg->graph->nb_filters, sizeof(*fg->overload_enable));
+    if (!fg->overload_enable)
+        return AVERROR(ENOMEM);
+    fg->nb_overload_enable = fg->graph->nb_filters;
+    fg->overload_shed      = 1;
+
+    for (i = 0; i < fg->graph->nb_filters; i++) {
+        AVFilterContext *f = fg->graph->filters[i];
+
+        if (!(f->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE) ||
+            !av_match_name(f->filter->name, names))
+            continue;
+        fg->overload_enable[i] = av_strdup(f->enable_str ? f->enable_str : "1");
+        if (!fg->overload_enable[i])
+            return AVERROR(ENOMEM);
+        if ((ret = avfilter_process_command(f, "enable", "0", NULL, 0, 0)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static void cleanup_filtergraph(FilterGraph *fg)
 {
     int i;
@@ -1005,6 +1149,8 @@ static void cleanup_filtergraph(FilterGraph *fg)
         fg->outputs[i]->filter = (AVFilterContext *)NULL;
     for (i = 0; i < fg->nb_inputs; i++)
         fg->inputs[i]->filter = (AVFilterContext *)NULL;
+    print_filtergraph_stats(fg);
+    free_overload_state(fg);
     avfilter_graph_free(&fg->graph);
 }
 
@@ -1014,10 +1160,16 @@ int configure_filtergraph(FilterGraph *fg)
     int ret, i, simple = filtergraph_is_simple(fg);
     const char *graph_desc = simple ? fg->outputs[0]->ost->avfilter :
                                       fg->graph_desc;
+    char *hw_graph_desc;
 
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    fg->graph->pipeline_threads = filter_pipeline_nbthreads;
+    if (filter_stats || do_benchmark_all)
+        av_opt_set_int(fg->graph, "stats", 1, 0);
+    if (filter_numa_node >= 0)
+        av_opt_set_int(fg->graph, "numa_node", filter_numa_node, 0);
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1059,7 +1211,12 @@ int configure_filtergraph(FilterGraph *fg)
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
 
-    if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
+    if ((ret = hw_pipeline_setup_for_filter(fg, graph_desc, &hw_graph_desc)) < 0)
+        goto fail;
+    ret = avfilter_graph_parse2(fg->graph, hw_graph_desc ? hw_graph_desc : graph_desc,
+                                &inputs, &outputs);
+    av_freep(&hw_graph_desc);
+    if (ret < 0)
         goto fail;
 
     ret = hw_device_setup_for_filter(fg);
@@ -1180,6 +1337,44 @@ fail:
     return ret;
 }
 
+int ifilter_reconfigure(InputFilter *ifilter, const AVFrame *frame)
+{
+    FilterGraph *fg = ifilter->graph;
+    AVBufferSrcParameters *par;
+    int i, ret;
+
+    if (ifilter->type != AVMEDIA_TYPE_VIDEO || ifilter->format != frame->format)
+        return AVERROR(ENOSYS);
+
+    par = av_buffersrc_parameters_alloc();
+    if (!par)
+        return AVERROR(ENOMEM);
+    par->width               = frame->width;
+    par->height              = frame->height;
+    par->sample_aspect_ratio = frame->sample_aspect_ratio;
+    par->hw_frames_ctx       = frame->hw_frames_ctx;
+    ret = av_buffersrc_reconfigure(ifilter->filter, par);
+    av_freep(&par);
+    if (ret < 0)
+        return ret;
+
+    /* the encoders keep their size: the scaler pinning it is only inserted
+     * when the graph is configured again */
+    for (i = 0; i < fg->nb_outputs; i++) {
+        OutputFilter *ofilter = fg->outputs[i];
+
+        if (ofilter->type == AVMEDIA_TYPE_VIDEO && ofilter->ost && ofilter->ost->autoscale &&
+            (av_buffersink_get_w(ofilter->filter) != ofilter->width ||
+             av_buffersink_get_h(ofilter->filter) != ofilter->height))
+            return AVERROR(ENOSYS);
+    }
+
+    av_log(NULL, AV_LOG_VERBOSE, "Filtergraph reconfigured in place for input stream "
+           "#%d:%d at %dx%d\n", ifilter->ist->file_index, ifilter->ist->st->index,
+           frame->width, frame->height);
+    return ifilter_parameters_from_frame(ifilter, frame);
+}
+
 int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame)
 {
     av_buffer_unref(&ifilter->hw_frames_ctx);
@@ -1203,6 +1398,104 @@ int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *frame)
     return 0;
 }
 
+/*
+ * Check whether all the simple filtergraphs fed by ist convert its frames to
+ * the same pixel format first, and if so set up a graph doing it once for all
+ * of them. The filtergraphs are then configured for the converted frames.
+ * Must be called before any frame was sent to the filtergraphs.
+ */
+int configure_shared_conversion(InputStream *ist, const AVFrame *frame)
+{
+    const char *sws_opts = NULL;
+    enum AVPixelFormat formats[] = { AV_PIX_FMT_NONE, AV_PIX_FMT_NONE };
+    AVFilterGraph *graph;
+    AVRational sar = frame->sample_aspect_ratio;
+    char args[256];
+    int i, ret;
+
+    if (ist->nb_filters < 2 || ist->dec_ctx->codec_type != AVMEDIA_TYPE_VIDEO ||
+        frame->hw_frames_ctx || !ist->reinit_filters)
+        return 0;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        FilterGraph *fg = ist->filters[i]->graph;
+        if (!filtergraph_is_simple(fg) || fg->graph)
+            return 0;
+    }
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        InputFilter *ifilter = ist->filters[i];
+        FilterGraph *fg = ifilter->graph;
+        AVFilterContext *conv;
+
+        if ((ret = ifilter_parameters_from_frame(ifilter, frame)) < 0 ||
+            (ret = configure_filtergraph(fg)) < 0)
+            return ret;
+
+        /* skip the null filter inserted for graphs without filters */
+        conv = ifilter->filter->outputs[0]->dst;
+        while (!strcmp(conv->filter->name, "null"))
+            conv = conv->outputs[0]->dst;
+        if (strncmp(conv->name, "auto_scaler_", 12) ||
+            conv->outputs[0]->w != frame->width ||
+            conv->outputs[0]->h != frame->height)
+            return 0;
+        if (!i) {
+            formats[0] = conv->outputs[0]->format;
+            sws_opts   = fg->graph->scale_sws_opts;
+        } else if (conv->outputs[0]->format != formats[0] ||
+                   strcmp(sws_opts ? sws_opts : "",
+                          fg->graph->scale_sws_opts ? fg->graph->scale_sws_opts : "")) {
+            return 0;
+        }
+    }
+
+    if (!(graph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+    graph->nb_threads = filter_nbthreads;
+    if (sws_opts && !(graph->scale_sws_opts = av_strdup(sws_opts))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if (!sar.den)
+        sar = (AVRational){ 0, 1 };
+    snprintf(args, sizeof(args),
+             "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+             frame->width, frame->height, frame->format,
+             ist->st->time_base.num, ist->st->time_base.den, sar.num, sar.den);
+    if ((ret = avfilter_graph_create_filter(&ist->conv_src, avfilter_get_by_name("buffer"),
+                                            "conversion input", args, NULL, graph)) < 0 ||
+        (ret = avfilter_graph_create_filter(&ist->conv_sink, avfilter_get_by_name("buffersink"),
+                                            "conversion output", NULL, NULL, graph)) < 0 ||
+        (ret = av_opt_set_int_list(ist->conv_sink, "pix_fmts", formats,
+                                   AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0 ||
+        (ret = avfilter_link(ist->conv_src, 0, ist->conv_sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto fail;
+
+    if (!ist->conv_frame && !(ist->conv_frame = av_frame_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        ist->filters[i]->format = formats[0];
+        if ((ret = configure_filtergraph(ist->filters[i]->graph)) < 0)
+            goto fail;
+    }
+
+    av_log(NULL, AV_LOG_VERBOSE, "Converting stream #%d:%d to %s once for %d filtergraphs\n",
+           ist->file_index, ist->st->index, av_get_pix_fmt_name(formats[0]), ist->nb_filters);
+    ist->conv_graph = graph;
+    return 0;
+
+fail:
+    avfilter_graph_free(&graph);
+    ist->conv_src = ist->conv_sink = NULL;
+    return ret;
+}
+
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist)
 {
     int i;
@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/pixdesc.h"
 #include "libavfilter/buffersink.h"
 
@@ -27,6 +28,16 @@
 static int nb_hw_devices;
 static HWDevice **hw_devices;
 
+// Device pools backing "type:auto" devices, one per type and option string.
+typedef struct HWDevicePoolEntry {
+    enum AVHWDeviceType type;
+    char *options;
+    AVHWDevicePool *pool;
+} HWDevicePoolEntry;
+
+static int nb_hw_device_pools;
+static HWDevicePoolEntry *hw_device_pools;
+
 static HWDevice *hw_device_get_by_type(enum AVHWDeviceType type)
 {
     HWDevice *found = NULL;
@@ -91,11 +102,61 @@ static char *hw_device_default_name(enum AVHWDeviceType type)
     return name;
 }
 
+static int hw_device_get_from_pool(AVBufferRef **device_ref,
+                                   enum AVHWDeviceType type,
+                                   const char *options_str,
+                                   AVDictionary *options)
+{
+    HWDevicePoolEntry *entry = NULL;
+    int i, err;
+
+    for (i = 0; i < nb_hw_device_pools; i++) {
+        if (hw_device_pools[i].type == type &&
+            !strcmp(hw_device_pools[i].options, options_str)) {
+            entry = &hw_device_pools[i];
+            break;
+        }
+    }
+
+    if (!entry) {
+        AVHWDevicePool *pool;
+        char *opts_copy;
+
+        err = av_hwdevice_pool_create(&pool, type, options, 0);
+        if (err < 0)
+            return err;
+
+        opts_copy = av_strdup(options_str);
+        if (!opts_copy) {
+            av_hwdevice_pool_free(&pool);
+            return AVERROR(ENOMEM);
+        }
+        err = av_reallocp_array(&hw_device_pools, nb_hw_device_pools + 1,
+                                sizeof(*hw_device_pools));
+        if (err < 0) {
+            nb_hw_device_pools = 0;
+            av_free(opts_copy);
+            av_hwdevice_pool_free(&pool);
+            return err;
+        }
+
+        entry = &hw_device_pools[nb_hw_device_pools++];
+        entry->type    = type;
+        entry->options = opts_copy;
+        entry->pool    = pool;
+    }
+
+    return av_hwdevice_pool_get(entry->pool, device_ref);
+}
+
 int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
 {
     // "type=name:device,key=value,key2=value2"
     // "type:device,key=value,key2=value2"
     // -> av_hwdevice_ctx_create()
+    // "type=name:auto,key=value,key2=value2"
+    // "type:auto,key=value,key2=value2"
+    // -> av_hwdevice_pool_get()
     // "type=name@name"
     // "type@name"
     // -> av_hwdevice_ctx_create_derived()
@@ -105,10 +166,23 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
     enum AVHWDeviceType type;
     HWDevice *dev, *src;
     AVBufferRef *device_ref = NULL;
-    int err;
+    int err, i;
     const char *errmsg, *p, *q;
     size_t k;
 
+    // A worker job asking for the same device as an earlier job gets
+    // the device created for that one.
+    for (i = 0; i < nb_hw_devices; i++) {
+        dev = hw_devices[i];
+        if (dev->kept && dev->spec && !strcmp(dev->spec, arg)) {
+            av_log(NULL, AV_LOG_VERBOSE, "Reusing device %s.\n", dev->name);
+            dev->kept = 0;
+            if (dev_out)
+                *dev_out = dev;
+            return 0;
+        }
+    }
+
     k = strcspn(arg, ":=@");
     p = arg + k;
 
@@ -171,9 +245,15 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
             }
         }
 
-        err = av_hwdevice_ctx_create(&device_ref, type,
-                                     q ? device : p[0] ? p : NULL,
-                                     options, 0);
+        err = AVERROR(ENOSYS);
+        if (!strcmp(q ? (device ? device : "") : p, "auto"))
+            err = hw_device_get_from_pool(&device_ref, type,
+                                          q ? q + 1 : "", options);
+        // Types without enumeration may take "auto" as a device string.
+        if (err == AVERROR(ENOSYS))
+            err = av_hwdevice_ctx_create(&device_ref, type,
+                                         q ? device : p[0] ? p : NULL,
+                                         options, 0);
         if (err < 0)
             goto fail;
 
@@ -204,6 +284,7 @@ int hw_device_init_from_string(const char *arg, HWDevice **dev_out)
     dev->name = name;
     dev->type = type;
     dev->device_ref = device_ref;
+    dev->spec = av_strdup(arg);
 
     if (dev_out)
         *dev_out = dev;
@@ -276,11 +357,26 @@ void hw_device_free_all(void)
     int i;
     for (i = 0; i < nb_hw_devices; i++) {
         av_freep(&hw_devices[i]->name);
+        av_freep(&hw_devices[i]->spec);
         av_buffer_unref(&hw_devices[i]->device_ref);
         av_freep(&hw_devices[i]);
     }
     av_freep(&hw_devices);
     nb_hw_devices = 0;
+
+    for (i = 0; i < nb_hw_device_pools; i++) {
+        av_freep(&hw_device_pools[i].options);
+        av_hwdevice_pool_free(&hw_device_pools[i].pool);
+    }
+    av_freep(&hw_device_pools);
+    nb_hw_device_pools = 0;
+}
+
+void hw_device_keep_all(void)
+{
+    int i;
+    for (i = 0; i < nb_hw_devices; i++)
+        hw_devices[i]->kept = 1;
 }
 
 static HWDevice *hw_device_match_by_codec(const AVCodec *codec)
@@ -538,6 +634,13 @@ int hw_device_setup_for_filter(FilterGraph *fg)
     else
         dev = NULL;
 
+    // Otherwise use the device of a hardware pipeline feeding the graph.
+    for (i = 0; !dev && fg->hw_pipeline && i < fg->nb_inputs; i++) {
+        InputStream *ist = fg->inputs[i]->ist;
+        if (ist->hwaccel_pipeline)
+            dev = hw_device_get_by_name(ist->hwaccel_device);
+    }
+
     if (dev) {
         for (i = 0; i < fg->graph->nb_filters; i++) {
             fg->graph->filters[i]->hw_device_ctx =
@@ -549,3 +652,291 @@ int hw_device_setup_for_filter(FilterGraph *fg)
 
     return 0;
 }
+
+/*
+ * -hwaccel auto-pipeline: decode into device memory and keep the frames there
+ * through the filtergraphs and the encoder where possible.
+ */
+
+int hw_pipeline_setup_for_decode(InputStream *ist)
+{
+    const AVCodecHWConfig *config = NULL;
+    HWDevice *dev = NULL;
+    int i, create;
+
+    // Prefer the devices created with -init_hw_device or by earlier
+    // streams, only then try to create a new one.
+    for (create = 0; create < 2 && !dev; create++) {
+        for (i = 0; !dev && (config = avcodec_get_hw_config(ist->dec, i)); i++) {
+            if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX))
+                continue;
+            if (create) {
+                if (hw_device_init_from_type(config->device_type,
+                                             ist->hwaccel_device, &dev) < 0)
+                    dev = NULL;
+            } else if (ist->hwaccel_device) {
+                dev = hw_device_get_by_name(ist->hwaccel_device);
+                if (dev && dev->type != config->device_type)
+                    dev = NULL;
+            } else {
+                dev = hw_device_get_by_type(config->device_type);
+            }
+        }
+    }
+
+    if (!dev) {
+        av_log(NULL, AV_LOG_WARNING, "No hardware device usable for decoding "
+               "stream #%d:%d, its frames will be in host memory.\n",
+               ist->file_index, ist->st->index);
+        ist->hwaccel_pipeline = 0;
+        ist->hwaccel_id       = HWACCEL_NONE;
+        return 0;
+    }
+
+    ist->hwaccel_id          = HWACCEL_GENERIC;
+    ist->hwaccel_device_type = dev->type;
+    av_freep(&ist->hwaccel_device);
+    ist->hwaccel_device = av_strdup(dev->name);
+    if (!ist->hwaccel_device)
+        return AVERROR(ENOMEM);
+
+    if (ist->hwaccel_output_format == AV_PIX_FMT_NONE)
+        ist->hwaccel_output_format = config->pix_fmt;
+    else if (ist->hwaccel_output_format != config->pix_fmt)
+        av_log(NULL, AV_LOG_WARNING, "Decoded frames of stream #%d:%d will "
+               "be copied to host memory (hwaccel output format %s).\n",
+               ist->file_index, ist->st->index,
+               av_get_pix_fmt_name(ist->hwaccel_output_format));
+
+    av_log(NULL, AV_LOG_INFO, "Using device %s (type %s) for the hardware "
+           "pipeline of stream #%d:%d.\n", dev->name,
+           av_hwdevice_get_type_name(dev->type), ist->file_index, ist->st->index);
+    return 0;
+}
+
+AVCodec *hw_pipeline_find_encoder(InputStream *ist, enum AVCodecID codec_id)
+{
+    const char *suffix;
+    char name[64];
+    AVCodec *enc;
+
+    if (!ist->hwaccel_pipeline)
+        return NULL;
+
+    // The NVIDIA encoders are named after NVENC rather than the device.
+    if (ist->hwaccel_device_type == AV_HWDEVICE_TYPE_CUDA)
+        suffix = "nvenc";
+    else
+        suffix = av_hwdevice_get_type_name(ist->hwaccel_device_type);
+    snprintf(name, sizeof(name), "%s_%s", avcodec_get_name(codec_id), suffix);
+
+    enc = avcodec_find_encoder_by_name(name);
+    if (!enc || enc->id != codec_id)
+        return NULL;
+    av_log(NULL, AV_LOG_VERBOSE, "Using encoder %s for the hardware pipeline "
+           "of stream #%d:%d.\n", enc->name, ist->file_index, ist->st->index);
+    return enc;
+}
+
+// Filters which do not touch the frame data and so work on any hardware frames.
+static const char *const pipeline_passthrough_filters[] = {
+    "null", "fps", "setpts", "settb", "trim", "setsar", "setdar",
+    "setfield", "setparams", "split", NULL
+};
+
+// OpenCL filters which forward their input frames, so that the mapping can
+// simply be undone after them.
+static const char *const pipeline_opencl_passthrough_filters[] = {
+    "scdet_opencl", "thumbnail_opencl", NULL
+};
+
+// Device types whose frames can be mapped to OpenCL.
+static const enum AVHWDeviceType pipeline_opencl_mappable[] = {
+    AV_HWDEVICE_TYPE_VAAPI, AV_HWDEVICE_TYPE_QSV, AV_HWDEVICE_TYPE_DXVA2,
+    AV_HWDEVICE_TYPE_D3D11VA, AV_HWDEVICE_TYPE_DRM, AV_HWDEVICE_TYPE_NONE
+};
+
+static int is_hw_filter_name(const char *name, const char *type_name)
+{
+    const char *suffix = strrchr(name, '_');
+
+    if (!strcmp(name, "hwupload") || !strcmp(name, "hwdownload") ||
+        !strcmp(name, "hwmap"))
+        return 1;
+    return suffix && (!strcmp(suffix + 1, type_name) ||
+                      !strcmp(suffix + 1, "opencl"));
+}
+
+/*
+ * Copy a filter description, replacing every video filter by its variant for
+ * the given device type, or by its OpenCL variant surrounded by hwmap filters.
+ * Returns 1 if the graph already handles hardware frames itself, 0 on success,
+ * AVERROR(ENOSYS) with the name of the filter in *unsupported if a filter has
+ * no hardware variant.
+ */
+static int pipeline_rewrite(AVBPrint *bp, const char *desc,
+                            enum AVHWDeviceType type, char *unsupported,
+                            size_t unsupported_size)
+{
+    const char *type_name = av_hwdevice_get_type_name(type);
+    const char *p = desc;
+    int opencl = 0, i;
+
+    for (i = 0; pipeline_opencl_mappable[i] != AV_HWDEVICE_TYPE_NONE; i++)
+        if (pipeline_opencl_mappable[i] == type)
+            opencl = avfilter_get_by_name("hwmap") != NULL;
+
+    while (*p) {
+        const AVFilter *filter, *hw_filter;
+        char name[128], hw_name[160];
+        size_t len;
+        int wrap = 0;
+
+        // input link labels
+        for (;;) {
+            len = strspn(p, " \n\t\r");
+            av_bprint_append_data(bp, p, len);
+            p += len;
+            if (*p != '[')
+                break;
+            len = strcspn(p, "]");
+            len += !!p[len];
+            av_bprint_append_data(bp, p, len);
+            p += len;
+        }
+
+        len = strcspn(p, "@=,;[] \n\t\r");
+        av_strlcpy(name, p, FFMIN(len + 1, sizeof(name)));
+        p += len;
+
+        filter = avfilter_get_by_name(name);
+        if (!filter)
+            return AVERROR_FILTER_NOT_FOUND;
+
+        if (is_hw_filter_name(name, type_name))
+            return 1;
+
+        hw_filter = NULL;
+        if ((filter->inputs  && avfilter_pad_get_type(filter->inputs,  0) == AVMEDIA_TYPE_AUDIO) ||
+            (filter->outputs && avfilter_pad_get_type(filter->outputs, 0) == AVMEDIA_TYPE_AUDIO)) {
+            hw_filter = filter;
+        } else {
+            for (i = 0; pipeline_passthrough_filters[i]; i++)
+                if (!strcmp(name, pipeline_passthrough_filters[i]))
+                    hw_filter = filter;
+        }
+        if (!hw_filter) {
+            snprintf(hw_name, sizeof(hw_name), "%s_%s", name, type_name);
+            hw_filter = avfilter_get_by_name(hw_name);
+        }
+        if (!hw_filter && opencl && filter->inputs &&
+            avfilter_pad_count(filter->inputs) == 1 &&
+            !(filter->flags & AVFILTER_FLAG_DYNAMIC_INPUTS)) {
+            snprintf(hw_name, sizeof(hw_name), "%s_opencl", name);
+            hw_filter = avfilter_get_by_name(hw_name);
+            wrap = !!hw_filter;
+        }
+        if (!hw_filter) {
+            av_strlcpy(unsupported, name, unsupported_size);
+            return AVERROR(ENOSYS);
+        }
+
+        if (wrap)
+            av_bprintf(bp, "hwmap=derive_device=opencl,");
+        av_bprintf(bp, "%s", hw_filter->name);
+
+        // instance name and arguments, up to the output link labels
+        while (*p && !strchr("[],;", *p)) {
+            if (*p == '\\' && p[1]) {
+                av_bprint_append_data(bp, p, 2);
+                p += 2;
+            } else if (*p == '\'') {
+                len = strcspn(p + 1, "'");
+                len += 1 + !!p[len + 1];
+                av_bprint_append_data(bp, p, len);
+                p += len;
+            } else {
+                av_bprint_append_data(bp, p++, 1);
+            }
+        }
+
+        if (wrap) {
+            for (i = 0; pipeline_opencl_passthrough_filters[i]; i++)
+                if (!strcmp(hw_filter->name, pipeline_opencl_passthrough_filters[i]))
+                    break;
+            av_bprintf(bp, ",hwmap=derive_device=%s%s", type_name,
+                       pipeline_opencl_passthrough_filters[i] ? "" : ":reverse=1");
+        }
+
+        // output link labels and the separator
+        while (*p == '[') {
+            len = strcspn(p, "]");
+            len += !!p[len];
+            av_bprint_append_data(bp, p, len);
+            p += len;
+            len = strspn(p, " \n\t\r");
+            av_bprint_append_data(bp, p, len);
+            p += len;
+        }
+        if (*p == ',' || *p == ';')
+            av_bprint_append_data(bp, p++, 1);
+        else if (*p)
+            return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+int hw_pipeline_setup_for_filter(FilterGraph *fg, const char *graph_desc,
+                                 char **hw_graph_desc)
+{
+    enum AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+    char unsupported[128];
+    AVBPrint bp;
+    int i, ret;
+
+    fg->hw_pipeline = 0;
+    *hw_graph_desc  = NULL;
+
+    // All the video inputs must come from the same device.
+    for (i = 0; i < fg->nb_inputs; i++) {
+        InputFilter *ifilter = fg->inputs[i];
+        enum AVHWDeviceType input_type;
+
+        if (ifilter->type != AVMEDIA_TYPE_VIDEO)
+            continue;
+        if (!ifilter->ist->hwaccel_pipeline || !ifilter->hw_frames_ctx)
+            return 0;
+        input_type = ((AVHWFramesContext*)ifilter->hw_frames_ctx->data)->device_ctx->type;
+        if (type != AV_HWDEVICE_TYPE_NONE && type != input_type)
+            return 0;
+        type = input_type;
+    }
+    if (type == AV_HWDEVICE_TYPE_NONE)
+        return 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = pipeline_rewrite(&bp, graph_desc, type, unsupported, sizeof(unsupported));
+    if (ret == 0) {
+        ret = av_bprint_finalize(&bp, hw_graph_desc);
+        if (ret < 0)
+            return ret;
+        av_log(NULL, AV_LOG_VERBOSE, "Filtergraph '%s' runs on %s as '%s'.\n",
+               graph_desc, av_hwdevice_get_type_name(type), *hw_graph_desc);
+        fg->hw_pipeline = 1;
+        return 0;
+    }
+    av_bprint_finalize(&bp, NULL);
+
+    if (ret == 1) {
+        fg->hw_pipeline = 1;
+    } else if (ret == AVERROR(ENOSYS)) {
+        av_log(NULL, AV_LOG_WARNING, "Filter '%s' has no %s variant, the "
+               "frames of filtergraph '%s' will be copied to host memory.\n",
+               unsupported, av_hwdevice_get_type_name(type), graph_desc);
+    } else if (ret != AVERROR_FILTER_NOT_FOUND && ret != AVERROR(EINVAL)) {
+        return ret;
+    }
+    // errors in the description are reported by the filtergraph parser
+    return 0;
+}
@@ -41,6 +41,7 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/trace.h"
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
@@ -93,6 +94,8 @@ static const char *opt_name_discard[]                   = {"discard", NULL};
 static const char *opt_name_disposition[]               = {"disposition", NULL};
 static const char *opt_name_time_bases[]                = {"time_base", NULL};
 static const char *opt_name_enc_time_bases[]            = {"enc_time_base", NULL};
+static const char *opt_name_enc_chunks[]                = {"enc_chunks", NULL};
+static const char *opt_name_enc_chunk_frames[]          = {"enc_chunk_frames", NULL};
 
 #define WARN_MULTIPLE_OPT_USAGE(name, type, so, st)\
 {\
@@ -153,9 +156,12 @@ int audio_volume      = 256;
 int audio_sync_method = 0;
 int video_sync_method = VSYNC_AUTO;
 float frame_drop_threshold = 0;
+float overload_lag = 0;
+char *overload_filters;
 int do_deinterlace    = 0;
 int do_benchmark      = 0;
 int do_benchmark_all  = 0;
+int filter_stats      = 0;
 int do_hex_dump       = 0;
 int do_pkt_dump       = 0;
 int copy_ts           = 0;
@@ -171,7 +177,13 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int filter_pipeline_nbthreads = 0;
+int filter_numa_node = -1;
+int enc_thread_queue_size = 0;
+int64_t stats_period = 500000;
 int vstats_version = 2;
+char *worker_url;
+char *worker_status_url;
 
 
 static int intra_only         = 0;
@@ -228,6 +240,7 @@ static void init_options(OptionsContext *o)
     o->limit_filesize = UINT64_MAX;
     o->chapters_input_file = INT_MAX;
     o->accurate_seek  = 1;
+    o->thread_queue_size = -1;
 }
 
 static int show_hwaccels(void *optctx, const char *opt, const char *arg)
@@ -901,6 +914,8 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
                     ist->hwaccel_id = HWACCEL_NONE;
                 else if (!strcmp(hwaccel, "auto"))
                     ist->hwaccel_id = HWACCEL_AUTO;
+                else if (!strcmp(hwaccel, "auto-pipeline"))
+                    ist->hwaccel_pipeline = 1;
                 else {
                     enum AVHWDeviceType type;
                     int i;
@@ -941,6 +956,13 @@ static void add_input_streams(OptionsContext *o, AVFormatContext *ic)
                     exit_program(1);
             }
 
+            if (ist->hwaccel_pipeline) {
+                if (!ist->dec)
+                    ist->hwaccel_pipeline = 0;
+                else if (hw_pipeline_setup_for_decode(ist) < 0)
+                    exit_program(1);
+            }
+
             ist->hwaccel_pix_fmt = AV_PIX_FMT_NONE;
 
             break;
@@ -1270,7 +1292,7 @@ static int open_input_file(OptionsContext *o, const char *filename)
     f->duration = 0;
     f->time_base = (AVRational){ 1, 1 };
 #if HAVE_THREADS
-    f->thread_queue_size = o->thread_queue_size > 0 ? o->thread_queue_size : 8;
+    f->thread_queue_size = o->thread_queue_size;
 #endif
 
     /* check if all codec options have been used */
@@ -1372,7 +1394,8 @@ static int get_preset_file_2(const char *preset_name, const char *codec_name, AV
     return ret;
 }
 
-static int choose_encoder(OptionsContext *o, AVFormatContext *s, OutputStream *ost)
+static int choose_encoder(OptionsContext *o, AVFormatContext *s, OutputStream *ost,
+                          int source_index)
 {
     enum AVMediaType type = ost->st->codecpar->codec_type;
     char *codec_name = NULL;
@@ -1382,7 +1405,11 @@ static int choose_encoder(OptionsContext *o, AVFormatContext *s, OutputStream *o
         if (!codec_name) {
             ost->st->codecpar->codec_id = av_guess_codec(s->oformat, NULL, s->url,
                                                          NULL, ost->st->codecpar->codec_type);
-            ost->enc = avcodec_find_encoder(ost->st->codecpar->codec_id);
+            if (type == AVMEDIA_TYPE_VIDEO && source_index >= 0)
+                ost->enc = hw_pipeline_find_encoder(input_streams[source_index],
+                                                    ost->st->codecpar->codec_id);
+            if (!ost->enc)
+                ost->enc = avcodec_find_encoder(ost->st->codecpar->codec_id);
             if (!ost->enc) {
                 av_log(NULL, AV_LOG_FATAL, "Automatic encoder selection failed for "
                        "output stream #%d:%d. Default encoder for format %s (codec %s) is "
@@ -1436,7 +1463,7 @@ static OutputStream *new_output_stream(OptionsContext *o, AVFormatContext *oc, e
     ost->forced_kf_ref_pts = AV_NOPTS_VALUE;
     st->codecpar->codec_type = type;
 
-    ret = choose_encoder(o, oc, ost);
+    ret = choose_encoder(o, oc, ost, source_index);
     if (ret < 0) {
         av_log(NULL, AV_LOG_FATAL, "Error selecting an encoder for stream "
                "%d:%d\n", ost->file_index, ost->index);
@@ -1852,6 +1879,14 @@ static OutputStream *new_video_stream(OptionsContext *o, AVFormatContext *oc, in
         ost->top_field_first = -1;
         MATCH_PER_STREAM_OPT(top_field_first, i, ost->top_field_first, oc, st);
 
+        MATCH_PER_STREAM_OPT(enc_chunks, i, ost->enc_chunks, oc, st);
+        ost->enc_chunk_frames = 250;
+        MATCH_PER_STREAM_OPT(enc_chunk_frames, i, ost->enc_chunk_frames, oc, st);
+        if (ost->enc_chunk_frames <= 0) {
+            av_log(NULL, AV_LOG_FATAL, "Invalid number of chunk frames: %d\n",
+                   ost->enc_chunk_frames);
+            exit_program(1);
+        }
 
         ost->avfilter = get_ost_filters(o, oc, ost);
         if (!ost->avfilter)
@@ -3312,6 +3347,131 @@ static int open_files(OptionGroupList *l, const char *inout,
     return 0;
 }
 
+typedef struct SavedOption {
+    const OptionDef *po;
+    union {
+        int     i;
+        int64_t i64;
+        float   f;
+        double  dbl;
+        char   *str;
+    } val;
+} SavedOption;
+
+/* the global options of the worker command line, see save_global_options() */
+static SavedOption *saved_options;
+static int       nb_saved_options;
+static int       saved_video_sync_method;
+static int       saved_abort_on_flags;
+static int64_t   saved_stats_period;
+static HWDevice *saved_filter_hw_device;
+static char     *saved_sdp_filename;
+static char     *saved_vstats_filename;
+
+static int is_global_value_option(const OptionDef *po)
+{
+    return !(po->flags & (OPT_OFFSET | OPT_SPEC)) &&
+           po->flags & (OPT_STRING | OPT_BOOL | OPT_INT | OPT_INT64 |
+                        OPT_TIME | OPT_FLOAT | OPT_DOUBLE);
+}
+
+static int save_string(char **dst, const char *src)
+{
+    av_freep(dst);
+    if (src && !(*dst = av_strdup(src)))
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+int save_global_options(void)
+{
+    const OptionDef *po;
+    int ret;
+
+    for (po = options; po->name; po++) {
+        SavedOption *so;
+
+        if (!is_global_value_option(po))
+            continue;
+        so = av_dynarray2_add((void **)&saved_options, &nb_saved_options,
+                              sizeof(*saved_options), NULL);
+        if (!so)
+            return AVERROR(ENOMEM);
+        memset(so, 0, sizeof(*so));
+        so->po = po;
+
+        if (po->flags & OPT_STRING) {
+            if ((ret = save_string(&so->val.str, *(char **)po->u.dst_ptr)) < 0)
+                return ret;
+        } else if (po->flags & (OPT_BOOL | OPT_INT)) {
+            so->val.i   = *(int *)po->u.dst_ptr;
+        } else if (po->flags & (OPT_INT64 | OPT_TIME)) {
+            so->val.i64 = *(int64_t *)po->u.dst_ptr;
+        } else if (po->flags & OPT_FLOAT) {
+            so->val.f   = *(float *)po->u.dst_ptr;
+        } else {
+            so->val.dbl = *(double *)po->u.dst_ptr;
+        }
+    }
+
+    /* globals set by option callbacks */
+    saved_video_sync_method = video_sync_method;
+    saved_abort_on_flags    = abort_on_flags;
+    saved_stats_period      = stats_period;
+    saved_filter_hw_device  = filter_hw_device;
+    if ((ret = save_string(&saved_sdp_filename,    sdp_filename))    < 0 ||
+        (ret = save_string(&saved_vstats_filename, vstats_filename)) < 0)
+        return ret;
+    return 0;
+}
+
+int restore_global_options(void)
+{
+    int i, ret;
+
+    for (i = 0; i < nb_saved_options; i++) {
+        SavedOption   *so = &saved_options[i];
+        const OptionDef *po = so->po;
+
+        if (po->flags & OPT_STRING) {
+            if ((ret = save_string(po->u.dst_ptr, so->val.str)) < 0)
+                return ret;
+        } else if (po->flags & (OPT_BOOL | OPT_INT)) {
+            *(int *)po->u.dst_ptr     = so->val.i;
+        } else if (po->flags & (OPT_INT64 | OPT_TIME)) {
+            *(int64_t *)po->u.dst_ptr = so->val.i64;
+        } else if (po->flags & OPT_FLOAT) {
+            *(float *)po->u.dst_ptr   = so->val.f;
+        } else {
+            *(double *)po->u.dst_ptr  = so->val.dbl;
+        }
+    }
+
+    video_sync_method = saved_video_sync_method;
+    abort_on_flags    = saved_abort_on_flags;
+    stats_period      = saved_stats_period;
+    filter_hw_device  = saved_filter_hw_device;
+    if ((ret = save_string(&sdp_filename,    saved_sdp_filename))    < 0 ||
+        (ret = save_string(&vstats_filename, saved_vstats_filename)) < 0)
+        return ret;
+
+    input_stream_potentially_available = 0;
+    return 0;
+}
+
+void free_saved_global_options(void)
+{
+    int i;
+
+    for (i = 0; i < nb_saved_options; i++)
+        if (saved_options[i].po->flags & OPT_STRING)
+            av_freep(&saved_options[i].val.str);
+    av_freep(&saved_options);
+    nb_saved_options = 0;
+    av_freep(&saved_sdp_filename);
+    av_freep(&saved_vstats_filename);
+}
+
 int ffmpeg_parse_options(int argc, char **argv)
 {
     OptionParseContext octx;
@@ -3387,6 +3547,44 @@ static int opt_progress(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_trace(void *optctx, const char *opt, const char *arg)
+{
+    int ret = av_trace_start(arg, 0);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Failed to start tracing: %s\n",
+               av_err2str(ret));
+    return ret;
+}
+
+static int opt_stats_report(void *optctx, const char *opt, const char *arg)
+{
+    AVIOContext *avio = NULL;
+    int ret;
+
+    if (!strcmp(arg, "-"))
+        arg = "pipe:";
+    ret = avio_open2(&avio, arg, AVIO_FLAG_WRITE, &int_cb, NULL);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open stats report URL \"%s\": %s\n",
+               arg, av_err2str(ret));
+        return ret;
+    }
+    stats_report_avio = avio;
+    return 0;
+}
+
+static int opt_stats_period(void *optctx, const char *opt, const char *arg)
+{
+    int64_t period = parse_time_or_die(opt, arg, 1);
+
+    if (period <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "stats_period %s must be positive.\n", arg);
+        return AVERROR(EINVAL);
+    }
+    stats_period = period;
+    return 0;
+}
+
 #define OFFSET(x) offsetof(OptionsContext, x)
 const OptionDef options[] = {
     /* main options */
@@ -3463,8 +3661,20 @@ const OptionDef options[] = {
         "add timings for benchmarking" },
     { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
       "add timings for each task" },
+    { "filter_stats",   OPT_BOOL | OPT_EXPERT,                       { &filter_stats },
+      "print the processing statistics of the filters at exit" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
+    { "stats_report",   HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_stats_report },
+      "write per-stage timing and queue statistics as JSON", "url" },
+    { "trace",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_trace },
+      "write the processing spans of all threads as Chrome trace JSON", "filename" },
+    { "stats_period",   HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_stats_period },
+      "set the period at which statistics and progress are updated", "time" },
+    { "worker",         OPT_STRING | HAS_ARG | OPT_EXPERT,           { &worker_url },
+      "run the command lines read from url as jobs in this process", "url" },
+    { "worker_status",  OPT_STRING | HAS_ARG | OPT_EXPERT,           { &worker_status_url },
+      "write the exit status of each worker job to url", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
       "enable or disable interaction on standard input" },
     { "timelimit",      HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_timelimit },
@@ -3483,6 +3693,10 @@ const OptionDef options[] = {
         "video sync method", "" },
     { "frame_drop_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,      { &frame_drop_threshold },
         "frame drop threshold", "" },
+    { "overload_lag",   HAS_ARG | OPT_FLOAT | OPT_EXPERT,                { &overload_lag },
+        "shed load when processing is more than this many seconds behind real time", "seconds" },
+    { "overload_filters", HAS_ARG | OPT_STRING | OPT_EXPERT,             { &overload_filters },
+        "filters disabled first when processing falls behind real time", "list" },
     { "async",          HAS_ARG | OPT_INT | OPT_EXPERT,              { &audio_sync_method },
         "audio sync method", "" },
     { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT,          { &audio_drift_threshold },
@@ -3532,6 +3746,10 @@ const OptionDef options[] = {
         "set stream filtergraph", "filter_graph" },
     { "filter_threads",  HAS_ARG | OPT_INT,                          { &filter_nbthreads },
         "number of non-complex filter threads" },
+    { "filter_pipeline_threads", HAS_ARG | OPT_INT | OPT_EXPERT,     { &filter_pipeline_nbthreads },
+        "number of threads running the filters of a graph concurrently" },
+    { "filter_numa_node", HAS_ARG | OPT_INT | OPT_EXPERT,            { &filter_numa_node },
+        "NUMA node to run the filter threads on", "node" },
     { "filter_script",  HAS_ARG | OPT_STRING | OPT_SPEC | OPT_OUTPUT, { .off = OFFSET(filter_scripts) },
         "read stream filtergraph description from a file", "filename" },
     { "reinit_filter",  HAS_ARG | OPT_INT | OPT_SPEC | OPT_INPUT,    { .off = OFFSET(reinit_filters) },
@@ -3540,6 +3758,8 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "enc_thread_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,         { &enc_thread_queue_size },
+        "maximum number of frames queued for each encoder thread, 0 to encode on the main thread", "size" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -3640,6 +3860,12 @@ const OptionDef options[] = {
     { "force_fps",    OPT_VIDEO | OPT_BOOL | OPT_EXPERT  | OPT_SPEC |
                       OPT_OUTPUT,                                                { .off = OFFSET(force_fps) },
         "force the selected framerate, disable the best supported framerate selection" },
+    { "enc_chunks",   OPT_VIDEO | HAS_ARG | OPT_EXPERT  | OPT_INT | OPT_SPEC |
+                      OPT_OUTPUT,                                                { .off = OFFSET(enc_chunks) },
+        "encode chunks of the stream in parallel, with this many encoders", "number" },
+    { "enc_chunk_frames", OPT_VIDEO | HAS_ARG | OPT_EXPERT | OPT_INT | OPT_SPEC |
+                      OPT_OUTPUT,                                                { .off = OFFSET(enc_chunk_frames) },
+        "set the minimum number of frames in a chunk for -enc_chunks", "frames" },
     { "streamid",     OPT_VIDEO | HAS_ARG | OPT_EXPERT | OPT_PERFILE |
                       OPT_OUTPUT,                                                { .func_arg = opt_streamid },
         "set the value of an outfile streamid", "streamIndex:value" },
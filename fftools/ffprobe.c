@@ -33,6 +33,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
+#include "libavutil/cpu.h"
 #include "libavutil/display.h"
 #include "libavutil/hash.h"
 #include "libavutil/mastering_display_metadata.h"
@@ -133,6 +134,9 @@ static int read_intervals_nb = 0;
 
 static int find_stream_info  = 1;
 
+static int do_fast_scan      = 0;
+static int fast_scan_threads = 1;
+
 /* section structure definition */
 
 #define SECTION_MAX_NB_CHILDREN 10
@@ -255,6 +259,8 @@ static const OptionDef *options;
 
 /* FFprobe context */
 static const char *input_filename;
+static const char **input_filenames;
+static int nb_input_filenames;
 static const char *print_input_filename;
 static AVInputFormat *iformat = NULL;
 
@@ -3069,6 +3075,236 @@ end:
     return ret;
 }
 
+/* fast scan: list packets without probing or opening the decoders */
+
+#define FAST_SCAN_FLUSH_SIZE (1 << 16)
+
+typedef struct FastScanContext {
+    const char **filenames;
+    int nb_files;
+    int next_file;              ///< index of the next file to scan
+    int ret;                    ///< last error of any file
+    AVMutex lock;               ///< protects next_file, ret and stdout
+} FastScanContext;
+
+typedef struct FastScanStream {
+    int selected;
+    int64_t nb_packets;
+} FastScanStream;
+
+static void fast_scan_flush(FastScanContext *fs, AVBPrint *buf)
+{
+    ff_mutex_lock(&fs->lock);
+    fwrite(buf->str, 1, buf->len, stdout);
+    ff_mutex_unlock(&fs->lock);
+    av_bprint_clear(buf);
+}
+
+static void fast_scan_print_int(AVBPrint *buf, int64_t val, int64_t unset, char sep)
+{
+    if (val == unset)
+        av_bprintf(buf, "N/A%c", sep);
+    else
+        av_bprintf(buf, "%"PRId64"%c", val, sep);
+}
+
+static int fast_scan_add_streams(AVFormatContext *fmt_ctx, int file_index,
+                                 FastScanStream **streams, int *nb_streams,
+                                 AVBPrint *buf)
+{
+    FastScanStream *tmp;
+    int i, ret;
+
+    if (fmt_ctx->nb_streams <= *nb_streams)
+        return 0;
+    tmp = av_realloc_array(*streams, fmt_ctx->nb_streams, sizeof(*tmp));
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    *streams = tmp;
+
+    for (i = *nb_streams; i < fmt_ctx->nb_streams; i++) {
+        AVStream *st = fmt_ctx->streams[i];
+        const char *type = av_get_media_type_string(st->codecpar->codec_type);
+
+        tmp[i].nb_packets = 0;
+        tmp[i].selected   = 1;
+        if (stream_specifier) {
+            ret = avformat_match_stream_specifier(fmt_ctx, st, stream_specifier);
+            if (ret < 0)
+                return ret;
+            tmp[i].selected = ret;
+        }
+        if (!tmp[i].selected) {
+            st->discard = AVDISCARD_ALL;
+            continue;
+        }
+        av_bprintf(buf, "stream,%d,%d,%s,%s,%d/%d\n", file_index, i,
+                   type ? type : "unknown", avcodec_get_name(st->codecpar->codec_id),
+                   st->time_base.num, st->time_base.den);
+    }
+    *nb_streams = fmt_ctx->nb_streams;
+    return 0;
+}
+
+static int fast_scan_file(FastScanContext *fs, int file_index, AVBPrint *buf)
+{
+    const char *filename = fs->filenames[file_index];
+    int show_packets = do_show_packets || !do_count_packets;
+    AVFormatContext *fmt_ctx = NULL;
+    AVDictionary *opts = NULL;
+    FastScanStream *streams = NULL;
+    int nb_streams = 0;
+    AVPacket pkt;
+    int ret, i;
+
+    /* format_opts is shared by all the scanning threads, so work on a copy */
+    ret = av_dict_copy(&opts, format_opts, 0);
+    if (ret >= 0)
+        ret = av_dict_set(&opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+    if (ret >= 0)
+        ret = avformat_open_input(&fmt_ctx, filename, iformat, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        print_error(filename, ret);
+        return ret;
+    }
+
+    av_bprintf(buf, "file,%d,", file_index);
+    csv_escape_str(buf, filename, ',', NULL);
+    av_bprint_chars(buf, '\n', 1);
+
+    av_init_packet(&pkt);
+    while (1) {
+        FastScanStream *fss;
+
+        ret = fast_scan_add_streams(fmt_ctx, file_index, &streams, &nb_streams, buf);
+        if (ret < 0)
+            break;
+        ret = av_read_frame(fmt_ctx, &pkt);
+        if (ret < 0)
+            break;
+        /* streams may have been added while reading this packet */
+        ret = fast_scan_add_streams(fmt_ctx, file_index, &streams, &nb_streams, buf);
+        if (ret < 0) {
+            av_packet_unref(&pkt);
+            break;
+        }
+
+        fss = &streams[pkt.stream_index];
+        if (fss->selected) {
+            fss->nb_packets++;
+            if (show_packets) {
+                av_bprintf(buf, "packet,%d,%d,%c%c,", file_index, pkt.stream_index,
+                           pkt.flags & AV_PKT_FLAG_KEY     ? 'K' : '_',
+                           pkt.flags & AV_PKT_FLAG_DISCARD ? 'D' : '_');
+                fast_scan_print_int(buf, pkt.pts,      AV_NOPTS_VALUE, ',');
+                fast_scan_print_int(buf, pkt.dts,      AV_NOPTS_VALUE, ',');
+                fast_scan_print_int(buf, pkt.duration, 0,              ',');
+                fast_scan_print_int(buf, pkt.pos,      -1,             ',');
+                av_bprintf(buf, "%d\n", pkt.size);
+            }
+        }
+        av_packet_unref(&pkt);
+
+        if (buf->len >= FAST_SCAN_FLUSH_SIZE) {
+            if (!av_bprint_is_complete(buf)) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            fast_scan_flush(fs, buf);
+        }
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    else if (ret < 0)
+        print_error(filename, ret);
+
+    if (do_count_packets) {
+        for (i = 0; i < nb_streams; i++)
+            if (streams[i].selected)
+                av_bprintf(buf, "packets,%d,%d,%"PRId64"\n",
+                           file_index, i, streams[i].nb_packets);
+    }
+    if (!av_bprint_is_complete(buf))
+        ret = AVERROR(ENOMEM);
+
+    av_free(streams);
+    avformat_close_input(&fmt_ctx);
+    return ret;
+}
+
+static void *fast_scan_worker(void *arg)
+{
+    FastScanContext *fs = arg;
+    AVBPrint buf;
+
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while (1) {
+        int file_index, ret;
+
+        ff_mutex_lock(&fs->lock);
+        file_index = fs->next_file++;
+        ff_mutex_unlock(&fs->lock);
+        if (file_index >= fs->nb_files)
+            break;
+
+        ret = fast_scan_file(fs, file_index, &buf);
+        fast_scan_flush(fs, &buf);
+        if (ret < 0) {
+            ff_mutex_lock(&fs->lock);
+            fs->ret = ret;
+            ff_mutex_unlock(&fs->lock);
+        }
+    }
+    av_bprint_finalize(&buf, NULL);
+    return NULL;
+}
+
+/**
+ * Scan all the input files, several of them in parallel if requested.
+ * The calling thread takes part in the scan.
+ */
+static int fast_scan(void)
+{
+    FastScanContext fs = {
+        .filenames = input_filenames,
+        .nb_files  = nb_input_filenames,
+    };
+    int nb_threads = fast_scan_threads > 0 ? fast_scan_threads : av_cpu_count();
+#if HAVE_THREADS
+    pthread_t *threads;
+    int i, nb_created = 0;
+#endif
+
+    nb_threads = FFMIN(nb_threads, nb_input_filenames);
+    ff_mutex_init(&fs.lock, NULL);
+
+#if HAVE_THREADS
+    threads = av_malloc_array(FFMAX(nb_threads - 1, 1), sizeof(*threads));
+    if (!threads) {
+        ff_mutex_destroy(&fs.lock);
+        return AVERROR(ENOMEM);
+    }
+    /* if a thread cannot be created, the ones that exist do its share */
+    for (i = 0; i < nb_threads - 1; i++) {
+        if (pthread_create(&threads[i], NULL, fast_scan_worker, &fs))
+            break;
+        nb_created++;
+    }
+#endif
+
+    fast_scan_worker(&fs);
+
+#if HAVE_THREADS
+    for (i = 0; i < nb_created; i++)
+        pthread_join(threads[i], NULL);
+    av_free(threads);
+#endif
+    fflush(stdout);
+    ff_mutex_destroy(&fs.lock);
+    return fs.ret;
+}
+
 static void show_usage(void)
 {
     av_log(NULL, AV_LOG_INFO, "Simple multimedia streams analyzer\n");
@@ -3287,15 +3523,13 @@ static int opt_show_format_entry(void *optctx, const char *opt, const char *arg)
 
 static void opt_input_file(void *optctx, const char *arg)
 {
-    if (input_filename) {
-        av_log(NULL, AV_LOG_ERROR,
-                "Argument '%s' provided as input filename, but '%s' was already specified.\n",
-                arg, input_filename);
-        exit_program(1);
-    }
     if (!strcmp(arg, "-"))
         arg = "pipe:";
-    input_filename = arg;
+    /* several input files are only accepted by -fast_scan, checked in main() */
+    GROW_ARRAY(input_filenames, nb_input_filenames);
+    input_filenames[nb_input_filenames - 1] = arg;
+    if (!input_filename)
+        input_filename = arg;
 }
 
 static int opt_input_file_i(void *optctx, const char *opt, const char *arg)
@@ -3571,6 +3805,10 @@ static const OptionDef real_options[] = {
     { "print_filename", HAS_ARG, {.func_arg = opt_print_filename}, "override the printed input filename", "print_file"},
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
+    { "fast_scan", OPT_BOOL, { &do_fast_scan },
+        "list the packets of all the input files as CSV, without probing the streams" },
+    { "fast_scan_threads", OPT_INT | HAS_ARG, { &fast_scan_threads },
+        "set the number of files scanned in parallel by -fast_scan, 0 for auto", "threads" },
     { NULL, },
 };
 
@@ -3648,6 +3886,24 @@ int main(int argc, char **argv)
     SET_DO_SHOW(PROGRAM_STREAM_TAGS, stream_tags);
     SET_DO_SHOW(PACKET_TAGS, packet_tags);
 
+    if (nb_input_filenames > 1 && !do_fast_scan) {
+        av_log(NULL, AV_LOG_ERROR,
+                "Argument '%s' provided as input filename, but '%s' was already specified.\n",
+                input_filenames[1], input_filename);
+        exit_program(1);
+    }
+
+    if (do_fast_scan) {
+        if (!input_filename) {
+            show_usage();
+            av_log(NULL, AV_LOG_ERROR, "You have to specify at least one input file.\n");
+            ret = AVERROR(EINVAL);
+        } else {
+            ret = fast_scan();
+        }
+        goto end;
+    }
+
     if (do_bitexact && (do_show_program_version || do_show_library_versions)) {
         av_log(NULL, AV_LOG_ERROR,
                "-bitexact and -show_program_version or -show_library_versions "
@@ -3729,6 +3985,7 @@ int main(int argc, char **argv)
 end:
     av_freep(&print_format);
     av_freep(&read_intervals);
+    av_freep(&input_filenames);
     av_hash_freep(&hash);
 
     uninit_opts();
@@ -373,6 +373,17 @@ static const AACPCEInfo aac_pce_configs[] = {
 /**
  * AAC encoder context
  */
+/**
+ * per channel element state of the quantizer search, which can be run
+ * for all elements of a frame in parallel
+ */
+typedef struct AACElementJob {
+    int start_ch;                                ///< first channel of the element
+    int bitres_alloc;                            ///< bits psy allocated for each channel
+    int random_state;                            ///< PNS random state for the element
+    int cutoff;                                  ///< psy bandwidth, may be updated by the coder
+} AACElementJob;
+
 typedef struct AACEncContext {
     AVClass *av_class;
     AACEncOptions options;                       ///< encoding options
@@ -418,6 +429,10 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    AACElementJob *elem_jobs;                    ///< per channel element search state
+    struct AACEncContext **thread_ctx;           ///< search contexts of the slice threads
+    int nb_thread_ctx;
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
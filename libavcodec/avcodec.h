@@ -369,6 +369,18 @@ typedef struct RcOverride{
  * Discard cropping information from SPS.
  */
 #define AV_CODEC_FLAG2_IGNORE_CROP    (1 << 16)
+/**
+ * Frame threaded decoding: return each frame as soon as it and all earlier
+ * frames are decoded, instead of after a fixed delay of thread_count - 1
+ * packets. Must be set before avcodec_open2().
+ */
+#define AV_CODEC_FLAG2_LOW_LATENCY    (1 << 17)
+/**
+ * Encoding: allocate the packet payloads from size class buffer pools owned
+ * by the codec context instead of the heap. Packets may hold up to twice the
+ * memory they need. Must be set before avcodec_open2().
+ */
+#define AV_CODEC_FLAG2_POOL_PACKETS   (1 << 18)
 
 /**
  * Show all frames before the first keyframe
@@ -743,7 +755,10 @@ typedef struct AVCodecContext {
      * When multithreading is used, it may be called from multiple threads
      * at the same time; threads might draw different parts of the same AVFrame,
      * or multiple AVFrames, and there is no guarantee that slices will be drawn
-     * in order.
+     * in order. With frame threading, the bands of a frame are drawn by the
+     * thread decoding it as soon as they are final, i.e. before the frame is
+     * returned by the decoder; a consumer can thus start working on the top of
+     * a frame while the rest of it is still being decoded.
      * The function is also used by hardware acceleration APIs.
      * It is called at least once during frame decoding to pass
      * the data needed for hardware render.
@@ -2352,6 +2367,16 @@ typedef struct AVCodecContext {
      * - encoding: set by user
      */
     int export_side_data;
+
+    /**
+     * NUMA node to run the codec threads on and to allocate the frames of
+     * avcodec_default_get_buffer2() from, -1 for no placement.
+     * See av_cpu_numa_bind_thread().
+     *
+     * - decoding: set by user before avcodec_open2()
+     * - encoding: set by user before avcodec_open2()
+     */
+    int numa_node;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
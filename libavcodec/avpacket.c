@@ -100,6 +100,62 @@ int av_new_packet(AVPacket *pkt, int size)
     return 0;
 }
 
+#define PACKET_POOL_MIN_CLASS 10
+#define PACKET_POOL_MAX_CLASS 24
+
+struct FFPacketPool {
+    AVBufferPool *pools[PACKET_POOL_MAX_CLASS - PACKET_POOL_MIN_CLASS + 1];
+};
+
+FFPacketPool *avpriv_packet_pool_alloc(void)
+{
+    FFPacketPool *pool = av_mallocz(sizeof(*pool));
+    int i;
+
+    if (!pool)
+        return NULL;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(pool->pools); i++) {
+        pool->pools[i] = av_buffer_pool_init(1 << (PACKET_POOL_MIN_CLASS + i), NULL);
+        if (!pool->pools[i]) {
+            avpriv_packet_pool_free(&pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void avpriv_packet_pool_free(FFPacketPool **ppool)
+{
+    FFPacketPool *pool = *ppool;
+    int i;
+
+    if (!pool)
+        return;
+
+    /* buffers still held by packets return to their pool and are freed
+     * with it once the last one is released */
+    for (i = 0; i < FF_ARRAY_ELEMS(pool->pools); i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+    av_freep(ppool);
+}
+
+AVBufferRef *avpriv_packet_pool_get(FFPacketPool *pool, int size)
+{
+    int cls;
+
+    if (size < 0 ||
+        size > (1 << PACKET_POOL_MAX_CLASS) - AV_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+
+    size += AV_INPUT_BUFFER_PADDING_SIZE;
+    cls   = size <= 1 << PACKET_POOL_MIN_CLASS ? 0 :
+            av_log2(size - 1) + 1 - PACKET_POOL_MIN_CLASS;
+
+    return av_buffer_pool_get(pool->pools[cls]);
+}
+
 void av_shrink_packet(AVPacket *pkt, int size)
 {
     if (pkt->size <= size)
@@ -37,6 +37,7 @@
 #include "libavutil/internal.h"
 #include "libavutil/intmath.h"
 #include "libavutil/opt.h"
+#include "libavutil/trace_internal.h"
 
 #include "avcodec.h"
 #include "bytestream.h"
@@ -546,14 +547,17 @@ static int decode_simple_receive_frame(AVCodecContext *avctx, AVFrame *frame)
 static int decode_receive_frame_internal(AVCodecContext *avctx, AVFrame *frame)
 {
     AVCodecInternal *avci = avctx->internal;
+    const AVClass *mem_class;
     int ret;
 
     av_assert0(!frame->buf[0]);
 
+    mem_class = ff_codec_set_mem_class(avctx);
     if (avctx->codec->receive_frame)
         ret = avctx->codec->receive_frame(avctx, frame);
     else
         ret = decode_simple_receive_frame(avctx, frame);
+    av_mem_set_class(mem_class);
 
     if (ret == AVERROR_EOF)
         avci->draining_done = 1;
@@ -611,7 +615,12 @@ int attribute_align_arg avcodec_send_packet(AVCodecContext *avctx, const AVPacke
     }
 
     if (!avci->buffer_frame->buf[0]) {
+        avpriv_trace_begin("lavc", "send_packet",
+                           avpkt ? avpkt->pts : AV_NOPTS_VALUE,
+                           avpkt ? avpkt->stream_index : -1);
         ret = decode_receive_frame_internal(avctx, avci->buffer_frame);
+        avpriv_trace_end("lavc", "send_packet",
+                         ret < 0 ? AV_NOPTS_VALUE : avci->buffer_frame->pts, -1);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
             return ret;
     }
@@ -659,7 +668,10 @@ int attribute_align_arg avcodec_receive_frame(AVCodecContext *avctx, AVFrame *fr
     if (avci->buffer_frame->buf[0]) {
         av_frame_move_ref(frame, avci->buffer_frame);
     } else {
+        avpriv_trace_begin("lavc", "receive_frame", AV_NOPTS_VALUE, -1);
         ret = decode_receive_frame_internal(avctx, frame);
+        avpriv_trace_end("lavc", "receive_frame",
+                         ret < 0 ? AV_NOPTS_VALUE : frame->pts, -1);
         if (ret < 0)
             return ret;
     }
@@ -1508,10 +1520,14 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
         for (i = 0; i < 4; i++) {
             pool->linesize[i] = linesize[i];
             if (size[i]) {
-                pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
-                                                     CONFIG_MEMORY_POISONING ?
-                                                        NULL :
-                                                        av_buffer_allocz);
+                if (avctx->numa_node >= 0)
+                    pool->pools[i] = av_buffer_pool_init_numa(size[i] + 16 + STRIDE_ALIGN - 1,
+                                                              avctx->numa_node);
+                else
+                    pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
+                                                         CONFIG_MEMORY_POISONING ?
+                                                            NULL :
+                                                            av_buffer_allocz);
                 if (!pool->pools[i]) {
                     ret = AVERROR(ENOMEM);
                     goto fail;
@@ -1530,7 +1546,9 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
         if (ret < 0)
             goto fail;
 
-        pool->pools[0] = av_buffer_pool_init(pool->linesize[0], NULL);
+        pool->pools[0] = avctx->numa_node >= 0 ?
+                         av_buffer_pool_init_numa(pool->linesize[0], avctx->numa_node) :
+                         av_buffer_pool_init(pool->linesize[0], NULL);
         if (!pool->pools[0]) {
             ret = AVERROR(ENOMEM);
             goto fail;
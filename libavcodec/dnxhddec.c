@@ -725,5 +725,6 @@ AVCodec ff_dnxhd_decoder = {
     .decode         = dnxhd_decode_frame,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
                       AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_FRAME_SLICE_THREADS,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_dnxhd_profiles),
 };
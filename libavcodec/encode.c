@@ -24,11 +24,13 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/trace_internal.h"
 
 #include "avcodec.h"
 #include "encode.h"
 #include "frame_thread_encoder.h"
 #include "internal.h"
+#include "packet_internal.h"
 
 int ff_alloc_packet2(AVCodecContext *avctx, AVPacket *avpkt, int64_t size, int64_t min_size)
 {
@@ -46,6 +48,13 @@ int ff_alloc_packet2(AVCodecContext *avctx, AVPacket *avpkt, int64_t size, int64
         avpkt->size = size;
     }
 
+    if (!avpkt->data && avctx && avctx->internal->packet_pool &&
+        (avpkt->buf = avpriv_packet_pool_get(avctx->internal->packet_pool, size))) {
+        avpkt->data = avpkt->buf->data;
+        avpkt->size = size;
+        memset(avpkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    }
+
     if (!avpkt->data) {
         int ret = av_new_packet(avpkt, size);
         if (ret < 0)
@@ -226,6 +235,7 @@ static int encode_simple_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
 static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt)
 {
     AVCodecInternal *avci = avctx->internal;
+    const AVClass *mem_class;
     int ret;
 
     if (avci->draining_done)
@@ -240,6 +250,7 @@ static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt
             return AVERROR(EINVAL);
     }
 
+    mem_class = ff_codec_set_mem_class(avctx);
     if (avctx->codec->receive_packet) {
         ret = avctx->codec->receive_packet(avctx, avpkt);
         if (!ret)
@@ -248,6 +259,7 @@ static int encode_receive_packet_internal(AVCodecContext *avctx, AVPacket *avpkt
             av_assert0(!avpkt->data || avpkt->buf);
     } else
         ret = encode_simple_receive_packet(avctx, avpkt);
+    av_mem_set_class(mem_class);
 
     if (ret == AVERROR_EOF)
         avci->draining_done = 1;
@@ -325,7 +337,11 @@ int attribute_align_arg avcodec_send_frame(AVCodecContext *avctx, const AVFrame
     }
 
     if (!avci->buffer_pkt->data && !avci->buffer_pkt->side_data) {
+        avpriv_trace_begin("lavc", "send_frame",
+                           frame ? frame->pts : AV_NOPTS_VALUE, -1);
         ret = encode_receive_packet_internal(avctx, avci->buffer_pkt);
+        avpriv_trace_end("lavc", "send_frame",
+                         ret < 0 ? AV_NOPTS_VALUE : avci->buffer_pkt->pts, -1);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
             return ret;
     }
@@ -346,7 +362,10 @@ int attribute_align_arg avcodec_receive_packet(AVCodecContext *avctx, AVPacket *
     if (avci->buffer_pkt->data || avci->buffer_pkt->side_data) {
         av_packet_move_ref(avpkt, avci->buffer_pkt);
     } else {
+        avpriv_trace_begin("lavc", "receive_packet", AV_NOPTS_VALUE, -1);
         ret = encode_receive_packet_internal(avctx, avpkt);
+        avpriv_trace_end("lavc", "receive_packet",
+                         ret < 0 ? AV_NOPTS_VALUE : avpkt->pts, -1);
         if (ret < 0)
             return ret;
     }
@@ -29,8 +29,6 @@
  *
  * For more information on the OpenEXR format, visit:
  *  http://openexr.com/
- *
- * exr_half2float() is credited to Aaftab Munshi, Dan Ginsburg, Dave Shreiner.
  */
 
 #include <float.h>
@@ -94,6 +92,8 @@ enum ExrTileLevelRound {
 typedef struct EXRChannel {
     int xsub, ysub;
     enum ExrPixelType pixel_type;
+    int p_linear;
+    const char *name; /* points into the packet being decoded */
 } EXRChannel;
 
 typedef struct EXRTileAttribute {
@@ -103,6 +103,23 @@ typedef struct EXRTileAttribute {
     enum ExrTileLevelRound level_round;
 } EXRTileAttribute;
 
+typedef struct HufDec {
+    int len;
+    int lit;
+    int p;
+} HufDec;
+
+typedef struct DwaChannel {
+    int scheme;
+    int csc_idx; /* component in a color set, -1 if coded on its own */
+    int offset;  /* byte offset of the channel inside a pixel */
+} DwaChannel;
+
+typedef struct DwaCscSet {
+    int comp[3];  /* R, G and B channel indexes */
+    const char *name;
+} DwaCscSet;
+
 typedef struct EXRThreadData {
     uint8_t *uncompressed_data;
     int uncompressed_size;
@@ -113,6 +130,28 @@ typedef struct EXRThreadData {
     uint8_t *bitmap;
     uint16_t *lut;
 
+    uint64_t *freq;
+    HufDec *hdec;
+    int *hlong;
+    unsigned int hlong_size;
+
+    uint16_t *ac_data;
+    unsigned int ac_size;
+    uint8_t *dc_data;
+    unsigned int dc_size;
+    uint8_t *rle_data;
+    unsigned int rle_size;
+    uint8_t *rle_raw_data;
+    unsigned int rle_raw_size;
+    uint8_t *lo_data;
+    unsigned int lo_size;
+
+    DwaChannel *dwa_channels;
+    unsigned int dwa_channels_size;
+    DwaCscSet *dwa_sets;
+    unsigned int dwa_sets_size;
+    float block[3][64];
+
     int ysize, xsize;
 
     int channel_line_size;
@@ -160,19 +199,9 @@ typedef struct EXRContext {
     enum AVColorTransferCharacteristic apply_trc_type;
     float gamma;
     union av_intfloat32 gamma_table[65536];
-} EXRContext;
 
-/* -15 stored using a single precision bias of 127 */
-#define HALF_FLOAT_MIN_BIASED_EXP_AS_SINGLE_FP_EXP 0x38000000
-
-/* max exponent value in single precision that will be converted
- * to Inf or Nan when stored as a half-float */
-#define HALF_FLOAT_MAX_BIASED_EXP_AS_SINGLE_FP_EXP 0x47800000
-
-/* 255 is the max exponent biased value */
-#define FLOAT_MAX_BIASED_EXP (0xFF << 23)
-
-#define HALF_FLOAT_MAX_BIASED_EXP (0x1F << 10)
+    uint16_t *to_linear; /* DWA nonlinear to linear half float table */
+} EXRContext;
 
 /**
  * Convert a half float as a uint16_t into a full float.
@@ -183,47 +212,63 @@ typedef struct EXRContext {
  */
 static union av_intfloat32 exr_half2float(uint16_t hf)
 {
-    unsigned int sign = (unsigned int) (hf >> 15);
-    unsigned int mantissa = (unsigned int) (hf & ((1 << 10) - 1));
-    unsigned int exp = (unsigned int) (hf & HALF_FLOAT_MAX_BIASED_EXP);
+    /* 2^112, moves the exponent bias from 15 to 127 and scales denormals */
+    static const union av_intfloat32 magic = { (254 - 15) << 23 };
+    unsigned int em = hf & 0x7fff;
     union av_intfloat32 f;
 
-    if (exp == HALF_FLOAT_MAX_BIASED_EXP) {
-        // we have a half-float NaN or Inf
-        // half-float NaNs will be converted to a single precision NaN
-        // half-float Infs will be converted to a single precision Inf
-        exp = FLOAT_MAX_BIASED_EXP;
-        if (mantissa)
-            mantissa = (1 << 23) - 1;    // set all bits to indicate a NaN
-    } else if (exp == 0x0) {
-        // convert half-float zero/denorm to single precision value
-        if (mantissa) {
-            mantissa <<= 1;
-            exp = HALF_FLOAT_MIN_BIASED_EXP_AS_SINGLE_FP_EXP;
-            // check for leading 1 in denorm mantissa
-            while ((mantissa & (1 << 10))) {
-                // for every leading 0, decrement single precision exponent by 1
-                // and shift half-float mantissa value to the left
-                mantissa <<= 1;
-                exp -= (1 << 23);
-            }
-            // clamp the mantissa to 10 bits
-            mantissa &= ((1 << 10) - 1);
-            // shift left to generate single-precision mantissa of 23 bits
-            mantissa <<= 13;
-        }
-    } else {
-        // shift left to generate single-precision mantissa of 23 bits
-        mantissa <<= 13;
-        // generate single precision biased exponent value
-        exp = (exp << 13) + HALF_FLOAT_MIN_BIASED_EXP_AS_SINGLE_FP_EXP;
-    }
-
-    f.i = (sign << 31) | exp | mantissa;
+    f.i  = em << 13;
+    f.f *= magic.f;
+    if (em >= 0x7c00) // Inf stays Inf, NaN gets all mantissa bits set
+        f.i = em == 0x7c00 ? 0x7f800000 : 0x7fffffff;
+    f.i |= (unsigned int)(hf & 0x8000) << 16;
 
     return f;
 }
 
+/**
+ * Convert a float to a half float, rounding to nearest even.
+ *
+ * @param f float bits
+ *
+ * @return half float as uint16_t
+ */
+static uint16_t exr_float2half(uint32_t f)
+{
+    unsigned int sign = (f >> 16) & 0x8000;
+    unsigned int mantissa = f & 0x7fffff;
+    int exp = (int)((f >> 23) & 0xff) - 127 + 15;
+    unsigned int h, rem, half;
+
+    if (exp == 0xff - 127 + 15) { // Inf or NaN
+        if (!mantissa)
+            return sign | 0x7c00;
+        mantissa >>= 13;
+        return sign | 0x7c00 | mantissa | !mantissa;
+    }
+    if (exp >= 31)
+        return sign | 0x7c00;
+    if (exp <= 0) { // denormal or zero
+        int shift = 14 - exp;
+
+        if (shift > 24)
+            return sign;
+        mantissa |= 0x800000;
+        h    = mantissa >> shift;
+        rem  = mantissa & ((1 << shift) - 1);
+        half = 1 << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+            h++;
+        return sign | h;
+    }
+
+    h   = sign | (exp << 10) | (mantissa >> 13);
+    rem = mantissa & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+        h++; // a carry into the exponent gives the correct result, even Inf
+    return h;
+}
+
 static int zip_uncompress(EXRContext *s, const uint8_t *src, int compressed_size,
                           int uncompressed_size, EXRThreadData *td)
 {
@@ -241,10 +286,10 @@ static int zip_uncompress(EXRContext *s, const uint8_t *src, int compressed_size
     return 0;
 }
 
-static int rle_uncompress(EXRContext *ctx, const uint8_t *src, int compressed_size,
-                          int uncompressed_size, EXRThreadData *td)
+static int rle(uint8_t *dst, const uint8_t *src,
+               int compressed_size, int uncompressed_size)
 {
-    uint8_t *d      = td->tmp;
+    uint8_t *d      = dst;
     const int8_t *s = src;
     int ssize       = compressed_size;
     int dsize       = uncompressed_size;
@@ -280,6 +325,16 @@ static int rle_uncompress(EXRContext *ctx, const uint8_t *src, int compressed_si
     if (dend != d)
         return AVERROR_INVALIDDATA;
 
+    return 0;
+}
+
+static int rle_uncompress(EXRContext *ctx, const uint8_t *src, int compressed_size,
+                          int uncompressed_size, EXRThreadData *td)
+{
+    int ret = rle(td->tmp, src, compressed_size, uncompressed_size);
+    if (ret < 0)
+        return ret;
+
     av_assert1(uncompressed_size % 2 == 0);
 
     ctx->dsp.predictor(td->tmp, uncompressed_size);
@@ -321,18 +376,12 @@ static void apply_lut(const uint16_t *lut, uint16_t *dst, int dsize)
 #define HUF_DECSIZE (1 << HUF_DECBITS)        // decoding table size
 #define HUF_DECMASK (HUF_DECSIZE - 1)
 
-typedef struct HufDec {
-    int len;
-    int lit;
-    int *p;
-} HufDec;
-
-static void huf_canonical_code_table(uint64_t *hcode)
+static void huf_canonical_code_table(uint64_t *hcode, int im, int iM)
 {
     uint64_t c, n[59] = { 0 };
     int i;
 
-    for (i = 0; i < HUF_ENCSIZE; ++i)
+    for (i = im; i <= iM; ++i)
         n[hcode[i]] += 1;
 
     c = 0;
@@ -342,7 +391,7 @@ static void huf_canonical_code_table(uint64_t *hcode)
         c    = nc;
     }
 
-    for (i = 0; i < HUF_ENCSIZE; ++i) {
+    for (i = im; i <= iM; ++i) {
         int l = hcode[i];
 
         if (l > 0)
@@ -359,6 +408,7 @@ static int huf_unpack_enc_table(GetByteContext *gb,
                                 int32_t im, int32_t iM, uint64_t *hcode)
 {
     GetBitContext gbit;
+    int first = im;
     int ret = init_get_bits8(&gbit, gb->buffer, bytestream2_get_bytes_left(gb));
     if (ret < 0)
         return ret;
@@ -390,17 +440,22 @@ static int huf_unpack_enc_table(GetByteContext *gb,
     }
 
     bytestream2_skip(gb, (get_bits_count(&gbit) + 7) / 8);
-    huf_canonical_code_table(hcode);
+    huf_canonical_code_table(hcode, first, iM);
 
     return 0;
 }
 
-static int huf_build_dec_table(const uint64_t *hcode, int im,
-                               int iM, HufDec *hdecod)
+static int huf_build_dec_table(EXRThreadData *td, int im, int iM)
 {
-    for (; im <= iM; im++) {
-        uint64_t c = hcode[im] >> 6;
-        int i, l = hcode[im] & 63;
+    const uint64_t *hcode = td->freq;
+    HufDec *hdecod = td->hdec;
+    int i, nb_long = 0;
+
+    memset(hdecod, 0, HUF_DECSIZE * sizeof(*hdecod));
+
+    for (i = im; i <= iM; i++) {
+        uint64_t c = hcode[i] >> 6;
+        int j, l = hcode[i] & 63;
 
         if (c >> l)
             return AVERROR_INVALIDDATA;
@@ -411,38 +466,57 @@ static int huf_build_dec_table(const uint64_t *hcode, int im,
                 return AVERROR_INVALIDDATA;
 
             pl->lit++;
-
-            pl->p = av_realloc(pl->p, pl->lit * sizeof(int));
-            if (!pl->p)
-                return AVERROR(ENOMEM);
-
-            pl->p[pl->lit - 1] = im;
+            nb_long++;
         } else if (l) {
             HufDec *pl = hdecod + (c << (HUF_DECBITS - l));
 
-            for (i = 1 << (HUF_DECBITS - l); i > 0; i--, pl++) {
-                if (pl->len || pl->p)
+            for (j = 1 << (HUF_DECBITS - l); j > 0; j--, pl++) {
+                if (pl->len || pl->lit)
                     return AVERROR_INVALIDDATA;
                 pl->len = l;
-                pl->lit = im;
+                pl->lit = i;
             }
         }
     }
 
+    if (!nb_long)
+        return 0;
+
+    /* Long codes sharing a table prefix are stored contiguously in hlong,
+     * p is the index of the first one. */
+    av_fast_malloc(&td->hlong, &td->hlong_size, nb_long * sizeof(*td->hlong));
+    if (!td->hlong)
+        return AVERROR(ENOMEM);
+
+    nb_long = 0;
+    for (i = 0; i < HUF_DECSIZE; i++) {
+        if (!hdecod[i].len && hdecod[i].lit) {
+            nb_long += hdecod[i].lit;
+            hdecod[i].p = nb_long;
+        }
+    }
+
+    for (i = im; i <= iM; i++) {
+        int l = hcode[i] & 63;
+
+        if (l > HUF_DECBITS)
+            td->hlong[--hdecod[(hcode[i] >> 6) >> (l - HUF_DECBITS)].p] = i;
+    }
+
     return 0;
 }
 
-#define get_char(c, lc, gb)                                                   \
+#define get_char(c, lc, ip, ie)                                               \
 {                                                                             \
-        c   = (c << 8) | bytestream2_get_byte(gb);                            \
+        c   = (c << 8) | (ip < ie ? *ip++ : 0);                               \
         lc += 8;                                                              \
 }
 
-#define get_code(po, rlc, c, lc, gb, out, oe, outb)                           \
+#define get_code(po, rlc, c, lc, ip, ie, out, oe, outb)                       \
 {                                                                             \
         if (po == rlc) {                                                      \
             if (lc < 8)                                                       \
-                get_char(c, lc, gb);                                          \
+                get_char(c, lc, ip, ie);                                      \
             lc -= 8;                                                          \
                                                                               \
             cs = c >> lc;                                                     \
@@ -461,44 +535,57 @@ static int huf_build_dec_table(const uint64_t *hcode, int im,
         }                                                                     \
 }
 
-static int huf_decode(const uint64_t *hcode, const HufDec *hdecod,
-                      GetByteContext *gb, int nbits,
+static int huf_decode(const EXRThreadData *td, GetByteContext *gb, int nbits,
                       int rlc, int no, uint16_t *out)
 {
-    uint64_t c        = 0;
-    uint16_t *outb    = out;
-    uint16_t *oe      = out + no;
-    const uint8_t *ie = gb->buffer + (nbits + 7) / 8; // input byte size
+    const uint64_t *hcode = td->freq;
+    const HufDec *hdecod  = td->hdec;
+    uint64_t c            = 0;
+    uint16_t *outb        = out;
+    uint16_t *oe          = out + no;
+    const uint8_t *ip     = gb->buffer;
+    const uint8_t *ie     = gb->buffer + (nbits + 7) / 8; // input byte size
     uint8_t cs;
     uint16_t s;
     int i, lc = 0;
 
-    while (gb->buffer < ie) {
-        get_char(c, lc, gb);
+    while (ip < ie) {
+        /* refill with as many whole bytes as fit in the accumulator */
+        if (ie - ip >= 8) {
+            int n = (63 - lc) >> 3;
+
+            c   = (c << (8 * n)) | (AV_RB64(ip) >> (64 - 8 * n));
+            ip += n;
+            lc += 8 * n;
+        } else {
+            while (lc <= 56 && ip < ie)
+                get_char(c, lc, ip, ie);
+        }
 
         while (lc >= HUF_DECBITS) {
             const HufDec pl = hdecod[(c >> (lc - HUF_DECBITS)) & HUF_DECMASK];
 
             if (pl.len) {
                 lc -= pl.len;
-                get_code(pl.lit, rlc, c, lc, gb, out, oe, outb);
+                get_code(pl.lit, rlc, c, lc, ip, ie, out, oe, outb);
             } else {
                 int j;
 
-                if (!pl.p)
+                if (!pl.lit)
                     return AVERROR_INVALIDDATA;
 
                 for (j = 0; j < pl.lit; j++) {
-                    int l = hcode[pl.p[j]] & 63;
+                    int sym = td->hlong[pl.p + j];
+                    int l   = hcode[sym] & 63;
 
-                    while (lc < l && bytestream2_get_bytes_left(gb) > 0)
-                        get_char(c, lc, gb);
+                    while (lc < l && ip < ie)
+                        get_char(c, lc, ip, ie);
 
                     if (lc >= l) {
-                        if ((hcode[pl.p[j]] >> 6) ==
+                        if ((hcode[sym] >> 6) ==
                             ((c >> (lc - l)) & ((1LL << l) - 1))) {
                             lc -= l;
-                            get_code(pl.p[j], rlc, c, lc, gb, out, oe, outb);
+                            get_code(sym, rlc, c, lc, ip, ie, out, oe, outb);
                             break;
                         }
                     }
@@ -519,7 +606,7 @@ static int huf_decode(const uint64_t *hcode, const HufDec *hdecod,
 
         if (pl.len && lc >= pl.len) {
             lc -= pl.len;
-            get_code(pl.lit, rlc, c, lc, gb, out, oe, outb);
+            get_code(pl.lit, rlc, c, lc, ip, ie, out, oe, outb);
         } else {
             return AVERROR_INVALIDDATA;
         }
@@ -530,55 +617,39 @@ static int huf_decode(const uint64_t *hcode, const HufDec *hdecod,
     return 0;
 }
 
-static int huf_uncompress(GetByteContext *gb,
+static int huf_uncompress(EXRThreadData *td, GetByteContext *gb,
                           uint16_t *dst, int dst_size)
 {
-    int32_t src_size, im, iM;
+    int32_t im, iM;
     uint32_t nBits;
-    uint64_t *freq;
-    HufDec *hdec;
-    int ret, i;
+    int ret;
 
-    src_size = bytestream2_get_le32(gb);
     im       = bytestream2_get_le32(gb);
     iM       = bytestream2_get_le32(gb);
     bytestream2_skip(gb, 4);
     nBits = bytestream2_get_le32(gb);
     if (im < 0 || im >= HUF_ENCSIZE ||
-        iM < 0 || iM >= HUF_ENCSIZE ||
-        src_size < 0)
+        iM < 0 || iM >= HUF_ENCSIZE)
         return AVERROR_INVALIDDATA;
 
     bytestream2_skip(gb, 4);
 
-    freq = av_mallocz_array(HUF_ENCSIZE, sizeof(*freq));
-    hdec = av_mallocz_array(HUF_DECSIZE, sizeof(*hdec));
-    if (!freq || !hdec) {
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
-    if ((ret = huf_unpack_enc_table(gb, im, iM, freq)) < 0)
-        goto fail;
-
-    if (nBits > 8 * bytestream2_get_bytes_left(gb)) {
-        ret = AVERROR_INVALIDDATA;
-        goto fail;
-    }
-
-    if ((ret = huf_build_dec_table(freq, im, iM, hdec)) < 0)
-        goto fail;
-    ret = huf_decode(freq, hdec, gb, nBits, iM, dst_size, dst);
+    if (!td->freq)
+        td->freq = av_malloc_array(HUF_ENCSIZE, sizeof(*td->freq));
+    if (!td->hdec)
+        td->hdec = av_malloc_array(HUF_DECSIZE, sizeof(*td->hdec));
+    if (!td->freq || !td->hdec)
+        return AVERROR(ENOMEM);
 
-fail:
-    for (i = 0; i < HUF_DECSIZE; i++)
-        if (hdec)
-            av_freep(&hdec[i].p);
+    if ((ret = huf_unpack_enc_table(gb, im, iM, td->freq)) < 0)
+        return ret;
 
-    av_free(freq);
-    av_free(hdec);
+    if (nBits > 8 * bytestream2_get_bytes_left(gb))
+        return AVERROR_INVALIDDATA;
 
-    return ret;
+    if ((ret = huf_build_dec_table(td, im, iM)) < 0)
+        return ret;
+    return huf_decode(td, gb, nBits, iM, dst_size, dst);
 }
 
 static inline void wdec14(uint16_t l, uint16_t h, uint16_t *a, uint16_t *b)
@@ -608,10 +679,9 @@ static inline void wdec16(uint16_t l, uint16_t h, uint16_t *a, uint16_t *b)
     *a = aa;
 }
 
-static void wav_decode(uint16_t *in, int nx, int ox,
-                       int ny, int oy, uint16_t mx)
+static av_always_inline void wav_decode_template(uint16_t *in, int nx, int ox,
+                                                 int ny, int oy, int w14)
 {
-    int w14 = (mx < (1 << 14));
     int n   = (nx > ny) ? ny : nx;
     int p   = 1;
     int p2;
@@ -687,6 +757,16 @@ static void wav_decode(uint16_t *in, int nx, int ox,
     }
 }
 
+static void wav_decode(uint16_t *in, int nx, int ox,
+                       int ny, int oy, uint16_t mx)
+{
+    /* separate versions so the 14 bit check is not done per pixel */
+    if (mx < (1 << 14))
+        wav_decode_template(in, nx, ox, ny, oy, 1);
+    else
+        wav_decode_template(in, nx, ox, ny, oy, 0);
+}
+
 static int piz_uncompress(EXRContext *s, const uint8_t *src, int ssize,
                           int dsize, EXRThreadData *td)
 {
@@ -726,7 +806,10 @@ static int piz_uncompress(EXRContext *s, const uint8_t *src, int ssize,
 
     maxval = reverse_lut(td->bitmap, td->lut);
 
-    ret = huf_uncompress(&gb, tmp, dsize / sizeof(uint16_t));
+    if ((int32_t)bytestream2_get_le32(&gb) < 0)
+        return AVERROR_INVALIDDATA;
+
+    ret = huf_uncompress(td, &gb, tmp, dsize / sizeof(uint16_t));
     if (ret)
         return ret;
 
@@ -957,8 +1040,7 @@ static int b44_uncompress(EXRContext *s, const uint8_t *src, int compressed_size
                         for (x = index_tl_x; x < FFMIN(index_tl_x + 4, td->xsize); x++) {
                             index_out = target_channel_offset * td->xsize + y * td->channel_line_size + 2 * x;
                             index_tmp = (y-index_tl_y) * 4 + (x-index_tl_x);
-                            td->uncompressed_data[index_out] = tmp_buffer[index_tmp] & 0xff;
-                            td->uncompressed_data[index_out + 1] = tmp_buffer[index_tmp] >> 8;
+                            AV_WL16(&td->uncompressed_data[index_out], tmp_buffer[index_tmp]);
                         }
                     }
                 }
@@ -984,6 +1066,470 @@ static int b44_uncompress(EXRContext *s, const uint8_t *src, int compressed_size
     return 0;
 }
 
+enum DwaScheme {
+    DWA_UNKNOWN,
+    DWA_LOSSY_DCT,
+    DWA_RLE,
+    DWA_NB_SCHEMES,
+};
+
+static void dct_inverse(float *block)
+{
+    const float a = .5f * cosf(3.14159f / 4.0f);
+    const float b = .5f * cosf(3.14159f / 16.0f);
+    const float c = .5f * cosf(3.14159f / 8.0f);
+    const float d = .5f * cosf(3.f * 3.14159f / 16.0f);
+    const float e = .5f * cosf(5.f * 3.14159f / 16.0f);
+    const float f = .5f * cosf(3.f * 3.14159f / 8.0f);
+    const float g = .5f * cosf(7.f * 3.14159f / 16.0f);
+    int i, step;
+
+    /* rows first, then columns */
+    for (step = 8; step >= 1; step >>= 3) {
+        int next = step == 8 ? 1 : 8;
+
+        for (i = 0; i < 8; i++) {
+            float *p = block + i * step;
+            float alpha[4], beta[4], theta[4], gamma[4];
+
+            alpha[0] = c * p[2 * next];
+            alpha[1] = f * p[2 * next];
+            alpha[2] = c * p[6 * next];
+            alpha[3] = f * p[6 * next];
+
+            beta[0] = b * p[1 * next] + d * p[3 * next] + e * p[5 * next] + g * p[7 * next];
+            beta[1] = d * p[1 * next] - g * p[3 * next] - b * p[5 * next] - e * p[7 * next];
+            beta[2] = e * p[1 * next] - b * p[3 * next] + g * p[5 * next] + d * p[7 * next];
+            beta[3] = g * p[1 * next] - e * p[3 * next] + d * p[5 * next] - b * p[7 * next];
+
+            theta[0] = a * (p[0] + p[4 * next]);
+            theta[3] = a * (p[0] - p[4 * next]);
+
+            theta[1] = alpha[0] + alpha[3];
+            theta[2] = alpha[1] - alpha[2];
+
+            gamma[0] = theta[0] + theta[1];
+            gamma[1] = theta[3] + theta[2];
+            gamma[2] = theta[3] - theta[2];
+            gamma[3] = theta[0] - theta[1];
+
+            p[0 * next] = gamma[0] + beta[0];
+            p[1 * next] = gamma[1] + beta[1];
+            p[2 * next] = gamma[2] + beta[2];
+            p[3 * next] = gamma[3] + beta[3];
+
+            p[4 * next] = gamma[3] - beta[3];
+            p[5 * next] = gamma[2] - beta[2];
+            p[6 * next] = gamma[1] - beta[1];
+            p[7 * next] = gamma[0] - beta[0];
+        }
+    }
+}
+
+static void csc709_inverse(float block[3][64])
+{
+    int i;
+
+    for (i = 0; i < 64; i++) {
+        float y  = block[0][i];
+        float cb = block[1][i];
+        float cr = block[2][i];
+
+        block[0][i] = y                + 1.5747f * cr;
+        block[1][i] = y - 0.1873f * cb - 0.4682f * cr;
+        block[2][i] = y + 1.8556f * cb;
+    }
+}
+
+static int dwa_unpack_ac(const uint16_t **ac, const uint16_t *ac_end, float *block)
+{
+    const uint16_t *p = *ac;
+    int n = 1;
+
+    while (n < 64) {
+        if (p >= ac_end)
+            return AVERROR_INVALIDDATA;
+
+        if (*p == 0xff00) {            // end of block
+            n = 64;
+        } else if (*p >> 8 == 0xff) {  // run of zeros
+            n += *p & 0xff;
+        } else {
+            block[ff_zigzag_direct[n++]] = exr_half2float(*p).f;
+        }
+        p++;
+    }
+
+    *ac = p;
+    return 0;
+}
+
+static int dwa_decode_lossy(EXRContext *s, EXRThreadData *td, const int *chans,
+                            int nb_comp, const uint16_t **ac, const uint16_t *ac_end,
+                            const uint8_t *dc)
+{
+    const uint16_t *to_linear = s->channels[chans[0]].p_linear ? NULL : s->to_linear;
+    int bw = (td->xsize + 7) >> 3;
+    int bh = (td->ysize + 7) >> 3;
+    int bx, by, c, x, y, ret;
+
+    for (c = 0; c < nb_comp; c++)
+        if (s->channels[chans[c]].pixel_type == EXR_UINT)
+            return AVERROR_INVALIDDATA;
+
+    for (by = 0; by < bh; by++) {
+        int h = FFMIN(8, td->ysize - by * 8);
+
+        for (bx = 0; bx < bw; bx++) {
+            int w = FFMIN(8, td->xsize - bx * 8);
+
+            for (c = 0; c < nb_comp; c++) {
+                float *block = td->block[c];
+
+                memset(block, 0, sizeof(td->block[c]));
+                block[0] = exr_half2float(AV_RL16(dc + 2 * ((c * bh + by) * bw + bx))).f;
+                if ((ret = dwa_unpack_ac(ac, ac_end, block)) < 0)
+                    return ret;
+                dct_inverse(block);
+            }
+
+            if (nb_comp == 3)
+                csc709_inverse(td->block);
+
+            for (c = 0; c < nb_comp; c++) {
+                const EXRChannel *channel = &s->channels[chans[c]];
+                const float *block = td->block[c];
+                uint8_t *out = td->uncompressed_data +
+                               by * 8 * td->channel_line_size +
+                               td->xsize * td->dwa_channels[chans[c]].offset;
+
+                for (y = 0; y < h; y++, out += td->channel_line_size) {
+                    for (x = 0; x < w; x++) {
+                        union av_intfloat32 t = { .f = block[y * 8 + x] };
+                        uint16_t hf = exr_float2half(t.i);
+
+                        if (to_linear)
+                            hf = to_linear[hf];
+                        if (channel->pixel_type == EXR_HALF)
+                            AV_WL16(out + 2 * (bx * 8 + x), hf);
+                        else
+                            AV_WL32(out + 4 * (bx * 8 + x), exr_half2float(hf).i);
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int dwa_prefix_cmp(const char *a, const char *b)
+{
+    const char *da = strrchr(a, '.'), *db = strrchr(b, '.');
+    int la = da ? da - a + 1 : 0;
+    int lb = db ? db - b + 1 : 0;
+    int ret = memcmp(a, b, FFMIN(la, lb));
+
+    return ret ? ret : la - lb;
+}
+
+static int dwa_uncompress(EXRContext *s, const uint8_t *src, int compressed_size,
+                          int uncompressed_size, EXRThreadData *td)
+{
+    int64_t version, lo_usize, lo_size, ac_size, dc_size;
+    int64_t rle_csize, rle_usize, rle_raw_size, ac_count, dc_count, ac_compression;
+    int64_t npixels = (int64_t)td->xsize * td->ysize;
+    int64_t nb_blocks = (int64_t)((td->xsize + 7) >> 3) * ((td->ysize + 7) >> 3);
+    int64_t lo_total = 0, rle_total = 0, dc_total = 0;
+    const uint16_t *ac, *ac_end;
+    const uint8_t *p;
+    GetByteContext gb, rgb;
+    DwaChannel *dch;
+    DwaCscSet *sets;
+    unsigned long dest_len;
+    int i, j, x, y, b, offset, rules_size, nb_sets = 0, ret;
+
+    if (compressed_size <= 88)
+        return AVERROR_INVALIDDATA;
+
+    version        = AV_RL64(src +  0);
+    lo_usize       = AV_RL64(src +  8);
+    lo_size        = AV_RL64(src + 16);
+    ac_size        = AV_RL64(src + 24);
+    dc_size        = AV_RL64(src + 32);
+    rle_csize      = AV_RL64(src + 40);
+    rle_usize      = AV_RL64(src + 48);
+    rle_raw_size   = AV_RL64(src + 56);
+    ac_count       = AV_RL64(src + 64);
+    dc_count       = AV_RL64(src + 72);
+    ac_compression = AV_RL64(src + 80);
+
+    if (version != 2) {
+        avpriv_report_missing_feature(s->avctx, "DWA version %"PRId64, version);
+        return AVERROR_PATCHWELCOME;
+    }
+
+    if (lo_size   < 0 || lo_size   > compressed_size ||
+        ac_size   < 0 || ac_size   > compressed_size ||
+        dc_size   < 0 || dc_size   > compressed_size ||
+        rle_csize < 0 || rle_csize > compressed_size ||
+        lo_usize < 0 || rle_raw_size < 0 || ac_count < 0 || dc_count < 0 ||
+        rle_usize < 0 || rle_usize > 2 * rle_raw_size + 1)
+        return AVERROR_INVALIDDATA;
+
+    bytestream2_init(&gb, src + 88, compressed_size - 88);
+    rules_size = bytestream2_get_le16(&gb);
+    if (rules_size < 2 || rules_size - 2 > bytestream2_get_bytes_left(&gb))
+        return AVERROR_INVALIDDATA;
+    bytestream2_init(&rgb, gb.buffer, rules_size - 2);
+    bytestream2_skip(&gb, rules_size - 2);
+
+    if (lo_size + ac_size + dc_size + rle_csize > bytestream2_get_bytes_left(&gb))
+        return AVERROR_INVALIDDATA;
+
+    av_fast_malloc(&td->dwa_channels, &td->dwa_channels_size,
+                   s->nb_channels * sizeof(*td->dwa_channels));
+    av_fast_malloc(&td->dwa_sets, &td->dwa_sets_size,
+                   s->nb_channels * sizeof(*td->dwa_sets));
+    if (!td->dwa_channels || !td->dwa_sets)
+        return AVERROR(ENOMEM);
+    dch  = td->dwa_channels;
+    sets = td->dwa_sets;
+
+    for (i = 0, offset = 0; i < s->nb_channels; i++) {
+        dch[i].scheme  = DWA_UNKNOWN;
+        dch[i].csc_idx = -1;
+        dch[i].offset  = offset;
+        offset += s->channels[i].pixel_type == EXR_HALF ? 2 : 4;
+    }
+
+    /* Classify the channels, a rule matches the channel name suffix and
+     * pixel type, later rules take precedence. */
+    while (bytestream2_get_bytes_left(&rgb) > 0) {
+        const char *suffix = rgb.buffer;
+        const char *end = memchr(suffix, 0, bytestream2_get_bytes_left(&rgb));
+        int value, type;
+
+        if (!end || end - suffix + 3 > bytestream2_get_bytes_left(&rgb))
+            return AVERROR_INVALIDDATA;
+        bytestream2_skip(&rgb, end - suffix + 1);
+        value = bytestream2_get_byte(&rgb);
+        type  = bytestream2_get_byte(&rgb);
+
+        if ((value >> 2 & 3) >= DWA_NB_SCHEMES || (value >> 4) > 3)
+            return AVERROR_INVALIDDATA;
+
+        for (i = 0; i < s->nb_channels; i++) {
+            const char *name = s->channels[i].name;
+            const char *dot  = strrchr(name, '.');
+
+            name = dot ? dot + 1 : name;
+            if (s->channels[i].pixel_type != type ||
+                (value & 1 ? av_strcasecmp(name, suffix) : strcmp(name, suffix)))
+                continue;
+
+            dch[i].scheme  = value >> 2 & 3;
+            dch[i].csc_idx = (value >> 4) - 1;
+        }
+    }
+
+    /* Group the lossy channels with the same prefix into color sets,
+     * incomplete sets are coded as individual channels. */
+    for (i = 0; i < s->nb_channels; i++) {
+        if (dch[i].scheme != DWA_LOSSY_DCT || dch[i].csc_idx < 0)
+            continue;
+
+        for (j = 0; j < nb_sets; j++)
+            if (!dwa_prefix_cmp(sets[j].name, s->channels[i].name))
+                break;
+        if (j == nb_sets) {
+            sets[nb_sets].comp[0] = sets[nb_sets].comp[1] = sets[nb_sets].comp[2] = -1;
+            sets[nb_sets++].name  = s->channels[i].name;
+        }
+        if (sets[j].comp[dch[i].csc_idx] >= 0)
+            dch[sets[j].comp[dch[i].csc_idx]].csc_idx = -1;
+        sets[j].comp[dch[i].csc_idx] = i;
+    }
+    for (j = 0; j < nb_sets; j++) {
+        if (FFMIN3(sets[j].comp[0], sets[j].comp[1], sets[j].comp[2]) >= 0)
+            continue;
+        for (i = 0; i < 3; i++)
+            if (sets[j].comp[i] >= 0)
+                dch[sets[j].comp[i]].csc_idx = -1;
+        sets[j--] = sets[--nb_sets];
+    }
+
+    for (i = 0; i < s->nb_channels; i++) {
+        int size = s->channels[i].pixel_type == EXR_HALF ? 2 : 4;
+
+        if (dch[i].scheme == DWA_UNKNOWN)
+            lo_total  += npixels * size;
+        else if (dch[i].scheme == DWA_RLE)
+            rle_total += npixels * size;
+        else if (dch[i].csc_idx < 0)
+            dc_total  += nb_blocks;
+    }
+
+    dc_total += nb_sets * 3 * nb_blocks;
+    if (lo_total != lo_usize || rle_total != rle_raw_size ||
+        dc_total != dc_count || ac_count > dc_count * 63)
+        return AVERROR_INVALIDDATA;
+
+    p = gb.buffer;
+
+    if (lo_usize) {
+        av_fast_padded_malloc(&td->lo_data, &td->lo_size, lo_usize);
+        if (!td->lo_data)
+            return AVERROR(ENOMEM);
+        dest_len = lo_usize;
+        if (uncompress(td->lo_data, &dest_len, p, lo_size) != Z_OK ||
+            dest_len != lo_usize)
+            return AVERROR_INVALIDDATA;
+    }
+    p += lo_size;
+
+    if (ac_count) {
+        av_fast_padded_malloc(&td->ac_data, &td->ac_size, ac_count * 2);
+        if (!td->ac_data)
+            return AVERROR(ENOMEM);
+
+        switch (ac_compression) {
+        case 0: {
+            GetByteContext agb;
+
+            bytestream2_init(&agb, p, ac_size);
+            if ((ret = huf_uncompress(td, &agb, td->ac_data, ac_count)) < 0)
+                return ret;
+            break;
+        }
+        case 1:
+            dest_len = ac_count * 2;
+            if (uncompress((uint8_t *)td->ac_data, &dest_len, p, ac_size) != Z_OK ||
+                dest_len != ac_count * 2)
+                return AVERROR_INVALIDDATA;
+#if HAVE_BIGENDIAN
+            s->bbdsp.bswap16_buf(td->ac_data, td->ac_data, ac_count);
+#endif
+            break;
+        default:
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    p += ac_size;
+
+    if (dc_count) {
+        av_fast_padded_malloc(&td->dc_data, &td->dc_size, dc_count * 2);
+        av_fast_padded_malloc(&td->tmp, &td->tmp_size, dc_count * 2);
+        if (!td->dc_data || !td->tmp)
+            return AVERROR(ENOMEM);
+        dest_len = dc_count * 2;
+        if (uncompress(td->tmp, &dest_len, p, dc_size) != Z_OK ||
+            dest_len != dc_count * 2)
+            return AVERROR_INVALIDDATA;
+        s->dsp.predictor(td->tmp, dc_count * 2);
+        s->dsp.reorder_pixels(td->dc_data, td->tmp, dc_count * 2);
+    }
+    p += dc_size;
+
+    if (rle_raw_size) {
+        av_fast_padded_malloc(&td->rle_data, &td->rle_size, rle_usize);
+        av_fast_padded_malloc(&td->rle_raw_data, &td->rle_raw_size, rle_raw_size);
+        if (!td->rle_data || !td->rle_raw_data)
+            return AVERROR(ENOMEM);
+        dest_len = rle_usize;
+        if (uncompress(td->rle_data, &dest_len, p, rle_csize) != Z_OK ||
+            dest_len != rle_usize)
+            return AVERROR_INVALIDDATA;
+        if ((ret = rle(td->rle_raw_data, td->rle_data, rle_usize, rle_raw_size)) < 0)
+            return ret;
+    }
+
+    if (dc_count) {
+        const uint8_t *dc = td->dc_data;
+
+        ac     = td->ac_data;
+        ac_end = ac + ac_count;
+
+        /* color sets are coded first, in prefix order */
+        while (nb_sets) {
+            int set = 0;
+
+            for (j = 1; j < nb_sets; j++)
+                if (dwa_prefix_cmp(sets[j].name, sets[set].name) < 0)
+                    set = j;
+
+            if ((ret = dwa_decode_lossy(s, td, sets[set].comp, 3, &ac, ac_end, dc)) < 0)
+                return ret;
+            dc += nb_blocks * 3 * 2;
+            sets[set] = sets[--nb_sets];
+        }
+
+        for (i = 0; i < s->nb_channels; i++) {
+            if (dch[i].scheme != DWA_LOSSY_DCT || dch[i].csc_idx >= 0)
+                continue;
+            if ((ret = dwa_decode_lossy(s, td, &i, 1, &ac, ac_end, dc)) < 0)
+                return ret;
+            dc += nb_blocks * 2;
+        }
+    }
+
+    p = td->rle_raw_data;
+    for (i = 0; i < s->nb_channels; i++) {
+        int size = s->channels[i].pixel_type == EXR_HALF ? 2 : 4;
+        uint8_t *out = td->uncompressed_data + td->xsize * dch[i].offset;
+
+        if (dch[i].scheme != DWA_RLE)
+            continue;
+
+        /* each byte of the samples is stored in its own plane */
+        for (y = 0; y < td->ysize; y++, out += td->channel_line_size)
+            for (x = 0; x < td->xsize; x++)
+                for (b = 0; b < size; b++)
+                    out[x * size + b] = p[b * npixels + y * td->xsize + x];
+        p += npixels * size;
+    }
+
+    p = td->lo_data;
+    for (i = 0; i < s->nb_channels; i++) {
+        int size = s->channels[i].pixel_type == EXR_HALF ? 2 : 4;
+        uint8_t *out = td->uncompressed_data + td->xsize * dch[i].offset;
+
+        if (dch[i].scheme != DWA_UNKNOWN)
+            continue;
+
+        for (y = 0; y < td->ysize; y++, out += td->channel_line_size) {
+            memcpy(out, p, td->xsize * size);
+            p += td->xsize * size;
+        }
+    }
+
+    return 0;
+}
+
+static av_cold void dwa_init_to_linear(uint16_t *to_linear)
+{
+    const double log_base = pow(2.7182818, 2.2);
+    int i;
+
+    for (i = 0; i < 65536; i++) {
+        float v = exr_half2float(i).f;
+        float sign = v < 0 ? -1.0f : 1.0f;
+        union av_intfloat32 t;
+
+        if ((i & 0x7c00) == 0x7c00) { // map Inf and NaN to 0
+            to_linear[i] = 0;
+            continue;
+        }
+
+        v = fabsf(v);
+        if (v <= 1.0f)
+            t.f = sign * powf(v, 2.2f);
+        else
+            t.f = sign * pow(log_base, v - 1.0f);
+        to_linear[i] = exr_float2half(t.i);
+    }
+}
+
 static int decode_block(AVCodecContext *avctx, void *tdata,
                         int jobnr, int threadnr)
 {
@@ -1113,6 +1659,10 @@ static int decode_block(AVCodecContext *avctx, void *tdata,
         case EXR_B44A:
             ret = b44_uncompress(s, src, data_size, uncompressed_size, td);
             break;
+        case EXR_DWA:
+        case EXR_DWB:
+            ret = dwa_uncompress(s, src, data_size, uncompressed_size, td);
+            break;
         }
         if (ret < 0) {
             av_log(avctx, AV_LOG_ERROR, "decode_block() failed.\n");
@@ -1357,8 +1907,9 @@ static int decode_header(EXRContext *s, AVFrame *frame)
             while (bytestream2_get_bytes_left(&ch_gb) >= 19) {
                 EXRChannel *channel;
                 enum ExrPixelType current_pixel_type;
+                const char *name = ch_gb.buffer;
                 int channel_index = -1;
-                int xsub, ysub;
+                int xsub, ysub, p_linear;
 
                 if (strcmp(s->layer, "") != 0) {
                     if (strncmp(ch_gb.buffer, s->layer, strlen(s->layer)) == 0) {
@@ -1422,7 +1973,8 @@ static int decode_header(EXRContext *s, AVFrame *frame)
                     goto fail;
                 }
 
-                bytestream2_skip(&ch_gb, 4);
+                p_linear = bytestream2_get_byte(&ch_gb);
+                bytestream2_skip(&ch_gb, 3);
                 xsub = bytestream2_get_le32(&ch_gb);
                 ysub = bytestream2_get_le32(&ch_gb);
 
@@ -1463,6 +2015,8 @@ static int decode_header(EXRContext *s, AVFrame *frame)
                 channel->pixel_type = current_pixel_type;
                 channel->xsub       = xsub;
                 channel->ysub       = ysub;
+                channel->p_linear   = p_linear;
+                channel->name       = name;
 
                 if (current_pixel_type == EXR_HALF) {
                     s->current_channel_offset += 2;
@@ -1721,8 +2275,12 @@ static int decode_frame(AVCodecContext *avctx, void *data,
     case EXR_PIZ:
     case EXR_B44:
     case EXR_B44A:
+    case EXR_DWA:
         s->scan_lines_per_block = 32;
         break;
+    case EXR_DWB:
+        s->scan_lines_per_block = 256;
+        break;
     default:
         avpriv_report_missing_feature(avctx, "Compression %d", s->compression);
         return AVERROR_PATCHWELCOME;
@@ -1742,6 +2300,13 @@ static int decode_frame(AVCodecContext *avctx, void *data,
     if ((ret = ff_set_dimensions(avctx, s->w, s->h)) < 0)
         return ret;
 
+    if ((s->compression == EXR_DWA || s->compression == EXR_DWB) && !s->to_linear) {
+        s->to_linear = av_malloc(65536 * sizeof(*s->to_linear));
+        if (!s->to_linear)
+            return AVERROR(ENOMEM);
+        dwa_init_to_linear(s->to_linear);
+    }
+
     s->desc          = av_pix_fmt_desc_get(avctx->pix_fmt);
     if (!s->desc)
         return AVERROR_INVALIDDATA;
@@ -1879,10 +2444,21 @@ static av_cold int decode_end(AVCodecContext *avctx)
         av_freep(&td->tmp);
         av_freep(&td->bitmap);
         av_freep(&td->lut);
+        av_freep(&td->freq);
+        av_freep(&td->hdec);
+        av_freep(&td->hlong);
+        av_freep(&td->ac_data);
+        av_freep(&td->dc_data);
+        av_freep(&td->rle_data);
+        av_freep(&td->rle_raw_data);
+        av_freep(&td->lo_data);
+        av_freep(&td->dwa_channels);
+        av_freep(&td->dwa_sets);
     }
 
     av_freep(&s->thread_data);
     av_freep(&s->channels);
+    av_freep(&s->to_linear);
 
     return 0;
 }
@@ -126,6 +126,17 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* slice threading: blocks are queued into per-thread copies of the
+     * context and encoded in parallel once all of them are filled */
+    struct FlacEncodeContext **thread_ctx;
+    int nb_thread_ctx;
+    int nb_queued;
+    int nb_encoded;
+    int next_out;
+    AVFrame  *job_frame;
+    AVPacket *job_pkt;
+    int job_ret;
 } FlacEncodeContext;
 
 
@@ -236,6 +247,40 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+static av_cold int init_thread_contexts(FlacEncodeContext *s)
+{
+    int i, ret;
+
+    s->thread_ctx = av_mallocz_array(s->avctx->thread_count, sizeof(*s->thread_ctx));
+    if (!s->thread_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->avctx->thread_count; i++) {
+        FlacEncodeContext *t = av_malloc(sizeof(*t));
+        if (!t)
+            return AVERROR(ENOMEM);
+        s->thread_ctx[i] = t;
+        s->nb_thread_ctx++;
+
+        *t = *s;
+        t->thread_ctx  = NULL;
+        t->md5ctx      = NULL;
+        t->md5_buffer  = NULL;
+        t->lpc_ctx.windowed_buffer = NULL;
+        t->job_frame   = av_frame_alloc();
+        t->job_pkt     = av_packet_alloc();
+        if (!t->job_frame || !t->job_pkt)
+            return AVERROR(ENOMEM);
+        ret = ff_lpc_init(&t->lpc_ctx, s->avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -463,6 +508,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     dprint_compression_options(s);
 
+    if (ret >= 0 && avctx->active_thread_type & FF_THREAD_SLICE &&
+        avctx->thread_count > 1)
+        ret = init_thread_contexts(s);
+
     return ret;
 }
 
@@ -1320,10 +1369,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1344,7 +1394,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1356,47 +1406,38 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
-static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
-                             const AVFrame *frame, int *got_packet_ptr)
+/**
+ * Update the stream-wide state with one input block. This has to be done
+ * in input order, the coded frame number is taken from s->frame_count.
+ */
+static int update_stream_state(FlacEncodeContext *s, const AVFrame *frame)
 {
-    FlacEncodeContext *s;
-    int frame_bytes, out_bytes, ret;
-
-    s = avctx->priv_data;
-
-    /* when the last block is reached, update the header in extradata */
-    if (!frame) {
-        s->max_framesize = s->max_encoded_framesize;
-        av_md5_final(s->md5ctx, s->md5sum);
-        write_streaminfo(s, avctx->extradata);
+    int ret;
 
-#if FF_API_SIDEDATA_ONLY_PKT
-FF_DISABLE_DEPRECATION_WARNINGS
-        if (avctx->side_data_only_packets && !s->flushed) {
-FF_ENABLE_DEPRECATION_WARNINGS
-#else
-        if (!s->flushed) {
-#endif
-            uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
-                                                         avctx->extradata_size);
-            if (!side_data)
-                return AVERROR(ENOMEM);
-            memcpy(side_data, avctx->extradata, avctx->extradata_size);
+    s->frame_count++;
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+        av_log(s->avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+    return 0;
+}
 
-            avpkt->pts = s->next_pts;
 
-            *got_packet_ptr = 1;
-            s->flushed = 1;
-        }
-
-        return 0;
-    }
+/**
+ * Encode one block into a packet. Only touches the per-block state of s,
+ * so that blocks can be encoded concurrently in separate contexts.
+ */
+static int encode_block(FlacEncodeContext *s, AVPacket *avpkt,
+                        const AVFrame *frame)
+{
+    int frame_bytes, out_bytes, ret;
 
     /* change max_framesize for small final frame */
     if (frame->nb_samples < s->frame.blocksize) {
         s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
                                                       s->channels,
-                                                      avctx->bits_per_raw_sample);
+                                                      s->avctx->bits_per_raw_sample);
     }
 
     init_frame(s, frame->nb_samples);
@@ -1415,32 +1456,158 @@ FF_ENABLE_DEPRECATION_WARNINGS
         s->frame.verbatim_only = 1;
         frame_bytes = encode_frame(s);
         if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
             return frame_bytes;
         }
     }
 
-    if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
+    if ((ret = ff_alloc_packet2(s->avctx, avpkt, frame_bytes, frame_bytes)) < 0)
         return ret;
 
     out_bytes = write_frame(s, avpkt);
 
-    s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
-        return ret;
-    }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
-
     avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
+    avpkt->duration = ff_samples_to_time_base(s->avctx, frame->nb_samples);
     avpkt->size     = out_bytes;
 
+    return 0;
+}
+
+
+static void update_frame_stats(FlacEncodeContext *s, const AVPacket *avpkt)
+{
+    if (avpkt->size > s->max_encoded_framesize)
+        s->max_encoded_framesize = avpkt->size;
+    if (avpkt->size < s->min_framesize)
+        s->min_framesize = avpkt->size;
+
     s->next_pts = avpkt->pts + avpkt->duration;
+}
+
+
+static int encode_block_thread(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeContext *t = s->thread_ctx[jobnr];
+
+    t->job_ret = encode_block(t, t->job_pkt, t->job_frame);
+    av_frame_unref(t->job_frame);
+    return 0;
+}
+
+
+static int encode_queued_blocks(AVCodecContext *avctx)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int i, ret = 0;
+
+    avctx->execute2(avctx, encode_block_thread, NULL, NULL, s->nb_queued);
+
+    for (i = 0; i < s->nb_queued; i++) {
+        FlacEncodeContext *t = s->thread_ctx[i];
+        if (t->job_ret < 0 && ret >= 0)
+            ret = t->job_ret;
+        if (ret < 0)
+            av_packet_unref(t->job_pkt);
+        else
+            update_frame_stats(s, t->job_pkt);
+    }
+
+    s->nb_encoded = ret < 0 ? 0 : s->nb_queued;
+    s->next_out   = 0;
+    s->nb_queued  = 0;
+    return ret;
+}
+
+
+/**
+ * Queue a block and return the oldest encoded packet, if any. Blocks are
+ * numbered and fed to the MD5 in input order, the encoding itself is
+ * deferred until one block per thread has been queued.
+ */
+static int encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                 const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int ret;
+
+    if (frame) {
+        FlacEncodeContext *t = s->thread_ctx[s->nb_queued];
+
+        if ((ret = av_frame_ref(t->job_frame, frame)) < 0)
+            return ret;
+        t->frame_count = s->frame_count;
+        s->nb_queued++;
+
+        if ((ret = update_stream_state(s, frame)) < 0)
+            return ret;
+    }
+
+    if (s->next_out == s->nb_encoded &&
+        (s->nb_queued == s->nb_thread_ctx || !frame && s->nb_queued)) {
+        if ((ret = encode_queued_blocks(avctx)) < 0)
+            return ret;
+    }
+
+    if (s->next_out < s->nb_encoded) {
+        av_packet_move_ref(avpkt, s->thread_ctx[s->next_out++]->job_pkt);
+        *got_packet_ptr = 1;
+    }
+
+    return 0;
+}
+
+
+static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
+                             const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s;
+    int ret;
+
+    s = avctx->priv_data;
+
+    if (s->thread_ctx) {
+        ret = encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+        if (ret < 0 || *got_packet_ptr || frame)
+            return ret;
+    }
+
+    /* when the last block is reached, update the header in extradata */
+    if (!frame) {
+        s->max_framesize = s->max_encoded_framesize;
+        av_md5_final(s->md5ctx, s->md5sum);
+        write_streaminfo(s, avctx->extradata);
+
+#if FF_API_SIDEDATA_ONLY_PKT
+FF_DISABLE_DEPRECATION_WARNINGS
+        if (avctx->side_data_only_packets && !s->flushed) {
+FF_ENABLE_DEPRECATION_WARNINGS
+#else
+        if (!s->flushed) {
+#endif
+            uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                                         avctx->extradata_size);
+            if (!side_data)
+                return AVERROR(ENOMEM);
+            memcpy(side_data, avctx->extradata, avctx->extradata_size);
+
+            avpkt->pts = s->next_pts;
+
+            *got_packet_ptr = 1;
+            s->flushed = 1;
+        }
+
+        return 0;
+    }
+
+    if ((ret = encode_block(s, avpkt, frame)) < 0)
+        return ret;
+
+    if ((ret = update_stream_state(s, frame)) < 0)
+        return ret;
+
+    update_frame_stats(s, avpkt);
 
     *got_packet_ptr = 1;
     return 0;
@@ -1451,6 +1618,16 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
+
+        for (i = 0; i < s->nb_thread_ctx; i++) {
+            FlacEncodeContext *t = s->thread_ctx[i];
+            ff_lpc_end(&t->lpc_ctx);
+            av_frame_free(&t->job_frame);
+            av_packet_free(&t->job_pkt);
+            av_freep(&s->thread_ctx[i]);
+        }
+        av_freep(&s->thread_ctx);
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
         ff_lpc_end(&s->lpc_ctx);
@@ -1508,7 +1685,9 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
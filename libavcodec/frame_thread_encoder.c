@@ -24,6 +24,7 @@
 
 #include "libavutil/fifo.h"
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
@@ -65,6 +66,9 @@ static void * attribute_align_arg worker(void *v){
     ThreadContext *c = avctx->internal->frame_thread_encoder;
     AVPacket *pkt = NULL;
 
+    if (avctx->numa_node >= 0)
+        av_cpu_numa_bind_thread(avctx->numa_node);
+
     while (!atomic_load(&c->exit)) {
         int got_packet = 0, ret;
         AVFrame *frame;
@@ -163,6 +167,15 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
         }
     }
 
+    // ffv1 frames only depend on each other through the context states,
+    // which are reset on every keyframe; otherwise use slice threads
+    if (avctx->codec_id == AV_CODEC_ID_FFV1 &&
+        (avctx->gop_size > 1 || avctx->flags & AV_CODEC_FLAG_PASS1)) {
+        av_log(avctx, AV_LOG_DEBUG,
+               "Using slice threads for ffv1 encoding with a GOP size above 1 or first pass\n");
+        return 0;
+    }
+
     if(!avctx->thread_count) {
         avctx->thread_count = av_cpu_count();
         avctx->thread_count = FFMIN(avctx->thread_count, MAX_THREADS);
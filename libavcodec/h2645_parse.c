@@ -476,7 +476,11 @@ int ff_h2645_packet_split(H2645Packet *pkt, const uint8_t *buf, int length,
         }
         nal = &pkt->nals[pkt->nb_nals];
 
-        consumed = ff_h2645_extract_rbsp(bc.buffer, extract_length, &pkt->rbsp, nal, small_padding);
+        // Without small_padding, a NAL unit free of escapes can still be
+        // used in place if the rest of the input provides the padding.
+        consumed = ff_h2645_extract_rbsp(bc.buffer, extract_length, &pkt->rbsp, nal,
+                                         small_padding ||
+                                         bytestream2_get_bytes_left(&bc) - extract_length >= padding);
         if (consumed < 0)
             return consumed;
 
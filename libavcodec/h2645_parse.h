@@ -88,6 +88,11 @@ typedef struct H2645Packet {
 
 /**
  * Extract the raw (unescaped) bitstream.
+ *
+ * @param small_padding if set and the NAL unit contains no escapes, point
+ *                      nal->data directly into src instead of copying it;
+ *                      the caller must then guarantee that src is followed
+ *                      by enough readable padding for its bitstream reader
  */
 int ff_h2645_extract_rbsp(const uint8_t *src, int length, H2645RBSP *rbsp,
                           H2645NAL *nal, int small_padding);
@@ -621,6 +621,10 @@ fail:
     return err;
 }
 
+static const CodedBitstreamUnitType decompose_unit_types[] = {
+    H264_NAL_SPS,
+};
+
 static int h264_metadata_init(AVBSFContext *bsf)
 {
     H264MetadataContext *ctx = bsf->priv_data;
@@ -630,6 +634,16 @@ static int h264_metadata_init(AVBSFContext *bsf)
     err = ff_cbs_init(&ctx->input,  AV_CODEC_ID_H264, bsf);
     if (err < 0)
         return err;
+    // Inserting an AUD needs the slice types, and SEI parsing may depend
+    // on the SPS activated by the slices, so only skip decomposing the
+    // rest of the access unit when neither is needed.
+    if (ctx->aud != INSERT && !ctx->sei_user_data && !ctx->delete_filler &&
+        ctx->display_orientation == PASS) {
+        ctx->input->decompose_unit_types    =
+            (CodedBitstreamUnitType*)decompose_unit_types;
+        ctx->input->nb_decompose_unit_types =
+            FF_ARRAY_ELEMS(decompose_unit_types);
+    }
     err = ff_cbs_init(&ctx->output, AV_CODEC_ID_H264, bsf);
     if (err < 0)
         return err;
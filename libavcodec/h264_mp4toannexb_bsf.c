@@ -170,7 +170,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
 {
     H264BSFContext *s = ctx->priv_data;
     AVPacket *in;
-    uint8_t unit_type, new_idr, sps_seen, pps_seen;
+    uint8_t unit_type, new_idr, sps_seen, pps_seen, inserted_ps;
     const uint8_t *buf;
     const uint8_t *buf_end;
     uint8_t *out;
@@ -199,6 +199,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
         sps_seen = s->idr_sps_seen;
         pps_seen = s->idr_pps_seen;
         out_size = 0;
+        inserted_ps = 0;
 
         do {
             uint32_t nal_size = 0;
@@ -231,7 +232,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
                         LOG_ONCE(ctx, AV_LOG_WARNING, "SPS not present in the stream, nor in AVCC, stream may be unreadable\n");
                     } else {
                         count_or_copy(&out, &out_size, s->sps, s->sps_size, -1, j);
-                        sps_seen = 1;
+                        sps_seen = inserted_ps = 1;
                     }
                 }
             }
@@ -244,9 +245,11 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
 
             /* prepend only to the first type 5 NAL unit of an IDR picture, if no sps/pps are already present */
             if (new_idr && unit_type == H264_NAL_IDR_SLICE && !sps_seen && !pps_seen) {
-                if (ctx->par_out->extradata)
+                if (ctx->par_out->extradata) {
                     count_or_copy(&out, &out_size, ctx->par_out->extradata,
                                   ctx->par_out->extradata_size, -1, j);
+                    inserted_ps = 1;
+                }
                 new_idr = 0;
             /* if only SPS has been seen, also insert PPS */
             } else if (new_idr && unit_type == H264_NAL_IDR_SLICE && sps_seen && !pps_seen) {
@@ -254,6 +257,7 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
                     LOG_ONCE(ctx, AV_LOG_WARNING, "PPS not present in the stream, nor in AVCC, stream may be unreadable\n");
                 } else {
                     count_or_copy(&out, &out_size, s->pps, s->pps_size, -1, j);
+                    inserted_ps = 1;
                 }
             }
 
@@ -268,6 +272,22 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
             buf += nal_size;
         } while (buf < buf_end);
 
+        /* Without inserted parameter sets, the output has the size of the
+         * input only if every NAL unit gets a 4 byte start code in place of
+         * a 4 byte length, the lengths are then overwritten in place. */
+        if (!j && !inserted_ps && out_size == in->size && s->length_size == 4 &&
+            in->buf && av_buffer_is_writable(in->buf)) {
+            uint32_t nal_size;
+
+            for (out = in->data; out < buf_end; out += 4 + nal_size) {
+                nal_size = AV_RB32(out);
+                AV_WB32(out, 1);
+            }
+            av_packet_move_ref(opkt, in);
+            ret = 0;
+            goto done;
+        }
+
         if (!j) {
             if (out_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
                 ret = AVERROR_INVALIDDATA;
@@ -283,14 +303,15 @@ static int h264_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *opkt)
 
     av_assert1(out_size == opkt->size);
 
-    s->new_idr      = new_idr;
-    s->idr_sps_seen = sps_seen;
-    s->idr_pps_seen = pps_seen;
-
     ret = av_packet_copy_props(opkt, in);
     if (ret < 0)
         goto fail;
 
+done:
+    s->new_idr      = new_idr;
+    s->idr_sps_seen = sps_seen;
+    s->idr_pps_seen = pps_seen;
+
 fail:
     if (ret < 0)
         av_packet_unref(opkt);
@@ -490,6 +490,12 @@ fail:
     return err;
 }
 
+static const CodedBitstreamUnitType decompose_unit_types[] = {
+    HEVC_NAL_VPS,
+    HEVC_NAL_SPS,
+    HEVC_NAL_PPS,
+};
+
 static int h265_metadata_init(AVBSFContext *bsf)
 {
     H265MetadataContext *ctx = bsf->priv_data;
@@ -499,6 +505,14 @@ static int h265_metadata_init(AVBSFContext *bsf)
     err = ff_cbs_init(&ctx->input,  AV_CODEC_ID_HEVC, bsf);
     if (err < 0)
         return err;
+    // Only the parameter sets are modified; slices are needed to choose
+    // the type of an inserted AUD.
+    if (ctx->aud != INSERT) {
+        ctx->input->decompose_unit_types    =
+            (CodedBitstreamUnitType*)decompose_unit_types;
+        ctx->input->nb_decompose_unit_types =
+            FF_ARRAY_ELEMS(decompose_unit_types);
+    }
     err = ff_cbs_init(&ctx->output, AV_CODEC_ID_HEVC, bsf);
     if (err < 0)
         return err;
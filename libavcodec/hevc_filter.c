@@ -27,6 +27,7 @@
 
 #include "cabac_functions.h"
 #include "hevcdec.h"
+#include "mpegutils.h"
 
 #include "bit_depth_template.c"
 
@@ -468,6 +469,10 @@ static int get_pcm(HEVCContext *s, int x, int y)
     return s->is_pcm[y_pu * s->ps.sps->min_pu_width + x_pu];
 }
 
+/* horizontal_bs/vertical_bs value of a tile edge whose strength is computed
+ * after the picture is decoded */
+#define BS_DEFERRED 3
+
 #define TC_CALC(qp, bs)                                                 \
     tctable[av_clip((qp) + DEFAULT_INTRA_TC_OFFSET * ((bs) - 1) +       \
                     (tc_offset & -2),                                   \
@@ -648,12 +653,12 @@ static void deblocking_filter_CTB(HEVCContext *s, int x0, int y0)
 }
 
 static int boundary_strength(HEVCContext *s, MvField *curr, MvField *neigh,
-                             RefPicList *neigh_refPicList)
+                             RefPicList *refPicList, RefPicList *neigh_refPicList)
 {
     if (curr->pred_flag == PF_BI &&  neigh->pred_flag == PF_BI) {
         // same L0 and L1
-        if (s->ref->refPicList[0].list[curr->ref_idx[0]] == neigh_refPicList[0].list[neigh->ref_idx[0]]  &&
-            s->ref->refPicList[0].list[curr->ref_idx[0]] == s->ref->refPicList[1].list[curr->ref_idx[1]] &&
+        if (refPicList[0].list[curr->ref_idx[0]] == neigh_refPicList[0].list[neigh->ref_idx[0]]  &&
+            refPicList[0].list[curr->ref_idx[0]] == refPicList[1].list[curr->ref_idx[1]] &&
             neigh_refPicList[0].list[neigh->ref_idx[0]] == neigh_refPicList[1].list[neigh->ref_idx[1]]) {
             if ((FFABS(neigh->mv[0].x - curr->mv[0].x) >= 4 || FFABS(neigh->mv[0].y - curr->mv[0].y) >= 4 ||
                  FFABS(neigh->mv[1].x - curr->mv[1].x) >= 4 || FFABS(neigh->mv[1].y - curr->mv[1].y) >= 4) &&
@@ -662,15 +667,15 @@ static int boundary_strength(HEVCContext *s, MvField *curr, MvField *neigh,
                 return 1;
             else
                 return 0;
-        } else if (neigh_refPicList[0].list[neigh->ref_idx[0]] == s->ref->refPicList[0].list[curr->ref_idx[0]] &&
-                   neigh_refPicList[1].list[neigh->ref_idx[1]] == s->ref->refPicList[1].list[curr->ref_idx[1]]) {
+        } else if (neigh_refPicList[0].list[neigh->ref_idx[0]] == refPicList[0].list[curr->ref_idx[0]] &&
+                   neigh_refPicList[1].list[neigh->ref_idx[1]] == refPicList[1].list[curr->ref_idx[1]]) {
             if (FFABS(neigh->mv[0].x - curr->mv[0].x) >= 4 || FFABS(neigh->mv[0].y - curr->mv[0].y) >= 4 ||
                 FFABS(neigh->mv[1].x - curr->mv[1].x) >= 4 || FFABS(neigh->mv[1].y - curr->mv[1].y) >= 4)
                 return 1;
             else
                 return 0;
-        } else if (neigh_refPicList[1].list[neigh->ref_idx[1]] == s->ref->refPicList[0].list[curr->ref_idx[0]] &&
-                   neigh_refPicList[0].list[neigh->ref_idx[0]] == s->ref->refPicList[1].list[curr->ref_idx[1]]) {
+        } else if (neigh_refPicList[1].list[neigh->ref_idx[1]] == refPicList[0].list[curr->ref_idx[0]] &&
+                   neigh_refPicList[0].list[neigh->ref_idx[0]] == refPicList[1].list[curr->ref_idx[1]]) {
             if (FFABS(neigh->mv[1].x - curr->mv[0].x) >= 4 || FFABS(neigh->mv[1].y - curr->mv[0].y) >= 4 ||
                 FFABS(neigh->mv[0].x - curr->mv[1].x) >= 4 || FFABS(neigh->mv[0].y - curr->mv[1].y) >= 4)
                 return 1;
@@ -685,10 +690,10 @@ static int boundary_strength(HEVCContext *s, MvField *curr, MvField *neigh,
 
         if (curr->pred_flag & 1) {
             A     = curr->mv[0];
-            ref_A = s->ref->refPicList[0].list[curr->ref_idx[0]];
+            ref_A = refPicList[0].list[curr->ref_idx[0]];
         } else {
             A     = curr->mv[1];
-            ref_A = s->ref->refPicList[1].list[curr->ref_idx[1]];
+            ref_A = refPicList[1].list[curr->ref_idx[1]];
         }
 
         if (neigh->pred_flag & 1) {
@@ -726,6 +731,15 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
     int i, j, bs;
 
     boundary_upper = y0 > 0 && !(y0 & 7);
+    if (boundary_upper && s->enable_parallel_tiles &&
+        s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+        lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+        (y0 % (1 << s->ps.sps->log2_ctb_size)) == 0) {
+        // the tile above may still be decoding, see ff_hevc_tile_boundary_strengths()
+        for (i = 0; i < (1 << log2_trafo_size); i += 4)
+            s->horizontal_bs[((x0 + i) + y0 * s->bs_width) >> 2] = BS_DEFERRED;
+        boundary_upper = 0;
+    }
     if (boundary_upper &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_UPPER_SLICE &&
@@ -757,13 +771,21 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 else if (curr_cbf_luma || top_cbf_luma)
                     bs = 1;
                 else
-                    bs = boundary_strength(s, curr, top, rpl_top);
+                    bs = boundary_strength(s, curr, top, s->ref->refPicList, rpl_top);
                 s->horizontal_bs[((x0 + i) + y0 * s->bs_width) >> 2] = bs;
             }
     }
 
     // bs for vertical TU boundaries
     boundary_left = x0 > 0 && !(x0 & 7);
+    if (boundary_left && s->enable_parallel_tiles &&
+        s->ps.pps->loop_filter_across_tiles_enabled_flag &&
+        lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+        (x0 % (1 << s->ps.sps->log2_ctb_size)) == 0) {
+        for (i = 0; i < (1 << log2_trafo_size); i += 4)
+            s->vertical_bs[(x0 + (y0 + i) * s->bs_width) >> 2] = BS_DEFERRED;
+        boundary_left = 0;
+    }
     if (boundary_left &&
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_LEFT_SLICE &&
@@ -795,7 +817,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 else if (curr_cbf_luma || left_cbf_luma)
                     bs = 1;
                 else
-                    bs = boundary_strength(s, curr, left, rpl_left);
+                    bs = boundary_strength(s, curr, left, s->ref->refPicList, rpl_left);
                 s->vertical_bs[(x0 + (y0 + i) * s->bs_width) >> 2] = bs;
             }
     }
@@ -813,7 +835,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
                 MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
 
-                bs = boundary_strength(s, curr, top, rpl);
+                bs = boundary_strength(s, curr, top, rpl, rpl);
                 s->horizontal_bs[((x0 + i) + (y0 + j) * s->bs_width) >> 2] = bs;
             }
         }
@@ -828,7 +850,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                 MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
                 MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
 
-                bs = boundary_strength(s, curr, left, rpl);
+                bs = boundary_strength(s, curr, left, rpl, rpl);
                 s->vertical_bs[((x0 + i) + (y0 + j) * s->bs_width) >> 2] = bs;
             }
         }
@@ -839,6 +861,112 @@ void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
 #undef CB
 #undef CR
 
+static int tile_edge_strength(HEVCContext *s, MvField *curr, MvField *neigh,
+                              int curr_cbf_luma, int neigh_cbf_luma,
+                              RefPicList *rpl, RefPicList *neigh_rpl)
+{
+    if (curr->pred_flag == PF_INTRA || neigh->pred_flag == PF_INTRA)
+        return 2;
+    if (curr_cbf_luma || neigh_cbf_luma)
+        return 1;
+    return boundary_strength(s, curr, neigh, rpl, neigh_rpl);
+}
+
+void ff_hevc_tile_boundary_strengths(HEVCContext *s, int x0, int y0)
+{
+    MvField *tab_mvf     = s->ref->tab_mvf;
+    int log2_ctb_size    = s->ps.sps->log2_ctb_size;
+    int log2_min_pu_size = s->ps.sps->log2_min_pu_size;
+    int log2_min_tu_size = s->ps.sps->log2_min_tb_size;
+    int min_pu_width     = s->ps.sps->min_pu_width;
+    int min_tu_width     = s->ps.sps->min_tb_width;
+    int ctb_addr_rs      = (y0 >> log2_ctb_size) * s->ps.sps->ctb_width + (x0 >> log2_ctb_size);
+    int slice_addr       = s->tab_slice_address[ctb_addr_rs];
+    int x_end            = FFMIN(x0 + (1 << log2_ctb_size), s->ps.sps->width);
+    int y_end            = FFMIN(y0 + (1 << log2_ctb_size), s->ps.sps->height);
+    RefPicList *rpl      = slice_addr >= 0 ? ff_hevc_get_ref_list(s, s->ref, x0, y0) : NULL;
+    int i;
+
+    if (y0 > 0) {
+        int neigh_addr = s->tab_slice_address[ctb_addr_rs - s->ps.sps->ctb_width];
+        int filter     = slice_addr >= 0 && neigh_addr >= 0 &&
+                         (neigh_addr == slice_addr || s->filter_slice_edges[ctb_addr_rs]);
+        RefPicList *rpl_top = filter ? ff_hevc_get_ref_list(s, s->ref, x0, y0 - 1) : NULL;
+        int yp_pu = (y0 - 1) >> log2_min_pu_size;
+        int yq_pu =  y0      >> log2_min_pu_size;
+        int yp_tu = (y0 - 1) >> log2_min_tu_size;
+        int yq_tu =  y0      >> log2_min_tu_size;
+
+        for (i = x0; i < x_end; i += 4) {
+            uint8_t *bs = &s->horizontal_bs[(i + y0 * s->bs_width) >> 2];
+            int x_pu    = i >> log2_min_pu_size;
+            int x_tu    = i >> log2_min_tu_size;
+
+            if (*bs != BS_DEFERRED)
+                continue;
+            *bs = filter ? tile_edge_strength(s, &tab_mvf[yq_pu * min_pu_width + x_pu],
+                                              &tab_mvf[yp_pu * min_pu_width + x_pu],
+                                              s->cbf_luma[yq_tu * min_tu_width + x_tu],
+                                              s->cbf_luma[yp_tu * min_tu_width + x_tu],
+                                              rpl, rpl_top) : 0;
+        }
+    }
+
+    if (x0 > 0) {
+        int neigh_addr = s->tab_slice_address[ctb_addr_rs - 1];
+        int filter     = slice_addr >= 0 && neigh_addr >= 0 &&
+                         (neigh_addr == slice_addr || s->filter_slice_edges[ctb_addr_rs]);
+        RefPicList *rpl_left = filter ? ff_hevc_get_ref_list(s, s->ref, x0 - 1, y0) : NULL;
+        int xp_pu = (x0 - 1) >> log2_min_pu_size;
+        int xq_pu =  x0      >> log2_min_pu_size;
+        int xp_tu = (x0 - 1) >> log2_min_tu_size;
+        int xq_tu =  x0      >> log2_min_tu_size;
+
+        for (i = y0; i < y_end; i += 4) {
+            uint8_t *bs = &s->vertical_bs[(x0 + i * s->bs_width) >> 2];
+            int y_pu    = i >> log2_min_pu_size;
+            int y_tu    = i >> log2_min_tu_size;
+
+            if (*bs != BS_DEFERRED)
+                continue;
+            *bs = filter ? tile_edge_strength(s, &tab_mvf[y_pu * min_pu_width + xq_pu],
+                                              &tab_mvf[y_pu * min_pu_width + xp_pu],
+                                              s->cbf_luma[y_tu * min_tu_width + xq_tu],
+                                              s->cbf_luma[y_tu * min_tu_width + xp_tu],
+                                              rpl, rpl_left) : 0;
+        }
+    }
+}
+
+void ff_hevc_draw_horiz_band(HEVCContext *s, int y)
+{
+    AVCodecContext *avctx = s->avctx;
+    const AVFrame *src    = s->ref->frame;
+    int offset[AV_NUM_DATA_POINTERS] = { 0 };
+    int i;
+
+    y = FFMIN(y, s->ps.sps->height);
+    if (!avctx->draw_horiz_band || avctx->hwaccel || s->bands_deferred ||
+        y <= s->band_y)
+        return;
+
+    for (i = 0; i < 3 && src->data[i]; i++)
+        offset[i] = (s->band_y >> s->ps.sps->vshift[i]) * src->linesize[i];
+
+    emms_c();
+
+    avctx->draw_horiz_band(avctx, src, offset, s->band_y, PICT_FRAME, y - s->band_y);
+    s->band_y = y;
+}
+
+/* rows above y are final: let frame threads and draw_horiz_band() use them */
+static void report_rows(HEVCContext *s, int y)
+{
+    if (s->threads_type & FF_THREAD_FRAME && !s->wpp_rows_pooled)
+        ff_thread_report_progress(&s->ref->tf, y, 0);
+    ff_hevc_draw_horiz_band(s, y);
+}
+
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size)
 {
     int x_end = x >= s->ps.sps->width  - ctb_size;
@@ -863,16 +991,14 @@ void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size)
             sao_filter_CTB(s, x - ctb_size, y);
         if (y && x_end) {
             sao_filter_CTB(s, x, y - ctb_size);
-            if (s->threads_type & FF_THREAD_FRAME )
-                ff_thread_report_progress(&s->ref->tf, y, 0);
+            report_rows(s, y);
         }
         if (x_end && y_end) {
             sao_filter_CTB(s, x , y);
-            if (s->threads_type & FF_THREAD_FRAME )
-                ff_thread_report_progress(&s->ref->tf, y + ctb_size, 0);
+            report_rows(s, y + ctb_size);
         }
-    } else if (s->threads_type & FF_THREAD_FRAME && x_end)
-        ff_thread_report_progress(&s->ref->tf, y + ctb_size - 4, 0);
+    } else if (x_end)
+        report_rows(s, y + ctb_size - 4);
 }
 
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size)
@@ -116,6 +116,44 @@ static int hevc_mp4toannexb_init(AVBSFContext *ctx)
     return 0;
 }
 
+/**
+ * Replace the 4 byte NAL unit lengths of a packet without IRAP NAL units by
+ * start codes, in place.
+ *
+ * @return 1 if the packet was rewritten, 0 if it must be copied
+ */
+static int hevc_mp4toannexb_inplace(AVBSFContext *ctx, AVPacket *in)
+{
+    HEVCBSFContext *s = ctx->priv_data;
+    uint8_t *buf = in->data, *buf_end = in->data + in->size;
+    uint32_t nalu_size;
+
+    if (s->length_size != 4 || !in->buf || !av_buffer_is_writable(in->buf))
+        return 0;
+
+    /* the extradata is prepended to IRAP frames, check for them and for
+     * invalid lengths before writing anything */
+    while (buf_end - buf >= 4) {
+        int nalu_type;
+
+        nalu_size = AV_RB32(buf);
+        if (nalu_size < 2 || nalu_size > buf_end - buf - 4)
+            return 0;
+        nalu_type = (buf[4] >> 1) & 0x3f;
+        if (nalu_type >= 16 && nalu_type <= 23)
+            return 0;
+        buf += 4 + nalu_size;
+    }
+    if (buf != buf_end)
+        return 0;
+
+    for (buf = in->data; buf < buf_end; buf += 4 + nalu_size) {
+        nalu_size = AV_RB32(buf);
+        AV_WB32(buf, 1);
+    }
+    return 1;
+}
+
 static int hevc_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *out)
 {
     HEVCBSFContext *s = ctx->priv_data;
@@ -129,7 +167,7 @@ static int hevc_mp4toannexb_filter(AVBSFContext *ctx, AVPacket *out)
     if (ret < 0)
         return ret;
 
-    if (!s->extradata_parsed) {
+    if (!s->extradata_parsed || hevc_mp4toannexb_inplace(ctx, in)) {
         av_packet_move_ref(out, in);
         av_packet_free(&in);
         return 0;
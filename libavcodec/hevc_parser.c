@@ -21,6 +21,7 @@
  */
 
 #include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
 
 #include "golomb.h"
 #include "hevc.h"
@@ -30,6 +31,7 @@
 #include "h2645_parse.h"
 #include "internal.h"
 #include "parser.h"
+#include "startcode.h"
 
 #define START_CODE 0x000001 ///< start_code_prefix_one_3bytes
 
@@ -266,8 +268,26 @@ static int hevc_find_frame_end(AVCodecParserContext *s, const uint8_t *buf,
     int i;
 
     for (i = 0; i < buf_size; i++) {
+        uint64_t last5 = pc->state64 & 0xFFFFFFFFFFULL;
         int nut;
 
+        /* A start code completes at the earliest five bytes after its
+         * first zero byte. If none of the last five bytes is zero, jump
+         * to the next zero byte in the buffer. */
+        if (!((last5 - 0x0101010101ULL) & ~last5 & 0x8080808080ULL)) {
+            int skip = ff_startcode_find_candidate_c(buf + i, buf_size - i);
+
+            if (skip >= 8) {
+                pc->state64 = AV_RB64(buf + i + skip - 8);
+            } else {
+                for (int j = 0; j < skip; j++)
+                    pc->state64 = (pc->state64 << 8) | buf[i + j];
+            }
+            i += skip;
+            if (i >= buf_size)
+                break;
+        }
+
         pc->state64 = (pc->state64 << 8) | buf[i];
 
         if (((pc->state64 >> 3 * 8) & 0xFFFFFF) != START_CODE)
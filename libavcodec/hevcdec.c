@@ -884,13 +884,11 @@ static int hls_slice_header(HEVCContext *s)
                 unsigned val = get_bits_long(gb, offset_len);
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
-            if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
+            // tiles combined with WPP are decoded serially
+            if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1) &&
+                s->ps.pps->entropy_coding_sync_enabled_flag)
                 s->threads_number = 1;
-            } else
-                s->enable_parallel_tiles = 0;
-        } else
-            s->enable_parallel_tiles = 0;
+        }
     }
 
     if (s->ps.pps->slice_header_extension_present_flag) {
@@ -2469,11 +2467,12 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *isFilterThread)
 
         ctb_addr_ts++;
         ff_hevc_save_states(s, ctb_addr_ts);
-        ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
+        if (!s->enable_parallel_tiles)
+            ff_hevc_hls_filters(s, x_ctb, y_ctb, ctb_size);
     }
 
     if (x_ctb + ctb_size >= s->ps.sps->width &&
-        y_ctb + ctb_size >= s->ps.sps->height)
+        y_ctb + ctb_size >= s->ps.sps->height && !s->enable_parallel_tiles)
         ff_hevc_hls_filter(s, x_ctb, y_ctb, ctb_size);
 
     return ctb_addr_ts;
@@ -2487,6 +2486,11 @@ static int hls_slice_data(HEVCContext *s)
     arg[0] = 0;
     arg[1] = 1;
 
+    /* the filters report the frame progress, keep them in the frame thread
+     * rather than on the slice thread pool shared with the other frames */
+    if (s->threads_type & FF_THREAD_FRAME)
+        return hls_decode_entry(s->avctx, arg);
+
     s->avctx->execute(s->avctx, hls_decode_entry, arg, ret , 1, sizeof(int));
     return ret[0];
 }
@@ -2571,6 +2575,101 @@ error:
     return ret;
 }
 
+/**
+ * Decode the tile starting at entry point job of the slice. The loop filter
+ * is left to hevc_filter_tiles(), as the neighbouring tiles may still be
+ * decoding.
+ */
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *input_offset, int job, int self_id)
+{
+    HEVCContext *s1      = avctxt->priv_data;
+    HEVCContext *s       = s1->sList[self_id];
+    HEVCLocalContext *lc = s->HEVClc;
+    const HEVCSPS *sps   = s->ps.sps;
+    const HEVCPPS *pps   = s->ps.pps;
+    int *offset          = input_offset;
+    int ctb_addr_ts      = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int tile_id          = pps->tile_id[ctb_addr_ts] + job;
+    int size             = job ? s->sh.size[job - 1] : offset[1] - offset[0];
+    int more_data        = 1;
+    int ctb_addr_rs, x_ctb, y_ctb, ret;
+
+    if (job) {
+        ctb_addr_ts = pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile_id]];
+    } else if (s->sh.dependent_slice_segment_flag) {
+        int prev_rs = ctb_addr_ts ? pps->ctb_addr_ts_to_rs[ctb_addr_ts - 1] : 0;
+        if (!ctb_addr_ts || s->tab_slice_address[prev_rs] != s->sh.slice_addr) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    ret = init_get_bits8(&lc->gb, s->data + offset[job], size);
+    if (ret < 0)
+        return ret;
+
+    ctb_addr_rs        = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+    x_ctb              = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+    lc->end_of_tiles_x = x_ctb + (pps->column_width[pps->col_idxX[ctb_addr_rs % sps->ctb_width]] << sps->log2_ctb_size);
+    lc->first_qp_group = 1;
+    lc->tu.cu_qp_offset_cb = 0;
+    lc->tu.cu_qp_offset_cr = 0;
+    if (!pps->cu_qp_delta_enabled_flag)
+        lc->qp_y = s->sh.slice_qp;
+
+    while (more_data && ctb_addr_ts < sps->ctb_size &&
+           pps->tile_id[ctb_addr_ts] == tile_id) {
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb       = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb       = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(s, ctb_addr_ts);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(s, x_ctb >> sps->log2_ctb_size, y_ctb >> sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(s, x_ctb, y_ctb, sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    return job == s->sh.num_entry_point_offsets ? ctb_addr_ts : 0;
+error:
+    s->tab_slice_address[ctb_addr_rs] = -1;
+    return ret;
+}
+
+/**
+ * Run the loop filter of a picture whose tiles were decoded in parallel,
+ * in raster order, once all its slices are decoded.
+ */
+static void hevc_filter_tiles(HEVCContext *s)
+{
+    int ctb_size = 1 << s->ps.sps->log2_ctb_size;
+    int x, y;
+
+    for (y = 0; y < s->ps.sps->height; y += ctb_size)
+        for (x = 0; x < s->ps.sps->width; x += ctb_size)
+            ff_hevc_tile_boundary_strengths(s, x, y);
+
+    for (y = 0; y < s->ps.sps->height; y += ctb_size)
+        for (x = 0; x < s->ps.sps->width; x += ctb_size)
+            ff_hevc_hls_filters(s, x, y, ctb_size);
+
+    ff_hevc_hls_filter(s, x - ctb_size, y - ctb_size, ctb_size);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2609,6 +2708,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     offset = (lc->gb.index >> 3);
+    arg[0] = offset;
 
     for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < nal->skipped_bytes; j++) {
         if (nal->skipped_bytes_pos[j] >= offset && nal->skipped_bytes_pos[j] < startheader) {
@@ -2632,6 +2732,13 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
     if (s->sh.num_entry_point_offsets != 0) {
         offset += s->sh.entry_point_offset[s->sh.num_entry_point_offsets - 1] - cmpt;
+        if (s->enable_parallel_tiles &&
+            s->ps.pps->tile_id[s->ps.pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs]] + s->sh.num_entry_point_offsets >=
+            s->ps.pps->num_tile_columns * s->ps.pps->num_tile_rows) {
+            av_log(s->avctx, AV_LOG_ERROR, "Too many entry points for the tiles left\n");
+            res = AVERROR_INVALIDDATA;
+            goto error;
+        }
         if (length < offset) {
             av_log(s->avctx, AV_LOG_ERROR, "entry_point_offset table is corrupted\n");
             res = AVERROR_INVALIDDATA;
@@ -2643,6 +2750,11 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
     s->data = data;
 
+    /* rows may be filtered out of order, so with frame threads the
+     * progress is only reported once the whole frame is decoded */
+    s->wpp_rows_pooled = !!(s->threads_type & FF_THREAD_FRAME);
+    s->bands_deferred  = 1;
+
     for (i = 1; i < s->threads_number; i++) {
         s->sList[i]->HEVClc->first_qp_group = 1;
         s->sList[i]->HEVClc->qp_y = s->sList[0]->HEVClc->qp_y;
@@ -2653,17 +2765,30 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     atomic_store(&s->wpp_err, 0);
     ff_reset_entries(s->avctx);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
-        arg[i] = i;
-        ret[i] = 0;
-    }
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
+            arg[i] = i;
+            ret[i] = 0;
+        }
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else if (s->enable_parallel_tiles) {
+        for (i = 1; i <= s->sh.num_entry_point_offsets; i++)
+            arg[i] = s->sh.offset[i - 1];
+
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, arg, ret, s->sh.num_entry_point_offsets + 1);
+
+        res = ret[s->sh.num_entry_point_offsets];
+        for (i = 0; i < s->sh.num_entry_point_offsets; i++)
+            if (ret[i] < 0)
+                res = ret[i];
+    }
 error:
+    s->wpp_rows_pooled = 0;
+    s->bands_deferred  = 0;
     av_free(ret);
     av_free(arg);
     return res;
@@ -2859,12 +2984,18 @@ static int hevc_frame_start(HEVCContext *s)
 
     s->is_decoded        = 0;
     s->first_nal_type    = s->nal_unit_type;
+    s->band_y            = 0;
 
     s->no_rasl_output_flag = IS_IDR(s) || IS_BLA(s) || (s->nal_unit_type == HEVC_NAL_CRA_NUT && s->last_eos);
 
     if (s->ps.pps->tiles_enabled_flag)
         lc->end_of_tiles_x = s->ps.pps->column_width[0] << s->ps.sps->log2_ctb_size;
 
+    s->enable_parallel_tiles = s->threads_number > 1 && !s->avctx->hwaccel &&
+                               s->ps.pps->tiles_enabled_flag &&
+                               !s->ps.pps->entropy_coding_sync_enabled_flag &&
+                               (s->ps.pps->num_tile_columns > 1 || s->ps.pps->num_tile_rows > 1);
+
     ret = ff_hevc_set_new_ref(s, &s->frame, s->poc);
     if (ret < 0)
         goto fail;
@@ -3143,6 +3274,10 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     }
 
 fail:
+    if (s->ref && s->enable_parallel_tiles)
+        hevc_filter_tiles(s);
+    if (s->ref)
+        ff_hevc_draw_horiz_band(s, INT_MAX);
     if (s->ref && s->threads_type == FF_THREAD_FRAME)
         ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
 
@@ -3610,9 +3745,10 @@ AVCodec ff_hevc_decoder = {
     .flush                 = hevc_decode_flush,
     .update_thread_context = ONLY_IF_THREADS_ENABLED(hevc_update_thread_context),
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                             AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
+                             AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS |
+                             AV_CODEC_CAP_DRAW_HORIZ_BAND,
     .caps_internal         = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_EXPORTS_CROPPING |
-                             FF_CODEC_CAP_ALLOCATE_PROGRESS,
+                             FF_CODEC_CAP_ALLOCATE_PROGRESS | FF_CODEC_CAP_FRAME_SLICE_THREADS,
     .profiles              = NULL_IF_CONFIG_SMALL(ff_hevc_profiles),
     .hw_configs            = (const AVCodecHWConfigInternal*[]) {
 #if CONFIG_HEVC_DXVA2_HWACCEL
@@ -552,8 +552,11 @@ typedef struct HEVCContext {
     uint16_t seq_decode;
     uint16_t seq_output;
 
-    int enable_parallel_tiles;
+    int enable_parallel_tiles; ///< tiles are decoded in parallel, the loop filter runs on the whole picture
     atomic_int wpp_err;
+    int wpp_rows_pooled;       ///< WPP rows run on the slice thread pool, the frame progress is reported at its end
+    int bands_deferred;        ///< rows are filtered out of order, draw_horiz_band() waits for the end of the slice
+    int band_y;                ///< rows of the current frame already passed to draw_horiz_band()
 
     const uint8_t *data;
 
@@ -673,12 +676,19 @@ void ff_hevc_set_qPy(HEVCContext *s, int xBase, int yBase,
                      int log2_cb_size);
 void ff_hevc_deblocking_boundary_strengths(HEVCContext *s, int x0, int y0,
                                            int log2_trafo_size);
+void ff_hevc_tile_boundary_strengths(HEVCContext *s, int x0, int y0);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCContext *s);
 int ff_hevc_cu_chroma_qp_offset_idx(HEVCContext *s);
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y, int ctb_size);
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size);
+
+/**
+ * Pass the rows of the current frame above y, which must be final, to
+ * draw_horiz_band() if they were not passed yet.
+ */
+void ff_hevc_draw_horiz_band(HEVCContext *s, int y);
 void ff_hevc_hls_residual_coding(HEVCContext *s, int x0, int y0,
                                  int log2_trafo_size, enum ScanType scan_idx,
                                  int c_idx);
@@ -29,6 +29,7 @@
 #include "libavutil/buffer.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
 #include "avcodec.h"
 #include "config.h"
@@ -73,6 +74,12 @@
  * uses ff_thread_report/await_progress().
  */
 #define FF_CODEC_CAP_ALLOCATE_PROGRESS      (1 << 6)
+/**
+ * The decoder's execute()/execute2() jobs only touch the frame being
+ * decoded, so with both frame and slice threading requested its frame
+ * threads may run them on a slice thread pool shared between them.
+ */
+#define FF_CODEC_CAP_FRAME_SLICE_THREADS    (1 << 7)
 
 /**
  * AVCodec.codec_tags termination value
@@ -137,6 +144,12 @@ typedef struct AVCodecInternal {
 
     void *thread_ctx;
 
+    /**
+     * Slice threading context. With frame and slice threading combined,
+     * every frame thread has its own, all sharing the same pool of workers.
+     */
+    void *slice_thread_ctx;
+
     DecodeSimpleContext ds;
     AVBSFContext *bsf;
 
@@ -152,6 +165,11 @@ typedef struct AVCodecInternal {
     uint8_t *byte_buffer;
     unsigned int byte_buffer_size;
 
+    /**
+     * pools for the encoded packets, with AV_CODEC_FLAG2_POOL_PACKETS
+     */
+    struct FFPacketPool *packet_pool;
+
     void *frame_thread_encoder;
 
     EncodeSimpleContext es;
@@ -267,6 +285,17 @@ static av_always_inline int64_t ff_samples_to_time_base(AVCodecContext *avctx,
                         avctx->time_base);
 }
 
+/**
+ * Attribute the allocations of the calling thread to the codec of avctx.
+ * @return the previous class, to be restored with av_mem_set_class()
+ */
+static inline const AVClass *ff_codec_set_mem_class(AVCodecContext *avctx)
+{
+    const AVCodec *codec = avctx->codec;
+    return av_mem_set_class(codec->priv_class ? codec->priv_class
+                                              : avctx->av_class);
+}
+
 /**
  * 2^(x) for integer x
  * @return correctly rounded float
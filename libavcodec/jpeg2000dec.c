@@ -126,6 +126,9 @@ typedef struct Jpeg2000DecoderContext {
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    struct Jpeg2000CblkJob *cblk_jobs; ///< code-blocks of the current tile, for slice threading
+    unsigned int     cblk_jobs_size;
+
     /*options parameters*/
     int             reduction_factor;
 } Jpeg2000DecoderContext;
@@ -1856,6 +1859,98 @@ static inline void roi_scale_cblk(Jpeg2000Cblk *cblk,
     }
 }
 
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component   *comp;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000Band        *band;
+    Jpeg2000Cblk        *cblk;
+    int                  bandpos;
+} Jpeg2000CblkJob;
+
+/* Decode one code-block and dequantize it into the component buffer.
+ * Returns 0 if the code-block has no coded data. */
+static int decode_cblk_dequantize(Jpeg2000DecoderContext *s,
+                                  const Jpeg2000CblkJob *job,
+                                  Jpeg2000T1Context *t1)
+{
+    Jpeg2000Component *comp     = job->comp;
+    Jpeg2000CodingStyle *codsty = job->codsty;
+    Jpeg2000Band *band          = job->band;
+    Jpeg2000Cblk *cblk          = job->cblk;
+    int x, y;
+    int ret = decode_cblk(s, codsty, t1, cblk,
+                          cblk->coord[0][1] - cblk->coord[0][0],
+                          cblk->coord[1][1] - cblk->coord[1][0],
+                          job->bandpos, comp->roi_shift);
+    if (!ret)
+        return 0;
+    x = cblk->coord[0][0] - band->coord[0][0];
+    y = cblk->coord[1][0] - band->coord[1][0];
+
+    if (comp->roi_shift)
+        roi_scale_cblk(cblk, comp, t1);
+    if (codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, comp, t1, band);
+    else if (codsty->transform == FF_DWT97_INT)
+        dequantization_int_97(x, y, cblk, comp, t1, band);
+    else
+        dequantization_int(x, y, cblk, comp, t1, band);
+    return 1;
+}
+
+/**
+ * List the code-blocks of one tile component, or only count them when
+ * jobs is NULL.
+ * @param coded set if any code-block carries data
+ * @return number of code-blocks
+ */
+static int tile_component_cblks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                                int compno, Jpeg2000CblkJob *jobs, int *coded)
+{
+    Jpeg2000Component *comp     = tile->comp + compno;
+    Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+    int reslevelno, bandno, nb_jobs = 0;
+
+    /* Loop on resolution levels */
+    for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
+        Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+        /* Loop on bands */
+        for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+            int nb_precincts, precno;
+            Jpeg2000Band *band = rlevel->band + bandno;
+            int cblkno = 0, bandpos;
+
+            bandpos = bandno + (reslevelno > 0);
+
+            if (band->coord[0][0] == band->coord[0][1] ||
+                band->coord[1][0] == band->coord[1][1])
+                continue;
+
+            nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
+            /* Loop on precincts */
+            for (precno = 0; precno < nb_precincts; precno++) {
+                Jpeg2000Prec *prec = band->prec + precno;
+
+                /* Loop on codeblocks */
+                for (cblkno = 0;
+                     cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+                     cblkno++, nb_jobs++) {
+                    Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+
+                    if (cblk->length)
+                        *coded = 1;
+                    if (jobs)
+                        jobs[nb_jobs] = (Jpeg2000CblkJob) {
+                            comp, codsty, band, cblk, bandpos
+                        };
+                } /* end cblk */
+            } /*end prec */
+        } /* end band */
+    } /* end reslevel */
+
+    return nb_jobs;
+}
+
 static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
 {
     Jpeg2000T1Context t1;
@@ -1894,27 +1989,11 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
                     for (cblkno = 0;
                          cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
                          cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        int ret = decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos, comp->roi_shift);
-                        if (ret)
+                        Jpeg2000CblkJob job = {
+                            comp, codsty, band, prec->cblk + cblkno, bandpos
+                        };
+                        if (decode_cblk_dequantize(s, &job, &t1))
                             coded = 1;
-                        else
-                            continue;
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (comp->roi_shift)
-                            roi_scale_cblk(cblk, comp, &t1);
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
                    } /* end cblk */
                 } /*end prec */
             } /* end band */
@@ -1927,6 +2006,59 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
     } /*end comp */
 }
 
+static int decode_cblk_job(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    const Jpeg2000CblkJob *job = s->cblk_jobs + jobnr;
+    Jpeg2000T1Context t1;
+
+    t1.stride = (1 << job->codsty->log2_cblk_width) + 2;
+    decode_cblk_dequantize(s, job, &t1);
+    return 0;
+}
+
+static int dwt_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000Tile *tile = arg;
+    Jpeg2000Component *comp     = tile->comp + jobnr;
+    Jpeg2000CodingStyle *codsty = tile->codsty + jobnr;
+    int coded = 0;
+
+    tile_component_cblks(s, tile, jobnr, NULL, &coded);
+    if (coded)
+        ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
+    return 0;
+}
+
+/**
+ * Code-block level parallel version of tile_codeblocks(), for frames with
+ * fewer tiles than threads: all code-blocks of the tile are decoded as
+ * separate jobs, then the components are inverse transformed in parallel.
+ */
+static int tile_codeblocks_threaded(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
+{
+    int compno, nb_jobs = 0, coded = 0;
+
+    for (compno = 0; compno < s->ncomponents; compno++)
+        nb_jobs += tile_component_cblks(s, tile, compno, NULL, &coded);
+
+    av_fast_malloc(&s->cblk_jobs, &s->cblk_jobs_size,
+                   nb_jobs * sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs)
+        return AVERROR(ENOMEM);
+
+    for (compno = 0, nb_jobs = 0; compno < s->ncomponents; compno++)
+        nb_jobs += tile_component_cblks(s, tile, compno,
+                                        s->cblk_jobs + nb_jobs, &coded);
+
+    s->avctx->execute2(s->avctx, decode_cblk_job, NULL, NULL, nb_jobs);
+    s->avctx->execute2(s->avctx, dwt_job, tile, NULL, s->ncomponents);
+
+    return 0;
+}
+
 #define WRITE_FRAME(D, PIXEL)                                                                     \
     static inline void write_frame_ ## D(Jpeg2000DecoderContext * s, Jpeg2000Tile * tile,         \
                                          AVFrame * picture, int precision)                        \
@@ -1994,16 +2126,11 @@ WRITE_FRAME(16, uint16_t)
 
 #undef WRITE_FRAME
 
-static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
-                                int jobnr, int threadnr)
+static void tile_output(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                        AVFrame *picture)
 {
-    Jpeg2000DecoderContext *s = avctx->priv_data;
-    AVFrame *picture = td;
-    Jpeg2000Tile *tile = s->tile + jobnr;
     int x;
 
-    tile_codeblocks(s, tile);
-
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
@@ -2029,6 +2156,17 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
 
         write_frame_16(s, tile, picture, precision);
     }
+}
+
+static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
+                                int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    AVFrame *picture = td;
+    Jpeg2000Tile *tile = s->tile + jobnr;
+
+    tile_codeblocks(s, tile);
+    tile_output(s, tile, picture);
 
     return 0;
 }
@@ -2380,7 +2518,7 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     Jpeg2000DecoderContext *s = avctx->priv_data;
     ThreadFrame frame = { .f = data };
     AVFrame *picture = data;
-    int ret;
+    int ret, tileno;
 
     s->avctx     = avctx;
     bytestream2_init(&s->g, avpkt->data, avpkt->size);
@@ -2427,7 +2565,18 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
 
-    avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
+    if (avctx->active_thread_type & FF_THREAD_SLICE &&
+        s->numXtiles * s->numYtiles < avctx->thread_count) {
+        /* too few tiles to keep the threads busy, split the tiles instead */
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+            Jpeg2000Tile *tile = s->tile + tileno;
+            if (tile_codeblocks_threaded(s, tile) < 0)
+                tile_codeblocks(s, tile);
+            tile_output(s, tile, picture);
+        }
+    } else {
+        avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
+    }
 
     jpeg2000_dec_cleanup(s);
 
@@ -2446,6 +2595,15 @@ end:
     return ret;
 }
 
+static av_cold int jpeg2000_decode_close(AVCodecContext *avctx)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    av_freep(&s->cblk_jobs);
+    s->cblk_jobs_size = 0;
+    return 0;
+}
+
 #define OFFSET(x) offsetof(Jpeg2000DecoderContext, x)
 #define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
 
@@ -2471,7 +2629,9 @@ AVCodec ff_jpeg2000_decoder = {
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init             = jpeg2000_decode_init,
     .decode           = jpeg2000_decode_frame,
+    .close            = jpeg2000_decode_close,
     .priv_class       = &jpeg2000_class,
     .max_lowres       = 5,
-    .profiles         = NULL_IF_CONFIG_SMALL(ff_jpeg2000_profiles)
+    .profiles         = NULL_IF_CONFIG_SMALL(ff_jpeg2000_profiles),
+    .caps_internal    = FF_CODEC_CAP_FRAME_SLICE_THREADS,
 };
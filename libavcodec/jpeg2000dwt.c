@@ -48,6 +48,9 @@
 #define I_LFTG_X       53274ll
 #define I_PRESHIFT 8
 
+/* number of columns transformed together by the vertical inverse passes */
+#define DWT_STRIP 16
+
 static inline void extend53(int *p, int i0, int i1)
 {
     p[i0 - 1] = p[i0 + 1];
@@ -76,6 +79,23 @@ static inline void extend97_int(int32_t *p, int i0, int i1)
     }
 }
 
+/* The vertical inverse passes work on strips of DWT_STRIP columns stored
+ * row by row, p[i * DWT_STRIP + c]. Each lifting step then runs over
+ * contiguous memory and vectorizes, while the arithmetic per column is the
+ * same as in the 1D functions. */
+#define ROW(p, i) ((p) + (i) * DWT_STRIP)
+
+static inline void extend_strip(void *p, int i0, int i1, int nb_ext, int n)
+{
+    int32_t *q = p;
+    int i;
+
+    for (i = 1; i <= nb_ext; i++) {
+        memcpy(ROW(q, i0 - i),     ROW(q, i0 + i),     n * sizeof(*q));
+        memcpy(ROW(q, i1 + i - 1), ROW(q, i1 - i - 1), n * sizeof(*q));
+    }
+}
+
 static void sd_1d53(int *p, int i0, int i1)
 {
     int i;
@@ -323,11 +343,37 @@ static void sr_1d53(unsigned *p, int i0, int i1)
         p[2 * i + 1] += (int)(p[2 * i] + p[2 * i + 2]) >> 1;
 }
 
+static void sr_strip53(unsigned *p, int i0, int i1, int n)
+{
+    int i, k;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (k = 0; k < n; k++)
+                ROW(p, 1)[k] = (int)ROW(p, 1)[k] >> 1;
+        return;
+    }
+
+    extend_strip(p, i0, i1, 2, n);
+
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        unsigned *d = ROW(p, 2 * i), *a = ROW(p, 2 * i - 1), *b = ROW(p, 2 * i + 1);
+        for (k = 0; k < n; k++)
+            d[k] -= (int)(a[k] + b[k] + 2) >> 2;
+    }
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        unsigned *d = ROW(p, 2 * i + 1), *a = ROW(p, 2 * i), *b = ROW(p, 2 * i + 2);
+        for (k = 0; k < n; k++)
+            d[k] += (int)(a[k] + b[k]) >> 1;
+    }
+}
+
 static void dwt_decode53(DWTContext *s, int *t)
 {
     int lev;
     int w     = s->linelen[s->ndeclevels - 1][0];
-    int32_t *line = s->i_linebuf;
+    int32_t *line  = s->i_linebuf;
+    int32_t *strip = s->i_linebuf + 3 * DWT_STRIP;
     line += 3;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
@@ -355,19 +401,19 @@ static void dwt_decode53(DWTContext *s, int *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = strip + mv * DWT_STRIP;
+        for (lp = 0; lp < lh; lp += DWT_STRIP) {
+            int i, j = 0, n = FFMIN(DWT_STRIP, lh - lp);
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
+                memcpy(ROW(l, i), t + w * j + lp, n * sizeof(*t));
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
+                memcpy(ROW(l, i), t + w * j + lp, n * sizeof(*t));
 
-            sr_1d53(line, mv, mv + lv);
+            sr_strip53(strip, mv, mv + lv, n);
 
             for (i = 0; i < lv; i++)
-                t[w * i + lp] = l[i];
+                memcpy(t + w * i + lp, ROW(l, i), n * sizeof(*t));
         }
     }
 }
@@ -399,11 +445,53 @@ static void sr_1d97_float(float *p, int i0, int i1)
         p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
 }
 
+static void sr_strip97_float(float *p, int i0, int i1, int n)
+{
+    int i, k;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (k = 0; k < n; k++)
+                ROW(p, 1)[k] *= F_LFTG_K/2;
+        else
+            for (k = 0; k < n; k++)
+                ROW(p, 0)[k] *= F_LFTG_X;
+        return;
+    }
+
+    extend_strip(p, i0, i1, 4, n);
+
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        float *d = ROW(p, 2 * i), *a = ROW(p, 2 * i - 1), *b = ROW(p, 2 * i + 1);
+        for (k = 0; k < n; k++)
+            d[k] -= F_LFTG_DELTA * (a[k] + b[k]);
+    }
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        float *d = ROW(p, 2 * i + 1), *a = ROW(p, 2 * i), *b = ROW(p, 2 * i + 2);
+        for (k = 0; k < n; k++)
+            d[k] -= F_LFTG_GAMMA * (a[k] + b[k]);
+    }
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        float *d = ROW(p, 2 * i), *a = ROW(p, 2 * i - 1), *b = ROW(p, 2 * i + 1);
+        for (k = 0; k < n; k++)
+            d[k] += F_LFTG_BETA * (a[k] + b[k]);
+    }
+    /* step 6 */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        float *d = ROW(p, 2 * i + 1), *a = ROW(p, 2 * i), *b = ROW(p, 2 * i + 2);
+        for (k = 0; k < n; k++)
+            d[k] += F_LFTG_ALPHA * (a[k] + b[k]);
+    }
+}
+
 static void dwt_decode97_float(DWTContext *s, float *t)
 {
     int lev;
     int w       = s->linelen[s->ndeclevels - 1][0];
-    float *line = s->f_linebuf;
+    float *line  = s->f_linebuf;
+    float *strip = s->f_linebuf + 5 * DWT_STRIP;
     float *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
     line += 5;
@@ -432,19 +520,19 @@ static void dwt_decode97_float(DWTContext *s, float *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = strip + mv * DWT_STRIP;
+        for (lp = 0; lp < lh; lp += DWT_STRIP) {
+            int i, j = 0, n = FFMIN(DWT_STRIP, lh - lp);
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), data + w * j + lp, n * sizeof(*data));
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), data + w * j + lp, n * sizeof(*data));
 
-            sr_1d97_float(line, mv, mv + lv);
+            sr_strip97_float(strip, mv, mv + lv, n);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                memcpy(data + w * i + lp, ROW(l, i), n * sizeof(*data));
         }
     }
 }
@@ -476,13 +564,55 @@ static void sr_1d97_int(int32_t *p, int i0, int i1)
         p[2 * i + 1] += (I_LFTG_ALPHA * (p[2 * i]     + (int64_t)p[2 * i + 2]) + (1 << 15)) >> 16;
 }
 
+static void sr_strip97_int(int32_t *p, int i0, int i1, int n)
+{
+    int i, k;
+
+    if (i1 <= i0 + 1) {
+        if (i0 == 1)
+            for (k = 0; k < n; k++)
+                ROW(p, 1)[k] = (ROW(p, 1)[k] * I_LFTG_K + (1<<16)) >> 17;
+        else
+            for (k = 0; k < n; k++)
+                ROW(p, 0)[k] = (ROW(p, 0)[k] * I_LFTG_X + (1<<15)) >> 16;
+        return;
+    }
+
+    extend_strip(p, i0, i1, 4, n);
+
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        int32_t *d = ROW(p, 2 * i), *a = ROW(p, 2 * i - 1), *b = ROW(p, 2 * i + 1);
+        for (k = 0; k < n; k++)
+            d[k] -= (I_LFTG_DELTA * (a[k] + (int64_t)b[k]) + (1 << 15)) >> 16;
+    }
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        int32_t *d = ROW(p, 2 * i + 1), *a = ROW(p, 2 * i), *b = ROW(p, 2 * i + 2);
+        for (k = 0; k < n; k++)
+            d[k] -= (I_LFTG_GAMMA * (a[k] + (int64_t)b[k]) + (1 << 15)) >> 16;
+    }
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        int32_t *d = ROW(p, 2 * i), *a = ROW(p, 2 * i - 1), *b = ROW(p, 2 * i + 1);
+        for (k = 0; k < n; k++)
+            d[k] += (I_LFTG_BETA * (a[k] + (int64_t)b[k]) + (1 << 15)) >> 16;
+    }
+    /* step 6 */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        int32_t *d = ROW(p, 2 * i + 1), *a = ROW(p, 2 * i), *b = ROW(p, 2 * i + 2);
+        for (k = 0; k < n; k++)
+            d[k] += (I_LFTG_ALPHA * (a[k] + (int64_t)b[k]) + (1 << 15)) >> 16;
+    }
+}
+
 static void dwt_decode97_int(DWTContext *s, int32_t *t)
 {
     int lev;
     int w       = s->linelen[s->ndeclevels - 1][0];
     int h       = s->linelen[s->ndeclevels - 1][1];
     int i;
-    int32_t *line = s->i_linebuf;
+    int32_t *line  = s->i_linebuf;
+    int32_t *strip = s->i_linebuf + 5 * DWT_STRIP;
     int32_t *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
     line += 5;
@@ -514,19 +644,20 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = strip + mv * DWT_STRIP;
+        for (lp = 0; lp < lh; lp += DWT_STRIP) {
+            int i, j = 0, k, n = FFMIN(DWT_STRIP, lh - lp);
             // rescale with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = ((data[w * j + lp] * I_LFTG_K) + (1 << 15)) >> 16;
+                for (k = 0; k < n; k++)
+                    ROW(l, i)[k] = ((data[w * j + lp + k] * I_LFTG_K) + (1 << 15)) >> 16;
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), data + w * j + lp, n * sizeof(*data));
 
-            sr_1d97_int(line, mv, mv + lv);
+            sr_strip97_int(strip, mv, mv + lv, n);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                memcpy(data + w * i + lp, ROW(l, i), n * sizeof(*data));
         }
     }
 
@@ -558,17 +689,17 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
         }
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_malloc_array((maxlen + 12) * DWT_STRIP, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
      case FF_DWT97_INT:
-        s->i_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen + 12) * DWT_STRIP, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     case FF_DWT53:
-        s->i_linebuf = av_malloc_array((maxlen +  6), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen +  6) * DWT_STRIP, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
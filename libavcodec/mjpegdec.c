@@ -775,10 +775,11 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -787,47 +788,48 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
+    val = val * (unsigned)quant_matrix[0] + last_dc[component];
     val = av_clip_int16(val);
-    s->last_dc[component] = val;
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -837,7 +839,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[i];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -848,7 +850,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -1138,7 +1140,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
                 topleft[i] = top[i];
                 top[i]     = buffer[mb_x][i];
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1270,7 +1272,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1341,7 +1343,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1410,17 +1412,184 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+typedef struct MJpegScan {
+    int nb_components;
+    int Ah, Al;
+    uint8_t *data[MAX_COMPONENTS];
+    const uint8_t *reference_data[MAX_COMPONENTS];
+    int linesize[MAX_COMPONENTS];
+    int chroma_width, chroma_height;
+    int bytes_per_pixel;
+
+    /* slice threading: one job per restart interval */
+    int nb_mcus;
+    const int *segment_start;   ///< byte offset of each interval in the scan
+    GetBitContext end_gb;       ///< reader state after the last interval
+} MJpegScan;
+
+static int decode_mcu(MJpegDecodeContext *s, const MJpegScan *scan,
+                      GetBitContext *gb, int *last_dc, int16_t *block,
+                      int mb_x, int mb_y, int copy_mb)
+{
+    int i;
+
+    for (i = 0; i < scan->nb_components; i++) {
+        uint8_t *ptr;
+        int n, h, v, x, y, c, j;
+        int block_offset;
+        n = s->nb_blocks[i];
+        c = s->comp_index[i];
+        h = s->h_scount[i];
+        v = s->v_scount[i];
+        x = 0;
+        y = 0;
+        for (j = 0; j < n; j++) {
+            block_offset = (((scan->linesize[c] * (v * mb_y + y) * 8) +
+                             (h * mb_x + x) * 8 * scan->bytes_per_pixel) >> s->avctx->lowres);
+
+            if (s->interlaced && s->bottom_field)
+                block_offset += scan->linesize[c] >> 1;
+            if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? scan->chroma_width  : s->width)
+                && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? scan->chroma_height : s->height)) {
+                ptr = scan->data[c] + block_offset;
+            } else
+                ptr = NULL;
+            if (!s->progressive) {
+                if (copy_mb) {
+                    if (ptr)
+                        mjpeg_copy_block(s, ptr, scan->reference_data[c] + block_offset,
+                                        scan->linesize[c], s->avctx->lowres);
+
+                } else {
+                    s->bdsp.clear_block(block);
+                    if (decode_block(s, gb, last_dc, block, i,
+                                     s->dc_index[i], s->ac_index[i],
+                                     s->quant_matrixes[s->quant_sindex[i]]) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
+                    }
+                    if (ptr) {
+                        s->idsp.idct_put(ptr, scan->linesize[c], block);
+                        if (s->bits & 7)
+                            shift_output(s, ptr, scan->linesize[c]);
+                    }
+                }
+            } else {
+                int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                 (h * mb_x + x);
+                int16_t *block = s->blocks[c][block_idx];
+                if (scan->Ah)
+                    block[0] += get_bits1(&s->gb) *
+                                s->quant_matrixes[s->quant_sindex[i]][0] << scan->Al;
+                else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                               s->quant_matrixes[s->quant_sindex[i]],
+                                               scan->Al) < 0) {
+                    av_log(s->avctx, AV_LOG_ERROR,
+                           "error y=%d x=%d\n", mb_y, mb_x);
+                    return AVERROR_INVALIDDATA;
+                }
+            }
+            ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+            ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                    mb_x, mb_y, x, y, c, s->bottom_field,
+                    (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+            if (++x == h) {
+                x = 0;
+                y++;
+            }
+        }
+    }
+    return 0;
+}
+
+static int decode_restart_interval(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegScan *scan = arg;
+    LOCAL_ALIGNED_32(int16_t, block, [64]);
+    int last_dc[MAX_COMPONENTS];
+    int mcu     = jobnr * s->restart_interval;
+    int mcu_end = FFMIN(mcu + s->restart_interval, scan->nb_mcus);
+    GetBitContext gb = s->gb;
+    int i, ret;
+
+    skip_bits_long(&gb, scan->segment_start[jobnr] * 8 - get_bits_count(&gb));
+    for (i = 0; i < scan->nb_components; i++)
+        last_dc[i] = 4 << s->bits;
+
+    for (; mcu < mcu_end; mcu++) {
+        if (get_bits_left(&gb) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+            return AVERROR_INVALIDDATA;
+        }
+        ret = decode_mcu(s, scan, &gb, last_dc, block,
+                         mcu % s->mb_width, mcu / s->mb_width, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (mcu_end == scan->nb_mcus)
+        scan->end_gb = gb;
+    return 0;
+}
+
+/**
+ * Decode a baseline scan with one slice job per restart interval. The
+ * intervals are located through the RSTn positions recorded while
+ * unescaping, their entropy coded data and DC predictors are independent.
+ * @return 1 if the markers do not match the interval layout and the scan
+ *         has to be decoded sequentially
+ */
+static int mjpeg_decode_scan_threaded(MJpegDecodeContext *s, MJpegScan *scan)
+{
+    int nb_segments, first, i, ret = 0;
+    int start = get_bits_count(&s->gb) / 8;
+    int *segment_start, *job_ret;
+
+    scan->nb_mcus = s->mb_width * s->mb_height;
+    nb_segments   = (scan->nb_mcus + s->restart_interval - 1) / s->restart_interval;
+    if (nb_segments < 2)
+        return 1;
+
+    /* the markers of an earlier field may precede this scan */
+    for (first = 0; first < s->nb_restart_offsets; first++)
+        if (s->restart_offsets[first] > start)
+            break;
+    if (s->nb_restart_offsets - first < nb_segments - 1)
+        return 1;
+
+    segment_start = av_malloc_array(2 * nb_segments, sizeof(*segment_start));
+    if (!segment_start)
+        return AVERROR(ENOMEM);
+    job_ret = segment_start + nb_segments;
+    segment_start[0] = start;
+    for (i = 1; i < nb_segments; i++)
+        segment_start[i] = s->restart_offsets[first + i - 1];
+    scan->segment_start = segment_start;
+    scan->end_gb        = s->gb;
+
+    s->avctx->execute2(s->avctx, decode_restart_interval, scan,
+                       job_ret, nb_segments);
+    for (i = 0; i < nb_segments && ret >= 0; i++)
+        ret = job_ret[i];
+    av_free(segment_start);
+    if (ret < 0)
+        return ret;
+
+    s->gb = scan->end_gb;
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
                              const AVFrame *reference)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
-    uint8_t *data[MAX_COMPONENTS];
-    const uint8_t *reference_data[MAX_COMPONENTS];
-    int linesize[MAX_COMPONENTS];
+    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, ret;
+    MJpegScan scan = { .nb_components = nb_components, .Ah = Ah, .Al = Al };
     GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
-    int bytes_per_pixel = 1 + (s->bits > 8);
 
     if (mb_bitmask) {
         if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
@@ -1434,17 +1603,26 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
 
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
-    chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
-    chroma_height = AV_CEIL_RSHIFT(s->height, chroma_v_shift);
+    scan.chroma_width    = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
+    scan.chroma_height   = AV_CEIL_RSHIFT(s->height, chroma_v_shift);
+    scan.bytes_per_pixel = 1 + (s->bits > 8);
 
     for (i = 0; i < nb_components; i++) {
         int c   = s->comp_index[i];
-        data[c] = s->picture_ptr->data[c];
-        reference_data[c] = reference ? reference->data[c] : NULL;
-        linesize[c] = s->linesize[c];
+        scan.data[c] = s->picture_ptr->data[c];
+        scan.reference_data[c] = reference ? reference->data[c] : NULL;
+        scan.linesize[c] = s->linesize[c];
         s->coefs_finished[c] |= 1;
     }
 
+    if (s->avctx->active_thread_type & FF_THREAD_SLICE &&
+        s->restart_interval && !mb_bitmask && !s->progressive &&
+        s->avctx->codec_id != AV_CODEC_ID_THP) {
+        ret = mjpeg_decode_scan_threaded(s, &scan);
+        if (ret <= 0)
+            return ret;
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1457,73 +1635,10 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                        -get_bits_left(&s->gb));
                 return AVERROR_INVALIDDATA;
             }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
-
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
-                    } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
-                            av_log(s->avctx, AV_LOG_ERROR,
-                                   "error y=%d x=%d\n", mb_y, mb_x);
-                            return AVERROR_INVALIDDATA;
-                        }
-                    }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
-                    }
-                }
-            }
+            ret = decode_mcu(s, &scan, &s->gb, s->last_dc, s->block,
+                             mb_x, mb_y, copy_mb);
+            if (ret < 0)
+                return ret;
 
             handle_rstn(s, nb_components);
         }
@@ -2190,6 +2305,17 @@ found:
     return val;
 }
 
+/* Failing to record an offset only disables threading for the scan. */
+static void add_restart_offset(MJpegDecodeContext *s, int offset)
+{
+    int *offsets = av_fast_realloc(s->restart_offsets, &s->restart_offsets_size,
+                                   (s->nb_restart_offsets + 1) * sizeof(*offsets));
+    if (!offsets)
+        return;
+    s->restart_offsets = offsets;
+    s->restart_offsets[s->nb_restart_offsets++] = offset;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -2202,6 +2328,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     if (!s->buffer)
         return AVERROR(ENOMEM);
 
+    s->nb_restart_offsets = 0;
+
     /* unescape buffer of SOS, use special treatment for JPEG-LS */
     if (start_code == SOS && !s->ls) {
         const uint8_t *src = *buf_ptr;
@@ -2245,6 +2373,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        add_restart_offset(s, dst - s->buffer + (ptr - src));
                     }
                 }
             }
@@ -2821,6 +2951,7 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->buffer);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
+    av_freep(&s->restart_offsets);
     s->ljpeg_buffer_size = 0;
 
     for (i = 0; i < 3; i++) {
@@ -2872,7 +3003,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
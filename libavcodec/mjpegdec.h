@@ -114,6 +114,9 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *restart_offsets;         ///< offsets in the unescaped scan just past each RSTn, for slice threading
+    unsigned int restart_offsets_size;
+    int nb_restart_offsets;
 
     int buggy_avid;
     int cs_itu601;
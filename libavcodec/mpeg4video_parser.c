@@ -36,18 +36,17 @@ struct Mp4vParseContext {
 
 int ff_mpeg4_find_frame_end(ParseContext *pc, const uint8_t *buf, int buf_size)
 {
-    int vop_found, i;
+    const uint8_t *ptr = buf, *end = buf + buf_size;
+    int vop_found;
     uint32_t state;
 
     vop_found = pc->frame_start_found;
     state     = pc->state;
 
-    i = 0;
     if (!vop_found) {
-        for (i = 0; i < buf_size; i++) {
-            state = (state << 8) | buf[i];
+        while (ptr < end) {
+            ptr = avpriv_find_start_code(ptr, end, &state);
             if (state == VOP_STARTCODE) {
-                i++;
                 vop_found = 1;
                 break;
             }
@@ -58,14 +57,14 @@ int ff_mpeg4_find_frame_end(ParseContext *pc, const uint8_t *buf, int buf_size)
         /* EOF considered as end of frame */
         if (buf_size == 0)
             return 0;
-        for (; i < buf_size; i++) {
-            state = (state << 8) | buf[i];
+        while (ptr < end) {
+            ptr = avpriv_find_start_code(ptr, end, &state);
             if ((state & 0xFFFFFF00) == 0x100) {
                 if (state == SLICE_STARTCODE || state == EXT_STARTCODE)
                     continue;
                 pc->frame_start_found = 0;
                 pc->state             = -1;
-                return i - 3;
+                return ptr - 4 - buf;
             }
         }
     }
@@ -1359,16 +1359,114 @@ static int encode_frame(AVCodecContext *c, AVFrame *frame)
     return size;
 }
 
-static int estimate_best_b_count(MpegEncContext *s)
+typedef struct BCountCandidate {
+    MpegEncContext *s;
+    int     b_count;
+    int     p_lambda, b_lambda, lambda2;
+    int64_t rd;
+} BCountCandidate;
+
+static int encode_tmp_frame(AVCodecContext *c, const AVFrame *src,
+                            enum AVPictureType pict_type, int quality)
 {
+    AVFrame *frame = av_frame_clone(src);
+    int ret;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+    frame->pict_type = pict_type;
+    frame->quality   = quality;
+
+    ret = encode_frame(c, frame);
+    av_frame_free(&frame);
+    return ret;
+}
+
+/**
+ * Encode the downscaled input frames with b_count B-frames between
+ * the P-frames and store the rate-distortion cost in the candidate.
+ * The candidates only share the downscaled frames, which they do
+ * not modify, so they can be evaluated concurrently.
+ */
+static int estimate_b_count_rd(AVCodecContext *avctx, void *arg)
+{
+    BCountCandidate *cand = arg;
+    MpegEncContext *s = cand->s;
     const AVCodec *codec = avcodec_find_encoder(s->avctx->codec_id);
+    const int j = cand->b_count;
+    AVCodecContext *c;
+    int64_t rd = 0;
+    int i, out_size, ret;
+
+    c = avcodec_alloc_context3(NULL);
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    c->width        = s->width  >> s->brd_scale;
+    c->height       = s->height >> s->brd_scale;
+    c->flags        = AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_PSNR;
+    c->flags       |= s->avctx->flags & AV_CODEC_FLAG_QPEL;
+    c->mb_decision  = s->avctx->mb_decision;
+    c->me_cmp       = s->avctx->me_cmp;
+    c->mb_cmp       = s->avctx->mb_cmp;
+    c->me_sub_cmp   = s->avctx->me_sub_cmp;
+    c->pix_fmt      = AV_PIX_FMT_YUV420P;
+    c->time_base    = s->avctx->time_base;
+    c->max_b_frames = s->max_b_frames;
+
+    ret = avcodec_open2(c, codec, NULL);
+    if (ret < 0)
+        goto fail;
+
+    ret = encode_tmp_frame(c, s->tmp_frames[0], AV_PICTURE_TYPE_I,
+                           1 * FF_QP2LAMBDA);
+    if (ret < 0)
+        goto fail;
+
+    //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
+
+    for (i = 0; i < s->max_b_frames + 1; i++) {
+        int is_p = i % (j + 1) == j || i == s->max_b_frames;
+
+        out_size = encode_tmp_frame(c, s->tmp_frames[i + 1],
+                                    is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B,
+                                    is_p ? cand->p_lambda : cand->b_lambda);
+        if (out_size < 0) {
+            ret = out_size;
+            goto fail;
+        }
+
+        rd += (out_size * cand->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    /* get the delayed frames */
+    out_size = encode_frame(c, NULL);
+    if (out_size < 0) {
+        ret = out_size;
+        goto fail;
+    }
+    rd += (out_size * cand->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+
+    rd += c->error[0] + c->error[1] + c->error[2];
+
+    cand->rd = rd;
+    ret = 0;
+
+fail:
+    avcodec_free_context(&c);
+    return ret;
+}
+
+static int estimate_best_b_count(MpegEncContext *s)
+{
+    BCountCandidate cands[MAX_B_FRAMES + 1];
+    int rets[MAX_B_FRAMES + 1];
     const int scale = s->brd_scale;
     int width  = s->width  >> scale;
     int height = s->height >> scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
+    int i, j, p_lambda, b_lambda, lambda2, nb_cands;
     int64_t best_rd  = INT64_MAX;
     int best_b_count = -1;
-    int ret = 0;
 
     av_assert0(scale >= 0 && scale <= 3);
 
@@ -1415,79 +1513,30 @@ static int estimate_best_b_count(MpegEncContext *s)
         }
     }
 
-    for (j = 0; j < s->max_b_frames + 1; j++) {
-        AVCodecContext *c;
-        int64_t rd = 0;
-
-        if (!s->input_picture[j])
+    for (nb_cands = 0; nb_cands < s->max_b_frames + 1; nb_cands++) {
+        if (!s->input_picture[nb_cands])
             break;
-
-        c = avcodec_alloc_context3(NULL);
-        if (!c)
-            return AVERROR(ENOMEM);
-
-        c->width        = width;
-        c->height       = height;
-        c->flags        = AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_PSNR;
-        c->flags       |= s->avctx->flags & AV_CODEC_FLAG_QPEL;
-        c->mb_decision  = s->avctx->mb_decision;
-        c->me_cmp       = s->avctx->me_cmp;
-        c->mb_cmp       = s->avctx->mb_cmp;
-        c->me_sub_cmp   = s->avctx->me_sub_cmp;
-        c->pix_fmt      = AV_PIX_FMT_YUV420P;
-        c->time_base    = s->avctx->time_base;
-        c->max_b_frames = s->max_b_frames;
-
-        ret = avcodec_open2(c, codec, NULL);
-        if (ret < 0)
-            goto fail;
-
-        s->tmp_frames[0]->pict_type = AV_PICTURE_TYPE_I;
-        s->tmp_frames[0]->quality   = 1 * FF_QP2LAMBDA;
-
-        out_size = encode_frame(c, s->tmp_frames[0]);
-        if (out_size < 0) {
-            ret = out_size;
-            goto fail;
-        }
-
-        //rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
-
-        for (i = 0; i < s->max_b_frames + 1; i++) {
-            int is_p = i % (j + 1) == j || i == s->max_b_frames;
-
-            s->tmp_frames[i + 1]->pict_type = is_p ?
-                                     AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            s->tmp_frames[i + 1]->quality   = is_p ? p_lambda : b_lambda;
-
-            out_size = encode_frame(c, s->tmp_frames[i + 1]);
-            if (out_size < 0) {
-                ret = out_size;
-                goto fail;
-            }
-
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        /* get the delayed frames */
-        out_size = encode_frame(c, NULL);
-        if (out_size < 0) {
-            ret = out_size;
-            goto fail;
-        }
-        rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-
-        rd += c->error[0] + c->error[1] + c->error[2];
-
-        if (rd < best_rd) {
-            best_rd = rd;
+        cands[nb_cands] = (BCountCandidate) {
+            .s        = s,
+            .b_count  = nb_cands,
+            .p_lambda = p_lambda,
+            .b_lambda = b_lambda,
+            .lambda2  = lambda2,
+        };
+    }
+
+    /* Each candidate runs a full encoder on its own; with slice
+     * threading they are spread over the worker threads. */
+    s->avctx->execute(s->avctx, estimate_b_count_rd, cands, rets,
+                      nb_cands, sizeof(*cands));
+
+    for (j = 0; j < nb_cands; j++) {
+        if (rets[j] < 0)
+            return rets[j];
+        if (cands[j].rd < best_rd) {
+            best_rd = cands[j].rd;
             best_b_count = j;
         }
-
-fail:
-        avcodec_free_context(&c);
-        if (ret < 0)
-            return ret;
     }
 
     return best_b_count;
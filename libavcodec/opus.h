@@ -129,6 +129,8 @@ typedef struct OpusStreamContext {
     int delayed_samples;
 
     OpusPacket packet;
+    /* start of this stream's sub-packet in the current packet */
+    const uint8_t *packet_data;
 
     int redundancy_idx;
 } OpusStreamContext;
@@ -162,6 +164,8 @@ typedef struct OpusContext {
     AVAudioFifo **sync_buffers;
     /* number of decoded samples for each stream */
     int         *decoded_samples;
+    /* number of samples coded in the current packet */
+    int          coded_samples;
 
     int             nb_streams;
     int      nb_stereo_streams;
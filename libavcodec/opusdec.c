@@ -411,6 +411,22 @@ finish:
     return output_samples;
 }
 
+static int opus_decode_stream(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    OpusContext        *c = arg;
+    OpusStreamContext *s = &c->streams[jobnr];
+
+    /* the streams only share the output frame, each one writing to
+     * its own channels, so they can be decoded concurrently */
+    c->decoded_samples[jobnr] = opus_decode_subpacket(s, s->packet_data,
+                                                      s->packet.data_size,
+                                                      c->out + 2 * jobnr,
+                                                      c->out_size[jobnr],
+                                                      c->coded_samples);
+    return 0;
+}
+
 static int opus_decode_packet(AVCodecContext *avctx, void *data,
                               int *got_frame_ptr, AVPacket *avpkt)
 {
@@ -496,7 +512,7 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
         c->out_size[i] = frame->linesize[0] - ret * sizeof(float);
     }
 
-    /* decode each sub-packet */
+    /* parse the header of each sub-packet */
     for (i = 0; i < c->nb_streams; i++) {
         OpusStreamContext *s = &c->streams[i];
 
@@ -515,15 +531,21 @@ static int opus_decode_packet(AVCodecContext *avctx, void *data,
             s->silk_samplerate = get_silk_samplerate(s->packet.config);
         }
 
-        ret = opus_decode_subpacket(&c->streams[i], buf, s->packet.data_size,
-                                    c->out + 2 * i, c->out_size[i], coded_samples);
-        if (ret < 0)
-            return ret;
-        c->decoded_samples[i] = ret;
-        decoded_samples       = FFMIN(decoded_samples, ret);
+        s->packet_data = buf;
+        if (buf) {
+            buf      += s->packet.packet_size;
+            buf_size -= s->packet.packet_size;
+        }
+    }
 
-        buf      += s->packet.packet_size;
-        buf_size -= s->packet.packet_size;
+    /* decode each sub-packet */
+    c->coded_samples = coded_samples;
+    avctx->execute2(avctx, opus_decode_stream, c, NULL, c->nb_streams);
+
+    for (i = 0; i < c->nb_streams; i++) {
+        if (c->decoded_samples[i] < 0)
+            return c->decoded_samples[i];
+        decoded_samples = FFMIN(decoded_samples, c->decoded_samples[i]);
     }
 
     /* buffer the extra samples */
@@ -737,5 +759,5 @@ AVCodec ff_opus_decoder = {
     .close           = opus_decode_close,
     .decode          = opus_decode_packet,
     .flush           = opus_decode_flush,
-    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .capabilities    = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
 };
@@ -27,4 +27,25 @@ int ff_side_data_set_encoder_stats(AVPacket *pkt, int quality, int64_t *error, i
 
 int ff_side_data_set_prft(AVPacket *pkt, int64_t timestamp);
 
+/**
+ * A set of buffer pools for packet payloads, one per power of two size
+ * class, so that packets can be allocated without hitting the heap once
+ * the pools have warmed up.
+ */
+typedef struct FFPacketPool FFPacketPool;
+
+FFPacketPool *avpriv_packet_pool_alloc(void);
+
+void avpriv_packet_pool_free(FFPacketPool **pool);
+
+/**
+ * Get a buffer large enough for size bytes of payload followed by
+ * AV_INPUT_BUFFER_PADDING_SIZE bytes of padding. The buffer contents,
+ * including the padding, are not initialized.
+ *
+ * @return a new reference, or NULL if size is too large for the pool
+ *         or on allocation failure
+ */
+AVBufferRef *avpriv_packet_pool_get(FFPacketPool *pool, int size);
+
 #endif // AVCODEC_PACKET_INTERNAL_H
@@ -45,6 +45,21 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/**
+ * Per-slice deflate state used with slice threading. Every slice is
+ * compressed as an independent raw deflate run, ended with a sync flush
+ * so the runs can simply be concatenated into one zlib stream.
+ */
+typedef struct PNGEncSlice {
+    z_stream zstream;
+    uint8_t *crow_base;
+    uint8_t *buf;
+    unsigned int buf_size;
+    int len;                     ///< bytes of compressed data in buf
+    uLong adler;                 ///< Adler-32 of the filtered rows of the slice
+    int ret;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -57,6 +72,11 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+    int compression_level;
+
+    PNGEncSlice *slices;
+    int nb_slices;
+
     int dpi;                     ///< Physical pixel density, in dots per inch, if set
     int dpm;                     ///< Physical pixel density, in dots per meter, if set
 
@@ -521,6 +541,95 @@ the_end:
     return ret;
 }
 
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s  = avctx->priv_data;
+    const AVFrame *p  = arg;
+    PNGEncSlice *sl   = &s->slices[jobnr];
+    int row_size      = (p->width * s->bits_per_pixel + 7) >> 3;
+    int y_start       =  jobnr      * p->height / s->nb_slices;
+    int y_end         = (jobnr + 1) * p->height / s->nb_slices;
+    int last          = jobnr == s->nb_slices - 1;
+    /* room for the zlib header in the first slice, the Adler-32 in the last */
+    int header        = jobnr ? 0 : 2;
+    uint8_t *crow_buf = sl->crow_base + 15;
+    uint8_t *ptr, *top, *crow;
+    int y;
+
+    sl->ret = -1;
+    av_fast_malloc(&sl->buf, &sl->buf_size,
+                   deflateBound(&sl->zstream, (y_end - y_start) * (row_size + 1)) + 64);
+    if (!sl->buf)
+        return sl->ret = AVERROR(ENOMEM);
+
+    sl->zstream.next_out  = sl->buf + header;
+    sl->zstream.avail_out = sl->buf_size - header - 4;
+    sl->adler = adler32(0, NULL, 0);
+
+    top = y_start ? p->data[0] + (y_start - 1) * p->linesize[0] : NULL;
+    for (y = y_start; y < y_end; y++) {
+        ptr  = p->data[0] + y * p->linesize[0];
+        crow = png_choose_filter(s, crow_buf, ptr, top,
+                                 row_size, s->bits_per_pixel >> 3);
+        sl->adler = adler32(sl->adler, crow, row_size + 1);
+        sl->zstream.next_in  = crow;
+        sl->zstream.avail_in = row_size + 1;
+        if (deflate(&sl->zstream, Z_NO_FLUSH) != Z_OK || sl->zstream.avail_in)
+            goto fail;
+        top = ptr;
+    }
+    if (deflate(&sl->zstream, last ? Z_FINISH : Z_SYNC_FLUSH) != (last ? Z_STREAM_END : Z_OK))
+        goto fail;
+
+    sl->len = sl->zstream.next_out - sl->buf;
+    sl->ret = 0;
+fail:
+    deflateReset(&sl->zstream);
+    return sl->ret;
+}
+
+/**
+ * Compress the rows of a non-interlaced image in parallel, pigz style.
+ * The result is a single zlib stream; it is only slightly larger than the
+ * single threaded one since the window starts empty in every slice.
+ */
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncSlice *last = &s->slices[s->nb_slices - 1];
+    int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+    uLong adler  = adler32(0, NULL, 0);
+    int header, level_flags, i;
+
+    avctx->execute2(avctx, encode_slice, (void *)pict, NULL, s->nb_slices);
+
+    for (i = 0; i < s->nb_slices; i++) {
+        int rows = (i + 1) * pict->height / s->nb_slices - i * pict->height / s->nb_slices;
+        if (s->slices[i].ret < 0)
+            return s->slices[i].ret;
+        adler = adler32_combine(adler, s->slices[i].adler, (z_off_t)rows * (row_size + 1));
+    }
+
+    /* the same header deflate() writes for a 32K window */
+    level_flags = s->compression_level < 2 ? 0 :
+                  s->compression_level < 6 ? 1 :
+                  s->compression_level == 6 ? 2 : 3;
+    header  = (Z_DEFLATED + (7 << 4)) << 8 | level_flags << 6;
+    header += 31 - header % 31;
+    AV_WB16(s->slices[0].buf, header);
+    AV_WB32(last->buf + last->len, adler);
+    last->len += 4;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        PNGEncSlice *sl = &s->slices[i];
+        if (s->bytestream_end - s->bytestream < sl->len + 100)
+            return AVERROR_BUG;
+        png_write_image_data(avctx, sl->buf, sl->len);
+    }
+
+    return 0;
+}
+
 static int encode_png(AVCodecContext *avctx, AVPacket *pkt,
                       const AVFrame *pict, int *got_packet)
 {
@@ -553,7 +662,10 @@ static int encode_png(AVCodecContext *avctx, AVPacket *pkt,
     if (ret < 0)
         return ret;
 
-    ret = encode_frame(avctx, pict);
+    if (s->nb_slices && pict->height >= 16 * s->nb_slices)
+        ret = encode_frame_slices(avctx, pict);
+    else
+        ret = encode_frame(avctx, pict);
     if (ret < 0)
         return ret;
 
@@ -1091,6 +1203,32 @@ FF_ENABLE_DEPRECATION_WARNINGS
                       : av_clip(avctx->compression_level, 0, 9);
     if (deflateInit2(&s->zstream, compression_level, Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         return -1;
+    s->compression_level = compression_level == Z_DEFAULT_COMPRESSION ? 6 : compression_level;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1 &&
+        !s->is_progressive) {
+        int row_size = (avctx->width * s->bits_per_pixel + 7) >> 3;
+        int i;
+
+        s->slices = av_mallocz_array(avctx->thread_count, sizeof(*s->slices));
+        if (!s->slices)
+            return AVERROR(ENOMEM);
+        s->nb_slices = avctx->thread_count;
+
+        for (i = 0; i < s->nb_slices; i++) {
+            PNGEncSlice *sl = &s->slices[i];
+
+            sl->zstream.zalloc = ff_png_zalloc;
+            sl->zstream.zfree  = ff_png_zfree;
+            sl->zstream.opaque = NULL;
+            if (deflateInit2(&sl->zstream, compression_level, Z_DEFLATED,
+                             -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                return -1;
+            sl->crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+            if (!sl->crow_base)
+                return AVERROR(ENOMEM);
+        }
+    }
 
     return 0;
 }
@@ -1098,8 +1236,17 @@ FF_ENABLE_DEPRECATION_WARNINGS
 static av_cold int png_enc_close(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
+    int i;
 
     deflateEnd(&s->zstream);
+    if (s->slices) {
+        for (i = 0; i < s->nb_slices; i++) {
+            deflateEnd(&s->slices[i].zstream);
+            av_freep(&s->slices[i].crow_base);
+            av_freep(&s->slices[i].buf);
+        }
+        av_freep(&s->slices);
+    }
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1146,7 +1293,8 @@ AVCodec ff_png_encoder = {
     .init           = png_enc_init,
     .close          = png_enc_close,
     .encode2        = encode_png,
-    .capabilities   = AV_CODEC_CAP_FRAME_THREADS,
+    .capabilities   = AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
     .pix_fmts       = (const enum AVPixelFormat[]) {
         AV_PIX_FMT_RGB24, AV_PIX_FMT_RGBA,
         AV_PIX_FMT_RGB48BE, AV_PIX_FMT_RGBA64BE,
@@ -826,5 +826,6 @@ AVCodec ff_prores_decoder = {
     .close          = decode_close,
     .decode         = decode_frame,
     .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal  = FF_CODEC_CAP_FRAME_SLICE_THREADS,
     .profiles       = NULL_IF_CONFIG_SMALL(ff_prores_profiles),
 };
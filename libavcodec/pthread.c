@@ -29,6 +29,9 @@
  * @see doc/multithreading.txt
  */
 
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+
 #include "avcodec.h"
 #include "internal.h"
 #include "pthread_internal.h"
@@ -40,17 +43,30 @@
  * Threading requires more than one thread.
  * Frame threading requires entire frames to be passed to the codec,
  * and introduces extra decoding delay, so is incompatible with low_delay.
+ * Decoders flagged FF_CODEC_CAP_FRAME_SLICE_THREADS can combine both
+ * when both are requested.
+ * Encoders get frame threads from frame_thread_encoder.c, so when they
+ * reach this they can only use slice threading.
  *
  * @param avctx The context.
  */
 static void validate_thread_parameters(AVCodecContext *avctx)
 {
     int frame_threading_supported = (avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)
+                                && av_codec_is_decoder(avctx->codec)
                                 && !(avctx->flags  & AV_CODEC_FLAG_TRUNCATED)
                                 && !(avctx->flags  & AV_CODEC_FLAG_LOW_DELAY)
                                 && !(avctx->flags2 & AV_CODEC_FLAG2_CHUNKS);
     if (avctx->thread_count == 1) {
         avctx->active_thread_type = 0;
+    } else if (frame_threading_supported &&
+               (avctx->thread_type & FF_THREAD_FRAME) &&
+               (avctx->thread_type & FF_THREAD_SLICE) &&
+               av_codec_is_decoder(avctx->codec) &&
+               avctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS &&
+               avctx->codec->caps_internal & FF_CODEC_CAP_FRAME_SLICE_THREADS &&
+               !(avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF)) {
+        avctx->active_thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
     } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
         avctx->active_thread_type = FF_THREAD_FRAME;
     } else if (avctx->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS &&
@@ -67,11 +83,53 @@ static void validate_thread_parameters(AVCodecContext *avctx)
                avctx->thread_count, MAX_AUTO_THREADS);
 }
 
+/**
+ * Split the threads between frame threads and a slice thread pool shared
+ * by them. Fewer frames in flight keep the decoding delay and the memory
+ * use down, the pool keeps all the cores busy.
+ */
+static int hybrid_thread_init(AVCodecContext *avctx)
+{
+    int thread_count = avctx->thread_count;
+    int frame_threads, slice_threads, ret;
+
+    if (!thread_count) {
+        int nb_cpus = av_cpu_count();
+        thread_count = nb_cpus > 1 ? FFMIN(nb_cpus + 1, MAX_AUTO_THREADS) : 1;
+    }
+
+    frame_threads = av_clip(thread_count / 4, 2, thread_count);
+    slice_threads = thread_count - frame_threads + 1;
+    if (slice_threads < 2) {
+        avctx->active_thread_type = FF_THREAD_FRAME;
+        return ff_frame_thread_init(avctx);
+    }
+
+    avctx->thread_count = slice_threads;
+    ret = ff_slice_thread_init(avctx);
+    if (ret < 0)
+        return ret;
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE)) {
+        avctx->active_thread_type = FF_THREAD_FRAME;
+        avctx->thread_count       = thread_count;
+        return ff_frame_thread_init(avctx);
+    }
+
+    avctx->active_thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    avctx->thread_count       = frame_threads;
+    ret = ff_frame_thread_init(avctx);
+    if (ret < 0 || !(avctx->active_thread_type & FF_THREAD_FRAME))
+        ff_slice_thread_free(avctx);
+    return ret;
+}
+
 int ff_thread_init(AVCodecContext *avctx)
 {
     validate_thread_parameters(avctx);
 
-    if (avctx->active_thread_type&FF_THREAD_SLICE)
+    if (avctx->active_thread_type == (FF_THREAD_FRAME | FF_THREAD_SLICE))
+        return hybrid_thread_init(avctx);
+    else if (avctx->active_thread_type&FF_THREAD_SLICE)
         return ff_slice_thread_init(avctx);
     else if (avctx->active_thread_type&FF_THREAD_FRAME)
         return ff_frame_thread_init(avctx);
@@ -83,6 +141,6 @@ void ff_thread_free(AVCodecContext *avctx)
 {
     if (avctx->active_thread_type&FF_THREAD_FRAME)
         ff_frame_thread_free(avctx, avctx->thread_count);
-    else
+    if (avctx->active_thread_type != FF_THREAD_FRAME)
         ff_slice_thread_free(avctx);
 }
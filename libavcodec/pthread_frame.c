@@ -44,6 +44,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/trace_internal.h"
 
 enum {
     ///< Set when the thread is awaiting a packet.
@@ -135,6 +136,9 @@ typedef struct FrameThreadContext {
                                     * Set for the first N packets, where N is the number of threads.
                                     * While it is set, ff_thread_en/decode_frame won't return any results.
                                     */
+
+    int low_latency;               ///< Set if AV_CODEC_FLAG2_LOW_LATENCY was set at init.
+    int nb_pending;                ///< Number of submitted packets whose output was not returned yet, only used with low_latency.
 } FrameThreadContext;
 
 #define THREAD_SAFE_CALLBACKS(avctx) \
@@ -171,6 +175,11 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
     AVCodecContext *avctx = p->avctx;
     const AVCodec *codec = avctx->codec;
 
+    /* the thread only ever runs this codec */
+    ff_codec_set_mem_class(avctx);
+    if (avctx->numa_node >= 0)
+        av_cpu_numa_bind_thread(avctx->numa_node);
+
     pthread_mutex_lock(&p->mutex);
     while (1) {
         while (atomic_load(&p->state) == STATE_INPUT_READY && !p->die)
@@ -198,7 +207,11 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
 
         av_frame_unref(p->frame);
         p->got_frame = 0;
+        avpriv_trace_begin("lavc", "decode", p->avpkt.pts, p->avpkt.stream_index);
         p->result = codec->decode(avctx, p->frame, &p->got_frame, &p->avpkt);
+        avpriv_trace_end("lavc", "decode",
+                         p->got_frame ? p->frame->pts : AV_NOPTS_VALUE,
+                         p->avpkt.stream_index);
 
         if ((p->result < 0 || !p->got_frame) && p->frame->buf[0]) {
             if (avctx->codec->caps_internal & FF_CODEC_CAP_ALLOCATE_PROGRESS)
@@ -476,10 +489,63 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
 
     fctx->prev_thread = p;
     fctx->next_decoding++;
+    if (fctx->low_latency)
+        fctx->nb_pending++;
 
     return 0;
 }
 
+/**
+ * Low latency output: instead of delaying output by thread_count - 1
+ * packets, return the oldest frame if it is already decoded and only wait
+ * for it when every thread holds an unreturned frame or when draining.
+ */
+static int return_finished_frame(AVCodecContext *avctx, AVFrame *picture,
+                                 int *got_picture_ptr, AVPacket *avpkt)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    int err = 0;
+
+    *got_picture_ptr = 0;
+
+    while (fctx->nb_pending) {
+        PerThreadContext *p = &fctx->threads[fctx->next_finished];
+
+        if (avpkt->size && fctx->nb_pending < avctx->thread_count &&
+            atomic_load(&p->state) != STATE_INPUT_READY)
+            break;
+
+        if (atomic_load(&p->state) != STATE_INPUT_READY) {
+            pthread_mutex_lock(&p->progress_mutex);
+            while (atomic_load_explicit(&p->state, memory_order_relaxed) != STATE_INPUT_READY)
+                pthread_cond_wait(&p->output_cond, &p->progress_mutex);
+            pthread_mutex_unlock(&p->progress_mutex);
+        }
+
+        av_frame_move_ref(picture, p->frame);
+        *got_picture_ptr = p->got_frame;
+        picture->pkt_dts = p->avpkt.dts;
+        err = p->result;
+        p->got_frame = 0;
+        p->result = 0;
+
+        update_context_from_thread(avctx, p->avctx, 1);
+
+        fctx->nb_pending--;
+        if (++fctx->next_finished >= avctx->thread_count)
+            fctx->next_finished = 0;
+
+        /* skip over packets that produced neither a frame nor an error */
+        if (*got_picture_ptr || err < 0)
+            break;
+    }
+
+    if (fctx->next_decoding >= avctx->thread_count)
+        fctx->next_decoding = 0;
+
+    return err < 0 ? err : avpkt->size;
+}
+
 int ff_thread_decode_frame(AVCodecContext *avctx,
                            AVFrame *picture, int *got_picture_ptr,
                            AVPacket *avpkt)
@@ -502,6 +568,11 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     if (err)
         goto finish;
 
+    if (fctx->low_latency) {
+        err = return_finished_frame(avctx, picture, got_picture_ptr, avpkt);
+        goto finish;
+    }
+
     /*
      * If we're still receiving the initial packets, don't return a frame.
      */
@@ -724,6 +795,7 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
         }
 
         if (p->avctx) {
+            ff_slice_thread_free(p->avctx);
             av_buffer_unref(&p->avctx->internal->pool);
             av_freep(&p->avctx->internal);
             av_buffer_unref(&p->avctx->hw_frames_ctx);
@@ -788,6 +860,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
     fctx->async_lock = 1;
     fctx->delaying = 1;
+    fctx->low_latency = !!(avctx->flags2 & AV_CODEC_FLAG2_LOW_LATENCY);
 
     if (codec->type == AVMEDIA_TYPE_VIDEO)
         avctx->delay = src->thread_count - 1;
@@ -827,8 +900,15 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         }
         *copy->internal = *src->internal;
         copy->internal->thread_ctx = p;
+        copy->internal->slice_thread_ctx = NULL;
         copy->internal->last_pkt_props = &p->avpkt;
 
+        if (avctx->active_thread_type & FF_THREAD_SLICE) {
+            err = ff_slice_thread_init_copy(copy, src);
+            if (err < 0)
+                goto error;
+        }
+
         copy->delay = avctx->delay;
 
         if (codec->priv_data_size) {
@@ -888,6 +968,7 @@ void ff_thread_flush(AVCodecContext *avctx)
 
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
+    fctx->nb_pending = 0;
     fctx->prev_thread = NULL;
     for (i = 0; i < avctx->thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
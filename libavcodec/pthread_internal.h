@@ -27,6 +27,11 @@
 
 int ff_slice_thread_init(AVCodecContext *avctx);
 void ff_slice_thread_free(AVCodecContext *avctx);
+/**
+ * Set up the slice threading context of a frame thread copy, sharing
+ * the worker pool of src.
+ */
+int ff_slice_thread_init_copy(AVCodecContext *copy, const AVCodecContext *src);
 
 int ff_frame_thread_init(AVCodecContext *avctx);
 void ff_frame_thread_free(AVCodecContext *avctx, int thread_count);
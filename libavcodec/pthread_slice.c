@@ -24,6 +24,8 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
+
 #include "avcodec.h"
 #include "internal.h"
 #include "pthread_internal.h"
@@ -40,8 +42,20 @@ typedef int (action_func)(AVCodecContext *c, void *arg);
 typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
 typedef int (main_func)(AVCodecContext *c);
 
-typedef struct SliceThreadContext {
+/**
+ * Worker threads executing the jobs. With frame and slice threading
+ * combined, all frame threads share the pool owned by the user context.
+ */
+typedef struct SliceThreadPool {
     AVSliceThread *thread;
+    int thread_count;
+    atomic_int busy;
+    AVCodecContext *avctx;  ///< context whose jobs are being executed
+} SliceThreadPool;
+
+typedef struct SliceThreadContext {
+    SliceThreadPool *pool;
+    int owns_pool;
     action_func *func;
     action_func2 *func2;
     main_func *mainfunc;
@@ -57,15 +71,17 @@ typedef struct SliceThreadContext {
 } SliceThreadContext;
 
 static void main_function(void *priv) {
-    AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadPool *pool = priv;
+    AVCodecContext *avctx = pool->avctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->mainfunc(avctx);
 }
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
 {
-    AVCodecContext *avctx = priv;
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadPool *pool = priv;
+    AVCodecContext *avctx = pool->avctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int ret;
 
     ret = c->func ? c->func(avctx, (char *)c->args + c->job_size * jobnr)
@@ -76,10 +92,16 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 
 void ff_slice_thread_free(AVCodecContext *avctx)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     int i;
 
-    avpriv_slicethread_free(&c->thread);
+    if (!c)
+        return;
+
+    if (c->owns_pool && c->pool) {
+        avpriv_slicethread_free(&c->pool->thread);
+        av_freep(&c->pool);
+    }
 
     for (i = 0; i < c->thread_count; i++) {
         pthread_mutex_destroy(&c->progress_mutex[i]);
@@ -89,12 +111,13 @@ void ff_slice_thread_free(AVCodecContext *avctx)
     av_freep(&c->entries);
     av_freep(&c->progress_mutex);
     av_freep(&c->progress_cond);
-    av_freep(&avctx->internal->thread_ctx);
+    av_freep(&avctx->internal->slice_thread_ctx);
 }
 
 static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
+    SliceThreadPool *pool;
 
     if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
@@ -102,25 +125,37 @@ static int thread_execute(AVCodecContext *avctx, action_func* func, void *arg, i
     if (job_count <= 0)
         return 0;
 
+    pool = c->pool;
+    /* Another frame thread is using the shared pool, run the jobs here
+     * instead of waiting for it. */
+    if (atomic_exchange_explicit(&pool->busy, 1, memory_order_acquire)) {
+        if (func)
+            return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
+        return avcodec_default_execute2(avctx, c->func2, arg, ret, job_count);
+    }
+
     c->job_size = job_size;
     c->args = arg;
     c->func = func;
     c->rets = ret;
+    pool->avctx = avctx;
 
-    avpriv_slicethread_execute(c->thread, job_count, !!c->mainfunc  );
+    avpriv_slicethread_execute(pool->thread, job_count, !!c->mainfunc  );
+
+    atomic_store_explicit(&pool->busy, 0, memory_order_release);
     return 0;
 }
 
 static int thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->func2 = func2;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
 int ff_slice_thread_execute_with_mainfunc(AVCodecContext *avctx, action_func2* func2, main_func *mainfunc, void *arg, int *ret, int job_count)
 {
-    SliceThreadContext *c = avctx->internal->thread_ctx;
+    SliceThreadContext *c = avctx->internal->slice_thread_ctx;
     c->func2 = func2;
     c->mainfunc = mainfunc;
     return thread_execute(avctx, NULL, arg, ret, job_count, 0);
@@ -154,26 +189,49 @@ int ff_slice_thread_init(AVCodecContext *avctx)
         return 0;
     }
 
-    avctx->internal->thread_ctx = c = av_mallocz(sizeof(*c));
+    avctx->internal->slice_thread_ctx = c = av_mallocz(sizeof(*c));
+    if (c) {
+        c->pool      = av_mallocz(sizeof(*c->pool));
+        c->owns_pool = 1;
+    }
     mainfunc = avctx->codec->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    if (!c || (thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func, mainfunc, thread_count)) <= 1) {
-        if (c)
-            avpriv_slicethread_free(&c->thread);
-        av_freep(&avctx->internal->thread_ctx);
+    if (!c || !c->pool ||
+        (thread_count = avpriv_slicethread_create(&c->pool->thread, c->pool, worker_func, mainfunc, thread_count)) <= 1) {
+        ff_slice_thread_free(avctx);
         avctx->thread_count = 1;
         avctx->active_thread_type = 0;
         return 0;
     }
-    avctx->thread_count = thread_count;
+    avctx->thread_count = c->pool->thread_count = thread_count;
+    atomic_init(&c->pool->busy, 0);
+
+    if (avctx->numa_node >= 0 &&
+        avpriv_slicethread_set_numa_node(c->pool->thread, avctx->numa_node) < 0)
+        av_log(avctx, AV_LOG_WARNING, "Could not bind the threads to NUMA node %d\n",
+               avctx->numa_node);
 
     avctx->execute = thread_execute;
     avctx->execute2 = thread_execute2;
     return 0;
 }
 
+int ff_slice_thread_init_copy(AVCodecContext *copy, const AVCodecContext *src)
+{
+    const SliceThreadContext *src_c = src->internal->slice_thread_ctx;
+    SliceThreadContext *c;
+
+    copy->internal->slice_thread_ctx = c = av_mallocz(sizeof(*c));
+    if (!c)
+        return AVERROR(ENOMEM);
+
+    c->pool           = src_c->pool;
+    copy->thread_count = c->pool->thread_count;
+    return 0;
+}
+
 void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, int n)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     int *entries = p->entries;
 
     pthread_mutex_lock(&p->progress_mutex[thread]);
@@ -184,7 +242,7 @@ void ff_thread_report_progress2(AVCodecContext *avctx, int field, int thread, in
 
 void ff_thread_await_progress2(AVCodecContext *avctx, int field, int thread, int shift)
 {
-    SliceThreadContext *p  = avctx->internal->thread_ctx;
+    SliceThreadContext *p  = avctx->internal->slice_thread_ctx;
     int *entries      = p->entries;
 
     if (!entries || !field) return;
@@ -203,7 +261,7 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
     int i;
 
     if (avctx->active_thread_type & FF_THREAD_SLICE)  {
-        SliceThreadContext *p = avctx->internal->thread_ctx;
+        SliceThreadContext *p = avctx->internal->slice_thread_ctx;
 
         if (p->entries) {
             av_assert0(p->thread_count == avctx->thread_count);
@@ -237,6 +295,6 @@ int ff_alloc_entries(AVCodecContext *avctx, int count)
 
 void ff_reset_entries(AVCodecContext *avctx)
 {
-    SliceThreadContext *p = avctx->internal->thread_ctx;
+    SliceThreadContext *p = avctx->internal->slice_thread_ctx;
     memset(p->entries, 0, p->entries_count * sizeof(int));
 }
@@ -47,6 +47,7 @@
 #include "hwconfig.h"
 #include "libavutil/opt.h"
 #include "mpegvideo.h"
+#include "packet_internal.h"
 #include "thread.h"
 #include "frame_thread_encoder.h"
 #include "internal.h"
@@ -759,6 +760,14 @@ FF_DISABLE_DEPRECATION_WARNINGS
 FF_ENABLE_DEPRECATION_WARNINGS
 #endif
 
+        if (avctx->flags2 & AV_CODEC_FLAG2_POOL_PACKETS) {
+            avci->packet_pool = avpriv_packet_pool_alloc();
+            if (!avci->packet_pool) {
+                ret = AVERROR(ENOMEM);
+                goto free_and_end;
+            }
+        }
+
         if (avctx->time_base.num <= 0 || avctx->time_base.den <= 0) {
             av_log(avctx, AV_LOG_ERROR, "The encoder timebase is not set.\n");
             ret = AVERROR(EINVAL);
@@ -928,7 +937,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     if (   avctx->codec->init && (!(avctx->active_thread_type&FF_THREAD_FRAME)
         || avci->frame_thread_encoder)) {
+        const AVClass *mem_class = ff_codec_set_mem_class(avctx);
         ret = avctx->codec->init(avctx);
+        av_mem_set_class(mem_class);
         if (ret < 0) {
             goto free_and_end;
         }
@@ -1025,7 +1036,7 @@ free_and_end:
          (avctx->codec->caps_internal & FF_CODEC_CAP_INIT_CLEANUP)))
         avctx->codec->close(avctx);
 
-    if (HAVE_THREADS && avci->thread_ctx)
+    if (HAVE_THREADS && (avci->thread_ctx || avci->slice_thread_ctx))
         ff_thread_free(avctx);
 
     if (codec->priv_class && codec->priv_data_size)
@@ -1054,6 +1065,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         av_bsf_free(&avci->bsf);
 
         av_buffer_unref(&avci->pool);
+        avpriv_packet_pool_free(&avci->packet_pool);
     }
     av_freep(&avci);
     avctx->internal = NULL;
@@ -1137,12 +1149,14 @@ av_cold int avcodec_close(AVCodecContext *avctx)
             avctx->internal->frame_thread_encoder && avctx->thread_count > 1) {
             ff_frame_thread_encoder_free(avctx);
         }
-        if (HAVE_THREADS && avctx->internal->thread_ctx)
+        if (HAVE_THREADS && (avctx->internal->thread_ctx ||
+                             avctx->internal->slice_thread_ctx))
             ff_thread_free(avctx);
         if (avctx->codec && avctx->codec->close)
             avctx->codec->close(avctx);
         avctx->internal->byte_buffer_size = 0;
         av_freep(&avctx->internal->byte_buffer);
+        avpriv_packet_pool_free(&avctx->internal->packet_pool);
         av_frame_free(&avctx->internal->to_free);
         av_frame_free(&avctx->internal->compat_decode_frame);
         av_frame_free(&avctx->internal->buffer_frame);
@@ -626,6 +626,58 @@ mc_bi_w_func(epel_hv, 12, 6, sse4)
 mc_bi_w_funcs(qpel_h, 12, sse4)
 mc_bi_w_funcs(qpel_v, 12, sse4)
 mc_bi_w_funcs(qpel_hv, 12, sse4)
+
+#if HAVE_AVX2_EXTERNAL
+/* weighted prediction: AVX2 interpolation followed by the SSE4 weighting */
+#define mc_w_func_avx2(name, bitd, W)                                                                \
+void ff_hevc_put_hevc_uni_w_##name##W##_##bitd##_avx2(uint8_t *_dst, ptrdiff_t _dststride,          \
+                                                      uint8_t *_src, ptrdiff_t _srcstride,           \
+                                                      int height, int denom,                         \
+                                                      int _wx, int _ox,                              \
+                                                      intptr_t mx, intptr_t my, int width)           \
+{                                                                                                    \
+    LOCAL_ALIGNED_32(int16_t, temp, [71 * MAX_PB_SIZE]);                                             \
+    ff_hevc_put_hevc_##name##W##_##bitd##_avx2(temp, _src, _srcstride, height, mx, my, width);      \
+    ff_hevc_put_hevc_uni_w##W##_##bitd##_sse4(_dst, _dststride, temp, height, denom, _wx, _ox);     \
+}                                                                                                    \
+void ff_hevc_put_hevc_bi_w_##name##W##_##bitd##_avx2(uint8_t *_dst, ptrdiff_t _dststride,           \
+                                                     uint8_t *_src, ptrdiff_t _srcstride,            \
+                                                     int16_t *_src2,                                 \
+                                                     int height, int denom,                          \
+                                                     int _wx0, int _wx1, int _ox0, int _ox1,         \
+                                                     intptr_t mx, intptr_t my, int width)            \
+{                                                                                                    \
+    LOCAL_ALIGNED_32(int16_t, temp, [71 * MAX_PB_SIZE]);                                             \
+    ff_hevc_put_hevc_##name##W##_##bitd##_avx2(temp, _src, _srcstride, height, mx, my, width);      \
+    ff_hevc_put_hevc_bi_w##W##_##bitd##_sse4(_dst, _dststride, temp, _src2,                          \
+                                             height, denom, _wx0, _wx1, _ox0, _ox1);                 \
+}
+
+#define mc_w_funcs_avx2_8(name)     \
+        mc_w_func_avx2(name, 8, 32) \
+        mc_w_func_avx2(name, 8, 48) \
+        mc_w_func_avx2(name, 8, 64)
+
+#define mc_w_funcs_avx2_10(name)     \
+        mc_w_func_avx2(name, 10, 16) \
+        mc_w_func_avx2(name, 10, 24) \
+        mc_w_func_avx2(name, 10, 32) \
+        mc_w_func_avx2(name, 10, 48) \
+        mc_w_func_avx2(name, 10, 64)
+
+mc_w_funcs_avx2_8(epel_h)
+mc_w_funcs_avx2_8(epel_v)
+mc_w_funcs_avx2_8(epel_hv)
+mc_w_funcs_avx2_8(qpel_h)
+mc_w_funcs_avx2_8(qpel_v)
+
+mc_w_funcs_avx2_10(epel_h)
+mc_w_funcs_avx2_10(epel_v)
+mc_w_funcs_avx2_10(epel_hv)
+mc_w_funcs_avx2_10(qpel_h)
+mc_w_funcs_avx2_10(qpel_v)
+mc_w_funcs_avx2_10(qpel_hv)
+#endif //AVX2
 #endif //ARCH_X86_64 && HAVE_SSE4_EXTERNAL
 
 #define SAO_BAND_FILTER_FUNCS(bitd, opt)                                                                                   \
@@ -705,6 +757,20 @@ SAO_EDGE_FILTER_FUNCS(12, avx2)
         PEL_LINK(pointer, 8, my , mx , fname##48,  bitd, opt ); \
         PEL_LINK(pointer, 9, my , mx , fname##64,  bitd, opt )
 
+#define PEL_W_LINK(pointer, idx1, idx2, idx3, name, D, opt) \
+        pointer ## _uni_w[idx1][idx2][idx3] = ff_hevc_put_hevc_uni_w_ ## name ## _ ## D ## _ ## opt; \
+        pointer ## _bi_w[idx1][idx2][idx3]  = ff_hevc_put_hevc_bi_w_ ## name ## _ ## D ## _ ## opt
+#define PEL_W_LINKS_8(pointer, my, mx, fname, opt)               \
+        PEL_W_LINK(pointer, 7, my, mx, fname##32, 8, opt);      \
+        PEL_W_LINK(pointer, 8, my, mx, fname##48, 8, opt);      \
+        PEL_W_LINK(pointer, 9, my, mx, fname##64, 8, opt)
+#define PEL_W_LINKS_10(pointer, my, mx, fname, opt)              \
+        PEL_W_LINK(pointer, 5, my, mx, fname##16, 10, opt);     \
+        PEL_W_LINK(pointer, 6, my, mx, fname##24, 10, opt);     \
+        PEL_W_LINK(pointer, 7, my, mx, fname##32, 10, opt);     \
+        PEL_W_LINK(pointer, 8, my, mx, fname##48, 10, opt);     \
+        PEL_W_LINK(pointer, 9, my, mx, fname##64, 10, opt)
+
 void ff_hevc_dsp_init_x86(HEVCDSPContext *c, const int bit_depth)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -868,6 +934,12 @@ void ff_hevc_dsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                 c->put_hevc_qpel_bi[7][1][0] = ff_hevc_put_hevc_bi_qpel_v32_8_avx2;
                 c->put_hevc_qpel_bi[8][1][0] = ff_hevc_put_hevc_bi_qpel_v48_8_avx2;
                 c->put_hevc_qpel_bi[9][1][0] = ff_hevc_put_hevc_bi_qpel_v64_8_avx2;
+
+                PEL_W_LINKS_8(c->put_hevc_epel, 0, 1, epel_h,  avx2);
+                PEL_W_LINKS_8(c->put_hevc_epel, 1, 0, epel_v,  avx2);
+                PEL_W_LINKS_8(c->put_hevc_epel, 1, 1, epel_hv, avx2);
+                PEL_W_LINKS_8(c->put_hevc_qpel, 0, 1, qpel_h,  avx2);
+                PEL_W_LINKS_8(c->put_hevc_qpel, 1, 0, qpel_v,  avx2);
             }
             SAO_BAND_INIT(8, avx2);
 
@@ -1087,6 +1159,13 @@ void ff_hevc_dsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                 c->put_hevc_qpel_bi[7][1][1] = ff_hevc_put_hevc_bi_qpel_hv32_10_avx2;
                 c->put_hevc_qpel_bi[8][1][1] = ff_hevc_put_hevc_bi_qpel_hv48_10_avx2;
                 c->put_hevc_qpel_bi[9][1][1] = ff_hevc_put_hevc_bi_qpel_hv64_10_avx2;
+
+                PEL_W_LINKS_10(c->put_hevc_epel, 0, 1, epel_h,  avx2);
+                PEL_W_LINKS_10(c->put_hevc_epel, 1, 0, epel_v,  avx2);
+                PEL_W_LINKS_10(c->put_hevc_epel, 1, 1, epel_hv, avx2);
+                PEL_W_LINKS_10(c->put_hevc_qpel, 0, 1, qpel_h,  avx2);
+                PEL_W_LINKS_10(c->put_hevc_qpel, 1, 0, qpel_v,  avx2);
+                PEL_W_LINKS_10(c->put_hevc_qpel, 1, 1, qpel_hv, avx2);
             }
             SAO_BAND_INIT(10, avx2);
             SAO_EDGE_INIT(10, avx2);
@@ -29,6 +29,7 @@
 #define IDeckLinkProfileAttributes IDeckLinkAttributes
 #endif
 
+#include "libavutil/fifo.h"
 #include "libavutil/thread.h"
 #include "decklink_common_c.h"
 #if CONFIG_LIBKLVANC
@@ -75,7 +76,7 @@ class decklink_output_callback;
 class decklink_input_callback;
 
 typedef struct AVPacketQueue {
-    AVPacketList *first_pkt, *last_pkt;
+    AVFifoBuffer *fifo; ///< queued AVPackets, only reallocated when full
     int nb_packets;
     unsigned long long size;
     int abort_request;
@@ -55,6 +55,7 @@ struct decklink_cctx {
     char *format_code;
     int raw_format;
     int64_t queue_size;
+    int video_pool_size;
     int copyts;
     int64_t timestamp_align;
     int timing_offset;
@@ -102,28 +102,73 @@ static VANCLineNumber vanc_line_numbers[] = {
     {bmdModeUnknown, 0, -1, -1, -1}
 };
 
+/* Each buffer is preceded by a header holding its size, so that buffers
+ * allocated before a video mode change are not put back into the pool. */
+#define ALLOCATOR_HEADER_SIZE 64
+
 class decklink_allocator : public IDeckLinkMemoryAllocator
 {
 public:
-        decklink_allocator(): _refs(1) { }
-        virtual ~decklink_allocator() { }
+        decklink_allocator(int pool_size): _refs(1), _pool_size(pool_size), _buffer_size(0)
+        {
+            pthread_mutex_init(&_mutex, NULL);
+            _pool.reserve(pool_size);
+        }
+        virtual ~decklink_allocator()
+        {
+            free_pool();
+            pthread_mutex_destroy(&_mutex);
+        }
 
         // IDeckLinkMemoryAllocator methods
         virtual HRESULT STDMETHODCALLTYPE AllocateBuffer(unsigned int bufferSize, void* *allocatedBuffer)
         {
-            void *buf = av_malloc(bufferSize + AV_INPUT_BUFFER_PADDING_SIZE);
+            uint8_t *buf = NULL;
+
+            pthread_mutex_lock(&_mutex);
+            if (bufferSize != _buffer_size) {
+                free_pool_locked();
+                _buffer_size = bufferSize;
+                while (_pool.size() < _pool_size) {
+                    uint8_t *tmp = alloc_buffer(bufferSize);
+                    if (!tmp)
+                        break;
+                    _pool.push_back(tmp);
+                }
+            }
+            if (!_pool.empty()) {
+                buf = _pool.back();
+                _pool.pop_back();
+            }
+            pthread_mutex_unlock(&_mutex);
+
+            if (!buf)
+                buf = alloc_buffer(bufferSize);
             if (!buf)
                 return E_OUTOFMEMORY;
-            *allocatedBuffer = buf;
+            *allocatedBuffer = buf + ALLOCATOR_HEADER_SIZE;
             return S_OK;
         }
         virtual HRESULT STDMETHODCALLTYPE ReleaseBuffer(void* buffer)
         {
-            av_free(buffer);
+            uint8_t *buf = (uint8_t *)buffer - ALLOCATOR_HEADER_SIZE;
+
+            pthread_mutex_lock(&_mutex);
+            if (AV_RN32(buf) == _buffer_size && _pool.size() < _pool_size) {
+                _pool.push_back(buf);
+                buf = NULL;
+            }
+            pthread_mutex_unlock(&_mutex);
+
+            av_free(buf);
             return S_OK;
         }
         virtual HRESULT STDMETHODCALLTYPE Commit() { return S_OK; }
-        virtual HRESULT STDMETHODCALLTYPE Decommit() { return S_OK; }
+        virtual HRESULT STDMETHODCALLTYPE Decommit()
+        {
+            free_pool();
+            return S_OK;
+        }
 
         // IUnknown methods
         virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
@@ -137,7 +182,31 @@ public:
         }
 
 private:
+        static uint8_t *alloc_buffer(unsigned int size)
+        {
+            uint8_t *buf = (uint8_t *)av_malloc(ALLOCATOR_HEADER_SIZE + size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (buf)
+                AV_WN32(buf, size);
+            return buf;
+        }
+        void free_pool_locked()
+        {
+            for (size_t i = 0; i < _pool.size(); i++)
+                av_free(_pool[i]);
+            _pool.clear();
+        }
+        void free_pool()
+        {
+            pthread_mutex_lock(&_mutex);
+            free_pool_locked();
+            pthread_mutex_unlock(&_mutex);
+        }
+
         std::atomic<int>  _refs;
+        size_t _pool_size;
+        unsigned int _buffer_size;
+        std::vector<uint8_t *> _pool;   ///< free buffers of _buffer_size bytes
+        pthread_mutex_t _mutex;
 };
 
 extern "C" {
@@ -468,28 +537,29 @@ skip_packet:
     return tgt;
 }
 
-static void avpacket_queue_init(AVFormatContext *avctx, AVPacketQueue *q)
+static int avpacket_queue_init(AVFormatContext *avctx, AVPacketQueue *q)
 {
     struct decklink_cctx *ctx = (struct decklink_cctx *)avctx->priv_data;
     memset(q, 0, sizeof(AVPacketQueue));
+    q->fifo = av_fifo_alloc_array(64, sizeof(AVPacket));
+    if (!q->fifo)
+        return AVERROR(ENOMEM);
     pthread_mutex_init(&q->mutex, NULL);
     pthread_cond_init(&q->cond, NULL);
     q->avctx = avctx;
     q->max_q_size = ctx->queue_size;
+    return 0;
 }
 
 static void avpacket_queue_flush(AVPacketQueue *q)
 {
-    AVPacketList *pkt, *pkt1;
+    AVPacket pkt;
 
     pthread_mutex_lock(&q->mutex);
-    for (pkt = q->first_pkt; pkt != NULL; pkt = pkt1) {
-        pkt1 = pkt->next;
-        av_packet_unref(&pkt->pkt);
-        av_freep(&pkt);
+    while (av_fifo_size(q->fifo) >= (int)sizeof(pkt)) {
+        av_fifo_generic_read(q->fifo, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
     }
-    q->last_pkt   = NULL;
-    q->first_pkt  = NULL;
     q->nb_packets = 0;
     q->size       = 0;
     pthread_mutex_unlock(&q->mutex);
@@ -497,7 +567,10 @@ static void avpacket_queue_flush(AVPacketQueue *q)
 
 static void avpacket_queue_end(AVPacketQueue *q)
 {
+    if (!q->fifo)
+        return;
     avpacket_queue_flush(q);
+    av_fifo_freep(&q->fifo);
     pthread_mutex_destroy(&q->mutex);
     pthread_cond_destroy(&q->cond);
 }
@@ -513,64 +586,53 @@ static unsigned long long avpacket_queue_size(AVPacketQueue *q)
 
 static int avpacket_queue_put(AVPacketQueue *q, AVPacket *pkt)
 {
-    AVPacketList *pkt1;
+    AVPacket pkt1;
+    int overrun = 0, ret = 0;
 
-    // Drop Packet if queue size is > maximum queue size
-    if (avpacket_queue_size(q) > (uint64_t)q->max_q_size) {
-        av_packet_unref(pkt);
-        av_log(q->avctx, AV_LOG_WARNING,  "Decklink input buffer overrun!\n");
-        return -1;
-    }
     /* ensure the packet is reference counted */
     if (av_packet_make_refcounted(pkt) < 0) {
         av_packet_unref(pkt);
         return -1;
     }
-
-    pkt1 = (AVPacketList *)av_malloc(sizeof(AVPacketList));
-    if (!pkt1) {
-        av_packet_unref(pkt);
-        return -1;
-    }
-    av_packet_move_ref(&pkt1->pkt, pkt);
-    pkt1->next = NULL;
+    av_packet_move_ref(&pkt1, pkt);
 
     pthread_mutex_lock(&q->mutex);
 
-    if (!q->last_pkt) {
-        q->first_pkt = pkt1;
+    // Drop Packet if queue size is > maximum queue size
+    if (q->size > (uint64_t)q->max_q_size) {
+        overrun = 1;
+        ret = -1;
+    } else if (av_fifo_space(q->fifo) < (int)sizeof(pkt1) &&
+               av_fifo_grow(q->fifo, av_fifo_size(q->fifo)) < 0) {
+        ret = -1;
     } else {
-        q->last_pkt->next = pkt1;
+        av_fifo_generic_write(q->fifo, &pkt1, sizeof(pkt1), NULL);
+        q->nb_packets++;
+        q->size += pkt1.size + sizeof(pkt1);
+        pthread_cond_signal(&q->cond);
     }
 
-    q->last_pkt = pkt1;
-    q->nb_packets++;
-    q->size += pkt1->pkt.size + sizeof(*pkt1);
-
-    pthread_cond_signal(&q->cond);
-
     pthread_mutex_unlock(&q->mutex);
-    return 0;
+
+    if (ret < 0) {
+        av_packet_unref(&pkt1);
+        if (overrun)
+            av_log(q->avctx, AV_LOG_WARNING,  "Decklink input buffer overrun!\n");
+    }
+    return ret;
 }
 
 static int avpacket_queue_get(AVPacketQueue *q, AVPacket *pkt, int block)
 {
-    AVPacketList *pkt1;
     int ret;
 
     pthread_mutex_lock(&q->mutex);
 
     for (;; ) {
-        pkt1 = q->first_pkt;
-        if (pkt1) {
-            q->first_pkt = pkt1->next;
-            if (!q->first_pkt) {
-                q->last_pkt = NULL;
-            }
+        if (av_fifo_size(q->fifo) >= (int)sizeof(*pkt)) {
+            av_fifo_generic_read(q->fifo, pkt, sizeof(*pkt), NULL);
             q->nb_packets--;
-            q->size -= pkt1->pkt.size + sizeof(*pkt1);
-            *pkt     = pkt1->pkt;
-            av_free(pkt1);
+            q->size -= pkt->size + sizeof(*pkt);
             ret = 1;
             break;
         } else if (!block) {
@@ -1197,7 +1259,7 @@ av_cold int ff_decklink_read_header(AVFormatContext *avctx)
         goto error;
     }
 
-    allocator = new decklink_allocator();
+    allocator = new decklink_allocator(cctx->video_pool_size);
     ret = (ctx->dli->SetVideoInputFrameMemoryAllocator(allocator) == S_OK ? 0 : AVERROR_EXTERNAL);
     allocator->Release();
     if (ret < 0) {
@@ -1359,7 +1421,9 @@ av_cold int ff_decklink_read_header(AVFormatContext *avctx)
         goto error;
     }
 
-    avpacket_queue_init (avctx, &ctx->queue);
+    ret = avpacket_queue_init(avctx, &ctx->queue);
+    if (ret < 0)
+        goto error;
 
     if (ctx->dli->StartStreams() != S_OK) {
         av_log(avctx, AV_LOG_ERROR, "Cannot start input stream\n");
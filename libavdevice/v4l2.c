@@ -39,6 +39,13 @@
 #include <libv4l2.h>
 #endif
 
+#if CONFIG_LIBDRM
+#include <drm_fourcc.h>
+
+#include "libavutil/hwcontext.h"
+#include "libavutil/hwcontext_drm.h"
+#endif
+
 static const int desired_video_buffers = 256;
 
 #define V4L_ALLFORMATS  3
@@ -103,6 +110,15 @@ struct video_data {
     ssize_t (*read_f)(int fd, void *buffer, size_t n);
     void *(*mmap_f)(void *start, size_t length, int prot, int flags, int fd, int64_t offset);
     int (*munmap_f)(void *_start, size_t length);
+
+    int use_dmabuf;     /**< Set by a private option. */
+    char *drm_device;   /**< Set by a private option. */
+#if CONFIG_LIBDRM
+    int *buf_fd;        /**< DMA-BUF file descriptors of the buffers */
+    AVDRMFrameDescriptor drm_desc; /**< layout shared by all the buffers */
+    AVBufferRef *device_ref;
+    AVBufferRef *frames_ref;
+#endif
 };
 
 struct buff_data {
@@ -428,6 +444,212 @@ static void mmap_release_buffer(void *opaque, uint8_t *data)
     enqueue_buffer(s, &buf);
 }
 
+#if CONFIG_LIBDRM
+static const struct {
+    uint32_t v4l2_fmt;
+    uint32_t drm_format;
+} dmabuf_formats[] = {
+    { V4L2_PIX_FMT_YUYV,    DRM_FORMAT_YUYV     },
+    { V4L2_PIX_FMT_YVYU,    DRM_FORMAT_YVYU     },
+    { V4L2_PIX_FMT_UYVY,    DRM_FORMAT_UYVY     },
+    { V4L2_PIX_FMT_NV12,    DRM_FORMAT_NV12     },
+    { V4L2_PIX_FMT_YUV420,  DRM_FORMAT_YUV420   },
+    { V4L2_PIX_FMT_YVU420,  DRM_FORMAT_YVU420   },
+    { V4L2_PIX_FMT_YUV422P, DRM_FORMAT_YUV422   },
+#ifdef DRM_FORMAT_R8
+    { V4L2_PIX_FMT_GREY,    DRM_FORMAT_R8       },
+#endif
+    { V4L2_PIX_FMT_RGB565,  DRM_FORMAT_RGB565   },
+    { V4L2_PIX_FMT_BGR24,   DRM_FORMAT_RGB888   },
+    { V4L2_PIX_FMT_RGB24,   DRM_FORMAT_BGR888   },
+    { V4L2_PIX_FMT_BGR32,   DRM_FORMAT_XRGB8888 },
+    { V4L2_PIX_FMT_RGB32,   DRM_FORMAT_BGRX8888 },
+};
+
+/**
+ * Export the capture buffers as DMA-BUF file descriptors and create the
+ * DRM frames context the exported frames belong to.
+ */
+static int dmabuf_init(AVFormatContext *ctx, enum AVPixelFormat pix_fmt)
+{
+    struct video_data *s = ctx->priv_data;
+    struct v4l2_format fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    AVDRMLayerDescriptor *layer = &s->drm_desc.layers[0];
+    AVHWFramesContext *frames;
+    uint32_t drm_format = 0;
+    int i, res, offset, linesize0;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(dmabuf_formats); i++) {
+        if (dmabuf_formats[i].v4l2_fmt == s->pixelformat) {
+            drm_format = dmabuf_formats[i].drm_format;
+            break;
+        }
+    }
+    if (!drm_format || !desc) {
+        av_log(ctx, AV_LOG_ERROR, "The pixel format 0x%08X cannot be exported "
+               "as DMA-BUF.\n", s->pixelformat);
+        return AVERROR(EINVAL);
+    }
+
+    if (v4l2_ioctl(s->fd, VIDIOC_G_FMT, &fmt) < 0) {
+        res = AVERROR(errno);
+        av_log(ctx, AV_LOG_ERROR, "ioctl(VIDIOC_G_FMT): %s\n", av_err2str(res));
+        return res;
+    }
+
+    /* the planes follow each other in the single buffer, the chroma pitch
+     * scaled from the luma one like for the system memory layout */
+    layer->format    = drm_format;
+    layer->nb_planes = av_pix_fmt_count_planes(pix_fmt);
+    linesize0        = av_image_get_linesize(pix_fmt, s->width, 0);
+    offset           = 0;
+    for (i = 0; i < layer->nb_planes; i++) {
+        int h = i == 1 || i == 2 ? AV_CEIL_RSHIFT(s->height, desc->log2_chroma_h) : s->height;
+        layer->planes[i].object_index = 0;
+        layer->planes[i].offset       = offset;
+        layer->planes[i].pitch        = (int64_t)fmt.fmt.pix.bytesperline *
+                                        av_image_get_linesize(pix_fmt, s->width, i) / linesize0;
+        offset += layer->planes[i].pitch * h;
+    }
+    s->drm_desc.nb_objects                 = 1;
+    s->drm_desc.objects[0].format_modifier = DRM_FORMAT_MOD_LINEAR;
+    s->drm_desc.nb_layers                  = 1;
+
+    s->buf_fd = av_malloc_array(s->buffers, sizeof(*s->buf_fd));
+    if (!s->buf_fd)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->buffers; i++)
+        s->buf_fd[i] = -1;
+
+    for (i = 0; i < s->buffers; i++) {
+        struct v4l2_exportbuffer expbuf = {
+            .type  = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+            .index = i,
+            .flags = O_RDONLY,
+        };
+        if (v4l2_ioctl(s->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+            res = AVERROR(errno);
+            av_log(ctx, AV_LOG_ERROR, "ioctl(VIDIOC_EXPBUF): %s\n", av_err2str(res));
+            return res;
+        }
+        s->buf_fd[i] = expbuf.fd;
+    }
+
+    res = av_hwdevice_ctx_create(&s->device_ref, AV_HWDEVICE_TYPE_DRM,
+                                 s->drm_device, NULL, 0);
+    if (res < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to open DRM device %s.\n", s->drm_device);
+        return res;
+    }
+
+    s->frames_ref = av_hwframe_ctx_alloc(s->device_ref);
+    if (!s->frames_ref)
+        return AVERROR(ENOMEM);
+    frames = (AVHWFramesContext*)s->frames_ref->data;
+    frames->format    = AV_PIX_FMT_DRM_PRIME;
+    frames->sw_format = pix_fmt;
+    frames->width     = s->width;
+    frames->height    = s->height;
+
+    res = av_hwframe_ctx_init(s->frames_ref);
+    if (res < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Failed to initialise hardware frames context.\n");
+        return res;
+    }
+
+    return 0;
+}
+
+static void dmabuf_close(struct video_data *s)
+{
+    int i;
+
+    if (s->buf_fd) {
+        for (i = 0; i < s->buffers; i++)
+            if (s->buf_fd[i] >= 0)
+                close(s->buf_fd[i]);
+        av_freep(&s->buf_fd);
+    }
+    av_buffer_unref(&s->frames_ref);
+    av_buffer_unref(&s->device_ref);
+}
+
+static void dmabuf_release_buffer(void *opaque, uint8_t *data)
+{
+    av_free(data);
+    mmap_release_buffer(opaque, NULL);
+}
+
+static void dmabuf_free_frame(void *opaque, uint8_t *data)
+{
+    AVFrame *frame = (AVFrame*)data;
+
+    av_frame_free(&frame);
+}
+
+/**
+ * Wrap the dequeued buffer into a DRM PRIME frame, the buffer is queued
+ * again when the frame is freed.
+ */
+static int dmabuf_wrap_buffer(AVFormatContext *ctx, AVPacket *pkt,
+                              struct v4l2_buffer *buf)
+{
+    struct video_data *s = ctx->priv_data;
+    struct buff_data *buf_descriptor;
+    AVDRMFrameDescriptor *desc;
+    AVFrame *frame;
+
+    frame = av_frame_alloc();
+    desc  = av_malloc(sizeof(*desc));
+    buf_descriptor = av_malloc(sizeof(*buf_descriptor));
+    if (!frame || !desc || !buf_descriptor)
+        goto fail;
+
+    *desc = s->drm_desc;
+    desc->objects[0].fd   = s->buf_fd[buf->index];
+    desc->objects[0].size = s->buf_len[buf->index];
+    buf_descriptor->index = buf->index;
+    buf_descriptor->s     = s;
+
+    frame->buf[0] = av_buffer_create((uint8_t*)desc, sizeof(*desc),
+                                     dmabuf_release_buffer, buf_descriptor, 0);
+    if (!frame->buf[0])
+        goto fail;
+    /* from now on, freeing the frame queues the buffer again */
+    desc = NULL;
+    buf_descriptor = NULL;
+
+    frame->hw_frames_ctx = av_buffer_ref(s->frames_ref);
+    if (!frame->hw_frames_ctx)
+        goto fail_frame;
+    frame->data[0] = frame->buf[0]->data;
+    frame->format  = AV_PIX_FMT_DRM_PRIME;
+    frame->width   = s->width;
+    frame->height  = s->height;
+
+    pkt->buf = av_buffer_create((uint8_t*)frame, sizeof(*frame),
+                                dmabuf_free_frame, NULL, 0);
+    if (!pkt->buf)
+        goto fail_frame;
+    pkt->data   = (uint8_t*)frame;
+    pkt->size   = sizeof(*frame);
+    pkt->flags |= AV_PKT_FLAG_TRUSTED;
+
+    return 0;
+
+fail:
+    av_frame_free(&frame);
+    av_free(desc);
+    av_free(buf_descriptor);
+    enqueue_buffer(s, buf);
+    return AVERROR(ENOMEM);
+fail_frame:
+    av_frame_free(&frame);
+    return AVERROR(ENOMEM);
+}
+#endif
+
 #if HAVE_CLOCK_GETTIME && defined(CLOCK_MONOTONIC)
 static int64_t av_gettime_monotonic(void)
 {
@@ -545,6 +767,23 @@ static int mmap_read_frame(AVFormatContext *ctx, AVPacket *pkt)
         }
     }
 
+#if CONFIG_LIBDRM
+    if (s->use_dmabuf) {
+        /* the frames cannot be copied to system memory, drop them instead
+         * when the caller holds too many buffers */
+        if (atomic_load(&s->buffers_queued) == FFMAX(s->buffers / 8, 1)) {
+            av_log(ctx, AV_LOG_WARNING, "Too many DMA-BUF frames are still "
+                   "in use, dropping a frame.\n");
+            res = enqueue_buffer(s, &buf);
+            return res < 0 ? res : AVERROR(EAGAIN);
+        }
+        res = dmabuf_wrap_buffer(ctx, pkt, &buf);
+        if (res < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Failed to wrap a DMA-BUF frame\n");
+            return res;
+        }
+    } else
+#endif
     /* Image is at s->buff_start[buf.index] */
     if (atomic_load(&s->buffers_queued) == FFMAX(s->buffers / 8, 1)) {
         /* when we start getting low on queued buffers, fall back on copying data */
@@ -949,14 +1188,39 @@ static int v4l2_read_header(AVFormatContext *ctx)
         s->frame_size = av_image_get_buffer_size(st->codecpar->format,
                                                  s->width, s->height, 1);
 
-    if ((res = mmap_init(ctx)) ||
-        (res = mmap_start(ctx)) < 0)
+    if (s->use_dmabuf) {
+#if CONFIG_LIBDRM
+        if (codec_id != AV_CODEC_ID_RAWVIDEO) {
+            av_log(ctx, AV_LOG_ERROR, "DMA-BUF export requires a raw video format.\n");
+            res = AVERROR(EINVAL);
             goto fail;
+        }
+#else
+        av_log(ctx, AV_LOG_ERROR, "DMA-BUF export requires libdrm support.\n");
+        res = AVERROR(ENOSYS);
+        goto fail;
+#endif
+    }
+
+    if ((res = mmap_init(ctx)))
+        goto fail;
+#if CONFIG_LIBDRM
+    if (s->use_dmabuf && (res = dmabuf_init(ctx, st->codecpar->format)) < 0)
+        goto fail;
+#endif
+    if ((res = mmap_start(ctx)) < 0)
+        goto fail;
 
     s->top_field_first = first_field(s);
 
     st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
     st->codecpar->codec_id = codec_id;
+#if CONFIG_LIBDRM
+    if (s->use_dmabuf) {
+        st->codecpar->codec_id = AV_CODEC_ID_WRAPPED_AVFRAME;
+        st->codecpar->format   = AV_PIX_FMT_DRM_PRIME;
+    } else
+#endif
     if (codec_id == AV_CODEC_ID_RAWVIDEO)
         st->codecpar->codec_tag =
             avcodec_pix_fmt_to_codec_tag(st->codecpar->format);
@@ -975,6 +1239,9 @@ static int v4l2_read_header(AVFormatContext *ctx)
     return 0;
 
 fail:
+#if CONFIG_LIBDRM
+    dmabuf_close(s);
+#endif
     v4l2_close(s->fd);
     return res;
 }
@@ -1013,6 +1280,9 @@ static int v4l2_read_close(AVFormatContext *ctx)
         av_log(ctx, AV_LOG_WARNING, "Some buffers are still owned by the caller on "
                "close.\n");
 
+#if CONFIG_LIBDRM
+    dmabuf_close(s);
+#endif
     mmap_close(s);
 
     v4l2_close(s->fd);
@@ -1121,6 +1391,8 @@ static const AVOption options[] = {
     { "abs",          "use absolute timestamps (wall clock)",                     OFFSET(ts_mode),      AV_OPT_TYPE_CONST,  {.i64 = V4L_TS_ABS      }, 0, 2, DEC, "timestamps" },
     { "mono2abs",     "force conversion from monotonic to absolute timestamps",   OFFSET(ts_mode),      AV_OPT_TYPE_CONST,  {.i64 = V4L_TS_MONO2ABS }, 0, 2, DEC, "timestamps" },
     { "use_libv4l2",  "use libv4l2 (v4l-utils) conversion functions",             OFFSET(use_libv4l2),  AV_OPT_TYPE_BOOL,   {.i64 = 0}, 0, 1, DEC },
+    { "dmabuf",       "export the capture buffers as DRM PRIME frames",           OFFSET(use_dmabuf),   AV_OPT_TYPE_BOOL,   {.i64 = 0}, 0, 1, DEC },
+    { "drm_device",   "DRM device of the exported frames",                        OFFSET(drm_device),   AV_OPT_TYPE_STRING, {.str = "/dev/dri/renderD128"}, 0, 0, DEC },
     { NULL },
 };
 
@@ -37,6 +37,11 @@
 #include <xcb/shape.h>
 #endif
 
+#if CONFIG_LIBXCB_DAMAGE
+#include <xcb/damage.h>
+#endif
+
+#include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
@@ -73,6 +78,16 @@ typedef struct XCBGrabContext {
     const char *framerate;
 
     int has_shm;
+
+    int track_damage;
+    int64_t damage_refresh;
+#if CONFIG_LIBXCB_DAMAGE
+    xcb_damage_damage_t damage;
+    uint8_t damage_event;
+    int damage_x0, damage_y0, damage_x1, damage_y1;
+    int pointer_x, pointer_y;
+    int64_t last_pts;
+#endif
 } XCBGrabContext;
 
 #define FOLLOW_CENTER -1
@@ -92,6 +107,8 @@ static const AVOption options[] = {
     { "centered", "Keep the mouse pointer at the center of grabbing region when following.", 0, AV_OPT_TYPE_CONST, { .i64 = -1 }, INT_MIN, INT_MAX, D, "follow_mouse" },
     { "show_region", "Show the grabbing region.", OFFSET(show_region), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D },
     { "region_border", "Set the region border thickness.", OFFSET(region_border), AV_OPT_TYPE_INT, { .i64 = 3 }, 1, 128, D },
+    { "damage", "Only grab a frame when the grabbed region changed.", OFFSET(track_damage), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "damage_refresh", "Maximum interval between two frames when tracking damage.", OFFSET(damage_refresh), AV_OPT_TYPE_DURATION, { .i64 = 1000000 }, 0, INT64_MAX, D },
     { NULL },
 };
 
@@ -397,6 +414,116 @@ static void xcbgrab_draw_mouse(AVFormatContext *s, AVPacket *pkt,
 }
 #endif /* CONFIG_LIBXCB_XFIXES */
 
+#if CONFIG_LIBXCB_DAMAGE
+static int check_damage(xcb_connection_t *conn)
+{
+    xcb_damage_query_version_cookie_t cookie;
+    xcb_damage_query_version_reply_t *reply;
+
+    cookie = xcb_damage_query_version(conn, XCB_DAMAGE_MAJOR_VERSION,
+                                      XCB_DAMAGE_MINOR_VERSION);
+    reply  = xcb_damage_query_version_reply(conn, cookie, NULL);
+
+    if (reply) {
+        free(reply);
+        return 1;
+    }
+    return 0;
+}
+
+static void xcbgrab_add_damage(XCBGrabContext *c, int x0, int y0, int x1, int y1)
+{
+    x0 = FFMAX(x0 - c->x, 0);
+    y0 = FFMAX(y0 - c->y, 0);
+    x1 = FFMIN(x1 - c->x, c->width);
+    y1 = FFMIN(y1 - c->y, c->height);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    if (c->damage_x0 >= c->damage_x1) {
+        c->damage_x0 = x0;
+        c->damage_y0 = y0;
+        c->damage_x1 = x1;
+        c->damage_y1 = y1;
+    } else {
+        c->damage_x0 = FFMIN(c->damage_x0, x0);
+        c->damage_y0 = FFMIN(c->damage_y0, y0);
+        c->damage_x1 = FFMAX(c->damage_x1, x1);
+        c->damage_y1 = FFMAX(c->damage_y1, y1);
+    }
+}
+
+/**
+ * Accumulate the damage reported since the last call into the bounding box
+ * of the changed part of the grabbed region.
+ *
+ * @return 1 if a frame has to be grabbed, 0 if it can be skipped
+ */
+static int xcbgrab_poll_damage(AVFormatContext *s,
+                               xcb_query_pointer_reply_t *p, int64_t pts)
+{
+    XCBGrabContext *c = s->priv_data;
+    xcb_generic_event_t *event;
+
+    /* The round trip makes sure every event generated before the damage is
+     * reset has been received, later damage is reported again. */
+    xcb_damage_subtract(c->conn, c->damage, XCB_NONE, XCB_NONE);
+    free(xcb_get_input_focus_reply(c->conn, xcb_get_input_focus(c->conn), NULL));
+
+    while ((event = xcb_poll_for_event(c->conn))) {
+        if ((event->response_type & 0x7f) == c->damage_event + XCB_DAMAGE_NOTIFY) {
+            xcb_damage_notify_event_t *dn = (xcb_damage_notify_event_t *)event;
+            xcbgrab_add_damage(c, dn->area.x, dn->area.y,
+                               dn->area.x + dn->area.width,
+                               dn->area.y + dn->area.height);
+        }
+        free(event);
+    }
+
+    /* The pointer is not part of the screen contents, and moving it
+     * also moves the region when following the mouse. */
+    if (p && (p->root_x != c->pointer_x || p->root_y != c->pointer_y)) {
+        c->pointer_x = p->root_x;
+        c->pointer_y = p->root_y;
+        xcbgrab_add_damage(c, c->x, c->y, c->x + c->width, c->y + c->height);
+    }
+
+    if (c->damage_x0 < c->damage_x1 || c->last_pts == AV_NOPTS_VALUE)
+        return 1;
+    return c->damage_refresh && pts - c->last_pts >= c->damage_refresh;
+}
+
+static int xcbgrab_export_damage(AVFormatContext *s, AVPacket *pkt)
+{
+    XCBGrabContext *c = s->priv_data;
+    AVDictionary *metadata = NULL;
+    uint8_t *side_data;
+    char buf[64];
+    int size, ret;
+
+    if (c->last_pts == AV_NOPTS_VALUE)
+        xcbgrab_add_damage(c, c->x, c->y, c->x + c->width, c->y + c->height);
+    c->last_pts = pkt->pts;
+
+    snprintf(buf, sizeof(buf), "%d,%d,%d,%d", c->damage_x0, c->damage_y0,
+             c->damage_x1 - c->damage_x0, c->damage_y1 - c->damage_y0);
+    c->damage_x0 = c->damage_y0 = c->damage_x1 = c->damage_y1 = 0;
+
+    if ((ret = av_dict_set(&metadata, "lavd.xcbgrab.damage", buf, 0)) < 0)
+        return ret;
+    side_data = av_packet_pack_dictionary(metadata, &size);
+    av_dict_free(&metadata);
+    if (!side_data)
+        return AVERROR(ENOMEM);
+    if ((ret = av_packet_add_side_data(pkt, AV_PKT_DATA_STRINGS_METADATA,
+                                       side_data, size)) < 0) {
+        av_free(side_data);
+        return ret;
+    }
+    return 0;
+}
+#endif /* CONFIG_LIBXCB_DAMAGE */
+
 static void xcbgrab_update_region(AVFormatContext *s)
 {
     XCBGrabContext *c     = s->priv_data;
@@ -419,13 +546,26 @@ static int xcbgrab_read_packet(AVFormatContext *s, AVPacket *pkt)
     int ret = 0;
     int64_t pts;
 
-    pts = wait_frame(s, pkt);
+    for (;;) {
+        pts = wait_frame(s, pkt);
+
+        if (c->follow_mouse || c->draw_mouse) {
+            pc  = xcb_query_pointer(c->conn, c->screen->root);
+            gc  = xcb_get_geometry(c->conn, c->screen->root);
+            p   = xcb_query_pointer_reply(c->conn, pc, NULL);
+            geo = xcb_get_geometry_reply(c->conn, gc, NULL);
+        }
 
-    if (c->follow_mouse || c->draw_mouse) {
-        pc  = xcb_query_pointer(c->conn, c->screen->root);
-        gc  = xcb_get_geometry(c->conn, c->screen->root);
-        p   = xcb_query_pointer_reply(c->conn, pc, NULL);
-        geo = xcb_get_geometry_reply(c->conn, gc, NULL);
+#if CONFIG_LIBXCB_DAMAGE
+        if (c->track_damage && !xcbgrab_poll_damage(s, p, pts)) {
+            free(p);
+            free(geo);
+            p   = NULL;
+            geo = NULL;
+            continue;
+        }
+#endif
+        break;
     }
 
     if (c->follow_mouse && p->same_screen)
@@ -450,6 +590,11 @@ static int xcbgrab_read_packet(AVFormatContext *s, AVPacket *pkt)
         xcbgrab_draw_mouse(s, pkt, p, geo);
 #endif
 
+#if CONFIG_LIBXCB_DAMAGE
+    if (ret >= 0 && c->track_damage)
+        ret = xcbgrab_export_damage(s, pkt);
+#endif
+
     free(p);
     free(geo);
 
@@ -464,6 +609,11 @@ static av_cold int xcbgrab_read_close(AVFormatContext *s)
     av_buffer_pool_uninit(&ctx->shm_pool);
 #endif
 
+#if CONFIG_LIBXCB_DAMAGE
+    if (ctx->damage)
+        xcb_damage_destroy(ctx->conn, ctx->damage);
+#endif
+
     xcb_disconnect(ctx->conn);
 
     return 0;
@@ -727,6 +877,26 @@ static av_cold int xcbgrab_read_header(AVFormatContext *s)
     }
 #endif
 
+    if (c->track_damage) {
+#if CONFIG_LIBXCB_DAMAGE
+        if (check_damage(c->conn)) {
+            c->damage_event = xcb_get_extension_data(c->conn, &xcb_damage_id)->first_event;
+            c->damage       = xcb_generate_id(c->conn);
+            c->last_pts     = AV_NOPTS_VALUE;
+            xcb_damage_create(c->conn, c->damage, c->screen->root,
+                              XCB_DAMAGE_REPORT_LEVEL_BOUNDING_BOX);
+        } else {
+            av_log(s, AV_LOG_WARNING,
+                   "Damage not available, grabbing every frame.\n");
+            c->track_damage = 0;
+        }
+#else
+        av_log(s, AV_LOG_WARNING,
+               "Damage tracking not compiled in, grabbing every frame.\n");
+        c->track_damage = 0;
+#endif
+    }
+
     if (c->show_region)
         setup_window(s);
 
@@ -64,143 +64,185 @@ static void direct(const float *in, const FFTComplex *ir, int len, float *out)
             out[n] += ir[m].re * in[n - m];
 }
 
-static int fir_quantum(AVFilterContext *ctx, AVFrame *out, int ch, int offset)
+static void fir_quantum(AVFilterContext *ctx, AudioFIRSegment *seg, float *ptr,
+                        int ch, int offset, int nb_samples)
 {
     AudioFIRContext *s = ctx->priv;
     const float *in = (const float *)s->in->extended_data[ch] + offset;
-    float *block, *buf, *ptr = (float *)out->extended_data[ch] + offset;
-    const int nb_samples = FFMIN(s->min_part_size, out->nb_samples - offset);
+    float *src = (float *)seg->input->extended_data[ch];
+    float *dst = (float *)seg->output->extended_data[ch];
+    float *sum = (float *)seg->sum->extended_data[ch];
+    float *block, *buf;
     int n, i, j;
 
-    for (int segment = 0; segment < s->nb_segments; segment++) {
-        AudioFIRSegment *seg = &s->seg[segment];
-        float *src = (float *)seg->input->extended_data[ch];
-        float *dst = (float *)seg->output->extended_data[ch];
-        float *sum = (float *)seg->sum->extended_data[ch];
-
-        if (s->min_part_size >= 8) {
-            s->fdsp->vector_fmul_scalar(src + seg->input_offset, in, s->dry_gain, FFALIGN(nb_samples, 4));
-            emms_c();
-        } else {
-            for (n = 0; n < nb_samples; n++)
-                src[seg->input_offset + n] = in[n] * s->dry_gain;
-        }
+    ptr += offset;
 
-        seg->output_offset[ch] += s->min_part_size;
-        if (seg->output_offset[ch] == seg->part_size) {
-            seg->output_offset[ch] = 0;
-        } else {
-            memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
+    if (s->min_part_size >= 8) {
+        s->fdsp->vector_fmul_scalar(src + seg->input_offset, in, s->dry_gain, FFALIGN(nb_samples, 4));
+        emms_c();
+    } else {
+        for (n = 0; n < nb_samples; n++)
+            src[seg->input_offset + n] = in[n] * s->dry_gain;
+    }
 
-            dst += seg->output_offset[ch];
-            for (n = 0; n < nb_samples; n++) {
-                ptr[n] += dst[n];
-            }
-            continue;
+    seg->output_offset[ch] += s->min_part_size;
+    if (seg->output_offset[ch] == seg->part_size) {
+        seg->output_offset[ch] = 0;
+    } else {
+        memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
+
+        dst += seg->output_offset[ch];
+        for (n = 0; n < nb_samples; n++) {
+            ptr[n] += dst[n];
         }
+        return;
+    }
 
-        if (seg->part_size < 8) {
-            memset(dst, 0, sizeof(*dst) * seg->part_size * seg->nb_partitions);
+    if (seg->part_size < 8) {
+        memset(dst, 0, sizeof(*dst) * seg->part_size * seg->nb_partitions);
 
-            j = seg->part_index[ch];
+        j = seg->part_index[ch];
 
-            for (i = 0; i < seg->nb_partitions; i++) {
-                const int coffset = j * seg->coeff_size;
-                const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
+        for (i = 0; i < seg->nb_partitions; i++) {
+            const int coffset = j * seg->coeff_size;
+            const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
 
-                direct(src, coeff, nb_samples, dst);
+            direct(src, coeff, nb_samples, dst);
 
-                if (j == 0)
-                    j = seg->nb_partitions;
-                j--;
-            }
+            if (j == 0)
+                j = seg->nb_partitions;
+            j--;
+        }
 
-            seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
+        seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
 
-            memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
+        memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
 
-            for (n = 0; n < nb_samples; n++) {
-                ptr[n] += dst[n];
-            }
-            continue;
+        for (n = 0; n < nb_samples; n++) {
+            ptr[n] += dst[n];
         }
+        return;
+    }
 
-        memset(sum, 0, sizeof(*sum) * seg->fft_length);
-        block = (float *)seg->block->extended_data[ch] + seg->part_index[ch] * seg->block_size;
-        memset(block + seg->part_size, 0, sizeof(*block) * (seg->fft_length - seg->part_size));
+    memset(sum, 0, sizeof(*sum) * seg->fft_length);
+    block = (float *)seg->block->extended_data[ch] + seg->part_index[ch] * seg->block_size;
+    memset(block + seg->part_size, 0, sizeof(*block) * (seg->fft_length - seg->part_size));
 
-        memcpy(block, src, sizeof(*src) * seg->part_size);
+    memcpy(block, src, sizeof(*src) * seg->part_size);
 
-        av_rdft_calc(seg->rdft[ch], block);
-        block[2 * seg->part_size] = block[1];
-        block[1] = 0;
+    av_rdft_calc(seg->rdft[ch], block);
+    block[2 * seg->part_size] = block[1];
+    block[1] = 0;
 
-        j = seg->part_index[ch];
+    j = seg->part_index[ch];
 
-        for (i = 0; i < seg->nb_partitions; i++) {
-            const int coffset = j * seg->coeff_size;
-            const float *block = (const float *)seg->block->extended_data[ch] + i * seg->block_size;
-            const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
+    for (i = 0; i < seg->nb_partitions; i++) {
+        const int coffset = j * seg->coeff_size;
+        const float *block = (const float *)seg->block->extended_data[ch] + i * seg->block_size;
+        const FFTComplex *coeff = (const FFTComplex *)seg->coeff->extended_data[ch * !s->one2many] + coffset;
 
-            s->afirdsp.fcmul_add(sum, block, (const float *)coeff, seg->part_size);
+        s->afirdsp.fcmul_add(sum, block, (const float *)coeff, seg->part_size);
 
-            if (j == 0)
-                j = seg->nb_partitions;
-            j--;
-        }
+        if (j == 0)
+            j = seg->nb_partitions;
+        j--;
+    }
 
-        sum[1] = sum[2 * seg->part_size];
-        av_rdft_calc(seg->irdft[ch], sum);
+    sum[1] = sum[2 * seg->part_size];
+    av_rdft_calc(seg->irdft[ch], sum);
 
-        buf = (float *)seg->buffer->extended_data[ch];
-        for (n = 0; n < seg->part_size; n++) {
-            buf[n] += sum[n];
-        }
+    buf = (float *)seg->buffer->extended_data[ch];
+    for (n = 0; n < seg->part_size; n++) {
+        buf[n] += sum[n];
+    }
 
-        memcpy(dst, buf, seg->part_size * sizeof(*dst));
+    memcpy(dst, buf, seg->part_size * sizeof(*dst));
 
-        buf = (float *)seg->buffer->extended_data[ch];
-        memcpy(buf, sum + seg->part_size, seg->part_size * sizeof(*buf));
+    buf = (float *)seg->buffer->extended_data[ch];
+    memcpy(buf, sum + seg->part_size, seg->part_size * sizeof(*buf));
 
-        seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
+    seg->part_index[ch] = (seg->part_index[ch] + 1) % seg->nb_partitions;
 
-        memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
+    memmove(src, src + s->min_part_size, (seg->input_size - s->min_part_size) * sizeof(*src));
 
-        for (n = 0; n < nb_samples; n++) {
-            ptr[n] += dst[n];
-        }
+    for (n = 0; n < nb_samples; n++) {
+        ptr[n] += dst[n];
     }
+}
 
-    if (s->min_part_size >= 8) {
-        s->fdsp->vector_fmul_scalar(ptr, ptr, s->wet_gain, FFALIGN(nb_samples, 4));
-        emms_c();
-    } else {
-        for (n = 0; n < nb_samples; n++)
-            ptr[n] *= s->wet_gain;
+static void fir_segment(AVFilterContext *ctx, AudioFIRSegment *seg, float *ptr,
+                        int ch, int nb_samples)
+{
+    AudioFIRContext *s = ctx->priv;
+
+    for (int offset = 0; offset < nb_samples; offset += s->min_part_size) {
+        fir_quantum(ctx, seg, ptr, ch, offset,
+                    FFMIN(s->min_part_size, nb_samples - offset));
     }
+}
+
+typedef struct ThreadData {
+    AVFrame *out;
+    int segments_done;
+} ThreadData;
+
+static int fir_segments(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AudioFIRContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out = td->out;
+    /* largest segments are the most expensive ones, schedule them first */
+    const int segment = s->nb_segments - 1 - jobnr / out->channels;
+    const int ch = jobnr % out->channels;
+    AudioFIRSegment *seg = &s->seg[segment];
+    AVFrame *dst = seg->tmp ? seg->tmp : out;
+
+    fir_segment(ctx, seg, (float *)dst->extended_data[ch], ch, out->nb_samples);
 
     return 0;
 }
 
-static int fir_channel(AVFilterContext *ctx, AVFrame *out, int ch)
+static void fir_channel(AVFilterContext *ctx, ThreadData *td, int ch)
 {
     AudioFIRContext *s = ctx->priv;
+    AVFrame *out = td->out;
+    float *ptr = (float *)out->extended_data[ch];
+    const int nb_samples = out->nb_samples;
+    int n;
+
+    /* accumulate segments always in the same order so that the output
+     * does not depend on the number of threads */
+    for (int segment = 0; segment < s->nb_segments; segment++) {
+        AudioFIRSegment *seg = &s->seg[segment];
+
+        if (!td->segments_done) {
+            fir_segment(ctx, seg, ptr, ch, nb_samples);
+        } else if (seg->tmp) {
+            const float *dst = (const float *)seg->tmp->extended_data[ch];
 
-    for (int offset = 0; offset < out->nb_samples; offset += s->min_part_size) {
-        fir_quantum(ctx, out, ch, offset);
+            for (n = 0; n < nb_samples; n++)
+                ptr[n] += dst[n];
+        }
     }
 
-    return 0;
+    if (s->min_part_size >= 8) {
+        s->fdsp->vector_fmul_scalar(ptr, ptr, s->wet_gain, FFALIGN(nb_samples, 4));
+        emms_c();
+    } else {
+        for (n = 0; n < nb_samples; n++)
+            ptr[n] *= s->wet_gain;
+    }
 }
 
 static int fir_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFrame *out = arg;
+    ThreadData *td = arg;
+    AVFrame *out = td->out;
     const int start = (out->channels * jobnr) / nb_jobs;
     const int end = (out->channels * (jobnr+1)) / nb_jobs;
 
     for (int ch = start; ch < end; ch++) {
-        fir_channel(ctx, out, ch);
+        fir_channel(ctx, td, ch);
     }
 
     return 0;
@@ -209,7 +251,10 @@ static int fir_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 static int fir_frame(AudioFIRContext *s, AVFrame *in, AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
+    const int nb_threads = ff_filter_get_nb_threads(ctx);
     AVFrame *out = NULL;
+    ThreadData td;
+    int ret = 0;
 
     out = ff_get_audio_buffer(outlink, in->nb_samples);
     if (!out) {
@@ -220,15 +265,44 @@ static int fir_frame(AudioFIRContext *s, AVFrame *in, AVFilterLink *outlink)
     if (s->pts == AV_NOPTS_VALUE)
         s->pts = in->pts;
     s->in = in;
-    ctx->internal->execute(ctx, fir_channels, out, NULL, FFMIN(outlink->channels,
-                                                               ff_filter_get_nb_threads(ctx)));
+    td.out = out;
+    td.segments_done = 0;
+
+    /* With fewer channels than threads, also run the segments of each
+     * channel in parallel. Every segment except the first one accumulates
+     * into its own buffer, those are summed up afterwards. */
+    if (nb_threads > outlink->channels && s->nb_segments > 1) {
+        for (int segment = 1; segment < s->nb_segments; segment++) {
+            AudioFIRSegment *seg = &s->seg[segment];
+
+            seg->tmp = ff_get_audio_buffer(outlink, in->nb_samples);
+            if (!seg->tmp) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+
+        ctx->internal->execute(ctx, fir_segments, &td, NULL,
+                               outlink->channels * s->nb_segments);
+        td.segments_done = 1;
+    }
+
+    ctx->internal->execute(ctx, fir_channels, &td, NULL, FFMIN(outlink->channels,
+                                                               nb_threads));
 
     out->pts = s->pts;
     if (s->pts != AV_NOPTS_VALUE)
         s->pts += av_rescale_q(out->nb_samples, (AVRational){1, outlink->sample_rate}, outlink->time_base);
 
+fail:
+    for (int segment = 0; segment < s->nb_segments; segment++)
+        av_frame_free(&s->seg[segment].tmp);
     av_frame_free(&in);
     s->in = NULL;
+    if (ret < 0) {
+        av_frame_free(&out);
+        return ret;
+    }
 
     return ff_filter_frame(outlink, out);
 }
@@ -440,6 +514,7 @@ static void uninit_segment(AVFilterContext *ctx, AudioFIRSegment *seg)
     av_frame_free(&seg->coeff);
     av_frame_free(&seg->input);
     av_frame_free(&seg->output);
+    av_frame_free(&seg->tmp);
     seg->input_size = 0;
 }
 
@@ -49,6 +49,7 @@ typedef struct AudioFIRSegment {
     AVFrame *coeff;
     AVFrame *input;
     AVFrame *output;
+    AVFrame *tmp;
 
     RDFTContext **rdft, **irdft;
 } AudioFIRSegment;
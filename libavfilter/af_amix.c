@@ -174,6 +174,8 @@ typedef struct MixContext {
     float *weights;             /**< custom weights for every input */
     float weight_sum;           /**< sum of custom weights for every input */
     float *scale_norm;          /**< normalization factor for every input */
+    int scales_settled;         /**< scale factors are fixed until an input changes state */
+    AVFrame **in_bufs;          /**< per-input buffers read from the FIFOs */
     int64_t next_pts;           /**< calculated pts for next output frame */
     FrameList *frame_list;      /**< list of frame info for the first input */
 } MixContext;
@@ -212,6 +214,9 @@ static void calculate_scales(MixContext *s, int nb_samples)
     float weight_sum = 0.f;
     int i;
 
+    if (s->scales_settled)
+        return;
+
     for (i = 0; i < s->nb_inputs; i++)
         if (s->input_state[i] & INPUT_ON)
             weight_sum += FFABS(s->weights[i]);
@@ -226,14 +231,63 @@ static void calculate_scales(MixContext *s, int nb_samples)
         }
     }
 
+    s->scales_settled = 1;
     for (i = 0; i < s->nb_inputs; i++) {
-        if (s->input_state[i] & INPUT_ON)
+        if (s->input_state[i] & INPUT_ON) {
             s->input_scale[i] = 1.0f / s->scale_norm[i] * FFSIGN(s->weights[i]);
-        else
+            if (s->scale_norm[i] > weight_sum / FFABS(s->weights[i]))
+                s->scales_settled = 0;
+        } else {
             s->input_scale[i] = 0.0f;
+        }
     }
 }
 
+/* number of samples accumulated from all inputs before moving on,
+ * sized so that one output block stays in L1 while the inputs stream by */
+#define BLOCK_SIZE 1024
+
+typedef struct ThreadData {
+    AVFrame *out;
+    int plane_size;
+    int nb_blocks;
+} ThreadData;
+
+static int mix_blocks(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MixContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out = td->out;
+    const int nb_units = (s->planar ? s->nb_channels : 1) * td->nb_blocks;
+    const int start = (nb_units * jobnr) / nb_jobs;
+    const int end = (nb_units * (jobnr + 1)) / nb_jobs;
+    const int is_float = out->format == AV_SAMPLE_FMT_FLT ||
+                         out->format == AV_SAMPLE_FMT_FLTP;
+
+    for (int u = start; u < end; u++) {
+        const int p = u / td->nb_blocks;
+        const int offset = (u % td->nb_blocks) * BLOCK_SIZE;
+        const int len = FFMIN(BLOCK_SIZE, td->plane_size - offset);
+
+        for (int i = 0; i < s->nb_inputs; i++) {
+            if (!s->in_bufs[i])
+                continue;
+
+            if (is_float) {
+                s->fdsp->vector_fmac_scalar((float *)out->extended_data[p] + offset,
+                                            (float *)s->in_bufs[i]->extended_data[p] + offset,
+                                            s->input_scale[i], len);
+            } else {
+                s->fdsp->vector_dmac_scalar((double *)out->extended_data[p] + offset,
+                                            (double *)s->in_bufs[i]->extended_data[p] + offset,
+                                            s->input_scale[i], len);
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -269,7 +323,8 @@ static int config_output(AVFilterLink *outlink)
 
     s->input_scale = av_mallocz_array(s->nb_inputs, sizeof(*s->input_scale));
     s->scale_norm  = av_mallocz_array(s->nb_inputs, sizeof(*s->scale_norm));
-    if (!s->input_scale || !s->scale_norm)
+    s->in_bufs     = av_mallocz_array(s->nb_inputs, sizeof(*s->in_bufs));
+    if (!s->input_scale || !s->scale_norm || !s->in_bufs)
         return AVERROR(ENOMEM);
     for (i = 0; i < s->nb_inputs; i++)
         s->scale_norm[i] = s->weight_sum / FFABS(s->weights[i]);
@@ -291,8 +346,9 @@ static int output_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
-    int nb_samples, ns, i;
+    AVFrame *out_buf;
+    ThreadData td;
+    int nb_samples, ns, nb_jobs, i, ret = 0;
 
     if (s->input_state[0] & INPUT_ON) {
         /* first input live: use the corresponding frame size */
@@ -336,40 +392,32 @@ static int output_frame(AVFilterLink *outlink)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
-
     for (i = 0; i < s->nb_inputs; i++) {
         if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
-
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
+            s->in_bufs[i] = ff_get_audio_buffer(outlink, nb_samples);
+            if (!s->in_bufs[i]) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            av_audio_fifo_read(s->fifos[i], (void **)s->in_bufs[i]->extended_data,
                                nb_samples);
+        }
+    }
 
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
+    td.out        = out_buf;
+    td.plane_size = FFALIGN(nb_samples * (s->planar ? 1 : s->nb_channels), 16);
+    td.nb_blocks  = (td.plane_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    nb_jobs       = (s->planar ? s->nb_channels : 1) * td.nb_blocks;
+    ctx->internal->execute(ctx, mix_blocks, &td, NULL,
+                           FFMIN(nb_jobs, ff_filter_get_nb_threads(ctx)));
 
-            if (out_buf->format == AV_SAMPLE_FMT_FLT ||
-                out_buf->format == AV_SAMPLE_FMT_FLTP) {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                                (float *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            } else {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p],
-                                                (double *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            }
-        }
+end:
+    for (i = 0; i < s->nb_inputs; i++)
+        av_frame_free(&s->in_bufs[i]);
+    if (ret < 0) {
+        av_frame_free(&out_buf);
+        return ret;
     }
-    av_frame_free(&in_buf);
 
     out_buf->pts = s->next_pts;
     if (s->next_pts != AV_NOPTS_VALUE)
@@ -411,6 +459,8 @@ static int calc_active_inputs(MixContext *s)
     int active_inputs = 0;
     for (i = 0; i < s->nb_inputs; i++)
         active_inputs += !!(s->input_state[i] & INPUT_ON);
+    if (active_inputs != s->active_inputs)
+        s->scales_settled = 0;
     s->active_inputs = active_inputs;
 
     if (!active_inputs ||
@@ -579,6 +629,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->input_state);
     av_freep(&s->input_scale);
     av_freep(&s->scale_norm);
+    av_freep(&s->in_bufs);
     av_freep(&s->weights);
     av_freep(&s->fdsp);
 
@@ -627,6 +678,7 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
     parse_weights(ctx);
     for (int i = 0; i < s->nb_inputs; i++)
         s->scale_norm[i] = s->weight_sum / FFABS(s->weights[i]);
+    s->scales_settled = 0;
     calculate_scales(s, 0);
 
     return 0;
@@ -653,5 +705,6 @@ AVFilter ff_af_amix = {
     .inputs         = NULL,
     .outputs        = avfilter_af_amix_outputs,
     .process_command = process_command,
-    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS |
+                      AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -24,6 +24,8 @@
  * resampling audio filter
  */
 
+#include <float.h>
+
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/opt.h"
@@ -41,6 +43,7 @@ typedef struct AResampleContext {
     struct SwrContext *swr;
     int64_t next_pts;
     int more_data;
+    int direct;         ///< no resampling nor compensation, swr never buffers
 } AResampleContext;
 
 static av_cold int init_dict(AVFilterContext *ctx, AVDictionary **opts)
@@ -140,9 +143,10 @@ static int config_output(AVFilterLink *outlink)
     AVFilterContext *ctx = outlink->src;
     AVFilterLink *inlink = ctx->inputs[0];
     AResampleContext *aresample = ctx->priv;
-    int64_t out_rate, out_layout;
+    int64_t out_rate, out_layout, flags;
     enum AVSampleFormat out_format;
     char inchl_buf[128], outchl_buf[128];
+    double min_comp;
 
     aresample->swr = swr_alloc_set_opts(aresample->swr,
                                         outlink->channel_layout, outlink->format, outlink->sample_rate,
@@ -170,6 +174,14 @@ static int config_output(AVFilterLink *outlink)
 
     aresample->ratio = (double)outlink->sample_rate / inlink->sample_rate;
 
+    /* Without a resampler and timestamp compensation, swr converts the
+     * format and/or the layout of each frame in a single step and keeps
+     * no samples back, so the output frames can be sized exactly. */
+    av_opt_get_double(aresample->swr, "min_comp", 0, &min_comp);
+    av_opt_get_int(aresample->swr, "flags", 0, &flags);
+    aresample->direct = inlink->sample_rate == outlink->sample_rate &&
+                        min_comp >= FLT_MAX / 2 && !(flags & SWR_FLAG_RESAMPLE);
+
     av_get_channel_layout_string(inchl_buf,  sizeof(inchl_buf),  inlink ->channels, inlink ->channel_layout);
     av_get_channel_layout_string(outchl_buf, sizeof(outchl_buf), outlink->channels, outlink->channel_layout);
 
@@ -189,9 +201,13 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamplesref)
     AVFrame *outsamplesref;
     int ret;
 
-    delay = swr_get_delay(aresample->swr, outlink->sample_rate);
-    if (delay > 0)
-        n_out += FFMIN(delay, FFMAX(4096, n_out));
+    if (aresample->direct) {
+        n_out = n_in;
+    } else {
+        delay = swr_get_delay(aresample->swr, outlink->sample_rate);
+        if (delay > 0)
+            n_out += FFMIN(delay, FFMAX(4096, n_out));
+    }
 
     outsamplesref = ff_get_audio_buffer(outlink, n_out);
 
@@ -222,7 +238,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamplesref)
         return 0;
     }
 
-    aresample->more_data = outsamplesref->nb_samples == n_out; // Indicate that there is probably more data in our buffers
+    aresample->more_data = !aresample->direct &&
+                           outsamplesref->nb_samples == n_out; // Indicate that there is probably more data in our buffers
 
     outsamplesref->nb_samples  = n_out;
 
@@ -282,7 +299,7 @@ static int request_frame(AVFilterLink *outlink)
     ret = ff_request_frame(ctx->inputs[0]);
 
     // Third if we hit the end flush
-    if (ret == AVERROR_EOF) {
+    if (ret == AVERROR_EOF && !aresample->direct) {
         AVFrame *outsamplesref;
 
         if ((ret = flush_frame(outlink, 1, &outsamplesref)) < 0)
@@ -20,17 +20,27 @@
 
 /* http://k.ylo.ph/2016/04/04/loudnorm.html */
 
+#include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "avfilter.h"
 #include "internal.h"
 #include "audio.h"
 #include "ebur128.h"
 
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_IO_H
+#include <io.h>
+#endif
+
 enum FrameType {
     FIRST_FRAME,
     INNER_FRAME,
     FINAL_FRAME,
     LINEAR_MODE,
+    MEASURE_MODE,
     FRAME_NB
 };
 
@@ -60,6 +70,7 @@ typedef struct LoudNormContext {
     double measured_thresh;
     double offset;
     int linear;
+    int measure;
     int dual_mono;
     enum PrintFormat print_format;
 
@@ -93,6 +104,9 @@ typedef struct LoudNormContext {
 
     FFEBUR128State *r128_in;
     FFEBUR128State *r128_out;
+
+    int spool_fd;                   ///< temporary file holding the input in measure mode
+    char *spool_filename;           ///< its name, if it could not be unlinked right away
 } LoudNormContext;
 
 #define OFFSET(x) offsetof(LoudNormContext, x)
@@ -114,6 +128,7 @@ static const AVOption loudnorm_options[] = {
     { "measured_thresh",  "measured threshold of input file",  OFFSET(measured_thresh),  AV_OPT_TYPE_DOUBLE,  {.dbl = -70.},   -99.,        0.,  FLAGS },
     { "offset",           "set offset gain",                   OFFSET(offset),           AV_OPT_TYPE_DOUBLE,  {.dbl =  0.},    -99.,       99.,  FLAGS },
     { "linear",           "normalize linearly if possible",    OFFSET(linear),           AV_OPT_TYPE_BOOL,    {.i64 =  1},        0,         1,  FLAGS },
+    { "measure",          "measure the whole input, then normalize it linearly", OFFSET(measure), AV_OPT_TYPE_BOOL, {.i64 =  0},        0,         1,  FLAGS },
     { "dual_mono",        "treat mono input as dual-mono",     OFFSET(dual_mono),        AV_OPT_TYPE_BOOL,    {.i64 =  0},        0,         1,  FLAGS },
     { "print_format",     "set print format for stats",        OFFSET(print_format),     AV_OPT_TYPE_INT,     {.i64 =  NONE},  NONE,  PF_NB -1,  FLAGS, "print_format" },
     {     "none",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  NONE},     0,         0,  FLAGS, "print_format" },
@@ -406,6 +421,106 @@ static void true_peak_limiter(LoudNormContext *s, double *out, int nb_samples, i
     }
 }
 
+static int spool_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    LoudNormContext *s = ctx->priv;
+    const uint8_t *data = in->data[0];
+    int size = in->nb_samples * s->channels * sizeof(double);
+
+    ff_ebur128_add_frames_double(s->r128_in, (const double *)data, in->nb_samples);
+
+    while (size > 0) {
+        int ret = write(s->spool_fd, data, size);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            av_log(ctx, AV_LOG_ERROR, "Failed to write to the measurement file.\n");
+            return ret;
+        }
+        data += ret;
+        size -= ret;
+    }
+
+    return 0;
+}
+
+static int end_measure(AVFilterContext *ctx)
+{
+    LoudNormContext *s = ctx->priv;
+    double global, lra, true_peak = 0., offset;
+    int c;
+
+    ff_ebur128_loudness_global(s->r128_in, &global);
+    ff_ebur128_loudness_range(s->r128_in, &lra);
+    for (c = 0; c < s->channels; c++) {
+        double tmp;
+        ff_ebur128_sample_peak(s->r128_in, c, &tmp);
+        true_peak = FFMAX(true_peak, tmp);
+    }
+
+    offset = isfinite(global) ? pow(10., (s->target_i - global) / 20.) : 1.;
+    if (true_peak * offset > s->target_tp) {
+        av_log(ctx, AV_LOG_WARNING, "Limiting gain to keep the true peak below target.\n");
+        offset = s->target_tp / true_peak;
+    }
+    if (lra > s->target_lra)
+        av_log(ctx, AV_LOG_VERBOSE, "Source LRA %.2f exceeds target LRA.\n", lra);
+
+    s->offset = offset;
+    s->frame_type = LINEAR_MODE;
+
+    if (lseek(s->spool_fd, 0, SEEK_SET) < 0) {
+        int ret = AVERROR(errno);
+        av_log(ctx, AV_LOG_ERROR, "Failed to rewind the measurement file.\n");
+        return ret;
+    }
+
+    return 0;
+}
+
+static int replay_frame(AVFilterContext *ctx)
+{
+    LoudNormContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    const int max_samples = frame_size(outlink->sample_rate, 100);
+    const int sample_size = s->channels * sizeof(double);
+    int size = 0, n, ret;
+    AVFrame *out;
+    double *dst;
+
+    out = ff_get_audio_buffer(outlink, max_samples);
+    if (!out)
+        return AVERROR(ENOMEM);
+
+    while (size < max_samples * sample_size) {
+        ret = read(s->spool_fd, out->data[0] + size, max_samples * sample_size - size);
+        if (ret < 0) {
+            ret = AVERROR(errno);
+            av_log(ctx, AV_LOG_ERROR, "Failed to read from the measurement file.\n");
+            av_frame_free(&out);
+            return ret;
+        }
+        if (!ret)
+            break;
+        size += ret;
+    }
+
+    out->nb_samples = size / sample_size;
+    if (!out->nb_samples) {
+        av_frame_free(&out);
+        return AVERROR_EOF;
+    }
+
+    dst = (double *)out->data[0];
+    for (n = 0; n < out->nb_samples * s->channels; n++)
+        dst[n] *= s->offset;
+    ff_ebur128_add_frames_double(s->r128_out, dst, out->nb_samples);
+
+    out->pts = s->pts;
+    s->pts += out->nb_samples;
+
+    return ff_filter_frame(outlink, out);
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -420,7 +535,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     double gain, gain_next, env_global, env_shortterm,
     global, shortterm, lra, relative_threshold;
 
-    if (av_frame_is_writable(in)) {
+    if (s->frame_type == MEASURE_MODE) {
+        out = in;
+    } else if (av_frame_is_writable(in)) {
         out = in;
     } else {
         out = ff_get_audio_buffer(outlink, in->nb_samples);
@@ -434,6 +551,12 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     if (s->pts == AV_NOPTS_VALUE)
         s->pts = in->pts;
 
+    if (s->frame_type == MEASURE_MODE) {
+        int ret = spool_frame(ctx, in);
+        av_frame_free(&in);
+        return ret;
+    }
+
     out->pts = s->pts;
     src = (const double *)in->data[0];
     dst = (double *)out->data[0];
@@ -644,7 +767,16 @@ static int request_frame(AVFilterLink *outlink)
     AVFilterLink *inlink = ctx->inputs[0];
     LoudNormContext *s = ctx->priv;
 
+    if (s->spool_fd >= 0 && s->frame_type == LINEAR_MODE)
+        return replay_frame(ctx);
+
     ret = ff_request_frame(inlink);
+    if (ret == AVERROR_EOF && s->frame_type == MEASURE_MODE) {
+        ret = end_measure(ctx);
+        if (ret < 0)
+            return ret;
+        return replay_frame(ctx);
+    }
     if (ret == AVERROR_EOF && s->frame_type == INNER_FRAME) {
         double *src;
         double *buf;
@@ -759,7 +891,19 @@ static int config_input(AVFilterLink *inlink)
 
     init_gaussian_filter(s);
 
-    if (s->frame_type != LINEAR_MODE) {
+    if (s->frame_type == MEASURE_MODE) {
+        char *filename;
+
+        s->spool_fd = avpriv_tempfile("ffloudnorm", &filename, 0, ctx);
+        if (s->spool_fd < 0)
+            return s->spool_fd;
+        if (unlink(filename) >= 0)
+            av_freep(&filename);
+        else
+            s->spool_filename = filename;
+    }
+
+    if (s->frame_type != LINEAR_MODE && s->frame_type != MEASURE_MODE) {
         inlink->min_samples =
         inlink->max_samples =
         inlink->partial_buf_size = frame_size(inlink->sample_rate, 3000);
@@ -784,8 +928,11 @@ static av_cold int init(AVFilterContext *ctx)
 {
     LoudNormContext *s = ctx->priv;
     s->frame_type = FIRST_FRAME;
+    s->spool_fd = -1;
 
-    if (s->linear) {
+    if (s->measure) {
+        s->frame_type = MEASURE_MODE;
+    } else if (s->linear) {
         double offset, offset_tp;
         offset    = s->target_i - s->measured_i;
         offset_tp = s->measured_tp + offset;
@@ -898,6 +1045,11 @@ end:
     av_freep(&s->limiter_buf);
     av_freep(&s->prev_smp);
     av_freep(&s->buf);
+    if (s->spool_fd >= 0)
+        close(s->spool_fd);
+    if (s->spool_filename)
+        unlink(s->spool_filename);
+    av_freep(&s->spool_filename);
 }
 
 static const AVFilterPad avfilter_af_loudnorm_inputs[] = {
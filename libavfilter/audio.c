@@ -86,12 +86,14 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 AVFrame *ff_get_audio_buffer(AVFilterLink *link, int nb_samples)
 {
     AVFrame *ret = NULL;
+    int locked = ff_graph_lock(link->graph);
 
     if (link->dstpad->get_audio_buffer)
         ret = link->dstpad->get_audio_buffer(link, nb_samples);
 
     if (!ret)
         ret = ff_default_get_audio_buffer(link, nb_samples);
+    ff_graph_unlock(link->graph, locked);
 
     return ret;
 }
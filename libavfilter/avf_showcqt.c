@@ -100,6 +100,7 @@ static const AVOption showcqt_options[] = {
         { "smpte240m",     "smpte240m", 0,                  AV_OPT_TYPE_CONST, { .i64 = AVCOL_SPC_SMPTE240M },   0, 0, FLAGS, "csp" },
         { "bt2020ncl",     "bt2020ncl", 0,                  AV_OPT_TYPE_CONST, { .i64 = AVCOL_SPC_BT2020_NCL },  0, 0, FLAGS, "csp" },
     { "cscheme",    "set color scheme", OFFSET(cscheme),   AV_OPT_TYPE_STRING, { .str = CSCHEME },   0, 0, FLAGS },
+    { "draw",       "draw the video", OFFSET(draw),          AV_OPT_TYPE_BOOL, { .i64 = 1 },                0, 1,        FLAGS|AV_OPT_FLAG_RUNTIME_PARAM },
     { NULL }
 };
 
@@ -144,6 +145,7 @@ static void common_uninit(ShowCQTContext *s)
 
     av_frame_free(&s->axis_frame);
     av_frame_free(&s->sono_frame);
+    av_frame_free(&s->last_frame);
     av_fft_end(s->fft_ctx);
     s->fft_ctx = NULL;
     if (s->coeffs)
@@ -1033,14 +1035,14 @@ static void draw_sono(AVFrame *out, AVFrame *sono, int off, int idx)
     int inc = (fmt == AV_PIX_FMT_YUV420P) ? 2 : 1;
     int ls, i, y, yh;
 
-    ls = FFMIN(out->linesize[0], sono->linesize[0]);
+    ls = (fmt == AV_PIX_FMT_RGB24) ? 3 * out->width : out->width;
     for (y = 0; y < h; y++) {
         memcpy(out->data[0] + (off + y) * out->linesize[0],
                sono->data[0] + (idx + y) % h * sono->linesize[0], ls);
     }
 
     for (i = 1; i < nb_planes; i++) {
-        ls = FFMIN(out->linesize[i], sono->linesize[i]);
+        ls = (fmt == AV_PIX_FMT_YUV444P) ? out->width : out->width / 2;
         for (y = 0; y < h; y += inc) {
             yh = (fmt == AV_PIX_FMT_YUV420P) ? y / 2 : y;
             memcpy(out->data[i] + (offh + yh) * out->linesize[i],
@@ -1080,6 +1082,78 @@ static void update_sono_yuv(AVFrame *sono, const ColorFloat *c, int idx)
     }
 }
 
+static int cqt_calc_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+    /* the x86-64 kernels store two results at once */
+    const int start = ((s->cqt_len *  jobnr   ) / nb_jobs) & ~1;
+    const int end   = ((s->cqt_len * (jobnr+1)) / nb_jobs) & ~1;
+
+    if (end > start)
+        s->cqt_calc(s->cqt_result + start, s->fft_result, s->coeffs + start,
+                    end - start, s->fft_len);
+    return 0;
+}
+
+enum DrawStep { UPDATE_SONO, DRAW_BAR, DRAW_AXIS, DRAW_SONO };
+
+typedef struct DrawThreadData {
+    AVFrame *out;
+    enum DrawStep step;
+} DrawThreadData;
+
+/* make dst a view of the columns [x, x + w) of src, x is even */
+static void crop_columns(AVFrame *dst, const AVFrame *src, int x, int w)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(src->format);
+    int i;
+
+    *dst = *src;
+    dst->width = w;
+    if (desc->flags & AV_PIX_FMT_FLAG_PLANAR) {
+        for (i = 0; i < 4 && dst->data[i]; i++)
+            dst->data[i] += (i == 1 || i == 2) ? x >> desc->log2_chroma_w : x;
+    } else {
+        dst->data[0] += x * desc->comp[0].step;
+    }
+}
+
+/* the drawing functions are independent between pairs of columns */
+static int draw_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+    DrawThreadData *td = arg;
+    const int start = ((s->width *  jobnr   ) / nb_jobs) & ~1;
+    const int end   = ((s->width * (jobnr+1)) / nb_jobs) & ~1;
+    const ColorFloat *c = s->c_buf + start;
+    AVFrame out, axis, sono;
+
+    if (end <= start)
+        return 0;
+
+    switch (td->step) {
+    case UPDATE_SONO:
+        crop_columns(&sono, s->sono_frame, start, end - start);
+        s->update_sono(&sono, c, s->sono_idx);
+        break;
+    case DRAW_BAR:
+        crop_columns(&out, td->out, start, end - start);
+        s->draw_bar(&out, s->h_buf + start, s->rcp_h_buf + start, c, s->bar_h, s->bar_t);
+        break;
+    case DRAW_AXIS:
+        crop_columns(&out, td->out, start, end - start);
+        crop_columns(&axis, s->axis_frame, start, end - start);
+        s->draw_axis(&out, &axis, c, s->bar_h);
+        break;
+    case DRAW_SONO:
+        crop_columns(&out, td->out, start, end - start);
+        crop_columns(&sono, s->sono_frame, start, end - start);
+        s->draw_sono(&out, &sono, s->bar_h + s->axis_h, s->sono_idx);
+        break;
+    }
+    return 0;
+}
+
 static void process_cqt(ShowCQTContext *s)
 {
     int x, i;
@@ -1130,6 +1204,8 @@ static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
 {
     AVFilterLink *outlink = ctx->outputs[0];
     ShowCQTContext *s = ctx->priv;
+    const int nb_jobs = FFMIN(s->width / 2, ff_filter_get_nb_threads(ctx));
+    DrawThreadData td;
     int64_t last_time, cur_time;
 
 #define UPDATE_TIME(t) \
@@ -1153,18 +1229,30 @@ static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
     s->fft_result[s->fft_len] = s->fft_result[0];
     UPDATE_TIME(s->fft_time);
 
-    s->cqt_calc(s->cqt_result, s->fft_result, s->coeffs, s->cqt_len, s->fft_len);
+    ctx->internal->execute(ctx, cqt_calc_slice, NULL, NULL, nb_jobs);
     UPDATE_TIME(s->cqt_time);
 
     process_cqt(s);
     UPDATE_TIME(s->process_cqt_time);
 
+    /* the sonogram keeps being updated while not drawing, so that it is
+     * complete when drawing resumes */
     if (s->sono_h) {
-        s->update_sono(s->sono_frame, s->c_buf, s->sono_idx);
+        td.step = UPDATE_SONO;
+        ctx->internal->execute(ctx, draw_slice, &td, NULL, nb_jobs);
         UPDATE_TIME(s->update_sono_time);
     }
 
-    if (!s->sono_count) {
+    if (s->draw)
+        av_frame_free(&s->last_frame);
+
+    if (!s->sono_count && s->last_frame) {
+        AVFrame *out = *frameout = av_frame_clone(s->last_frame);
+        if (!out)
+            return AVERROR(ENOMEM);
+        out->pts = s->next_pts;
+        s->next_pts += PTS_STEP;
+    } else if (!s->sono_count) {
         AVFrame *out = *frameout = ff_get_video_buffer(outlink, outlink->w, outlink->h);
         if (!out)
             return AVERROR(ENOMEM);
@@ -1173,22 +1261,32 @@ static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
         out->colorspace = s->csp;
         UPDATE_TIME(s->alloc_time);
 
+        td.out = out;
         if (s->bar_h) {
-            s->draw_bar(out, s->h_buf, s->rcp_h_buf, s->c_buf, s->bar_h, s->bar_t);
+            td.step = DRAW_BAR;
+            ctx->internal->execute(ctx, draw_slice, &td, NULL, nb_jobs);
             UPDATE_TIME(s->bar_time);
         }
 
         if (s->axis_h) {
-            s->draw_axis(out, s->axis_frame, s->c_buf, s->bar_h);
+            td.step = DRAW_AXIS;
+            ctx->internal->execute(ctx, draw_slice, &td, NULL, nb_jobs);
             UPDATE_TIME(s->axis_time);
         }
 
         if (s->sono_h) {
-            s->draw_sono(out, s->sono_frame, s->bar_h + s->axis_h, s->sono_idx);
+            td.step = DRAW_SONO;
+            ctx->internal->execute(ctx, draw_slice, &td, NULL, nb_jobs);
             UPDATE_TIME(s->sono_time);
         }
         out->pts = s->next_pts;
         s->next_pts += PTS_STEP;
+
+        /* the last frame drawn is repeated until drawing is enabled again */
+        if (!s->draw && !(s->last_frame = av_frame_clone(out))) {
+            av_frame_free(frameout);
+            return AVERROR(ENOMEM);
+        }
     }
     s->sono_count = (s->sono_count + 1) % s->count;
     if (s->sono_h)
@@ -1599,4 +1697,6 @@ AVFilter ff_avf_showcqt = {
     .inputs        = showcqt_inputs,
     .outputs       = showcqt_outputs,
     .priv_class    = &showcqt_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+    .process_command = ff_filter_process_command,
 };
@@ -48,6 +48,7 @@ typedef struct ShowCQTContext {
     AVFilterContext     *ctx;
     AVFrame             *axis_frame;
     AVFrame             *sono_frame;
+    AVFrame             *last_frame;    /* repeated while not drawing */
     enum AVPixelFormat  format;
     int                 sono_idx;
     int                 sono_count;
@@ -120,6 +121,7 @@ typedef struct ShowCQTContext {
     int                 axis;
     int                 csp;
     char                *cscheme;
+    int                 draw;
 } ShowCQTContext;
 
 void ff_showcqt_init_x86(ShowCQTContext *s);
@@ -96,6 +96,7 @@ typedef struct ShowSpectrumContext {
     int old_len;
     int single_pic;
     int legend;
+    int draw;                   ///< 0 to keep the analysis running without drawing
     int start_x, start_y;
     int (*plot_channel)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
 } ShowSpectrumContext;
@@ -176,6 +177,7 @@ static const AVOption showspectrum_options[] = {
     { "stop",  "stop frequency",  OFFSET(stop),  AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT32_MAX, FLAGS },
     { "fps",   "set video rate",  OFFSET(rate_str), AV_OPT_TYPE_STRING, {.str = "auto"}, 0, 0, FLAGS },
     { "legend", "draw legend", OFFSET(legend), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
+    { "draw", "draw the spectrum", OFFSET(draw), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS | AV_OPT_FLAG_RUNTIME_PARAM },
     { NULL }
 };
 
@@ -1001,8 +1003,10 @@ static int config_output(AVFilterLink *outlink)
         return AVERROR(EINVAL);
     }
 
-    if (!strcmp(ctx->filter->name, "showspectrumpic"))
+    if (!strcmp(ctx->filter->name, "showspectrumpic")) {
         s->single_pic = 1;
+        s->draw = 1;
+    }
 
     outlink->w = s->w;
     outlink->h = s->h;
@@ -1263,70 +1267,79 @@ static void scale_magnitudes(ShowSpectrumContext *s, float scale)
     }
 }
 
-static void clear_combine_buffer(ShowSpectrumContext *s, int size)
-{
-    int y;
-
-    for (y = 0; y < size; y++) {
-        s->combine_buffer[3 * y    ] = 0;
-        s->combine_buffer[3 * y + 1] = 127.5;
-        s->combine_buffer[3 * y + 2] = 127.5;
-    }
-}
-
-static int plot_spectrum_column(AVFilterLink *inlink, AVFrame *insamples)
+/**
+ * Combine the channel colors of a slice of the new column and copy it to the
+ * output, scrolling the rows of the slice first in vertical orientation.
+ */
+static int draw_column(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
-    AVFilterLink *outlink = ctx->outputs[0];
     ShowSpectrumContext *s = ctx->priv;
     AVFrame *outpicref = s->outpicref;
-    int ret, plane, x, y, z = s->orientation == VERTICAL ? s->h : s->w;
+    const int z = s->orientation == VERTICAL ? s->h : s->w;
+    const int start = (z *  jobnr   ) / nb_jobs;
+    const int end   = (z * (jobnr+1)) / nb_jobs;
+    int plane, x, y;
 
-    /* fill a new spectrum column */
     /* initialize buffer for combining to black */
-    clear_combine_buffer(s, z);
-
-    ctx->internal->execute(ctx, s->plot_channel, NULL, NULL, s->nb_display_channels);
+    for (y = start; y < end; y++) {
+        float *c = &s->combine_buffer[3 * y];
 
-    for (y = 0; y < z * 3; y++) {
+        c[0] = 0;
+        c[1] = 127.5;
+        c[2] = 127.5;
         for (x = 0; x < s->nb_display_channels; x++) {
-            s->combine_buffer[y] += s->color_buffer[x][y];
+            c[0] += s->color_buffer[x][3 * y    ];
+            c[1] += s->color_buffer[x][3 * y + 1];
+            c[2] += s->color_buffer[x][3 * y + 2];
         }
     }
 
-    av_frame_make_writable(s->outpicref);
-    /* copy to output */
     if (s->orientation == VERTICAL) {
-        if (s->sliding == SCROLL) {
-            for (plane = 0; plane < 3; plane++) {
-                for (y = 0; y < s->h; y++) {
-                    uint8_t *p = outpicref->data[plane] + s->start_x +
-                                 (y + s->start_y) * outpicref->linesize[plane];
+        for (plane = 0; plane < 3; plane++) {
+            for (y = start; y < end; y++) {
+                uint8_t *p = outpicref->data[plane] + s->start_x +
+                             (s->start_y + s->h - 1 - y) * outpicref->linesize[plane];
+
+                if (s->sliding == SCROLL)
                     memmove(p, p + 1, s->w - 1);
-                }
-            }
-            s->xpos = s->w - 1;
-        } else if (s->sliding == RSCROLL) {
-            for (plane = 0; plane < 3; plane++) {
-                for (y = 0; y < s->h; y++) {
-                    uint8_t *p = outpicref->data[plane] + s->start_x +
-                                 (y + s->start_y) * outpicref->linesize[plane];
+                else if (s->sliding == RSCROLL)
                     memmove(p + 1, p, s->w - 1);
-                }
+                p[s->xpos] = lrintf(av_clipf(s->combine_buffer[3 * y + plane], 0, 255));
             }
-            s->xpos = 0;
         }
+    } else {
         for (plane = 0; plane < 3; plane++) {
             uint8_t *p = outpicref->data[plane] + s->start_x +
-                         (outlink->h - 1 - s->start_y) * outpicref->linesize[plane] +
-                         s->xpos;
-            for (y = 0; y < s->h; y++) {
-                *p = lrintf(av_clipf(s->combine_buffer[3 * y + plane], 0, 255));
-                p -= outpicref->linesize[plane];
-            }
+                         (s->xpos + s->start_y) * outpicref->linesize[plane];
+            for (x = start; x < end; x++)
+                p[x] = lrintf(av_clipf(s->combine_buffer[3 * x + plane], 0, 255));
         }
-    } else {
-        if (s->sliding == SCROLL) {
+    }
+
+    return 0;
+}
+
+static int plot_spectrum_column(AVFilterLink *inlink, AVFrame *insamples)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ShowSpectrumContext *s = ctx->priv;
+    AVFrame *outpicref = s->outpicref;
+    int ret, plane, y, z = s->orientation == VERTICAL ? s->h : s->w;
+
+    if (s->sliding == SCROLL)
+        s->xpos = s->orientation == VERTICAL ? s->w - 1 : s->h - 1;
+    else if (s->sliding == RSCROLL)
+        s->xpos = 0;
+
+    if (s->draw) {
+        /* fill a new spectrum column */
+        ctx->internal->execute(ctx, s->plot_channel, NULL, NULL, s->nb_display_channels);
+
+        av_frame_make_writable(s->outpicref);
+        /* rows are moved into their neighbours, so the horizontal scrolling
+         * is not sliced */
+        if (s->orientation == HORIZONTAL && s->sliding == SCROLL) {
             for (plane = 0; plane < 3; plane++) {
                 for (y = 1; y < s->h; y++) {
                     memmove(outpicref->data[plane] + (y-1 + s->start_y) * outpicref->linesize[plane] + s->start_x,
@@ -1334,8 +1347,7 @@ static int plot_spectrum_column(AVFilterLink *inlink, AVFrame *insamples)
                             s->w);
                 }
             }
-            s->xpos = s->h - 1;
-        } else if (s->sliding == RSCROLL) {
+        } else if (s->orientation == HORIZONTAL && s->sliding == RSCROLL) {
             for (plane = 0; plane < 3; plane++) {
                 for (y = s->h - 1; y >= 1; y--) {
                     memmove(outpicref->data[plane] + (y   + s->start_y) * outpicref->linesize[plane] + s->start_x,
@@ -1343,16 +1355,9 @@ static int plot_spectrum_column(AVFilterLink *inlink, AVFrame *insamples)
                             s->w);
                 }
             }
-            s->xpos = 0;
-        }
-        for (plane = 0; plane < 3; plane++) {
-            uint8_t *p = outpicref->data[plane] + s->start_x +
-                         (s->xpos + s->start_y) * outpicref->linesize[plane];
-            for (x = 0; x < s->w; x++) {
-                *p = lrintf(av_clipf(s->combine_buffer[3 * x + plane], 0, 255));
-                p++;
-            }
         }
+        ctx->internal->execute(ctx, draw_column, NULL, NULL,
+                               FFMIN(z, ff_filter_get_nb_threads(ctx)));
     }
 
     if (s->sliding != FULLFRAME || s->xpos == 0)
@@ -1367,8 +1372,8 @@ static int plot_spectrum_column(AVFilterLink *inlink, AVFrame *insamples)
         if (s->old_pts < outpicref->pts) {
             AVFrame *clone;
 
-            if (s->legend) {
-                char *units = get_time(ctx, insamples->pts /(float)inlink->sample_rate, x);
+            if (s->legend && s->draw) {
+                char *units = get_time(ctx, insamples->pts /(float)inlink->sample_rate, 1);
                 if (!units)
                     return AVERROR(ENOMEM);
 
@@ -1537,6 +1542,7 @@ AVFilter ff_avf_showspectrum = {
     .activate      = activate,
     .priv_class    = &showspectrum_class,
     .flags         = AVFILTER_FLAG_SLICE_THREADS,
+    .process_command = ff_filter_process_command,
 };
 #endif // CONFIG_SHOWSPECTRUM_FILTER
 
@@ -33,6 +33,8 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libavutil/trace_internal.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -42,6 +44,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "internal.h"
+#include "video.h"
 
 #include "libavutil/ffversion.h"
 const char av_filter_ffversion[] = "FFmpeg version " FFMPEG_VERSION;
@@ -192,7 +195,12 @@ int avfilter_link_get_channels(AVFilterLink *link)
 
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
+    int locked = ff_graph_lock(filter->graph);
+
     filter->ready = FFMAX(filter->ready, priority);
+    if (filter->graph && filter->graph->internal->pipeline)
+        ff_graph_pipeline_signal(filter->graph);
+    ff_graph_unlock(filter->graph, locked);
 }
 
 /**
@@ -210,8 +218,11 @@ static void filter_unblock(AVFilterContext *filter)
 
 void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
 {
+    int locked;
+
     if (link->status_in == status)
         return;
+    locked = ff_graph_lock(link->graph);
     av_assert0(!link->status_in);
     link->status_in = status;
     link->status_in_pts = pts;
@@ -219,10 +230,13 @@ void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
     link->frame_blocked_in = 0;
     filter_unblock(link->dst);
     ff_filter_set_ready(link->dst, 200);
+    ff_graph_unlock(link->graph, locked);
 }
 
 void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
 {
+    int locked = ff_graph_lock(link->graph);
+
     av_assert0(!link->frame_wanted_out);
     av_assert0(!link->status_out);
     link->status_out = status;
@@ -230,6 +244,7 @@ void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts
         ff_update_link_current_pts(link, pts);
     filter_unblock(link->dst);
     ff_filter_set_ready(link->src, 200);
+    ff_graph_unlock(link->graph, locked);
 }
 
 void avfilter_link_set_closed(AVFilterLink *link, int closed)
@@ -237,6 +252,39 @@ void avfilter_link_set_closed(AVFilterLink *link, int closed)
     ff_avfilter_link_set_out_status(link, closed ? AVERROR_EOF : 0, AV_NOPTS_VALUE);
 }
 
+int avfilter_link_get_stats(const AVFilterLink *link, AVFilterLinkStats *stats)
+{
+    if (!link || !stats)
+        return AVERROR(EINVAL);
+
+    stats->frames     = link->frame_count_in;
+    stats->queued     = ff_framequeue_queued_frames(&link->fifo);
+    stats->max_queued = link->max_queued;
+    stats->avg_queued = link->frame_count_in ?
+                        (double)link->queued_sum / link->frame_count_in : 0;
+    return 0;
+}
+
+int avfilter_get_stats(const AVFilterContext *ctx, AVFilterStats *stats)
+{
+    unsigned i;
+
+    if (!ctx || !stats)
+        return AVERROR(EINVAL);
+
+    stats->nb_activations = ctx->internal->nb_activations;
+    stats->activate_time  = ctx->internal->activate_time;
+    stats->frames_in      = 0;
+    stats->frames_out     = 0;
+    for (i = 0; i < ctx->nb_inputs; i++)
+        if (ctx->inputs[i])
+            stats->frames_in += ctx->inputs[i]->frame_count_out;
+    for (i = 0; i < ctx->nb_outputs; i++)
+        if (ctx->outputs[i])
+            stats->frames_out += ctx->outputs[i]->frame_count_in;
+    return 0;
+}
+
 int avfilter_insert_filter(AVFilterLink *link, AVFilterContext *filt,
                            unsigned filt_srcpad_idx, unsigned filt_dstpad_idx)
 {
@@ -380,6 +428,53 @@ int avfilter_config_links(AVFilterContext *filter)
     return 0;
 }
 
+int ff_filter_link_reconfigure(AVFilterLink *link)
+{
+    AVFilterContext *dst = link->dst;
+    unsigned i;
+    int ret;
+
+    if (!(dst->filter->flags_internal & FF_FILTER_FLAG_RECONFIGURABLE)) {
+        av_log(dst, AV_LOG_VERBOSE, "Filter %s cannot be reconfigured in place\n",
+               dst->filter->name);
+        return AVERROR(ENOSYS);
+    }
+
+    if (link->dstpad->config_props && (ret = link->dstpad->config_props(link)) < 0)
+        return ret;
+
+    for (i = 0; i < dst->nb_outputs; i++) {
+        AVFilterLink *out = dst->outputs[i];
+        int w, h;
+        AVRational sar;
+
+        if (!out)
+            continue;
+        w   = out->w;
+        h   = out->h;
+        sar = out->sample_aspect_ratio;
+
+        /* the defaults of avfilter_config_links() */
+        out->w                   = dst->inputs[0]->w;
+        out->h                   = dst->inputs[0]->h;
+        out->sample_aspect_ratio = dst->inputs[0]->sample_aspect_ratio;
+        if (out->srcpad->config_props && (ret = out->srcpad->config_props(out)) < 0) {
+            av_log(dst, AV_LOG_ERROR, "Failed to reconfigure output pad on %s\n",
+                   dst->name);
+            return ret;
+        }
+
+        if (out->w == w && out->h == h && !av_cmp_q(out->sample_aspect_ratio, sar))
+            continue;
+        av_log(dst, AV_LOG_VERBOSE, "Output %d reconfigured from %dx%d to %dx%d\n",
+               i, w, h, out->w, out->h);
+        if ((ret = ff_filter_link_reconfigure(out)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 void ff_tlog_link(void *ctx, AVFilterLink *link, int end)
 {
     if (link->type == AVMEDIA_TYPE_VIDEO) {
@@ -404,9 +499,8 @@ void ff_tlog_link(void *ctx, AVFilterLink *link, int end)
     }
 }
 
-int ff_request_frame(AVFilterLink *link)
+static int request_frame(AVFilterLink *link)
 {
-    FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
 
     av_assert1(!link->dst->filter->activate);
     if (link->status_out)
@@ -429,6 +523,18 @@ int ff_request_frame(AVFilterLink *link)
     return 0;
 }
 
+int ff_request_frame(AVFilterLink *link)
+{
+    int locked, ret;
+
+    FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
+
+    locked = ff_graph_lock(link->graph);
+    ret = request_frame(link);
+    ff_graph_unlock(link->graph, locked);
+    return ret;
+}
+
 static int64_t guess_status_pts(AVFilterContext *ctx, int status, AVRational link_time_base)
 {
     unsigned i;
@@ -1062,7 +1168,7 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     int (*filter_frame)(AVFilterLink *, AVFrame *);
     AVFilterContext *dstctx = link->dst;
     AVFilterPad *dst = link->dstpad;
-    int ret;
+    int left, ret;
 
     if (!(filter_frame = dst->filter_frame))
         filter_frame = default_filter_frame;
@@ -1079,7 +1185,9 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     if (dstctx->is_disabled &&
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
+    left = ff_graph_pipeline_leave(dstctx->graph);
     ret = filter_frame(link, frame);
+    ff_graph_pipeline_enter(dstctx->graph, left);
     link->frame_count_out++;
     return ret;
 
@@ -1088,7 +1196,7 @@ fail:
     return ret;
 }
 
-int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+static int filter_frame(AVFilterLink *link, AVFrame *frame)
 {
     int ret;
     FF_TPRINTF_START(NULL, filter_frame); ff_tlog_link(NULL, link, 1); ff_tlog(NULL, " "); ff_tlog_ref(NULL, frame, 1);
@@ -1131,6 +1239,11 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         av_frame_free(&frame);
         return ret;
     }
+    if (link->graph && link->graph->stats) {
+        int queued = ff_framequeue_queued_frames(&link->fifo);
+        link->max_queued  = FFMAX(link->max_queued, queued);
+        link->queued_sum += queued;
+    }
     ff_filter_set_ready(link->dst, 300);
     return 0;
 
@@ -1139,6 +1252,15 @@ error:
     return AVERROR_PATCHWELCOME;
 }
 
+int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
+{
+    int locked = ff_graph_lock(link->graph);
+    int ret = filter_frame(link, frame);
+
+    ff_graph_unlock(link->graph, locked);
+    return ret;
+}
+
 static int samples_ready(AVFilterLink *link, unsigned min)
 {
     return ff_framequeue_queued_frames(&link->fifo) &&
@@ -1431,14 +1553,28 @@ static int ff_filter_activate_default(AVFilterContext *filter)
 
 int ff_filter_activate(AVFilterContext *filter)
 {
+    int stats = filter->graph && filter->graph->stats;
+    const AVClass *mem_class;
+    int64_t start = 0;
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
     filter->ready = 0;
+    if (stats)
+        start = av_gettime_relative();
+    mem_class = av_mem_set_class(filter->filter->priv_class ?
+                                 filter->filter->priv_class : filter->av_class);
+    avpriv_trace_begin("lavfi", filter->filter->name, AV_NOPTS_VALUE, -1);
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           ff_filter_activate_default(filter);
+    avpriv_trace_end("lavfi", filter->filter->name, AV_NOPTS_VALUE, -1);
+    av_mem_set_class(mem_class);
+    if (stats) {
+        filter->internal->activate_time += av_gettime_relative() - start;
+        filter->internal->nb_activations++;
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
@@ -1564,8 +1700,11 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
 
     switch (link->type) {
     case AVMEDIA_TYPE_VIDEO:
-        av_image_copy(out->data, out->linesize, (const uint8_t **)frame->data, frame->linesize,
-                      frame->format, frame->width, frame->height);
+        ret = ff_video_frame_copy(link->dst, out, frame);
+        if (ret < 0) {
+            av_frame_free(&out);
+            return ret;
+        }
         break;
     case AVMEDIA_TYPE_AUDIO:
         av_samples_copy(out->extended_data, frame->extended_data,
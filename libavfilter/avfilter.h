@@ -642,6 +642,14 @@ struct AVFilterLink {
      */
     int status_out;
 
+    /**
+     * Largest number of frames queued in fifo and the sum of the queue
+     * depths seen after each queued frame, updated when the graph collects
+     * statistics.
+     */
+    int max_queued;
+    int64_t queued_sum;
+
 #endif /* FF_INTERNAL_FIELDS */
 
 };
@@ -907,6 +915,14 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    int pipeline_threads; ///< number of threads running the filters concurrently, Access ONLY through AVOptions
+    int stats; ///< collect filter and link statistics, Access ONLY through AVOptions
+
+    int64_t frame_pool_size;      ///< bytes retained by the graph frame pool, Access ONLY through AVOptions
+    int64_t frame_pool_idle_time; ///< time before the unused pooled frames are freed, Access ONLY through AVOptions
+
+    int numa_node; ///< NUMA node to run the filter threads on, -1 for any, Access ONLY through AVOptions
 } AVFilterGraph;
 
 /**
@@ -976,6 +992,42 @@ enum {
     AVFILTER_AUTO_CONVERT_NONE = -1, /**< all automatic conversions disabled */
 };
 
+/**
+ * Processing statistics of a filter instance. The timing is only collected
+ * when the "stats" option of the graph is set.
+ */
+typedef struct AVFilterStats {
+    int64_t nb_activations; ///< number of times the filter was activated
+    int64_t activate_time;  ///< wall clock time spent in the filter, in microseconds
+    int64_t frames_in;      ///< frames consumed from all the inputs
+    int64_t frames_out;     ///< frames sent to all the outputs
+} AVFilterStats;
+
+/**
+ * Statistics of the frame queue of a link. The queue depths are only
+ * collected when the "stats" option of the graph is set.
+ */
+typedef struct AVFilterLinkStats {
+    int64_t frames;         ///< frames sent through the link
+    int     queued;         ///< frames currently queued
+    int     max_queued;     ///< largest number of frames queued at once
+    double  avg_queued;     ///< average number of frames queued after each frame was sent
+} AVFilterLinkStats;
+
+/**
+ * Get the processing statistics of a filter.
+ *
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int avfilter_get_stats(const AVFilterContext *ctx, AVFilterStats *stats);
+
+/**
+ * Get the frame queue statistics of a link.
+ *
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int avfilter_link_get_stats(const AVFilterLink *link, AVFilterLinkStats *stats);
+
 /**
  * Check validity and configure all the links and formats in the graph.
  *
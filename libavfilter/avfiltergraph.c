@@ -56,6 +56,16 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "pipeline_threads", "Number of threads running the filters concurrently", OFFSET(pipeline_threads),
+        AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
+    { "stats",       "Collect filter and link statistics", OFFSET(stats),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
+    { "frame_pool_size", "Maximum bytes of video frames retained for all the links", OFFSET(frame_pool_size),
+        AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, F|V },
+    { "frame_pool_idle_time", "Free the pooled video frames unused for this time", OFFSET(frame_pool_idle_time),
+        AV_OPT_TYPE_DURATION, { .i64 = 1000000 }, 0, INT64_MAX, F|V },
+    { "numa_node", "NUMA node to run the filter threads on", OFFSET(numa_node),
+        AV_OPT_TYPE_INT,   { .i64 = -1 }, -1, INT_MAX, F|V|A },
     { NULL },
 };
 
@@ -80,6 +90,55 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 }
 #endif
 
+#if !HAVE_PTHREADS
+int ff_graph_pipeline_init(AVFilterGraph *graph)
+{
+    if (graph->pipeline_threads > 0)
+        av_log(graph, AV_LOG_WARNING, "Pipeline threads are not supported in this build.\n");
+    return 0;
+}
+
+void ff_graph_pipeline_free(AVFilterGraph *graph)
+{
+}
+
+int ff_graph_lock(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_unlock(AVFilterGraph *graph, int locked)
+{
+}
+
+int ff_graph_pipeline_leave(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_pipeline_enter(AVFilterGraph *graph, int left)
+{
+}
+
+void ff_graph_pipeline_signal(AVFilterGraph *graph)
+{
+}
+
+int ff_graph_pipeline_run_once(AVFilterGraph *graph)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_graph_pipeline_wait(AVFilterGraph *graph, int drain)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_filter_wait_idle(AVFilterContext *ctx)
+{
+}
+#endif
+
 AVFilterGraph *avfilter_graph_alloc(void)
 {
     AVFilterGraph *ret = av_mallocz(sizeof(*ret));
@@ -122,10 +181,13 @@ void avfilter_graph_free(AVFilterGraph **graph)
     if (!*graph)
         return;
 
+    ff_graph_pipeline_free(*graph);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    ff_graph_frame_pool_uninit(&(*graph)->internal->frame_pool);
 
     av_freep(&(*graph)->sink_links);
 
@@ -1282,6 +1344,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = ff_graph_pipeline_init(graphctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -1305,7 +1369,10 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if (!strcmp(target, "all") || (filter->name && !strcmp(target, filter->name)) || !strcmp(target, filter->filter->name)) {
+            int locked = ff_graph_lock(graph);
+            ff_filter_wait_idle(filter);
             r = avfilter_process_command(filter, cmd, arg, res, res_len, flags);
+            ff_graph_unlock(graph, locked);
             if (r != AVERROR(ENOSYS)) {
                 if ((flags & AVFILTER_CMD_FLAG_ONE) || r < 0)
                     return r;
@@ -1318,11 +1385,12 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
 
 int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
 {
-    int i;
+    int i, locked, ret = 0;
 
     if(!graph)
         return 0;
 
+    locked = ff_graph_lock(graph);
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         if(filter && (!strcmp(target, "all") || !strcmp(target, filter->name) || !strcmp(target, filter->filter->name))){
@@ -1331,8 +1399,10 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
                 queue = &(*queue)->next;
             next = *queue;
             *queue = av_mallocz(sizeof(AVFilterCommand));
-            if (!*queue)
-                return AVERROR(ENOMEM);
+            if (!*queue) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
 
             (*queue)->command = av_strdup(command);
             (*queue)->arg     = av_strdup(arg);
@@ -1340,11 +1410,12 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
             (*queue)->flags   = flags;
             (*queue)->next    = next;
             if(flags & AVFILTER_CMD_FLAG_ONE)
-                return 0;
+                break;
         }
     }
+    ff_graph_unlock(graph, locked);
 
-    return 0;
+    return ret;
 }
 
 static void heap_bubble_up(AVFilterGraph *graph,
@@ -1396,7 +1467,7 @@ void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
     heap_bubble_down(graph, link, link->age_index);
 }
 
-int avfilter_graph_request_oldest(AVFilterGraph *graph)
+static int graph_request_oldest(AVFilterGraph *graph)
 {
     AVFilterLink *oldest = graph->sink_links[0];
     int64_t frame_count;
@@ -1441,12 +1512,23 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+int avfilter_graph_request_oldest(AVFilterGraph *graph)
+{
+    int locked = ff_graph_lock(graph);
+    int ret = graph_request_oldest(graph);
+
+    ff_graph_unlock(graph, locked);
+    return ret;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
     unsigned i;
 
     av_assert0(graph->nb_filters);
+    if (graph->internal->pipeline)
+        return ff_graph_pipeline_run_once(graph);
     filter = graph->filters[0];
     for (i = 1; i < graph->nb_filters; i++)
         if (graph->filters[i]->ready > filter->ready)
@@ -58,6 +58,9 @@ typedef struct BufferSinkContext {
     int sample_rates_size;
 
     AVFrame *peeked_frame;
+
+    int (*get_buffer)(AVFilterContext *ctx, AVFrame *frame, void *opaque);
+    void *get_buffer_opaque;
 } BufferSinkContext;
 
 #define NB_ITEMS(list) (list ## _size / sizeof(*list))
@@ -98,7 +101,6 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
         if (ret < 0) {
             return ret;
         } else if (ret) {
-            /* TODO return the frame instead of copying it */
             return return_or_keep_frame(buf, frame, cur_frame, flags);
         } else if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
             return status;
@@ -114,15 +116,24 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
     }
 }
 
+static int get_frame_locked(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
+{
+    int locked = ff_graph_lock(ctx->graph);
+    int ret = get_frame_internal(ctx, frame, flags, samples);
+
+    ff_graph_unlock(ctx->graph, locked);
+    return ret;
+}
+
 int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
-    return get_frame_internal(ctx, frame, flags, ctx->inputs[0]->min_samples);
+    return get_frame_locked(ctx, frame, flags, ctx->inputs[0]->min_samples);
 }
 
 int attribute_align_arg av_buffersink_get_samples(AVFilterContext *ctx,
                                                   AVFrame *frame, int nb_samples)
 {
-    return get_frame_internal(ctx, frame, 0, nb_samples);
+    return get_frame_locked(ctx, frame, 0, nb_samples);
 }
 
 #if FF_API_NEXT
@@ -180,6 +191,47 @@ void av_buffersink_set_frame_size(AVFilterContext *ctx, unsigned frame_size)
     inlink->partial_buf_size = frame_size;
 }
 
+void av_buffersink_set_get_buffer(AVFilterContext *ctx,
+                                  int (*get_buffer)(AVFilterContext *ctx,
+                                                    AVFrame *frame, void *opaque),
+                                  void *opaque)
+{
+    BufferSinkContext *buf = ctx->priv;
+
+    av_assert0(ctx->filter->activate == activate &&
+               ctx->filter->inputs[0].type == AVMEDIA_TYPE_VIDEO);
+    buf->get_buffer        = get_buffer;
+    buf->get_buffer_opaque = opaque;
+}
+
+static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
+{
+    AVFilterContext *ctx = inlink->dst;
+    BufferSinkContext *buf = ctx->priv;
+    AVFrame *frame;
+    int ret;
+
+    /* NULL makes ff_get_video_buffer() use the default allocator */
+    if (!buf->get_buffer || inlink->hw_frames_ctx)
+        return NULL;
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+    frame->width               = w;
+    frame->height              = h;
+    frame->format              = inlink->format;
+    frame->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    ret = buf->get_buffer(ctx, frame, buf->get_buffer_opaque);
+    if (ret < 0 || !frame->buf[0]) {
+        if (ret < 0)
+            av_log(ctx, AV_LOG_WARNING, "get_buffer() failed: %s\n", av_err2str(ret));
+        av_frame_free(&frame);
+    }
+    return frame;
+}
+
 #define MAKE_AVFILTERLINK_ACCESSOR(type, field) \
 type av_buffersink_get_##field(const AVFilterContext *ctx) { \
     av_assert0(ctx->filter->activate == activate); \
@@ -305,8 +357,9 @@ AVFILTER_DEFINE_CLASS(abuffersink);
 
 static const AVFilterPad avfilter_vsink_buffer_inputs[] = {
     {
-        .name = "default",
-        .type = AVMEDIA_TYPE_VIDEO,
+        .name             = "default",
+        .type             = AVMEDIA_TYPE_VIDEO,
+        .get_video_buffer = get_video_buffer,
     },
     { NULL }
 };
@@ -321,6 +374,7 @@ AVFilter ff_vsink_buffer = {
     .activate      = activate,
     .inputs        = avfilter_vsink_buffer_inputs,
     .outputs       = NULL,
+    .flags_internal = FF_FILTER_FLAG_RECONFIGURABLE,
 };
 
 static const AVFilterPad avfilter_asink_abuffer_inputs[] = {
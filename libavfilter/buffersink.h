@@ -104,6 +104,38 @@ AVABufferSinkParams *av_abuffersink_params_alloc(void);
  */
 void av_buffersink_set_frame_size(AVFilterContext *ctx, unsigned frame_size);
 
+/**
+ * Set the allocator of the frames returned by a video buffer sink.
+ *
+ * The callback is invoked whenever the filter feeding the sink, or the last
+ * filter allocating frames before a chain of pass-through filters, needs an
+ * output frame, so the graph writes its output directly to memory owned by the
+ * caller, e.g. a shared memory segment. The frames are returned by
+ * av_buffersink_get_frame() without any copy. Frames forwarded unchanged from
+ * the buffer source keep the buffers they were added with.
+ *
+ * On entry, frame->width, height, format and sample_aspect_ratio are set. As
+ * with AVCodecContext.get_buffer2(), the callback must set frame->buf[] to
+ * reference counted buffers, created with av_buffer_create() for foreign
+ * memory, and frame->data[] and linesize[]. The planes must be laid out and
+ * aligned like av_frame_get_buffer() with align 0 does, as the filters may
+ * read and write the padding. The buffers are released through their free
+ * callback once the caller and the graph have dropped their references.
+ *
+ * If the callback fails or sets no buffer, the frame is allocated by lavfi.
+ * It is not used for hardware frames.
+ *
+ * @param ctx        an instance of the buffersink filter
+ * @param get_buffer the allocator, or NULL to restore the default one; it
+ *                   returns 0 on success or a negative AVERROR code, and is
+ *                   called from the threads running the graph
+ * @param opaque     passed to get_buffer
+ */
+void av_buffersink_set_get_buffer(AVFilterContext *ctx,
+                                  int (*get_buffer)(AVFilterContext *ctx,
+                                                    AVFrame *frame, void *opaque),
+                                  void *opaque);
+
 /**
  * @defgroup lavfi_buffersink_accessors Buffer sink accessors
  * Get the properties of the stream
@@ -138,6 +138,40 @@ int av_buffersrc_parameters_set(AVFilterContext *ctx, AVBufferSrcParameters *par
     return 0;
 }
 
+int av_buffersrc_reconfigure(AVFilterContext *ctx, AVBufferSrcParameters *param)
+{
+    BufferSourceContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+
+    if (!outlink || outlink->type != AVMEDIA_TYPE_VIDEO)
+        return AVERROR(ENOSYS);
+    if ((param->format != AV_PIX_FMT_NONE && param->format != s->pix_fmt) ||
+        (param->time_base.num > 0 && av_cmp_q(param->time_base, s->time_base)) ||
+        (param->frame_rate.num > 0 && av_cmp_q(param->frame_rate, s->frame_rate)) ||
+        (param->hw_frames_ctx &&
+         (!s->hw_frames_ctx || param->hw_frames_ctx->data != s->hw_frames_ctx->data)))
+        return AVERROR(ENOSYS);
+
+    if (param->width > 0)
+        s->w = param->width;
+    if (param->height > 0)
+        s->h = param->height;
+    if (param->sample_aspect_ratio.num > 0 && param->sample_aspect_ratio.den > 0)
+        s->pixel_aspect = param->sample_aspect_ratio;
+
+    if (outlink->w == s->w && outlink->h == s->h &&
+        !av_cmp_q(outlink->sample_aspect_ratio, s->pixel_aspect))
+        return 0;
+
+    av_log(ctx, AV_LOG_VERBOSE, "Reconfiguring from %dx%d to %dx%d\n",
+           outlink->w, outlink->h, s->w, s->h);
+    outlink->w                   = s->w;
+    outlink->h                   = s->h;
+    outlink->sample_aspect_ratio = s->pixel_aspect;
+
+    return ff_filter_link_reconfigure(outlink);
+}
+
 int attribute_align_arg av_buffersrc_write_frame(AVFilterContext *ctx, const AVFrame *frame)
 {
     return av_buffersrc_add_frame_flags(ctx, (AVFrame *)frame,
@@ -155,7 +189,7 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
 int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     AVFrame *copy = NULL;
-    int ret = 0;
+    int locked, ret = 0;
 
     if (frame && frame->channel_layout &&
         av_get_channel_layout_nb_channels(frame->channel_layout) != frame->channels) {
@@ -163,23 +197,34 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
         return AVERROR(EINVAL);
     }
 
-    if (!(flags & AV_BUFFERSRC_FLAG_KEEP_REF) || !frame)
-        return av_buffersrc_add_frame_internal(ctx, frame, flags);
+    if (!(flags & AV_BUFFERSRC_FLAG_KEEP_REF) || !frame) {
+        locked = ff_graph_lock(ctx->graph);
+        ret = av_buffersrc_add_frame_internal(ctx, frame, flags);
+        ff_graph_unlock(ctx->graph, locked);
+        return ret;
+    }
 
     if (!(copy = av_frame_alloc()))
         return AVERROR(ENOMEM);
     ret = av_frame_ref(copy, frame);
-    if (ret >= 0)
+    if (ret >= 0) {
+        locked = ff_graph_lock(ctx->graph);
         ret = av_buffersrc_add_frame_internal(ctx, copy, flags);
+        ff_graph_unlock(ctx->graph, locked);
+    }
 
     av_frame_free(&copy);
     return ret;
 }
 
-static int push_frame(AVFilterGraph *graph)
+static int push_frame(AVFilterGraph *graph, int eof)
 {
     int ret;
 
+    /* let the pipeline workers run while the caller gets the next frame */
+    if (graph->internal->pipeline)
+        return ff_graph_pipeline_wait(graph, eof);
+
     while (1) {
         ret = ff_filter_graph_run_once(graph);
         if (ret == AVERROR(EAGAIN))
@@ -244,7 +289,7 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
         return ret;
 
     if ((flags & AV_BUFFERSRC_FLAG_PUSH)) {
-        ret = push_frame(ctx->graph);
+        ret = push_frame(ctx->graph, 0);
         if (ret < 0)
             return ret;
     }
@@ -255,10 +300,15 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 {
     BufferSourceContext *s = ctx->priv;
+    int locked = ff_graph_lock(ctx->graph);
+    int ret = 0;
 
     s->eof = 1;
     ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
-    return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph) : 0;
+    if (flags & AV_BUFFERSRC_FLAG_PUSH)
+        ret = push_frame(ctx->graph, 1);
+    ff_graph_unlock(ctx->graph, locked);
+    return ret;
 }
 
 static av_cold int init_video(AVFilterContext *ctx)
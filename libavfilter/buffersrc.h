@@ -137,6 +137,25 @@ AVBufferSrcParameters *av_buffersrc_parameters_alloc(void);
  */
 int av_buffersrc_parameters_set(AVFilterContext *ctx, AVBufferSrcParameters *param);
 
+/**
+ * Change the parameters of a buffersrc filter in a configured graph, and
+ * reconfigure in place the filters downstream whose inputs change. The
+ * filters whose inputs keep their parameters, e.g. after a scale filter with
+ * a fixed output size, are left untouched.
+ *
+ * Only the width, height and sample aspect ratio of the video can change;
+ * the other fields of param must be left unset or keep their current value.
+ *
+ * @param ctx an instance of the buffersrc filter, in a configured graph
+ * @param param the new stream parameters
+ * @return 0 on success, AVERROR(ENOSYS) if the change cannot be made in
+ *         place (other parameters changed, or a filter reached by the change
+ *         does not support it), another negative AVERROR code on error. On
+ *         failure other than for unsupported parameters, the graph must be
+ *         configured again from scratch.
+ */
+int av_buffersrc_reconfigure(AVFilterContext *ctx, AVBufferSrcParameters *param);
+
 /**
  * Add a frame to the buffer source.
  *
@@ -181,6 +200,16 @@ int av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *frame);
  * ownership of the reference(s) and reset the frame. This can be controlled
  * using the flags.
  *
+ * Taking ownership never copies the data: the graph holds the references
+ * until the filters are done with the frame, and the buffers are released
+ * through their free callback. Memory owned by the caller, e.g. decoded into
+ * a shared memory segment, can thus be filtered in place by wrapping it with
+ * av_buffer_create() and passing the frame without AV_BUFFERSRC_FLAG_KEEP_REF.
+ * Filters needing to write to the frame copy it only if a reference is still
+ * held elsewhere, or if the buffer was created read-only; the caller must not
+ * touch the data until its free callback is called. Frames that are not
+ * reference-counted are always copied.
+ *
  * If this function returns an error, the input frame is not touched.
  *
  * @param buffer_src  pointer to a buffer source context
@@ -31,6 +31,7 @@
 enum SearchMethod {
     EXHAUSTIVE,        ///< Search all possible positions
     SMART_EXHAUSTIVE,  ///< Search most possible positions (faster)
+    PYRAMID,           ///< Search a half resolution copy, then refine (fastest)
     SEARCH_COUNT
 };
 
@@ -57,6 +58,11 @@ typedef struct DeshakeContext {
     int counts[2*MAX_R+1][2*MAX_R+1]; /// < Scratch buffer for motion search
     double *angles;            ///< Scratch buffer for block angles
     unsigned angles_size;
+    IntMotionVector *mvs;      ///< Scratch buffer for block motion vectors
+    unsigned mvs_size;
+    uint8_t *pyramid[2];       ///< Half resolution luma of reference and current frame
+    unsigned pyramid_size[2];
+    int pyramid_stride;
     AVFrame *ref;              ///< Previous frame
     int rx;                    ///< Maximum horizontal shift
     int ry;                    ///< Maximum vertical shift
@@ -65,6 +71,7 @@ typedef struct DeshakeContext {
     int contrast;              ///< Contrast threshold
     int search;                ///< Motion search method
     av_pixelutils_sad_fn sad;  ///< Sum of the absolute difference function
+    av_pixelutils_sad_fn sad_half; ///< 8x8 SAD used on the half resolution planes
     Transform last;            ///< Transform from last frame
     int refcount;              ///< Number of reference frames (defines averaging window)
     FILE *fp;
@@ -25,8 +25,252 @@
 
 #include "dnn_backend_native.h"
 #include "libavutil/avassert.h"
+#include "libavutil/file.h"
 #include "dnn_backend_native_layer_conv2d.h"
+#include "dnn_backend_native_layer_mathbinary.h"
+#include "dnn_backend_native_layer_mathunary.h"
+#include "dnn_backend_native_layer_maximum.h"
+#include "dnn_backend_native_layer_pad.h"
 #include "dnn_backend_native_layers.h"
+#include "../internal.h"
+
+#define OFFSET(x) offsetof(NativeContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM
+static const AVOption dnn_native_options[] = {
+    { "threads", "number of threads for layer execution, 0 means auto", OFFSET(options.threads), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "optimize", "fuse the layers of the model after loading it", OFFSET(options.optimize), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(dnn_native);
+
+static void native_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    NativeContext *ctx = priv;
+    ctx->job_func(ctx->job_arg, jobnr, nb_jobs);
+}
+
+void ff_dnn_native_execute(NativeContext *ctx, void (*func)(void *arg, int jobnr, int nb_jobs),
+                           void *arg, int nb_jobs)
+{
+    if (!ctx || !ctx->slicethread || nb_jobs <= 1) {
+        for (int i = 0; i < nb_jobs; i++)
+            func(arg, i, nb_jobs);
+        return;
+    }
+
+    ctx->job_func = func;
+    ctx->job_arg  = arg;
+    avpriv_slicethread_execute(ctx->slicethread, nb_jobs, 0);
+}
+
+int ff_dnn_native_nb_jobs(const NativeContext *ctx, int nb_rows)
+{
+    if (!ctx || !ctx->slicethread)
+        return 1;
+    return av_clip(nb_rows, 1, ctx->nb_threads);
+}
+
+int ff_dnn_native_alloc_operand(NativeContext *ctx, DnnOperand *operands, int32_t index)
+{
+    DnnOperand *oprd = &operands[index];
+
+    oprd->length = calculate_operand_data_length(oprd);
+    if (oprd->length <= 0)
+        return -1;
+
+    if (ctx && ctx->planned_lengths && ctx->planned_lengths[index] >= 0)
+        return oprd->length <= ctx->planned_lengths[index] ? 0 : -1;
+
+    oprd->data = av_realloc(oprd->data, oprd->length);
+    if (!oprd->data)
+        return -1;
+    return 0;
+}
+
+static void free_memory_plan(ConvolutionalNetwork *network)
+{
+    if (network->ctx.planned_lengths) {
+        for (int32_t i = 0; i < network->operands_num; i++) {
+            if (network->ctx.planned_lengths[i] >= 0)
+                network->operands[i].data = NULL;
+        }
+    }
+    av_freep(&network->ctx.planned_lengths);
+    av_freep(&network->arena);
+}
+
+// Computes the lifetime of the operands from the layer graph, the unused
+// input slots of a layer may point at operand 0, which only makes it live longer.
+static DNNReturnType init_lifetimes(ConvolutionalNetwork *network)
+{
+    free_memory_plan(network);
+
+    if (!network->operand_first) {
+        network->operand_first = av_malloc_array(network->operands_num, sizeof(*network->operand_first));
+        network->operand_last  = av_malloc_array(network->operands_num, sizeof(*network->operand_last));
+        if (!network->operand_first || !network->operand_last)
+            return DNN_ERROR;
+    }
+
+    for (int32_t i = 0; i < network->operands_num; i++) {
+        network->operand_first[i] = -1;
+        network->operand_last[i]  = -1;
+    }
+
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        const Layer *l = &network->layers[layer];
+        int32_t out = l->output_operand_index;
+
+        if (out < 0 || out >= network->operands_num)
+            return DNN_ERROR;
+        if (network->operand_first[out] < 0)
+            network->operand_first[out] = layer;
+        network->operand_last[out] = FFMAX(network->operand_last[out], layer);
+
+        for (int i = 0; i < FF_ARRAY_ELEMS(l->input_operand_indexes); i++) {
+            int32_t in = l->input_operand_indexes[i];
+            if (in >= 0 && in < network->operands_num)
+                network->operand_last[in] = layer;
+        }
+    }
+
+    for (uint32_t i = 0; i < network->nb_output; i++) {
+        int32_t index = network->output_indexes[i];
+        // the operands of the layers fused at load time are never written
+        if (network->operand_first[index] < 0 && network->operands[index].type != DOT_INPUT)
+            return DNN_ERROR;
+        network->operand_last[index] = network->layers_num;
+    }
+
+    return DNN_SUCCESS;
+}
+
+static int is_planned(const ConvolutionalNetwork *network, int32_t index)
+{
+    // the input buffer is handed to the caller by set_input_output and stays out of the arena
+    return network->operand_first[index] >= 0 && network->operands[index].type != DOT_INPUT;
+}
+
+typedef struct PlannedBuffer {
+    int32_t index;
+    size_t offset;
+    size_t size;
+} PlannedBuffer;
+
+static int cmp_buffer_size(const void *a, const void *b)
+{
+    const PlannedBuffer *ba = a, *bb = b;
+    if (ba->size != bb->size)
+        return ba->size < bb->size ? 1 : -1;
+    return ba->index - bb->index;
+}
+
+static int cmp_buffer_offset(const void *a, const void *b)
+{
+    const PlannedBuffer *ba = a, *bb = b;
+    return ba->offset < bb->offset ? -1 : ba->offset > bb->offset;
+}
+
+// Gives the operands, whose lengths are known after the first execution, an offset in
+// one arena. The largest buffers are placed first, each at the lowest offset which
+// does not overlap the buffers of the operands alive at the same time.
+static DNNReturnType plan_memory(ConvolutionalNetwork *network)
+{
+    NativeContext *ctx = &network->ctx;
+    PlannedBuffer *buffers, **live = NULL;
+    int nb_buffers = 0;
+    size_t arena_size = 0;
+    DNNReturnType ret = DNN_ERROR;
+
+    buffers = av_malloc_array(network->operands_num, sizeof(*buffers));
+    live = av_malloc_array(network->operands_num, sizeof(*live));
+    ctx->planned_lengths = av_malloc_array(network->operands_num, sizeof(*ctx->planned_lengths));
+    if (!buffers || !live || !ctx->planned_lengths)
+        goto end;
+
+    for (int32_t i = 0; i < network->operands_num; i++) {
+        ctx->planned_lengths[i] = -1;
+        if (!is_planned(network, i) || network->operands[i].length <= 0)
+            continue;
+        buffers[nb_buffers].index  = i;
+        buffers[nb_buffers].offset = 0;
+        buffers[nb_buffers].size   = FFALIGN(network->operands[i].length, 64);
+        nb_buffers++;
+    }
+    qsort(buffers, nb_buffers, sizeof(*buffers), cmp_buffer_size);
+
+    for (int i = 0; i < nb_buffers; i++) {
+        PlannedBuffer *buf = &buffers[i];
+        int32_t first = network->operand_first[buf->index];
+        int32_t last  = network->operand_last[buf->index];
+        int nb_live = 0;
+        size_t offset = 0;
+
+        for (int j = 0; j < i; j++) {
+            int32_t index = buffers[j].index;
+            if (network->operand_first[index] <= last && first <= network->operand_last[index])
+                live[nb_live++] = &buffers[j];
+        }
+        // the live buffers are sorted by offset to find the first gap large enough
+        for (int j = 1; j < nb_live; j++) {
+            PlannedBuffer *tmp = live[j];
+            int k = j;
+            for (; k > 0 && cmp_buffer_offset(live[k - 1], tmp) > 0; k--)
+                live[k] = live[k - 1];
+            live[k] = tmp;
+        }
+        for (int j = 0; j < nb_live; j++) {
+            if (live[j]->offset >= offset + buf->size)
+                break;
+            offset = FFMAX(offset, live[j]->offset + live[j]->size);
+        }
+        buf->offset = offset;
+        arena_size = FFMAX(arena_size, offset + buf->size);
+    }
+
+    network->arena = av_malloc(FFMAX(arena_size, 1));
+    if (!network->arena)
+        goto end;
+
+    for (int i = 0; i < nb_buffers; i++) {
+        DnnOperand *oprd = &network->operands[buffers[i].index];
+        uint8_t *data = network->arena + buffers[i].offset;
+        // only the outputs still hold data, which is read after this execution
+        if (oprd->data)
+            memcpy(data, oprd->data, oprd->length);
+        av_freep(&oprd->data);
+        oprd->data = data;
+        ctx->planned_lengths[buffers[i].index] = oprd->length;
+    }
+    ret = DNN_SUCCESS;
+
+end:
+    if (ret != DNN_SUCCESS)
+        av_freep(&ctx->planned_lengths);
+    av_freep(&buffers);
+    av_freep(&live);
+    return ret;
+}
+
+static int init_threads(NativeContext *ctx)
+{
+    int ret;
+
+    if (ctx->options.threads == 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&ctx->slicethread, ctx, native_worker, NULL, ctx->options.threads);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0)
+        return ret;
+
+    ctx->nb_threads = ret;
+    if (ret == 1)
+        avpriv_slicethread_free(&ctx->slicethread);
+    return 0;
+}
 
 static DNNReturnType get_input_native(void *model, DNNData *input, const char *input_name)
 {
@@ -108,20 +352,227 @@ static DNNReturnType set_input_output_native(void *model, DNNData *input, const
     if (network->nb_output != nb_output)
         return DNN_ERROR;
 
-    return DNN_SUCCESS;
+    // the memory is planned after the next execution, once the operand lengths are known
+    return init_lifetimes(network);
+}
+
+static int nb_layer_inputs(const Layer *layer)
+{
+    if (layer->type == DLT_MATH_BINARY) {
+        const DnnLayerMathBinaryParams *params = layer->params;
+        return 2 - !!params->input0_broadcast - !!params->input1_broadcast;
+    }
+    return 1;
+}
+
+// Gives the index of the only layer reading the operand of index, or -1 if
+// the operand is read by several layers or is not an intermediate operand.
+static int32_t get_single_reader(const ConvolutionalNetwork *network, int32_t index)
+{
+    int32_t reader = -1;
+    int nb_writers = 0;
+
+    if (network->operands[index].type != DOT_INTERMEDIATE)
+        return -1;
+
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        const Layer *l = &network->layers[layer];
+        nb_writers += l->output_operand_index == index;
+        for (int i = 0; i < nb_layer_inputs(l); i++) {
+            if (l->input_operand_indexes[i] == index) {
+                if (reader >= 0)
+                    return -1;
+                reader = layer;
+            }
+        }
+    }
+
+    return nb_writers == 1 ? reader : -1;
+}
+
+static void remove_layer(ConvolutionalNetwork *network, int32_t layer)
+{
+    av_freep(&network->layers[layer].params);
+    memmove(&network->layers[layer], &network->layers[layer + 1],
+            (network->layers_num - layer - 1) * sizeof(*network->layers));
+    network->layers_num--;
+}
+
+// A pad of the spatial dims by the radius of the kernel before a VALID conv2d
+// is the padding of a SAME conv2d, the conv2d then reads the missing pixels itself.
+static int fold_pad(const Layer *pad, Layer *conv)
+{
+    const LayerPadParams *pad_params = pad->params;
+    ConvolutionalParams *conv_params = conv->params;
+    int radius = (conv_params->kernel_size - 1) / 2 * conv_params->dilation;
+
+    if (conv_params->padding_method != VALID || !(conv_params->kernel_size & 1) ||
+        (pad_params->mode == LPMP_CONSTANT && pad_params->constant_values != 0.0f))
+        return 0;
+    for (int i = 0; i < 2; i++) {
+        if (pad_params->paddings[0][i] || pad_params->paddings[3][i] ||
+            pad_params->paddings[1][i] != radius || pad_params->paddings[2][i] != radius)
+            return 0;
+    }
+
+    switch (pad_params->mode) {
+    case LPMP_CONSTANT:
+        conv_params->padding_method = SAME;
+        break;
+    case LPMP_REFLECT:
+        conv_params->padding_method = SAME_REFLECT;
+        break;
+    case LPMP_SYMMETRIC:
+        conv_params->padding_method = SAME_SYMMETRIC;
+        break;
+    default:
+        return 0;
+    }
+    conv->input_operand_indexes[0] = pad->input_operand_indexes[0];
+    return 1;
+}
+
+static int scale_conv(ConvolutionalParams *conv_params, float scale)
+{
+    int kernel_size = conv_params->input_num * conv_params->output_num *
+                      conv_params->kernel_size * conv_params->kernel_size;
+
+    if (conv_params->kernel_mapped) {
+        // the mapping may be read-only, and it is shared otherwise
+        float *kernel = av_memdup(conv_params->kernel, kernel_size * sizeof(*kernel));
+        if (!kernel)
+            return AVERROR(ENOMEM);
+        conv_params->kernel = kernel;
+        conv_params->kernel_mapped = 0;
+    }
+    for (int i = 0; i < kernel_size; i++)
+        conv_params->kernel[i] *= scale;
+    if (conv_params->has_bias) {
+        for (int i = 0; i < conv_params->output_num; i++)
+            conv_params->biases[i] *= scale;
+    }
+    return 1;
+}
+
+static int offset_conv(ConvolutionalParams *conv_params, float offset)
+{
+    if (!conv_params->has_bias) {
+        conv_params->biases = av_mallocz_array(conv_params->output_num, sizeof(*conv_params->biases));
+        if (!conv_params->biases)
+            return AVERROR(ENOMEM);
+        conv_params->has_bias = 1;
+    }
+    for (int i = 0; i < conv_params->output_num; i++)
+        conv_params->biases[i] += offset;
+    return 1;
+}
+
+// Merges the elementwise layer reading the output of a conv2d into the conv2d,
+// as its activation or into its kernel and biases.
+static int fuse_into_conv(Layer *conv, const Layer *layer)
+{
+    ConvolutionalParams *conv_params = conv->params;
+
+    if (conv_params->activation != NONE)
+        return 0;
+
+    switch (layer->type) {
+    case DLT_MAXIMUM: {
+        const DnnLayerMaximumParams *params = layer->params;
+        if (params->val.y != 0.0f)
+            return 0;
+        conv_params->activation = RELU;
+        return 1;
+    }
+    case DLT_MATH_UNARY: {
+        const DnnLayerMathUnaryParams *params = layer->params;
+        if (params->un_op != DMUO_TANH)
+            return 0;
+        conv_params->activation = TANH;
+        return 1;
+    }
+    case DLT_MATH_BINARY: {
+        const DnnLayerMathBinaryParams *params = layer->params;
+        if (!params->input0_broadcast == !params->input1_broadcast)
+            return 0;
+        switch (params->bin_op) {
+        case DMBO_ADD:
+            return offset_conv(conv_params, params->v);
+        case DMBO_SUB:
+            if (params->input1_broadcast)
+                return offset_conv(conv_params, -params->v);
+            scale_conv(conv_params, -1.0f);
+            return offset_conv(conv_params, params->v);
+        case DMBO_MUL:
+            return scale_conv(conv_params, params->v);
+        case DMBO_REALDIV:
+            if (!params->input1_broadcast || params->v == 0.0f)
+                return 0;
+            return scale_conv(conv_params, 1.0f / params->v);
+        default:
+            return 0;
+        }
+    }
+    default:
+        return 0;
+    }
+}
+
+// Reduces the number of passes over the operands: the zero pads are folded into
+// the following conv2d, the activations and the elementwise operations with
+// a constant are fused into the preceding conv2d.
+static int optimize_network(ConvolutionalNetwork *network)
+{
+    int ret;
+
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        Layer *l = &network->layers[layer];
+        int32_t reader;
+
+        if (l->type != DLT_MIRROR_PAD)
+            continue;
+        reader = get_single_reader(network, l->output_operand_index);
+        if (reader >= 0 && network->layers[reader].type == DLT_CONV2D &&
+            reader > layer && fold_pad(l, &network->layers[reader])) {
+            remove_layer(network, layer);
+            layer--;
+        }
+    }
+
+    for (int32_t layer = 0; layer < network->layers_num; layer++) {
+        Layer *conv = &network->layers[layer];
+
+        if (conv->type != DLT_CONV2D)
+            continue;
+        while (1) {
+            int32_t reader = get_single_reader(network, conv->output_operand_index);
+            if (reader <= layer)
+                break;
+            ret = fuse_into_conv(conv, &network->layers[reader]);
+            if (ret < 0)
+                return ret;
+            if (!ret)
+                break;
+            conv->output_operand_index = network->layers[reader].output_operand_index;
+            remove_layer(network, reader);
+        }
+    }
+
+    return 0;
 }
 
 // Loads model and its parameters that are stored in a binary file with following structure:
 // layers_num,layer_type,layer_parameterss,layer_type,layer_parameters...
-// For CONV layer: activation_function, input_num, output_num, kernel_size, kernel, biases
+// For CONV layer: activation_function, input_num, output_num, kernel_size, kernel, biases,
+// the kernel is aligned to NATIVE_WEIGHT_ALIGN bytes from NATIVE_ALIGNED_MINOR_VERSION on
 // For DEPTH_TO_SPACE layer: block_size
-DNNModel *ff_dnn_load_model_native(const char *model_filename)
+DNNModel *ff_dnn_load_model_native(const char *model_filename, const char *options)
 {
     DNNModel *model = NULL;
     char header_expected[] = "FFMPEGDNNNATIVE";
     char *buf;
     size_t size;
-    int version, header_size, major_version_expected = 1;
+    int version, minor_version, header_size, major_version_expected = 1;
     ConvolutionalNetwork *network = NULL;
     AVIOContext *model_file_context;
     int file_size, dnn_size, parsed_size;
@@ -162,8 +613,7 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         goto fail;
     }
 
-    // currently no need to check minor version
-    version = (int32_t)avio_rl32(model_file_context);
+    minor_version = (int32_t)avio_rl32(model_file_context);
     dnn_size += 4;
     header_size = dnn_size;
 
@@ -173,6 +623,32 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
     }
     model->model = (void *)network;
 
+    // aligned weights can be used in place from a mapping of the file, so all
+    // the instances loading the same model share its pages in the page cache
+    if (minor_version >= NATIVE_ALIGNED_MINOR_VERSION) {
+        uint8_t *map_data;
+        size_t map_size;
+
+        network->map.aligned = 1;
+        if (av_file_map(model_filename, &map_data, &map_size,
+                        AV_LOG_VERBOSE - AV_LOG_ERROR, NULL) >= 0) {
+            network->map.data = map_data;
+            network->map.size = map_size;
+        }
+    }
+
+    network->ctx.class = &dnn_native_class;
+    av_opt_set_defaults(&network->ctx);
+    if (av_opt_set_from_string(&network->ctx, options, NULL, "=", "&") < 0) {
+        av_log(&network->ctx, AV_LOG_ERROR, "Failed to parse options \"%s\"\n", options);
+        goto fail;
+    }
+    if (init_threads(&network->ctx) < 0)
+        goto fail;
+    network->ctx.fdsp = avpriv_float_dsp_alloc(0);
+    if (!network->ctx.fdsp)
+        goto fail;
+
     avio_seek(model_file_context, file_size - 8, SEEK_SET);
     network->layers_num = (int32_t)avio_rl32(model_file_context);
     network->operands_num = (int32_t)avio_rl32(model_file_context);
@@ -198,7 +674,8 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         }
 
         network->layers[layer].type = layer_type;
-        parsed_size = layer_funcs[layer_type].pf_load(&network->layers[layer], model_file_context, file_size, network->operands_num);
+        parsed_size = layer_funcs[layer_type].pf_load(&network->layers[layer], model_file_context, file_size,
+                                                        network->operands_num, &network->map);
         if (!parsed_size) {
             goto fail;
         }
@@ -243,6 +720,11 @@ DNNModel *ff_dnn_load_model_native(const char *model_filename)
         return NULL;
     }
 
+    if (network->ctx.options.optimize && optimize_network(network) < 0) {
+        ff_dnn_free_model_native(&model);
+        return NULL;
+    }
+
     model->set_input_output = &set_input_output_native;
     model->get_input = &get_input_native;
 
@@ -265,14 +747,31 @@ DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *output
     if (!network->operands[0].data)
         return DNN_ERROR;
 
+    if (!network->operand_first)
+        return DNN_ERROR;
+
     for (layer = 0; layer < network->layers_num; ++layer){
         DNNLayerType layer_type = network->layers[layer].type;
-        layer_funcs[layer_type].pf_exec(network->operands,
-                                  network->layers[layer].input_operand_indexes,
-                                  network->layers[layer].output_operand_index,
-                                  network->layers[layer].params);
+        if (layer_funcs[layer_type].pf_exec(network->operands,
+                                            network->layers[layer].input_operand_indexes,
+                                            network->layers[layer].output_operand_index,
+                                            network->layers[layer].params,
+                                            &network->ctx))
+            return DNN_ERROR;
+
+        // before the memory is planned, the operands are released once they are dead,
+        // their lengths are kept for the plan
+        if (!network->ctx.planned_lengths) {
+            for (int32_t i = 0; i < network->operands_num; i++) {
+                if (network->operand_last[i] == layer && is_planned(network, i))
+                    av_freep(&network->operands[i].data);
+            }
+        }
     }
 
+    if (!network->ctx.planned_lengths && plan_memory(network) != DNN_SUCCESS)
+        return DNN_ERROR;
+
     for (uint32_t i = 0; i < nb; ++i) {
         DnnOperand *oprd = &network->operands[network->output_indexes[i]];
         outputs[i].data = oprd->data;
@@ -320,7 +819,8 @@ void ff_dnn_free_model_native(DNNModel **model)
                 for (layer = 0; layer < network->layers_num; ++layer){
                     if (network->layers[layer].type == DLT_CONV2D){
                         conv_params = (ConvolutionalParams *)network->layers[layer].params;
-                        av_freep(&conv_params->kernel);
+                        if (!conv_params->kernel_mapped)
+                            av_freep(&conv_params->kernel);
                         av_freep(&conv_params->biases);
                     }
                     av_freep(&network->layers[layer].params);
@@ -329,12 +829,20 @@ void ff_dnn_free_model_native(DNNModel **model)
             }
 
             if (network->operands) {
+                free_memory_plan(network);
                 for (uint32_t operand = 0; operand < network->operands_num; ++operand)
                     av_freep(&network->operands[operand].data);
                 av_freep(&network->operands);
             }
+            av_freep(&network->operand_first);
+            av_freep(&network->operand_last);
 
             av_freep(&network->output_indexes);
+            if (network->map.data)
+                av_file_unmap((uint8_t *)network->map.data, network->map.size);
+            avpriv_slicethread_free(&network->ctx.slicethread);
+            av_freep(&network->ctx.fdsp);
+            av_opt_free(&network->ctx);
             av_freep(&network);
         }
         av_freep(model);
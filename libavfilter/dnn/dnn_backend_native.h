@@ -29,6 +29,9 @@
 
 #include "../dnn_interface.h"
 #include "libavformat/avio.h"
+#include "libavutil/float_dsp.h"
+#include "libavutil/opt.h"
+#include "libavutil/slicethread.h"
 
 /**
  * the enum value of DNNLayerType should not be changed,
@@ -48,6 +51,17 @@ typedef enum {
 
 typedef enum {DOT_INPUT = 1, DOT_OUTPUT = 2, DOT_INTERMEDIATE = DOT_INPUT | DOT_OUTPUT} DNNOperandType;
 
+// from this minor version on, the weight blobs in the model file are preceded
+// by zero padding up to a multiple of NATIVE_WEIGHT_ALIGN bytes of the file offset
+#define NATIVE_ALIGNED_MINOR_VERSION 19
+#define NATIVE_WEIGHT_ALIGN 64
+
+typedef struct NativeModelMap {
+    int aligned;            ///< the weight blobs are aligned in the file
+    const uint8_t *data;    ///< the whole model file mapped into memory, NULL if not mapped
+    size_t size;
+} NativeModelMap;
+
 typedef struct Layer{
     DNNLayerType type;
     /**
@@ -92,8 +106,9 @@ typedef struct DnnOperand{
     /**
      * data pointer with data length in bytes.
      * usedNumbersLeft is only valid for intermediate operand,
-     * it means how many layers still depend on this operand,
-     * todo: the memory can be reused when usedNumbersLeft is zero.
+     * it means how many layers still depend on this operand.
+     * The memory of the intermediate and output operands is planned in
+     * one arena after the first execution, see ff_dnn_native_alloc_operand().
      */
     void *data;
     int32_t length;
@@ -104,22 +119,77 @@ typedef struct InputParams{
     int height, width, channels;
 } InputParams;
 
+typedef struct NativeOptions{
+    int threads;
+    int optimize;
+} NativeOptions;
+
+typedef struct NativeContext {
+    const AVClass *class;
+    NativeOptions options;
+    AVFloatDSPContext *fdsp;
+
+    // slice threads shared by the layers, NULL for single threaded execution
+    AVSliceThread *slicethread;
+    int nb_threads;
+    void (*job_func)(void *arg, int jobnr, int nb_jobs);
+    void *job_arg;
+
+    // capacity of the operand buffers planned in the arena of the network,
+    // -1 for the operands out of it, NULL until the memory is planned
+    int32_t *planned_lengths;
+} NativeContext;
+
 // Represents simple feed-forward convolutional network.
 typedef struct ConvolutionalNetwork{
+    NativeContext ctx;
     Layer *layers;
     int32_t layers_num;
     DnnOperand *operands;
     int32_t operands_num;
     int32_t *output_indexes;
     uint32_t nb_output;
+
+    // index of the first layer writing and of the last layer reading each operand,
+    // the outputs are read after the last layer, -1 if no layer writes it
+    int32_t *operand_first;
+    int32_t *operand_last;
+    // buffer of the intermediate and output operands, the operands which are
+    // not alive at the same time share memory
+    uint8_t *arena;
+    // mapping of the model file, the weights may point into it
+    NativeModelMap map;
 } ConvolutionalNetwork;
 
-DNNModel *ff_dnn_load_model_native(const char *model_filename);
+DNNModel *ff_dnn_load_model_native(const char *model_filename, const char *options);
 
 DNNReturnType ff_dnn_execute_model_native(const DNNModel *model, DNNData *outputs, uint32_t nb_output);
 
 void ff_dnn_free_model_native(DNNModel **model);
 
+/**
+ * Run func(arg, jobnr, nb_jobs) for every jobnr in [0, nb_jobs) on the slice
+ * threads of ctx, or one after another in the calling thread if ctx is NULL
+ * or single threaded.
+ */
+void ff_dnn_native_execute(NativeContext *ctx, void (*func)(void *arg, int jobnr, int nb_jobs),
+                           void *arg, int nb_jobs);
+
+/**
+ * Get the number of jobs to split a layer of nb_rows output rows into.
+ */
+int ff_dnn_native_nb_jobs(const NativeContext *ctx, int nb_rows);
+
+/**
+ * Make the data of operands[index] hold its length computed from its dims.
+ * Once the memory of the network is planned, the operand keeps its buffer in
+ * the arena and nothing is allocated. ctx can be NULL.
+ *
+ * @return 0 on success, a negative value if the length is invalid or does not
+ *         fit the planned buffer, or on allocation failure
+ */
+int ff_dnn_native_alloc_operand(NativeContext *ctx, DnnOperand *operands, int32_t index);
+
 // NOTE: User must check for error (return value <= 0) to handle
 // case like integer overflow.
 int32_t calculate_operand_data_length(const DnnOperand *oprd);
@@ -18,16 +18,37 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
 #include "libavutil/avassert.h"
+#include "libavutil/intfloat.h"
+#include "libavutil/intreadwrite.h"
 #include "dnn_backend_native_layer_conv2d.h"
 
 #define CLAMP_TO_EDGE(x, w) ((x) < 0 ? 0 : ((x) >= (w) ? (w - 1) : (x)))
+#define REFLECT(x, w) ((x) < 0 ? -(x) : ((x) >= (w) ? 2 * (w) - 2 - (x) : (x)))
+#define SYMMETRIC(x, w) ((x) < 0 ? -(x) - 1 : ((x) >= (w) ? 2 * (w) - 1 - (x) : (x)))
 
-int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
+// read little-endian floats in one go instead of one avio_rl32() per value
+static void read_floats(AVIOContext *model_file_context, float *dst, int nb)
+{
+    int size = avio_read(model_file_context, (uint8_t *)dst, nb * sizeof(*dst));
+
+    if (size < (int)(nb * sizeof(*dst)))
+        memset((uint8_t *)dst + FFMAX(size, 0), 0, nb * sizeof(*dst) - FFMAX(size, 0));
+#if HAVE_BIGENDIAN
+    for (int i = 0; i < nb; i++)
+        dst[i] = av_int2float(AV_RL32(dst + i));
+#endif
+}
+
+int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                          const NativeModelMap *map)
 {
     ConvolutionalParams *conv_params;
     int kernel_size;
     int dnn_size = 0;
+    int64_t pos = 0;
+    int pad = 0;
     conv_params = av_malloc(sizeof(*conv_params));
     if (!conv_params)
         return 0;
@@ -41,38 +62,58 @@ int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int fil
     conv_params->has_bias = (int32_t)avio_rl32(model_file_context);
     dnn_size += 28;
 
+    if (conv_params->input_num <= 0 || conv_params->output_num <= 0 ||
+        conv_params->kernel_size <= 0 ||
+        (int64_t)conv_params->input_num * conv_params->output_num *
+        conv_params->kernel_size * conv_params->kernel_size > INT_MAX / 4) {
+        av_freep(&conv_params);
+        return 0;
+    }
+
+    if (map->aligned) {
+        pos = avio_tell(model_file_context);
+        pad = FFALIGN(pos, NATIVE_WEIGHT_ALIGN) - pos;
+        avio_skip(model_file_context, pad);
+        dnn_size += pad;
+    }
+
     kernel_size = conv_params->input_num * conv_params->output_num *
                       conv_params->kernel_size * conv_params->kernel_size;
     dnn_size += kernel_size * 4;
     if (conv_params->has_bias)
         dnn_size += conv_params->output_num * 4;
 
-    if (dnn_size > file_size || conv_params->input_num <= 0 ||
-        conv_params->output_num <= 0 || conv_params->kernel_size <= 0){
+    if (dnn_size > file_size){
         av_freep(&conv_params);
         return 0;
     }
 
-    conv_params->kernel = av_malloc(kernel_size * sizeof(float));
-    if (!conv_params->kernel) {
-        av_freep(&conv_params);
-        return 0;
-    }
-    for (int i = 0; i < kernel_size; ++i) {
-        conv_params->kernel[i] = av_int2float(avio_rl32(model_file_context));
+    conv_params->kernel_mapped = 0;
+    if (map->aligned && map->data && !HAVE_BIGENDIAN &&
+        pos + pad + kernel_size * 4 <= map->size) {
+        // use the kernel in place, the pages are shared with the page cache
+        conv_params->kernel = (float *)(map->data + pos + pad);
+        conv_params->kernel_mapped = 1;
+        avio_skip(model_file_context, kernel_size * 4);
+    } else {
+        conv_params->kernel = av_malloc(kernel_size * sizeof(float));
+        if (!conv_params->kernel) {
+            av_freep(&conv_params);
+            return 0;
+        }
+        read_floats(model_file_context, conv_params->kernel, kernel_size);
     }
 
     conv_params->biases = NULL;
     if (conv_params->has_bias) {
         conv_params->biases = av_malloc(conv_params->output_num * sizeof(float));
         if (!conv_params->biases){
-            av_freep(&conv_params->kernel);
+            if (!conv_params->kernel_mapped)
+                av_freep(&conv_params->kernel);
             av_freep(&conv_params);
             return 0;
         }
-        for (int i = 0; i < conv_params->output_num; ++i){
-            conv_params->biases[i] = av_int2float(avio_rl32(model_file_context));
-        }
+        read_floats(model_file_context, conv_params->biases, conv_params->output_num);
     }
 
     layer->params = conv_params;
@@ -88,69 +129,69 @@ int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int fil
     return dnn_size;
 }
 
-int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
-                             int32_t output_operand_index, const void *parameters)
-{
+typedef struct Conv2dThreadArg {
+    const ConvolutionalParams *conv_params;
+    const float *input;
     float *output;
-    int32_t input_operand_index = input_operand_indexes[0];
-    int number = operands[input_operand_index].dims[0];
-    int height = operands[input_operand_index].dims[1];
-    int width = operands[input_operand_index].dims[2];
-    int channel = operands[input_operand_index].dims[3];
-    const float *input = operands[input_operand_index].data;
-    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
+    int height, width, pad_size;
 
-    int radius = conv_params->kernel_size >> 1;
-    int src_linesize = width * conv_params->input_num;
-    int filter_linesize = conv_params->kernel_size * conv_params->input_num;
-    int filter_size = conv_params->kernel_size * filter_linesize;
-    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    // kernel rows and per job input patches, padded to a multiple of 4 with zeros
+    const float *kernel;
+    float *patches;
+    int padded_size;
+    float (*scalarproduct)(const float *v1, const float *v2, int len);
+} Conv2dThreadArg;
 
-    DnnOperand *output_operand = &operands[output_operand_index];
-    output_operand->dims[0] = number;
-    output_operand->dims[1] = height - pad_size * 2;
-    output_operand->dims[2] = width - pad_size * 2;
-    output_operand->dims[3] = conv_params->output_num;
-    output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    if (output_operand->length <= 0)
-        return -1;
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
-        return -1;
-    output = output_operand->data;
+static void conv2d_slice(void *arg, int jobnr, int nb_jobs)
+{
+    const Conv2dThreadArg *thread_arg = arg;
+    const ConvolutionalParams *conv_params = thread_arg->conv_params;
+    const float *input = thread_arg->input;
+    int height = thread_arg->height;
+    int width = thread_arg->width;
+    int pad_size = thread_arg->pad_size;
+    int output_height = height - pad_size * 2;
+    int slice_start = pad_size + (output_height *  jobnr     ) / nb_jobs;
+    int slice_end   = pad_size + (output_height * (jobnr + 1)) / nb_jobs;
 
-    av_assert0(channel == conv_params->input_num);
+    int radius = conv_params->kernel_size >> 1;
+    int input_num = conv_params->input_num;
+    int src_linesize = width * input_num;
+    int padded_size = thread_arg->padded_size;
+    float *patch = thread_arg->patches + jobnr * padded_size;
+    float *output = thread_arg->output + (slice_start - pad_size) * (width - pad_size * 2) * conv_params->output_num;
 
-    for (int y = pad_size; y < height - pad_size; ++y) {
+    for (int y = slice_start; y < slice_end; ++y) {
         for (int x = pad_size; x < width - pad_size; ++x) {
-            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
-                if (conv_params->has_bias)
-                    output[n_filter] = conv_params->biases[n_filter];
-                else
-                    output[n_filter] = 0.f;
-
-                for (int ch = 0; ch < conv_params->input_num; ++ch) {
-                    for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
-                        for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
-                            float input_pel;
-                            if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
-                                int y_pos = CLAMP_TO_EDGE(y + (kernel_y - radius) * conv_params->dilation, height);
-                                int x_pos = CLAMP_TO_EDGE(x + (kernel_x - radius) * conv_params->dilation, width);
-                                input_pel = input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            } else {
-                                int y_pos = y + (kernel_y - radius) * conv_params->dilation;
-                                int x_pos = x + (kernel_x - radius) * conv_params->dilation;
-                                input_pel = (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height) ? 0.0 :
-                                                   input[y_pos * src_linesize + x_pos * conv_params->input_num + ch];
-                            }
-
-
-                            output[n_filter] += input_pel * conv_params->kernel[n_filter * filter_size + kernel_y * filter_linesize +
-                                                                                kernel_x * conv_params->input_num + ch];
-                        }
+            // gather the input pixels seen by the kernel in the layout of the kernel
+            float *dst = patch;
+            for (int kernel_y = 0; kernel_y < conv_params->kernel_size; ++kernel_y) {
+                for (int kernel_x = 0; kernel_x < conv_params->kernel_size; ++kernel_x) {
+                    int y_pos = y + (kernel_y - radius) * conv_params->dilation;
+                    int x_pos = x + (kernel_x - radius) * conv_params->dilation;
+                    if (conv_params->padding_method == SAME_CLAMP_TO_EDGE) {
+                        y_pos = CLAMP_TO_EDGE(y_pos, height);
+                        x_pos = CLAMP_TO_EDGE(x_pos, width);
+                    } else if (conv_params->padding_method == SAME_REFLECT) {
+                        y_pos = REFLECT(y_pos, height);
+                        x_pos = REFLECT(x_pos, width);
+                    } else if (conv_params->padding_method == SAME_SYMMETRIC) {
+                        y_pos = SYMMETRIC(y_pos, height);
+                        x_pos = SYMMETRIC(x_pos, width);
                     }
+                    if (x_pos < 0 || x_pos >= width || y_pos < 0 || y_pos >= height)
+                        memset(dst, 0, input_num * sizeof(*dst));
+                    else
+                        memcpy(dst, input + y_pos * src_linesize + x_pos * input_num, input_num * sizeof(*dst));
+                    dst += input_num;
                 }
+            }
+
+            for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter) {
+                output[n_filter] = thread_arg->scalarproduct(patch, thread_arg->kernel + n_filter * padded_size, padded_size);
+                if (conv_params->has_bias)
+                    output[n_filter] += conv_params->biases[n_filter];
+
                 switch (conv_params->activation){
                 case RELU:
                     output[n_filter] = FFMAX(output[n_filter], 0.0);
@@ -170,5 +211,60 @@ int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_
             output += conv_params->output_num;
         }
     }
+}
+
+int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
+                             int32_t output_operand_index, const void *parameters, NativeContext *ctx)
+{
+    Conv2dThreadArg thread_arg;
+    int32_t input_operand_index = input_operand_indexes[0];
+    int number = operands[input_operand_index].dims[0];
+    int height = operands[input_operand_index].dims[1];
+    int width = operands[input_operand_index].dims[2];
+    int channel = operands[input_operand_index].dims[3];
+    const ConvolutionalParams *conv_params = (const ConvolutionalParams *)parameters;
+    int pad_size = (conv_params->padding_method == VALID) ? (conv_params->kernel_size - 1) / 2 * conv_params->dilation : 0;
+    int filter_size = conv_params->kernel_size * conv_params->kernel_size * conv_params->input_num;
+    int padded_size = FFALIGN(filter_size, 4);
+    int nb_jobs;
+    float *kernel;
+
+    DnnOperand *output_operand = &operands[output_operand_index];
+    output_operand->dims[0] = number;
+    output_operand->dims[1] = height - pad_size * 2;
+    output_operand->dims[2] = width - pad_size * 2;
+    output_operand->dims[3] = conv_params->output_num;
+    output_operand->data_type = operands[input_operand_index].data_type;
+    if (ff_dnn_native_alloc_operand(ctx, operands, output_operand_index) < 0)
+        return -1;
+
+    av_assert0(channel == conv_params->input_num);
+
+    nb_jobs = ff_dnn_native_nb_jobs(ctx, output_operand->dims[1]);
+    kernel = av_mallocz_array(conv_params->output_num, padded_size * sizeof(*kernel));
+    thread_arg.patches = av_mallocz_array(nb_jobs, padded_size * sizeof(*thread_arg.patches));
+    if (!kernel || !thread_arg.patches) {
+        av_freep(&kernel);
+        av_freep(&thread_arg.patches);
+        return -1;
+    }
+    for (int n_filter = 0; n_filter < conv_params->output_num; ++n_filter)
+        memcpy(kernel + n_filter * padded_size, conv_params->kernel + n_filter * filter_size,
+               filter_size * sizeof(*kernel));
+
+    thread_arg.conv_params = conv_params;
+    thread_arg.input = operands[input_operand_index].data;
+    thread_arg.output = output_operand->data;
+    thread_arg.height = height;
+    thread_arg.width = width;
+    thread_arg.pad_size = pad_size;
+    thread_arg.kernel = kernel;
+    thread_arg.padded_size = padded_size;
+    thread_arg.scalarproduct = ctx && ctx->fdsp ? ctx->fdsp->scalarproduct_float : avpriv_scalarproduct_float_c;
+
+    ff_dnn_native_execute(ctx, conv2d_slice, &thread_arg, nb_jobs);
+
+    av_freep(&kernel);
+    av_freep(&thread_arg.patches);
     return 0;
 }
@@ -24,7 +24,9 @@
 #include "dnn_backend_native.h"
 
 typedef enum {RELU, TANH, SIGMOID, NONE, LEAKY_RELU} DNNActivationFunc;
-typedef enum {VALID, SAME, SAME_CLAMP_TO_EDGE} DNNConvPaddingParam;
+// SAME_REFLECT and SAME_SYMMETRIC are not stored in the model file,
+// they come from a mirror pad folded into the conv2d
+typedef enum {VALID, SAME, SAME_CLAMP_TO_EDGE, SAME_REFLECT, SAME_SYMMETRIC} DNNConvPaddingParam;
 
 typedef struct ConvolutionalParams{
     int32_t input_num, output_num, kernel_size;
@@ -34,9 +36,12 @@ typedef struct ConvolutionalParams{
     int32_t has_bias;
     float *kernel;
     float *biases;
+    // the kernel points into the mapped model file and must not be freed or written
+    int kernel_mapped;
 } ConvolutionalParams;
 
-int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num);
+int dnn_load_layer_conv2d(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                          const NativeModelMap *map);
 int dnn_execute_layer_conv2d(DnnOperand *operands, const int32_t *input_operand_indexes,
-                             int32_t output_operand_index, const void *parameters);
+                             int32_t output_operand_index, const void *parameters, NativeContext *ctx);
 #endif
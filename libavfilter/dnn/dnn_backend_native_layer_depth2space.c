@@ -27,7 +27,8 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_depth2space.h"
 
-int dnn_load_layer_depth2space(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
+int dnn_load_layer_depth2space(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                               const NativeModelMap *map)
 {
     DepthToSpaceParams *params;
     int dnn_size = 0;
@@ -50,7 +51,7 @@ int dnn_load_layer_depth2space(Layer *layer, AVIOContext *model_file_context, in
 }
 
 int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_operand_indexes,
-                                  int32_t output_operand_index, const void *parameters)
+                                  int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
     float *output;
     const DepthToSpaceParams *params = (const DepthToSpaceParams *)parameters;
@@ -62,7 +63,7 @@ int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_ope
     int channels = operands[input_operand_index].dims[3];
     const float *input = operands[input_operand_index].data;
 
-    int y, x, by, bx, ch;
+    int y, x, by;
     int new_channels = channels / (block_size * block_size);
     int output_linesize = width * channels;
     int by_linesize = output_linesize / block_size;
@@ -74,23 +75,17 @@ int dnn_execute_layer_depth2space(DnnOperand *operands, const int32_t *input_ope
     output_operand->dims[2] = width * block_size;
     output_operand->dims[3] = new_channels;
     output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    if (output_operand->length <= 0)
-        return -1;
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
+    if (ff_dnn_native_alloc_operand(ctx, operands, output_operand_index) < 0)
         return -1;
     output = output_operand->data;
 
     for (y = 0; y < height; ++y){
         for (x = 0; x < width; ++x){
             for (by = 0; by < block_size; ++by){
-                for (bx = 0; bx < block_size; ++bx){
-                    for (ch = 0; ch < new_channels; ++ch){
-                        output[by * by_linesize + x * x_linesize + bx * new_channels + ch] = input[ch];
-                    }
-                    input += new_channels;
-                }
+                // the channels of a block row are contiguous in both input and output
+                memcpy(output + by * by_linesize + x * x_linesize, input,
+                       x_linesize * sizeof(*output));
+                input += x_linesize;
             }
         }
         output += output_linesize;
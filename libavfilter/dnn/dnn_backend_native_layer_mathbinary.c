@@ -27,7 +27,8 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_mathbinary.h"
 
-int dnn_load_layer_math_binary(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
+int dnn_load_layer_math_binary(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                               const NativeModelMap *map)
 {
     DnnLayerMathBinaryParams *params;
     int dnn_size = 0;
@@ -77,7 +78,7 @@ int dnn_load_layer_math_binary(Layer *layer, AVIOContext *model_file_context, in
 }
 
 int dnn_execute_layer_math_binary(DnnOperand *operands, const int32_t *input_operand_indexes,
-                                 int32_t output_operand_index, const void *parameters)
+                                 int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
     const DnnOperand *input = &operands[input_operand_indexes[0]];
     DnnOperand *output = &operands[output_operand_index];
@@ -90,11 +91,7 @@ int dnn_execute_layer_math_binary(DnnOperand *operands, const int32_t *input_ope
         output->dims[i] = input->dims[i];
 
     output->data_type = input->data_type;
-    output->length = calculate_operand_data_length(output);
-    if (output->length <= 0)
-        return DNN_ERROR;
-    output->data = av_realloc(output->data, output->length);
-    if (!output->data)
+    if (ff_dnn_native_alloc_operand(ctx, operands, output_operand_index) < 0)
         return DNN_ERROR;
 
     dims_count = calculate_operand_dims_count(output);
@@ -27,7 +27,8 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_maximum.h"
 
-int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
+int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                           const NativeModelMap *map)
 {
     DnnLayerMaximumParams *params;
     int dnn_size = 0;
@@ -50,7 +51,7 @@ int dnn_load_layer_maximum(Layer *layer, AVIOContext *model_file_context, int fi
 }
 
 int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand_indexes,
-                              int32_t output_operand_index, const void *parameters)
+                              int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
     const DnnOperand *input = &operands[input_operand_indexes[0]];
     DnnOperand *output = &operands[output_operand_index];
@@ -63,11 +64,7 @@ int dnn_execute_layer_maximum(DnnOperand *operands, const int32_t *input_operand
         output->dims[i] = input->dims[i];
 
     output->data_type = input->data_type;
-    output->length = calculate_operand_data_length(output);
-    if (output->length <= 0)
-        return DNN_ERROR;
-    output->data = av_realloc(output->data, output->length);
-    if (!output->data)
+    if (ff_dnn_native_alloc_operand(ctx, operands, output_operand_index) < 0)
         return DNN_ERROR;
 
     dims_count = calculate_operand_dims_count(output);
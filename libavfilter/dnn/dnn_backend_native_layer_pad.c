@@ -22,7 +22,8 @@
 #include "libavutil/avassert.h"
 #include "dnn_backend_native_layer_pad.h"
 
-int dnn_load_layer_pad(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num)
+int dnn_load_layer_pad(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                       const NativeModelMap *map)
 {
     LayerPadParams *params;
     int dnn_size = 0;
@@ -32,6 +33,8 @@ int dnn_load_layer_pad(Layer *layer, AVIOContext *model_file_context, int file_s
 
     params->mode = (int32_t)avio_rl32(model_file_context);
     dnn_size += 4;
+    // the model file has no constant value, the constant pads are zero pads
+    params->constant_values = 0;
     for (int i = 0; i < 4; ++i) {
         params->paddings[i][0] = avio_rl32(model_file_context);
         params->paddings[i][1] = avio_rl32(model_file_context);
@@ -76,7 +79,7 @@ static int after_get_buddy(int given, int border, LayerPadModeParam mode)
 }
 
 int dnn_execute_layer_pad(DnnOperand *operands, const int32_t *input_operand_indexes,
-                          int32_t output_operand_index, const void *parameters)
+                          int32_t output_operand_index, const void *parameters, NativeContext *ctx)
 {
     int32_t before_paddings;
     int32_t after_paddings;
@@ -110,11 +113,7 @@ int dnn_execute_layer_pad(DnnOperand *operands, const int32_t *input_operand_ind
     output_operand->dims[2] = new_width;
     output_operand->dims[3] = new_channel;
     output_operand->data_type = operands[input_operand_index].data_type;
-    output_operand->length = calculate_operand_data_length(output_operand);
-    if (output_operand->length <= 0)
-        return -1;
-    output_operand->data = av_realloc(output_operand->data, output_operand->length);
-    if (!output_operand->data)
+    if (ff_dnn_native_alloc_operand(ctx, operands, output_operand_index) < 0)
         return -1;
     output = output_operand->data;
 
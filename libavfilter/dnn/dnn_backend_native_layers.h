@@ -25,8 +25,9 @@
 #include "dnn_backend_native.h"
 
 typedef int (*LAYER_EXEC_FUNC)(DnnOperand *operands, const int32_t *input_operand_indexes,
-                               int32_t output_operand_index, const void *parameters);
-typedef int (*LAYER_LOAD_FUNC)(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num);
+                               int32_t output_operand_index, const void *parameters, NativeContext *ctx);
+typedef int (*LAYER_LOAD_FUNC)(Layer *layer, AVIOContext *model_file_context, int file_size, int operands_num,
+                               const NativeModelMap *map);
 
 typedef struct LayerFunc {
     LAYER_EXEC_FUNC pf_exec;
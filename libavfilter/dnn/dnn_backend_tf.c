@@ -490,7 +490,8 @@ static DNNReturnType load_native_model(TFModel *tf_model, const char *model_file
     DNNModel *native_model = NULL;
     ConvolutionalNetwork *conv_network;
 
-    native_model = ff_dnn_load_model_native(model_filename);
+    // the layers are converted one to one, the fused layers of the native backend are not supported
+    native_model = ff_dnn_load_model_native(model_filename, "optimize=0");
     if (!native_model){
         return DNN_ERROR;
     }
@@ -572,12 +573,12 @@ static DNNReturnType load_native_model(TFModel *tf_model, const char *model_file
     return DNN_SUCCESS;
 }
 
-DNNModel *ff_dnn_load_model_tf(const char *model_filename)
+DNNModel *ff_dnn_load_model_tf(const char *model_filename, const char *options)
 {
     DNNModel *model = NULL;
     TFModel *tf_model = NULL;
 
-    model = av_malloc(sizeof(DNNModel));
+    model = av_mallocz(sizeof(DNNModel));
     if (!model){
         return NULL;
     }
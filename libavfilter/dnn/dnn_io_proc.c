@@ -0,0 +1,438 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DNN input pre-processing for the DNN based filters.
+ */
+
+#include "dnn_io_proc.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/intfloat.h"
+#include "libavutil/internal.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+// rounds to the nearest half-precision value, ties to even
+static uint16_t float_to_half(float f)
+{
+    uint32_t x    = av_float2int(f);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t mant = x & 0x7fffff;
+    int exp = (int)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t half, rem, mid;
+    int shift;
+
+    if (exp >= 31) // overflow, infinity or nan
+        return sign | 0x7c00 | ((x & 0x7fffffff) > 0x7f800000 ? 0x200 : 0);
+
+    if (exp <= 0) { // subnormal
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        shift = 14 - exp;
+    } else {
+        mant |= exp << 23;
+        shift = 13;
+    }
+    half = mant >> shift;
+    rem  = mant & ((1 << shift) - 1);
+    mid  = 1 << (shift - 1);
+    if (rem > mid || (rem == mid && (half & 1)))
+        half++;
+
+    return sign | half;
+}
+
+static float half_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t mant = h & 0x3ff;
+    int exp = (h >> 10) & 0x1f;
+
+    if (exp == 31)
+        return av_int2float(sign | 0x7f800000 | mant << 13);
+    if (!exp)
+        return (sign ? -1.f : 1.f) * mant * (1.f / (1 << 24));
+    return av_int2float(sign | (exp + 112) << 23 | mant << 13);
+}
+
+size_t ff_dnn_data_size(const DNNData *data)
+{
+    size_t size = (size_t)data->width * data->height * data->channels;
+
+    switch (data->dt) {
+    case DNN_FLOAT:
+        return size * sizeof(float);
+    case DNN_HALF:
+        return size * sizeof(uint16_t);
+    default:
+        return size;
+    }
+}
+
+void ff_dnn_half_to_uint8(uint8_t *dst, int dst_linesize,
+                          const uint16_t *src, int src_linesize, int w, int h)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++)
+            dst[x] = av_clip_uint8(lrintf(half_to_float(src[x]) * 255.f));
+        dst += dst_linesize;
+        src += src_linesize / sizeof(*src);
+    }
+}
+
+int ff_dnn_preproc_init(DNNPreProc *pp, void *log_ctx,
+                        int src_w, int src_h, enum AVPixelFormat src_fmt,
+                        const DNNData *input, enum AVPixelFormat dst_fmt,
+                        float mean, float scale)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dst_fmt);
+    int need_sws;
+
+    if (input->width <= 0 || input->height <= 0) {
+        av_log(log_ctx, AV_LOG_ERROR, "the model input size is not known\n");
+        return AVERROR(EINVAL);
+    }
+    if (!desc || desc->nb_components != input->channels) {
+        av_log(log_ctx, AV_LOG_ERROR, "%s does not match the model input channel %d\n",
+               av_get_pix_fmt_name(dst_fmt), input->channels);
+        return AVERROR(EINVAL);
+    }
+    if (input->dt != DNN_FLOAT &&
+        ((input->dt != DNN_UINT8 && input->dt != DNN_HALF) || dst_fmt == AV_PIX_FMT_GRAYF32)) {
+        av_log(log_ctx, AV_LOG_ERROR, "%s is not supported for the model input data type\n",
+               av_get_pix_fmt_name(dst_fmt));
+        return AVERROR(EINVAL);
+    }
+
+    pp->src_fmt = src_fmt;
+    pp->dst_fmt = dst_fmt;
+    pp->src_w   = src_w;
+    pp->src_h   = src_h;
+    pp->dst_w   = input->width;
+    pp->dst_h   = input->height;
+    pp->channels = input->channels;
+    pp->dt      = input->dt;
+    pp->mean    = mean;
+    pp->scale   = scale;
+
+    need_sws = src_fmt != dst_fmt || src_w != pp->dst_w || src_h != pp->dst_h;
+    if (need_sws) {
+        // reinitializing for another source size, e.g. the next region, reuses the context
+        pp->sws = sws_getCachedContext(pp->sws, src_w, src_h, src_fmt,
+                                       pp->dst_w, pp->dst_h, dst_fmt,
+                                       SWS_BICUBIC, NULL, NULL, NULL);
+        if (!pp->sws) {
+            av_log(log_ctx, AV_LOG_ERROR, "could not convert %dx%d %s to %dx%d %s\n",
+                   src_w, src_h, av_get_pix_fmt_name(src_fmt),
+                   pp->dst_w, pp->dst_h, av_get_pix_fmt_name(dst_fmt));
+            return AVERROR(EINVAL);
+        }
+    } else {
+        sws_freeContext(pp->sws);
+        pp->sws = NULL;
+    }
+
+    if (pp->dt != DNN_UINT8 && dst_fmt != AV_PIX_FMT_GRAYF32) {
+        for (int i = 0; i < 256; i++) {
+            pp->lut[i]      = ((float)i - mean) * scale;
+            pp->lut_half[i] = float_to_half(pp->lut[i]);
+        }
+
+        if (need_sws) {
+            pp->buf_linesize = av_image_get_linesize(dst_fmt, pp->dst_w, 0);
+            av_fast_malloc(&pp->buf, &pp->buf_size, (size_t)pp->buf_linesize * pp->dst_h);
+            if (!pp->buf)
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return 0;
+}
+
+int ff_dnn_preproc_run(DNNPreProc *pp, const uint8_t *const src[4],
+                       const int src_linesize[4], DNNData *input)
+{
+    int dst_linesize = av_image_get_linesize(pp->dst_fmt, pp->dst_w, 0);
+    const uint8_t *samples;
+    int samples_linesize;
+
+    if (pp->dt == DNN_UINT8 || pp->dst_fmt == AV_PIX_FMT_GRAYF32) {
+        // the samples already have the type of the model input
+        if (pp->sws) {
+            sws_scale(pp->sws, src, src_linesize, 0, pp->src_h,
+                      (uint8_t *const [4]){ input->data }, (const int [4]){ dst_linesize });
+        } else {
+            av_image_copy_plane(input->data, dst_linesize, src[0], src_linesize[0],
+                                dst_linesize, pp->dst_h);
+        }
+        return 0;
+    }
+
+    if (pp->sws) {
+        sws_scale(pp->sws, src, src_linesize, 0, pp->src_h,
+                  (uint8_t *const [4]){ pp->buf }, (const int [4]){ pp->buf_linesize });
+        samples          = pp->buf;
+        samples_linesize = pp->buf_linesize;
+    } else {
+        samples          = src[0];
+        samples_linesize = src_linesize[0];
+    }
+
+    if (pp->dt == DNN_HALF) {
+        uint16_t *dst = input->data;
+        for (int y = 0; y < pp->dst_h; y++) {
+            for (int x = 0; x < dst_linesize; x++)
+                dst[x] = pp->lut_half[samples[x]];
+            dst     += dst_linesize;
+            samples += samples_linesize;
+        }
+    } else {
+        float *dst = input->data;
+        for (int y = 0; y < pp->dst_h; y++) {
+            for (int x = 0; x < dst_linesize; x++)
+                dst[x] = pp->lut[samples[x]];
+            dst     += dst_linesize;
+            samples += samples_linesize;
+        }
+    }
+
+    return 0;
+}
+
+int ff_dnn_preproc_run_region(DNNPreProc *pp, void *log_ctx, const AVFrame *frame,
+                              int *x, int *y, int *w, int *h, DNNData *input)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    DNNData model_input = {
+        .width    = pp->dst_w,
+        .height   = pp->dst_h,
+        .channels = pp->channels,
+        .dt       = pp->dt,
+    };
+    const uint8_t *data[4] = { NULL };
+    int max_step[4];
+    int x0, y0, x1, y1, ret;
+
+    // align the region to the chroma subsampling, so that all planes start at the same pixel
+    x0 = av_clip(*x, 0, frame->width)  & ~((1 << desc->log2_chroma_w) - 1);
+    y0 = av_clip(*y, 0, frame->height) & ~((1 << desc->log2_chroma_h) - 1);
+    x1 = av_clip(*x + (int64_t)*w, 0, frame->width);
+    y1 = av_clip(*y + (int64_t)*h, 0, frame->height);
+
+    *x = x0;
+    *y = y0;
+    *w = FFMAX(x1 - x0, 0);
+    *h = FFMAX(y1 - y0, 0);
+    if (!*w || !*h) {
+        *w = *h = 0;
+        return 0;
+    }
+
+    av_image_fill_max_pixsteps(max_step, NULL, desc);
+    for (int i = 0; i < 4 && frame->data[i]; i++) {
+        int shift_x = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+        int shift_y = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+        data[i] = frame->data[i] + (y0 >> shift_y) * frame->linesize[i] +
+                  (x0 >> shift_x) * max_step[i];
+    }
+
+    ret = ff_dnn_preproc_init(pp, log_ctx, *w, *h, frame->format, &model_input,
+                              pp->dst_fmt, pp->mean, pp->scale);
+    if (ret < 0)
+        return ret;
+
+    return ff_dnn_preproc_run(pp, data, frame->linesize, input);
+}
+
+void ff_dnn_preproc_uninit(DNNPreProc *pp)
+{
+    sws_freeContext(pp->sws);
+    pp->sws = NULL;
+    av_freep(&pp->buf);
+    pp->buf_size = 0;
+}
+
+static size_t pixel_size(const DNNData *data)
+{
+    DNNData pixel = *data;
+
+    pixel.width = pixel.height = 1;
+    return ff_dnn_data_size(&pixel);
+}
+
+int ff_dnn_tiles_init(DNNTiles *t, void *log_ctx, DNNModule *module, DNNModel *model,
+                      DNNData *input, const char *input_name, const char *output_name,
+                      int tile_size, int overlap, DNNData *output)
+{
+    DNNData out;
+    DNNReturnType result;
+
+    t->module  = module;
+    t->model   = model;
+    t->input   = *input;
+    t->overlap = overlap;
+    t->tile_w  = FFMIN(tile_size, input->width);
+    t->tile_h  = FFMIN(tile_size, input->height);
+
+    if ((t->tile_w < input->width  && t->tile_w <= 2 * overlap) ||
+        (t->tile_h < input->height && t->tile_h <= 2 * overlap)) {
+        av_log(log_ctx, AV_LOG_ERROR, "tile size %d leaves nothing of the overlap %d\n",
+               tile_size, overlap);
+        return AVERROR(EINVAL);
+    }
+
+    t->tile_in        = *input;
+    t->tile_in.width  = t->tile_w;
+    t->tile_in.height = t->tile_h;
+    result = model->set_input_output(model->model, &t->tile_in, input_name, &output_name, 1);
+    if (result != DNN_SUCCESS) {
+        av_log(log_ctx, AV_LOG_ERROR, "could not set input and output for the model\n");
+        return AVERROR(EIO);
+    }
+
+    // trial run to find the output size of a tile
+    memset(t->tile_in.data, 0, ff_dnn_data_size(&t->tile_in));
+    result = module->execute_model(model, &out, 1);
+    if (result != DNN_SUCCESS) {
+        av_log(log_ctx, AV_LOG_ERROR, "failed to execute the model\n");
+        return AVERROR(EIO);
+    }
+    t->scale = out.width / t->tile_w;
+    if (t->scale < 1 || out.width != t->tile_w * t->scale || out.height != t->tile_h * t->scale) {
+        av_log(log_ctx, AV_LOG_ERROR, "the model output %dx%d is not an integer multiple "
+               "of its input %dx%d, it cannot be run on tiles\n",
+               out.width, out.height, t->tile_w, t->tile_h);
+        return AVERROR(EINVAL);
+    }
+
+    t->output        = out;
+    t->output.width  = t->input.width  * t->scale;
+    t->output.height = t->input.height * t->scale;
+
+    t->in_buf  = av_malloc(ff_dnn_data_size(&t->input));
+    t->out_buf = av_malloc(ff_dnn_data_size(&t->output));
+    if (!t->in_buf || !t->out_buf)
+        return AVERROR(ENOMEM);
+    t->input.data  = t->in_buf;
+    t->output.data = t->out_buf;
+
+    *input  = t->input;
+    *output = t->output;
+    return 0;
+}
+
+/**
+ * Gets the position of the tile of index in the input and the core of it
+ * which is kept in the output.
+ */
+static void tile_rect(const DNNTiles *t, int index, int *x0, int *y0,
+                      int *cx, int *cy, int *cw, int *ch)
+{
+    int core_w = t->tile_w < t->input.width  ? t->tile_w - 2 * t->overlap : t->tile_w;
+    int core_h = t->tile_h < t->input.height ? t->tile_h - 2 * t->overlap : t->tile_h;
+    int nb_x   = (t->input.width + core_w - 1) / core_w;
+
+    *cx = index % nb_x * core_w;
+    *cy = index / nb_x * core_h;
+    *cw = FFMIN(core_w, t->input.width  - *cx);
+    *ch = FFMIN(core_h, t->input.height - *cy);
+    *x0 = av_clip(*cx - t->overlap, 0, t->input.width  - t->tile_w);
+    *y0 = av_clip(*cy - t->overlap, 0, t->input.height - t->tile_h);
+}
+
+static int nb_tiles(const DNNTiles *t)
+{
+    int core_w = t->tile_w < t->input.width  ? t->tile_w - 2 * t->overlap : t->tile_w;
+    int core_h = t->tile_h < t->input.height ? t->tile_h - 2 * t->overlap : t->tile_h;
+
+    return ((t->input.width  + core_w - 1) / core_w) *
+           ((t->input.height + core_h - 1) / core_h);
+}
+
+static void tile_load(const DNNTiles *t, int index, uint8_t *dst)
+{
+    size_t pix = pixel_size(&t->input);
+    int x0, y0, cx, cy, cw, ch;
+
+    tile_rect(t, index, &x0, &y0, &cx, &cy, &cw, &ch);
+    av_image_copy_plane(dst, t->tile_w * pix,
+                        t->in_buf + (y0 * (size_t)t->input.width + x0) * pix,
+                        t->input.width * pix, t->tile_w * pix, t->tile_h);
+}
+
+static void tile_store(const DNNTiles *t, int index, const DNNData *out)
+{
+    size_t pix = pixel_size(&t->output);
+    int s = t->scale;
+    int x0, y0, cx, cy, cw, ch;
+
+    tile_rect(t, index, &x0, &y0, &cx, &cy, &cw, &ch);
+    av_image_copy_plane(t->out_buf + (cy * s * (size_t)t->output.width + cx * s) * pix,
+                        t->output.width * pix,
+                        (const uint8_t *)out->data +
+                        ((cy - y0) * s * (size_t)out->width + (cx - x0) * s) * pix,
+                        out->width * pix, cw * s * pix, ch * s);
+}
+
+int ff_dnn_tiles_run(DNNTiles *t, void *log_ctx)
+{
+    int nb = nb_tiles(t);
+
+    for (int i = 0; i < nb; i++) {
+        DNNData out;
+
+        tile_load(t, i, t->tile_in.data);
+        if (t->module->execute_model(t->model, &out, 1) != DNN_SUCCESS) {
+            av_log(log_ctx, AV_LOG_ERROR, "failed to execute the model on a tile\n");
+            return AVERROR(EIO);
+        }
+        tile_store(t, i, &out);
+    }
+    return 0;
+}
+
+void ff_dnn_tiles_uninit(DNNTiles *t)
+{
+    av_freep(&t->in_buf);
+    av_freep(&t->out_buf);
+}
+
+double ff_dnn_scene_score(ff_scene_sad_fn sad, const AVFrame *ref, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int nb_planes = av_pix_fmt_count_planes(frame->format);
+    uint64_t total = 0, count = 0;
+
+    for (int i = 0; i < nb_planes; i++) {
+        int width  = av_image_get_linesize(frame->format, frame->width, i);
+        int height = (i == 1 || i == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h)
+                                        : frame->height;
+        uint64_t plane_sad;
+
+        sad(ref->data[i], ref->linesize[i], frame->data[i], frame->linesize[i],
+            width, height, &plane_sad);
+        total += plane_sad;
+        count += (uint64_t)width * height;
+    }
+    emms_c();
+
+    return count ? (double)total * 100. / count / 256 : 0;
+}
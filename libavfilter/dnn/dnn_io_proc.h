@@ -0,0 +1,166 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DNN input pre-processing for the DNN based filters.
+ */
+
+#ifndef AVFILTER_DNN_DNN_IO_PROC_H
+#define AVFILTER_DNN_DNN_IO_PROC_H
+
+#include "../dnn_interface.h"
+#include "../scene_sad.h"
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#include "libswscale/swscale.h"
+
+/**
+ * Converts image data to the input of a model: the image is resized to
+ * the model input dimensions and converted to its pixel layout by a single
+ * swscale pass, 8-bit samples are normalized to float or half-precision
+ * float with (sample - mean) * scale through a lookup table.
+ *
+ * The passes which are not needed are skipped, data which already has
+ * the layout and size of the model input is normalized in place of the copy.
+ */
+typedef struct DNNPreProc {
+    struct SwsContext *sws;
+    enum AVPixelFormat src_fmt;
+    enum AVPixelFormat dst_fmt;
+    int src_w, src_h;
+    int dst_w, dst_h;
+    int channels;
+    DNNDataType dt;
+    float mean, scale;
+
+    // 8-bit samples in the model layout, when they have to be normalized after swscale
+    uint8_t *buf;
+    unsigned int buf_size;
+    int buf_linesize;
+
+    float lut[256];
+    uint16_t lut_half[256];
+} DNNPreProc;
+
+/**
+ * Initializes the pre-processing of src_w x src_h images of src_fmt
+ * to the input of a model. It can be called again to change the source,
+ * the resources of the previous call are reused when possible.
+ *
+ * @param input    width, height, channels and data type of the model input,
+ *                 the dimensions must be known
+ * @param dst_fmt  pixel layout of the model input, one of AV_PIX_FMT_GRAY8,
+ *                 AV_PIX_FMT_RGB24 and AV_PIX_FMT_BGR24 for 8-bit sources,
+ *                 AV_PIX_FMT_GRAYF32 for float sources
+ * @param mean     value subtracted from the 8-bit samples for a float or half model input
+ * @param scale    factor applied to the 8-bit samples for a float or half model input
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_dnn_preproc_init(DNNPreProc *pp, void *log_ctx,
+                        int src_w, int src_h, enum AVPixelFormat src_fmt,
+                        const DNNData *input, enum AVPixelFormat dst_fmt,
+                        float mean, float scale);
+
+/**
+ * Fills input->data with the pre-processed image.
+ */
+int ff_dnn_preproc_run(DNNPreProc *pp, const uint8_t *const src[4],
+                       const int src_linesize[4], DNNData *input);
+
+/**
+ * Fills input->data with the pre-processed region x, y, w, h of the frame.
+ * The region is clipped to the frame and its origin is aligned to the chroma
+ * subsampling, the region actually used is written back, with *w and *h set
+ * to 0 and input->data left untouched if nothing of it is in the frame.
+ *
+ * ff_dnn_preproc_init() must have been called first to set the model input,
+ * the source is reinitialized for the format of the frame and the region size.
+ */
+int ff_dnn_preproc_run_region(DNNPreProc *pp, void *log_ctx, const AVFrame *frame,
+                              int *x, int *y, int *w, int *h, DNNData *input);
+
+void ff_dnn_preproc_uninit(DNNPreProc *pp);
+
+/**
+ * Gives the size in bytes of the samples of data.
+ */
+size_t ff_dnn_data_size(const DNNData *data);
+
+/**
+ * Converts w x h half-precision samples in [0, 1] to 8-bit samples,
+ * as swscale converts AV_PIX_FMT_GRAYF32 to AV_PIX_FMT_GRAY8.
+ * The linesizes are in bytes.
+ */
+void ff_dnn_half_to_uint8(uint8_t *dst, int dst_linesize,
+                          const uint16_t *src, int src_linesize, int w, int h);
+
+/**
+ * Runs a model on overlapping tiles of its input, so that the memory of the
+ * intermediate operands is bounded by the tile size.
+ */
+typedef struct DNNTiles {
+    DNNModule *module;
+    DNNModel *model;
+
+    // whole input and output, their data are in_buf and out_buf
+    DNNData input, output;
+    // input of the model, tile_w x tile_h pixels
+    DNNData tile_in;
+    int tile_w, tile_h;
+    // pixels of context added to each side of the core of a tile
+    int overlap;
+    // output size divided by input size
+    int scale;
+
+    uint8_t *in_buf;
+    uint8_t *out_buf;
+} DNNTiles;
+
+/**
+ * Sets the model input to tiles of at most tile_size x tile_size pixels
+ * and finds the output size with a trial run.
+ *
+ * @param input   width, height, channels and data type of the whole input,
+ *                its data is set to a buffer to be filled before each run
+ * @param overlap pixels of context on each side of the part of a tile which
+ *                is kept, the results match an untiled run when it covers the
+ *                receptive field radius of the model
+ * @param output  set to the description and the buffer of the whole output
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_dnn_tiles_init(DNNTiles *t, void *log_ctx, DNNModule *module, DNNModel *model,
+                      DNNData *input, const char *input_name, const char *output_name,
+                      int tile_size, int overlap, DNNData *output);
+
+/**
+ * Runs the model on all the tiles of the input set up by ff_dnn_tiles_init()
+ * and assembles the output.
+ */
+int ff_dnn_tiles_run(DNNTiles *t, void *log_ctx);
+
+void ff_dnn_tiles_uninit(DNNTiles *t);
+
+/**
+ * Gives the scene change score between two frames of the same 8-bit format
+ * and size, measured as in vf_scdet: the mean absolute difference of all the
+ * samples of the frames, in percent of the sample range.
+ */
+double ff_dnn_scene_score(ff_scene_sad_fn sad, const AVFrame *ref, const AVFrame *frame);
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DNN input pre-processing of OpenCL frames for the DNN based filters.
+ */
+
+#include "dnn_io_proc.h"
+#include "dnn_io_proc_opencl.h"
+#include "../colorspace.h"
+#include "../opencl_source.h"
+#include "libavutil/bprint.h"
+#include "libavutil/hwcontext.h"
+#include "libavutil/log.h"
+#include "libavutil/pixdesc.h"
+
+static const enum AVPixelFormat supported_formats[] = {
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_P010,
+    AV_PIX_FMT_P016,
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV422P,
+    AV_PIX_FMT_YUV444P,
+};
+
+static int load_program(DNNPreProcOpenCL *pp, void *avctx, const char *header)
+{
+    const char *sources[] = { header, ff_opencl_source_dnn_preproc };
+    cl_int cle;
+
+    pp->program = clCreateProgramWithSource(pp->hwctx->context, FF_ARRAY_ELEMS(sources),
+                                            sources, NULL, &cle);
+    if (!pp->program) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to create program: %d.\n", cle);
+        return AVERROR(EIO);
+    }
+
+    cle = clBuildProgram(pp->program, 1, &pp->hwctx->device_id, NULL, NULL, NULL);
+    if (cle != CL_SUCCESS) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to build program: %d.\n", cle);
+
+        if (cle == CL_BUILD_PROGRAM_FAILURE) {
+            char *log;
+            size_t log_length;
+
+            clGetProgramBuildInfo(pp->program, pp->hwctx->device_id,
+                                  CL_PROGRAM_BUILD_LOG, 0, NULL, &log_length);
+
+            log = av_malloc(log_length);
+            if (log) {
+                cle = clGetProgramBuildInfo(pp->program, pp->hwctx->device_id,
+                                            CL_PROGRAM_BUILD_LOG, log_length, log, NULL);
+                if (cle == CL_SUCCESS)
+                    av_log(avctx, AV_LOG_ERROR, "Build log:\n%s\n", log);
+            }
+
+            av_free(log);
+        }
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+int ff_dnn_preproc_opencl_init(DNNPreProcOpenCL *pp, void *avctx, AVBufferRef *frames_ref,
+                               const DNNData *input, enum AVPixelFormat dst_fmt,
+                               float mean, float scale)
+{
+    AVHWFramesContext *frames = (AVHWFramesContext *)frames_ref->data;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frames->sw_format);
+    AVBPrint header;
+    cl_int cle;
+    int i, err;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(supported_formats); i++) {
+        if (frames->sw_format == supported_formats[i])
+            break;
+    }
+    if (i == FF_ARRAY_ELEMS(supported_formats)) {
+        av_log(avctx, AV_LOG_ERROR, "%s OpenCL frames are not supported\n",
+               av_get_pix_fmt_name(frames->sw_format));
+        return AVERROR(ENOSYS);
+    }
+    if (input->width <= 0 || input->height <= 0) {
+        av_log(avctx, AV_LOG_ERROR, "the model input size is not known\n");
+        return AVERROR(EINVAL);
+    }
+    if ((dst_fmt == AV_PIX_FMT_GRAY8 ? 1 : 3) != input->channels ||
+        (dst_fmt != AV_PIX_FMT_GRAY8 && dst_fmt != AV_PIX_FMT_RGB24 && dst_fmt != AV_PIX_FMT_BGR24)) {
+        av_log(avctx, AV_LOG_ERROR, "%s does not match the model input channel %d\n",
+               av_get_pix_fmt_name(dst_fmt), input->channels);
+        return AVERROR(EINVAL);
+    }
+
+    ff_dnn_preproc_opencl_uninit(pp, avctx);
+
+    pp->device_ref = av_buffer_ref(frames->device_ref);
+    if (!pp->device_ref)
+        return AVERROR(ENOMEM);
+    pp->hwctx     = ((AVHWDeviceContext *)pp->device_ref->data)->hwctx;
+    pp->sw_format = frames->sw_format;
+    pp->dst_w     = input->width;
+    pp->dst_h     = input->height;
+    pp->mean      = mean;
+    pp->scale     = scale;
+
+    av_bprint_init(&header, 256, AV_BPRINT_SIZE_AUTOMATIC);
+    if (desc->nb_components == 3 && desc->comp[1].plane == desc->comp[2].plane)
+        av_bprintf(&header, "#define SEMI_PLANAR\n");
+    av_bprintf(&header, "#define CHROMA_W %d\n", desc->log2_chroma_w);
+    av_bprintf(&header, "#define CHROMA_H %d\n", desc->log2_chroma_h);
+    av_bprintf(&header, "#define CHANNELS %d\n", input->channels);
+    if (dst_fmt == AV_PIX_FMT_BGR24)
+        av_bprintf(&header, "#define BGR\n");
+    av_bprintf(&header, "#define %s\n", input->dt == DNN_FLOAT ? "OUT_FLOAT" :
+                                        input->dt == DNN_HALF  ? "OUT_HALF"  : "OUT_UINT8");
+    if (!av_bprint_is_complete(&header)) {
+        av_bprint_finalize(&header, NULL);
+        return AVERROR(ENOMEM);
+    }
+
+    err = load_program(pp, avctx, header.str);
+    av_bprint_finalize(&header, NULL);
+    if (err < 0)
+        return err;
+
+    pp->kernel = clCreateKernel(pp->program, "dnn_preproc", &cle);
+    if (!pp->kernel) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to create dnn_preproc kernel: %d.\n", cle);
+        return AVERROR(EIO);
+    }
+
+    pp->command_queue = clCreateCommandQueue(pp->hwctx->context, pp->hwctx->device_id, 0, &cle);
+    if (!pp->command_queue) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to create OpenCL command queue: %d.\n", cle);
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+int ff_dnn_preproc_opencl_run(DNNPreProcOpenCL *pp, void *avctx, const AVFrame *frame,
+                              int x, int y, int w, int h, DNNData *input)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pp->sw_format);
+    const struct LumaCoefficients *coeffs = ff_get_luma_coefficients(frame->colorspace);
+    int bits = desc->comp[0].depth + desc->comp[0].shift;
+    double max = (1 << bits) - 1;
+    size_t global_work[2] = { pp->dst_w, pp->dst_h };
+    size_t size = ff_dnn_data_size(input);
+    cl_mem src_y = (cl_mem)frame->data[0];
+    cl_mem src_u = (cl_mem)frame->data[1];
+    cl_mem src_v = (cl_mem)(frame->data[2] ? frame->data[2] : frame->data[1]);
+    cl_float4 region, range, mat;
+    cl_float2 norm;
+    cl_int cle;
+    int err;
+
+    if (size != pp->dst_size) {
+        CL_RELEASE_MEMORY(pp->dst);
+        pp->dst_size = 0;
+        pp->dst = clCreateBuffer(pp->hwctx->context, CL_MEM_WRITE_ONLY, size, NULL, &cle);
+        if (!pp->dst) {
+            av_log(avctx, AV_LOG_ERROR, "Failed to create the model input buffer: %d.\n", cle);
+            return AVERROR(EIO);
+        }
+        pp->dst_size = size;
+    }
+
+    // unspecified frames are converted as swscale does by default
+    if (!coeffs)
+        coeffs = ff_get_luma_coefficients(AVCOL_SPC_SMPTE170M);
+
+    region.s[0] = x;
+    region.s[1] = y;
+    region.s[2] = (float)w / pp->dst_w;
+    region.s[3] = (float)h / pp->dst_h;
+
+    // the samples are read normalized to the full range of their container
+    if (frame->color_range == AVCOL_RANGE_JPEG) {
+        range.s[0] = 0;
+        range.s[1] = 1;
+        range.s[3] = 1;
+    } else {
+        range.s[0] = (16 << (bits - 8)) / max;
+        range.s[1] = max / (219 << (bits - 8));
+        range.s[3] = max / (224 << (bits - 8));
+    }
+    range.s[2] = (128 << (bits - 8)) / max;
+
+    mat.s[0] = 2 * (1 - coeffs->cr);
+    mat.s[1] = 2 * coeffs->cb * (1 - coeffs->cb) / coeffs->cg;
+    mat.s[2] = 2 * coeffs->cr * (1 - coeffs->cr) / coeffs->cg;
+    mat.s[3] = 2 * (1 - coeffs->cb);
+
+    norm.s[0] = pp->mean;
+    norm.s[1] = pp->scale;
+
+    CL_SET_KERNEL_ARG(pp->kernel, 0, cl_mem, &src_y);
+    CL_SET_KERNEL_ARG(pp->kernel, 1, cl_mem, &src_u);
+    CL_SET_KERNEL_ARG(pp->kernel, 2, cl_mem, &src_v);
+    CL_SET_KERNEL_ARG(pp->kernel, 3, cl_mem, &pp->dst);
+    CL_SET_KERNEL_ARG(pp->kernel, 4, cl_int, &pp->dst_w);
+    CL_SET_KERNEL_ARG(pp->kernel, 5, cl_int, &pp->dst_h);
+    CL_SET_KERNEL_ARG(pp->kernel, 6, cl_float4, &region);
+    CL_SET_KERNEL_ARG(pp->kernel, 7, cl_float4, &range);
+    CL_SET_KERNEL_ARG(pp->kernel, 8, cl_float4, &mat);
+    CL_SET_KERNEL_ARG(pp->kernel, 9, cl_float2, &norm);
+
+    cle = clEnqueueNDRangeKernel(pp->command_queue, pp->kernel, 2, NULL,
+                                 global_work, NULL, 0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to enqueue dnn_preproc kernel: %d.\n", cle);
+
+    // only the model input is read back, the frame stays on the device
+    cle = clEnqueueReadBuffer(pp->command_queue, pp->dst, CL_TRUE, 0, size,
+                              input->data, 0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to read the model input: %d.\n", cle);
+
+    return 0;
+
+fail:
+    clFinish(pp->command_queue);
+    return err;
+}
+
+void ff_dnn_preproc_opencl_uninit(DNNPreProcOpenCL *pp, void *avctx)
+{
+    cl_int cle;
+
+    CL_RELEASE_MEMORY(pp->dst);
+    pp->dst = NULL;
+    pp->dst_size = 0;
+    CL_RELEASE_KERNEL(pp->kernel);
+    pp->kernel = NULL;
+    CL_RELEASE_QUEUE(pp->command_queue);
+    pp->command_queue = NULL;
+    if (pp->program) {
+        clReleaseProgram(pp->program);
+        pp->program = NULL;
+    }
+    av_buffer_unref(&pp->device_ref);
+    pp->hwctx = NULL;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DNN input pre-processing of OpenCL frames for the DNN based filters.
+ */
+
+#ifndef AVFILTER_DNN_DNN_IO_PROC_OPENCL_H
+#define AVFILTER_DNN_DNN_IO_PROC_OPENCL_H
+
+#include "../opencl.h"
+#include "../dnn_interface.h"
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+
+/**
+ * Converts OpenCL frames to the input of a model on the device: the frame
+ * is resized to the model input dimensions, converted from yuv to the pixel
+ * layout of the model and normalized as DNNPreProc does, only the resulting
+ * samples are read back to the model input.
+ */
+typedef struct DNNPreProcOpenCL {
+    AVBufferRef *device_ref;
+    AVOpenCLDeviceContext *hwctx;
+
+    cl_program program;
+    cl_kernel kernel;
+    cl_command_queue command_queue;
+    cl_mem dst;
+    size_t dst_size;
+
+    enum AVPixelFormat sw_format;
+    int dst_w, dst_h;
+    float mean, scale;
+} DNNPreProcOpenCL;
+
+/**
+ * Initializes the pre-processing of the frames of an OpenCL frames context.
+ *
+ * @param frames_ref the hardware frames context of the input,
+ *                   its software format must be 8 or 16-bit yuv
+ * @see ff_dnn_preproc_init() for the other parameters
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ff_dnn_preproc_opencl_init(DNNPreProcOpenCL *pp, void *avctx, AVBufferRef *frames_ref,
+                               const DNNData *input, enum AVPixelFormat dst_fmt,
+                               float mean, float scale);
+
+/**
+ * Fills input->data with the pre-processed region x, y, w, h of the frame,
+ * the region must be inside the frame.
+ */
+int ff_dnn_preproc_opencl_run(DNNPreProcOpenCL *pp, void *avctx, const AVFrame *frame,
+                              int x, int y, int w, int h, DNNData *input);
+
+void ff_dnn_preproc_opencl_uninit(DNNPreProcOpenCL *pp, void *avctx);
+
+#endif
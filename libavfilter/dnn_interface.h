@@ -32,7 +32,8 @@ typedef enum {DNN_SUCCESS, DNN_ERROR} DNNReturnType;
 
 typedef enum {DNN_NATIVE, DNN_TF, DNN_OV} DNNBackendType;
 
-typedef enum {DNN_FLOAT = 1, DNN_UINT8 = 4} DNNDataType;
+// the values match the TF_DataType of the tensorflow C API
+typedef enum {DNN_FLOAT = 1, DNN_UINT8 = 4, DNN_HALF = 19} DNNDataType;
 
 typedef struct DNNData{
     void *data;
@@ -54,7 +55,8 @@ typedef struct DNNModel{
 // Stores pointers to functions for loading, executing, freeing DNN models for one of the backends.
 typedef struct DNNModule{
     // Loads model and parameters from given file. Returns NULL if it is not possible.
-    DNNModel *(*load_model)(const char *model_filename);
+    // options is a '&' separated list of key=value backend options, can be NULL.
+    DNNModel *(*load_model)(const char *model_filename, const char *options);
     // Executes model with specified input and output. Returns DNN_ERROR otherwise.
     DNNReturnType (*execute_model)(const DNNModel *model, DNNData *outputs, uint32_t nb_output);
     // Frees memory allocated for model.
@@ -602,6 +602,38 @@ static void blend_line_hv(uint8_t *dst, int dst_delta,
 {
     int x;
 
+    /* 8-bit masks, without and with 2x2 subsampling: same as blend_pixel() */
+    if (l2depth == 3 && !hsub && !vsub) {
+        mask += xm;
+        for (x = 0; x < w; x++) {
+            unsigned a = mask[x] * alpha;
+            *dst = ((0x1010101 - a) * *dst + a * src) >> 24;
+            dst += dst_delta;
+        }
+        return;
+    }
+    if (l2depth == 3 && hsub == 1 && vsub == 1 && hband == 2) {
+        const uint8_t *mask1 = mask + mask_linesize;
+
+        if (left) {
+            blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
+                        left, hband, hsub + vsub, xm);
+            dst += dst_delta;
+            xm += left;
+        }
+        for (x = 0; x < w; x++) {
+            unsigned t = mask[xm] + mask[xm + 1] + mask1[xm] + mask1[xm + 1];
+            unsigned a = (t >> 2) * alpha;
+            *dst = ((0x1010101 - a) * *dst + a * src) >> 24;
+            dst += dst_delta;
+            xm += 2;
+        }
+        if (right)
+            blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
+                        right, hband, hsub + vsub, xm);
+        return;
+    }
+
     if (left) {
         blend_pixel(dst, src, alpha, mask, mask_linesize, l2depth,
                     left, hband, hsub + vsub, xm);
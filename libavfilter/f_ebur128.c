@@ -99,7 +99,8 @@ typedef struct EBUR128Context {
     double *sample_peaks;           ///< sample peaks per channel
     double *true_peaks_per_frame;   ///< true peaks in a frame per channel
 #if CONFIG_SWRESAMPLE
-    SwrContext *swr_ctx;            ///< over-sampling context for true peak metering
+    SwrContext **swr_ctx;           ///< per channel over-sampling contexts for true peak metering
+    int *swr_ch_map;                ///< identity channel map, one entry per over-sampling context
     double *swr_buf;                ///< resampled audio data for true peak metering
     int swr_linesize;
 #endif
@@ -149,6 +150,12 @@ typedef struct EBUR128Context {
     int scale;                      ///< display scale type of statistics
 } EBUR128Context;
 
+typedef struct ThreadData {
+    const double *samples;          ///< first interleaved input sample of the segment
+    int nb_samples;                 ///< number of samples in the segment
+    AVFrame *in;                    ///< input frame, for true peak metering
+} ThreadData;
+
 enum {
     PEAK_MODE_NONE          = 0,
     PEAK_MODE_SAMPLES_PEAKS = 1<<1,
@@ -446,22 +453,38 @@ static int config_audio_output(AVFilterLink *outlink)
         ebur128->swr_buf    = av_malloc_array(nb_channels, 19200 * sizeof(double));
         ebur128->true_peaks = av_calloc(nb_channels, sizeof(*ebur128->true_peaks));
         ebur128->true_peaks_per_frame = av_calloc(nb_channels, sizeof(*ebur128->true_peaks_per_frame));
-        ebur128->swr_ctx    = swr_alloc();
+        ebur128->swr_ctx    = av_calloc(nb_channels, sizeof(*ebur128->swr_ctx));
+        ebur128->swr_ch_map = av_calloc(nb_channels, sizeof(*ebur128->swr_ch_map));
         if (!ebur128->swr_buf || !ebur128->true_peaks ||
-            !ebur128->true_peaks_per_frame || !ebur128->swr_ctx)
+            !ebur128->true_peaks_per_frame || !ebur128->swr_ctx ||
+            !ebur128->swr_ch_map)
             return AVERROR(ENOMEM);
 
-        av_opt_set_int(ebur128->swr_ctx, "in_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "in_sample_rate",       outlink->sample_rate, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "in_sample_fmt", outlink->format, 0);
-
-        av_opt_set_int(ebur128->swr_ctx, "out_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "out_sample_rate",       192000, 0);
-        av_opt_set_sample_fmt(ebur128->swr_ctx, "out_sample_fmt", outlink->format, 0);
-
-        ret = swr_init(ebur128->swr_ctx);
-        if (ret < 0)
-            return ret;
+        /* One mono over-sampling context per channel, each picking its
+         * channel out of the interleaved input, so that the channels can
+         * be over-sampled in parallel. */
+        for (i = 0; i < nb_channels; i++) {
+            SwrContext *swr = ebur128->swr_ctx[i] = swr_alloc();
+            if (!swr)
+                return AVERROR(ENOMEM);
+
+            ebur128->swr_ch_map[i] = i;
+            av_opt_set_int(swr, "in_channel_count",      nb_channels, 0);
+            av_opt_set_int(swr, "used_channel_count",    1, 0);
+            av_opt_set_int(swr, "in_sample_rate",        outlink->sample_rate, 0);
+            av_opt_set_sample_fmt(swr, "in_sample_fmt",  outlink->format, 0);
+
+            av_opt_set_int(swr, "out_channel_layout",    AV_CH_LAYOUT_MONO, 0);
+            av_opt_set_int(swr, "out_sample_rate",       192000, 0);
+            av_opt_set_sample_fmt(swr, "out_sample_fmt", outlink->format, 0);
+
+            ret = swr_set_channel_mapping(swr, &ebur128->swr_ch_map[i]);
+            if (ret < 0)
+                return ret;
+            ret = swr_init(swr);
+            if (ret < 0)
+                return ret;
+        }
     }
 #endif
 
@@ -585,94 +608,166 @@ static int gate_update(struct integrator *integ, double power,
     return gate_hist_pos;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
+#if CONFIG_SWRESAMPLE
+static int true_peaks_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    int i, ch, idx_insample;
-    AVFilterContext *ctx = inlink->dst;
     EBUR128Context *ebur128 = ctx->priv;
+    ThreadData *td = arg;
     const int nb_channels = ebur128->nb_channels;
-    const int nb_samples  = insamples->nb_samples;
-    const double *samples = (double *)insamples->data[0];
-    AVFrame *pic = ebur128->outpicref;
-
-#if CONFIG_SWRESAMPLE
-    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
-        const double *swr_samples = ebur128->swr_buf;
-        int ret = swr_convert(ebur128->swr_ctx, (uint8_t**)&ebur128->swr_buf, 19200,
-                              (const uint8_t **)insamples->data, nb_samples);
+    const int start = (nb_channels *  jobnr   ) / nb_jobs;
+    const int end   = (nb_channels * (jobnr+1)) / nb_jobs;
+    int i, ch;
+
+    for (ch = start; ch < end; ch++) {
+        double *swr_samples = ebur128->swr_buf + ch * 19200;
+        double peak = 0.0;
+        int ret = swr_convert(ebur128->swr_ctx[ch], (uint8_t**)&swr_samples, 19200,
+                              (const uint8_t **)td->in->data, td->in->nb_samples);
         if (ret < 0)
             return ret;
-        for (ch = 0; ch < nb_channels; ch++)
-            ebur128->true_peaks_per_frame[ch] = 0.0;
-        for (idx_insample = 0; idx_insample < ret; idx_insample++) {
-            for (ch = 0; ch < nb_channels; ch++) {
-                ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], fabs(*swr_samples));
-                ebur128->true_peaks_per_frame[ch] = FFMAX(ebur128->true_peaks_per_frame[ch],
-                                                          fabs(*swr_samples));
-                swr_samples++;
-            }
-        }
+        for (i = 0; i < ret; i++)
+            peak = FFMAX(peak, fabs(swr_samples[i]));
+        ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], peak);
+        ebur128->true_peaks_per_frame[ch] = peak;
     }
-#endif
 
-    for (idx_insample = 0; idx_insample < nb_samples; idx_insample++) {
-        const int bin_id_400  = ebur128->i400.cache_pos;
-        const int bin_id_3000 = ebur128->i3000.cache_pos;
+    return 0;
+}
+#endif
 
-#define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
-    ebur128->i##time.cache_pos++;                           \
-    if (ebur128->i##time.cache_pos == I##time##_BINS) {     \
-        ebur128->i##time.filled    = 1;                     \
-        ebur128->i##time.cache_pos = 0;                     \
-    }                                                       \
+/* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
+#define FILTER(name, y0, y1, y2, x0, x1, x2) do {                               \
+    y2 = y1;                                                                    \
+    y1 = y0;                                                                    \
+    y0 = x0*name##_B0 + x1*name##_B1 + x2*name##_B2 - y1*name##_A1 - y2*name##_A2; \
 } while (0)
 
-        MOVE_TO_NEXT_CACHED_ENTRY(400);
-        MOVE_TO_NEXT_CACHED_ENTRY(3000);
-
-        for (ch = 0; ch < nb_channels; ch++) {
-            double bin;
+static int filter_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    EBUR128Context *ebur128 = ctx->priv;
+    ThreadData *td = arg;
+    const int nb_channels = ebur128->nb_channels;
+    const int nb_samples  = td->nb_samples;
+    const int start = (nb_channels *  jobnr   ) / nb_jobs;
+    const int end   = (nb_channels * (jobnr+1)) / nb_jobs;
+    int i, ch;
+
+    for (ch = start; ch < end; ch++) {
+        const double *samples = td->samples + ch;
+        double *x = ebur128->x + ch * 3;
+        double *y = ebur128->y + ch * 3;
+        double *z = ebur128->z + ch * 3;
+        double x0 = x[0], x1 = x[1], x2 = x[2];
+        double y0 = y[0], y1 = y[1], y2 = y[2];
+        double z0 = z[0], z1 = z[1], z2 = z[2];
+        double *cache_400, *cache_3000, sum_400, sum_3000;
+        int pos_400, pos_3000;
+
+        if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
+            double peak = ebur128->sample_peaks[ch];
+            for (i = 0; i < nb_samples; i++)
+                peak = FFMAX(peak, fabs(samples[i * nb_channels]));
+            ebur128->sample_peaks[ch] = peak;
+        }
 
-            if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS)
-                ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch], fabs(*samples));
+        if (!ebur128->ch_weighting[ch]) {
+            x[0] = samples[(nb_samples - 1) * nb_channels];
+            continue;
+        }
 
-            ebur128->x[ch * 3] = *samples++; // set X[i]
+        cache_400  = ebur128->i400.cache[ch];
+        cache_3000 = ebur128->i3000.cache[ch];
+        sum_400    = ebur128->i400.sum[ch];
+        sum_3000   = ebur128->i3000.sum[ch];
+        pos_400    = ebur128->i400.cache_pos;
+        pos_3000   = ebur128->i3000.cache_pos;
 
-            if (!ebur128->ch_weighting[ch])
-                continue;
+        for (i = 0; i < nb_samples; i++) {
+            double bin;
 
-            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
-#define FILTER(Y, X, name) do {                                                 \
-            double *dst = ebur128->Y + ch*3;                                    \
-            double *src = ebur128->X + ch*3;                                    \
-            dst[2] = dst[1];                                                    \
-            dst[1] = dst[0];                                                    \
-            dst[0] = src[0]*name##_B0 + src[1]*name##_B1 + src[2]*name##_B2     \
-                                      - dst[1]*name##_A1 - dst[2]*name##_A2;    \
-} while (0)
+            x0 = samples[i * nb_channels];
 
             // TODO: merge both filters in one?
-            FILTER(y, x, PRE);  // apply pre-filter
-            ebur128->x[ch * 3 + 2] = ebur128->x[ch * 3 + 1];
-            ebur128->x[ch * 3 + 1] = ebur128->x[ch * 3    ];
-            FILTER(z, y, RLB);  // apply RLB-filter
+            FILTER(PRE, y0, y1, y2, x0, x1, x2);  // apply pre-filter
+            x2 = x1;
+            x1 = x0;
+            FILTER(RLB, z0, z1, z2, y0, y1, y2);  // apply RLB-filter
 
-            bin = ebur128->z[ch * 3] * ebur128->z[ch * 3];
+            bin = z0 * z0;
 
             /* add the new value, and limit the sum to the cache size (400ms or 3s)
              * by removing the oldest one */
-            ebur128->i400.sum [ch] = ebur128->i400.sum [ch] + bin - ebur128->i400.cache [ch][bin_id_400];
-            ebur128->i3000.sum[ch] = ebur128->i3000.sum[ch] + bin - ebur128->i3000.cache[ch][bin_id_3000];
+            sum_400  = sum_400  + bin - cache_400 [pos_400 ];
+            sum_3000 = sum_3000 + bin - cache_3000[pos_3000];
 
             /* override old cache entry with the new value */
-            ebur128->i400.cache [ch][bin_id_400 ] = bin;
-            ebur128->i3000.cache[ch][bin_id_3000] = bin;
+            cache_400 [pos_400 ] = bin;
+            cache_3000[pos_3000] = bin;
+
+            if (++pos_400  == I400_BINS)  pos_400  = 0;
+            if (++pos_3000 == I3000_BINS) pos_3000 = 0;
         }
 
+        x[0] = x0; x[1] = x1; x[2] = x2;
+        y[0] = y0; y[1] = y1; y[2] = y2;
+        z[0] = z0; z[1] = z1; z[2] = z2;
+        ebur128->i400.sum[ch]  = sum_400;
+        ebur128->i3000.sum[ch] = sum_3000;
+    }
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
+{
+    int i, ch, idx_insample, seg_start, seg_len;
+    AVFilterContext *ctx = inlink->dst;
+    EBUR128Context *ebur128 = ctx->priv;
+    const int nb_channels = ebur128->nb_channels;
+    const int nb_samples  = insamples->nb_samples;
+    const int nb_jobs = FFMIN(nb_channels, ff_filter_get_nb_threads(ctx));
+    const double *samples = (double *)insamples->data[0];
+    AVFrame *pic = ebur128->outpicref;
+    ThreadData td;
+
+#if CONFIG_SWRESAMPLE
+    if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
+        int ret[MAX_CHANNELS];
+
+        td.in = insamples;
+        ctx->internal->execute(ctx, true_peaks_channels, &td, ret, nb_jobs);
+        for (i = 0; i < nb_jobs; i++)
+            if (ret[i] < 0)
+                return ret[i];
+    }
+#endif
+
+    /* Filter the frame in segments ending on the 100ms boundaries, where
+     * the loudness is computed; within a segment channels are independent. */
+    for (seg_start = 0; seg_start < nb_samples; seg_start += seg_len) {
+        seg_len = FFMIN(nb_samples - seg_start, 4800 - ebur128->sample_count);
+        idx_insample = seg_start + seg_len - 1;
+
+        td.samples    = samples + seg_start * nb_channels;
+        td.nb_samples = seg_len;
+        ctx->internal->execute(ctx, filter_channels, &td, NULL, nb_jobs);
+
+#define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
+    ebur128->i##time.cache_pos += seg_len;                  \
+    if (ebur128->i##time.cache_pos >= I##time##_BINS) {     \
+        ebur128->i##time.filled     = 1;                    \
+        ebur128->i##time.cache_pos -= I##time##_BINS;       \
+    }                                                       \
+} while (0)
+
+        MOVE_TO_NEXT_CACHED_ENTRY(400);
+        MOVE_TO_NEXT_CACHED_ENTRY(3000);
+
         /* For integrated loudness, gating blocks are 400ms long with 75%
          * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
          * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == 4800) {
+        ebur128->sample_count += seg_len;
+        if (ebur128->sample_count == 4800) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
@@ -995,7 +1090,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&ebur128->outpicref);
 #if CONFIG_SWRESAMPLE
     av_freep(&ebur128->swr_buf);
-    swr_free(&ebur128->swr_ctx);
+    if (ebur128->swr_ctx)
+        for (i = 0; i < ebur128->nb_channels; i++)
+            swr_free(&ebur128->swr_ctx[i]);
+    av_freep(&ebur128->swr_ctx);
+    av_freep(&ebur128->swr_ch_map);
 #endif
 }
 
@@ -1019,5 +1118,5 @@ AVFilter ff_af_ebur128 = {
     .inputs        = ebur128_inputs,
     .outputs       = NULL,
     .priv_class    = &ebur128_class,
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -146,14 +146,8 @@ typedef struct SelectContext {
     char *expr_str;
     AVExpr *expr;
     double var_values[VAR_VARS_NB];
-    int bitdepth;
-    int nb_planes;
-    ptrdiff_t width[4];
-    ptrdiff_t height[4];
     int do_scene_detect;            ///< 1 if the expression requires scene detection variables, 0 otherwise
-    ff_scene_sad_fn sad;            ///< Sum of the absolute difference function (scene detect only)
-    double prev_mafd;               ///< previous MAFD                           (scene detect only)
-    AVFrame *prev_picref;           ///< previous frame                          (scene detect only)
+    SceneScoreContext scene;        ///< scene change scoring (scene detect only)
     double select;
     int select_out;                 ///< mark the selected output pad index
     int nb_outputs;
@@ -208,21 +202,6 @@ static av_cold int init(AVFilterContext *ctx)
 static int config_input(AVFilterLink *inlink)
 {
     SelectContext *select = inlink->dst->priv;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
-    int is_yuv = !(desc->flags & AV_PIX_FMT_FLAG_RGB) &&
-                 (desc->flags & AV_PIX_FMT_FLAG_PLANAR) &&
-                 desc->nb_components >= 3;
-
-    select->bitdepth = desc->comp[0].depth;
-    select->nb_planes = is_yuv ? 1 : av_pix_fmt_count_planes(inlink->format);
-
-    for (int plane = 0; plane < select->nb_planes; plane++) {
-        ptrdiff_t line_size = av_image_get_linesize(inlink->format, inlink->w, plane);
-        int vsub = desc->log2_chroma_h;
-
-        select->width[plane] = line_size >> (select->bitdepth > 8);
-        select->height[plane] = plane == 1 || plane == 2 ?  AV_CEIL_RSHIFT(inlink->h, vsub) : inlink->h;
-    }
 
     select->var_values[VAR_N]          = 0.0;
     select->var_values[VAR_SELECTED_N] = 0.0;
@@ -262,45 +241,23 @@ static int config_input(AVFilterLink *inlink)
     select->var_values[VAR_SAMPLE_RATE] =
         inlink->type == AVMEDIA_TYPE_AUDIO ? inlink->sample_rate : NAN;
 
-    if (CONFIG_SELECT_FILTER && select->do_scene_detect) {
-        select->sad = ff_scene_sad_get_fn(select->bitdepth == 8 ? 8 : 16);
-        if (!select->sad)
-            return AVERROR(EINVAL);
-    }
+    if (CONFIG_SELECT_FILTER && select->do_scene_detect)
+        return ff_scene_score_init(&select->scene, inlink);
     return 0;
 }
 
 static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
 {
-    double ret = 0;
     SelectContext *select = ctx->priv;
-    AVFrame *prev_picref = select->prev_picref;
-
-    if (prev_picref &&
-        frame->height == prev_picref->height &&
-        frame->width  == prev_picref->width) {
-        uint64_t sad = 0;
-        double mafd, diff;
-        uint64_t count = 0;
-
-        for (int plane = 0; plane < select->nb_planes; plane++) {
-            uint64_t plane_sad;
-            select->sad(prev_picref->data[plane], prev_picref->linesize[plane],
-                    frame->data[plane], frame->linesize[plane],
-                    select->width[plane], select->height[plane], &plane_sad);
-            sad += plane_sad;
-            count += select->width[plane] * select->height[plane];
-        }
+    double score;
 
-        emms_c();
-        mafd = (double)sad / count / (1ULL << (select->bitdepth - 8));
-        diff = fabs(mafd - select->prev_mafd);
-        ret  = av_clipf(FFMIN(mafd, diff) / 100., 0, 1);
-        select->prev_mafd = mafd;
-        av_frame_free(&prev_picref);
-    }
-    select->prev_picref = av_frame_clone(frame);
-    return ret;
+    // reuse the score of an upstream select or scdet instead of recomputing it
+    if (ff_scene_score_from_metadata(frame, &score))
+        return score;
+
+    score = av_clipf(ff_scene_score(ctx, &select->scene, frame) / 100., 0, 1);
+    ff_scene_score_set_metadata(frame, score);
+    return score;
 }
 
 static double get_concatdec_select(AVFrame *frame, int64_t pts)
@@ -353,13 +310,8 @@ static void select_frame(AVFilterContext *ctx, AVFrame *frame)
             !frame->interlaced_frame ? INTERLACE_TYPE_P :
         frame->top_field_first ? INTERLACE_TYPE_T : INTERLACE_TYPE_B;
         select->var_values[VAR_PICT_TYPE] = frame->pict_type;
-        if (select->do_scene_detect) {
-            char buf[32];
+        if (CONFIG_SELECT_FILTER && select->do_scene_detect)
             select->var_values[VAR_SCENE] = get_scene_score(ctx, frame);
-            // TODO: document metadata
-            snprintf(buf, sizeof(buf), "%f", select->var_values[VAR_SCENE]);
-            av_dict_set(&frame->metadata, "lavfi.scene_score", buf, 0);
-        }
         break;
     }
 
@@ -440,9 +392,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
 
-    if (select->do_scene_detect) {
-        av_frame_free(&select->prev_picref);
-    }
+    if (CONFIG_SELECT_FILTER && select->do_scene_detect)
+        ff_scene_score_uninit(&select->scene);
 }
 
 #if CONFIG_ASELECT_FILTER
@@ -549,6 +500,6 @@ AVFilter ff_vf_select = {
     .priv_size     = sizeof(SelectContext),
     .priv_class    = &select_class,
     .inputs        = avfilter_vf_select_inputs,
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif /* CONFIG_SELECT_FILTER */
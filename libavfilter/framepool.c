@@ -26,6 +26,8 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 struct FFFramePool {
 
@@ -48,6 +50,25 @@ struct FFFramePool {
 
 };
 
+static int fill_video_linesizes(int linesize[4], int width,
+                                enum AVPixelFormat format, int align)
+{
+    int i, ret;
+
+    for (i = 1; i <= align; i += i) {
+        ret = av_image_fill_linesizes(linesize, format, FFALIGN(width, i));
+        if (ret < 0)
+            return ret;
+        if (!(linesize[0] & (align - 1)))
+            break;
+    }
+
+    for (i = 0; i < 4 && linesize[i]; i++)
+        linesize[i] = FFALIGN(linesize[i], align);
+
+    return 0;
+}
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
                                       int width,
                                       int height,
@@ -75,21 +96,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
         goto fail;
     }
 
-    if (!pool->linesize[0]) {
-        for(i = 1; i <= align; i += i) {
-            ret = av_image_fill_linesizes(pool->linesize, pool->format,
-                                          FFALIGN(pool->width, i));
-            if (ret < 0) {
-                goto fail;
-            }
-            if (!(pool->linesize[0] & (pool->align - 1)))
-                break;
-        }
-
-        for (i = 0; i < 4 && pool->linesize[i]; i++) {
-            pool->linesize[i] = FFALIGN(pool->linesize[i], pool->align);
-        }
-    }
+    if ((ret = fill_video_linesizes(pool->linesize, width, format, align)) < 0)
+        goto fail;
 
     for (i = 0; i < 4 && pool->linesize[i]; i++) {
         int h = FFALIGN(pool->height, 32);
@@ -294,3 +302,229 @@ void ff_frame_pool_uninit(FFFramePool **pool)
 
     av_freep(pool);
 }
+
+typedef struct GraphPoolBuffer {
+    FFGraphFramePool *pool;
+    uint8_t *data;
+    size_t size;
+
+    int width;
+    int height;
+    int format;
+    int align;
+
+    int64_t released;
+    struct GraphPoolBuffer *prev, *next;
+} GraphPoolBuffer;
+
+struct FFGraphFramePool {
+    AVMutex mutex;
+    int64_t max_size;
+    int64_t idle_time;
+
+    /* released buffers, from the least to the most recently released */
+    GraphPoolBuffer *first, *last;
+    int64_t retained;
+
+    /* buffers in use, and the reference held by the graph */
+    unsigned refcount;
+};
+
+static void graph_pool_unlink(FFGraphFramePool *pool, GraphPoolBuffer *buf)
+{
+    if (buf->prev)
+        buf->prev->next = buf->next;
+    else
+        pool->first = buf->next;
+    if (buf->next)
+        buf->next->prev = buf->prev;
+    else
+        pool->last = buf->prev;
+    buf->prev = buf->next = NULL;
+    pool->retained -= buf->size;
+}
+
+static void graph_pool_buffer_free(GraphPoolBuffer *buf)
+{
+    av_free(buf->data);
+    av_free(buf);
+}
+
+/* frees the released buffers while more than max_size bytes are retained
+ * or the oldest one was released before the given time */
+static void graph_pool_trim(FFGraphFramePool *pool, int64_t max_size, int64_t before)
+{
+    while (pool->first &&
+           (pool->retained > max_size || pool->first->released < before)) {
+        GraphPoolBuffer *buf = pool->first;
+        graph_pool_unlink(pool, buf);
+        graph_pool_buffer_free(buf);
+    }
+}
+
+static void graph_pool_unref(FFGraphFramePool *pool)
+{
+    unsigned refcount;
+
+    ff_mutex_lock(&pool->mutex);
+    refcount = --pool->refcount;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (!refcount) {
+        ff_mutex_destroy(&pool->mutex);
+        av_free(pool);
+    }
+}
+
+static void graph_pool_release(void *opaque, uint8_t *data)
+{
+    GraphPoolBuffer *buf = opaque;
+    FFGraphFramePool *pool = buf->pool;
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->max_size > 0 && buf->size <= pool->max_size) {
+        buf->released = av_gettime_relative();
+        buf->prev = pool->last;
+        if (pool->last)
+            pool->last->next = buf;
+        else
+            pool->first = buf;
+        pool->last = buf;
+        pool->retained += buf->size;
+        graph_pool_trim(pool, pool->max_size, INT64_MIN);
+    } else {
+        graph_pool_buffer_free(buf);
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    graph_pool_unref(pool);
+}
+
+FFGraphFramePool *ff_graph_frame_pool_init(int64_t max_size, int64_t idle_time)
+{
+    FFGraphFramePool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+    if (ff_mutex_init(&pool->mutex, NULL)) {
+        av_free(pool);
+        return NULL;
+    }
+    pool->max_size  = max_size;
+    pool->idle_time = idle_time;
+    pool->refcount  = 1;
+
+    return pool;
+}
+
+void ff_graph_frame_pool_uninit(FFGraphFramePool **ppool)
+{
+    FFGraphFramePool *pool = *ppool;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    // the buffers still in use are freed when released
+    ff_mutex_lock(&pool->mutex);
+    pool->max_size = 0;
+    graph_pool_trim(pool, 0, INT64_MIN);
+    ff_mutex_unlock(&pool->mutex);
+
+    graph_pool_unref(pool);
+}
+
+AVFrame *ff_graph_frame_pool_get_video(FFGraphFramePool *pool,
+                                       int width,
+                                       int height,
+                                       enum AVPixelFormat format,
+                                       int align)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    GraphPoolBuffer *buf;
+    AVFrame *frame;
+    size_t offset[4] = { 0 }, size = 0;
+    int linesize[4] = { 0 };
+    int i, pal;
+
+    if (!desc || av_image_check_size2(width, height, INT64_MAX, format, 0, NULL) < 0 ||
+        fill_video_linesizes(linesize, width, format, align) < 0)
+        return NULL;
+
+    // the planes are laid out as in the pools of ff_frame_pool_video_init()
+    pal = desc->flags & AV_PIX_FMT_FLAG_PAL || desc->flags & FF_PSEUDOPAL;
+    for (i = 0; i < 4 && linesize[i]; i++) {
+        int h = FFALIGN(height, 32);
+        if (i == 1 || i == 2)
+            h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
+
+        offset[i] = size;
+        size     += FFALIGN((size_t)linesize[i] * h + 16 + 16 - 1, 64);
+    }
+    if (pal) {
+        offset[1] = size;
+        size     += AVPALETTE_SIZE;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->idle_time > 0)
+        graph_pool_trim(pool, pool->max_size, av_gettime_relative() - pool->idle_time);
+    for (buf = pool->last; buf; buf = buf->prev)
+        if (buf->width == width && buf->height == height &&
+            buf->format == format && buf->align == align)
+            break;
+    if (buf)
+        graph_pool_unlink(pool, buf);
+    pool->refcount++;
+    ff_mutex_unlock(&pool->mutex);
+
+    if (!buf) {
+        buf = av_mallocz(sizeof(*buf));
+        if (!buf)
+            goto fail;
+        buf->data = av_mallocz(size);
+        if (!buf->data) {
+            av_freep(&buf);
+            goto fail;
+        }
+        buf->pool   = pool;
+        buf->size   = size;
+        buf->width  = width;
+        buf->height = height;
+        buf->format = format;
+        buf->align  = align;
+    }
+
+    frame->buf[0] = av_buffer_create(buf->data, buf->size, graph_pool_release, buf, 0);
+    if (!frame->buf[0]) {
+        graph_pool_buffer_free(buf);
+        goto fail;
+    }
+
+    frame->width  = width;
+    frame->height = height;
+    frame->format = format;
+    for (i = 0; i < 4; i++) {
+        frame->linesize[i] = linesize[i];
+        if (linesize[i] || (pal && i == 1))
+            frame->data[i] = buf->data + offset[i];
+    }
+    if (pal) {
+        enum AVPixelFormat pal_format = format == AV_PIX_FMT_PAL8 ? AV_PIX_FMT_BGR8 : format;
+        if (avpriv_set_systematic_pal2((uint32_t *)frame->data[1], pal_format) < 0) {
+            av_frame_free(&frame);
+            return NULL;
+        }
+    }
+    frame->extended_data = frame->data;
+
+    return frame;
+fail:
+    av_frame_free(&frame);
+    graph_pool_unref(pool);
+    return NULL;
+}
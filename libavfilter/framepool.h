@@ -114,5 +114,29 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Pool of video buffers shared by all the links of a graph.
+ *
+ * The buffers of any format, size and alignment are kept in a single list
+ * after they are released, so that links of the same configuration reuse
+ * each others buffers. At most max_size bytes are retained, the least
+ * recently released buffers being freed first, and the buffers which were
+ * not reused for idle_time microseconds are freed when a frame is taken.
+ *
+ * The buffers can be released from any thread, and after the pool is
+ * uninitialized.
+ */
+typedef struct FFGraphFramePool FFGraphFramePool;
+
+FFGraphFramePool *ff_graph_frame_pool_init(int64_t max_size, int64_t idle_time);
+
+void ff_graph_frame_pool_uninit(FFGraphFramePool **pool);
+
+AVFrame *ff_graph_frame_pool_get_video(FFGraphFramePool *pool,
+                                       int width,
+                                       int height,
+                                       enum AVPixelFormat format,
+                                       int align);
+
 
 #endif /* AVFILTER_FRAMEPOOL_H */
@@ -50,6 +50,8 @@ typedef struct FrameRateContext {
 
     ff_scene_sad_fn sad;                ///< Sum of the absolute difference function (scene detect only)
     double prev_mafd;                   ///< previous MAFD                           (scene detect only)
+    uint64_t *job_sad;                  ///< partial SAD of each slice job           (scene detect only)
+    int nb_sad_jobs;
 
     int blend_factor_max;
     int bitdepth;
@@ -42,6 +42,7 @@ static const AVOption framesync_options[] = {
         { "pass",   "Pass through the main input.", 0, AV_OPT_TYPE_CONST, { .i64 = EOF_ACTION_PASS },   .flags = FLAGS, "eof_action" },
     { "shortest", "force termination when the shortest input terminates", OFFSET(opt_shortest), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
     { "repeatlast", "extend last frame of secondary streams beyond EOF", OFFSET(opt_repeatlast), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { "latency", "proceed without the inputs lagging by more than this", OFFSET(opt_latency), AV_OPT_TYPE_DURATION, { .i64 = 0 }, 0, INT64_MAX, FLAGS },
     { NULL }
 };
 static const AVClass framesync_class = {
@@ -163,6 +164,9 @@ int ff_framesync_configure(FFFrameSync *fs)
                fs->time_base.num, fs->time_base.den);
     }
 
+    if (fs->opt_latency)
+        fs->latency = FFMAX(av_rescale_q(fs->opt_latency, AV_TIME_BASE_Q, fs->time_base), 1);
+
     for (i = 0; i < fs->nb_in; i++)
         fs->in[i].pts = fs->in[i].pts_next = AV_NOPTS_VALUE;
     fs->sync_level = UINT_MAX;
@@ -193,7 +197,7 @@ static int framesync_advance(FFFrameSync *fs)
         for (i = 0; i < fs->nb_in; i++) {
             if (fs->in[i].pts_next == pts ||
                 (fs->in[i].before == EXT_INFINITY &&
-                 fs->in[i].state == STATE_BOF)) {
+                 fs->in[i].state == STATE_BOF && fs->in[i].have_next)) {
                 av_frame_free(&fs->in[i].frame);
                 fs->in[i].frame      = fs->in[i].frame_next;
                 fs->in[i].pts        = fs->in[i].pts_next;
@@ -292,6 +296,10 @@ void ff_framesync_uninit(FFFrameSync *fs)
     unsigned i;
 
     for (i = 0; i < fs->nb_in; i++) {
+        if (fs->in[i].nb_stalls)
+            av_log(fs, AV_LOG_INFO, "Input %u stalled %u times, "
+                   "%"PRIu64" frame events without it\n", i,
+                   fs->in[i].nb_stalls, fs->in[i].nb_late_events);
         av_frame_free(&fs->in[i].frame);
         av_frame_free(&fs->in[i].frame_next);
     }
@@ -299,6 +307,81 @@ void ff_framesync_uninit(FFFrameSync *fs)
     av_freep(&fs->in);
 }
 
+/**
+ * Leave the inputs without a next frame behind if the frames waiting on the
+ * other inputs span more than the latency bound.
+ *
+ * The span goes from the oldest next frame to the newest frame queued on
+ * the links, so that no wall clock is involved. An input is only left
+ * behind if another input can generate the frame events meanwhile.
+ *
+ * @return  the number of inputs left behind
+ */
+static unsigned framesync_skip_late(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    unsigned i, nb_late = 0, have_sync = 0;
+
+    for (i = 0; i < fs->nb_in; i++) {
+        size_t nb_queued = ff_inlink_queued_frames(ctx->inputs[i]);
+
+        if (!fs->in[i].have_next || !fs->in[i].frame_next)
+            continue;
+        first = FFMIN(first, fs->in[i].pts_next);
+        last  = FFMAX(last,  fs->in[i].pts_next);
+        if (nb_queued) {
+            AVFrame *frame = ff_inlink_peek_frame(ctx->inputs[i], nb_queued - 1);
+            last = FFMAX(last, av_rescale_q(frame->pts, fs->in[i].time_base,
+                                            fs->time_base));
+        }
+        have_sync |= fs->in[i].sync == fs->sync_level;
+    }
+    if (!have_sync || last - first <= fs->latency)
+        return 0;
+
+    for (i = 0; i < fs->nb_in; i++) {
+        if (fs->in[i].have_next || fs->in[i].state == STATE_EOF)
+            continue;
+        if (!fs->in[i].late) {
+            av_log(fs, AV_LOG_VERBOSE, "Input %u is late, proceeding without it\n", i);
+            fs->in[i].late = 1;
+            fs->in[i].nb_stalls++;
+        }
+        nb_late++;
+    }
+    return nb_late;
+}
+
+/**
+ * Bring a late input up to date with a frame it delivered.
+ *
+ * The frames older than the current event are made the current frame
+ * without generating an event, as their time has already been output.
+ *
+ * @return  1 if the next frame was consumed that way, 0 otherwise
+ */
+static int framesync_catch_up(FFFrameSync *fs, unsigned in)
+{
+    FFFrameSyncIn *fsi = &fs->in[in];
+
+    if (!fsi->late)
+        return 0;
+    if (fsi->pts_next > fs->pts) {
+        av_log(fs, AV_LOG_VERBOSE, "Input %u caught up\n", in);
+        fsi->late = 0;
+        return 0;
+    }
+    av_frame_free(&fsi->frame);
+    fsi->frame      = fsi->frame_next;
+    fsi->pts        = fsi->pts_next;
+    fsi->frame_next = NULL;
+    fsi->pts_next   = AV_NOPTS_VALUE;
+    fsi->have_next  = 0;
+    fsi->state      = STATE_RUN;
+    return 1;
+}
+
 static int consume_from_fifos(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -312,21 +395,27 @@ static int consume_from_fifos(FFFrameSync *fs)
         if (fs->in[i].have_next || fs->in[i].state == STATE_EOF)
             continue;
         nb_active++;
-        ret = ff_inlink_consume_frame(ctx->inputs[i], &frame);
-        if (ret < 0)
-            return ret;
-        if (ret) {
-            av_assert0(frame);
-            framesync_inject_frame(fs, i, frame);
-        } else {
+        do {
+            ret = ff_inlink_consume_frame(ctx->inputs[i], &frame);
+            if (ret < 0)
+                return ret;
+            if (ret) {
+                av_assert0(frame);
+                framesync_inject_frame(fs, i, frame);
+            }
+        } while (ret && framesync_catch_up(fs, i));
+        if (!ret) {
             ret = ff_inlink_acknowledge_status(ctx->inputs[i], &status, &pts);
             if (ret > 0) {
+                fs->in[i].late = 0;
                 framesync_inject_status(fs, i, status, pts);
             } else if (!ret) {
                 nb_miss++;
             }
         }
     }
+    if (nb_miss && fs->latency)
+        nb_miss -= framesync_skip_late(fs);
     if (nb_miss) {
         if (nb_miss == nb_active && !ff_outlink_frame_wanted(ctx->outputs[0]))
             return FFERROR_NOT_READY;
@@ -335,11 +424,15 @@ static int consume_from_fifos(FFFrameSync *fs)
                 ff_inlink_request_frame(ctx->inputs[i]);
         return 0;
     }
+    for (i = 0; i < fs->nb_in; i++)
+        if (!fs->in[i].have_next && fs->in[i].state != STATE_EOF)
+            ff_inlink_request_frame(ctx->inputs[i]);
     return 1;
 }
 
 int ff_framesync_activate(FFFrameSync *fs)
 {
+    unsigned i;
     int ret;
 
     ret = framesync_advance(fs);
@@ -347,6 +440,8 @@ int ff_framesync_activate(FFFrameSync *fs)
         return ret;
     if (fs->eof || !fs->frame_ready)
         return 0;
+    for (i = 0; i < fs->nb_in; i++)
+        fs->in[i].nb_late_events += fs->in[i].late;
     ret = fs->on_event(fs);
     if (ret < 0)
         return ret;
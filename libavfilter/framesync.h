@@ -138,6 +138,22 @@ typedef struct FFFrameSyncIn {
      */
     unsigned sync;
 
+    /**
+     * Flag indicating that the input missed the latency deadline and that
+     * frame events are generated without it, for internal use
+     */
+    uint8_t late;
+
+    /**
+     * Number of times the input missed the latency deadline
+     */
+    unsigned nb_stalls;
+
+    /**
+     * Number of frame events generated while the input was late
+     */
+    uint64_t nb_late_events;
+
 } FFFrameSyncIn;
 
 /**
@@ -205,6 +221,12 @@ typedef struct FFFrameSync {
     int opt_repeatlast;
     int opt_shortest;
     int opt_eof_action;
+    int64_t opt_latency;
+
+    /**
+     * Latency bound in the output time base, 0 if unbounded
+     */
+    int64_t latency;
 
 } FFFrameSync;
 
@@ -138,10 +138,17 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+    void *pipeline;
+    FFGraphFramePool *frame_pool;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    /* the filter is being activated by a pipeline worker */
+    int busy;
+
+    int64_t nb_activations;
+    int64_t activate_time;
 };
 
 /**
@@ -368,6 +375,25 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The config_props() callbacks of the filter can be called again while the
+ * graph is running, to change the video dimensions of its inputs, and have
+ * no other side effect than reconfiguring the filter for them. The frames
+ * already queued with the previous dimensions must still be handled.
+ */
+#define FF_FILTER_FLAG_RECONFIGURABLE (1 << 1)
+
+/**
+ * Propagate a change of the dimensions or the sample aspect ratio of a video
+ * link already configured: reconfigure its destination filter and, for each
+ * of its outputs whose parameters change in turn, the filters downstream.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if a filter reached by the change
+ *         is not FF_FILTER_FLAG_RECONFIGURABLE, another negative AVERROR
+ *         code on error; on failure the graph must be configured again
+ */
+int ff_filter_link_reconfigure(AVFilterLink *link);
+
 /**
  * Run one round of processing on a filter graph.
  */
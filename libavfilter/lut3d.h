@@ -0,0 +1,53 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_LUT3D_H
+#define AVFILTER_LUT3D_H
+
+enum interp_mode {
+    INTERPOLATE_NEAREST,
+    INTERPOLATE_TRILINEAR,
+    INTERPOLATE_TETRAHEDRAL,
+    NB_INTERP_MODE
+};
+
+struct rgbvec {
+    float r, g, b;
+};
+
+/* the coordinate arrays given to LUT3DDSPContext.interp are padded to this size */
+#define LUT3D_PADDING 16
+
+typedef struct LUT3DDSPContext {
+    /**
+     * Interpolate the lut at w points.
+     *
+     * @param r, g, b  on input, the coordinates of the points in the lut,
+     *                 in the range [0, lutsize - 1], on output the
+     *                 interpolated values; the arrays are 32-byte aligned,
+     *                 and padded to a multiple of LUT3D_PADDING entries
+     *                 with valid coordinates, which may be overwritten
+     * @param lut      lutsize^3 entries, indexed by r * lutsize^2 + g * lutsize + b
+     */
+    void (*interp)(float *r, float *g, float *b,
+                   const struct rgbvec *lut, int lutsize, int w);
+} LUT3DDSPContext;
+
+void ff_lut3d_init(LUT3DDSPContext *dsp, int interpolation);
+
+#endif /* AVFILTER_LUT3D_H */
@@ -17,10 +17,14 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "libavutil/avstring.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/sha.h"
 
 #include "formats.h"
 #include "opencl.h"
@@ -168,18 +172,219 @@ void ff_opencl_filter_uninit(AVFilterContext *avctx)
     av_buffer_unref(&ctx->device_ref);
 }
 
+/**
+ * Program binary cache.
+ *
+ * If FFMPEG_OPENCL_CACHE_DIR names an existing directory, built programs
+ * are stored there and reused on later runs instead of compiling the
+ * source again. Entries are keyed by a SHA-1 over the device name, vendor
+ * and version, the driver version and the program source (programs are
+ * always built without options), so a driver update or a source change
+ * simply misses the cache.
+ */
+
+#define OPENCL_CACHE_VERSION "1"
+
+static int opencl_cache_update_info(AVFilterContext *avctx, struct AVSHA *sha,
+                                    cl_device_id device, cl_device_info param)
+{
+    uint8_t *str;
+    size_t size;
+    cl_int cle;
+
+    cle = clGetDeviceInfo(device, param, 0, NULL, &size);
+    if (cle != CL_SUCCESS)
+        return AVERROR(EIO);
+
+    str = av_malloc(size);
+    if (!str)
+        return AVERROR(ENOMEM);
+
+    cle = clGetDeviceInfo(device, param, size, str, NULL);
+    if (cle == CL_SUCCESS)
+        av_sha_update(sha, str, size);
+
+    av_free(str);
+    return cle == CL_SUCCESS ? 0 : AVERROR(EIO);
+}
+
+static char *opencl_cache_path(AVFilterContext *avctx,
+                               const char **program_source_array,
+                               int nb_strings)
+{
+    OpenCLFilterContext *ctx = avctx->priv;
+    cl_device_id device = ctx->hwctx->device_id;
+    const char *dir = getenv("FFMPEG_OPENCL_CACHE_DIR");
+    uint8_t digest[20];
+    char hex[2 * sizeof(digest) + 1];
+    struct AVSHA *sha;
+    int err = 0;
+
+    if (!dir || !*dir)
+        return NULL;
+
+    sha = av_sha_alloc();
+    if (!sha)
+        return NULL;
+    av_sha_init(sha, 160);
+
+    av_sha_update(sha, (const uint8_t *)OPENCL_CACHE_VERSION,
+                  sizeof(OPENCL_CACHE_VERSION));
+    if (!err)
+        err = opencl_cache_update_info(avctx, sha, device, CL_DEVICE_NAME);
+    if (!err)
+        err = opencl_cache_update_info(avctx, sha, device, CL_DEVICE_VERSION);
+    if (!err)
+        err = opencl_cache_update_info(avctx, sha, device, CL_DRIVER_VERSION);
+    if (!err)
+        err = opencl_cache_update_info(avctx, sha, device, CL_DEVICE_VENDOR);
+
+    for (int i = 0; i < nb_strings; i++)
+        av_sha_update(sha, (const uint8_t *)program_source_array[i],
+                      strlen(program_source_array[i]));
+
+    av_sha_final(sha, digest);
+    av_free(sha);
+
+    if (err < 0)
+        return NULL;
+
+    for (int i = 0; i < sizeof(digest); i++)
+        snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+
+    return av_asprintf("%s/%s.clbin", dir, hex);
+}
+
+static cl_program opencl_cache_load(AVFilterContext *avctx, const char *path)
+{
+    OpenCLFilterContext *ctx = avctx->priv;
+    cl_program program = NULL;
+    unsigned char *bin = NULL;
+    const unsigned char *bin_const;
+    cl_int cle, status;
+    FILE *file;
+    size_t size;
+    long len;
+
+    file = av_fopen_utf8(path, "rb");
+    if (!file)
+        return NULL;
+
+    if (fseek(file, 0, SEEK_END) || (len = ftell(file)) <= 0 ||
+        fseek(file, 0, SEEK_SET))
+        goto end;
+    size = len;
+
+    bin = av_malloc(size);
+    if (!bin || fread(bin, 1, size, file) != size)
+        goto end;
+
+    bin_const = bin;
+    program = clCreateProgramWithBinary(ctx->hwctx->context, 1,
+                                        &ctx->hwctx->device_id, &size,
+                                        &bin_const, &status, &cle);
+    if (!program || status != CL_SUCCESS) {
+        av_log(avctx, AV_LOG_VERBOSE, "Ignoring unusable cached program "
+               "binary \"%s\": %d.\n", path, program ? status : cle);
+        goto fail;
+    }
+
+    cle = clBuildProgram(program, 1, &ctx->hwctx->device_id, NULL, NULL, NULL);
+    if (cle != CL_SUCCESS) {
+        av_log(avctx, AV_LOG_VERBOSE, "Failed to build cached program "
+               "binary \"%s\": %d.\n", path, cle);
+        goto fail;
+    }
+
+    av_log(avctx, AV_LOG_DEBUG, "Loaded program from cache \"%s\".\n", path);
+    goto end;
+
+fail:
+    if (program)
+        clReleaseProgram(program);
+    program = NULL;
+end:
+    av_free(bin);
+    fclose(file);
+    return program;
+}
+
+static void opencl_cache_store(AVFilterContext *avctx, cl_program program,
+                               const char *path)
+{
+    unsigned char *bin = NULL;
+    char *tmp_path = NULL;
+    FILE *file = NULL;
+    size_t size;
+    cl_int cle;
+
+    cle = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+                           sizeof(size), &size, NULL);
+    if (cle != CL_SUCCESS || !size)
+        return;
+
+    bin = av_malloc(size);
+    if (!bin)
+        return;
+
+    cle = clGetProgramInfo(program, CL_PROGRAM_BINARIES,
+                           sizeof(bin), &bin, NULL);
+    if (cle != CL_SUCCESS)
+        goto end;
+
+    /* Write to a unique temporary file first, so that concurrent processes
+     * never observe a partially written entry. */
+    tmp_path = av_asprintf("%s.%08x.tmp", path, av_get_random_seed());
+    if (!tmp_path)
+        goto end;
+
+    file = av_fopen_utf8(tmp_path, "wb");
+    if (!file) {
+        av_log(avctx, AV_LOG_VERBOSE, "Unable to write program cache "
+               "\"%s\".\n", tmp_path);
+        goto end;
+    }
+
+    if (fwrite(bin, 1, size, file) != size) {
+        fclose(file);
+        remove(tmp_path);
+        goto end;
+    }
+    fclose(file);
+
+    if (rename(tmp_path, path))
+        remove(tmp_path);
+    else
+        av_log(avctx, AV_LOG_DEBUG, "Stored program in cache \"%s\".\n", path);
+
+end:
+    av_free(tmp_path);
+    av_free(bin);
+}
+
 int ff_opencl_filter_load_program(AVFilterContext *avctx,
                                   const char **program_source_array,
                                   int nb_strings)
 {
     OpenCLFilterContext *ctx = avctx->priv;
+    char *cache_path;
     cl_int cle;
 
+    cache_path = opencl_cache_path(avctx, program_source_array, nb_strings);
+    if (cache_path) {
+        ctx->program = opencl_cache_load(avctx, cache_path);
+        if (ctx->program) {
+            av_free(cache_path);
+            return 0;
+        }
+    }
+
     ctx->program = clCreateProgramWithSource(ctx->hwctx->context, nb_strings,
                                              program_source_array,
                                              NULL, &cle);
     if (!ctx->program) {
         av_log(avctx, AV_LOG_ERROR, "Failed to create program: %d.\n", cle);
+        av_free(cache_path);
         return AVERROR(EIO);
     }
 
@@ -210,9 +415,15 @@ int ff_opencl_filter_load_program(AVFilterContext *avctx,
 
         clReleaseProgram(ctx->program);
         ctx->program = NULL;
+        av_free(cache_path);
         return AVERROR(EIO);
     }
 
+    if (cache_path) {
+        opencl_cache_store(avctx, ctx->program, cache_path);
+        av_free(cache_path);
+    }
+
     return 0;
 }
 
@@ -0,0 +1,103 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// The host prepends the defines of the source layout:
+//   SEMI_PLANAR            the chroma is interleaved in one image (NV12, P010)
+//   CHROMA_W, CHROMA_H     log2 of the chroma subsampling
+// and of the model input layout:
+//   CHANNELS               1 for gray, 3 for rgb or bgr
+//   BGR                    the 3 channels are stored in bgr order
+//   OUT_FLOAT, OUT_HALF, OUT_UINT8   data type of the samples
+
+#if CHANNELS == 3 && defined(BGR)
+#define STORE_RGB(i, rgb) do { STORE(i, rgb.z); STORE(i + 1, rgb.y); STORE(i + 2, rgb.x); } while (0)
+#else
+#define STORE_RGB(i, rgb) do { STORE(i, rgb.x); STORE(i + 1, rgb.y); STORE(i + 2, rgb.z); } while (0)
+#endif
+
+#if defined(OUT_FLOAT)
+#define STORE(i, v) ((__global float *)dst)[i] = ((v) * 255.0f - norm.x) * norm.y
+#elif defined(OUT_HALF)
+#define STORE(i, v) vstore_half(((v) * 255.0f - norm.x) * norm.y, i, (__global half *)dst)
+#else
+#define STORE(i, v) dst[i] = convert_uchar_sat_rte((v) * 255.0f)
+#endif
+
+// Resizes the region of the source to the model input size with bilinear
+// filtering, converts it to rgb, bgr or gray and writes it as interleaved
+// samples to dst, normalized with (sample - norm.x) * norm.y for float models.
+//
+// region: x, y of the region in the source, horizontal and vertical step
+// range:  luma offset and scale, chroma offset and scale, in [0, 1] samples
+// mat:    the v to r, u to g, v to g and u to b factors of the yuv to rgb matrix
+__kernel void dnn_preproc(__read_only image2d_t src_y,
+                          __read_only image2d_t src_u,
+                          __read_only image2d_t src_v,
+                          __global uchar *dst,
+                          int dst_w,
+                          int dst_h,
+                          float4 region,
+                          float4 range,
+                          float4 mat,
+                          float2 norm)
+{
+    const sampler_t sampler = (CLK_NORMALIZED_COORDS_FALSE |
+                               CLK_ADDRESS_CLAMP_TO_EDGE   |
+                               CLK_FILTER_LINEAR);
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+    float2 pos;
+    float luma;
+    int i;
+
+    if (x >= dst_w || y >= dst_h)
+        return;
+
+    // the center of the destination pixel in the source
+    pos = (float2)(region.x + (x + 0.5f) * region.z,
+                   region.y + (y + 0.5f) * region.w);
+    luma = (read_imagef(src_y, sampler, pos).x - range.x) * range.y;
+    i = (y * dst_w + x) * CHANNELS;
+
+#if CHANNELS == 1
+    STORE(i, clamp(luma, 0.0f, 1.0f));
+#else
+    {
+        float2 cpos = pos / (float2)(1 << CHROMA_W, 1 << CHROMA_H);
+        float u, v;
+        float3 rgb;
+
+#ifdef SEMI_PLANAR
+        float2 uv = read_imagef(src_u, sampler, cpos).xy;
+        u = uv.x;
+        v = uv.y;
+#else
+        u = read_imagef(src_u, sampler, cpos).x;
+        v = read_imagef(src_v, sampler, cpos).x;
+#endif
+        u = (u - range.z) * range.w;
+        v = (v - range.z) * range.w;
+
+        rgb = (float3)(luma + mat.x * v,
+                       luma - mat.y * u - mat.z * v,
+                       luma + mat.w * u);
+        rgb = clamp(rgb, 0.0f, 1.0f);
+        STORE_RGB(i, rgb);
+    }
+#endif
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// Must match the work group size used by vf_scdet_opencl.c
+#define BLOCK 16
+
+// Sum of absolute differences of the first channel, in 16-bit units.
+// Each work group writes the sum of its block to sums, which the host
+// adds up; a block of 256 pixels cannot overflow 32 bits.
+__kernel void sad(__read_only image2d_t prev,
+                  __read_only image2d_t cur,
+                  __global uint *sums,
+                  int width,
+                  int height)
+{
+    const sampler_t sampler = (CLK_NORMALIZED_COORDS_FALSE |
+                               CLK_ADDRESS_CLAMP_TO_EDGE   |
+                               CLK_FILTER_NEAREST);
+    __local uint partial[BLOCK * BLOCK];
+
+    int2 loc  = (int2)(get_global_id(0), get_global_id(1));
+    int   lid = get_local_id(1) * BLOCK + get_local_id(0);
+    uint diff = 0;
+    int i;
+
+    if (loc.x < width && loc.y < height) {
+        float a = read_imagef(prev, sampler, loc).x;
+        float b = read_imagef(cur,  sampler, loc).x;
+        diff = convert_uint_sat_rte(fabs(a - b) * 65535.0f);
+    }
+    partial[lid] = diff;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (i = BLOCK * BLOCK / 2; i > 0; i >>= 1) {
+        if (lid < i)
+            partial[lid] += partial[lid + i];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        sums[get_group_id(1) * get_num_groups(0) + get_group_id(0)] = partial[0];
+}
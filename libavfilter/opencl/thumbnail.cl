@@ -0,0 +1,55 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+// Must match the work group size used by vf_thumbnail_opencl.c
+#define BLOCK 16
+
+__kernel void histogram(__read_only image2d_t src,
+                        __global uint *hist,
+                        int width,
+                        int height,
+                        int offset,
+                        int channels)
+{
+    const sampler_t sampler = (CLK_NORMALIZED_COORDS_FALSE |
+                               CLK_ADDRESS_CLAMP_TO_EDGE   |
+                               CLK_FILTER_NEAREST);
+    __local uint local_hist[2 * 256];
+
+    int2 loc  = (int2)(get_global_id(0), get_global_id(1));
+    int   lid = get_local_id(1) * BLOCK + get_local_id(0);
+    int i;
+
+    for (i = lid; i < 2 * 256; i += BLOCK * BLOCK)
+        local_hist[i] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (loc.x < width && loc.y < height) {
+        float4 val = read_imagef(src, sampler, loc);
+        atomic_inc(&local_hist[convert_int_sat_rte(val.x * 255.0f)]);
+        if (channels > 1)
+            atomic_inc(&local_hist[256 + convert_int_sat_rte(val.y * 255.0f)]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // merge the work group histogram, skipping the empty bins
+    for (i = lid; i < channels * 256; i += BLOCK * BLOCK) {
+        if (local_hist[i])
+            atomic_add(&hist[offset + i], local_hist[i]);
+    }
+}
@@ -23,6 +23,10 @@
 
 #include "config.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
@@ -30,6 +34,7 @@
 #include "libavutil/slicethread.h"
 
 #include "avfilter.h"
+#include "filters.h"
 #include "internal.h"
 #include "thread.h"
 
@@ -38,6 +43,9 @@ typedef struct ThreadContext {
     AVSliceThread *thread;
     avfilter_action_func *func;
 
+    /* serializes the filters of a pipelined graph */
+    AVMutex execute_lock;
+
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
@@ -54,6 +62,8 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 
 static void slice_thread_uninit(ThreadContext *c)
 {
+    if (c->thread)
+        ff_mutex_destroy(&c->execute_lock);
     avpriv_slicethread_free(&c->thread);
 }
 
@@ -64,25 +74,31 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    ff_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    ff_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
-    return FFMAX(nb_threads, 1);
+        return FFMAX(nb_threads, 1);
+    }
+    ff_mutex_init(&c->execute_lock, NULL);
+    return nb_threads;
 }
 
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
+    ThreadContext *c;
     int ret;
 
     if (graph->nb_threads == 1) {
@@ -90,11 +106,11 @@ int ff_graph_thread_init(AVFilterGraph *graph)
         return 0;
     }
 
-    graph->internal->thread = av_mallocz(sizeof(ThreadContext));
-    if (!graph->internal->thread)
+    graph->internal->thread = c = av_mallocz(sizeof(ThreadContext));
+    if (!c)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
+    ret = thread_init_internal(c, graph->nb_threads);
     if (ret <= 1) {
         av_freep(&graph->internal->thread);
         graph->thread_type = 0;
@@ -103,6 +119,11 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     }
     graph->nb_threads = ret;
 
+    if (graph->numa_node >= 0 &&
+        avpriv_slicethread_set_numa_node(c->thread, graph->numa_node) < 0)
+        av_log(graph, AV_LOG_WARNING, "Could not bind the threads to NUMA node %d\n",
+               graph->numa_node);
+
     graph->internal->thread_execute = thread_execute;
 
     return 0;
@@ -114,3 +135,247 @@ void ff_graph_thread_free(AVFilterGraph *graph)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
 }
+
+#if HAVE_PTHREADS
+typedef struct PipelineContext {
+    AVFilterGraph *graph;
+    pthread_t *workers;
+    int nb_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;  ///< signaled when a filter becomes ready
+    pthread_cond_t  done_cond;  ///< signaled when an activation is finished
+    /* set to the graph in the threads holding the lock */
+    pthread_key_t   owner;
+    /* set to the filter a worker is activating */
+    pthread_key_t   current;
+
+    int nb_busy;
+    int error;
+    int quit;
+} PipelineContext;
+
+static AVFilterContext *pipeline_next_filter(AVFilterGraph *graph)
+{
+    AVFilterContext *filter = NULL;
+    unsigned i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (f->ready && !f->internal->busy && (!filter || f->ready > filter->ready))
+            filter = f;
+    }
+    return filter;
+}
+
+static int pipeline_has_work(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    return p->nb_busy || pipeline_next_filter(graph);
+}
+
+static void *pipeline_worker(void *arg)
+{
+    PipelineContext *p = arg;
+    AVFilterGraph *graph = p->graph;
+
+    if (graph->numa_node >= 0 && av_cpu_numa_bind_thread(graph->numa_node) < 0)
+        av_log(graph, AV_LOG_WARNING, "Could not bind a pipeline thread to NUMA node %d\n",
+               graph->numa_node);
+
+    pthread_mutex_lock(&p->lock);
+    pthread_setspecific(p->owner, graph);
+    while (!p->quit) {
+        AVFilterContext *filter = pipeline_next_filter(graph);
+        int ret;
+
+        if (!filter) {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+            continue;
+        }
+        filter->internal->busy = 1;
+        p->nb_busy++;
+        pthread_setspecific(p->current, filter);
+        ret = ff_filter_activate(filter);
+        pthread_setspecific(p->current, NULL);
+        filter->internal->busy = 0;
+        p->nb_busy--;
+        if (ret < 0 && ret != AVERROR(EAGAIN) && !p->error)
+            p->error = ret;
+        pthread_cond_broadcast(&p->done_cond);
+    }
+    pthread_setspecific(p->owner, NULL);
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static int pipeline_error(PipelineContext *p)
+{
+    int ret = p->error;
+
+    p->error = 0;
+    return ret;
+}
+
+int ff_graph_pipeline_init(AVFilterGraph *graph)
+{
+    PipelineContext *p;
+    int i, ret;
+
+    if (graph->pipeline_threads <= 0 || graph->internal->pipeline)
+        return 0;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->graph   = graph;
+    p->workers = av_calloc(graph->pipeline_threads, sizeof(*p->workers));
+    if (!p->workers) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = pthread_mutex_init(&p->lock, NULL))) {
+        av_free(p->workers);
+        av_free(p);
+        return AVERROR(ret);
+    }
+    pthread_cond_init(&p->work_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+    pthread_key_create(&p->owner, NULL);
+    pthread_key_create(&p->current, NULL);
+    graph->internal->pipeline = p;
+
+    for (i = 0; i < graph->pipeline_threads; i++) {
+        ret = pthread_create(&p->workers[i], NULL, pipeline_worker, p);
+        if (ret) {
+            ff_graph_pipeline_free(graph);
+            return AVERROR(ret);
+        }
+        p->nb_workers++;
+    }
+    return 0;
+}
+
+void ff_graph_pipeline_free(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph->internal->pipeline;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 0; i < p->nb_workers; i++)
+        pthread_join(p->workers[i], NULL);
+
+    pthread_key_delete(p->current);
+    pthread_key_delete(p->owner);
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_mutex_destroy(&p->lock);
+    av_freep(&p->workers);
+    av_freep(&graph->internal->pipeline);
+}
+
+int ff_graph_lock(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph ? graph->internal->pipeline : NULL;
+
+    if (!p || pthread_getspecific(p->owner))
+        return 0;
+    pthread_mutex_lock(&p->lock);
+    pthread_setspecific(p->owner, graph);
+    return 1;
+}
+
+void ff_graph_unlock(AVFilterGraph *graph, int locked)
+{
+    PipelineContext *p;
+
+    if (!locked)
+        return;
+    p = graph->internal->pipeline;
+    pthread_setspecific(p->owner, NULL);
+    pthread_mutex_unlock(&p->lock);
+}
+
+int ff_graph_pipeline_leave(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    if (!p || !pthread_getspecific(p->owner))
+        return 0;
+    pthread_setspecific(p->owner, NULL);
+    pthread_mutex_unlock(&p->lock);
+    return 1;
+}
+
+void ff_graph_pipeline_enter(AVFilterGraph *graph, int left)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    if (!left)
+        return;
+    pthread_mutex_lock(&p->lock);
+    pthread_setspecific(p->owner, graph);
+}
+
+void ff_graph_pipeline_signal(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    pthread_cond_signal(&p->work_cond);
+}
+
+int ff_graph_pipeline_run_once(AVFilterGraph *graph)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    if (p->error)
+        return pipeline_error(p);
+    if (!pipeline_has_work(graph))
+        return AVERROR(EAGAIN);
+    pthread_cond_wait(&p->done_cond, &p->lock);
+    return pipeline_error(p);
+}
+
+static int pipeline_queued_frames(AVFilterGraph *graph)
+{
+    int queued = 0;
+    unsigned i, j;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (!f->nb_outputs)
+            continue;
+        for (j = 0; j < f->nb_inputs; j++)
+            queued += ff_inlink_queued_frames(f->inputs[j]);
+    }
+    return queued;
+}
+
+int ff_graph_pipeline_wait(AVFilterGraph *graph, int drain)
+{
+    PipelineContext *p = graph->internal->pipeline;
+
+    while (!p->error && pipeline_has_work(graph) &&
+           (drain || pipeline_queued_frames(graph) > p->nb_workers))
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    return pipeline_error(p);
+}
+
+void ff_filter_wait_idle(AVFilterContext *ctx)
+{
+    PipelineContext *p = ctx->graph ? ctx->graph->internal->pipeline : NULL;
+
+    if (!p)
+        return;
+    /* a filter sending a command to itself is busy in this thread */
+    while (ctx->internal->busy && pthread_getspecific(p->current) != ctx)
+        pthread_cond_wait(&p->done_cond, &p->lock);
+}
+#endif
@@ -22,6 +22,7 @@
  */
 
 #include "libavutil/common.h"
+#include "libavutil/fifo.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/hwcontext_qsv.h"
@@ -41,9 +42,16 @@ typedef struct QSVFrame {
     AVFrame          *frame;
     mfxFrameSurface1 *surface;
     mfxFrameSurface1  surface_internal;  /* for system memory */
+    int               queued;            /* waiting in the async fifo */
     struct QSVFrame  *next;
 } QSVFrame;
 
+/* an output frame submitted to the runtime but not synced yet */
+typedef struct QSVAsyncFrame {
+    QSVFrame     *frame;
+    mfxSyncPoint  sync;
+} QSVAsyncFrame;
+
 /* abstract struct for all QSV filters */
 struct QSVVPPContext {
     mfxSession          session;
@@ -66,6 +74,10 @@ struct QSVVPPContext {
     mfxExtOpaqueSurfaceAlloc opaque_alloc;
     mfxExtBuffer      **ext_buffers;
     int                 nb_ext_buffers;
+
+    /* output frames in flight, the oldest is synced once async_depth are queued */
+    int                 async_depth;
+    AVFifoBuffer       *async_fifo;
 };
 
 static const mfxHandleType handle_types[] = {
@@ -232,7 +244,7 @@ static int fill_frameinfo_by_link(mfxFrameInfo *frameinfo, AVFilterLink *link)
 static void clear_unused_frames(QSVFrame *list)
 {
     while (list) {
-        if (list->surface && !list->surface->Data.Locked) {
+        if (list->surface && !list->surface->Data.Locked && !list->queued) {
             list->surface = NULL;
             av_frame_free(&list->frame);
         }
@@ -460,7 +472,7 @@ static int init_vpp_session(AVFilterContext *avctx, QSVVPPContext *s)
         out_frames_ctx->width             = FFALIGN(outlink->w, 32);
         out_frames_ctx->height            = FFALIGN(outlink->h, 32);
         out_frames_ctx->sw_format         = s->out_sw_format;
-        out_frames_ctx->initial_pool_size = 64;
+        out_frames_ctx->initial_pool_size = 64 + s->async_depth;
         if (avctx->extra_hw_frames > 0)
             out_frames_ctx->initial_pool_size += avctx->extra_hw_frames;
         out_frames_hwctx->frame_type      = s->out_mem_mode;
@@ -572,6 +584,13 @@ int ff_qsvvpp_create(AVFilterContext *avctx, QSVVPPContext **vpp, QSVVPPParam *p
     if (!s->filter_frame)
         s->filter_frame = ff_filter_frame;
     s->out_sw_format = param->out_sw_format;
+    s->async_depth   = FFMAX(param->async_depth, 1);
+
+    s->async_fifo = av_fifo_alloc(s->async_depth * sizeof(QSVAsyncFrame));
+    if (!s->async_fifo) {
+        ret = AVERROR(ENOMEM);
+        goto failed;
+    }
 
     /* create the vpp session */
     ret = init_vpp_session(avctx, s);
@@ -630,7 +649,7 @@ int ff_qsvvpp_create(AVFilterContext *avctx, QSVVPPContext **vpp, QSVVPPParam *p
         s->vpp_param.ExtParam    = param->ext_buf;
     }
 
-    s->vpp_param.AsyncDepth = 1;
+    s->vpp_param.AsyncDepth = s->async_depth;
 
     if (IS_SYSTEM_MEMORY(s->in_mem_mode))
         s->vpp_param.IOPattern |= MFX_IOPATTERN_IN_SYSTEM_MEMORY;
@@ -680,16 +699,51 @@ int ff_qsvvpp_free(QSVVPPContext **vpp)
     av_freep(&s->surface_ptrs_out);
     av_freep(&s->ext_buffers);
     av_freep(&s->frame_infos);
+    av_fifo_freep(&s->async_fifo);
     av_freep(vpp);
 
     return 0;
 }
 
+/* sync the oldest queued output frame and pass it on */
+static int output_async_frame(QSVVPPContext *s, AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    QSVAsyncFrame    aframe;
+    int              ret;
+
+    av_fifo_generic_read(s->async_fifo, &aframe, sizeof(aframe), NULL);
+    aframe.frame->queued = 0;
+
+    if (MFXVideoCORE_SyncOperation(s->session, aframe.sync, 1000) < 0)
+        av_log(ctx, AV_LOG_WARNING, "Sync failed.\n");
+
+    aframe.frame->frame->pts = av_rescale_q(aframe.frame->surface->Data.TimeStamp,
+                                            default_tb, outlink->time_base);
+
+    ret = s->filter_frame(outlink, aframe.frame->frame);
+    if (ret < 0)
+        av_frame_free(&aframe.frame->frame);
+    aframe.frame->frame = NULL;
+
+    return ret;
+}
+
+int ff_qsvvpp_flush(QSVVPPContext *s, AVFilterLink *outlink)
+{
+    int ret = 0;
+
+    while (av_fifo_size(s->async_fifo) && ret >= 0)
+        ret = output_async_frame(s, outlink);
+
+    return ret;
+}
+
 int ff_qsvvpp_filter_frame(QSVVPPContext *s, AVFilterLink *inlink, AVFrame *picref)
 {
     AVFilterContext  *ctx     = inlink->dst;
     AVFilterLink     *outlink = ctx->outputs[0];
-    mfxSyncPoint      sync;
+    QSVAsyncFrame     aframe;
     QSVFrame         *in_frame, *out_frame;
     int               ret, filter_ret;
 
@@ -709,7 +763,7 @@ int ff_qsvvpp_filter_frame(QSVVPPContext *s, AVFilterLink *inlink, AVFrame *picr
 
         do {
             ret = MFXVideoVPP_RunFrameVPPAsync(s->session, in_frame->surface,
-                                               out_frame->surface, NULL, &sync);
+                                               out_frame->surface, NULL, &aframe.sync);
             if (ret == MFX_WRN_DEVICE_BUSY)
                 av_usleep(500);
         } while (ret == MFX_WRN_DEVICE_BUSY);
@@ -721,19 +775,18 @@ int ff_qsvvpp_filter_frame(QSVVPPContext *s, AVFilterLink *inlink, AVFrame *picr
             break;
         }
 
-        if (MFXVideoCORE_SyncOperation(s->session, sync, 1000) < 0)
-            av_log(ctx, AV_LOG_WARNING, "Sync failed.\n");
-
-        out_frame->frame->pts = av_rescale_q(out_frame->surface->Data.TimeStamp,
-                                             default_tb, outlink->time_base);
+        aframe.frame      = out_frame;
+        out_frame->queued = 1;
+        av_fifo_generic_write(s->async_fifo, &aframe, sizeof(aframe), NULL);
 
-        filter_ret = s->filter_frame(outlink, out_frame->frame);
+        filter_ret = 0;
+        while (av_fifo_size(s->async_fifo) >= s->async_depth * sizeof(aframe) &&
+               filter_ret >= 0)
+            filter_ret = output_async_frame(s, outlink);
         if (filter_ret < 0) {
-            av_frame_free(&out_frame->frame);
             ret = filter_ret;
             break;
         }
-        out_frame->frame = NULL;
     } while(ret == MFX_ERR_MORE_SURFACE);
 
     return ret;
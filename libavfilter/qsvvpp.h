@@ -60,6 +60,9 @@ typedef struct QSVVPPParam {
     /* Crop information for each input, if needed */
     int num_crop;
     QSVVPPCrop *crop;
+
+    /* Number of output frames kept in flight before syncing, 0 means 1 */
+    int async_depth;
 } QSVVPPParam;
 
 /* create and initialize the QSV session */
@@ -71,4 +74,7 @@ int ff_qsvvpp_free(QSVVPPContext **vpp);
 /* vpp filter frame and call the cb if needed */
 int ff_qsvvpp_filter_frame(QSVVPPContext *vpp, AVFilterLink *inlink, AVFrame *frame);
 
+/* sync and output all the frames still in flight, to be called on EOF */
+int ff_qsvvpp_flush(QSVVPPContext *vpp, AVFilterLink *outlink);
+
 #endif /* AVFILTER_QSVVPP_H */
@@ -21,6 +21,13 @@
  * Scene SAD functions
  */
 
+#include <stdlib.h>
+
+#include "libavutil/common.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+
+#include "internal.h"
 #include "scene_sad.h"
 
 void ff_scene_sad16_c(SCENE_SAD_PARAMS)
@@ -70,3 +77,126 @@ ff_scene_sad_fn ff_scene_sad_get_fn(int depth)
     return sad;
 }
 
+
+int ff_scene_score_init(SceneScoreContext *s, AVFilterLink *inlink)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    int is_yuv = !(desc->flags & AV_PIX_FMT_FLAG_RGB) &&
+                 (desc->flags & AV_PIX_FMT_FLAG_PLANAR) &&
+                 desc->nb_components >= 3;
+
+    s->bitdepth = desc->comp[0].depth;
+    s->nb_planes = is_yuv ? 1 : av_pix_fmt_count_planes(inlink->format);
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        ptrdiff_t line_size = av_image_get_linesize(inlink->format, inlink->w, plane);
+        int vsub = desc->log2_chroma_h;
+
+        s->width[plane] = line_size >> (s->bitdepth > 8);
+        s->height[plane] = plane == 1 || plane == 2 ? AV_CEIL_RSHIFT(inlink->h, vsub) : inlink->h;
+    }
+
+    s->sad = ff_scene_sad_get_fn(s->bitdepth == 8 ? 8 : 16);
+    if (!s->sad)
+        return AVERROR(EINVAL);
+
+    s->nb_jobs = FFMAX(1, FFMIN(inlink->h, ff_filter_get_nb_threads(inlink->dst)));
+    av_freep(&s->job_sad);
+    s->job_sad = av_calloc(s->nb_jobs, sizeof(*s->job_sad));
+    if (!s->job_sad)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+typedef struct ThreadData {
+    SceneScoreContext *s;
+    const AVFrame *prev;
+    const AVFrame *cur;
+} ThreadData;
+
+static int scene_sad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    SceneScoreContext *s = td->s;
+    uint64_t sad = 0;
+
+    for (int plane = 0; plane < s->nb_planes; plane++) {
+        const int start = (s->height[plane] * jobnr) / nb_jobs;
+        const int end = (s->height[plane] * (jobnr + 1)) / nb_jobs;
+        const ptrdiff_t stride1 = td->prev->linesize[plane];
+        const ptrdiff_t stride2 = td->cur->linesize[plane];
+        uint64_t plane_sad;
+
+        if (start >= end)
+            continue;
+        s->sad(td->prev->data[plane] + start * stride1, stride1,
+               td->cur->data[plane]  + start * stride2, stride2,
+               s->width[plane], end - start, &plane_sad);
+        sad += plane_sad;
+    }
+    emms_c();
+    s->job_sad[jobnr] = sad;
+
+    return 0;
+}
+
+double ff_scene_score(AVFilterContext *ctx, SceneScoreContext *s, AVFrame *frame)
+{
+    double ret = 0;
+    AVFrame *prev_picref = s->prev_picref;
+
+    if (prev_picref &&
+        frame->height == prev_picref->height &&
+        frame->width  == prev_picref->width) {
+        ThreadData td = { .s = s, .prev = prev_picref, .cur = frame };
+        uint64_t sad = 0;
+        double mafd, diff;
+        uint64_t count = 0;
+
+        ctx->internal->execute(ctx, scene_sad_slice, &td, NULL, s->nb_jobs);
+
+        for (int i = 0; i < s->nb_jobs; i++)
+            sad += s->job_sad[i];
+        for (int plane = 0; plane < s->nb_planes; plane++)
+            count += s->width[plane] * s->height[plane];
+
+        mafd = (double)sad / count / (1ULL << (s->bitdepth - 8));
+        diff = fabs(mafd - s->prev_mafd);
+        ret  = FFMIN(mafd, diff);
+        s->prev_mafd = mafd;
+        av_frame_free(&prev_picref);
+    }
+    s->prev_picref = av_frame_clone(frame);
+    return ret;
+}
+
+int ff_scene_score_from_metadata(const AVFrame *frame, double *score)
+{
+    AVDictionaryEntry *e = av_dict_get(frame->metadata, SCENE_SCORE_KEY, NULL, 0);
+    char *tail;
+    double val;
+
+    if (!e)
+        return 0;
+    val = strtod(e->value, &tail);
+    if (tail == e->value || *tail)
+        return 0;
+    *score = av_clipd(val, 0, 1);
+    return 1;
+}
+
+int ff_scene_score_set_metadata(AVFrame *frame, double score)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%f", score);
+    return av_dict_set(&frame->metadata, SCENE_SCORE_KEY, buf, 0);
+}
+
+void ff_scene_score_uninit(SceneScoreContext *s)
+{
+    av_frame_free(&s->prev_picref);
+    av_freep(&s->job_sad);
+    s->nb_jobs = 0;
+}
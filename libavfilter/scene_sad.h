@@ -24,6 +24,7 @@
 #ifndef AVFILTER_SCENE_SAD_H
 #define AVFILTER_SCENE_SAD_H
 
+#include "libavutil/frame.h"
 #include "avfilter.h"
 
 #define SCENE_SAD_PARAMS const uint8_t *src1, ptrdiff_t stride1, \
@@ -41,4 +42,50 @@ ff_scene_sad_fn ff_scene_sad_get_fn_x86(int depth);
 
 ff_scene_sad_fn ff_scene_sad_get_fn(int depth);
 
+/**
+ * Frame to frame scene change scoring, shared by the filters that need it.
+ * The SAD of each frame is computed in slices using the filter's threads.
+ */
+typedef struct SceneScoreContext {
+    ff_scene_sad_fn sad;
+    int bitdepth;
+    int nb_planes;
+    ptrdiff_t width[4];
+    ptrdiff_t height[4];
+    double prev_mafd;           ///< mean absolute frame difference of the last frame, in 8-bit units
+    AVFrame *prev_picref;       ///< previous frame
+    uint64_t *job_sad;          ///< partial SAD of each slice job
+    int nb_jobs;
+} SceneScoreContext;
+
+/**
+ * Metadata key holding the scene score, in the range [0, 1].
+ */
+#define SCENE_SCORE_KEY "lavfi.scene_score"
+
+int ff_scene_score_init(SceneScoreContext *s, AVFilterLink *inlink);
+
+/**
+ * Compute the scene change of frame against the previous frame passed to
+ * this function, and keep a reference to frame for the next call.
+ *
+ * @return the smaller of the mean absolute frame difference and its change
+ *         since the last frame, in 8-bit units; 0 for the first frame
+ */
+double ff_scene_score(AVFilterContext *ctx, SceneScoreContext *s, AVFrame *frame);
+
+/**
+ * Get the score set by an upstream filter, so that it is not computed twice.
+ *
+ * @return 1 and set *score if frame carries the score metadata, 0 otherwise
+ */
+int ff_scene_score_from_metadata(const AVFrame *frame, double *score);
+
+/**
+ * Store the score in the frame metadata for the filters downstream.
+ */
+int ff_scene_score_set_metadata(AVFrame *frame, double score);
+
+void ff_scene_score_uninit(SceneScoreContext *s);
+
 #endif /* AVFILTER_SCENE_SAD_H */
@@ -563,7 +563,7 @@ static const Block elem_d8_data[] = {
 };
 static const ElemCat elem_d8 = { 0, 1, 2, 20, elem_d8_data };
 
-static const ElemCat* elements[ELEMENT_COUNT] = { &elem_a1, &elem_a2,
+static av_unused const ElemCat* elements[ELEMENT_COUNT] = { &elem_a1, &elem_a2,
                                                   &elem_d1, &elem_d2, &elem_d3, &elem_d4,
                                                   &elem_d5, &elem_d6, &elem_d7, &elem_d8 };
 #endif /* AVFILTER_SIGNATURE_H */
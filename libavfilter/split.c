@@ -129,6 +129,7 @@ AVFilter ff_vf_split = {
     .inputs      = avfilter_vf_split_inputs,
     .outputs     = NULL,
     .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags_internal = FF_FILTER_FLAG_RECONFIGURABLE,
 };
 
 static const AVFilterPad avfilter_af_asplit_inputs[] = {
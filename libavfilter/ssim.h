@@ -31,6 +31,13 @@ typedef struct SSIMDSPContext {
     double (*ssim_end_line)(const int (*sum0)[4], const int (*sum1)[4], int w);
 } SSIMDSPContext;
 
+void ff_ssim_init(SSIMDSPContext *dsp);
 void ff_ssim_init_x86(SSIMDSPContext *dsp);
 
+/* high bit depth versions, the sums are too large for the SSIMDSPContext ones */
+void ff_ssim_4x4xn_16bit(const uint8_t *main, ptrdiff_t main_stride,
+                         const uint8_t *ref, ptrdiff_t ref_stride,
+                         int64_t (*sums)[4], int w);
+float ff_ssim_endn_16bit(const int64_t (*sum0)[4], const int64_t (*sum1)[4], int w, int max);
+
 #endif /* AVFILTER_SSIM_H */
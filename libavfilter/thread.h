@@ -25,4 +25,60 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Start the worker threads running the filters of a configured graph, if
+ * the pipeline_threads option is set.
+ *
+ * In this mode the graph is protected by a lock. Public entry points take it
+ * with ff_graph_lock(). The workers hold it while activating a filter, except
+ * around the filter_frame() callbacks, so several filters can process frames
+ * at the same time. The framework functions called from such a callback take
+ * the lock again with ff_graph_lock().
+ */
+int ff_graph_pipeline_init(AVFilterGraph *graph);
+
+void ff_graph_pipeline_free(AVFilterGraph *graph);
+
+/**
+ * Lock the graph if it is pipelined and the calling thread does not hold
+ * the lock yet.
+ *
+ * @return a value to pass to ff_graph_unlock()
+ */
+int ff_graph_lock(AVFilterGraph *graph);
+
+void ff_graph_unlock(AVFilterGraph *graph, int locked);
+
+/**
+ * Release the lock of a pipelined graph around a filter callback.
+ *
+ * @return a value to pass to ff_graph_pipeline_enter()
+ */
+int ff_graph_pipeline_leave(AVFilterGraph *graph);
+
+void ff_graph_pipeline_enter(AVFilterGraph *graph, int left);
+
+/**
+ * Wake up a worker after a filter was marked ready. The lock must be held.
+ */
+void ff_graph_pipeline_signal(AVFilterGraph *graph);
+
+/**
+ * Wait for a worker to finish an activation, or return AVERROR(EAGAIN) if
+ * no filter is ready or being activated. The lock must be held.
+ */
+int ff_graph_pipeline_run_once(AVFilterGraph *graph);
+
+/**
+ * Wait until the frames queued inside the graph do not exceed the number of
+ * workers, or with drain set until no filter is left to activate. The lock
+ * must be held.
+ */
+int ff_graph_pipeline_wait(AVFilterGraph *graph, int drain);
+
+/**
+ * Wait until no worker is activating the filter. The lock must be held.
+ */
+void ff_filter_wait_idle(AVFilterContext *ctx);
+
 #endif /* AVFILTER_THREAD_H */
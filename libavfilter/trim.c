@@ -215,6 +215,7 @@ AVFilter ff_vf_trim = {
     .priv_class  = &trim_class,
     .inputs      = trim_inputs,
     .outputs     = trim_outputs,
+    .flags_internal = FF_FILTER_FLAG_RECONFIGURABLE,
 };
 #endif // CONFIG_TRIM_FILTER
 
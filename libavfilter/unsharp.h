@@ -37,7 +37,7 @@ typedef struct UnsharpFilterParam {
     int steps_y;                             ///< vertical step count
     int scalebits;                           ///< bits to shift pixel
     int32_t halfscale;                       ///< amount to add to pixel
-    uint32_t *sr;        ///< finite state machine storage within a row
+    uint32_t *sr;        ///< the sums of a row, for each thread
     uint32_t **sc;       ///< finite state machine storage across rows
 } UnsharpFilterParam;
 
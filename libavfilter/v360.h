@@ -20,6 +20,7 @@
 
 #ifndef AVFILTER_V360_H
 #define AVFILTER_V360_H
+#include "libavutil/buffer.h"
 #include "avfilter.h"
 
 enum StereoFormats {
@@ -102,6 +103,8 @@ enum RotationOrder {
     NB_RORDERS,
 };
 
+#define V360_PHASES 256
+
 typedef struct XYRemap {
     int16_t u[4][4];
     int16_t v[4][4];
@@ -164,11 +167,22 @@ typedef struct V360Context {
     int mask_size;
     int max_value;
 
+    int map_step;
+
+    AVBufferRef *maps;          ///< the tables below, shared between instances
     int16_t *u[2], *v[2];
     int16_t *ker[2];
     uint8_t *mask;
     unsigned map[4];
 
+    /* compact maps, with map_step > 1 */
+    int grid_width[2], grid_height[2];
+    float *grid[2];             ///< input coordinates u, v at every map_step output pixel
+    int32_t *cells[2];          ///< per grid cell, -1 or the index of its exact tables
+    int16_t *exact[2];          ///< u, v and ker of the pixels of the cells not interpolated
+    int16_t *line_buf;          ///< u, v and ker of a line, for each thread
+    float coeffs[V360_PHASES + 1][4];
+
     int (*in_transform)(const struct V360Context *s,
                         const float *vec, int width, int height,
                         int16_t us[4][4], int16_t vs[4][4], float *du, float *dv);
@@ -43,6 +43,7 @@
 #include "framesync.h"
 #include "internal.h"
 #include "video.h"
+#include "vf_bm3d.h"
 
 #define MAX_NB_THREADS 32
 
@@ -114,11 +115,10 @@ typedef struct BM3DContext {
     FFFrameSync fs;
     int nb_threads;
 
+    BM3DDSPContext dsp;
+
     void (*get_block_row)(const uint8_t *srcp, int src_linesize,
                           int y, int x, int block_size, float *dst);
-    double (*do_block_ssd)(struct BM3DContext *s, PosCode *pos,
-                           const uint8_t *src, int src_stride,
-                           int r_y, int r_x);
     void (*do_output)(struct BM3DContext *s, uint8_t *dst, int dst_linesize,
                       int plane, int nb_jobs);
     void (*block_filtering)(struct BM3DContext *s,
@@ -225,50 +225,44 @@ static int search_boundary(int plane_boundary, int search_range, int search_step
     return do_search_boundary(vertical ? y : x, plane_boundary, search_range, search_step);
 }
 
-static int cmp_scores(const void *a, const void *b)
-{
-    const struct PosPairCode *pair1 = a;
-    const struct PosPairCode *pair2 = b;
-    return FFDIFFSIGN(pair1->score, pair2->score);
-}
-
-static double do_block_ssd(BM3DContext *s, PosCode *pos, const uint8_t *src, int src_stride, int r_y, int r_x)
+static uint64_t block_ssd(const uint8_t *src, const uint8_t *ref,
+                          ptrdiff_t linesize, int block_size)
 {
-    const uint8_t *srcp = src + pos->y * src_stride + pos->x;
-    const uint8_t *refp = src + r_y * src_stride + r_x;
-    const int block_size = s->block_size;
-    double dist = 0.;
+    uint64_t dist = 0;
     int x, y;
 
     for (y = 0; y < block_size; y++) {
+        uint32_t line = 0;
+
         for (x = 0; x < block_size; x++) {
-            double temp = refp[x] - srcp[x];
-            dist += temp * temp;
+            const int temp = ref[x] - src[x];
+            line += temp * temp;
         }
+        dist += line;
 
-        srcp += src_stride;
-        refp += src_stride;
+        src += linesize;
+        ref += linesize;
     }
 
     return dist;
 }
 
-static double do_block_ssd16(BM3DContext *s, PosCode *pos, const uint8_t *src, int src_stride, int r_y, int r_x)
+static uint64_t block_ssd16(const uint8_t *srcp, const uint8_t *refp,
+                            ptrdiff_t linesize, int block_size)
 {
-    const uint16_t *srcp = (uint16_t *)src + pos->y * src_stride / 2 + pos->x;
-    const uint16_t *refp = (uint16_t *)src + r_y * src_stride / 2 + r_x;
-    const int block_size = s->block_size;
-    double dist = 0.;
+    const uint16_t *src = (const uint16_t *)srcp;
+    const uint16_t *ref = (const uint16_t *)refp;
+    uint64_t dist = 0;
     int x, y;
 
     for (y = 0; y < block_size; y++) {
         for (x = 0; x < block_size; x++) {
-            double temp = refp[x] - srcp[x];
+            const int64_t temp = ref[x] - src[x];
             dist += temp * temp;
         }
 
-        srcp += src_stride / 2;
-        refp += src_stride / 2;
+        src += linesize / 2;
+        ref += linesize / 2;
     }
 
     return dist;
@@ -282,13 +276,16 @@ static void do_block_matching_multi(BM3DContext *s, const uint8_t *src, int src_
     double MSE2SSE = s->group_size * s->block_size * s->block_size * src_range * src_range / (s->max * s->max);
     double distMul = 1. / MSE2SSE;
     double th_sse = th_mse * MSE2SSE;
-    int i, index = sc->nb_match_blocks;
+    const int bps = s->depth > 8 ? 2 : 1;
+    const uint8_t *refp = src + r_y * src_stride + r_x * bps;
+    int i, j, index = sc->nb_match_blocks;
 
     for (i = 0; i < search_size; i++) {
         PosCode pos = search_pos[i];
         double dist;
 
-        dist = s->do_block_ssd(s, &pos, src, src_stride, r_y, r_x);
+        dist = s->dsp.block_ssd(src + pos.y * src_stride + pos.x * bps, refp,
+                                src_stride, s->block_size);
 
         // Only match similar blocks but not identical blocks
         if (dist <= th_sse && dist != 0) {
@@ -301,11 +298,14 @@ static void do_block_matching_multi(BM3DContext *s, const uint8_t *src, int src_
             if (index >= s->group_size)
                 index = s->group_size - 1;
 
-            sc->match_blocks[index].score = score;
-            sc->match_blocks[index].y = pos.y;
-            sc->match_blocks[index].x = pos.x;
+            // keep the blocks sorted, after the blocks of equal score
+            for (j = index; j > 0 && sc->match_blocks[j - 1].score > score; j--)
+                sc->match_blocks[j] = sc->match_blocks[j - 1];
+
+            sc->match_blocks[j].score = score;
+            sc->match_blocks[j].y = pos.y;
+            sc->match_blocks[j].x = pos.x;
             index++;
-            qsort(sc->match_blocks, index, sizeof(PosPairCode), cmp_scores);
         }
     }
 
@@ -777,6 +777,11 @@ static int filter_frame(AVFilterContext *ctx, AVFrame **out, AVFrame *in, AVFram
 
 #define SQR(x) ((x) * (x))
 
+av_cold void ff_bm3d_init(BM3DDSPContext *dsp, int depth)
+{
+    dsp->block_ssd = depth > 8 ? block_ssd16 : block_ssd;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
@@ -839,15 +844,15 @@ static int config_input(AVFilterLink *inlink)
     }
 
     s->do_output = do_output;
-    s->do_block_ssd = do_block_ssd;
     s->get_block_row = get_block_row;
 
     if (s->depth > 8) {
         s->do_output = do_output16;
-        s->do_block_ssd = do_block_ssd16;
         s->get_block_row = get_block_row16;
     }
 
+    ff_bm3d_init(&s->dsp, s->depth);
+
     return 0;
 }
 
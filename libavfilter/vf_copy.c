@@ -58,7 +58,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     ret = av_frame_copy_props(out, in);
     if (ret < 0)
         goto fail;
-    ret = av_frame_copy(out, in);
+    ret = ff_video_frame_copy(inlink->dst, out, in);
     if (ret < 0)
         goto fail;
     av_frame_free(&in);
@@ -92,4 +92,5 @@ AVFilter ff_vf_copy = {
     .inputs      = avfilter_vf_copy_inputs,
     .outputs     = avfilter_vf_copy_outputs,
     .query_formats = query_formats,
+    .flags_internal = FF_FILTER_FLAG_RECONFIGURABLE,
 };
@@ -81,6 +81,7 @@ static const AVOption deshake_options[] = {
     { "search",  "set search strategy", OFFSET(search), AV_OPT_TYPE_INT, {.i64=EXHAUSTIVE}, EXHAUSTIVE, SEARCH_COUNT-1, FLAGS, "smode" },
         { "exhaustive", "exhaustive search",      0, AV_OPT_TYPE_CONST, {.i64=EXHAUSTIVE},       INT_MIN, INT_MAX, FLAGS, "smode" },
         { "less",       "less exhaustive search", 0, AV_OPT_TYPE_CONST, {.i64=SMART_EXHAUSTIVE}, INT_MIN, INT_MAX, FLAGS, "smode" },
+        { "pyramid",    "half resolution search, full resolution refinement", 0, AV_OPT_TYPE_CONST, {.i64=PYRAMID}, INT_MIN, INT_MAX, FLAGS, "smode" },
     { "filename", "set motion search detailed log file name", OFFSET(filename), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { "opencl", "ignored",                              OFFSET(opencl), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
     { NULL }
@@ -163,6 +164,41 @@ static void find_block_motion(DeshakeContext *deshake, uint8_t *src1,
                 if (x == tmp && y == tmp2)
                     continue;
 
+                diff = CMP(cx - x, cy - y);
+                if (diff < smallest) {
+                    smallest = diff;
+                    mv->x = x;
+                    mv->y = y;
+                }
+            }
+        }
+    } else if (deshake->search == PYRAMID) {
+        // Compare every position of an 8x8 block on the half resolution
+        // planes, covering the same search range with a quarter of the
+        // positions and a quarter of the pixels each
+        const int hstride = deshake->pyramid_stride;
+        const uint8_t *hsrc1 = deshake->pyramid[0] + (cy >> 1) * hstride + (cx >> 1);
+        const uint8_t *hsrc2 = deshake->pyramid[1] + (cy >> 1) * hstride + (cx >> 1);
+
+        for (y = -(deshake->ry >> 1); y <= deshake->ry >> 1; y++) {
+            for (x = -(deshake->rx >> 1); x <= deshake->rx >> 1; x++) {
+                diff = deshake->sad_half(hsrc1, hstride,
+                                         hsrc2 - y * hstride - x, hstride);
+                if (diff < smallest) {
+                    smallest = diff;
+                    mv->x = x;
+                    mv->y = y;
+                }
+            }
+        }
+
+        // Refine the scaled up match on the full resolution planes
+        tmp  = mv->x * 2;
+        tmp2 = mv->y * 2;
+        smallest = INT_MAX;
+
+        for (y = FFMAX(tmp2 - 1, -deshake->ry); y <= FFMIN(tmp2 + 1, deshake->ry); y++) {
+            for (x = FFMAX(tmp - 1, -deshake->rx); x <= FFMIN(tmp + 1, deshake->rx); x++) {
                 diff = CMP(cx - x, cy - y);
                 if (diff < smallest) {
                     smallest = diff;
@@ -225,6 +261,62 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
            diff;
 }
 
+/**
+ * Downscale a luma plane by two in both directions for the pyramid search.
+ */
+static void downscale_half(uint8_t *dst, int dst_stride,
+                           const uint8_t *src, int src_stride,
+                           int width, int height)
+{
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        const uint8_t *s0 = src + 2 * y * src_stride;
+        const uint8_t *s1 = s0 + src_stride;
+
+        for (x = 0; x < width; x++)
+            dst[x] = (s0[2 * x] + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1] + 2) >> 2;
+        dst += dst_stride;
+    }
+}
+
+typedef struct ThreadData {
+    uint8_t *src1;
+    uint8_t *src2;
+    int stride;
+    int nb_rows;
+    int nb_cols;
+} ThreadData;
+
+/**
+ * Find the motion vector of every block in a range of block rows.
+ * Blocks that are skipped get a vector of (-1, -1).
+ */
+static int find_motion_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DeshakeContext *deshake = ctx->priv;
+    ThreadData *td = arg;
+    const int start = (td->nb_rows * jobnr) / nb_jobs;
+    const int end = (td->nb_rows * (jobnr + 1)) / nb_jobs;
+    int row, col, x, y;
+
+    for (row = start; row < end; row++) {
+        y = deshake->ry + row * deshake->blocksize * 2;
+        for (col = 0; col < td->nb_cols; col++) {
+            IntMotionVector *mv = &deshake->mvs[row * td->nb_cols + col];
+
+            x = deshake->rx + col * 16;
+            mv->x = mv->y = -1;
+            // If the contrast is too low, just skip this block as it probably
+            // won't be very useful to us.
+            if (block_contrast(td->src2, x, y, td->stride, deshake->blocksize) > deshake->contrast)
+                find_block_motion(deshake, td->src1, td->src2, x, y, td->stride, mv);
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Find the estimated global motion for a scene given the most likely shift
  * for each block in the frame. The global motion is estimated to be the
@@ -232,19 +324,21 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
  * move one pixel to the right and two pixels down, this would yield a
  * motion vector (1, -2).
  */
-static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
-                        int width, int height, int stride, Transform *t)
+static int find_motion(AVFilterContext *ctx, uint8_t *src1, uint8_t *src2,
+                       int width, int height, int stride, Transform *t)
 {
-    int x, y;
-    IntMotionVector mv = {0, 0};
+    DeshakeContext *deshake = ctx->priv;
+    ThreadData td;
+    int x, y, i;
     int count_max_value = 0;
-    int contrast;
 
     int pos;
     int center_x = 0, center_y = 0;
     double p_x, p_y;
 
     av_fast_malloc(&deshake->angles, &deshake->angles_size, width * height / (16 * deshake->blocksize) * sizeof(*deshake->angles));
+    if (!deshake->angles)
+        return AVERROR(ENOMEM);
 
     // Reset counts to zero
     for (x = 0; x < deshake->rx * 2 + 1; x++) {
@@ -253,27 +347,56 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
         }
     }
 
-    pos = 0;
-    // Find motion for every block and store the motion vector in the counts
-    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2) {
-        // We use a width of 16 here to match the sad function
-        for (x = deshake->rx; x < width - deshake->rx - 16; x += 16) {
-            // If the contrast is too low, just skip this block as it probably
-            // won't be very useful to us.
-            contrast = block_contrast(src2, x, y, stride, deshake->blocksize);
-            if (contrast > deshake->contrast) {
-                //av_log(NULL, AV_LOG_ERROR, "%d\n", contrast);
-                find_block_motion(deshake, src1, src2, x, y, stride, &mv);
-                if (mv.x != -1 && mv.y != -1) {
-                    deshake->counts[mv.x + deshake->rx][mv.y + deshake->ry] += 1;
-                    if (x > deshake->rx && y > deshake->ry)
-                        deshake->angles[pos++] = block_angle(x, y, 0, 0, &mv);
-
-                    center_x += mv.x;
-                    center_y += mv.y;
-                }
+    td.src1    = src1;
+    td.src2    = src2;
+    td.stride  = stride;
+    td.nb_rows = 0;
+    td.nb_cols = 0;
+    // We use a width of 16 here to match the sad function
+    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2)
+        td.nb_rows++;
+    for (x = deshake->rx; x < width - deshake->rx - 16; x += 16)
+        td.nb_cols++;
+
+    if (td.nb_rows > 0 && td.nb_cols > 0) {
+        av_fast_malloc(&deshake->mvs, &deshake->mvs_size,
+                       td.nb_rows * td.nb_cols * sizeof(*deshake->mvs));
+        if (!deshake->mvs)
+            return AVERROR(ENOMEM);
+
+        if (deshake->search == PYRAMID) {
+            // Pad by a block so that reads past the bottom and right edge
+            // stay inside the buffers, as they do in the frame padding
+            deshake->pyramid_stride = FFALIGN((width >> 1) + 16, 16);
+            for (i = 0; i < 2; i++) {
+                av_fast_mallocz(&deshake->pyramid[i], &deshake->pyramid_size[i],
+                                deshake->pyramid_stride * ((height >> 1) + 16));
+                if (!deshake->pyramid[i])
+                    return AVERROR(ENOMEM);
+                downscale_half(deshake->pyramid[i], deshake->pyramid_stride,
+                               i ? src2 : src1, stride, width >> 1, height >> 1);
             }
         }
+
+        ctx->internal->execute(ctx, find_motion_rows, &td, NULL,
+                               FFMIN(td.nb_rows, ff_filter_get_nb_threads(ctx)));
+    }
+
+    pos = 0;
+    // Store the motion vector of every block in the counts, in raster order
+    for (i = 0; i < td.nb_rows * td.nb_cols; i++) {
+        IntMotionVector *mv = &deshake->mvs[i];
+
+        x = deshake->rx + (i % td.nb_cols) * 16;
+        y = deshake->ry + (i / td.nb_cols) * deshake->blocksize * 2;
+        if (mv->x != -1 && mv->y != -1) {
+            deshake->counts[mv->x + deshake->rx][mv->y + deshake->ry] += 1;
+            if (x > deshake->rx && y > deshake->ry)
+                deshake->angles[pos++] = block_angle(x, y, 0, 0, mv);
+
+            center_x += mv->x;
+            center_y += mv->y;
+        }
     }
 
     if (pos) {
@@ -310,6 +433,7 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
     t->angle = av_clipf(t->angle, -0.1, 0.1);
 
     //av_log(NULL, AV_LOG_ERROR, "%d x %d\n", avg->x, avg->y);
+    return 0;
 }
 
 static int deshake_transform_c(AVFilterContext *ctx,
@@ -403,6 +527,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&deshake->ref);
     av_freep(&deshake->angles);
     deshake->angles_size = 0;
+    av_freep(&deshake->mvs);
+    deshake->mvs_size = 0;
+    av_freep(&deshake->pyramid[0]);
+    av_freep(&deshake->pyramid[1]);
     if (deshake->fp)
         fclose(deshake->fp);
 }
@@ -432,12 +560,13 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
     aligned = !((intptr_t)in->data[0] & 15 | in->linesize[0] & 15);
     deshake->sad = av_pixelutils_get_sad_fn(4, 4, aligned, deshake); // 16x16, 2nd source unaligned
-    if (!deshake->sad)
+    deshake->sad_half = av_pixelutils_get_sad_fn(3, 3, 0, deshake); // 8x8
+    if (!deshake->sad || !deshake->sad_half)
         return AVERROR(EINVAL);
 
     if (deshake->cx < 0 || deshake->cy < 0 || deshake->cw < 0 || deshake->ch < 0) {
         // Find the most likely global motion for the current frame
-        find_motion(deshake, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
+        ret = find_motion(link->dst, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
     } else {
         uint8_t *src1 = (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0];
         uint8_t *src2 = in->data[0];
@@ -454,9 +583,13 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         src1 += deshake->cy * in->linesize[0] + deshake->cx;
         src2 += deshake->cy * in->linesize[0] + deshake->cx;
 
-        find_motion(deshake, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+        ret = find_motion(link->dst, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+    }
+    if (ret < 0) {
+        av_frame_free(&out);
+        av_frame_free(&in);
+        return ret;
     }
-
 
     // Copy transform so we can output it later to compare to the smoothed value
     orig.vec.x = t.vec.x;
@@ -560,4 +693,5 @@ AVFilter ff_vf_deshake = {
     .inputs        = deshake_inputs,
     .outputs       = deshake_outputs,
     .priv_class    = &deshake_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,395 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * implementing a classification filter for the detected regions using deep learning networks.
+ */
+
+#include <float.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/detection_bbox.h"
+#include "libavutil/opt.h"
+#include "avfilter.h"
+#include "dnn_interface.h"
+#include "dnn/dnn_io_proc.h"
+#include "formats.h"
+#include "internal.h"
+
+typedef struct DnnClassifyContext {
+    const AVClass *class;
+
+    char *model_filename;
+    DNNBackendType backend_type;
+    char *model_inputname;
+    char *model_outputname;
+    char *backend_options;
+    float confidence;
+    char *labels_filename;
+    char *target;
+    enum AVPixelFormat model_fmt;
+    float mean;
+    float scale;
+
+    DNNModule *dnn_module;
+    DNNModel *model;
+
+    char **labels;
+    int nb_labels;
+
+    DNNData input;
+    DNNData output;
+    DNNPreProc preproc;
+} DnnClassifyContext;
+
+#define OFFSET(x) offsetof(DnnClassifyContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
+static const AVOption dnn_classify_options[] = {
+    { "dnn_backend", "DNN backend",                OFFSET(backend_type),     AV_OPT_TYPE_INT,       { .i64 = 0 },    INT_MIN, INT_MAX, FLAGS, "backend" },
+    { "native",      "native backend flag",        0,                        AV_OPT_TYPE_CONST,     { .i64 = 0 },    0, 0, FLAGS, "backend" },
+#if (CONFIG_LIBTENSORFLOW == 1)
+    { "tensorflow",  "tensorflow backend flag",    0,                        AV_OPT_TYPE_CONST,     { .i64 = 1 },    0, 0, FLAGS, "backend" },
+#endif
+#if (CONFIG_LIBOPENVINO == 1)
+    { "openvino",    "openvino backend flag",      0,                        AV_OPT_TYPE_CONST,     { .i64 = 2 },    0, 0, FLAGS, "backend" },
+#endif
+    { "model",       "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "input",       "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "output",      "output name of the model",   OFFSET(model_outputname), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "backend_configs", "backend configs",        OFFSET(backend_options),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "confidence",  "threshold of confidence",    OFFSET(confidence),       AV_OPT_TYPE_FLOAT,     { .dbl = 0.5 },  0, 1, FLAGS },
+    { "labels",      "path to labels file",        OFFSET(labels_filename),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "target",      "which one to be classified", OFFSET(target),           AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "model_fmt",   "pixel layout of a 3 channels model input", OFFSET(model_fmt), AV_OPT_TYPE_PIXEL_FMT, { .i64 = AV_PIX_FMT_BGR24 }, -1, INT_MAX, FLAGS },
+    { "mean",        "value subtracted from 8-bit samples for a float model", OFFSET(mean), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, -255, 255, FLAGS },
+    { "scale",       "factor applied to 8-bit samples for a float model", OFFSET(scale), AV_OPT_TYPE_FLOAT, { .dbl = 1.0 / 255 }, -FLT_MAX, FLT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(dnn_classify);
+
+static void free_labels(DnnClassifyContext *ctx)
+{
+    for (int i = 0; i < ctx->nb_labels; i++)
+        av_freep(&ctx->labels[i]);
+    av_freep(&ctx->labels);
+    ctx->nb_labels = 0;
+}
+
+// Reads one label per line, the line index is the label id of the model.
+static int read_labels(AVFilterContext *context)
+{
+    DnnClassifyContext *ctx = context->priv;
+    char buf[1024];
+    FILE *file;
+    int ret = 0;
+
+    file = av_fopen_utf8(ctx->labels_filename, "r");
+    if (!file) {
+        av_log(context, AV_LOG_ERROR, "failed to open labels file %s\n", ctx->labels_filename);
+        return AVERROR(EINVAL);
+    }
+
+    while (fgets(buf, sizeof(buf), file)) {
+        char *label;
+        size_t len = strlen(buf);
+
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            buf[--len] = '\0';
+
+        label = av_strdup(buf);
+        if (!label || av_dynarray_add_nofree(&ctx->labels, &ctx->nb_labels, label) < 0) {
+            av_freep(&label);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+    }
+
+    fclose(file);
+    return ret;
+}
+
+static av_cold int init(AVFilterContext *context)
+{
+    DnnClassifyContext *ctx = context->priv;
+    int ret;
+
+    if (!ctx->model_filename) {
+        av_log(ctx, AV_LOG_ERROR, "model file for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (!ctx->model_inputname) {
+        av_log(ctx, AV_LOG_ERROR, "input name of the model network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (!ctx->model_outputname) {
+        av_log(ctx, AV_LOG_ERROR, "output name of the model network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (ctx->model_fmt != AV_PIX_FMT_RGB24 && ctx->model_fmt != AV_PIX_FMT_BGR24) {
+        av_log(ctx, AV_LOG_ERROR, "model_fmt must be rgb24 or bgr24\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (ctx->labels_filename) {
+        ret = read_labels(context);
+        if (ret < 0)
+            return ret;
+    }
+
+    ctx->dnn_module = ff_get_dnn_module(ctx->backend_type);
+    if (!ctx->dnn_module) {
+        av_log(ctx, AV_LOG_ERROR, "could not create DNN module for requested backend\n");
+        return AVERROR(ENOMEM);
+    }
+    if (!ctx->dnn_module->load_model) {
+        av_log(ctx, AV_LOG_ERROR, "load_model for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename, ctx->backend_options);
+    if (!ctx->model) {
+        av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int query_formats(AVFilterContext *context)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24,
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_NV12,
+        AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    return ff_set_common_formats(context, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *context = inlink->dst;
+    DnnClassifyContext *ctx = context->priv;
+    DNNReturnType result;
+    DNNData model_input;
+    int ret;
+
+    result = ctx->model->get_input(ctx->model->model, &model_input, ctx->model_inputname);
+    if (result != DNN_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "could not get input from the model\n");
+        return AVERROR(EIO);
+    }
+
+    if (model_input.channels != 1 && model_input.channels != 3) {
+        av_log(ctx, AV_LOG_ERROR, "the model input channel %d is not supported\n", model_input.channels);
+        return AVERROR(EIO);
+    }
+    if (model_input.width == -1 || model_input.height == -1) {
+        av_log(ctx, AV_LOG_ERROR, "the model input size must be fixed\n");
+        return AVERROR(EIO);
+    }
+
+    ctx->input.width    = model_input.width;
+    ctx->input.height   = model_input.height;
+    ctx->input.channels = model_input.channels;
+    ctx->input.dt       = model_input.dt;
+
+    // the source is set for each region
+    ret = ff_dnn_preproc_init(&ctx->preproc, ctx, inlink->w, inlink->h, inlink->format, &ctx->input,
+                              model_input.channels == 3 ? ctx->model_fmt : AV_PIX_FMT_GRAY8,
+                              ctx->mean, ctx->scale);
+    if (ret < 0)
+        return ret;
+
+    result = (ctx->model->set_input_output)(ctx->model->model,
+                                            &ctx->input, ctx->model_inputname,
+                                            (const char **)&ctx->model_outputname, 1);
+    if (result != DNN_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "could not set input and output for the model\n");
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+// Converts the region of the bounding box to the model input.
+static int copy_from_bbox_to_dnn(AVFilterContext *context, const AVFrame *frame,
+                                 const AVDetectionBBox *bbox, DNNData *dnn_input)
+{
+    DnnClassifyContext *ctx = context->priv;
+    int x = bbox->x, y = bbox->y, w = bbox->w, h = bbox->h;
+    int ret;
+
+    ret = ff_dnn_preproc_run_region(&ctx->preproc, ctx, frame, &x, &y, &w, &h, dnn_input);
+    if (ret < 0)
+        return ret;
+
+    return w ? 0 : AVERROR(EINVAL);
+}
+
+// Appends the most probable class of the output to the bounding box.
+static int add_classification(AVFilterContext *context, AVDetectionBBox *bbox, const DNNData *output)
+{
+    DnnClassifyContext *ctx = context->priv;
+    const float *probs = output->data;
+    int nb_classes = output->channels * output->height * output->width;
+    int label_id = 0;
+    int i;
+
+    if (output->dt != DNN_FLOAT) {
+        av_log(ctx, AV_LOG_ERROR, "only support dnn models with output data type as float32.\n");
+        return AVERROR(EIO);
+    }
+
+    for (i = 1; i < nb_classes; i++) {
+        if (probs[i] > probs[label_id])
+            label_id = i;
+    }
+
+    if (probs[label_id] < ctx->confidence || bbox->classify_count >= AV_NUM_DETECTION_BBOX_CLASSIFY)
+        return 0;
+
+    i = bbox->classify_count++;
+    bbox->classify_confidences[i] = av_make_q((int)(probs[label_id] * 10000), 10000);
+    if (label_id < ctx->nb_labels)
+        av_strlcpy(bbox->classify_labels[i], ctx->labels[label_id], sizeof(bbox->classify_labels[i]));
+    else
+        snprintf(bbox->classify_labels[i], sizeof(bbox->classify_labels[i]), "%d", label_id);
+
+    return 0;
+}
+
+static int classify_bbox(AVFilterContext *context, const AVFrame *frame, AVDetectionBBox *bbox)
+{
+    DnnClassifyContext *ctx = context->priv;
+    DNNReturnType dnn_result;
+    int ret;
+
+    ret = copy_from_bbox_to_dnn(context, frame, bbox, &ctx->input);
+    if (ret < 0)
+        return ret;
+
+    dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
+    if (dnn_result != DNN_SUCCESS){
+        av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+        return AVERROR(EIO);
+    }
+
+    return add_classification(context, bbox, &ctx->output);
+}
+
+static int classify_frame(AVFilterContext *context, AVFrame *frame)
+{
+    DnnClassifyContext *ctx = context->priv;
+    AVDetectionBBoxHeader *header;
+    AVFrameSideData *sd;
+    int ret;
+
+    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
+    if (!sd)
+        return 0;
+
+    // the classifications are added in place
+    ret = av_buffer_make_writable(&sd->buf);
+    if (ret < 0)
+        return ret;
+    sd->data = sd->buf->data;
+    header = (AVDetectionBBoxHeader *)sd->data;
+
+    for (int i = 0; i < header->nb_bboxes; i++) {
+        AVDetectionBBox *bbox = av_get_detection_bbox(header, i);
+
+        if (ctx->target && strcmp(bbox->detect_label, ctx->target))
+            continue;
+        if (bbox->classify_count >= AV_NUM_DETECTION_BBOX_CLASSIFY)
+            continue;
+        if (bbox->w <= 0 || bbox->h <= 0 ||
+            bbox->x >= frame->width || bbox->y >= frame->height ||
+            bbox->x + bbox->w <= 0 || bbox->y + bbox->h <= 0)
+            continue;
+
+        ret = classify_bbox(context, frame, bbox);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *context = inlink->dst;
+    int ret;
+
+    ret = classify_frame(context, in);
+    if (ret < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
+
+    return ff_filter_frame(context->outputs[0], in);
+}
+
+static av_cold void uninit(AVFilterContext *context)
+{
+    DnnClassifyContext *ctx = context->priv;
+
+    ff_dnn_preproc_uninit(&ctx->preproc);
+    free_labels(ctx);
+
+    if (ctx->dnn_module)
+        (ctx->dnn_module->free_model)(&ctx->model);
+
+    av_freep(&ctx->dnn_module);
+}
+
+static const AVFilterPad dnn_classify_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad dnn_classify_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_dnn_classify = {
+    .name          = "dnn_classify",
+    .description   = NULL_IF_CONFIG_SMALL("Apply DNN classify filter to the input."),
+    .priv_size     = sizeof(DnnClassifyContext),
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = dnn_classify_inputs,
+    .outputs       = dnn_classify_outputs,
+    .priv_class    = &dnn_classify_class,
+};
@@ -0,0 +1,584 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * implementing an object detecting filter using deep learning networks.
+ */
+
+#include <float.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/detection_bbox.h"
+#include "libavutil/opt.h"
+#include "avfilter.h"
+#include "dnn_interface.h"
+#include "dnn/dnn_io_proc.h"
+#include "formats.h"
+#include "internal.h"
+#if CONFIG_OPENCL
+#include "dnn/dnn_io_proc_opencl.h"
+#endif
+
+// a detection of the DetectionOutput layout: image_id, label, confidence, x_min, y_min, x_max, y_max
+#define DETECTION_SIZE 7
+
+enum DetectAction {
+    DETECT_PASS,    ///< output the frame without bounding boxes
+    DETECT_INFER,   ///< run the detection on the frame
+    DETECT_REUSE,   ///< attach the bounding boxes of the last inferred frame
+};
+
+typedef struct DnnDetectContext {
+    const AVClass *class;
+
+    char *model_filename;
+    DNNBackendType backend_type;
+    char *model_inputname;
+    char *model_outputname;
+    char *backend_options;
+    float confidence;
+    char *labels_filename;
+    int detect_interval;
+    enum AVPixelFormat model_fmt;
+    float mean;
+    float scale;
+    float scene_thresh;
+    int roi_only;
+
+    DNNModule *dnn_module;
+    DNNModel *model;
+
+    char **labels;
+    int nb_labels;
+
+    DNNData input;
+    DNNData output;
+    DNNPreProc preproc;
+#if CONFIG_OPENCL
+    // OpenCL frames are pre-processed on the device
+    DNNPreProcOpenCL preproc_opencl;
+#endif
+    int64_t frame_count;
+
+    // the detections of the frame being inferred
+    AVDetectionBBox *bboxes;
+    unsigned int bboxes_size;
+    int nb_bboxes;
+
+    // the side data of the last inferred frame and the frame itself, for the scene check
+    AVBufferRef *last_bboxes;
+    AVFrame *ref_frame;
+    ff_scene_sad_fn sad;
+} DnnDetectContext;
+
+#define OFFSET(x) offsetof(DnnDetectContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM
+static const AVOption dnn_detect_options[] = {
+    { "dnn_backend", "DNN backend",                OFFSET(backend_type),     AV_OPT_TYPE_INT,       { .i64 = 0 },    INT_MIN, INT_MAX, FLAGS, "backend" },
+    { "native",      "native backend flag",        0,                        AV_OPT_TYPE_CONST,     { .i64 = 0 },    0, 0, FLAGS, "backend" },
+#if (CONFIG_LIBTENSORFLOW == 1)
+    { "tensorflow",  "tensorflow backend flag",    0,                        AV_OPT_TYPE_CONST,     { .i64 = 1 },    0, 0, FLAGS, "backend" },
+#endif
+#if (CONFIG_LIBOPENVINO == 1)
+    { "openvino",    "openvino backend flag",      0,                        AV_OPT_TYPE_CONST,     { .i64 = 2 },    0, 0, FLAGS, "backend" },
+#endif
+    { "model",       "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "input",       "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "output",      "output name of the model",   OFFSET(model_outputname), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "backend_configs", "backend configs",        OFFSET(backend_options),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "confidence",  "threshold of confidence",    OFFSET(confidence),       AV_OPT_TYPE_FLOAT,     { .dbl = 0.5 },  0, 1, FLAGS },
+    { "labels",      "path to labels file",        OFFSET(labels_filename),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "detect_interval", "run the detection once every this many frames", OFFSET(detect_interval), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, INT_MAX, FLAGS },
+    { "model_fmt",   "pixel layout of a 3 channels model input", OFFSET(model_fmt), AV_OPT_TYPE_PIXEL_FMT, { .i64 = AV_PIX_FMT_BGR24 }, -1, INT_MAX, FLAGS },
+    { "mean",        "value subtracted from 8-bit samples for a float model", OFFSET(mean), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, -255, 255, FLAGS },
+    { "scale",       "factor applied to 8-bit samples for a float model", OFFSET(scale), AV_OPT_TYPE_FLOAT, { .dbl = 1.0 / 255 }, -FLT_MAX, FLT_MAX, FLAGS },
+    { "scene_thresh", "reuse the last detections while the scene score stays below this", OFFSET(scene_thresh), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, 0, 100, FLAGS },
+    { "roi_only",    "only run the detection in the regions of interest", OFFSET(roi_only), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(dnn_detect);
+
+static void free_labels(DnnDetectContext *ctx)
+{
+    for (int i = 0; i < ctx->nb_labels; i++)
+        av_freep(&ctx->labels[i]);
+    av_freep(&ctx->labels);
+    ctx->nb_labels = 0;
+}
+
+// Reads one label per line, the line index is the label id of the model.
+static int read_labels(AVFilterContext *context)
+{
+    DnnDetectContext *ctx = context->priv;
+    char buf[1024];
+    FILE *file;
+    int ret = 0;
+
+    file = av_fopen_utf8(ctx->labels_filename, "r");
+    if (!file) {
+        av_log(context, AV_LOG_ERROR, "failed to open labels file %s\n", ctx->labels_filename);
+        return AVERROR(EINVAL);
+    }
+
+    while (fgets(buf, sizeof(buf), file)) {
+        char *label;
+        size_t len = strlen(buf);
+
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            buf[--len] = '\0';
+
+        label = av_strdup(buf);
+        if (!label || av_dynarray_add_nofree(&ctx->labels, &ctx->nb_labels, label) < 0) {
+            av_freep(&label);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+    }
+
+    fclose(file);
+    return ret;
+}
+
+static av_cold int init(AVFilterContext *context)
+{
+    DnnDetectContext *ctx = context->priv;
+    int ret;
+
+    if (!ctx->model_filename) {
+        av_log(ctx, AV_LOG_ERROR, "model file for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (!ctx->model_inputname) {
+        av_log(ctx, AV_LOG_ERROR, "input name of the model network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (!ctx->model_outputname) {
+        av_log(ctx, AV_LOG_ERROR, "output name of the model network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+    if (ctx->model_fmt != AV_PIX_FMT_RGB24 && ctx->model_fmt != AV_PIX_FMT_BGR24) {
+        av_log(ctx, AV_LOG_ERROR, "model_fmt must be rgb24 or bgr24\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (ctx->labels_filename) {
+        ret = read_labels(context);
+        if (ret < 0)
+            return ret;
+    }
+
+    ctx->dnn_module = ff_get_dnn_module(ctx->backend_type);
+    if (!ctx->dnn_module) {
+        av_log(ctx, AV_LOG_ERROR, "could not create DNN module for requested backend\n");
+        return AVERROR(ENOMEM);
+    }
+    if (!ctx->dnn_module->load_model) {
+        av_log(ctx, AV_LOG_ERROR, "load_model for network is not specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename, ctx->backend_options);
+    if (!ctx->model) {
+        av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (ctx->scene_thresh > 0)
+        ctx->sad = ff_scene_sad_get_fn(8);
+
+    return 0;
+}
+
+static int query_formats(AVFilterContext *context)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24,
+        AV_PIX_FMT_GRAY8,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_NV12,
+#if CONFIG_OPENCL
+        AV_PIX_FMT_OPENCL,
+#endif
+        AV_PIX_FMT_NONE
+    };
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    return ff_set_common_formats(context, fmts_list);
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *context = inlink->dst;
+    DnnDetectContext *ctx = context->priv;
+    DNNReturnType result;
+    DNNData model_input;
+    int ret;
+
+    result = ctx->model->get_input(ctx->model->model, &model_input, ctx->model_inputname);
+    if (result != DNN_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "could not get input from the model\n");
+        return AVERROR(EIO);
+    }
+
+    if (model_input.channels != 1 && model_input.channels != 3) {
+        av_log(ctx, AV_LOG_ERROR, "the model input channel %d is not supported\n", model_input.channels);
+        return AVERROR(EIO);
+    }
+
+    // the frames are resized to the model input size if it is fixed
+    ctx->input.width    = model_input.width  != -1 ? model_input.width  : inlink->w;
+    ctx->input.height   = model_input.height != -1 ? model_input.height : inlink->h;
+    ctx->input.channels = model_input.channels;
+    ctx->input.dt       = model_input.dt;
+
+#if CONFIG_OPENCL
+    if (inlink->format == AV_PIX_FMT_OPENCL) {
+        if (!inlink->hw_frames_ctx) {
+            av_log(ctx, AV_LOG_ERROR, "a hardware frames context is required for hardware input\n");
+            return AVERROR(EINVAL);
+        }
+        // the scene score is computed from the samples in memory
+        if (ctx->scene_thresh > 0) {
+            av_log(ctx, AV_LOG_ERROR, "scene_thresh is not supported for OpenCL input\n");
+            return AVERROR(EINVAL);
+        }
+        ret = ff_dnn_preproc_opencl_init(&ctx->preproc_opencl, ctx, inlink->hw_frames_ctx, &ctx->input,
+                                         model_input.channels == 3 ? ctx->model_fmt : AV_PIX_FMT_GRAY8,
+                                         ctx->mean, ctx->scale);
+    } else
+#endif
+    ret = ff_dnn_preproc_init(&ctx->preproc, ctx, inlink->w, inlink->h, inlink->format, &ctx->input,
+                              model_input.channels == 3 ? ctx->model_fmt : AV_PIX_FMT_GRAY8,
+                              ctx->mean, ctx->scale);
+    if (ret < 0)
+        return ret;
+
+    result = (ctx->model->set_input_output)(ctx->model->model,
+                                            &ctx->input, ctx->model_inputname,
+                                            (const char **)&ctx->model_outputname, 1);
+    if (result != DNN_SUCCESS) {
+        av_log(ctx, AV_LOG_ERROR, "could not set input and output for the model\n");
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
+static int copy_from_frame_to_dnn(DnnDetectContext *ctx, const AVFrame *frame, DNNData *dnn_input)
+{
+#if CONFIG_OPENCL
+    if (frame->format == AV_PIX_FMT_OPENCL)
+        return ff_dnn_preproc_opencl_run(&ctx->preproc_opencl, ctx, frame, 0, 0,
+                                         frame->width, frame->height, dnn_input);
+#endif
+    return ff_dnn_preproc_run(&ctx->preproc, (const uint8_t * const *)frame->data,
+                              frame->linesize, dnn_input);
+}
+
+// Appends the detections above the confidence threshold, the coordinates
+// of the model are relative to the region x, y, w, h of the frame.
+static int collect_detections(AVFilterContext *context, const DNNData *output,
+                              int x, int y, int w, int h)
+{
+    DnnDetectContext *ctx = context->priv;
+    const float *detections = output->data;
+    int nb_detections = output->channels * output->height * output->width / DETECTION_SIZE;
+
+    if (output->dt != DNN_FLOAT) {
+        av_log(ctx, AV_LOG_ERROR, "only support dnn models with output data type as float32.\n");
+        return AVERROR(EIO);
+    }
+
+    for (int i = 0; i < nb_detections; i++) {
+        const float *det = detections + i * DETECTION_SIZE;
+        AVDetectionBBox *bbox;
+        int label_id, x0, y0, x1, y1;
+
+        // a negative image id ends the detections
+        if (det[0] < 0)
+            break;
+        if (det[2] < ctx->confidence)
+            continue;
+
+        bbox = av_fast_realloc(ctx->bboxes, &ctx->bboxes_size,
+                               (ctx->nb_bboxes + 1) * sizeof(*ctx->bboxes));
+        if (!bbox)
+            return AVERROR(ENOMEM);
+        ctx->bboxes = bbox;
+        bbox = &ctx->bboxes[ctx->nb_bboxes++];
+        memset(bbox, 0, sizeof(*bbox));
+
+        x0 = x + av_clipf(det[3], 0, 1) * w;
+        y0 = y + av_clipf(det[4], 0, 1) * h;
+        x1 = x + av_clipf(det[5], 0, 1) * w;
+        y1 = y + av_clipf(det[6], 0, 1) * h;
+        bbox->x = x0;
+        bbox->y = y0;
+        bbox->w = FFMAX(x1 - x0, 0);
+        bbox->h = FFMAX(y1 - y0, 0);
+
+        bbox->detect_confidence = av_make_q((int)(det[2] * 10000), 10000);
+        label_id = det[1];
+        if (label_id >= 0 && label_id < ctx->nb_labels)
+            av_strlcpy(bbox->detect_label, ctx->labels[label_id], sizeof(bbox->detect_label));
+        else
+            snprintf(bbox->detect_label, sizeof(bbox->detect_label), "%d", label_id);
+    }
+
+    return 0;
+}
+
+// Exports the collected detections as side data of the frame.
+static int attach_detections(AVFilterContext *context, AVFrame *frame)
+{
+    DnnDetectContext *ctx = context->priv;
+    AVDetectionBBoxHeader *header;
+    int nb_bboxes = ctx->nb_bboxes;
+
+    ctx->nb_bboxes = 0;
+    av_buffer_unref(&ctx->last_bboxes);
+    av_frame_remove_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
+    if (!nb_bboxes)
+        return 0;
+
+    header = av_detection_bbox_create_side_data(frame, nb_bboxes);
+    if (!header)
+        return AVERROR(ENOMEM);
+    av_strlcpy(header->source, ctx->model_filename, sizeof(header->source));
+    for (int i = 0; i < nb_bboxes; i++)
+        *av_get_detection_bbox(header, i) = ctx->bboxes[i];
+
+    if (ctx->scene_thresh > 0) {
+        AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
+        ctx->last_bboxes = av_buffer_ref(sd->buf);
+        if (!ctx->last_bboxes)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static int add_detections(AVFilterContext *context, AVFrame *frame, const DNNData *output)
+{
+    int ret = collect_detections(context, output, 0, 0, frame->width, frame->height);
+    if (ret < 0)
+        return ret;
+    return attach_detections(context, frame);
+}
+
+// Attaches the bounding boxes of the last inferred frame, they are shared by the frames.
+static int reuse_detections(AVFilterContext *context, AVFrame *frame)
+{
+    DnnDetectContext *ctx = context->priv;
+    AVBufferRef *buf;
+
+    av_frame_remove_side_data(frame, AV_FRAME_DATA_DETECTION_BBOXES);
+    if (!ctx->last_bboxes)
+        return 0;
+
+    buf = av_buffer_ref(ctx->last_bboxes);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    if (!av_frame_new_side_data_from_buf(frame, AV_FRAME_DATA_DETECTION_BBOXES, buf)) {
+        av_buffer_unref(&buf);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+// Fills the model input with the region of the frame, the region actually
+// used is written back as by ff_dnn_preproc_run_region().
+static int copy_region_to_dnn(DnnDetectContext *ctx, const AVFrame *frame,
+                              int *x, int *y, int *w, int *h, DNNData *dnn_input)
+{
+#if CONFIG_OPENCL
+    if (frame->format == AV_PIX_FMT_OPENCL) {
+        int x0 = av_clip(*x, 0, frame->width);
+        int y0 = av_clip(*y, 0, frame->height);
+        int x1 = av_clip(*x + (int64_t)*w, 0, frame->width);
+        int y1 = av_clip(*y + (int64_t)*h, 0, frame->height);
+
+        *x = x0;
+        *y = y0;
+        *w = FFMAX(x1 - x0, 0);
+        *h = FFMAX(y1 - y0, 0);
+        if (!*w || !*h) {
+            *w = *h = 0;
+            return 0;
+        }
+        return ff_dnn_preproc_opencl_run(&ctx->preproc_opencl, ctx, frame,
+                                         *x, *y, *w, *h, dnn_input);
+    }
+#endif
+    return ff_dnn_preproc_run_region(&ctx->preproc, ctx, frame, x, y, w, h, dnn_input);
+}
+
+// Runs the detection in each region of interest of the frame.
+static int detect_regions(AVFilterContext *context, AVFrame *frame)
+{
+    DnnDetectContext *ctx = context->priv;
+    AVFrameSideData *sd = av_frame_get_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+    const AVRegionOfInterest *roi = (const AVRegionOfInterest *)sd->data;
+    uint32_t roi_size = roi->self_size;
+    int nb_rois;
+
+    if (!roi_size || sd->size % roi_size) {
+        av_log(ctx, AV_LOG_ERROR, "invalid regions of interest side data\n");
+        return AVERROR(EINVAL);
+    }
+    nb_rois = sd->size / roi_size;
+
+    for (int i = 0; i < nb_rois; i++) {
+        DNNReturnType dnn_result;
+        int x, y, w, h, ret;
+
+        roi = (const AVRegionOfInterest *)(sd->data + roi_size * i);
+        x = roi->left;
+        y = roi->top;
+        w = roi->right  - roi->left;
+        h = roi->bottom - roi->top;
+        ret = copy_region_to_dnn(ctx, frame, &x, &y, &w, &h, &ctx->input);
+        if (ret < 0)
+            return ret;
+        if (!w)
+            continue;
+
+        dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
+        if (dnn_result != DNN_SUCCESS){
+            av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+            return AVERROR(EIO);
+        }
+
+        ret = collect_detections(context, &ctx->output, x, y, w, h);
+        if (ret < 0)
+            return ret;
+    }
+
+    return attach_detections(context, frame);
+}
+
+// Decides what to do with the next frame.
+static int get_action(AVFilterContext *context, const AVFrame *frame)
+{
+    DnnDetectContext *ctx = context->priv;
+
+    if (ctx->frame_count++ % ctx->detect_interval)
+        return DETECT_PASS;
+    if (ctx->roi_only && !av_frame_get_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST))
+        return DETECT_PASS;
+
+    if (ctx->scene_thresh > 0) {
+        // the scene is compared to the last inferred frame, so that slow changes add up
+        if (ctx->ref_frame && ctx->ref_frame->width == frame->width &&
+            ctx->ref_frame->height == frame->height &&
+            ff_dnn_scene_score(ctx->sad, ctx->ref_frame, frame) < ctx->scene_thresh)
+            return DETECT_REUSE;
+
+        av_frame_free(&ctx->ref_frame);
+        ctx->ref_frame = av_frame_clone(frame);
+        if (!ctx->ref_frame)
+            return AVERROR(ENOMEM);
+    }
+
+    return DETECT_INFER;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *context = inlink->dst;
+    AVFilterLink *outlink = context->outputs[0];
+    DnnDetectContext *ctx = context->priv;
+    DNNReturnType dnn_result;
+    int ret;
+
+    ret = get_action(context, in);
+    if (ret == DETECT_REUSE) {
+        ret = reuse_detections(context, in);
+    } else if (ret == DETECT_INFER && ctx->roi_only) {
+        ret = detect_regions(context, in);
+    } else if (ret == DETECT_INFER) {
+        copy_from_frame_to_dnn(ctx, in, &ctx->input);
+
+        dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
+        if (dnn_result != DNN_SUCCESS){
+            av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+            av_frame_free(&in);
+            return AVERROR(EIO);
+        }
+
+        ret = add_detections(context, in, &ctx->output);
+    }
+    if (ret < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
+
+    return ff_filter_frame(outlink, in);
+}
+
+static av_cold void uninit(AVFilterContext *context)
+{
+    DnnDetectContext *ctx = context->priv;
+
+    ff_dnn_preproc_uninit(&ctx->preproc);
+#if CONFIG_OPENCL
+    ff_dnn_preproc_opencl_uninit(&ctx->preproc_opencl, ctx);
+#endif
+    av_freep(&ctx->bboxes);
+    av_buffer_unref(&ctx->last_bboxes);
+    av_frame_free(&ctx->ref_frame);
+    free_labels(ctx);
+
+    if (ctx->dnn_module)
+        (ctx->dnn_module->free_model)(&ctx->model);
+
+    av_freep(&ctx->dnn_module);
+}
+
+static const AVFilterPad dnn_detect_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+static const AVFilterPad dnn_detect_outputs[] = {
+    {
+        .name = "default",
+        .type = AVMEDIA_TYPE_VIDEO,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_dnn_detect = {
+    .name          = "dnn_detect",
+    .description   = NULL_IF_CONFIG_SMALL("Apply DNN detect filter to the input."),
+    .priv_size     = sizeof(DnnDetectContext),
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = dnn_detect_inputs,
+    .outputs       = dnn_detect_outputs,
+    .priv_class    = &dnn_detect_class,
+};
@@ -23,13 +23,18 @@
  * implementing a generic image processing filter using deep learning networks.
  */
 
+#include <float.h>
+
 #include "libavformat/avio.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/avassert.h"
+#include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
 #include "avfilter.h"
 #include "dnn_interface.h"
+#include "dnn/dnn_io_proc.h"
+#include "filters.h"
 #include "formats.h"
 #include "internal.h"
 #include "libswscale/swscale.h"
@@ -41,15 +46,32 @@ typedef struct DnnProcessingContext {
     DNNBackendType backend_type;
     char *model_inputname;
     char *model_outputname;
+    char *backend_options;
+    float mean;
+    float scale;
+    float scene_thresh;
+    int tile_size;
+    int tile_overlap;
 
     DNNModule *dnn_module;
     DNNModel *model;
 
+    // format of the frame data, the sw_format for hardware frames
+    enum AVPixelFormat sw_format;
+
     // input & output of the model at execution time
     DNNData input;
     DNNData output;
 
-    struct SwsContext *sws_gray8_to_grayf32;
+    // the last inferred frame and a copy of its output, for the scene check
+    AVFrame *ref_frame;
+    DNNData last_output;
+    uint8_t *last_output_buf;
+    unsigned int last_output_size;
+    ff_scene_sad_fn sad;
+
+    DNNPreProc preproc;
+    DNNTiles tiles;
     struct SwsContext *sws_grayf32_to_gray8;
     struct SwsContext *sws_uv_scale;
     int sws_uv_height;
@@ -69,6 +91,12 @@ static const AVOption dnn_processing_options[] = {
     { "model",       "path to model file",         OFFSET(model_filename),   AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
     { "input",       "input name of the model",    OFFSET(model_inputname),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
     { "output",      "output name of the model",   OFFSET(model_outputname), AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "backend_configs", "backend configs",        OFFSET(backend_options),  AV_OPT_TYPE_STRING,    { .str = NULL }, 0, 0, FLAGS },
+    { "mean",        "value subtracted from 8-bit samples for a float model", OFFSET(mean), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, -255, 255, FLAGS },
+    { "scale",       "factor applied to 8-bit samples for a float model", OFFSET(scale), AV_OPT_TYPE_FLOAT, { .dbl = 1.0 / 255 }, -FLT_MAX, FLT_MAX, FLAGS },
+    { "scene_thresh", "reuse the last output while the scene score stays below this", OFFSET(scene_thresh), AV_OPT_TYPE_FLOAT, { .dbl = 0 }, 0, 100, FLAGS },
+    { "tile_size",   "run the model on tiles of at most this size, 0 for the whole frame", OFFSET(tile_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "tile_overlap", "pixels of context around each tile", OFFSET(tile_overlap), AV_OPT_TYPE_INT, { .i64 = 16 }, 0, 1024, FLAGS },
     { NULL }
 };
 
@@ -101,12 +129,15 @@ static av_cold int init(AVFilterContext *context)
         return AVERROR(EINVAL);
     }
 
-    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename);
+    ctx->model = (ctx->dnn_module->load_model)(ctx->model_filename, ctx->backend_options);
     if (!ctx->model) {
         av_log(ctx, AV_LOG_ERROR, "could not load DNN model\n");
         return AVERROR(EINVAL);
     }
 
+    if (ctx->scene_thresh > 0)
+        ctx->sad = ff_scene_sad_get_fn(8);
+
     return 0;
 }
 
@@ -117,6 +148,8 @@ static int query_formats(AVFilterContext *context)
         AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAYF32,
         AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
         AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV411P,
+        AV_PIX_FMT_NV12,
+        AV_PIX_FMT_VAAPI,
         AV_PIX_FMT_NONE
     };
     AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
@@ -130,22 +163,10 @@ static int query_formats(AVFilterContext *context)
            av_get_pix_fmt_name(fmt),                        \
            model_input->channels);
 
-static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLink *inlink)
+static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLink *inlink,
+                                   enum AVPixelFormat fmt)
 {
     AVFilterContext *ctx   = inlink->dst;
-    enum AVPixelFormat fmt = inlink->format;
-
-    // the design is to add explicit scale filter before this filter
-    if (model_input->height != -1 && model_input->height != inlink->h) {
-        av_log(ctx, AV_LOG_ERROR, "the model requires frame height %d but got %d\n",
-                                   model_input->height, inlink->h);
-        return AVERROR(EIO);
-    }
-    if (model_input->width != -1 && model_input->width != inlink->w) {
-        av_log(ctx, AV_LOG_ERROR, "the model requires frame width %d but got %d\n",
-                                   model_input->width, inlink->w);
-        return AVERROR(EIO);
-    }
 
     switch (fmt) {
     case AV_PIX_FMT_RGB24:
@@ -154,8 +175,8 @@ static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLin
             LOG_FORMAT_CHANNEL_MISMATCH();
             return AVERROR(EIO);
         }
-        if (model_input->dt != DNN_FLOAT && model_input->dt != DNN_UINT8) {
-            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type as float32 and uint8.\n");
+        if (model_input->dt != DNN_FLOAT && model_input->dt != DNN_HALF && model_input->dt != DNN_UINT8) {
+            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type as float32, float16 and uint8.\n");
             return AVERROR(EIO);
         }
         return 0;
@@ -170,17 +191,27 @@ static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLin
         }
         return 0;
     case AV_PIX_FMT_GRAYF32:
+        if (model_input->channels != 1) {
+            LOG_FORMAT_CHANNEL_MISMATCH();
+            return AVERROR(EIO);
+        }
+        if (model_input->dt != DNN_FLOAT) {
+            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type float32.\n");
+            return AVERROR(EIO);
+        }
+        return 0;
     case AV_PIX_FMT_YUV420P:
     case AV_PIX_FMT_YUV422P:
     case AV_PIX_FMT_YUV444P:
     case AV_PIX_FMT_YUV410P:
     case AV_PIX_FMT_YUV411P:
+    case AV_PIX_FMT_NV12:
         if (model_input->channels != 1) {
             LOG_FORMAT_CHANNEL_MISMATCH();
             return AVERROR(EIO);
         }
-        if (model_input->dt != DNN_FLOAT) {
-            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type float32.\n");
+        if (model_input->dt != DNN_FLOAT && model_input->dt != DNN_HALF) {
+            av_log(ctx, AV_LOG_ERROR, "only support dnn models with input data type float32 and float16.\n");
             return AVERROR(EIO);
         }
         return 0;
@@ -192,13 +223,28 @@ static int check_modelinput_inlink(const DNNData *model_input, const AVFilterLin
     return 0;
 }
 
+// Gives the pixel layout of the model input for the frame format,
+// only the luma plane of the yuv formats is processed.
+static enum AVPixelFormat model_pix_fmt(enum AVPixelFormat fmt)
+{
+    switch (fmt) {
+    case AV_PIX_FMT_RGB24:
+    case AV_PIX_FMT_BGR24:
+    case AV_PIX_FMT_GRAY8:
+    case AV_PIX_FMT_GRAYF32:
+        return fmt;
+    default:
+        return AV_PIX_FMT_GRAY8;
+    }
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *context     = inlink->dst;
     DnnProcessingContext *ctx = context->priv;
     DNNReturnType result;
     DNNData model_input;
-    int check;
+    int check, ret;
 
     result = ctx->model->get_input(ctx->model->model, &model_input, ctx->model_inputname);
     if (result != DNN_SUCCESS) {
@@ -206,16 +252,49 @@ static int config_input(AVFilterLink *inlink)
         return AVERROR(EIO);
     }
 
-    check = check_modelinput_inlink(&model_input, inlink);
+    if (inlink->format == AV_PIX_FMT_VAAPI) {
+        // hardware frames are mapped to memory, the surfaces are not downloaded
+        if (!inlink->hw_frames_ctx) {
+            av_log(ctx, AV_LOG_ERROR, "a hardware frames context is required for hardware input\n");
+            return AVERROR(EINVAL);
+        }
+        ctx->sw_format = ((AVHWFramesContext *)inlink->hw_frames_ctx->data)->sw_format;
+    } else {
+        ctx->sw_format = inlink->format;
+    }
+
+    check = check_modelinput_inlink(&model_input, inlink, ctx->sw_format);
     if (check != 0) {
         return check;
     }
 
-    ctx->input.width    = inlink->w;
-    ctx->input.height   = inlink->h;
+    if (ctx->scene_thresh > 0 && ctx->sw_format == AV_PIX_FMT_GRAYF32) {
+        av_log(ctx, AV_LOG_ERROR, "scene_thresh is not supported for %s\n",
+               av_get_pix_fmt_name(ctx->sw_format));
+        return AVERROR(EINVAL);
+    }
+
+    // the frames are resized to the model input size if it is fixed
+    ctx->input.width    = model_input.width  != -1 ? model_input.width  : inlink->w;
+    ctx->input.height   = model_input.height != -1 ? model_input.height : inlink->h;
     ctx->input.channels = model_input.channels;
     ctx->input.dt = model_input.dt;
 
+    if (ctx->tile_size > 0 && (model_input.width != -1 || model_input.height != -1)) {
+        av_log(ctx, AV_LOG_ERROR, "tile_size is not supported for a model with a fixed input size\n");
+        return AVERROR(EINVAL);
+    }
+
+    ret = ff_dnn_preproc_init(&ctx->preproc, ctx, inlink->w, inlink->h, model_pix_fmt(ctx->sw_format),
+                              &ctx->input, model_pix_fmt(ctx->sw_format), ctx->mean, ctx->scale);
+    if (ret < 0)
+        return ret;
+
+    if (ctx->tile_size > 0)
+        return ff_dnn_tiles_init(&ctx->tiles, ctx, ctx->dnn_module, ctx->model,
+                                 &ctx->input, ctx->model_inputname, ctx->model_outputname,
+                                 ctx->tile_size, ctx->tile_overlap, &ctx->output);
+
     result = (ctx->model->set_input_output)(ctx->model->model,
                                         &ctx->input, ctx->model_inputname,
                                         (const char **)&ctx->model_outputname, 1);
@@ -232,22 +311,13 @@ static int prepare_sws_context(AVFilterLink *outlink)
     AVFilterContext *context = outlink->src;
     DnnProcessingContext *ctx = context->priv;
     AVFilterLink *inlink = context->inputs[0];
-    enum AVPixelFormat fmt = inlink->format;
+    enum AVPixelFormat fmt = ctx->sw_format;
     DNNDataType input_dt  = ctx->input.dt;
     DNNDataType output_dt = ctx->output.dt;
 
     switch (fmt) {
     case AV_PIX_FMT_RGB24:
     case AV_PIX_FMT_BGR24:
-        if (input_dt == DNN_FLOAT) {
-            ctx->sws_gray8_to_grayf32 = sws_getContext(inlink->w * 3,
-                                                       inlink->h,
-                                                       AV_PIX_FMT_GRAY8,
-                                                       inlink->w * 3,
-                                                       inlink->h,
-                                                       AV_PIX_FMT_GRAYF32,
-                                                       0, NULL, NULL, NULL);
-        }
         if (output_dt == DNN_FLOAT) {
             ctx->sws_grayf32_to_gray8 = sws_getContext(outlink->w * 3,
                                                        outlink->h,
@@ -263,22 +333,18 @@ static int prepare_sws_context(AVFilterLink *outlink)
     case AV_PIX_FMT_YUV444P:
     case AV_PIX_FMT_YUV410P:
     case AV_PIX_FMT_YUV411P:
-        av_assert0(input_dt == DNN_FLOAT);
-        av_assert0(output_dt == DNN_FLOAT);
-        ctx->sws_gray8_to_grayf32 = sws_getContext(inlink->w,
-                                                   inlink->h,
-                                                   AV_PIX_FMT_GRAY8,
-                                                   inlink->w,
-                                                   inlink->h,
-                                                   AV_PIX_FMT_GRAYF32,
-                                                   0, NULL, NULL, NULL);
-        ctx->sws_grayf32_to_gray8 = sws_getContext(outlink->w,
-                                                   outlink->h,
-                                                   AV_PIX_FMT_GRAYF32,
-                                                   outlink->w,
-                                                   outlink->h,
-                                                   AV_PIX_FMT_GRAY8,
-                                                   0, NULL, NULL, NULL);
+    case AV_PIX_FMT_NV12:
+        av_assert0(input_dt == DNN_FLOAT || input_dt == DNN_HALF);
+        av_assert0(output_dt == DNN_FLOAT || output_dt == DNN_HALF);
+        if (output_dt == DNN_FLOAT) {
+            ctx->sws_grayf32_to_gray8 = sws_getContext(outlink->w,
+                                                       outlink->h,
+                                                       AV_PIX_FMT_GRAYF32,
+                                                       outlink->w,
+                                                       outlink->h,
+                                                       AV_PIX_FMT_GRAY8,
+                                                       0, NULL, NULL, NULL);
+        }
 
         if (inlink->w != outlink->w || inlink->h != outlink->h) {
             const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
@@ -286,8 +352,10 @@ static int prepare_sws_context(AVFilterLink *outlink)
             int sws_src_w = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
             int sws_dst_h = AV_CEIL_RSHIFT(outlink->h, desc->log2_chroma_h);
             int sws_dst_w = AV_CEIL_RSHIFT(outlink->w, desc->log2_chroma_w);
-            ctx->sws_uv_scale = sws_getContext(sws_src_w, sws_src_h, AV_PIX_FMT_GRAY8,
-                                               sws_dst_w, sws_dst_h, AV_PIX_FMT_GRAY8,
+            // the interleaved UV plane of NV12 is scaled as a two components format
+            enum AVPixelFormat uv_fmt = fmt == AV_PIX_FMT_NV12 ? AV_PIX_FMT_YA8 : AV_PIX_FMT_GRAY8;
+            ctx->sws_uv_scale = sws_getContext(sws_src_w, sws_src_h, uv_fmt,
+                                               sws_dst_w, sws_dst_h, uv_fmt,
                                                SWS_BICUBIC, NULL, NULL, NULL);
             ctx->sws_uv_height = sws_src_h;
         }
@@ -300,72 +368,77 @@ static int prepare_sws_context(AVFilterLink *outlink)
     return 0;
 }
 
+// The output surfaces are allocated from a new pool of the input device with the output size.
+static int init_hw_frames(AVFilterLink *outlink)
+{
+    AVFilterContext *context = outlink->src;
+    AVFilterLink *inlink = context->inputs[0];
+    AVHWFramesContext *in_frames = (AVHWFramesContext *)inlink->hw_frames_ctx->data;
+    AVHWFramesContext *out_frames;
+    AVBufferRef *frames_ref;
+    int ret;
+
+    frames_ref = av_hwframe_ctx_alloc(in_frames->device_ref);
+    if (!frames_ref)
+        return AVERROR(ENOMEM);
+
+    out_frames = (AVHWFramesContext *)frames_ref->data;
+    out_frames->format    = in_frames->format;
+    out_frames->sw_format = in_frames->sw_format;
+    out_frames->width     = outlink->w;
+    out_frames->height    = outlink->h;
+
+    ret = av_hwframe_ctx_init(frames_ref);
+    if (ret < 0) {
+        av_log(context, AV_LOG_ERROR, "failed to create the output frames context\n");
+        av_buffer_unref(&frames_ref);
+        return ret;
+    }
+
+    av_buffer_unref(&outlink->hw_frames_ctx);
+    outlink->hw_frames_ctx = frames_ref;
+    return 0;
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *context = outlink->src;
     DnnProcessingContext *ctx = context->priv;
     DNNReturnType result;
 
-    // have a try run in case that the dnn model resize the frame
-    result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
-    if (result != DNN_SUCCESS){
-        av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
-        return AVERROR(EIO);
+    // have a try run in case that the dnn model resize the frame,
+    // the tiler already did it to find its output size
+    if (!ctx->tile_size) {
+        result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
+        if (result != DNN_SUCCESS){
+            av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+            return AVERROR(EIO);
+        }
     }
 
     outlink->w = ctx->output.width;
     outlink->h = ctx->output.height;
 
+    if (outlink->format != ctx->sw_format) {
+        int ret = init_hw_frames(outlink);
+        if (ret < 0)
+            return ret;
+    }
+
     prepare_sws_context(outlink);
 
     return 0;
 }
 
-static int copy_from_frame_to_dnn(DnnProcessingContext *ctx, const AVFrame *frame)
+static int copy_from_frame_to_dnn(DnnProcessingContext *ctx, const AVFrame *frame, DNNData *dnn_input)
 {
-    int bytewidth = av_image_get_linesize(frame->format, frame->width, 0);
-    DNNData *dnn_input = &ctx->input;
-
-    switch (frame->format) {
-    case AV_PIX_FMT_RGB24:
-    case AV_PIX_FMT_BGR24:
-        if (dnn_input->dt == DNN_FLOAT) {
-            sws_scale(ctx->sws_gray8_to_grayf32, (const uint8_t **)frame->data, frame->linesize,
-                      0, frame->height, (uint8_t * const*)(&dnn_input->data),
-                      (const int [4]){frame->width * 3 * sizeof(float), 0, 0, 0});
-        } else {
-            av_assert0(dnn_input->dt == DNN_UINT8);
-            av_image_copy_plane(dnn_input->data, bytewidth,
-                                frame->data[0], frame->linesize[0],
-                                bytewidth, frame->height);
-        }
-        return 0;
-    case AV_PIX_FMT_GRAY8:
-    case AV_PIX_FMT_GRAYF32:
-        av_image_copy_plane(dnn_input->data, bytewidth,
-                            frame->data[0], frame->linesize[0],
-                            bytewidth, frame->height);
-        return 0;
-    case AV_PIX_FMT_YUV420P:
-    case AV_PIX_FMT_YUV422P:
-    case AV_PIX_FMT_YUV444P:
-    case AV_PIX_FMT_YUV410P:
-    case AV_PIX_FMT_YUV411P:
-        sws_scale(ctx->sws_gray8_to_grayf32, (const uint8_t **)frame->data, frame->linesize,
-                  0, frame->height, (uint8_t * const*)(&dnn_input->data),
-                  (const int [4]){frame->width * sizeof(float), 0, 0, 0});
-        return 0;
-    default:
-        return AVERROR(EIO);
-    }
-
-    return 0;
+    return ff_dnn_preproc_run(&ctx->preproc, (const uint8_t * const *)frame->data,
+                              frame->linesize, dnn_input);
 }
 
-static int copy_from_dnn_to_frame(DnnProcessingContext *ctx, AVFrame *frame)
+static int copy_from_dnn_to_frame(DnnProcessingContext *ctx, AVFrame *frame, const DNNData *dnn_output)
 {
     int bytewidth = av_image_get_linesize(frame->format, frame->width, 0);
-    DNNData *dnn_output = &ctx->output;
 
     switch (frame->format) {
     case AV_PIX_FMT_RGB24:
@@ -375,6 +448,9 @@ static int copy_from_dnn_to_frame(DnnProcessingContext *ctx, AVFrame *frame)
                       (const int[4]){frame->width * 3 * sizeof(float), 0, 0, 0},
                       0, frame->height, (uint8_t * const*)frame->data, frame->linesize);
 
+        } else if (dnn_output->dt == DNN_HALF) {
+            ff_dnn_half_to_uint8(frame->data[0], frame->linesize[0], dnn_output->data,
+                                 frame->width * 3 * sizeof(uint16_t), frame->width * 3, frame->height);
         } else {
             av_assert0(dnn_output->dt == DNN_UINT8);
             av_image_copy_plane(frame->data[0], frame->linesize[0],
@@ -401,6 +477,12 @@ static int copy_from_dnn_to_frame(DnnProcessingContext *ctx, AVFrame *frame)
     case AV_PIX_FMT_YUV444P:
     case AV_PIX_FMT_YUV410P:
     case AV_PIX_FMT_YUV411P:
+    case AV_PIX_FMT_NV12:
+        if (dnn_output->dt == DNN_HALF) {
+            ff_dnn_half_to_uint8(frame->data[0], frame->linesize[0], dnn_output->data,
+                                 frame->width * sizeof(uint16_t), frame->width, frame->height);
+            return 0;
+        }
         sws_scale(ctx->sws_grayf32_to_gray8, (const uint8_t *[4]){(const uint8_t *)dnn_output->data, 0, 0, 0},
                   (const int[4]){frame->width * sizeof(float), 0, 0, 0},
                   0, frame->height, (uint8_t * const*)frame->data, frame->linesize);
@@ -423,44 +505,75 @@ static int copy_uv_planes(DnnProcessingContext *ctx, AVFrame *out, const AVFrame
 {
     const AVPixFmtDescriptor *desc;
     int uv_height;
+    int nb_planes = av_pix_fmt_count_planes(in->format);
 
     if (!ctx->sws_uv_scale) {
         av_assert0(in->height == out->height && in->width == out->width);
         desc = av_pix_fmt_desc_get(in->format);
         uv_height = AV_CEIL_RSHIFT(in->height, desc->log2_chroma_h);
-        for (int i = 1; i < 3; ++i) {
+        for (int i = 1; i < nb_planes; ++i) {
             int bytewidth = av_image_get_linesize(in->format, in->width, i);
             av_image_copy_plane(out->data[i], out->linesize[i],
                                 in->data[i], in->linesize[i],
                                 bytewidth, uv_height);
         }
     } else {
-        sws_scale(ctx->sws_uv_scale, (const uint8_t **)(in->data + 1), in->linesize + 1,
-                  0, ctx->sws_uv_height, out->data + 1, out->linesize + 1);
-        sws_scale(ctx->sws_uv_scale, (const uint8_t **)(in->data + 2), in->linesize + 2,
-                  0, ctx->sws_uv_height, out->data + 2, out->linesize + 2);
+        for (int i = 1; i < nb_planes; ++i)
+            sws_scale(ctx->sws_uv_scale, (const uint8_t **)(in->data + i), in->linesize + i,
+                      0, ctx->sws_uv_height, out->data + i, out->linesize + i);
     }
 
     return 0;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+// Gives access to the data of a hardware frame without downloading it.
+static int map_hw_frame(AVFrame **dst, AVFrame *src, enum AVPixelFormat sw_format, int flags)
 {
-    AVFilterContext *context  = inlink->dst;
-    AVFilterLink *outlink = context->outputs[0];
-    DnnProcessingContext *ctx = context->priv;
-    DNNReturnType dnn_result;
-    AVFrame *out;
+    AVFrame *mapped = av_frame_alloc();
+    int ret;
 
-    copy_from_frame_to_dnn(ctx, in);
+    if (!mapped)
+        return AVERROR(ENOMEM);
 
-    dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
-    if (dnn_result != DNN_SUCCESS){
-        av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
-        av_frame_free(&in);
-        return AVERROR(EIO);
+    mapped->format = sw_format;
+    ret = av_hwframe_map(mapped, src, flags);
+    if (ret < 0) {
+        av_frame_free(&mapped);
+        return ret;
+    }
+
+    *dst = mapped;
+    return 0;
+}
+
+static int map_input_frame(DnnProcessingContext *ctx, AVFrame **in)
+{
+    AVFrame *mapped;
+    int ret;
+
+    if (!(*in)->hw_frames_ctx)
+        return 0;
+
+    ret = map_hw_frame(&mapped, *in, ctx->sw_format, AV_HWFRAME_MAP_READ);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "failed to map the hardware input frame\n");
+        av_frame_free(in);
+        return ret;
     }
 
+    av_frame_copy_props(mapped, *in);
+    av_frame_free(in);
+    *in = mapped;
+    return 0;
+}
+
+static int output_frame(AVFilterContext *context, AVFrame *in, const DNNData *dnn_output)
+{
+    AVFilterLink *outlink = context->outputs[0];
+    DnnProcessingContext *ctx = context->priv;
+    AVFrame *out, *dst;
+    int ret;
+
     out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
         av_frame_free(&in);
@@ -468,20 +581,173 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     av_frame_copy_props(out, in);
-    copy_from_dnn_to_frame(ctx, out);
+
+    // the output surface is written in place, it is uploaded when unmapped
+    dst = out;
+    if (out->hw_frames_ctx) {
+        ret = map_hw_frame(&dst, out, ctx->sw_format, AV_HWFRAME_MAP_WRITE | AV_HWFRAME_MAP_OVERWRITE);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "failed to map the hardware output frame\n");
+            av_frame_free(&out);
+            av_frame_free(&in);
+            return ret;
+        }
+    }
+
+    copy_from_dnn_to_frame(ctx, dst, dnn_output);
 
     if (isPlanarYUV(in->format))
-        copy_uv_planes(ctx, out, in);
+        copy_uv_planes(ctx, dst, in);
 
+    if (dst != out)
+        av_frame_free(&dst);
     av_frame_free(&in);
     return ff_filter_frame(outlink, out);
 }
 
+// Keeps a copy of the output of the last inference, which is overwritten by the next one.
+static int save_output(DnnProcessingContext *ctx, const DNNData *output)
+{
+    size_t size = ff_dnn_data_size(output);
+
+    av_fast_malloc(&ctx->last_output_buf, &ctx->last_output_size, size);
+    if (!ctx->last_output_buf)
+        return AVERROR(ENOMEM);
+    memcpy(ctx->last_output_buf, output->data, size);
+
+    ctx->last_output      = *output;
+    ctx->last_output.data = ctx->last_output_buf;
+    return 0;
+}
+
+// Returns 1 if the frame is close enough to the last inferred frame to reuse its output.
+static int scene_unchanged(DnnProcessingContext *ctx, const AVFrame *frame)
+{
+    // the scene is compared to the last inferred frame, so that slow changes add up
+    if (ctx->ref_frame && ctx->last_output.data &&
+        ff_dnn_scene_score(ctx->sad, ctx->ref_frame, frame) < ctx->scene_thresh)
+        return 1;
+
+    av_frame_free(&ctx->ref_frame);
+    ctx->ref_frame = av_frame_clone(frame);
+    return ctx->ref_frame ? 0 : AVERROR(ENOMEM);
+}
+
+static int filter_frame(AVFilterContext *context, AVFrame *in, int *got_frame)
+{
+    DnnProcessingContext *ctx = context->priv;
+    DNNReturnType dnn_result;
+    int ret = 0;
+
+    if (ctx->scene_thresh > 0) {
+        ret = scene_unchanged(ctx, in);
+        if (ret < 0) {
+            av_frame_free(&in);
+            return ret;
+        }
+        if (ret) {
+            *got_frame = 1;
+            return output_frame(context, in, &ctx->last_output);
+        }
+    }
+
+    copy_from_frame_to_dnn(ctx, in, &ctx->input);
+    *got_frame = 1;
+
+    if (ctx->tile_size > 0) {
+        ret = ff_dnn_tiles_run(&ctx->tiles, ctx);
+    } else {
+        dnn_result = (ctx->dnn_module->execute_model)(ctx->model, &ctx->output, 1);
+        if (dnn_result != DNN_SUCCESS){
+            av_log(ctx, AV_LOG_ERROR, "failed to execute model\n");
+            ret = AVERROR(EIO);
+        }
+    }
+    if (ret >= 0 && ctx->scene_thresh > 0)
+        ret = save_output(ctx, &ctx->output);
+    if (ret < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
+
+    return output_frame(context, in, &ctx->output);
+}
+
+// With the timeline disabling the filter, frames are passed through unchanged
+// when the model does not change the frame size.
+static int passthrough_frame(AVFilterContext *context, AVFrame *in)
+{
+    AVFilterLink *inlink = context->inputs[0];
+    AVFilterLink *outlink = context->outputs[0];
+    int ret;
+
+    if (outlink->w != inlink->w || outlink->h != inlink->h ||
+        outlink->format != inlink->format)
+        return 0;
+
+    ret = ff_filter_frame(outlink, in);
+    return ret < 0 ? ret : 1;
+}
+
+static int activate(AVFilterContext *context)
+{
+    AVFilterLink *inlink = context->inputs[0];
+    AVFilterLink *outlink = context->outputs[0];
+    DnnProcessingContext *ctx = context->priv;
+    AVFrame *in = NULL;
+    int64_t pts;
+    int ret, status;
+    int got_frame = 0;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    do {
+        // drain all input frames
+        ret = ff_inlink_consume_frame(inlink, &in);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            if (context->is_disabled) {
+                ret = passthrough_frame(context, in);
+                if (ret < 0)
+                    return ret;
+                if (ret > 0) {
+                    got_frame = 1;
+                    continue;
+                }
+            }
+            ret = map_input_frame(ctx, &in);
+            if (ret < 0)
+                return ret;
+            ret = filter_frame(context, in, &got_frame);
+            if (ret < 0)
+                return ret;
+            ret = 1;
+        }
+    } while (ret > 0);
+
+    // if frame got, schedule to next filter
+    if (got_frame)
+        return 0;
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        ff_outlink_set_status(outlink, status, pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DnnProcessingContext *context = ctx->priv;
 
-    sws_freeContext(context->sws_gray8_to_grayf32);
+    ff_dnn_preproc_uninit(&context->preproc);
+    ff_dnn_tiles_uninit(&context->tiles);
+    av_frame_free(&context->ref_frame);
+    av_freep(&context->last_output_buf);
     sws_freeContext(context->sws_grayf32_to_gray8);
     sws_freeContext(context->sws_uv_scale);
 
@@ -496,7 +762,6 @@ static const AVFilterPad dnn_processing_inputs[] = {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
         .config_props = config_input,
-        .filter_frame = filter_frame,
     },
     { NULL }
 };
@@ -517,7 +782,10 @@ AVFilter ff_vf_dnn_processing = {
     .init          = init,
     .uninit        = uninit,
     .query_formats = query_formats,
+    .activate      = activate,
     .inputs        = dnn_processing_inputs,
     .outputs       = dnn_processing_outputs,
     .priv_class    = &dnn_processing_class,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
 };
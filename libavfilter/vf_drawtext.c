@@ -154,7 +154,12 @@ typedef struct DrawTextContext {
     AVBPrint expanded_fontcolor;    ///< used to contain the expanded fontcolor spec
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
     FT_Vector *positions;           ///< positions for each element in the text
+    struct Glyph **text_glyphs;     ///< glyph drawn for each element in the text, or NULL
     size_t nb_positions;            ///< number of elements of positions array
+    int nb_text_glyphs;             ///< number of elements in the text
+    char *layout_text;              ///< text the positions were computed for
+    unsigned int layout_fontsize;   ///< font size the positions were computed for
+    int text_w, text_h;             ///< size of the text the positions were computed for
     char *textfile;                 ///< file with text to be drawn
     int x;                          ///< x position to start drawing text
     int y;                          ///< y position to start drawing text
@@ -811,7 +816,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     s->x_pexpr = s->y_pexpr = s->a_pexpr = s->fontsize_pexpr = NULL;
 
     av_freep(&s->positions);
+    av_freep(&s->text_glyphs);
+    av_freep(&s->layout_text);
     s->nb_positions = 0;
+    s->nb_text_glyphs = 0;
 
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(s->glyphs);
@@ -1213,52 +1221,203 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw)
+static void draw_glyphs(DrawTextContext *s, uint8_t *data[4], int linesize[4],
+                        int width, int height,
+                        FFDrawColor *color,
+                        int x, int y, int borderw)
 {
-    char *text = s->expanded_text.str;
-    uint32_t code = 0;
     int i, x1, y1;
+
+    for (i = 0; i < s->nb_text_glyphs; i++) {
+        const Glyph *glyph = s->text_glyphs[i];
+        const FT_Bitmap *bitmap;
+
+        if (!glyph)
+            continue;
+
+        bitmap = borderw ? &glyph->border_bitmap : &glyph->bitmap;
+
+        x1 = s->positions[i].x+s->x+x - borderw;
+        y1 = s->positions[i].y+s->y+y - borderw;
+
+        ff_blend_mask(&s->dc, color,
+                      data, linesize, width, height,
+                      bitmap->buffer, bitmap->pitch,
+                      bitmap->width, bitmap->rows,
+                      bitmap->pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
+                      0, x1, y1);
+    }
+}
+
+typedef struct ThreadData {
+    AVFrame *frame;
+    int width, height;
+    int starty, endy;               ///< rows touched by the box and the glyphs
+    int box_w, box_h;
+    FFDrawColor *fontcolor;
+    FFDrawColor *shadowcolor;
+    FFDrawColor *bordercolor;
+    FFDrawColor *boxcolor;
+} ThreadData;
+
+/**
+ * Draw the box and the glyphs over a band of rows of the frame. The bands
+ * start on chroma lines, so blending them one by one gives the same result
+ * as blending the whole frame.
+ */
+static int draw_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    const int vstep = 1 << s->dc.vsub_max;
+    const int nb_lines = (td->endy - td->starty + vstep - 1) / vstep;
+    const int slice_start = td->starty + nb_lines *  jobnr      / nb_jobs * vstep;
+    const int slice_end   = FFMIN(td->starty + nb_lines * (jobnr + 1) / nb_jobs * vstep,
+                                  td->height);
+    const int height = slice_end - slice_start;
+    uint8_t *data[4] = { NULL };
+    int plane;
+
+    if (height <= 0)
+        return 0;
+
+    for (plane = 0; plane < s->dc.nb_planes; plane++)
+        data[plane] = frame->data[plane] +
+                      (slice_start >> s->dc.vsub[plane]) * frame->linesize[plane];
+
+    if (s->draw_box)
+        ff_blend_rectangle(&s->dc, td->boxcolor,
+                           data, frame->linesize, td->width, height,
+                           s->x - s->boxborderw, s->y - s->boxborderw - slice_start,
+                           td->box_w + s->boxborderw * 2, td->box_h + s->boxborderw * 2);
+
+    if (s->shadowx || s->shadowy)
+        draw_glyphs(s, data, frame->linesize, td->width, height,
+                    td->shadowcolor, s->shadowx, s->shadowy - slice_start, 0);
+
+    if (s->borderw)
+        draw_glyphs(s, data, frame->linesize, td->width, height,
+                    td->bordercolor, 0, -slice_start, s->borderw);
+
+    draw_glyphs(s, data, frame->linesize, td->width, height,
+                td->fontcolor, 0, -slice_start, 0);
+
+    return 0;
+}
+
+static int layout_text(AVFilterContext *ctx)
+{
+    DrawTextContext *s = ctx->priv;
+    char *text = s->expanded_text.str;
+    uint32_t code = 0, prev_code = 0;
+    int x = 0, y = 0, i = 0, ret;
+    int max_text_line_w = 0;
     uint8_t *p;
-    Glyph *glyph = NULL;
+    int y_min = 32000, y_max = -32000;
+    int x_min = 32000, x_max = -32000;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
+    Glyph dummy = { 0 };
 
+    av_freep(&s->layout_text);
+
+    /* load and cache glyphs */
     for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
         GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
 continue_on_invalid:
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
+        /* get glyph */
+        dummy.code = code;
+        dummy.fontsize = s->fontsize;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        if (!glyph) {
+            ret = load_glyph(ctx, &glyph, code);
+            if (ret < 0)
+                return ret;
+        }
+
+        y_min = FFMIN(glyph->bbox.yMin, y_min);
+        y_max = FFMAX(glyph->bbox.yMax, y_max);
+        x_min = FFMIN(glyph->bbox.xMin, x_min);
+        x_max = FFMAX(glyph->bbox.xMax, x_max);
+    }
+    s->max_glyph_h = y_max - y_min;
+    s->max_glyph_w = x_max - x_min;
+
+    /* compute and save position for each glyph */
+    glyph = NULL;
+    for (i = 0, p = text; *p; i++) {
+        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
+continue_on_invalid2:
+
+        s->text_glyphs[i] = NULL;
+
+        /* skip the \n in the sequence \r\n */
+        if (prev_code == '\r' && code == '\n')
+            continue;
+
+        prev_code = code;
+        if (is_newline(code)) {
+
+            max_text_line_w = FFMAX(max_text_line_w, x);
+            y += s->max_glyph_h + s->line_spacing;
+            x = 0;
             continue;
+        }
 
+        /* get glyph */
+        prev_glyph = glyph;
         dummy.code = code;
         dummy.fontsize = s->fontsize;
         glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
 
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+        /* kerning */
+        if (s->use_kerning && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
 
         if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
-        x1 = s->positions[i].x+s->x+x - borderw;
-        y1 = s->positions[i].y+s->y+y - borderw;
-
-        ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
-                      bitmap.buffer, bitmap.pitch,
-                      bitmap.width, bitmap.rows,
-                      bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
-                      0, x1, y1);
+        /* save position */
+        s->positions[i].x = x + glyph->bitmap_left;
+        s->positions[i].y = y - glyph->bitmap_top + y_max;
+        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
+        else              x += glyph->advance;
+        if (code != '\t')
+            s->text_glyphs[i] = glyph;
     }
+    s->nb_text_glyphs = i;
+
+    max_text_line_w = FFMAX(x, max_text_line_w);
+
+    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
+    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
+
+    s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
+    s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
+    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
+    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
+
+    s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
+
+    s->text_w = max_text_line_w;
+    s->text_h = y + s->max_glyph_h;
+
+    s->layout_fontsize = s->fontsize;
+    s->layout_text = av_strdup(text);
+    if (!s->layout_text)
+        return AVERROR(ENOMEM);
 
     return 0;
 }
 
 
+
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
     *color = incolor;
@@ -1287,17 +1446,9 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     DrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
 
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
-    int max_text_line_w = 0, len;
-    int box_w, box_h;
+    ThreadData td;
+    int i, ret, len, nb_jobs;
     char *text;
-    uint8_t *p;
-    int y_min = 32000, y_max = -32000;
-    int x_min = 32000, x_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
 
     time_t now = time(0);
     struct tm ltime;
@@ -1341,6 +1492,9 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         if (!(s->positions =
               av_realloc(s->positions, len*sizeof(*s->positions))))
             return AVERROR(ENOMEM);
+        if (!(s->text_glyphs =
+              av_realloc(s->text_glyphs, len*sizeof(*s->text_glyphs))))
+            return AVERROR(ENOMEM);
         s->nb_positions = len;
     }
 
@@ -1358,86 +1512,16 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         ff_draw_color(&s->dc, &s->fontcolor, s->fontcolor.rgba);
     }
 
-    x = 0;
-    y = 0;
-
     if ((ret = update_fontsize(ctx)) < 0)
         return ret;
 
-    /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
-continue_on_invalid:
-
-        /* get glyph */
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph) {
-            ret = load_glyph(ctx, &glyph, code);
-            if (ret < 0)
-                return ret;
-        }
-
-        y_min = FFMIN(glyph->bbox.yMin, y_min);
-        y_max = FFMAX(glyph->bbox.yMax, y_max);
-        x_min = FFMIN(glyph->bbox.xMin, x_min);
-        x_max = FFMAX(glyph->bbox.xMax, x_max);
-    }
-    s->max_glyph_h = y_max - y_min;
-    s->max_glyph_w = x_max - x_min;
-
-    /* compute and save position for each glyph */
-    glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
-continue_on_invalid2:
-
-        /* skip the \n in the sequence \r\n */
-        if (prev_code == '\r' && code == '\n')
-            continue;
-
-        prev_code = code;
-        if (is_newline(code)) {
-
-            max_text_line_w = FFMAX(max_text_line_w, x);
-            y += s->max_glyph_h + s->line_spacing;
-            x = 0;
-            continue;
-        }
-
-        /* get glyph */
-        prev_glyph = glyph;
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        /* kerning */
-        if (s->use_kerning && prev_glyph && glyph->code) {
-            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
-                           ft_kerning_default, &delta);
-            x += delta.x >> 6;
-        }
-
-        /* save position */
-        s->positions[i].x = x + glyph->bitmap_left;
-        s->positions[i].y = y - glyph->bitmap_top + y_max;
-        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
-        else              x += glyph->advance;
+    /* the layout of the text does not change as long as the text is the same */
+    if (!s->layout_text || s->layout_fontsize != s->fontsize ||
+        strcmp(s->layout_text, text)) {
+        if ((ret = layout_text(ctx)) < 0)
+            return ret;
     }
 
-    max_text_line_w = FFMAX(x, max_text_line_w);
-
-    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
-    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
-
-    s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
-    s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
-    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
-    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
-
-    s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
-
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
     s->y = s->var_values[VAR_Y] = av_expr_eval(s->y_pexpr, s->var_values, &s->prng);
     /* It is necessary if x is expressed from y  */
@@ -1449,8 +1533,8 @@ continue_on_invalid2:
     update_color_with_alpha(s, &bordercolor, s->bordercolor);
     update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
 
-    box_w = max_text_line_w;
-    box_h = y + s->max_glyph_h;
+    td.box_w = s->text_w;
+    td.box_h = s->text_h;
 
     if (s->fix_bounds) {
 
@@ -1472,33 +1556,54 @@ continue_on_invalid2:
         if (s->x - offsetleft < 0) s->x = offsetleft;
         if (s->y - offsettop < 0)  s->y = offsettop;
 
-        if (s->x + box_w + offsetright > width)
-            s->x = FFMAX(width - box_w - offsetright, 0);
-        if (s->y + box_h + offsetbottom > height)
-            s->y = FFMAX(height - box_h - offsetbottom, 0);
+        if (s->x + td.box_w + offsetright > width)
+            s->x = FFMAX(width - td.box_w - offsetright, 0);
+        if (s->y + td.box_h + offsetbottom > height)
+            s->y = FFMAX(height - td.box_h - offsetbottom, 0);
     }
 
-    /* draw box */
-    if (s->draw_box)
-        ff_blend_rectangle(&s->dc, &boxcolor,
-                           frame->data, frame->linesize, width, height,
-                           s->x - s->boxborderw, s->y - s->boxborderw,
-                           box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
-
-    if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
+    /* rows touched by the box and the glyphs */
+    td.starty = INT_MAX;
+    td.endy   = INT_MIN;
+    if (s->draw_box) {
+        td.starty = s->y - s->boxborderw;
+        td.endy   = s->y + td.box_h + s->boxborderw;
     }
+    for (i = 0; i < s->nb_text_glyphs; i++) {
+        const Glyph *glyph = s->text_glyphs[i];
+        int y, rows;
 
-    if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
+        if (!glyph)
+            continue;
+        y    = s->positions[i].y + s->y;
+        rows = glyph->bitmap.rows;
+        td.starty = FFMIN(td.starty, y);
+        td.endy   = FFMAX(td.endy, y + rows);
+        if (s->shadowx || s->shadowy) {
+            td.starty = FFMIN(td.starty, y + s->shadowy);
+            td.endy   = FFMAX(td.endy, y + s->shadowy + rows);
+        }
+        if (s->borderw) {
+            rows = glyph->border_bitmap.rows;
+            td.starty = FFMIN(td.starty, y - s->borderw);
+            td.endy   = FFMAX(td.endy, y - s->borderw + rows);
+        }
     }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    td.starty = FFMAX(td.starty, 0) & ~((1 << s->dc.vsub_max) - 1);
+    td.endy   = FFMIN(td.endy, height);
+    if (td.starty >= td.endy)
+        return 0;
+
+    td.frame       = frame;
+    td.width       = width;
+    td.height      = height;
+    td.fontcolor   = &fontcolor;
+    td.shadowcolor = &shadowcolor;
+    td.bordercolor = &bordercolor;
+    td.boxcolor    = &boxcolor;
+    nb_jobs = FFMIN(ff_filter_get_nb_threads(ctx),
+                    (td.endy - td.starty + (1 << s->dc.vsub_max) - 1) >> s->dc.vsub_max);
+    ctx->internal->execute(ctx, draw_slice, &td, NULL, nb_jobs);
 
     return 0;
 }
@@ -1574,5 +1679,5 @@ AVFilter ff_vf_drawtext = {
     .inputs        = avfilter_vf_drawtext_inputs,
     .outputs       = avfilter_vf_drawtext_outputs,
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
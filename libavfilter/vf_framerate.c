@@ -62,6 +62,28 @@ static const AVOption framerate_options[] = {
 
 AVFILTER_DEFINE_CLASS(framerate);
 
+typedef struct SADThreadData {
+    AVFrame *crnt, *next;
+} SADThreadData;
+
+static int sad_slice(AVFilterContext *ctx, void *arg, int job, int nb_jobs)
+{
+    FrameRateContext *s = ctx->priv;
+    SADThreadData *td = arg;
+    const int start = (td->crnt->height *  job   ) / nb_jobs;
+    const int end   = (td->crnt->height * (job+1)) / nb_jobs;
+    const ptrdiff_t linesize1 = td->crnt->linesize[0];
+    const ptrdiff_t linesize2 = td->next->linesize[0];
+
+    s->job_sad[job] = 0;
+    if (start < end)
+        s->sad(td->crnt->data[0] + start * linesize1, linesize1,
+               td->next->data[0] + start * linesize2, linesize2,
+               td->crnt->width, end - start, &s->job_sad[job]);
+    emms_c();
+    return 0;
+}
+
 static double get_scene_score(AVFilterContext *ctx, AVFrame *crnt, AVFrame *next)
 {
     FrameRateContext *s = ctx->priv;
@@ -69,14 +91,24 @@ static double get_scene_score(AVFilterContext *ctx, AVFrame *crnt, AVFrame *next
 
     ff_dlog(ctx, "get_scene_score()\n");
 
+    // reuse the score of an upstream select or scdet, on the scale of scdet
+    if (ff_scene_score_from_metadata(next, &ret)) {
+        ret = ret * 100. * 100. / 256;
+        ff_dlog(ctx, "get_scene_score() result from metadata is:%f\n", ret);
+        return ret;
+    }
+
     if (crnt->height == next->height &&
         crnt->width  == next->width) {
-        uint64_t sad;
+        SADThreadData td = { .crnt = crnt, .next = next };
+        uint64_t sad = 0;
         double mafd, diff;
+        int i;
 
         ff_dlog(ctx, "get_scene_score() process\n");
-        s->sad(crnt->data[0], crnt->linesize[0], next->data[0], next->linesize[0], crnt->width, crnt->height, &sad);
-        emms_c();
+        ctx->internal->execute(ctx, sad_slice, &td, NULL, s->nb_sad_jobs);
+        for (i = 0; i < s->nb_sad_jobs; i++)
+            sad += s->job_sad[i];
         mafd = (double)sad * 100.0 / (crnt->width * crnt->height) / (1 << s->bitdepth);
         diff = fabs(mafd - s->prev_mafd);
         ret  = av_clipf(FFMIN(mafd, diff), 0, 100.0);
@@ -212,6 +244,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     FrameRateContext *s = ctx->priv;
     av_frame_free(&s->f0);
     av_frame_free(&s->f1);
+    av_freep(&s->job_sad);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -292,6 +325,12 @@ static int config_input(AVFilterLink *inlink)
     if (!s->sad)
         return AVERROR(EINVAL);
 
+    s->nb_sad_jobs = FFMAX(1, FFMIN(inlink->h >> 4, ff_filter_get_nb_threads(ctx)));
+    av_freep(&s->job_sad);
+    s->job_sad = av_calloc(s->nb_sad_jobs, sizeof(*s->job_sad));
+    if (!s->job_sad)
+        return AVERROR(ENOMEM);
+
     s->srce_time_base = inlink->time_base;
 
     ff_framerate_init(s);
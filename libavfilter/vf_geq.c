@@ -377,9 +377,12 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
     const int linesize = td->linesize;
     const int slice_start = (height *  jobnr) / nb_jobs;
     const int slice_end = (height * (jobnr+1)) / nb_jobs;
+    const double *var_values[VAR_VARS_NB] = { NULL };
+    double *xs, *row;
     int x, y;
 
     double values[VAR_VARS_NB];
+    values[VAR_X] = 0;
     values[VAR_W] = geq->values[VAR_W];
     values[VAR_H] = geq->values[VAR_H];
     values[VAR_N] = geq->values[VAR_N];
@@ -387,29 +390,40 @@ static int slice_geq_filter(AVFilterContext *ctx, void *arg, int jobnr, int nb_j
     values[VAR_SH] = geq->values[VAR_SH];
     values[VAR_T] = geq->values[VAR_T];
 
+    xs  = av_malloc_array(width, sizeof(*xs));
+    row = av_malloc_array(width, sizeof(*row));
+    if (!xs || !row) {
+        av_free(xs);
+        av_free(row);
+        return AVERROR(ENOMEM);
+    }
+    for (x = 0; x < width; x++)
+        xs[x] = x;
+    var_values[VAR_X] = xs;
+
     if (geq->bps == 8) {
         uint8_t *ptr = geq->dst + linesize * slice_start;
         for (y = slice_start; y < slice_end; y++) {
             values[VAR_Y] = y;
+            av_expr_eval_batch(geq->e[plane][jobnr], values, var_values, row, width, geq);
 
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr[x] = av_expr_eval(geq->e[plane][jobnr], values, geq);
-            }
+            for (x = 0; x < width; x++)
+                ptr[x] = row[x];
             ptr += linesize;
         }
     } else {
         uint16_t *ptr16 = geq->dst16 + (linesize/2) * slice_start;
         for (y = slice_start; y < slice_end; y++) {
             values[VAR_Y] = y;
-            for (x = 0; x < width; x++) {
-                values[VAR_X] = x;
-                ptr16[x] = av_expr_eval(geq->e[plane][jobnr], values, geq);
-            }
+            av_expr_eval_batch(geq->e[plane][jobnr], values, var_values, row, width, geq);
+            for (x = 0; x < width; x++)
+                ptr16[x] = row[x];
             ptr16 += linesize/2;
         }
     }
 
+    av_free(xs);
+    av_free(row);
     return 0;
 }
 
@@ -38,6 +38,7 @@
 #include "formats.h"
 #include "framesync.h"
 #include "internal.h"
+#include "lut3d.h"
 #include "video.h"
 
 #define R 0
@@ -45,17 +46,6 @@
 #define B 2
 #define A 3
 
-enum interp_mode {
-    INTERPOLATE_NEAREST,
-    INTERPOLATE_TRILINEAR,
-    INTERPOLATE_TETRAHEDRAL,
-    NB_INTERP_MODE
-};
-
-struct rgbvec {
-    float r, g, b;
-};
-
 /* 3D LUT don't often go up to level 32, but it is common to have a Hald CLUT
  * of 512x512 (64x64x64) */
 #define MAX_LEVEL 256
@@ -76,6 +66,7 @@ typedef struct LUT3DContext {
     uint8_t rgba_map[4];
     int step;
     avfilter_action_func *interp;
+    LUT3DDSPContext dsp;
     struct rgbvec scale;
     struct rgbvec *lut;
     int lutsize;
@@ -144,37 +135,36 @@ static inline struct rgbvec lerp(const struct rgbvec *v0, const struct rgbvec *v
 
 #define NEAR(x) ((int)((x) + .5))
 #define PREV(x) ((int)(x))
-#define NEXT(x) (FFMIN((int)(x) + 1, lut3d->lutsize - 1))
+#define NEXT(x) (FFMIN((int)(x) + 1, lutsize - 1))
 
 /**
  * Get the nearest defined point
  */
-static inline struct rgbvec interp_nearest(const LUT3DContext *lut3d,
+static inline struct rgbvec interp_nearest(const struct rgbvec *lut, int lutsize,
                                            const struct rgbvec *s)
 {
-    return lut3d->lut[NEAR(s->r) * lut3d->lutsize2 + NEAR(s->g) * lut3d->lutsize + NEAR(s->b)];
+    return lut[NEAR(s->r) * lutsize * lutsize + NEAR(s->g) * lutsize + NEAR(s->b)];
 }
 
 /**
  * Interpolate using the 8 vertices of a cube
  * @see https://en.wikipedia.org/wiki/Trilinear_interpolation
  */
-static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
+static inline struct rgbvec interp_trilinear(const struct rgbvec *lut, int lutsize,
                                              const struct rgbvec *s)
 {
-    const int lutsize2 = lut3d->lutsize2;
-    const int lutsize  = lut3d->lutsize;
+    const int lutsize2 = lutsize * lutsize;
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-    const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-    const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
-    const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
-    const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c000 = lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+    const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+    const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+    const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+    const struct rgbvec c111 = lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
     const struct rgbvec c00  = lerp(&c000, &c100, d.r);
     const struct rgbvec c10  = lerp(&c010, &c110, d.r);
     const struct rgbvec c01  = lerp(&c001, &c101, d.r);
@@ -189,53 +179,52 @@ static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
  * Tetrahedral interpolation. Based on code found in Truelight Software Library paper.
  * @see http://www.filmlight.ltd.uk/pdf/whitepapers/FL-TL-TN-0057-SoftwareLib.pdf
  */
-static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
+static inline struct rgbvec interp_tetrahedral(const struct rgbvec *lut, int lutsize,
                                                const struct rgbvec *s)
 {
-    const int lutsize2 = lut3d->lutsize2;
-    const int lutsize  = lut3d->lutsize;
+    const int lutsize2 = lutsize * lutsize;
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c000 = lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c111 = lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
     struct rgbvec c;
     if (d.r > d.g) {
         if (d.g > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+            const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.g) * c100.r + (d.g-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.g) * c100.g + (d.g-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.g) * c100.b + (d.g-d.b) * c110.b + (d.b) * c111.b;
         } else if (d.r > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+            const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.b) * c100.r + (d.b-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.b) * c100.g + (d.b-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.b) * c100.b + (d.b-d.g) * c101.b + (d.g) * c111.b;
         } else {
-            const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.r) * c001.r + (d.r-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.r) * c001.g + (d.r-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.r) * c001.b + (d.r-d.g) * c101.b + (d.g) * c111.b;
         }
     } else {
         if (d.b > d.g) {
-            const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+            const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.g) * c001.r + (d.g-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.g) * c001.g + (d.g-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.g) * c001.b + (d.g-d.r) * c011.b + (d.r) * c111.b;
         } else if (d.b > d.r) {
-            const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+            const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.b) * c010.r + (d.b-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.b) * c010.g + (d.b-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.b) * c010.b + (d.b-d.r) * c011.b + (d.r) * c111.b;
         } else {
-            const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.r) * c010.r + (d.r-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.r) * c010.g + (d.r-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.r) * c010.b + (d.r-d.b) * c110.b + (d.b) * c111.b;
@@ -272,10 +261,50 @@ static inline struct rgbvec apply_prelut(const Lut3DPreLut *prelut,
     return c;
 }
 
-#define DEFINE_INTERP_FUNC_PLANAR(name, nbits, depth)                                                  \
-static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) \
+#define DEFINE_INTERP_ROW(name)                                                 \
+static void interp_row_##name(float *r, float *g, float *b,                     \
+                              const struct rgbvec *lut, int lutsize, int w)     \
+{                                                                               \
+    int x;                                                                      \
+                                                                                \
+    for (x = 0; x < w; x++) {                                                   \
+        const struct rgbvec s = {r[x], g[x], b[x]};                             \
+        const struct rgbvec c = interp_##name(lut, lutsize, &s);                \
+        r[x] = c.r;                                                             \
+        g[x] = c.g;                                                             \
+        b[x] = c.b;                                                             \
+    }                                                                           \
+}
+
+DEFINE_INTERP_ROW(nearest)
+DEFINE_INTERP_ROW(trilinear)
+DEFINE_INTERP_ROW(tetrahedral)
+
+/* the pixels are interpolated by blocks of this size */
+#define BLOCK_SIZE 256
+
+static void interp_block(const LUT3DContext *lut3d, float *r, float *g, float *b, int n)
+{
+    int x;
+
+    for (x = n; x < FFALIGN(n, LUT3D_PADDING); x++)
+        r[x] = g[x] = b[x] = 0.0f;
+    lut3d->dsp.interp(r, g, b, lut3d->lut, lut3d->lutsize, n);
+}
+
+/* set the coordinates in the lut of the pixel x of the block */
+#define SET_COORDS(x, sr, sg, sb) do {                                          \
+    const struct rgbvec rgb = {sr, sg, sb};                                     \
+    const struct rgbvec prelut_rgb = apply_prelut(prelut, &rgb);                \
+    cr[x] = av_clipf(prelut_rgb.r * scale_r, 0, lut_max);                       \
+    cg[x] = av_clipf(prelut_rgb.g * scale_g, 0, lut_max);                       \
+    cb[x] = av_clipf(prelut_rgb.b * scale_b, 0, lut_max);                       \
+} while (0)
+
+#define DEFINE_INTERP_FUNC_PLANAR(nbits, depth)                                                        \
+static int interp_##nbits##_p##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)          \
 {                                                                                                      \
-    int x, y;                                                                                          \
+    int x, x0, y;                                                                                      \
     const LUT3DContext *lut3d = ctx->priv;                                                             \
     const Lut3DPreLut *prelut = &lut3d->prelut;                                                        \
     const ThreadData *td = arg;                                                                        \
@@ -297,6 +326,9 @@ static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, i
     const float scale_r = lut3d->scale.r * lut_max;                                                    \
     const float scale_g = lut3d->scale.g * lut_max;                                                    \
     const float scale_b = lut3d->scale.b * lut_max;                                                    \
+    LOCAL_ALIGNED_32(float, cr, [BLOCK_SIZE]);                                                         \
+    LOCAL_ALIGNED_32(float, cg, [BLOCK_SIZE]);                                                         \
+    LOCAL_ALIGNED_32(float, cb, [BLOCK_SIZE]);                                                         \
                                                                                                        \
     for (y = slice_start; y < slice_end; y++) {                                                        \
         uint##nbits##_t *dstg = (uint##nbits##_t *)grow;                                               \
@@ -307,20 +339,20 @@ static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, i
         const uint##nbits##_t *srcb = (const uint##nbits##_t *)srcbrow;                                \
         const uint##nbits##_t *srcr = (const uint##nbits##_t *)srcrrow;                                \
         const uint##nbits##_t *srca = (const uint##nbits##_t *)srcarow;                                \
-        for (x = 0; x < in->width; x++) {                                                              \
-            const struct rgbvec rgb = {srcr[x] * scale_f,                                              \
-                                       srcg[x] * scale_f,                                              \
-                                       srcb[x] * scale_f};                                             \
-            const struct rgbvec prelut_rgb = apply_prelut(prelut, &rgb);                               \
-            const struct rgbvec scaled_rgb = {av_clipf(prelut_rgb.r * scale_r, 0, lut_max),            \
-                                              av_clipf(prelut_rgb.g * scale_g, 0, lut_max),            \
-                                              av_clipf(prelut_rgb.b * scale_b, 0, lut_max)};           \
-            struct rgbvec vec = interp_##name(lut3d, &scaled_rgb);                                     \
-            dstr[x] = av_clip_uintp2(vec.r * (float)((1<<depth) - 1), depth);                          \
-            dstg[x] = av_clip_uintp2(vec.g * (float)((1<<depth) - 1), depth);                          \
-            dstb[x] = av_clip_uintp2(vec.b * (float)((1<<depth) - 1), depth);                          \
-            if (!direct && in->linesize[3])                                                            \
-                dsta[x] = srca[x];                                                                     \
+        for (x0 = 0; x0 < in->width; x0 += BLOCK_SIZE) {                                               \
+            const int n = FFMIN(in->width - x0, BLOCK_SIZE);                                           \
+            for (x = 0; x < n; x++)                                                                    \
+                SET_COORDS(x, srcr[x0 + x] * scale_f,                                                  \
+                              srcg[x0 + x] * scale_f,                                                  \
+                              srcb[x0 + x] * scale_f);                                                 \
+            interp_block(lut3d, cr, cg, cb, n);                                                        \
+            for (x = 0; x < n; x++) {                                                                  \
+                dstr[x0 + x] = av_clip_uintp2(cr[x] * (float)((1<<depth) - 1), depth);                 \
+                dstg[x0 + x] = av_clip_uintp2(cg[x] * (float)((1<<depth) - 1), depth);                 \
+                dstb[x0 + x] = av_clip_uintp2(cb[x] * (float)((1<<depth) - 1), depth);                 \
+                if (!direct && in->linesize[3])                                                        \
+                    dsta[x0 + x] = srca[x0 + x];                                                       \
+            }                                                                                          \
         }                                                                                              \
         grow += out->linesize[0];                                                                      \
         brow += out->linesize[1];                                                                      \
@@ -334,34 +366,17 @@ static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, i
     return 0;                                                                                          \
 }
 
-DEFINE_INTERP_FUNC_PLANAR(nearest,     8, 8)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   8, 8)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 8, 8)
-
-DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 9)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 9)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 9)
+DEFINE_INTERP_FUNC_PLANAR(8,  8)
+DEFINE_INTERP_FUNC_PLANAR(16, 9)
+DEFINE_INTERP_FUNC_PLANAR(16, 10)
+DEFINE_INTERP_FUNC_PLANAR(16, 12)
+DEFINE_INTERP_FUNC_PLANAR(16, 14)
+DEFINE_INTERP_FUNC_PLANAR(16, 16)
 
-DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 10)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 10)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 10)
-
-DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 12)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 12)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 12)
-
-DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 14)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 14)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 14)
-
-DEFINE_INTERP_FUNC_PLANAR(nearest,     16, 16)
-DEFINE_INTERP_FUNC_PLANAR(trilinear,   16, 16)
-DEFINE_INTERP_FUNC_PLANAR(tetrahedral, 16, 16)
-
-#define DEFINE_INTERP_FUNC_PLANAR_FLOAT(name, depth)                                                   \
-static int interp_##name##_pf##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)          \
+#define DEFINE_INTERP_FUNC_PLANAR_FLOAT(depth)                                                         \
+static int interp_pf##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)                   \
 {                                                                                                      \
-    int x, y;                                                                                          \
+    int x, x0, y;                                                                                      \
     const LUT3DContext *lut3d = ctx->priv;                                                             \
     const Lut3DPreLut *prelut = &lut3d->prelut;                                                        \
     const ThreadData *td = arg;                                                                        \
@@ -382,6 +397,9 @@ static int interp_##name##_pf##depth(AVFilterContext *ctx, void *arg, int jobnr,
     const float scale_r = lut3d->scale.r * lut_max;                                                    \
     const float scale_g = lut3d->scale.g * lut_max;                                                    \
     const float scale_b = lut3d->scale.b * lut_max;                                                    \
+    LOCAL_ALIGNED_32(float, cr, [BLOCK_SIZE]);                                                         \
+    LOCAL_ALIGNED_32(float, cg, [BLOCK_SIZE]);                                                         \
+    LOCAL_ALIGNED_32(float, cb, [BLOCK_SIZE]);                                                         \
                                                                                                        \
     for (y = slice_start; y < slice_end; y++) {                                                        \
         float *dstg = (float *)grow;                                                                   \
@@ -392,20 +410,20 @@ static int interp_##name##_pf##depth(AVFilterContext *ctx, void *arg, int jobnr,
         const float *srcb = (const float *)srcbrow;                                                    \
         const float *srcr = (const float *)srcrrow;                                                    \
         const float *srca = (const float *)srcarow;                                                    \
-        for (x = 0; x < in->width; x++) {                                                              \
-            const struct rgbvec rgb = {sanitizef(srcr[x]),                                             \
-                                       sanitizef(srcg[x]),                                             \
-                                       sanitizef(srcb[x])};                                            \
-            const struct rgbvec prelut_rgb = apply_prelut(prelut, &rgb);                               \
-            const struct rgbvec scaled_rgb = {av_clipf(prelut_rgb.r * scale_r, 0, lut_max),            \
-                                              av_clipf(prelut_rgb.g * scale_g, 0, lut_max),            \
-                                              av_clipf(prelut_rgb.b * scale_b, 0, lut_max)};           \
-            struct rgbvec vec = interp_##name(lut3d, &scaled_rgb);                                     \
-            dstr[x] = vec.r;                                                                           \
-            dstg[x] = vec.g;                                                                           \
-            dstb[x] = vec.b;                                                                           \
-            if (!direct && in->linesize[3])                                                            \
-                dsta[x] = srca[x];                                                                     \
+        for (x0 = 0; x0 < in->width; x0 += BLOCK_SIZE) {                                               \
+            const int n = FFMIN(in->width - x0, BLOCK_SIZE);                                           \
+            for (x = 0; x < n; x++)                                                                    \
+                SET_COORDS(x, sanitizef(srcr[x0 + x]),                                                 \
+                              sanitizef(srcg[x0 + x]),                                                 \
+                              sanitizef(srcb[x0 + x]));                                                \
+            interp_block(lut3d, cr, cg, cb, n);                                                        \
+            for (x = 0; x < n; x++) {                                                                  \
+                dstr[x0 + x] = cr[x];                                                                  \
+                dstg[x0 + x] = cg[x];                                                                  \
+                dstb[x0 + x] = cb[x];                                                                  \
+                if (!direct && in->linesize[3])                                                        \
+                    dsta[x0 + x] = srca[x0 + x];                                                       \
+            }                                                                                          \
         }                                                                                              \
         grow += out->linesize[0];                                                                      \
         brow += out->linesize[1];                                                                      \
@@ -419,14 +437,12 @@ static int interp_##name##_pf##depth(AVFilterContext *ctx, void *arg, int jobnr,
     return 0;                                                                                          \
 }
 
-DEFINE_INTERP_FUNC_PLANAR_FLOAT(nearest,     32)
-DEFINE_INTERP_FUNC_PLANAR_FLOAT(trilinear,   32)
-DEFINE_INTERP_FUNC_PLANAR_FLOAT(tetrahedral, 32)
+DEFINE_INTERP_FUNC_PLANAR_FLOAT(32)
 
-#define DEFINE_INTERP_FUNC(name, nbits)                                                             \
-static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)         \
+#define DEFINE_INTERP_FUNC(nbits)                                                                   \
+static int interp_##nbits(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)                  \
 {                                                                                                   \
-    int x, y;                                                                                       \
+    int x, x0, y;                                                                                   \
     const LUT3DContext *lut3d = ctx->priv;                                                          \
     const Lut3DPreLut *prelut = &lut3d->prelut;                                                     \
     const ThreadData *td = arg;                                                                     \
@@ -447,24 +463,27 @@ static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, i
     const float scale_r = lut3d->scale.r * lut_max;                                                 \
     const float scale_g = lut3d->scale.g * lut_max;                                                 \
     const float scale_b = lut3d->scale.b * lut_max;                                                 \
+    LOCAL_ALIGNED_32(float, cr, [BLOCK_SIZE]);                                                      \
+    LOCAL_ALIGNED_32(float, cg, [BLOCK_SIZE]);                                                      \
+    LOCAL_ALIGNED_32(float, cb, [BLOCK_SIZE]);                                                      \
                                                                                                     \
     for (y = slice_start; y < slice_end; y++) {                                                     \
-        uint##nbits##_t *dst = (uint##nbits##_t *)dstrow;                                           \
-        const uint##nbits##_t *src = (const uint##nbits##_t *)srcrow;                               \
-        for (x = 0; x < in->width * step; x += step) {                                              \
-            const struct rgbvec rgb = {src[x + r] * scale_f,                                        \
-                                       src[x + g] * scale_f,                                        \
-                                       src[x + b] * scale_f};                                       \
-            const struct rgbvec prelut_rgb = apply_prelut(prelut, &rgb);                            \
-            const struct rgbvec scaled_rgb = {av_clipf(prelut_rgb.r * scale_r, 0, lut_max),         \
-                                              av_clipf(prelut_rgb.g * scale_g, 0, lut_max),         \
-                                              av_clipf(prelut_rgb.b * scale_b, 0, lut_max)};        \
-            struct rgbvec vec = interp_##name(lut3d, &scaled_rgb);                                  \
-            dst[x + r] = av_clip_uint##nbits(vec.r * (float)((1<<nbits) - 1));                      \
-            dst[x + g] = av_clip_uint##nbits(vec.g * (float)((1<<nbits) - 1));                      \
-            dst[x + b] = av_clip_uint##nbits(vec.b * (float)((1<<nbits) - 1));                      \
-            if (!direct && step == 4)                                                               \
-                dst[x + a] = src[x + a];                                                            \
+        for (x0 = 0; x0 < in->width; x0 += BLOCK_SIZE) {                                            \
+            const int n = FFMIN(in->width - x0, BLOCK_SIZE);                                        \
+            uint##nbits##_t *dst = (uint##nbits##_t *)dstrow + x0 * step;                           \
+            const uint##nbits##_t *src = (const uint##nbits##_t *)srcrow + x0 * step;               \
+            for (x = 0; x < n; x++)                                                                 \
+                SET_COORDS(x, src[x * step + r] * scale_f,                                          \
+                              src[x * step + g] * scale_f,                                          \
+                              src[x * step + b] * scale_f);                                         \
+            interp_block(lut3d, cr, cg, cb, n);                                                     \
+            for (x = 0; x < n; x++) {                                                               \
+                dst[x * step + r] = av_clip_uint##nbits(cr[x] * (float)((1<<nbits) - 1));           \
+                dst[x * step + g] = av_clip_uint##nbits(cg[x] * (float)((1<<nbits) - 1));           \
+                dst[x * step + b] = av_clip_uint##nbits(cb[x] * (float)((1<<nbits) - 1));           \
+                if (!direct && step == 4)                                                           \
+                    dst[x * step + a] = src[x * step + a];                                          \
+            }                                                                                       \
         }                                                                                           \
         dstrow += out->linesize[0];                                                                 \
         srcrow += in ->linesize[0];                                                                 \
@@ -472,13 +491,19 @@ static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, i
     return 0;                                                                                       \
 }
 
-DEFINE_INTERP_FUNC(nearest,     8)
-DEFINE_INTERP_FUNC(trilinear,   8)
-DEFINE_INTERP_FUNC(tetrahedral, 8)
+DEFINE_INTERP_FUNC(8)
+DEFINE_INTERP_FUNC(16)
 
-DEFINE_INTERP_FUNC(nearest,     16)
-DEFINE_INTERP_FUNC(trilinear,   16)
-DEFINE_INTERP_FUNC(tetrahedral, 16)
+void ff_lut3d_init(LUT3DDSPContext *dsp, int interpolation)
+{
+    switch (interpolation) {
+    case INTERPOLATE_NEAREST:     dsp->interp = interp_row_nearest;     break;
+    case INTERPOLATE_TRILINEAR:   dsp->interp = interp_row_trilinear;   break;
+    case INTERPOLATE_TETRAHEDRAL: dsp->interp = interp_row_tetrahedral; break;
+    default:
+        av_assert0(0);
+    }
+}
 
 #define MAX_LINE_SIZE 512
 
@@ -1069,28 +1094,20 @@ static int config_input(AVFilterLink *inlink)
     ff_fill_rgba_map(lut3d->rgba_map, inlink->format);
     lut3d->step = av_get_padded_bits_per_pixel(desc) >> (3 + is16bit);
 
-#define SET_FUNC(name) do {                                     \
-    if (planar && !isfloat) {                                   \
-        switch (depth) {                                        \
-        case  8: lut3d->interp = interp_8_##name##_p8;   break; \
-        case  9: lut3d->interp = interp_16_##name##_p9;  break; \
-        case 10: lut3d->interp = interp_16_##name##_p10; break; \
-        case 12: lut3d->interp = interp_16_##name##_p12; break; \
-        case 14: lut3d->interp = interp_16_##name##_p14; break; \
-        case 16: lut3d->interp = interp_16_##name##_p16; break; \
-        }                                                       \
-    } else if (isfloat) { lut3d->interp = interp_##name##_pf32; \
-    } else if (is16bit) { lut3d->interp = interp_16_##name;     \
-    } else {       lut3d->interp = interp_8_##name; }           \
-} while (0)
+    if (planar && !isfloat) {
+        switch (depth) {
+        case  8: lut3d->interp = interp_8_p8;   break;
+        case  9: lut3d->interp = interp_16_p9;  break;
+        case 10: lut3d->interp = interp_16_p10; break;
+        case 12: lut3d->interp = interp_16_p12; break;
+        case 14: lut3d->interp = interp_16_p14; break;
+        case 16: lut3d->interp = interp_16_p16; break;
+        }
+    } else if (isfloat) { lut3d->interp = interp_pf32;
+    } else if (is16bit) { lut3d->interp = interp_16;
+    } else {              lut3d->interp = interp_8; }
 
-    switch (lut3d->interpolation) {
-    case INTERPOLATE_NEAREST:     SET_FUNC(nearest);        break;
-    case INTERPOLATE_TRILINEAR:   SET_FUNC(trilinear);      break;
-    case INTERPOLATE_TETRAHEDRAL: SET_FUNC(tetrahedral);    break;
-    default:
-        av_assert0(0);
-    }
+    ff_lut3d_init(&lut3d->dsp, lut3d->interpolation);
 
     return 0;
 }
@@ -47,4 +47,5 @@ AVFilter ff_vf_null = {
     .description = NULL_IF_CONFIG_SMALL("Pass the source unchanged to the output."),
     .inputs      = avfilter_vf_null_inputs,
     .outputs     = avfilter_vf_null_outputs,
+    .flags_internal = FF_FILTER_FLAG_RECONFIGURABLE,
 };
@@ -0,0 +1,568 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Calculate the PSNR, SSIM and VMAF motion of two input videos in one pass.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "drawutils.h"
+#include "formats.h"
+#include "framesync.h"
+#include "internal.h"
+#include "psnr.h"
+#include "ssim.h"
+#include "vmaf_motion.h"
+#include "video.h"
+
+#define METRIC_PSNR       (1 << 0)
+#define METRIC_SSIM       (1 << 1)
+#define METRIC_VMAFMOTION (1 << 2)
+
+#define SUM_LEN(w) (((w) >> 2) + 3)
+
+typedef struct QualityContext {
+    const AVClass *class;
+    FFFrameSync fs;
+    int metrics;
+    FILE *stats_file;
+    char *stats_file_str;
+    uint64_t nb_frames;
+    int nb_jobs;
+
+    int nb_components;
+    int depth;
+    int is_rgb;
+    uint8_t rgba_map[4];
+    char comps[4];
+    int planewidth[4];
+    int planeheight[4];
+    double planeweight[4];
+
+    PSNRDSPContext psnr_dsp;
+    int max[4], average_max;
+    double mse, min_mse, max_mse, mse_comp[4];
+    uint64_t (*sse)[4];             ///< sum of squared errors of each job
+
+    SSIMDSPContext ssim_dsp;
+    uint8_t *ssim_temp;             ///< sums of the 4x4 blocks of each job
+    size_t ssim_temp_size;
+    double *ssim_lines[4];          ///< score of each line of 4x4 blocks
+    double ssim[4], ssim_total;
+
+    VMAFMotionData vmaf;
+    uint64_t *vmaf_sad;             ///< SAD of each job
+} QualityContext;
+
+typedef struct ThreadData {
+    AVFrame *main, *ref;
+} ThreadData;
+
+#define OFFSET(x) offsetof(QualityContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
+
+static const AVOption quality_options[] = {
+    { "metrics", "set the metrics to compute", OFFSET(metrics), AV_OPT_TYPE_FLAGS, {.i64=METRIC_PSNR|METRIC_SSIM|METRIC_VMAFMOTION}, 0, INT_MAX, FLAGS, "metrics" },
+        { "psnr",       NULL, 0, AV_OPT_TYPE_CONST, {.i64=METRIC_PSNR},       0, 0, FLAGS, "metrics" },
+        { "ssim",       NULL, 0, AV_OPT_TYPE_CONST, {.i64=METRIC_SSIM},       0, 0, FLAGS, "metrics" },
+        { "vmafmotion", NULL, 0, AV_OPT_TYPE_CONST, {.i64=METRIC_VMAFMOTION}, 0, 0, FLAGS, "metrics" },
+    { "stats_file", "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "f",          "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { NULL }
+};
+
+FRAMESYNC_DEFINE_CLASS(quality, QualityContext, fs);
+
+static inline double get_psnr(double mse, uint64_t nb_frames, int max)
+{
+    return 10.0 * log10((unsigned)(max * max) / (mse / nb_frames));
+}
+
+static double ssim_db(double ssim, double weight)
+{
+    return (fabs(weight - ssim) > 1e-9) ? 10.0 * log10(weight / (weight - ssim)) : INFINITY;
+}
+
+static void set_meta(AVDictionary **metadata, const char *key, char comp, float d)
+{
+    char value[128];
+    snprintf(value, sizeof(value), "%0.2f", d);
+    if (comp) {
+        char key2[128];
+        snprintf(key2, sizeof(key2), "%s%c", key, comp);
+        av_dict_set(metadata, key2, value, 0);
+    } else {
+        av_dict_set(metadata, key, value, 0);
+    }
+}
+
+static void psnr_slice(QualityContext *s, const AVFrame *main, const AVFrame *ref,
+                       int jobnr, int nb_jobs)
+{
+    int c, y;
+
+    for (c = 0; c < s->nb_components; c++) {
+        const int w = s->planewidth[c];
+        const int h = s->planeheight[c];
+        const int slice_start = (h *  jobnr     ) / nb_jobs;
+        const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+        const uint8_t *main_line = main->data[c] + slice_start * main->linesize[c];
+        const uint8_t *ref_line  = ref->data[c]  + slice_start * ref->linesize[c];
+        uint64_t m = 0;
+
+        for (y = slice_start; y < slice_end; y++) {
+            m += s->psnr_dsp.sse_line(main_line, ref_line, w);
+            main_line += main->linesize[c];
+            ref_line  += ref->linesize[c];
+        }
+        s->sse[jobnr][c] = m;
+    }
+}
+
+static void ssim_slice(QualityContext *s, const AVFrame *main, const AVFrame *ref,
+                       int jobnr, int nb_jobs)
+{
+    const size_t sum_size = s->depth > 8 ? sizeof(int64_t[4]) : sizeof(int[4]);
+    int c, y;
+
+    for (c = 0; c < s->nb_components; c++) {
+        const int w = s->planewidth[c] >> 2;
+        const int h = s->planeheight[c] >> 2;
+        /* the score of the line y uses the block lines y - 1 and y */
+        const int slice_start = 1 + ((h - 1) *  jobnr     ) / nb_jobs;
+        const int slice_end   = 1 + ((h - 1) * (jobnr + 1)) / nb_jobs;
+        const int main_stride = main->linesize[c];
+        const int ref_stride  = ref->linesize[c];
+        void *sum0 = s->ssim_temp + jobnr * s->ssim_temp_size;
+        void *sum1 = (uint8_t *)sum0 + SUM_LEN(s->planewidth[c]) * sum_size;
+
+        if (h < 2 || slice_start >= slice_end)
+            continue;
+
+        for (y = slice_start - 1; y < slice_end; y++) {
+            const uint8_t *main_line = main->data[c] + 4 * y * main_stride;
+            const uint8_t *ref_line  = ref->data[c]  + 4 * y * ref_stride;
+
+            FFSWAP(void *, sum0, sum1);
+            if (s->depth > 8)
+                ff_ssim_4x4xn_16bit(main_line, main_stride, ref_line, ref_stride, sum0, w);
+            else
+                s->ssim_dsp.ssim_4x4_line(main_line, main_stride, ref_line, ref_stride, sum0, w);
+
+            if (y < slice_start)
+                continue;
+
+            if (s->depth > 8)
+                s->ssim_lines[c][y - 1] = ff_ssim_endn_16bit(sum0, sum1, w - 1, s->max[0]);
+            else
+                s->ssim_lines[c][y - 1] = s->ssim_dsp.ssim_end_line(sum0, sum1, w - 1);
+        }
+    }
+}
+
+static int metrics_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    QualityContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    if (s->metrics & METRIC_PSNR)
+        psnr_slice(s, td->main, td->ref, jobnr, nb_jobs);
+    if (s->metrics & METRIC_SSIM)
+        ssim_slice(s, td->main, td->ref, jobnr, nb_jobs);
+    if (s->metrics & METRIC_VMAFMOTION) {
+        const int slice_start = (s->vmaf.height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (s->vmaf.height * (jobnr + 1)) / nb_jobs;
+
+        s->vmaf_sad[jobnr] = ff_vmafmotion_process_slice(&s->vmaf, td->ref, slice_start, slice_end);
+    }
+
+    return 0;
+}
+
+static int do_metrics(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    QualityContext *s = ctx->priv;
+    AVFrame *master, *ref;
+    AVDictionary **metadata;
+    double comp_mse[4], mse = 0;
+    double ssimc[4] = { 0 }, ssimv = 0;
+    double motion = 0;
+    ThreadData td;
+    int ret, i, j, c;
+
+    ret = ff_framesync_dualinput_get(fs, &master, &ref);
+    if (ret < 0)
+        return ret;
+    if (!ref)
+        return ff_filter_frame(ctx->outputs[0], master);
+    metadata = &master->metadata;
+
+    td.main = master;
+    td.ref  = ref;
+    ctx->internal->execute(ctx, metrics_slice, &td, NULL, s->nb_jobs);
+
+    s->nb_frames++;
+
+    if (s->metrics & METRIC_PSNR) {
+        for (j = 0; j < s->nb_components; j++) {
+            uint64_t m = 0;
+
+            for (i = 0; i < s->nb_jobs; i++)
+                m += s->sse[i][j];
+            comp_mse[j] = m / (double)(s->planewidth[j] * s->planeheight[j]);
+            mse += comp_mse[j] * s->planeweight[j];
+            s->mse_comp[j] += comp_mse[j];
+        }
+
+        s->min_mse = FFMIN(s->min_mse, mse);
+        s->max_mse = FFMAX(s->max_mse, mse);
+        s->mse += mse;
+
+        for (j = 0; j < s->nb_components; j++) {
+            c = s->is_rgb ? s->rgba_map[j] : j;
+            set_meta(metadata, "lavfi.psnr.mse.", s->comps[j], comp_mse[c]);
+            set_meta(metadata, "lavfi.psnr.psnr.", s->comps[j], get_psnr(comp_mse[c], 1, s->max[c]));
+        }
+        set_meta(metadata, "lavfi.psnr.mse_avg", 0, mse);
+        set_meta(metadata, "lavfi.psnr.psnr_avg", 0, get_psnr(mse, 1, s->average_max));
+    }
+
+    if (s->metrics & METRIC_SSIM) {
+        for (j = 0; j < s->nb_components; j++) {
+            const int w = s->planewidth[j] >> 2;
+            const int h = s->planeheight[j] >> 2;
+            double sum = 0;
+
+            for (i = 0; i < h - 1; i++)
+                sum += s->ssim_lines[j][i];
+            ssimc[j] = sum / ((h - 1) * (w - 1));
+            ssimv += s->planeweight[j] * ssimc[j];
+            s->ssim[j] += ssimc[j];
+        }
+        s->ssim_total += ssimv;
+
+        for (j = 0; j < s->nb_components; j++) {
+            c = s->is_rgb ? s->rgba_map[j] : j;
+            set_meta(metadata, "lavfi.ssim.", av_toupper(s->comps[j]), ssimc[c]);
+        }
+        set_meta(metadata, "lavfi.ssim.All", 0, ssimv);
+        set_meta(metadata, "lavfi.ssim.dB", 0, ssim_db(ssimv, 1.0));
+    }
+
+    if (s->metrics & METRIC_VMAFMOTION) {
+        uint64_t sad = 0;
+
+        for (i = 0; i < s->nb_jobs; i++)
+            sad += s->vmaf_sad[i];
+        motion = ff_vmafmotion_end_frame(&s->vmaf, sad);
+        set_meta(metadata, "lavfi.vmafmotion.score", 0, motion);
+    }
+
+    if (s->stats_file) {
+        fprintf(s->stats_file, "n:%"PRId64, s->nb_frames);
+        if (s->metrics & METRIC_PSNR) {
+            fprintf(s->stats_file, " mse_avg:%0.2f", mse);
+            for (j = 0; j < s->nb_components; j++) {
+                c = s->is_rgb ? s->rgba_map[j] : j;
+                fprintf(s->stats_file, " mse_%c:%0.2f", s->comps[j], comp_mse[c]);
+            }
+            fprintf(s->stats_file, " psnr_avg:%0.2f", get_psnr(mse, 1, s->average_max));
+            for (j = 0; j < s->nb_components; j++) {
+                c = s->is_rgb ? s->rgba_map[j] : j;
+                fprintf(s->stats_file, " psnr_%c:%0.2f", s->comps[j],
+                        get_psnr(comp_mse[c], 1, s->max[c]));
+            }
+        }
+        if (s->metrics & METRIC_SSIM) {
+            for (j = 0; j < s->nb_components; j++) {
+                c = s->is_rgb ? s->rgba_map[j] : j;
+                fprintf(s->stats_file, " ssim_%c:%f", s->comps[j], ssimc[c]);
+            }
+            fprintf(s->stats_file, " ssim_all:%f (%f)", ssimv, ssim_db(ssimv, 1.0));
+        }
+        if (s->metrics & METRIC_VMAFMOTION)
+            fprintf(s->stats_file, " motion:%0.2f", motion);
+        fprintf(s->stats_file, "\n");
+    }
+
+    return ff_filter_frame(ctx->outputs[0], master);
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    QualityContext *s = ctx->priv;
+
+    if (!s->metrics) {
+        av_log(ctx, AV_LOG_ERROR, "No metric selected.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->min_mse = +INFINITY;
+    s->max_mse = -INFINITY;
+
+    if (s->stats_file_str) {
+        if (!strcmp(s->stats_file_str, "-")) {
+            s->stats_file = stdout;
+        } else {
+            s->stats_file = fopen(s->stats_file_str, "w");
+            if (!s->stats_file) {
+                int err = AVERROR(errno);
+                char buf[128];
+                av_strerror(err, buf, sizeof(buf));
+                av_log(ctx, AV_LOG_ERROR, "Could not open stats file %s: %s\n",
+                       s->stats_file_str, buf);
+                return err;
+            }
+        }
+    }
+
+    s->fs.on_event = do_metrics;
+    return 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAY9, AV_PIX_FMT_GRAY10,
+        AV_PIX_FMT_GRAY12, AV_PIX_FMT_GRAY14, AV_PIX_FMT_GRAY16,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P,
+        AV_PIX_FMT_YUV440P, AV_PIX_FMT_YUV411P, AV_PIX_FMT_YUV410P,
+        AV_PIX_FMT_YUVJ411P, AV_PIX_FMT_YUVJ420P, AV_PIX_FMT_YUVJ422P,
+        AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_YUVJ444P,
+        AV_PIX_FMT_GBRP,
+#define PF(suf) AV_PIX_FMT_YUV420##suf,  AV_PIX_FMT_YUV422##suf,  AV_PIX_FMT_YUV444##suf, AV_PIX_FMT_GBR##suf
+        PF(P9), PF(P10), PF(P12), PF(P14), PF(P16),
+        AV_PIX_FMT_NONE
+    };
+
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_input_ref(AVFilterLink *inlink)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    AVFilterContext *ctx  = inlink->dst;
+    QualityContext *s = ctx->priv;
+    double average_max;
+    unsigned sum;
+    int i, ret;
+
+    if (ctx->inputs[0]->w != ctx->inputs[1]->w ||
+        ctx->inputs[0]->h != ctx->inputs[1]->h) {
+        av_log(ctx, AV_LOG_ERROR, "Width and height of input videos must be same.\n");
+        return AVERROR(EINVAL);
+    }
+    if (ctx->inputs[0]->format != ctx->inputs[1]->format) {
+        av_log(ctx, AV_LOG_ERROR, "Inputs must be of same pixel format.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->nb_components = desc->nb_components;
+    s->depth = desc->comp[0].depth;
+    s->is_rgb = ff_fill_rgba_map(s->rgba_map, inlink->format) >= 0;
+    s->comps[0] = s->is_rgb ? 'r' : 'y';
+    s->comps[1] = s->is_rgb ? 'g' : 'u';
+    s->comps[2] = s->is_rgb ? 'b' : 'v';
+    s->comps[3] = 'a';
+
+    if ((s->metrics & METRIC_VMAFMOTION) &&
+        (s->is_rgb || (s->depth != 8 && s->depth != 10))) {
+        av_log(ctx, AV_LOG_ERROR, "VMAF motion requires 8 or 10 bit YUV or gray input.\n");
+        return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < 4; i++)
+        s->max[i] = (1 << desc->comp[i].depth) - 1;
+
+    s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
+    s->planeheight[0] = s->planeheight[3] = inlink->h;
+    s->planewidth[1]  = s->planewidth[2]  = AV_CEIL_RSHIFT(inlink->w, desc->log2_chroma_w);
+    s->planewidth[0]  = s->planewidth[3]  = inlink->w;
+    sum = 0;
+    for (i = 0; i < s->nb_components; i++)
+        sum += s->planeheight[i] * s->planewidth[i];
+    average_max = 0;
+    for (i = 0; i < s->nb_components; i++) {
+        s->planeweight[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
+        average_max += s->max[i] * s->planeweight[i];
+    }
+    s->average_max = lrint(average_max);
+
+    s->nb_jobs = FFMAX(1, FFMIN(inlink->h, ff_filter_get_nb_threads(ctx)));
+
+    if (s->metrics & METRIC_PSNR) {
+        s->sse = av_calloc(s->nb_jobs, sizeof(*s->sse));
+        if (!s->sse)
+            return AVERROR(ENOMEM);
+        ff_psnr_init(&s->psnr_dsp, s->depth);
+    }
+
+    if (s->metrics & METRIC_SSIM) {
+        s->ssim_temp_size = 2 * SUM_LEN(inlink->w) * (s->depth > 8 ? sizeof(int64_t[4]) : sizeof(int[4]));
+        s->ssim_temp = av_calloc(s->nb_jobs, s->ssim_temp_size);
+        if (!s->ssim_temp)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->nb_components; i++) {
+            s->ssim_lines[i] = av_calloc(FFMAX(1, s->planeheight[i] >> 2), sizeof(*s->ssim_lines[i]));
+            if (!s->ssim_lines[i])
+                return AVERROR(ENOMEM);
+        }
+        ff_ssim_init(&s->ssim_dsp);
+    }
+
+    if (s->metrics & METRIC_VMAFMOTION) {
+        s->vmaf_sad = av_calloc(s->nb_jobs, sizeof(*s->vmaf_sad));
+        if (!s->vmaf_sad)
+            return AVERROR(ENOMEM);
+        ret = ff_vmafmotion_init(&s->vmaf, inlink->w, inlink->h, inlink->format);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    QualityContext *s = ctx->priv;
+    AVFilterLink *mainlink = ctx->inputs[0];
+    int ret;
+
+    ret = ff_framesync_init_dualinput(&s->fs, ctx);
+    if (ret < 0)
+        return ret;
+    outlink->w = mainlink->w;
+    outlink->h = mainlink->h;
+    outlink->time_base = mainlink->time_base;
+    outlink->sample_aspect_ratio = mainlink->sample_aspect_ratio;
+    outlink->frame_rate = mainlink->frame_rate;
+    if ((ret = ff_framesync_configure(&s->fs)) < 0)
+        return ret;
+
+    outlink->time_base = s->fs.time_base;
+
+    if (av_cmp_q(mainlink->time_base, outlink->time_base) ||
+        av_cmp_q(ctx->inputs[1]->time_base, outlink->time_base))
+        av_log(ctx, AV_LOG_WARNING, "not matching timebases found between first input: %d/%d and second input %d/%d, results may be incorrect!\n",
+               mainlink->time_base.num, mainlink->time_base.den,
+               ctx->inputs[1]->time_base.num, ctx->inputs[1]->time_base.den);
+
+    return 0;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    QualityContext *s = ctx->priv;
+    return ff_framesync_activate(&s->fs);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    QualityContext *s = ctx->priv;
+    double avg_motion;
+    int i;
+
+    if (s->nb_frames > 0) {
+        char buf[256];
+
+        if (s->metrics & METRIC_PSNR) {
+            buf[0] = 0;
+            for (i = 0; i < s->nb_components; i++) {
+                int c = s->is_rgb ? s->rgba_map[i] : i;
+                av_strlcatf(buf, sizeof(buf), " %c:%f", s->comps[i],
+                            get_psnr(s->mse_comp[c], s->nb_frames, s->max[c]));
+            }
+            av_log(ctx, AV_LOG_INFO, "PSNR%s average:%f min:%f max:%f\n",
+                   buf,
+                   get_psnr(s->mse, s->nb_frames, s->average_max),
+                   get_psnr(s->max_mse, 1, s->average_max),
+                   get_psnr(s->min_mse, 1, s->average_max));
+        }
+
+        if (s->metrics & METRIC_SSIM) {
+            buf[0] = 0;
+            for (i = 0; i < s->nb_components; i++) {
+                int c = s->is_rgb ? s->rgba_map[i] : i;
+                av_strlcatf(buf, sizeof(buf), " %c:%f (%f)", av_toupper(s->comps[i]), s->ssim[c] / s->nb_frames,
+                            ssim_db(s->ssim[c], s->nb_frames));
+            }
+            av_log(ctx, AV_LOG_INFO, "SSIM%s All:%f (%f)\n", buf,
+                   s->ssim_total / s->nb_frames, ssim_db(s->ssim_total, s->nb_frames));
+        }
+    }
+
+    avg_motion = ff_vmafmotion_uninit(&s->vmaf);
+    if ((s->metrics & METRIC_VMAFMOTION) && s->vmaf.nb_frames > 0)
+        av_log(ctx, AV_LOG_INFO, "VMAF Motion avg: %.3f\n", avg_motion);
+
+    ff_framesync_uninit(&s->fs);
+
+    if (s->stats_file && s->stats_file != stdout)
+        fclose(s->stats_file);
+
+    av_freep(&s->sse);
+    av_freep(&s->ssim_temp);
+    for (i = 0; i < 4; i++)
+        av_freep(&s->ssim_lines[i]);
+    av_freep(&s->vmaf_sad);
+}
+
+static const AVFilterPad quality_inputs[] = {
+    {
+        .name         = "main",
+        .type         = AVMEDIA_TYPE_VIDEO,
+    },{
+        .name         = "reference",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input_ref,
+    },
+    { NULL }
+};
+
+static const AVFilterPad quality_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_quality = {
+    .name          = "quality",
+    .description   = NULL_IF_CONFIG_SMALL("Calculate the PSNR, SSIM and VMAF motion between two video streams."),
+    .preinit       = quality_framesync_preinit,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .activate      = activate,
+    .priv_size     = sizeof(QualityContext),
+    .priv_class    = &quality_class,
+    .inputs        = quality_inputs,
+    .outputs       = quality_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -552,6 +552,7 @@ static int config_props(AVFilterLink *outlink)
             if (scale->out_range != AVCOL_RANGE_UNSPECIFIED)
                 av_opt_set_int(*s, "dst_range",
                                scale->out_range == AVCOL_RANGE_JPEG, 0);
+            av_opt_set_int(*s, "threads", ff_filter_get_nb_threads(ctx), 0);
 
             if (scale->opts) {
                 AVDictionaryEntry *e = NULL;
@@ -986,6 +987,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags_internal  = FF_FILTER_FLAG_RECONFIGURABLE,
 };
 
 static const AVClass scale2ref_class = {
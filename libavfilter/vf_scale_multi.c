@@ -0,0 +1,442 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one input to several output sizes, e.g. for an ABR ladder
+ *
+ * An output is scaled from a larger output instead of the input when that
+ * one is at least cascade_ratio times bigger in both dimensions, so only
+ * the first step reads the (big) input. All outputs of the same step are
+ * scaled in parallel.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "scale_eval.h"
+#include "video.h"
+
+typedef struct ScaleMultiOutput {
+    int w, h;
+    int src;                    ///< index of the output scaled from, -1 for the input
+    int level;                  ///< number of scaling steps from the input
+    struct SwsContext *sws;
+    AVFrame *frame;
+} ScaleMultiOutput;
+
+typedef struct ScaleMultiContext {
+    const AVClass *class;
+    char *sizes_str;
+    char *flags_str;
+    int cascade;
+    double cascade_ratio;
+
+    unsigned flags;
+    ScaleMultiOutput *outs;
+    int nb_outs;
+    int nb_levels;
+
+    /* input properties the scalers were initialized for */
+    int in_w, in_h, in_full_range;
+    enum AVPixelFormat in_format;
+} ScaleMultiContext;
+
+typedef struct ThreadData {
+    AVFrame *in;
+    int level;
+} ThreadData;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ScaleMultiContext *s = ctx->priv;
+    const ScaleMultiOutput *out = &s->outs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->w = out->w;
+    outlink->h = out->h;
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ScaleMultiContext *s = ctx->priv;
+    char *sizes, *saveptr = NULL, *token;
+    int ret = 0;
+
+    if (!s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (s->flags_str) {
+        const AVClass *class = sws_get_class();
+        const AVOption    *o = av_opt_find(&class, "sws_flags", NULL, 0,
+                                           AV_OPT_SEARCH_FAKE_OBJ);
+        if ((ret = av_opt_eval_flags(&class, o, s->flags_str, &s->flags)) < 0)
+            return ret;
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (token = av_strtok(sizes, "|", &saveptr); token;
+         token = av_strtok(NULL, "|", &saveptr)) {
+        AVFilterPad pad = { 0 };
+        int w, h;
+
+        /* negative values keep the aspect ratio, as in the scale filter */
+        if (sscanf(token, "%dx%d", &w, &h) != 2 &&
+            av_parse_video_size(&w, &h, token) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'.\n", token);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+
+        if ((ret = av_reallocp_array(&s->outs, s->nb_outs + 1, sizeof(*s->outs))) < 0) {
+            s->nb_outs = 0;
+            goto end;
+        }
+        memset(&s->outs[s->nb_outs], 0, sizeof(*s->outs));
+        s->outs[s->nb_outs].w = w;
+        s->outs[s->nb_outs].h = h;
+        s->nb_outs++;
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", ctx->nb_outputs);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = ff_insert_outpad(ctx, ctx->nb_outputs, &pad)) < 0) {
+            av_freep(&pad.name);
+            goto end;
+        }
+    }
+
+    if (!s->nb_outs) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        ret = AVERROR(EINVAL);
+    }
+
+end:
+    av_free(sizes);
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ScaleMultiContext *s = ctx->priv;
+    int i;
+
+    for (i = 0; i < s->nb_outs; i++) {
+        sws_freeContext(s->outs[i].sws);
+        av_frame_free(&s->outs[i].frame);
+    }
+    av_freep(&s->outs);
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_freep(&ctx->output_pads[i].name);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int i, ret;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if ((sws_isSupportedInput(pix_fmt) ||
+             sws_isSupportedEndiannessConversion(pix_fmt)) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->out_formats)) < 0)
+        return ret;
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        formats = NULL;
+        desc    = NULL;
+        while ((desc = av_pix_fmt_desc_next(desc))) {
+            enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+            if ((sws_isSupportedOutput(pix_fmt) ||
+                 sws_isSupportedEndiannessConversion(pix_fmt)) &&
+                (ret = ff_add_format(&formats, pix_fmt)) < 0)
+                return ret;
+        }
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[i]->in_formats)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int config_input(AVFilterLink *inlink)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleMultiContext *s = ctx->priv;
+    int i;
+
+    for (i = 0; i < s->nb_outs; i++) {
+        ScaleMultiOutput *out = &s->outs[i];
+
+        if (!out->w)
+            out->w = inlink->w;
+        if (!out->h)
+            out->h = inlink->h;
+        ff_scale_adjust_dimensions(inlink, &out->w, &out->h, 0, 1);
+        if (out->w <= 0 || out->h <= 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size %dx%d for output %d.\n",
+                   out->w, out->h, i);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    return 0;
+}
+
+static int get_level(const ScaleMultiContext *s, int i)
+{
+    return s->outs[i].src < 0 ? 0 : get_level(s, s->outs[i].src) + 1;
+}
+
+/**
+ * Pick the source of every output and set up its scaler. An output is only
+ * scaled from another one with the same format which is strictly larger
+ * and at least cascade_ratio times the size in both dimensions, so the
+ * chains cannot loop.
+ */
+static int init_scalers(AVFilterContext *ctx, const AVFrame *in)
+{
+    ScaleMultiContext *s = ctx->priv;
+    int i, j, ret;
+
+    s->nb_levels = 0;
+    for (i = 0; i < s->nb_outs; i++) {
+        ScaleMultiOutput *out = &s->outs[i];
+        int64_t best_area = INT64_MAX;
+
+        sws_freeContext(out->sws);
+        out->sws = NULL;
+        out->src = -1;
+        if (!s->cascade)
+            continue;
+
+        for (j = 0; j < s->nb_outs; j++) {
+            const ScaleMultiOutput *cand = &s->outs[j];
+            int64_t area = (int64_t)cand->w * cand->h;
+
+            if (ctx->outputs[j]->format != ctx->outputs[i]->format ||
+                !sws_isSupportedInput(ctx->outputs[j]->format) ||
+                area <= (int64_t)out->w * out->h ||
+                cand->w < out->w * s->cascade_ratio ||
+                cand->h < out->h * s->cascade_ratio ||
+                area >= best_area)
+                continue;
+            best_area = area;
+            out->src  = j;
+        }
+    }
+
+    for (i = 0; i < s->nb_outs; i++) {
+        ScaleMultiOutput *out = &s->outs[i];
+        enum AVPixelFormat src_format = out->src < 0 ? in->format : ctx->outputs[out->src]->format;
+        enum AVPixelFormat dst_format = ctx->outputs[i]->format;
+
+        out->level   = get_level(s, i);
+        s->nb_levels = FFMAX(s->nb_levels, out->level + 1);
+
+        out->sws = sws_alloc_context();
+        if (!out->sws)
+            return AVERROR(ENOMEM);
+
+        av_opt_set_int(out->sws, "srcw", out->src < 0 ? in->width  : s->outs[out->src].w, 0);
+        av_opt_set_int(out->sws, "srch", out->src < 0 ? in->height : s->outs[out->src].h, 0);
+        av_opt_set_int(out->sws, "src_format", src_format, 0);
+        av_opt_set_int(out->sws, "dstw", out->w, 0);
+        av_opt_set_int(out->sws, "dsth", out->h, 0);
+        av_opt_set_int(out->sws, "dst_format", dst_format, 0);
+        av_opt_set_int(out->sws, "sws_flags", s->flags, 0);
+        av_opt_set_int(out->sws, "src_range", s->in_full_range, 0);
+        av_opt_set_int(out->sws, "dst_range", s->in_full_range, 0);
+        /* MPEG-2 chroma positions, as in the scale filter */
+        if (src_format == AV_PIX_FMT_YUV420P)
+            av_opt_set_int(out->sws, "src_v_chr_pos", 128, 0);
+        if (dst_format == AV_PIX_FMT_YUV420P)
+            av_opt_set_int(out->sws, "dst_v_chr_pos", 128, 0);
+
+        if ((ret = sws_init_context(out->sws, NULL, NULL)) < 0)
+            return ret;
+
+        av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d %s from %s\n", i,
+               out->w, out->h, av_get_pix_fmt_name(dst_format),
+               out->src < 0 ? "input" : ctx->output_pads[out->src].name);
+    }
+
+    return 0;
+}
+
+static int scale_outputs(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleMultiContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int i, n = 0;
+
+    for (i = 0; i < s->nb_outs; i++) {
+        ScaleMultiOutput *out = &s->outs[i];
+        const AVFrame *src;
+
+        if (out->level != td->level || n++ % nb_jobs != jobnr)
+            continue;
+
+        src = out->src < 0 ? td->in : s->outs[out->src].frame;
+        sws_scale(out->sws, (const uint8_t * const *)src->data, src->linesize,
+                  0, src->height, out->frame->data, out->frame->linesize);
+    }
+
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleMultiContext *s = ctx->priv;
+    int full_range = in->color_range == AVCOL_RANGE_JPEG;
+    int i, level, ret = AVERROR_EOF;
+
+    if (!s->outs[0].sws ||
+        in->width  != s->in_w ||
+        in->height != s->in_h ||
+        in->format != s->in_format ||
+        full_range != s->in_full_range) {
+        s->in_w          = in->width;
+        s->in_h          = in->height;
+        s->in_format     = in->format;
+        s->in_full_range = full_range;
+        if ((ret = init_scalers(ctx, in)) < 0)
+            goto fail;
+    }
+
+    for (i = 0; i < s->nb_outs; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(outlink->format);
+        ScaleMultiOutput *out = &s->outs[i];
+
+        out->frame = ff_get_video_buffer(outlink, out->w, out->h);
+        if (!out->frame) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        av_frame_copy_props(out->frame, in);
+        out->frame->width  = out->w;
+        out->frame->height = out->h;
+        av_reduce(&out->frame->sample_aspect_ratio.num, &out->frame->sample_aspect_ratio.den,
+                  (int64_t)in->sample_aspect_ratio.num * out->h * in->width,
+                  (int64_t)in->sample_aspect_ratio.den * out->w * in->height,
+                  INT_MAX);
+        if (desc->flags & FF_PSEUDOPAL)
+            avpriv_set_systematic_pal2((uint32_t *)out->frame->data[1], outlink->format);
+    }
+
+    for (level = 0; level < s->nb_levels; level++) {
+        ThreadData td = { .in = in, .level = level };
+        int nb_jobs = 0;
+
+        for (i = 0; i < s->nb_outs; i++)
+            nb_jobs += s->outs[i].level == level;
+        ctx->internal->execute(ctx, scale_outputs, &td, NULL,
+                               FFMIN(nb_jobs, ff_filter_get_nb_threads(ctx)));
+    }
+
+    ret = AVERROR_EOF;
+    for (i = 0; i < s->nb_outs; i++) {
+        AVFrame *frame = s->outs[i].frame;
+
+        s->outs[i].frame = NULL;
+        if (ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&frame);
+            continue;
+        }
+        ret = ff_filter_frame(ctx->outputs[i], frame);
+        if (ret < 0)
+            goto fail;
+    }
+
+fail:
+    for (i = 0; i < s->nb_outs; i++)
+        av_frame_free(&s->outs[i].frame);
+    av_frame_free(&in);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(ScaleMultiContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scale_multi_options[] = {
+    { "sizes",         "set the '|'-separated output sizes", OFFSET(sizes_str),     AV_OPT_TYPE_STRING, { .str = NULL },       .flags = FLAGS },
+    { "flags",         "set libswscale flags",               OFFSET(flags_str),     AV_OPT_TYPE_STRING, { .str = "bilinear" }, .flags = FLAGS },
+    { "cascade",       "scale from larger outputs",          OFFSET(cascade),       AV_OPT_TYPE_BOOL,   { .i64 = 1 },   0, 1,  FLAGS },
+    { "cascade_ratio", "set the minimum size ratio to scale from another output", OFFSET(cascade_ratio), AV_OPT_TYPE_DOUBLE, { .dbl = 2 }, 1, 16, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scale_multi);
+
+static const AVFilterPad scale_multi_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_scale_multi = {
+    .name          = "scale_multi",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several output sizes."),
+    .priv_size     = sizeof(ScaleMultiContext),
+    .priv_class    = &scale_multi_class,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .inputs        = scale_multi_inputs,
+    .outputs       = NULL,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
+};
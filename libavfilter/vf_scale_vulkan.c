@@ -16,8 +16,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <float.h>
+
 #include "libavutil/random_seed.h"
 #include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
 #include "vulkan.h"
 #include "scale_eval.h"
 #include "internal.h"
@@ -28,14 +31,28 @@
 enum ScalerFunc {
     F_BILINEAR = 0,
     F_NEAREST,
+    F_BICUBIC,
+    F_LANCZOS,
 
     F_NB,
 };
 
+enum TonemapAlgorithm {
+    TONEMAP_NONE,
+    TONEMAP_LINEAR,
+    TONEMAP_GAMMA,
+    TONEMAP_CLIP,
+    TONEMAP_REINHARD,
+    TONEMAP_HABLE,
+    TONEMAP_MOBIUS,
+    TONEMAP_MAX,
+};
+
 typedef struct ScaleVulkanContext {
     VulkanFilterContext vkctx;
 
     int initialized;
+    int convert;
     FFVkExecContext *exec;
     VulkanPipeline *pl;
     FFVkBuffer params_buf;
@@ -48,20 +65,111 @@ typedef struct ScaleVulkanContext {
     enum ScalerFunc scaler;
     char *out_format_string;
     enum AVColorRange out_range;
+    char *colour_matrix_string;
+    enum AVColorSpace colour_matrix;
     char *w_expr;
     char *h_expr;
+
+    enum TonemapAlgorithm tonemap;
+    double tonemap_param;
+    double peak;
 } ScaleVulkanContext;
 
-static const char scale_bilinear[] = {
-    C(0, vec4 scale_bilinear(int idx, ivec2 pos, vec2 crop_range, vec2 crop_off))
+static const struct PrimaryCoefficients primaries_table[AVCOL_PRI_NB] = {
+    [AVCOL_PRI_BT709]  = { 0.640, 0.330, 0.300, 0.600, 0.150, 0.060 },
+    [AVCOL_PRI_BT2020] = { 0.708, 0.292, 0.170, 0.797, 0.131, 0.046 },
+};
+
+static const struct WhitepointCoefficients whitepoint_table[AVCOL_PRI_NB] = {
+    [AVCOL_PRI_BT709]  = { 0.3127, 0.3290 },
+    [AVCOL_PRI_BT2020] = { 0.3127, 0.3290 },
+};
+
+static const char *linearize_funcs[AVCOL_TRC_NB] = {
+    [AVCOL_TRC_SMPTE2084]    = "eotf_st2084",
+    [AVCOL_TRC_ARIB_STD_B67] = "inverse_oetf_hlg",
+};
+
+static const char out_npos[] = {
+    C(0, vec2 out_npos(ivec2 pos, ivec2 size, vec2 crop_range, vec2 crop_off)  )
     C(0, {                                                                      )
-    C(1,     vec2 npos = (vec2(pos) + 0.5f) / imageSize(output_img[idx]);       )
+    C(1,     vec2 npos = (vec2(pos) + 0.5f) / size;                             )
     C(1,     npos *= crop_range;    /* Reduce the range */                      )
     C(1,     npos += crop_off;      /* Offset the start */                      )
+    C(1,     return npos;                                                       )
+    C(0, }                                                                      )
+};
+
+static const char scale_bilinear[] = {
+    C(0, vec4 scale_plane(int idx, vec2 npos)                                   )
+    C(0, {                                                                      )
     C(1,     return texture(input_img[idx], npos);                              )
     C(0, }                                                                      )
 };
 
+/* Catmull-Rom (B = 0, C = 0.5) */
+static const char kernel_bicubic[] = {
+    C(0, float kernel_w(float x)                                                )
+    C(0, {                                                                      )
+    C(1,     x = abs(x);                                                        )
+    C(1,     if (x < 1.0)                                                       )
+    C(2,         return (1.5*x - 2.5)*x*x + 1.0;                                )
+    C(1,     if (x < 2.0)                                                       )
+    C(2,         return ((-0.5*x + 2.5)*x - 4.0)*x + 2.0;                       )
+    C(1,     return 0.0;                                                        )
+    C(0, }                                                                      )
+};
+
+static const char kernel_lanczos[] = {
+    C(0, float kernel_w(float x)                                                )
+    C(0, {                                                                      )
+    C(1,     x = abs(x);                                                        )
+    C(1,     if (x < 1e-5)                                                      )
+    C(2,         return 1.0;                                                    )
+    C(1,     if (x >= 3.0)                                                      )
+    C(2,         return 0.0;                                                    )
+    C(1,     x *= 3.14159265358979;                                             )
+    C(1,     return 3.0*sin(x)*sin(x / 3.0) / (x*x);                            )
+    C(0, }                                                                      )
+};
+
+/* Needs kernel_w(), kernel_r and kernel_fs (the kernel stretch factor, which
+ * is above 1.0 when downscaling to avoid aliasing) to be defined */
+static const char scale_kernel[] = {
+    C(0, vec4 scale_plane(int idx, vec2 npos)                                   )
+    C(0, {                                                                      )
+    C(1,     ivec2 isz = textureSize(input_img[idx], 0);                        )
+    C(1,     vec2 p = npos*vec2(isz) - 0.5;                                     )
+    C(1,     ivec2 lo = ivec2(ceil(p - kernel_r*kernel_fs));                    )
+    C(1,     ivec2 hi = ivec2(floor(p + kernel_r*kernel_fs));                   )
+    C(1,     vec4 sum = vec4(0.0);                                              )
+    C(1,     float wsum = 0.0;                                                  )
+    C(1,     for (int y = lo.y; y <= hi.y; y++) {                               )
+    C(2,         float wy = kernel_w((float(y) - p.y) / kernel_fs.y);           )
+    C(2,         for (int x = lo.x; x <= hi.x; x++) {                           )
+    C(3,             float w = wy*kernel_w((float(x) - p.x) / kernel_fs.x);     )
+    C(3,             ivec2 tp = clamp(ivec2(x, y), ivec2(0), isz - 1);          )
+    C(3,             sum += w*texelFetch(input_img[idx], tp, 0);                )
+    C(3,             wsum += w;                                                 )
+    C(2,         }                                                              )
+    C(1,     }                                                                  )
+    C(1,     return sum / wsum;                                                 )
+    C(0, }                                                                      )
+};
+
+static const char yuv2rgb[] = {
+    C(0, vec4 yuv2rgb(vec4 src, int fullrange)                                  )
+    C(0, {                                                                      )
+    C(1,     if (fullrange == 1) {                                              )
+    C(2,         src -= vec4(0.0, 0.5, 0.5, 0.0);                               )
+    C(1,     } else {                                                           )
+    C(2,         src -= vec4(16.0 / 255.0, 128.0 / 255.0, 128.0 / 255.0, 0.0);  )
+    C(2,         src /= vec4(219.0 / 255.0, 224.0 / 255.0, 224.0 / 255.0, 1.0); )
+    C(1,     }                                                                  )
+    C(1,     return src * rgb_matrix;                                           )
+    C(0, }                                                                      )
+};
+
 static const char rgb2yuv[] = {
     C(0, vec4 rgb2yuv(vec4 src, int fullrange)                                  )
     C(0, {                                                                      )
@@ -76,6 +184,65 @@ static const char rgb2yuv[] = {
     C(0, }                                                                      )
 };
 
+static const char transfer_funcs[] = {
+    C(0, float eotf_st2084(float x)                                             )
+    C(0, {                                                                      )
+    C(1,     float p = pow(max(x, 0.0), 1.0 / 78.84375);                        )
+    C(1,     float a = max(p - 0.8359375, 0.0);                                 )
+    C(1,     float b = max(18.8515625 - 18.6875*p, 1e-6);                       )
+    C(1,     return pow(a / b, 1.0 / 0.1593017578125) * 10000.0 / 100.0;       )
+    C(0, }                                                                      )
+    C(0,                                                                        )
+    C(0, float inverse_oetf_hlg(float x)                                        )
+    C(0, {                                                                      )
+    C(1,     if (x < 0.5)                                                       )
+    C(2,         return 4.0*x*x;                                                )
+    C(1,     return exp((x - 0.55991073) / 0.17883277) + 0.28466892;            )
+    C(0, }                                                                      )
+    C(0,                                                                        )
+    C(0, vec3 ootf_hlg(vec3 c, float peak)                                      )
+    C(0, {                                                                      )
+    C(1,     float luma = dot(luma_src, c);                                     )
+    C(1,     float gamma = 1.2 + 0.42*log(peak*100.0 / 1000.0) / log(10.0);    )
+    C(1,     gamma = max(1.0, gamma);                                           )
+    C(1,     return c*peak*pow(luma, gamma - 1.0) / pow(12.0, gamma);           )
+    C(0, }                                                                      )
+    C(0,                                                                        )
+    C(0, float inverse_eotf_bt1886(float c)                                     )
+    C(0, {                                                                      )
+    C(1,     return c < 0.0 ? 0.0 : pow(c, 1.0 / 2.4);                          )
+    C(0, }                                                                      )
+    C(0,                                                                        )
+    C(0, float hable_f(float x)                                                 )
+    C(0, {                                                                      )
+    C(1,     return (x*(x*0.15 + 0.05) + 0.004) / (x*(x*0.15 + 0.5) + 0.06) - 0.02 / 0.3; )
+    C(0, }                                                                      )
+};
+
+static const char read_nv12[] = {
+    C(0, vec4 read_nv12(vec2 npos)                                              )
+    C(0, {                                                                      )
+    C(1,     return vec4(scale_plane(0, npos).r, scale_plane(1, npos).rg, 1.0); )
+    C(0, }                                                                      )
+};
+
+static const char read_planar[] = {
+    C(0, vec4 read_planar(vec2 npos)                                            )
+    C(0, {                                                                      )
+    C(1,     vec4 res = vec4(scale_plane(0, npos).r, 0.0, 0.0, 1.0);            )
+    C(1,     res.g = scale_plane(1, npos).r;                                    )
+    C(1,     res.b = scale_plane(2, npos).r;                                    )
+    C(1,     return res;                                                        )
+    C(0, }                                                                      )
+};
+
+static const char read_packed[] = {
+    C(0, vec4 read_packed(vec2 npos)                                            )
+    C(0, {                                                                      )
+    C(1,     return scale_plane(0, npos);                                       )
+    C(0, }                                                                      )
+};
+
 static const char write_nv12[] = {
     C(0, void write_nv12(vec4 src, ivec2 pos)                                   )
     C(0, {                                                                      )
@@ -104,12 +271,96 @@ static const char write_444[] = {
     C(0, }                                                                      )
 };
 
+static const char write_packed[] = {
+    C(0, void write_packed(vec4 src, ivec2 pos)                                 )
+    C(0, {                                                                      )
+    C(1,     imageStore(output_img[0], pos, src);                               )
+    C(0, }                                                                      )
+};
+
+static int is_supported_yuv(enum AVPixelFormat fmt)
+{
+    switch (fmt) {
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_P010:
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV420P10:
+    case AV_PIX_FMT_YUV444P:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Formats with less than 16 bits stored LSB-aligned in 16 bit images are
+ * read back as a fraction of the full unorm range and need rescaling */
+static double unorm_scale(enum AVPixelFormat fmt)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
+    const int depth = desc->comp[0].depth;
+    if (desc->comp[0].shift || depth <= 8 || depth == 16)
+        return 1.0;
+    return 65535.0 / ((1 << depth) - 1);
+}
+
+static const char *read_func(enum AVPixelFormat fmt)
+{
+    switch (fmt) {
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_P010:      return "read_nv12";
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV420P10:
+    case AV_PIX_FMT_YUV444P:   return "read_planar";
+    default:                   return "read_packed";
+    }
+}
+
+static const char *write_func(enum AVPixelFormat fmt)
+{
+    switch (fmt) {
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_P010:      return "write_nv12";
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV420P10: return "write_420";
+    case AV_PIX_FMT_YUV444P:   return "write_444";
+    default:                   return "write_packed";
+    }
+}
+
+static void fill_mat4(float dst[4][4], double src[3][3])
+{
+    memset(dst, 0, 16 * sizeof(float));
+
+    for (int y = 0; y < 3; y++)
+        for (int x = 0; x < 3; x++)
+            dst[x][y] = src[x][y];
+
+    dst[3][3] = 1.0;
+}
+
+static void get_rgb2rgb_matrix(enum AVColorPrimaries in, enum AVColorPrimaries out,
+                               double rgb2rgb[3][3])
+{
+    double rgb2xyz[3][3], xyz2rgb[3][3];
+
+    ff_fill_rgb2xyz_table(&primaries_table[out], &whitepoint_table[out], rgb2xyz);
+    ff_matrix_invert_3x3(rgb2xyz, xyz2rgb);
+    ff_fill_rgb2xyz_table(&primaries_table[in], &whitepoint_table[in], rgb2xyz);
+    ff_matrix_mul_3x3(rgb2rgb, rgb2xyz, xyz2rgb);
+}
+
 static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
 {
     int err;
     VkSampler *sampler;
     VkFilter sampler_mode;
     ScaleVulkanContext *s = ctx->priv;
+    const int in_yuv  = is_supported_yuv(s->vkctx.input_format);
+    const int out_yuv = is_supported_yuv(s->vkctx.output_format);
+    const double in_scale  = unorm_scale(s->vkctx.input_format);
+    const double out_scale = unorm_scale(s->vkctx.output_format);
+    const char *linearize = NULL;
+    double peak = s->peak;
 
     int crop_x = in->crop_left;
     int crop_y = in->crop_top;
@@ -120,8 +371,27 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
     s->vkctx.queue_count = GET_QUEUE_COUNT(s->vkctx.hwctx, 0, 1, 0);
     s->vkctx.cur_queue_idx = av_get_random_seed() % s->vkctx.queue_count;
 
+    if (s->tonemap != TONEMAP_NONE) {
+        linearize = linearize_funcs[in->color_trc];
+        if (!linearize) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported input transfer %s for "
+                   "tonemapping\n", av_color_transfer_name(in->color_trc));
+            return AVERROR(EINVAL);
+        }
+        if (in->color_primaries != AVCOL_PRI_BT709 &&
+            in->color_primaries != AVCOL_PRI_BT2020) {
+            av_log(ctx, AV_LOG_ERROR, "Unsupported input primaries %s for "
+                   "tonemapping\n", av_color_primaries_name(in->color_primaries));
+            return AVERROR(EINVAL);
+        }
+        if (peak <= 0.0)
+            peak = ff_determine_signal_peak(in);
+    }
+
     switch (s->scaler) {
     case F_NEAREST:
+    case F_BICUBIC:
+    case F_LANCZOS:
         sampler_mode = VK_FILTER_NEAREST;
         break;
     case F_BILINEAR:
@@ -168,7 +438,7 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
             .mem_layout  = "std430",
             .stages      = VK_SHADER_STAGE_COMPUTE_BIT,
             .updater     = &s->params_desc,
-            .buf_content = "mat4 yuv_matrix;",
+            .buf_content = "mat4 yuv_matrix; mat4 rgb_matrix; mat4 lrgb2lrgb;",
         };
 
         SPIRVShader *shd = ff_vk_init_shader(ctx, s->pl, "scale_compute",
@@ -181,17 +451,97 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
         RET(ff_vk_add_descriptor_set(ctx, s->pl, shd,  desc_i, 2, 0)); /* set 0 */
         RET(ff_vk_add_descriptor_set(ctx, s->pl, shd, &desc_b, 1, 0)); /* set 0 */
 
-        GLSLD(   scale_bilinear                                                  );
+        GLSLD(   out_npos                                                        );
+
+        switch (s->scaler) {
+        case F_NEAREST:
+        case F_BILINEAR:
+            GLSLD(   scale_bilinear                                              );
+            break;
+        case F_BICUBIC:
+        case F_LANCZOS:
+            GLSLF(0, const float kernel_r = %f;  ,s->scaler == F_LANCZOS ? 3.0 : 2.0);
+            GLSLF(0, const vec2 kernel_fs = vec2(%f, %f);                          ,
+                  FFMAX(crop_w / (double)s->vkctx.output_width,  1.0),
+                  FFMAX(crop_h / (double)s->vkctx.output_height, 1.0));
+            GLSLD(s->scaler == F_LANCZOS ? kernel_lanczos : kernel_bicubic       );
+            GLSLD(   scale_kernel                                                );
+            break;
+        default:
+            break;
+        };
 
-        if (s->vkctx.output_format != s->vkctx.input_format) {
+        if (s->convert) {
+            GLSLD(   read_nv12                                                   );
+            GLSLD(   read_planar                                                 );
+            GLSLD(   read_packed                                                 );
+            GLSLD(   yuv2rgb                                                     );
             GLSLD(   rgb2yuv                                                     );
+            GLSLD(   write_nv12                                                  );
+            GLSLD(   write_420                                                   );
+            GLSLD(   write_444                                                   );
+            GLSLD(   write_packed                                                );
         }
 
-        switch (s->vkctx.output_format) {
-        case AV_PIX_FMT_NV12:    GLSLD(write_nv12); break;
-        case AV_PIX_FMT_YUV420P: GLSLD( write_420); break;
-        case AV_PIX_FMT_YUV444P: GLSLD( write_444); break;
-        default: break;
+        if (linearize) {
+            const struct LumaCoefficients *lcoeffs;
+            lcoeffs = ff_get_luma_coefficients(in->colorspace);
+            if (!lcoeffs)
+                lcoeffs = ff_get_luma_coefficients(AVCOL_SPC_BT2020_NCL);
+
+            GLSLF(0, const vec3 luma_src = vec3(%f, %f, %f);                       ,
+                  lcoeffs->cr, lcoeffs->cg, lcoeffs->cb);
+            GLSLF(0, const float signal_peak = %f;                           ,peak);
+            GLSLF(0, const float tone_param = %f;              ,s->tonemap_param);
+            GLSLD(   transfer_funcs                                              );
+
+            GLSLC(0, float tonemap_op(float s, float peak)                       );
+            GLSLC(0, {                                                           );
+            switch (s->tonemap) {
+            case TONEMAP_LINEAR:
+                GLSLC(1, return s*tone_param / peak;                             );
+                break;
+            case TONEMAP_GAMMA:
+                GLSLC(1, float p = s > 0.05 ? s / peak : 0.05 / peak;            );
+                GLSLC(1, float v = pow(p, 1.0 / tone_param);                     );
+                GLSLC(1, return s > 0.05 ? v : (s*v / 0.05);                     );
+                break;
+            case TONEMAP_CLIP:
+                GLSLC(1, return clamp(s*tone_param, 0.0, 1.0);                   );
+                break;
+            case TONEMAP_REINHARD:
+                GLSLC(1, return s / (s + tone_param)*(peak + tone_param) / peak; );
+                break;
+            case TONEMAP_HABLE:
+                GLSLC(1, return hable_f(s) / hable_f(peak);                      );
+                break;
+            case TONEMAP_MOBIUS:
+                GLSLC(1, float j = tone_param;                                   );
+                GLSLC(1, if (s <= j)                                             );
+                GLSLC(2,     return s;                                           );
+                GLSLC(1, float a = -j*j*(peak - 1.0) / (j*j - 2.0*j + peak);     );
+                GLSLC(1, float b = (j*j - 2.0*j*peak + peak) / max(peak - 1.0, 1e-6); );
+                GLSLC(1, return (b*b + 2.0*b*j + j*j) / (b - a)*(s + a) / (s + b); );
+                break;
+            default:
+                GLSLC(1, return s;                                               );
+                break;
+            }
+            GLSLC(0, }                                                           );
+            GLSLC(0,                                                             );
+
+            GLSLC(0, vec3 tonemap_rgb(vec3 c)                                    );
+            GLSLC(0, {                                                           );
+            GLSLF(1,     c = vec3(%s(c.r), %s(c.g), %s(c.b));                      ,
+                  linearize, linearize, linearize);
+            if (in->color_trc == AVCOL_TRC_ARIB_STD_B67)
+                GLSLC(1, c = ootf_hlg(c, signal_peak);                           );
+            GLSLC(1,     float sig = max(max(c.r, c.g), max(c.b, 1e-6));         );
+            GLSLC(1,     c *= tonemap_op(sig, signal_peak) / sig;                );
+            GLSLC(1,     c = (vec4(c, 0.0) * lrgb2lrgb).rgb;                     );
+            GLSLC(1,     c = clamp(c, 0.0, 1.0);                                 );
+            GLSLC(1,     return vec3(inverse_eotf_bt1886(c.r), inverse_eotf_bt1886(c.g), inverse_eotf_bt1886(c.b)); );
+            GLSLC(0, }                                                           );
         }
 
         GLSLC(0, void main()                                                     );
@@ -203,28 +553,32 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
         GLSLF(1,     vec2 c_o = vec2(%i, %i) / in_d;               ,crop_x,crop_y);
         GLSLC(0,                                                                 );
 
-        if (s->vkctx.output_format == s->vkctx.input_format) {
+        if (!s->convert) {
             for (int i = 0; i < desc_i[1].elems; i++) {
                 GLSLF(1,  size = imageSize(output_img[%i]);                    ,i);
                 GLSLC(1,  if (IS_WITHIN(pos, size)) {                            );
-                switch (s->scaler) {
-                case F_NEAREST:
-                case F_BILINEAR:
-                    GLSLF(2, vec4 res = scale_bilinear(%i, pos, c_r, c_o);     ,i);
-                    GLSLF(2, imageStore(output_img[%i], pos, res);             ,i);
-                    break;
-                };
+                GLSLC(2,      vec2 npos = out_npos(pos, size, c_r, c_o);         );
+                GLSLF(2,      vec4 res = scale_plane(%i, npos);                ,i);
+                GLSLF(2,      imageStore(output_img[%i], pos, res);            ,i);
                 GLSLC(1, }                                                       );
             }
         } else {
-            GLSLC(1, vec4 res = scale_bilinear(0, pos, c_r, c_o);                );
-            GLSLF(1, res = rgb2yuv(res, %i);    ,s->out_range == AVCOL_RANGE_JPEG);
-            switch (s->vkctx.output_format) {
-            case AV_PIX_FMT_NV12:    GLSLC(1, write_nv12(res, pos); ); break;
-            case AV_PIX_FMT_YUV420P: GLSLC(1,  write_420(res, pos); ); break;
-            case AV_PIX_FMT_YUV444P: GLSLC(1,  write_444(res, pos); ); break;
-            default: return AVERROR(EINVAL);
-            }
+            GLSLC(1, size = imageSize(output_img[0]);                            );
+            GLSLC(1, if (!IS_WITHIN(pos, size))                                  );
+            GLSLC(2,     return;                                                 );
+            GLSLC(1, vec2 npos = out_npos(pos, size, c_r, c_o);                  );
+            GLSLF(1, vec4 res = %s(npos);       ,read_func(s->vkctx.input_format));
+            if (in_scale != 1.0)
+                GLSLF(1, res.rgb *= %f;                                 ,in_scale);
+            if (in_yuv)
+                GLSLF(1, res = yuv2rgb(res, %i); ,in->color_range == AVCOL_RANGE_JPEG);
+            if (linearize)
+                GLSLC(1, res.rgb = tonemap_rgb(res.rgb);                         );
+            if (out_yuv)
+                GLSLF(1, res = rgb2yuv(res, %i);  ,s->out_range == AVCOL_RANGE_JPEG);
+            if (out_scale != 1.0)
+                GLSLF(1, res.rgb /= %f;                                ,out_scale);
+            GLSLF(1, %s(res, pos);            ,write_func(s->vkctx.output_format));
         }
 
         GLSLC(0, }                                                               );
@@ -235,20 +589,17 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
     RET(ff_vk_init_pipeline_layout(ctx, s->pl));
     RET(ff_vk_init_compute_pipeline(ctx, s->pl));
 
-    if (s->vkctx.output_format != s->vkctx.input_format) {
+    if (s->convert) {
         const struct LumaCoefficients *lcoeffs;
-        double tmp_mat[3][3];
+        enum AVColorSpace out_csp;
+        double tmp_mat[3][3], inv_mat[3][3];
 
         struct {
             float yuv_matrix[4][4];
+            float rgb_matrix[4][4];
+            float lrgb2lrgb[4][4];
         } *par;
 
-        lcoeffs = ff_get_luma_coefficients(in->colorspace);
-        if (!lcoeffs) {
-            av_log(ctx, AV_LOG_ERROR, "Unsupported colorspace\n");
-            return AVERROR(EINVAL);
-        }
-
         err = ff_vk_create_buf(ctx, &s->params_buf,
                                sizeof(*par),
                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
@@ -260,15 +611,39 @@ static av_cold int init_filter(AVFilterContext *ctx, AVFrame *in)
         if (err)
             return err;
 
-        ff_fill_rgb2yuv_table(lcoeffs, tmp_mat);
-
         memset(par, 0, sizeof(*par));
 
-        for (int y = 0; y < 3; y++)
-            for (int x = 0; x < 3; x++)
-                par->yuv_matrix[x][y] = tmp_mat[x][y];
+        if (in_yuv) {
+            lcoeffs = ff_get_luma_coefficients(in->colorspace);
+            if (!lcoeffs) {
+                av_log(ctx, AV_LOG_ERROR, "Unsupported input colorspace\n");
+                ff_vk_unmap_buffers(ctx, &s->params_buf, 1, 0);
+                return AVERROR(EINVAL);
+            }
+            ff_fill_rgb2yuv_table(lcoeffs, tmp_mat);
+            ff_matrix_invert_3x3(tmp_mat, inv_mat);
+            fill_mat4(par->rgb_matrix, inv_mat);
+        }
 
-        par->yuv_matrix[3][3] = 1.0;
+        if (out_yuv) {
+            out_csp = s->colour_matrix;
+            if (out_csp == AVCOL_SPC_UNSPECIFIED)
+                out_csp = linearize ? AVCOL_SPC_BT709 : in->colorspace;
+            lcoeffs = ff_get_luma_coefficients(out_csp);
+            if (!lcoeffs) {
+                av_log(ctx, AV_LOG_ERROR, "Unsupported colorspace\n");
+                ff_vk_unmap_buffers(ctx, &s->params_buf, 1, 0);
+                return AVERROR(EINVAL);
+            }
+            ff_fill_rgb2yuv_table(lcoeffs, tmp_mat);
+            fill_mat4(par->yuv_matrix, tmp_mat);
+            s->colour_matrix = out_csp;
+        }
+
+        if (linearize) {
+            get_rgb2rgb_matrix(in->color_primaries, AVCOL_PRI_BT709, tmp_mat);
+            fill_mat4(par->lrgb2lrgb, tmp_mat);
+        }
 
         err = ff_vk_unmap_buffers(ctx, &s->params_buf, 1, 1);
         if (err)
@@ -415,8 +790,16 @@ static int scale_vulkan_filter_frame(AVFilterLink *link, AVFrame *in)
 
     if (s->out_range != AVCOL_RANGE_UNSPECIFIED)
         out->color_range = s->out_range;
-    if (s->vkctx.output_format != s->vkctx.input_format)
+    if (s->colour_matrix != AVCOL_SPC_UNSPECIFIED)
+        out->colorspace = s->colour_matrix;
+    if (s->convert && is_supported_yuv(s->vkctx.output_format))
         out->chroma_location = AVCHROMA_LOC_TOPLEFT;
+    if (s->tonemap != TONEMAP_NONE) {
+        out->color_trc       = AVCOL_TRC_BT709;
+        out->color_primaries = AVCOL_PRI_BT709;
+        av_frame_remove_side_data(out, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+        av_frame_remove_side_data(out, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+    }
 
     av_frame_free(&in);
 
@@ -451,14 +834,47 @@ static int scale_vulkan_config_output(AVFilterLink *outlink)
         s->vkctx.output_format = s->vkctx.input_format;
     }
 
-    if (s->vkctx.output_format != s->vkctx.input_format) {
-        if (!ff_vk_mt_is_np_rgb(s->vkctx.input_format)) {
+    s->colour_matrix = AVCOL_SPC_UNSPECIFIED;
+    if (s->colour_matrix_string) {
+        int csp = av_color_space_from_name(s->colour_matrix_string);
+        if (csp < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Invalid output color matrix.\n");
+            return AVERROR(EINVAL);
+        }
+        s->colour_matrix = csp;
+    }
+
+    s->convert = s->vkctx.output_format != s->vkctx.input_format ||
+                 s->colour_matrix != AVCOL_SPC_UNSPECIFIED ||
+                 s->tonemap != TONEMAP_NONE;
+
+    switch (s->tonemap) {
+    case TONEMAP_GAMMA:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 1.8;
+        break;
+    case TONEMAP_REINHARD:
+        if (!isnan(s->tonemap_param))
+            s->tonemap_param = (1.0 - s->tonemap_param) / s->tonemap_param;
+        break;
+    case TONEMAP_MOBIUS:
+        if (isnan(s->tonemap_param))
+            s->tonemap_param = 0.3;
+        break;
+    default:
+        break;
+    }
+    if (isnan(s->tonemap_param))
+        s->tonemap_param = 1.0;
+
+    if (s->convert) {
+        if (!ff_vk_mt_is_np_rgb(s->vkctx.input_format) &&
+            !is_supported_yuv(s->vkctx.input_format)) {
             av_log(avctx, AV_LOG_ERROR, "Unsupported input format for conversion\n");
             return AVERROR(EINVAL);
         }
-        if (s->vkctx.output_format != AV_PIX_FMT_NV12 &&
-            s->vkctx.output_format != AV_PIX_FMT_YUV420P &&
-            s->vkctx.output_format != AV_PIX_FMT_YUV444P) {
+        if (!ff_vk_mt_is_np_rgb(s->vkctx.output_format) &&
+            !is_supported_yuv(s->vkctx.output_format)) {
             av_log(avctx, AV_LOG_ERROR, "Unsupported output format\n");
             return AVERROR(EINVAL);
         }
@@ -492,6 +908,8 @@ static const AVOption scale_vulkan_options[] = {
     { "scaler", "Scaler function", OFFSET(scaler), AV_OPT_TYPE_INT, {.i64 = F_BILINEAR}, 0, F_NB, .flags = FLAGS, "scaler" },
         { "bilinear", "Bilinear interpolation (fastest)", 0, AV_OPT_TYPE_CONST, {.i64 = F_BILINEAR}, 0, 0, .flags = FLAGS, "scaler" },
         { "nearest", "Nearest (useful for pixel art)", 0, AV_OPT_TYPE_CONST, {.i64 = F_NEAREST}, 0, 0, .flags = FLAGS, "scaler" },
+        { "bicubic", "Bicubic (Catmull-Rom) interpolation", 0, AV_OPT_TYPE_CONST, {.i64 = F_BICUBIC}, 0, 0, .flags = FLAGS, "scaler" },
+        { "lanczos", "Lanczos (3 lobes) interpolation", 0, AV_OPT_TYPE_CONST, {.i64 = F_LANCZOS}, 0, 0, .flags = FLAGS, "scaler" },
     { "format", "Output video format (software format of hardware frames)", OFFSET(out_format_string), AV_OPT_TYPE_STRING, .flags = FLAGS },
     { "out_range", "Output colour range (from 0 to 2) (default 0)", OFFSET(out_range), AV_OPT_TYPE_INT, {.i64 = AVCOL_RANGE_UNSPECIFIED}, AVCOL_RANGE_UNSPECIFIED, AVCOL_RANGE_JPEG, .flags = FLAGS, "range" },
         { "full", "Full range", 0, AV_OPT_TYPE_CONST, { .i64 = AVCOL_RANGE_JPEG }, 0, 0, FLAGS, "range" },
@@ -500,6 +918,17 @@ static const AVOption scale_vulkan_options[] = {
         { "mpeg", "Limited range", 0, AV_OPT_TYPE_CONST, { .i64 = AVCOL_RANGE_MPEG }, 0, 0, FLAGS, "range" },
         { "tv", "Limited range", 0, AV_OPT_TYPE_CONST, { .i64 = AVCOL_RANGE_MPEG }, 0, 0, FLAGS, "range" },
         { "pc", "Full range", 0, AV_OPT_TYPE_CONST, { .i64 = AVCOL_RANGE_JPEG }, 0, 0, FLAGS, "range" },
+    { "out_color_matrix", "Output colour matrix coefficient set", OFFSET(colour_matrix_string), AV_OPT_TYPE_STRING, { .str = NULL }, .flags = FLAGS },
+    { "tonemap", "Tonemap HDR input to SDR BT.709", OFFSET(tonemap), AV_OPT_TYPE_INT, {.i64 = TONEMAP_NONE}, TONEMAP_NONE, TONEMAP_MAX - 1, FLAGS, "tonemap" },
+        { "none",     0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_NONE},     0, 0, FLAGS, "tonemap" },
+        { "linear",   0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_LINEAR},   0, 0, FLAGS, "tonemap" },
+        { "gamma",    0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_GAMMA},    0, 0, FLAGS, "tonemap" },
+        { "clip",     0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_CLIP},     0, 0, FLAGS, "tonemap" },
+        { "reinhard", 0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_REINHARD}, 0, 0, FLAGS, "tonemap" },
+        { "hable",    0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_HABLE},    0, 0, FLAGS, "tonemap" },
+        { "mobius",   0, 0, AV_OPT_TYPE_CONST, {.i64 = TONEMAP_MOBIUS},   0, 0, FLAGS, "tonemap" },
+    { "param", "Tonemap parameter", OFFSET(tonemap_param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
+    { "peak", "Signal peak override (0 = from frame metadata)", OFFSET(peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
     { NULL },
 };
 
@@ -22,9 +22,7 @@
  */
 
 #include "libavutil/avassert.h"
-#include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
-#include "libavutil/pixdesc.h"
 #include "libavutil/timestamp.h"
 
 #include "avfilter.h"
@@ -34,16 +32,11 @@
 typedef struct SCDetContext {
     const AVClass *class;
 
-    ptrdiff_t width[4];
-    ptrdiff_t height[4];
-    int nb_planes;
-    int bitdepth;
-    ff_scene_sad_fn sad;
-    double prev_mafd;
+    SceneScoreContext scene;
     double scene_score;
-    AVFrame *prev_picref;
     double threshold;
     int sc_pass;
+    int force_key;
 } SCDetContext;
 
 #define OFFSET(x) offsetof(SCDetContext, x)
@@ -55,6 +48,7 @@ static const AVOption scdet_options[] = {
     { "t",           "set scene change detect threshold",        OFFSET(threshold),  AV_OPT_TYPE_DOUBLE,   {.dbl = 10.},     0,  100., V|F },
     { "sc_pass",     "Set the flag to pass scene change frames", OFFSET(sc_pass),    AV_OPT_TYPE_BOOL,     {.dbl =  0  },    0,    1,  V|F },
     { "s",           "Set the flag to pass scene change frames", OFFSET(sc_pass),    AV_OPT_TYPE_BOOL,     {.dbl =  0  },    0,    1,  V|F },
+    { "force_key",   "Mark scene changes as the only key frames", OFFSET(force_key), AV_OPT_TYPE_BOOL,   {.dbl =  0  },    0,    1,  V|F },
     {NULL}
 };
 
@@ -83,66 +77,16 @@ static int query_formats(AVFilterContext *ctx)
 
 static int config_input(AVFilterLink *inlink)
 {
-    AVFilterContext *ctx = inlink->dst;
-    SCDetContext *s = ctx->priv;
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
-    int is_yuv = !(desc->flags & AV_PIX_FMT_FLAG_RGB) &&
-        (desc->flags & AV_PIX_FMT_FLAG_PLANAR) &&
-        desc->nb_components >= 3;
-
-    s->bitdepth = desc->comp[0].depth;
-    s->nb_planes = is_yuv ? 1 : av_pix_fmt_count_planes(inlink->format);
-
-    for (int plane = 0; plane < 4; plane++) {
-        ptrdiff_t line_size = av_image_get_linesize(inlink->format, inlink->w, plane);
-        s->width[plane] = line_size >> (s->bitdepth > 8);
-        s->height[plane] = inlink->h >> ((plane == 1 || plane == 2) ? desc->log2_chroma_h : 0);
-    }
-
-    s->sad = ff_scene_sad_get_fn(s->bitdepth == 8 ? 8 : 16);
-    if (!s->sad)
-        return AVERROR(EINVAL);
+    SCDetContext *s = inlink->dst->priv;
 
-    return 0;
+    return ff_scene_score_init(&s->scene, inlink);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SCDetContext *s = ctx->priv;
 
-    av_frame_free(&s->prev_picref);
-}
-
-static double get_scene_score(AVFilterContext *ctx, AVFrame *frame)
-{
-    double ret = 0;
-    SCDetContext *s = ctx->priv;
-    AVFrame *prev_picref = s->prev_picref;
-
-    if (prev_picref && frame->height == prev_picref->height
-                    && frame->width  == prev_picref->width) {
-        uint64_t sad = 0;
-        double mafd, diff;
-        uint64_t count = 0;
-
-        for (int plane = 0; plane < s->nb_planes; plane++) {
-            uint64_t plane_sad;
-            s->sad(prev_picref->data[plane], prev_picref->linesize[plane],
-                    frame->data[plane], frame->linesize[plane],
-                    s->width[plane], s->height[plane], &plane_sad);
-            sad += plane_sad;
-            count += s->width[plane] * s->height[plane];
-        }
-
-        emms_c();
-        mafd = (double)sad * 100. / count / (1ULL << s->bitdepth);
-        diff = fabs(mafd - s->prev_mafd);
-        ret  = av_clipf(FFMIN(mafd, diff), 0, 100.);
-        s->prev_mafd = mafd;
-        av_frame_free(&prev_picref);
-    }
-    s->prev_picref = av_frame_clone(frame);
-    return ret;
+    ff_scene_score_uninit(&s->scene);
 }
 
 static int set_meta(SCDetContext *s, AVFrame *frame, const char *key, const char *value)
@@ -166,9 +110,18 @@ static int activate(AVFilterContext *ctx)
 
     if (frame) {
         char buf[64];
-        s->scene_score = get_scene_score(ctx, frame);
-        snprintf(buf, sizeof(buf), "%0.3f", s->prev_mafd);
-        set_meta(s, frame, "lavfi.scd.mafd", buf);
+        double score;
+
+        // reuse the score of an upstream select or scdet instead of recomputing it
+        if (ff_scene_score_from_metadata(frame, &score)) {
+            s->scene_score = score * 100. * 100. / 256;
+        } else {
+            score = ff_scene_score(ctx, &s->scene, frame);
+            ff_scene_score_set_metadata(frame, av_clipf(score / 100., 0, 1));
+            s->scene_score = av_clipf(score * 100. / 256, 0, 100.);
+            snprintf(buf, sizeof(buf), "%0.3f", s->scene.prev_mafd * 100. / 256);
+            set_meta(s, frame, "lavfi.scd.mafd", buf);
+        }
         snprintf(buf, sizeof(buf), "%0.3f", s->scene_score);
         set_meta(s, frame, "lavfi.scd.score", buf);
 
@@ -178,6 +131,12 @@ static int activate(AVFilterContext *ctx)
             set_meta(s, frame, "lavfi.scd.time",
                     av_ts2timestr(frame->pts, &inlink->time_base));
         }
+        if (s->force_key) {
+            /* lets every encoder fed from here, e.g. through split and
+             * scale, cut at the same frames with -force_key_frames source */
+            frame->key_frame = s->scene_score > s->threshold;
+            frame->pict_type = frame->key_frame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        }
         if (s->sc_pass) {
             if (s->scene_score > s->threshold)
                 return ff_filter_frame(outlink, frame);
@@ -221,4 +180,5 @@ AVFilter ff_vf_scdet = {
     .inputs        = scdet_inputs,
     .outputs       = scdet_outputs,
     .activate      = activate,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
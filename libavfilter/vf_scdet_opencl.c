@@ -0,0 +1,323 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Scene change detection on OpenCL frames. The luma SAD is reduced on the
+ * device and only one partial sum per 16x16 block is read back.
+ */
+
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/timestamp.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "internal.h"
+#include "opencl.h"
+#include "opencl_source.h"
+#include "scene_sad.h"
+#include "video.h"
+
+#define BLOCK 16
+
+static const enum AVPixelFormat supported_formats[] = {
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_P010,
+    AV_PIX_FMT_P016,
+    AV_PIX_FMT_YUV444P16,
+};
+
+typedef struct SCDetOpenCLContext {
+    OpenCLFilterContext ocf;
+
+    int                initialized;
+    cl_kernel          kernel;
+    cl_command_queue   command_queue;
+    cl_mem             sums;
+    cl_uint           *sums_host;
+    size_t             nb_blocks;
+    int                width, height;
+
+    AVFrame *prev_picref;
+    double prev_mafd;
+    double scene_score;
+    double threshold;
+    int sc_pass;
+    int force_key;
+} SCDetOpenCLContext;
+
+static int scdet_opencl_load(AVFilterContext *avctx, int width, int height)
+{
+    SCDetOpenCLContext *s = avctx->priv;
+    cl_int cle;
+    int err;
+
+    err = ff_opencl_filter_load_program(avctx, &ff_opencl_source_scdet, 1);
+    if (err < 0)
+        goto fail;
+
+    s->command_queue = clCreateCommandQueue(s->ocf.hwctx->context,
+                                            s->ocf.hwctx->device_id,
+                                            0, &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create OpenCL "
+                     "command queue %d.\n", cle);
+
+    s->kernel = clCreateKernel(s->ocf.program, "sad", &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create kernel %d.\n", cle);
+
+    s->width     = width;
+    s->height    = height;
+    s->nb_blocks = (size_t)FFALIGN(width,  BLOCK) / BLOCK *
+                           FFALIGN(height, BLOCK) / BLOCK;
+    s->sums_host = av_malloc_array(s->nb_blocks, sizeof(*s->sums_host));
+    if (!s->sums_host) {
+        err = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    s->sums = clCreateBuffer(s->ocf.hwctx->context, 0,
+                             s->nb_blocks * sizeof(cl_uint), NULL, &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create sums buffer: %d.\n", cle);
+
+    s->initialized = 1;
+    return 0;
+
+fail:
+    CL_RELEASE_MEMORY(s->sums);
+    CL_RELEASE_KERNEL(s->kernel);
+    CL_RELEASE_QUEUE(s->command_queue);
+    s->sums          = NULL;
+    s->kernel        = NULL;
+    s->command_queue = NULL;
+    av_freep(&s->sums_host);
+    return err;
+}
+
+/**
+ * Same score as ff_scene_score(), from the luma plane only.
+ */
+static int scene_score(AVFilterContext *avctx, AVFrame *frame, double *score)
+{
+    SCDetOpenCLContext *s = avctx->priv;
+    AVFrame *prev = s->prev_picref;
+    size_t global_work[2] = { FFALIGN(s->width, BLOCK), FFALIGN(s->height, BLOCK) };
+    size_t local_work[2]  = { BLOCK, BLOCK };
+    uint64_t sad = 0;
+    double mafd, diff;
+    cl_mem src0, src1;
+    cl_int cle;
+    int err;
+
+    *score = 0;
+    if (!prev || frame->width  != s->width  || prev->width  != s->width ||
+                 frame->height != s->height || prev->height != s->height)
+        goto done;
+
+    src0 = (cl_mem)prev->data[0];
+    src1 = (cl_mem)frame->data[0];
+    CL_SET_KERNEL_ARG(s->kernel, 0, cl_mem, &src0);
+    CL_SET_KERNEL_ARG(s->kernel, 1, cl_mem, &src1);
+    CL_SET_KERNEL_ARG(s->kernel, 2, cl_mem, &s->sums);
+    CL_SET_KERNEL_ARG(s->kernel, 3, cl_int, &s->width);
+    CL_SET_KERNEL_ARG(s->kernel, 4, cl_int, &s->height);
+
+    cle = clEnqueueNDRangeKernel(s->command_queue, s->kernel, 2, NULL,
+                                 global_work, local_work, 0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to enqueue kernel: %d.\n", cle);
+
+    cle = clEnqueueReadBuffer(s->command_queue, s->sums, CL_TRUE, 0,
+                              s->nb_blocks * sizeof(cl_uint), s->sums_host,
+                              0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to read sums: %d.\n", cle);
+
+    for (size_t i = 0; i < s->nb_blocks; i++)
+        sad += s->sums_host[i];
+
+    // the kernel works in 16-bit units, the score in 8-bit ones
+    mafd = (double)sad / ((uint64_t)frame->width * frame->height) / 257.;
+    diff = fabs(mafd - s->prev_mafd);
+    *score = FFMIN(mafd, diff);
+    s->prev_mafd = mafd;
+
+done:
+    av_frame_free(&s->prev_picref);
+    s->prev_picref = av_frame_clone(frame);
+    if (!s->prev_picref)
+        return AVERROR(ENOMEM);
+    return 0;
+
+fail:
+    clFinish(s->command_queue);
+    return err;
+}
+
+static int set_meta(SCDetOpenCLContext *s, AVFrame *frame, const char *key, const char *value)
+{
+    return av_dict_set(&frame->metadata, key, value, 0);
+}
+
+static int scdet_opencl_activate(AVFilterContext *avctx)
+{
+    AVFilterLink *inlink  = avctx->inputs[0];
+    AVFilterLink *outlink = avctx->outputs[0];
+    SCDetOpenCLContext *s = avctx->priv;
+    AVFrame *frame;
+    int ret;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    ret = ff_inlink_consume_frame(inlink, &frame);
+    if (ret < 0)
+        return ret;
+
+    if (frame) {
+        char buf[64];
+        double score;
+
+        // reuse the score of an upstream select or scdet instead of recomputing it
+        if (ff_scene_score_from_metadata(frame, &score)) {
+            s->scene_score = score * 100. * 100. / 256;
+        } else {
+            ret = scene_score(avctx, frame, &score);
+            if (ret < 0) {
+                av_frame_free(&frame);
+                return ret;
+            }
+            ff_scene_score_set_metadata(frame, av_clipf(score / 100., 0, 1));
+            s->scene_score = av_clipf(score * 100. / 256, 0, 100.);
+            snprintf(buf, sizeof(buf), "%0.3f", s->prev_mafd * 100. / 256);
+            set_meta(s, frame, "lavfi.scd.mafd", buf);
+        }
+        snprintf(buf, sizeof(buf), "%0.3f", s->scene_score);
+        set_meta(s, frame, "lavfi.scd.score", buf);
+
+        if (s->scene_score > s->threshold) {
+            av_log(s, AV_LOG_INFO, "lavfi.scd.score: %.3f, lavfi.scd.time: %s\n",
+                    s->scene_score, av_ts2timestr(frame->pts, &inlink->time_base));
+            set_meta(s, frame, "lavfi.scd.time",
+                    av_ts2timestr(frame->pts, &inlink->time_base));
+        }
+        if (s->force_key) {
+            /* lets every encoder fed from here, e.g. through split and
+             * scale, cut at the same frames with -force_key_frames source */
+            frame->key_frame = s->scene_score > s->threshold;
+            frame->pict_type = frame->key_frame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        }
+        if (s->sc_pass && s->scene_score <= s->threshold)
+            av_frame_free(&frame);
+        else
+            return ff_filter_frame(outlink, frame);
+    }
+
+    FF_FILTER_FORWARD_STATUS(inlink, outlink);
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+static int scdet_opencl_config_output(AVFilterLink *outlink)
+{
+    AVFilterContext    *avctx = outlink->src;
+    AVFilterLink      *inlink = avctx->inputs[0];
+    SCDetOpenCLContext     *s = avctx->priv;
+    AVHWFramesContext *in_frames = (AVHWFramesContext*)inlink->hw_frames_ctx->data;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(supported_formats); i++) {
+        if (in_frames->sw_format == supported_formats[i])
+            break;
+    }
+    if (i == FF_ARRAY_ELEMS(supported_formats)) {
+        av_log(avctx, AV_LOG_ERROR, "Unsupported input format: %s\n",
+               av_get_pix_fmt_name(in_frames->sw_format));
+        return AVERROR(ENOSYS);
+    }
+
+    // frames are passed through untouched
+    av_buffer_unref(&outlink->hw_frames_ctx);
+    outlink->hw_frames_ctx = av_buffer_ref(inlink->hw_frames_ctx);
+    if (!outlink->hw_frames_ctx)
+        return AVERROR(ENOMEM);
+
+    if (!s->initialized)
+        return scdet_opencl_load(avctx, inlink->w, inlink->h);
+
+    return 0;
+}
+
+static av_cold void scdet_opencl_uninit(AVFilterContext *avctx)
+{
+    SCDetOpenCLContext *s = avctx->priv;
+    cl_int cle;
+
+    CL_RELEASE_MEMORY(s->sums);
+    CL_RELEASE_KERNEL(s->kernel);
+    CL_RELEASE_QUEUE(s->command_queue);
+    av_freep(&s->sums_host);
+    av_frame_free(&s->prev_picref);
+
+    ff_opencl_filter_uninit(avctx);
+}
+
+#define OFFSET(x) offsetof(SCDetOpenCLContext, x)
+#define FLAGS (AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption scdet_opencl_options[] = {
+    { "threshold",   "set scene change detect threshold",        OFFSET(threshold),  AV_OPT_TYPE_DOUBLE,   {.dbl = 10.},     0,  100., FLAGS },
+    { "t",           "set scene change detect threshold",        OFFSET(threshold),  AV_OPT_TYPE_DOUBLE,   {.dbl = 10.},     0,  100., FLAGS },
+    { "sc_pass",     "Set the flag to pass scene change frames", OFFSET(sc_pass),    AV_OPT_TYPE_BOOL,     {.dbl =  0  },    0,    1,  FLAGS },
+    { "s",           "Set the flag to pass scene change frames", OFFSET(sc_pass),    AV_OPT_TYPE_BOOL,     {.dbl =  0  },    0,    1,  FLAGS },
+    { "force_key",   "Mark scene changes as the only key frames", OFFSET(force_key), AV_OPT_TYPE_BOOL,   {.dbl =  0  },    0,    1,  FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scdet_opencl);
+
+static const AVFilterPad scdet_opencl_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = &ff_opencl_filter_config_input,
+    },
+    { NULL }
+};
+
+static const AVFilterPad scdet_opencl_outputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = &scdet_opencl_config_output,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_scdet_opencl = {
+    .name           = "scdet_opencl",
+    .description    = NULL_IF_CONFIG_SMALL("Detect video scene change"),
+    .priv_size      = sizeof(SCDetOpenCLContext),
+    .priv_class     = &scdet_opencl_class,
+    .init           = &ff_opencl_filter_init,
+    .uninit         = &scdet_opencl_uninit,
+    .query_formats  = &ff_opencl_filter_query_formats,
+    .inputs         = scdet_opencl_inputs,
+    .outputs        = scdet_opencl_outputs,
+    .activate       = &scdet_opencl_activate,
+    .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
+};
@@ -26,6 +26,7 @@
 
 #include "libavutil/bswap.h"
 #include "libavutil/adler32.h"
+#include "libavutil/detection_bbox.h"
 #include "libavutil/display.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
@@ -217,6 +218,25 @@ static void dump_sei_unregistered_metadata(AVFilterContext *ctx, AVFrameSideData
     av_log(ctx, AV_LOG_INFO, "\n");
 }
 
+static void dump_detection_bbox(AVFilterContext *ctx, AVFrameSideData *sd)
+{
+    AVDetectionBBoxHeader *header = (AVDetectionBBoxHeader *)sd->data;
+
+    av_log(ctx, AV_LOG_INFO, "detection bounding boxes:\n");
+    av_log(ctx, AV_LOG_INFO, "source: %s\n", header->source);
+    for (int i = 0; i < header->nb_bboxes; i++) {
+        AVDetectionBBox *bbox = av_get_detection_bbox(header, i);
+        av_log(ctx, AV_LOG_INFO, "index: %d,\tregion: (%d, %d) -> (%d, %d), label: %s, confidence: %d/%d.\n",
+               i, bbox->x, bbox->y, bbox->x + bbox->w, bbox->y + bbox->h,
+               bbox->detect_label, bbox->detect_confidence.num, bbox->detect_confidence.den);
+        for (int j = 0; j < bbox->classify_count; j++) {
+            av_log(ctx, AV_LOG_INFO, "\t\tclassify:  label: %s, confidence: %d/%d.\n",
+                   bbox->classify_labels[j], bbox->classify_confidences[j].num,
+                   bbox->classify_confidences[j].den);
+        }
+    }
+}
+
 static void dump_color_property(AVFilterContext *ctx, AVFrame *frame)
 {
     const char *color_range_str     = av_color_range_name(frame->color_range);
@@ -405,6 +425,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         case AV_FRAME_DATA_SEI_UNREGISTERED:
             dump_sei_unregistered_metadata(ctx, sd);
             break;
+        case AV_FRAME_DATA_DETECTION_BBOXES:
+            dump_detection_bbox(ctx, sd);
+            break;
         default:
             av_log(ctx, AV_LOG_WARNING, "unknown side data type %d (%d bytes)\n",
                    sd->type, sd->size);
@@ -132,6 +132,36 @@ static uint64_t get_block_sum(StreamContext *sc, uint64_t intpic[32][32], const
     return sum;
 }
 
+typedef struct ThreadData {
+    AVFrame *picref;
+    uint64_t (*intpic)[32];
+    const int *intjlut;
+} ThreadData;
+
+/* each job sums the pixels of a range of rows of the 32x32 block grid */
+static int block_sums(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    const AVFrame *picref = td->picref;
+    const int w = picref->width;
+    const int h = picref->height;
+    const int block_start = (32 * jobnr) / nb_jobs;
+    const int block_end = (32 * (jobnr+1)) / nb_jobs;
+    const int slice_start = (block_start * h + 31) / 32;
+    const int slice_end = (block_end * h + 31) / 32;
+    const uint8_t *p = picref->data[0] + slice_start * picref->linesize[0];
+    int i, j;
+
+    for (i = slice_start; i < slice_end; i++) {
+        uint64_t *row = td->intpic[(i*32)/h];
+        for (j = 0; j < w; j++)
+            row[td->intjlut[j]] += p[j];
+        p += picref->linesize[0];
+    }
+
+    return 0;
+}
+
 static int cmp(const uint64_t *a, const uint64_t *b)
 {
     return *a < *b ? -1 : ( *a > *b ? 1 : 0 );
@@ -163,9 +193,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     uint8_t wordt2b[5] = { 0, 0, 0, 0, 0 }; /* word ternary to binary */
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
     int *intjlut;
+    ThreadData td;
 
     uint64_t conflist[DIFFELEM_SIZE];
     int f = 0, g = 0, w = 0;
@@ -203,14 +232,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         intjlut[i] = (i*32)/inlink->w;
     }
 
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
+    td.picref = picref;
+    td.intpic = intpic;
+    td.intjlut = intjlut;
+    ctx->internal->execute(ctx, block_sums, &td, NULL,
+                           FFMIN(32, ff_filter_get_nb_threads(ctx)));
     av_freep(&intjlut);
 
     /* The following calculates a summed area table (intpic) and brings the numbers
@@ -767,5 +793,5 @@ AVFilter ff_vf_signature = {
     .query_formats = query_formats,
     .outputs       = signature_outputs,
     .inputs        = NULL,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -33,17 +33,22 @@
 #include "libavformat/avio.h"
 #include "libswscale/swscale.h"
 #include "dnn_interface.h"
+#include "dnn/dnn_io_proc.h"
 
 typedef struct SRContext {
     const AVClass *class;
 
     char *model_filename;
     DNNBackendType backend_type;
+    char *backend_options;
     DNNModule *dnn_module;
     DNNModel *model;
     DNNData input;
     DNNData output;
     int scale_factor;
+    int tile_size;
+    int tile_overlap;
+    DNNTiles tiles;
     struct SwsContext *sws_contexts[3];
     int sws_slice_h, sws_input_linesize, sws_output_linesize;
 } SRContext;
@@ -58,6 +63,9 @@ static const AVOption sr_options[] = {
 #endif
     { "scale_factor", "scale factor for SRCNN model", OFFSET(scale_factor), AV_OPT_TYPE_INT, { .i64 = 2 }, 2, 4, FLAGS },
     { "model", "path to model file specifying network architecture and its parameters", OFFSET(model_filename), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "backend_configs", "backend configs", OFFSET(backend_options), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { "tile_size", "run the model on tiles of at most this size, 0 for the whole frame", OFFSET(tile_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, FLAGS },
+    { "tile_overlap", "pixels of context around each tile", OFFSET(tile_overlap), AV_OPT_TYPE_INT, { .i64 = 16 }, 0, 1024, FLAGS },
     { NULL }
 };
 
@@ -81,7 +89,7 @@ static av_cold int init(AVFilterContext *context)
         av_log(context, AV_LOG_ERROR, "load_model for network was not specified\n");
         return AVERROR(EIO);
     }
-    sr_context->model = (sr_context->dnn_module->load_model)(sr_context->model_filename);
+    sr_context->model = (sr_context->dnn_module->load_model)(sr_context->model_filename, sr_context->backend_options);
     if (!sr_context->model){
         av_log(context, AV_LOG_ERROR, "could not load DNN model\n");
         return AVERROR(EIO);
@@ -111,19 +119,24 @@ static int query_formats(AVFilterContext *context)
     return ff_set_common_formats(context, formats_list);
 }
 
-static int config_props(AVFilterLink *inlink)
+// Sets the model input to width x height and runs it once to get the output size.
+static int set_model_input(AVFilterContext *context, int width, int height)
 {
-    AVFilterContext *context = inlink->dst;
     SRContext *sr_context = context->priv;
-    AVFilterLink *outlink = context->outputs[0];
     DNNReturnType result;
-    int sws_src_h, sws_src_w, sws_dst_h, sws_dst_w;
     const char *model_output_name = "y";
 
-    sr_context->input.width = inlink->w * sr_context->scale_factor;
-    sr_context->input.height = inlink->h * sr_context->scale_factor;
+    sr_context->input.width = width;
+    sr_context->input.height = height;
     sr_context->input.channels = 1;
 
+    if (sr_context->tile_size > 0){
+        ff_dnn_tiles_uninit(&sr_context->tiles);
+        return ff_dnn_tiles_init(&sr_context->tiles, context, sr_context->dnn_module, sr_context->model,
+                                 &sr_context->input, "x", model_output_name,
+                                 sr_context->tile_size, sr_context->tile_overlap, &sr_context->output);
+    }
+
     result = (sr_context->model->set_input_output)(sr_context->model->model, &sr_context->input, "x", &model_output_name, 1);
     if (result != DNN_SUCCESS){
         av_log(context, AV_LOG_ERROR, "could not set input and output for the model\n");
@@ -136,19 +149,25 @@ static int config_props(AVFilterLink *inlink)
         return AVERROR(EIO);
     }
 
+    return 0;
+}
+
+static int config_props(AVFilterLink *inlink)
+{
+    AVFilterContext *context = inlink->dst;
+    SRContext *sr_context = context->priv;
+    AVFilterLink *outlink = context->outputs[0];
+    int sws_src_h, sws_src_w, sws_dst_h, sws_dst_w;
+    int ret;
+
+    ret = set_model_input(context, inlink->w * sr_context->scale_factor, inlink->h * sr_context->scale_factor);
+    if (ret < 0)
+        return ret;
+
     if (sr_context->input.height != sr_context->output.height || sr_context->input.width != sr_context->output.width){
-        sr_context->input.width = inlink->w;
-        sr_context->input.height = inlink->h;
-        result = (sr_context->model->set_input_output)(sr_context->model->model, &sr_context->input, "x", &model_output_name, 1);
-        if (result != DNN_SUCCESS){
-            av_log(context, AV_LOG_ERROR, "could not set input and output for the model\n");
-            return AVERROR(EIO);
-        }
-        result = (sr_context->dnn_module->execute_model)(sr_context->model, &sr_context->output, 1);
-        if (result != DNN_SUCCESS){
-            av_log(context, AV_LOG_ERROR, "failed to execute loaded model\n");
-            return AVERROR(EIO);
-        }
+        ret = set_model_input(context, inlink->w, inlink->h);
+        if (ret < 0)
+            return ret;
         sr_context->scale_factor = 0;
     }
     outlink->h = sr_context->output.height;
@@ -233,10 +252,19 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
     av_frame_free(&in);
 
-    dnn_result = (sr_context->dnn_module->execute_model)(sr_context->model, &sr_context->output, 1);
-    if (dnn_result != DNN_SUCCESS){
-        av_log(context, AV_LOG_ERROR, "failed to execute loaded model\n");
-        return AVERROR(EIO);
+    if (sr_context->tile_size > 0){
+        int ret = ff_dnn_tiles_run(&sr_context->tiles, context);
+        if (ret < 0){
+            av_frame_free(&out);
+            return ret;
+        }
+    } else {
+        dnn_result = (sr_context->dnn_module->execute_model)(sr_context->model, &sr_context->output, 1);
+        if (dnn_result != DNN_SUCCESS){
+            av_log(context, AV_LOG_ERROR, "failed to execute loaded model\n");
+            av_frame_free(&out);
+            return AVERROR(EIO);
+        }
     }
 
     sws_scale(sr_context->sws_contexts[2], (const uint8_t *[4]){(const uint8_t *)sr_context->output.data, 0, 0, 0},
@@ -251,6 +279,7 @@ static av_cold void uninit(AVFilterContext *context)
     int i;
     SRContext *sr_context = context->priv;
 
+    ff_dnn_tiles_uninit(&sr_context->tiles);
     if (sr_context->dnn_module){
         (sr_context->dnn_module->free_model)(&sr_context->model);
         av_freep(&sr_context->dnn_module);
@@ -59,16 +59,23 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    uint8_t *temp;
+    size_t temp_size;
+    double *score[4];
+    int nb_threads;
     int is_rgb;
-    double (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    void (*ssim_plane)(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, int height, void *temp,
+                       int max, double *score, int jobnr, int nb_jobs);
     SSIMDSPContext dsp;
 } SSIMContext;
 
+typedef struct ThreadData {
+    AVFrame *main, *ref;
+} ThreadData;
+
 #define OFFSET(x) offsetof(SSIMContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
@@ -93,9 +100,9 @@ static void set_meta(AVDictionary **metadata, const char *key, char comp, float
     }
 }
 
-static void ssim_4x4xn_16bit(const uint8_t *main8, ptrdiff_t main_stride,
-                             const uint8_t *ref8, ptrdiff_t ref_stride,
-                             int64_t (*sums)[4], int width)
+void ff_ssim_4x4xn_16bit(const uint8_t *main8, ptrdiff_t main_stride,
+                         const uint8_t *ref8, ptrdiff_t ref_stride,
+                         int64_t (*sums)[4], int width)
 {
     const uint16_t *main16 = (const uint16_t *)main8;
     const uint16_t *ref16  = (const uint16_t *)ref8;
@@ -192,7 +199,7 @@ static float ssim_end1(int s1, int s2, int ss, int s12)
          / ((float)(fs1 * fs1 + fs2 * fs2 + ssim_c1) * (float)(vars + ssim_c2));
 }
 
-static float ssim_endn_16bit(const int64_t (*sum0)[4], const int64_t (*sum1)[4], int width, int max)
+float ff_ssim_endn_16bit(const int64_t (*sum0)[4], const int64_t (*sum1)[4], int width, int max)
 {
     float ssim = 0.0;
     int i;
@@ -219,51 +226,69 @@ static double ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int wid
     return ssim;
 }
 
+void ff_ssim_init(SSIMDSPContext *dsp)
+{
+    dsp->ssim_4x4_line = ssim_4x4xn_8bit;
+    dsp->ssim_end_line = ssim_endn_8bit;
+    if (ARCH_X86)
+        ff_ssim_init_x86(dsp);
+}
+
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static double ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+/* the score of the block line y needs the sums of the block lines y - 1 and y,
+ * each job stores the scores of its lines and the caller adds them in order */
+static void ssim_plane_16bit(SSIMDSPContext *dsp,
+                             uint8_t *main, int main_stride,
+                             uint8_t *ref, int ref_stride,
+                             int width, int height, void *temp,
+                             int max, double *score, int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    double ssim = 0.0;
     int64_t (*sum0)[4] = temp;
     int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
+    int slice_start, slice_end, z, y;
 
     width >>= 2;
     height >>= 2;
+    if (height < 2)
+        return;
+
+    slice_start = 1 + ((height - 1) * jobnr) / nb_jobs;
+    slice_end = 1 + ((height - 1) * (jobnr+1)) / nb_jobs;
+    z = slice_start - 1;
 
-    for (y = 1; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
-            ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
-                             &ref[4 * z * ref_stride], ref_stride,
-                             sum0, width);
+            ff_ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
+                                &ref[4 * z * ref_stride], ref_stride,
+                                sum0, width);
         }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+        score[y - 1] = ff_ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
     }
-
-    return ssim / ((height - 1) * (width - 1));
 }
 
-static double ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static void ssim_plane(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, int height, void *temp,
+                       int max, double *score, int jobnr, int nb_jobs)
 {
-    int z = 0, y;
-    double ssim = 0.0;
     int (*sum0)[4] = temp;
     int (*sum1)[4] = sum0 + SUM_LEN(width);
+    int slice_start, slice_end, z, y;
 
     width >>= 2;
     height >>= 2;
+    if (height < 2)
+        return;
+
+    slice_start = 1 + ((height - 1) * jobnr) / nb_jobs;
+    slice_end = 1 + ((height - 1) * (jobnr+1)) / nb_jobs;
+    z = slice_start - 1;
 
-    for (y = 1; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
@@ -271,8 +296,36 @@ static double ssim_plane(SSIMDSPContext *dsp,
                                sum0, width);
         }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        score[y - 1] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
     }
+}
+
+static int ssim_planes(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    void *temp = s->temp + jobnr * s->temp_size;
+    int i;
+
+    for (i = 0; i < s->nb_components; i++)
+        s->ssim_plane(&s->dsp, td->main->data[i], td->main->linesize[i],
+                      td->ref->data[i], td->ref->linesize[i],
+                      s->planewidth[i], s->planeheight[i], temp,
+                      s->max, s->score[i], jobnr, nb_jobs);
+
+    return 0;
+}
+
+static double ssim_plane_sum(const double *score, int width, int height)
+{
+    double ssim = 0.0;
+    int y;
+
+    width >>= 2;
+    height >>= 2;
+
+    for (y = 1; y < height; y++)
+        ssim += score[y - 1];
 
     return ssim / ((height - 1) * (width - 1));
 }
@@ -289,6 +342,7 @@ static int do_ssim(FFFrameSync *fs)
     AVFrame *master, *ref;
     AVDictionary **metadata;
     double c[4] = { 0 }, ssimv = 0.0;
+    ThreadData td;
     int ret, i;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
@@ -300,11 +354,12 @@ static int do_ssim(FFFrameSync *fs)
 
     s->nb_frames++;
 
+    td.main = master;
+    td.ref = ref;
+    ctx->internal->execute(ctx, ssim_planes, &td, NULL, s->nb_threads);
+
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
+        c[i] = ssim_plane_sum(s->score[i], s->planewidth[i], s->planeheight[i]);
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -410,16 +465,20 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    s->temp_size = 2 * SUM_LEN(inlink->w) * ((desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->temp = av_mallocz_array(s->nb_threads, s->temp_size);
     if (!s->temp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_components; i++) {
+        s->score[i] = av_mallocz_array(FFMAX(1, s->planeheight[i] >> 2), sizeof(*s->score[i]));
+        if (!s->score[i])
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
-    s->dsp.ssim_4x4_line = ssim_4x4xn_8bit;
-    s->dsp.ssim_end_line = ssim_endn_8bit;
-    if (ARCH_X86)
-        ff_ssim_init_x86(&s->dsp);
+    ff_ssim_init(&s->dsp);
 
     return 0;
 }
@@ -463,10 +522,10 @@ static int activate(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
+    int i;
 
     if (s->nb_frames > 0) {
         char buf[256];
-        int i;
         buf[0] = 0;
         for (i = 0; i < s->nb_components; i++) {
             int c = s->is_rgb ? s->rgba_map[i] : i;
@@ -483,6 +542,8 @@ static av_cold void uninit(AVFilterContext *ctx)
         fclose(s->stats_file);
 
     av_freep(&s->temp);
+    for (i = 0; i < 4; i++)
+        av_freep(&s->score[i]);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -518,4 +579,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
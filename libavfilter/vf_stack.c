@@ -43,6 +43,7 @@ typedef struct StackContext {
     int nb_inputs;
     char *layout;
     int shortest;
+    int64_t latency;
     int is_vertical;
     int is_horizontal;
     int nb_planes;
@@ -355,6 +356,7 @@ static int config_output(AVFilterLink *outlink)
     in = s->fs.in;
     s->fs.opaque = s;
     s->fs.on_event = process_frame;
+    s->fs.opt_latency = s->latency;
 
     for (i = 0; i < s->nb_inputs; i++) {
         AVFilterLink *inlink = ctx->inputs[i];
@@ -395,6 +397,7 @@ static int activate(AVFilterContext *ctx)
 static const AVOption stack_options[] = {
     { "inputs", "set number of inputs", OFFSET(nb_inputs), AV_OPT_TYPE_INT, {.i64=2}, 2, INT_MAX, .flags = FLAGS },
     { "shortest", "force termination when the shortest input terminates", OFFSET(shortest), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
+    { "latency", "proceed without the inputs lagging by more than this", OFFSET(latency), AV_OPT_TYPE_DURATION, {.i64=0}, 0, INT64_MAX, .flags = FLAGS },
     { NULL },
 };
 
@@ -453,6 +456,7 @@ static const AVOption xstack_options[] = {
     { "inputs", "set number of inputs", OFFSET(nb_inputs), AV_OPT_TYPE_INT, {.i64=2}, 2, INT_MAX, .flags = FLAGS },
     { "layout", "set custom layout", OFFSET(layout), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, .flags = FLAGS },
     { "shortest", "force termination when the shortest input terminates", OFFSET(shortest), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, .flags = FLAGS },
+    { "latency", "proceed without the inputs lagging by more than this", OFFSET(latency), AV_OPT_TYPE_DURATION, {.i64=0}, 0, INT64_MAX, .flags = FLAGS },
     { "fill",  "set the color for unused pixels", OFFSET(fillcolor_str), AV_OPT_TYPE_STRING, {.str = "none"}, .flags = FLAGS },
     { NULL },
 };
@@ -0,0 +1,382 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Thumbnail selection on OpenCL frames. Only the color histograms are read
+ * back to the host, the frames themselves stay on the device.
+ */
+
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "avfilter.h"
+#include "internal.h"
+#include "opencl.h"
+#include "opencl_source.h"
+#include "video.h"
+
+#define HIST_SIZE (3*256)
+#define BLOCK 16
+
+static const enum AVPixelFormat supported_formats[] = {
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV444P,
+    AV_PIX_FMT_P010,
+    AV_PIX_FMT_P016,
+    AV_PIX_FMT_YUV444P16,
+};
+
+struct thumb_frame {
+    AVFrame *buf;               ///< cached frame
+    int histogram[HIST_SIZE];   ///< color distribution histogram of the frame
+};
+
+typedef struct ThumbnailOpenCLContext {
+    OpenCLFilterContext ocf;
+
+    int                initialized;
+    cl_kernel          kernel;
+    cl_command_queue   command_queue;
+    cl_mem             hist;
+
+    int n;                      ///< current frame
+    int n_frames;               ///< number of frames for analysis
+    struct thumb_frame *frames; ///< the n_frames frames
+    AVRational tb;              ///< copy of the input timebase to ease access
+
+    const AVPixFmtDescriptor *desc;
+    int nb_planes;
+} ThumbnailOpenCLContext;
+
+static av_cold int thumbnail_opencl_init(AVFilterContext *avctx)
+{
+    ThumbnailOpenCLContext *s = avctx->priv;
+
+    s->frames = av_calloc(s->n_frames, sizeof(*s->frames));
+    if (!s->frames) {
+        av_log(avctx, AV_LOG_ERROR,
+               "Allocation failure, try to lower the number of frames\n");
+        return AVERROR(ENOMEM);
+    }
+    av_log(avctx, AV_LOG_VERBOSE, "batch size: %d frames\n", s->n_frames);
+
+    return ff_opencl_filter_init(avctx);
+}
+
+static int thumbnail_opencl_load(AVFilterContext *avctx)
+{
+    ThumbnailOpenCLContext *s = avctx->priv;
+    cl_int cle;
+    int err;
+
+    err = ff_opencl_filter_load_program(avctx, &ff_opencl_source_thumbnail, 1);
+    if (err < 0)
+        goto fail;
+
+    s->command_queue = clCreateCommandQueue(s->ocf.hwctx->context,
+                                            s->ocf.hwctx->device_id,
+                                            0, &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create OpenCL "
+                     "command queue %d.\n", cle);
+
+    s->kernel = clCreateKernel(s->ocf.program, "histogram", &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create kernel %d.\n", cle);
+
+    s->hist = clCreateBuffer(s->ocf.hwctx->context, 0,
+                             HIST_SIZE * sizeof(cl_uint), NULL, &cle);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to create histogram "
+                     "buffer: %d.\n", cle);
+
+    s->initialized = 1;
+    return 0;
+
+fail:
+    CL_RELEASE_MEMORY(s->hist);
+    CL_RELEASE_KERNEL(s->kernel);
+    CL_RELEASE_QUEUE(s->command_queue);
+    s->hist          = NULL;
+    s->kernel        = NULL;
+    s->command_queue = NULL;
+    return err;
+}
+
+/**
+ * @brief        Compute Sum-square deviation to estimate "closeness".
+ * @param hist   color distribution histogram
+ * @param median average color distribution histogram
+ * @return       sum of squared errors
+ */
+static double frame_sum_square_err(const int *hist, const double *median)
+{
+    int i;
+    double err, sum_sq_err = 0;
+
+    for (i = 0; i < HIST_SIZE; i++) {
+        err = median[i] - (double)hist[i];
+        sum_sq_err += err*err;
+    }
+    return sum_sq_err;
+}
+
+static AVFrame *get_best_frame(AVFilterContext *avctx)
+{
+    AVFrame *picref;
+    ThumbnailOpenCLContext *s = avctx->priv;
+    int i, j, best_frame_idx = 0;
+    int nb_frames = s->n;
+    double avg_hist[HIST_SIZE] = {0}, sq_err, min_sq_err = -1;
+
+    // average histogram of the N frames
+    for (j = 0; j < FF_ARRAY_ELEMS(avg_hist); j++) {
+        for (i = 0; i < nb_frames; i++)
+            avg_hist[j] += (double)s->frames[i].histogram[j];
+        avg_hist[j] /= nb_frames;
+    }
+
+    // find the frame closer to the average using the sum of squared errors
+    for (i = 0; i < nb_frames; i++) {
+        sq_err = frame_sum_square_err(s->frames[i].histogram, avg_hist);
+        if (i == 0 || sq_err < min_sq_err)
+            best_frame_idx = i, min_sq_err = sq_err;
+    }
+
+    // free and reset everything (except the best frame buffer)
+    for (i = 0; i < nb_frames; i++) {
+        memset(s->frames[i].histogram, 0, sizeof(s->frames[i].histogram));
+        if (i != best_frame_idx)
+            av_frame_free(&s->frames[i].buf);
+    }
+    s->n = 0;
+
+    // raise the chosen one
+    picref = s->frames[best_frame_idx].buf;
+    av_log(avctx, AV_LOG_INFO, "frame id #%d (pts_time=%f) selected "
+           "from a set of %d images\n", best_frame_idx,
+           picref->pts * av_q2d(s->tb), nb_frames);
+    s->frames[best_frame_idx].buf = NULL;
+
+    return picref;
+}
+
+static int compute_histogram(AVFilterContext *avctx, int *hist, AVFrame *in)
+{
+    ThumbnailOpenCLContext *s = avctx->priv;
+    const AVPixFmtDescriptor *desc = s->desc;
+    const cl_uint zero = 0;
+    size_t global_work[2];
+    size_t local_work[2] = { BLOCK, BLOCK };
+    cl_uint counts[HIST_SIZE];
+    cl_int width, height, offset, channels;
+    cl_mem src;
+    int plane, comp, i, err;
+    cl_int cle;
+
+    cle = clEnqueueFillBuffer(s->command_queue, s->hist,
+                              &zero, sizeof(zero), 0, sizeof(counts),
+                              0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to clear histogram "
+                     "buffer: %d.\n", cle);
+
+    // 256 bins per component, the interleaved chroma of NV12 and P010
+    // is counted by a single kernel run on the second plane
+    for (plane = 0; plane < s->nb_planes; plane++) {
+        offset   = -1;
+        channels = 0;
+        for (comp = 0; comp < desc->nb_components; comp++) {
+            if (desc->comp[comp].plane != plane)
+                continue;
+            if (offset < 0)
+                offset = comp * 256;
+            channels++;
+        }
+
+        // only the visible area, the surfaces may be padded
+        width  = plane ? AV_CEIL_RSHIFT(in->width,  desc->log2_chroma_w) : in->width;
+        height = plane ? AV_CEIL_RSHIFT(in->height, desc->log2_chroma_h) : in->height;
+        global_work[0] = FFALIGN(width,  BLOCK);
+        global_work[1] = FFALIGN(height, BLOCK);
+
+        src = (cl_mem)in->data[plane];
+        CL_SET_KERNEL_ARG(s->kernel, 0, cl_mem, &src);
+        CL_SET_KERNEL_ARG(s->kernel, 1, cl_mem, &s->hist);
+        CL_SET_KERNEL_ARG(s->kernel, 2, cl_int, &width);
+        CL_SET_KERNEL_ARG(s->kernel, 3, cl_int, &height);
+        CL_SET_KERNEL_ARG(s->kernel, 4, cl_int, &offset);
+        CL_SET_KERNEL_ARG(s->kernel, 5, cl_int, &channels);
+
+        cle = clEnqueueNDRangeKernel(s->command_queue, s->kernel, 2, NULL,
+                                     global_work, local_work, 0, NULL, NULL);
+        CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to enqueue kernel: %d.\n", cle);
+    }
+
+    cle = clEnqueueReadBuffer(s->command_queue, s->hist, CL_TRUE, 0,
+                              sizeof(counts), counts, 0, NULL, NULL);
+    CL_FAIL_ON_ERROR(AVERROR(EIO), "Failed to read histogram: %d.\n", cle);
+
+    // give the subsampled chroma planes the same weight as the luma one
+    for (i = 0; i < HIST_SIZE; i++)
+        hist[i] = counts[i] << (i < 256 ? 0 : desc->log2_chroma_w +
+                                               desc->log2_chroma_h);
+
+    return 0;
+
+fail:
+    clFinish(s->command_queue);
+    return err;
+}
+
+static int thumbnail_opencl_filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext      *avctx = inlink->dst;
+    ThumbnailOpenCLContext   *s = avctx->priv;
+    AVFilterLink       *outlink = avctx->outputs[0];
+    int err;
+
+    if (!frame->hw_frames_ctx) {
+        av_frame_free(&frame);
+        return AVERROR(EINVAL);
+    }
+
+    // keep a reference of each frame
+    s->frames[s->n].buf = frame;
+
+    err = compute_histogram(avctx, s->frames[s->n].histogram, frame);
+    if (err < 0) {
+        av_frame_free(&s->frames[s->n].buf);
+        return err;
+    }
+
+    // no selection until the buffer of N frames is filled up
+    s->n++;
+    if (s->n < s->n_frames)
+        return 0;
+
+    return ff_filter_frame(outlink, get_best_frame(avctx));
+}
+
+static int thumbnail_opencl_request_frame(AVFilterLink *link)
+{
+    AVFilterContext *avctx = link->src;
+    ThumbnailOpenCLContext *s = avctx->priv;
+    int ret = ff_request_frame(avctx->inputs[0]);
+
+    if (ret == AVERROR_EOF && s->n) {
+        ret = ff_filter_frame(link, get_best_frame(avctx));
+        if (ret < 0)
+            return ret;
+        ret = AVERROR_EOF;
+    }
+    if (ret < 0)
+        return ret;
+    return 0;
+}
+
+static int thumbnail_opencl_config_output(AVFilterLink *outlink)
+{
+    AVFilterContext      *avctx = outlink->src;
+    AVFilterLink        *inlink = avctx->inputs[0];
+    ThumbnailOpenCLContext   *s = avctx->priv;
+    AVHWFramesContext *in_frames = (AVHWFramesContext*)inlink->hw_frames_ctx->data;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(supported_formats); i++) {
+        if (in_frames->sw_format == supported_formats[i])
+            break;
+    }
+    if (i == FF_ARRAY_ELEMS(supported_formats)) {
+        av_log(avctx, AV_LOG_ERROR, "Unsupported input format: %s\n",
+               av_get_pix_fmt_name(in_frames->sw_format));
+        return AVERROR(ENOSYS);
+    }
+
+    s->desc      = av_pix_fmt_desc_get(in_frames->sw_format);
+    s->nb_planes = av_pix_fmt_count_planes(in_frames->sw_format);
+    s->tb        = inlink->time_base;
+
+    // the selected frames are passed through untouched
+    av_buffer_unref(&outlink->hw_frames_ctx);
+    outlink->hw_frames_ctx = av_buffer_ref(inlink->hw_frames_ctx);
+    if (!outlink->hw_frames_ctx)
+        return AVERROR(ENOMEM);
+
+    if (!s->initialized)
+        return thumbnail_opencl_load(avctx);
+
+    return 0;
+}
+
+static av_cold void thumbnail_opencl_uninit(AVFilterContext *avctx)
+{
+    ThumbnailOpenCLContext *s = avctx->priv;
+    cl_int cle;
+    int i;
+
+    CL_RELEASE_MEMORY(s->hist);
+    CL_RELEASE_KERNEL(s->kernel);
+    CL_RELEASE_QUEUE(s->command_queue);
+
+    for (i = 0; i < s->n_frames && s->frames && s->frames[i].buf; i++)
+        av_frame_free(&s->frames[i].buf);
+    av_freep(&s->frames);
+
+    ff_opencl_filter_uninit(avctx);
+}
+
+#define OFFSET(x) offsetof(ThumbnailOpenCLContext, x)
+#define FLAGS (AV_OPT_FLAG_FILTERING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption thumbnail_opencl_options[] = {
+    { "n", "set the frames batch size", OFFSET(n_frames), AV_OPT_TYPE_INT, {.i64=100}, 2, INT_MAX, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(thumbnail_opencl);
+
+static const AVFilterPad thumbnail_opencl_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = &thumbnail_opencl_filter_frame,
+        .config_props = &ff_opencl_filter_config_input,
+    },
+    { NULL }
+};
+
+static const AVFilterPad thumbnail_opencl_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = &thumbnail_opencl_config_output,
+        .request_frame = &thumbnail_opencl_request_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_thumbnail_opencl = {
+    .name           = "thumbnail_opencl",
+    .description    = NULL_IF_CONFIG_SMALL("Select the most representative frame in a given sequence of consecutive frames."),
+    .priv_size      = sizeof(ThumbnailOpenCLContext),
+    .priv_class     = &thumbnail_opencl_class,
+    .init           = &thumbnail_opencl_init,
+    .uninit         = &thumbnail_opencl_uninit,
+    .query_formats  = &ff_opencl_filter_query_formats,
+    .inputs         = thumbnail_opencl_inputs,
+    .outputs        = thumbnail_opencl_outputs,
+    .flags_internal = FF_FILTER_FLAG_HWFRAME_AWARE,
+};
@@ -48,6 +48,12 @@ typedef struct TileContext {
     uint8_t rgba_color[4];
 } TileContext;
 
+typedef struct ThreadData {
+    AVFrame *dst, *src;         ///< src is NULL to fill the rectangle with the blank color
+    unsigned dst_x, dst_y, src_x, src_y;
+    unsigned w, h;
+} ThreadData;
+
 #define OFFSET(x) offsetof(TileContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 
@@ -145,6 +151,53 @@ static int config_props(AVFilterLink *outlink)
     return 0;
 }
 
+static int copy_rectangle_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    TileContext *tile = ctx->priv;
+    ThreadData *td = arg;
+    /* keep the slices aligned to the chroma lines */
+    const unsigned align = 1 << tile->draw.vsub_max;
+    const unsigned slice_start = ((td->h * jobnr) / nb_jobs) & ~(align - 1);
+    const unsigned slice_end = jobnr == nb_jobs - 1 ? td->h :
+                               ((td->h * (jobnr+1)) / nb_jobs) & ~(align - 1);
+
+    if (slice_start >= slice_end)
+        return 0;
+
+    if (td->src)
+        ff_copy_rectangle2(&tile->draw,
+                           td->dst->data, td->dst->linesize,
+                           td->src->data, td->src->linesize,
+                           td->dst_x, td->dst_y + slice_start,
+                           td->src_x, td->src_y + slice_start,
+                           td->w, slice_end - slice_start);
+    else
+        ff_fill_rectangle(&tile->draw, &tile->blank,
+                          td->dst->data, td->dst->linesize,
+                          td->dst_x, td->dst_y + slice_start,
+                          td->w, slice_end - slice_start);
+
+    return 0;
+}
+
+static void copy_rectangle(AVFilterContext *ctx, AVFrame *dst, AVFrame *src,
+                           unsigned dst_x, unsigned dst_y,
+                           unsigned src_x, unsigned src_y,
+                           unsigned w, unsigned h)
+{
+    TileContext *tile = ctx->priv;
+    ThreadData td = {
+        .dst   = dst,   .src   = src,
+        .dst_x = dst_x, .dst_y = dst_y,
+        .src_x = src_x, .src_y = src_y,
+        .w     = w,     .h     = h,
+    };
+
+    ctx->internal->execute(ctx, copy_rectangle_slice, &td, NULL,
+                           FFMAX(1, FFMIN(h >> tile->draw.vsub_max,
+                                          ff_filter_get_nb_threads(ctx))));
+}
+
 static void get_tile_pos(AVFilterContext *ctx, unsigned *x, unsigned *y, unsigned current)
 {
     TileContext *tile    = ctx->priv;
@@ -163,9 +216,7 @@ static void draw_blank_frame(AVFilterContext *ctx, AVFrame *out_buf)
     unsigned x0, y0;
 
     get_tile_pos(ctx, &x0, &y0, tile->current);
-    ff_fill_rectangle(&tile->draw, &tile->blank,
-                      out_buf->data, out_buf->linesize,
-                      x0, y0, inlink->w, inlink->h);
+    copy_rectangle(ctx, out_buf, NULL, x0, y0, 0, 0, inlink->w, inlink->h);
     tile->current++;
 }
 
@@ -211,10 +262,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 
         /* fill surface once for margin/padding */
         if (tile->margin || tile->padding || tile->init_padding)
-            ff_fill_rectangle(&tile->draw, &tile->blank,
-                              tile->out_ref->data,
-                              tile->out_ref->linesize,
-                              0, 0, outlink->w, outlink->h);
+            copy_rectangle(ctx, tile->out_ref, NULL,
+                           0, 0, 0, 0, outlink->w, outlink->h);
         tile->init_padding = 0;
     }
 
@@ -224,19 +273,15 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
         for (i = tile->nb_frames - tile->overlap; i < tile->nb_frames; i++) {
             get_tile_pos(ctx, &x1, &y1, i);
             get_tile_pos(ctx, &x0, &y0, i - (tile->nb_frames - tile->overlap));
-            ff_copy_rectangle2(&tile->draw,
-                               tile->out_ref->data, tile->out_ref->linesize,
-                               tile->prev_out_ref->data, tile->prev_out_ref->linesize,
-                               x0, y0, x1, y1, inlink->w, inlink->h);
+            copy_rectangle(ctx, tile->out_ref, tile->prev_out_ref,
+                           x0, y0, x1, y1, inlink->w, inlink->h);
 
         }
     }
 
     get_tile_pos(ctx, &x0, &y0, tile->current);
-    ff_copy_rectangle2(&tile->draw,
-                       tile->out_ref->data, tile->out_ref->linesize,
-                       picref->data, picref->linesize,
-                       x0, y0, 0, 0, inlink->w, inlink->h);
+    copy_rectangle(ctx, tile->out_ref, picref,
+                   x0, y0, 0, 0, inlink->w, inlink->h);
 
     av_frame_free(&picref);
     if (++tile->current == tile->nb_frames)
@@ -295,4 +340,5 @@ AVFilter ff_vf_tile = {
     .inputs        = tile_inputs,
     .outputs       = tile_outputs,
     .priv_class    = &tile_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -39,6 +39,13 @@
 #include "internal.h"
 #include "video.h"
 
+/**
+ * The curve lut holds TONEMAP_LUT_SIZE + 1 samples of the tonemap curve,
+ * taken at the signal values peak * (i / TONEMAP_LUT_SIZE)^2 so that the
+ * dark part of the range, where the curves bend the most, gets most of them.
+ */
+#define TONEMAP_LUT_SIZE 4096
+
 enum TonemapAlgorithm {
     TONEMAP_NONE,
     TONEMAP_LINEAR,
@@ -69,6 +76,9 @@ typedef struct TonemapContext {
     double peak;
 
     const struct LumaCoefficients *coeffs;
+
+    float lut[TONEMAP_LUT_SIZE + 1];
+    double lut_peak;            ///< the peak the lut was built for, 0 if none
 } TonemapContext;
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -126,6 +136,37 @@ static float mobius(float in, float j, double peak)
     return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
 }
 
+static float tonemap_curve(const TonemapContext *s, float sig, double peak)
+{
+    switch(s->tonemap) {
+    default:
+    case TONEMAP_NONE:
+        // do nothing
+        break;
+    case TONEMAP_LINEAR:
+        sig = sig * s->param / peak;
+        break;
+    case TONEMAP_GAMMA:
+        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
+                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
+        break;
+    case TONEMAP_CLIP:
+        sig = av_clipf(sig * s->param, 0, 1.0f);
+        break;
+    case TONEMAP_HABLE:
+        sig = hable(sig) / hable(peak);
+        break;
+    case TONEMAP_REINHARD:
+        sig = sig / (sig + s->param) * (peak + s->param) / peak;
+        break;
+    case TONEMAP_MOBIUS:
+        sig = mobius(sig, s->param, peak);
+        break;
+    }
+
+    return sig;
+}
+
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
 static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
                     const AVPixFmtDescriptor *desc, int x, int y, double peak)
@@ -157,32 +198,7 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
      * out-of-bounds clipping */
     sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
     sig_orig = sig;
-
-    switch(s->tonemap) {
-    default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
-    }
+    sig = tonemap_curve(s, sig, peak);
 
     /* apply the computed scale factor to the color,
      * linearly to prevent discoloration */
@@ -191,10 +207,62 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     *b_out *= sig / sig_orig;
 }
 
+typedef struct TonemapParams {
+    float coeffs[3];            ///< luma coefficients of the planes
+    float desat;                ///< desaturation strength, 0 to disable
+    float lut_scale;            ///< TONEMAP_LUT_SIZE^2 / peak
+} TonemapParams;
+
+/* returns nonzero if the signal of some pixels exceeds the peak of the lut */
+static int tonemap_line(float *dst0, float *dst1, float *dst2,
+                        const float *src0, const float *src1, const float *src2,
+                        const float *lut, const TonemapParams *params, int w)
+{
+    int over = 0;
+
+    for (int x = 0; x < w; x++) {
+        float c0 = src0[x], c1 = src1[x], c2 = src2[x];
+        float sig, pos, frac, scale;
+        int i;
+
+        if (params->desat > 0) {
+            float luma = params->coeffs[0] * c0 + params->coeffs[1] * c1 + params->coeffs[2] * c2;
+            float overbright = FFMAX(luma - params->desat, 1e-6f) / FFMAX(luma, 1e-6f);
+            c0 = MIX(c0, luma, overbright);
+            c1 = MIX(c1, luma, overbright);
+            c2 = MIX(c2, luma, overbright);
+        }
+
+        sig = FFMAX(FFMAX3(c0, c1, c2), 1e-6f);
+        pos = sqrtf(sig * params->lut_scale);
+        over |= pos > TONEMAP_LUT_SIZE;
+        pos   = FFMIN(pos, TONEMAP_LUT_SIZE);
+        i     = FFMIN((int)pos, TONEMAP_LUT_SIZE - 1);
+        frac  = pos - i;
+        scale = (lut[i] + (lut[i + 1] - lut[i]) * frac) / sig;
+
+        dst0[x] = c0 * scale;
+        dst1[x] = c1 * scale;
+        dst2[x] = c2 * scale;
+    }
+
+    return over;
+}
+
+static void build_lut(TonemapContext *s, double peak)
+{
+    for (int i = 0; i <= TONEMAP_LUT_SIZE; i++) {
+        float u = i / (float)TONEMAP_LUT_SIZE;
+        s->lut[i] = tonemap_curve(s, peak * u * u, peak);
+    }
+    s->lut_peak = peak;
+}
+
 typedef struct ThreadData {
     AVFrame *in, *out;
     const AVPixFmtDescriptor *desc;
     double peak;
+    TonemapParams params;
 } ThreadData;
 
 static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
@@ -208,9 +276,21 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
     double peak = td->peak;
 
-    for (int y = slice_start; y < slice_end; y++)
-        for (int x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    /* r, b and g follow the naming of tonemap() */
+    for (int y = slice_start; y < slice_end; y++) {
+        const float *r_in = (const float *)(in->data[0] + y * in->linesize[0]);
+        const float *b_in = (const float *)(in->data[1] + y * in->linesize[1]);
+        const float *g_in = (const float *)(in->data[2] + y * in->linesize[2]);
+        float *r_out = (float *)(out->data[0] + y * out->linesize[0]);
+        float *b_out = (float *)(out->data[1] + y * out->linesize[1]);
+        float *g_out = (float *)(out->data[2] + y * out->linesize[2]);
+
+        /* the signal goes above the peak, outside of the lut */
+        if (tonemap_line(r_out, b_out, g_out, r_in, b_in, g_in,
+                         s->lut, &td->params, out->width))
+            for (int x = 0; x < out->width; x++)
+                tonemap(s, out, in, desc, x, y, peak);
+    }
 
     return 0;
 }
@@ -270,11 +350,19 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         s->desat = 0;
     }
 
+    if (peak != s->lut_peak)
+        build_lut(s, peak);
+
     /* do the tone map */
     td.out = out;
     td.in = in;
     td.desc = desc;
     td.peak = peak;
+    td.params.coeffs[0] = s->desat > 0 ? s->coeffs->cr : 0;
+    td.params.coeffs[1] = s->desat > 0 ? s->coeffs->cb : 0;
+    td.params.coeffs[2] = s->desat > 0 ? s->coeffs->cg : 0;
+    td.params.desat     = s->desat;
+    td.params.lut_scale = TONEMAP_LUT_SIZE * TONEMAP_LUT_SIZE / peak;
     ctx->internal->execute(ctx, tonemap_slice, &td, NULL, FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
 
     /* copy/generate alpha if needed */
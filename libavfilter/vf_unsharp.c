@@ -57,13 +57,57 @@ typedef struct TheadData {
     int height;
 } ThreadData;
 
+/*
+ * Run a row through the horizontal sum cascade, in place: nb_sr times, sum
+ * the neighbouring elements, buf[x] += buf[x + 1]. buf holds w + nb_sr
+ * elements on input and the w sums on output.
+ */
+static void hsum(uint32_t *buf, int nb_sr, int w)
+{
+    // two stages per pass, nb_sr is even
+    for (int z = 0; z < nb_sr; z += 2) {
+        const int len = w + nb_sr - 2 - z;
+        for (int x = 0; x < len; x++)
+            buf[x] += 2 * buf[x + 1] + buf[x + 2];
+    }
+}
+
+/* Run the horizontal sums of a row through the vertical sum cascade. */
+static void vsum(uint32_t *sum, uint32_t *const *sc, int nb_sc, int w)
+{
+    for (int z = 0; z < nb_sc; z += 2) {
+        uint32_t *sc0 = sc[z + 0], *sc1 = sc[z + 1];
+
+        for (int x = 0; x < w; x++) {
+            uint32_t tmp1 = sum[x];
+            uint32_t tmp2 = sc0[x] + tmp1;
+
+            sc0[x] = tmp1;
+            sum[x] = sc1[x] + tmp2;
+            sc1[x] = tmp2;
+        }
+    }
+}
+
+static void apply_row(uint8_t *dst, const uint8_t *src, const uint32_t *sum,
+                      int w, int amount, int scalebits, int32_t halfscale)
+{
+    for (int x = 0; x < w; x++) {
+        int32_t res = (int32_t)src[x] + ((((int32_t)src[x] - (int32_t)((sum[x] + halfscale) >> scalebits)) * amount) >> 16);
+        dst[x] = av_clip_uint8(res);
+    }
+}
+
+/*
+ * The matrix is applied as a cascade of sums of neighbouring elements,
+ * 2 * steps_x along the rows then 2 * steps_y along the columns, which sums
+ * the pixels weighted by binomial coefficients. The pixels are replicated
+ * past the edges.
+ */
 static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     ThreadData *td = arg;
     UnsharpFilterParam *fp = td->fp;
-    uint32_t **sc = fp->sc;
-    uint32_t *sr = fp->sr;
-    const uint8_t *src2 = NULL;  //silence a warning
     const int amount = fp->amount;
     const int steps_x = fp->steps_x;
     const int steps_y = fp->steps_y;
@@ -76,15 +120,11 @@ static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     const int src_stride = td->src_stride;
     const int width = td->width;
     const int height = td->height;
-    const int sc_offset = jobnr * 2 * steps_y;
-    const int sr_offset = jobnr * (MAX_MATRIX_SIZE - 1);
+    uint32_t *const *sc = fp->sc + jobnr * 2 * steps_y;
+    uint32_t *sr = fp->sr + jobnr * (width + 2 * steps_x);
     const int slice_start = (height * jobnr) / nb_jobs;
     const int slice_end = (height * (jobnr+1)) / nb_jobs;
 
-    int32_t res;
-    int x, y, z;
-    uint32_t tmp1, tmp2;
-
     if (!amount) {
         av_image_copy_plane(dst + slice_start * dst_stride, dst_stride,
                             src + slice_start * src_stride, src_stride,
@@ -92,42 +132,28 @@ static int unsharp_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
         return 0;
     }
 
-    for (y = 0; y < 2 * steps_y; y++)
-        memset(sc[sc_offset + y], 0, sizeof(sc[y][0]) * (width + 2 * steps_x));
+    for (int z = 0; z < 2 * steps_y; z++)
+        memset(sc[z], 0, sizeof(sc[z][0]) * width);
 
-    // if this is not the first tile, we start from (slice_start - steps_y),
-    // so we can get smooth result at slice boundary
-    if (slice_start > steps_y) {
-        src += (slice_start - steps_y) * src_stride;
-        dst += (slice_start - steps_y) * dst_stride;
-    }
+    // the slice starts steps_y lines early, so that the result is smooth
+    // at the slice boundaries
+    for (int y = slice_start - steps_y; y < slice_end + steps_y; y++) {
+        const uint8_t *src2 = src + av_clip(y, 0, height - 1) * src_stride;
 
-    for (y = -steps_y + slice_start; y < steps_y + slice_end; y++) {
-        if (y < height)
-            src2 = src;
-
-        memset(sr + sr_offset, 0, sizeof(sr[0]) * (2 * steps_x - 1));
-        for (x = -steps_x; x < width + steps_x; x++) {
-            tmp1 = x <= 0 ? src2[0] : x >= width ? src2[width-1] : src2[x];
-            for (z = 0; z < steps_x * 2; z += 2) {
-                tmp2 = sr[sr_offset + z + 0] + tmp1; sr[sr_offset + z + 0] = tmp1;
-                tmp1 = sr[sr_offset + z + 1] + tmp2; sr[sr_offset + z + 1] = tmp2;
-            }
-            for (z = 0; z < steps_y * 2; z += 2) {
-                tmp2 = sc[sc_offset + z + 0][x + steps_x] + tmp1; sc[sc_offset + z + 0][x + steps_x] = tmp1;
-                tmp1 = sc[sc_offset + z + 1][x + steps_x] + tmp2; sc[sc_offset + z + 1][x + steps_x] = tmp2;
-            }
-            if (x >= steps_x && y >= (steps_y + slice_start)) {
-                const uint8_t *srx = src - steps_y * src_stride + x - steps_x;
-                uint8_t *dsx       = dst - steps_y * dst_stride + x - steps_x;
-
-                res = (int32_t)*srx + ((((int32_t) * srx - (int32_t)((tmp1 + halfscale) >> scalebits)) * amount) >> 16);
-                *dsx = av_clip_uint8(res);
-            }
+        for (int x = 0; x < steps_x; x++) {
+            sr[x] = src2[0];
+            sr[width + steps_x + x] = src2[width - 1];
         }
-        if (y >= 0) {
-            dst += dst_stride;
-            src += src_stride;
+        for (int x = 0; x < width; x++)
+            sr[steps_x + x] = src2[x];
+        hsum(sr, 2 * steps_x, width);
+        vsum(sr, sc, 2 * steps_y, width);
+
+        if (y >= slice_start + steps_y) {
+            uint8_t *dsx       = dst + (y - steps_y) * dst_stride;
+            const uint8_t *srx = src + (y - steps_y) * src_stride;
+
+            apply_row(dsx, srx, sr, width, amount, scalebits, halfscale);
         }
     }
     return 0;
@@ -217,13 +243,14 @@ static int init_filter_param(AVFilterContext *ctx, UnsharpFilterParam *fp, const
     av_log(ctx, AV_LOG_VERBOSE, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    fp->sr = av_malloc_array((MAX_MATRIX_SIZE - 1) * s->nb_threads, sizeof(uint32_t));
+    fp->sr = av_mallocz_array((width + 2 * fp->steps_x) * s->nb_threads,
+                              sizeof(uint32_t));
     fp->sc = av_mallocz_array(2 * fp->steps_y * s->nb_threads, sizeof(uint32_t *));
     if (!fp->sr || !fp->sc)
         return AVERROR(ENOMEM);
 
     for (z = 0; z < 2 * fp->steps_y * s->nb_threads; z++)
-        if (!(fp->sc[z] = av_malloc_array(width + 2 * fp->steps_x,
+        if (!(fp->sc[z] = av_malloc_array(width,
                                           sizeof(*(fp->sc[z])))))
             return AVERROR(ENOMEM);
 
@@ -36,9 +36,11 @@
 #include <math.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
@@ -50,6 +52,25 @@ typedef struct ThreadData {
     AVFrame *out;
 } ThreadData;
 
+/**
+ * Remap tables, shared between the instances with the same parameters.
+ */
+typedef struct V360Maps {
+    char *key;
+    AVBufferRef *cache_ref;     ///< the reference held by the cache
+    struct V360Maps *next;
+
+    int16_t *u[2], *v[2];
+    int16_t *ker[2];
+    uint8_t *mask;
+    float *grid[2];
+    int32_t *cells[2];
+    int16_t *exact[2];
+} V360Maps;
+
+static AVMutex maps_lock = AV_MUTEX_INITIALIZER;
+static V360Maps *maps_cache;
+
 #define OFFSET(x) offsetof(V360Context, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 #define TFLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_RUNTIME_PARAM
@@ -159,6 +180,7 @@ static const AVOption v360_options[] = {
     {    "iv_fov", "input vertical field of view",  OFFSET(iv_fov), AV_OPT_TYPE_FLOAT,  {.dbl=45.f},     0.00001f,               360.f,TFLAGS, "iv_fov"},
     {    "id_fov", "input diagonal field of view",  OFFSET(id_fov), AV_OPT_TYPE_FLOAT,  {.dbl=0.f},           0.f,               360.f,TFLAGS, "id_fov"},
     {"alpha_mask", "build mask in alpha plane",      OFFSET(alpha), AV_OPT_TYPE_BOOL,   {.i64=0},               0,                   1, FLAGS, "alpha"},
+    {  "map_step", "remap tables step",         OFFSET(map_step), AV_OPT_TYPE_INT,    {.i64=1},               1,                  64, FLAGS, "map_step"},
     { NULL }
 };
 
@@ -326,6 +348,135 @@ DEFINE_REMAP(2, 16)
 DEFINE_REMAP(3, 16)
 DEFINE_REMAP(4, 16)
 
+/**
+ * Rebuild the remap data of an output line from the compact tables.
+ *
+ * The input coordinates are interpolated between the grid points around the
+ * line, the cells across a discontinuity of the projection have their exact
+ * data stored instead.
+ */
+static void compact_line(const V360Context *s, int p, int y,
+                         int16_t *u, int16_t *v, int16_t *ker)
+{
+    const int step = s->map_step;
+    const int elements = s->elements;
+    const int ws = elements == 16 ? 4 : elements == 9 ? 3 : elements == 4 ? 2 : 1;
+    const int off = ws == 4;
+    const int t = s->in_transpose;
+    const int width = s->pr_width[p];
+    const int height = s->pr_height[p];
+    const int in_width = s->inplanewidth[p];
+    const int in_height = s->inplaneheight[p];
+    const int gw = s->grid_width[p];
+    const int gy = y / step;
+    const int y0 = gy * step;
+    const int y1 = FFMIN(y0 + step, height - 1);
+    const float ty = y1 > y0 ? (float)(y - y0) / (y1 - y0) : 0.f;
+    const float *g0 = s->grid[p] + gy * gw * 2;
+    const float *g1 = g0 + gw * 2;
+    const int32_t *cells = s->cells[p] + gy * (gw - 1);
+    const int row = step * elements;
+
+    for (int cx = 0; cx < gw - 1; cx++) {
+        const int x0 = cx * step;
+        const int x1 = FFMIN(x0 + step, width - 1);
+        const int xend = FFMIN(x0 + step, width);
+        float lu, lv, ru, rv;
+
+        if (cells[cx] >= 0) {
+            const int16_t *e = s->exact[p] + ((int64_t)cells[cx] * step + y - y0) * row * 3;
+            const int n = (xend - x0) * elements;
+
+            memcpy(u   + x0 * elements, e,           n * sizeof(*u));
+            memcpy(v   + x0 * elements, e + row,     n * sizeof(*v));
+            memcpy(ker + x0 * elements, e + row * 2, n * sizeof(*ker));
+            continue;
+        }
+
+        lu = g0[cx * 2    ] + (g1[cx * 2    ] - g0[cx * 2    ]) * ty;
+        lv = g0[cx * 2 + 1] + (g1[cx * 2 + 1] - g0[cx * 2 + 1]) * ty;
+        ru = g0[cx * 2 + 2] + (g1[cx * 2 + 2] - g0[cx * 2 + 2]) * ty;
+        rv = g0[cx * 2 + 3] + (g1[cx * 2 + 3] - g0[cx * 2 + 3]) * ty;
+
+        for (int x = x0; x < xend; x++) {
+            const float tx = x1 > x0 ? (float)(x - x0) / (x1 - x0) : 0.f;
+            const float fu = lu + (ru - lu) * tx;
+            const float fv = lv + (rv - lv) * tx;
+            const int ui = floorf(fu);
+            const int vi = floorf(fv);
+            const int pu = lrintf((fu - ui) * V360_PHASES);
+            const int pv = lrintf((fv - vi) * V360_PHASES);
+            int16_t *uu = u + x * elements;
+            int16_t *vv = v + x * elements;
+            int16_t *kk = ker + x * elements;
+
+            if (ws == 1) {
+                uu[0] = av_clip(ui + (pu > V360_PHASES / 2), 0, in_width  - 1);
+                vv[0] = av_clip(vi + (pv > V360_PHASES / 2), 0, in_height - 1);
+                continue;
+            }
+
+            /* the window is transposed along with the input */
+            for (int i = 0; i < ws; i++) {
+                for (int j = 0; j < ws; j++) {
+                    uu[i * ws + j] = av_clip(ui + (t ? i : j) - off, 0, in_width  - 1);
+                    vv[i * ws + j] = av_clip(vi + (t ? j : i) - off, 0, in_height - 1);
+                    kk[i * ws + j] = lrintf(s->coeffs[t ? pv : pu][j] *
+                                            s->coeffs[t ? pu : pv][i] * 16385.f);
+                }
+            }
+        }
+    }
+}
+
+static int remap_compact_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    const V360Context *s = ctx->priv;
+    const AVFrame *in = td->in;
+    AVFrame *out = td->out;
+    const int bytes = s->mask_size;
+    const int line_size = s->uv_linesize[0] * s->elements;
+    int16_t *u   = s->line_buf + jobnr * line_size * 3;
+    int16_t *v   = u + line_size;
+    int16_t *ker = v + line_size;
+
+    for (int p = 0; p < s->nb_allocated; p++) {
+        const int height = s->pr_height[p];
+        const int slice_start = (height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+        for (int y = slice_start; y < slice_end; y++) {
+            compact_line(s, p, y, u, v, ker);
+
+            for (int stereo = 0; stereo < 1 + s->out_stereo > STEREO_2D; stereo++) {
+                for (int plane = 0; plane < s->nb_planes; plane++) {
+                    const int in_linesize  = in->linesize[plane];
+                    const int out_linesize = out->linesize[plane];
+                    const int in_offset_w = stereo ? s->in_offset_w[plane] : 0;
+                    const int in_offset_h = stereo ? s->in_offset_h[plane] : 0;
+                    const int out_offset_w = stereo ? s->out_offset_w[plane] : 0;
+                    const int out_offset_h = stereo ? s->out_offset_h[plane] : 0;
+                    const uint8_t *const src = in->data[plane] +
+                                               in_offset_h * in_linesize + in_offset_w * bytes;
+                    uint8_t *dst = out->data[plane] + (out_offset_h + y) * out_linesize +
+                                   out_offset_w * bytes;
+                    const int width = s->pr_width[plane];
+
+                    if (s->map[plane] != p)
+                        continue;
+                    if (plane == 3 && s->mask)
+                        memcpy(dst, s->mask + y * width * bytes, width * bytes);
+                    else
+                        s->remap_line(dst, width, src, in_linesize, u, v, ker);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
 #define DEFINE_REMAP_LINE(ws, bits, div)                                                      \
 static void remap##ws##_##bits##bit_line_c(uint8_t *dst, int width, const uint8_t *const src, \
                                            ptrdiff_t in_linesize,                             \
@@ -430,6 +581,18 @@ static void bilinear_kernel(float du, float dv, const XYRemap *rmap,
     ker[3] = lrintf(       du  *        dv  * 16385.f);
 }
 
+/**
+ * Calculate 1-dimensional linear coefficients.
+ *
+ * @param t relative coordinate
+ * @param coeffs coefficients
+ */
+static void calculate_bilinear_coeffs(float t, float *coeffs)
+{
+    coeffs[0] = 1.f - t;
+    coeffs[1] = t;
+}
+
 /**
  * Calculate 1-dimensional lagrange coefficients.
  *
@@ -3831,25 +3994,151 @@ static inline void mirror(const float *modifier, float *vec)
     vec[2] *= modifier[2];
 }
 
-static int allocate_plane(V360Context *s, int sizeof_uv, int sizeof_ker, int sizeof_mask, int p)
+static void maps_free(void *opaque, uint8_t *data)
 {
-    if (!s->u[p])
-        s->u[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_uv);
-    if (!s->v[p])
-        s->v[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_uv);
-    if (!s->u[p] || !s->v[p])
-        return AVERROR(ENOMEM);
-    if (sizeof_ker) {
-        if (!s->ker[p])
-            s->ker[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_ker);
-        if (!s->ker[p])
+    V360Maps *m = (V360Maps *)data;
+
+    for (int p = 0; p < 2; p++) {
+        av_freep(&m->u[p]);
+        av_freep(&m->v[p]);
+        av_freep(&m->ker[p]);
+        av_freep(&m->grid[p]);
+        av_freep(&m->cells[p]);
+        av_freep(&m->exact[p]);
+    }
+    av_freep(&m->mask);
+    av_freep(&m->key);
+    av_free(m);
+}
+
+static void set_maps(V360Context *s)
+{
+    V360Maps *m = (V360Maps *)s->maps->data;
+
+    for (int p = 0; p < 2; p++) {
+        s->u[p]     = m->u[p];
+        s->v[p]     = m->v[p];
+        s->ker[p]   = m->ker[p];
+        s->grid[p]  = m->grid[p];
+        s->cells[p] = m->cells[p];
+        s->exact[p] = m->exact[p];
+    }
+    s->mask = m->mask;
+}
+
+static void release_maps(V360Context *s)
+{
+    if (!s->maps)
+        return;
+
+    ff_mutex_lock(&maps_lock);
+    {
+        V360Maps *m = (V360Maps *)s->maps->data;
+
+        /* the last user drops the tables from the cache */
+        if (m->cache_ref && av_buffer_get_ref_count(s->maps) == 2) {
+            V360Maps **mp = &maps_cache;
+
+            while (*mp != m)
+                mp = &(*mp)->next;
+            *mp = m->next;
+            av_buffer_unref(&m->cache_ref);
+        }
+        av_buffer_unref(&s->maps);
+    }
+    ff_mutex_unlock(&maps_lock);
+}
+
+static AVBufferRef *find_maps(const char *key)
+{
+    AVBufferRef *ref = NULL;
+
+    ff_mutex_lock(&maps_lock);
+    for (V360Maps *m = maps_cache; m; m = m->next) {
+        if (!strcmp(m->key, key)) {
+            ref = av_buffer_ref(m->cache_ref);
+            break;
+        }
+    }
+    ff_mutex_unlock(&maps_lock);
+
+    return ref;
+}
+
+/**
+ * Add the tables just calculated to the cache, or use the ones another
+ * instance added in the meantime.
+ */
+static int insert_maps(V360Context *s)
+{
+    V360Maps *m = (V360Maps *)s->maps->data;
+    AVBufferRef *ref;
+    int ret = 0;
+
+    if ((ref = find_maps(m->key))) {
+        av_buffer_unref(&s->maps);
+        s->maps = ref;
+        return 0;
+    }
+
+    ff_mutex_lock(&maps_lock);
+    m->cache_ref = av_buffer_ref(s->maps);
+    if (m->cache_ref) {
+        m->next = maps_cache;
+        maps_cache = m;
+    } else {
+        ret = AVERROR(ENOMEM);
+    }
+    ff_mutex_unlock(&maps_lock);
+
+    return ret;
+}
+
+static char *maps_key(AVFilterContext *ctx)
+{
+    V360Context *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    char *opts, *key;
+
+    if (av_opt_serialize(s, AV_OPT_FLAG_FILTERING_PARAM, 0, &opts, '=', ':') < 0)
+        return NULL;
+    key = av_asprintf("%s:%dx%d:%s", opts, inlink->w, inlink->h,
+                      av_get_pix_fmt_name(inlink->format));
+    av_free(opts);
+
+    return key;
+}
+
+static int allocate_plane(V360Context *s, V360Maps *m, int sizeof_uv, int sizeof_ker,
+                          int sizeof_mask, int p)
+{
+    const int step = s->map_step;
+
+    if (step > 1) {
+        const int cw = (s->pr_width[p]  + step - 1) / step;
+        const int ch = (s->pr_height[p] + step - 1) / step;
+
+        s->grid_width[p]  = cw + 1;
+        s->grid_height[p] = ch + 1;
+        m->grid[p]  = av_malloc_array((cw + 1) * (ch + 1), 2 * sizeof(*m->grid[p]));
+        m->cells[p] = av_malloc_array(cw * ch, sizeof(*m->cells[p]));
+        if (!m->grid[p] || !m->cells[p])
             return AVERROR(ENOMEM);
+    } else {
+        m->u[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_uv);
+        m->v[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_uv);
+        if (!m->u[p] || !m->v[p])
+            return AVERROR(ENOMEM);
+        if (sizeof_ker) {
+            m->ker[p] = av_calloc(s->uv_linesize[p] * s->pr_height[p], sizeof_ker);
+            if (!m->ker[p])
+                return AVERROR(ENOMEM);
+        }
     }
 
     if (sizeof_mask && !p) {
-        if (!s->mask)
-            s->mask = av_calloc(s->pr_width[p] * s->pr_height[p], sizeof_mask);
-        if (!s->mask)
+        m->mask = av_calloc(s->pr_width[p] * s->pr_height[p], sizeof_mask);
+        if (!m->mask)
             return AVERROR(ENOMEM);
     }
 
@@ -3933,22 +4222,59 @@ static void set_dimensions(int *outw, int *outh, int w, int h, const AVPixFmtDes
     outh[0] = outh[3] = h;
 }
 
+/**
+ * Calculate the input window of an output pixel.
+ *
+ * @return 1 if the pixel is mapped, 0 otherwise
+ */
+static av_always_inline int map_pixel(const V360Context *s, int p, int i, int j,
+                                      XYRemap *rmap, float *du, float *dv)
+{
+    const int width = s->pr_width[p];
+    const int height = s->pr_height[p];
+    const int in_width = s->inplanewidth[p];
+    const int in_height = s->inplaneheight[p];
+    int in_mask, out_mask;
+    float vec[3];
+
+    if (s->out_transpose)
+        out_mask = s->out_transform(s, j, i, height, width, vec);
+    else
+        out_mask = s->out_transform(s, i, j, width, height, vec);
+    av_assert1(!isnan(vec[0]) && !isnan(vec[1]) && !isnan(vec[2]));
+    rotate(s->rot_mat, vec);
+    av_assert1(!isnan(vec[0]) && !isnan(vec[1]) && !isnan(vec[2]));
+    normalize_vector(vec);
+    mirror(s->output_mirror_modifier, vec);
+    if (s->in_transpose)
+        in_mask = s->in_transform(s, vec, in_height, in_width, rmap->v, rmap->u, du, dv);
+    else
+        in_mask = s->in_transform(s, vec, in_width, in_height, rmap->u, rmap->v, du, dv);
+    av_assert1(!isnan(*du) && !isnan(*dv));
+
+    return out_mask & in_mask;
+}
+
+static void set_mask(V360Context *s, int i, int j, int mapped)
+{
+    if (s->mask_size == 1)
+        s->mask[j * s->pr_width[0] + i] = 255 * mapped;
+    else
+        ((uint16_t *)s->mask)[j * s->pr_width[0] + i] = s->max_value * mapped;
+}
+
 // Calculate remap data
 static av_always_inline int v360_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     V360Context *s = ctx->priv;
 
     for (int p = 0; p < s->nb_allocated; p++) {
-        const int max_value = s->max_value;
         const int width = s->pr_width[p];
         const int uv_linesize = s->uv_linesize[p];
         const int height = s->pr_height[p];
-        const int in_width = s->inplanewidth[p];
-        const int in_height = s->inplaneheight[p];
         const int slice_start = (height *  jobnr     ) / nb_jobs;
         const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
         float du, dv;
-        float vec[3];
         XYRemap rmap;
 
         for (int j = slice_start; j < slice_end; j++) {
@@ -3956,31 +4282,160 @@ static av_always_inline int v360_slice(AVFilterContext *ctx, void *arg, int jobn
                 int16_t *u = s->u[p] + (j * uv_linesize + i) * s->elements;
                 int16_t *v = s->v[p] + (j * uv_linesize + i) * s->elements;
                 int16_t *ker = s->ker[p] + (j * uv_linesize + i) * s->elements;
-                uint8_t *mask8 = p ? NULL : s->mask + (j * s->pr_width[0] + i);
-                uint16_t *mask16 = p ? NULL : (uint16_t *)s->mask + (j * s->pr_width[0] + i);
-                int in_mask, out_mask;
-
-                if (s->out_transpose)
-                    out_mask = s->out_transform(s, j, i, height, width, vec);
-                else
-                    out_mask = s->out_transform(s, i, j, width, height, vec);
-                av_assert1(!isnan(vec[0]) && !isnan(vec[1]) && !isnan(vec[2]));
-                rotate(s->rot_mat, vec);
-                av_assert1(!isnan(vec[0]) && !isnan(vec[1]) && !isnan(vec[2]));
-                normalize_vector(vec);
-                mirror(s->output_mirror_modifier, vec);
-                if (s->in_transpose)
-                    in_mask = s->in_transform(s, vec, in_height, in_width, rmap.v, rmap.u, &du, &dv);
-                else
-                    in_mask = s->in_transform(s, vec, in_width, in_height, rmap.u, rmap.v, &du, &dv);
-                av_assert1(!isnan(du) && !isnan(dv));
+                const int mapped = map_pixel(s, p, i, j, &rmap, &du, &dv);
+
                 s->calculate_kernel(du, dv, &rmap, u, v, ker);
 
-                if (!p && s->mask) {
-                    if (s->mask_size == 1) {
-                        mask8[0] = 255 * (out_mask & in_mask);
-                    } else {
-                        mask16[0] = max_value * (out_mask & in_mask);
+                if (!p && s->mask)
+                    set_mask(s, i, j, mapped);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int is_contiguous(const V360Context *s, const XYRemap *rmap)
+{
+    const int t = s->in_transpose;
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (rmap->u[i][j] != rmap->u[1][1] + (t ? i : j) - 1 ||
+                rmap->v[i][j] != rmap->v[1][1] + (t ? j : i) - 1)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Get the input coordinates of the center of the interpolation window; with
+ * a transposed input, du and dv are relative to v and u.
+ */
+static void window_position(const V360Context *s, const XYRemap *rmap,
+                            float du, float dv, float *fu, float *fv)
+{
+    *fu = rmap->u[1][1] + (s->in_transpose ? dv : du);
+    *fv = rmap->v[1][1] + (s->in_transpose ? du : dv);
+}
+
+// Calculate the input coordinates at the grid points of the compact tables
+static int grid_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    V360Context *s = ctx->priv;
+    const int step = s->map_step;
+
+    for (int p = 0; p < s->nb_allocated; p++) {
+        const int gw = s->grid_width[p];
+        const int gh = s->grid_height[p];
+        const int slice_start = (gh *  jobnr     ) / nb_jobs;
+        const int slice_end   = (gh * (jobnr + 1)) / nb_jobs;
+        float du, dv;
+        XYRemap rmap;
+
+        for (int gy = slice_start; gy < slice_end; gy++) {
+            for (int gx = 0; gx < gw; gx++) {
+                float *g = s->grid[p] + (gy * gw + gx) * 2;
+
+                map_pixel(s, p, FFMIN(gx * step, s->pr_width[p]  - 1),
+                                FFMIN(gy * step, s->pr_height[p] - 1), &rmap, &du, &dv);
+                window_position(s, &rmap, du, dv, &g[0], &g[1]);
+                /* a window wrapping around or clamped cannot be interpolated */
+                if (!is_contiguous(s, &rmap))
+                    g[0] = NAN;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Mark the cells of the compact tables which cannot be interpolated from
+ * their corners: across the edges of the projections, the interpolation at
+ * the center of the cell misses the exact coordinates.
+ */
+static int cells_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    V360Context *s = ctx->priv;
+    const int step = s->map_step;
+    const float max_error = 1.f / 8.f;
+
+    for (int p = 0; p < s->nb_allocated; p++) {
+        const int gw = s->grid_width[p];
+        const int ch = s->grid_height[p] - 1;
+        const int slice_start = (ch *  jobnr     ) / nb_jobs;
+        const int slice_end   = (ch * (jobnr + 1)) / nb_jobs;
+        float du, dv;
+        XYRemap rmap;
+
+        for (int cy = slice_start; cy < slice_end; cy++) {
+            for (int cx = 0; cx < gw - 1; cx++) {
+                const float *g0 = s->grid[p] + (cy * gw + cx) * 2;
+                const float *g1 = g0 + gw * 2;
+                const int x0 = cx * step, x1 = FFMIN(x0 + step, s->pr_width[p]  - 1);
+                const int y0 = cy * step, y1 = FFMIN(y0 + step, s->pr_height[p] - 1);
+                const int x = (x0 + FFMIN(x0 + step, s->pr_width[p])  - 1) / 2;
+                const int y = (y0 + FFMIN(y0 + step, s->pr_height[p]) - 1) / 2;
+                const float tx = x1 > x0 ? (float)(x - x0) / (x1 - x0) : 0.f;
+                const float ty = y1 > y0 ? (float)(y - y0) / (y1 - y0) : 0.f;
+                int32_t *cell = s->cells[p] + cy * (gw - 1) + cx;
+                float fu, fv, eu, ev;
+
+                *cell = 1;
+                if (isnan(g0[0]) || isnan(g0[2]) || isnan(g1[0]) || isnan(g1[2]))
+                    continue;
+
+                fu = (g0[0] * (1.f - tx) + g0[2] * tx) * (1.f - ty) +
+                     (g1[0] * (1.f - tx) + g1[2] * tx) * ty;
+                fv = (g0[1] * (1.f - tx) + g0[3] * tx) * (1.f - ty) +
+                     (g1[1] * (1.f - tx) + g1[3] * tx) * ty;
+                map_pixel(s, p, x, y, &rmap, &du, &dv);
+                window_position(s, &rmap, du, dv, &eu, &ev);
+                if (is_contiguous(s, &rmap) &&
+                    fabsf(eu - fu) <= max_error && fabsf(ev - fv) <= max_error)
+                    *cell = -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Calculate the exact remap data of the cells not interpolated
+static int exact_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    V360Context *s = ctx->priv;
+    const int step = s->map_step;
+    const int row = step * s->elements;
+
+    for (int p = 0; p < s->nb_allocated; p++) {
+        const int cw = s->grid_width[p] - 1;
+        const int ch = s->grid_height[p] - 1;
+        const int slice_start = (ch *  jobnr     ) / nb_jobs;
+        const int slice_end   = (ch * (jobnr + 1)) / nb_jobs;
+        float du, dv;
+        XYRemap rmap;
+
+        for (int cy = slice_start; cy < slice_end; cy++) {
+            for (int cx = 0; cx < cw; cx++) {
+                const int cell = s->cells[p][cy * cw + cx];
+                const int yend = FFMIN(cy * step + step, s->pr_height[p]);
+                const int xend = FFMIN(cx * step + step, s->pr_width[p]);
+
+                if (cell < 0)
+                    continue;
+
+                for (int j = cy * step; j < yend; j++) {
+                    int16_t *u = s->exact[p] + ((int64_t)cell * step + j - cy * step) * row * 3;
+
+                    for (int i = cx * step; i < xend; i++) {
+                        const int k = (i - cx * step) * s->elements;
+
+                        map_pixel(s, p, i, j, &rmap, &du, &dv);
+                        s->calculate_kernel(du, dv, &rmap, u + k, u + row + k, u + row * 2 + k);
                     }
                 }
             }
@@ -3990,6 +4445,55 @@ static av_always_inline int v360_slice(AVFilterContext *ctx, void *arg, int jobn
     return 0;
 }
 
+static int mask_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    V360Context *s = ctx->priv;
+    const int height = s->pr_height[0];
+    const int slice_start = (height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
+    float du, dv;
+    XYRemap rmap;
+
+    for (int j = slice_start; j < slice_end; j++)
+        for (int i = 0; i < s->pr_width[0]; i++)
+            set_mask(s, i, j, map_pixel(s, 0, i, j, &rmap, &du, &dv));
+
+    return 0;
+}
+
+static int calculate_compact_maps(AVFilterContext *ctx, V360Maps *m, int nb_jobs)
+{
+    V360Context *s = ctx->priv;
+    const int step = s->map_step;
+
+    ctx->internal->execute(ctx, grid_slice, NULL, NULL, nb_jobs);
+    ctx->internal->execute(ctx, cells_slice, NULL, NULL, nb_jobs);
+
+    for (int p = 0; p < s->nb_allocated; p++) {
+        const int nb_cells = (s->grid_width[p] - 1) * (s->grid_height[p] - 1);
+        int nb_exact = 0;
+
+        for (int i = 0; i < nb_cells; i++)
+            if (s->cells[p][i] >= 0)
+                s->cells[p][i] = nb_exact++;
+
+        if (nb_exact) {
+            m->exact[p] = av_calloc(nb_exact, step * step * s->elements * 3 * sizeof(*m->exact[p]));
+            if (!m->exact[p])
+                return AVERROR(ENOMEM);
+            s->exact[p] = m->exact[p];
+        }
+        av_log(ctx, AV_LOG_DEBUG, "plane %d: %d of %d cells stored exactly\n",
+               p, nb_exact, nb_cells);
+    }
+
+    ctx->internal->execute(ctx, exact_slice, NULL, NULL, nb_jobs);
+    if (s->mask)
+        ctx->internal->execute(ctx, mask_slice, NULL, NULL, nb_jobs);
+
+    return 0;
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -4006,7 +4510,11 @@ static int config_output(AVFilterLink *outlink)
     int out_offset_h, out_offset_w;
     float hf, wf;
     int (*prepare_out)(AVFilterContext *ctx);
+    void (*calculate_coeffs)(float t, float *coeffs) = NULL;
     int have_alpha;
+    int nb_jobs;
+    V360Maps *m;
+    char *key;
 
     s->max_value = (1 << depth) - 1;
     s->input_mirror_modifier[0] = s->ih_flip ? -1.f : 1.f;
@@ -4022,6 +4530,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case BILINEAR:
         s->calculate_kernel = bilinear_kernel;
+        calculate_coeffs = calculate_bilinear_coeffs;
         s->remap_slice = depth <= 8 ? remap2_8bit_slice : remap2_16bit_slice;
         s->elements = 2 * 2;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4029,6 +4538,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case LAGRANGE9:
         s->calculate_kernel = lagrange_kernel;
+        calculate_coeffs = calculate_lagrange_coeffs;
         s->remap_slice = depth <= 8 ? remap3_8bit_slice : remap3_16bit_slice;
         s->elements = 3 * 3;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4036,6 +4546,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case BICUBIC:
         s->calculate_kernel = bicubic_kernel;
+        calculate_coeffs = calculate_bicubic_coeffs;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4043,6 +4554,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case LANCZOS:
         s->calculate_kernel = lanczos_kernel;
+        calculate_coeffs = calculate_lanczos_coeffs;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4050,6 +4562,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case SPLINE16:
         s->calculate_kernel = spline16_kernel;
+        calculate_coeffs = calculate_spline16_coeffs;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4057,6 +4570,7 @@ static int config_output(AVFilterLink *outlink)
         break;
     case GAUSSIAN:
         s->calculate_kernel = gaussian_kernel;
+        calculate_coeffs = calculate_gaussian_coeffs;
         s->remap_slice = depth <= 8 ? remap4_8bit_slice : remap4_16bit_slice;
         s->elements = 4 * 4;
         sizeof_uv = sizeof(int16_t) * s->elements;
@@ -4493,16 +5007,67 @@ static int config_output(AVFilterLink *outlink)
         s->map[1] = s->map[2] = 1;
     }
 
+    calculate_rotation_matrix(s->yaw, s->pitch, s->roll, s->rot_mat, s->rotation_order);
+    set_mirror_modifier(s->h_flip, s->v_flip, s->d_flip, s->output_mirror_modifier);
+
+    nb_jobs = FFMIN(outlink->h, ff_filter_get_nb_threads(ctx));
+
+    if (s->map_step > 1) {
+        const int line_size = s->uv_linesize[0] * s->elements * 3;
+
+        s->remap_slice = remap_compact_slice;
+        if (calculate_coeffs)
+            for (int i = 0; i <= V360_PHASES; i++)
+                calculate_coeffs(i / (float)V360_PHASES, s->coeffs[i]);
+
+        av_freep(&s->line_buf);
+        s->line_buf = av_malloc_array(nb_jobs, line_size * sizeof(*s->line_buf));
+        if (!s->line_buf)
+            return AVERROR(ENOMEM);
+    }
+
+    release_maps(s);
+    key = maps_key(ctx);
+    if (!key)
+        return AVERROR(ENOMEM);
+    s->maps = find_maps(key);
+    if (s->maps) {
+        av_free(key);
+        set_maps(s);
+        return 0;
+    }
+
+    m = av_mallocz(sizeof(*m));
+    if (!m) {
+        av_free(key);
+        return AVERROR(ENOMEM);
+    }
+    m->key = key;
+    s->maps = av_buffer_create((uint8_t *)m, sizeof(*m), maps_free, NULL, 0);
+    if (!s->maps) {
+        maps_free(NULL, (uint8_t *)m);
+        return AVERROR(ENOMEM);
+    }
+
     for (int i = 0; i < s->nb_allocated; i++) {
-        err = allocate_plane(s, sizeof_uv, sizeof_ker, sizeof_mask * have_alpha * s->alpha, i);
+        err = allocate_plane(s, m, sizeof_uv, sizeof_ker, sizeof_mask * have_alpha * s->alpha, i);
         if (err < 0)
             return err;
     }
+    set_maps(s);
 
-    calculate_rotation_matrix(s->yaw, s->pitch, s->roll, s->rot_mat, s->rotation_order);
-    set_mirror_modifier(s->h_flip, s->v_flip, s->d_flip, s->output_mirror_modifier);
+    if (s->map_step > 1) {
+        err = calculate_compact_maps(ctx, m, nb_jobs);
+        if (err < 0)
+            return err;
+    } else {
+        ctx->internal->execute(ctx, v360_slice, NULL, NULL, nb_jobs);
+    }
 
-    ctx->internal->execute(ctx, v360_slice, NULL, NULL, FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
+    err = insert_maps(s);
+    if (err < 0)
+        return err;
+    set_maps(s);
 
     return 0;
 }
@@ -4547,12 +5112,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     V360Context *s = ctx->priv;
 
-    for (int p = 0; p < s->nb_allocated; p++) {
-        av_freep(&s->u[p]);
-        av_freep(&s->v[p]);
-        av_freep(&s->ker[p]);
-    }
-    av_freep(&s->mask);
+    release_maps(s);
+    av_freep(&s->line_buf);
 }
 
 static const AVFilterPad inputs[] = {
@@ -128,18 +128,19 @@ static void convolution_x(const uint16_t *filter, int filt_w, const uint16_t *sr
 static void convolution_y_##bits##bit(const uint16_t *filter, int filt_w, \
                                       const uint8_t *_src, uint16_t *dst, \
                                       int w, int h, ptrdiff_t _src_stride, \
-                                      ptrdiff_t _dst_stride) \
+                                      ptrdiff_t _dst_stride, \
+                                      int slice_start, int slice_end) \
 { \
     const type *src = (const type *) _src; \
     ptrdiff_t src_stride = _src_stride / sizeof(*src); \
     ptrdiff_t dst_stride = _dst_stride / sizeof(*dst); \
     int radius = filt_w / 2; \
-    int borders_top = radius; \
-    int borders_bottom = h - (filt_w - radius); \
+    int borders_top = FFMIN(radius, slice_end); \
+    int borders_bottom = FFMIN(h - (filt_w - radius), slice_end); \
     int i, j, k; \
     int sum = 0; \
     \
-    for (i = 0; i < borders_top; i++) { \
+    for (i = slice_start; i < borders_top; i++) { \
         for (j = 0; j < w; j++) { \
             sum = 0; \
             for (k = 0; k < filt_w; k++) { \
@@ -152,7 +153,7 @@ static void convolution_y_##bits##bit(const uint16_t *filter, int filt_w, \
             dst[i * dst_stride + j] = sum >> bits; \
         } \
     } \
-    for (i = borders_top; i < borders_bottom; i++) { \
+    for (i = FFMAX(borders_top, slice_start); i < borders_bottom; i++) { \
         for (j = 0; j < w; j++) { \
             sum = 0; \
             for (k = 0; k < filt_w; k++) { \
@@ -161,7 +162,7 @@ static void convolution_y_##bits##bit(const uint16_t *filter, int filt_w, \
             dst[i * dst_stride + j] = sum >> bits; \
         } \
     } \
-    for (i = borders_bottom; i < h; i++) { \
+    for (i = FFMAX(borders_bottom, slice_start); i < slice_end; i++) { \
         for (j = 0; j < w; j++) { \
             sum = 0; \
             for (k = 0; k < filt_w; k++) { \
@@ -185,20 +186,31 @@ static void vmafmotiondsp_init(VMAFMotionDSPContext *dsp, int bpp) {
     dsp->sad = image_sad;
 }
 
-double ff_vmafmotion_process(VMAFMotionData *s, AVFrame *ref)
+uint64_t ff_vmafmotion_process_slice(VMAFMotionData *s, const AVFrame *ref,
+                                     int slice_start, int slice_end)
 {
-    double score;
+    const ptrdiff_t offset = slice_start * s->stride / sizeof(uint16_t);
 
     s->vmafdsp.convolution_y(s->filter, 5, ref->data[0], s->temp_data,
-                             s->width, s->height, ref->linesize[0], s->stride);
-    s->vmafdsp.convolution_x(s->filter, 5, s->temp_data, s->blur_data[0],
-                             s->width, s->height, s->stride, s->stride);
+                             s->width, s->height, ref->linesize[0], s->stride,
+                             slice_start, slice_end);
+    s->vmafdsp.convolution_x(s->filter, 5, s->temp_data + offset, s->blur_data[0] + offset,
+                             s->width, slice_end - slice_start, s->stride, s->stride);
+
+    if (!s->nb_frames)
+        return 0;
+
+    return s->vmafdsp.sad(s->blur_data[1] + offset, s->blur_data[0] + offset,
+                          s->width, slice_end - slice_start, s->stride, s->stride);
+}
+
+double ff_vmafmotion_end_frame(VMAFMotionData *s, uint64_t sad)
+{
+    double score;
 
     if (!s->nb_frames) {
         score = 0.0;
     } else {
-        uint64_t sad = s->vmafdsp.sad(s->blur_data[1], s->blur_data[0],
-                                      s->width, s->height, s->stride, s->stride);
         // the output score is always normalized to 8 bits
         score = (double) (sad * 1.0 / (s->width * s->height << (BIT_SHIFT - 8)));
     }
@@ -210,6 +222,13 @@ double ff_vmafmotion_process(VMAFMotionData *s, AVFrame *ref)
     return score;
 }
 
+double ff_vmafmotion_process(VMAFMotionData *s, AVFrame *ref)
+{
+    uint64_t sad = ff_vmafmotion_process_slice(s, ref, 0, s->height);
+
+    return ff_vmafmotion_end_frame(s, sad);
+}
+
 static void set_meta(AVDictionary **metadata, const char *key, float d)
 {
     char value[128];
@@ -93,6 +93,8 @@ typedef struct VPPContext{
     char *cx, *cy, *cw, *ch;
     char *ow, *oh;
     char *output_format_str;
+
+    int async_depth;
 } VPPContext;
 
 static const AVOption options[] = {
@@ -128,6 +130,7 @@ static const AVOption options[] = {
     { "h",      "Output video height", OFFSET(oh), AV_OPT_TYPE_STRING, { .str="w*ch/cw" }, 0, 255, .flags = FLAGS },
     { "height", "Output video height", OFFSET(oh), AV_OPT_TYPE_STRING, { .str="w*ch/cw" }, 0, 255, .flags = FLAGS },
     { "format", "Output pixel format", OFFSET(output_format_str), AV_OPT_TYPE_STRING, { .str = "same" }, .flags = FLAGS },
+    { "async_depth", "Number of frames in flight before syncing", OFFSET(async_depth), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 64, .flags = FLAGS },
 
     { NULL }
 };
@@ -315,6 +318,7 @@ static int config_output(AVFilterLink *outlink)
     if (vpp->out_format == AV_PIX_FMT_NONE)
         vpp->out_format = in_format;
     param.out_sw_format  = vpp->out_format;
+    param.async_depth    = vpp->async_depth;
 
     if (vpp->use_crop) {
         crop.in_idx = 0;
@@ -486,6 +490,22 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     return ret;
 }
 
+static int request_frame(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    VPPContext      *vpp = ctx->priv;
+    int ret, flush_ret;
+
+    ret = ff_request_frame(ctx->inputs[0]);
+    if (ret == AVERROR_EOF && vpp->qsv) {
+        flush_ret = ff_qsvvpp_flush(vpp->qsv, outlink);
+        if (flush_ret < 0)
+            return flush_ret;
+    }
+
+    return ret;
+}
+
 static int query_formats(AVFilterContext *ctx)
 {
     int ret;
@@ -546,6 +566,7 @@ static const AVFilterPad vpp_outputs[] = {
         .name          = "default",
         .type          = AVMEDIA_TYPE_VIDEO,
         .config_props  = config_output,
+        .request_frame = request_frame,
     },
     { NULL }
 };
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+
 #include "libavutil/imgutils.h"
 #include "libavutil/eval.h"
 #include "libavutil/opt.h"
@@ -95,6 +97,8 @@ typedef struct XFadeContext {
     void (*transitionf)(AVFilterContext *ctx, const AVFrame *a, const AVFrame *b, AVFrame *out, float progress,
                         int slice_start, int slice_end, int jobnr);
 
+    float *noise;               ///< the dissolve noise of each pixel
+
     AVExpr *e;
 } XFadeContext;
 
@@ -139,6 +143,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     XFadeContext *s = ctx->priv;
 
     av_expr_free(s->e);
+    av_freep(&s->noise);
 }
 
 #define OFFSET(x) offsetof(XFadeContext, x)
@@ -249,6 +254,21 @@ static inline float smoothstep(float edge0, float edge1, float x)
     return t * t * (3.f - 2.f * t);
 }
 
+#define FADE_LINE(name, type)                                                        \
+static void fade##name##_line(uint8_t *dst, const uint8_t *a, const uint8_t *b,      \
+                              int w, float progress)                               \
+{                                                                                    \
+    const type *xf0 = (const type *)a;                                               \
+    const type *xf1 = (const type *)b;                                               \
+    type *d = (type *)dst;                                                           \
+                                                                                     \
+    for (int x = 0; x < w; x++)                                                      \
+        d[x] = mix(xf0[x], xf1[x], progress);                                        \
+}
+
+FADE_LINE(8, uint8_t)
+FADE_LINE(16, uint16_t)
+
 #define FADE_TRANSITION(name, type, div)                                             \
 static void fade##name##_transition(AVFilterContext *ctx,                            \
                             const AVFrame *a, const AVFrame *b, AVFrame *out,        \
@@ -264,9 +284,8 @@ static void fade##name##_transition(AVFilterContext *ctx,
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = mix(xf0[x], xf1[x], progress);                              \
-            }                                                                        \
+            fade##name##_line((uint8_t *)dst, (const uint8_t *)xf0,                  \
+                              (const uint8_t *)xf1, out->width, progress);           \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
             xf0 += a->linesize[p] / div;                                             \
@@ -287,6 +306,8 @@ static void wipeleft##name##_transition(AVFilterContext *ctx,
     XFadeContext *s = ctx->priv;                                                     \
     const int height = slice_end - slice_start;                                      \
     const int z = out->width * progress;                                             \
+    /* the pixels up to z are taken from the first input */                          \
+    const int n = av_clip(z + 1, 0, out->width);                                     \
                                                                                      \
     for (int p = 0; p < s->nb_planes; p++) {                                         \
         const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
@@ -294,9 +315,8 @@ static void wipeleft##name##_transition(AVFilterContext *ctx,
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf1[x] : xf0[x];                                    \
-            }                                                                        \
+            memcpy(dst, xf0, n * sizeof(*dst));                                      \
+            memcpy(dst + n, xf1 + n, (out->width - n) * sizeof(*dst));               \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
             xf0 += a->linesize[p] / div;                                             \
@@ -317,6 +337,8 @@ static void wiperight##name##_transition(AVFilterContext *ctx,
     XFadeContext *s = ctx->priv;                                                     \
     const int height = slice_end - slice_start;                                      \
     const int z = out->width * (1.f - progress);                                     \
+    /* the pixels up to z are taken from the second input */                         \
+    const int n = av_clip(z + 1, 0, out->width);                                     \
                                                                                      \
     for (int p = 0; p < s->nb_planes; p++) {                                         \
         const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
@@ -324,9 +346,8 @@ static void wiperight##name##_transition(AVFilterContext *ctx,
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf0[x] : xf1[x];                                    \
-            }                                                                        \
+            memcpy(dst, xf1, n * sizeof(*dst));                                      \
+            memcpy(dst + n, xf0 + n, (out->width - n) * sizeof(*dst));               \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
             xf0 += a->linesize[p] / div;                                             \
@@ -354,9 +375,8 @@ static void wipeup##name##_transition(AVFilterContext *ctx,
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf1[x] : xf0[x];                      \
-            }                                                                        \
+            memcpy(dst, slice_start + y > z ? xf1 : xf0,                             \
+                   out->width * sizeof(*dst));                                       \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
             xf0 += a->linesize[p] / div;                                             \
@@ -384,9 +404,8 @@ static void wipedown##name##_transition(AVFilterContext *ctx,
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf0[x] : xf1[x];                      \
-            }                                                                        \
+            memcpy(dst, slice_start + y > z ? xf0 : xf1,                             \
+                   out->width * sizeof(*dst));                                       \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
             xf0 += a->linesize[p] / div;                                             \
@@ -1006,6 +1025,24 @@ static float frand(int x, int y)
     return r - floorf(r);
 }
 
+#define DISSOLVE_LINE(name, type)                                                    \
+static void dissolve##name##_line(uint8_t *dst, const uint8_t *a,                    \
+                                  const uint8_t *b, const float *noise,            \
+                                    int w, float progress)                           \
+{                                                                                    \
+    const type *xf0 = (const type *)a;                                               \
+    const type *xf1 = (const type *)b;                                               \
+    type *d = (type *)dst;                                                           \
+                                                                                     \
+    for (int x = 0; x < w; x++) {                                                    \
+        const float smooth = noise[x] * 2.f + progress * 2.f - 1.5f;                 \
+        d[x] = smooth >= 0.5f ? xf0[x] : xf1[x];                                     \
+    }                                                                                \
+}
+
+DISSOLVE_LINE(8, uint8_t)
+DISSOLVE_LINE(16, uint16_t)
+
 #define DISSOLVE_TRANSITION(name, type, div)                                         \
 static void dissolve##name##_transition(AVFilterContext *ctx,                        \
                             const AVFrame *a, const AVFrame *b, AVFrame *out,        \
@@ -1015,16 +1052,15 @@ static void dissolve##name##_transition(AVFilterContext *ctx,
     XFadeContext *s = ctx->priv;                                                     \
     const int width = out->width;                                                    \
                                                                                      \
-    for (int y = slice_start; y < slice_end; y++) {                                  \
-        for (int x = 0; x < width; x++) {                                            \
-            const float smooth = frand(x, y) * 2.f + progress * 2.f - 1.5f;          \
-            for (int p = 0; p < s->nb_planes; p++) {                                 \
-                const type *xf0 = (const type *)(a->data[p] + y * a->linesize[p]);   \
-                const type *xf1 = (const type *)(b->data[p] + y * b->linesize[p]);   \
-                type *dst = (type *)(out->data[p] + y * out->linesize[p]);           \
-                                                                                     \
-                dst[x] = smooth >= 0.5f ? xf0[x] : xf1[x];                           \
-            }                                                                        \
+    for (int p = 0; p < s->nb_planes; p++) {                                         \
+        for (int y = slice_start; y < slice_end; y++) {                              \
+            const type *xf0 = (const type *)(a->data[p] + y * a->linesize[p]);       \
+            const type *xf1 = (const type *)(b->data[p] + y * b->linesize[p]);       \
+            type *dst = (type *)(out->data[p] + y * out->linesize[p]);               \
+            const float *noise = s->noise + y * width;                               \
+                                                                                     \
+            dissolve##name##_line((uint8_t *)dst, (const uint8_t *)xf0,              \
+                                  (const uint8_t *)xf1, noise, width, progress);     \
         }                                                                            \
     }                                                                                \
 }
@@ -1427,6 +1463,17 @@ static int config_output(AVFilterLink *outlink)
     case VDSLICE:    s->transitionf = s->depth <= 8 ? vdslice8_transition    : vdslice16_transition;    break;
     }
 
+    /* the noise does not depend on the progress, it is computed once */
+    if (s->transition == DISSOLVE) {
+        av_freep(&s->noise);
+        s->noise = av_malloc_array(outlink->w * outlink->h, sizeof(*s->noise));
+        if (!s->noise)
+            return AVERROR(ENOMEM);
+        for (int y = 0; y < outlink->h; y++)
+            for (int x = 0; x < outlink->w; x++)
+                s->noise[y * outlink->w + x] = frand(x, y);
+    }
+
     if (s->transition == CUSTOM) {
         static const char *const func2_names[]    = {
             "a0", "a1", "a2", "a3",
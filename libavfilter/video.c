@@ -27,7 +27,9 @@
 #include "libavutil/buffer.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/imgutils_internal.h"
 #include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -64,6 +66,22 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         return frame;
     }
 
+    if (link->graph && link->graph->frame_pool_size > 0) {
+        AVFilterGraphInternal *graphi = link->graph->internal;
+
+        if (!graphi->frame_pool) {
+            graphi->frame_pool = ff_graph_frame_pool_init(link->graph->frame_pool_size,
+                                                          link->graph->frame_pool_idle_time);
+            if (!graphi->frame_pool)
+                return NULL;
+        }
+        frame = ff_graph_frame_pool_get_video(graphi->frame_pool, w, h,
+                                              link->format, BUFFER_ALIGN);
+        if (frame)
+            frame->sample_aspect_ratio = link->sample_aspect_ratio;
+        return frame;
+    }
+
     if (!link->frame_pool) {
         link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
                                                     link->format, BUFFER_ALIGN);
@@ -99,14 +117,62 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h)
 {
     AVFrame *ret = NULL;
+    int locked;
 
     FF_TPRINTF_START(NULL, get_video_buffer); ff_tlog_link(NULL, link, 0);
 
+    locked = ff_graph_lock(link->graph);
     if (link->dstpad->get_video_buffer)
         ret = link->dstpad->get_video_buffer(link, w, h);
 
     if (!ret)
         ret = ff_default_get_video_buffer(link, w, h);
+    ff_graph_unlock(link->graph, locked);
 
     return ret;
 }
+
+typedef struct CopyThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+} CopyThreadData;
+
+static int copy_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CopyThreadData *td = arg;
+    ptrdiff_t dst_linesize[4], src_linesize[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        dst_linesize[i] = td->dst->linesize[i];
+        src_linesize[i] = td->src->linesize[i];
+    }
+    avpriv_image_copy_slice(td->dst->data, dst_linesize,
+                            (const uint8_t **)td->src->data, src_linesize,
+                            td->src->format, td->src->width, td->src->height,
+                            jobnr, nb_jobs);
+    return 0;
+}
+
+int ff_video_frame_copy(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src)
+{
+    CopyThreadData td = { dst, src };
+    int i, nb_slices;
+
+    if (dst->format != src->format || dst->format < 0 ||
+        dst->width < src->width || dst->height < src->height ||
+        src->hw_frames_ctx || dst->hw_frames_ctx)
+        return av_frame_copy(dst, src);
+
+    nb_slices = avpriv_image_copy_nb_slices(src->format, src->width, src->height,
+                                            ff_filter_get_nb_threads(ctx));
+    if (nb_slices <= 1)
+        return av_frame_copy(dst, src);
+
+    for (i = 0; i < av_pix_fmt_count_planes(dst->format); i++)
+        if (!dst->data[i] || !src->data[i])
+            return AVERROR(EINVAL);
+
+    ctx->internal->execute(ctx, copy_slice, &td, NULL, nb_slices);
+    return 0;
+}
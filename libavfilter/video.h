@@ -38,4 +38,13 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h);
  */
 AVFrame *ff_get_video_buffer(AVFilterLink *link, int w, int h);
 
+/**
+ * Copy the data of a video frame like av_frame_copy(), splitting large
+ * software frames across the threads of the filter.
+ *
+ * @param ctx the filter doing the copy, whose threads are used
+ * @return 0 on success, a negative AVERROR on error
+ */
+int ff_video_frame_copy(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src);
+
 #endif /* AVFILTER_VIDEO_H */
@@ -34,7 +34,7 @@ typedef struct VMAFMotionDSPContext {
                           ptrdiff_t dst_stride);
     void (*convolution_y)(const uint16_t *filter, int filt_w, const uint8_t *src,
                           uint16_t *dst, int w, int h, ptrdiff_t src_stride,
-                          ptrdiff_t dst_stride);
+                          ptrdiff_t dst_stride, int slice_start, int slice_end);
 } VMAFMotionDSPContext;
 
 void ff_vmafmotion_init_x86(VMAFMotionDSPContext *dsp);
@@ -53,6 +53,15 @@ typedef struct VMAFMotionData {
 
 int ff_vmafmotion_init(VMAFMotionData *data, int w, int h, enum AVPixelFormat fmt);
 double ff_vmafmotion_process(VMAFMotionData *data, AVFrame *frame);
+
+/**
+ * Blur the lines [slice_start, slice_end) of frame and return their SAD
+ * against the previous frame. The slices can be run in parallel, the frame
+ * is then completed with ff_vmafmotion_end_frame() and the sum of the SADs.
+ */
+uint64_t ff_vmafmotion_process_slice(VMAFMotionData *data, const AVFrame *frame,
+                                     int slice_start, int slice_end);
+double ff_vmafmotion_end_frame(VMAFMotionData *data, uint64_t sad);
 double ff_vmafmotion_uninit(VMAFMotionData *data);
 
 #endif /* AVFILTER_VMAF_MOTION_H */
@@ -1494,6 +1494,8 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+#define AVFMT_FLAG_POOL_PACKETS 0x400000 ///< Allocate the demuxed packet payloads from buffer pools instead of the heap
+#define AVFMT_FLAG_FAST_INFO  0x800000 ///< Stop stream analysis as soon as the codec parameters are known, without estimating frame rates
 
     /**
      * Maximum size of the data read from input for determining
@@ -1951,6 +1953,26 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_probe_packets;
+
+    /**
+     * Directory in which avformat_find_stream_info() caches its results.
+     * Inputs of known size are looked up by URL, size and modification
+     * time; on a hit the stream analysis is skipped entirely.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *stream_info_cache;
+
+    /**
+     * Path of the sidecar seek index listing the keyframes of the video
+     * streams with their byte position.
+     * - encoding: if set, the index is written there by av_write_trailer()
+     * - decoding: the index is loaded from there on the first seek, and
+     *             seeks go straight to its keyframes. If unset, the input
+     *             URL with the ".ffindex" suffix is used for local mpegts,
+     *             h264 and hevc files when it exists.
+     */
+    char *seek_index;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -2474,6 +2496,43 @@ int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts, int
  */
 int avformat_flush(AVFormatContext *s);
 
+/**
+ * Decode the frames of a stream at a list of timestamps.
+ *
+ * The timestamps are grouped by the keyframe preceding them in the index of
+ * the stream, each group is demuxed once from its keyframe, and the groups
+ * are decoded in parallel by nb_threads decoders. Without an index, each
+ * timestamp is seeked to separately.
+ *
+ * The frame of a timestamp is the first one whose timestamp is not lower
+ * than it, or the last one decoded from its keyframe if there is none, like
+ * with an accurate seek.
+ *
+ * The read position of s is undefined after this call, the discard state of
+ * its streams is preserved.
+ *
+ * @param s            an opened input
+ * @param stream_index the stream to decode
+ * @param timestamps   the timestamps to extract, in the time base of the
+ *                     stream, in any order and possibly repeated
+ * @param nb_timestamps the number of timestamps
+ * @param nb_threads   the number of decoders working in parallel, 0 for one
+ *                     per CPU; each of them runs on a single thread unless
+ *                     codec_opts sets "threads"
+ * @param codec_opts   options for the decoders, may be NULL
+ * @param cb           called with each frame and the index of its timestamp
+ *                     in timestamps; it can be called from any thread, but
+ *                     never concurrently, and must reference the frame to
+ *                     keep it. Returning a negative value aborts.
+ * @param opaque       passed to cb
+ * @return >= 0 on success, a negative AVERROR code otherwise
+ */
+int avformat_extract_frames(AVFormatContext *s, int stream_index,
+                            const int64_t *timestamps, int nb_timestamps,
+                            int nb_threads, AVDictionary *codec_opts,
+                            int (*cb)(void *opaque, int index, const AVFrame *frame),
+                            void *opaque);
+
 /**
  * Start playing a network-based stream (e.g. RTSP stream) at the
  * current position.
@@ -58,6 +58,7 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"readahead_size", "Size of the buffer filled ahead of reads by a background thread", OFFSET(readahead_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT_MAX, D },
     { NULL }
 };
 
@@ -361,6 +362,27 @@ int ffurl_open(URLContext **puc, const char *filename, int flags,
                                 int_cb, options, NULL, NULL, NULL);
 }
 
+/**
+ * Wait before retrying a transfer which returned AVERROR(EAGAIN) in
+ * blocking mode: retry right away a few times, then sleep, until
+ * rw_timeout is exceeded.
+ */
+static int transfer_wait(URLContext *h, int *fast_retries, int64_t *wait_since)
+{
+    if (*fast_retries) {
+        (*fast_retries)--;
+    } else {
+        if (h->rw_timeout) {
+            if (!*wait_since)
+                *wait_since = av_gettime_relative();
+            else if (av_gettime_relative() > *wait_since + h->rw_timeout)
+                return AVERROR(EIO);
+        }
+        av_usleep(1000);
+    }
+    return 0;
+}
+
 static inline int retry_transfer_wrapper(URLContext *h, uint8_t *buf,
                                          int size, int size_min,
                                          int (*transfer_func)(URLContext *h,
@@ -381,18 +403,8 @@ static inline int retry_transfer_wrapper(URLContext *h, uint8_t *buf,
         if (h->flags & AVIO_FLAG_NONBLOCK)
             return ret;
         if (ret == AVERROR(EAGAIN)) {
-            ret = 0;
-            if (fast_retries) {
-                fast_retries--;
-            } else {
-                if (h->rw_timeout) {
-                    if (!wait_since)
-                        wait_since = av_gettime_relative();
-                    else if (av_gettime_relative() > wait_since + h->rw_timeout)
-                        return AVERROR(EIO);
-                }
-                av_usleep(1000);
-            }
+            if ((ret = transfer_wait(h, &fast_retries, &wait_since)) < 0)
+                return ret;
         } else if (ret == AVERROR_EOF)
             return (len > 0) ? len : AVERROR_EOF;
         else if (ret < 0)
@@ -433,6 +445,66 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
                                   h->prot->url_write);
 }
 
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    URLIOVec vec[URL_MAX_IOV], *v = vec;
+    int64_t total = 0;
+    int i, ret, len = 0;
+    int fast_retries = 5;
+    int64_t wait_since = 0;
+
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (iovcnt > URL_MAX_IOV)
+        return AVERROR(EINVAL);
+    for (i = 0; i < iovcnt; i++)
+        total += iov[i].size;
+    if (total > INT_MAX)
+        return AVERROR(EINVAL);
+    /* avoid sending too big packets */
+    if (h->max_packet_size && total > h->max_packet_size)
+        return AVERROR(EIO);
+
+    if (!h->prot->url_writev) {
+        for (i = 0; i < iovcnt; i++)
+            if (iov[i].size && (ret = ffurl_write(h, iov[i].data, iov[i].size)) < 0)
+                return ret;
+        return total;
+    }
+
+    memcpy(vec, iov, iovcnt * sizeof(*vec));
+    while (len < total) {
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+        ret = h->prot->url_writev(h, v, iovcnt);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (h->flags & AVIO_FLAG_NONBLOCK && ret < 0)
+            return len > 0 ? len : ret;
+        if (ret == AVERROR(EAGAIN)) {
+            if ((ret = transfer_wait(h, &fast_retries, &wait_since)) < 0)
+                return ret;
+            continue;
+        } else if (ret < 0)
+            return ret;
+        fast_retries = FFMAX(fast_retries, 2);
+        wait_since = 0;
+        len += ret;
+
+        /* skip what was written */
+        while (iovcnt && ret >= v->size) {
+            ret -= v->size;
+            v++;
+            iovcnt--;
+        }
+        if (ret) {
+            v->data += ret;
+            v->size -= ret;
+        }
+    }
+    return len;
+}
+
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
     int64_t ret;
@@ -656,6 +728,13 @@ int ffurl_get_short_seek(URLContext *h)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapping(URLContext *h, const uint8_t **data, int64_t *size)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapping)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapping(h, data, size);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
@@ -349,6 +349,20 @@ typedef struct AVIOContext {
      * Try to buffer at least this amount of data before flushing it
      */
     int min_packet_size;
+
+    /**
+     * Pools av_get_packet() allocates the packet payloads from, if set.
+     * Internal, owned by the AVFormatContext demuxing from this context.
+     */
+    struct FFPacketPool *packet_pool;
+
+    /**
+     * Read-only mapping of the whole underlying resource, if the protocol
+     * provides one; reads are then served from it without a bounce copy
+     * through buffer. Internal, set up by ffio_fdopen().
+     */
+    const unsigned char *map;
+    int64_t map_size;
 } AVIOContext;
 
 /**
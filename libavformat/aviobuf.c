@@ -26,6 +26,7 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avio_internal.h"
@@ -45,7 +46,7 @@
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
-    return prev ? NULL : s->opaque;
+    return prev ? NULL : ffio_geturlcontext(s);
 }
 
 #if FF_API_CHILD_CLASS_NEXT
@@ -157,10 +158,28 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
+static void writeout_done(AVIOContext *s, int len, int ret)
+{
+    if (ret < 0) {
+        s->error = ret;
+    } else {
+        if (s->pos + len > s->written)
+            s->written = s->pos + len;
+    }
+    if (s->current_type == AVIO_DATA_MARKER_SYNC_POINT ||
+        s->current_type == AVIO_DATA_MARKER_BOUNDARY_POINT) {
+        s->current_type = AVIO_DATA_MARKER_UNKNOWN;
+    }
+    s->last_time = AV_NOPTS_VALUE;
+    s->writeout_count ++;
+    s->pos += len;
+}
+
 static void writeout(AVIOContext *s, const uint8_t *data, int len)
 {
+    int ret = 0;
+
     if (!s->error) {
-        int ret = 0;
         if (s->write_data_type)
             ret = s->write_data_type(s->opaque, (uint8_t *)data,
                                      len,
@@ -168,20 +187,38 @@ static void writeout(AVIOContext *s, const uint8_t *data, int len)
                                      s->last_time);
         else if (s->write_packet)
             ret = s->write_packet(s->opaque, (uint8_t *)data, len);
-        if (ret < 0) {
-            s->error = ret;
-        } else {
-            if (s->pos + len > s->written)
-                s->written = s->pos + len;
-        }
-    }
-    if (s->current_type == AVIO_DATA_MARKER_SYNC_POINT ||
-        s->current_type == AVIO_DATA_MARKER_BOUNDARY_POINT) {
-        s->current_type = AVIO_DATA_MARKER_UNKNOWN;
+    } else {
+        ret = s->error;
     }
-    s->last_time = AV_NOPTS_VALUE;
-    s->writeout_count ++;
-    s->pos += len;
+    writeout_done(s, len, ret);
+}
+
+/**
+ * Write the buffered data followed by buf with a single call, if the
+ * protocol can send both without copying buf into the buffer first.
+ *
+ * @return 1 if done, 0 if buf must go through the buffer
+ */
+static int writeout_gather(AVIOContext *s, const uint8_t *buf, int size)
+{
+    URLContext *h;
+    URLIOVec iov[2];
+    int ret;
+
+    if (size < s->buffer_size || s->update_checksum || s->write_data_type ||
+        s->max_packet_size || s->buf_ptr < s->buf_ptr_max ||
+        size > INT_MAX - s->buffer_size || !(h = ffio_geturlcontext(s)) ||
+        !h->prot->url_writev)
+        return 0;
+
+    iov[0].data = s->buffer;
+    iov[0].size = s->buf_ptr - s->buffer;
+    iov[1].data = buf;
+    iov[1].size = size;
+    ret = s->error ? s->error : ffurl_writev(h, iov, 2);
+    writeout_done(s, iov[0].size + size, ret);
+    s->buf_ptr = s->buf_ptr_max = s->buffer;
+    return 1;
 }
 
 static void flush_buffer(AVIOContext *s)
@@ -229,6 +266,8 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
         writeout(s, buf, size);
         return;
     }
+    if (s->write_flag && writeout_gather(s, buf, size))
+        return;
     while (size > 0) {
         int len = FFMIN(s->buf_end - s->buf_ptr, size);
         memcpy(s->buf_ptr, buf, len);
@@ -642,7 +681,7 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
     while (size > 0) {
         len = FFMIN(s->buf_end - s->buf_ptr, size);
         if (len == 0 || s->write_flag) {
-            if((s->direct || size > s->buffer_size) && !s->update_checksum) {
+            if((s->direct || s->map || size > s->buffer_size) && !s->update_checksum) {
                 // bypass the buffer and read data directly into buf
                 len = read_packet_wrapper(s, buf, size);
                 if (len == AVERROR_EOF) {
@@ -697,10 +736,21 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
         *data = s->buf_ptr;
         s->buf_ptr += size;
         return size;
-    } else {
-        *data = buf;
-        return avio_read(s, buf, size);
     }
+    if (s->map && s->buf_ptr == s->buf_end && !s->write_flag &&
+        !s->update_checksum && size >= 0 && s->pos <= s->map_size - size) {
+        /* point into the mapping and move the protocol along with us */
+        int64_t pos = s->seek(s->opaque, s->pos + size, SEEK_SET);
+        if (pos >= 0) {
+            *data = s->map + s->pos;
+            s->pos         = pos;
+            s->bytes_read += size;
+            s->buf_ptr = s->buf_end = s->buffer;
+            return size;
+        }
+    }
+    *data = buf;
+    return avio_read(s, buf, size);
 }
 
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
@@ -927,6 +977,278 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
     return val;
 }
 
+#if HAVE_THREADS
+/* largest single read issued by the read-ahead thread */
+#define READAHEAD_CHUNK_SIZE 65536
+
+/**
+ * Background read-ahead between an AVIOContext and its URLContext.
+ *
+ * The ring holds the stream range [start, end); the byte at position p is
+ * stored at buf[p % size]. Up to a quarter of the ring is kept behind the
+ * read position so that short backward seeks, as well as forward seeks into
+ * the part already read or about to be read, are served without touching
+ * the protocol.
+ */
+typedef struct ReadAhead {
+    URLContext *h;
+    uint8_t *buf;
+    int64_t size;
+    int64_t back_size;
+    int64_t file_size;
+
+    int64_t start;
+    int64_t end;
+    int64_t read_pos;
+    int eof;
+    int error;
+
+    int seek_request;
+    int64_t seek_pos;
+    int64_t seek_ret;
+
+    int abort;
+    AVIOInterruptCB interrupt_callback;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_reader;
+    pthread_cond_t cond_worker;
+} ReadAhead;
+
+static int readahead_interrupt(void *opaque)
+{
+    ReadAhead *ra = opaque;
+    return ra->abort || ff_check_interrupt(&ra->interrupt_callback);
+}
+
+static void *readahead_worker(void *arg)
+{
+    ReadAhead *ra = arg;
+
+    pthread_mutex_lock(&ra->mutex);
+    while (!ra->abort) {
+        int64_t drop, space, fill_pos;
+        int len, ret;
+
+        if (ra->seek_request) {
+            int64_t pos = ra->seek_pos, seek_ret;
+
+            pthread_mutex_unlock(&ra->mutex);
+            seek_ret = ffurl_seek(ra->h, pos, SEEK_SET);
+            pthread_mutex_lock(&ra->mutex);
+            if (seek_ret >= 0) {
+                ra->start = ra->end = ra->read_pos = pos;
+                ra->eof   = ra->error = 0;
+            }
+            ra->seek_ret     = seek_ret;
+            ra->seek_request = 0;
+            pthread_cond_signal(&ra->cond_reader);
+            continue;
+        }
+
+        drop = FFMIN(ra->read_pos - ra->back_size, ra->end);
+        if (drop > ra->start)
+            ra->start = drop;
+        space = ra->size - (ra->end - ra->start);
+        if (ra->eof || ra->error || space <= 0) {
+            pthread_cond_wait(&ra->cond_worker, &ra->mutex);
+            continue;
+        }
+
+        fill_pos = ra->end;
+        len = FFMIN3(space, ra->size - fill_pos % ra->size, READAHEAD_CHUNK_SIZE);
+        pthread_mutex_unlock(&ra->mutex);
+        ret = ffurl_read(ra->h, ra->buf + fill_pos % ra->size, len);
+        pthread_mutex_lock(&ra->mutex);
+
+        /* a seek issued meanwhile invalidates what was just read */
+        if (ra->seek_request || ra->end != fill_pos)
+            continue;
+        if (ret == AVERROR_EOF || ret == 0)
+            ra->eof = 1;
+        else if (ret < 0)
+            ra->error = ret;
+        else
+            ra->end += ret;
+        pthread_cond_signal(&ra->cond_reader);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+static int readahead_read(void *opaque, uint8_t *buf, int size)
+{
+    ReadAhead *ra = opaque;
+    int ret;
+
+    pthread_mutex_lock(&ra->mutex);
+    for (;;) {
+        if (ra->read_pos < ra->end) {
+            int64_t off = ra->read_pos % ra->size;
+            int len = FFMIN(size, ra->end - ra->read_pos);
+            int len1 = FFMIN(len, ra->size - off);
+
+            memcpy(buf, ra->buf + off, len1);
+            memcpy(buf + len1, ra->buf, len - len1);
+            ra->read_pos += len;
+            pthread_cond_signal(&ra->cond_worker);
+            ret = len;
+            break;
+        }
+        if (ra->error || ra->eof) {
+            ret = ra->error ? ra->error : AVERROR_EOF;
+            break;
+        }
+        pthread_cond_wait(&ra->cond_reader, &ra->mutex);
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return ret;
+}
+
+static int64_t readahead_seek(void *opaque, int64_t pos, int whence)
+{
+    ReadAhead *ra = opaque;
+    int64_t ret;
+
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        return ra->file_size;
+
+    pthread_mutex_lock(&ra->mutex);
+    if (whence == SEEK_CUR) {
+        pos += ra->read_pos;
+    } else if (whence == SEEK_END) {
+        if (ra->file_size < 0) {
+            pthread_mutex_unlock(&ra->mutex);
+            return ra->file_size;
+        }
+        pos += ra->file_size;
+    } else if (whence != SEEK_SET) {
+        pthread_mutex_unlock(&ra->mutex);
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0) {
+        pthread_mutex_unlock(&ra->mutex);
+        return AVERROR(EINVAL);
+    }
+
+    if (!ra->error && pos >= ra->start &&
+        (pos <= ra->end || (!ra->eof && pos - ra->end <= ra->size / 2))) {
+        /* keep the buffered range, the worker catches up if needed */
+        ra->read_pos = pos;
+        pthread_cond_signal(&ra->cond_worker);
+        ret = pos;
+    } else {
+        ra->seek_request = 1;
+        ra->seek_pos     = pos;
+        pthread_cond_signal(&ra->cond_worker);
+        while (ra->seek_request)
+            pthread_cond_wait(&ra->cond_reader, &ra->mutex);
+        ret = ra->seek_ret;
+    }
+    pthread_mutex_unlock(&ra->mutex);
+
+    return ret;
+}
+
+static int readahead_short_seek(void *opaque)
+{
+    ReadAhead *ra = opaque;
+    return ffurl_get_short_seek(ra->h);
+}
+
+static URLContext *readahead_free(ReadAhead **pra)
+{
+    ReadAhead *ra = *pra;
+    URLContext *h;
+
+    if (!ra)
+        return NULL;
+    h = ra->h;
+
+    pthread_mutex_lock(&ra->mutex);
+    ra->abort = 1;
+    pthread_cond_signal(&ra->cond_worker);
+    pthread_mutex_unlock(&ra->mutex);
+    pthread_join(ra->thread, NULL);
+    h->interrupt_callback = ra->interrupt_callback;
+
+    pthread_cond_destroy(&ra->cond_worker);
+    pthread_cond_destroy(&ra->cond_reader);
+    pthread_mutex_destroy(&ra->mutex);
+    av_freep(&ra->buf);
+    av_freep(pra);
+
+    return h;
+}
+
+static int readahead_init(AVIOContext *s, URLContext *h)
+{
+    ReadAhead *ra;
+    int64_t pos;
+    int ret;
+
+    if ((pos = ffurl_seek(h, 0, SEEK_CUR)) < 0)
+        pos = 0;
+
+    ra = av_mallocz(sizeof(*ra));
+    if (!ra)
+        return AVERROR(ENOMEM);
+    ra->size = FFMAX(h->readahead_size, READAHEAD_CHUNK_SIZE);
+    ra->buf  = av_malloc(ra->size);
+    if (!ra->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ra->h         = h;
+    ra->back_size = ra->size / 4;
+    ra->file_size = ffurl_size(h);
+    ra->start = ra->end = ra->read_pos = pos;
+
+    if ((ret = pthread_mutex_init(&ra->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&ra->cond_reader, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_mutex;
+    }
+    if ((ret = pthread_cond_init(&ra->cond_worker, NULL))) {
+        ret = AVERROR(ret);
+        goto fail_cond;
+    }
+
+    /* let close interrupt a read blocked in the worker */
+    ra->interrupt_callback         = h->interrupt_callback;
+    h->interrupt_callback.callback     = readahead_interrupt;
+    h->interrupt_callback.opaque       = ra;
+    if ((ret = pthread_create(&ra->thread, NULL, readahead_worker, ra))) {
+        h->interrupt_callback = ra->interrupt_callback;
+        ret = AVERROR(ret);
+        goto fail_cond_worker;
+    }
+
+    s->opaque         = ra;
+    s->read_packet    = readahead_read;
+    s->seek           = readahead_seek;
+    s->short_seek_get = readahead_short_seek;
+    return 0;
+
+fail_cond_worker:
+    pthread_cond_destroy(&ra->cond_worker);
+fail_cond:
+    pthread_cond_destroy(&ra->cond_reader);
+fail_mutex:
+    pthread_mutex_destroy(&ra->mutex);
+fail:
+    av_free(ra->buf);
+    av_free(ra);
+    return ret;
+}
+#endif
+
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
     uint8_t *buffer = NULL;
@@ -973,6 +1295,18 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
             (*s)->seekable |= AVIO_SEEKABLE_TIME;
     }
     (*s)->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
+    if (!(*s)->write_flag && ffurl_get_mapping(h, &(*s)->map, &(*s)->map_size) < 0) {
+        (*s)->map      = NULL;
+        (*s)->map_size = 0;
+    }
+#if HAVE_THREADS
+    if (h->readahead_size && !(*s)->write_flag && !(*s)->map && h->prot &&
+        !h->prot->url_read_seek && !h->prot->url_read_pause && !h->prot->url_accept) {
+        int ret = readahead_init(*s, h);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot start read-ahead: %s\n", av_err2str(ret));
+    }
+#endif
     (*s)->av_class = &ff_avio_class;
     return 0;
 fail:
@@ -987,6 +1321,10 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
 
     if (s->opaque && s->read_packet == (int (*)(void *, uint8_t *, int))ffurl_read)
         return s->opaque;
+#if HAVE_THREADS
+    if (s->opaque && s->read_packet == readahead_read)
+        return ((ReadAhead *)s->opaque)->h;
+#endif
     else
         return NULL;
 }
@@ -1164,7 +1502,11 @@ int avio_close(AVIOContext *s)
         return 0;
 
     avio_flush(s);
-    h         = s->opaque;
+    h = s->opaque;
+#if HAVE_THREADS
+    if (s->read_packet == readahead_read)
+        h = readahead_free((ReadAhead **)&s->opaque);
+#endif
     s->opaque = NULL;
 
     av_freep(&s->buffer);
@@ -25,12 +25,22 @@
  * @TODO
  *      support keeping files
  *      support filling with a background thread
+ *
+ * With the shared option, readers of the same URL opened with the same
+ * options within one process share a memory cache of fixed size blocks instead of each keeping a private
+ * tempfile. Every block is downloaded once by whichever reader needs it
+ * first; readers wanting a block that is still being loaded wait for it.
+ * Least recently used blocks are dropped, or spilled to a per-URL tempfile,
+ * once the memory budget is exceeded.
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
 #include <fcntl.h>
@@ -51,6 +61,48 @@ typedef struct CacheEntry {
     int size;
 } CacheEntry;
 
+#define SHARED_BLOCK_SIZE (64 * 1024)
+
+typedef struct SharedBlock {
+    int64_t index;                      ///< position / SHARED_BLOCK_SIZE, must be first
+    struct SharedSource *src;
+    uint8_t *data;                      ///< NULL while loading or once spilled
+    int64_t spill_pos;                  ///< offset in the spill file, -1 if not spilled
+    int size;                           ///< less than SHARED_BLOCK_SIZE only for the last block
+    int loading;
+    struct SharedBlock *prev, *next;    ///< LRU list of the blocks held in memory
+} SharedBlock;
+
+typedef struct SharedSource {
+    char *key;                          ///< URL and open options, see shared_source_key()
+    AVDictionary *unused_options;       ///< options left by the protocol at the first open
+    int opening;                        ///< the first reader is still opening the URL
+    int open_error;                     ///< the first open failed with this error
+    int refcount;
+    struct AVTreeNode *blocks;
+    int nb_blocks;
+    int64_t end;
+    int is_true_eof;
+    int spill;
+    int spill_fd;
+    char *spill_name;
+    int64_t ttl;
+    int64_t last_used;
+#if HAVE_THREADS
+    pthread_cond_t cond;                ///< signaled when a block finished loading
+#endif
+    struct SharedSource *next;
+} SharedSource;
+
+static AVMutex shared_mutex = AV_MUTEX_INITIALIZER;
+
+static struct {
+    SharedSource *sources;
+    SharedBlock *lru_first, *lru_last;  ///< most and least recently used block
+    int64_t mem_used;
+    int64_t mem_limit;                  ///< largest cache_size requested by a reader
+} shared_cache;
+
 typedef struct Context {
     AVClass *class;
     int fd;
@@ -64,6 +116,14 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+    int shared;
+    int64_t cache_size;
+    int spill;
+    int64_t shared_ttl;
+    SharedSource *src;
+    char *inner_url;
+    int inner_flags;
+    AVDictionary *inner_options;
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -71,6 +131,514 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+static int shared_block_cmp(const void *key, const void *node)
+{
+    return FFDIFFSIGN(*(const int64_t *)key, ((const SharedBlock *) node)->index);
+}
+
+static void shared_lru_unlink(SharedBlock *b)
+{
+    if (b->prev)
+        b->prev->next = b->next;
+    else
+        shared_cache.lru_first = b->next;
+    if (b->next)
+        b->next->prev = b->prev;
+    else
+        shared_cache.lru_last = b->prev;
+    b->prev = b->next = NULL;
+}
+
+static void shared_lru_push(SharedBlock *b)
+{
+    b->prev = NULL;
+    b->next = shared_cache.lru_first;
+    if (b->next)
+        b->next->prev = b;
+    else
+        shared_cache.lru_last = b;
+    shared_cache.lru_first = b;
+}
+
+static void shared_block_free(SharedBlock *b)
+{
+    if (b->data) {
+        shared_lru_unlink(b);
+        shared_cache.mem_used -= b->size;
+        av_free(b->data);
+    }
+    av_free(b);
+}
+
+static void shared_block_remove(SharedBlock *b)
+{
+    SharedSource *src = b->src;
+    struct AVTreeNode *node = NULL;
+
+    av_tree_insert(&src->blocks, b, shared_block_cmp, &node);
+    av_free(node);
+    src->nb_blocks--;
+    shared_block_free(b);
+}
+
+static int shared_enu_free(void *opaque, void *elem)
+{
+    shared_block_free(elem);
+    return 0;
+}
+
+static void shared_source_free(SharedSource *src)
+{
+    SharedSource **p;
+
+    for (p = &shared_cache.sources; *p != src; p = &(*p)->next)
+        ;
+    *p = src->next;
+
+    av_tree_enumerate(src->blocks, NULL, NULL, shared_enu_free);
+    av_tree_destroy(src->blocks);
+    if (src->spill_fd >= 0)
+        close(src->spill_fd);
+    if (src->spill_name) {
+        unlink(src->spill_name);
+        av_free(src->spill_name);
+    }
+    av_free(src->key);
+    av_dict_free(&src->unused_options);
+#if HAVE_THREADS
+    pthread_cond_destroy(&src->cond);
+#endif
+    av_free(src);
+}
+
+/* Drop the sources no reader has used for longer than their ttl. */
+static void shared_expire(void)
+{
+    int64_t now = av_gettime_relative();
+    SharedSource *src = shared_cache.sources, *next;
+
+    for (; src; src = next) {
+        next = src->next;
+        if (!src->refcount && now - src->last_used >= src->ttl)
+            shared_source_free(src);
+    }
+}
+
+static int shared_spill(SharedBlock *b)
+{
+    SharedSource *src = b->src;
+    int64_t pos;
+    int ret;
+
+    if (src->spill_fd < 0) {
+        src->spill_fd = avpriv_tempfile("ffcache", &src->spill_name, 0, NULL);
+        if (src->spill_fd < 0)
+            return src->spill_fd;
+        if (unlink(src->spill_name) >= 0)
+            av_freep(&src->spill_name);
+    }
+
+    pos = lseek(src->spill_fd, 0, SEEK_END);
+    if (pos < 0)
+        return AVERROR(errno);
+    ret = write(src->spill_fd, b->data, b->size);
+    if (ret != b->size)
+        return ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+
+    shared_lru_unlink(b);
+    shared_cache.mem_used -= b->size;
+    av_freep(&b->data);
+    b->spill_pos = pos;
+    return 0;
+}
+
+static void shared_evict(void)
+{
+    while (shared_cache.mem_used > shared_cache.mem_limit && shared_cache.lru_last) {
+        SharedBlock *b = shared_cache.lru_last;
+        SharedSource *src = b->src;
+
+        if (src->spill && shared_spill(b) >= 0)
+            continue;
+        shared_block_remove(b);
+        if (!src->refcount && !src->nb_blocks)
+            shared_source_free(src);
+    }
+}
+
+/* Options such as headers, credentials or a start offset change the data
+ * returned for a URL, and which ones do depends on the protocol, so all of
+ * them are part of the key. */
+static int shared_source_key(char **key, const char *url, const AVDictionary *options)
+{
+    AVDictionaryEntry *e = NULL;
+    AVBPrint bp;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "%s", url);
+    while ((e = av_dict_get(options, "", e, AV_DICT_IGNORE_SUFFIX)))
+        av_bprintf(&bp, "\n%s=%s", e->key, e->value);
+    return av_bprint_finalize(&bp, key);
+}
+
+/* Called with shared_mutex held, src referenced by the caller. */
+static int shared_wait_open(URLContext *h, SharedSource *src)
+{
+    while (src->opening) {
+#if HAVE_THREADS
+        int64_t t = av_gettime() + 100000;
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        int err = pthread_cond_timedwait(&src->cond, &shared_mutex, &tv);
+        if (err && err != ETIMEDOUT)
+            return AVERROR(err);
+        if (ff_check_interrupt(&h->interrupt_callback))
+            return AVERROR_EXIT;
+#else
+        av_assert0(0);
+#endif
+    }
+    return src->open_error;
+}
+
+static int shared_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    Context *c = h->priv_data;
+    AVDictionaryEntry *e = NULL;
+    AVDictionary *left = NULL;
+    SharedSource *src;
+    char *key;
+    int ret;
+
+    if ((ret = shared_source_key(&key, arg, options ? *options : NULL)) < 0)
+        return ret;
+
+    ff_mutex_lock(&shared_mutex);
+    shared_expire();
+    for (src = shared_cache.sources; src; src = src->next)
+        if (!src->open_error && !strcmp(src->key, key))
+            break;
+    if (!src) {
+        src = av_mallocz(sizeof(*src));
+        if (!src) {
+            av_free(key);
+            ff_mutex_unlock(&shared_mutex);
+            return AVERROR(ENOMEM);
+        }
+#if HAVE_THREADS
+        if ((ret = pthread_cond_init(&src->cond, NULL))) {
+            av_free(key);
+            av_free(src);
+            ff_mutex_unlock(&shared_mutex);
+            return AVERROR(ret);
+        }
+#endif
+        src->key      = key;
+        src->opening  = 1;
+        src->spill_fd = -1;
+        src->next = shared_cache.sources;
+        shared_cache.sources = src;
+    } else {
+        av_free(key);
+        /* Somebody already fetched from this URL, only connect once a block
+         * is missing from the cache. */
+        c->inner_url = av_strdup(arg);
+        if (!c->inner_url) {
+            ff_mutex_unlock(&shared_mutex);
+            return AVERROR(ENOMEM);
+        }
+    }
+    src->refcount++;
+    src->spill |= c->spill;
+    shared_cache.mem_limit = FFMAX(shared_cache.mem_limit, c->cache_size);
+    c->src = src;
+
+    if (c->inner_url) {
+        /* Consume the options as the first open of the source did, so that
+         * the caller sees the same unused options with or without a cache
+         * hit. The full set is kept for our own connection. */
+        c->inner_flags = flags;
+        if ((ret = shared_wait_open(h, src)) >= 0 &&
+            (ret = av_dict_copy(&c->inner_options, options ? *options : NULL, 0)) >= 0) {
+            while (options && (e = av_dict_get(*options, "", e, AV_DICT_IGNORE_SUFFIX))) {
+                if (av_dict_get(src->unused_options, e->key, NULL, AV_DICT_MATCH_CASE) &&
+                    (ret = av_dict_set(&left, e->key, e->value, 0)) < 0)
+                    break;
+            }
+            if (ret >= 0 && options) {
+                av_dict_free(options);
+                *options = left;
+                left = NULL;
+            }
+        }
+        if (ret < 0) {
+            if (!--src->refcount && !src->nb_blocks)
+                shared_source_free(src);
+            c->src = NULL;
+        }
+        ff_mutex_unlock(&shared_mutex);
+        av_dict_free(&left);
+        return ret;
+    }
+    ff_mutex_unlock(&shared_mutex);
+
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+
+    ff_mutex_lock(&shared_mutex);
+    if (ret >= 0 && options &&
+        (ret = av_dict_copy(&src->unused_options, *options, 0)) < 0)
+        ffurl_closep(&c->inner);
+    src->opening    = 0;
+    src->open_error = FFMIN(ret, 0);
+#if HAVE_THREADS
+    pthread_cond_broadcast(&src->cond);
+#endif
+    if (ret < 0) {
+        if (!--src->refcount && !src->nb_blocks)
+            shared_source_free(src);
+        c->src = NULL;
+    }
+    ff_mutex_unlock(&shared_mutex);
+    return ret;
+}
+
+static int shared_open_inner(URLContext *h)
+{
+    Context *c = h->priv_data;
+    int ret;
+
+    if (c->inner)
+        return 0;
+    ret = ffurl_open_whitelist(&c->inner, c->inner_url, c->inner_flags,
+                               &h->interrupt_callback, &c->inner_options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        av_log(h, AV_LOG_ERROR, "Failed to open %s\n", c->inner_url);
+    c->inner_pos = 0;
+    return ret;
+}
+
+/* Fill data with the block at pos from our own connection, called unlocked.
+ * Returns the number of bytes read, less than a full block only at EOF. */
+static int shared_fetch(URLContext *h, uint8_t *data, int64_t pos)
+{
+    Context *c = h->priv_data;
+    int size = 0, r;
+
+    if ((r = shared_open_inner(h)) < 0)
+        return r;
+
+    if (c->inner_pos != pos) {
+        int64_t ret = ffurl_seek(c->inner, pos, SEEK_SET);
+        if (ret >= 0) {
+            c->inner_pos = ret;
+        } else if (pos < c->inner_pos) {
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+            return ret;
+        }
+        /* Not seekable, skip forward to the block. */
+        while (c->inner_pos < pos) {
+            r = ffurl_read(c->inner, data, FFMIN(SHARED_BLOCK_SIZE, pos - c->inner_pos));
+            if (r <= 0)
+                return r;
+            c->inner_pos += r;
+        }
+    }
+
+    while (size < SHARED_BLOCK_SIZE) {
+        r = ffurl_read(c->inner, data + size, SHARED_BLOCK_SIZE - size);
+        if (r == AVERROR_EOF || !r)
+            break;
+        if (r < 0)
+            return r;
+        size        += r;
+        c->inner_pos += r;
+    }
+    return size;
+}
+
+static int shared_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c = h->priv_data;
+    SharedSource *src = c->src;
+    int64_t index = c->logical_pos / SHARED_BLOCK_SIZE;
+    int off = c->logical_pos % SHARED_BLOCK_SIZE;
+    struct AVTreeNode *node;
+    SharedBlock *b;
+    uint8_t *data;
+    int r;
+
+    ff_mutex_lock(&shared_mutex);
+    while ((b = av_tree_find(src->blocks, &index, shared_block_cmp, NULL))) {
+        if (b->loading) {
+#if HAVE_THREADS
+            /* Wake up regularly to honor the interrupt callback, the reader
+             * loading the block may be stuck on a stalled connection. */
+            int64_t t = av_gettime() + 100000;
+            struct timespec tv = { .tv_sec  =  t / 1000000,
+                                   .tv_nsec = (t % 1000000) * 1000 };
+            int err = pthread_cond_timedwait(&src->cond, &shared_mutex, &tv);
+            if (err && err != ETIMEDOUT) {
+                ff_mutex_unlock(&shared_mutex);
+                return AVERROR(err);
+            }
+            if (ff_check_interrupt(&h->interrupt_callback)) {
+                ff_mutex_unlock(&shared_mutex);
+                return AVERROR_EXIT;
+            }
+            continue;
+#else
+            av_assert0(0);
+#endif
+        }
+        if (off >= b->size) {
+            r = AVERROR_EOF;
+        } else if (b->data) {
+            r = FFMIN(size, b->size - off);
+            memcpy(buf, b->data + off, r);
+            shared_lru_unlink(b);
+            shared_lru_push(b);
+        } else {
+            r = -1;
+            if (lseek(src->spill_fd, b->spill_pos + off, SEEK_SET) >= 0)
+                r = read(src->spill_fd, buf, FFMIN(size, b->size - off));
+            if (r <= 0) {
+                av_log(h, AV_LOG_ERROR, "read from spill file failed\n");
+                r = r < 0 ? AVERROR(errno) : AVERROR(EIO);
+            }
+        }
+        if (r > 0) {
+            c->logical_pos += r;
+            c->cache_hit++;
+        }
+        ff_mutex_unlock(&shared_mutex);
+        return r;
+    }
+
+    if (src->is_true_eof && c->logical_pos >= src->end) {
+        ff_mutex_unlock(&shared_mutex);
+        return AVERROR_EOF;
+    }
+
+    b    = av_mallocz(sizeof(*b));
+    node = av_tree_node_alloc();
+    data = av_malloc(SHARED_BLOCK_SIZE);
+    if (!b || !node || !data) {
+        ff_mutex_unlock(&shared_mutex);
+        av_free(b);
+        av_free(node);
+        av_free(data);
+        return AVERROR(ENOMEM);
+    }
+    b->index     = index;
+    b->src       = src;
+    b->spill_pos = -1;
+    b->loading   = 1;
+    av_tree_insert(&src->blocks, b, shared_block_cmp, &node);
+    src->nb_blocks++;
+    ff_mutex_unlock(&shared_mutex);
+
+    r = shared_fetch(h, data, index * SHARED_BLOCK_SIZE);
+
+    ff_mutex_lock(&shared_mutex);
+    if (r < SHARED_BLOCK_SIZE && r >= 0) {
+        src->is_true_eof = 1;
+        src->end         = index * SHARED_BLOCK_SIZE + r;
+    }
+    if (r <= 0) {
+        shared_block_remove(b);
+        av_free(data);
+        if (!r)
+            r = AVERROR_EOF;
+    } else {
+        b->loading = 0;
+        b->data    = data;
+        b->size    = r;
+        shared_cache.mem_used += r;
+        shared_lru_push(b);
+        c->cache_miss++;
+
+        r = off < b->size ? FFMIN(size, b->size - off) : AVERROR_EOF;
+        if (r > 0) {
+            memcpy(buf, data + off, r);
+            c->logical_pos += r;
+        }
+        shared_evict();
+    }
+#if HAVE_THREADS
+    pthread_cond_broadcast(&src->cond);
+#endif
+    ff_mutex_unlock(&shared_mutex);
+    return r;
+}
+
+static int64_t shared_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context *c = h->priv_data;
+    SharedSource *src = c->src;
+    int64_t ret, end;
+    int is_true_eof;
+
+    ff_mutex_lock(&shared_mutex);
+    is_true_eof = src->is_true_eof;
+    end         = src->end;
+    ff_mutex_unlock(&shared_mutex);
+
+    if (!is_true_eof && (whence == AVSEEK_SIZE || whence == SEEK_END)) {
+        if ((ret = shared_open_inner(h)) < 0)
+            return ret;
+        end = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+        if (end <= 0)
+            return whence == AVSEEK_SIZE ? end : AVERROR(ENOSYS);
+        ff_mutex_lock(&shared_mutex);
+        src->is_true_eof = 1;
+        src->end         = end;
+        ff_mutex_unlock(&shared_mutex);
+    }
+
+    if (whence == AVSEEK_SIZE)
+        return end;
+    if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END)
+        pos += end;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* The inner connection is only repositioned once a block is missing. */
+    c->logical_pos = pos;
+    return pos;
+}
+
+static int shared_close(URLContext *h)
+{
+    Context *c = h->priv_data;
+    SharedSource *src = c->src;
+
+    av_log(h, AV_LOG_INFO, "Statistics, shared cache hits:%"PRId64" cache misses:%"PRId64"\n",
+           c->cache_hit, c->cache_miss);
+
+    ffurl_closep(&c->inner);
+    av_dict_free(&c->inner_options);
+    av_freep(&c->inner_url);
+    if (!src)
+        return 0;
+
+    ff_mutex_lock(&shared_mutex);
+    src->ttl       = FFMAX(src->ttl, c->shared_ttl);
+    src->last_used = av_gettime_relative();
+    if (!--src->refcount && (!src->ttl || !src->nb_blocks))
+        shared_source_free(src);
+    shared_expire();
+    ff_mutex_unlock(&shared_mutex);
+    c->src = NULL;
+
+    return 0;
+}
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     int ret;
@@ -79,6 +647,9 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->shared)
+        return shared_open(h, arg, flags, options);
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -165,6 +736,9 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     CacheEntry *entry, *next[2] = {NULL, NULL};
     int64_t r;
 
+    if (c->shared)
+        return shared_read(h, buf, size);
+
     entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
 
     if (!entry)
@@ -229,6 +803,9 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     Context *c= h->priv_data;
     int64_t ret;
 
+    if (c->shared)
+        return shared_seek(h, pos, whence);
+
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
@@ -300,6 +877,9 @@ static int cache_close(URLContext *h)
     Context *c= h->priv_data;
     int ret;
 
+    if (c->shared)
+        return shared_close(h);
+
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
@@ -322,6 +902,10 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "shared", "Share the cache with other readers of the same URL in this process", OFFSET(shared), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "cache_size", "Memory budget in bytes of the shared cache", OFFSET(cache_size), AV_OPT_TYPE_INT64, { .i64 = 64 << 20 }, SHARED_BLOCK_SIZE, INT64_MAX, D },
+    { "spill", "Spill blocks evicted from the shared cache to a tempfile", OFFSET(spill), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "shared_ttl", "How long the shared cache of a URL is kept after its last reader closed", OFFSET(shared_ttl), AV_OPT_TYPE_DURATION, { .i64 = 0 }, 0, INT64_MAX, D },
     {NULL},
 };
 
@@ -18,12 +18,15 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "libavutil/timestamp.h"
 #include "avformat.h"
 #include "internal.h"
@@ -34,6 +37,12 @@ typedef enum ConcatMatchMode {
     MATCH_EXACT_ID,
 } ConcatMatchMode;
 
+enum PreopenState {
+    PREOPEN_NONE,
+    PREOPEN_RUNNING,
+    PREOPEN_DONE,
+};
+
 typedef struct ConcatStream {
     AVBSFContext *bsf;
     int out_stream_index;
@@ -52,6 +61,9 @@ typedef struct {
     int64_t outpoint;
     AVDictionary *metadata;
     int nb_streams;
+    AVFormatContext *preopened;
+    int preopen_ret;
+    enum PreopenState preopen_state;
 } ConcatFile;
 
 typedef struct {
@@ -66,6 +78,15 @@ typedef struct {
     ConcatMatchMode stream_match_mode;
     unsigned auto_convert;
     int segment_time_metadata;
+    int preopen;
+#if HAVE_THREADS
+    pthread_t preopen_thread;
+    pthread_mutex_t preopen_lock;
+    pthread_cond_t preopen_cond;
+    int preopen_thread_started;
+    unsigned preopen_cur;       ///< files after this one are opened ahead
+    atomic_int preopen_abort;
+#endif
 } ConcatContext;
 
 static int concat_probe(const AVProbeData *probe)
@@ -325,31 +346,197 @@ static int64_t get_best_effort_duration(ConcatFile *file, AVFormatContext *avf)
     return AV_NOPTS_VALUE;
 }
 
-static int open_file(AVFormatContext *avf, unsigned fileno)
+#if HAVE_THREADS
+static int preopen_interrupt(void *opaque)
 {
+    AVFormatContext *avf = opaque;
     ConcatContext *cat = avf->priv_data;
-    ConcatFile *file = &cat->files[fileno];
-    int ret;
 
-    if (cat->avf)
-        avformat_close_input(&cat->avf);
+    return atomic_load(&cat->preopen_abort) ||
+           ff_check_interrupt(&avf->interrupt_callback);
+}
+#endif
 
-    cat->avf = avformat_alloc_context();
-    if (!cat->avf)
+/**
+ * Open and probe the input of a file entry, and seek to its inpoint.
+ * May run in the preopen thread, so it must not modify the concat context.
+ */
+static int open_input(AVFormatContext *avf, ConcatFile *file,
+                      AVFormatContext **pctx)
+{
+    ConcatContext av_unused *cat = avf->priv_data;
+    AVFormatContext *ctx;
+    int ret;
+
+    ctx = avformat_alloc_context();
+    if (!ctx)
         return AVERROR(ENOMEM);
 
-    cat->avf->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
-    cat->avf->interrupt_callback = avf->interrupt_callback;
+    ctx->flags |= avf->flags & ~AVFMT_FLAG_CUSTOM_IO;
+    ctx->interrupt_callback = avf->interrupt_callback;
+#if HAVE_THREADS
+    if (cat->preopen > 0)
+        ctx->interrupt_callback = (AVIOInterruptCB){ preopen_interrupt, avf };
+#endif
 
-    if ((ret = ff_copy_whiteblacklists(cat->avf, avf)) < 0)
+    if ((ret = ff_copy_whiteblacklists(ctx, avf)) < 0) {
+        avformat_free_context(ctx);
         return ret;
+    }
 
-    if ((ret = avformat_open_input(&cat->avf, file->url, NULL, NULL)) < 0 ||
-        (ret = avformat_find_stream_info(cat->avf, NULL)) < 0) {
+    if ((ret = avformat_open_input(&ctx, file->url, NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(ctx, NULL)) < 0) {
         av_log(avf, AV_LOG_ERROR, "Impossible to open '%s'\n", file->url);
-        avformat_close_input(&cat->avf);
+        avformat_close_input(&ctx);
         return ret;
     }
+    if (file->inpoint != AV_NOPTS_VALUE) {
+        if ((ret = avformat_seek_file(ctx, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0) {
+            avformat_close_input(&ctx);
+            return ret;
+        }
+    }
+    *pctx = ctx;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *preopen_thread(void *arg)
+{
+    AVFormatContext *avf = arg;
+    ConcatContext *cat = avf->priv_data;
+
+    pthread_mutex_lock(&cat->preopen_lock);
+    while (!atomic_load(&cat->preopen_abort)) {
+        ConcatFile *file = NULL;
+        AVFormatContext *ctx = NULL;
+        unsigned i, end = FFMIN(cat->preopen_cur + cat->preopen, cat->nb_files - 1);
+        int ret;
+
+        for (i = cat->preopen_cur + 1; i <= end; i++) {
+            if (cat->files[i].preopen_state == PREOPEN_NONE) {
+                file = &cat->files[i];
+                break;
+            }
+        }
+        if (!file) {
+            pthread_cond_wait(&cat->preopen_cond, &cat->preopen_lock);
+            continue;
+        }
+
+        file->preopen_state = PREOPEN_RUNNING;
+        pthread_mutex_unlock(&cat->preopen_lock);
+        av_log(avf, AV_LOG_VERBOSE, "Opening '%s' ahead of time\n", file->url);
+        ret = open_input(avf, file, &ctx);
+        pthread_mutex_lock(&cat->preopen_lock);
+
+        file->preopened    = ctx;
+        file->preopen_ret  = ret;
+        file->preopen_state = PREOPEN_DONE;
+        pthread_cond_broadcast(&cat->preopen_cond);
+    }
+    pthread_mutex_unlock(&cat->preopen_lock);
+    return NULL;
+}
+
+/**
+ * Take the input of a file entry from the preopen thread, waiting for it if
+ * it is being opened, and move the preopen window past that entry.
+ *
+ * @return 1 if the input was taken, 0 if it must be opened by the caller
+ */
+static int take_preopened(AVFormatContext *avf, unsigned fileno,
+                          AVFormatContext **pctx, int *pret)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    int taken = 0;
+    unsigned i;
+
+    pthread_mutex_lock(&cat->preopen_lock);
+    while (file->preopen_state == PREOPEN_RUNNING)
+        pthread_cond_wait(&cat->preopen_cond, &cat->preopen_lock);
+    if (file->preopen_state == PREOPEN_DONE) {
+        *pctx = file->preopened;
+        *pret = file->preopen_ret;
+        file->preopened     = NULL;
+        file->preopen_state = PREOPEN_NONE;
+        taken = 1;
+    }
+
+    /* drop inputs which fell out of the window, e.g. after a seek */
+    cat->preopen_cur = fileno;
+    for (i = 0; i < cat->nb_files; i++) {
+        ConcatFile *f = &cat->files[i];
+        if (f->preopen_state == PREOPEN_DONE &&
+            (i <= fileno || i > fileno + cat->preopen)) {
+            avformat_close_input(&f->preopened);
+            f->preopen_state = PREOPEN_NONE;
+        }
+    }
+    pthread_cond_signal(&cat->preopen_cond);
+    pthread_mutex_unlock(&cat->preopen_lock);
+    return taken;
+}
+
+static int start_preopen(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    int ret;
+
+    cat->preopen_cur = cat->cur_file - cat->files;
+    atomic_init(&cat->preopen_abort, 0);
+    pthread_mutex_init(&cat->preopen_lock, NULL);
+    pthread_cond_init(&cat->preopen_cond, NULL);
+    ret = pthread_create(&cat->preopen_thread, NULL, preopen_thread, avf);
+    if (ret) {
+        pthread_mutex_destroy(&cat->preopen_lock);
+        pthread_cond_destroy(&cat->preopen_cond);
+        return AVERROR(ret);
+    }
+    cat->preopen_thread_started = 1;
+    return 0;
+}
+
+static void stop_preopen(AVFormatContext *avf)
+{
+    ConcatContext *cat = avf->priv_data;
+    unsigned i;
+
+    if (!cat->preopen_thread_started)
+        return;
+    pthread_mutex_lock(&cat->preopen_lock);
+    atomic_store(&cat->preopen_abort, 1);
+    pthread_cond_signal(&cat->preopen_cond);
+    pthread_mutex_unlock(&cat->preopen_lock);
+    pthread_join(cat->preopen_thread, NULL);
+    pthread_mutex_destroy(&cat->preopen_lock);
+    pthread_cond_destroy(&cat->preopen_cond);
+    cat->preopen_thread_started = 0;
+
+    for (i = 0; i < cat->nb_files; i++)
+        avformat_close_input(&cat->files[i].preopened);
+}
+#endif
+
+static int open_file(AVFormatContext *avf, unsigned fileno)
+{
+    ConcatContext *cat = avf->priv_data;
+    ConcatFile *file = &cat->files[fileno];
+    int ret = 0, taken = 0;
+
+    if (cat->avf)
+        avformat_close_input(&cat->avf);
+
+#if HAVE_THREADS
+    if (cat->preopen_thread_started)
+        taken = take_preopened(avf, fileno, &cat->avf, &ret);
+#endif
+    if (!taken)
+        ret = open_input(avf, file, &cat->avf);
+    if (ret < 0)
+        return ret;
+
     cat->cur_file = file;
     file->start_time = !fileno ? 0 :
                        cat->files[fileno - 1].start_time +
@@ -364,13 +551,7 @@ static int open_file(AVFormatContext *avf, unsigned fileno)
             av_dict_set_int(&file->metadata, "lavf.concatdec.duration", file->duration, 0);
     }
 
-    if ((ret = match_streams(avf)) < 0)
-        return ret;
-    if (file->inpoint != AV_NOPTS_VALUE) {
-       if ((ret = avformat_seek_file(cat->avf, -1, INT64_MIN, file->inpoint, file->inpoint, 0)) < 0)
-           return ret;
-    }
-    return 0;
+    return match_streams(avf);
 }
 
 static int concat_read_close(AVFormatContext *avf)
@@ -378,6 +559,9 @@ static int concat_read_close(AVFormatContext *avf)
     ConcatContext *cat = avf->priv_data;
     unsigned i, j;
 
+#if HAVE_THREADS
+    stop_preopen(avf);
+#endif
     for (i = 0; i < cat->nb_files; i++) {
         av_freep(&cat->files[i].url);
         for (j = 0; j < cat->files[i].nb_streams; j++) {
@@ -510,6 +694,14 @@ static int concat_read_header(AVFormatContext *avf)
                                                MATCH_ONE_TO_ONE;
     if ((ret = open_file(avf, 0)) < 0)
         goto fail;
+    if (cat->preopen > 0 && cat->nb_files > 1) {
+#if HAVE_THREADS
+        if ((ret = start_preopen(avf)) < 0)
+            goto fail;
+#else
+        av_log(avf, AV_LOG_WARNING, "preopen requires thread support, ignoring\n");
+#endif
+    }
     av_bprint_finalize(&bp, NULL);
     return 0;
 
@@ -764,6 +956,8 @@ static const AVOption options[] = {
       OFFSET(auto_convert), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, DEC },
     { "segment_time_metadata", "output file segment start time and duration as packet metadata",
       OFFSET(segment_time_metadata), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, DEC },
+    { "preopen", "number of files to open ahead of time in a background thread",
+      OFFSET(preopen), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, DEC },
     { NULL }
 };
 
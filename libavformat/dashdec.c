@@ -20,17 +20,21 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <libxml/parser.h>
+#include "libavutil/avassert.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "http.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 #define MAX_MANIFEST_SIZE 50 * 1024
 #define DEFAULT_MANIFEST_SIZE 8 * 1024
+#define MAX_PREFETCH_THREADS 16
 
 struct fragment {
     int64_t url_offset;
@@ -120,7 +124,37 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    /* prefetched fragment in use as input, if any */
+    struct prefetch_slot *input_slot;
+};
+
+#if HAVE_THREADS
+enum PrefetchState {
+    PREFETCH_FREE,
+    PREFETCH_REQUESTED,
+    PREFETCH_LOADING,
+    PREFETCH_DONE,
+    PREFETCH_IN_USE,
+};
+
+/* A fragment downloaded into memory ahead of time by a prefetch thread. */
+struct prefetch_slot {
+    enum PrefetchState state;
+    struct representation *rep;
+    int64_t seq_no;
+    /* to the current fragment of rep, the closest fragments are loaded first */
+    int64_t distance;
+    char *url;
+    int64_t url_offset;
+    int64_t size;
+    AVDictionary *opts;
+    uint8_t *data;
+    int64_t len;
+    int64_t read_pos;
+    int ret;
 };
+#endif
 
 typedef struct DASHContext {
     const AVClass *class;
@@ -160,6 +194,21 @@ typedef struct DASHContext {
     int is_init_section_common_video;
     int is_init_section_common_audio;
 
+    int prefetch_segments;
+    int64_t prefetch_max_size;
+#if HAVE_THREADS
+    /* Fragments of all representations downloaded concurrently with the
+     * demuxing, see the prefetch_segments option. The slots are protected
+     * by prefetch_mutex, except the ones in use as input. */
+    struct prefetch_slot *prefetch_slots;
+    int n_prefetch_slots;
+    int64_t prefetch_buffered;
+    pthread_t *prefetch_threads;
+    int n_prefetch_threads;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+    int prefetch_abort;
+#endif
 } DASHContext;
 
 static int ishttp(char *url)
@@ -348,6 +397,8 @@ static void free_timelines_list(struct representation *pls)
     pls->n_timelines = 0;
 }
 
+static void close_input(struct representation *pls);
+
 static void free_representation(struct representation *pls)
 {
     free_fragment_list(pls);
@@ -356,7 +407,7 @@ static void free_representation(struct representation *pls)
     free_fragment(&pls->init_section);
     av_freep(&pls->init_sec_buf);
     av_freep(&pls->pb.buffer);
-    ff_format_io_close(pls->parent, &pls->input);
+    close_input(pls);
     if (pls->ctx) {
         pls->ctx->pb = NULL;
         avformat_close_input(&pls->ctx);
@@ -399,16 +450,10 @@ static void free_subtitle_list(DASHContext *c)
     c->n_subtitles = 0;
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http)
+static int check_url(AVFormatContext *s, const char *url, int *is_http)
 {
     DASHContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
-
-    av_dict_copy(&tmp, opts, 0);
-    av_dict_copy(&tmp, opts2, 0);
 
     if (av_strstart(url, "crypto", NULL)) {
         if (url[6] == '+' || url[6] == ':')
@@ -442,6 +487,25 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    if (is_http)
+        *is_http = av_strstart(proto_name, "http", NULL);
+
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary *opts, AVDictionary *opts2, int *is_http)
+{
+    DASHContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+
+    if ((ret = check_url(s, url, is_http)) < 0)
+        return ret;
+
+    av_dict_copy(&tmp, opts, 0);
+    av_dict_copy(&tmp, opts2, 0);
+
     av_freep(pb);
     ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
@@ -459,10 +523,25 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
 
     av_dict_free(&tmp);
 
-    if (is_http)
-        *is_http = av_strstart(proto_name, "http", NULL);
+    return ret;
+}
 
+static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
+                              const char *url, AVDictionary **options)
+{
+#if !CONFIG_HTTP_PROTOCOL
+    return AVERROR_PROTOCOL_NOT_FOUND;
+#else
+    int ret;
+    URLContext *uc = ffio_geturlcontext(*pb);
+    av_assert0(uc);
+    (*pb)->eof_reached = 0;
+    ret = ff_http_do_new_request2(uc, url, options);
+    if (ret < 0) {
+        ff_format_io_close(s, pb);
+    }
     return ret;
+#endif
 }
 
 static char *get_content_url(xmlNodePtr *baseurl_nodes,
@@ -1611,6 +1690,38 @@ finish:
     return ret;
 }
 
+static struct fragment *get_fragment_from_template(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    seg = av_mallocz(sizeof(struct fragment));
+    if (!seg)
+        return NULL;
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        av_free(seg);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
@@ -1653,34 +1764,9 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"], playlist %d\n", min_seq_no, max_seq_no, (int)pls->rep_idx);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+        seg = get_fragment_from_template(pls, pls->cur_seq_no);
     } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    }
-    if (seg) {
-        char *tmpfilename= av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+        seg = get_fragment_from_template(pls, pls->cur_seq_no);
     }
 
     return seg;
@@ -1734,6 +1820,426 @@ cleanup:
     return ret;
 }
 
+#if HAVE_THREADS
+static void prefetch_slot_reset(DASHContext *c, struct prefetch_slot *slot)
+{
+    if (slot->state == PREFETCH_DONE || slot->state == PREFETCH_IN_USE)
+        c->prefetch_buffered -= slot->len;
+    av_freep(&slot->url);
+    av_dict_free(&slot->opts);
+    slot->rep      = NULL;
+    slot->len      = 0;
+    slot->read_pos = 0;
+    slot->state    = PREFETCH_FREE;
+}
+
+static int prefetch_interrupt(void *opaque)
+{
+    AVFormatContext *s = opaque;
+    DASHContext *c = s->priv_data;
+
+    return c->prefetch_abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+/* Download a whole fragment into slot->data, called without the lock held.
+ * *pb is the connection of the calling thread, kept open across fragments
+ * served by the same HTTP server. */
+static int prefetch_load(AVFormatContext *s, struct prefetch_slot *slot, AVIOContext **pb)
+{
+    const AVIOInterruptCB int_cb = { prefetch_interrupt, s };
+    int is_http = 0, ret;
+
+    if ((ret = check_url(s, slot->url, &is_http)) < 0)
+        return ret;
+
+    /* also resets a range restriction left over on a kept-alive connection */
+    av_dict_set_int(&slot->opts, "offset", slot->size >= 0 ? slot->url_offset : 0, 0);
+    av_dict_set_int(&slot->opts, "end_offset", slot->size >= 0 ? slot->url_offset + slot->size : 0, 0);
+
+    ret = -1;
+    if (*pb && is_http)
+        ret = open_url_keepalive(s, pb, slot->url, &slot->opts);
+    if (ret < 0) {
+        ff_format_io_close(s, pb);
+        if (is_http)
+            av_dict_set(&slot->opts, "multiple_requests", "1", 0);
+        ret = ffio_open_whitelist(pb, slot->url, AVIO_FLAG_READ, &int_cb, &slot->opts,
+                                  s->protocol_whitelist, s->protocol_blacklist);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (!is_http && slot->url_offset) {
+        int64_t seekret = avio_seek(*pb, slot->url_offset, SEEK_SET);
+        if (seekret < 0) {
+            ret = seekret;
+            goto end;
+        }
+    }
+
+    slot->len = 0;
+    for (;;) {
+        int size = INITIAL_BUFFER_SIZE * 8;
+
+        if (slot->size >= 0)
+            size = FFMIN(size, slot->size - slot->len);
+        if (size <= 0)
+            break;
+        if (slot->len + size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_reallocp(&slot->data, slot->len + size);
+        if (ret < 0)
+            goto end;
+        ret = avio_read(*pb, slot->data + slot->len, size);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            goto end;
+        slot->len += ret;
+    }
+    ret = 0;
+
+end:
+    if (!is_http || ret < 0)
+        ff_format_io_close(s, pb);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    DASHContext *c = s->priv_data;
+    AVIOContext *pb = NULL;
+    int i, ret;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    while (!c->prefetch_abort) {
+        struct prefetch_slot *slot = NULL;
+
+        for (i = 0; i < c->n_prefetch_slots; i++) {
+            struct prefetch_slot *cand = &c->prefetch_slots[i];
+            if (cand->state != PREFETCH_REQUESTED)
+                continue;
+            /* the fragments being read are always loaded */
+            if (cand->distance > 0 && c->prefetch_buffered >= c->prefetch_max_size)
+                continue;
+            if (!slot || cand->distance < slot->distance)
+                slot = cand;
+        }
+        if (!slot) {
+            pthread_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+            continue;
+        }
+
+        slot->state = PREFETCH_LOADING;
+        pthread_mutex_unlock(&c->prefetch_mutex);
+
+        av_log(s, AV_LOG_VERBOSE, "DASH prefetch of url '%s', offset %"PRId64"\n",
+               slot->url, slot->url_offset);
+        ret = prefetch_load(s, slot, &pb);
+
+        pthread_mutex_lock(&c->prefetch_mutex);
+        slot->ret   = ret;
+        slot->state = PREFETCH_DONE;
+        c->prefetch_buffered += slot->len;
+        pthread_cond_broadcast(&c->prefetch_cond);
+    }
+    pthread_mutex_unlock(&c->prefetch_mutex);
+
+    ff_format_io_close(s, &pb);
+    return NULL;
+}
+
+static void prefetch_uninit(DASHContext *c)
+{
+    int i;
+
+    if (!c->prefetch_slots)
+        return;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    c->prefetch_abort = 1;
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+
+    for (i = 0; i < c->n_prefetch_threads; i++)
+        pthread_join(c->prefetch_threads[i], NULL);
+    av_freep(&c->prefetch_threads);
+    c->n_prefetch_threads = 0;
+
+    for (i = 0; i < c->n_prefetch_slots; i++) {
+        prefetch_slot_reset(c, &c->prefetch_slots[i]);
+        av_freep(&c->prefetch_slots[i].data);
+    }
+    av_freep(&c->prefetch_slots);
+    c->n_prefetch_slots = 0;
+
+    pthread_cond_destroy(&c->prefetch_cond);
+    pthread_mutex_destroy(&c->prefetch_mutex);
+}
+
+static int prefetch_init(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int n_reps = c->n_videos + c->n_audios + c->n_subtitles;
+    int i, ret;
+
+    /* the current fragment and the next prefetch_segments ones of every
+     * representation, loaded by a shared pool of threads */
+    c->n_prefetch_slots = (c->prefetch_segments + 1) * n_reps;
+    c->prefetch_slots   = av_mallocz_array(c->n_prefetch_slots, sizeof(*c->prefetch_slots));
+    c->prefetch_threads = av_mallocz_array(FFMIN(c->n_prefetch_slots, MAX_PREFETCH_THREADS),
+                                           sizeof(*c->prefetch_threads));
+    if (!c->prefetch_slots || !c->prefetch_threads) {
+        av_freep(&c->prefetch_slots);
+        av_freep(&c->prefetch_threads);
+        c->n_prefetch_slots = 0;
+        return AVERROR(ENOMEM);
+    }
+
+    pthread_mutex_init(&c->prefetch_mutex, NULL);
+    pthread_cond_init(&c->prefetch_cond, NULL);
+
+    for (i = 0; i < FFMIN(c->n_prefetch_slots, MAX_PREFETCH_THREADS); i++) {
+        ret = AVERROR(pthread_create(&c->prefetch_threads[i], NULL, prefetch_thread, s));
+        if (ret < 0) {
+            prefetch_uninit(c);
+            return ret;
+        }
+        c->n_prefetch_threads++;
+    }
+
+    return 0;
+}
+
+static int prefetch_request(DASHContext *c, struct prefetch_slot *slot,
+                            struct representation *pls, int64_t seq_no)
+{
+    struct fragment *seg = NULL;
+    const struct fragment *src;
+
+    if (pls->n_fragments) {
+        src = pls->fragments[seq_no];
+    } else {
+        seg = get_fragment_from_template(pls, seq_no);
+        if (!seg)
+            return AVERROR(ENOMEM);
+        src = seg;
+    }
+
+    slot->url = av_mallocz(c->max_url_size);
+    if (!slot->url) {
+        free_fragment(&seg);
+        return AVERROR(ENOMEM);
+    }
+    ff_make_absolute_url(slot->url, c->max_url_size, c->base_url, src->url);
+    slot->url_offset = src->url_offset;
+    slot->size       = src->size;
+    slot->rep        = pls;
+    slot->seq_no     = seq_no;
+    slot->distance   = seq_no - pls->cur_seq_no;
+    slot->ret        = 0;
+    free_fragment(&seg);
+
+    if (av_dict_copy(&slot->opts, c->avio_opts, 0) < 0) {
+        prefetch_slot_reset(c, slot);
+        return AVERROR(ENOMEM);
+    }
+    slot->state = PREFETCH_REQUESTED;
+
+    return 0;
+}
+
+static int64_t prefetch_last_seq_no(DASHContext *c, struct representation *pls)
+{
+    int64_t last = pls->n_fragments ? pls->n_fragments - 1 : pls->last_seq_no;
+
+    return FFMIN(pls->cur_seq_no + c->prefetch_segments, last);
+}
+
+/* Drop the fragments that are not needed anymore, after seeking or when a
+ * representation got discarded, and request the missing ones. */
+static void prefetch_schedule(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    struct representation **reps[] = { c->videos, c->audios, c->subtitles };
+    int n_reps[] = { c->n_videos, c->n_audios, c->n_subtitles };
+    int i, j, k;
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+
+    for (i = 0; i < c->n_prefetch_slots; i++) {
+        struct prefetch_slot *slot = &c->prefetch_slots[i];
+        struct representation *pls = slot->rep;
+
+        if (slot->state != PREFETCH_REQUESTED && slot->state != PREFETCH_DONE)
+            continue;
+        if (!pls->ctx || slot->seq_no < pls->cur_seq_no ||
+            slot->seq_no > prefetch_last_seq_no(c, pls))
+            prefetch_slot_reset(c, slot);
+        else
+            slot->distance = slot->seq_no - pls->cur_seq_no;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(reps); i++) {
+        for (j = 0; j < n_reps[i]; j++) {
+            struct representation *pls = reps[i][j];
+            int64_t seq_no;
+
+            if (!pls->ctx || pls->n_fragments == 1)
+                continue;
+            for (seq_no = pls->cur_seq_no; seq_no <= prefetch_last_seq_no(c, pls); seq_no++) {
+                struct prefetch_slot *slot = NULL;
+
+                for (k = 0; k < c->n_prefetch_slots; k++) {
+                    struct prefetch_slot *cand = &c->prefetch_slots[k];
+                    if (cand->state == PREFETCH_FREE)
+                        slot = slot ? slot : cand;
+                    else if (cand->rep == pls && cand->seq_no == seq_no)
+                        break;
+                }
+                if (k < c->n_prefetch_slots)
+                    continue;
+                if (!slot || prefetch_request(c, slot, pls, seq_no) < 0)
+                    break;
+            }
+        }
+    }
+
+    pthread_cond_broadcast(&c->prefetch_cond);
+    pthread_mutex_unlock(&c->prefetch_mutex);
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct prefetch_slot *slot = opaque;
+    int size = FFMIN(buf_size, slot->len - slot->read_pos);
+
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, slot->data + slot->read_pos, size);
+    slot->read_pos += size;
+
+    return size;
+}
+
+static int64_t prefetch_seek(void *opaque, int64_t offset, int whence)
+{
+    struct prefetch_slot *slot = opaque;
+
+    if (whence == AVSEEK_SIZE)
+        return slot->len;
+    if (whence == SEEK_CUR)
+        offset += slot->read_pos;
+    else if (whence == SEEK_END)
+        offset += slot->len;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (offset < 0 || offset > slot->len)
+        return AVERROR(EINVAL);
+    slot->read_pos = offset;
+
+    return offset;
+}
+#endif
+
+/**
+ * Open the current fragment from the prefetched data, waiting for its
+ * download to finish if needed. Returns a negative error code if the
+ * fragment has not been or could not be prefetched.
+ */
+static int open_prefetched_input(DASHContext *c, struct representation *pls, struct fragment *seg)
+{
+#if HAVE_THREADS
+    AVFormatContext *s = pls->parent;
+    struct prefetch_slot *slot = NULL;
+    char *url;
+    uint8_t *buf;
+    int i, ret;
+
+    if (c->prefetch_segments <= 0 || c->is_live || pls->n_fragments == 1)
+        return AVERROR(ENOSYS);
+    if (!c->prefetch_slots && (ret = prefetch_init(s)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Failed to start prefetching\n");
+        c->prefetch_segments = 0;
+        return ret;
+    }
+
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return AVERROR(ENOMEM);
+    ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+
+    prefetch_schedule(s);
+
+    pthread_mutex_lock(&c->prefetch_mutex);
+    for (i = 0; i < c->n_prefetch_slots; i++) {
+        struct prefetch_slot *cand = &c->prefetch_slots[i];
+        if (cand->state != PREFETCH_FREE && cand->rep == pls &&
+            cand->seq_no == pls->cur_seq_no && !strcmp(cand->url, url))
+            slot = cand;
+    }
+    /* downloads are interrupted along with the demuxer, so this
+     * cannot block beyond the interrupt callback */
+    while (slot && (slot->state == PREFETCH_REQUESTED || slot->state == PREFETCH_LOADING))
+        pthread_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+    if (slot && slot->ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Failed to prefetch fragment %"PRId64" of playlist %d: %s\n",
+               pls->cur_seq_no, pls->rep_idx, av_err2str(slot->ret));
+        ret = slot->ret;
+        prefetch_slot_reset(c, slot);
+        slot = NULL;
+    } else {
+        ret = AVERROR(EAGAIN);
+    }
+    if (slot)
+        slot->state = PREFETCH_IN_USE;
+    pthread_mutex_unlock(&c->prefetch_mutex);
+    av_free(url);
+
+    if (!slot)
+        return ret;
+
+    buf = av_malloc(INITIAL_BUFFER_SIZE);
+    pls->input = buf ? avio_alloc_context(buf, INITIAL_BUFFER_SIZE, 0, slot,
+                                          prefetch_read, NULL, prefetch_seek) : NULL;
+    if (!pls->input) {
+        av_free(buf);
+        pthread_mutex_lock(&c->prefetch_mutex);
+        prefetch_slot_reset(c, slot);
+        pthread_mutex_unlock(&c->prefetch_mutex);
+        return AVERROR(ENOMEM);
+    }
+    pls->input_slot     = slot;
+    pls->cur_seg_offset = 0;
+    pls->cur_seg_size   = seg->size;
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static void close_input(struct representation *pls)
+{
+#if HAVE_THREADS
+    if (pls->input_slot) {
+        DASHContext *c = pls->parent->priv_data;
+
+        av_freep(&pls->input->buffer);
+        avio_context_free(&pls->input);
+        pthread_mutex_lock(&c->prefetch_mutex);
+        prefetch_slot_reset(c, pls->input_slot);
+        pthread_mutex_unlock(&c->prefetch_mutex);
+        pls->input_slot = NULL;
+        return;
+    }
+#endif
+    ff_format_io_close(pls->parent, &pls->input);
+}
+
 static int update_init_section(struct representation *pls)
 {
     static const int max_init_section_size = 1024 * 1024;
@@ -1811,7 +2317,9 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        ret = open_prefetched_input(c, v, v->cur_seg);
+        if (ret < 0 && ret != AVERROR_EXIT)
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -1858,7 +2366,8 @@ static int save_avio_options(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
     const char *opts[] = {
-        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy", NULL };
+        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy",
+        "http2", NULL };
     const char **opt = opts;
     uint8_t *buf = NULL;
     int ret = 0;
@@ -2189,6 +2698,10 @@ static int dash_read_header(AVFormatContext *s)
 
     return 0;
 fail:
+#if HAVE_THREADS
+    /* read_close() is not called when the header fails */
+    prefetch_uninit(c);
+#endif
     return ret;
 }
 
@@ -2211,7 +2724,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
             av_log(s, AV_LOG_INFO, "Now receiving stream_index %d\n", pls->stream_index);
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
-            ff_format_io_close(pls->parent, &pls->input);
+            close_input(pls);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2272,7 +2785,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (cur->is_restart_needed) {
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
-            ff_format_io_close(cur->parent, &cur->input);
+            close_input(cur);
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2285,6 +2798,10 @@ static int dash_close(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     free_audio_list(c);
     free_video_list(c);
+#if HAVE_THREADS
+    /* after the representations, which return the slots in use */
+    prefetch_uninit(c);
+#endif
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
     return 0;
@@ -2310,7 +2827,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
         return av_seek_frame(pls->ctx, -1, seek_pos_msec * 1000, flags);
     }
 
-    ff_format_io_close(pls->parent, &pls->input);
+    close_input(pls);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2408,6 +2925,10 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of fragments of each representation to download ahead concurrently",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Maximum amount of prefetched data to keep in memory",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
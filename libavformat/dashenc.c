@@ -28,11 +28,13 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
 #include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/rational.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 
@@ -138,6 +140,16 @@ typedef struct OutputStream {
     int64_t gop_size;
     AVRational sar;
     int coding_dependency;
+#if HAVE_THREADS
+    pthread_t upload_thread;
+    pthread_mutex_t upload_lock;
+    pthread_cond_t upload_cond;
+    int upload_thread_started;
+    AVFifoBuffer *upload_fifo;  ///< AVBufferRef pointers waiting to be written to out
+    int upload_busy;            ///< the upload thread is writing a chunk
+    int upload_abort;
+    int upload_ret;             ///< first write error of the upload thread
+#endif
 } OutputStream;
 
 typedef struct DASHContext {
@@ -198,6 +210,7 @@ typedef struct DASHContext {
     int target_latency_refid;
     AVRational min_playback_rate;
     AVRational max_playback_rate;
+    int upload_thread;
 } DASHContext;
 
 static struct codec_string {
@@ -453,9 +466,139 @@ static void set_codec_str(AVFormatContext *s, AVCodecParameters *par,
     }
 }
 
+#if HAVE_THREADS
+static void *upload_thread(void *arg)
+{
+    OutputStream *os = arg;
+
+    pthread_mutex_lock(&os->upload_lock);
+    for (;;) {
+        AVBufferRef *buf;
+        int ret;
+
+        while (!av_fifo_size(os->upload_fifo) && !os->upload_abort)
+            pthread_cond_wait(&os->upload_cond, &os->upload_lock);
+        if (!av_fifo_size(os->upload_fifo))
+            break;
+        av_fifo_generic_read(os->upload_fifo, &buf, sizeof(buf), NULL);
+        os->upload_busy = 1;
+        pthread_mutex_unlock(&os->upload_lock);
+
+        // out only changes while the queue is empty and no chunk is in flight
+        avio_write(os->out, buf->data, buf->size);
+        avio_flush(os->out);
+        ret = os->out->error;
+        av_buffer_unref(&buf);
+
+        pthread_mutex_lock(&os->upload_lock);
+        os->upload_busy = 0;
+        if (ret < 0 && !os->upload_ret)
+            os->upload_ret = ret;
+        pthread_cond_broadcast(&os->upload_cond);
+    }
+    pthread_mutex_unlock(&os->upload_lock);
+    return NULL;
+}
+
+static int start_upload_thread(OutputStream *os)
+{
+    int ret;
+
+    os->upload_fifo = av_fifo_alloc(16 * sizeof(AVBufferRef *));
+    if (!os->upload_fifo)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&os->upload_lock, NULL);
+    pthread_cond_init(&os->upload_cond, NULL);
+    ret = pthread_create(&os->upload_thread, NULL, upload_thread, os);
+    if (ret) {
+        pthread_mutex_destroy(&os->upload_lock);
+        pthread_cond_destroy(&os->upload_cond);
+        av_fifo_freep(&os->upload_fifo);
+        return AVERROR(ret);
+    }
+    os->upload_thread_started = 1;
+    return 0;
+}
+
+static void stop_upload_thread(OutputStream *os)
+{
+    if (!os->upload_thread_started)
+        return;
+    // the thread drains the queue before it exits
+    pthread_mutex_lock(&os->upload_lock);
+    os->upload_abort = 1;
+    pthread_cond_broadcast(&os->upload_cond);
+    pthread_mutex_unlock(&os->upload_lock);
+    pthread_join(os->upload_thread, NULL);
+    pthread_mutex_destroy(&os->upload_lock);
+    pthread_cond_destroy(&os->upload_cond);
+    av_fifo_freep(&os->upload_fifo);
+    os->upload_thread_started = 0;
+}
+#endif
+
+/**
+ * Write a chunk of the current segment to out. With an upload thread, the
+ * chunk is copied and queued, and the thread writes and flushes it.
+ */
+static int write_chunk(OutputStream *os, const uint8_t *data, int size, int flush)
+{
+    if (!os->out || size <= 0)
+        return 0;
+#if HAVE_THREADS
+    if (os->upload_thread_started) {
+        AVBufferRef *buf = av_buffer_alloc(size);
+        int ret = 0;
+
+        if (!buf)
+            return AVERROR(ENOMEM);
+        memcpy(buf->data, data, size);
+        pthread_mutex_lock(&os->upload_lock);
+        if (av_fifo_space(os->upload_fifo) < sizeof(buf))
+            ret = av_fifo_grow(os->upload_fifo, av_fifo_size(os->upload_fifo));
+        if (ret >= 0) {
+            av_fifo_generic_write(os->upload_fifo, &buf, sizeof(buf), NULL);
+            pthread_cond_broadcast(&os->upload_cond);
+        }
+        pthread_mutex_unlock(&os->upload_lock);
+        if (ret < 0)
+            av_buffer_unref(&buf);
+        return ret;
+    }
+#endif
+    avio_write(os->out, data, size);
+    if (flush)
+        avio_flush(os->out);
+    return 0;
+}
+
+/**
+ * Wait until the upload thread has written all queued chunks, so that out
+ * can be closed or replaced.
+ */
+static void wait_upload(AVFormatContext *s, OutputStream *os)
+{
+#if HAVE_THREADS
+    DASHContext *c = s->priv_data;
+
+    if (!os->upload_thread_started)
+        return;
+    pthread_mutex_lock(&os->upload_lock);
+    while (av_fifo_size(os->upload_fifo) || os->upload_busy)
+        pthread_cond_wait(&os->upload_cond, &os->upload_lock);
+    if (os->upload_ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Upload of representation %d failed: %s\n",
+               (int)(os - c->streams), av_err2str(os->upload_ret));
+        os->upload_ret = 0;
+    }
+    pthread_mutex_unlock(&os->upload_lock);
+#endif
+}
+
 static int flush_dynbuf(DASHContext *c, OutputStream *os, int *range_length)
 {
     uint8_t *buffer;
+    int ret;
 
     if (!os->ctx->pb) {
         return AVERROR(EINVAL);
@@ -469,10 +612,11 @@ static int flush_dynbuf(DASHContext *c, OutputStream *os, int *range_length)
         // write out to file
         *range_length = avio_close_dyn_buf(os->ctx->pb, &buffer);
         os->ctx->pb = NULL;
-        if (os->out)
-            avio_write(os->out, buffer + os->written_len, *range_length - os->written_len);
+        ret = write_chunk(os, buffer + os->written_len, *range_length - os->written_len, 0);
         os->written_len = 0;
         av_free(buffer);
+        if (ret < 0)
+            return ret;
 
         // re-open buffer
         return avio_open_dyn_buf(&os->ctx->pb);
@@ -605,6 +749,7 @@ static int flush_init_segment(AVFormatContext *s, OutputStream *os)
     if (!c->single_file) {
         char filename[1024];
         snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
+        wait_upload(s, os);
         dashenc_io_close(s, &os->out, filename);
     }
     return 0;
@@ -634,6 +779,9 @@ static void dash_free(AVFormatContext *s)
             else
                 avio_close(os->ctx->pb);
         }
+#if HAVE_THREADS
+        stop_upload_thread(os);
+#endif
         ff_format_io_close(s, &os->out);
         avformat_free_context(os->ctx);
         avcodec_free_context(&os->parser_avctx);
@@ -1712,6 +1860,20 @@ static int dash_init(AVFormatContext *s)
     c->nr_of_streams_flushed = 0;
     c->target_latency_refid = -1;
 
+    if (c->upload_thread && (!c->streaming || c->single_file)) {
+        av_log(s, AV_LOG_WARNING, "Upload thread option will be ignored as streaming is not enabled or single_file is enabled\n");
+        c->upload_thread = 0;
+    }
+    if (c->upload_thread) {
+#if HAVE_THREADS
+        for (i = 0; i < s->nb_streams; i++)
+            if ((ret = start_upload_thread(&c->streams[i])) < 0)
+                return ret;
+#else
+        av_log(s, AV_LOG_WARNING, "Upload thread option requires thread support, ignoring\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -1951,6 +2113,7 @@ static int dash_flush(AVFormatContext *s, int final, int stream)
         if (c->single_file) {
             find_index_range(s, os->full_path, os->pos, &index_length);
         } else {
+            wait_upload(s, os);
             dashenc_io_close(s, &os->out, os->temp_path);
 
             if (use_rename) {
@@ -2240,6 +2403,7 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         snprintf(os->temp_path, sizeof(os->temp_path),
                  use_rename ? "%s.tmp" : "%s", os->full_path);
         set_http_options(&opts, c);
+        wait_upload(s, os);
         ret = dashenc_io_open(s, &os->out, os->temp_path, &opts);
         av_dict_free(&opts);
         if (ret < 0) {
@@ -2257,10 +2421,9 @@ static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
         uint8_t *buf = NULL;
         avio_flush(os->ctx->pb);
         len = avio_get_dyn_buf (os->ctx->pb, &buf);
-        if (os->out) {
-            avio_write(os->out, buf + os->written_len, len - os->written_len);
-            avio_flush(os->out);
-        }
+        ret = write_chunk(os, buf + os->written_len, len - os->written_len, 1);
+        if (ret < 0)
+            return ret;
         os->written_len = len;
     }
 
@@ -2380,6 +2543,7 @@ static const AVOption options[] = {
     { "target_latency", "Set desired target latency for Low-latency dash", OFFSET(target_latency), AV_OPT_TYPE_DURATION, { .i64 = 0 }, 0, INT_MAX, E },
     { "min_playback_rate", "Set desired minimum playback rate", OFFSET(min_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
     { "max_playback_rate", "Set desired maximum playback rate", OFFSET(max_playback_rate), AV_OPT_TYPE_RATIONAL, { .dbl = 1.0 }, 0.5, 1.5, E },
+    { "upload_thread", "Write the chunks of each representation from a separate thread in streaming mode", OFFSET(upload_thread), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { NULL },
 };
 
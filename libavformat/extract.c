@@ -0,0 +1,392 @@
+/*
+ * Frame extraction at a list of timestamps
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+
+#include "avformat.h"
+#include "internal.h"
+
+typedef struct ExtractTarget {
+    int64_t ts;
+    int index;
+} ExtractTarget;
+
+/**
+ * The targets sharing a keyframe, and the packets from that keyframe
+ * to the next one following the last target.
+ */
+typedef struct ExtractGroup {
+    int64_t key_ts;
+    ExtractTarget *targets;
+    int nb_targets;
+    AVPacket **pkts;
+    int nb_pkts;
+} ExtractGroup;
+
+typedef struct ExtractWorker {
+    struct ExtractContext *ctx;
+    AVCodecContext *avctx;
+    AVFrame *frame;
+    AVFrame *last;
+#if HAVE_THREADS
+    pthread_t thread;
+    int thread_started;
+#endif
+} ExtractWorker;
+
+typedef struct ExtractContext {
+    int (*cb)(void *opaque, int index, const AVFrame *frame);
+    void *opaque;
+    AVMutex cb_lock;
+    atomic_int error;
+    AVThreadMessageQueue *queue;
+} ExtractContext;
+
+static int cmp_target(const void *a, const void *b)
+{
+    const ExtractTarget *ta = a, *tb = b;
+    if (ta->ts != tb->ts)
+        return FFDIFFSIGN(ta->ts, tb->ts);
+    return FFDIFFSIGN(ta->index, tb->index);
+}
+
+static void free_group_packets(ExtractGroup *g)
+{
+    int i;
+
+    for (i = 0; i < g->nb_pkts; i++)
+        av_packet_free(&g->pkts[i]);
+    av_freep(&g->pkts);
+    g->nb_pkts = 0;
+}
+
+static int deliver(ExtractContext *ctx, int index, const AVFrame *frame)
+{
+    int ret;
+
+    ff_mutex_lock(&ctx->cb_lock);
+    ret = ctx->cb(ctx->opaque, index, frame);
+    ff_mutex_unlock(&ctx->cb_lock);
+    return ret;
+}
+
+/**
+ * Decode the packets of a group until every target got a frame: the first
+ * one whose timestamp is not lower than the target, or the last one of the
+ * group if there is none.
+ */
+static int decode_group(ExtractWorker *w, ExtractGroup *g)
+{
+    AVCodecContext *avctx = w->avctx;
+    int i, j = 0, ret;
+
+    avcodec_flush_buffers(avctx);
+    av_frame_unref(w->last);
+
+    for (i = 0; i <= g->nb_pkts && j < g->nb_targets; i++) {
+        ret = avcodec_send_packet(avctx, i < g->nb_pkts ? g->pkts[i] : NULL);
+        if (ret < 0 && ret != AVERROR_INVALIDDATA)
+            return ret;
+
+        while ((ret = avcodec_receive_frame(avctx, w->frame)) >= 0) {
+            int64_t ts = w->frame->best_effort_timestamp;
+
+            while (j < g->nb_targets && ts != AV_NOPTS_VALUE &&
+                   ts >= g->targets[j].ts) {
+                if ((ret = deliver(w->ctx, g->targets[j].index, w->frame)) < 0)
+                    return ret;
+                j++;
+            }
+            av_frame_unref(w->last);
+            av_frame_move_ref(w->last, w->frame);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF &&
+            ret != AVERROR_INVALIDDATA)
+            return ret;
+    }
+
+    for (; j < g->nb_targets && w->last->buf[0]; j++)
+        if ((ret = deliver(w->ctx, g->targets[j].index, w->last)) < 0)
+            return ret;
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *worker_thread(void *arg)
+{
+    ExtractWorker *w = arg;
+    ExtractContext *ctx = w->ctx;
+    ExtractGroup *g;
+
+    while (av_thread_message_queue_recv(ctx->queue, &g, 0) >= 0) {
+        if (!atomic_load(&ctx->error)) {
+            int ret = decode_group(w, g);
+            if (ret < 0) {
+                int expected = 0;
+                atomic_compare_exchange_strong(&ctx->error, &expected, ret);
+                av_thread_message_queue_set_err_send(ctx->queue, ret);
+            }
+        }
+        free_group_packets(g);
+    }
+    return NULL;
+}
+#endif
+
+static int init_worker(ExtractWorker *w, ExtractContext *ctx, AVStream *st,
+                       const AVCodec *codec, AVDictionary *codec_opts, int threaded)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    w->ctx   = ctx;
+    w->frame = av_frame_alloc();
+    w->last  = av_frame_alloc();
+    w->avctx = avcodec_alloc_context3(codec);
+    if (!w->frame || !w->last || !w->avctx)
+        return AVERROR(ENOMEM);
+
+    if ((ret = avcodec_parameters_to_context(w->avctx, st->codecpar)) < 0)
+        return ret;
+    w->avctx->pkt_timebase = st->time_base;
+
+    if ((ret = av_dict_copy(&opts, codec_opts, 0)) < 0)
+        return ret;
+    /* the parallelism comes from the workers, one thread each */
+    if (threaded && (ret = av_dict_set(&opts, "threads", "1", AV_DICT_DONT_OVERWRITE)) < 0) {
+        av_dict_free(&opts);
+        return ret;
+    }
+    ret = avcodec_open2(w->avctx, codec, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static void uninit_worker(ExtractWorker *w)
+{
+    avcodec_free_context(&w->avctx);
+    av_frame_free(&w->frame);
+    av_frame_free(&w->last);
+}
+
+/**
+ * Read the packets of the stream from the keyframe of the group up to the
+ * next keyframe following its last target, and the leading pictures of
+ * that keyframe in an open GOP.
+ */
+static int read_group(AVFormatContext *s, int stream_index, ExtractGroup *g)
+{
+    int64_t last_ts = g->targets[g->nb_targets - 1].ts;
+    int64_t next_key_ts = AV_NOPTS_VALUE;
+    AVPacket *pkt;
+    int ret;
+
+    ret = avformat_seek_file(s, stream_index, INT64_MIN, g->key_ts, g->key_ts, 0);
+    if (ret < 0)
+        return ret;
+
+    for (;;) {
+        int64_t ts;
+
+        if (!(pkt = av_packet_alloc()))
+            return AVERROR(ENOMEM);
+        ret = av_read_frame(s, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret == AVERROR_EOF ? 0 : ret;
+        }
+        if (pkt->stream_index != stream_index) {
+            av_packet_free(&pkt);
+            continue;
+        }
+
+        ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (next_key_ts != AV_NOPTS_VALUE) {
+            if (pkt->flags & AV_PKT_FLAG_KEY || ts == AV_NOPTS_VALUE ||
+                ts > next_key_ts) {
+                av_packet_free(&pkt);
+                return 0;
+            }
+        } else if (g->nb_pkts && pkt->flags & AV_PKT_FLAG_KEY &&
+                   ts != AV_NOPTS_VALUE && ts > last_ts) {
+            next_key_ts = ts;
+        }
+
+        ret = av_dynarray_add_nofree(&g->pkts, &g->nb_pkts, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret;
+        }
+    }
+}
+
+int avformat_extract_frames(AVFormatContext *s, int stream_index,
+                            const int64_t *timestamps, int nb_timestamps,
+                            int nb_threads, AVDictionary *codec_opts,
+                            int (*cb)(void *opaque, int index, const AVFrame *frame),
+                            void *opaque)
+{
+    ExtractContext ctx = { .cb = cb, .opaque = opaque };
+    ExtractTarget *targets  = NULL;
+    ExtractGroup *groups    = NULL;
+    ExtractWorker *workers  = NULL;
+    enum AVDiscard *discard = NULL;
+    const AVCodec *codec;
+    AVStream *st;
+    int i, nb_groups = 0, ret = 0;
+
+    if (stream_index < 0 || stream_index >= s->nb_streams || nb_timestamps < 0 || !cb)
+        return AVERROR(EINVAL);
+    if (!nb_timestamps)
+        return 0;
+    st = s->streams[stream_index];
+
+    codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+
+    if (nb_threads <= 0)
+        nb_threads = av_cpu_count();
+    if (!HAVE_THREADS)
+        nb_threads = 1;
+
+    ff_mutex_init(&ctx.cb_lock, NULL);
+    atomic_init(&ctx.error, 0);
+
+    targets = av_malloc_array(nb_timestamps, sizeof(*targets));
+    groups  = av_mallocz_array(nb_timestamps, sizeof(*groups));
+    discard = av_malloc_array(s->nb_streams, sizeof(*discard));
+    if (!targets || !groups || !discard) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        discard[i] = s->streams[i]->discard;
+        if (i != stream_index)
+            s->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    for (i = 0; i < nb_timestamps; i++) {
+        targets[i].ts    = timestamps[i];
+        targets[i].index = i;
+    }
+    qsort(targets, nb_timestamps, sizeof(*targets), cmp_target);
+
+    /* some demuxers only load their index on the first seek */
+    avformat_seek_file(s, stream_index, INT64_MIN, targets[nb_timestamps - 1].ts,
+                       targets[nb_timestamps - 1].ts, 0);
+
+    /* group the targets by the keyframe of the index preceding them, each
+     * target gets its own seek without an index */
+    for (i = 0; i < nb_timestamps; i++) {
+        int key = av_index_search_timestamp(st, targets[i].ts, AVSEEK_FLAG_BACKWARD);
+        int64_t key_ts = key >= 0 ? st->index_entries[key].timestamp : targets[i].ts;
+
+        if (nb_groups && key >= 0 && groups[nb_groups - 1].key_ts == key_ts) {
+            groups[nb_groups - 1].nb_targets++;
+        } else {
+            groups[nb_groups].key_ts     = key_ts;
+            groups[nb_groups].targets    = &targets[i];
+            groups[nb_groups].nb_targets = 1;
+            nb_groups++;
+        }
+    }
+    nb_threads = FFMIN(nb_threads, nb_groups);
+
+    workers = av_mallocz_array(nb_threads, sizeof(*workers));
+    if (!workers) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < nb_threads; i++) {
+        ret = init_worker(&workers[i], &ctx, st, codec, codec_opts, nb_threads > 1);
+        if (ret < 0)
+            goto end;
+    }
+
+#if HAVE_THREADS
+    if (nb_threads > 1) {
+        ret = av_thread_message_queue_alloc(&ctx.queue, nb_threads, sizeof(ExtractGroup *));
+        if (ret < 0)
+            goto end;
+        for (i = 0; i < nb_threads; i++) {
+            ret = AVERROR(pthread_create(&workers[i].thread, NULL,
+                                         worker_thread, &workers[i]));
+            if (ret < 0)
+                goto end;
+            workers[i].thread_started = 1;
+        }
+    }
+#endif
+
+    /* demux here, decode the groups on the workers */
+    for (i = 0; i < nb_groups && ret >= 0; i++) {
+        ExtractGroup *g = &groups[i];
+
+        ret = read_group(s, stream_index, g);
+        if (ret < 0)
+            break;
+#if HAVE_THREADS
+        if (ctx.queue) {
+            ret = av_thread_message_queue_send(ctx.queue, &g, 0);
+            if (ret < 0)
+                break;
+            continue;
+        }
+#endif
+        ret = decode_group(&workers[0], g);
+        free_group_packets(g);
+    }
+
+end:
+    if (ret < 0) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&ctx.error, &expected, ret);
+    }
+#if HAVE_THREADS
+    if (ctx.queue)
+        av_thread_message_queue_set_err_recv(ctx.queue, AVERROR_EOF);
+    for (i = 0; workers && i < nb_threads; i++)
+        if (workers[i].thread_started)
+            pthread_join(workers[i].thread, NULL);
+    av_thread_message_queue_free(&ctx.queue);
+#endif
+    ret = atomic_load(&ctx.error);
+
+    for (i = 0; workers && i < nb_threads; i++)
+        uninit_worker(&workers[i]);
+    for (i = 0; groups && i < nb_groups; i++)
+        free_group_packets(&groups[i]);
+    if (discard)
+        for (i = 0; i < s->nb_streams; i++)
+            s->streams[i]->discard = discard[i];
+    ff_mutex_destroy(&ctx.cb_lock);
+    av_free(workers);
+    av_free(groups);
+    av_free(targets);
+    av_free(discard);
+    return ret;
+}
@@ -82,6 +82,21 @@ typedef struct FifoContext {
     atomic_int_least64_t queue_duration;
     int64_t last_sent_dts;
     int64_t timeshift;
+
+    /* Upper bound for the payload bytes held in the queue, 0 for none */
+    int64_t queue_max_bytes;
+    atomic_int_least64_t queued_bytes;
+    /* Signalled under overflow_flag_lock when queued_bytes decreases */
+    pthread_cond_t queued_bytes_cond;
+    int queued_bytes_cond_initialized;
+    volatile uint8_t consumer_done;
+
+    /* Statistics, reported at the end */
+    int64_t max_queued_bytes;
+    atomic_int_least64_t nb_dropped;
+    int64_t nb_written;
+    int64_t latency_sum;
+    int64_t latency_max;
 } FifoContext;
 
 typedef struct FifoThreadContext {
@@ -117,8 +132,21 @@ typedef enum FifoMessageType {
 typedef struct FifoMessage {
     FifoMessageType type;
     AVPacket pkt;
+    /* Set while the message is queued, for accounting of dropped data */
+    FifoContext *fifo;
+    int64_t queued_time;
 } FifoMessage;
 
+static void fifo_release_bytes(FifoContext *fifo, int size)
+{
+    if (!fifo->queue_max_bytes)
+        return;
+    atomic_fetch_sub_explicit(&fifo->queued_bytes, size, memory_order_relaxed);
+    pthread_mutex_lock(&fifo->overflow_flag_lock);
+    pthread_cond_signal(&fifo->queued_bytes_cond);
+    pthread_mutex_unlock(&fifo->overflow_flag_lock);
+}
+
 static int fifo_thread_write_header(FifoThreadContext *ctx)
 {
     AVFormatContext *avf = ctx->avf;
@@ -176,7 +204,8 @@ static int64_t next_duration(AVFormatContext *avf, AVPacket *pkt, int64_t *last_
     return duration;
 }
 
-static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
+static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt,
+                                    int64_t queued_time)
 {
     AVFormatContext *avf = ctx->avf;
     FifoContext *fifo = avf->priv_data;
@@ -193,6 +222,7 @@ static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
             av_log(avf, AV_LOG_VERBOSE, "Keyframe received, recovering...\n");
         } else {
             av_log(avf, AV_LOG_VERBOSE, "Dropping non-keyframe packet\n");
+            atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
             av_packet_unref(pkt);
             return 0;
         }
@@ -204,8 +234,13 @@ static int fifo_thread_write_packet(FifoThreadContext *ctx, AVPacket *pkt)
     av_packet_rescale_ts(pkt, src_tb, dst_tb);
 
     ret = av_write_frame(avf2, pkt);
-    if (ret >= 0)
+    if (ret >= 0) {
+        int64_t latency = av_gettime_relative() - queued_time;
+        fifo->nb_written++;
+        fifo->latency_sum += latency;
+        fifo->latency_max  = FFMAX(fifo->latency_max, latency);
         av_packet_unref(pkt);
+    }
     return ret;
 }
 
@@ -243,7 +278,7 @@ static int fifo_thread_dispatch_message(FifoThreadContext *ctx, FifoMessage *msg
         av_assert0(ret >= 0);
         return ret;
     case FIFO_WRITE_PACKET:
-        return fifo_thread_write_packet(ctx, &msg->pkt);
+        return fifo_thread_write_packet(ctx, &msg->pkt, msg->queued_time);
     case FIFO_FLUSH_OUTPUT:
         return fifo_thread_flush_output(ctx);
     }
@@ -275,8 +310,13 @@ static void free_message(void *msg)
 {
     FifoMessage *fifo_msg = msg;
 
-    if (fifo_msg->type == FIFO_WRITE_PACKET)
+    if (fifo_msg->type == FIFO_WRITE_PACKET) {
+        if (fifo_msg->fifo) {
+            fifo_release_bytes(fifo_msg->fifo, fifo_msg->pkt.size);
+            atomic_fetch_add_explicit(&fifo_msg->fifo->nb_dropped, 1, memory_order_relaxed);
+        }
         av_packet_unref(&fifo_msg->pkt);
+    }
 }
 
 static int fifo_thread_process_recovery_failure(FifoThreadContext *ctx, AVPacket *pkt,
@@ -400,8 +440,10 @@ static int fifo_thread_recover(FifoThreadContext *ctx, FifoMessage *msg, int err
     } while (ret == AVERROR(EAGAIN) && !fifo->drop_pkts_on_overflow);
 
     if (ret == AVERROR(EAGAIN) && fifo->drop_pkts_on_overflow) {
-        if (msg->type == FIFO_WRITE_PACKET)
+        if (msg->type == FIFO_WRITE_PACKET) {
+            atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
             av_packet_unref(&msg->pkt);
+        }
         ret = 0;
     }
 
@@ -462,8 +504,18 @@ static void *fifo_consumer_thread(void *data)
             av_thread_message_queue_set_err_send(queue, ret);
             break;
         }
+        if (msg.fifo) {
+            msg.fifo = NULL;
+            fifo_release_bytes(fifo, msg.pkt.size);
+        }
     }
 
+    /* wake up a producer waiting for queue space that will never come */
+    pthread_mutex_lock(&fifo->overflow_flag_lock);
+    fifo->consumer_done = 1;
+    pthread_cond_signal(&fifo->queued_bytes_cond);
+    pthread_mutex_unlock(&fifo->overflow_flag_lock);
+
     fifo->write_trailer_ret = fifo_thread_write_trailer(&fifo_thread_ctx);
 
     return NULL;
@@ -529,8 +581,11 @@ static int fifo_init(AVFormatContext *avf)
     if (ret < 0)
         return ret;
 
-    ret = av_thread_message_queue_alloc(&fifo->queue, (unsigned) fifo->queue_size,
-                                        sizeof(FifoMessage));
+    /* the muxing thread sends and the consumer thread receives and flushes */
+    ret = av_thread_message_queue_alloc2(&fifo->queue, (unsigned) fifo->queue_size,
+                                         sizeof(FifoMessage),
+                                         AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER |
+                                         AV_THREAD_MESSAGE_QUEUE_SINGLE_PRODUCER);
     if (ret < 0)
         return ret;
 
@@ -541,6 +596,13 @@ static int fifo_init(AVFormatContext *avf)
         return AVERROR(ret);
     fifo->overflow_flag_lock_initialized = 1;
 
+    ret = pthread_cond_init(&fifo->queued_bytes_cond, NULL);
+    if (ret < 0)
+        return AVERROR(ret);
+    fifo->queued_bytes_cond_initialized = 1;
+    atomic_init(&fifo->queued_bytes, 0);
+    atomic_init(&fifo->nb_dropped, 0);
+
     return 0;
 }
 
@@ -563,17 +625,48 @@ static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
 {
     FifoContext *fifo = avf->priv_data;
     FifoMessage msg = {.type = pkt ? FIFO_WRITE_PACKET : FIFO_FLUSH_OUTPUT};
+    int64_t queued = 0;
     int ret;
 
     if (pkt) {
         ret = av_packet_ref(&msg.pkt,pkt);
         if (ret < 0)
             return ret;
+        msg.queued_time = av_gettime_relative();
+    }
+
+    if (pkt && fifo->queue_max_bytes) {
+        /* a single packet larger than the limit is let through alone */
+        pthread_mutex_lock(&fifo->overflow_flag_lock);
+        while ((queued = atomic_load_explicit(&fifo->queued_bytes, memory_order_relaxed)) &&
+               queued + pkt->size > fifo->queue_max_bytes &&
+               !fifo->drop_pkts_on_overflow && !fifo->consumer_done)
+            pthread_cond_wait(&fifo->queued_bytes_cond, &fifo->overflow_flag_lock);
+        pthread_mutex_unlock(&fifo->overflow_flag_lock);
+        if (queued && queued + pkt->size > fifo->queue_max_bytes &&
+            fifo->drop_pkts_on_overflow)
+            ret = AVERROR(EAGAIN);
+        else
+            ret = 0;
+        if (!ret) {
+            /* account before sending, the consumer may dequeue right away */
+            msg.fifo = fifo;
+            queued = atomic_fetch_add_explicit(&fifo->queued_bytes, pkt->size,
+                                               memory_order_relaxed) + pkt->size;
+            fifo->max_queued_bytes = FFMAX(fifo->max_queued_bytes, queued);
+        }
+    } else {
+        ret = 0;
     }
 
-    ret = av_thread_message_queue_send(fifo->queue, &msg,
-                                       fifo->drop_pkts_on_overflow ?
-                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (!ret)
+        ret = av_thread_message_queue_send(fifo->queue, &msg,
+                                           fifo->drop_pkts_on_overflow ?
+                                           AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret < 0 && msg.fifo) {
+        msg.fifo = NULL;
+        fifo_release_bytes(fifo, pkt->size);
+    }
     if (ret == AVERROR(EAGAIN)) {
         uint8_t overflow_set = 0;
 
@@ -587,6 +680,7 @@ static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
 
         if (overflow_set)
             av_log(avf, AV_LOG_WARNING, "FIFO queue full\n");
+        atomic_fetch_add_explicit(&fifo->nb_dropped, 1, memory_order_relaxed);
         ret = 0;
         goto fail;
     } else if (ret < 0) {
@@ -638,6 +732,13 @@ static int fifo_write_trailer(AVFormatContext *avf)
         return AVERROR(ret);
     }
 
+    av_log(avf, AV_LOG_VERBOSE, "Statistics: %"PRId64" packets written, "
+           "%"PRId64" dropped, latency avg %"PRId64" max %"PRId64" us, "
+           "at most %"PRId64" bytes queued\n", fifo->nb_written,
+           (int64_t)atomic_load(&fifo->nb_dropped),
+           fifo->nb_written ? fifo->latency_sum / fifo->nb_written : 0,
+           fifo->latency_max, fifo->max_queued_bytes);
+
     ret = fifo->write_trailer_ret;
     return ret;
 }
@@ -650,6 +751,8 @@ static void fifo_deinit(AVFormatContext *avf)
     av_thread_message_queue_free(&fifo->queue);
     if (fifo->overflow_flag_lock_initialized)
         pthread_mutex_destroy(&fifo->overflow_flag_lock);
+    if (fifo->queued_bytes_cond_initialized)
+        pthread_cond_destroy(&fifo->queued_bytes_cond);
 }
 
 #define OFFSET(x) offsetof(FifoContext, x)
@@ -660,6 +763,9 @@ static const AVOption options[] = {
         {"queue_size", "Size of fifo queue", OFFSET(queue_size),
          AV_OPT_TYPE_INT, {.i64 = FIFO_DEFAULT_QUEUE_SIZE}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM},
 
+        {"queue_max_bytes", "Maximum amount of packet data held in the queue", OFFSET(queue_max_bytes),
+         AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM},
+
         {"format_opts", "Options to be passed to underlying muxer", OFFSET(format_options),
          AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, AV_OPT_FLAG_ENCODING_PARAM},
 
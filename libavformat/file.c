@@ -35,8 +35,17 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
+#if HAVE_LINUX_IO_URING_H
+#include "uring.h"
+
+#define URING_BUFFERS     8
+#define URING_BUFFER_SIZE 262144
+#endif
 
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
@@ -65,6 +74,9 @@
 #  endif
 #endif
 
+/* amount of data after a seek target the kernel is asked to read ahead */
+#define MMAP_WILLNEED_SIZE (4 << 20)
+
 /* standard file protocol */
 
 typedef struct FileContext {
@@ -74,6 +86,26 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
+#if HAVE_MMAP
+    uint8_t *map;
+    int64_t map_size;
+    int64_t map_pos;
+#endif
+    int use_uring;
+#if HAVE_LINUX_IO_URING_H
+    FFURing ring;
+    int uring_active;
+    int uring_error;
+    int64_t uring_pos;
+    uint8_t *uring_buf;
+    struct {
+        int busy;
+        int64_t offset;
+        int size;
+        int done;
+    } uring_req[URING_BUFFERS];
+#endif
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -84,6 +116,8 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file into memory for reading", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Write asynchronously through io_uring", offsetof(FileContext, use_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -111,6 +145,16 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_MMAP
+    if (c->map) {
+        if (c->map_pos >= c->map_size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map_size - c->map_pos);
+        memcpy(buf, c->map + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -119,11 +163,106 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+#if HAVE_LINUX_IO_URING_H
+static void uring_queue_write(FileContext *c, int idx)
+{
+    struct io_uring_sqe *sqe = ff_uring_get_sqe(&c->ring);
+
+    /* the ring has room for every buffer, so this cannot fail */
+    sqe->opcode    = IORING_OP_WRITE_FIXED;
+    sqe->fd        = c->fd;
+    sqe->off       = c->uring_req[idx].offset + c->uring_req[idx].done;
+    sqe->addr      = (uintptr_t)(c->uring_buf + idx * URING_BUFFER_SIZE + c->uring_req[idx].done);
+    sqe->len       = c->uring_req[idx].size - c->uring_req[idx].done;
+    sqe->buf_index = 0;
+    sqe->user_data = idx;
+}
+
+/**
+ * Submit queued writes and reap completions, waiting for at least one
+ * completion if wait is set and writes are in flight.
+ */
+static int uring_reap(FileContext *c, int wait)
+{
+    struct io_uring_cqe cqe;
+    int ret;
+
+    ret = ff_uring_submit(&c->ring, wait && c->ring.inflight + (c->ring.sqe_tail - *c->ring.sq_tail));
+    if (ret < 0)
+        return ret;
+
+    while (ff_uring_get_cqe(&c->ring, &cqe) >= 0) {
+        int idx = cqe.user_data;
+
+        if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+            uring_queue_write(c, idx);
+        } else if (cqe.res < 0) {
+            c->uring_req[idx].busy = 0;
+            if (!c->uring_error)
+                c->uring_error = AVERROR(-cqe.res);
+        } else if (!cqe.res) {
+            c->uring_req[idx].busy = 0;
+            if (!c->uring_error)
+                c->uring_error = AVERROR(EIO);
+        } else if ((c->uring_req[idx].done += cqe.res) < c->uring_req[idx].size) {
+            uring_queue_write(c, idx);
+        } else {
+            c->uring_req[idx].busy = 0;
+        }
+    }
+    return 0;
+}
+
+static int uring_drain(FileContext *c)
+{
+    int ret;
+
+    while (c->ring.inflight || c->ring.sqe_tail != *c->ring.sq_tail)
+        if ((ret = uring_reap(c, 1)) < 0)
+            return ret;
+    return c->uring_error;
+}
+
+static int uring_write(FileContext *c, const unsigned char *buf, int size)
+{
+    int idx, ret;
+
+    for (;;) {
+        if (c->uring_error)
+            return c->uring_error;
+        for (idx = 0; idx < URING_BUFFERS; idx++)
+            if (!c->uring_req[idx].busy)
+                break;
+        if (idx < URING_BUFFERS)
+            break;
+        if ((ret = uring_reap(c, 1)) < 0)
+            return ret;
+    }
+
+    size = FFMIN(size, URING_BUFFER_SIZE);
+    memcpy(c->uring_buf + idx * URING_BUFFER_SIZE, buf, size);
+    c->uring_req[idx].busy   = 1;
+    c->uring_req[idx].offset = c->uring_pos;
+    c->uring_req[idx].size   = size;
+    c->uring_req[idx].done   = 0;
+    uring_queue_write(c, idx);
+    c->uring_pos += size;
+
+    if ((ret = uring_reap(c, 0)) < 0)
+        return ret;
+    return size;
+}
+#endif
+
 static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring_active)
+        return uring_write(c, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -205,6 +344,96 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_LINUX_IO_URING_H
+static int file_uring_init(FileContext *c)
+{
+    struct iovec iov;
+    int ret;
+
+    c->uring_buf = av_malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+    if (!c->uring_buf)
+        return AVERROR(ENOMEM);
+    /* two entries per buffer leave room to requeue short writes */
+    if ((ret = ff_uring_init(&c->ring, 2 * URING_BUFFERS)) < 0)
+        goto fail;
+    iov.iov_base = c->uring_buf;
+    iov.iov_len  = URING_BUFFERS * URING_BUFFER_SIZE;
+    if ((ret = ff_uring_register_buffers(&c->ring, &iov, 1)) < 0) {
+        ff_uring_uninit(&c->ring);
+        goto fail;
+    }
+    if ((c->uring_pos = lseek(c->fd, 0, SEEK_CUR)) < 0)
+        c->uring_pos = 0;
+    c->uring_active = 1;
+    return 0;
+fail:
+    av_freep(&c->uring_buf);
+    return ret;
+}
+
+static int file_uring_uninit(FileContext *c)
+{
+    int ret;
+
+    if (!c->uring_active)
+        return 0;
+    ret = uring_drain(c);
+    ff_uring_uninit(&c->ring);
+    av_freep(&c->uring_buf);
+    c->uring_active = 0;
+    return ret;
+}
+#endif
+
+#if HAVE_MMAP
+static void file_map_willneed(FileContext *c, int64_t pos)
+{
+#ifdef MADV_WILLNEED
+    int64_t page = sysconf(_SC_PAGESIZE);
+    int64_t start, end;
+
+    if (page <= 0 || pos >= c->map_size)
+        return;
+    start = pos - pos % page;
+    end   = FFMIN(pos + MMAP_WILLNEED_SIZE, c->map_size);
+    madvise(c->map + start, end - start, MADV_WILLNEED);
+#endif
+}
+
+static int file_map(URLContext *h, struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    void *map;
+
+    if (!S_ISREG(st->st_mode) || st->st_size <= 0 ||
+        (uint64_t)st->st_size > SIZE_MAX)
+        return AVERROR(EINVAL);
+
+    map = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (map == MAP_FAILED)
+        return AVERROR(errno);
+
+    c->map      = map;
+    c->map_size = st->st_size;
+    c->map_pos  = 0;
+#ifdef MADV_SEQUENTIAL
+    madvise(c->map, c->map_size, MADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+static int file_get_mapping(URLContext *h, const uint8_t **data, int64_t *size)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *data = c->map;
+    *size = c->map_size;
+    return 0;
+}
+#endif
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -243,6 +472,34 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    if (c->use_mmap) {
+        int ret = AVERROR(ENOSYS);
+#if HAVE_MMAP
+        if (flags & AVIO_FLAG_WRITE || c->follow || h->is_streamed)
+            ret = AVERROR(EINVAL);
+        else if (fstat(fd, &st) < 0)
+            ret = AVERROR(errno);
+        else
+            ret = file_map(h, &st);
+#endif
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot map %s, using regular reads: %s\n",
+                   filename, av_err2str(ret));
+    }
+
+    if (c->use_uring) {
+        int ret = AVERROR(ENOSYS);
+#if HAVE_LINUX_IO_URING_H
+        if (flags & AVIO_FLAG_READ || h->is_streamed)
+            ret = AVERROR(EINVAL);
+        else
+            ret = file_uring_init(c);
+#endif
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot use io_uring for %s, using regular writes: %s\n",
+                   filename, av_err2str(ret));
+    }
+
     return 0;
 }
 
@@ -252,6 +509,53 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if HAVE_MMAP
+    if (c->map) {
+        switch (whence) {
+        case AVSEEK_SIZE:
+            return c->map_size;
+        case SEEK_SET:
+            break;
+        case SEEK_CUR:
+            pos += c->map_pos;
+            break;
+        case SEEK_END:
+            pos += c->map_size;
+            break;
+        default:
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        /* only hint real jumps, sequential reads are covered by readahead */
+        if (pos < c->map_pos || pos > c->map_pos + MMAP_WILLNEED_SIZE)
+            file_map_willneed(c, pos);
+        c->map_pos = pos;
+        return pos;
+    }
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+    /* Writes carry their own offset, but the muxer may reopen the file to
+     * read back what it wrote (e.g. movenc faststart) after seeking, so
+     * let the queue complete first. */
+    if (c->uring_active) {
+        if ((ret = uring_drain(c)) < 0)
+            return ret;
+        if (whence == SEEK_SET || whence == SEEK_CUR) {
+            pos += whence == SEEK_CUR ? c->uring_pos : 0;
+            if (pos < 0)
+                return AVERROR(EINVAL);
+            return c->uring_pos = pos;
+        }
+        if (whence == SEEK_END) {
+            if ((ret = lseek(c->fd, pos, SEEK_END)) >= 0)
+                c->uring_pos = ret;
+            return ret < 0 ? AVERROR(errno) : ret;
+        }
+    }
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -266,7 +570,20 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    return close(c->fd);
+    int ret = 0;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+    c->map = NULL;
+#endif
+#if HAVE_LINUX_IO_URING_H
+    /* callers tend to ignore close errors, so make a lost write visible */
+    if ((ret = file_uring_uninit(c)) < 0)
+        av_log(h, AV_LOG_ERROR, "Queued write failed: %s\n", av_err2str(ret));
+#endif
+    if (close(c->fd) < 0 && !ret)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 static int file_open_dir(URLContext *h)
@@ -361,6 +678,9 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+#if HAVE_MMAP
+    .url_get_mapping     = file_get_mapping,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
@@ -33,6 +33,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -77,6 +78,30 @@ struct segment {
     struct segment *init_section;
 };
 
+#if HAVE_THREADS
+enum PrefetchState {
+    PREFETCH_FREE,
+    PREFETCH_REQUESTED,
+    PREFETCH_LOADING,
+    PREFETCH_DONE,
+    PREFETCH_IN_USE,
+};
+
+/* A segment downloaded into memory ahead of time by a prefetch thread. */
+struct prefetch_slot {
+    enum PrefetchState state;
+    int seq_no;
+    /* copy of the segment, the playlist may be reloaded while it loads */
+    struct segment seg;
+    AVDictionary *opts;
+    uint8_t *data;
+    unsigned int data_size;
+    int64_t len;
+    int64_t read_pos;
+    int ret;
+};
+#endif
+
 struct rendition;
 
 enum PlaylistType {
@@ -160,6 +185,21 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* prefetched segment in use as input, if any */
+    struct prefetch_slot *input_slot;
+#if HAVE_THREADS
+    /* Segments downloaded concurrently with the demuxing of the current
+     * one, see the prefetch_segments option. The slots are protected by
+     * prefetch_mutex, except the one in use as input. */
+    struct prefetch_slot *prefetch_slots;
+    int n_prefetch_slots;
+    pthread_t *prefetch_threads;
+    int n_prefetch_threads;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+    int prefetch_abort;
+#endif
 };
 
 /*
@@ -212,6 +252,7 @@ typedef struct HLSContext {
     int http_persistent;
     int http_multiple;
     int http_seekable;
+    int prefetch_segments;
     AVIOContext *playlist_pb;
 } HLSContext;
 
@@ -243,6 +284,11 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void close_input(struct playlist *pls);
+#if HAVE_THREADS
+static void prefetch_uninit(struct playlist *pls);
+#endif
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
@@ -258,7 +304,10 @@ static void free_playlist_list(HLSContext *c)
         av_freep(&pls->init_sec_buf);
         av_packet_unref(&pls->pkt);
         av_freep(&pls->pb.buffer);
-        ff_format_io_close(c->ctx, &pls->input);
+        close_input(pls);
+#if HAVE_THREADS
+        prefetch_uninit(pls);
+#endif
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
@@ -624,14 +673,10 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http_out)
+static int check_url(AVFormatContext *s, const char *url, int *is_http)
 {
     HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
-    int is_http = 0;
 
     if (av_strstart(url, "crypto", NULL)) {
         if (url[6] == '+' || url[6] == ':')
@@ -657,7 +702,7 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
             return AVERROR_INVALIDDATA;
         }
     } else if (av_strstart(proto_name, "http", NULL)) {
-        is_http = 1;
+        *is_http = 1;
     } else if (av_strstart(proto_name, "data", NULL)) {
         ;
     } else
@@ -672,6 +717,20 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary *opts, AVDictionary *opts2, int *is_http_out)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+    int is_http = 0;
+
+    if ((ret = check_url(s, url, &is_http)) < 0)
+        return ret;
+
     av_dict_copy(&tmp, opts, 0);
     av_dict_copy(&tmp, opts2, 0);
 
@@ -1306,6 +1365,367 @@ cleanup:
     return ret;
 }
 
+#if HAVE_THREADS
+static void prefetch_slot_reset(struct prefetch_slot *slot)
+{
+    av_freep(&slot->seg.url);
+    av_freep(&slot->seg.key);
+    av_dict_free(&slot->opts);
+    slot->len      = 0;
+    slot->read_pos = 0;
+    slot->state    = PREFETCH_FREE;
+}
+
+static int prefetch_interrupt(void *opaque)
+{
+    struct playlist *pls = opaque;
+    HLSContext *c = pls->parent->priv_data;
+
+    return pls->prefetch_abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+static int prefetch_open(struct playlist *pls, const char *url,
+                         AVDictionary **opts, AVIOContext **pb, int *is_http)
+{
+    AVFormatContext *s = pls->parent;
+    const AVIOInterruptCB int_cb = { prefetch_interrupt, pls };
+    int ret = check_url(s, url, is_http);
+
+    if (ret < 0)
+        return ret;
+    return ffio_open_whitelist(pb, url, AVIO_FLAG_READ, &int_cb, opts,
+                               s->protocol_whitelist, s->protocol_blacklist);
+}
+
+/* Download a whole segment into slot->data, called without the lock held. */
+static int prefetch_load(struct playlist *pls, struct prefetch_slot *slot)
+{
+    struct segment *seg = &slot->seg;
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    char url[MAX_URL_SIZE];
+    int is_http = 0, ret;
+
+    av_strlcpy(url, seg->url, sizeof(url));
+
+    if (seg->key_type == KEY_AES_128) {
+        char iv[33], key_hex[33];
+        uint8_t key[16];
+
+        av_dict_copy(&opts, slot->opts, 0);
+        ret = prefetch_open(pls, seg->key, &opts, &pb, &is_http);
+        av_dict_free(&opts);
+        if (ret < 0)
+            return ret;
+        ret = avio_read(pb, key, sizeof(key));
+        avio_closep(&pb);
+        if (ret != sizeof(key))
+            return ret < 0 ? ret : AVERROR_INVALIDDATA;
+
+        ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
+        ff_data_to_hex(key_hex, key, sizeof(key), 0);
+        iv[32] = key_hex[32] = '\0';
+        snprintf(url, sizeof(url), strstr(seg->url, "://") ? "crypto+%s" : "crypto:%s",
+                 seg->url);
+        av_dict_set(&slot->opts, "key", key_hex, 0);
+        av_dict_set(&slot->opts, "iv", iv, 0);
+    }
+
+    if (seg->size >= 0) {
+        av_dict_set_int(&slot->opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&slot->opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+
+    ret = prefetch_open(pls, url, &slot->opts, &pb, &is_http);
+    if (ret < 0)
+        return ret;
+
+    /* see open_input() */
+    if (!is_http && seg->key_type == KEY_NONE && seg->url_offset) {
+        int64_t seekret = avio_seek(pb, seg->url_offset, SEEK_SET);
+        if (seekret < 0) {
+            ret = seekret;
+            goto end;
+        }
+    }
+
+    slot->len = 0;
+    for (;;) {
+        int size = INITIAL_BUFFER_SIZE * 8;
+
+        if (seg->size >= 0)
+            size = FFMIN(size, seg->size - slot->len);
+        if (size <= 0)
+            break;
+        if (slot->len + size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_reallocp(&slot->data, slot->len + size);
+        if (ret < 0) {
+            slot->data_size = 0;
+            goto end;
+        }
+        slot->data_size = slot->len + size;
+        ret = avio_read(pb, slot->data + slot->len, size);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            goto end;
+        slot->len += ret;
+    }
+    ret = 0;
+
+end:
+    avio_closep(&pb);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    int i, ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (!pls->prefetch_abort) {
+        struct prefetch_slot *slot = NULL;
+
+        for (i = 0; i < pls->n_prefetch_slots; i++) {
+            struct prefetch_slot *s = &pls->prefetch_slots[i];
+            if (s->state == PREFETCH_REQUESTED && (!slot || s->seq_no < slot->seq_no))
+                slot = s;
+        }
+        if (!slot) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            continue;
+        }
+
+        slot->state = PREFETCH_LOADING;
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+
+        av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch of url '%s', offset %"PRId64", playlist %d\n",
+               slot->seg.url, slot->seg.url_offset, pls->index);
+        ret = prefetch_load(pls, slot);
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        slot->ret   = ret;
+        slot->state = PREFETCH_DONE;
+        pthread_cond_broadcast(&pls->prefetch_cond);
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return NULL;
+}
+
+static void prefetch_uninit(struct playlist *pls)
+{
+    int i;
+
+    if (!pls->prefetch_slots)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    pls->prefetch_abort = 1;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    for (i = 0; i < pls->n_prefetch_threads; i++)
+        pthread_join(pls->prefetch_threads[i], NULL);
+    av_freep(&pls->prefetch_threads);
+    pls->n_prefetch_threads = 0;
+
+    for (i = 0; i < pls->n_prefetch_slots; i++) {
+        prefetch_slot_reset(&pls->prefetch_slots[i]);
+        av_freep(&pls->prefetch_slots[i].data);
+    }
+    av_freep(&pls->prefetch_slots);
+    pls->n_prefetch_slots = 0;
+
+    pthread_cond_destroy(&pls->prefetch_cond);
+    pthread_mutex_destroy(&pls->prefetch_mutex);
+}
+
+static int prefetch_init(HLSContext *c, struct playlist *pls)
+{
+    int i, ret;
+
+    /* the current segment and the next prefetch_segments ones */
+    pls->prefetch_slots = av_mallocz_array(c->prefetch_segments + 1, sizeof(*pls->prefetch_slots));
+    pls->prefetch_threads = av_mallocz_array(c->prefetch_segments + 1, sizeof(*pls->prefetch_threads));
+    if (!pls->prefetch_slots || !pls->prefetch_threads) {
+        av_freep(&pls->prefetch_slots);
+        av_freep(&pls->prefetch_threads);
+        return AVERROR(ENOMEM);
+    }
+    pls->n_prefetch_slots = c->prefetch_segments + 1;
+
+    pthread_mutex_init(&pls->prefetch_mutex, NULL);
+    pthread_cond_init(&pls->prefetch_cond, NULL);
+
+    for (i = 0; i < pls->n_prefetch_slots; i++) {
+        ret = AVERROR(pthread_create(&pls->prefetch_threads[i], NULL, prefetch_thread, pls));
+        if (ret < 0) {
+            prefetch_uninit(pls);
+            return ret;
+        }
+        pls->n_prefetch_threads++;
+    }
+
+    return 0;
+}
+
+/* Request the segments from the current one on that are not loaded yet. */
+static void prefetch_schedule(struct playlist *pls)
+{
+    int last_seq_no = FFMIN(pls->cur_seq_no + pls->n_prefetch_slots,
+                            pls->start_seq_no + pls->n_segments);
+    int seq_no, i;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+
+    for (i = 0; i < pls->n_prefetch_slots; i++) {
+        struct prefetch_slot *slot = &pls->prefetch_slots[i];
+        if ((slot->state == PREFETCH_REQUESTED || slot->state == PREFETCH_DONE) &&
+            (slot->seq_no < pls->cur_seq_no || slot->seq_no >= last_seq_no))
+            prefetch_slot_reset(slot);
+    }
+
+    for (seq_no = pls->cur_seq_no; seq_no < last_seq_no; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch_slot *slot = NULL;
+
+        if (seg->key_type != KEY_NONE && seg->key_type != KEY_AES_128)
+            continue;
+        for (i = 0; i < pls->n_prefetch_slots; i++)
+            if (pls->prefetch_slots[i].state != PREFETCH_FREE &&
+                pls->prefetch_slots[i].seq_no == seq_no)
+                break;
+        if (i < pls->n_prefetch_slots)
+            continue;
+        for (i = 0; i < pls->n_prefetch_slots && !slot; i++)
+            if (pls->prefetch_slots[i].state == PREFETCH_FREE)
+                slot = &pls->prefetch_slots[i];
+        if (!slot)
+            break;
+
+        slot->seq_no          = seq_no;
+        slot->seg             = *seg;
+        slot->seg.init_section = NULL;
+        slot->seg.url         = av_strdup(seg->url);
+        slot->seg.key         = seg->key ? av_strdup(seg->key) : NULL;
+        av_dict_copy(&slot->opts, ((HLSContext *)pls->parent->priv_data)->avio_opts, 0);
+        if (!slot->seg.url || (seg->key && !slot->seg.key)) {
+            prefetch_slot_reset(slot);
+            break;
+        }
+        slot->state = PREFETCH_REQUESTED;
+    }
+
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    struct prefetch_slot *slot = opaque;
+    int size = FFMIN(buf_size, slot->len - slot->read_pos);
+
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, slot->data + slot->read_pos, size);
+    slot->read_pos += size;
+
+    return size;
+}
+#endif
+
+/**
+ * Open the current segment from the prefetched data, waiting for its
+ * download to finish if needed. Returns a negative error code if the
+ * segment has not been or could not be prefetched.
+ */
+static int open_prefetched_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+#if HAVE_THREADS
+    struct prefetch_slot *slot = NULL;
+    uint8_t *buf;
+    int i, ret;
+
+    if (c->prefetch_segments <= 0)
+        return AVERROR(ENOSYS);
+    if (!pls->prefetch_slots && (ret = prefetch_init(c, pls)) < 0) {
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to start prefetching for playlist %d\n",
+               pls->index);
+        c->prefetch_segments = 0;
+        return ret;
+    }
+
+    prefetch_schedule(pls);
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    for (i = 0; i < pls->n_prefetch_slots; i++) {
+        struct prefetch_slot *s = &pls->prefetch_slots[i];
+        if (s->state != PREFETCH_FREE && s->seq_no == pls->cur_seq_no &&
+            !strcmp(s->seg.url, seg->url))
+            slot = s;
+    }
+    /* downloads are interrupted along with the demuxer, so this
+     * cannot block beyond the interrupt callback */
+    while (slot && (slot->state == PREFETCH_REQUESTED || slot->state == PREFETCH_LOADING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+    if (slot && slot->ret < 0) {
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to prefetch segment %d of playlist %d: %s\n",
+               pls->cur_seq_no, pls->index, av_err2str(slot->ret));
+        ret = slot->ret;
+        prefetch_slot_reset(slot);
+        slot = NULL;
+    } else {
+        ret = AVERROR(EAGAIN);
+    }
+    if (slot)
+        slot->state = PREFETCH_IN_USE;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    if (!slot)
+        return ret;
+
+    /* a kept-alive connection is not needed anymore */
+    ff_format_io_close(pls->parent, &pls->input);
+
+    buf = av_malloc(INITIAL_BUFFER_SIZE);
+    pls->input = buf ? avio_alloc_context(buf, INITIAL_BUFFER_SIZE, 0, slot, prefetch_read, NULL, NULL) : NULL;
+    if (!pls->input) {
+        av_free(buf);
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        prefetch_slot_reset(slot);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+        return AVERROR(ENOMEM);
+    }
+    pls->input_slot     = slot;
+    pls->cur_seg_offset = 0;
+
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static void close_input(struct playlist *pls)
+{
+#if HAVE_THREADS
+    if (pls->input_slot) {
+        av_freep(&pls->input->buffer);
+        avio_context_free(&pls->input);
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        prefetch_slot_reset(pls->input_slot);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+        pls->input_slot = NULL;
+        return;
+    }
+#endif
+    ff_format_io_close(pls->parent, &pls->input);
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
     static const int max_init_section_size = 1024*1024;
@@ -1506,7 +1926,9 @@ reload:
             v->input_next_requested = 0;
             ret = 0;
         } else {
-            ret = open_input(c, v, seg, &v->input);
+            ret = open_prefetched_input(c, v, seg);
+            if (ret < 0 && ret != AVERROR_EXIT)
+                ret = open_input(c, v, seg, &v->input);
         }
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
@@ -1563,11 +1985,11 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (c->http_persistent && !v->input_slot &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
-        ff_format_io_close(v->parent, &v->input);
+        close_input(v);
     }
     v->cur_seq_no++;
 
@@ -1701,7 +2123,8 @@ static int save_avio_options(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
     static const char * const opts[] = {
-        "headers", "http_proxy", "user_agent", "cookies", "referer", "rw_timeout", "icy", NULL };
+        "headers", "http_proxy", "user_agent", "cookies", "referer", "rw_timeout", "icy",
+        "http2", NULL };
     const char * const * opt = opts;
     uint8_t *buf;
     int ret = 0;
@@ -1869,6 +2292,10 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+    /* the prefetch threads already keep the next segments in flight */
+    if (c->prefetch_segments > 0)
+        c->http_multiple = 0;
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         goto fail;
 
@@ -2085,7 +2512,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
-            ff_format_io_close(pls->parent, &pls->input);
+            close_input(pls);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
@@ -2326,7 +2753,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
-        ff_format_io_close(pls->parent, &pls->input);
+        close_input(pls);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
@@ -2391,6 +2818,8 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead concurrently",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
     {NULL}
 };
 
@@ -51,6 +51,7 @@
 #endif
 #include "hlsplaylist.h"
 #include "internal.h"
+#include "ioworker.h"
 #include "os_support.h"
 
 typedef enum {
@@ -71,6 +72,12 @@ typedef enum {
 #define HLS_MICROSECOND_UNIT   1000000
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    char *filename;
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -85,6 +92,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts;
+    int nb_parts;
+
     struct HLSSegment *next;
 } HLSSegment;
 
@@ -149,6 +159,12 @@ typedef struct VariantStream {
     HLSSegment *last_segment;
     HLSSegment *old_segments;
 
+    HLSPart *parts;          // partial segments of the segment being written
+    int nb_parts;
+    int64_t part_start_dts;  // parts are cut in decode order, which B-frames reorder in pts
+    int part_start_offset;   // start of the current part in the segment buffer
+    int part_independent;
+
     char *basename;
     char *vtt_basename;
     char *vtt_m3u8_name;
@@ -193,6 +209,7 @@ typedef struct HLSContext {
 
     float time;            // Set by a private option.
     float init_time;       // Set by a private option.
+    float part_time;       // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
 #if FF_API_HLS_WRAP
@@ -246,6 +263,7 @@ typedef struct HLSContext {
     char *master_pl_name;
     unsigned int master_publish_rate;
     int http_persistent;
+    int http2;
     AVIOContext *m3u8_out;
     AVIOContext *sub_m3u8_out;
     int64_t timeout;
@@ -253,6 +271,9 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+
+    int io_queue_size;
+    FFIOWorker *io_worker; ///< finishes segments and playlists in the background
 } HLSContext;
 
 static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
@@ -297,6 +318,41 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+static int hlsenc_playlist_open(AVFormatContext *s, AVIOContext **pb, char *filename,
+                                AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->io_worker)
+        return avio_open_dyn_buf(pb);
+    return hlsenc_io_open(s, pb, filename, options);
+}
+
+static int hlsenc_playlist_close(AVFormatContext *s, AVIOContext **pb, char *filename,
+                                 AVDictionary *options)
+{
+    HLSContext *hls = s->priv_data;
+    uint8_t *buf;
+    int size;
+
+    if (!hls->io_worker)
+        return hlsenc_io_close(s, pb, filename);
+    if (!*pb)
+        return 0;
+    size = avio_close_dyn_buf(*pb, &buf);
+    *pb = NULL;
+    return ff_io_worker_write(hls->io_worker, filename, options, buf, size);
+}
+
+static int hlsenc_rename(AVFormatContext *s, const char *url_src, const char *url_dst)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->io_worker)
+        return ff_io_worker_rename(hls->io_worker, url_src, url_dst);
+    return ff_rename(url_src, url_dst, s);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -310,6 +366,8 @@ static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSCont
         av_dict_set(options, "user_agent", c->user_agent, 0);
     if (c->http_persistent)
         av_dict_set_int(options, "multiple_requests", 1, 0);
+    if (c->http2)
+        av_dict_set_int(options, "http2", 1, 0);
     if (c->timeout >= 0)
         av_dict_set_int(options, "timeout", c->timeout, 0);
     if (c->headers)
@@ -487,12 +545,66 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+static int queue_dynbuf(AVFormatContext *s, VariantStream *vs, char *filename,
+                        AVDictionary *options)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *ctx = vs->avf;
+    AVIOContext *out;
+    uint8_t *buf;
+    int size, ret, err;
+
+    if (!ctx->pb) {
+        return AVERROR(EINVAL);
+    }
+
+    // flush
+    av_write_frame(ctx, NULL);
+
+    // hand the segment to the worker, it owns the buffer from now on
+    size = avio_close_dyn_buf(ctx->pb, &buf);
+    ctx->pb = NULL;
+    if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+        if ((ret = avio_open_dyn_buf(&out)) < 0) {
+            av_free(buf);
+            return ret;
+        }
+        write_styp(out);
+        avio_write(out, buf, size);
+        av_free(buf);
+        size = avio_close_dyn_buf(out, &buf);
+    }
+    ret = ff_io_worker_write(hls->io_worker, filename, options, buf, size);
+    if (hls->ignore_io_errors)
+        ret = 0;
+
+    // re-open buffer
+    err = avio_open_dyn_buf(&ctx->pb);
+    return ret < 0 ? ret : err;
+}
+
 #if HAVE_DOS_PATHS
 #define SEPARATOR '\\'
 #else
 #define SEPARATOR '/'
 #endif
 
+static void hls_free_parts(HLSPart **parts, int *nb_parts)
+{
+    int i;
+
+    for (i = 0; i < *nb_parts; i++)
+        av_freep(&(*parts)[i].filename);
+    av_freep(parts);
+    *nb_parts = 0;
+}
+
+static void hls_free_segment(HLSSegment *en)
+{
+    hls_free_parts(&en->parts, &en->nb_parts);
+    av_free(en);
+}
+
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            const char *path, const char *proto)
 {
@@ -519,7 +631,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
 
     HLSSegment *segment, *previous_segment = NULL;
     float playlist_duration = 0.0f;
-    int ret = 0;
+    int ret = 0, i;
     int segment_cnt = 0;
     AVBPrint path;
     const char *dirname = NULL;
@@ -593,6 +705,21 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         if (ret = hls_delete_file(hls, vs->avf, path.str, proto))
             goto fail;
 
+        for (i = 0; i < segment->nb_parts; i++) {
+            av_bprint_clear(&path);
+            if (!hls->use_localtime_mkdir)
+                av_bprintf(&path, "%s%c", dirname, SEPARATOR);
+            av_bprintf(&path, "%s", segment->parts[i].filename);
+
+            if (!av_bprint_is_complete(&path)) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+
+            if (ret = hls_delete_file(hls, vs->avf, path.str, proto))
+                goto fail;
+        }
+
         if ((segment->sub_filename[0] != '\0')) {
             vtt_dirname_r = av_strdup(vs->vtt_avf->url);
             vtt_dirname = av_dirname(vtt_dirname_r);
@@ -613,7 +740,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
-        av_freep(&previous_segment);
+        hls_free_segment(previous_segment);
     }
 
 fail:
@@ -978,10 +1105,11 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
     return ret;
 }
 
-static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
+static void sls_flag_file_rename(AVFormatContext *s, VariantStream *vs, char *old_filename) {
+    HLSContext *hls = s->priv_data;
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        hlsenc_rename(s, old_filename, vs->avf->url);
     }
 }
 
@@ -1037,7 +1165,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
                               VariantStream *vs, double duration, int64_t pos,
                               int64_t size)
 {
-    HLSSegment *en = av_malloc(sizeof(*en));
+    HLSSegment *en = av_mallocz(sizeof(*en));
     const char  *filename;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
     int ret;
@@ -1086,6 +1214,11 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         av_strlcpy(en->iv_string, vs->iv_string, sizeof(en->iv_string));
     }
 
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
+
     if (!vs->segments)
         vs->segments = en;
     else
@@ -1112,7 +1245,7 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
         } else
-            av_freep(&en);
+            hls_free_segment(en);
     } else
         vs->nb_entries++;
 
@@ -1222,7 +1355,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
-        av_freep(&en);
+        hls_free_segment(en);
     }
 }
 
@@ -1235,7 +1368,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = hlsenc_rename(s, oc->url, final_filename);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1443,6 +1576,23 @@ fail:
     return ret;
 }
 
+static char *hls_part_filename(VariantStream *vs, int part)
+{
+    const char *url = vs->avf->url;
+    int len = strlen(url), ext, i;
+
+    if (len > 4 && !strcmp(url + len - 4, ".tmp"))
+        len -= 4;
+    ext = len;
+    for (i = len - 1; i >= 0 && url[i] != '/' && url[i] != SEPARATOR; i--) {
+        if (url[i] == '.') {
+            ext = i;
+            break;
+        }
+    }
+    return av_asprintf("%.*s.part%d%.*s", ext, url, part, len - ext, url + ext);
+}
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1462,6 +1612,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    AVIOContext **out = byterange_mode ? &hls->m3u8_out : &vs->out;
+    AVIOContext **sub_out = &hls->sub_m3u8_out;
+    AVIOContext *out_buf = NULL, *sub_out_buf = NULL;
+    double remaining_duration = 0;
+    int i;
 
     hls->version = 3;
     if (byterange_mode) {
@@ -1480,9 +1635,16 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (!is_file_proto && (hls->flags & HLS_TEMP_FILE) && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
 
+    /* With background I/O the playlists are rendered in memory and uploaded
+     * by the worker after the segments queued before them. */
+    if (hls->io_worker) {
+        out     = &out_buf;
+        sub_out = &sub_out_buf;
+    }
+
     set_http_options(s, &options, hls);
     snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->m3u8_name);
-    if ((ret = hlsenc_io_open(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename, &options)) < 0) {
+    if ((ret = hlsenc_playlist_open(s, out, temp_filename, &options)) < 0) {
         if (hls->ignore_io_errors)
             ret = 0;
         goto fail;
@@ -1491,36 +1653,48 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        remaining_duration += en->duration;
     }
 
     vs->discontinuity_set = 0;
-    ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
+    ff_hls_write_playlist_header(*out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
+        avio_printf(*out, "#EXT-X-DISCONTINUITY\n");
         vs->discontinuity_set = 1;
     }
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
-        avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+        avio_printf(*out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
+    if (hls->part_time > 0)
+        ff_hls_write_part_info(*out, hls->part_time);
     for (en = vs->segments; en; en = en->next) {
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
+            avio_printf(*out, "#EXT-X-KEY:METHOD=AES-128,URI=\"%s\"", en->key_uri);
             if (*en->iv_string)
-                avio_printf(byterange_mode ? hls->m3u8_out : vs->out, ",IV=0x%s", en->iv_string);
-            avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "\n");
+                avio_printf(*out, ",IV=0x%s", en->iv_string);
+            avio_printf(*out, "\n");
             key_uri = en->key_uri;
             iv_string = en->iv_string;
         }
 
         if ((hls->segment_type == SEGMENT_TYPE_FMP4) && (en == vs->segments)) {
-            ff_hls_write_init_file(byterange_mode ? hls->m3u8_out : vs->out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
+            ff_hls_write_init_file(*out, (hls->flags & HLS_SINGLE_FILE) ? en->filename : vs->fmp4_init_filename,
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
-        ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
+        /* partial segments are only listed within three target durations
+         * of the live edge */
+        if (remaining_duration <= 3 * target_duration) {
+            for (i = 0; i < en->nb_parts; i++)
+                ff_hls_write_part(*out, en->parts[i].duration, hls->baseurl,
+                                  en->parts[i].filename, en->parts[i].independent);
+        }
+        remaining_duration -= en->duration;
+
+        ret = ff_hls_write_file_entry(*out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
                                       en->filename, prog_date_time_p, en->keyframe_size, en->keyframe_pos, hls->flags & HLS_I_FRAMES_ONLY);
@@ -1529,20 +1703,37 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (hls->part_time > 0 && !last && vs->init_range_length) {
+        char *hint = hls_part_filename(vs, vs->nb_parts);
+
+        if (!hint) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if (!vs->segments)
+            ff_hls_write_init_file(*out, vs->fmp4_init_filename, 0, vs->init_range_length, 0);
+        for (i = 0; i < vs->nb_parts; i++)
+            ff_hls_write_part(*out, vs->parts[i].duration, hls->baseurl,
+                              vs->parts[i].filename, vs->parts[i].independent);
+        ff_hls_write_preload_hint(*out, hls->baseurl,
+                                  hls->use_localtime_mkdir ? hint : av_basename(hint));
+        av_free(hint);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
-        ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
+        ff_hls_write_end_list(*out);
 
     if (vs->vtt_m3u8_name) {
         snprintf(temp_vtt_filename, sizeof(temp_vtt_filename), use_temp_file ? "%s.tmp" : "%s", vs->vtt_m3u8_name);
-        if ((ret = hlsenc_io_open(s, &hls->sub_m3u8_out, temp_vtt_filename, &options)) < 0) {
+        if ((ret = hlsenc_playlist_open(s, sub_out, temp_vtt_filename, &options)) < 0) {
             if (hls->ignore_io_errors)
                 ret = 0;
             goto fail;
         }
-        ff_hls_write_playlist_header(hls->sub_m3u8_out, hls->version, hls->allowcache,
+        ff_hls_write_playlist_header(*sub_out, hls->version, hls->allowcache,
                                      target_duration, sequence, PLAYLIST_TYPE_NONE, 0);
         for (en = vs->segments; en; en = en->next) {
-            ret = ff_hls_write_file_entry(hls->sub_m3u8_out, 0, byterange_mode,
+            ret = ff_hls_write_file_entry(*sub_out, 0, byterange_mode,
                                           en->duration, 0, en->size, en->pos,
                                           hls->baseurl, en->sub_filename, NULL, 0, 0, 0);
             if (ret < 0) {
@@ -1551,21 +1742,22 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
 
         if (last)
-            ff_hls_write_end_list(hls->sub_m3u8_out);
+            ff_hls_write_end_list(*sub_out);
 
     }
 
 fail:
-    av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    ret = hlsenc_playlist_close(s, out, temp_filename, options);
     if (ret < 0) {
+        av_dict_free(&options);
         return ret;
     }
-    hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    hlsenc_playlist_close(s, sub_out, temp_vtt_filename, options);
+    av_dict_free(&options);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        hlsenc_rename(s, temp_filename, vs->m3u8_name);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            hlsenc_rename(s, temp_vtt_filename, vs->vtt_m3u8_name);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
@@ -2258,6 +2450,101 @@ static int hls_init_file_resend(AVFormatContext *s, VariantStream *vs)
     return ret;
 }
 
+static int hls_flush_init_buffer(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+/* Write the fragment buffered since the last part as a partial segment,
+ * the complete segment is still written at the segment boundary. */
+static int hls_flush_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    HLSPart *parts, *part;
+    char *filename;
+    uint8_t *buf, *data;
+    int size, ret;
+
+    av_write_frame(oc, NULL);
+    if (!vs->init_range_length) {
+        /* the first flush only wrote the init section */
+        if ((ret = hls_flush_init_buffer(s, vs)) < 0)
+            return ret;
+        vs->part_start_offset = 0;
+        av_write_frame(oc, NULL);
+    }
+
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_start_offset)
+        return 0;
+    buf  += vs->part_start_offset;
+    size -= vs->part_start_offset;
+
+    filename = hls_part_filename(vs, vs->nb_parts);
+    if (!filename)
+        return AVERROR(ENOMEM);
+
+    set_http_options(s, &options, hls);
+    if (hls->io_worker) {
+        data = av_memdup(buf, size);
+        ret = data ? ff_io_worker_write(hls->io_worker, filename, options, data, size)
+                   : AVERROR(ENOMEM);
+    } else {
+        ret = hlsenc_io_open(s, &vs->out, filename, &options);
+        if (ret >= 0) {
+            avio_write(vs->out, buf, size);
+            ret = hlsenc_io_close(s, &vs->out, filename);
+        }
+    }
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to write partial segment '%s'\n", filename);
+        if (!hls->ignore_io_errors) {
+            av_free(filename);
+            return ret;
+        }
+    }
+    vs->part_start_offset += size;
+
+    parts = av_realloc_array(vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (!parts) {
+        av_free(filename);
+        return AVERROR(ENOMEM);
+    }
+    vs->parts = parts;
+    part = &vs->parts[vs->nb_parts];
+    part->filename = av_strdup(hls->use_localtime_mkdir ? filename : av_basename(filename));
+    av_free(filename);
+    if (!part->filename)
+        return AVERROR(ENOMEM);
+    part->duration    = duration;
+    part->independent = vs->part_independent;
+    vs->nb_parts++;
+
+    return 0;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2265,6 +2552,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVStream *st = s->streams[pkt->stream_index];
     int64_t end_pts = 0;
     int is_ref_pkt = 1;
+    int64_t part_dts;
     int ret = 0, can_split = 1, i, j;
     int stream_index = 0;
     int range_length = 0;
@@ -2324,6 +2612,13 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     }
     if (pkt->pts == AV_NOPTS_VALUE)
         is_ref_pkt = can_split = 0;
+    part_dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+
+    if (hls->part_time > 0 && is_ref_pkt && oc == vs->avf &&
+        vs->part_start_dts == AV_NOPTS_VALUE) {
+        vs->part_start_dts   = part_dts;
+        vs->part_independent = 1;
+    }
 
     if (is_ref_pkt) {
         if (vs->end_pts == AV_NOPTS_VALUE)
@@ -2349,25 +2644,22 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         int64_t new_start_pos;
         int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
 
+        if (hls->part_time > 0) {
+            /* the last part ends with the segment */
+            ret = hls_flush_part(s, vs, (part_dts - vs->part_start_dts) * av_q2d(st->time_base));
+            if (ret < 0)
+                return ret;
+        }
+
         av_write_frame(oc, NULL); /* Flush any buffered data */
         new_start_pos = avio_tell(oc->pb);
         vs->size = new_start_pos - vs->start_pos;
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = hls_flush_init_buffer(s, vs);
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2411,35 +2703,43 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 
                 set_http_options(s, &options, hls);
 
-                ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                if (ret < 0) {
-                    av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
-                           "Failed to open file '%s'\n", filename);
-                    av_freep(&filename);
+                if (hls->io_worker) {
+                    ret = queue_dynbuf(s, vs, filename, options);
                     av_dict_free(&options);
-                    return hls->ignore_io_errors ? 0 : ret;
-                }
-                if (hls->segment_type == SEGMENT_TYPE_FMP4) {
-                    write_styp(vs->out);
-                }
-                ret = flush_dynbuf(vs, &range_length);
-                if (ret < 0) {
                     av_freep(&filename);
-                    av_dict_free(&options);
-                    return ret;
-                }
-                ret = hlsenc_io_close(s, &vs->out, filename);
-                if (ret < 0) {
-                    av_log(s, AV_LOG_WARNING, "upload segment failed,"
-                           " will retry with a new http session.\n");
-                    ff_format_io_close(s, &vs->out);
+                    if (ret < 0)
+                        return ret;
+                } else {
                     ret = hlsenc_io_open(s, &vs->out, filename, &options);
-                    reflush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+                               "Failed to open file '%s'\n", filename);
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return hls->ignore_io_errors ? 0 : ret;
+                    }
+                    if (hls->segment_type == SEGMENT_TYPE_FMP4) {
+                        write_styp(vs->out);
+                    }
+                    ret = flush_dynbuf(vs, &range_length);
+                    if (ret < 0) {
+                        av_freep(&filename);
+                        av_dict_free(&options);
+                        return ret;
+                    }
                     ret = hlsenc_io_close(s, &vs->out, filename);
+                    if (ret < 0) {
+                        av_log(s, AV_LOG_WARNING, "upload segment failed,"
+                               " will retry with a new http session.\n");
+                        ff_format_io_close(s, &vs->out);
+                        ret = hlsenc_io_open(s, &vs->out, filename, &options);
+                        reflush_dynbuf(vs, &range_length);
+                        ret = hlsenc_io_close(s, &vs->out, filename);
+                    }
+                    av_dict_free(&options);
+                    av_freep(&vs->temp_buffer);
+                    av_freep(&filename);
                 }
-                av_dict_free(&options);
-                av_freep(&vs->temp_buffer);
-                av_freep(&filename);
             }
 
             if (use_temp_file)
@@ -2463,7 +2763,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // with partial segments the playlist is written once the next segment is started
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !(hls->part_time > 0)) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2487,7 +2788,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         } else if (hls->max_seg_size > 0) {
             if (vs->size + vs->start_pos >= hls->max_seg_size) {
                 vs->sequence++;
-                sls_flag_file_rename(hls, vs, old_filename);
+                sls_flag_file_rename(s, vs, old_filename);
                 ret = hls_start(s, vs);
                 vs->start_pos = 0;
                 /* When split segment by byte, the duration is short than hls_time,
@@ -2497,7 +2798,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         } else {
             vs->start_pos = new_start_pos;
-            sls_flag_file_rename(hls, vs, old_filename);
+            sls_flag_file_rename(s, vs, old_filename);
             ret = hls_start(s, vs);
         }
         vs->number++;
@@ -2507,6 +2808,27 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+        if (hls->part_time > 0) {
+            vs->part_start_dts    = part_dts;
+            vs->part_start_offset = 0;
+            vs->part_independent  = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    } else if (hls->part_time > 0 && is_ref_pkt && oc == vs->avf && vs->packets_written &&
+               part_dts > vs->part_start_dts) {
+        /* cut a part before the packet that would make it exceed the part target */
+        int cmp = av_compare_ts(part_dts + pkt->duration - vs->part_start_dts, st->time_base,
+                                llrint(hls->part_time * AV_TIME_BASE), AV_TIME_BASE_Q);
+        if (pkt->duration ? cmp > 0 : cmp >= 0) {
+            ret = hls_flush_part(s, vs, (part_dts - vs->part_start_dts) * av_q2d(st->time_base));
+            if (ret < 0)
+                return ret;
+            vs->part_start_dts   = part_dts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
     }
 
     vs->packets_written++;
@@ -2531,6 +2853,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    ff_io_worker_free(&hls->io_worker);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2546,6 +2870,7 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        hls_free_parts(&vs->parts, &vs->nb_parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2572,6 +2897,9 @@ static int hls_write_trailer(struct AVFormatContext *s)
     AVDictionary *options = NULL;
     int range_length, byterange_mode;
 
+    /* let the queued uploads complete, the last segments are written inline */
+    ff_io_worker_free(&hls->io_worker);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         char *filename = NULL;
         vs = &hls->var_streams[i];
@@ -2595,6 +2923,17 @@ static int hls_write_trailer(struct AVFormatContext *s)
             return AVERROR(ENOMEM);
         }
 
+        if (hls->part_time > 0 && vs->part_start_dts != AV_NOPTS_VALUE) {
+            double duration = vs->duration + vs->dpp;
+            int j;
+
+            for (j = 0; j < vs->nb_parts; j++)
+                duration -= vs->parts[j].duration;
+            ret = hls_flush_part(s, vs, FFMAX(duration, 0));
+            if (ret < 0)
+                goto failed;
+        }
+
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             int range_length = 0;
             if (!vs->init_range_length) {
@@ -2669,7 +3008,7 @@ failed:
         /* after av_write_trailer, then duration + 1 duration per packet */
         hls_append_segment(s, hls, vs, vs->duration + vs->dpp, vs->start_pos, vs->size);
 
-        sls_flag_file_rename(hls, vs, old_filename);
+        sls_flag_file_rename(s, vs, old_filename);
 
         if (vtt_oc) {
             if (vtt_oc->pb)
@@ -2779,6 +3118,14 @@ static int hls_init(AVFormatContext *s)
 
     hls->recording_time = (hls->init_time ? hls->init_time : hls->time) * AV_TIME_BASE;
 
+    if (hls->part_time > 0 &&
+        (hls->segment_type != SEGMENT_TYPE_FMP4 || hls->flags & HLS_SINGLE_FILE ||
+         hls->max_seg_size > 0 || hls->key_info_file || hls->encrypt)) {
+        av_log(s, AV_LOG_ERROR, "Partial segments require fmp4 segments "
+               "without single_file, hls_segment_size or encryption\n");
+        return AVERROR(EINVAL);
+    }
+
     if (hls->flags & HLS_SPLIT_BY_TIME && hls->flags & HLS_INDEPENDENT_SEGMENTS) {
         // Independent segments cannot be guaranteed when splitting by time
         hls->flags &= ~HLS_INDEPENDENT_SEGMENTS;
@@ -2797,6 +3144,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_dts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
 
         if (hls->flags & HLS_PROGRAM_DATE_TIME) {
@@ -2931,6 +3279,15 @@ static int hls_init(AVFormatContext *s)
         vs->number++;
     }
 
+    if (hls->io_queue_size > 0) {
+        ret = ff_io_worker_alloc(&hls->io_worker, s, hls->io_queue_size);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(s, AV_LOG_WARNING, "Background I/O requires threads, "
+                   "finishing segments on the muxing thread\n");
+            ret = 0;
+        }
+    }
+
     return ret;
 }
 
@@ -2940,6 +3297,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length in seconds",           OFFSET(time),    AV_OPT_TYPE_FLOAT,  {.dbl = 2},     0, FLT_MAX, E},
     {"hls_init_time", "set segment length in seconds at init list",           OFFSET(init_time),    AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
+    {"hls_part_time", "set partial segment length in seconds for Low-Latency HLS", OFFSET(part_time), AV_OPT_TYPE_FLOAT,  {.dbl = 0},     0, FLT_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options), AV_OPT_TYPE_DICT, {.str = NULL},  0, 0,    E},
@@ -3001,8 +3359,10 @@ static const AVOption options[] = {
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
     {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    {"http2", "Use HTTP/2 for HTTPS output if the server supports it", OFFSET(http2), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
+    {"io_queue_size", "set the number of output operations that may be pending in the background I/O thread", OFFSET(io_queue_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { NULL },
 };
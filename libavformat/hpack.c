@@ -0,0 +1,395 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "hpack.h"
+
+#define STATIC_TABLE_SIZE 61
+#define FIELD_OVERHEAD    32
+#define HUFFMAN_EOS       256
+#define HUFFMAN_MAX_BITS  30
+
+static const char *const static_table[STATIC_TABLE_SIZE][2] = {
+    { ":authority",                  ""              },
+    { ":method",                     "GET"           },
+    { ":method",                     "POST"          },
+    { ":path",                       "/"             },
+    { ":path",                       "/index.html"   },
+    { ":scheme",                     "http"          },
+    { ":scheme",                     "https"         },
+    { ":status",                     "200"           },
+    { ":status",                     "204"           },
+    { ":status",                     "206"           },
+    { ":status",                     "304"           },
+    { ":status",                     "400"           },
+    { ":status",                     "404"           },
+    { ":status",                     "500"           },
+    { "accept-charset",              ""              },
+    { "accept-encoding",             "gzip, deflate" },
+    { "accept-language",             ""              },
+    { "accept-ranges",               ""              },
+    { "accept",                      ""              },
+    { "access-control-allow-origin", ""              },
+    { "age",                         ""              },
+    { "allow",                       ""              },
+    { "authorization",               ""              },
+    { "cache-control",               ""              },
+    { "content-disposition",         ""              },
+    { "content-encoding",            ""              },
+    { "content-language",            ""              },
+    { "content-length",              ""              },
+    { "content-location",            ""              },
+    { "content-range",               ""              },
+    { "content-type",                ""              },
+    { "cookie",                      ""              },
+    { "date",                        ""              },
+    { "etag",                        ""              },
+    { "expect",                      ""              },
+    { "expires",                     ""              },
+    { "from",                        ""              },
+    { "host",                        ""              },
+    { "if-match",                    ""              },
+    { "if-modified-since",           ""              },
+    { "if-none-match",               ""              },
+    { "if-range",                    ""              },
+    { "if-unmodified-since",         ""              },
+    { "last-modified",               ""              },
+    { "link",                        ""              },
+    { "location",                    ""              },
+    { "max-forwards",                ""              },
+    { "proxy-authenticate",          ""              },
+    { "proxy-authorization",         ""              },
+    { "range",                       ""              },
+    { "referer",                     ""              },
+    { "refresh",                     ""              },
+    { "retry-after",                 ""              },
+    { "server",                      ""              },
+    { "set-cookie",                  ""              },
+    { "strict-transport-security",   ""              },
+    { "transfer-encoding",           ""              },
+    { "user-agent",                  ""              },
+    { "vary",                        ""              },
+    { "via",                         ""              },
+    { "www-authenticate",            ""              },
+};
+
+/* Code lengths of the canonical Huffman code of RFC 7541 Appendix B,
+ * indexed by symbol, the last one being EOS. */
+static const uint8_t huffman_lens[HUFFMAN_EOS + 1] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+     6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+     5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+    13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+     7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+    15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+     6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+static uint32_t huffman_first[HUFFMAN_MAX_BITS + 1];
+static uint16_t huffman_count[HUFFMAN_MAX_BITS + 1];
+static uint16_t huffman_offset[HUFFMAN_MAX_BITS + 1];
+static uint16_t huffman_syms[HUFFMAN_EOS + 1];
+static AVOnce huffman_init_once = AV_ONCE_INIT;
+
+static void huffman_init(void)
+{
+    uint32_t code = 0;
+    int n = 0;
+
+    for (int len = 1; len <= HUFFMAN_MAX_BITS; len++) {
+        huffman_first[len]  = code;
+        huffman_offset[len] = n;
+        for (int sym = 0; sym <= HUFFMAN_EOS; sym++)
+            if (huffman_lens[sym] == len)
+                huffman_syms[n++] = sym;
+        huffman_count[len] = n - huffman_offset[len];
+        code = (code + huffman_count[len]) << 1;
+    }
+}
+
+static int huffman_decode(const uint8_t *src, int len, char **out)
+{
+    /* the shortest code has 5 bits */
+    char *dst = av_malloc(len * 8 / 5 + 1), *d = dst;
+    uint32_t code = 0;
+    int bits = 0;
+
+    if (!dst)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < len; i++) {
+        for (int b = 7; b >= 0; b--) {
+            uint32_t idx;
+
+            code = code << 1 | (src[i] >> b & 1);
+            bits++;
+            idx  = code - huffman_first[bits];
+            if (code >= huffman_first[bits] && idx < huffman_count[bits]) {
+                int sym = huffman_syms[huffman_offset[bits] + idx];
+                if (sym == HUFFMAN_EOS)
+                    goto fail;
+                *d++ = sym;
+                code = bits = 0;
+            } else if (bits == HUFFMAN_MAX_BITS) {
+                goto fail;
+            }
+        }
+    }
+    /* padding must be a prefix of EOS, i.e. all ones, and shorter than a byte */
+    if (bits > 7 || code != (1U << bits) - 1)
+        goto fail;
+
+    *d   = 0;
+    *out = dst;
+    return 0;
+fail:
+    av_free(dst);
+    return AVERROR_INVALIDDATA;
+}
+
+static int decode_int(const uint8_t **p, const uint8_t *end, int prefix,
+                      uint32_t *val)
+{
+    uint32_t mask = (1U << prefix) - 1, v;
+    int shift = 0, b;
+
+    if (*p >= end)
+        return AVERROR_INVALIDDATA;
+    v = *(*p)++ & mask;
+    if (v == mask) {
+        do {
+            if (*p >= end || shift > 21)
+                return AVERROR_INVALIDDATA;
+            b = *(*p)++;
+            v += (uint32_t)(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+    }
+    *val = v;
+    return 0;
+}
+
+static int decode_string(const uint8_t **p, const uint8_t *end, char **out)
+{
+    int huffman = *p < end && **p & 0x80;
+    uint32_t len;
+    int ret;
+
+    if ((ret = decode_int(p, end, 7, &len)) < 0)
+        return ret;
+    if (len > end - *p)
+        return AVERROR_INVALIDDATA;
+
+    if (huffman) {
+        ff_thread_once(&huffman_init_once, huffman_init);
+        ret = huffman_decode(*p, len, out);
+    } else {
+        *out = av_malloc(len + 1);
+        if (*out) {
+            memcpy(*out, *p, len);
+            (*out)[len] = 0;
+        }
+        ret = *out ? 0 : AVERROR(ENOMEM);
+    }
+    *p += len;
+    return ret;
+}
+
+static void evict(HPACKDecoder *d, int size)
+{
+    int n = 0;
+
+    while (n < d->nb_fields && d->size + size > d->max_size) {
+        d->size -= strlen(d->fields[n].name) + strlen(d->fields[n].value) + FIELD_OVERHEAD;
+        av_freep(&d->fields[n].name);
+        av_freep(&d->fields[n].value);
+        n++;
+    }
+    d->nb_fields -= n;
+    memmove(d->fields, d->fields + n, d->nb_fields * sizeof(*d->fields));
+}
+
+static int add_field(HPACKDecoder *d, const char *name, const char *value)
+{
+    int size = strlen(name) + strlen(value) + FIELD_OVERHEAD;
+    /* copy first, the name may refer to a field about to be evicted */
+    char *name_copy  = av_strdup(name);
+    char *value_copy = av_strdup(value);
+    HPACKField *f;
+
+    if (!name_copy || !value_copy)
+        goto fail;
+
+    evict(d, size);
+    /* a field larger than the table just empties it */
+    if (size > d->max_size) {
+        av_free(name_copy);
+        av_free(value_copy);
+        return 0;
+    }
+
+    f = av_fast_realloc(d->fields, &d->fields_allocated,
+                        (d->nb_fields + 1) * sizeof(*d->fields));
+    if (!f)
+        goto fail;
+    d->fields = f;
+    d->fields[d->nb_fields].name  = name_copy;
+    d->fields[d->nb_fields].value = value_copy;
+    d->nb_fields++;
+    d->size += size;
+    return 0;
+fail:
+    av_free(name_copy);
+    av_free(value_copy);
+    return AVERROR(ENOMEM);
+}
+
+static int get_field(HPACKDecoder *d, uint32_t idx,
+                     const char **name, const char **value)
+{
+    if (!idx)
+        return AVERROR_INVALIDDATA;
+    if (idx <= STATIC_TABLE_SIZE) {
+        *name  = static_table[idx - 1][0];
+        *value = static_table[idx - 1][1];
+        return 0;
+    }
+    idx -= STATIC_TABLE_SIZE + 1;
+    if (idx >= d->nb_fields)
+        return AVERROR_INVALIDDATA;
+    *name  = d->fields[d->nb_fields - 1 - idx].name;
+    *value = d->fields[d->nb_fields - 1 - idx].value;
+    return 0;
+}
+
+void ff_hpack_decoder_init(HPACKDecoder *d, int max_size_limit)
+{
+    memset(d, 0, sizeof(*d));
+    d->max_size       = max_size_limit;
+    d->max_size_limit = max_size_limit;
+}
+
+void ff_hpack_decoder_uninit(HPACKDecoder *d)
+{
+    d->max_size = 0;
+    evict(d, 0);
+    av_freep(&d->fields);
+    d->fields_allocated = 0;
+}
+
+int ff_hpack_decode(HPACKDecoder *d, const uint8_t *buf, int size,
+                    int (*cb)(void *opaque, const char *name, const char *value),
+                    void *opaque)
+{
+    const uint8_t *p = buf, *end = buf + size;
+    int ret = 0;
+
+    while (p < end && ret >= 0) {
+        const char *name, *value;
+        char *lit_name = NULL, *lit_value = NULL;
+        int first = *p, indexing = 0;
+        uint32_t idx;
+
+        if (first & 0x80) {
+            /* indexed field */
+            if ((ret = decode_int(&p, end, 7, &idx)) < 0 ||
+                (ret = get_field(d, idx, &name, &value)) < 0)
+                break;
+            ret = cb(opaque, name, value);
+            continue;
+        } else if ((first & 0xe0) == 0x20) {
+            /* dynamic table size update */
+            if ((ret = decode_int(&p, end, 5, &idx)) < 0)
+                break;
+            if (idx > d->max_size_limit) {
+                ret = AVERROR_INVALIDDATA;
+                break;
+            }
+            d->max_size = idx;
+            evict(d, 0);
+            continue;
+        }
+
+        /* literal field, with incremental indexing, without indexing
+         * or never indexed */
+        indexing = (first & 0xc0) == 0x40;
+        if ((ret = decode_int(&p, end, indexing ? 6 : 4, &idx)) < 0)
+            break;
+        if (idx) {
+            if ((ret = get_field(d, idx, &name, &value)) < 0)
+                break;
+        } else {
+            if ((ret = decode_string(&p, end, &lit_name)) < 0)
+                break;
+            name = lit_name;
+        }
+        if ((ret = decode_string(&p, end, &lit_value)) >= 0) {
+            ret = cb(opaque, name, lit_value);
+            if (ret >= 0 && indexing)
+                ret = add_field(d, name, lit_value);
+        }
+        av_free(lit_name);
+        av_free(lit_value);
+    }
+    return ret;
+}
+
+static void encode_int(AVBPrint *bp, int first, int prefix, uint32_t val)
+{
+    uint32_t mask = (1U << prefix) - 1;
+
+    if (val < mask) {
+        av_bprint_chars(bp, first | val, 1);
+        return;
+    }
+    av_bprint_chars(bp, first | mask, 1);
+    for (val -= mask; val >= 0x80; val >>= 7)
+        av_bprint_chars(bp, 0x80 | (val & 0x7f), 1);
+    av_bprint_chars(bp, val, 1);
+}
+
+static void encode_string(AVBPrint *bp, const char *str)
+{
+    int len = strlen(str);
+
+    encode_int(bp, 0, 7, len);
+    av_bprint_append_data(bp, str, len);
+}
+
+void ff_hpack_encode_field(AVBPrint *bp, const char *name, const char *value)
+{
+    encode_int(bp, 0x00, 4, 0);
+    encode_string(bp, name);
+    encode_string(bp, value);
+}
@@ -0,0 +1,67 @@
+/*
+ * HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HPACK_H
+#define AVFORMAT_HPACK_H
+
+#include <stdint.h>
+
+#include "libavutil/bprint.h"
+
+typedef struct HPACKField {
+    char *name;
+    char *value;
+} HPACKField;
+
+/**
+ * Decoder state of one connection direction; header blocks must be
+ * decoded in the order they were received.
+ */
+typedef struct HPACKDecoder {
+    HPACKField *fields;     ///< dynamic table, oldest field first
+    int nb_fields;
+    unsigned fields_allocated;
+    int size;               ///< size of the dynamic table as defined by RFC 7541
+    int max_size;           ///< current limit, set by the encoder
+    int max_size_limit;     ///< limit announced with SETTINGS_HEADER_TABLE_SIZE
+} HPACKDecoder;
+
+void ff_hpack_decoder_init(HPACKDecoder *d, int max_size_limit);
+
+void ff_hpack_decoder_uninit(HPACKDecoder *d);
+
+/**
+ * Decode a complete header block.
+ *
+ * @param cb called for each decoded field with nul-terminated strings,
+ *           decoding stops if it returns a negative value
+ * @return 0 on success, a negative AVERROR code on error; decoding errors
+ *         leave the decoder in an unusable state
+ */
+int ff_hpack_decode(HPACKDecoder *d, const uint8_t *buf, int size,
+                    int (*cb)(void *opaque, const char *name, const char *value),
+                    void *opaque);
+
+/**
+ * Append a literal field which is never added to the peer's dynamic table.
+ */
+void ff_hpack_encode_field(AVBPrint *bp, const char *name, const char *value);
+
+#endif /* AVFORMAT_HPACK_H */
@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
+
 #if CONFIG_ZLIB
 #include <zlib.h>
 #endif /* CONFIG_ZLIB */
@@ -29,6 +31,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/bprint.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 
@@ -59,6 +62,8 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+typedef struct HTTPParallel HTTPParallel;
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
@@ -127,6 +132,11 @@ typedef struct HTTPContext {
     int is_multi_client;
     HandshakeState handshake_step;
     int is_connected_server;
+    int parallel;
+    int parallel_chunk_size;
+    HTTPParallel *par;
+    int http2;
+    int is_http2;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -169,6 +179,9 @@ static const AVOption options[] = {
     { "listen", "listen on HTTP", OFFSET(listen), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 2, D | E },
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
+    { "parallel", "number of connections fetching ranges ahead of the read position", OFFSET(parallel), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
+    { "parallel_chunk_size", "size of the ranges fetched by each parallel connection", OFFSET(parallel_chunk_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, 64 << 10, 256 << 20, D },
+    { "http2", "use HTTP/2 if the server supports it, sharing connections between requests", OFFSET(http2), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
     { NULL }
 };
 
@@ -195,7 +208,7 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char hostname[1024], hoststr[1024], proto[10];
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE];
-    char buf[1024], urlbuf[MAX_URL_SIZE];
+    char buf[1024], urlbuf[MAX_URL_SIZE], http2buf[1030];
     int port, use_proxy, err, location_changed = 0;
     HTTPContext *s = h->priv_data;
 
@@ -243,11 +256,29 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
-        if (err < 0)
-            return err;
+        err = AVERROR(ENOPROTOOPT);
+        /* cleartext HTTP/2 would need an upgrade round trip, only use it
+         * when negotiated during the TLS handshake */
+        if (s->http2 && !strcmp(lower_proto, "tls") && !s->listen) {
+            snprintf(http2buf, sizeof(http2buf), "http2:%s", buf);
+            err = ffurl_open_whitelist(&s->hd, http2buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
+            /* not supported by the server or not available in this build */
+            if (err == AVERROR(ENOPROTOOPT) || err == AVERROR(EINVAL) ||
+                err == AVERROR_PROTOCOL_NOT_FOUND)
+                av_log(h, AV_LOG_VERBOSE, "Using HTTP/1.1 for %s\n", hoststr);
+            else if (err < 0)
+                return err;
+        }
+        s->is_http2 = err >= 0;
+        if (!s->is_http2) {
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
+            if (err < 0)
+                return err;
+        }
     }
 
     err = http_connect(h, path, local_path, hoststr,
@@ -552,6 +583,373 @@ fail:
     return ret;
 }
 
+#if HAVE_THREADS
+/* Parallel range reading: a pool of connections fetches fixed-size ranges
+ * of the resource ahead of the read position into memory, and http_read()
+ * returns them in order. Chunks behind the read position or beyond the
+ * window are dropped, so seeking inside the window costs nothing. */
+
+enum HTTPChunkState {
+    CHUNK_FREE,
+    CHUNK_FETCHING,
+    CHUNK_CANCELLED,    ///< still being fetched, but no longer wanted
+    CHUNK_DONE,
+};
+
+typedef struct HTTPChunk {
+    enum HTTPChunkState state;
+    int64_t start;
+    int size;
+    int filled;
+    int error;
+    uint8_t *data;
+} HTTPChunk;
+
+struct HTTPParallel {
+    URLContext *h;
+    AVIOInterruptCB interrupt_callback;
+    pthread_t *threads;
+    int nb_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    HTTPChunk *chunks;
+    int nb_chunks;
+    int window;         ///< number of chunks to keep ahead of the read position
+    int chunk_size;
+    int64_t pos;
+    int64_t size;
+    atomic_int abort;
+};
+
+static int parallel_interrupt(void *opaque)
+{
+    HTTPParallel *p = opaque;
+    return atomic_load(&p->abort) || ff_check_interrupt(&p->h->interrupt_callback);
+}
+
+static HTTPChunk *parallel_find_chunk(HTTPParallel *p, int64_t pos)
+{
+    for (int i = 0; i < p->nb_chunks; i++) {
+        HTTPChunk *c = &p->chunks[i];
+        if ((c->state == CHUNK_FETCHING || c->state == CHUNK_DONE) &&
+            pos >= c->start && pos < c->start + c->size)
+            return c;
+    }
+    return NULL;
+}
+
+static void parallel_release(HTTPChunk *c)
+{
+    if (c->state == CHUNK_FETCHING)
+        c->state = CHUNK_CANCELLED;
+    else if (c->state == CHUNK_DONE)
+        c->state = CHUNK_FREE;
+}
+
+/* Must be called with the lock held after the read position changed. */
+static void parallel_update_window(HTTPParallel *p, int drop_errors)
+{
+    int64_t start = p->pos - p->pos % p->chunk_size;
+    int64_t end   = start + (int64_t)p->window * p->chunk_size;
+
+    for (int i = 0; i < p->nb_chunks; i++) {
+        HTTPChunk *c = &p->chunks[i];
+        if (c->start + c->size <= p->pos || c->start >= end ||
+            (drop_errors && c->error))
+            parallel_release(c);
+    }
+    pthread_cond_broadcast(&p->cond);
+}
+
+/* Pick the first range of the window nobody fetches yet, lock held. */
+static HTTPChunk *parallel_next_chunk(HTTPParallel *p)
+{
+    int64_t start = p->pos - p->pos % p->chunk_size;
+    int64_t end   = FFMIN(start + (int64_t)p->window * p->chunk_size, p->size);
+    HTTPChunk *c = NULL;
+
+    /* the last range may have been released already */
+    if (p->pos >= p->size)
+        return NULL;
+    for (int i = 0; i < p->nb_chunks && !c; i++)
+        if (p->chunks[i].state == CHUNK_FREE)
+            c = &p->chunks[i];
+    if (!c)
+        return NULL;
+
+    for (; start < end; start += p->chunk_size) {
+        if (!parallel_find_chunk(p, start)) {
+            c->state  = CHUNK_FETCHING;
+            c->start  = start;
+            c->size   = FFMIN(p->chunk_size, p->size - start);
+            c->filled = 0;
+            c->error  = 0;
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static int parallel_open_range(HTTPParallel *p, URLContext **puc,
+                               int64_t start, int64_t end)
+{
+    URLContext *h = p->h;
+    HTTPContext *s = h->priv_data, *cs;
+    AVDictionary *options = NULL;
+    int ret;
+
+    ret = ffurl_alloc(puc, h->filename, AVIO_FLAG_READ, &p->interrupt_callback);
+    if (ret < 0)
+        return ret;
+    cs = (*puc)->priv_data;
+    if ((ret = av_opt_copy(*puc, h)) < 0 ||
+        (ret = av_opt_copy(cs, s)) < 0)
+        goto fail;
+    ff_http_init_auth_state(*puc, h);
+    av_freep(&cs->location);
+    cs->off      = start;
+    cs->end_off  = end;
+    cs->seekable = 1;
+    cs->icy      = 0;
+    cs->parallel = 0;
+
+    if ((ret = av_dict_copy(&options, s->chained_options, 0)) < 0)
+        goto fail;
+    ret = ffurl_connect(*puc, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        goto fail;
+    /* a server ignoring the range would send the data from the start */
+    if (cs->off != start) {
+        ret = AVERROR(EIO);
+        goto fail;
+    }
+    return 0;
+fail:
+    ffurl_closep(puc);
+    return ret;
+}
+
+static int parallel_fetch(HTTPParallel *p, HTTPChunk *c)
+{
+    URLContext *uc = NULL;
+    int ret = 0;
+
+    if (!c->data && !(c->data = av_malloc(p->chunk_size)))
+        return AVERROR(ENOMEM);
+    if ((ret = parallel_open_range(p, &uc, c->start, c->start + c->size)) < 0)
+        return ret;
+
+    while (ret >= 0) {
+        int left;
+
+        pthread_mutex_lock(&p->lock);
+        left = c->state == CHUNK_FETCHING ? c->size - c->filled : 0;
+        pthread_mutex_unlock(&p->lock);
+        if (!left)
+            break;
+
+        ret = ffurl_read(uc, c->data + c->filled, left);
+        if (!ret || ret == AVERROR_EOF)
+            ret = AVERROR(EIO);
+        if (ret > 0) {
+            pthread_mutex_lock(&p->lock);
+            c->filled += ret;
+            pthread_cond_broadcast(&p->cond);
+            pthread_mutex_unlock(&p->lock);
+        }
+    }
+    ffurl_closep(&uc);
+    return FFMIN(ret, 0);
+}
+
+static void *parallel_worker(void *arg)
+{
+    HTTPParallel *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (!atomic_load(&p->abort)) {
+        HTTPChunk *c = parallel_next_chunk(p);
+        int ret;
+
+        if (!c) {
+            pthread_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&p->lock);
+        ret = parallel_fetch(p, c);
+        pthread_mutex_lock(&p->lock);
+
+        if (c->state == CHUNK_CANCELLED) {
+            c->state = CHUNK_FREE;
+        } else {
+            if (ret < 0 && ret != AVERROR_EXIT)
+                av_log(p->h, AV_LOG_ERROR, "Fetching bytes %"PRId64"-%"PRId64" failed: %s\n",
+                       c->start, c->start + c->size - 1, av_err2str(ret));
+            c->state = CHUNK_DONE;
+            c->error = ret;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void parallel_free(HTTPParallel **pp)
+{
+    HTTPParallel *p = *pp;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    atomic_store(&p->abort, 1);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->nb_threads; i++)
+        pthread_join(p->threads[i], NULL);
+
+    for (int i = 0; i < p->nb_chunks; i++)
+        av_freep(&p->chunks[i].data);
+    av_freep(&p->chunks);
+    av_freep(&p->threads);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    av_freep(pp);
+}
+
+static int parallel_init(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p;
+    int ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->h          = h;
+    p->chunk_size = s->parallel_chunk_size;
+    p->window     = 2 * s->parallel;
+    /* cancelled chunks keep their slot until their worker notices */
+    p->nb_chunks  = p->window + s->parallel;
+    p->pos        = s->off;
+    p->size       = s->filesize;
+    p->interrupt_callback.callback = parallel_interrupt;
+    p->interrupt_callback.opaque   = p;
+    atomic_init(&p->abort, 0);
+
+    p->chunks  = av_calloc(p->nb_chunks, sizeof(*p->chunks));
+    p->threads = av_calloc(s->parallel, sizeof(*p->threads));
+    if (!p->chunks || !p->threads) {
+        av_freep(&p->chunks);
+        av_freep(&p->threads);
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+
+    for (; p->nb_threads < s->parallel; p->nb_threads++) {
+        ret = pthread_create(&p->threads[p->nb_threads], NULL, parallel_worker, p);
+        if (ret) {
+            parallel_free(&p);
+            return AVERROR(ret);
+        }
+    }
+
+    /* all data now comes from the workers */
+    ffurl_closep(&s->hd);
+    s->buf_ptr = s->buf_end = s->buffer;
+    s->par = p;
+    return 0;
+}
+
+static int parallel_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p = s->par;
+    int ret;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        HTTPChunk *c = parallel_find_chunk(p, p->pos);
+        int avail = c ? c->filled - (int)(p->pos - c->start) : 0;
+
+        if (p->pos >= p->size) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        if (avail > 0) {
+            ret = FFMIN(size, avail);
+            /* only the reader releases chunks, so the data stays valid */
+            pthread_mutex_unlock(&p->lock);
+            memcpy(buf, c->data + (p->pos - c->start), ret);
+            pthread_mutex_lock(&p->lock);
+            p->pos += ret;
+            s->off  = p->pos;
+            if (p->pos >= c->start + c->size)
+                parallel_update_window(p, 0);
+            break;
+        }
+        if (c && c->state == CHUNK_DONE && c->error) {
+            ret = c->error;
+            break;
+        }
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_wait(&p->cond, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return ret;
+}
+
+static int64_t parallel_seek(URLContext *h, int64_t off, int whence)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPParallel *p = s->par;
+
+    if (whence == AVSEEK_SIZE)
+        return p->size;
+    else if (whence == SEEK_CUR)
+        off += p->pos;
+    else if (whence == SEEK_END)
+        off += p->size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (off < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&p->lock);
+    p->pos = off;
+    s->off = off;
+    /* a seek is the only way to retry a failed range */
+    parallel_update_window(p, 1);
+    pthread_mutex_unlock(&p->lock);
+    return off;
+}
+#else
+static int parallel_init(URLContext *h)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void parallel_free(HTTPParallel **pp)
+{
+}
+
+static int parallel_read(URLContext *h, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+static int64_t parallel_seek(URLContext *h, int64_t off, int whence)
+{
+    return AVERROR(ENOSYS);
+}
+#endif /* HAVE_THREADS */
+
 static int http_open(URLContext *h, const char *uri, int flags,
                      AVDictionary **options)
 {
@@ -588,8 +986,23 @@ static int http_open(URLContext *h, const char *uri, int flags,
         return http_listen(h, uri, flags, options);
     }
     ret = http_open_cnx(h, options);
-    if (ret < 0)
+    if (ret < 0) {
         av_dict_free(&s->chained_options);
+        return ret;
+    }
+
+    if (s->parallel > 1 && !(flags & AVIO_FLAG_WRITE) && !h->is_streamed &&
+        s->filesize != UINT64_MAX && s->chunksize == UINT64_MAX &&
+        !s->icy_metaint && !s->end_off && !s->post_data
+#if CONFIG_ZLIB
+        && !s->compressed
+#endif
+       ) {
+        int err = parallel_init(h);
+        if (err < 0)
+            av_log(h, AV_LOG_WARNING, "Could not start parallel reading: %s\n",
+                   av_err2str(err));
+    }
     return ret;
 }
 
@@ -1237,6 +1650,9 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         post            = 1;
         s->chunked_post = 0;
     }
+    /* HTTP/2 has its own framing, the end of the body ends the stream */
+    if (s->is_http2)
+        s->chunked_post = 0;
 
     if (s->method)
         method = s->method;
@@ -1248,7 +1664,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     proxyauthstr = ff_http_auth_create_response(&s->proxy_auth_state, proxyauth,
                                                 local_path, method);
 
-     if (post && !s->post_data) {
+     if (post && !s->post_data && !s->is_http2) {
         if (s->send_expect_100 != -1) {
             send_expect_100 = s->send_expect_100;
         } else {
@@ -1626,6 +2042,9 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+    if (s->par)
+        return parallel_read(h, buf, size);
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1643,7 +2062,6 @@ static int http_write(URLContext *h, const uint8_t *buf, int size)
 {
     char temp[11] = "";  /* 32-bit hex + CRLF + nul */
     int ret;
-    char crlf[] = "\r\n";
     HTTPContext *s = h->priv_data;
 
     if (!s->chunked_post) {
@@ -1654,12 +2072,49 @@ static int http_write(URLContext *h, const uint8_t *buf, int size)
     /* silently ignore zero-size data since chunk encoding that would
      * signal EOF */
     if (size > 0) {
+        URLIOVec iov[3] = {
+            { temp, 0 }, { buf, size }, { "\r\n", 2 }
+        };
         /* upload data using chunked encoding */
-        snprintf(temp, sizeof(temp), "%x\r\n", size);
+        iov[0].size = snprintf(temp, sizeof(temp), "%x\r\n", size);
 
-        if ((ret = ffurl_write(s->hd, temp, strlen(temp))) < 0 ||
-            (ret = ffurl_write(s->hd, buf, size)) < 0          ||
-            (ret = ffurl_write(s->hd, crlf, sizeof(crlf) - 1)) < 0)
+        if ((ret = ffurl_writev(s->hd, iov, 3)) < 0)
+            return ret;
+    }
+    return size;
+}
+
+static int http_writev(URLContext *h, const URLIOVec *iov, int iovcnt)
+{
+    char temp[11] = "";  /* 32-bit hex + CRLF + nul */
+    URLIOVec vec[URL_MAX_IOV];
+    int i, ret, size = 0;
+    HTTPContext *s = h->priv_data;
+
+    if (!s->chunked_post)
+        return ffurl_writev(s->hd, iov, iovcnt);
+
+    if (iovcnt > URL_MAX_IOV - 2) {
+        /* no room for the chunk header and trailer, send several chunks */
+        for (i = 0; i < iovcnt; i++) {
+            if ((ret = http_write(h, iov[i].data, iov[i].size)) < 0)
+                return ret;
+            size += ret;
+        }
+        return size;
+    }
+
+    /* send all buffers as one chunk */
+    for (i = 0; i < iovcnt; i++)
+        size += iov[i].size;
+    if (size > 0) {
+        vec[0].data = temp;
+        vec[0].size = snprintf(temp, sizeof(temp), "%x\r\n", size);
+        memcpy(vec + 1, iov, iovcnt * sizeof(*vec));
+        vec[iovcnt + 1].data = "\r\n";
+        vec[iovcnt + 1].size = 2;
+
+        if ((ret = ffurl_writev(s->hd, vec, iovcnt + 2)) < 0)
             return ret;
     }
     return size;
@@ -1689,6 +2144,9 @@ static int http_shutdown(URLContext *h, int flags)
             }
         }
         s->end_chunked_post = 1;
+    } else if ((flags & AVIO_FLAG_WRITE) && s->is_http2) {
+        ret = ffurl_shutdown(s->hd, AVIO_FLAG_WRITE);
+        s->end_chunked_post = 1;
     }
 
     return ret;
@@ -1704,6 +2162,8 @@ static int http_close(URLContext *h)
     av_freep(&s->inflate_buffer);
 #endif /* CONFIG_ZLIB */
 
+    parallel_free(&s->par);
+
     if (s->hd && !s->end_chunked_post)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
@@ -1774,6 +2234,10 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 
 static int64_t http_seek(URLContext *h, int64_t off, int whence)
 {
+    HTTPContext *s = h->priv_data;
+
+    if (s->par)
+        return parallel_seek(h, off, whence);
     return http_seek_internal(h, off, whence, 0);
 }
 
@@ -1807,6 +2271,7 @@ const URLProtocol ff_http_protocol = {
     .url_handshake       = http_handshake,
     .url_read            = http_read,
     .url_write           = http_write,
+    .url_writev          = http_writev,
     .url_seek            = http_seek,
     .url_close           = http_close,
     .url_get_file_handle = http_get_file_handle,
@@ -1815,7 +2280,7 @@ const URLProtocol ff_http_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &http_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy,data"
+    .default_whitelist   = "http,https,http2,tls,rtp,tcp,udp,crypto,httpproxy,data"
 };
 #endif /* CONFIG_HTTP_PROTOCOL */
 
@@ -1827,6 +2292,7 @@ const URLProtocol ff_https_protocol = {
     .url_open2           = http_open,
     .url_read            = http_read,
     .url_write           = http_write,
+    .url_writev          = http_writev,
     .url_seek            = http_seek,
     .url_close           = http_close,
     .url_get_file_handle = http_get_file_handle,
@@ -1835,7 +2301,7 @@ const URLProtocol ff_https_protocol = {
     .priv_data_size      = sizeof(HTTPContext),
     .priv_data_class     = &https_context_class,
     .flags               = URL_PROTOCOL_FLAG_NETWORK,
-    .default_whitelist   = "http,https,tls,rtp,tcp,udp,crypto,httpproxy"
+    .default_whitelist   = "http,https,http2,tls,rtp,tcp,udp,crypto,httpproxy"
 };
 #endif /* CONFIG_HTTPS_PROTOCOL */
 
@@ -0,0 +1,1177 @@
+/*
+ * HTTP/2 client streams multiplexed over shared connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * HTTP/2 transport for the http protocol (RFC 7540).
+ *
+ * A context opened as "http2:tls://host:port" (or tcp://) carries one
+ * request at a time. It takes the HTTP/1.1 request written by http.c,
+ * sends it as a HEADERS frame on a new stream, and returns the response as
+ * an HTTP/1.1 header followed by the body, so http.c needs to know next to
+ * nothing about HTTP/2.
+ *
+ * All contexts to the same lower URL share one connection from a process
+ * wide pool. A thread per connection reads and dispatches the frames; since
+ * TLS sessions must not be used concurrently, it only reads when data is
+ * available and every access to the lower context is serialized.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/fifo.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "avformat.h"
+#include "hpack.h"
+#include "internal.h"
+#include "network.h"
+#include "url.h"
+
+#define FRAME_DATA          0x0
+#define FRAME_HEADERS       0x1
+#define FRAME_RST_STREAM    0x3
+#define FRAME_SETTINGS      0x4
+#define FRAME_PUSH_PROMISE  0x5
+#define FRAME_PING          0x6
+#define FRAME_GOAWAY        0x7
+#define FRAME_WINDOW_UPDATE 0x8
+#define FRAME_CONTINUATION  0x9
+
+#define FLAG_END_STREAM     0x01
+#define FLAG_ACK            0x01
+#define FLAG_END_HEADERS    0x04
+#define FLAG_PADDED         0x08
+#define FLAG_PRIORITY       0x20
+
+#define SETTINGS_ENABLE_PUSH            0x2
+#define SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define SETTINGS_INITIAL_WINDOW_SIZE    0x4
+#define SETTINGS_MAX_FRAME_SIZE         0x5
+
+#define ERROR_NO_ERROR       0x0
+#define ERROR_PROTOCOL       0x1
+#define ERROR_FLOW_CONTROL   0x3
+#define ERROR_FRAME_SIZE     0x6
+#define ERROR_CANCEL         0x8
+#define ERROR_COMPRESSION    0x9
+
+#define FRAME_HEADER_SIZE   9
+#define DEFAULT_FRAME_SIZE  16384
+#define DEFAULT_WINDOW      65535
+#define HEADER_TABLE_SIZE   4096
+#define STREAM_WINDOW       (1 << 21)
+#define CONN_WINDOW         (1 << 24)
+#define MAX_HEADER_BLOCK    (1 << 20)
+#define MAX_STREAM_ID       0x7fffffff
+#define WAIT_INTERVAL       100000
+
+static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+typedef struct HTTP2Stream {
+    struct HTTP2Stream *next;
+    uint32_t id;
+    int detached;           ///< the owner moved on, drop the response
+    int local_closed;       ///< END_STREAM sent
+    int remote_closed;      ///< END_STREAM or RST_STREAM received
+    int error;
+    int headers_done;       ///< the final response header was received
+    AVBPrint head;          ///< response header in HTTP/1.1 syntax
+    AVFifoBuffer *fifo;
+    int64_t send_window;
+    int recv_unacked;       ///< bytes not yet returned to the peer's window
+} HTTP2Stream;
+
+typedef struct HTTP2Connection {
+    struct HTTP2Connection *next;
+    char *key;
+    int refcount;           ///< protected by pool_lock
+    int opening;            ///< protected by lock
+
+    URLContext *hd;
+    AVIOInterruptCB *open_cb;
+    atomic_int abort;
+    pthread_t thread;
+    int thread_started;
+
+    pthread_mutex_t io_lock;    ///< serializes access to hd, taken before lock
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    /* protected by lock */
+    int error;
+    int goaway;
+    uint32_t next_stream_id;
+    int nb_streams;
+    int max_streams;
+    int64_t send_window;
+    int peer_initial_window;
+    int peer_max_frame;
+    HTTP2Stream *streams;
+
+    /* only used by the connection thread */
+    HPACKDecoder hpack;
+    uint8_t rbuf[FRAME_HEADER_SIZE + DEFAULT_FRAME_SIZE];
+    int rbuf_len;
+    uint8_t *hblock;
+    int hblock_size;
+    unsigned hblock_allocated;
+    uint32_t hblock_stream;
+    int hblock_flags;
+    int recv_unacked;
+} HTTP2Connection;
+
+typedef struct HTTP2Context {
+    const AVClass *class;
+    HTTP2Connection *conn;
+    HTTP2Stream *stream;
+    char *url;
+    AVDictionary *options;
+    int https;
+    AVBPrint request;       ///< request header not yet complete
+    int64_t body_left;      ///< request body still to send, -1 if unknown
+    int head_pos;
+} HTTP2Context;
+
+static AVMutex pool_lock = AV_MUTEX_INITIALIZER;
+static HTTP2Connection *pool;
+/* recent servers which did not select HTTP/2, protected by pool_lock */
+static char no_h2[16][256];
+static int no_h2_pos;
+
+static void put_frame_header(uint8_t *p, int len, int type, int flags, uint32_t id)
+{
+    AV_WB24(p, len);
+    p[3] = type;
+    p[4] = flags;
+    AV_WB32(p + 5, id);
+}
+
+/* Frames sent in reply to a received one, written once the lock is released. */
+typedef struct Replies {
+    uint8_t buf[64];
+    int size;
+} Replies;
+
+static void add_reply(Replies *r, int type, int flags, uint32_t id,
+                      const uint8_t *payload, int len)
+{
+    if (r->size + FRAME_HEADER_SIZE + len > sizeof(r->buf))
+        return;
+    put_frame_header(r->buf + r->size, len, type, flags, id);
+    memcpy(r->buf + r->size + FRAME_HEADER_SIZE, payload, len);
+    r->size += FRAME_HEADER_SIZE + len;
+}
+
+static void add_reply_u32(Replies *r, int type, uint32_t id, uint32_t val)
+{
+    uint8_t payload[4];
+    AV_WB32(payload, val);
+    add_reply(r, type, 0, id, payload, 4);
+}
+
+static void add_goaway(Replies *r, uint32_t code)
+{
+    uint8_t payload[8] = { 0 };
+    AV_WB32(payload + 4, code);
+    add_reply(r, FRAME_GOAWAY, 0, 0, payload, 8);
+}
+
+static void conn_fail(HTTP2Connection *c, int err)
+{
+    pthread_mutex_lock(&c->lock);
+    if (!c->error)
+        c->error = err;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static int conn_write(HTTP2Connection *c, const uint8_t *hdr,
+                      const uint8_t *payload, int len)
+{
+    URLIOVec iov[2] = { { hdr, FRAME_HEADER_SIZE }, { payload, len } };
+    int ret;
+
+    pthread_mutex_lock(&c->io_lock);
+    ret = ffurl_writev(c->hd, iov, len ? 2 : 1);
+    pthread_mutex_unlock(&c->io_lock);
+    if (ret < 0)
+        conn_fail(c, ret);
+    return FFMIN(ret, 0);
+}
+
+static int conn_write_raw(HTTP2Connection *c, const uint8_t *buf, int size)
+{
+    int ret;
+
+    if (!size)
+        return 0;
+    pthread_mutex_lock(&c->io_lock);
+    ret = ffurl_write(c->hd, buf, size);
+    pthread_mutex_unlock(&c->io_lock);
+    if (ret < 0)
+        conn_fail(c, ret);
+    return FFMIN(ret, 0);
+}
+
+static HTTP2Stream *find_stream(HTTP2Connection *c, uint32_t id)
+{
+    HTTP2Stream *st;
+    for (st = c->streams; st && st->id != id; st = st->next)
+        ;
+    return st;
+}
+
+static void stream_free(HTTP2Connection *c, HTTP2Stream *st)
+{
+    HTTP2Stream **p;
+
+    for (p = &c->streams; *p && *p != st; p = &(*p)->next)
+        ;
+    if (*p)
+        *p = st->next;
+    if (!st->remote_closed)
+        c->nb_streams--;
+    av_fifo_freep(&st->fifo);
+    av_bprint_finalize(&st->head, NULL);
+    av_free(st);
+    pthread_cond_broadcast(&c->cond);
+}
+
+static void stream_close_remote(HTTP2Connection *c, HTTP2Stream *st, int error)
+{
+    if (st->remote_closed)
+        return;
+    st->remote_closed = 1;
+    if (!st->error)
+        st->error = error;
+    c->nb_streams--;
+    if (st->detached)
+        stream_free(c, st);
+}
+
+typedef struct HeaderParser {
+    AVBPrint *bp;
+    int status;
+} HeaderParser;
+
+static int header_cb(void *opaque, const char *name, const char *value)
+{
+    HeaderParser *hp = opaque;
+
+    if (!hp->bp)
+        return 0;
+    if (!strcmp(name, ":status")) {
+        if (hp->status)
+            return AVERROR_INVALIDDATA;
+        hp->status = atoi(value);
+        av_bprintf(hp->bp, "HTTP/2.0 %s\r\n", value);
+    } else if (name[0] != ':' && hp->status) {
+        av_bprintf(hp->bp, "%s: %s\r\n", name, value);
+    }
+    return 0;
+}
+
+static int handle_header_block(HTTP2Connection *c, Replies *r)
+{
+    HTTP2Stream *st = find_stream(c, c->hblock_stream);
+    HeaderParser hp = { NULL };
+    AVBPrint bp;
+    int ret;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    /* the block must be decoded in any case to keep the table in sync */
+    if (st && !st->detached && !st->headers_done)
+        hp.bp = &bp;
+    ret = ff_hpack_decode(&c->hpack, c->hblock, c->hblock_size, header_cb, &hp);
+    if (ret < 0) {
+        av_bprint_finalize(&bp, NULL);
+        av_log(c->hd, AV_LOG_ERROR, "Invalid HTTP/2 header block\n");
+        add_goaway(r, ERROR_COMPRESSION);
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (hp.bp && hp.status >= 200) {
+        av_bprintf(&bp, "\r\n");
+        av_bprintf(&st->head, "%s", bp.str);
+        if (!av_bprint_is_complete(&st->head))
+            st->error = AVERROR(ENOMEM);
+        st->headers_done = 1;
+    } else if (hp.bp && !hp.status) {
+        st->error = AVERROR_INVALIDDATA;
+    }
+    av_bprint_finalize(&bp, NULL);
+
+    if (st && (c->hblock_flags & FLAG_END_STREAM)) {
+        stream_close_remote(c, st, 0);
+    } else if (st && (st->detached || st->error)) {
+        add_reply_u32(r, FRAME_RST_STREAM, st->id, ERROR_CANCEL);
+        stream_close_remote(c, st, 0);
+    }
+    c->hblock_stream = 0;
+    return 0;
+}
+
+static int append_header_block(HTTP2Connection *c, const uint8_t *buf, int size)
+{
+    uint8_t *p;
+
+    if (c->hblock_size + size > MAX_HEADER_BLOCK)
+        return AVERROR_INVALIDDATA;
+    p = av_fast_realloc(c->hblock, &c->hblock_allocated, c->hblock_size + size);
+    if (!p)
+        return AVERROR(ENOMEM);
+    c->hblock = p;
+    memcpy(c->hblock + c->hblock_size, buf, size);
+    c->hblock_size += size;
+    return 0;
+}
+
+static int strip_padding(int flags, const uint8_t **p, int *len)
+{
+    int pad;
+
+    if (!(flags & FLAG_PADDED))
+        return 0;
+    if (*len < 1 || (pad = **p) >= *len)
+        return AVERROR_INVALIDDATA;
+    *p   += 1;
+    *len -= 1 + pad;
+    return 0;
+}
+
+/* Called with the lock held. */
+static int handle_frame(HTTP2Connection *c, int type, int flags, uint32_t id,
+                        const uint8_t *p, int len, Replies *r)
+{
+    HTTP2Stream *st;
+    int size = len, ret;
+
+    if (c->hblock_stream && type != FRAME_CONTINUATION)
+        goto protocol_error;
+
+    switch (type) {
+    case FRAME_DATA:
+        if (!id || strip_padding(flags, &p, &len) < 0)
+            goto protocol_error;
+        c->recv_unacked += size;
+        if (c->recv_unacked >= CONN_WINDOW / 2) {
+            add_reply_u32(r, FRAME_WINDOW_UPDATE, 0, c->recv_unacked);
+            c->recv_unacked = 0;
+        }
+        st = find_stream(c, id);
+        if (!st || st->remote_closed)
+            break;
+        if (!st->detached) {
+            if (av_fifo_space(st->fifo) < len && av_fifo_grow(st->fifo, len) < 0)
+                return AVERROR(ENOMEM);
+            av_fifo_generic_write(st->fifo, (void *)p, len, NULL);
+            /* padding is never seen by the reader, return it right away */
+            st->recv_unacked += size - len;
+        }
+        if (flags & FLAG_END_STREAM)
+            stream_close_remote(c, st, 0);
+        break;
+    case FRAME_HEADERS:
+        if (!id || strip_padding(flags, &p, &len) < 0)
+            goto protocol_error;
+        if (flags & FLAG_PRIORITY) {
+            if (len < 5)
+                goto protocol_error;
+            p   += 5;
+            len -= 5;
+        }
+        c->hblock_stream = id;
+        c->hblock_flags  = flags;
+        c->hblock_size   = 0;
+        /* fall through */
+    case FRAME_CONTINUATION:
+        if (id != c->hblock_stream)
+            goto protocol_error;
+        if ((ret = append_header_block(c, p, len)) < 0)
+            return ret;
+        if (flags & FLAG_END_HEADERS)
+            return handle_header_block(c, r);
+        break;
+    case FRAME_RST_STREAM:
+        if (len != 4)
+            goto protocol_error;
+        if ((st = find_stream(c, id))) {
+            uint32_t code = AV_RB32(p);
+            if (code != ERROR_NO_ERROR)
+                av_log(c->hd, AV_LOG_ERROR, "HTTP/2 stream %u reset with error %u\n",
+                       id, code);
+            stream_close_remote(c, st, AVERROR(ECONNRESET));
+        }
+        break;
+    case FRAME_SETTINGS:
+        if (id || len % 6)
+            goto protocol_error;
+        if (flags & FLAG_ACK)
+            break;
+        for (; len > 0; p += 6, len -= 6) {
+            uint32_t val = AV_RB32(p + 2);
+            switch (AV_RB16(p)) {
+            case SETTINGS_MAX_CONCURRENT_STREAMS:
+                c->max_streams = FFMIN(val, INT_MAX);
+                break;
+            case SETTINGS_INITIAL_WINDOW_SIZE:
+                if (val > MAX_STREAM_ID)
+                    goto protocol_error;
+                for (st = c->streams; st; st = st->next)
+                    st->send_window += (int64_t)val - c->peer_initial_window;
+                c->peer_initial_window = val;
+                break;
+            case SETTINGS_MAX_FRAME_SIZE:
+                if (val < DEFAULT_FRAME_SIZE || val > 0xffffff)
+                    goto protocol_error;
+                c->peer_max_frame = val;
+                break;
+            }
+        }
+        add_reply(r, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+        break;
+    case FRAME_PING:
+        if (id || len != 8)
+            goto protocol_error;
+        if (!(flags & FLAG_ACK))
+            add_reply(r, FRAME_PING, FLAG_ACK, 0, p, len);
+        break;
+    case FRAME_GOAWAY: {
+        uint32_t last, code;
+        if (id || len < 8)
+            goto protocol_error;
+        last = AV_RB32(p) & MAX_STREAM_ID;
+        code = AV_RB32(p + 4);
+        if (code != ERROR_NO_ERROR)
+            av_log(c->hd, AV_LOG_ERROR, "HTTP/2 connection closed with error %u\n", code);
+        c->goaway = 1;
+        for (HTTP2Stream *next, *st = c->streams; st; st = next) {
+            next = st->next;
+            if (st->id > last)
+                stream_close_remote(c, st, AVERROR(ECONNRESET));
+        }
+        break;
+    }
+    case FRAME_WINDOW_UPDATE: {
+        uint32_t inc;
+        if (len != 4)
+            goto protocol_error;
+        inc = AV_RB32(p) & MAX_STREAM_ID;
+        if (!id) {
+            c->send_window += inc;
+            if (c->send_window > MAX_STREAM_ID) {
+                add_goaway(r, ERROR_FLOW_CONTROL);
+                return AVERROR_INVALIDDATA;
+            }
+        } else if ((st = find_stream(c, id))) {
+            st->send_window += inc;
+        }
+        break;
+    }
+    case FRAME_PUSH_PROMISE:
+        /* disabled in our settings */
+        goto protocol_error;
+    }
+    return 0;
+
+protocol_error:
+    av_log(c->hd, AV_LOG_ERROR, "HTTP/2 protocol error in frame type %d\n", type);
+    add_goaway(r, ERROR_PROTOCOL);
+    return AVERROR_INVALIDDATA;
+}
+
+static int parse_frames(HTTP2Connection *c)
+{
+    uint8_t *p = c->rbuf;
+    int left = c->rbuf_len, ret = 0;
+
+    while (left >= FRAME_HEADER_SIZE) {
+        int len = AV_RB24(p);
+        Replies r = { .size = 0 };
+
+        if (len > DEFAULT_FRAME_SIZE) {
+            av_log(c->hd, AV_LOG_ERROR, "HTTP/2 frame too large\n");
+            add_goaway(&r, ERROR_FRAME_SIZE);
+            conn_write_raw(c, r.buf, r.size);
+            return AVERROR_INVALIDDATA;
+        }
+        if (left < FRAME_HEADER_SIZE + len)
+            break;
+
+        pthread_mutex_lock(&c->lock);
+        ret = handle_frame(c, p[3], p[4], AV_RB32(p + 5) & MAX_STREAM_ID,
+                           p + FRAME_HEADER_SIZE, len, &r);
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->lock);
+
+        conn_write_raw(c, r.buf, r.size);
+        if (ret < 0)
+            return ret;
+        p    += FRAME_HEADER_SIZE + len;
+        left -= FRAME_HEADER_SIZE + len;
+    }
+    memmove(c->rbuf, p, left);
+    c->rbuf_len = left;
+    return 0;
+}
+
+static void *conn_thread(void *arg)
+{
+    HTTP2Connection *c = arg;
+    int fd = ffurl_get_file_handle(c->hd);
+    int ret = 0;
+
+    while (!atomic_load(&c->abort)) {
+        pthread_mutex_lock(&c->io_lock);
+        c->hd->flags |= AVIO_FLAG_NONBLOCK;
+        ret = ffurl_read(c->hd, c->rbuf + c->rbuf_len, sizeof(c->rbuf) - c->rbuf_len);
+        c->hd->flags &= ~AVIO_FLAG_NONBLOCK;
+        pthread_mutex_unlock(&c->io_lock);
+
+        if (ret == AVERROR(EAGAIN)) {
+            ret = ff_network_wait_fd(fd, 0);
+            if (ret < 0 && ret != AVERROR(EAGAIN))
+                break;
+            continue;
+        }
+        if (!ret)
+            ret = AVERROR_EOF;
+        if (ret < 0)
+            break;
+        c->rbuf_len += ret;
+        if ((ret = parse_frames(c)) < 0)
+            break;
+    }
+    conn_fail(c, ret < 0 ? ret : AVERROR_EXIT);
+    return NULL;
+}
+
+static int conn_interrupt(void *opaque)
+{
+    HTTP2Connection *c = opaque;
+    return c->open_cb && ff_check_interrupt(c->open_cb);
+}
+
+static void conn_free(HTTP2Connection *c)
+{
+    if (c->thread_started) {
+        pthread_mutex_lock(&c->lock);
+        if (!c->error) {
+            uint8_t goaway[FRAME_HEADER_SIZE + 8] = { 0 };
+            pthread_mutex_unlock(&c->lock);
+            put_frame_header(goaway, 8, FRAME_GOAWAY, 0, 0);
+            conn_write_raw(c, goaway, sizeof(goaway));
+        } else {
+            pthread_mutex_unlock(&c->lock);
+        }
+        atomic_store(&c->abort, 1);
+        pthread_join(c->thread, NULL);
+    }
+    ffurl_closep(&c->hd);
+    while (c->streams)
+        stream_free(c, c->streams);
+    ff_hpack_decoder_uninit(&c->hpack);
+    av_freep(&c->hblock);
+    av_freep(&c->key);
+    pthread_mutex_destroy(&c->io_lock);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->cond);
+    av_free(c);
+}
+
+static HTTP2Connection *conn_alloc(const char *key)
+{
+    HTTP2Connection *c = av_mallocz(sizeof(*c));
+
+    if (!c)
+        return NULL;
+    if (!(c->key = av_strdup(key))) {
+        av_free(c);
+        return NULL;
+    }
+    c->refcount            = 1;
+    c->opening             = 1;
+    c->next_stream_id      = 1;
+    c->max_streams         = INT_MAX;
+    c->send_window         = DEFAULT_WINDOW;
+    c->peer_initial_window = DEFAULT_WINDOW;
+    c->peer_max_frame      = DEFAULT_FRAME_SIZE;
+    atomic_init(&c->abort, 0);
+    ff_hpack_decoder_init(&c->hpack, HEADER_TABLE_SIZE);
+    pthread_mutex_init(&c->io_lock, NULL);
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    return c;
+}
+
+static int conn_open(URLContext *h, HTTP2Connection *c)
+{
+    HTTP2Context *s = h->priv_data;
+    AVIOInterruptCB int_cb;
+    AVDictionary *opts = NULL;
+    uint8_t buf[sizeof(preface) - 1 + 2 * FRAME_HEADER_SIZE + 12 + 4], *p;
+    int ret;
+
+    /* the lower context outlives the context opening it, so its interrupt
+     * callback only applies until the connection is established */
+    int_cb.callback = conn_interrupt;
+    int_cb.opaque   = c;
+    c->open_cb      = &h->interrupt_callback;
+    av_dict_copy(&opts, s->options, 0);
+    if (s->https)
+        av_dict_set(&opts, "alpn", "h2", 0);
+    ret = ffurl_open_whitelist(&c->hd, s->url, AVIO_FLAG_READ_WRITE, &int_cb,
+                               &opts, h->protocol_whitelist,
+                               h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    c->open_cb = NULL;
+    if (ret < 0)
+        return ret;
+
+    if (s->https) {
+        uint8_t *proto = NULL;
+        av_opt_get(c->hd, "alpn_selected", AV_OPT_SEARCH_CHILDREN, &proto);
+        ret = proto && !strcmp(proto, "h2") ? 0 : AVERROR(ENOPROTOOPT);
+        av_free(proto);
+        if (ret < 0) {
+            av_log(h, AV_LOG_VERBOSE, "Server did not select HTTP/2\n");
+            return ret;
+        }
+    }
+
+    p = buf;
+    memcpy(p, preface, sizeof(preface) - 1);
+    p += sizeof(preface) - 1;
+    put_frame_header(p, 12, FRAME_SETTINGS, 0, 0);
+    AV_WB16(p +  9, SETTINGS_ENABLE_PUSH);
+    AV_WB32(p + 11, 0);
+    AV_WB16(p + 15, SETTINGS_INITIAL_WINDOW_SIZE);
+    AV_WB32(p + 17, STREAM_WINDOW);
+    p += FRAME_HEADER_SIZE + 12;
+    put_frame_header(p, 4, FRAME_WINDOW_UPDATE, 0, 0);
+    AV_WB32(p + 9, CONN_WINDOW - DEFAULT_WINDOW);
+    if ((ret = ffurl_write(c->hd, buf, sizeof(buf))) < 0)
+        return ret;
+
+    if ((ret = pthread_create(&c->thread, NULL, conn_thread, c)))
+        return AVERROR(ret);
+    c->thread_started = 1;
+    return 0;
+}
+
+static int conn_usable(HTTP2Connection *c)
+{
+    int usable;
+
+    pthread_mutex_lock(&c->lock);
+    usable = !c->error && !c->goaway && c->next_stream_id < MAX_STREAM_ID;
+    pthread_mutex_unlock(&c->lock);
+    return usable;
+}
+
+/* Wait for a change of the connection state, with the lock held. */
+static int stream_wait(URLContext *h, int64_t *deadline)
+{
+    HTTP2Context *s = h->priv_data;
+    struct timespec ts;
+    int64_t t;
+
+    if (ff_check_interrupt(&h->interrupt_callback))
+        return AVERROR_EXIT;
+    if (h->flags & AVIO_FLAG_NONBLOCK)
+        return AVERROR(EAGAIN);
+    if (h->rw_timeout > 0) {
+        if (!*deadline)
+            *deadline = av_gettime_relative() + h->rw_timeout;
+        else if (av_gettime_relative() > *deadline)
+            return AVERROR(ETIMEDOUT);
+    }
+    t = av_gettime() + WAIT_INTERVAL;
+    ts.tv_sec  = t / 1000000;
+    ts.tv_nsec = t % 1000000 * 1000;
+    pthread_cond_timedwait(&s->conn->cond, &s->conn->lock, &ts);
+    return 0;
+}
+
+static void conn_release(HTTP2Connection **pc)
+{
+    HTTP2Connection *c = *pc, **p;
+
+    if (!c)
+        return;
+    *pc = NULL;
+
+    ff_mutex_lock(&pool_lock);
+    if (--c->refcount) {
+        ff_mutex_unlock(&pool_lock);
+        return;
+    }
+    for (p = &pool; *p && *p != c; p = &(*p)->next)
+        ;
+    if (*p)
+        *p = c->next;
+    ff_mutex_unlock(&pool_lock);
+    conn_free(c);
+}
+
+static int conn_get(URLContext *h)
+{
+    HTTP2Context *s = h->priv_data;
+    HTTP2Connection *c;
+    int64_t deadline = 0;
+    int opener = 0, ret = 0;
+
+    ff_mutex_lock(&pool_lock);
+    for (int i = 0; i < FF_ARRAY_ELEMS(no_h2); i++) {
+        if (!strcmp(no_h2[i], s->url)) {
+            ff_mutex_unlock(&pool_lock);
+            return AVERROR(ENOPROTOOPT);
+        }
+    }
+    for (c = pool; c; c = c->next) {
+        if (!strcmp(c->key, s->url) && conn_usable(c)) {
+            c->refcount++;
+            break;
+        }
+    }
+    /* register the connection right away, so that concurrent requests to
+     * the same server wait for it rather than open their own */
+    if (!c && (c = conn_alloc(s->url))) {
+        c->next = pool;
+        pool    = c;
+        opener  = 1;
+    }
+    ff_mutex_unlock(&pool_lock);
+    if (!c)
+        return AVERROR(ENOMEM);
+    s->conn = c;
+
+    if (opener && (ret = conn_open(h, c)) == AVERROR(ENOPROTOOPT) &&
+        strlen(s->url) < sizeof(no_h2[0])) {
+        /* spare the next requests a useless handshake */
+        ff_mutex_lock(&pool_lock);
+        strcpy(no_h2[no_h2_pos], s->url);
+        no_h2_pos = (no_h2_pos + 1) % FF_ARRAY_ELEMS(no_h2);
+        ff_mutex_unlock(&pool_lock);
+    }
+
+    pthread_mutex_lock(&c->lock);
+    if (opener) {
+        c->opening = 0;
+        if (ret < 0)
+            c->error = ret;
+        pthread_cond_broadcast(&c->cond);
+    }
+    while (c->opening && !c->error && (ret = stream_wait(h, &deadline)) >= 0)
+        ;
+    if (c->error)
+        ret = c->error;
+    pthread_mutex_unlock(&c->lock);
+
+    if (ret < 0)
+        conn_release(&s->conn);
+    return ret;
+}
+
+/* Stop caring about the current stream, if any. */
+static void stream_detach(URLContext *h)
+{
+    HTTP2Context *s = h->priv_data;
+    HTTP2Connection *c = s->conn;
+    HTTP2Stream *st = s->stream;
+    uint32_t id;
+
+    if (!st)
+        return;
+    s->stream = NULL;
+
+    pthread_mutex_lock(&c->lock);
+    id = st->id;
+    if (st->remote_closed) {
+        stream_free(c, st);
+        id = 0;
+    } else if (st->local_closed && !st->headers_done) {
+        /* let e.g. an upload complete, the connection thread cancels the
+         * stream once the response arrives */
+        st->detached = 1;
+        id = 0;
+    } else {
+        stream_free(c, st);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (id) {
+        uint8_t rst[FRAME_HEADER_SIZE + 4];
+        put_frame_header(rst, 4, FRAME_RST_STREAM, 0, id);
+        AV_WB32(rst + FRAME_HEADER_SIZE, ERROR_CANCEL);
+        conn_write_raw(c, rst, sizeof(rst));
+    }
+}
+
+static int send_data(URLContext *h, const uint8_t *buf, int size, int end_stream)
+{
+    HTTP2Context *s = h->priv_data;
+    HTTP2Connection *c = s->conn;
+    HTTP2Stream *st = s->stream;
+    int64_t deadline = 0;
+    int pos = 0, ret = 0;
+
+    if (s->body_left >= 0 && size > s->body_left)
+        return AVERROR(EINVAL);
+
+    do {
+        uint8_t hdr[FRAME_HEADER_SIZE];
+        int n, last;
+
+        pthread_mutex_lock(&c->lock);
+        for (;;) {
+            if (st->remote_closed) {
+                ret = st->error ? st->error : AVERROR(EPIPE);
+                break;
+            }
+            if (c->error) {
+                ret = c->error;
+                break;
+            }
+            n = FFMIN3(size - pos, c->peer_max_frame,
+                       FFMIN(c->send_window, st->send_window));
+            if (n > 0 || pos == size)
+                break;
+            if ((ret = stream_wait(h, &deadline)) < 0)
+                break;
+        }
+        if (ret < 0) {
+            pthread_mutex_unlock(&c->lock);
+            return ret;
+        }
+        n     = FFMAX(n, 0);
+        last  = end_stream || (s->body_left >= 0 && s->body_left == n);
+        last &= pos + n == size;
+        c->send_window  -= n;
+        st->send_window -= n;
+        if (last)
+            st->local_closed = 1;
+        pthread_mutex_unlock(&c->lock);
+
+        put_frame_header(hdr, n, FRAME_DATA, last ? FLAG_END_STREAM : 0, st->id);
+        if ((ret = conn_write(c, hdr, buf + pos, n)) < 0)
+            return ret;
+        pos += n;
+        if (s->body_left >= 0)
+            s->body_left -= n;
+    } while (pos < size);
+    return size;
+}
+
+static int is_connection_header(const char *name)
+{
+    static const char *const names[] = {
+        "connection", "host", "keep-alive", "proxy-connection", "te",
+        "transfer-encoding", "upgrade",
+    };
+    for (int i = 0; i < FF_ARRAY_ELEMS(names); i++)
+        if (!strcmp(name, names[i]))
+            return 1;
+    return 0;
+}
+
+/* Convert a complete HTTP/1.1 request header into a header block. */
+static int build_header_block(URLContext *h, char *req, AVBPrint *block,
+                              int *end_stream)
+{
+    HTTP2Context *s = h->priv_data;
+    char *method, *path, *line, *next, *save = NULL;
+    const char *host = "";
+    AVBPrint fields;
+    int ret;
+
+    if (!(next = strstr(req, "\r\n")))
+        return AVERROR(EINVAL);
+    *next = 0;
+    method = av_strtok(req, " ", &save);
+    path   = av_strtok(NULL, " ", &save);
+    if (!method || !path)
+        return AVERROR(EINVAL);
+
+    /* pseudo-header fields must come first, but the authority is only
+     * known once the Host line has been seen */
+    av_bprint_init(&fields, 0, AV_BPRINT_SIZE_UNLIMITED);
+    s->body_left = -1;
+    for (line = next + 2; (next = strstr(line, "\r\n")); line = next + 2) {
+        char *value = strchr(line, ':');
+        *next = 0;
+        if (!value || value > next)
+            continue;
+        *value++ = 0;
+        value += strspn(value, " \t");
+        for (char *p = line; *p; p++)
+            *p = av_tolower(*p);
+        if (!strcmp(line, "host"))
+            host = value;
+        else if (!strcmp(line, "content-length"))
+            s->body_left = strtoll(value, NULL, 10);
+        if (!is_connection_header(line))
+            ff_hpack_encode_field(&fields, line, value);
+    }
+    *end_stream = !s->body_left ||
+                  (s->body_left < 0 && (!strcmp(method, "GET") || !strcmp(method, "HEAD")));
+
+    ff_hpack_encode_field(block, ":method", method);
+    ff_hpack_encode_field(block, ":scheme", s->https ? "https" : "http");
+    ff_hpack_encode_field(block, ":authority", host);
+    ff_hpack_encode_field(block, ":path", path);
+    av_bprint_append_data(block, fields.str, fields.len);
+    ret = av_bprint_is_complete(&fields) && av_bprint_is_complete(block) ?
+          0 : AVERROR(ENOMEM);
+    av_bprint_finalize(&fields, NULL);
+    return ret;
+}
+
+static int start_stream(URLContext *h, const char *head, int head_len)
+{
+    HTTP2Context *s = h->priv_data;
+    HTTP2Connection *c;
+    HTTP2Stream *st;
+    AVBPrint block;
+    char *req;
+    int64_t deadline = 0;
+    int end_stream, max_frame, ret;
+
+    stream_detach(h);
+
+    req = av_strndup(head, head_len);
+    if (!req)
+        return AVERROR(ENOMEM);
+    av_bprint_init(&block, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = build_header_block(h, req, &block, &end_stream);
+    av_free(req);
+    if (ret < 0)
+        goto end;
+
+    if (!conn_usable(s->conn)) {
+        conn_release(&s->conn);
+        if ((ret = conn_get(h)) < 0)
+            goto end;
+    }
+    c = s->conn;
+
+    st = av_mallocz(sizeof(*st));
+    if (!st || !(st->fifo = av_fifo_alloc(DEFAULT_FRAME_SIZE))) {
+        av_free(st);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    av_bprint_init(&st->head, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    pthread_mutex_lock(&c->lock);
+    while (!c->error && c->nb_streams >= c->max_streams &&
+           (ret = stream_wait(h, &deadline)) >= 0)
+        ;
+    if (c->error)
+        ret = c->error;
+    pthread_mutex_unlock(&c->lock);
+    if (ret < 0) {
+        av_fifo_freep(&st->fifo);
+        av_free(st);
+        goto end;
+    }
+
+    /* stream ids must be used in increasing order */
+    pthread_mutex_lock(&c->io_lock);
+    pthread_mutex_lock(&c->lock);
+    st->id           = c->next_stream_id;
+    st->send_window  = c->peer_initial_window;
+    st->local_closed = end_stream;
+    st->next         = c->streams;
+    c->streams       = st;
+    c->next_stream_id += 2;
+    c->nb_streams++;
+    max_frame = c->peer_max_frame;
+    pthread_mutex_unlock(&c->lock);
+
+    for (int pos = 0; pos < block.len;) {
+        uint8_t hdr[FRAME_HEADER_SIZE];
+        int n = FFMIN(block.len - pos, max_frame);
+        int flags = pos + n == block.len ? FLAG_END_HEADERS : 0;
+        URLIOVec iov[2] = { { hdr, FRAME_HEADER_SIZE }, { block.str + pos, n } };
+        if (!pos && end_stream)
+            flags |= FLAG_END_STREAM;
+        put_frame_header(hdr, n, pos ? FRAME_CONTINUATION : FRAME_HEADERS,
+                         flags, st->id);
+        if ((ret = ffurl_writev(c->hd, iov, 2)) < 0)
+            break;
+        pos += n;
+    }
+    pthread_mutex_unlock(&c->io_lock);
+
+    s->stream   = st;
+    s->head_pos = 0;
+    if (ret < 0)
+        conn_fail(c, ret);
+end:
+    av_bprint_finalize(&block, NULL);
+    return FFMIN(ret, 0);
+}
+
+static int http2_open(URLContext *h, const char *uri, int flags,
+                      AVDictionary **options)
+{
+    HTTP2Context *s = h->priv_data;
+    const char *url;
+    int ret;
+
+    av_bprint_init(&s->request, 0, AV_BPRINT_SIZE_UNLIMITED);
+    if (!av_strstart(uri, "http2:", &url)) {
+        av_log(h, AV_LOG_ERROR, "Unsupported url %s\n", uri);
+        return AVERROR(EINVAL);
+    }
+    s->https = av_strstart(url, "tls:", NULL);
+    if (!(s->url = av_strdup(url)))
+        return AVERROR(ENOMEM);
+    if (options && (ret = av_dict_copy(&s->options, *options, 0)) < 0)
+        return ret;
+
+    h->is_streamed = 1;
+    return conn_get(h);
+}
+
+static int http2_write(URLContext *h, const uint8_t *buf, int size)
+{
+    HTTP2Context *s = h->priv_data;
+    const char *end;
+    int head_len, ret;
+
+    if (s->stream && !s->stream->local_closed)
+        return size ? send_data(h, buf, size, 0) : 0;
+
+    /* anything else starts a new request */
+    av_bprint_append_data(&s->request, buf, size);
+    if (!av_bprint_is_complete(&s->request))
+        return AVERROR(ENOMEM);
+    if (!(end = strstr(s->request.str, "\r\n\r\n")))
+        return size;
+    head_len = end + 4 - s->request.str;
+
+    ret = start_stream(h, s->request.str, head_len);
+    if (ret >= 0 && s->request.len > head_len)
+        ret = send_data(h, s->request.str + head_len, s->request.len - head_len, 0);
+    av_bprint_clear(&s->request);
+    return ret < 0 ? ret : size;
+}
+
+static int http2_read(URLContext *h, uint8_t *buf, int size)
+{
+    HTTP2Context *s = h->priv_data;
+    HTTP2Connection *c = s->conn;
+    HTTP2Stream *st = s->stream;
+    int64_t deadline = 0;
+    int ret = 0, ack = 0;
+
+    if (!st)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        if (st->headers_done && s->head_pos < st->head.len) {
+            ret = FFMIN(size, st->head.len - s->head_pos);
+            memcpy(buf, st->head.str + s->head_pos, ret);
+            s->head_pos += ret;
+            break;
+        }
+        if (st->headers_done && av_fifo_size(st->fifo)) {
+            ret = FFMIN(size, av_fifo_size(st->fifo));
+            av_fifo_generic_read(st->fifo, buf, ret, NULL);
+            st->recv_unacked += ret;
+            if (st->recv_unacked >= STREAM_WINDOW / 2 && !st->remote_closed) {
+                ack = st->recv_unacked;
+                st->recv_unacked = 0;
+            }
+            break;
+        }
+        if (st->error || st->remote_closed) {
+            ret = st->error ? st->error : AVERROR_EOF;
+            break;
+        }
+        if (c->error) {
+            ret = c->error == AVERROR_EOF ? AVERROR(ECONNRESET) : c->error;
+            break;
+        }
+        if ((ret = stream_wait(h, &deadline)) < 0)
+            break;
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    if (ack) {
+        uint8_t hdr[FRAME_HEADER_SIZE], inc[4];
+        put_frame_header(hdr, 4, FRAME_WINDOW_UPDATE, 0, st->id);
+        AV_WB32(inc, ack);
+        conn_write(c, hdr, inc, 4);
+    }
+    return ret;
+}
+
+static int http2_shutdown(URLContext *h, int flags)
+{
+    HTTP2Context *s = h->priv_data;
+
+    if ((flags & AVIO_FLAG_WRITE) && s->stream && !s->stream->local_closed) {
+        int ret = send_data(h, NULL, 0, 1);
+        return FFMIN(ret, 0);
+    }
+    return 0;
+}
+
+static int http2_close(URLContext *h)
+{
+    HTTP2Context *s = h->priv_data;
+
+    if (s->conn)
+        stream_detach(h);
+    conn_release(&s->conn);
+    av_freep(&s->url);
+    av_dict_free(&s->options);
+    av_bprint_finalize(&s->request, NULL);
+    return 0;
+}
+
+static const AVClass http2_context_class = {
+    .class_name = "http2",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_http2_protocol = {
+    .name            = "http2",
+    .url_open2       = http2_open,
+    .url_read        = http2_read,
+    .url_write       = http2_write,
+    .url_shutdown    = http2_shutdown,
+    .url_close       = http2_close,
+    .priv_data_size  = sizeof(HTTP2Context),
+    .priv_data_class = &http2_context_class,
+    .flags           = URL_PROTOCOL_FLAG_NETWORK,
+};
@@ -25,6 +25,11 @@
 #include <stdint.h>
 #include "avformat.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
+
+#if HAVE_THREADS
+#include <stdatomic.h>
+#endif
 
 #if HAVE_GLOB
 #include <glob.h>
@@ -62,6 +67,15 @@ typedef struct VideoDemuxData {
     int frame_size;
     int ts_from_file;
     int export_path_metadata; /**< enabled when set to 1. */
+    int prefetch;           /**< number of files read ahead in parallel */
+#if HAVE_THREADS
+    struct ImgPrefetchSlot *prefetch_slots;
+    pthread_t *prefetch_threads;
+    int nb_prefetch_threads;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    atomic_int prefetch_abort;
+#endif
 } VideoDemuxData;
 
 typedef struct IdStrMap {
@@ -76,4 +90,6 @@ extern const AVOption ff_img_options[];
 int ff_img_read_header(AVFormatContext *s1);
 
 int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt);
+
+int ff_img_read_close(AVFormatContext *s1);
 #endif
@@ -52,6 +52,7 @@ AVInputFormat ff_image2_brender_pix_demuxer = {
     .read_probe     = brender_read_probe,
     .read_header    = ff_img_read_header,
     .read_packet    = ff_img_read_packet,
+    .read_close     = ff_img_read_close,
     .raw_codec_id   = AV_CODEC_ID_BRENDER_PIX,
     .priv_class     = &image2_brender_pix_class,
 };
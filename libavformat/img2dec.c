@@ -179,6 +179,281 @@ static int img_read_probe(const AVProbeData *p)
     return 0;
 }
 
+static int get_image_filename(VideoDemuxData *s, int number,
+                              char *buf, int buf_size, char **filename)
+{
+    *filename = buf;
+    if (s->pattern_type == PT_NONE) {
+        av_strlcpy(buf, s->path, buf_size);
+    } else if (s->use_glob) {
+#if HAVE_GLOB
+        *filename = s->globstate.gl_pathv[number];
+#endif
+    } else {
+        if (av_get_frame_filename(buf, buf_size, s->path, number) < 0 && number > 1)
+            return AVERROR(EIO);
+    }
+    return 0;
+}
+
+#if HAVE_THREADS
+enum PrefetchState {
+    PREFETCH_FREE,
+    PREFETCH_QUEUED,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE,
+};
+
+typedef struct ImgPrefetchSlot {
+    enum PrefetchState state;
+    int number;             ///< image number of the file
+    int order;              ///< position in the read-ahead window, lower is read first
+    char filename[1024];
+    uint8_t *data;          ///< padded file contents
+    int ret;                ///< size of data or error code
+} ImgPrefetchSlot;
+
+static int prefetch_interrupt(void *opaque)
+{
+    AVFormatContext *s1 = opaque;
+    VideoDemuxData *s = s1->priv_data;
+
+    return atomic_load(&s->prefetch_abort) ||
+           ff_check_interrupt(&s1->interrupt_callback);
+}
+
+/**
+ * Read a whole file into a padded buffer.
+ * Runs in the prefetch threads, so it must not modify the demuxer context.
+ */
+static int prefetch_read_file(AVFormatContext *s1, const char *filename,
+                              uint8_t **data)
+{
+    AVIOInterruptCB cb = { prefetch_interrupt, s1 };
+    AVIOContext *pb = NULL;
+    int64_t size;
+    int ret;
+
+    ret = ffio_open_whitelist(&pb, filename, AVIO_FLAG_READ, &cb, NULL,
+                              s1->protocol_whitelist, s1->protocol_blacklist);
+    if (ret < 0) {
+        av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n", filename);
+        return AVERROR(EIO);
+    }
+
+    size = avio_size(pb);
+    if (size < 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        ret = size < 0 ? size : AVERROR(ERANGE);
+        goto end;
+    }
+    *data = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!*data) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avio_read(pb, *data, size);
+    if (ret > 0)
+        memset(*data + ret, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    else
+        av_freep(data);
+end:
+    avio_closep(&pb);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    AVFormatContext *s1 = arg;
+    VideoDemuxData *s = s1->priv_data;
+
+    pthread_mutex_lock(&s->prefetch_lock);
+    while (!atomic_load(&s->prefetch_abort)) {
+        ImgPrefetchSlot *slot = NULL;
+        uint8_t *data = NULL;
+        int i, ret;
+
+        for (i = 0; i < s->prefetch; i++) {
+            ImgPrefetchSlot *cur = &s->prefetch_slots[i];
+            if (cur->state == PREFETCH_QUEUED && (!slot || cur->order < slot->order))
+                slot = cur;
+        }
+        if (!slot) {
+            pthread_cond_wait(&s->prefetch_cond, &s->prefetch_lock);
+            continue;
+        }
+
+        slot->state = PREFETCH_RUNNING;
+        pthread_mutex_unlock(&s->prefetch_lock);
+        ret = prefetch_read_file(s1, slot->filename, &data);
+        pthread_mutex_lock(&s->prefetch_lock);
+
+        slot->data  = data;
+        slot->ret   = ret;
+        slot->state = PREFETCH_DONE;
+        pthread_cond_broadcast(&s->prefetch_cond);
+    }
+    pthread_mutex_unlock(&s->prefetch_lock);
+    return NULL;
+}
+
+/* position of an image number in the read-ahead window starting at cur, or -1 */
+static int prefetch_order(VideoDemuxData *s, int cur, int number)
+{
+    int count = s->img_last - s->img_first + 1;
+    int pos   = number - cur;
+
+    if (pos < 0 && s->loop)
+        pos += count;
+    return pos >= 0 && pos < FFMIN(s->prefetch, count) ? pos : -1;
+}
+
+/**
+ * Queue the files of the read-ahead window starting at image number cur and
+ * drop the ones which fell out of it, e.g. after a seek.
+ * Must be called with prefetch_lock held.
+ */
+static void prefetch_schedule(VideoDemuxData *s, int cur)
+{
+    int count = s->img_last - s->img_first + 1;
+    int i, k;
+
+    for (i = 0; i < s->prefetch; i++) {
+        ImgPrefetchSlot *slot = &s->prefetch_slots[i];
+        if (slot->state == PREFETCH_FREE || slot->state == PREFETCH_RUNNING)
+            continue;
+        slot->order = prefetch_order(s, cur, slot->number);
+        if (slot->order < 0) {
+            av_freep(&slot->data);
+            slot->state = PREFETCH_FREE;
+        }
+    }
+
+    for (k = 0; k < FFMIN(s->prefetch, count); k++) {
+        ImgPrefetchSlot *slot = NULL;
+        int number = cur + k;
+        char *filename;
+
+        if (number > s->img_last) {
+            if (!s->loop)
+                break;
+            number -= count;
+        }
+        for (i = 0; i < s->prefetch; i++) {
+            ImgPrefetchSlot *cur_slot = &s->prefetch_slots[i];
+            if (cur_slot->state != PREFETCH_FREE && cur_slot->number == number)
+                break;
+            if (cur_slot->state == PREFETCH_FREE && !slot)
+                slot = cur_slot;
+        }
+        if (i < s->prefetch || !slot)
+            continue;
+
+        slot->number = number;
+        slot->order  = k;
+        slot->data   = NULL;
+        if (get_image_filename(s, number, slot->filename,
+                               sizeof(slot->filename), &filename) < 0) {
+            slot->ret   = AVERROR(EIO);
+            slot->state = PREFETCH_DONE;
+            continue;
+        }
+        if (filename != slot->filename)
+            av_strlcpy(slot->filename, filename, sizeof(slot->filename));
+        slot->state = PREFETCH_QUEUED;
+    }
+    pthread_cond_broadcast(&s->prefetch_cond);
+}
+
+/**
+ * Take the contents of the current file from the prefetch threads, waiting
+ * for them if needed, and move the read-ahead window past it.
+ *
+ * @return size of data, 0 on EOF or a negative error code
+ */
+static int prefetch_take(AVFormatContext *s1, uint8_t **data)
+{
+    VideoDemuxData *s = s1->priv_data;
+    ImgPrefetchSlot *slot;
+    int i, ret, next;
+
+    pthread_mutex_lock(&s->prefetch_lock);
+    for (;;) {
+        prefetch_schedule(s, s->img_number);
+        for (i = 0; i < s->prefetch; i++) {
+            slot = &s->prefetch_slots[i];
+            if (slot->state != PREFETCH_FREE && slot->number == s->img_number)
+                break;
+        }
+        if (i < s->prefetch && slot->state == PREFETCH_DONE)
+            break;
+        pthread_cond_wait(&s->prefetch_cond, &s->prefetch_lock);
+    }
+
+    *data       = slot->data;
+    ret         = slot->ret;
+    slot->data  = NULL;
+    slot->state = PREFETCH_FREE;
+
+    next = s->img_number + 1;
+    if (next > s->img_last && s->loop)
+        next = s->img_first;
+    if (next <= s->img_last)
+        prefetch_schedule(s, next);
+    pthread_mutex_unlock(&s->prefetch_lock);
+    return ret;
+}
+
+static void stop_prefetch(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    int i;
+
+    if (!s->prefetch_slots)
+        return;
+    pthread_mutex_lock(&s->prefetch_lock);
+    atomic_store(&s->prefetch_abort, 1);
+    pthread_cond_broadcast(&s->prefetch_cond);
+    pthread_mutex_unlock(&s->prefetch_lock);
+    for (i = 0; i < s->nb_prefetch_threads; i++)
+        pthread_join(s->prefetch_threads[i], NULL);
+    pthread_mutex_destroy(&s->prefetch_lock);
+    pthread_cond_destroy(&s->prefetch_cond);
+    s->nb_prefetch_threads = 0;
+
+    for (i = 0; i < s->prefetch; i++)
+        av_freep(&s->prefetch_slots[i].data);
+    av_freep(&s->prefetch_slots);
+    av_freep(&s->prefetch_threads);
+}
+
+static int start_prefetch(AVFormatContext *s1)
+{
+    VideoDemuxData *s = s1->priv_data;
+    int i, ret;
+
+    s->prefetch_slots   = av_mallocz_array(s->prefetch, sizeof(*s->prefetch_slots));
+    s->prefetch_threads = av_mallocz_array(s->prefetch, sizeof(*s->prefetch_threads));
+    if (!s->prefetch_slots || !s->prefetch_threads) {
+        av_freep(&s->prefetch_slots);
+        av_freep(&s->prefetch_threads);
+        return AVERROR(ENOMEM);
+    }
+    atomic_init(&s->prefetch_abort, 0);
+    pthread_mutex_init(&s->prefetch_lock, NULL);
+    pthread_cond_init(&s->prefetch_cond, NULL);
+
+    for (i = 0; i < s->prefetch; i++) {
+        ret = pthread_create(&s->prefetch_threads[i], NULL, prefetch_thread, s1);
+        if (ret) {
+            stop_prefetch(s1);
+            return AVERROR(ret);
+        }
+        s->nb_prefetch_threads++;
+    }
+    return 0;
+}
+#endif
+
 int ff_img_read_header(AVFormatContext *s1)
 {
     VideoDemuxData *s = s1->priv_data;
@@ -371,6 +646,17 @@ int ff_img_read_header(AVFormatContext *s1)
         pix_fmt != AV_PIX_FMT_NONE)
         st->codecpar->format = pix_fmt;
 
+    if (s->prefetch > 0 && !s->is_pipe && !s1->pb &&
+        s->pattern_type != PT_NONE && !s->split_planes) {
+#if HAVE_THREADS
+        int ret = start_prefetch(s1);
+        if (ret < 0)
+            return ret;
+#else
+        av_log(s1, AV_LOG_WARNING, "prefetch requires thread support, ignoring\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -407,6 +693,7 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     int i, res;
     int size[3]           = { 0 }, ret[3] = { 0 };
     AVIOContext *f[3]     = { NULL };
+    uint8_t *data         = NULL;
     AVCodecParameters *par = s1->streams[0]->codecpar;
 
     if (!s->is_pipe) {
@@ -416,19 +703,19 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
-        if (s->pattern_type == PT_NONE) {
-            av_strlcpy(filename_bytes, s->path, sizeof(filename_bytes));
-        } else if (s->use_glob) {
-#if HAVE_GLOB
-            filename = s->globstate.gl_pathv[s->img_number];
-#endif
-        } else {
-        if (av_get_frame_filename(filename_bytes, sizeof(filename_bytes),
-                                  s->path,
-                                  s->img_number) < 0 && s->img_number > 1)
-            return AVERROR(EIO);
+        res = get_image_filename(s, s->img_number, filename_bytes,
+                                 sizeof(filename_bytes), &filename);
+        if (res < 0)
+            return res;
+#if HAVE_THREADS
+        if (s->prefetch_slots) {
+            res = prefetch_take(s1, &data);
+            if (res <= 0)
+                return res ? res : AVERROR_EOF;
+            size[0] = res;
         }
-        for (i = 0; i < 3; i++) {
+#endif
+        for (i = 0; i < 3 && !data; i++) {
             if (s1->pb &&
                 !strcmp(filename_bytes, s->path) &&
                 !s->loop &&
@@ -455,11 +742,16 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
             int ret;
             int score = 0;
 
-            ret = avio_read(f[0], header, PROBE_BUF_MIN);
-            if (ret < 0)
-                return ret;
+            if (data) {
+                ret = FFMIN(size[0], PROBE_BUF_MIN);
+                memcpy(header, data, ret);
+            } else {
+                ret = avio_read(f[0], header, PROBE_BUF_MIN);
+                if (ret < 0)
+                    return ret;
+                avio_skip(f[0], -ret);
+            }
             memset(header + ret, 0, sizeof(header) - ret);
-            avio_skip(f[0], -ret);
             pd.buf = header;
             pd.buf_size = ret;
             pd.filename = filename;
@@ -486,6 +778,13 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
     }
 
+    if (data) {
+        res = av_packet_from_data(pkt, data, size[0]);
+        if (res < 0)
+            goto fail;
+        data = NULL;
+        ret[0] = pkt->size;
+    } else
     res = av_new_packet(pkt, size[0] + size[1] + size[2]);
     if (res < 0) {
         goto fail;
@@ -522,7 +821,8 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
             goto fail;
     }
 
-    pkt->size = 0;
+    if (!ret[0])
+        pkt->size = 0;
     for (i = 0; i < 3; i++) {
         if (f[i]) {
             ret[i] = avio_read(f[i], pkt->data + pkt->size, size[i]);
@@ -558,6 +858,7 @@ int ff_img_read_packet(AVFormatContext *s1, AVPacket *pkt)
     }
 
 fail:
+    av_free(data);
     if (!s->is_pipe) {
         for (i = 0; i < 3; i++) {
             if (f[i] != s1->pb)
@@ -567,10 +868,13 @@ fail:
     return res;
 }
 
-static int img_read_close(struct AVFormatContext* s1)
+int ff_img_read_close(AVFormatContext *s1)
 {
+    VideoDemuxData av_unused *s = s1->priv_data;
+#if HAVE_THREADS
+    stop_prefetch(s1);
+#endif
 #if HAVE_GLOB
-    VideoDemuxData *s = s1->priv_data;
     if (s->use_glob) {
         globfree(&s->globstate);
     }
@@ -621,6 +925,7 @@ const AVOption ff_img_options[] = {
     { "sec",  "second precision",       0, AV_OPT_TYPE_CONST,    {.i64 = 1   }, 0, 2,       DEC, "ts_type" },
     { "ns",   "nano second precision",  0, AV_OPT_TYPE_CONST,    {.i64 = 2   }, 0, 2,       DEC, "ts_type" },
     { "export_path_metadata", "enable metadata containing input path information", OFFSET(export_path_metadata), AV_OPT_TYPE_BOOL,   {.i64 = 0   }, 0, 1,       DEC }, \
+    { "prefetch",     "set number of files to read ahead in parallel", OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0   }, 0, 64,      DEC },
     COMMON_OPTIONS
 };
 
@@ -637,7 +942,7 @@ AVInputFormat ff_image2_demuxer = {
     .read_probe     = img_read_probe,
     .read_header    = ff_img_read_header,
     .read_packet    = ff_img_read_packet,
-    .read_close     = img_read_close,
+    .read_close     = ff_img_read_close,
     .read_seek      = img_read_seek,
     .flags          = AVFMT_NOFILE,
     .priv_class     = &img2_class,
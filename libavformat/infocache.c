@@ -0,0 +1,394 @@
+/*
+ * Cache of the results of avformat_find_stream_info()
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * The cache holds one text file per input, named after the MD5 of the URL.
+ * Each file is an AVDictionary serialized as key=value lines, which records
+ * the identity of the input (size, modification time, library versions) and
+ * the codec and timing parameters of all its streams.
+ */
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/dict.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavcodec/version.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+#include "version.h"
+
+#define CACHE_MAX_SIZE (1 << 20)
+
+typedef struct CacheField {
+    const char *name;
+    size_t offset;
+    int size;
+} CacheField;
+
+#define PAR(x) { #x, offsetof(AVCodecParameters, x), sizeof(((AVCodecParameters *)0)->x) }
+static const CacheField par_fields[] = {
+    PAR(codec_type),
+    PAR(codec_id),
+    PAR(codec_tag),
+    PAR(format),
+    PAR(bit_rate),
+    PAR(bits_per_coded_sample),
+    PAR(bits_per_raw_sample),
+    PAR(profile),
+    PAR(level),
+    PAR(width),
+    PAR(height),
+    PAR(field_order),
+    PAR(color_range),
+    PAR(color_primaries),
+    PAR(color_trc),
+    PAR(color_space),
+    PAR(chroma_location),
+    PAR(video_delay),
+    PAR(channel_layout),
+    PAR(channels),
+    PAR(sample_rate),
+    PAR(block_align),
+    PAR(frame_size),
+    PAR(initial_padding),
+    PAR(trailing_padding),
+    PAR(seek_preroll),
+};
+
+static int cache_path(AVFormatContext *s, char *path, int size)
+{
+    uint8_t md5[16];
+    char hex[33];
+
+    if (!s->url || !*s->url)
+        return AVERROR(EINVAL);
+    av_md5_sum(md5, s->url, strlen(s->url));
+    ff_data_to_hex(hex, md5, sizeof(md5), 1);
+    hex[32] = 0;
+    if (snprintf(path, size, "%s/%s.txt", s->stream_info_cache, hex) >= size)
+        return AVERROR(ENAMETOOLONG);
+    return 0;
+}
+
+/**
+ * Build the dictionary identifying the current state of the input. Only
+ * inputs of known size can be cached; the modification time is only known
+ * for local files.
+ */
+static int input_identity(AVFormatContext *s, AVDictionary **id)
+{
+    const char *proto = avio_find_protocol_name(s->url);
+    int64_t size = s->pb ? avio_size(s->pb) : -1;
+    int64_t mtime = 0;
+    int ret;
+
+    if (size <= 0)
+        return AVERROR(ENOSYS);
+
+    if (proto && !strcmp(proto, "file")) {
+        const char *filename = s->url;
+        struct stat st;
+
+        av_strstart(filename, "file:", &filename);
+        if (!stat(filename, &st))
+            mtime = st.st_mtime;
+    }
+
+    if ((ret = av_dict_set(id, "lavf", LIBAVFORMAT_IDENT, 0)) < 0 ||
+        (ret = av_dict_set(id, "lavc", LIBAVCODEC_IDENT, 0)) < 0 ||
+        (ret = av_dict_set(id, "format", s->iformat->name, 0)) < 0 ||
+        (ret = av_dict_set(id, "url", s->url, 0)) < 0 ||
+        (ret = av_dict_set_int(id, "size", size, 0)) < 0 ||
+        (ret = av_dict_set_int(id, "mtime", mtime, 0)) < 0 ||
+        (ret = av_dict_set_int(id, "nb_streams", s->nb_streams, 0)) < 0)
+        return ret;
+    return 0;
+}
+
+static int64_t get_int(AVDictionary *d, const char *key, int64_t def)
+{
+    AVDictionaryEntry *e = av_dict_get(d, key, NULL, 0);
+    return e ? strtoll(e->value, NULL, 10) : def;
+}
+
+static AVRational get_rational(AVDictionary *d, const char *key)
+{
+    AVDictionaryEntry *e = av_dict_get(d, key, NULL, 0);
+    AVRational q = { 0, 1 };
+
+    if (e && sscanf(e->value, "%d/%d", &q.num, &q.den) != 2)
+        q = (AVRational){ 0, 1 };
+    return q;
+}
+
+static int set_rational(AVDictionary **d, const char *key, AVRational q)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%d/%d", q.num, q.den);
+    return av_dict_set(d, key, buf, 0);
+}
+
+static int check_entry(AVFormatContext *s, AVDictionary *id, AVDictionary *d)
+{
+    AVDictionaryEntry *e = NULL;
+    int i;
+
+    while ((e = av_dict_get(id, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        AVDictionaryEntry *c = av_dict_get(d, e->key, NULL, 0);
+        if (!c || strcmp(c->value, e->value))
+            return 0;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVCodecParameters *par = s->streams[i]->codecpar;
+        char key[32];
+
+        snprintf(key, sizeof(key), "%d.par.codec_type", i);
+        if (get_int(d, key, AVMEDIA_TYPE_UNKNOWN) != par->codec_type)
+            return 0;
+        snprintf(key, sizeof(key), "%d.par.codec_id", i);
+        if (par->codec_id != AV_CODEC_ID_NONE &&
+            get_int(d, key, AV_CODEC_ID_NONE) != par->codec_id)
+            return 0;
+    }
+    return 1;
+}
+
+static int apply_stream(AVStream *st, int index, AVDictionary *d)
+{
+    AVCodecParameters *par = st->codecpar;
+    AVDictionaryEntry *e;
+    char key[64];
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(par_fields); i++) {
+        const CacheField *f = &par_fields[i];
+        uint8_t *dst = (uint8_t *)par + f->offset;
+        int64_t val;
+
+        snprintf(key, sizeof(key), "%d.par.%s", index, f->name);
+        if (!(e = av_dict_get(d, key, NULL, 0)))
+            continue;
+        val = strtoll(e->value, NULL, 10);
+        if (f->size == 8)
+            AV_WN64(dst, val);
+        else
+            AV_WN32(dst, val);
+    }
+    snprintf(key, sizeof(key), "%d.par.sample_aspect_ratio", index);
+    par->sample_aspect_ratio = get_rational(d, key);
+
+    snprintf(key, sizeof(key), "%d.par.extradata", index);
+    e = av_dict_get(d, key, NULL, 0);
+    if (e && !par->extradata) {
+        int size = strlen(e->value) / 2;
+        par->extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!par->extradata)
+            return AVERROR(ENOMEM);
+        par->extradata_size = ff_hex_to_data(par->extradata, e->value);
+    }
+
+    snprintf(key, sizeof(key), "%d.start_time", index);
+    st->start_time = get_int(d, key, AV_NOPTS_VALUE);
+    snprintf(key, sizeof(key), "%d.duration", index);
+    st->duration = get_int(d, key, AV_NOPTS_VALUE);
+    snprintf(key, sizeof(key), "%d.disposition", index);
+    st->disposition = get_int(d, key, st->disposition);
+    snprintf(key, sizeof(key), "%d.sample_aspect_ratio", index);
+    st->sample_aspect_ratio = get_rational(d, key);
+    snprintf(key, sizeof(key), "%d.avg_frame_rate", index);
+    st->avg_frame_rate = get_rational(d, key);
+    snprintf(key, sizeof(key), "%d.r_frame_rate", index);
+    st->r_frame_rate = get_rational(d, key);
+    snprintf(key, sizeof(key), "%d.codec_time_base", index);
+    st->internal->avctx->time_base = get_rational(d, key);
+    snprintf(key, sizeof(key), "%d.ticks_per_frame", index);
+    st->internal->avctx->ticks_per_frame = get_int(d, key, 1);
+
+    /* let the parser and timestamp code see the cached parameters */
+    st->internal->need_context_update = 1;
+    return 0;
+}
+
+int ff_stream_info_cache_load(AVFormatContext *s)
+{
+    AVDictionary *id = NULL, *d = NULL;
+    AVIOContext *pb = NULL;
+    AVBPrint bp;
+    char path[1024];
+    int i, ret = 0;
+
+    if (cache_path(s, path, sizeof(path)) < 0 ||
+        input_identity(s, &id) < 0)
+        goto end;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    ret = ffio_open_whitelist(&pb, path, AVIO_FLAG_READ, &s->interrupt_callback,
+                              NULL, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret >= 0) {
+        ret = avio_read_to_bprint(pb, &bp, CACHE_MAX_SIZE);
+        avio_closep(&pb);
+    }
+    if (ret >= 0 && av_bprint_is_complete(&bp))
+        ret = av_dict_parse_string(&d, bp.str, "=", "\n", 0);
+    av_bprint_finalize(&bp, NULL);
+    if (ret < 0 || !check_entry(s, id, d)) {
+        av_log(s, AV_LOG_DEBUG, "No stream info cache entry in %s\n", path);
+        ret = 0;
+        goto end;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        ret = apply_stream(s->streams[i], i, d);
+        if (ret < 0)
+            goto end;
+    }
+    s->start_time = get_int(d, "start_time", AV_NOPTS_VALUE);
+    s->duration   = get_int(d, "duration",   AV_NOPTS_VALUE);
+    s->bit_rate   = get_int(d, "bit_rate",   0);
+    s->duration_estimation_method = get_int(d, "duration_estimation_method",
+                                            AVFMT_DURATION_FROM_PTS);
+
+    av_log(s, AV_LOG_VERBOSE, "Stream info loaded from %s\n", path);
+    ret = 1;
+
+end:
+    av_dict_free(&id);
+    av_dict_free(&d);
+    return ret > 0;
+}
+
+static int store_stream(AVStream *st, int index, AVDictionary **d)
+{
+    const AVCodecParameters *par = st->codecpar;
+    char key[64];
+    int i, ret;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(par_fields); i++) {
+        const CacheField *f = &par_fields[i];
+        const uint8_t *src = (const uint8_t *)par + f->offset;
+        int64_t val = f->size == 8 ? (int64_t)AV_RN64(src) : (int32_t)AV_RN32(src);
+
+        snprintf(key, sizeof(key), "%d.par.%s", index, f->name);
+        if ((ret = av_dict_set_int(d, key, val, 0)) < 0)
+            return ret;
+    }
+    snprintf(key, sizeof(key), "%d.par.sample_aspect_ratio", index);
+    if ((ret = set_rational(d, key, par->sample_aspect_ratio)) < 0)
+        return ret;
+
+    if (par->extradata_size > 0) {
+        char *hex = av_malloc(par->extradata_size * 2 + 1);
+        if (!hex)
+            return AVERROR(ENOMEM);
+        ff_data_to_hex(hex, par->extradata, par->extradata_size, 1);
+        hex[par->extradata_size * 2] = 0;
+        snprintf(key, sizeof(key), "%d.par.extradata", index);
+        if ((ret = av_dict_set(d, key, hex, AV_DICT_DONT_STRDUP_VAL)) < 0)
+            return ret;
+    }
+
+    if (st->start_time != AV_NOPTS_VALUE) {
+        snprintf(key, sizeof(key), "%d.start_time", index);
+        if ((ret = av_dict_set_int(d, key, st->start_time, 0)) < 0)
+            return ret;
+    }
+    if (st->duration != AV_NOPTS_VALUE) {
+        snprintf(key, sizeof(key), "%d.duration", index);
+        if ((ret = av_dict_set_int(d, key, st->duration, 0)) < 0)
+            return ret;
+    }
+    snprintf(key, sizeof(key), "%d.disposition", index);
+    if ((ret = av_dict_set_int(d, key, st->disposition, 0)) < 0)
+        return ret;
+    snprintf(key, sizeof(key), "%d.sample_aspect_ratio", index);
+    if ((ret = set_rational(d, key, st->sample_aspect_ratio)) < 0)
+        return ret;
+    snprintf(key, sizeof(key), "%d.avg_frame_rate", index);
+    if ((ret = set_rational(d, key, st->avg_frame_rate)) < 0)
+        return ret;
+    snprintf(key, sizeof(key), "%d.r_frame_rate", index);
+    if ((ret = set_rational(d, key, st->r_frame_rate)) < 0)
+        return ret;
+    snprintf(key, sizeof(key), "%d.codec_time_base", index);
+    if ((ret = set_rational(d, key, st->internal->avctx->time_base)) < 0)
+        return ret;
+    snprintf(key, sizeof(key), "%d.ticks_per_frame", index);
+    return av_dict_set_int(d, key, st->internal->avctx->ticks_per_frame, 0);
+}
+
+void ff_stream_info_cache_store(AVFormatContext *s)
+{
+    AVDictionary *d = NULL;
+    AVIOContext *pb = NULL;
+    char path[1024], tmp[1040];
+    char *str = NULL;
+    int i, ret;
+
+    if (cache_path(s, path, sizeof(path)) < 0 ||
+        input_identity(s, &d) < 0)
+        goto end;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        ret = store_stream(s->streams[i], i, &d);
+        if (ret < 0)
+            goto fail;
+    }
+    if (s->start_time != AV_NOPTS_VALUE &&
+        (ret = av_dict_set_int(&d, "start_time", s->start_time, 0)) < 0)
+        goto fail;
+    if (s->duration != AV_NOPTS_VALUE &&
+        (ret = av_dict_set_int(&d, "duration", s->duration, 0)) < 0)
+        goto fail;
+    if ((ret = av_dict_set_int(&d, "bit_rate", s->bit_rate, 0)) < 0 ||
+        (ret = av_dict_set_int(&d, "duration_estimation_method",
+                               s->duration_estimation_method, 0)) < 0 ||
+        (ret = av_dict_get_string(d, &str, '=', '\n')) < 0)
+        goto fail;
+
+    /* write to a temporary file, so that concurrent readers never see a
+     * partial entry */
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    ret = ffio_open_whitelist(&pb, tmp, AVIO_FLAG_WRITE, &s->interrupt_callback,
+                              NULL, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0)
+        goto fail;
+    avio_write(pb, str, strlen(str));
+    avio_w8(pb, '\n');
+    ret = avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp, path, s);
+
+fail:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not write the stream info cache %s: %s\n",
+               path, av_err2str(ret));
+end:
+    av_freep(&str);
+    av_dict_free(&d);
+}
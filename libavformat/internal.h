@@ -142,6 +142,22 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Pools for the demuxed packet payloads, with AVFMT_FLAG_POOL_PACKETS.
+     */
+    struct FFPacketPool *packet_pool;
+
+    /**
+     * Whether the sidecar seek index was loaded: 0 not tried yet, 1 loaded,
+     * -1 not available.
+     */
+    int seek_index_state;
+
+    /**
+     * Keyframes recorded for the sidecar seek index, muxing only.
+     */
+    struct FFSeekIndexWriter *seek_index_writer;
 };
 
 struct AVStreamInternal {
@@ -772,6 +788,42 @@ int ff_packet_list_get(AVPacketList **head, AVPacketList **tail,
  */
 void ff_packet_list_free(AVPacketList **head, AVPacketList **tail);
 
+/**
+ * Fill in the stream parameters of s from its stream info cache entry.
+ *
+ * @return 1 if a valid entry was found and applied, 0 otherwise
+ */
+int ff_stream_info_cache_load(AVFormatContext *s);
+
+/**
+ * Save the stream parameters of s to its stream info cache. Failures are
+ * only logged.
+ */
+void ff_stream_info_cache_store(AVFormatContext *s);
+
+typedef struct FFSeekIndexWriter FFSeekIndexWriter;
+
+/**
+ * Load the sidecar seek index of the input into the index of its streams,
+ * once. It is AVFormatContext.seek_index, or the input URL with the
+ * ".ffindex" suffix for local mpegts, h264 and hevc files.
+ *
+ * @return 1 if the streams have a complete index from the sidecar, 0 if not
+ */
+int ff_seek_index_load(AVFormatContext *s);
+
+/**
+ * Record a packet about to be written at pos for the sidecar seek index.
+ */
+int ff_seek_index_add(AVFormatContext *s, const AVPacket *pkt, int64_t pos);
+
+/**
+ * Write the recorded keyframes to AVFormatContext.seek_index.
+ */
+int ff_seek_index_write(AVFormatContext *s);
+
+void ff_seek_index_free(AVFormatContext *s);
+
 void avpriv_register_devices(const AVOutputFormat * const o[], const AVInputFormat * const i[]);
 
 #endif /* AVFORMAT_INTERNAL_H */
@@ -0,0 +1,301 @@
+/*
+ * Background I/O worker for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "ioworker.h"
+
+#if HAVE_THREADS
+
+enum IOJobType {
+    IO_JOB_WRITE,
+    IO_JOB_CLOSE,
+    IO_JOB_RENAME,
+};
+
+typedef struct IOJob {
+    enum IOJobType type;
+    AVFormatContext *s;
+    char *url;
+    char *url_dst;
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    AVIOContext *pb;
+} IOJob;
+
+struct FFIOWorker {
+    AVFormatContext *s;
+    AVThreadMessageQueue *queue;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending;
+    int error;
+};
+
+static void free_job(void *msg)
+{
+    IOJob *job = msg;
+
+    av_freep(&job->url);
+    av_freep(&job->url_dst);
+    av_dict_free(&job->options);
+    av_freep(&job->data);
+    if (job->pb)
+        ff_format_io_close(job->s, &job->pb);
+}
+
+static int write_file(FFIOWorker *w, IOJob *job)
+{
+    AVFormatContext *s = w->s;
+    AVDictionary *options = NULL;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    av_dict_copy(&options, job->options, 0);
+    ret = s->io_open(s, &pb, job->url, AVIO_FLAG_WRITE, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return ret;
+    avio_write(pb, job->data, job->size);
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+    return ret;
+}
+
+static int run_job(FFIOWorker *w, IOJob *job)
+{
+    AVFormatContext *s = w->s;
+    int ret;
+
+    switch (job->type) {
+    case IO_JOB_WRITE:
+        ret = write_file(w, job);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "upload of '%s' failed,"
+                   " will retry with a new http session.\n", job->url);
+            ret = write_file(w, job);
+        }
+        break;
+    case IO_JOB_CLOSE:
+        avio_flush(job->pb);
+        ret = job->pb->error;
+        ff_format_io_close(s, &job->pb);
+        break;
+    case IO_JOB_RENAME:
+        ret = ff_rename(job->url, job->url_dst, s);
+        break;
+    default:
+        ret = AVERROR_BUG;
+    }
+    if (ret < 0)
+        av_log(s, AV_LOG_ERROR, "Background I/O on '%s' failed: %s\n",
+               job->url, av_err2str(ret));
+    return ret;
+}
+
+static void *io_worker_thread(void *arg)
+{
+    FFIOWorker *w = arg;
+    IOJob job;
+
+    while (av_thread_message_queue_recv(w->queue, &job, 0) >= 0) {
+        int ret = run_job(w, &job);
+
+        free_job(&job);
+        pthread_mutex_lock(&w->lock);
+        if (ret < 0 && !w->error)
+            w->error = ret;
+        w->pending--;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return NULL;
+}
+
+int ff_io_worker_alloc(FFIOWorker **pw, AVFormatContext *s, int queue_size)
+{
+    FFIOWorker *w;
+    int ret;
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s = s;
+
+    ret = av_thread_message_queue_alloc(&w->queue, FFMAX(queue_size, 1), sizeof(IOJob));
+    if (ret < 0) {
+        av_free(w);
+        return ret;
+    }
+    av_thread_message_queue_set_free_func(w->queue, free_job);
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    ret = pthread_create(&w->thread, NULL, io_worker_thread, w);
+    if (ret) {
+        av_thread_message_queue_free(&w->queue);
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        av_free(w);
+        return AVERROR(ret);
+    }
+
+    *pw = w;
+    return 0;
+}
+
+static int queue_job(FFIOWorker *w, IOJob *job)
+{
+    int ret;
+
+    pthread_mutex_lock(&w->lock);
+    w->pending++;
+    pthread_mutex_unlock(&w->lock);
+
+    ret = av_thread_message_queue_send(w->queue, job, 0);
+
+    pthread_mutex_lock(&w->lock);
+    if (ret < 0) {
+        free_job(job);
+        w->pending--;
+    } else {
+        ret = w->error;
+        w->error = 0;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+int ff_io_worker_write(FFIOWorker *w, const char *url, AVDictionary *options,
+                       uint8_t *data, int size)
+{
+    IOJob job = { IO_JOB_WRITE };
+
+    job.data = data;
+    job.size = size;
+    job.url  = av_strdup(url);
+    if (!job.url || av_dict_copy(&job.options, options, 0) < 0) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return queue_job(w, &job);
+}
+
+int ff_io_worker_close(FFIOWorker *w, AVIOContext *pb, const char *url)
+{
+    IOJob job = { IO_JOB_CLOSE };
+
+    job.s   = w->s;
+    job.pb  = pb;
+    job.url = av_strdup(url);
+    if (!job.url) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return queue_job(w, &job);
+}
+
+int ff_io_worker_rename(FFIOWorker *w, const char *url_src, const char *url_dst)
+{
+    IOJob job = { IO_JOB_RENAME };
+
+    job.url     = av_strdup(url_src);
+    job.url_dst = av_strdup(url_dst);
+    if (!job.url || !job.url_dst) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    return queue_job(w, &job);
+}
+
+int ff_io_worker_flush(FFIOWorker *w)
+{
+    int ret;
+
+    pthread_mutex_lock(&w->lock);
+    while (w->pending > 0)
+        pthread_cond_wait(&w->cond, &w->lock);
+    ret = w->error;
+    w->error = 0;
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+void ff_io_worker_free(FFIOWorker **pw)
+{
+    FFIOWorker *w = *pw;
+
+    if (!w)
+        return;
+
+    av_thread_message_queue_set_err_recv(w->queue, AVERROR_EOF);
+    pthread_join(w->thread, NULL);
+    av_thread_message_queue_free(&w->queue);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    av_freep(pw);
+}
+
+#else
+
+int ff_io_worker_alloc(FFIOWorker **pw, AVFormatContext *s, int queue_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_io_worker_write(FFIOWorker *w, const char *url, AVDictionary *options,
+                       uint8_t *data, int size)
+{
+    av_free(data);
+    return AVERROR(ENOSYS);
+}
+
+int ff_io_worker_close(FFIOWorker *w, AVIOContext *pb, const char *url)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_io_worker_rename(FFIOWorker *w, const char *url_src, const char *url_dst)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_io_worker_flush(FFIOWorker *w)
+{
+    return 0;
+}
+
+void ff_io_worker_free(FFIOWorker **pw)
+{
+}
+
+#endif /* HAVE_THREADS */
@@ -0,0 +1,82 @@
+/*
+ * Background I/O worker for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_IOWORKER_H
+#define AVFORMAT_IOWORKER_H
+
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * A single thread executing output jobs (uploads, closes, renames) in the
+ * order they were queued, so that a muxer can hand off a finished segment
+ * and its playlist without blocking on the output protocol.
+ *
+ * Files are opened and closed through the io_open/io_close callbacks of the
+ * AVFormatContext given to ff_io_worker_alloc().
+ */
+typedef struct FFIOWorker FFIOWorker;
+
+/**
+ * Start a worker.
+ *
+ * @param queue_size maximum number of pending jobs; queuing blocks while
+ *                   the queue is full
+ * @return 0 on success, AVERROR(ENOSYS) if built without thread support
+ */
+int ff_io_worker_alloc(FFIOWorker **pw, AVFormatContext *s, int queue_size);
+
+/**
+ * Queue a write of a complete file. The data must have been allocated with
+ * av_malloc() and is owned by the worker afterwards; the options are copied.
+ * The upload is retried once with a new connection if it fails.
+ *
+ * All queuing functions return a negative AVERROR code if queuing failed
+ * or if a previously queued job failed since the last call; the latter
+ * error is only reported once.
+ */
+int ff_io_worker_write(FFIOWorker *w, const char *url, AVDictionary *options,
+                       uint8_t *data, int size);
+
+/**
+ * Queue flushing and closing an open output context, which is owned by the
+ * worker afterwards. The url is only used for error messages.
+ */
+int ff_io_worker_close(FFIOWorker *w, AVIOContext *pb, const char *url);
+
+/**
+ * Queue a rename, see ff_rename().
+ */
+int ff_io_worker_rename(FFIOWorker *w, const char *url_src, const char *url_dst);
+
+/**
+ * Wait until all queued jobs are done.
+ *
+ * @return the first error of a job not yet reported, 0 otherwise
+ */
+int ff_io_worker_flush(FFIOWorker *w);
+
+/**
+ * Run the remaining jobs, stop the worker and free it.
+ */
+void ff_io_worker_free(FFIOWorker **pw);
+
+#endif /* AVFORMAT_IOWORKER_H */
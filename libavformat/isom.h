@@ -155,6 +155,26 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Position in the sample tables of a track, used to resolve samples on
+ * demand instead of expanding them into the AVStream index.
+ */
+typedef struct MOVSampleCursor {
+    AVIndexEntry entry;         ///< the sample at this position
+    unsigned int sample;
+    unsigned int chunk;
+    unsigned int chunk_sample;
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int rap_group_index;
+    unsigned int rap_group_sample;
+    unsigned int distance;
+    int64_t dts_correction;
+} MOVSampleCursor;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -193,6 +213,18 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    /**
+     * Compact index: st->index_entries only holds the first sample and
+     * the keyframes, cursor_index the table positions of these entries.
+     */
+    int compact_index;
+    unsigned int nb_samples;      ///< number of samples of a compact index
+    int all_keyframes;            ///< every sample is a keyframe without stss (audio)
+    MOVSampleCursor *cursor_index;
+    unsigned int nb_cursor_index;
+    unsigned int cursor_index_allocated_size;
+    MOVSampleCursor cursor;       ///< current sample of a compact index
+    MOVSampleCursor cursor_prev;
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -267,6 +299,7 @@ typedef struct MOVContext {
     int use_absolute_path;
     int ignore_editlist;
     int advanced_editlist;
+    int compact_index;
     int ignore_chapters;
     int seek_individually;
     int64_t next_root_atom; ///< offset of the next root atom
@@ -338,6 +338,12 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+typedef struct MatroskaCueRange {
+    int64_t start, end;         ///< byte range of the Cues read
+    int64_t last_start;         ///< position of the last CuePoint read
+    int64_t first_time, last_time;
+} MatroskaCueRange;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -377,6 +383,12 @@ typedef struct MatroskaDemuxContext {
     /* File has a CUES element, but we defer parsing until it is needed. */
     int cues_parsing_deferred;
 
+    /* Payload of the CUES element and the parts of it read so far,
+     * when loading it lazily. */
+    int64_t cues_start, cues_end;
+    MatroskaCueRange *cue_ranges;
+    int nb_cue_ranges;
+
     /* Level1 elements and whether they were read yet */
     MatroskaLevel1Element level1_elems[64];
     int num_level1_elems;
@@ -388,6 +400,9 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    int lazy_cues;
+    int cluster_seek;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -1401,6 +1416,15 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
+        if (id == MATROSKA_ID_CUES && matroska->lazy_cues &&
+            matroska->cues_parsing_deferred > 0 &&
+            length != EBML_UNKNOWN_LENGTH) {
+            // only remember where the cues are, they are read on demand
+            level1_elem = matroska_find_level1_elem(matroska, id, pos);
+            if (level1_elem && !level1_elem->pos)
+                level1_elem->pos = pos;
+            goto skip;
+        }
         if ((res = ebml_read_master(matroska, length, pos_alt)) < 0)
             return res;
         if (id == MATROSKA_ID_SEGMENT)
@@ -1943,6 +1967,308 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     matroska_add_index_entries(matroska);
 }
 
+#define CUES_CHUNK_SIZE (64 * 1024)
+#define SEEK_PROBE_SIZE 4096
+
+/*
+ * Read an EBML number from a buffer. Unlike ebml_read_num(), invalid data
+ * is not logged, as the buffers searched for cue points and clusters may
+ * start anywhere.
+ */
+static int ebml_buf_read_num(const uint8_t **p, const uint8_t *end,
+                             int max_size, int keep_marker, uint64_t *number)
+{
+    uint64_t total;
+    int n, read;
+
+    if (*p >= end || !**p)
+        return AVERROR_INVALIDDATA;
+    read = 8 - ff_log2_tab[**p];
+    if (read > max_size || end - *p < read)
+        return AVERROR_INVALIDDATA;
+    total = keep_marker ? **p : **p & (0xFF >> read);
+    for (n = 1; n < read; n++)
+        total = (total << 8) | (*p)[n];
+    *p     += read;
+    *number = total;
+    return read;
+}
+
+static int ebml_buf_read_header(const uint8_t **p, const uint8_t *end,
+                                uint32_t *id, uint64_t *length)
+{
+    uint64_t num;
+
+    if (ebml_buf_read_num(p, end, 4, 1, &num) < 0 ||
+        ebml_buf_read_num(p, end, 8, 0, length) < 0 ||
+        *length > end - *p)
+        return AVERROR_INVALIDDATA;
+    *id = num;
+    return 0;
+}
+
+static uint64_t ebml_buf_read_uint(const uint8_t *p, int size)
+{
+    uint64_t num = 0;
+
+    while (size--)
+        num = (num << 8) | *p++;
+    return num;
+}
+
+/*
+ * Parse the CuePoint at the start of buf. Its time is returned in *time;
+ * if add is set, *time is used as the time of the index entries added for
+ * its positions instead, as the CueTime may follow the positions.
+ *
+ * @return the size of the CuePoint, or a negative value if it is invalid
+ */
+static int matroska_parse_cue_point(MatroskaDemuxContext *matroska,
+                                    const uint8_t *buf, const uint8_t *end,
+                                    int64_t *time, int add)
+{
+    const uint8_t *p = buf, *cue_end;
+    int64_t cue_time = -1;
+    uint64_t length;
+    uint32_t id;
+    int nb_pos = 0;
+
+    if (ebml_buf_read_header(&p, end, &id, &length) < 0 ||
+        id != MATROSKA_ID_POINTENTRY)
+        return AVERROR_INVALIDDATA;
+    cue_end = p + length;
+
+    while (p < cue_end) {
+        const uint8_t *elem_end;
+
+        if (ebml_buf_read_header(&p, cue_end, &id, &length) < 0)
+            return AVERROR_INVALIDDATA;
+        elem_end = p + length;
+        if (id == MATROSKA_ID_CUETIME && length <= 7) {
+            cue_time = ebml_buf_read_uint(p, length);
+        } else if (id == MATROSKA_ID_CUETRACKPOSITION) {
+            uint64_t track = 0, pos = UINT64_MAX;
+
+            while (p < elem_end) {
+                if (ebml_buf_read_header(&p, elem_end, &id, &length) < 0)
+                    return AVERROR_INVALIDDATA;
+                if (id == MATROSKA_ID_CUETRACK && length <= 8)
+                    track = ebml_buf_read_uint(p, length);
+                else if (id == MATROSKA_ID_CUECLUSTERPOSITION && length <= 8)
+                    pos = ebml_buf_read_uint(p, length);
+                p += length;
+            }
+            if (!track || pos > INT64_MAX - matroska->segment_start)
+                return AVERROR_INVALIDDATA;
+            nb_pos++;
+
+            if (add) {
+                MatroskaTrack *track_entry = matroska_find_track_by_num(matroska, track);
+                if (track_entry && track_entry->stream)
+                    av_add_index_entry(track_entry->stream,
+                                       pos + matroska->segment_start, *time,
+                                       0, 0, AVINDEX_KEYFRAME);
+            }
+        }
+        p = elem_end;
+    }
+    if (cue_time < 0 || !nb_pos)
+        return AVERROR_INVALIDDATA;
+    if (!add)
+        *time = cue_time;
+    return p - buf;
+}
+
+/*
+ * Find the first CuePoint starting in [pos, end) of the Cues and read its
+ * time. A candidate only counts if it is followed by another CuePoint or
+ * Void element, or ends where the read data does.
+ *
+ * @return 1 if one was found, 0 if not, a negative value on error
+ */
+static int matroska_probe_cue_point(MatroskaDemuxContext *matroska,
+                                    int64_t pos, int64_t end,
+                                    int64_t *cue_pos, int64_t *cue_time)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint8_t buf[SEEK_PROBE_SIZE];
+    int i, size = FFMIN(SEEK_PROBE_SIZE, matroska->cues_end - pos);
+
+    if (avio_seek(pb, pos, SEEK_SET) != pos)
+        return AVERROR(EIO);
+    if ((size = avio_read(pb, buf, size)) < 0)
+        return size;
+
+    for (i = 0; i < size && pos + i < end; i++) {
+        int len;
+
+        if (buf[i] != MATROSKA_ID_POINTENTRY)
+            continue;
+        len = matroska_parse_cue_point(matroska, buf + i, buf + size, cue_time, 0);
+        if (len < 0)
+            continue;
+        if (i + len == size ||
+            buf[i + len] == MATROSKA_ID_POINTENTRY || buf[i + len] == EBML_ID_VOID) {
+            *cue_pos = pos + i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Read the CuePoints in [start, stop) and the first one after stop into
+ * the index.
+ */
+static int matroska_read_cue_range(MatroskaDemuxContext *matroska,
+                                   int64_t start, int64_t stop)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaCueRange range = { .start = start, .first_time = AV_NOPTS_VALUE };
+    int size = FFMIN(matroska->cues_end, stop + SEEK_PROBE_SIZE) - start;
+    const uint8_t *p, *end;
+    uint8_t *buf;
+    int ret;
+
+    if (!(buf = av_malloc(size)))
+        return AVERROR(ENOMEM);
+    if (avio_seek(pb, start, SEEK_SET) != start) {
+        ret = AVERROR(EIO);
+        goto end;
+    }
+    if ((size = avio_read(pb, buf, size)) < 0) {
+        ret = size;
+        goto end;
+    }
+
+    p   = buf;
+    end = buf + size;
+    while (p < end) {
+        const uint8_t *next = p;
+        int64_t pos = start + (p - buf), time;
+        uint64_t length;
+        uint32_t id;
+
+        if (ebml_buf_read_header(&next, end, &id, &length) < 0)
+            break;
+        next += length;
+        // skip the CRC-32 and Void elements
+        if (id == MATROSKA_ID_POINTENTRY) {
+            if (matroska_parse_cue_point(matroska, p, end, &time, 0) < 0)
+                break;
+            matroska_parse_cue_point(matroska, p, end, &time, 1);
+            if (range.first_time == AV_NOPTS_VALUE)
+                range.first_time = time;
+            range.last_time  = time;
+            range.last_start = pos;
+            if (pos >= stop) {
+                p = next;
+                break;
+            }
+        }
+        p = next;
+    }
+    range.end = start + (p - buf);
+
+    ret = 0;
+    if (range.first_time != AV_NOPTS_VALUE &&
+        (ret = av_reallocp_array(&matroska->cue_ranges, matroska->nb_cue_ranges + 1,
+                                 sizeof(*matroska->cue_ranges))) >= 0)
+        matroska->cue_ranges[matroska->nb_cue_ranges++] = range;
+    else if (ret < 0)
+        matroska->nb_cue_ranges = 0;
+end:
+    av_free(buf);
+    return ret;
+}
+
+static int matroska_has_cues(MatroskaDemuxContext *matroska)
+{
+    int i;
+
+    for (i = 0; i < matroska->num_level1_elems; i++)
+        if (matroska->level1_elems[i].id == MATROSKA_ID_CUES &&
+            matroska->level1_elems[i].pos)
+            return 1;
+    return 0;
+}
+
+static int matroska_locate_cues(MatroskaDemuxContext *matroska)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint64_t id, length;
+    int i, res;
+
+    for (i = 0; i < matroska->num_level1_elems; i++) {
+        MatroskaLevel1Element *elem = &matroska->level1_elems[i];
+        if (elem->id != MATROSKA_ID_CUES || !elem->pos || elem->parsed)
+            continue;
+
+        if (avio_seek(pb, elem->pos, SEEK_SET) != elem->pos)
+            return AVERROR(EIO);
+        if ((res = ebml_read_num(matroska, pb, 4, &id, 1)) < 0)
+            return res;
+        if ((id | 1ULL << 7 * res) != MATROSKA_ID_CUES)
+            return AVERROR_INVALIDDATA;
+        if ((res = ebml_read_length(matroska, pb, &length)) < 0)
+            return res;
+        if (length == EBML_UNKNOWN_LENGTH)
+            return AVERROR_INVALIDDATA;
+        matroska->cues_start = avio_tell(pb);
+        matroska->cues_end   = matroska->cues_start + length;
+        return 0;
+    }
+    return AVERROR(ENOENT);
+}
+
+/*
+ * Make sure the index contains the cue points around ts, by bisecting the
+ * Cues down to CUES_CHUNK_SIZE bytes and reading only those.
+ */
+static int matroska_load_cues(MatroskaDemuxContext *matroska, int64_t ts)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t before_pos = avio_tell(pb), lo, hi;
+    int i, ret = 0;
+
+    if (matroska->ctx->flags & AVFMT_FLAG_IGNIDX)
+        return 0;
+
+    if (!matroska->cues_end && (ret = matroska_locate_cues(matroska)) < 0)
+        goto end;
+
+    lo = matroska->cues_start;
+    hi = matroska->cues_end;
+    for (i = 0; i < matroska->nb_cue_ranges; i++) {
+        const MatroskaCueRange *range = &matroska->cue_ranges[i];
+        if ((range->first_time <= ts || range->start == matroska->cues_start) &&
+            (range->last_time   > ts || range->end   == matroska->cues_end))
+            goto end;
+        if (range->last_time <= ts)
+            lo = FFMAX(lo, range->last_start);
+        else if (range->first_time > ts)
+            hi = FFMIN(hi, range->start);
+    }
+
+    while (hi - lo > CUES_CHUNK_SIZE) {
+        int64_t mid = lo + (hi - lo) / 2, pos, time;
+
+        if ((ret = matroska_probe_cue_point(matroska, mid, hi, &pos, &time)) < 0)
+            goto end;
+        if (!ret)
+            hi = mid;
+        else if (time <= ts)
+            lo = pos;
+        else
+            hi = pos;
+    }
+    ret = matroska_read_cue_range(matroska, lo, hi);
+
+end:
+    avio_seek(pb, before_pos, SEEK_SET);
+    return ret;
+}
+
 static int matroska_aac_profile(char *codec_id)
 {
     static const char *const aac_profiles[] = { "MAIN", "LC", "SSR" };
@@ -3755,6 +4081,130 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
+/*
+ * Find the first Cluster starting in [pos, end) and read its Timestamp,
+ * which is expected as its first child, possibly after a CRC-32 or Void.
+ *
+ * @return 1 if one was found, 0 if not, a negative value on error
+ */
+static int matroska_probe_cluster(MatroskaDemuxContext *matroska,
+                                  int64_t pos, int64_t end,
+                                  int64_t *cluster_pos, int64_t *cluster_time)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    uint8_t buf[SEEK_PROBE_SIZE];
+    int i, size;
+
+    // the windows overlap so that a cluster header is always read whole
+    for (; pos < end; pos += SEEK_PROBE_SIZE - 32) {
+        if (avio_seek(pb, pos, SEEK_SET) != pos)
+            return AVERROR(EIO);
+        if ((size = avio_read(pb, buf, sizeof(buf))) < 0)
+            return size == AVERROR_EOF ? 0 : size;
+
+        for (i = 0; i + 4 <= size && pos + i < end; i++) {
+            const uint8_t *p = buf + i + 4;
+            uint64_t length;
+            uint32_t id;
+
+            if (AV_RB32(buf + i) != MATROSKA_ID_CLUSTER ||
+                ebml_buf_read_num(&p, buf + size, 8, 0, &length) < 0)
+                continue;
+            while (ebml_buf_read_header(&p, buf + size, &id, &length) >= 0) {
+                if (id == MATROSKA_ID_CLUSTERTIMECODE && length <= 7) {
+                    *cluster_pos  = pos + i;
+                    *cluster_time = ebml_buf_read_uint(p, length);
+                    return 1;
+                }
+                if (id != EBML_ID_CRC32 && id != EBML_ID_VOID)
+                    break;
+                p += length;
+            }
+        }
+        if (size < sizeof(buf))
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Find the last Cluster with a timestamp not after ts by bisecting the
+ * Clusters of the segment.
+ */
+static int matroska_bisect_clusters(MatroskaDemuxContext *matroska, int64_t ts,
+                                    int64_t *cluster_pos, int64_t *cluster_time)
+{
+    AVFormatContext *s = matroska->ctx;
+    MatroskaLevel *segment = &matroska->levels[0];
+    int64_t lo = s->internal->data_offset, hi, lo_time;
+    int ret;
+
+    if (matroska->num_levels && segment->length != EBML_UNKNOWN_LENGTH)
+        hi = segment->start + segment->length;
+    else if ((hi = avio_size(s->pb)) < 0)
+        return hi;
+
+    if ((ret = matroska_probe_cluster(matroska, lo, lo + 1, &lo, &lo_time)) <= 0)
+        return ret < 0 ? ret : AVERROR_INVALIDDATA;
+
+    while (hi - lo > SEEK_PROBE_SIZE) {
+        int64_t mid = lo + (hi - lo) / 2, pos, time;
+
+        if ((ret = matroska_probe_cluster(matroska, mid, hi, &pos, &time)) < 0)
+            return ret;
+        if (!ret) {
+            hi = mid;
+        } else if (time <= ts) {
+            lo      = pos;
+            lo_time = time;
+        } else
+            hi = pos;
+    }
+    *cluster_pos  = lo;
+    *cluster_time = lo_time;
+    return 0;
+}
+
+/*
+ * Seek without Cues: index the keyframes of the clusters around ts, found
+ * by bisection, and return the index entry to seek to.
+ */
+static int matroska_seek_clusters(MatroskaDemuxContext *matroska, AVStream *st,
+                                  int64_t ts, int flags)
+{
+    MatroskaCluster *cluster = &matroska->current_cluster;
+    int64_t first_pos = matroska->ctx->internal->data_offset;
+    int64_t target = ts, stop = INT64_MAX, pos, time;
+    int i, index, ret;
+
+    for (i = 0; i < 32; i++) {
+        if ((ret = matroska_bisect_clusters(matroska, target, &pos, &time)) < 0)
+            return ret;
+
+        matroska_reset_status(matroska, 0, pos);
+        while (matroska_parse_cluster(matroska) >= 0) {
+            matroska_clear_queue(matroska);
+            if (cluster->pos != pos &&
+                (cluster->pos >= stop || (int64_t)cluster->timecode > ts))
+                break;
+        }
+        matroska_clear_queue(matroska);
+        matroska->done = 0;
+
+        // entries before pos may be from reading far earlier
+        index = av_index_search_timestamp(st, ts, flags);
+        if (index >= 0 && st->index_entries[index].pos >= pos)
+            return index;
+        if (pos <= first_pos)
+            return av_index_search_timestamp(st, ts, flags & ~AVSEEK_FLAG_BACKWARD);
+        // no keyframe of this stream in the clusters read, so look back
+        // twice as far, reading only up to where the last attempt started
+        stop   = pos;
+        target = time - FFMAX(ts - time, 1);
+    }
+    return AVERROR_INVALIDDATA;
+}
+
 static int matroska_read_seek(AVFormatContext *s, int stream_index,
                               int64_t timestamp, int flags)
 {
@@ -3764,11 +4214,19 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     int i, index;
 
     /* Parse the CUES now since we need the index data to seek. */
-    if (matroska->cues_parsing_deferred > 0) {
+    if (matroska->cues_parsing_deferred > 0 &&
+        (!matroska->lazy_cues || matroska_load_cues(matroska, timestamp) < 0)) {
         matroska->cues_parsing_deferred = 0;
         matroska_parse_cues(matroska);
     }
 
+    if (matroska->cluster_seek && !matroska_has_cues(matroska) &&
+        (s->pb->seekable & AVIO_SEEKABLE_NORMAL) && s->internal->data_offset) {
+        if ((index = matroska_seek_clusters(matroska, st, timestamp, flags)) < 0)
+            goto err;
+        goto found;
+    }
+
     if (!st->nb_index_entries)
         goto err;
     timestamp = FFMAX(timestamp, st->index_entries[0].timestamp);
@@ -3786,6 +4244,7 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     if (index < 0 || (matroska->cues_parsing_deferred < 0 && index == st->nb_index_entries - 1))
         goto err;
 
+found:
     tracks = matroska->tracks.elem;
     for (i = 0; i < matroska->tracks.nb_elem; i++) {
         tracks[i].audio.pkt_cnt        = 0;
@@ -3831,6 +4290,7 @@ static int matroska_read_close(AVFormatContext *s)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
             av_freep(&tracks[n].audio.buf);
     ebml_free(matroska_segment, matroska);
+    av_freep(&matroska->cue_ranges);
 
     return 0;
 }
@@ -4241,6 +4701,19 @@ static const AVOption options[] = {
     { NULL },
 };
 
+static const AVOption matroska_options[] = {
+    { "lazy_cues", "read only the parts of the cues needed for seeking", OFFSET(lazy_cues), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "cluster_seek", "seek by bisecting the clusters in files without cues", OFFSET(cluster_seek), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 static const AVClass webm_dash_class = {
     .class_name = "WebM DASH Manifest demuxer",
     .item_name  = av_default_item_name,
@@ -4258,7 +4731,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
@@ -100,6 +100,7 @@ typedef struct mkv_cuepoint {
 typedef struct mkv_cues {
     mkv_cuepoint   *entries;
     int             num_entries;
+    unsigned        entries_size;   ///< allocated size of entries in bytes
 } mkv_cues;
 
 typedef struct mkv_track {
@@ -536,7 +537,10 @@ static int mkv_add_cuepoint(MatroskaMuxContext *mkv, int stream, int64_t ts,
     if (ts < 0)
         return 0;
 
-    entries = av_realloc_array(entries, cues->num_entries + 1, sizeof(mkv_cuepoint));
+    if ((unsigned)cues->num_entries + 1 > UINT_MAX / sizeof(mkv_cuepoint))
+        return AVERROR(ENOMEM);
+    entries = av_fast_realloc(entries, &cues->entries_size,
+                              (cues->num_entries + 1) * sizeof(mkv_cuepoint));
     if (!entries)
         return AVERROR(ENOMEM);
     cues->entries = entries;
@@ -2455,7 +2459,7 @@ static int mkv_write_trailer(AVFormatContext *s)
     MatroskaMuxContext *mkv = s->priv_data;
     AVIOContext *pb = s->pb;
     int64_t endpos, ret64;
-    int ret, ret2 = 0;
+    int ret;
 
     // check if we have an audio packet cached
     if (mkv->cur_audio_pkt.size > 0) {
@@ -2486,6 +2490,7 @@ static int mkv_write_trailer(AVFormatContext *s)
     if (mkv->cues.num_entries && mkv->reserve_cues_space >= 0) {
         AVIOContext *cues = NULL;
         uint64_t size;
+        int64_t cues_start;
         int length_size = 0;
 
         ret = start_ebml_master_crc32(&cues, mkv);
@@ -2504,12 +2509,15 @@ static int mkv_write_trailer(AVFormatContext *s)
             length_size = ebml_length_size(size);
             size += 4 + length_size;
             if (mkv->reserve_cues_space < size) {
+                /* Appending the Cues only costs updating the SeekHead,
+                 * which is rewritten below anyway. The reserved space
+                 * stays behind as an EBML Void element. */
                 av_log(s, AV_LOG_WARNING,
                        "Insufficient space reserved for Cues: "
-                       "%d < %"PRIu64". No Cues will be output.\n",
+                       "%d < %"PRIu64". Writing them at the end instead.\n",
                        mkv->reserve_cues_space, size);
-                ret2 = AVERROR(EINVAL);
-                goto after_cues;
+                mkv->reserve_cues_space = 0;
+                length_size = 0;
             } else {
                 if ((ret64 = avio_seek(pb, mkv->cues_pos, SEEK_SET)) < 0) {
                     ffio_free_dyn_buf(&cues);
@@ -2526,10 +2534,13 @@ static int mkv_write_trailer(AVFormatContext *s)
                 }
             }
         }
+        cues_start = avio_tell(pb);
         ret = end_ebml_master_crc32(pb, &cues, mkv, MATROSKA_ID_CUES,
                                     length_size, 0, 1);
         if (ret < 0)
             return ret;
+        av_log(s, AV_LOG_VERBOSE, "Cues: %d entries, %"PRId64" bytes\n",
+               mkv->cues.num_entries, avio_tell(pb) - cues_start);
         if (mkv->reserve_cues_space) {
             if (size < mkv->reserve_cues_space)
                 put_ebml_void(pb, mkv->reserve_cues_space - size);
@@ -2537,7 +2548,6 @@ static int mkv_write_trailer(AVFormatContext *s)
             endpos = avio_tell(pb);
     }
 
-after_cues:
     /* Lengths greater than (1ULL << 56) - 1 can't be represented
      * via an EBML number, so leave the unknown length field. */
     if (endpos - mkv->segment_offset < (1ULL << 56) - 1) {
@@ -2603,7 +2613,7 @@ after_cues:
 
     avio_seek(pb, endpos, SEEK_SET);
 
-    return ret2;
+    return 0;
 }
 
 static int mkv_query_codec(enum AVCodecID codec_id, int std_compliance)
@@ -3400,8 +3400,143 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
     }
 }
 
+#define MOV_COMPACT_INDEX_DISTANCE 64
+
+/**
+ * Move the cursor to the next chunk holding samples, starting at c->chunk.
+ */
+static void mov_cursor_enter_chunk(MOVStreamContext *sc, MOVSampleCursor *c)
+{
+    for (; c->chunk < sc->chunk_count; c->chunk++) {
+        while (mov_stsc_index_valid(c->stsc_index, sc->stsc_count) &&
+               c->chunk + 1 == sc->stsc_data[c->stsc_index + 1].first)
+            c->stsc_index++;
+        if (sc->stsc_data[c->stsc_index].count)
+            break;
+    }
+    c->chunk_sample = 0;
+    if (c->chunk < sc->chunk_count)
+        c->entry.pos = sc->chunk_offsets[c->chunk];
+}
+
+/**
+ * Fill in size and flags of the sample at the cursor, its position and
+ * timestamp are set by mov_cursor_advance().
+ */
+static void mov_cursor_load(MOVStreamContext *sc, MOVSampleCursor *c)
+{
+    int rap_group_present = sc->rap_group_count && sc->rap_group;
+    int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+    int keyframe = 0;
+
+    if (!sc->keyframe_absent && (!sc->keyframe_count || c->sample + key_off == sc->keyframes[c->stss_index])) {
+        keyframe = 1;
+        if (c->stss_index + 1 < sc->keyframe_count)
+            c->stss_index++;
+    } else if (sc->stps_count && c->sample + key_off == sc->stps_data[c->stps_index]) {
+        keyframe = 1;
+        if (c->stps_index + 1 < sc->stps_count)
+            c->stps_index++;
+    }
+    if (rap_group_present && c->rap_group_index < sc->rap_group_count) {
+        if (sc->rap_group[c->rap_group_index].index > 0)
+            keyframe = 1;
+        if (++c->rap_group_sample == sc->rap_group[c->rap_group_index].count) {
+            c->rap_group_sample = 0;
+            c->rap_group_index++;
+        }
+    }
+    if (sc->keyframe_absent
+        && !sc->stps_count
+        && !rap_group_present
+        && (sc->all_keyframes || (c->chunk == 0 && c->chunk_sample == 0)))
+        keyframe = 1;
+    if (keyframe)
+        c->distance = 0;
+
+    c->entry.size         = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[c->sample];
+    c->entry.min_distance = c->distance;
+    c->entry.flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+}
+
+/**
+ * Step the cursor past the current sample, following the timestamp rules
+ * of mov_build_index().
+ */
+static void mov_cursor_advance(MOVStreamContext *sc, MOVSampleCursor *c)
+{
+    int64_t last_dts = c->entry.timestamp;
+    int64_t dts = last_dts;
+    int duration = sc->stts_data[c->stts_index].duration;
+
+    c->entry.pos += c->entry.size;
+
+    /* A negative sample duration only corrects the DTS at its first use,
+     * the remaining samples of the stts entry are 1 tick long. */
+    if (duration < 0) {
+        if (!c->stts_sample)
+            c->dts_correction += duration - 1;
+        duration = 1;
+    }
+    dts += duration;
+    if (!c->dts_correction || dts + c->dts_correction > last_dts) {
+        dts += c->dts_correction;
+        c->dts_correction = 0;
+    } else {
+        /* Avoid creating non-monotonous DTS */
+        c->dts_correction += dts - last_dts - 1;
+        dts = last_dts + 1;
+    }
+    c->entry.timestamp = dts;
+    c->distance++;
+    c->stts_sample++;
+    c->sample++;
+    if (c->stts_index + 1 < sc->stts_count && c->stts_sample == sc->stts_data[c->stts_index].count) {
+        c->stts_sample = 0;
+        c->stts_index++;
+    }
+
+    if (++c->chunk_sample == sc->stsc_data[c->stsc_index].count) {
+        c->chunk++;
+        mov_cursor_enter_chunk(sc, c);
+    }
+}
+
+static void mov_cursor_next(MOVStreamContext *sc, MOVSampleCursor *c)
+{
+    mov_cursor_advance(sc, c);
+    if (c->sample < sc->nb_samples)
+        mov_cursor_load(sc, c);
+}
+
+/**
+ * Position the cursor of a compact index on the given sample.
+ */
+static void mov_cursor_seek(MOVStreamContext *sc, unsigned int sample)
+{
+    int lo = 0, hi = sc->nb_cursor_index - 1;
+
+    if (sc->cursor.sample == sample)
+        return;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (sc->cursor_index[mid].sample <= sample)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    if (sc->cursor.sample < sc->cursor_index[lo].sample || sc->cursor.sample > sample)
+        sc->cursor = sc->cursor_index[lo];
+    while (sc->cursor.sample < sample && sc->cursor.sample < sc->nb_samples)
+        mov_cursor_next(sc, &sc->cursor);
+}
+
 static void mov_current_sample_inc(MOVStreamContext *sc)
 {
+    if (sc->compact_index) {
+        sc->cursor_prev = sc->cursor;
+        mov_cursor_next(sc, &sc->cursor);
+    }
     sc->current_sample++;
     sc->current_index++;
     if (sc->index_ranges &&
@@ -3414,6 +3549,12 @@ static void mov_current_sample_inc(MOVStreamContext *sc)
 
 static void mov_current_sample_dec(MOVStreamContext *sc)
 {
+    if (sc->compact_index) {
+        if (sc->cursor_prev.sample + 1 == sc->cursor.sample)
+            sc->cursor = sc->cursor_prev;
+        else
+            mov_cursor_seek(sc, sc->cursor.sample - 1);
+    }
     sc->current_sample--;
     sc->current_index--;
     if (sc->index_ranges &&
@@ -3428,6 +3569,8 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
 {
     int64_t range_size;
 
+    if (sc->compact_index)
+        mov_cursor_seek(sc, current_sample);
     sc->current_sample = current_sample;
     sc->current_index = current_sample;
     if (!sc->index_ranges) {
@@ -3756,6 +3899,261 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+/**
+ * Expand ctts entries such that we have a 1-1 mapping with samples.
+ */
+static int mov_expand_ctts(MOVStreamContext *sc)
+{
+    MOVStts *ctts_data_old = sc->ctts_data;
+    unsigned int ctts_count_old = sc->ctts_count;
+    unsigned int i, j;
+
+    if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
+        return AVERROR(EINVAL);
+    sc->ctts_count = 0;
+    sc->ctts_allocated_size = 0;
+    sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
+                            sc->sample_count * sizeof(*sc->ctts_data));
+    if (!sc->ctts_data) {
+        av_free(ctts_data_old);
+        return AVERROR(ENOMEM);
+    }
+
+    memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
+
+    for (i = 0; i < ctts_count_old &&
+                sc->ctts_count < sc->sample_count; i++)
+        for (j = 0; j < ctts_data_old[i].count &&
+                    sc->ctts_count < sc->sample_count; j++)
+            add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
+                           &sc->ctts_allocated_size, 1,
+                           ctts_data_old[i].duration);
+    av_free(ctts_data_old);
+    return 0;
+}
+
+/**
+ * Check that no sample is dropped for belonging to another stsd entry.
+ */
+static int mov_all_samples_used(MOVStreamContext *sc)
+{
+    unsigned int i;
+
+    if (sc->pseudo_stream_id == -1)
+        return 1;
+    for (i = 0; i < sc->stsc_count; i++)
+        if (sc->stsc_data[i].id - 1 != sc->pseudo_stream_id)
+            return 0;
+    return 1;
+}
+
+static int mov_add_cursor_entry(AVStream *st, const MOVSampleCursor *c)
+{
+    MOVStreamContext *sc = st->priv_data;
+    AVIndexEntry *entries;
+    MOVSampleCursor *cursors;
+
+    if (sc->nb_cursor_index >= UINT_MAX / sizeof(*cursors) - 1)
+        return AVERROR(ENOMEM);
+
+    entries = av_fast_realloc(st->index_entries, &st->index_entries_allocated_size,
+                              (st->nb_index_entries + 1) * sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    st->index_entries = entries;
+
+    cursors = av_fast_realloc(sc->cursor_index, &sc->cursor_index_allocated_size,
+                              (sc->nb_cursor_index + 1) * sizeof(*cursors));
+    if (!cursors)
+        return AVERROR(ENOMEM);
+    sc->cursor_index = cursors;
+
+    entries[st->nb_index_entries++] = c->entry;
+    cursors[sc->nb_cursor_index++]  = *c;
+    return 0;
+}
+
+/**
+ * Index only the first sample and the keyframes of a track, together with
+ * the sample table positions needed to walk on from them. Keyframes closer
+ * than MOV_COMPACT_INDEX_DISTANCE samples to the previous entry are left out,
+ * which keeps the index small for tracks where every sample is a keyframe.
+ * Samples are then resolved from the tables by sc->cursor while demuxing.
+ */
+static int mov_build_compact_index(MOVContext *mov, AVStream *st, int64_t current_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleCursor c = { { 0 } };
+    uint64_t stream_size = 0;
+    unsigned int stsc_index = 0;
+    unsigned int last_entry = 0;
+    unsigned int i;
+    int ret = 0;
+
+    /* validate the tables up front, the cursor does not log */
+    for (i = 0; i < sc->chunk_count; i++) {
+        int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+        while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
+            i + 1 == sc->stsc_data[stsc_index + 1].first)
+            stsc_index++;
+
+        if (next_offset > sc->chunk_offsets[i] && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+            sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - sc->chunk_offsets[i]) {
+            av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+            sc->stsz_sample_size = sc->sample_size;
+        }
+        if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+            av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+            sc->stsz_sample_size = sc->sample_size;
+        }
+    }
+    for (i = 0; i < sc->stts_count; i++) {
+        /* A negative sample duration is invalid based on the spec,
+         * but some samples need it to correct the DTS. */
+        if (sc->stts_data[i].duration < 0)
+            av_log(mov->fc, AV_LOG_WARNING,
+                   "Invalid SampleDelta %d in STTS, at %d st:%d\n",
+                   sc->stts_data[i].duration, i, st->index);
+    }
+
+    sc->all_keyframes = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    c.entry.timestamp = current_dts;
+    mov_cursor_enter_chunk(sc, &c);
+    while (c.chunk < sc->chunk_count) {
+        unsigned int sample_size;
+
+        if (c.sample >= sc->sample_count) {
+            av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[c.sample];
+        if (sample_size > 0x3FFFFFFF) {
+            av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        mov_cursor_load(sc, &c);
+
+        if (!c.sample || ((c.entry.flags & AVINDEX_KEYFRAME) &&
+                          c.sample - last_entry >= MOV_COMPACT_INDEX_DISTANCE)) {
+            if (mov_add_cursor_entry(st, &c) < 0) {
+                av_freep(&st->index_entries);
+                av_freep(&sc->cursor_index);
+                st->nb_index_entries = sc->nb_cursor_index = 0;
+                st->index_entries_allocated_size = sc->cursor_index_allocated_size = 0;
+                return AVERROR(ENOMEM);
+            }
+            last_entry = c.sample;
+            av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
+                   "size %u, keyframe %d\n", st->index, c.sample, c.entry.pos,
+                   c.entry.timestamp, sample_size, !!(c.entry.flags & AVINDEX_KEYFRAME));
+        }
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && c.sample < 99)
+            ff_rfps_add_frame(mov->fc, st, c.entry.timestamp);
+
+        stream_size += sample_size;
+        mov_cursor_advance(sc, &c);
+    }
+
+    sc->compact_index = 1;
+    sc->nb_samples = c.sample;
+    sc->cursor = sc->cursor_index[0];
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: compact index of %d entries for %u samples\n",
+           st->index, st->nb_index_entries, sc->nb_samples);
+
+    if (ret >= 0 && st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+    return ret;
+}
+
+/**
+ * Replace a compact index by the full sample index, for code modifying
+ * the index in place.
+ */
+static int mov_expand_compact_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleCursor c;
+    AVIndexEntry *entries;
+    unsigned int i;
+    int ret;
+
+    if (!sc->compact_index)
+        return 0;
+
+    entries = av_malloc_array(sc->nb_samples, sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    c = sc->cursor_index[0];
+    for (i = 0; i < sc->nb_samples; i++) {
+        entries[i] = c.entry;
+        mov_cursor_next(sc, &c);
+    }
+
+    if (sc->ctts_data) {
+        unsigned int ctts_sample = sc->ctts_sample;
+
+        for (i = 0; i < sc->ctts_index && i < sc->ctts_count; i++)
+            ctts_sample += sc->ctts_data[i].count;
+        if ((ret = mov_expand_ctts(sc)) < 0) {
+            av_free(entries);
+            return ret;
+        }
+        sc->ctts_index  = ctts_sample;
+        sc->ctts_sample = 0;
+    }
+
+    av_freep(&st->index_entries);
+    st->index_entries = entries;
+    st->nb_index_entries = sc->nb_samples;
+    st->index_entries_allocated_size = sc->nb_samples * sizeof(*entries);
+    av_freep(&sc->cursor_index);
+    sc->nb_cursor_index = sc->cursor_index_allocated_size = 0;
+    sc->compact_index = 0;
+    return 0;
+}
+
+/**
+ * Check whether the edit list can be applied to a compact index: a single
+ * edit starting at media time 0, which mov_fix_index() maps to the samples
+ * unchanged as long as it covers all of them.
+ */
+static int mov_compact_edit(MOVContext *mov, MOVStreamContext *sc)
+{
+    return sc->elst_count == 1 && sc->elst_data[0].time == 0 &&
+           !sc->ctts_data && !sc->dts_shift && mov->time_scale > 0;
+}
+
+static void mov_fix_compact_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t edit_duration, last_dts;
+
+    if (!sc->elst_count)
+        return;
+
+    edit_duration = av_rescale(sc->elst_data[0].duration, sc->time_scale, mov->time_scale);
+    mov_cursor_seek(sc, sc->nb_samples - 1);
+    last_dts = sc->cursor.entry.timestamp;
+    mov_cursor_seek(sc, 0);
+
+    if (last_dts >= edit_duration) {
+        /* samples are cut at the end, leave that to mov_fix_index() */
+        if (mov_expand_compact_index(st) < 0)
+            return;
+        mov_fix_index(mov, st);
+        return;
+    }
+
+    /* the stream properties mov_fix_index() would set */
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        st->skip_samples = sc->start_pad = 0;
+    sc->min_corrected_pts = 0;
+    st->start_time = 0;
+    st->duration = FFMIN(st->duration, edit_duration);
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3767,8 +4165,14 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     unsigned int stps_index = 0;
     unsigned int i, j;
     uint64_t stream_size = 0;
-    MOVStts *ctts_data_old = sc->ctts_data;
-    unsigned int ctts_count_old = sc->ctts_count;
+    int compact = mov->compact_index && mov_all_samples_used(sc) &&
+                  sc->sample_count && !st->nb_index_entries &&
+                  sc->chunk_count && sc->stsc_count && sc->stts_count &&
+                  (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+                   (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                    !(sc->stts_count == 1 && sc->stts_data[0].duration == 1))) &&
+                  (mov->ignore_editlist || !mov->advanced_editlist ||
+                   !sc->elst_count || mov_compact_edit(mov, sc));
 
     if (sc->elst_count) {
         int i, edit_start_index = 0, multiple_edits = 0;
@@ -3810,7 +4214,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     }
 
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
-    if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+    if (compact) {
+        if (mov_build_compact_index(mov, st, current_dts - sc->dts_shift) < 0)
+            return;
+    } else if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
@@ -3838,30 +4245,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
         st->index_entries_allocated_size = (st->nb_index_entries + sc->sample_count) * sizeof(*st->index_entries);
 
-        if (ctts_data_old) {
-            // Expand ctts entries such that we have a 1-1 mapping with samples
-            if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
-                return;
-            sc->ctts_count = 0;
-            sc->ctts_allocated_size = 0;
-            sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
-                                    sc->sample_count * sizeof(*sc->ctts_data));
-            if (!sc->ctts_data) {
-                av_free(ctts_data_old);
-                return;
-            }
-
-            memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
-
-            for (i = 0; i < ctts_count_old &&
-                        sc->ctts_count < sc->sample_count; i++)
-                for (j = 0; j < ctts_data_old[i].count &&
-                            sc->ctts_count < sc->sample_count; j++)
-                    add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
-                                   &sc->ctts_allocated_size, 1,
-                                   ctts_data_old[i].duration);
-            av_free(ctts_data_old);
-        }
+        if (sc->ctts_data && mov_expand_ctts(sc) < 0)
+            return;
 
         for (i = 0; i < sc->chunk_count; i++) {
             int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
@@ -4070,7 +4455,10 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
     if (!mov->ignore_editlist && mov->advanced_editlist) {
         // Fix index according to edit lists.
-        mov_fix_index(mov, st);
+        if (sc->compact_index)
+            mov_fix_compact_index(mov, st);
+        else
+            mov_fix_index(mov, st);
     }
 
     // Update start time of the stream.
@@ -4312,14 +4700,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless samples are read from them. */
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
+    if (!sc->compact_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->rap_group);
+    }
 
     return 0;
 }
@@ -4740,7 +5130,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts, pts = AV_NOPTS_VALUE;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
@@ -4766,6 +5156,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if ((ret = mov_expand_compact_index(st)) < 0)
+        return ret;
 
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
@@ -7340,6 +7732,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        av_freep(&sc->cursor_index);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -7730,6 +8123,16 @@ fail:
     return err;
 }
 
+static AVIndexEntry *mov_current_entry(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->compact_index)
+        return (unsigned)sc->current_sample < sc->nb_samples ? &sc->cursor.entry : NULL;
+    return sc->current_sample < st->nb_index_entries ?
+           &st->index_entries[sc->current_sample] : NULL;
+}
+
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
@@ -7738,8 +8141,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample = mov_current_entry(avst);
+        if (msc->pb && current_sample) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -7847,7 +8250,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, *next;
+    AVIndexEntry compact_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
@@ -7862,6 +8266,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    if (sc->compact_index) {
+        /* the cursor entry is overwritten by the increment below */
+        compact_sample = *sample;
+        sample = &compact_sample;
+    }
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
     mov_current_sample_inc(sc);
@@ -7871,6 +8280,15 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         sample->size = FFMIN(sample->size, (mov->next_root_atom - sample->pos));
     }
 
+    if (st->discard == AVDISCARD_NONKEY && !(sample->flags & AVINDEX_KEYFRAME)) {
+        /* Jump straight to the next keyframe in the index, without seeking
+         * to (and thus possibly reading through) the samples in between. */
+        while ((next = mov_current_entry(st)) && !(next->flags & AVINDEX_KEYFRAME))
+            mov_current_sample_inc(sc);
+        av_log(mov->fc, AV_LOG_DEBUG, "Nonkey frames from stream %d discarded due to AVDISCARD_NONKEY\n", sc->ffindex);
+        goto retry;
+    }
+
     if (st->discard != AVDISCARD_ALL) {
         int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
         if (ret64 != sample->pos) {
@@ -7882,11 +8300,6 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             return AVERROR_INVALIDDATA;
         }
 
-        if (st->discard == AVDISCARD_NONKEY && !(sample->flags & AVINDEX_KEYFRAME)) {
-            av_log(mov->fc, AV_LOG_DEBUG, "Nonkey frame from stream %d discarded due to AVDISCARD_NONKEY\n", sc->ffindex);
-            goto retry;
-        }
-
         if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
         else
@@ -7942,8 +8355,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (next = mov_current_entry(st)) ? next->timestamp : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8008,6 +8420,37 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
     return 0;
 }
 
+/**
+ * Search a compact index like av_index_search_timestamp() would search the
+ * full index, leaving the cursor on the sample found.
+ */
+static int mov_compact_index_search(AVStream *st, int64_t timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleCursor saved = sc->cursor, found;
+    int index, sample = -1;
+
+    index = av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
+    sc->cursor = sc->cursor_index[FFMAX(index, 0)];
+    for (; sc->cursor.sample < sc->nb_samples; mov_cursor_next(sc, &sc->cursor)) {
+        const AVIndexEntry *e = &sc->cursor.entry;
+        int match = (flags & AVSEEK_FLAG_ANY) || (e->flags & AVINDEX_KEYFRAME);
+
+        if (flags & AVSEEK_FLAG_BACKWARD) {
+            if (e->timestamp > timestamp)
+                break;
+            if (match) {
+                sample = sc->cursor.sample;
+                found  = sc->cursor;
+            }
+        } else if (match && e->timestamp >= timestamp) {
+            return sc->cursor.sample;
+        }
+    }
+    sc->cursor = sample >= 0 ? found : saved;
+    return sample;
+}
+
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -8022,7 +8465,10 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    if (sc->compact_index)
+        sample = mov_compact_index_search(st, timestamp, flags);
+    else
+        sample = av_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
     if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
         sample = 0;
@@ -8079,7 +8525,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_current_entry(st)->timestamp;
 
         for (i = 0; i < s->nb_streams; i++) {
             int64_t timestamp;
@@ -8131,6 +8577,10 @@ static const AVOption mov_options[] = {
         "Modify the AVIndex according to the editlists. Use this option to decode in the order specified by the edits.",
         OFFSET(advanced_editlist), AV_OPT_TYPE_BOOL, {.i64 = 1},
         0, 1, FLAGS},
+    {"compact_index",
+        "only index keyframes and read the other samples from the sample tables",
+        OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"ignore_chapters", "", OFFSET(ignore_chapters), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
     {"use_mfra_for",
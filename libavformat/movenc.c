@@ -58,10 +58,14 @@
 #include "mov_chan.h"
 #include "vpcc.h"
 
+/* minimum amount of data moved at once when shifting for faststart */
+#define SHIFT_DATA_MIN_BLOCK_SIZE (1 << 20)
+
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "faststart_reserve", "Reserve an estimated moov size for faststart, shift data only if it is too small", offsetof(MOVMuxContext, faststart_reserve), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM, 0 },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_every_frame", "Fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_EVERY_FRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -6277,6 +6281,58 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Upper estimate of the moov size from the expected number of samples,
+ * assuming every sample starts a new chunk and needs its own table entries.
+ * Returns 0 if the sample count cannot be estimated.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    int64_t size = 4096;
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        double duration = 0, rate = 0;
+        int64_t nb_samples = st->nb_frames;
+
+        if (st->duration > 0)
+            duration = st->duration * av_q2d(st->time_base);
+        else if (s->duration > 0)
+            duration = s->duration / (double)AV_TIME_BASE;
+
+        if (nb_samples <= 0) {
+            switch (par->codec_type) {
+            case AVMEDIA_TYPE_VIDEO:
+                if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+                    rate = av_q2d(st->avg_frame_rate);
+                else if (st->r_frame_rate.num > 0 && st->r_frame_rate.den > 0)
+                    rate = av_q2d(st->r_frame_rate);
+                break;
+            case AVMEDIA_TYPE_AUDIO:
+                if (par->sample_rate > 0)
+                    rate = par->sample_rate / (double)(par->frame_size > 0 ? par->frame_size : 1024);
+                break;
+            default:
+                rate = 10;
+                break;
+            }
+            if (duration <= 0 || rate <= 0)
+                return 0;
+            nb_samples = ceil(duration * rate) + 1;
+        }
+
+        /* stsz + stts + stco/co64 + stsc per sample, ctts + stss for video */
+        size += 2048 + par->extradata_size +
+                nb_samples * (par->codec_type == AVMEDIA_TYPE_VIDEO ? 44 : 32);
+        if (size > INT_MAX)
+            return 0;
+    }
+
+    return size;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6333,6 +6389,16 @@ static int mov_init(AVFormatContext *s)
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
+        if (mov->faststart_reserve && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
+            int64_t size = estimate_moov_size(s);
+            if (size > 0 && size <= INT_MAX) {
+                av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+                mov->reserved_moov_size = size;
+            } else {
+                av_log(s, AV_LOG_VERBOSE, "Cannot estimate the moov size, "
+                       "using a second pass for faststart\n");
+            }
+        }
     }
 
     if (mov->use_editlist < 0) {
@@ -6693,7 +6759,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6825,28 +6891,26 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/*
+ * Move everything from start up to the current position shift bytes
+ * forward. Reading one block ahead keeps this safe for any block size of at
+ * least shift bytes.
+ */
+static int shift_data_from(AVFormatContext *s, int64_t start, int shift)
 {
-    int ret = 0, moov_size;
-    MOVMuxContext *mov = s->priv_data;
+    int ret = 0;
+    int block_size = FFMAX(shift, SHIFT_DATA_MIN_BLOCK_SIZE);
     int64_t pos, pos_end;
     uint8_t *buf, *read_buf[2];
     int read_buf_id = 0;
     int read_size[2];
     AVIOContext *read_pb;
 
-    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
-        moov_size = compute_sidx_size(s);
-    else
-        moov_size = compute_moov_size(s);
-    if (moov_size < 0)
-        return moov_size;
-
-    buf = av_malloc(moov_size * 2);
+    buf = av_malloc(block_size * 2LL);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6862,18 +6926,18 @@ static int shift_data(AVFormatContext *s)
     /* mark the end of the shift to up to the last data we wrote, and get ready
      * for writing */
     pos_end = avio_tell(s->pb);
-    avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
+    avio_seek(s->pb, start + shift, SEEK_SET);
 
     /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
+    avio_seek(read_pb, start, SEEK_SET);
     pos = avio_tell(read_pb);
 
-#define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
-    read_buf_id ^= 1;                                                               \
+#define READ_BLOCK do {                                                              \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size);  \
+    read_buf_id ^= 1;                                                                \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at most block_size */
     READ_BLOCK;
     do {
         int n;
@@ -6891,6 +6955,63 @@ end:
     return ret;
 }
 
+static int shift_data(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int moov_size;
+
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+        moov_size = compute_sidx_size(s);
+    else
+        moov_size = compute_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    return shift_data_from(s, mov->reserved_header_pos, moov_size);
+}
+
+/*
+ * The moov did not fit the space reserved by faststart_reserve: move the
+ * data after the reserved space just enough for the moov and the free atom
+ * that follows it, and grow the reservation accordingly.
+ */
+static int grow_reserved_moov(AVFormatContext *s, int64_t *end)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int reserved = mov->reserved_moov_size;
+    int i, moov_size, moov_size2, shift, ret;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+    if (moov_size <= reserved - 8)
+        return 0;
+
+    shift = moov_size + 8 - reserved;
+    av_log(s, AV_LOG_INFO, "Reserved moov space too small by %d bytes, "
+           "shifting the data\n", shift);
+    for (i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset += shift;
+
+    /* switching from stco to co64 grows the moov further */
+    moov_size2 = get_moov_size(s);
+    if (moov_size2 < 0)
+        return moov_size2;
+    if (moov_size2 != moov_size) {
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += moov_size2 - moov_size;
+        shift += moov_size2 - moov_size;
+    }
+
+    avio_seek(s->pb, *end, SEEK_SET);
+    ret = shift_data_from(s, mov->reserved_header_pos + reserved, shift);
+    if (ret < 0)
+        return ret;
+    *end += shift;
+    mov->reserved_moov_size += shift;
+    return 0;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6954,9 +7075,13 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            if ((res = grow_reserved_moov(s, &moov_pos)) < 0)
+                return res;
+        }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
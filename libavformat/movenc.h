@@ -209,6 +209,7 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int faststart_reserve;  ///< reserve an estimated moov size instead of shifting for faststart
 
     char *major_brand;
 
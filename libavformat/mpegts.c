@@ -2912,13 +2912,45 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Skip the packets at the start of the I/O buffer which handle_packet()
+ * would ignore anyway, i.e. those of PIDs without a filter or of PIDs only
+ * in discarded programs, without copying each of them out of the buffer.
+ * Packets starting a payload unit are left to handle_packet(), as they may
+ * change whether their PID is discarded.
+ *
+ * @return the number of packets skipped
+ */
+static int skip_discarded_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const int packet_size = ts->raw_packet_size;
+    const uint8_t *p = pb->buf_ptr;
+    int nb_packets = 0;
+
+    while (pb->buf_end - p >= packet_size && nb_packets < max_packets) {
+        MpegTSFilter *tss;
+
+        if (p[0] != 0x47)
+            break;
+        tss = ts->pids[AV_RB16(p + 1) & 0x1fff];
+        if (tss ? !tss->discard || p[1] & 0x40 : ts->auto_guess)
+            break;
+        p += packet_size;
+        nb_packets++;
+    }
+    if (nb_packets)
+        avio_skip(pb, p - pb->buf_ptr);
+    return nb_packets;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
     int64_t packet_num;
-    int ret = 0;
+    int skipped, ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
         int i;
@@ -2953,6 +2985,12 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_discarded_packets(ts, nb_packets ? nb_packets - packet_num : INT_MAX);
+        if (skipped > 0) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
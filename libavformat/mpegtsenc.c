@@ -112,6 +112,11 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    /* TS packets assembled but not yet passed to the AVIOContext */
+#define OUT_BUF_PACKETS 128
+    uint8_t out_buf[OUT_BUF_PACKETS * (TS_PACKET_SIZE + 4)];
+    int out_buf_len;
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -804,21 +809,46 @@ invalid:
 
 static int64_t get_pcr(const MpegTSWrite *ts, AVIOContext *pb)
 {
-    return av_rescale(avio_tell(pb) + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
-           ts->first_pcr;
+    return av_rescale(avio_tell(pb) + ts->out_buf_len + 11,
+                      8 * PCR_TIME_BASE, ts->mux_rate) + ts->first_pcr;
 }
 
-static void write_packet(AVFormatContext *s, const uint8_t *packet)
+static void flush_packets(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->out_buf_len) {
+        avio_write(s->pb, ts->out_buf, ts->out_buf_len);
+        ts->out_buf_len = 0;
+    }
+}
+
+/* Return the space for the next TS packet in the output buffer; the packet
+ * is built there and then added to the output by commit_packet(). */
+static uint8_t *get_packet_buf(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->out_buf_len > sizeof(ts->out_buf) - (TS_PACKET_SIZE + 4))
+        flush_packets(s);
+    return ts->out_buf + ts->out_buf_len + (ts->m2ts_mode ? 4 : 0);
+}
+
+static void commit_packet(AVFormatContext *s)
 {
     MpegTSWrite *ts = s->priv_data;
     if (ts->m2ts_mode) {
-        int64_t pcr = get_pcr(s->priv_data, s->pb);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+        int64_t pcr = get_pcr(ts, s->pb);
+        AV_WB32(ts->out_buf + ts->out_buf_len, pcr % 0x3fffffff);
+        ts->out_buf_len += 4;
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
+    ts->out_buf_len += TS_PACKET_SIZE;
+}
+
+static void write_packet(AVFormatContext *s, const uint8_t *packet)
+{
+    memcpy(get_packet_buf(s), packet, TS_PACKET_SIZE);
+    commit_packet(s);
 }
 
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
@@ -1166,8 +1196,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 /* Write a single null transport stream packet */
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
+    uint8_t *buf = get_packet_buf(s);
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
 
     q    = buf;
     *q++ = 0x47;
@@ -1175,7 +1205,7 @@ static void mpegts_insert_null_packet(AVFormatContext *s)
     *q++ = 0xff;
     *q++ = 0x10;
     memset(q, 0x0FF, TS_PACKET_SIZE - (q - buf));
-    write_packet(s, buf);
+    commit_packet(s);
 }
 
 /* Write a single transport stream packet with a PCR and no payload */
@@ -1183,8 +1213,8 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
 {
     MpegTSWrite *ts = s->priv_data;
     MpegTSWriteStream *ts_st = st->priv_data;
+    uint8_t *buf = get_packet_buf(s);
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
 
     q    = buf;
     *q++ = 0x47;
@@ -1204,7 +1234,7 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
 
     /* stuffing bytes */
     memset(q, 0xFF, TS_PACKET_SIZE - (q - buf));
-    write_packet(s, buf);
+    commit_packet(s);
 }
 
 static void write_pts(uint8_t *q, int fourbits, int64_t pts)
@@ -1264,7 +1294,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t *buf;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, is_dvb_subtitle, is_dvb_teletext, flags;
     int afc_len, stuffing_len;
@@ -1272,7 +1302,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
+    av_assert0(ts_st->payload != ts->out_buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1339,6 +1369,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         }
 
         /* prepare packet header */
+        buf  = get_packet_buf(s);
         q    = buf;
         *q++ = 0x47;
         val  = ts_st->pid >> 8;
@@ -1546,7 +1577,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 
         payload      += len;
         payload_size -= len;
-        write_packet(s, buf);
+        commit_packet(s);
     }
     ts_st->prev_payload_key = key;
 }
@@ -1898,7 +1929,7 @@ static void mpegts_write_flush(AVFormatContext *s)
     }
 
     if (ts->m2ts_mode) {
-        int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
+        int packets = ((avio_tell(s->pb) + ts->out_buf_len) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
     }
@@ -1906,18 +1937,24 @@ static void mpegts_write_flush(AVFormatContext *s)
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+    int ret;
+
     if (!pkt) {
         mpegts_write_flush(s);
-        return 1;
+        ret = 1;
     } else {
-        return mpegts_write_packet_internal(s, pkt);
+        ret = mpegts_write_packet_internal(s, pkt);
     }
+    flush_packets(s);
+    return ret;
 }
 
 static int mpegts_write_end(AVFormatContext *s)
 {
-    if (s->pb)
+    if (s->pb) {
         mpegts_write_flush(s);
+        flush_packets(s);
+    }
 
     return 0;
 }
@@ -30,6 +30,7 @@
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/trace_internal.h"
 
 /**
  * @file
@@ -728,7 +729,14 @@ static int write_packet(AVFormatContext *s, AVPacket *pkt)
         av_assert0(pkt->size == sizeof(*frame));
         ret = s->oformat->write_uncoded_frame(s, pkt->stream_index, frame, 0);
     } else {
+        int64_t pos = s->pb ? avio_tell(s->pb) : -1;
+
         ret = s->oformat->write_packet(s, pkt);
+        if (ret >= 0 && s->seek_index) {
+            int err = ff_seek_index_add(s, pkt, pos);
+            if (err < 0)
+                ret = err;
+        }
     }
 
     if (s->pb && ret >= 0) {
@@ -1225,7 +1233,9 @@ int av_write_frame(AVFormatContext *s, AVPacket *in)
         }
     }
 
+    avpriv_trace_begin("lavf", "write_frame", pkt->pts, pkt->stream_index);
     ret = write_packets_common(s, pkt, 0/*non-interleaved*/);
+    avpriv_trace_end("lavf", "write_frame", in->pts, in->stream_index);
 
 fail:
     // Uncoded frames using the noninterleaved codepath are also freed here
@@ -1238,7 +1248,12 @@ int av_interleaved_write_frame(AVFormatContext *s, AVPacket *pkt)
     int ret;
 
     if (pkt) {
+        int64_t pts      = pkt->pts;
+        int stream_index = pkt->stream_index;
+
+        avpriv_trace_begin("lavf", "interleaved_write_frame", pts, stream_index);
         ret = write_packets_common(s, pkt, 1/*interleaved*/);
+        avpriv_trace_end("lavf", "interleaved_write_frame", pts, stream_index);
         if (ret < 0)
             av_packet_unref(pkt);
         return ret;
@@ -1283,6 +1298,11 @@ int av_write_trailer(AVFormatContext *s)
        avio_flush(s->pb);
     if (ret == 0)
        ret = s->pb ? s->pb->error : 0;
+    if (s->seek_index) {
+        int err = ff_seek_index_write(s);
+        if (ret >= 0)
+            ret = err;
+    }
     for (i = 0; i < s->nb_streams; i++) {
         av_freep(&s->streams[i]->priv_data);
         av_freep(&s->streams[i]->index_entries);
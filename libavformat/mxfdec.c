@@ -51,6 +51,7 @@
 #include "libavcodec/bytestream.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/qsort.h"
 #include "libavutil/timecode.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -258,7 +259,7 @@ typedef struct MXFIndexTable {
     int body_sid;
     int nb_ptses;               /* number of PTSes or total duration of index */
     int64_t first_dts;          /* DTS = EditUnit + first_dts */
-    int64_t *ptses;             /* maps EditUnit -> PTS */
+    int64_t *ptses;             /* maps EditUnit -> PTS, NULL if PTS = EditUnit */
     int nb_segments;
     MXFIndexTableSegment **segments;    /* sorted by IndexStartPosition */
     AVIndexEntry *fake_index;   /* used for calling ff_index_search_timestamp() */
@@ -287,6 +288,8 @@ typedef struct MXFContext {
     int parsing_backward;
     int64_t last_forward_tell;
     int last_forward_partition;
+    int footer_sets_start;      /* first metadata set read from the FooterPartition */
+    int skip_index_segments;    /* the FooterPartition has a complete index */
     int nb_index_tables;
     MXFIndexTable *index_tables;
     int eia608_extract;
@@ -695,6 +698,8 @@ static int mxf_read_partition_pack(void *arg, AVIOContext *pb, int tag, int size
         break;
     case 4:
         partition->type = Footer;
+        if (mxf->parsing_backward)
+            mxf->footer_sets_start = mxf->metadata_sets_count;
         break;
     default:
         av_log(mxf->fc, AV_LOG_ERROR, "unknown partition type %i\n", uid[13]);
@@ -1415,11 +1420,23 @@ static MXFWrappingScheme mxf_get_wrapping_kind(UID *essence_container_ul)
     return UnknownWrapped;
 }
 
+static int mxf_compare_index_segments(MXFIndexTableSegment **a, MXFIndexTableSegment **b)
+{
+    const MXFIndexTableSegment *s1 = *a, *s2 = *b;
+
+    if (s1->body_sid != s2->body_sid)
+        return s1->body_sid < s2->body_sid ? -1 : 1;
+    if (s1->index_sid != s2->index_sid)
+        return s1->index_sid < s2->index_sid ? -1 : 1;
+    if (s1->index_start_position != s2->index_start_position)
+        return s1->index_start_position < s2->index_start_position ? -1 : 1;
+    return (s1->index_duration < s2->index_duration) - (s1->index_duration > s2->index_duration);
+}
+
 static int mxf_get_sorted_table_segments(MXFContext *mxf, int *nb_sorted_segments, MXFIndexTableSegment ***sorted_segments)
 {
-    int i, j, nb_segments = 0;
-    MXFIndexTableSegment **unsorted_segments;
-    int last_body_sid = -1, last_index_sid = -1, last_index_start = -1;
+    int i, nb_segments = 0;
+    MXFIndexTableSegment **unsorted_segments, **segments, **tmp, *last = NULL;
 
     /* count number of segments, allocate arrays and copy unsorted segments */
     for (i = 0; i < mxf->metadata_sets_count; i++)
@@ -1453,45 +1470,22 @@ static int mxf_get_sorted_table_segments(MXFContext *mxf, int *nb_sorted_segment
         return AVERROR_INVALIDDATA;
     }
 
-    *nb_sorted_segments = 0;
+    /* sort segments by {BodySID, IndexSID, IndexStartPosition}, longest IndexDuration first.
+     * The sort is stable, so of equal segments the first one read is kept. */
+    segments = unsorted_segments;
+    tmp      = *sorted_segments;
+    AV_MSORT(segments, tmp, nb_segments, MXFIndexTableSegment*, mxf_compare_index_segments);
 
-    /* sort segments by {BodySID, IndexSID, IndexStartPosition}, remove duplicates while we're at it */
+    /* remove duplicates, segments may be the output array itself */
+    *nb_sorted_segments = 0;
     for (i = 0; i < nb_segments; i++) {
-        int best = -1, best_body_sid = -1, best_index_sid = -1, best_index_start = -1;
-        uint64_t best_index_duration = 0;
-
-        for (j = 0; j < nb_segments; j++) {
-            MXFIndexTableSegment *s = unsorted_segments[j];
+        MXFIndexTableSegment *s = segments[i];
 
-            /* Require larger BosySID, IndexSID or IndexStartPosition then the previous entry. This removes duplicates.
-             * We want the smallest values for the keys than what we currently have, unless this is the first such entry this time around.
-             * If we come across an entry with the same IndexStartPosition but larger IndexDuration, then we'll prefer it over the one we currently have.
-             */
-            if ((i == 0 ||
-                 s->body_sid >  last_body_sid ||
-                 s->body_sid == last_body_sid && s->index_sid >  last_index_sid ||
-                 s->body_sid == last_body_sid && s->index_sid == last_index_sid && s->index_start_position > last_index_start) &&
-                (best == -1 ||
-                 s->body_sid <  best_body_sid ||
-                 s->body_sid == best_body_sid && s->index_sid <  best_index_sid ||
-                 s->body_sid == best_body_sid && s->index_sid == best_index_sid && s->index_start_position <  best_index_start ||
-                 s->body_sid == best_body_sid && s->index_sid == best_index_sid && s->index_start_position == best_index_start && s->index_duration > best_index_duration)) {
-                best             = j;
-                best_body_sid    = s->body_sid;
-                best_index_sid   = s->index_sid;
-                best_index_start = s->index_start_position;
-                best_index_duration = s->index_duration;
-            }
-        }
-
-        /* no suitable entry found -> we're done */
-        if (best == -1)
-            break;
-
-        (*sorted_segments)[(*nb_sorted_segments)++] = unsorted_segments[best];
-        last_body_sid    = best_body_sid;
-        last_index_sid   = best_index_sid;
-        last_index_start = best_index_start;
+        if (last && s->body_sid             == last->body_sid &&
+                    s->index_sid            == last->index_sid &&
+                    s->index_start_position == last->index_start_position)
+            continue;
+        (*sorted_segments)[(*nb_sorted_segments)++] = last = s;
     }
 
     av_free(unsorted_segments);
@@ -1609,6 +1603,32 @@ static int mxf_edit_unit_absolute_offset(MXFContext *mxf, MXFIndexTable *index_t
     return AVERROR_INVALIDDATA;
 }
 
+/**
+ * Checks whether every edit unit of the index table is a keyframe stored in
+ * display order. PTS = DTS = EditUnit then, and seeking needs no fake index.
+ */
+static int mxf_index_in_display_order(MXFIndexTable *index_table)
+{
+    int i, j, x;
+
+    for (i = x = 0; i < index_table->nb_segments; i++) {
+        MXFIndexTableSegment *s = index_table->segments[i];
+        int index_delta = 1;
+        int n = s->nb_index_entries;
+
+        if (s->nb_index_entries == 2 * s->index_duration + 1) {
+            index_delta = 2;    /* Avid index */
+            n--;
+        }
+
+        for (j = 0; j < n; j += index_delta, x++)
+            if (s->temporal_offset_entries[j] / index_delta || s->flag_entries[j] & 0x30)
+                return 0;
+    }
+
+    return x == index_table->nb_ptses;
+}
+
 static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_table)
 {
     int i, j, x;
@@ -1637,6 +1657,12 @@ static int mxf_compute_ptses_fake_index(MXFContext *mxf, MXFIndexTable *index_ta
     if (index_table->nb_ptses <= 0)
         return 0;
 
+    /* intra-only essence, no need for per edit unit tables */
+    if (mxf_index_in_display_order(index_table)) {
+        index_table->first_dts = 0;
+        return 0;
+    }
+
     if (!(index_table->ptses      = av_calloc(index_table->nb_ptses, sizeof(int64_t))) ||
         !(index_table->fake_index = av_calloc(index_table->nb_ptses, sizeof(AVIndexEntry))) ||
         !(index_table->offsets    = av_calloc(index_table->nb_ptses, sizeof(int8_t))) ||
@@ -2828,6 +2854,69 @@ static int mxf_parse_klv(MXFContext *mxf, KLVPacket klv, MXFMetadataReadFunc *re
     return 0;
 }
 
+/**
+ * Checks whether the index table segments read from the FooterPartition
+ * cover each IndexSID of the essence containers from EditUnit 0 without
+ * gaps. The segments repeated in body partitions can be skipped then.
+ */
+static int mxf_footer_index_is_complete(MXFContext *mxf)
+{
+    int nb_sets = mxf->metadata_sets_count - mxf->footer_sets_start;
+    MXFIndexTableSegment **buf, **segments, **tmp;
+    uint64_t end = 0;
+    int i, nb_segments = 0, ret = 0;
+
+    if (nb_sets <= 0 || !(buf = av_calloc(nb_sets, 2 * sizeof(*buf))))
+        return 0;
+    segments = buf;
+    tmp      = buf + nb_sets;
+
+    for (i = mxf->footer_sets_start; i < mxf->metadata_sets_count; i++) {
+        MXFIndexTableSegment *s = (MXFIndexTableSegment *)mxf->metadata_sets[i];
+        if (s->type == IndexTableSegment)
+            segments[nb_segments++] = s;
+    }
+    if (!nb_segments)
+        goto end;
+
+    AV_MSORT(segments, tmp, nb_segments, MXFIndexTableSegment*, mxf_compare_index_segments);
+
+    for (i = 0; i < nb_segments; i++) {
+        MXFIndexTableSegment *s = segments[i];
+
+        if (!i || s->body_sid != segments[i - 1]->body_sid || s->index_sid != segments[i - 1]->index_sid)
+            end = 0;
+        if (s->index_start_position > end)
+            goto end;
+        if (!s->index_duration) {
+            /* a CBR segment without IndexDuration covers the rest of the essence */
+            if (!s->edit_unit_byte_count)
+                goto end;
+            end = UINT64_MAX;
+        } else if (end != UINT64_MAX && s->index_start_position + s->index_duration > end) {
+            end = s->index_start_position + s->index_duration;
+        }
+    }
+
+    for (i = 0; i < mxf->metadata_sets_count; i++) {
+        MXFEssenceContainerData *essence_data = (MXFEssenceContainerData *)mxf->metadata_sets[i];
+        int j;
+
+        if (essence_data->type != EssenceContainerData || !essence_data->index_sid)
+            continue;
+        for (j = 0; j < nb_segments; j++)
+            if (segments[j]->index_sid == essence_data->index_sid)
+                break;
+        if (j == nb_segments)
+            goto end;
+        ret = 1;
+    }
+
+end:
+    av_free(buf);
+    return ret;
+}
+
 /**
  * Seeks to the previous partition and parses it, if possible
  * @return <= 0 if we should stop parsing, > 0 if we should keep going
@@ -2843,6 +2932,12 @@ static int mxf_seek_to_previous_partition(MXFContext *mxf)
         mxf->run_in + mxf->current_partition->previous_partition <= mxf->last_forward_tell)
         return 0;   /* we've parsed all partitions */
 
+    if (mxf->current_partition->type == Footer && !mxf->skip_index_segments &&
+        mxf_footer_index_is_complete(mxf)) {
+        av_log(mxf->fc, AV_LOG_VERBOSE, "complete index in FooterPartition, skipping the index segments of other partitions\n");
+        mxf->skip_index_segments = 1;
+    }
+
     /* seek to previous partition */
     current_partition_ofs = mxf->current_partition->pack_ofs;   //includes run-in
     avio_seek(pb, mxf->run_in + mxf->current_partition->previous_partition, SEEK_SET);
@@ -3225,6 +3320,10 @@ static int mxf_read_header(AVFormatContext *s)
 
         for (metadata = mxf_metadata_read_table; metadata->read; metadata++) {
             if (IS_KLV_KEY(klv.key, metadata->key)) {
+                if (metadata->type == IndexTableSegment && mxf->skip_index_segments) {
+                    avio_skip(s->pb, klv.length);
+                    break;
+                }
                 if ((ret = mxf_parse_klv(mxf, klv, metadata->read, metadata->ctx_size, metadata->type)) < 0)
                     goto fail;
                 break;
@@ -3406,7 +3505,7 @@ static int mxf_set_pts(MXFContext *mxf, AVStream *st, AVPacket *pkt)
 
         if (t && track->sample_count < t->nb_ptses) {
             pkt->dts = track->sample_count + t->first_dts;
-            pkt->pts = t->ptses[track->sample_count];
+            pkt->pts = t->ptses ? t->ptses[track->sample_count] : track->sample_count;
         } else if (track->intra_only) {
             /* intra-only -> PTS = EditUnit.
              * let utils.c figure out DTS since it can be < PTS if low_delay = 0 (Sony IMX30) */
@@ -3682,6 +3781,13 @@ static int mxf_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
                 return sample_time;
             /* get the stored order index from the display order index */
             sample_time += t->offsets[sample_time];
+        } else if (t->nb_ptses) {
+            /* every edit unit is a keyframe in display order */
+            if (sample_time >= t->nb_ptses) {
+                if (!(flags & AVSEEK_FLAG_BACKWARD))
+                    return -1;
+                sample_time = t->nb_ptses - 1;
+            }
         } else {
             /* no IndexEntryArray (one or more CBR segments)
              * make sure we don't seek past the end */
@@ -47,6 +47,8 @@ static const AVOption avformat_options[] = {
 {"noparse", "disable AVParsers, this needs nofillin too", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_NOPARSE }, INT_MIN, INT_MAX, D, "fflags"},
 {"igndts", "ignore dts", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_IGNDTS }, INT_MIN, INT_MAX, D, "fflags"},
 {"discardcorrupt", "discard corrupted frames", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_DISCARD_CORRUPT }, INT_MIN, INT_MAX, D, "fflags"},
+{"pool_packets", "allocate demuxed packets from a buffer pool", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_POOL_PACKETS }, INT_MIN, INT_MAX, D, "fflags"},
+{"fastinfo", "stop stream analysis once the codec parameters are known", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_FAST_INFO }, INT_MIN, INT_MAX, D, "fflags"},
 {"sortdts", "try to interleave outputted packets by dts", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_SORT_DTS }, INT_MIN, INT_MAX, D, "fflags"},
 #if FF_API_LAVF_KEEPSIDE_FLAG
 {"keepside", "deprecated, does nothing", 0, AV_OPT_TYPE_CONST, {.i64 = AVFMT_FLAG_KEEP_SIDE_DATA }, INT_MIN, INT_MAX, D, "fflags"},
@@ -112,6 +114,8 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"stream_info_cache", "directory in which to cache the results of stream analysis", OFFSET(stream_info_cache), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+{"seek_index", "path of the sidecar seek index to read or write", OFFSET(seek_index), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D|E },
 {NULL},
 };
 
@@ -315,9 +315,12 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
                          int *nb_prev_pkt)
 {
     uint8_t pkt_hdr[16], *p = pkt_hdr;
+    uint8_t marker[5];
+    URLIOVec iov[URL_MAX_IOV];
     int mode = RTMP_PS_TWELVEBYTES;
     int off = 0;
     int written = 0;
+    int marker_size, nb_iov = 0;
     int ret;
     RTMPPacket *prev_pkt;
     int use_delta; // flag if using timestamp delta, not RTMP_PS_TWELVEBYTES
@@ -382,28 +385,35 @@ int ff_rtmp_packet_write(URLContext *h, RTMPPacket *pkt,
     prev_pkt[pkt->channel_id].ts_field   = pkt->ts_field;
     prev_pkt[pkt->channel_id].extra      = pkt->extra;
 
-    if ((ret = ffurl_write(h, pkt_hdr, p - pkt_hdr)) < 0)
-        return ret;
+    /* the chunks are sent together with their headers, up to URL_MAX_IOV
+     * buffers at once */
+    marker[0] = 0xC0 | pkt->channel_id;
+    marker_size = 1;
+    if (pkt->ts_field == 0xFFFFFF) {
+        AV_WB32(marker + 1, timestamp);
+        marker_size += 4;
+    }
+    iov[nb_iov].data   = pkt_hdr;
+    iov[nb_iov++].size = p - pkt_hdr;
     written = p - pkt_hdr + pkt->size;
     while (off < pkt->size) {
         int towrite = FFMIN(chunk_size, pkt->size - off);
-        if ((ret = ffurl_write(h, pkt->data + off, towrite)) < 0)
-            return ret;
+        iov[nb_iov].data   = pkt->data + off;
+        iov[nb_iov++].size = towrite;
         off += towrite;
         if (off < pkt->size) {
-            uint8_t marker = 0xC0 | pkt->channel_id;
-            if ((ret = ffurl_write(h, &marker, 1)) < 0)
+            iov[nb_iov].data   = marker;
+            iov[nb_iov++].size = marker_size;
+            written += marker_size;
+        }
+        if (nb_iov > URL_MAX_IOV - 2) {
+            if ((ret = ffurl_writev(h, iov, nb_iov)) < 0)
                 return ret;
-            written++;
-            if (pkt->ts_field == 0xFFFFFF) {
-                uint8_t ts_header[4];
-                AV_WB32(ts_header, timestamp);
-                if ((ret = ffurl_write(h, ts_header, 4)) < 0)
-                    return ret;
-                written += 4;
-            }
+            nb_iov = 0;
         }
     }
+    if (nb_iov && (ret = ffurl_writev(h, iov, nb_iov)) < 0)
+        return ret;
     return written;
 }
 
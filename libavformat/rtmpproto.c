@@ -89,6 +89,9 @@ typedef struct RTMPContext {
     uint8_t*      flv_data;                   ///< buffer with data for demuxer
     int           flv_size;                   ///< current buffer size
     int           flv_off;                    ///< number of bytes read from current buffer
+    RTMPPacket    in_pkt;                     ///< audio/video packet read by the demuxer directly after flv_data
+    uint8_t       in_tag[RTMP_HEADER + 4];    ///< FLV tag header and trailer of in_pkt
+    int           in_off;                     ///< number of bytes of the in_pkt FLV tag already read
     int           flv_nb_packets;             ///< number of flv packets published
     RTMPPacket    out_pkt;                    ///< rtmp packet, created from flv a/v or metadata (for output)
     uint32_t      receive_report_size;        ///< number of bytes after which we should report the number of received bytes to the peer
@@ -2216,6 +2219,23 @@ static int append_flv_data(RTMPContext *rt, RTMPPacket *pkt, int skip)
         rt->has_video = 1;
     }
 
+    if (!skip && rt->flv_off >= rt->flv_size && !rt->in_pkt.data) {
+        // Nothing is buffered, so let the demuxer read the payload from the
+        // packet itself instead of copying it into flv_data
+        bytestream2_init_writer(&pbc, rt->in_tag, sizeof(rt->in_tag));
+        bytestream2_put_byte(&pbc, pkt->type);
+        bytestream2_put_be24(&pbc, size);
+        bytestream2_put_be24(&pbc, ts);
+        bytestream2_put_byte(&pbc, ts >> 24);
+        bytestream2_put_be24(&pbc, 0);
+        bytestream2_put_be32(&pbc, size + RTMP_HEADER);
+        rt->in_pkt = *pkt;
+        rt->in_off = 0;
+        pkt->data  = NULL;
+        pkt->size  = 0;
+        return 0;
+    }
+
     old_flv_size = update_offset(rt, size + 15);
 
     if ((ret = av_reallocp(&rt->flv_data, rt->flv_size)) < 0) {
@@ -2511,6 +2531,7 @@ static int rtmp_close(URLContext *h)
 
     free_tracked_methods(rt);
     av_freep(&rt->flv_data);
+    ff_rtmp_packet_destroy(&rt->in_pkt);
     ffurl_closep(&rt->stream);
     return ret;
 }
@@ -2889,31 +2910,51 @@ fail:
     return ret;
 }
 
+static int read_in_pkt(RTMPContext *rt, uint8_t *buf, int size)
+{
+    int total = rt->in_pkt.size + sizeof(rt->in_tag);
+    int len   = 0;
+
+    while (len < size && rt->in_off < total) {
+        int off = rt->in_off, n;
+
+        if (off < RTMP_HEADER) {
+            n = FFMIN(RTMP_HEADER - off, size - len);
+            memcpy(buf + len, rt->in_tag + off, n);
+        } else if (off < RTMP_HEADER + rt->in_pkt.size) {
+            n = FFMIN(RTMP_HEADER + rt->in_pkt.size - off, size - len);
+            memcpy(buf + len, rt->in_pkt.data + off - RTMP_HEADER, n);
+        } else {
+            n = FFMIN(total - off, size - len);
+            memcpy(buf + len, rt->in_tag + off - rt->in_pkt.size, n);
+        }
+        len        += n;
+        rt->in_off += n;
+    }
+    if (rt->in_off == total)
+        ff_rtmp_packet_destroy(&rt->in_pkt);
+    return len;
+}
+
 static int rtmp_read(URLContext *s, uint8_t *buf, int size)
 {
     RTMPContext *rt = s->priv_data;
-    int orig_size = size;
     int ret;
 
-    while (size > 0) {
+    for (;;) {
         int data_left = rt->flv_size - rt->flv_off;
 
-        if (data_left >= size) {
+        if (data_left > 0) {
+            size = FFMIN(size, data_left);
             memcpy(buf, rt->flv_data + rt->flv_off, size);
             rt->flv_off += size;
-            return orig_size;
-        }
-        if (data_left > 0) {
-            memcpy(buf, rt->flv_data + rt->flv_off, data_left);
-            buf  += data_left;
-            size -= data_left;
-            rt->flv_off = rt->flv_size;
-            return data_left;
+            return size;
         }
+        if (rt->in_pkt.data)
+            return read_in_pkt(rt, buf, size);
         if ((ret = get_packet(s, 0)) < 0)
            return ret;
     }
-    return orig_size;
 }
 
 static int64_t rtmp_seek(URLContext *s, int stream_index, int64_t timestamp,
@@ -2932,6 +2973,7 @@ static int64_t rtmp_seek(URLContext *s, int stream_index, int64_t timestamp,
         return ret;
     }
     rt->flv_off = rt->flv_size;
+    ff_rtmp_packet_destroy(&rt->in_pkt);
     rt->state = STATE_SEEKING;
     return timestamp;
 }
@@ -32,6 +32,8 @@
 #include "rtpdec_formats.h"
 
 #define MIN_FEEDBACK_INTERVAL 200000 /* 200 ms in us */
+#define MIN_REORDER_DELAY       5000 /* 5 ms in us */
+#define REORDER_DELAY_HALF_LIFE 10000000 /* 10 s in us */
 
 static RTPDynamicProtocolHandler l24_dynamic_handler = {
     .enc_name   = "L24",
@@ -716,6 +718,7 @@ void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
     s->seq       = 0;
     s->queue_len = 0;
     s->prev_ret  = 0;
+    s->skip_recvtime = 0;
 }
 
 static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
@@ -728,6 +731,9 @@ static int enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
         int16_t diff = seq - (*cur)->seq;
         if (diff < 0)
             break;
+        /* duplicate, e.g. a retransmission of a packet already queued */
+        if (!diff)
+            return AVERROR(EAGAIN);
         cur = &(*cur)->next;
     }
 
@@ -755,6 +761,60 @@ int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
     return s->queue ? s->queue->recvtime : 0;
 }
 
+static int64_t decayed_reorder_delay(RTPDemuxContext *s, int64_t now)
+{
+    int64_t halvings = (now - s->reorder_delay_time) / REORDER_DELAY_HALF_LIFE;
+    return s->reorder_delay >> FFMIN(halvings, 62);
+}
+
+/**
+ * Record how long after its successor a missing packet arrived. The peak is
+ * kept, and halves every REORDER_DELAY_HALF_LIFE without a larger one.
+ */
+static void update_reorder_delay(RTPDemuxContext *s, int64_t delay)
+{
+    int64_t now = av_gettime_relative();
+
+    if (delay >= decayed_reorder_delay(s, now)) {
+        s->reorder_delay      = delay;
+        s->reorder_delay_time = now;
+    }
+}
+
+int64_t ff_rtp_reorder_delay(RTPDemuxContext *s, int64_t max_delay)
+{
+    int64_t delay = 2 * decayed_reorder_delay(s, av_gettime_relative());
+
+    if (s->st)
+        delay = FFMAX(delay, 4 * av_rescale_q(s->statistics.jitter >> 4,
+                                              s->st->time_base, AV_TIME_BASE_Q));
+    return FFMIN(delay + MIN_REORDER_DELAY, max_delay);
+}
+
+/**
+ * Turn an RFC 4588 retransmission back into the original packet in place:
+ * restore the payload type, sequence number and SSRC of the original stream
+ * and drop the original sequence number from the payload.
+ */
+static int unwrap_rtx_packet(RTPDemuxContext *s, uint8_t *buf, int len)
+{
+    int hdr = 12 + 4 * (buf[0] & 0x0f);
+
+    if (buf[0] & 0x10) {
+        if (len < hdr + 4)
+            return AVERROR_INVALIDDATA;
+        hdr += (AV_RB16(buf + hdr + 2) + 1) << 2;
+    }
+    if (len < hdr + 2)
+        return AVERROR_INVALIDDATA;
+
+    buf[1] = (buf[1] & 0x80) | s->payload_type;
+    AV_WB16(buf + 2, AV_RB16(buf + hdr));
+    AV_WB32(buf + 8, s->ssrc);
+    memmove(buf + hdr, buf + hdr + 2, len - hdr - 2);
+    return len - 2;
+}
+
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
@@ -763,9 +823,13 @@ static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
     if (s->queue_len <= 0)
         return -1;
 
-    if (!has_next_packet(s))
+    if (!has_next_packet(s)) {
         av_log(s->ic, AV_LOG_WARNING,
                "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+        s->skip_recvtime = s->queue->recvtime;
+        s->skip_first    = s->seq + 1;
+        s->skip_last     = s->queue->seq - 1;
+    }
 
     /* Parse the first packet in the queue, and dequeue it */
     rv   = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
@@ -781,7 +845,7 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
                                 uint8_t **bufptr, int len)
 {
     uint8_t *buf = bufptr ? *bufptr : NULL;
-    int flags = 0;
+    int flags = 0, rtx = 0;
     uint32_t timestamp;
     int rv = 0;
 
@@ -813,7 +877,14 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         return rtcp_parse_packet(s, buf, len);
     }
 
-    if (s->st) {
+    if (s->rtx_payload_type && (buf[1] & 0x7f) == s->rtx_payload_type) {
+        /* retransmissions only make sense with reordering */
+        if (s->queue_size <= 1 || !s->ssrc)
+            return -1;
+        if ((len = unwrap_rtx_packet(s, buf, len)) < 0)
+            return -1;
+        rtx = 1;
+    } else if (s->st) {
         int64_t received = av_gettime_relative();
         uint32_t arrival_ts = av_rescale_q(received, AV_TIME_BASE_Q,
                                            s->st->time_base);
@@ -831,11 +902,19 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         int16_t diff = seq - s->seq;
         if (diff < 0) {
             /* Packet older than the previously emitted one, drop */
+            if (rtx)
+                return -1;
             av_log(s->ic, AV_LOG_WARNING,
                    "RTP: dropping old packet received too late\n");
+            /* a missing packet given up on too early */
+            if (s->skip_recvtime &&
+                (uint16_t)(seq - s->skip_first) <= (uint16_t)(s->skip_last - s->skip_first))
+                update_reorder_delay(s, av_gettime_relative() - s->skip_recvtime);
             return -1;
         } else if (diff <= 1) {
-            /* Correct packet */
+            /* Correct packet, possibly filling the gap before the queue */
+            if (s->queue)
+                update_reorder_delay(s, av_gettime_relative() - s->queue->recvtime);
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
         } else {
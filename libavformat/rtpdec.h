@@ -50,6 +50,14 @@ int ff_rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
                         uint8_t **buf, int len);
 void ff_rtp_parse_close(RTPDemuxContext *s);
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s);
+/**
+ * Get how long the first queued packet should wait for the missing ones,
+ * adapted to the reordering and jitter measured on the stream.
+ *
+ * @param max_delay upper bound of the returned delay, in microseconds
+ * @return the delay in microseconds
+ */
+int64_t ff_rtp_reorder_delay(RTPDemuxContext *s, int64_t max_delay);
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s);
 
 /**
@@ -171,6 +179,11 @@ struct RTPDemuxContext {
     RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
     int queue_len;    ///< The number of packets in queue
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    int64_t reorder_delay;      ///< peak delay of a missing packet after its successor
+    int64_t reorder_delay_time; ///< when reorder_delay was set
+    int64_t skip_recvtime;      ///< arrival time of the packet last returned despite a gap
+    uint16_t skip_first, skip_last; ///< sequence numbers of that gap
+    int rtx_payload_type;       ///< payload type of RFC 4588 retransmissions, 0 if none
     /*@}*/
 
     /* rtcp sender statistics receive */
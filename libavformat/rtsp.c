@@ -77,6 +77,7 @@
 
 #define COMMON_OPTS() \
     { "reorder_queue_size", "set number of packets to buffer for handling of reordered packets", OFFSET(reordering_queue_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC }, \
+    { "adaptive_delay",     "adapt the reordering delay to the measured jitter, up to max_delay", OFFSET(adaptive_delay), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, DEC }, \
     { "buffer_size",        "Underlying protocol send/receive buffer size",                  OFFSET(buffer_size),           AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, DEC|ENC }, \
     { "pkt_size",           "Underlying protocol send packet size",                          OFFSET(pkt_size),              AV_OPT_TYPE_INT, { .i64 = -1 }, -1, INT_MAX, ENC } \
 
@@ -570,7 +571,10 @@ static void sdp_parse_line(AVFormatContext *s, SDPParseState *s1,
             get_word(buf1, sizeof(buf1), &p);
             payload_type = atoi(buf1);
             rtsp_st = rt->rtsp_streams[rt->nb_rtsp_streams - 1];
-            if (rtsp_st->stream_index >= 0) {
+            if (!av_strncasecmp(p + strspn(p, SPACE_CHARS), "rtx/", 4)) {
+                /* retransmissions of another payload type, see fmtp apt */
+                rtsp_st->rtx_payload_type = payload_type;
+            } else if (rtsp_st->stream_index >= 0) {
                 st = s->streams[rtsp_st->stream_index];
                 sdp_parse_rtpmap(s, st, rtsp_st, payload_type, p);
             }
@@ -583,6 +587,16 @@ static void sdp_parse_line(AVFormatContext *s, SDPParseState *s1,
             // let dynamic protocol handlers have a stab at the line.
             get_word(buf1, sizeof(buf1), &p);
             payload_type = atoi(buf1);
+            for (; s->nb_streams > 0 && p; p = strchr(p, ';')) {
+                p += strspn(p, "; ");
+                if (av_strstart(p, "apt=", &p)) {
+                    /* RFC 4588 retransmissions */
+                    rtsp_st = rt->rtsp_streams[rt->nb_rtsp_streams - 1];
+                    rtsp_st->rtx_payload_type = payload_type;
+                    rtsp_st->rtx_apt          = atoi(p);
+                    break;
+                }
+            }
             if (s1->seen_rtpmap) {
                 parse_fmtp(s, rt, payload_type, buf);
             } else {
@@ -849,6 +863,8 @@ int ff_rtsp_open_transport_ctx(AVFormatContext *s, RTSPStream *rtsp_st)
                s->iformat) {
         RTPDemuxContext *rtpctx = rtsp_st->transport_priv;
         rtpctx->ssrc = rtsp_st->ssrc;
+        if (rtsp_st->rtx_payload_type && rtsp_st->rtx_apt == rtsp_st->sdp_payload_type)
+            rtpctx->rtx_payload_type = rtsp_st->rtx_payload_type;
         if (rtsp_st->dynamic_handler) {
             ff_rtp_parse_set_dynamic_protocol(rtsp_st->transport_priv,
                                               rtsp_st->dynamic_protocol_context,
@@ -2093,7 +2109,9 @@ static int pick_stream(AVFormatContext *s, RTSPStream **rtsp_st,
             }
         } else {
             for (i = 0; i < rt->nb_rtsp_streams; i++) {
-                if ((buf[1] & 0x7f) == rt->rtsp_streams[i]->sdp_payload_type) {
+                if ((buf[1] & 0x7f) == rt->rtsp_streams[i]->sdp_payload_type ||
+                    rt->rtsp_streams[i]->rtx_payload_type &&
+                    (buf[1] & 0x7f) == rt->rtsp_streams[i]->rtx_payload_type) {
                     *rtsp_st = rt->rtsp_streams[i];
                     return len;
                 }
@@ -2178,21 +2196,25 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
 redo:
     if (rt->transport == RTSP_TRANSPORT_RTP) {
         int i;
-        int64_t first_queue_time = 0;
+        int64_t first_deadline = 0;
         for (i = 0; i < rt->nb_rtsp_streams; i++) {
             RTPDemuxContext *rtpctx = rt->rtsp_streams[i]->transport_priv;
-            int64_t queue_time;
+            int64_t queue_time, deadline;
             if (!rtpctx)
                 continue;
             queue_time = ff_rtp_queued_packet_time(rtpctx);
-            if (queue_time && (queue_time - first_queue_time < 0 ||
-                               !first_queue_time)) {
-                first_queue_time = queue_time;
-                first_queue_st   = rt->rtsp_streams[i];
+            if (!queue_time)
+                continue;
+            deadline = queue_time + (rt->adaptive_delay ?
+                                     ff_rtp_reorder_delay(rtpctx, s->max_delay) :
+                                     s->max_delay);
+            if (deadline - first_deadline < 0 || !first_deadline) {
+                first_deadline = deadline;
+                first_queue_st = rt->rtsp_streams[i];
             }
         }
-        if (first_queue_time) {
-            wait_end = first_queue_time + s->max_delay;
+        if (first_deadline) {
+            wait_end = first_deadline;
         } else {
             wait_end = 0;
             first_queue_st = NULL;
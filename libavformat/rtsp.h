@@ -403,6 +403,11 @@ typedef struct RTSPState {
      */
     int reordering_queue_size;
 
+    /**
+     * Adapt the reordering delay to the measured jitter, up to max_delay.
+     */
+    int adaptive_delay;
+
     /**
      * User-Agent string
      */
@@ -469,6 +474,9 @@ typedef struct RTSPStream {
     /** Enable sending RTCP feedback messages according to RFC 4585 */
     int feedback;
 
+    /** RFC 4588 retransmission payload type and its associated payload type */
+    int rtx_payload_type, rtx_apt;
+
     /** SSRC for this stream, to allow identifying RTCP packets before the first RTP packet */
     uint32_t ssrc;
 
@@ -0,0 +1,311 @@
+/*
+ * Sidecar seek index
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * The sidecar index is a text file listing the keyframes of the video
+ * streams of a file:
+ *
+ *     ffseekindex 2 <file size> <file modification time>
+ *     stream <index> <time base num>/<time base den> <first dts>
+ *     <index> <dts> <byte position> <GOP size in packets>
+ *     ...
+ *
+ * The timestamps are decoding timestamps, like in the index lavf builds
+ * itself while demuxing. The keyframes of a stream are in increasing order.
+ * The first dts of the stream aligns the timestamps of a muxer with the
+ * ones seen by the demuxer, which may be offset, e.g. by the mpegts mux
+ * delay.
+ *
+ * The size and the modification time identify the version of the file the
+ * index was written for, an index not matching them is ignored. They are -1
+ * when unknown.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mathematics.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+
+#define SEEK_INDEX_SUFFIX ".ffindex"
+
+typedef struct SeekIndexStream {
+    int last_entry;             ///< the entry counting the current GOP
+    int64_t first_dts;
+} SeekIndexStream;
+
+typedef struct SeekIndexEntry {
+    int stream_index;
+    int64_t dts;
+    int64_t pos;
+    int gop_size;
+} SeekIndexEntry;
+
+struct FFSeekIndexWriter {
+    SeekIndexEntry *entries;
+    int nb_entries;
+    unsigned entries_size;
+    SeekIndexStream *streams;
+    int nb_streams;
+};
+
+/* the demuxers seeking by bisection or by a linear scan without an index */
+static const char * const auto_formats[] = { "mpegts", "h264", "hevc" };
+
+static char *seek_index_path(AVFormatContext *s)
+{
+    const char *proto;
+    int i;
+
+    if (s->seek_index)
+        return av_strdup(s->seek_index);
+
+    proto = avio_find_protocol_name(s->url);
+    if (!proto || strcmp(proto, "file") || !s->iformat)
+        return NULL;
+    for (i = 0; i < FF_ARRAY_ELEMS(auto_formats); i++)
+        if (av_match_name(auto_formats[i], s->iformat->name))
+            return av_asprintf("%s" SEEK_INDEX_SUFFIX, s->url);
+    return NULL;
+}
+
+/**
+ * Get the size and the modification time of the indexed file. The
+ * modification time is only known for local files.
+ */
+static void file_identity(AVFormatContext *s, int64_t *size, int64_t *mtime)
+{
+    const char *proto = avio_find_protocol_name(s->url);
+
+    *size  = s->pb ? avio_size(s->pb) : -1;
+    *mtime = -1;
+    if (*size < 0)
+        *size = -1;
+
+    if (proto && !strcmp(proto, "file")) {
+        const char *filename = s->url;
+        struct stat st;
+
+        av_strstart(filename, "file:", &filename);
+        if (!stat(filename, &st))
+            *mtime = st.st_mtime;
+    }
+}
+
+int ff_seek_index_load(AVFormatContext *s)
+{
+    struct {
+        AVRational tb;
+        int64_t offset;
+        int gop_size;
+    } *sts = NULL;
+    AVIOContext *pb = NULL;
+    char *path, line[256];
+    int64_t size, mtime, cur_size, cur_mtime;
+    int nb_entries = 0, version, ret;
+
+    if (s->internal->seek_index_state)
+        return s->internal->seek_index_state > 0;
+    s->internal->seek_index_state = -1;
+
+    if (!(path = seek_index_path(s)))
+        return 0;
+    if (!s->seek_index && avio_check(path, AVIO_FLAG_READ) < 0) {
+        av_free(path);
+        return 0;
+    }
+
+    ret = ffio_open_whitelist(&pb, path, AVIO_FLAG_READ, &s->interrupt_callback,
+                              NULL, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0)
+        goto end;
+
+    sts = av_calloc(s->nb_streams, sizeof(*sts));
+    if (!sts) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ff_get_chomp_line(pb, line, sizeof(line));
+    if (sscanf(line, "ffseekindex %d %"SCNd64" %"SCNd64, &version, &size, &mtime) != 3 ||
+        version != 2) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    file_identity(s, &cur_size, &cur_mtime);
+    if ((size  >= 0 && cur_size  >= 0 && size  != cur_size) ||
+        (mtime >= 0 && cur_mtime >= 0 && mtime != cur_mtime)) {
+        av_log(s, AV_LOG_WARNING, "The seek index %s was written for another "
+               "version of the input, ignoring it\n", path);
+        ret = 0;
+        goto end;
+    }
+
+    while (!avio_feof(pb)) {
+        int64_t dts, pos;
+        int idx, gop_size, num, den;
+
+        ff_get_chomp_line(pb, line, sizeof(line));
+        if (!line[0])
+            continue;
+        if (sscanf(line, "stream %d %d/%d %"SCNd64, &idx, &num, &den, &dts) == 4) {
+            AVStream *st;
+
+            if (idx < 0 || idx >= s->nb_streams || num <= 0 || den <= 0)
+                continue;
+            st = s->streams[idx];
+            sts[idx].tb = (AVRational){ num, den };
+            if (st->first_dts != AV_NOPTS_VALUE)
+                sts[idx].offset = st->first_dts - av_rescale_q(dts, sts[idx].tb, st->time_base);
+        } else if (sscanf(line, "%d %"SCNd64" %"SCNd64" %d",
+                          &idx, &dts, &pos, &gop_size) == 4) {
+            AVStream *st;
+
+            if (idx < 0 || idx >= s->nb_streams || !sts[idx].tb.num || pos < 0)
+                continue;
+            st  = s->streams[idx];
+            dts = av_rescale_q(dts, sts[idx].tb, st->time_base) + sts[idx].offset;
+            /* the distance is the number of packets since the previous keyframe */
+            ret = av_add_index_entry(st, pos, dts, 0, sts[idx].gop_size, AVINDEX_KEYFRAME);
+            if (ret < 0)
+                goto end;
+            sts[idx].gop_size = gop_size;
+            nb_entries++;
+        } else {
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+    }
+
+    if (nb_entries) {
+        s->internal->seek_index_state = 1;
+        av_log(s, AV_LOG_VERBOSE, "Loaded %d keyframes from %s\n", nb_entries, path);
+    }
+    ret = 0;
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not load the seek index %s: %s\n",
+               path, av_err2str(ret));
+    avio_closep(&pb);
+    av_free(sts);
+    av_free(path);
+    return s->internal->seek_index_state > 0;
+}
+
+int ff_seek_index_add(AVFormatContext *s, const AVPacket *pkt, int64_t pos)
+{
+    FFSeekIndexWriter *w = s->internal->seek_index_writer;
+    AVStream *st = s->streams[pkt->stream_index];
+    SeekIndexStream *sis;
+    SeekIndexEntry *e;
+
+    if (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO)
+        return 0;
+
+    if (!w) {
+        w = s->internal->seek_index_writer = av_mallocz(sizeof(*w));
+        if (!w)
+            return AVERROR(ENOMEM);
+    }
+    if (w->nb_streams < s->nb_streams) {
+        SeekIndexStream *sts = av_realloc_array(w->streams, s->nb_streams, sizeof(*sts));
+        if (!sts)
+            return AVERROR(ENOMEM);
+        for (; w->nb_streams < s->nb_streams; w->nb_streams++) {
+            sts[w->nb_streams].last_entry = -1;
+            sts[w->nb_streams].first_dts  = AV_NOPTS_VALUE;
+        }
+        w->streams = sts;
+    }
+    sis = &w->streams[pkt->stream_index];
+    if (sis->first_dts == AV_NOPTS_VALUE)
+        sis->first_dts = pkt->dts;
+
+    if (!(pkt->flags & AV_PKT_FLAG_KEY) || pkt->dts == AV_NOPTS_VALUE || pos < 0) {
+        if (sis->last_entry >= 0)
+            w->entries[sis->last_entry].gop_size++;
+        return 0;
+    }
+
+    e = av_fast_realloc(w->entries, &w->entries_size,
+                        (w->nb_entries + 1) * sizeof(*w->entries));
+    if (!e)
+        return AVERROR(ENOMEM);
+    w->entries = e;
+
+    e = &w->entries[w->nb_entries];
+    e->stream_index = pkt->stream_index;
+    e->dts          = pkt->dts;
+    e->pos          = pos;
+    e->gop_size     = 1;
+    sis->last_entry = w->nb_entries++;
+    return 0;
+}
+
+int ff_seek_index_write(AVFormatContext *s)
+{
+    FFSeekIndexWriter *w = s->internal->seek_index_writer;
+    AVIOContext *pb;
+    int64_t size, mtime;
+    int i, ret;
+
+    if (!w)
+        return 0;
+
+    // the output is complete and flushed at this point
+    file_identity(s, &size, &mtime);
+
+    ret = ffio_open_whitelist(&pb, s->seek_index, AVIO_FLAG_WRITE, &s->interrupt_callback,
+                              NULL, s->protocol_whitelist, s->protocol_blacklist);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not open the seek index %s\n", s->seek_index);
+        return ret;
+    }
+
+    avio_printf(pb, "ffseekindex 2 %"PRId64" %"PRId64"\n", size, mtime);
+    for (i = 0; i < w->nb_streams; i++)
+        if (w->streams[i].last_entry >= 0)
+            avio_printf(pb, "stream %d %d/%d %"PRId64"\n", i,
+                        s->streams[i]->time_base.num, s->streams[i]->time_base.den,
+                        w->streams[i].first_dts);
+    for (i = 0; i < w->nb_entries; i++) {
+        const SeekIndexEntry *e = &w->entries[i];
+        avio_printf(pb, "%d %"PRId64" %"PRId64" %d\n",
+                    e->stream_index, e->dts, e->pos, e->gop_size);
+    }
+    return avio_closep(&pb);
+}
+
+void ff_seek_index_free(AVFormatContext *s)
+{
+    FFSeekIndexWriter *w = s->internal->seek_index_writer;
+
+    if (!w)
+        return;
+    av_freep(&w->entries);
+    av_freep(&w->streams);
+    av_freep(&s->internal->seek_index_writer);
+}
@@ -30,6 +30,7 @@
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "ioworker.h"
 
 #include "libavutil/avassert.h"
 #include "libavutil/internal.h"
@@ -123,6 +124,9 @@ typedef struct SegmentContext {
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
+
+    int io_queue_size;
+    FFIOWorker *io_worker; ///< closes segments and writes lists in the background
 } SegmentContext;
 
 static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
@@ -287,7 +291,10 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    if (seg->io_worker)
+        ret = avio_open_dyn_buf(&seg->list_pb);
+    else
+        ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -316,6 +323,27 @@ static int segment_list_open(AVFormatContext *s)
     return ret;
 }
 
+static int segment_list_close(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    uint8_t *buf;
+    int size, ret;
+
+    if (!seg->io_worker) {
+        ff_format_io_close(s, &seg->list_pb);
+        if (seg->use_rename)
+            ff_rename(seg->temp_list_filename, seg->list, s);
+        return 0;
+    }
+
+    size = avio_close_dyn_buf(seg->list_pb, &buf);
+    seg->list_pb = NULL;
+    ret = ff_io_worker_write(seg->io_worker, seg->temp_list_filename, NULL, buf, size);
+    if (ret >= 0 && seg->use_rename)
+        ret = ff_io_worker_rename(seg->io_worker, seg->temp_list_filename, seg->list);
+    return ret;
+}
+
 static void segment_list_print_entry(AVIOContext      *list_ioctx,
                                      ListType          list_type,
                                      const SegmentListEntry *list_entry,
@@ -374,6 +402,15 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->url);
 
+    /* queue the close before the list update so the list never references
+     * a segment that is still being written */
+    if (seg->io_worker) {
+        err = ff_io_worker_close(seg->io_worker, oc->pb, oc->url);
+        oc->pb = NULL;
+        if (err < 0)
+            ret = err;
+    }
+
     if (seg->list) {
         if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
             SegmentListEntry *entry = av_mallocz(sizeof(*entry));
@@ -405,9 +442,8 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
             if (seg->list_type == LIST_TYPE_M3U8 && is_last)
                 avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
+            if ((ret = segment_list_close(s)) < 0)
+                goto end;
         } else {
             segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
             avio_flush(seg->list_pb);
@@ -660,6 +696,7 @@ static int select_reference_stream(AVFormatContext *s)
 static void seg_free(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
+    ff_io_worker_free(&seg->io_worker);
     ff_format_io_close(seg->avf, &seg->list_pb);
     avformat_free_context(seg->avf);
     seg->avf = NULL;
@@ -810,6 +847,15 @@ static int seg_init(AVFormatContext *s)
     if (oc->avoid_negative_ts > 0 && s->avoid_negative_ts < 0)
         s->avoid_negative_ts = 1;
 
+    if (seg->io_queue_size > 0) {
+        int err = ff_io_worker_alloc(&seg->io_worker, s, seg->io_queue_size);
+        if (err == AVERROR(ENOSYS))
+            av_log(s, AV_LOG_WARNING, "Background I/O requires threads, "
+                   "closing segments on the muxing thread\n");
+        else if (err < 0)
+            return err;
+    }
+
     return ret;
 }
 
@@ -1004,6 +1050,12 @@ static int seg_write_trailer(struct AVFormatContext *s)
         ret = segment_end(s, 1, 1);
     }
 fail:
+    if (seg->io_worker) {
+        int err = ff_io_worker_flush(seg->io_worker);
+        if (ret >= 0)
+            ret = err;
+        ff_io_worker_free(&seg->io_worker);
+    }
     if (seg->list)
         ff_format_io_close(s, &seg->list_pb);
 
@@ -1078,6 +1130,7 @@ static const AVOption options[] = {
     { "segment_wrap_number", "set the number of wrap before the first segment", OFFSET(segment_idx_wrap_nb), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
     { "strftime",          "set filename expansion with strftime at segment creation", OFFSET(use_strftime), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     { "increment_tc", "increment timecode between each segment", OFFSET(increment_tc), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    { "io_queue_size", "set the number of output operations that may be pending in the background I/O thread", OFFSET(io_queue_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
     { "break_non_keyframes", "allow breaking segments on non-keyframes", OFFSET(break_non_keyframes), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
 
     { "individual_header_trailer", "write header/trailer to each segment", OFFSET(individual_header_trailer), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, E },
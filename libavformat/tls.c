@@ -108,3 +108,28 @@ int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AV
                                 &parent->interrupt_callback, options,
                                 parent->protocol_whitelist, parent->protocol_blacklist, parent);
 }
+
+int ff_tls_alpn_wire(const char *alpn, uint8_t **wire, int *size)
+{
+    int len = strlen(alpn);
+    uint8_t *buf, *out;
+
+    /* each comma becomes a length byte, plus one for the first name */
+    buf = out = av_malloc(len + 1);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    while (*alpn) {
+        int n = strcspn(alpn, ",");
+        if (!n || n > 255) {
+            av_free(buf);
+            return AVERROR(EINVAL);
+        }
+        *out++ = n;
+        memcpy(out, alpn, n);
+        out  += n;
+        alpn += n + !!alpn[n];
+    }
+    *wire = buf;
+    *size = out - buf;
+    return 0;
+}
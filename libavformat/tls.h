@@ -34,6 +34,8 @@ typedef struct TLSShared {
     int listen;
 
     char *host;
+    char *alpn;
+    char *alpn_selected;
 
     char underlying_host[200];
     int numerichost;
@@ -49,10 +51,20 @@ typedef struct TLSShared {
     {"cert_file",  "Certificate file",                    offsetof(pstruct, options_field . cert_file), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"key_file",   "Private key file",                    offsetof(pstruct, options_field . key_file),  AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"listen",     "Listen for incoming connections",     offsetof(pstruct, options_field . listen),    AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }, \
-    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }
+    {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"alpn",       "Comma-separated list of application protocols to offer", offsetof(pstruct, options_field . alpn), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"alpn_selected", "Application protocol selected by the server", offsetof(pstruct, options_field . alpn_selected), AV_OPT_TYPE_STRING, .flags = AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY }
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+/**
+ * Convert the alpn option to the wire format of the ALPN extension, a
+ * sequence of length-prefixed protocol names.
+ *
+ * @param wire set to a buffer allocated with av_malloc()
+ */
+int ff_tls_alpn_wire(const char *alpn, uint8_t **wire, int *size);
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
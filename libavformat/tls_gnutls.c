@@ -181,6 +181,26 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     gnutls_transport_set_push_function(p->session, gnutls_url_push);
     gnutls_transport_set_ptr(p->session, c->tcp);
     gnutls_priority_set_direct(p->session, "NORMAL", NULL);
+#if GNUTLS_VERSION_NUMBER >= 0x030200
+    if (!c->listen && c->alpn) {
+        gnutls_datum_t protos[16];
+        uint8_t *wire;
+        int size, nb_protos = 0;
+        if ((ret = ff_tls_alpn_wire(c->alpn, &wire, &size)) < 0)
+            goto fail;
+        for (int i = 0; i < size && nb_protos < FF_ARRAY_ELEMS(protos); i += 1 + wire[i]) {
+            protos[nb_protos].data = wire + i + 1;
+            protos[nb_protos].size = wire[i];
+            nb_protos++;
+        }
+        ret = gnutls_alpn_set_protocols(p->session, protos, nb_protos, 0);
+        av_free(wire);
+        if (ret < 0) {
+            ret = print_tls_error(h, ret);
+            goto fail;
+        }
+    }
+#endif
     do {
         if (ff_check_interrupt(&h->interrupt_callback)) {
             ret = AVERROR_EXIT;
@@ -194,6 +214,16 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         }
     } while (ret);
     p->need_shutdown = 1;
+#if GNUTLS_VERSION_NUMBER >= 0x030200
+    if (!c->listen && c->alpn) {
+        gnutls_datum_t proto;
+        if (!gnutls_alpn_get_selected_protocol(p->session, &proto) &&
+            !(c->alpn_selected = av_strndup((const char *)proto.data, proto.size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
     if (c->verify) {
         unsigned int status, cert_list_size;
         gnutls_x509_crt_t cert;
@@ -299,6 +299,22 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     SSL_set_bio(p->ssl, bio, bio);
     if (!c->listen && !c->numerichost)
         SSL_set_tlsext_host_name(p->ssl, c->host);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+    if (!c->listen && c->alpn) {
+        uint8_t *wire;
+        int size;
+        if ((ret = ff_tls_alpn_wire(c->alpn, &wire, &size)) < 0)
+            goto fail;
+        /* unlike most OpenSSL functions, this returns 0 on success */
+        ret = SSL_set_alpn_protos(p->ssl, wire, size);
+        av_free(wire);
+        if (ret) {
+            av_log(h, AV_LOG_ERROR, "Unable to set ALPN protocols %s\n", c->alpn);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+    }
+#endif
     ret = c->listen ? SSL_accept(p->ssl) : SSL_connect(p->ssl);
     if (ret == 0) {
         av_log(h, AV_LOG_ERROR, "Unable to negotiate TLS/SSL session\n");
@@ -308,6 +324,17 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = print_tls_error(h, ret);
         goto fail;
     }
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+    if (!c->listen && c->alpn) {
+        const unsigned char *proto;
+        unsigned int len;
+        SSL_get0_alpn_selected(p->ssl, &proto, &len);
+        if (len && !(c->alpn_selected = av_strndup((const char *)proto, len))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+#endif
 
     return 0;
 fail:
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -70,6 +71,10 @@
 #include "libavutil/thread.h"
 #endif
 
+#if HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -79,6 +84,16 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH_SIZE 1024
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_SIZE 65000
+
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+typedef union UDPGSOControl {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+} UDPGSOControl;
+#endif
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -117,6 +132,20 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    /* Datagrams moved per system call by the circular buffer thread */
+    int batch_size;
+    int gso;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    uint8_t *batch_buf;
+    int batch_buf_size;
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_storage *msg_addrs;
+#endif
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    UDPGSOControl *gso_ctrl;
+#endif
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -141,6 +170,8 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Maximum number of datagrams per system call (circular buffer only)", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, UDP_MAX_BATCH_SIZE, .flags = D|E },
+    { "gso",            "Use UDP generic segmentation offload to send batches", OFFSET(gso), AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       E },
     { NULL }
 };
 
@@ -459,6 +490,126 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+static void udp_free_batch(UDPContext *s)
+{
+    av_freep(&s->batch_buf);
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+    av_freep(&s->msg_addrs);
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    av_freep(&s->gso_ctrl);
+#endif
+}
+
+/* Set up the vectors for moving batch_size datagrams of up to slot_size
+ * bytes per system call. */
+static int udp_alloc_batch(UDPContext *s, int slot_size, int is_output)
+{
+    int i;
+
+    s->batch_buf_size = s->batch_size * slot_size;
+    /* a single queued datagram always fits */
+    if (is_output)
+        s->batch_buf_size = FFMAX(s->batch_buf_size, sizeof(s->tmp));
+    s->batch_buf = av_malloc(s->batch_buf_size);
+    s->msgs      = av_calloc(s->batch_size, sizeof(*s->msgs));
+    s->iovs      = av_calloc(s->batch_size, sizeof(*s->iovs));
+    if (!is_output)
+        s->msg_addrs = av_calloc(s->batch_size, sizeof(*s->msg_addrs));
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+    if (is_output && s->gso)
+        s->gso_ctrl = av_calloc(s->batch_size, sizeof(*s->gso_ctrl));
+#endif
+    if (!s->batch_buf || !s->msgs || !s->iovs || (!is_output && !s->msg_addrs)
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+        || (is_output && s->gso && !s->gso_ctrl)
+#endif
+        ) {
+        udp_free_batch(s);
+        return AVERROR(ENOMEM);
+    }
+
+    if (!is_output) {
+        for (i = 0; i < s->batch_size; i++) {
+            s->iovs[i].iov_base = s->batch_buf + i * slot_size;
+            s->iovs[i].iov_len  = slot_size;
+            s->msgs[i].msg_hdr.msg_iov     = &s->iovs[i];
+            s->msgs[i].msg_hdr.msg_iovlen  = 1;
+            s->msgs[i].msg_hdr.msg_name    = &s->msg_addrs[i];
+            s->msgs[i].msg_hdr.msg_namelen = sizeof(s->msg_addrs[i]);
+        }
+    }
+
+    return 0;
+}
+#endif
+
+#if HAVE_SENDMMSG
+/* Send the first n datagrams of s->iovs. With gso, runs of equally sized
+ * datagrams are passed as single messages, segmented again by the kernel
+ * or the network card. */
+static int udp_send_batch(URLContext *h, int n)
+{
+    UDPContext *s = h->priv_data;
+    int i, nb_msgs = 0, sent = 0;
+
+    for (i = 0; i < n; nb_msgs++) {
+        struct msghdr *hdr = &s->msgs[nb_msgs].msg_hdr;
+        int nb_segs = 1;
+
+        memset(hdr, 0, sizeof(*hdr));
+        if (!s->is_connected) {
+            hdr->msg_name    = &s->dest_addr;
+            hdr->msg_namelen = s->dest_addr_len;
+        }
+        hdr->msg_iov    = &s->iovs[i];
+        hdr->msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+        if (s->gso) {
+            /* all segments but the last one must have the same size */
+            uint16_t seg_size = s->iovs[i].iov_len;
+            size_t size = seg_size;
+
+            while (i + nb_segs < n && nb_segs < UDP_GSO_MAX_SEGMENTS &&
+                   s->iovs[i + nb_segs - 1].iov_len == seg_size &&
+                   s->iovs[i + nb_segs].iov_len <= seg_size &&
+                   size + s->iovs[i + nb_segs].iov_len <= UDP_GSO_MAX_SIZE) {
+                size += s->iovs[i + nb_segs].iov_len;
+                nb_segs++;
+            }
+            if (nb_segs > 1) {
+                struct cmsghdr *cm;
+
+                hdr->msg_iovlen     = nb_segs;
+                hdr->msg_control    = s->gso_ctrl[nb_msgs].buf;
+                hdr->msg_controllen = sizeof(s->gso_ctrl[nb_msgs].buf);
+                cm = CMSG_FIRSTHDR(hdr);
+                cm->cmsg_level = IPPROTO_UDP;
+                cm->cmsg_type  = UDP_SEGMENT;
+                cm->cmsg_len   = CMSG_LEN(sizeof(seg_size));
+                memcpy(CMSG_DATA(cm), &seg_size, sizeof(seg_size));
+            }
+        }
+#endif
+        i += nb_segs;
+    }
+
+    while (sent < nb_msgs) {
+        int ret = sendmmsg(s->udp_fd, s->msgs + sent, nb_msgs - sent, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+            continue;
+        }
+        sent += ret;
+    }
+
+    return 0;
+}
+#endif
+
 #if HAVE_PTHREAD_CANCEL
 static void *circular_buffer_task_rx( void *_URLContext)
 {
@@ -474,7 +625,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, i, n = 1;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -483,6 +634,11 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+#if HAVE_RECVMMSG
+        if (s->msgs)
+            len = n = recvmmsg(s->udp_fd, s->msgs, s->batch_size, MSG_WAITFORONE, NULL);
+        else
+#endif
         len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
@@ -493,25 +649,46 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        for (i = 0; i < n; i++) {
+            struct sockaddr_storage *src = &addr;
+            const uint8_t *dg = s->tmp + 4;
+            uint8_t tmp[4];
+
+#if HAVE_RECVMMSG
+            if (s->msgs) {
+                struct msghdr *hdr = &s->msgs[i].msg_hdr;
+
+                if (hdr->msg_flags & MSG_TRUNC)
+                    av_log(h, AV_LOG_WARNING, "Datagram truncated to %d bytes, "
+                           "increase pkt_size\n", (int)hdr->msg_iov->iov_len);
+                src = hdr->msg_name;
+                dg  = hdr->msg_iov->iov_base;
+                len = s->msgs[i].msg_len;
+                hdr->msg_namelen = sizeof(*src);
+            }
+#endif
+            if (ff_ip_check_source_lists(src, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+
+            if(av_fifo_space(s->fifo) < len + 4) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
             }
+            AV_WL32(tmp, len);
+            av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+            av_fifo_generic_write(s->fifo, (uint8_t *)dg, len, NULL);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -540,8 +717,8 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
+        int len, n = 1;
+        const uint8_t *p = s->tmp;
         uint8_t tmp[4];
         int64_t timestamp;
 
@@ -562,8 +739,36 @@ static void *circular_buffer_task_tx( void *_URLContext)
         av_assert0(len >= 0);
         av_assert0(len <= sizeof(s->tmp));
 
+#if HAVE_SENDMMSG
+        if (s->msgs) {
+            /* take the following queued datagrams too, as long as they fit
+             * in the batch and, when pacing, in a burst */
+            int size = len;
+
+            p = s->batch_buf;
+            av_fifo_generic_read(s->fifo, s->batch_buf, len, NULL);
+            s->iovs[0].iov_base = s->batch_buf;
+            s->iovs[0].iov_len  = len;
+            while (n < s->batch_size && av_fifo_size(s->fifo) >= 4) {
+                av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+                len = AV_RL32(tmp);
+                if (size + len > s->batch_buf_size ||
+                    (s->bitrate && (size + len) * 8LL > s->burst_bits))
+                    break;
+                av_fifo_drain(s->fifo, 4);
+                av_fifo_generic_read(s->fifo, s->batch_buf + size, len, NULL);
+                s->iovs[n].iov_base = s->batch_buf + size;
+                s->iovs[n].iov_len  = len;
+                size += len;
+                n++;
+            }
+            len = size;
+        } else
+#endif
         av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
 
+        /* wake up udp_write() if it waits for space */
+        pthread_cond_signal(&s->cond);
         pthread_mutex_unlock(&s->mutex);
 
         if (s->bitrate) {
@@ -586,7 +791,17 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
+#if HAVE_SENDMMSG
+        if (n > 1) {
+            int ret = udp_send_batch(h, n);
+            pthread_mutex_lock(&s->mutex);
+            if (ret < 0) {
+                s->circular_buffer_error = ret;
+                goto end;
+            }
+            continue;
+        }
+#endif
         while (len) {
             int ret;
             av_assert0(len > 0);
@@ -604,6 +819,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
                     pthread_mutex_lock(&s->mutex);
                     s->circular_buffer_error = ret;
+                    pthread_cond_signal(&s->cond);
                     pthread_mutex_unlock(&s->mutex);
                     return NULL;
                 }
@@ -614,6 +830,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
 end:
+    pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
@@ -726,6 +943,10 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p))
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_BATCH_SIZE);
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -876,6 +1097,24 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         }
     }
 
+    if (s->batch_size > 1 && !(is_output ? HAVE_SENDMMSG : HAVE_RECVMMSG))
+        av_log(h, AV_LOG_WARNING,
+               "'batch_size' option was set but it is not supported on this build\n");
+    if (s->gso) {
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+        int gso_size;
+        len = sizeof(gso_size);
+        if (getsockopt(udp_fd, IPPROTO_UDP, UDP_SEGMENT, &gso_size, &len) < 0) {
+            ff_log_net_error(h, AV_LOG_WARNING, "getsockopt(UDP_SEGMENT)");
+            s->gso = 0;
+        }
+#else
+        av_log(h, AV_LOG_WARNING,
+               "'gso' option was set but it is not supported on this build\n");
+        s->gso = 0;
+#endif
+    }
+
     s->udp_fd = udp_fd;
 
 #if HAVE_PTHREAD_CANCEL
@@ -890,9 +1129,21 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         av_log(h, AV_LOG_WARNING,"'bitrate' option was set but 'circular_buffer_size' is not, but required\n");
     }
 
-    if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
+    if ((!is_output && s->circular_buffer_size) ||
+        (is_output && (s->bitrate || s->batch_size > 1) && s->circular_buffer_size)) {
         int ret;
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+        if (s->batch_size > 1 && (is_output ? HAVE_SENDMMSG : HAVE_RECVMMSG)) {
+            /* received datagrams are limited to pkt_size in batches, as
+             * UDP_MAX_PKT_SIZE per datagram would take too much memory */
+            ret = udp_alloc_batch(s, is_output || s->pkt_size <= 0 ? h->max_packet_size :
+                                     FFMIN(s->pkt_size, UDP_MAX_PKT_SIZE), is_output);
+            if (ret < 0)
+                goto fail;
+        }
+#endif
+
         /* start the task going */
         s->fifo = av_fifo_alloc(s->circular_buffer_size);
         ret = pthread_mutex_init(&s->mutex, NULL);
@@ -925,6 +1176,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    udp_free_batch(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return AVERROR(EIO);
 }
@@ -1025,6 +1279,18 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
             return err;
         }
 
+        /* without pacing, the thread sends as fast as it can, so wait
+         * for it to make room */
+        while (!s->bitrate && !(h->flags & AVIO_FLAG_NONBLOCK) &&
+               av_fifo_space(s->fifo) < size + 4 && !s->circular_buffer_error &&
+               size + 4 <= av_fifo_size(s->fifo) + av_fifo_space(s->fifo))
+            pthread_cond_wait(&s->cond, &s->mutex);
+        if (s->circular_buffer_error < 0) {
+            int err = s->circular_buffer_error;
+            pthread_mutex_unlock(&s->mutex);
+            return err;
+        }
+
         if(av_fifo_space(s->fifo) < size + 4) {
             /* What about a partial packet tx ? */
             pthread_mutex_unlock(&s->mutex);
@@ -1094,6 +1360,9 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    udp_free_batch(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -0,0 +1,184 @@
+/*
+ * Minimal io_uring submission/completion ring
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "libavutil/error.h"
+#include "uring.h"
+
+#define LOAD_ACQUIRE(p)     atomic_load_explicit((_Atomic unsigned *)(p), memory_order_acquire)
+#define STORE_RELEASE(p, v) atomic_store_explicit((_Atomic unsigned *)(p), (v), memory_order_release)
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+#ifdef __NR_io_uring_setup
+    return syscall(__NR_io_uring_setup, entries, p);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags)
+{
+#ifdef __NR_io_uring_enter
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   NULL, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int ff_uring_init(FFURing *ring, unsigned entries)
+{
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+    int ret;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = uring_setup(entries, &p);
+    if (ring->fd < 0) {
+        ring->fd = -1;
+        return AVERROR(errno);
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size    = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        goto fail;
+    }
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) {
+        ring->cq_ring = NULL;
+        goto fail;
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        goto fail;
+    }
+
+    sq = ring->sq_ring;
+    cq = ring->cq_ring;
+    ring->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    ring->sq_entries = p.sq_entries;
+    ring->sqe_tail   = *ring->sq_tail;
+    return 0;
+
+fail:
+    ret = AVERROR(errno);
+    ff_uring_uninit(ring);
+    return ret;
+}
+
+void ff_uring_uninit(FFURing *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+int ff_uring_register_buffers(FFURing *ring, const struct iovec *iov, unsigned nb)
+{
+#ifdef __NR_io_uring_register
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, nb) < 0)
+        return AVERROR(errno);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+struct io_uring_sqe *ff_uring_get_sqe(FFURing *ring)
+{
+    struct io_uring_sqe *sqe;
+    unsigned head = LOAD_ACQUIRE(ring->sq_head);
+
+    if (ring->sqe_tail - head >= ring->sq_entries)
+        return NULL;
+    sqe = &ring->sqes[ring->sqe_tail & *ring->sq_mask];
+    ring->sq_array[ring->sqe_tail & *ring->sq_mask] = ring->sqe_tail & *ring->sq_mask;
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int ff_uring_submit(FFURing *ring, unsigned wait_nr)
+{
+    unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+    int ret;
+
+    if (!to_submit && !wait_nr)
+        return 0;
+    STORE_RELEASE(ring->sq_tail, ring->sqe_tail);
+
+    do {
+        ret = uring_enter(ring->fd, to_submit, wait_nr,
+                          wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return AVERROR(errno);
+
+    ring->inflight += ret;
+    return ret;
+}
+
+int ff_uring_get_cqe(FFURing *ring, struct io_uring_cqe *cqe)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == LOAD_ACQUIRE(ring->cq_tail))
+        return AVERROR(EAGAIN);
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    STORE_RELEASE(ring->cq_head, head + 1);
+    ring->inflight--;
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Minimal io_uring submission/completion ring
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_URING_H
+#define AVFORMAT_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/**
+ * A Linux io_uring instance driven through the raw system calls.
+ *
+ * Requests are tagged with a caller chosen user_data, so a single ring may
+ * serve several contexts as long as they are driven from one thread.
+ */
+typedef struct FFURing {
+    int fd;
+
+    void   *sq_ring;
+    size_t  sq_ring_size;
+    void   *cq_ring;
+    size_t  cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t  sqes_size;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned sq_entries;
+    unsigned sqe_tail;      ///< local tail, published by ff_uring_submit()
+    unsigned inflight;      ///< requests submitted but not yet reaped
+} FFURing;
+
+/**
+ * Set up a ring with room for at least entries submissions.
+ *
+ * @return 0 on success, a negative AVERROR code (ENOSYS if the kernel
+ *         lacks io_uring) on failure
+ */
+int ff_uring_init(FFURing *ring, unsigned entries);
+
+void ff_uring_uninit(FFURing *ring);
+
+/**
+ * Register fixed buffers for IORING_OP_READ_FIXED / IORING_OP_WRITE_FIXED.
+ */
+int ff_uring_register_buffers(FFURing *ring, const struct iovec *iov, unsigned nb);
+
+/**
+ * Return a zeroed submission entry, or NULL if the ring is full.
+ */
+struct io_uring_sqe *ff_uring_get_sqe(FFURing *ring);
+
+/**
+ * Submit all queued entries in one system call and optionally wait until
+ * at least wait_nr completions are available.
+ *
+ * @return number of entries submitted or a negative AVERROR code
+ */
+int ff_uring_submit(FFURing *ring, unsigned wait_nr);
+
+/**
+ * Pop one completion without blocking.
+ *
+ * @return 0 if cqe was filled, AVERROR(EAGAIN) if none is available
+ */
+int ff_uring_get_cqe(FFURing *ring, struct io_uring_cqe *cqe);
+
+#endif /* AVFORMAT_URING_H */
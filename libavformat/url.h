@@ -49,8 +49,22 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int64_t readahead_size;     /**< if non zero, ffio_fdopen() reads ahead into a buffer of this size from a background thread */
 } URLContext;
 
+/**
+ * One of the buffers written together by ffurl_writev().
+ */
+typedef struct URLIOVec {
+    const uint8_t *data;
+    int size;
+} URLIOVec;
+
+/**
+ * Maximum number of buffers passed to ffurl_writev() at once.
+ */
+#define URL_MAX_IOV 64
+
 typedef struct URLProtocol {
     const char *name;
     int     (*url_open)( URLContext *h, const char *url, int flags);
@@ -86,6 +100,7 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    int (*url_get_mapping)(URLContext *h, const uint8_t **data, int64_t *size);
     int (*url_shutdown)(URLContext *h, int flags);
     int priv_data_size;
     const AVClass *priv_data_class;
@@ -97,6 +112,12 @@ typedef struct URLProtocol {
     int (*url_delete)(URLContext *h);
     int (*url_move)(URLContext *h_src, URLContext *h_dst);
     const char *default_whitelist;
+    /**
+     * Write the concatenation of iovcnt buffers, like url_write(). As with
+     * url_write(), less than the total size may be written; looping is left
+     * to ffurl_writev().
+     */
+    int (*url_writev)(URLContext *h, const URLIOVec *iov, int iovcnt);
 } URLProtocol;
 
 /**
@@ -202,6 +223,17 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Write the concatenation of iovcnt buffers to the resource accessed by h.
+ * Protocols implementing url_writev send them without copying them into
+ * one buffer first, the others get one ffurl_write() call per buffer.
+ *
+ * @param iovcnt number of buffers, at most URL_MAX_IOV
+ * @return the total size written, or a negative AVERROR code in case of
+ * failure
+ */
+int ffurl_writev(URLContext *h, const URLIOVec *iov, int iovcnt);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
@@ -257,6 +289,14 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Return a read-only memory mapping of the whole resource, if the protocol
+ * provides one. The mapping stays valid until the URLContext is closed.
+ *
+ * @return 0 on success, <0 on error or if the resource is not mapped.
+ */
+int ffurl_get_mapping(URLContext *h, const uint8_t **data, int64_t *size);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -34,9 +34,11 @@
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/timestamp.h"
+#include "libavutil/trace_internal.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/internal.h"
+#include "libavcodec/packet_internal.h"
 #include "libavcodec/raw.h"
 
 #include "avformat.h"
@@ -308,6 +310,10 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     pkt->size = 0;
     pkt->pos  = avio_tell(s);
 
+    /* append_packet_chunked() grows the packet into the pooled buffer */
+    if (s->packet_pool)
+        pkt->buf = avpriv_packet_pool_get(s->packet_pool, size);
+
     return append_packet_chunked(s, pkt, size);
 }
 
@@ -570,6 +576,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
         goto fail;
     s->probe_score = ret;
 
+    if (s->flags & AVFMT_FLAG_POOL_PACKETS && s->pb) {
+        s->internal->packet_pool = avpriv_packet_pool_alloc();
+        if (!s->internal->packet_pool) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        s->pb->packet_pool = s->internal->packet_pool;
+    }
+
     if (!s->protocol_whitelist && s->pb && s->pb->protocol_whitelist) {
         s->protocol_whitelist = av_strdup(s->pb->protocol_whitelist);
         if (!s->protocol_whitelist) {
@@ -675,6 +690,8 @@ close:
 fail:
     ff_id3v2_free_extra_meta(&id3v2_extra_meta);
     av_dict_free(&tmp);
+    if (s->pb)
+        s->pb->packet_pool = NULL;
     if (s->pb && !(s->flags & AVFMT_FLAG_CUSTOM_IO))
         avio_closep(&s->pb);
     avformat_free_context(s);
@@ -1770,7 +1787,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     return ret;
 }
 
-int av_read_frame(AVFormatContext *s, AVPacket *pkt)
+static int read_frame(AVFormatContext *s, AVPacket *pkt)
 {
     const int genpts = s->flags & AVFMT_FLAG_GENPTS;
     int eof = 0;
@@ -1868,6 +1885,17 @@ return_packet:
     return ret;
 }
 
+int av_read_frame(AVFormatContext *s, AVPacket *pkt)
+{
+    int ret;
+
+    avpriv_trace_begin("lavf", "read_frame", AV_NOPTS_VALUE, -1);
+    ret = read_frame(s, pkt);
+    avpriv_trace_end("lavf", "read_frame", ret < 0 ? AV_NOPTS_VALUE : pkt->pts,
+                     ret < 0 ? -1 : pkt->stream_index);
+    return ret;
+}
+
 /* XXX: suppress the packet queue */
 static void flush_packet_queue(AVFormatContext *s)
 {
@@ -2473,6 +2501,26 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     return 0;
 }
 
+static int seek_frame_index(AVFormatContext *s, int stream_index,
+                            int64_t timestamp, int flags)
+{
+    AVStream *st = s->streams[stream_index];
+    AVIndexEntry *ie;
+    int64_t ret;
+    int index;
+
+    index = av_index_search_timestamp(st, timestamp, flags);
+    if (index < 0)
+        return -1;
+
+    ie = &st->index_entries[index];
+    if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
+        return ret;
+    ff_update_cur_dts(s, st, ie->timestamp);
+
+    return 0;
+}
+
 static int seek_frame_internal(AVFormatContext *s, int stream_index,
                                int64_t timestamp, int flags)
 {
@@ -2497,6 +2545,15 @@ static int seek_frame_internal(AVFormatContext *s, int stream_index,
                                AV_TIME_BASE * (int64_t) st->time_base.num);
     }
 
+    /* a sidecar index makes the demuxer specific search unneeded */
+    if (ff_seek_index_load(s) &&
+        s->streams[stream_index]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+        s->streams[stream_index]->nb_index_entries) {
+        ff_read_frame_flush(s);
+        if (seek_frame_index(s, stream_index, timestamp, flags) >= 0)
+            return 0;
+    }
+
     /* first, we try the format specific seek */
     if (s->iformat->read_seek) {
         ff_read_frame_flush(s);
@@ -3650,6 +3707,11 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         av_log(ic, AV_LOG_DEBUG, "Before avformat_find_stream_info() pos: %"PRId64" bytes read:%"PRId64" seeks:%d nb_streams:%d\n",
                avio_tell(ic->pb), ic->pb->bytes_read, ic->pb->seek_count, ic->nb_streams);
 
+    if (ic->stream_info_cache && ff_stream_info_cache_load(ic)) {
+        ret = 0;
+        goto stream_info_found;
+    }
+
     for (i = 0; i < ic->nb_streams; i++) {
         const AVCodec *codec;
         AVDictionary *thread_opt = NULL;
@@ -3760,6 +3822,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 fps_analyze_framecount *= 2;
             if (!tb_unreliable(st->internal->avctx))
                 fps_analyze_framecount = 0;
+            if (ic->flags & AVFMT_FLAG_FAST_INFO)
+                fps_analyze_framecount = 0;
             if (ic->fps_probe_size >= 0)
                 fps_analyze_framecount = ic->fps_probe_size;
             if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
@@ -3775,7 +3839,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
             }
             // Look at the first 3 frames if there is evidence of frame delay
             // but the decoder delay is not set.
-            if (st->info->frame_delay_evidence && count < 2 && st->internal->avctx->has_b_frames == 0)
+            if (st->info->frame_delay_evidence && count < 2 && st->internal->avctx->has_b_frames == 0 &&
+                !(ic->flags & AVFMT_FLAG_FAST_INFO))
                 break;
             if (!st->internal->avctx->extradata &&
                 (!st->internal->extract_extradata.inited ||
@@ -3794,8 +3859,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (i == ic->nb_streams) {
                 analyzed_all_streams = 1;
                 /* NOTE: If the format has no header, then we need to read some
-                 * packets to get most of the streams, so we cannot stop here. */
-                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+                 * packets to get most of the streams, so we cannot stop here,
+                 * unless asked to trust the streams found so far. */
+                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+                    ((ic->flags & AVFMT_FLAG_FAST_INFO) && ic->nb_streams)) {
                     /* If we found the info for all the codecs, we can stop. */
                     ret = count;
                     av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -4139,6 +4206,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
+stream_info_found:
     compute_chapters_end(ic);
 
     /* update the stream parameters from the internal codec contexts */
@@ -4204,6 +4272,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    if (ic->stream_info_cache && ret >= 0)
+        ff_stream_info_cache_store(ic);
+
 find_stream_info_err:
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
@@ -4481,6 +4552,9 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_dict_free(&s->internal->id3v2_meta);
+    /* the callers have detached the pool from s->pb */
+    avpriv_packet_pool_free(&s->internal->packet_pool);
+    ff_seek_index_free(s);
     av_freep(&s->streams);
     flush_packet_queue(s);
     av_freep(&s->internal);
@@ -4509,6 +4583,10 @@ void avformat_close_input(AVFormatContext **ps)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
 
+    /* a custom AVIOContext outlives us */
+    if (s->pb)
+        s->pb->packet_pool = NULL;
+
     avformat_free_context(s);
 
     *ps = NULL;
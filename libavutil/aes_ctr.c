@@ -22,15 +22,21 @@
 #include "common.h"
 #include "aes_ctr.h"
 #include "aes.h"
+#include "intreadwrite.h"
+#include "mem.h"
 #include "random_seed.h"
 
 #define AES_BLOCK_SIZE (16)
 
+/* number of counter blocks encrypted with a single av_aes_crypt() call */
+#define AES_CTR_BATCH  (32)
+
 typedef struct AVAESCTR {
     struct AVAES* aes;
     uint8_t counter[AES_BLOCK_SIZE];
     uint8_t encrypted_counter[AES_BLOCK_SIZE];
     int block_offset;
+    DECLARE_ALIGNED(16, uint8_t, keystream)[AES_CTR_BATCH * AES_BLOCK_SIZE];
 } AVAESCTR;
 
 struct AVAESCTR *av_aes_ctr_alloc(void)
@@ -111,25 +117,37 @@ void av_aes_ctr_increment_iv(struct AVAESCTR *a)
 void av_aes_ctr_crypt(struct AVAESCTR *a, uint8_t *dst, const uint8_t *src, int count)
 {
     const uint8_t* src_end = src + count;
-    const uint8_t* cur_end_pos;
-    uint8_t* encrypted_counter_pos;
+    int i;
+
+    /* finish the keystream block left over by the previous call */
+    while (a->block_offset && src < src_end) {
+        *dst++ = *src++ ^ a->encrypted_counter[a->block_offset++];
+        a->block_offset &= (AES_BLOCK_SIZE - 1);
+    }
 
-    while (src < src_end) {
-        if (a->block_offset == 0) {
-            av_aes_crypt(a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
+    /* whole blocks: encrypt the counters in batches, so that the ECB
+     * implementation can process several blocks in parallel */
+    while (src_end - src >= AES_BLOCK_SIZE) {
+        int nb_blocks = FFMIN((src_end - src) / AES_BLOCK_SIZE, AES_CTR_BATCH);
 
+        for (i = 0; i < nb_blocks; i++) {
+            memcpy(a->keystream + i * AES_BLOCK_SIZE, a->counter, AES_BLOCK_SIZE);
             av_aes_ctr_increment_be64(a->counter + 8);
         }
+        av_aes_crypt(a->aes, a->keystream, a->keystream, nb_blocks, NULL, 0);
 
-        encrypted_counter_pos = a->encrypted_counter + a->block_offset;
-        cur_end_pos = src + AES_BLOCK_SIZE - a->block_offset;
-        cur_end_pos = FFMIN(cur_end_pos, src_end);
+        for (i = 0; i < nb_blocks * AES_BLOCK_SIZE; i += 8)
+            AV_WN64(dst + i, AV_RN64(src + i) ^ AV_RN64(a->keystream + i));
+        src += nb_blocks * AES_BLOCK_SIZE;
+        dst += nb_blocks * AES_BLOCK_SIZE;
+    }
 
-        a->block_offset += cur_end_pos - src;
-        a->block_offset &= (AES_BLOCK_SIZE - 1);
+    /* start a new keystream block for the remaining bytes */
+    if (src < src_end) {
+        av_aes_crypt(a->aes, a->encrypted_counter, a->counter, 1, NULL, 0);
+        av_aes_ctr_increment_be64(a->counter + 8);
 
-        while (src < cur_end_pos) {
-            *dst++ = *src++ ^ *encrypted_counter_pos++;
-        }
+        while (src < src_end)
+            *dst++ = *src++ ^ a->encrypted_counter[a->block_offset++];
     }
 }
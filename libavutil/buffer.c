@@ -23,6 +23,7 @@
 #include "avassert.h"
 #include "buffer_internal.h"
 #include "common.h"
+#include "cpu_internal.h"
 #include "mem.h"
 #include "thread.h"
 
@@ -231,6 +232,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     pool->alloc     = av_buffer_alloc; // fallback
     pool->pool_free = pool_free;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -247,23 +249,47 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    atomic_init(&pool->pool, 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
 }
 
+static AVBufferRef *pool_alloc_numa(void *opaque, int size)
+{
+    AVBufferRef *ret = av_buffer_alloc(size);
+
+    if (ret) {
+        /* placed before the pages are touched, so that nothing has to move */
+        ff_numa_bind_memory(ret->data, size, (intptr_t)opaque);
+        memset(ret->data, 0, size);
+    }
+    return ret;
+}
+
+AVBufferPool *av_buffer_pool_init_numa(int size, int numa_node)
+{
+    if (numa_node < 0)
+        return av_buffer_pool_init(size, av_buffer_allocz);
+    return av_buffer_pool_init2(size, (void *)(intptr_t)numa_node,
+                                pool_alloc_numa, NULL);
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolEntry *buf = (BufferPoolEntry*)atomic_load_explicit(&pool->pool,
+                                                                  memory_order_acquire);
+
+    while (buf) {
+        BufferPoolEntry *next = buf->next;
 
         buf->free(buf->opaque, buf->data);
         av_freep(&buf);
+        buf = next;
     }
     ff_mutex_destroy(&pool->mutex);
 
@@ -286,6 +312,34 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+static void pool_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    intptr_t head = atomic_load_explicit(&pool->pool, memory_order_relaxed);
+
+    do {
+        buf->next = (BufferPoolEntry*)head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->pool, &head,
+                                                    (intptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/* only called with pool->mutex held, so that no other entry can be popped
+ * meanwhile: the head cannot be popped and pushed back under our feet, so
+ * its next pointer is still valid if the compare-and-swap succeeds */
+static BufferPoolEntry *pool_pop(AVBufferPool *pool)
+{
+    intptr_t head = atomic_load_explicit(&pool->pool, memory_order_acquire);
+
+    while (head && !atomic_compare_exchange_weak_explicit(&pool->pool, &head,
+                                                          (intptr_t)((BufferPoolEntry*)head)->next,
+                                                          memory_order_acquire,
+                                                          memory_order_acquire))
+        ;
+
+    return (BufferPoolEntry*)head;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -294,10 +348,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_push(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -339,15 +390,20 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
     AVBufferRef *ret;
     BufferPoolEntry *buf;
 
+    /* Only the release side is lock-free. Popping without the mutex would
+     * need an ABA-safe head (e.g. a pointer and a counter swapped with a
+     * double-width compare-and-swap), which C11 atomics do not provide
+     * portably. The mutex also serializes the pool allocation callbacks,
+     * some of which (hwcontext surface pools) rely on it. */
     ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_pop(pool);
     if (buf) {
         ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                                buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
+        if (ret)
             buf->next = NULL;
-        }
+        else
+            pool_push(pool, buf);
     } else {
         ret = pool_alloc_buffer(pool);
     }
@@ -267,6 +267,21 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque));
 
+/**
+ * Allocate and initialize a buffer pool whose buffers are placed in the
+ * memory of a NUMA node, for data mostly accessed by threads running on that
+ * node (see av_cpu_numa_bind_thread()).
+ *
+ * The buffers are zero-initialized, as with av_buffer_allocz(). Placement is
+ * best effort: if the system does not support it, or the node is out of
+ * memory, the buffers are allocated as usual.
+ *
+ * @param size size of each buffer in this pool
+ * @param numa_node the NUMA node, or -1 for no placement
+ * @return newly created buffer pool on success, NULL on error.
+ */
+AVBufferPool *av_buffer_pool_init_numa(int size, int numa_node);
+
 /**
  * Mark the pool as being available for freeing. It will actually be freed only
  * once all the allocated buffers associated with the pool are released. Thus it
@@ -75,8 +75,21 @@ typedef struct BufferPoolEntry {
 } BufferPoolEntry;
 
 struct AVBufferPool {
+    /*
+     * Serializes the getters: only one thread pops from the free stack at a
+     * time, and the alloc callbacks, some of which rely on it, are called
+     * with it held. Releasing a buffer does not take it.
+     */
     AVMutex mutex;
-    BufferPoolEntry *pool;
+
+    /*
+     * Stack of the free BufferPoolEntry, stored as an intptr_t. Released
+     * buffers are pushed with a compare-and-swap, without the mutex. Pops
+     * are also done with a compare-and-swap, but only with the mutex held;
+     * with a single popper at a time an entry cannot be popped and pushed
+     * back during a pop, so the stack is not subject to the ABA problem.
+     */
+    atomic_intptr_t pool;
 
     /*
      * This is used to track when the pool is to be freed.
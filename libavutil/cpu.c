@@ -16,6 +16,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for the CPU_* macros of sched.h, must come before any system header */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdatomic.h>
@@ -28,9 +33,6 @@
 #include "common.h"
 
 #if HAVE_SCHED_GETAFFINITY
-#ifndef _GNU_SOURCE
-# define _GNU_SOURCE
-#endif
 #include <sched.h>
 #endif
 #if HAVE_GETPROCESSAFFINITYMASK || HAVE_WINRT
@@ -46,6 +48,16 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if defined(__linux__)
+#include <stdio.h>
+#include <sys/syscall.h>
+#endif
+
+#if HAVE_SCHED_GETAFFINITY && defined(CPU_SET) && defined(__linux__)
+#define HAVE_NUMA_SYSFS 1
+#else
+#define HAVE_NUMA_SYSFS 0
+#endif
 
 static atomic_int cpu_flags = ATOMIC_VAR_INIT(-1);
 
@@ -306,6 +318,138 @@ int av_cpu_count(void)
     return nb_cpus;
 }
 
+#if HAVE_NUMA_SYSFS
+static int read_node_file(int node, const char *name, char *buf, int size)
+{
+    char path[64];
+    FILE *f;
+    int ret = 0;
+
+    if (node < 0)
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s", name);
+    else
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/%s", node, name);
+
+    if (!(f = fopen(path, "r")))
+        return AVERROR(ENOSYS);
+    if (!fgets(buf, size, f))
+        ret = AVERROR(EINVAL);
+    fclose(f);
+    return ret;
+}
+
+/**
+ * Parse a sysfs list like "0-3,8-11", adding its members to set if not NULL.
+ * @return the largest member, or a negative AVERROR code
+ */
+static int parse_list(const char *s, cpu_set_t *set)
+{
+    int last = AVERROR(EINVAL);
+
+    while (*s >= '0' && *s <= '9') {
+        char *end;
+        int a = strtol(s, &end, 10), b = a;
+
+        if (*end == '-')
+            b = strtol(end + 1, &end, 10);
+        if (a < 0 || b < a)
+            return AVERROR(EINVAL);
+        for (last = a; set && last <= b && last < CPU_SETSIZE; last++)
+            CPU_SET(last, set);
+        last = b;
+        s    = *end == ',' ? end + 1 : end;
+    }
+    return last;
+}
+
+static int get_node_cpus(int node, cpu_set_t *set)
+{
+    char buf[4096];
+    int ret;
+
+    if (node < 0)
+        return AVERROR(EINVAL);
+    if ((ret = read_node_file(node, "cpulist", buf, sizeof(buf))) < 0)
+        return ret == AVERROR(ENOSYS) ? AVERROR(EINVAL) : ret;
+
+    CPU_ZERO(set);
+    if ((ret = parse_list(buf, set)) < 0)
+        return ret;
+    return CPU_COUNT(set) ? 0 : AVERROR(EINVAL);
+}
+#endif
+
+int av_cpu_numa_node_count(void)
+{
+#if HAVE_NUMA_SYSFS
+    char buf[256];
+    int last;
+
+    if (read_node_file(-1, "possible", buf, sizeof(buf)) < 0 ||
+        (last = parse_list(buf, NULL)) < 0)
+        return 1;
+    return last + 1;
+#else
+    return 1;
+#endif
+}
+
+int av_cpu_numa_bind_thread(int node)
+{
+#if HAVE_NUMA_SYSFS
+    cpu_set_t set;
+    int ret;
+
+    if ((ret = get_node_cpus(node, &set)) < 0)
+        return ret;
+    /* on Linux, pid 0 is the calling thread, not the whole process */
+    if (sched_setaffinity(0, sizeof(set), &set))
+        return AVERROR(errno);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_numa_node_cpu_count(int node)
+{
+#if HAVE_NUMA_SYSFS
+    cpu_set_t set;
+    int ret;
+
+    if ((ret = get_node_cpus(node, &set)) < 0)
+        return ret;
+    return CPU_COUNT(&set);
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_numa_bind_memory(void *ptr, size_t size, int node)
+{
+#if HAVE_NUMA_SYSFS && defined(SYS_mbind)
+    /* from linux/mempolicy.h */
+    enum { MPOL_PREFERRED = 1, MPOL_MF_MOVE = 1 << 1 };
+    unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+    uintptr_t page  = sysconf(_SC_PAGESIZE);
+    uintptr_t start = FFALIGN((uintptr_t)ptr, page);
+    uintptr_t end   = ((uintptr_t)ptr + size) & ~(page - 1);
+
+    if (node < 0 || node >= 8 * sizeof(nodemask))
+        return AVERROR(EINVAL);
+    if (end <= start)
+        return 0;
+
+    nodemask[node / (8 * sizeof(*nodemask))] |= 1UL << (node % (8 * sizeof(*nodemask)));
+    if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, nodemask,
+                8 * sizeof(nodemask), MPOL_MF_MOVE))
+        return AVERROR(errno);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 size_t av_cpu_max_align(void)
 {
     if (ARCH_AARCH64)
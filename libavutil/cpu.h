@@ -116,6 +116,23 @@ int av_parse_cpu_caps(unsigned *flags, const char *s);
  */
 int av_cpu_count(void);
 
+/**
+ * @return the number of NUMA nodes of the system, 1 if unknown.
+ */
+int av_cpu_numa_node_count(void);
+
+/**
+ * Restrict the calling thread to the CPUs of a NUMA node.
+ *
+ * Memory first touched by the thread is then normally allocated on that
+ * node too.
+ *
+ * @param node the node, between 0 and av_cpu_numa_node_count() - 1
+ * @return 0 on success, AVERROR(ENOSYS) if unsupported on this system, or
+ *         another negative AVERROR code on failure
+ */
+int av_cpu_numa_bind_thread(int node);
+
 /**
  * Get the maximum data alignment that may be required by FFmpeg.
  *
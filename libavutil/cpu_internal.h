@@ -51,4 +51,15 @@ size_t ff_get_cpu_max_align_arm(void);
 size_t ff_get_cpu_max_align_ppc(void);
 size_t ff_get_cpu_max_align_x86(void);
 
+/**
+ * @return the number of CPUs of a NUMA node, or a negative AVERROR code
+ */
+int ff_numa_node_cpu_count(int node);
+
+/**
+ * Ask for the pages fully inside [ptr, ptr + size) to be placed on a NUMA
+ * node, moving those already allocated.
+ */
+int ff_numa_bind_memory(void *ptr, size_t size, int node);
+
 #endif /* AVUTIL_CPU_INTERNAL_H */
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
 #include <string.h>
 
 #include "avstring.h"
@@ -27,11 +28,143 @@
 #include "time_internal.h"
 #include "bprint.h"
 
+/* number of entries from which lookups go through the hash index */
+#define HASH_MIN_ENTRIES 16
+#define HASH_DELETED     UINT_MAX
+
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+
+    /**
+     * Open addressing index over elems, keyed by the case-folded key.
+     * A slot holds 0 when free, HASH_DELETED when its entry was removed,
+     * and the entry index plus one otherwise.
+     */
+    unsigned *hash;
+    unsigned hash_size;     ///< number of slots, a power of 2
+    unsigned hash_used;     ///< number of slots that are not free
+
+    int has_dups;           ///< some keys may be equal ignoring case
 };
 
+static unsigned hash_key(const char *key)
+{
+    uint32_t h = 2166136261U;
+    while (*key)
+        h = (h ^ av_toupper((uint8_t)*key++)) * 16777619U;
+    return h;
+}
+
+static AVDictionaryEntry *hash_get(const AVDictionary *m, const char *key,
+                                   int flags)
+{
+    unsigned mask = m->hash_size - 1, best = UINT_MAX;
+
+    /* the first match in insertion order wins, as with a linear search */
+    for (unsigned i = hash_key(key) & mask; m->hash[i]; i = (i + 1) & mask) {
+        unsigned idx = m->hash[i] - 1;
+        const char *s;
+
+        if (m->hash[i] == HASH_DELETED || idx >= best)
+            continue;
+        s = m->elems[idx].key;
+        if (flags & AV_DICT_MATCH_CASE ? !strcmp(s, key) : !av_strcasecmp(s, key))
+            best = idx;
+    }
+    return best == UINT_MAX ? NULL : &m->elems[best];
+}
+
+static unsigned *hash_slot(AVDictionary *m, unsigned idx)
+{
+    unsigned mask = m->hash_size - 1, i = hash_key(m->elems[idx].key) & mask;
+
+    while (m->hash[i] != idx + 1)
+        i = (i + 1) & mask;
+    return &m->hash[i];
+}
+
+static void hash_insert(AVDictionary *m, unsigned idx)
+{
+    unsigned mask = m->hash_size - 1, i = hash_key(m->elems[idx].key) & mask;
+
+    while (m->hash[i] && m->hash[i] != HASH_DELETED)
+        i = (i + 1) & mask;
+    m->hash_used += !m->hash[i];
+    m->hash[i] = idx + 1;
+}
+
+/**
+ * Make room in the index for one more entry, rebuilding it without the
+ * deleted slots when needed. The index is only an accelerator: if it cannot
+ * be allocated, lookups fall back to a linear search.
+ */
+static void hash_reserve(AVDictionary *m)
+{
+    unsigned size = FFMAX(m->hash_size, 32);
+
+    if (!m->hash && m->count + 1 < HASH_MIN_ENTRIES)
+        return;
+    if (m->hash && (m->hash_used + 1) * 4 <= m->hash_size * 3)
+        return;
+
+    while (size < 2 * (m->count + 1))
+        size *= 2;
+    av_freep(&m->hash);
+    m->hash_size = m->hash_used = 0;
+    if (!(m->hash = av_calloc(size, sizeof(*m->hash))))
+        return;
+    m->hash_size = size;
+    for (int i = 0; i < m->count; i++)
+        hash_insert(m, i);
+}
+
+static void dict_free(AVDictionary *m)
+{
+    if (m) {
+        while (m->count--) {
+            av_freep(&m->elems[m->count].key);
+            av_freep(&m->elems[m->count].value);
+        }
+        av_freep(&m->elems);
+        av_freep(&m->hash);
+        av_free(m);
+    }
+}
+
+static AVDictionary *dict_clone(const AVDictionary *src)
+{
+    AVDictionary *m = av_mallocz(sizeof(*m));
+
+    if (!m)
+        return NULL;
+    m->has_dups = src->has_dups;
+    if (!(m->elems = av_malloc_array(src->count, sizeof(*m->elems))))
+        goto fail;
+    for (; m->count < src->count; m->count++) {
+        const AVDictionaryEntry *e = &src->elems[m->count];
+        char *key   = av_strdup(e->key);
+        char *value = av_strdup(e->value);
+        if (!key || (e->value && !value)) {
+            av_free(key);
+            av_free(value);
+            goto fail;
+        }
+        m->elems[m->count].key   = key;
+        m->elems[m->count].value = value;
+    }
+    if (src->hash) {
+        if ((m->hash = av_memdup(src->hash, src->hash_size * sizeof(*m->hash)))) {
+            m->hash_size = src->hash_size;
+            m->hash_used = src->hash_used;
+        }
+    }
+    return m;
+fail:
+    dict_free(m);
+    return NULL;
+}
+
 int av_dict_count(const AVDictionary *m)
 {
     return m ? m->count : 0;
@@ -45,6 +178,9 @@ AVDictionaryEntry *av_dict_get(const AVDictionary *m, const char *key,
     if (!m)
         return NULL;
 
+    if (m->hash && !prev && !(flags & AV_DICT_IGNORE_SUFFIX))
+        return hash_get(m, key, flags);
+
     if (prev)
         i = prev - m->elems + 1;
     else
@@ -96,6 +232,12 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_free(copy_value);
             return 0;
         }
+        if (m->hash) {
+            unsigned idx = tag - m->elems, last = m->count - 1;
+            *hash_slot(m, idx) = HASH_DELETED;
+            if (idx != last)
+                *hash_slot(m, last) = idx + 1;
+        }
         if (flags & AV_DICT_APPEND)
             oldval = tag->value;
         else
@@ -110,6 +252,9 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
         m->elems = tmp;
     }
     if (copy_value) {
+        if ((flags & (AV_DICT_MULTIKEY | AV_DICT_MATCH_CASE)) && !m->has_dups)
+            m->has_dups = !!av_dict_get(m, copy_key, NULL, 0);
+        hash_reserve(m);
         m->elems[m->count].key = copy_key;
         m->elems[m->count].value = copy_value;
         if (oldval && flags & AV_DICT_APPEND) {
@@ -124,21 +269,19 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value,
             av_freep(&copy_value);
         }
         m->count++;
+        if (m->hash)
+            hash_insert(m, m->count - 1);
     } else {
         av_freep(&copy_key);
     }
-    if (!m->count) {
-        av_freep(&m->elems);
-        av_freep(pm);
-    }
+    if (!m->count)
+        av_dict_free(pm);
 
     return 0;
 
 err_out:
-    if (m && !m->count) {
-        av_freep(&m->elems);
-        av_freep(pm);
-    }
+    if (m && !m->count)
+        av_dict_free(pm);
     av_free(copy_key);
     av_free(copy_value);
     return AVERROR(ENOMEM);
@@ -202,22 +345,24 @@ int av_dict_parse_string(AVDictionary **pm, const char *str,
 
 void av_dict_free(AVDictionary **pm)
 {
-    AVDictionary *m = *pm;
-
-    if (m) {
-        while (m->count--) {
-            av_freep(&m->elems[m->count].key);
-            av_freep(&m->elems[m->count].value);
-        }
-        av_freep(&m->elems);
-    }
-    av_freep(pm);
+    dict_free(*pm);
+    *pm = NULL;
 }
 
 int av_dict_copy(AVDictionary **dst, const AVDictionary *src, int flags)
 {
     AVDictionaryEntry *t = NULL;
 
+    /* Copying into an empty dictionary yields the same entries in the same
+     * order, unless duplicate keys would be merged, so clone the source with
+     * its index in one go. */
+    if (!*dst && src && src->count &&
+        !(flags & ~(AV_DICT_MULTIKEY | AV_DICT_DONT_OVERWRITE | AV_DICT_APPEND)) &&
+        ((flags & AV_DICT_MULTIKEY) || !src->has_dups)) {
+        *dst = dict_clone(src);
+        return *dst ? 0 : AVERROR(ENOMEM);
+    }
+
     while ((t = av_dict_get(src, "", t, AV_DICT_IGNORE_SUFFIX))) {
         int ret = av_dict_set(dst, t->key, t->value, flags);
         if (ret < 0)
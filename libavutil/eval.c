@@ -167,15 +167,37 @@ struct AVExpr {
     } type;
     double value; // is sign in other types
     int const_index;
-    union {
+    union ExprFunc {
         double (*func0)(double);
         double (*func1)(void *, double);
         double (*func2)(void *, double, double);
     } a;
     struct AVExpr *param[3];
     double *var;
+
+    /* flat program compiled from the tree, only set in the root node */
+    struct ExprInsn *insn;
+    int nb_insn;
+    int lazy;      ///< the program calls user functions in an if() branch
+    int nb_consts; ///< number of entries in const_names
 };
 
+/**
+ * One node of the compiled program. Instructions are stored in postorder,
+ * instruction i writes register i and reads the registers in src
+ * (-1 for an absent operand).
+ */
+typedef struct ExprInsn {
+    int type;
+    double value;
+    int const_index;
+    union ExprFunc a;
+    int src[3];
+} ExprInsn;
+
+#define MAX_SCALAR_INSN 128
+#define BATCH_SIZE 64
+
 static double etime(double v)
 {
     return av_gettime() * 0.000001;
@@ -331,6 +353,61 @@ static double eval_expr(Parser *p, AVExpr *e)
     return NAN;
 }
 
+/* scalar counterpart of eval_expr() for one compiled instruction */
+static double eval_insn(const ExprInsn *in, const double *r,
+                        const double *const_values, void *opaque)
+{
+    double d  = in->src[0] >= 0 ? r[in->src[0]] : 0;
+    double d2 = in->src[1] >= 0 ? r[in->src[1]] : 0;
+    double d3 = in->src[2] >= 0 ? r[in->src[2]] : 0;
+
+    switch (in->type) {
+        case e_value:  return in->value;
+        case e_const:  return in->value * const_values[in->const_index];
+        case e_func0:  return in->value * in->a.func0(d);
+        case e_func1:  return in->value * in->a.func1(opaque, d);
+        case e_func2:  return in->value * in->a.func2(opaque, d, d2);
+        case e_squish: return 1/(1+exp(4*d));
+        case e_gauss:  return exp(-d*d/2)/sqrt(2*M_PI);
+        case e_isnan:  return in->value * !!isnan(d);
+        case e_isinf:  return in->value * !!isinf(d);
+        case e_floor:  return in->value * floor(d);
+        case e_ceil :  return in->value * ceil (d);
+        case e_trunc:  return in->value * trunc(d);
+        case e_round:  return in->value * round(d);
+        case e_sgn:    return in->value * FFDIFFSIGN(d, 0);
+        case e_sqrt:   return in->value * sqrt (d);
+        case e_not:    return in->value * (d == 0);
+        case e_if:     return in->value * ( d ? d2 : d3);
+        case e_ifnot:  return in->value * (!d ? d2 : d3);
+        case e_clip:
+            if (isnan(d2) || isnan(d3) || isnan(d) || d2 > d3)
+                return NAN;
+            return in->value * av_clipd(d, d2, d3);
+        case e_between: return in->value * (d >= d2 && d <= d3);
+        case e_lerp:   return d + (d2 - d) * d3;
+        case e_mod:    return in->value * (d - floor((!CONFIG_FTRAPV || d2) ? d / d2 : d * INFINITY) * d2);
+        case e_gcd:    return in->value * av_gcd(d,d2);
+        case e_max:    return in->value * (d >  d2 ?   d : d2);
+        case e_min:    return in->value * (d <  d2 ?   d : d2);
+        case e_eq:     return in->value * (d == d2 ? 1.0 : 0.0);
+        case e_gt:     return in->value * (d >  d2 ? 1.0 : 0.0);
+        case e_gte:    return in->value * (d >= d2 ? 1.0 : 0.0);
+        case e_lt:     return in->value * (d <  d2 ? 1.0 : 0.0);
+        case e_lte:    return in->value * (d <= d2 ? 1.0 : 0.0);
+        case e_pow:    return in->value * pow(d, d2);
+        case e_mul:    return in->value * (d * d2);
+        case e_div:    return in->value * ((!CONFIG_FTRAPV || d2 ) ? (d / d2) : d * INFINITY);
+        case e_add:    return in->value * (d + d2);
+        case e_last:   return in->value * d2;
+        case e_hypot:  return in->value * hypot(d, d2);
+        case e_atan2:  return in->value * atan2(d, d2);
+        case e_bitand: return isnan(d) || isnan(d2) ? NAN : in->value * ((long int)d & (long int)d2);
+        case e_bitor:  return isnan(d) || isnan(d2) ? NAN : in->value * ((long int)d | (long int)d2);
+    }
+    return NAN;
+}
+
 static int parse_expr(AVExpr **e, Parser *p);
 
 void av_expr_free(AVExpr *e)
@@ -340,6 +417,7 @@ void av_expr_free(AVExpr *e)
     av_expr_free(e->param[1]);
     av_expr_free(e->param[2]);
     av_freep(&e->var);
+    av_freep(&e->insn);
     av_freep(&e);
 }
 
@@ -682,6 +760,105 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+/* Check that the tree only holds pure nodes, which can be evaluated
+ * eagerly and in any order, and count them. */
+static int can_compile(const AVExpr *e, int in_branch, int *nb_nodes, int *lazy)
+{
+    int i;
+
+    if (!e) return 1;
+    switch (e->type) {
+        case e_ld:
+        case e_st:
+        case e_while:
+        case e_taylor:
+        case e_root:
+        case e_random:
+        case e_print:
+            return 0;
+        case e_func1:
+        case e_func2:
+            *lazy |= in_branch;
+            break;
+    }
+    (*nb_nodes)++;
+    for (i = 0; i < 3; i++) {
+        int branch = in_branch || (i && (e->type == e_if || e->type == e_ifnot));
+        if (!can_compile(e->param[i], branch, nb_nodes, lazy))
+            return 0;
+    }
+    return 1;
+}
+
+static int can_fold(const AVExpr *e)
+{
+    switch (e->type) {
+        case e_const:
+        case e_func1:
+        case e_func2: return 0;
+        case e_func0: return e->a.func0 != etime;
+        default:      return 1;
+    }
+}
+
+static int compile_node(AVExpr *root, const AVExpr *e)
+{
+    ExprInsn *in;
+    int i, src[3] = { -1, -1, -1 }, nb_src = 0, fold = can_fold(e);
+
+    for (i = 0; i < 3; i++) {
+        if (!e->param[i])
+            continue;
+        src[i] = compile_node(root, e->param[i]);
+        fold  &= root->insn[src[i]].type == e_value;
+        nb_src++;
+    }
+
+    in = &root->insn[root->nb_insn];
+    in->type        = e->type;
+    in->value       = e->value;
+    in->const_index = e->const_index;
+    in->a           = e->a;
+    memcpy(in->src, src, sizeof(in->src));
+
+    if (fold) {
+        /* all operands are constants, which are the last nb_src
+         * instructions, replace them by the result */
+        ExprInsn tmp = *in;
+        double r[3];
+
+        for (i = 0; i < 3; i++) {
+            if (src[i] < 0)
+                continue;
+            r[i]       = root->insn[src[i]].value;
+            tmp.src[i] = i;
+        }
+        root->nb_insn -= nb_src;
+        in = &root->insn[root->nb_insn];
+        memset(in, 0, sizeof(*in));
+        in->type  = e_value;
+        in->value = eval_insn(&tmp, r, NULL, NULL);
+        memset(in->src, -1, sizeof(in->src));
+    }
+
+    return root->nb_insn++;
+}
+
+static int compile_expr(AVExpr *e)
+{
+    int nb_nodes = 0, lazy = 0;
+
+    if (!can_compile(e, 0, &nb_nodes, &lazy))
+        return 0;
+
+    e->insn = av_malloc_array(nb_nodes, sizeof(*e->insn));
+    if (!e->insn)
+        return AVERROR(ENOMEM);
+    e->lazy = lazy;
+    compile_node(e, e);
+    return 0;
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -729,6 +906,10 @@ int av_expr_parse(AVExpr **expr, const char *s,
         ret = AVERROR(ENOMEM);
         goto end;
     }
+    while (const_names && const_names[e->nb_consts])
+        e->nb_consts++;
+    if ((ret = compile_expr(e)) < 0)
+        goto end;
     *expr = e;
     e = NULL;
 end:
@@ -763,9 +944,23 @@ int av_expr_count_func(AVExpr *e, unsigned *counter, int size, int arg)
     return expr_count(e, counter, size, ((int[]){e_const, e_func1, e_func2})[arg]);
 }
 
+static double eval_program(const AVExpr *e, const double *const_values, void *opaque)
+{
+    double r[MAX_SCALAR_INSN];
+    int i;
+
+    for (i = 0; i < e->nb_insn; i++)
+        r[i] = eval_insn(&e->insn[i], r, const_values, opaque);
+    return r[e->nb_insn - 1];
+}
+
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
 {
     Parser p = { 0 };
+
+    if (e->nb_insn && !e->lazy && e->nb_insn <= MAX_SCALAR_INSN)
+        return eval_program(e, const_values, opaque);
+
     p.var= e->var;
 
     p.const_values = const_values;
@@ -773,6 +968,125 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
     return eval_expr(&p, e);
 }
 
+/* Evaluate the program for n elements starting at off, one instruction at a
+ * time over the whole block. Each loop is written so the compiler can
+ * vectorize it. */
+static void eval_block(const AVExpr *e, double *buf, const double *const_values,
+                       const double *const *var_values, int off, int n, void *opaque)
+{
+    static const double zero[BATCH_SIZE];
+    int i, j;
+
+#define LOOP(expr) for (j = 0; j < n; j++) o[j] = (expr); break
+    for (i = 0; i < e->nb_insn; i++) {
+        const ExprInsn *in = &e->insn[i];
+        double *av_restrict o = buf + i * BATCH_SIZE;
+        const double *a = in->src[0] >= 0 ? buf + in->src[0] * BATCH_SIZE : zero;
+        const double *b = in->src[1] >= 0 ? buf + in->src[1] * BATCH_SIZE : zero;
+        const double *c = in->src[2] >= 0 ? buf + in->src[2] * BATCH_SIZE : zero;
+        const double v = in->value;
+
+        switch (in->type) {
+        case e_value:   LOOP(v);
+        case e_const: {
+            const double *x = var_values ? var_values[in->const_index] : NULL;
+            const double k  = x ? 0 : v * const_values[in->const_index];
+            if (x) {
+                x += off;
+                LOOP(v * x[j]);
+            }
+            LOOP(k);
+        }
+        case e_func0:   LOOP(v * in->a.func0(a[j]));
+        case e_func1:   LOOP(v * in->a.func1(opaque, a[j]));
+        case e_func2:   LOOP(v * in->a.func2(opaque, a[j], b[j]));
+        case e_squish:  LOOP(1/(1+exp(4*a[j])));
+        case e_gauss:   LOOP(exp(-a[j]*a[j]/2)/sqrt(2*M_PI));
+        case e_isnan:   LOOP(v * !!isnan(a[j]));
+        case e_isinf:   LOOP(v * !!isinf(a[j]));
+        case e_floor:   LOOP(v * floor(a[j]));
+        case e_ceil:    LOOP(v * ceil (a[j]));
+        case e_trunc:   LOOP(v * trunc(a[j]));
+        case e_round:   LOOP(v * round(a[j]));
+        case e_sgn:     LOOP(v * FFDIFFSIGN(a[j], 0));
+        case e_sqrt:    LOOP(v * sqrt (a[j]));
+        case e_not:     LOOP(v * (a[j] == 0));
+        case e_if:      LOOP(v * ( a[j] ? b[j] : c[j]));
+        case e_ifnot:   LOOP(v * (!a[j] ? b[j] : c[j]));
+        case e_clip:    LOOP(isnan(b[j]) || isnan(c[j]) || isnan(a[j]) || b[j] > c[j] ?
+                             NAN : v * av_clipd(a[j], b[j], c[j]));
+        case e_between: LOOP(v * (a[j] >= b[j] && a[j] <= c[j]));
+        case e_lerp:    LOOP(a[j] + (b[j] - a[j]) * c[j]);
+        case e_mod:     LOOP(v * (a[j] - floor((!CONFIG_FTRAPV || b[j]) ? a[j] / b[j] : a[j] * INFINITY) * b[j]));
+        case e_gcd:     LOOP(v * av_gcd(a[j], b[j]));
+        case e_max:     LOOP(v * (a[j] >  b[j] ? a[j] : b[j]));
+        case e_min:     LOOP(v * (a[j] <  b[j] ? a[j] : b[j]));
+        case e_eq:      LOOP(v * (a[j] == b[j] ? 1.0 : 0.0));
+        case e_gt:      LOOP(v * (a[j] >  b[j] ? 1.0 : 0.0));
+        case e_gte:     LOOP(v * (a[j] >= b[j] ? 1.0 : 0.0));
+        case e_lt:      LOOP(v * (a[j] <  b[j] ? 1.0 : 0.0));
+        case e_lte:     LOOP(v * (a[j] <= b[j] ? 1.0 : 0.0));
+        case e_pow:     LOOP(v * pow(a[j], b[j]));
+        case e_mul:     LOOP(v * (a[j] * b[j]));
+        case e_div:     LOOP(v * ((!CONFIG_FTRAPV || b[j]) ? (a[j] / b[j]) : a[j] * INFINITY));
+        case e_add:     LOOP(v * (a[j] + b[j]));
+        case e_last:    LOOP(v * b[j]);
+        case e_hypot:   LOOP(v * hypot(a[j], b[j]));
+        case e_atan2:   LOOP(v * atan2(a[j], b[j]));
+        case e_bitand:  LOOP(isnan(a[j]) || isnan(b[j]) ? NAN : v * ((long int)a[j] & (long int)b[j]));
+        case e_bitor:   LOOP(isnan(a[j]) || isnan(b[j]) ? NAN : v * ((long int)a[j] | (long int)b[j]));
+        default:        LOOP(NAN);
+        }
+    }
+#undef LOOP
+}
+
+static void eval_batch_scalar(AVExpr *e, const double *const_values,
+                              const double *const *var_values,
+                              double *res, int nb, void *opaque)
+{
+    double *values = av_malloc_array(e->nb_consts + 1, sizeof(*values));
+    int i, j;
+
+    if (!values) {
+        for (i = 0; i < nb; i++)
+            res[i] = NAN;
+        return;
+    }
+    if (e->nb_consts)
+        memcpy(values, const_values, e->nb_consts * sizeof(*values));
+
+    for (i = 0; i < nb; i++) {
+        for (j = 0; var_values && j < e->nb_consts; j++)
+            if (var_values[j])
+                values[j] = var_values[j][i];
+        res[i] = av_expr_eval(e, values, opaque);
+    }
+    av_free(values);
+}
+
+void av_expr_eval_batch(AVExpr *e, const double *const_values,
+                        const double *const *var_values,
+                        double *res, int nb, void *opaque)
+{
+    double *buf = NULL;
+    int off;
+
+    if (e->nb_insn && !e->lazy)
+        buf = av_malloc_array(e->nb_insn, BATCH_SIZE * sizeof(*buf));
+    if (!buf) {
+        eval_batch_scalar(e, const_values, var_values, res, nb, opaque);
+        return;
+    }
+
+    for (off = 0; off < nb; off += BATCH_SIZE) {
+        int n = FFMIN(nb - off, BATCH_SIZE);
+        eval_block(e, buf, const_values, var_values, off, n, opaque);
+        memcpy(res + off, buf + (e->nb_insn - 1) * BATCH_SIZE, n * sizeof(*res));
+    }
+    av_free(buf);
+}
+
 int av_expr_parse_and_eval(double *d, const char *s,
                            const char * const *const_names, const double *const_values,
                            const char * const *func1_names, double (* const *funcs1)(void *, double),
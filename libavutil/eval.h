@@ -86,6 +86,25 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Evaluate a previously parsed expression for a batch of inputs.
+ *
+ * This is equivalent to calling av_expr_eval() nb times, but much faster
+ * for expressions which were compiled at parse time, i.e. which do not
+ * use ld(), st(), while(), taylor(), root(), random() or print().
+ *
+ * @param const_values a zero terminated array of values for the identifiers from av_expr_parse() const_names
+ * @param var_values   NULL, or an array with one entry per identifier from
+ *                     av_expr_parse() const_names; a non-NULL entry i points to
+ *                     nb values which are used in place of const_values[i]
+ * @param res          array of nb values where the results are stored
+ * @param nb           number of values to evaluate
+ * @param opaque       a pointer which will be passed to all functions from funcs1 and funcs2
+ */
+void av_expr_eval_batch(AVExpr *e, const double *const_values,
+                        const double *const *var_values,
+                        double *res, int nb, void *opaque);
+
 /**
  * Track the presence of variables and their number of occurrences in a parsed expression
  *
@@ -20,13 +20,17 @@
 
 #include "buffer.h"
 #include "common.h"
+#include "cpu.h"
 #include "hwcontext.h"
 #include "hwcontext_internal.h"
 #include "imgutils.h"
+#include "imgutils_internal.h"
+#include "internal.h"
 #include "log.h"
 #include "mem.h"
 #include "pixdesc.h"
 #include "pixfmt.h"
+#include "thread.h"
 
 static const HWContextType * const hw_table[] = {
 #if CONFIG_CUDA
@@ -185,6 +189,8 @@ AVBufferRef *av_hwdevice_ctx_alloc(enum AVHWDeviceType type)
     ctx->av_class = &hwdevice_ctx_class;
 
     ctx->internal->hw_type = hw_type;
+    atomic_init(&ctx->internal->nb_frames_ctx, 0);
+    atomic_init(&ctx->internal->pool_bytes, 0);
 
     return buf;
 
@@ -225,9 +231,17 @@ static void hwframe_ctx_free(void *opaque, uint8_t *data)
 {
     AVHWFramesContext *ctx = (AVHWFramesContext*)data;
 
+    if (ctx->internal->accounted) {
+        AVHWDeviceInternal *dev = ctx->device_ctx->internal;
+        atomic_fetch_sub(&dev->nb_frames_ctx, 1);
+        atomic_fetch_sub(&dev->pool_bytes, ctx->internal->accounted_bytes);
+    }
+
     if (ctx->internal->pool_internal)
         av_buffer_pool_uninit(&ctx->internal->pool_internal);
 
+    avpriv_slicethread_free(&ctx->internal->copy_thread);
+
     if (ctx->internal->hw_type->frames_uninit)
         ctx->internal->hw_type->frames_uninit(ctx);
 
@@ -375,6 +389,14 @@ int av_hwframe_ctx_init(AVBufferRef *ref)
             goto fail;
     }
 
+    /* account the context to its device for AVHWDevicePool placement */
+    ret = av_image_get_buffer_size(ctx->sw_format, ctx->width, ctx->height, 1);
+    ctx->internal->accounted_bytes = FFMAX(ret, 0) * (size_t)FFMAX(ctx->initial_pool_size, 1);
+    ctx->internal->accounted       = 1;
+    atomic_fetch_add(&ctx->device_ctx->internal->nb_frames_ctx, 1);
+    atomic_fetch_add(&ctx->device_ctx->internal->pool_bytes,
+                     ctx->internal->accounted_bytes);
+
     return 0;
 fail:
     if (ctx->internal->hw_type->frames_uninit)
@@ -719,6 +741,166 @@ int av_hwdevice_ctx_create_derived(AVBufferRef **dst_ref_ptr,
                                                NULL, flags);
 }
 
+struct AVHWDevicePool {
+    const AVClass *av_class;
+    enum AVHWDeviceType type;
+    AVDictionary *opts;
+    int flags;
+
+    char **names;
+    AVBufferRef **devices;
+    int *failed;
+    int nb_devices;
+
+    AVMutex lock;
+};
+
+static const AVClass hwdevice_pool_class = {
+    .class_name = "AVHWDevicePool",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+void av_hwdevice_pool_free(AVHWDevicePool **ppool)
+{
+    AVHWDevicePool *pool = *ppool;
+    int i;
+
+    if (!pool)
+        return;
+
+    for (i = 0; i < pool->nb_devices; i++) {
+        av_buffer_unref(&pool->devices[i]);
+        av_freep(&pool->names[i]);
+    }
+    av_freep(&pool->names);
+    av_freep(&pool->devices);
+    av_freep(&pool->failed);
+    av_dict_free(&pool->opts);
+    ff_mutex_destroy(&pool->lock);
+    av_freep(ppool);
+}
+
+int av_hwdevice_pool_create(AVHWDevicePool **ppool, enum AVHWDeviceType type,
+                            AVDictionary *opts, int flags)
+{
+    const HWContextType *hw_type = NULL;
+    AVHWDevicePool *pool;
+    int i, ret;
+
+    *ppool = NULL;
+
+    for (i = 0; hw_table[i]; i++) {
+        if (hw_table[i]->type == type) {
+            hw_type = hw_table[i];
+            break;
+        }
+    }
+    if (!hw_type || !hw_type->device_enumerate)
+        return AVERROR(ENOSYS);
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return AVERROR(ENOMEM);
+    pool->av_class = &hwdevice_pool_class;
+    pool->type     = type;
+    pool->flags    = flags;
+    ff_mutex_init(&pool->lock, NULL);
+
+    ret = av_dict_copy(&pool->opts, opts, 0);
+    if (ret < 0)
+        goto fail;
+
+    ret = hw_type->device_enumerate(pool, &pool->names, &pool->nb_devices);
+    if (ret < 0)
+        goto fail;
+    if (!pool->nb_devices) {
+        av_log(pool, AV_LOG_ERROR, "No %s devices found.\n", hw_type->name);
+        ret = AVERROR(ENODEV);
+        goto fail;
+    }
+
+    pool->devices = av_mallocz_array(pool->nb_devices, sizeof(*pool->devices));
+    pool->failed  = av_mallocz_array(pool->nb_devices, sizeof(*pool->failed));
+    if (!pool->devices || !pool->failed) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < pool->nb_devices; i++)
+        av_log(pool, AV_LOG_VERBOSE, "Device %d: %s.\n", i, pool->names[i]);
+
+    *ppool = pool;
+    return 0;
+
+fail:
+    av_hwdevice_pool_free(&pool);
+    return ret;
+}
+
+int av_hwdevice_pool_get(AVHWDevicePool *pool, AVBufferRef **device_ref)
+{
+    int ret = AVERROR(ENODEV);
+
+    *device_ref = NULL;
+
+    ff_mutex_lock(&pool->lock);
+
+    while (!*device_ref) {
+        size_t best_bytes = SIZE_MAX;
+        int best = -1, best_sessions = INT_MAX;
+
+        /* Memory held by frame pools is the scarcer resource, the number of
+         * users of the device only breaks ties, e.g. between devices which
+         * were opened but have not allocated any frames yet. */
+        for (int i = 0; i < pool->nb_devices; i++) {
+            size_t bytes = 0;
+            int sessions = 0;
+
+            if (pool->failed[i])
+                continue;
+            if (pool->devices[i]) {
+                AVHWDeviceContext *ctx = (AVHWDeviceContext*)pool->devices[i]->data;
+                bytes    = atomic_load(&ctx->internal->pool_bytes);
+                sessions = av_buffer_get_ref_count(pool->devices[i]) - 1;
+            }
+            if (bytes < best_bytes ||
+                (bytes == best_bytes && sessions < best_sessions)) {
+                best          = i;
+                best_bytes    = bytes;
+                best_sessions = sessions;
+            }
+        }
+        if (best < 0)
+            break;
+
+        if (!pool->devices[best]) {
+            ret = av_hwdevice_ctx_create(&pool->devices[best], pool->type,
+                                         pool->names[best], pool->opts,
+                                         pool->flags);
+            if (ret < 0) {
+                av_log(pool, AV_LOG_WARNING, "Failed to open device %s, "
+                       "excluding it from the pool.\n", pool->names[best]);
+                pool->failed[best] = 1;
+                continue;
+            }
+        }
+
+        *device_ref = av_buffer_ref(pool->devices[best]);
+        if (!*device_ref) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        av_log(pool, AV_LOG_VERBOSE, "Placing new user on device %s "
+               "(%d users, %"SIZE_SPECIFIER" bytes in frame pools).\n",
+               pool->names[best], best_sessions, best_bytes);
+        ret = 0;
+    }
+
+    ff_mutex_unlock(&pool->lock);
+    return ret;
+}
+
 static void ff_hwframe_unmap(void *opaque, uint8_t *data)
 {
     HWMapDescriptor *hwmap = (HWMapDescriptor*)data;
@@ -926,3 +1108,59 @@ int ff_hwframe_map_replace(AVFrame *dst, const AVFrame *src)
     av_frame_unref(hwmap->source);
     return av_frame_ref(hwmap->source, src);
 }
+
+static void hwframe_copy_slice(void *priv, int jobnr, int threadnr,
+                               int nb_jobs, int nb_threads)
+{
+    AVHWFramesInternal *fi = priv;
+    ptrdiff_t dst_linesize[4], src_linesize[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        dst_linesize[i] = fi->copy_dst->linesize[i];
+        src_linesize[i] = fi->copy_src->linesize[i];
+    }
+    avpriv_image_copy_slice(fi->copy_dst->data, dst_linesize,
+                            (const uint8_t **)fi->copy_src->data, src_linesize,
+                            fi->copy_src->format, fi->copy_src->width,
+                            fi->copy_src->height, jobnr, nb_jobs);
+}
+
+int ff_hwframe_copy_data(AVHWFramesContext *ctx, AVFrame *dst, const AVFrame *src)
+{
+    AVHWFramesInternal *fi = ctx->internal;
+    int i, nb_slices;
+
+    if (dst->format != src->format || dst->format < 0 ||
+        dst->width < src->width || dst->height < src->height ||
+        src->hw_frames_ctx || dst->hw_frames_ctx)
+        return av_frame_copy(dst, src);
+
+    nb_slices = avpriv_image_copy_nb_slices(src->format, src->width,
+                                            src->height, av_cpu_count());
+    if (nb_slices <= 1)
+        return av_frame_copy(dst, src);
+
+    for (i = 0; i < av_pix_fmt_count_planes(dst->format); i++)
+        if (!dst->data[i] || !src->data[i])
+            return AVERROR(EINVAL);
+
+    if (atomic_exchange(&fi->copy_busy, 1))
+        return av_frame_copy(dst, src);
+
+    if (!fi->copy_thread &&
+        avpriv_slicethread_create(&fi->copy_thread, fi, hwframe_copy_slice,
+                                  NULL, 0) < 0) {
+        atomic_store(&fi->copy_busy, 0);
+        return av_frame_copy(dst, src);
+    }
+
+    fi->copy_dst = dst;
+    fi->copy_src = src;
+    avpriv_slicethread_execute(fi->copy_thread, nb_slices, 0);
+    fi->copy_dst = NULL;
+    fi->copy_src = NULL;
+
+    atomic_store(&fi->copy_busy, 0);
+    return 0;
+}
@@ -349,6 +349,52 @@ int av_hwdevice_ctx_create_derived_opts(AVBufferRef **dst_ctx,
                                         AVBufferRef *src_ctx,
                                         AVDictionary *options, int flags);
 
+/**
+ * A set of all devices of one type present in the system, handing out the
+ * least loaded one on request.
+ *
+ * Load is measured from the frames contexts created on each device through
+ * this process: the memory held by their pools first and the number of
+ * users holding a reference to the device second. Devices are opened on
+ * first use. Devices of other processes are not taken into account.
+ *
+ * All functions operating on a pool are thread-safe.
+ */
+typedef struct AVHWDevicePool AVHWDevicePool;
+
+/**
+ * Enumerate the devices of the given type and create a pool for them.
+ *
+ * @param pool  On success, the new pool is written here. It must be freed
+ *              with av_hwdevice_pool_free().
+ * @param type  The device type. Not all types support enumeration.
+ * @param opts  Options used for every device opened by the pool, as in
+ *              av_hwdevice_ctx_create(). The dictionary remains owned by
+ *              the caller.
+ * @param flags Passed to av_hwdevice_ctx_create().
+ * @return 0 on success, AVERROR(ENOSYS) if the type cannot be enumerated,
+ *         AVERROR(ENODEV) if no device was found, another negative AVERROR
+ *         code on other failures.
+ */
+int av_hwdevice_pool_create(AVHWDevicePool **pool, enum AVHWDeviceType type,
+                            AVDictionary *opts, int flags);
+
+/**
+ * Get a reference to the least loaded device of the pool, opening it if
+ * needed. Devices which fail to open are excluded from the pool.
+ *
+ * @param device_ctx On success, a new reference to the chosen
+ *                   AVHWDeviceContext, owned by the caller.
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+int av_hwdevice_pool_get(AVHWDevicePool *pool, AVBufferRef **device_ctx);
+
+/**
+ * Free the pool and release its references to the devices. Devices still
+ * referenced elsewhere stay alive.
+ */
+void av_hwdevice_pool_free(AVHWDevicePool **pool);
+
 /**
  * Allocate an AVHWFramesContext tied to a given device context.
  *
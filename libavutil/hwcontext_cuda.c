@@ -25,6 +25,7 @@
 #include "hwcontext_vulkan.h"
 #endif
 #include "cuda_check.h"
+#include "avstring.h"
 #include "mem.h"
 #include "pixdesc.h"
 #include "pixfmt.h"
@@ -394,6 +395,43 @@ error:
     return AVERROR_UNKNOWN;
 }
 
+static int cuda_device_enumerate(void *logctx, char ***devices, int *nb_devices)
+{
+    CudaFunctions *cu = NULL;
+    int i, ret, count;
+
+    ret = cuda_load_functions(&cu, logctx);
+    if (ret < 0) {
+        av_log(logctx, AV_LOG_ERROR, "Could not dynamically load CUDA\n");
+        return ret;
+    }
+
+    ret = FF_CUDA_CHECK_DL(logctx, cu, cu->cuInit(0));
+    if (ret < 0)
+        goto end;
+
+    ret = FF_CUDA_CHECK_DL(logctx, cu, cu->cuDeviceGetCount(&count));
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < count; i++) {
+        char *name = av_asprintf("%d", i);
+        if (!name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_dynarray_add_nofree(devices, nb_devices, name);
+        if (ret < 0) {
+            av_free(name);
+            goto end;
+        }
+    }
+
+end:
+    cuda_free_functions(&cu);
+    return ret;
+}
+
 static int cuda_device_derive(AVHWDeviceContext *device_ctx,
                               AVHWDeviceContext *src_ctx, AVDictionary *opts,
                               int flags) {
@@ -487,6 +525,7 @@ const HWContextType ff_hwcontext_type_cuda = {
     .frames_priv_size     = sizeof(CUDAFramesContext),
 
     .device_create        = cuda_device_create,
+    .device_enumerate     = cuda_device_enumerate,
     .device_derive        = cuda_device_derive,
     .device_init          = cuda_device_init,
     .device_uninit        = cuda_device_uninit,
@@ -16,8 +16,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <drm.h>
@@ -26,6 +29,7 @@
 #include "avassert.h"
 #include "hwcontext.h"
 #include "hwcontext_drm.h"
+#include "hwcontext_drm_internal.h"
 #include "hwcontext_internal.h"
 #include "imgutils.h"
 
@@ -206,7 +210,7 @@ static int drm_transfer_data_from(AVHWFramesContext *hwfc,
     map->width  = dst->width;
     map->height = dst->height;
 
-    err = av_frame_copy(dst, map);
+    err = ff_hwframe_copy_data(hwfc, dst, map);
     if (err)
         goto fail;
 
@@ -267,6 +271,46 @@ static int drm_map_from(AVHWFramesContext *hwfc, AVFrame *dst,
     return 0;
 }
 
+int ff_drm_import_key(FFDRMImportKey *key, const AVDRMFrameDescriptor *desc)
+{
+    struct stat st;
+    int i, j;
+
+    memset(key, 0, sizeof(*key));
+
+    key->layout.nb_objects = desc->nb_objects;
+    for (i = 0; i < desc->nb_objects; i++) {
+        if (fstat(desc->objects[i].fd, &st) < 0)
+            return AVERROR(errno);
+        key->ino[i] = st.st_ino;
+
+        key->layout.objects[i].fd              = -1;
+        key->layout.objects[i].size            = desc->objects[i].size;
+        key->layout.objects[i].format_modifier = desc->objects[i].format_modifier;
+    }
+
+    key->layout.nb_layers = desc->nb_layers;
+    for (i = 0; i < desc->nb_layers; i++) {
+        const AVDRMLayerDescriptor *layer = &desc->layers[i];
+
+        key->layout.layers[i].format    = layer->format;
+        key->layout.layers[i].nb_planes = layer->nb_planes;
+        for (j = 0; j < layer->nb_planes; j++) {
+            key->layout.layers[i].planes[j].object_index =
+                layer->planes[j].object_index;
+            key->layout.layers[i].planes[j].offset = layer->planes[j].offset;
+            key->layout.layers[i].planes[j].pitch  = layer->planes[j].pitch;
+        }
+    }
+
+    return 0;
+}
+
+int ff_drm_import_key_equal(const FFDRMImportKey *a, const FFDRMImportKey *b)
+{
+    return !memcmp(a, b, sizeof(*a));
+}
+
 const HWContextType ff_hwcontext_type_drm = {
     .type                   = AV_HWDEVICE_TYPE_DRM,
     .name                   = "DRM",
@@ -0,0 +1,63 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_HWCONTEXT_DRM_INTERNAL_H
+#define AVUTIL_HWCONTEXT_DRM_INTERNAL_H
+
+#include <sys/types.h>
+
+#include "hwcontext_drm.h"
+
+/**
+ * @file
+ * FFmpeg internal API for DRM PRIME frame descriptors.
+ */
+
+/**
+ * Identifies the buffers behind a DRM frame descriptor and the layout they
+ * are used with.
+ *
+ * File descriptor numbers differ every time a buffer is exported, so the
+ * objects are identified by the inode of their DMA-BUF instead. An import
+ * which is kept alive holds a reference to the buffer, so the inode cannot
+ * be reused while the import is cached.
+ */
+typedef struct FFDRMImportKey {
+    ino_t ino[AV_DRM_MAX_PLANES];
+    /**
+     * Copy of the descriptor with all file descriptors set to -1 and all
+     * unused entries zeroed.
+     */
+    AVDRMFrameDescriptor layout;
+} FFDRMImportKey;
+
+/**
+ * Fill in the import key for desc.
+ *
+ * @return 0 on success, a negative AVERROR code if the objects cannot be
+ *         identified.
+ */
+int ff_drm_import_key(FFDRMImportKey *key, const AVDRMFrameDescriptor *desc);
+
+/**
+ * @return 1 if both keys refer to the same buffers with the same layout,
+ *         0 otherwise.
+ */
+int ff_drm_import_key_equal(const FFDRMImportKey *a, const FFDRMImportKey *b);
+
+#endif /* AVUTIL_HWCONTEXT_DRM_INTERNAL_H */
@@ -19,12 +19,14 @@
 #ifndef AVUTIL_HWCONTEXT_INTERNAL_H
 #define AVUTIL_HWCONTEXT_INTERNAL_H
 
+#include <stdatomic.h>
 #include <stddef.h>
 
 #include "buffer.h"
 #include "hwcontext.h"
 #include "frame.h"
 #include "pixfmt.h"
+#include "slicethread.h"
 
 typedef struct HWContextType {
     enum AVHWDeviceType type;
@@ -69,6 +71,13 @@ typedef struct HWContextType {
     int              (*device_derive)(AVHWDeviceContext *dst_ctx,
                                       AVHWDeviceContext *src_ctx,
                                       AVDictionary *opts, int flags);
+    /**
+     * List the device strings device_create() accepts for every device of
+     * this type present in the system, used by AVHWDevicePool. The strings
+     * are appended to *devices with av_dynarray_add_nofree().
+     */
+    int              (*device_enumerate)(void *logctx, char ***devices,
+                                         int *nb_devices);
 
     int              (*device_init)(AVHWDeviceContext *ctx);
     void             (*device_uninit)(AVHWDeviceContext *ctx);
@@ -109,6 +118,14 @@ struct AVHWDeviceInternal {
      * context it was derived from.
      */
     AVBufferRef *source_device;
+
+    /**
+     * Number of initialised frames contexts on this device and an estimate
+     * of the memory their pools hold, used by AVHWDevicePool to place new
+     * work on the least loaded device.
+     */
+    atomic_int    nb_frames_ctx;
+    atomic_size_t pool_bytes;
 };
 
 struct AVHWFramesInternal {
@@ -117,6 +134,13 @@ struct AVHWFramesInternal {
 
     AVBufferPool *pool_internal;
 
+    /**
+     * Memory accounted to the device for this context, see
+     * AVHWDeviceInternal.pool_bytes.
+     */
+    size_t accounted_bytes;
+    int accounted;
+
     /**
      * For a derived context, a reference to the original frames
      * context it was derived from.
@@ -127,6 +151,16 @@ struct AVHWFramesInternal {
      * frame context when trying to allocate in the derived context.
      */
     int source_allocation_map_flags;
+
+    /**
+     * Slice threads of ff_hwframe_copy_data(), created on first use, and
+     * the frames being copied. copy_busy is set while they are in use;
+     * concurrent copies fall back to a single-threaded copy.
+     */
+    AVSliceThread *copy_thread;
+    atomic_int     copy_busy;
+    AVFrame       *copy_dst;
+    const AVFrame *copy_src;
 };
 
 typedef struct HWMapDescriptor {
@@ -163,6 +197,13 @@ int ff_hwframe_map_create(AVBufferRef *hwframe_ref,
  */
 int ff_hwframe_map_replace(AVFrame *dst, const AVFrame *src);
 
+/**
+ * Copy the data of a software frame like av_frame_copy(), splitting large
+ * frames across threads. Meant for the transfers from mapped frames, which
+ * are copies of whole uncached frames.
+ */
+int ff_hwframe_copy_data(AVHWFramesContext *ctx, AVFrame *dst, const AVFrame *src);
+
 extern const HWContextType ff_hwcontext_type_cuda;
 extern const HWContextType ff_hwcontext_type_d3d11va;
 extern const HWContextType ff_hwcontext_type_drm;
@@ -48,6 +48,10 @@
     (MFX_VERSION_MAJOR > (MAJOR) ||         \
      MFX_VERSION_MAJOR == (MAJOR) && MFX_VERSION_MINOR >= (MINOR))
 
+#define QSV_RUNTIME_VERSION_ATLEAST(MFX_VERSION, MAJOR, MINOR) \
+    ((MFX_VERSION.Major > (MAJOR)) ||                           \
+    (MFX_VERSION.Major == (MAJOR) && MFX_VERSION.Minor >= (MINOR)))
+
 typedef struct QSVDevicePriv {
     AVBufferRef *child_device_ctx;
 } QSVDevicePriv;
@@ -443,6 +447,7 @@ static int qsv_init_internal_session(AVHWFramesContext *ctx,
     QSVFramesContext              *s = ctx->internal->priv;
     AVQSVFramesContext *frames_hwctx = ctx->hwctx;
     QSVDeviceContext   *device_priv  = ctx->device_ctx->internal->priv;
+    AVQSVDeviceContext *device_hwctx = ctx->device_ctx->hwctx;
     int opaque = !!(frames_hwctx->frame_type & MFX_MEMTYPE_OPAQUE_FRAME);
 
     mfxFrameAllocator frame_allocator = {
@@ -470,6 +475,17 @@ static int qsv_init_internal_session(AVHWFramesContext *ctx,
             return AVERROR_UNKNOWN;
     }
 
+    /* Join the device session, so that the upload/download VPP shares its
+     * scheduler with the decoders, encoders and filters running on the same
+     * device instead of spawning its own worker threads. */
+    if (QSV_RUNTIME_VERSION_ATLEAST(device_priv->ver, 1, 25)) {
+        err = MFXJoinSession(device_hwctx->session, *session);
+        if (err != MFX_ERR_NONE) {
+            av_log(ctx, AV_LOG_ERROR, "Error joining an internal session\n");
+            return AVERROR_UNKNOWN;
+        }
+    }
+
     if (!opaque) {
         err = MFXVideoCORE_SetFrameAllocator(*session, &frame_allocator);
         if (err != MFX_ERR_NONE)
@@ -32,6 +32,9 @@
 #   ifndef DRM_FORMAT_MOD_INVALID
 #       define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
 #   endif
+#   ifndef DRM_FORMAT_MOD_LINEAR
+#       define DRM_FORMAT_MOD_LINEAR 0
+#   endif
 #endif
 
 #include <fcntl.h>
@@ -41,10 +44,14 @@
 
 
 #include "avassert.h"
+#include "avstring.h"
 #include "buffer.h"
 #include "common.h"
 #include "hwcontext.h"
 #include "hwcontext_drm.h"
+#if CONFIG_LIBDRM
+#include "hwcontext_drm_internal.h"
+#endif
 #include "hwcontext_internal.h"
 #include "hwcontext_vaapi.h"
 #include "mem.h"
@@ -71,6 +78,17 @@ typedef struct VAAPIDeviceContext {
     int              nb_formats;
 } VAAPIDeviceContext;
 
+#if CONFIG_LIBDRM
+// Maximum number of surfaces created from DMA-BUFs which a frames context
+// keeps around for reuse.
+#define VAAPI_MAX_DRM_IMPORTS 32
+
+typedef struct VAAPIDRMImport {
+    FFDRMImportKey key;
+    VASurfaceID    surface_id;
+} VAAPIDRMImport;
+#endif
+
 typedef struct VAAPIFramesContext {
     // Surface attributes set at create time.
     VASurfaceAttrib *attributes;
@@ -79,6 +97,15 @@ typedef struct VAAPIFramesContext {
     unsigned int rt_format;
     // Whether vaDeriveImage works.
     int derive_works;
+#if CONFIG_LIBDRM
+    // DRM PRIME descriptors of the surfaces in a fixed pool, indexed like
+    // AVVAAPIFramesContext.surface_ids.  Each surface is exported once and
+    // the file descriptors stay open until the frames context is freed.
+    AVDRMFrameDescriptor *drm_exports;
+    // Surfaces created from DMA-BUFs mapped to this frames context.
+    VAAPIDRMImport drm_imports[VAAPI_MAX_DRM_IMPORTS];
+    int         nb_drm_imports;
+#endif
 } VAAPIFramesContext;
 
 typedef struct VAAPIMapping {
@@ -645,6 +672,23 @@ static void vaapi_frames_uninit(AVHWFramesContext *hwfc)
     AVVAAPIFramesContext *avfc = hwfc->hwctx;
     VAAPIFramesContext    *ctx = hwfc->internal->priv;
 
+#if CONFIG_LIBDRM
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    int i, j;
+
+    if (ctx->drm_exports) {
+        for (i = 0; i < avfc->nb_surfaces; i++) {
+            for (j = 0; j < ctx->drm_exports[i].nb_objects; j++)
+                close(ctx->drm_exports[i].objects[j].fd);
+        }
+        av_freep(&ctx->drm_exports);
+    }
+
+    for (i = 0; i < ctx->nb_drm_imports; i++)
+        vaDestroySurfaces(hwctx->display, &ctx->drm_imports[i].surface_id, 1);
+    ctx->nb_drm_imports = 0;
+#endif
+
     av_freep(&avfc->surface_ids);
     av_freep(&ctx->attributes);
 }
@@ -892,7 +936,7 @@ static int vaapi_transfer_data_from(AVHWFramesContext *hwfc,
     map->width  = dst->width;
     map->height = dst->height;
 
-    err = av_frame_copy(dst, map);
+    err = ff_hwframe_copy_data(hwfc, dst, map);
     if (err)
         goto fail;
 
@@ -999,18 +1043,15 @@ static void vaapi_unmap_from_drm(AVHWFramesContext *dst_fc,
     vaDestroySurfaces(dst_dev->display, &surface_id, 1);
 }
 
-static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
-                              const AVFrame *src, int flags)
+static int vaapi_surface_from_drm_prime(AVHWFramesContext *hwfc,
+                                        const AVDRMFrameDescriptor *desc,
+                                        const VAAPIFormatDescriptor *format_desc,
+                                        int width, int height,
+                                        VASurfaceID *surface_id)
 {
-    AVHWFramesContext      *dst_fc =
-        (AVHWFramesContext*)dst->hw_frames_ctx->data;
-    AVVAAPIDeviceContext  *dst_dev = dst_fc->device_ctx->hwctx;
-    const AVDRMFrameDescriptor *desc;
-    const VAAPIFormatDescriptor *format_desc;
-    VASurfaceID surface_id;
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
     VAStatus vas;
-    uint32_t va_fourcc;
-    int err, i, j, k;
+    int i, j, k;
 
     unsigned long buffer_handle;
     VASurfaceAttribExternalBuffers buffer_desc;
@@ -1029,44 +1070,24 @@ static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
         }
     };
 
-    desc = (AVDRMFrameDescriptor*)src->data[0];
-
     if (desc->nb_objects != 1) {
-        av_log(dst_fc, AV_LOG_ERROR, "VAAPI can only map frames "
+        av_log(hwfc, AV_LOG_ERROR, "VAAPI can only map frames "
                "made from a single DRM object.\n");
         return AVERROR(EINVAL);
     }
 
-    va_fourcc = 0;
-    for (i = 0; i < FF_ARRAY_ELEMS(vaapi_drm_format_map); i++) {
-        if (desc->nb_layers != vaapi_drm_format_map[i].nb_layer_formats)
-            continue;
-        for (j = 0; j < desc->nb_layers; j++) {
-            if (desc->layers[j].format !=
-                vaapi_drm_format_map[i].layer_formats[j])
-                break;
-        }
-        if (j != desc->nb_layers)
-            continue;
-        va_fourcc = vaapi_drm_format_map[i].va_fourcc;
-        break;
+    if (desc->objects[0].format_modifier != DRM_FORMAT_MOD_LINEAR &&
+        desc->objects[0].format_modifier != DRM_FORMAT_MOD_INVALID) {
+        av_log(hwfc, AV_LOG_WARNING, "DRM object %d has format modifier "
+               "%#"PRIx64" which cannot be passed to VAAPI, result may "
+               "not be as expected.\n", desc->objects[0].fd,
+               desc->objects[0].format_modifier);
     }
-    if (!va_fourcc) {
-        av_log(dst_fc, AV_LOG_ERROR, "DRM format not supported "
-               "by VAAPI.\n");
-        return AVERROR(EINVAL);
-    }
-
-    av_log(dst_fc, AV_LOG_DEBUG, "Map DRM object %d to VAAPI as "
-           "%08x.\n", desc->objects[0].fd, va_fourcc);
-
-    format_desc = vaapi_format_from_fourcc(va_fourcc);
-    av_assert0(format_desc);
 
     buffer_handle = desc->objects[0].fd;
-    buffer_desc.pixel_format = va_fourcc;
-    buffer_desc.width        = src_fc->width;
-    buffer_desc.height       = src_fc->height;
+    buffer_desc.pixel_format = format_desc->fourcc;
+    buffer_desc.width        = hwfc->width;
+    buffer_desc.height       = hwfc->height;
     buffer_desc.data_size    = desc->objects[0].size;
     buffer_desc.buffers      = &buffer_handle;
     buffer_desc.num_buffers  = 1;
@@ -1088,22 +1109,175 @@ static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
         FFSWAP(uint32_t, buffer_desc.offsets[1], buffer_desc.offsets[2]);
     }
 
-    vas = vaCreateSurfaces(dst_dev->display, format_desc->rt_format,
-                           src->width, src->height,
-                           &surface_id, 1,
+    vas = vaCreateSurfaces(hwctx->display, format_desc->rt_format,
+                           width, height, surface_id, 1,
                            attrs, FF_ARRAY_ELEMS(attrs));
     if (vas != VA_STATUS_SUCCESS) {
-        av_log(dst_fc, AV_LOG_ERROR, "Failed to create surface from DRM "
+        av_log(hwfc, AV_LOG_ERROR, "Failed to create surface from DRM "
                "object: %d (%s).\n", vas, vaErrorStr(vas));
         return AVERROR(EIO);
     }
+
+    return 0;
+}
+
+#if VA_CHECK_VERSION(1, 1, 0)
+static int vaapi_surface_from_drm_prime2(AVHWFramesContext *hwfc,
+                                         const AVDRMFrameDescriptor *desc,
+                                         const VAAPIFormatDescriptor *format_desc,
+                                         int width, int height,
+                                         VASurfaceID *surface_id)
+{
+    AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    VAStatus vas;
+    int i, j;
+
+    VADRMPRIMESurfaceDescriptor va_desc = { 0 };
+    VASurfaceAttrib attrs[2] = {
+        {
+            .type  = VASurfaceAttribMemoryType,
+            .flags = VA_SURFACE_ATTRIB_SETTABLE,
+            .value.type    = VAGenericValueTypeInteger,
+            .value.value.i = VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
+        },
+        {
+            .type  = VASurfaceAttribExternalBufferDescriptor,
+            .flags = VA_SURFACE_ATTRIB_SETTABLE,
+            .value.type    = VAGenericValueTypePointer,
+            .value.value.p = &va_desc,
+        }
+    };
+
+    // The inverse of the conversion in vaapi_map_to_drm_esh(); unlike the
+    // legacy descriptor this carries the format modifier of every object,
+    // so tiled buffers can be imported as they are.
+    va_desc.fourcc      = format_desc->fourcc;
+    va_desc.width       = width;
+    va_desc.height      = height;
+    va_desc.num_objects = desc->nb_objects;
+    for (i = 0; i < desc->nb_objects; i++) {
+        va_desc.objects[i].fd   = desc->objects[i].fd;
+        va_desc.objects[i].size = desc->objects[i].size;
+        va_desc.objects[i].drm_format_modifier =
+            desc->objects[i].format_modifier;
+    }
+    va_desc.num_layers = desc->nb_layers;
+    for (i = 0; i < desc->nb_layers; i++) {
+        // Same chroma order fixup as for the legacy descriptor.
+        const AVDRMLayerDescriptor *layer =
+            &desc->layers[format_desc->chroma_planes_swapped &&
+                          desc->nb_layers == 3 && i ? 3 - i : i];
+
+        va_desc.layers[i].drm_format = layer->format;
+        va_desc.layers[i].num_planes = layer->nb_planes;
+        for (j = 0; j < layer->nb_planes; j++) {
+            va_desc.layers[i].object_index[j] = layer->planes[j].object_index;
+            va_desc.layers[i].offset[j]       = layer->planes[j].offset;
+            va_desc.layers[i].pitch[j]        = layer->planes[j].pitch;
+        }
+    }
+
+    vas = vaCreateSurfaces(hwctx->display, format_desc->rt_format,
+                           width, height, surface_id, 1,
+                           attrs, FF_ARRAY_ELEMS(attrs));
+    if (vas != VA_STATUS_SUCCESS) {
+        av_log(hwfc, AV_LOG_DEBUG, "Failed to create surface from DRM "
+               "PRIME 2 descriptor: %d (%s).\n", vas, vaErrorStr(vas));
+        return AVERROR(ENOSYS);
+    }
+
+    return 0;
+}
+#endif
+
+static int vaapi_map_from_drm(AVHWFramesContext *src_fc, AVFrame *dst,
+                              const AVFrame *src, int flags)
+{
+    AVHWFramesContext      *dst_fc =
+        (AVHWFramesContext*)dst->hw_frames_ctx->data;
+    AVVAAPIDeviceContext  *dst_dev = dst_fc->device_ctx->hwctx;
+    VAAPIFramesContext        *ctx = dst_fc->internal->priv;
+    const AVDRMFrameDescriptor *desc;
+    const VAAPIFormatDescriptor *format_desc;
+    FFDRMImportKey key;
+    VASurfaceID surface_id;
+    uint32_t va_fourcc;
+    int err, i, j, cached;
+
+    desc = (AVDRMFrameDescriptor*)src->data[0];
+
+    va_fourcc = 0;
+    for (i = 0; i < FF_ARRAY_ELEMS(vaapi_drm_format_map); i++) {
+        if (desc->nb_layers != vaapi_drm_format_map[i].nb_layer_formats)
+            continue;
+        for (j = 0; j < desc->nb_layers; j++) {
+            if (desc->layers[j].format !=
+                vaapi_drm_format_map[i].layer_formats[j])
+                break;
+        }
+        if (j != desc->nb_layers)
+            continue;
+        va_fourcc = vaapi_drm_format_map[i].va_fourcc;
+        break;
+    }
+    if (!va_fourcc) {
+        av_log(dst_fc, AV_LOG_ERROR, "DRM format not supported "
+               "by VAAPI.\n");
+        return AVERROR(EINVAL);
+    }
+
+    format_desc = vaapi_format_from_fourcc(va_fourcc);
+    av_assert0(format_desc);
+
+    // Mapping the same buffers again (e.g. frames from a fixed pool in
+    // another API) reuses the surface created the first time.  Cached
+    // surfaces live until the frames context is freed.
+    cached = ff_drm_import_key(&key, desc) >= 0;
+    if (cached) {
+        for (i = 0; i < ctx->nb_drm_imports; i++) {
+            if (ff_drm_import_key_equal(&ctx->drm_imports[i].key, &key)) {
+                surface_id = ctx->drm_imports[i].surface_id;
+                av_log(dst_fc, AV_LOG_DEBUG, "Reuse surface %#x for DRM "
+                       "object %d.\n", surface_id, desc->objects[0].fd);
+                goto mapped;
+            }
+        }
+        cached = ctx->nb_drm_imports < VAAPI_MAX_DRM_IMPORTS;
+    }
+
+    av_log(dst_fc, AV_LOG_DEBUG, "Map DRM object %d to VAAPI as "
+           "%08x.\n", desc->objects[0].fd, va_fourcc);
+
+    err = AVERROR(ENOSYS);
+#if VA_CHECK_VERSION(1, 1, 0)
+    err = vaapi_surface_from_drm_prime2(src_fc, desc, format_desc,
+                                        src->width, src->height,
+                                        &surface_id);
+#endif
+    if (err < 0) {
+        err = vaapi_surface_from_drm_prime(src_fc, desc, format_desc,
+                                           src->width, src->height,
+                                           &surface_id);
+        if (err < 0)
+            return err;
+    }
     av_log(dst_fc, AV_LOG_DEBUG, "Create surface %#x.\n", surface_id);
 
+    if (cached) {
+        ctx->drm_imports[ctx->nb_drm_imports].key        = key;
+        ctx->drm_imports[ctx->nb_drm_imports].surface_id = surface_id;
+        ctx->nb_drm_imports++;
+    }
+
+mapped:
     err = ff_hwframe_map_create(dst->hw_frames_ctx, dst, src,
-                                &vaapi_unmap_from_drm,
+                                cached ? NULL : &vaapi_unmap_from_drm,
                                 (void*)(uintptr_t)surface_id);
-    if (err < 0)
+    if (err < 0) {
+        if (!cached)
+            vaDestroySurfaces(dst_dev->display, &surface_id, 1);
         return err;
+    }
 
     dst->width   = src->width;
     dst->height  = src->height;
@@ -1132,20 +1306,45 @@ static int vaapi_map_to_drm_esh(AVHWFramesContext *hwfc, AVFrame *dst,
                                 const AVFrame *src, int flags)
 {
     AVVAAPIDeviceContext *hwctx = hwfc->device_ctx->hwctx;
+    AVVAAPIFramesContext *avfc = hwfc->hwctx;
+    VAAPIFramesContext    *ctx = hwfc->internal->priv;
     VASurfaceID surface_id;
     VAStatus vas;
     VADRMPRIMESurfaceDescriptor va_desc;
     AVDRMFrameDescriptor *drm_desc = NULL;
     uint32_t export_flags;
-    int err, i, j;
+    int err, i, j, index;
 
     surface_id = (VASurfaceID)(uintptr_t)src->data[3];
 
+    // Surfaces of a fixed pool are exported once and the descriptor is
+    // reused by every later mapping, so importers see the same buffers.
+    for (index = avfc->nb_surfaces - 1; index >= 0; index--) {
+        if (avfc->surface_ids[index] == surface_id)
+            break;
+    }
+    if (index >= 0) {
+        if (!ctx->drm_exports) {
+            ctx->drm_exports = av_mallocz_array(avfc->nb_surfaces,
+                                                sizeof(*ctx->drm_exports));
+            if (!ctx->drm_exports)
+                return AVERROR(ENOMEM);
+        }
+        if (ctx->drm_exports[index].nb_objects > 0) {
+            drm_desc = &ctx->drm_exports[index];
+            goto mapped;
+        }
+    }
+
     export_flags = VA_EXPORT_SURFACE_SEPARATE_LAYERS;
-    if (flags & AV_HWFRAME_MAP_READ)
-        export_flags |= VA_EXPORT_SURFACE_READ_ONLY;
-    if (flags & AV_HWFRAME_MAP_WRITE)
-        export_flags |= VA_EXPORT_SURFACE_WRITE_ONLY;
+    if (index >= 0) {
+        export_flags |= VA_EXPORT_SURFACE_READ_WRITE;
+    } else {
+        if (flags & AV_HWFRAME_MAP_READ)
+            export_flags |= VA_EXPORT_SURFACE_READ_ONLY;
+        if (flags & AV_HWFRAME_MAP_WRITE)
+            export_flags |= VA_EXPORT_SURFACE_WRITE_ONLY;
+    }
 
     vas = vaExportSurfaceHandle(hwctx->display, surface_id,
                                 VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
@@ -1158,10 +1357,14 @@ static int vaapi_map_to_drm_esh(AVHWFramesContext *hwfc, AVFrame *dst,
         return AVERROR(EIO);
     }
 
-    drm_desc = av_mallocz(sizeof(*drm_desc));
-    if (!drm_desc) {
-        err = AVERROR(ENOMEM);
-        goto fail;
+    if (index >= 0) {
+        drm_desc = &ctx->drm_exports[index];
+    } else {
+        drm_desc = av_mallocz(sizeof(*drm_desc));
+        if (!drm_desc) {
+            err = AVERROR(ENOMEM);
+            goto fail;
+        }
     }
 
     // By some bizarre coincidence, these structures are very similar...
@@ -1186,10 +1389,16 @@ static int vaapi_map_to_drm_esh(AVHWFramesContext *hwfc, AVFrame *dst,
         }
     }
 
+mapped:
     err = ff_hwframe_map_create(src->hw_frames_ctx, dst, src,
-                                &vaapi_unmap_to_drm_esh, drm_desc);
-    if (err < 0)
+                                index >= 0 ? NULL : &vaapi_unmap_to_drm_esh,
+                                drm_desc);
+    if (err < 0) {
+        // A cached descriptor stays valid and is released on uninit.
+        if (index >= 0)
+            return err;
         goto fail;
+    }
 
     dst->width   = src->width;
     dst->height  = src->height;
@@ -1705,6 +1914,35 @@ static int vaapi_device_derive(AVHWDeviceContext *ctx,
     return AVERROR(ENOSYS);
 }
 
+#if HAVE_VAAPI_DRM
+static int vaapi_device_enumerate(void *logctx, char ***devices, int *nb_devices)
+{
+    int n, fd, ret, max_devices = 8;
+
+    // Same render node range as searched by vaapi_device_create().
+    for (n = 0; n < max_devices; n++) {
+        char *path = av_asprintf("/dev/dri/renderD%d", 128 + n);
+        if (!path)
+            return AVERROR(ENOMEM);
+
+        fd = open(path, O_RDWR);
+        if (fd < 0) {
+            av_free(path);
+            break;
+        }
+        close(fd);
+
+        ret = av_dynarray_add_nofree(devices, nb_devices, path);
+        if (ret < 0) {
+            av_free(path);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+#endif
+
 const HWContextType ff_hwcontext_type_vaapi = {
     .type                   = AV_HWDEVICE_TYPE_VAAPI,
     .name                   = "VAAPI",
@@ -1717,6 +1955,9 @@ const HWContextType ff_hwcontext_type_vaapi = {
 
     .device_create          = &vaapi_device_create,
     .device_derive          = &vaapi_device_derive,
+#if HAVE_VAAPI_DRM
+    .device_enumerate       = &vaapi_device_enumerate,
+#endif
     .device_init            = &vaapi_device_init,
     .device_uninit          = &vaapi_device_uninit,
     .frames_get_constraints = &vaapi_frames_get_constraints,
@@ -188,7 +188,7 @@ static int vt_transfer_data_from(AVHWFramesContext *hwfc,
     map->width  = dst->width;
     map->height = dst->height;
 
-    err = av_frame_copy(dst, map);
+    err = ff_hwframe_copy_data(hwfc, dst, map);
     if (err)
         goto fail;
 
@@ -29,6 +29,10 @@
 #include <xf86drm.h>
 #include <drm_fourcc.h>
 #include "hwcontext_drm.h"
+#include "hwcontext_drm_internal.h"
+#ifndef DRM_FORMAT_MOD_INVALID
+#define DRM_FORMAT_MOD_INVALID ((1ULL << 56) - 1)
+#endif
 #if CONFIG_VAAPI
 #include <va/va_drmcommon.h>
 #include "hwcontext_vaapi.h"
@@ -83,6 +87,16 @@ typedef struct VulkanDevicePriv {
     int dev_is_nvidia;
 } VulkanDevicePriv;
 
+#if CONFIG_LIBDRM
+/* Maximum number of DMA-BUF imports a frames context keeps around */
+#define VULKAN_MAX_DRM_IMPORTS 32
+
+typedef struct VulkanDRMImport {
+    FFDRMImportKey key;
+    AVVkFrame *frame;
+} VulkanDRMImport;
+#endif
+
 typedef struct VulkanFramesPriv {
     /* Image conversions */
     VulkanExecCtx conv_ctx;
@@ -90,6 +104,17 @@ typedef struct VulkanFramesPriv {
     /* Image transfers */
     VulkanExecCtx upload_ctx;
     VulkanExecCtx download_ctx;
+
+#if CONFIG_LIBDRM
+    /* DRM format modifiers the pool images are created with */
+    uint64_t *modifiers;
+    int nb_modifiers;
+    VkImageDrmFormatModifierListCreateInfoEXT modifier_info;
+
+    /* DMA-BUFs imported as frames, reused when mapped again */
+    VulkanDRMImport drm_imports[VULKAN_MAX_DRM_IMPORTS];
+    int nb_drm_imports;
+#endif
 } VulkanFramesPriv;
 
 typedef struct AVVkFrameInternal {
@@ -102,6 +127,11 @@ typedef struct AVVkFrameInternal {
     CUarray cu_array[AV_NUM_DATA_POINTERS];
     CUexternalSemaphore cu_sem[AV_NUM_DATA_POINTERS];
 #endif
+#if CONFIG_LIBDRM
+    /* Exported once and kept open, so that importers of the DMA-BUFs can
+     * recognize and reuse their imports */
+    AVDRMFrameDescriptor *drm_desc;
+#endif
 } AVVkFrameInternal;
 
 #define GET_QUEUE_COUNT(hwctx, graph, comp, tx) (                   \
@@ -152,6 +182,8 @@ static const struct {
     { AV_PIX_FMT_YUV422P, { VK_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM } },
     { AV_PIX_FMT_YUV444P, { VK_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM } },
 
+    { AV_PIX_FMT_YUV420P10, { VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM } },
+
     { AV_PIX_FMT_YUV420P16, { VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM } },
     { AV_PIX_FMT_YUV422P16, { VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM } },
     { AV_PIX_FMT_YUV444P16, { VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM, VK_FORMAT_R16_UNORM } },
@@ -1331,6 +1363,14 @@ static void vulkan_free_internal(AVVkFrameInternal *internal)
     }
 #endif
 
+#if CONFIG_LIBDRM
+    if (internal->drm_desc) {
+        for (int i = 0; i < internal->drm_desc->nb_objects; i++)
+            close(internal->drm_desc->objects[i].fd);
+        av_free(internal->drm_desc);
+    }
+#endif
+
     av_free(internal);
 }
 
@@ -1610,6 +1650,26 @@ static void try_export_flags(AVHWFramesContext *hwfc,
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
         .handleType = exp,
     };
+#if CONFIG_LIBDRM
+    VulkanDevicePriv *p = hwfc->device_ctx->internal->priv;
+    VulkanFramesPriv *fp = hwfc->internal->priv;
+    VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+        .sharingMode           = p->num_qfs > 1 ? VK_SHARING_MODE_CONCURRENT :
+                                                  VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = p->num_qfs,
+        .pQueueFamilyIndices   = p->qfs,
+    };
+
+    /* Modifier tiling can't be queried without a modifier, all of the
+     * negotiated ones are usable so check the first one */
+    if (hwctx->tiling == VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT) {
+        if (!fp->nb_modifiers)
+            return;
+        drm_info.drmFormatModifier = fp->modifiers[0];
+        enext.pNext = &drm_info;
+    }
+#endif
     VkPhysicalDeviceImageFormatInfo2 pinfo = {
         .sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
         .pNext  = !exp ? NULL : &enext,
@@ -1628,6 +1688,147 @@ static void try_export_flags(AVHWFramesContext *hwfc,
     }
 }
 
+#if CONFIG_LIBDRM
+/* Checks whether images of a format can be created with a DRM format
+ * modifier and exported as a DMA-BUF */
+static int vulkan_modifier_supported(AVHWFramesContext *hwfc, VkFormat fmt,
+                                     uint64_t modifier)
+{
+    VkResult ret;
+    AVVulkanFramesContext *hwctx = hwfc->hwctx;
+    AVVulkanDeviceContext *dev_hwctx = hwfc->device_ctx->hwctx;
+    VulkanDevicePriv *p = hwfc->device_ctx->internal->priv;
+    VkImageFormatProperties2 props = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+    };
+    VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+        .drmFormatModifier     = modifier,
+        .sharingMode           = p->num_qfs > 1 ? VK_SHARING_MODE_CONCURRENT :
+                                                  VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = p->num_qfs,
+        .pQueueFamilyIndices   = p->qfs,
+    };
+    VkPhysicalDeviceExternalImageFormatInfo enext = {
+        .sType      = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+        .pNext      = &drm_info,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+    };
+    VkPhysicalDeviceImageFormatInfo2 pinfo = {
+        .sType  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+        .pNext  = &enext,
+        .format = fmt,
+        .type   = VK_IMAGE_TYPE_2D,
+        .tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+        .usage  = hwctx->usage,
+        .flags  = VK_IMAGE_CREATE_ALIAS_BIT,
+    };
+
+    ret = vkGetPhysicalDeviceImageFormatProperties2(dev_hwctx->phys_dev,
+                                                    &pinfo, &props);
+    return ret == VK_SUCCESS;
+}
+
+/* Finds the DRM format modifiers which all planes of the pool support with
+ * the requested usage, so that frames keep their native tiling when they
+ * are exported to DRM instead of having to be linear. Modifiers with more
+ * than one memory plane (e.g. compression metadata) are skipped as every
+ * plane is a separate image with a single object. */
+static int vulkan_negotiate_modifiers(AVHWFramesContext *hwfc)
+{
+    AVVulkanFramesContext *hwctx = hwfc->hwctx;
+    AVVulkanDeviceContext *dev_hwctx = hwfc->device_ctx->hwctx;
+    VulkanFramesPriv *fp = hwfc->internal->priv;
+    const VkFormat *img_fmts = av_vkfmt_from_pixfmt(hwfc->sw_format);
+    const int planes = av_pix_fmt_count_planes(hwfc->sw_format);
+    VkFormatFeatureFlags feats = 0x0;
+
+    if (hwctx->usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+        feats |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    if (hwctx->usage & VK_IMAGE_USAGE_STORAGE_BIT)
+        feats |= VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+    if (hwctx->usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        feats |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+    if (hwctx->usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+        feats |= VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    if (hwctx->usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+        feats |= VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+
+    for (int i = 0; i < planes; i++) {
+        int nb_mods = 0;
+        VkDrmFormatModifierPropertiesEXT *mod_props;
+        VkDrmFormatModifierPropertiesListEXT mod_list = {
+            .sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT,
+        };
+        VkFormatProperties2 fprops = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+            .pNext = &mod_list,
+        };
+
+        vkGetPhysicalDeviceFormatProperties2(dev_hwctx->phys_dev, img_fmts[i],
+                                             &fprops);
+        if (!mod_list.drmFormatModifierCount) {
+            fp->nb_modifiers = 0;
+            break;
+        }
+
+        mod_props = av_malloc_array(mod_list.drmFormatModifierCount,
+                                    sizeof(*mod_props));
+        if (!mod_props)
+            return AVERROR(ENOMEM);
+
+        mod_list.pDrmFormatModifierProperties = mod_props;
+        vkGetPhysicalDeviceFormatProperties2(dev_hwctx->phys_dev, img_fmts[i],
+                                             &fprops);
+
+        if (!i) {
+            fp->modifiers = av_malloc_array(mod_list.drmFormatModifierCount,
+                                            sizeof(*fp->modifiers));
+            if (!fp->modifiers) {
+                av_free(mod_props);
+                return AVERROR(ENOMEM);
+            }
+            for (int j = 0; j < mod_list.drmFormatModifierCount; j++)
+                fp->modifiers[j] = mod_props[j].drmFormatModifier;
+            fp->nb_modifiers = mod_list.drmFormatModifierCount;
+        }
+
+        /* Only keep what this plane supports too */
+        for (int j = 0; j < fp->nb_modifiers; j++) {
+            for (int k = 0; k < mod_list.drmFormatModifierCount; k++) {
+                if (mod_props[k].drmFormatModifier != fp->modifiers[j])
+                    continue;
+                if (mod_props[k].drmFormatModifierPlaneCount == 1 &&
+                    (mod_props[k].drmFormatModifierTilingFeatures & feats) == feats &&
+                    vulkan_modifier_supported(hwfc, img_fmts[i], fp->modifiers[j]))
+                    fp->modifiers[nb_mods++] = fp->modifiers[j];
+                break;
+            }
+        }
+        fp->nb_modifiers = nb_mods;
+
+        av_free(mod_props);
+    }
+
+    if (!fp->nb_modifiers) {
+        av_freep(&fp->modifiers);
+        return 0;
+    }
+
+    fp->modifier_info = (VkImageDrmFormatModifierListCreateInfoEXT) {
+        .sType                  = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_LIST_CREATE_INFO_EXT,
+        .pNext                  = hwctx->create_pnext,
+        .drmFormatModifierCount = fp->nb_modifiers,
+        .pDrmFormatModifiers    = fp->modifiers,
+    };
+
+    av_log(hwfc, AV_LOG_VERBOSE, "Using %i DRM format modifiers for the "
+           "frame pool.\n", fp->nb_modifiers);
+
+    return 0;
+}
+#endif
+
 static AVBufferRef *vulkan_pool_alloc(void *opaque, int size)
 {
     int err;
@@ -1645,6 +1846,11 @@ static AVBufferRef *vulkan_pool_alloc(void *opaque, int size)
         .pNext       = hwctx->create_pnext,
     };
 
+#if CONFIG_LIBDRM
+    if (fp->nb_modifiers)
+        eiinfo.pNext = &fp->modifier_info;
+#endif
+
     if (p->extensions & EXT_EXTERNAL_FD_MEMORY)
         try_export_flags(hwfc, &eiinfo.handleTypes, &e,
                          VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT);
@@ -1691,6 +1897,15 @@ static void vulkan_frames_uninit(AVHWFramesContext *hwfc)
     free_exec_ctx(hwfc, &fp->conv_ctx);
     free_exec_ctx(hwfc, &fp->upload_ctx);
     free_exec_ctx(hwfc, &fp->download_ctx);
+
+#if CONFIG_LIBDRM
+    for (int i = 0; i < fp->nb_drm_imports; i++)
+        vulkan_frame_free(hwfc, (uint8_t *)fp->drm_imports[i].frame);
+    fp->nb_drm_imports = 0;
+
+    av_freep(&fp->modifiers);
+    fp->nb_modifiers = 0;
+#endif
 }
 
 static int vulkan_frames_init(AVHWFramesContext *hwfc)
@@ -1702,13 +1917,34 @@ static int vulkan_frames_init(AVHWFramesContext *hwfc)
     AVVulkanDeviceContext *dev_hwctx = hwfc->device_ctx->hwctx;
     VulkanDevicePriv *p = hwfc->device_ctx->internal->priv;
 
+    if (!hwctx->usage)
+        hwctx->usage = DEFAULT_USAGE_FLAGS;
+
+#if CONFIG_LIBDRM
+    /* Frames on a device derived from VAAPI or DRM are likely to be mapped
+     * back, so allocate them with a modifier both sides understand. */
+    if (!hwctx->tiling && !p->use_linear_images &&
+        (p->extensions & EXT_DRM_MODIFIER_FLAGS) &&
+        (p->extensions & EXT_EXTERNAL_DMABUF_MEMORY) &&
+        hwfc->device_ctx->internal->source_device) {
+        AVHWDeviceContext *src_dev =
+            (AVHWDeviceContext *)hwfc->device_ctx->internal->source_device->data;
+
+        if (src_dev->type == AV_HWDEVICE_TYPE_VAAPI ||
+            src_dev->type == AV_HWDEVICE_TYPE_DRM) {
+            err = vulkan_negotiate_modifiers(hwfc);
+            if (err < 0)
+                return err;
+            if (fp->nb_modifiers)
+                hwctx->tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+        }
+    }
+#endif
+
     /* Default pool flags */
     hwctx->tiling = hwctx->tiling ? hwctx->tiling : p->use_linear_images ?
                     VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
 
-    if (!hwctx->usage)
-        hwctx->usage = DEFAULT_USAGE_FLAGS;
-
     err = create_exec_ctx(hwfc, &fp->conv_ctx,
                           dev_hwctx->queue_family_comp_index,
                           GET_QUEUE_COUNT(dev_hwctx, 0, 1, 0));
@@ -1728,6 +1964,9 @@ static int vulkan_frames_init(AVHWFramesContext *hwfc)
 
     /* Test to see if allocation will fail */
     err = create_frame(hwfc, &f, hwctx->tiling, hwctx->usage,
+#if CONFIG_LIBDRM
+                       fp->nb_modifiers ? &fp->modifier_info :
+#endif
                        hwctx->create_pnext);
     if (err)
         goto fail;
@@ -1916,16 +2155,9 @@ fail:
 static void vulkan_unmap_from(AVHWFramesContext *hwfc, HWMapDescriptor *hwmap)
 {
     VulkanMapping *map = hwmap->priv;
-    AVVulkanDeviceContext *hwctx = hwfc->device_ctx->hwctx;
-    const int planes = av_pix_fmt_count_planes(hwfc->sw_format);
 
-    for (int i = 0; i < planes; i++) {
-        vkDestroyImage(hwctx->act_dev, map->frame->img[i], hwctx->alloc);
-        vkFreeMemory(hwctx->act_dev, map->frame->mem[i], hwctx->alloc);
-        vkDestroySemaphore(hwctx->act_dev, map->frame->sem[i], hwctx->alloc);
-    }
-
-    av_freep(&map->frame);
+    vulkan_frame_free(hwfc, (uint8_t *)map->frame);
+    av_free(map);
 }
 
 static const struct {
@@ -1965,7 +2197,8 @@ static int vulkan_map_from_drm_frame_desc(AVHWFramesContext *hwfc, AVVkFrame **f
     VulkanFramesPriv *fp = hwfc->internal->priv;
     AVVulkanFramesContext *frames_hwctx = hwfc->hwctx;
     const AVPixFmtDescriptor *fmt_desc = av_pix_fmt_desc_get(hwfc->sw_format);
-    const int has_modifiers = p->extensions & EXT_DRM_MODIFIER_FLAGS;
+    int has_modifiers = p->extensions & EXT_DRM_MODIFIER_FLAGS;
+    int is_linear = 1;
     VkSubresourceLayout plane_data[AV_NUM_DATA_POINTERS] = { 0 };
     VkBindImageMemoryInfo bind_info[AV_NUM_DATA_POINTERS] = { 0 };
     VkBindImagePlaneMemoryInfo plane_info[AV_NUM_DATA_POINTERS] = { 0 };
@@ -1987,15 +2220,24 @@ static int vulkan_map_from_drm_frame_desc(AVHWFramesContext *hwfc, AVVkFrame **f
         goto fail;
     }
 
+    /* An implicit modifier can't be described explicitly, the driver has to
+     * guess the layout in that case */
+    for (int i = 0; i < desc->nb_objects; i++) {
+        if (desc->objects[i].format_modifier == DRM_FORMAT_MOD_INVALID)
+            has_modifiers = 0;
+        if (desc->objects[i].format_modifier != DRM_FORMAT_MOD_LINEAR)
+            is_linear = 0;
+    }
+
     f->tiling = has_modifiers ? VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT :
-                desc->objects[0].format_modifier == DRM_FORMAT_MOD_LINEAR ?
-                VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
+                is_linear ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
 
     for (int i = 0; i < desc->nb_layers; i++) {
         const int planes = desc->layers[i].nb_planes;
+        const int obj = desc->layers[i].planes[0].object_index;
         VkImageDrmFormatModifierExplicitCreateInfoEXT drm_info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
-            .drmFormatModifier = desc->objects[0].format_modifier,
+            .drmFormatModifier = desc->objects[obj].format_modifier,
             .drmFormatModifierPlaneCount = planes,
             .pPlaneLayouts = (const VkSubresourceLayout *)&plane_data,
         };
@@ -2192,26 +2434,52 @@ static int vulkan_map_from_drm(AVHWFramesContext *hwfc, AVFrame *dst,
     int err = 0;
     AVVkFrame *f;
     VulkanMapping *map = NULL;
+    VulkanFramesPriv *fp = hwfc->internal->priv;
+    AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor *)src->data[0];
+    FFDRMImportKey key;
+    int cached;
+
+    /* Importing is expensive, so buffers mapped again (e.g. from a fixed
+     * decoder pool) reuse the frame imported the first time. The imported
+     * frames keep their semaphores, which every user leaves signalled. */
+    cached = ff_drm_import_key(&key, desc) >= 0;
+    if (cached) {
+        for (int i = 0; i < fp->nb_drm_imports; i++) {
+            if (ff_drm_import_key_equal(&fp->drm_imports[i].key, &key)) {
+                f = fp->drm_imports[i].frame;
+                goto mapped;
+            }
+        }
+        cached = fp->nb_drm_imports < VULKAN_MAX_DRM_IMPORTS;
+    }
 
-    err = vulkan_map_from_drm_frame_desc(hwfc, &f,
-                                         (AVDRMFrameDescriptor *)src->data[0]);
+    err = vulkan_map_from_drm_frame_desc(hwfc, &f, desc);
     if (err)
         return err;
 
-    /* The unmapping function will free this */
+    if (cached) {
+        fp->drm_imports[fp->nb_drm_imports].key   = key;
+        fp->drm_imports[fp->nb_drm_imports].frame = f;
+        fp->nb_drm_imports++;
+    } else {
+        /* The unmapping function will free this */
+        map = av_mallocz(sizeof(VulkanMapping));
+        if (!map) {
+            vulkan_frame_free(hwfc, (uint8_t *)f);
+            return AVERROR(ENOMEM);
+        }
+
+        map->frame = f;
+        map->flags = flags;
+    }
+
+mapped:
     dst->data[0] = (uint8_t *)f;
     dst->width   = src->width;
     dst->height  = src->height;
 
-    map = av_mallocz(sizeof(VulkanMapping));
-    if (!map)
-        goto fail;
-
-    map->frame = f;
-    map->flags = flags;
-
     err = ff_hwframe_map_create(dst->hw_frames_ctx, dst, src,
-                                &vulkan_unmap_from, map);
+                                map ? &vulkan_unmap_from : NULL, map);
     if (err < 0)
         goto fail;
 
@@ -2220,7 +2488,8 @@ static int vulkan_map_from_drm(AVHWFramesContext *hwfc, AVFrame *dst,
     return 0;
 
 fail:
-    vulkan_frame_free(hwfc->device_ctx->hwctx, (uint8_t *)f);
+    if (map)
+        vulkan_frame_free(hwfc, (uint8_t *)f);
     av_free(map);
     return err;
 }
@@ -2495,21 +2764,6 @@ static int vulkan_map_to(AVHWFramesContext *hwfc, AVFrame *dst,
 }
 
 #if CONFIG_LIBDRM
-typedef struct VulkanDRMMapping {
-    AVDRMFrameDescriptor drm_desc;
-    AVVkFrame *source;
-} VulkanDRMMapping;
-
-static void vulkan_unmap_to_drm(AVHWFramesContext *hwfc, HWMapDescriptor *hwmap)
-{
-    AVDRMFrameDescriptor *drm_desc = hwmap->priv;
-
-    for (int i = 0; i < drm_desc->nb_objects; i++)
-        close(drm_desc->objects[i].fd);
-
-    av_free(drm_desc);
-}
-
 static inline uint32_t vulkan_fmt_to_drm(VkFormat vkfmt)
 {
     for (int i = 0; i < FF_ARRAY_ELEMS(vulkan_drm_format_map); i++)
@@ -2524,51 +2778,62 @@ static int vulkan_map_to_drm(AVHWFramesContext *hwfc, AVFrame *dst,
     int err = 0;
     VkResult ret;
     AVVkFrame *f = (AVVkFrame *)src->data[0];
-    VulkanDevicePriv *p = hwfc->device_ctx->internal->priv;
     VulkanFramesPriv *fp = hwfc->internal->priv;
     AVVulkanDeviceContext *hwctx = hwfc->device_ctx->hwctx;
     const int planes = av_pix_fmt_count_planes(hwfc->sw_format);
+    const int has_modifiers = f->tiling == VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+    AVDRMFrameDescriptor *drm_desc;
     VK_LOAD_PFN(hwctx->inst, vkGetMemoryFdKHR);
-    VkImageDrmFormatModifierPropertiesEXT drm_mod = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_PROPERTIES_EXT,
-    };
-
-    AVDRMFrameDescriptor *drm_desc = av_mallocz(sizeof(*drm_desc));
-    if (!drm_desc)
-        return AVERROR(ENOMEM);
 
     err = prepare_frame(hwfc, &fp->conv_ctx, f, PREP_MODE_EXTERNAL_EXPORT);
     if (err < 0)
-        goto end;
-
-    err = ff_hwframe_map_create(src->hw_frames_ctx, dst, src, &vulkan_unmap_to_drm, drm_desc);
-    if (err < 0)
-        goto end;
+        return err;
 
-    if (p->extensions & EXT_DRM_MODIFIER_FLAGS) {
-        VK_LOAD_PFN(hwctx->inst, vkGetImageDrmFormatModifierPropertiesEXT);
-        ret = pfn_vkGetImageDrmFormatModifierPropertiesEXT(hwctx->act_dev, f->img[0],
-                                                           &drm_mod);
-        if (ret != VK_SUCCESS) {
-            av_log(hwfc, AV_LOG_ERROR, "Failed to retrieve DRM format modifier!\n");
-            err = AVERROR_EXTERNAL;
-            goto end;
-        }
+    /* The frame is only exported once, the descriptor lives as long as
+     * the frame does */
+    if (f->internal && f->internal->drm_desc) {
+        drm_desc = f->internal->drm_desc;
+        goto mapped;
     }
 
+    if (!f->internal && !(f->internal = av_mallocz(sizeof(*f->internal))))
+        return AVERROR(ENOMEM);
+
+    drm_desc = av_mallocz(sizeof(*drm_desc));
+    if (!drm_desc)
+        return AVERROR(ENOMEM);
+
     for (int i = 0; (i < planes) && (f->mem[i]); i++) {
         VkMemoryGetFdInfoKHR export_info = {
             .sType      = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
             .memory     = f->mem[i],
             .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
         };
+        VkImageDrmFormatModifierPropertiesEXT drm_mod = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_PROPERTIES_EXT,
+            .drmFormatModifier = f->tiling == VK_IMAGE_TILING_LINEAR ?
+                                 DRM_FORMAT_MOD_LINEAR : DRM_FORMAT_MOD_INVALID,
+        };
+
+        /* Every plane is its own image, which may have been created with
+         * any of the allowed modifiers */
+        if (has_modifiers) {
+            VK_LOAD_PFN(hwctx->inst, vkGetImageDrmFormatModifierPropertiesEXT);
+            ret = pfn_vkGetImageDrmFormatModifierPropertiesEXT(hwctx->act_dev, f->img[i],
+                                                               &drm_mod);
+            if (ret != VK_SUCCESS) {
+                av_log(hwfc, AV_LOG_ERROR, "Failed to retrieve DRM format modifier!\n");
+                err = AVERROR_EXTERNAL;
+                goto fail;
+            }
+        }
 
         ret = pfn_vkGetMemoryFdKHR(hwctx->act_dev, &export_info,
                                    &drm_desc->objects[i].fd);
         if (ret != VK_SUCCESS) {
             av_log(hwfc, AV_LOG_ERROR, "Unable to export the image as a FD!\n");
             err = AVERROR_EXTERNAL;
-            goto end;
+            goto fail;
         }
 
         drm_desc->nb_objects++;
@@ -2580,7 +2845,7 @@ static int vulkan_map_to_drm(AVHWFramesContext *hwfc, AVFrame *dst,
     for (int i = 0; i < drm_desc->nb_layers; i++) {
         VkSubresourceLayout layout;
         VkImageSubresource sub = {
-            .aspectMask = p->extensions & EXT_DRM_MODIFIER_FLAGS ?
+            .aspectMask = has_modifiers ?
                           VK_IMAGE_ASPECT_MEMORY_PLANE_0_BIT_EXT :
                           VK_IMAGE_ASPECT_COLOR_BIT,
         };
@@ -2592,7 +2857,7 @@ static int vulkan_map_to_drm(AVHWFramesContext *hwfc, AVFrame *dst,
         if (drm_desc->layers[i].format == DRM_FORMAT_INVALID) {
             av_log(hwfc, AV_LOG_ERROR, "Cannot map to DRM layer, unsupported!\n");
             err = AVERROR_PATCHWELCOME;
-            goto end;
+            goto fail;
         }
 
         drm_desc->layers[i].planes[0].object_index = FFMIN(i, drm_desc->nb_objects - 1);
@@ -2605,6 +2870,13 @@ static int vulkan_map_to_drm(AVHWFramesContext *hwfc, AVFrame *dst,
         drm_desc->layers[i].planes[0].pitch        = layout.rowPitch;
     }
 
+    f->internal->drm_desc = drm_desc;
+
+mapped:
+    err = ff_hwframe_map_create(src->hw_frames_ctx, dst, src, NULL, NULL);
+    if (err < 0)
+        return err;
+
     dst->width   = src->width;
     dst->height  = src->height;
     dst->data[0] = (uint8_t *)drm_desc;
@@ -2613,7 +2885,9 @@ static int vulkan_map_to_drm(AVHWFramesContext *hwfc, AVFrame *dst,
 
     return 0;
 
-end:
+fail:
+    for (int i = 0; i < drm_desc->nb_objects; i++)
+        close(drm_desc->objects[i].fd);
     av_free(drm_desc);
     return err;
 }
@@ -408,6 +408,59 @@ void av_image_copy_uc_from(uint8_t *dst_data[4], const ptrdiff_t dst_linesizes[4
                width, height, image_copy_plane_uc_from);
 }
 
+/* Slices smaller than this do not amortize the cost of waking up a thread. */
+#define SLICE_MIN_SIZE (1 << 20)
+
+int avpriv_image_copy_nb_slices(enum AVPixelFormat pix_fmt, int width,
+                                int height, int max_slices)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    int size;
+
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL |
+                                FF_PSEUDOPAL))
+        return 1;
+
+    size = av_image_get_buffer_size(pix_fmt, width, height, 1);
+    if (size < 0)
+        return 1;
+
+    max_slices = FFMIN(max_slices, size / SLICE_MIN_SIZE);
+    max_slices = FFMIN(max_slices, height >> desc->log2_chroma_h);
+    return FFMAX(max_slices, 1);
+}
+
+void avpriv_image_copy_slice(uint8_t *dst_data[4], const ptrdiff_t dst_linesizes[4],
+                             const uint8_t *src_data[4], const ptrdiff_t src_linesizes[4],
+                             enum AVPixelFormat pix_fmt, int width, int height,
+                             int slice, int nb_slices)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    uint8_t *dst[4];
+    const uint8_t *src[4];
+    int start, end, i;
+
+    if (!desc)
+        return;
+
+    /* slice boundaries fall on whole chroma rows */
+    start = (int64_t)height *  slice      / nb_slices >> desc->log2_chroma_h << desc->log2_chroma_h;
+    end   = (int64_t)height * (slice + 1) / nb_slices >> desc->log2_chroma_h << desc->log2_chroma_h;
+    if (slice == nb_slices - 1)
+        end = height;
+    if (start >= end)
+        return;
+
+    for (i = 0; i < 4; i++) {
+        int y = (i == 1 || i == 2) ? start >> desc->log2_chroma_h : start;
+        dst[i] = dst_data[i] ? dst_data[i] + y * dst_linesizes[i] : NULL;
+        src[i] = src_data[i] ? src_data[i] + y * src_linesizes[i] : NULL;
+    }
+
+    image_copy(dst, dst_linesizes, src, src_linesizes, pix_fmt,
+               width, end - start, image_copy_plane);
+}
+
 int av_image_fill_arrays(uint8_t *dst_data[4], int dst_linesize[4],
                          const uint8_t *src, enum AVPixelFormat pix_fmt,
                          int width, int height, int align)
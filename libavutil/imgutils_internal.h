@@ -22,9 +22,32 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "pixfmt.h"
+
 int ff_image_copy_plane_uc_from_x86(uint8_t       *dst, ptrdiff_t dst_linesize,
                                     const uint8_t *src, ptrdiff_t src_linesize,
                                     ptrdiff_t bytewidth, int height);
 
+/**
+ * Get the number of slices worth splitting the copy of an image into, for
+ * avpriv_image_copy_slice().
+ *
+ * @param max_slices maximum number of slices, usually the number of threads
+ * @return the number of slices, 1 if the image is too small to benefit from
+ *         threading or cannot be split
+ */
+int avpriv_image_copy_nb_slices(enum AVPixelFormat pix_fmt, int width,
+                                int height, int max_slices);
+
+/**
+ * Copy one horizontal band of an image, like av_image_copy().
+ * Copying the slices 0 to nb_slices - 1 in any order, possibly concurrently,
+ * copies the whole image.
+ */
+void avpriv_image_copy_slice(uint8_t *dst_data[4], const ptrdiff_t dst_linesizes[4],
+                             const uint8_t *src_data[4], const ptrdiff_t src_linesizes[4],
+                             enum AVPixelFormat pix_fmt, int width, int height,
+                             int slice, int nb_slices);
+
 
 #endif /* AVUTIL_IMGUTILS_INTERNAL_H */
@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,7 +42,9 @@
 #include "common.h"
 #include "dynarray.h"
 #include "intreadwrite.h"
+#include "log.h"
 #include "mem.h"
+#include "thread.h"
 
 #ifdef MALLOC_PREFIX
 
@@ -74,12 +77,182 @@ void av_max_alloc(size_t max){
     max_alloc_size = max;
 }
 
-void *av_malloc(size_t size)
+typedef struct MemClassStats {
+    const AVClass *class;
+    atomic_intptr_t live;       ///< size_t, intptr_t for the CAS on peak
+    atomic_intptr_t peak;
+    atomic_intptr_t nb_allocs;
+    atomic_intptr_t nb_frees;
+} MemClassStats;
+
+#define MAX_CLASSES 512
+
+/* [0] is for the allocations made without a class set, [MAX_CLASSES] holds
+ * the totals. Entries are appended under class_lock and never removed, so
+ * readers only need the acquire load of nb_classes. */
+static MemClassStats class_stats[MAX_CLASSES + 1];
+static atomic_int nb_classes = ATOMIC_VAR_INIT(1);
+static AVMutex class_lock = AV_MUTEX_INITIALIZER;
+
+static AVMemAllocator allocator;
+static int have_allocator;
+
+#if HAVE_PTHREADS
+static pthread_key_t  current_key;
+static pthread_once_t current_key_once = PTHREAD_ONCE_INIT;
+
+static void current_key_init(void)
 {
-    void *ptr = NULL;
+    pthread_key_create(&current_key, NULL);
+}
 
-    if (size > max_alloc_size)
+static MemClassStats *get_current(void)
+{
+    MemClassStats *s;
+    pthread_once(&current_key_once, current_key_init);
+    s = pthread_getspecific(current_key);
+    return s ? s : &class_stats[0];
+}
+
+static void set_current(MemClassStats *s)
+{
+    pthread_once(&current_key_once, current_key_init);
+    pthread_setspecific(current_key, s);
+}
+#else
+/* without pthreads the class is process-wide */
+static MemClassStats *current = &class_stats[0];
+
+static MemClassStats *get_current(void)
+{
+    return current;
+}
+
+static void set_current(MemClassStats *s)
+{
+    current = s;
+}
+#endif
+
+static MemClassStats *find_class(const AVClass *class)
+{
+    int nb = atomic_load_explicit(&nb_classes, memory_order_acquire);
+    for (int i = 1; i < nb; i++)
+        if (class_stats[i].class == class)
+            return &class_stats[i];
+    return NULL;
+}
+
+static MemClassStats *get_class(const AVClass *class)
+{
+    MemClassStats *s;
+    int nb;
+
+    if (!class)
+        return &class_stats[0];
+    if ((s = find_class(class)))
+        return s;
+
+    ff_mutex_lock(&class_lock);
+    s  = find_class(class);
+    nb = atomic_load_explicit(&nb_classes, memory_order_relaxed);
+    if (!s && nb < MAX_CLASSES) {
+        s = &class_stats[nb];
+        s->class = class;
+        atomic_store_explicit(&nb_classes, nb + 1, memory_order_release);
+    }
+    ff_mutex_unlock(&class_lock);
+
+    /* classes beyond the table are accounted as having no class */
+    return s ? s : &class_stats[0];
+}
+
+#if CONFIG_MEMORY_STATS
+/* Every block is prefixed by a header recording its size and the class it
+ * is accounted to. Its size keeps the returned pointers aligned. */
+#define HEADER_SIZE ALIGN
+
+typedef struct MemHeader {
+    size_t   size;
+    unsigned idx;
+} MemHeader;
+
+static void account(MemClassStats *s, intptr_t delta, int allocs, int frees)
+{
+    for (int i = 0; i < 2; i++, s = &class_stats[MAX_CLASSES]) {
+        intptr_t live = atomic_fetch_add_explicit(&s->live, delta,
+                                                  memory_order_relaxed) + delta;
+        intptr_t peak = atomic_load_explicit(&s->peak, memory_order_relaxed);
+
+        while ((size_t)live > (size_t)peak &&
+               !atomic_compare_exchange_weak_explicit(&s->peak, &peak, live,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            ;
+        if (allocs)
+            atomic_fetch_add_explicit(&s->nb_allocs, 1, memory_order_relaxed);
+        if (frees)
+            atomic_fetch_add_explicit(&s->nb_frees, 1, memory_order_relaxed);
+    }
+}
+#endif
+
+void av_mem_set_allocator(const AVMemAllocator *a)
+{
+    allocator      = *a;
+    have_allocator = 1;
+}
+
+const AVClass *av_mem_set_class(const AVClass *class)
+{
+    const AVClass *prev;
+
+    if (!CONFIG_MEMORY_STATS && !have_allocator)
+        return NULL;
+
+    prev = get_current()->class;
+    set_current(get_class(class));
+    return prev;
+}
+
+int av_mem_get_stats(AVMemStats *stats, const AVClass *class)
+{
+#if CONFIG_MEMORY_STATS
+    const MemClassStats *s = class ? find_class(class) : &class_stats[MAX_CLASSES];
+
+    memset(stats, 0, sizeof(*stats));
+    if (s) {
+        stats->live_bytes = atomic_load_explicit(&s->live,      memory_order_relaxed);
+        stats->peak_bytes = atomic_load_explicit(&s->peak,      memory_order_relaxed);
+        stats->nb_allocs  = atomic_load_explicit(&s->nb_allocs, memory_order_relaxed);
+        stats->nb_frees   = atomic_load_explicit(&s->nb_frees,  memory_order_relaxed);
+    }
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+const AVClass *av_mem_stats_iterate(void **opaque)
+{
+#if CONFIG_MEMORY_STATS
+    uintptr_t i = (uintptr_t)*opaque + 1;
+
+    if (i >= atomic_load_explicit(&nb_classes, memory_order_acquire))
         return NULL;
+    *opaque = (void *)i;
+    return class_stats[i].class;
+#else
+    return NULL;
+#endif
+}
+
+static void *mem_alloc(size_t size, const MemClassStats *cur)
+{
+    void *ptr = NULL;
+
+    if (have_allocator)
+        return allocator.alloc(allocator.opaque, size, ALIGN, cur->class);
 
 #if HAVE_POSIX_MEMALIGN
     if (size) //OS X on SDK 10.6 has a broken posix_memalign implementation
@@ -119,6 +292,61 @@ void *av_malloc(size_t size)
      */
 #else
     ptr = malloc(size);
+#endif
+    return ptr;
+}
+
+static void *mem_realloc(void *ptr, size_t size, const MemClassStats *cur)
+{
+    if (have_allocator)
+        return allocator.realloc(allocator.opaque, ptr, size, cur->class);
+
+#if HAVE_ALIGNED_MALLOC
+    return _aligned_realloc(ptr, size, ALIGN);
+#else
+    return realloc(ptr, size);
+#endif
+}
+
+static void mem_free(void *ptr)
+{
+    if (have_allocator) {
+        if (ptr)
+            allocator.free(allocator.opaque, ptr);
+        return;
+    }
+
+#if HAVE_ALIGNED_MALLOC
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+void *av_malloc(size_t size)
+{
+    const MemClassStats *cur = NULL;
+    void *ptr;
+
+    if (size > max_alloc_size)
+        return NULL;
+
+    if (CONFIG_MEMORY_STATS || have_allocator)
+        cur = get_current();
+
+#if CONFIG_MEMORY_STATS
+    if (size > SIZE_MAX - HEADER_SIZE)
+        return NULL;
+    ptr = mem_alloc(size + HEADER_SIZE, cur);
+    if (ptr) {
+        MemHeader *h = ptr;
+        h->size = size;
+        h->idx  = cur - class_stats;
+        account(&class_stats[h->idx], size, 1, 0);
+        ptr = (uint8_t *)ptr + HEADER_SIZE;
+    }
+#else
+    ptr = mem_alloc(size, cur);
 #endif
     if(!ptr && !size) {
         size = 1;
@@ -133,13 +361,33 @@ void *av_malloc(size_t size)
 
 void *av_realloc(void *ptr, size_t size)
 {
+    const MemClassStats *cur = NULL;
+
     if (size > max_alloc_size)
         return NULL;
 
-#if HAVE_ALIGNED_MALLOC
-    return _aligned_realloc(ptr, size + !size, ALIGN);
+    if (CONFIG_MEMORY_STATS || have_allocator)
+        cur = get_current();
+
+#if CONFIG_MEMORY_STATS
+    {
+        /* a resized block stays accounted to the class that allocated it */
+        MemHeader *h  = ptr ? (MemHeader *)((uint8_t *)ptr - HEADER_SIZE) : NULL;
+        size_t old    = h ? h->size : 0;
+        unsigned idx  = h ? h->idx  : cur - class_stats;
+
+        if (size > SIZE_MAX - HEADER_SIZE)
+            return NULL;
+        h = mem_realloc(h, size + HEADER_SIZE, cur);
+        if (!h)
+            return NULL;
+        h->size = size;
+        h->idx  = idx;
+        account(&class_stats[idx], (intptr_t)size - (intptr_t)old, !ptr, 0);
+        return (uint8_t *)h + HEADER_SIZE;
+    }
 #else
-    return realloc(ptr, size + !size);
+    return mem_realloc(ptr, size + !size, cur);
 #endif
 }
 
@@ -218,11 +466,14 @@ int av_reallocp_array(void *ptr, size_t nmemb, size_t size)
 
 void av_free(void *ptr)
 {
-#if HAVE_ALIGNED_MALLOC
-    _aligned_free(ptr);
-#else
-    free(ptr);
+#if CONFIG_MEMORY_STATS
+    if (ptr) {
+        MemHeader *h = (MemHeader *)((uint8_t *)ptr - HEADER_SIZE);
+        account(&class_stats[h->idx], -(intptr_t)h->size, 0, 1);
+        ptr = h;
+    }
 #endif
+    mem_free(ptr);
 }
 
 void av_freep(void *arg)
@@ -692,6 +692,95 @@ static inline int av_size_mult(size_t a, size_t b, size_t *r)
  */
 void av_max_alloc(size_t max);
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup lavu_mem_tracking Allocation Tracking
+ *
+ * Accounting of the memory allocated through the @ref lavu_mem_funcs
+ * "heap management functions", and replacement of the underlying allocator.
+ *
+ * Allocations are attributed to the AVClass set with av_mem_set_class() on
+ * the allocating thread. The libraries set it to the class of the codec or
+ * filter they are running, so memory can be broken down per component.
+ *
+ * @{
+ */
+
+struct AVClass;
+
+/**
+ * Memory statistics of one class, or of the whole process.
+ */
+typedef struct AVMemStats {
+    size_t   live_bytes;    ///< currently allocated bytes
+    size_t   peak_bytes;    ///< maximum of live_bytes so far
+    uint64_t nb_allocs;     ///< number of allocations
+    uint64_t nb_frees;      ///< number of frees
+} AVMemStats;
+
+/**
+ * Replacement for the system allocator.
+ */
+typedef struct AVMemAllocator {
+    void *opaque;           ///< passed to the callbacks
+    /**
+     * Allocate size bytes aligned to align (a power of 2).
+     * @param avcl the class set on the calling thread, or NULL; it can be
+     *              used to serve each component from its own arena
+     */
+    void *(*alloc)(void *opaque, size_t size, size_t align, const struct AVClass *avcl);
+    /**
+     * Resize a block returned by alloc() or realloc(), or allocate a new one
+     * if ptr is NULL. No alignment beyond what malloc() provides is needed.
+     */
+    void *(*realloc)(void *opaque, void *ptr, size_t size, const struct AVClass *avcl);
+    void  (*free)(void *opaque, void *ptr);
+} AVMemAllocator;
+
+/**
+ * Route all the heap management functions through a custom allocator.
+ *
+ * @warning This must be called before any other libav* function, as memory
+ *          allocated before the call is released through the new allocator
+ *          too. It is not thread-safe and cannot be undone.
+ *
+ * @param allocator the allocator callbacks, copied by this function
+ */
+void av_mem_set_allocator(const AVMemAllocator *allocator);
+
+/**
+ * Set the class the calling thread's allocations are attributed to.
+ *
+ * This has no cost unless memory statistics are enabled (configure option
+ * --enable-memory-stats) or a custom allocator is installed.
+ *
+ * @return the previous class of the calling thread, to be restored by the
+ *         caller when it is done
+ */
+const struct AVClass *av_mem_set_class(const struct AVClass *avcl);
+
+/**
+ * Get the memory statistics.
+ *
+ * @param avcl the class to get the statistics of, NULL for the totals of
+ *              the process
+ * @return 0 on success, AVERROR(ENOSYS) if libavutil was built without
+ *         --enable-memory-stats
+ */
+int av_mem_get_stats(AVMemStats *stats, const struct AVClass *avcl);
+
+/**
+ * Iterate over the classes memory was attributed to.
+ *
+ * @param opaque a pointer where libavutil will store the iteration state. Must
+ *               point to NULL to start the iteration.
+ * @return the next class, or NULL when the iteration is finished
+ */
+const struct AVClass *av_mem_stats_iterate(void **opaque);
+
 /**
  * @}
  * @}
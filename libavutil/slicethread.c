@@ -18,77 +18,216 @@
 
 #include <stdatomic.h>
 #include "slicethread.h"
+#include "cpu.h"
+#include "cpu_internal.h"
 #include "mem.h"
 #include "thread.h"
 #include "avassert.h"
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
-typedef struct WorkerContext {
-    AVSliceThread   *ctx;
+/**
+ * Process-wide pool of worker threads shared by all slice threading
+ * contexts. A context being executed is queued on the pool and idle
+ * workers join it, each taking a distinct threadnr, until the context's
+ * own thread count is reached. Jobs are then pulled from the context's
+ * shared job counter, so that a worker is never tied to one context.
+ *
+ * There is one pool for the unbound contexts, and one per NUMA node the
+ * contexts were bound to, whose workers only run on the CPUs of the node.
+ */
+typedef struct WorkerPool {
+    struct WorkerPool *next;
+    int             node;           ///< NUMA node, -1 if unbound
+
+    pthread_t       *threads;
+    int             nb_threads;
+
     pthread_mutex_t mutex;
     pthread_cond_t  cond;
-    pthread_t       thread;
-    int             done;
-} WorkerContext;
+    AVSliceThread   *queue;         ///< contexts waiting for workers
+    int             finished;
+    int             refcount;       ///< number of contexts using the pool
+} WorkerPool;
+
+static pthread_mutex_t worker_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static WorkerPool *worker_pools;
 
 struct AVSliceThread {
-    WorkerContext   *workers;
+    WorkerPool      *pool;
+    AVSliceThread   *next;          ///< next context in the pool queue
+    int             queued;
+
     int             nb_threads;
     int             nb_active_threads;
     int             nb_jobs;
-
-    atomic_uint     first_job;
     atomic_uint     current_job;
-    pthread_mutex_t done_mutex;
+
+    /* protected by pool->mutex */
+    int             nb_slots;       ///< threadnr handed out so far
+    int             nb_runners;     ///< workers currently running jobs
     pthread_cond_t  done_cond;
-    int             done;
-    int             finished;
 
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
 };
 
-static int run_jobs(AVSliceThread *ctx)
+static void run_jobs(AVSliceThread *ctx, int threadnr)
 {
-    unsigned nb_jobs    = ctx->nb_jobs;
+    unsigned nb_jobs           = ctx->nb_jobs;
     unsigned nb_active_threads = ctx->nb_active_threads;
-    unsigned first_job    = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
-    unsigned current_job  = first_job;
+    unsigned current_job;
+
+    while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, current_job, threadnr, nb_jobs, nb_active_threads);
+}
+
+/* must be called with pool->mutex held */
+static void queue_remove(WorkerPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool->queue;
+
+    if (!ctx->queued)
+        return;
+    while (*p != ctx)
+        p = &(*p)->next;
+    *p          = ctx->next;
+    ctx->next   = NULL;
+    ctx->queued = 0;
+}
 
-    do {
-        ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
-    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs);
+/* must be called with pool->mutex held */
+static int take_slot(WorkerPool *pool, AVSliceThread *ctx)
+{
+    int threadnr = ctx->nb_slots++;
 
-    return current_job == nb_jobs + nb_active_threads - 1;
+    if (ctx->nb_slots == ctx->nb_active_threads)
+        queue_remove(pool, ctx);
+    return threadnr;
 }
 
 static void *attribute_align_arg thread_worker(void *v)
 {
-    WorkerContext *w = v;
-    AVSliceThread *ctx = w->ctx;
+    WorkerPool *pool = v;
 
-    pthread_mutex_lock(&w->mutex);
-    pthread_cond_signal(&w->cond);
+    if (pool->node >= 0)
+        av_cpu_numa_bind_thread(pool->node);
 
+    pthread_mutex_lock(&pool->mutex);
     while (1) {
-        w->done = 1;
-        while (w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
+        AVSliceThread *ctx;
+        int threadnr;
 
-        if (ctx->finished) {
-            pthread_mutex_unlock(&w->mutex);
-            return NULL;
-        }
+        while (!pool->queue && !pool->finished)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
 
-        if (run_jobs(ctx)) {
-            pthread_mutex_lock(&ctx->done_mutex);
-            ctx->done = 1;
+        if (pool->finished)
+            break;
+
+        ctx      = pool->queue;
+        threadnr = take_slot(pool, ctx);
+        ctx->nb_runners++;
+        /* the caller waits for the jobs to start before running main_func */
+        if (!threadnr)
             pthread_cond_signal(&ctx->done_cond);
-            pthread_mutex_unlock(&ctx->done_mutex);
+        pthread_mutex_unlock(&pool->mutex);
+
+        run_jobs(ctx, threadnr);
+
+        pthread_mutex_lock(&pool->mutex);
+        /* all the jobs have been taken, do not let other workers join */
+        queue_remove(pool, ctx);
+        if (!--ctx->nb_runners)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+static void worker_pool_free(WorkerPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->finished = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+static int worker_pool_ref(WorkerPool **ppool, int node)
+{
+    WorkerPool *pool;
+    int nb_threads, i, ret = 0;
+
+    pthread_mutex_lock(&worker_pool_mutex);
+    for (pool = worker_pools; pool; pool = pool->next) {
+        if (pool->node == node) {
+            pool->refcount++;
+            *ppool = pool;
+            goto end;
         }
     }
+
+    nb_threads = node >= 0 ? ff_numa_node_cpu_count(node) : av_cpu_count();
+    if (nb_threads < 0) {
+        ret = nb_threads;
+        goto end;
+    }
+    nb_threads = FFMAX(nb_threads, 1);
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pool->node    = node;
+    pool->threads = av_calloc(nb_threads, sizeof(*pool->threads));
+    if (!pool->threads) {
+        av_free(pool);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (i = 0; i < nb_threads; i++) {
+        if (ret = pthread_create(&pool->threads[i], NULL, thread_worker, pool)) {
+            worker_pool_free(pool);
+            ret = AVERROR(ret);
+            goto end;
+        }
+        pool->nb_threads++;
+    }
+
+    pool->refcount = 1;
+    pool->next     = worker_pools;
+    *ppool = worker_pools = pool;
+end:
+    pthread_mutex_unlock(&worker_pool_mutex);
+    return ret;
+}
+
+static void worker_pool_unref(WorkerPool *pool)
+{
+    pthread_mutex_lock(&worker_pool_mutex);
+    if (!--pool->refcount) {
+        WorkerPool **p = &worker_pools;
+        while (*p != pool)
+            p = &(*p)->next;
+        *p = pool->next;
+        worker_pool_free(pool);
+    }
+    pthread_mutex_unlock(&worker_pool_mutex);
 }
 
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
@@ -97,7 +236,7 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               int nb_threads)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
+    int ret;
 
     av_assert0(nb_threads >= 0);
     if (!nb_threads) {
@@ -108,17 +247,13 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
             nb_threads = 1;
     }
 
-    nb_workers = nb_threads;
-    if (!main_func)
-        nb_workers--;
-
     *pctx = ctx = av_mallocz(sizeof(*ctx));
     if (!ctx)
         return AVERROR(ENOMEM);
 
-    if (nb_workers && !(ctx->workers = av_calloc(nb_workers, sizeof(*ctx->workers)))) {
+    if ((ret = worker_pool_ref(&ctx->pool, -1)) < 0) {
         av_freep(pctx);
-        return AVERROR(ENOMEM);
+        return ret;
     }
 
     ctx->priv        = priv;
@@ -127,107 +262,95 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     ctx->nb_threads  = nb_threads;
     ctx->nb_active_threads = 0;
     ctx->nb_jobs     = 0;
-    ctx->finished    = 0;
 
-    atomic_init(&ctx->first_job, 0);
     atomic_init(&ctx->current_job, 0);
-    pthread_mutex_init(&ctx->done_mutex, NULL);
     pthread_cond_init(&ctx->done_cond, NULL);
-    ctx->done        = 0;
-
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        int ret;
-        w->ctx = ctx;
-        pthread_mutex_init(&w->mutex, NULL);
-        pthread_cond_init(&w->cond, NULL);
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-
-        if (ret = pthread_create(&w->thread, NULL, thread_worker, w)) {
-            ctx->nb_threads = main_func ? i : i + 1;
-            pthread_mutex_unlock(&w->mutex);
-            pthread_cond_destroy(&w->cond);
-            pthread_mutex_destroy(&w->mutex);
-            avpriv_slicethread_free(pctx);
-            return AVERROR(ret);
-        }
-
-        while (!w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
-        pthread_mutex_unlock(&w->mutex);
-    }
 
     return nb_threads;
 }
 
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
-    int nb_workers, i, is_last = 0;
+    WorkerPool *pool = ctx->pool;
+    int run_main = ctx->main_func && execute_main;
+    int threadnr = 0, nb_wake;
 
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
-    atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
-    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
-    nb_workers             = ctx->nb_active_threads;
-    if (!ctx->main_func || !execute_main)
-        nb_workers--;
-
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->mutex);
+    /* the calling thread takes the first slot unless it runs main_func */
+    ctx->nb_slots = !run_main;
+    nb_wake       = ctx->nb_active_threads - ctx->nb_slots;
+    if (nb_wake > 0) {
+        AVSliceThread **p = &pool->queue;
+        while (*p)
+            p = &(*p)->next;
+        *p          = ctx;
+        ctx->queued = 1;
+
+        if (nb_wake >= pool->nb_threads)
+            pthread_cond_broadcast(&pool->cond);
+        else
+            while (nb_wake--)
+                pthread_cond_signal(&pool->cond);
+
+        /* main_func may wait for the progress of the jobs (e.g. the vp9
+         * loop filter), so a worker must be running them before it is
+         * called, as the pool is shared and its workers can be busy */
+        while (run_main && !ctx->nb_slots)
+            pthread_cond_wait(&ctx->done_cond, &pool->mutex);
     }
+    pthread_mutex_unlock(&pool->mutex);
 
-    if (ctx->main_func && execute_main)
+    if (run_main) {
         ctx->main_func(ctx->priv);
-    else
-        is_last = run_jobs(ctx);
-
-    if (!is_last) {
-        pthread_mutex_lock(&ctx->done_mutex);
-        while (!ctx->done)
-            pthread_cond_wait(&ctx->done_cond, &ctx->done_mutex);
-        ctx->done = 0;
-        pthread_mutex_unlock(&ctx->done_mutex);
+
+        /* help with the remaining jobs if not all the slots were taken */
+        pthread_mutex_lock(&pool->mutex);
+        threadnr = ctx->nb_slots < ctx->nb_active_threads ? take_slot(pool, ctx) : -1;
+        pthread_mutex_unlock(&pool->mutex);
     }
+
+    if (threadnr >= 0)
+        run_jobs(ctx, threadnr);
+
+    pthread_mutex_lock(&pool->mutex);
+    queue_remove(pool, ctx);
+    while (ctx->nb_runners)
+        pthread_cond_wait(&ctx->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int avpriv_slicethread_set_numa_node(AVSliceThread *ctx, int node)
+{
+    WorkerPool *pool;
+    int ret;
+
+    if (node < -1)
+        return AVERROR(EINVAL);
+    if (ctx->pool->node == node)
+        return 0;
+    if ((ret = worker_pool_ref(&pool, node)) < 0)
+        return ret;
+
+    worker_pool_unref(ctx->pool);
+    ctx->pool = pool;
+    return 0;
 }
 
 void avpriv_slicethread_free(AVSliceThread **pctx)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
 
     if (!pctx || !*pctx)
         return;
 
     ctx = *pctx;
-    nb_workers = ctx->nb_threads;
-    if (!ctx->main_func)
-        nb_workers--;
-
-    ctx->finished = 1;
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
-    }
-
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_join(w->thread, NULL);
-        pthread_cond_destroy(&w->cond);
-        pthread_mutex_destroy(&w->mutex);
-    }
-
     pthread_cond_destroy(&ctx->done_cond);
-    pthread_mutex_destroy(&ctx->done_mutex);
-    av_freep(&ctx->workers);
+    worker_pool_unref(ctx->pool);
     av_freep(pctx);
 }
 
@@ -247,6 +370,12 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(0);
 }
 
+int avpriv_slicethread_set_numa_node(AVSliceThread *ctx, int node)
+{
+    av_assert0(0);
+    return AVERROR(EINVAL);
+}
+
 void avpriv_slicethread_free(AVSliceThread **pctx)
 {
     av_assert0(!pctx || !*pctx);
@@ -23,11 +23,14 @@ typedef struct AVSliceThread AVSliceThread;
 
 /**
  * Create slice threading context.
+ * The jobs are run by the calling thread and by a worker pool shared by
+ * all the contexts of the process, sized after the number of CPUs.
  * @param pctx slice threading context returned here
  * @param priv private pointer to be passed to callback function
  * @param worker_func callback function to be executed
  * @param main_func special callback function, called from main thread, may be NULL
- * @param nb_threads number of threads, 0 for automatic, must be >= 0
+ * @param nb_threads maximum number of threads running the jobs of this
+ *                   context at once, 0 for automatic, must be >= 0
  * @return return number of threads or negative AVERROR on failure
  */
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
@@ -43,6 +46,16 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Run the jobs of a context on workers bound to the CPUs of a NUMA node.
+ * Must not be called while the context is being executed.
+ * @param ctx slice threading context
+ * @param node the NUMA node, or -1 to use the unbound workers again
+ * @return 0 on success, negative AVERROR on failure, in which case the
+ *         context is left unchanged
+ */
+int avpriv_slicethread_set_numa_node(AVSliceThread *ctx, int node);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
@@ -49,6 +49,65 @@ static void test_separators(const AVDictionary *m, const char pair, const char v
     av_dict_free(&dict);
 }
 
+static const AVDictionaryEntry *linear_get(const AVDictionary *m, const char *key,
+                                           int flags)
+{
+    for (int i = 0; i < m->count; i++) {
+        const char *s = m->elems[i].key;
+        if (flags & AV_DICT_MATCH_CASE ? !strcmp(s, key) : !av_strcasecmp(s, key))
+            return &m->elems[i];
+    }
+    return NULL;
+}
+
+static void test_hash(void)
+{
+    AVDictionary *dict = NULL, *copy = NULL;
+    AVDictionaryEntry *e;
+    char key[16];
+    int mismatches = 0;
+
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "key%d", i % 60);
+        av_dict_set_int(&dict, key, i, i & 1 ? AV_DICT_MULTIKEY : 0);
+        if (i % 7 == 0) {
+            snprintf(key, sizeof(key), "KEY%d", i / 2);
+            av_dict_set(&dict, key, NULL, 0);
+        }
+    }
+    av_dict_set(&dict, "Key5", "case", AV_DICT_MATCH_CASE);
+    printf("count %d, indexed %d\n", av_dict_count(dict), !!dict->hash);
+    for (int i = 0; i < 70; i++) {
+        for (int flags = 0; flags <= AV_DICT_MATCH_CASE; flags++) {
+            snprintf(key, sizeof(key), i & 1 ? "key%d" : "Key%d", i);
+            mismatches += av_dict_get(dict, key, NULL, flags) != linear_get(dict, key, flags);
+        }
+    }
+    printf("mismatches %d\n", mismatches);
+    printf("key5 %s, Key5 %s\n", av_dict_get(dict, "key5", NULL, 0)->value,
+           av_dict_get(dict, "Key5", NULL, AV_DICT_MATCH_CASE)->value);
+
+    av_dict_copy(&copy, dict, AV_DICT_MULTIKEY);
+    printf("copy count %d, indexed %d\n", av_dict_count(copy), !!copy->hash);
+    /* modifying an entry of the copy in place must not touch the source */
+    e = av_dict_get(copy, "key7", NULL, 0);
+    av_freep(&e->value);
+    e->value = av_strdup("changed");
+    av_dict_set(&copy, "key8", "set", 0);
+    printf("key7 %s %s, key8 %s %s\n",
+           av_dict_get(dict, "key7", NULL, 0)->value,
+           av_dict_get(copy, "key7", NULL, 0)->value,
+           av_dict_get(dict, "key8", NULL, 0)->value,
+           av_dict_get(copy, "key8", NULL, 0)->value);
+    av_dict_free(&copy);
+
+    /* merging the duplicate keys */
+    av_dict_copy(&copy, dict, 0);
+    printf("count %d\n", av_dict_count(copy));
+    av_dict_free(&copy);
+    av_dict_free(&dict);
+}
+
 int main(void)
 {
     AVDictionary *dict = NULL;
@@ -132,5 +191,8 @@ int main(void)
     printf("%s\n", e->value);
     av_dict_free(&dict);
 
+    printf("\nTesting hashed lookups and copies\n");
+    test_hash();
+
     return 0;
 }
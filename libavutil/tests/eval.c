@@ -168,6 +168,30 @@ int main(int argc, char **argv)
     if (ret < 0)
         printf("av_expr_parse_and_eval failed\n");
 
+    for (expr = exprs; *expr; expr++) {
+        double pis[16], res[16];
+        const double *var_values[] = { pis, NULL, NULL };
+        double values[3] = { 0, M_E, 0 };
+        AVExpr *e = NULL, *e2 = NULL;
+
+        if (av_expr_parse(&e,  *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0 ||
+            av_expr_parse(&e2, *expr, const_names, NULL, NULL, NULL, NULL, 0, NULL) < 0) {
+            av_expr_free(e);
+            continue;
+        }
+        for (i = 0; i < 16; i++)
+            pis[i] = M_PI * (i - 8);
+        av_expr_eval_batch(e, values, var_values, res, 16, NULL);
+        for (i = 0; i < 16; i++) {
+            values[0] = pis[i];
+            d = av_expr_eval(e2, values, NULL);
+            if (memcmp(&d, &res[i], sizeof(d)) && !(isnan(d) && isnan(res[i])))
+                printf("'%s' batch mismatch at %d: %f != %f\n", *expr, i, res[i], d);
+        }
+        av_expr_free(e);
+        av_expr_free(e2);
+    }
+
     if (argc > 1 && !strcmp(argv[1], "-t")) {
         for (i = 0; i < 1050; i++) {
             START_TIMER;
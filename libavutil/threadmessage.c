@@ -18,6 +18,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
@@ -28,10 +31,29 @@ struct AVThreadMessageQueue {
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /*
+     * Lock-free ring, used instead of the fifo with
+     * AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER. Positions are free-running
+     * counters: senders claim a position by advancing tail, then publish
+     * the message by setting the seq of its cell to position + 1. The
+     * receiver advances head once the message has been read. The lock and
+     * the condition variables are only used to sleep when the ring is
+     * empty or full.
+     */
+    unsigned flags;
+    unsigned nelem;
+    unsigned mask;
+    uint8_t *ring;
+    atomic_uint *seq;
+    atomic_intptr_t tail;   ///< unsigned position, intptr_t for the CAS
+    atomic_uint head;
+    atomic_int recv_waiting;
+    atomic_int nb_send_waiting;
 #else
     int dummy;
 #endif
@@ -40,6 +62,44 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+#if HAVE_THREADS
+static int ring_alloc(AVThreadMessageQueue *mq, unsigned nelem, unsigned elsize)
+{
+    unsigned size = 1, i;
+
+    while (size < nelem)
+        size <<= 1;
+    if (size > INT_MAX / elsize)
+        return AVERROR(EINVAL);
+
+    mq->ring = av_malloc_array(size, elsize);
+    mq->seq  = av_malloc_array(size, sizeof(*mq->seq));
+    if (!mq->ring || !mq->seq) {
+        av_freep(&mq->ring);
+        av_freep(&mq->seq);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < size; i++)
+        atomic_init(&mq->seq[i], 0);
+
+    mq->nelem = nelem;
+    mq->mask  = size - 1;
+    atomic_init(&mq->tail, 0);
+    atomic_init(&mq->head, 0);
+    atomic_init(&mq->recv_waiting, 0);
+    atomic_init(&mq->nb_send_waiting, 0);
+    return 0;
+}
+#endif /* HAVE_THREADS */
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
@@ -49,6 +109,8 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
+    atomic_init(&rmq->err_send, 0);
+    atomic_init(&rmq->err_recv, 0);
     if ((ret = pthread_mutex_init(&rmq->lock, NULL))) {
         av_free(rmq);
         return AVERROR(ret);
@@ -64,14 +126,19 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER)
+        ret = ring_alloc(rmq, nelem, elsize);
+    else if (!(rmq->fifo = av_fifo_alloc(elsize * nelem)))
+        ret = AVERROR(ENOMEM);
+    if (ret < 0) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
-        return AVERROR(ENOMEM);
+        return ret;
     }
     rmq->elsize = elsize;
+    rmq->flags  = flags;
     *mq = rmq;
     return 0;
 #else
@@ -94,6 +161,8 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
+        av_freep(&(*mq)->seq);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -106,6 +175,11 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+    if (mq->ring) {
+        unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+        return FFMIN(tail - head, mq->nelem);
+    }
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -121,13 +195,16 @@ static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
                                                void *msg,
                                                unsigned flags)
 {
-    while (!mq->err_send && av_fifo_space(mq->fifo) < mq->elsize) {
+    int err;
+
+    while (!(err = atomic_load_explicit(&mq->err_send, memory_order_relaxed)) &&
+           av_fifo_space(mq->fifo) < mq->elsize) {
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
         pthread_cond_wait(&mq->cond_send, &mq->lock);
     }
-    if (mq->err_send)
-        return mq->err_send;
+    if (err)
+        return err;
     av_fifo_generic_write(mq->fifo, msg, mq->elsize, NULL);
     /* one message is sent, signal one receiver */
     pthread_cond_signal(&mq->cond_recv);
@@ -138,19 +215,128 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
                                                void *msg,
                                                unsigned flags)
 {
-    while (!mq->err_recv && av_fifo_size(mq->fifo) < mq->elsize) {
+    while (!atomic_load_explicit(&mq->err_recv, memory_order_relaxed) &&
+           av_fifo_size(mq->fifo) < mq->elsize) {
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
         pthread_cond_wait(&mq->cond_recv, &mq->lock);
     }
     if (av_fifo_size(mq->fifo) < mq->elsize)
-        return mq->err_recv;
+        return atomic_load_explicit(&mq->err_recv, memory_order_relaxed);
     av_fifo_generic_read(mq->fifo, msg, mq->elsize, NULL);
     /* one message space appeared, signal one sender */
     pthread_cond_signal(&mq->cond_send);
     return 0;
 }
 
+static unsigned ring_used(AVThreadMessageQueue *mq)
+{
+    unsigned tail = atomic_load(&mq->tail);
+    unsigned head = atomic_load(&mq->head);
+    return tail - head;
+}
+
+/* the message at position pos has been published */
+static int ring_ready(AVThreadMessageQueue *mq, unsigned pos)
+{
+    return atomic_load(&mq->seq[pos & mq->mask]) == pos + 1;
+}
+
+/*
+ * The sleeping side announces itself before checking the ring again, and
+ * the waking side checks for sleepers after updating the ring, both with
+ * sequentially consistent operations: either the sleeper sees the update
+ * or the waker sees the sleeper and signals it under the lock.
+ */
+static int ring_send(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    intptr_t cur;
+    unsigned pos;
+    int err;
+
+    while (1) {
+        if ((err = atomic_load_explicit(&mq->err_send, memory_order_relaxed)))
+            return err;
+
+        cur = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+        pos = cur;
+        if (pos - atomic_load_explicit(&mq->head, memory_order_acquire) < mq->nelem) {
+            if (mq->flags & AV_THREAD_MESSAGE_QUEUE_SINGLE_PRODUCER) {
+                atomic_store_explicit(&mq->tail, (intptr_t)(pos + 1), memory_order_relaxed);
+                break;
+            }
+            if (atomic_compare_exchange_weak_explicit(&mq->tail, &cur, (intptr_t)(pos + 1),
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+            continue;
+        }
+
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+
+        pthread_mutex_lock(&mq->lock);
+        atomic_fetch_add(&mq->nb_send_waiting, 1);
+        while (!atomic_load_explicit(&mq->err_send, memory_order_relaxed) &&
+               ring_used(mq) >= mq->nelem)
+            pthread_cond_wait(&mq->cond_send, &mq->lock);
+        atomic_fetch_sub(&mq->nb_send_waiting, 1);
+        pthread_mutex_unlock(&mq->lock);
+    }
+
+    memcpy(mq->ring + (size_t)(pos & mq->mask) * mq->elsize, msg, mq->elsize);
+    atomic_store(&mq->seq[pos & mq->mask], pos + 1);
+
+    if (atomic_load(&mq->recv_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(&mq->cond_recv);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    return 0;
+}
+
+/* must only be called by the receiving thread */
+static void ring_consumed(AVThreadMessageQueue *mq, unsigned head)
+{
+    atomic_store(&mq->head, head);
+
+    if (atomic_load(&mq->nb_send_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+static int ring_recv(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+
+    if (!ring_ready(mq, head)) {
+        int err = 0;
+
+        if ((err = atomic_load_explicit(&mq->err_recv, memory_order_relaxed)) ||
+            (flags & AV_THREAD_MESSAGE_NONBLOCK)) {
+            /* a message may have been published along with the error */
+            if (!ring_ready(mq, head))
+                return err ? err : AVERROR(EAGAIN);
+        } else {
+            pthread_mutex_lock(&mq->lock);
+            atomic_store(&mq->recv_waiting, 1);
+            while (!ring_ready(mq, head) &&
+                   !(err = atomic_load_explicit(&mq->err_recv, memory_order_relaxed)))
+                pthread_cond_wait(&mq->cond_recv, &mq->lock);
+            atomic_store(&mq->recv_waiting, 0);
+            pthread_mutex_unlock(&mq->lock);
+            if (!ring_ready(mq, head))
+                return err;
+        }
+    }
+
+    memcpy(msg, mq->ring + (size_t)(head & mq->mask) * mq->elsize, mq->elsize);
+    ring_consumed(mq, head + 1);
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -160,6 +346,9 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_send(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +365,9 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_recv(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -190,7 +382,7 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_send = err;
+    atomic_store(&mq->err_send, err);
     pthread_cond_broadcast(&mq->cond_send);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -201,7 +393,7 @@ void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_recv = err;
+    atomic_store(&mq->err_recv, err);
     pthread_cond_broadcast(&mq->cond_recv);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -221,6 +413,16 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     int used, off;
     void *free_func = mq->free_func;
 
+    if (mq->ring) {
+        unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+
+        for (; ring_ready(mq, head); head++)
+            if (free_func)
+                mq->free_func(mq->ring + (size_t)(head & mq->mask) * mq->elsize);
+        ring_consumed(mq, head);
+        return;
+    }
+
     pthread_mutex_lock(&mq->lock);
     used = av_fifo_size(mq->fifo);
     if (free_func)
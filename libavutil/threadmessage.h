@@ -32,6 +32,24 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+typedef enum AVThreadMessageQueueFlags {
+
+    /**
+     * Only one thread at a time receives from or flushes the queue.
+     * The queue is then implemented as a lock-free ring buffer, and the
+     * threads only take a lock to sleep when it is empty or full.
+     * av_thread_message_flush() must be called from the receiving thread.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER = 1 << 0,
+
+    /**
+     * Only one thread at a time sends to the queue. Only meaningful
+     * together with AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SINGLE_PRODUCER = 1 << 1,
+
+} AVThreadMessageQueueFlags;
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +63,20 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue for a given usage pattern.
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   a combination of AVThreadMessageQueueFlags
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -0,0 +1,205 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _DEFAULT_SOURCE /* for syscall() */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#endif
+
+#include "avutil.h"
+#include "error.h"
+#include "mem.h"
+#include "thread.h"
+#include "time.h"
+#include "trace.h"
+#include "trace_internal.h"
+
+typedef struct TraceEvent {
+    const char *cat;
+    const char *name;
+    int64_t ts;
+    int64_t pts;
+    int stream_index;
+    int tid;
+    char ph;
+} TraceEvent;
+
+static atomic_int trace_enabled = ATOMIC_VAR_INIT(0);
+static AVMutex trace_lock = AV_MUTEX_INITIALIZER;
+static TraceEvent *trace_events;
+static unsigned nb_trace_events, trace_events_size;
+static char *trace_filename;
+static int64_t trace_start_time;
+
+static int trace_tid(void)
+{
+#if defined(__linux__) && defined(SYS_gettid)
+    return syscall(SYS_gettid);
+#elif HAVE_PTHREADS
+    return (int)(intptr_t)pthread_self();
+#else
+    return 0;
+#endif
+}
+
+static void trace_add(char ph, const char *cat, const char *name,
+                      int64_t pts, int stream_index)
+{
+    TraceEvent *ev;
+    int64_t ts;
+    int tid;
+
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed))
+        return;
+
+    ts  = av_gettime_relative();
+    tid = trace_tid();
+
+    ff_mutex_lock(&trace_lock);
+    if (trace_events) {
+        if (nb_trace_events >= trace_events_size) {
+            unsigned size = FFMAX(2 * trace_events_size, 4096);
+            TraceEvent *events = av_realloc_array(trace_events, size, sizeof(*events));
+            if (!events)
+                goto end;
+            trace_events      = events;
+            trace_events_size = size;
+        }
+        ev = &trace_events[nb_trace_events++];
+        ev->cat          = cat;
+        ev->name         = name;
+        ev->ts           = ts - trace_start_time;
+        ev->pts          = pts;
+        ev->stream_index = stream_index;
+        ev->tid          = tid;
+        ev->ph           = ph;
+    }
+end:
+    ff_mutex_unlock(&trace_lock);
+}
+
+void avpriv_trace_begin(const char *cat, const char *name,
+                        int64_t pts, int stream_index)
+{
+#if HAVE_SYS_SDT_H
+    DTRACE_PROBE4(ffmpeg, span_begin, cat, name, pts, stream_index);
+#endif
+    trace_add('B', cat, name, pts, stream_index);
+}
+
+void avpriv_trace_end(const char *cat, const char *name,
+                      int64_t pts, int stream_index)
+{
+#if HAVE_SYS_SDT_H
+    DTRACE_PROBE4(ffmpeg, span_end, cat, name, pts, stream_index);
+#endif
+    trace_add('E', cat, name, pts, stream_index);
+}
+
+int av_trace_start(const char *filename, int flags)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&trace_lock);
+    if (trace_events) {
+        ret = AVERROR(EBUSY);
+        goto end;
+    }
+    trace_filename = av_strdup(filename);
+    trace_events   = av_malloc_array(4096, sizeof(*trace_events));
+    if (!trace_filename || !trace_events) {
+        av_freep(&trace_filename);
+        av_freep(&trace_events);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    trace_events_size = 4096;
+    nb_trace_events   = 0;
+    trace_start_time  = av_gettime_relative();
+    atomic_store_explicit(&trace_enabled, 1, memory_order_relaxed);
+end:
+    ff_mutex_unlock(&trace_lock);
+    return ret;
+}
+
+int av_trace_stop(void)
+{
+    TraceEvent *events;
+    unsigned i, nb_events;
+    char *filename;
+    int pid = 0;
+    FILE *f;
+    int ret = 0;
+
+    ff_mutex_lock(&trace_lock);
+    atomic_store_explicit(&trace_enabled, 0, memory_order_relaxed);
+    events    = trace_events;
+    nb_events = nb_trace_events;
+    filename  = trace_filename;
+    trace_events      = NULL;
+    trace_filename    = NULL;
+    nb_trace_events   = 0;
+    trace_events_size = 0;
+    ff_mutex_unlock(&trace_lock);
+
+    if (!events)
+        return 0;
+
+#if HAVE_UNISTD_H
+    pid = getpid();
+#endif
+
+    f = av_fopen_utf8(filename, "w");
+    if (!f) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (i = 0; i < nb_events; i++) {
+        const TraceEvent *ev = &events[i];
+        fprintf(f, "{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRId64
+                ",\"pid\":%d,\"tid\":%d,\"args\":{",
+                ev->cat, ev->name, ev->ph, ev->ts, pid, ev->tid);
+        if (ev->pts != AV_NOPTS_VALUE)
+            fprintf(f, "\"pts\":%"PRId64"%s", ev->pts,
+                    ev->stream_index >= 0 ? "," : "");
+        if (ev->stream_index >= 0)
+            fprintf(f, "\"stream\":%d", ev->stream_index);
+        fprintf(f, "}}%s\n", i + 1 < nb_events ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    if (fclose(f))
+        ret = AVERROR(errno);
+
+end:
+    av_free(events);
+    av_free(filename);
+    return ret;
+}
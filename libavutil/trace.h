@@ -0,0 +1,69 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_TRACE_H
+#define AVUTIL_TRACE_H
+
+/**
+ * @file
+ * @ingroup lavu_trace
+ * Runtime tracing of the processing steps of the libraries.
+ */
+
+/**
+ * @defgroup lavu_trace Tracing
+ * @ingroup lavu_misc
+ *
+ * The libraries mark the main processing steps (packet read, decode, filter
+ * activation, encode, mux write) with begin/end spans carrying the
+ * timestamp and stream index of the data they work on, and the thread they
+ * run on.
+ *
+ * The spans are always exposed as the ffmpeg:span_begin and ffmpeg:span_end
+ * USDT probes when the libraries are built with sys/sdt.h; they cost a nop
+ * each unless a tracer is attached. Recording them for the Chrome trace
+ * JSON export is enabled with av_trace_start(); when disabled, a span costs
+ * a function call and an atomic load.
+ *
+ * @{
+ */
+
+/**
+ * Start recording the spans of all threads.
+ *
+ * @param filename the file the spans are written to by av_trace_stop(), in
+ *                 the Chrome trace event format (chrome://tracing, Perfetto)
+ * @param flags    currently unused, must be 0
+ * @return 0 on success, a negative AVERROR code if recording is already
+ *         started or on error
+ */
+int av_trace_start(const char *filename, int flags);
+
+/**
+ * Stop recording and write the recorded spans out.
+ *
+ * @return 0 on success or if recording was not started, a negative AVERROR
+ *         code if the spans could not be written
+ */
+int av_trace_stop(void);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_TRACE_H */
@@ -0,0 +1,39 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_TRACE_INTERNAL_H
+#define AVUTIL_TRACE_INTERNAL_H
+
+#include <stdint.h>
+
+/**
+ * Mark the beginning or the end of a span.
+ *
+ * @param cat  the component, "lavf", "lavc", "lavfi", ...
+ * @param name the step; both strings must stay valid until av_trace_stop()
+ *             and not need JSON escaping, string literals or the names of
+ *             the codecs and filters are fine
+ * @param pts  the timestamp of the data processed, or AV_NOPTS_VALUE
+ * @param stream_index the index of the stream processed, or -1
+ */
+void avpriv_trace_begin(const char *cat, const char *name,
+                        int64_t pts, int stream_index);
+void avpriv_trace_end(const char *cat, const char *name,
+                      int64_t pts, int stream_index);
+
+#endif /* AVUTIL_TRACE_INTERNAL_H */
@@ -27,8 +27,12 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/slicethread.h"
 #include "resample.h"
 
+/* below this number of filter taps per call, threading costs more than it saves */
+#define MIN_THREADED_TAPS (1 << 16)
+
 static inline double eval_poly(const double *coeff, int size, double x) {
     double sum = coeff[size-1];
     int i;
@@ -280,6 +284,7 @@ static void resample_free(ResampleContext **cc){
     ResampleContext *c = *cc;
     if(!c)
         return;
+    avpriv_slicethread_free(&c->slicethread);
     av_freep(&c->filter_bank);
     av_freep(cc);
 }
@@ -316,6 +321,8 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
             return NULL;
 
         c->format= format;
+        c->nb_threads   = 1;
+        c->thread_count = 1;
 
         c->felem_size= av_get_bytes_per_sample(c->format);
 
@@ -449,6 +456,63 @@ static int set_compensation(ResampleContext *c, int sample_delta, int compensati
     return 0;
 }
 
+typedef struct ResampleThreadArg {
+    int (*resample_func)(struct ResampleContext *c, void *dst,
+                         const void *src, int n, int update_ctx);
+    AudioData *dst, *src;
+    int dst_size;
+    int need_emms;
+    // state of the context after the last channel
+    int consumed, index, frac;
+} ResampleThreadArg;
+
+static void resample_worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ResampleContext *c = priv;
+    ResampleThreadArg *arg = c->thread_arg;
+    int ch_count = arg->dst->ch_count;
+    int start = (ch_count *  jobnr     ) / nb_jobs;
+    int end   = (ch_count * (jobnr + 1)) / nb_jobs;
+
+    for (int i = start; i < end; i++) {
+        if (i + 1 == ch_count) {
+            // the other jobs still read the context, update a copy of it
+            ResampleContext tmp = *c;
+            arg->consumed = arg->resample_func(&tmp, arg->dst->ch[i], arg->src->ch[i], arg->dst_size, 1);
+            arg->index    = tmp.index;
+            arg->frac     = tmp.frac;
+        } else
+            arg->resample_func(c, arg->dst->ch[i], arg->src->ch[i], arg->dst_size, 0);
+    }
+
+    if (arg->need_emms)
+        emms_c();
+}
+
+static int set_threads(ResampleContext *c, int nb_threads)
+{
+    int ret;
+
+    if (c->nb_threads == nb_threads)
+        return 0;
+
+    avpriv_slicethread_free(&c->slicethread);
+    c->nb_threads   = nb_threads;
+    c->thread_count = 1;
+    if (nb_threads == 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, resample_worker, NULL, nb_threads);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    if (ret < 0)
+        return ret;
+    c->thread_count = ret;
+    if (ret == 1)
+        avpriv_slicethread_free(&c->slicethread);
+    return 0;
+}
+
 static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size, int *consumed){
     int i;
     int av_unused mm_flags = av_get_cpu_flags();
@@ -494,8 +558,25 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
              * when frac and dst_incr_mod are zero */
             resample_func = (c->linear && (c->frac || c->dst_incr_mod)) ?
                             c->dsp.resample_linear : c->dsp.resample_common;
-            for (i = 0; i < dst->ch_count; i++)
-                *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            if (c->slicethread && dst->ch_count > 1 &&
+                (int64_t)dst_size * c->filter_length * dst->ch_count >= MIN_THREADED_TAPS) {
+                ResampleThreadArg arg = {
+                    .resample_func = resample_func,
+                    .dst           = dst,
+                    .src           = src,
+                    .dst_size      = dst_size,
+                    .need_emms     = need_emms,
+                };
+                c->thread_arg = &arg;
+                avpriv_slicethread_execute(c->slicethread, FFMIN(dst->ch_count, c->thread_count), 0);
+                c->thread_arg = NULL;
+                *consumed = arg.consumed;
+                c->index  = arg.index;
+                c->frac   = arg.frac;
+            } else {
+                for (i = 0; i < dst->ch_count; i++)
+                    *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            }
         }
     }
 
@@ -619,4 +700,5 @@ struct Resampler const swri_resampler={
   get_delay,
   invert_initial_buffer,
   get_out_samples,
+  set_threads,
 };
@@ -24,6 +24,7 @@
 
 #include "libavutil/log.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/slicethread.h"
 
 #include "swresample_internal.h"
 
@@ -58,6 +59,12 @@ typedef struct ResampleContext {
         int (*resample_linear)(struct ResampleContext *c, void *dst,
                                const void *src, int n, int update_ctx);
     } dsp;
+
+    // slice threads resampling the channels in parallel, NULL when single threaded
+    AVSliceThread *slicethread;
+    int nb_threads;                    ///< requested number of threads, 0 for auto
+    int thread_count;                  ///< number of threads of slicethread
+    struct ResampleThreadArg *thread_arg;
 } ResampleContext;
 
 void swri_resample_dsp_init(ResampleContext *c);
@@ -277,6 +277,13 @@ av_cold int swr_init(struct SwrContext *s){
             av_log(s, AV_LOG_ERROR, "Failed to initialize resampler\n");
             return AVERROR(ENOMEM);
         }
+        if (s->resampler->set_threads) {
+            ret = s->resampler->set_threads(s->resample, s->nb_threads);
+            if (ret < 0) {
+                av_log(s, AV_LOG_ERROR, "Failed to create the resampling threads\n");
+                goto fail;
+            }
+        }
     }else
         s->resampler->free(&s->resample);
     if(    s->int_sample_fmt != AV_SAMPLE_FMT_S16P
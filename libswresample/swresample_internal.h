@@ -77,6 +77,7 @@ typedef int     (* set_compensation_func)(struct ResampleContext *c, int sample_
 typedef int64_t (* get_delay_func)(struct SwrContext *s, int64_t base);
 typedef int     (* invert_initial_buffer_func)(struct ResampleContext *c, AudioData *dst, const AudioData *src, int src_size, int *dst_idx, int *dst_count);
 typedef int64_t (* get_out_samples_func)(struct SwrContext *s, int in_samples);
+typedef int     (* set_threads_func)(struct ResampleContext *c, int nb_threads);
 
 struct Resampler {
   resample_init_func            init;
@@ -87,6 +88,7 @@ struct Resampler {
   get_delay_func                get_delay;
   invert_initial_buffer_func    invert_initial_buffer;
   get_out_samples_func          get_out_samples;
+  set_threads_func              set_threads;       ///< may be NULL if the resampler is single threaded
 };
 
 extern struct Resampler const swri_resampler;
@@ -133,6 +135,7 @@ struct SwrContext {
     double kaiser_beta;                                /**< swr beta value for Kaiser window (only applicable if filter_type == AV_FILTER_TYPE_KAISER) */
     double precision;                               /**< soxr resampling precision (in bits) */
     int cheby;                                      /**< soxr: if 1 then passband rolloff will be none (Chebyshev) & irrational ratio approximation precision will be higher */
+    int nb_threads;                                 /**< swr: number of threads resampling the channels in parallel, 0 for auto */
 
     float min_compensation;                         ///< swr minimum below which no compensation will happen
     float min_hard_compensation;                    ///< swr minimum below which no silence inject / sample drop will happen
@@ -31,6 +31,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/ppc/util_altivec.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
@@ -290,6 +291,7 @@ typedef struct SwsContext {
      * sws_scale() wrapper so they can be freely modified here.
      */
     SwsFunc swscale;
+    SwsFunc yuv420_to_rgb;        ///< Planar YUV 4:2:0 -> RGB converter used by the NV12 -> RGB wrapper.
     int srcW;                     ///< Width  of source      luma/alpha planes.
     int srcH;                     ///< Height of source      luma/alpha planes.
     int dstH;                     ///< Height of destination luma/alpha planes.
@@ -323,6 +325,18 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* With slice threading, the output picture is split into horizontal
+     * bands which are scaled in parallel, each by its own child context.
+     */
+    int nb_threads;
+    AVSliceThread *slicethread;
+    struct SwsContext **slice_ctx;
+    int nb_slice_ctx;
+    const uint8_t *slice_src[4];
+    int slice_srcStride[4];
+    uint8_t *slice_dst[4];
+    int slice_dstStride[4];
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -864,6 +878,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Slice threading worker, scales one horizontal band of the output
+ * picture set up in the slice_* fields of the parent context priv.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -323,6 +323,251 @@ static int planar8ToP01xleWrapper(SwsContext *c, const uint8_t *src[],
 
 #undef output_pixel
 
+static const uint8_t zero_dither[8] = { 0 };
+
+static void ditherLineTo8(uint8_t *dst, const uint16_t *src, int length,
+                          unsigned src_shift, unsigned shift, int shiftonly,
+                          const uint8_t *dither)
+{
+    int j;
+
+    if (shiftonly) {
+        for (j = 0; j < length; j++) {
+            unsigned tmp = ((src[j] >> src_shift) + dither[j & 7]) >> shift;
+            dst[j] = tmp - (tmp >> 8);
+        }
+    } else {
+        for (j = 0; j < length; j++) {
+            unsigned tmp = src[j] >> src_shift;
+            dst[j] = (tmp - (tmp >> 8) + dither[j & 7]) >> shift;
+        }
+    }
+}
+
+static void ditherInterleaveTo8(uint8_t *dst, const uint16_t *src1,
+                                const uint16_t *src2, int length, int step,
+                                unsigned src_shift, unsigned shift,
+                                const uint8_t *dither)
+{
+    int j;
+
+    for (j = 0; j < length; j++) {
+        unsigned tmp1 = ((src1[step * j] >> src_shift) + dither[j & 7]) >> shift;
+        unsigned tmp2 = ((src2[step * j] >> src_shift) + dither[j & 7]) >> shift;
+        dst[2 * j + 0] = tmp1 - (tmp1 >> 8);
+        dst[2 * j + 1] = tmp2 - (tmp2 >> 8);
+    }
+}
+
+static int nv12ToP01xWrapper(SwsContext *c, const uint8_t *src[],
+                             int srcStride[], int srcSliceY,
+                             int srcSliceH, uint8_t *dstParam8[],
+                             int dstStride[])
+{
+    const uint16_t mask = c->dstFormat == AV_PIX_FMT_P010 ? 0xffc0 : 0xffff;
+    uint16_t *dstY = (uint16_t*)(dstParam8[0] + dstStride[0] * srcSliceY);
+    uint16_t *dstUV = (uint16_t*)(dstParam8[1] + dstStride[1] * srcSliceY / 2);
+    const uint8_t *srcY = src[0], *srcUV = src[1];
+    int x, y;
+
+    av_assert0(!(dstStride[0] % 2 || dstStride[1] % 2));
+
+    for (y = 0; y < srcSliceH; y++) {
+        for (x = 0; x < c->srcW; x++)
+            dstY[x] = (srcY[x] | (srcY[x] << 8)) & mask;
+        srcY += srcStride[0];
+        dstY += dstStride[0] / 2;
+
+        if (!(y & 1)) {
+            for (x = 0; x < 2 * c->chrSrcW; x++)
+                dstUV[x] = (srcUV[x] | (srcUV[x] << 8)) & mask;
+            srcUV += srcStride[1];
+            dstUV += dstStride[1] / 2;
+        }
+    }
+
+    return srcSliceH;
+}
+
+static int p01xToNv12Wrapper(SwsContext *c, const uint8_t *src8[],
+                             int srcStride[], int srcSliceY,
+                             int srcSliceH, uint8_t *dstParam[],
+                             int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+    const unsigned src_shift = desc->comp[0].shift;
+    const unsigned shift = desc->comp[0].depth - 8;
+    const int dither = c->dither != SWS_DITHER_NONE;
+    const uint16_t *srcY = (const uint16_t*)src8[0];
+    const uint16_t *srcUV = (const uint16_t*)src8[1];
+    uint8_t *dstY = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *dstUV = dstParam[1] + dstStride[1] * srcSliceY / 2;
+    int y;
+
+    av_assert0(!(srcStride[0] % 2 || srcStride[1] % 2));
+
+    for (y = 0; y < srcSliceH; y++) {
+        ditherLineTo8(dstY, srcY, c->srcW, src_shift, shift,
+                      !dither || !c->srcRange,
+                      dither ? dithers[shift - 1][y & 7] : zero_dither);
+        srcY += srcStride[0] / 2;
+        dstY += dstStride[0];
+
+        if (!(y & 1)) {
+            ditherInterleaveTo8(dstUV, srcUV, srcUV + 1, c->chrSrcW, 2,
+                                src_shift, shift,
+                                dither ? dithers[shift - 1][(y >> 1) & 7] : zero_dither);
+            srcUV += srcStride[1] / 2;
+            dstUV += dstStride[1];
+        }
+    }
+
+    return srcSliceH;
+}
+
+static int planarToNv12DitherWrapper(SwsContext *c, const uint8_t *src8[],
+                                     int srcStride[], int srcSliceY,
+                                     int srcSliceH, uint8_t *dstParam[],
+                                     int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+    const unsigned shift = desc->comp[0].depth - 8;
+    const int dither = c->dither != SWS_DITHER_NONE;
+    const uint16_t *srcY = (const uint16_t*)src8[0];
+    const uint16_t *srcU = (const uint16_t*)src8[1];
+    const uint16_t *srcV = (const uint16_t*)src8[2];
+    uint8_t *dstY = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *dstUV = dstParam[1] + dstStride[1] * srcSliceY / 2;
+    int y;
+
+    av_assert0(!(srcStride[0] % 2 || srcStride[1] % 2 || srcStride[2] % 2));
+
+    for (y = 0; y < srcSliceH; y++) {
+        ditherLineTo8(dstY, srcY, c->srcW, 0, shift,
+                      !dither || !c->srcRange,
+                      dither ? dithers[shift - 1][y & 7] : zero_dither);
+        srcY += srcStride[0] / 2;
+        dstY += dstStride[0];
+
+        if (!(y & 1)) {
+            ditherInterleaveTo8(dstUV, srcU, srcV, c->chrSrcW, 1, 0, shift,
+                                dither ? dithers[shift - 1][(y >> 1) & 7] : zero_dither);
+            srcU += srcStride[1] / 2;
+            srcV += srcStride[2] / 2;
+            dstUV += dstStride[1];
+        }
+    }
+
+    return srcSliceH;
+}
+
+static int yuyvToNv12Wrapper(SwsContext *c, const uint8_t *src[],
+                             int srcStride[], int srcSliceY, int srcSliceH,
+                             uint8_t *dstParam[], int dstStride[])
+{
+    uint8_t *ydst = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *uvdst = dstParam[1] + dstStride[1] * srcSliceY / 2;
+    uint8_t *utmp = c->formatConvBuffer;
+    uint8_t *vtmp = utmp + FFALIGN(c->chrSrcW + 16, 16);
+    int y;
+
+    for (y = 0; y < srcSliceH; y += 2) {
+        const uint8_t *s = src[0] + y * srcStride[0];
+
+        /* The 4:2:0 converter only emits chroma once it has seen a line
+         * pair, so take a trailing odd line's chroma as is. */
+        if (y + 1 < srcSliceH)
+            yuyvtoyuv420(ydst, utmp, vtmp, s, c->srcW, 2,
+                         dstStride[0], 0, srcStride[0]);
+        else
+            yuyvtoyuv422(ydst, utmp, vtmp, s, c->srcW, 1,
+                         dstStride[0], 0, srcStride[0]);
+        interleaveBytes(utmp, vtmp, uvdst, c->chrSrcW, 1, 0, 0, dstStride[1]);
+
+        ydst  += 2 * dstStride[0];
+        uvdst += dstStride[1];
+    }
+
+    return srcSliceH;
+}
+
+static int rgb32ToNv12Wrapper(SwsContext *c, const uint8_t *src[],
+                              int srcStride[], int srcSliceY, int srcSliceH,
+                              uint8_t *dstParam[], int dstStride[])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+    const int ro = desc->comp[0].offset;
+    const int go = desc->comp[1].offset;
+    const int bo = desc->comp[2].offset;
+    const int32_t *rgb2yuv = c->input_rgb2yuv_table;
+    const int32_t ry = rgb2yuv[RY_IDX], gy = rgb2yuv[GY_IDX], by = rgb2yuv[BY_IDX];
+    const int32_t ru = rgb2yuv[RU_IDX], gu = rgb2yuv[GU_IDX], bu = rgb2yuv[BU_IDX];
+    const int32_t rv = rgb2yuv[RV_IDX], gv = rgb2yuv[GV_IDX], bv = rgb2yuv[BV_IDX];
+    const int y_offset = (16 << RGB2YUV_SHIFT) + (1 << (RGB2YUV_SHIFT - 1));
+    const int c_offset = (128 << (RGB2YUV_SHIFT + 2)) + (1 << (RGB2YUV_SHIFT + 1));
+    uint8_t *ydst = dstParam[0] + dstStride[0] * srcSliceY;
+    uint8_t *uvdst = dstParam[1] + dstStride[1] * srcSliceY / 2;
+    int x, y;
+
+    for (y = 0; y < srcSliceH; y += 2) {
+        const uint8_t *s0 = src[0] + y * srcStride[0];
+        const uint8_t *s1 = y + 1 < srcSliceH ? s0 + srcStride[0] : s0;
+
+        for (x = 0; x < c->srcW; x++) {
+            int r = s0[4 * x + ro], g = s0[4 * x + go], b = s0[4 * x + bo];
+            ydst[x] = (ry * r + gy * g + by * b + y_offset) >> RGB2YUV_SHIFT;
+        }
+        if (s1 != s0) {
+            for (x = 0; x < c->srcW; x++) {
+                int r = s1[4 * x + ro], g = s1[4 * x + go], b = s1[4 * x + bo];
+                ydst[x + dstStride[0]] = (ry * r + gy * g + by * b + y_offset) >> RGB2YUV_SHIFT;
+            }
+        }
+
+        for (x = 0; x < c->chrDstW; x++) {
+            const int x0 = 8 * x, x1 = 4 * FFMIN(2 * x + 1, c->srcW - 1);
+            int r = s0[x0 + ro] + s0[x1 + ro] + s1[x0 + ro] + s1[x1 + ro];
+            int g = s0[x0 + go] + s0[x1 + go] + s1[x0 + go] + s1[x1 + go];
+            int b = s0[x0 + bo] + s0[x1 + bo] + s1[x0 + bo] + s1[x1 + bo];
+            uvdst[2 * x + 0] = (ru * r + gu * g + bu * b + c_offset) >> (RGB2YUV_SHIFT + 2);
+            uvdst[2 * x + 1] = (rv * r + gv * g + bv * b + c_offset) >> (RGB2YUV_SHIFT + 2);
+        }
+
+        ydst  += 2 * dstStride[0];
+        uvdst += dstStride[1];
+    }
+
+    return srcSliceH;
+}
+
+static int nv12ToRgbWrapper(SwsContext *c, const uint8_t *src[],
+                            int srcStride[], int srcSliceY, int srcSliceH,
+                            uint8_t *dst[], int dstStride[])
+{
+    uint8_t *utmp = c->formatConvBuffer;
+    uint8_t *vtmp = utmp + FFALIGN(c->chrSrcW + 16, 16);
+    const uint8_t *planes[4] = { NULL, utmp, vtmp, NULL };
+    int strides[4] = { srcStride[0], 0, 0, 0 };
+    int y;
+
+    /* Deinterleave one chroma line at a time into a scratch buffer and
+     * feed the matching line pair to the planar 4:2:0 converter. */
+    for (y = 0; y < srcSliceH; y += 2) {
+        const uint8_t *uv = src[1] + (y >> 1) * srcStride[1];
+
+        if (c->srcFormat == AV_PIX_FMT_NV12)
+            deinterleaveBytes(uv, utmp, vtmp, c->chrSrcW, 1, 0, 0, 0);
+        else
+            deinterleaveBytes(uv, vtmp, utmp, c->chrSrcW, 1, 0, 0, 0);
+
+        planes[0] = src[0] + y * srcStride[0];
+        c->yuv420_to_rgb(c, planes, strides, srcSliceY + y,
+                         FFMIN(2, srcSliceH - y), dst, dstStride);
+    }
+
+    return srcSliceH;
+}
+
 static int planarToYuy2Wrapper(SwsContext *c, const uint8_t *src[],
                                int srcStride[], int srcSliceY, int srcSliceH,
                                uint8_t *dstParam[], int dstStride[])
@@ -1970,6 +2215,41 @@ void ff_get_unscaled_swscale(SwsContext *c)
         (dstFormat == AV_PIX_FMT_P010 || dstFormat == AV_PIX_FMT_P016)) {
         c->swscale = planarToP01xWrapper;
     }
+    /* nv12_to_p01x */
+    if (srcFormat == AV_PIX_FMT_NV12 &&
+        (dstFormat == AV_PIX_FMT_P010 || dstFormat == AV_PIX_FMT_P016)) {
+        c->swscale = nv12ToP01xWrapper;
+    }
+    /* p01x_to_nv12 */
+    if ((srcFormat == AV_PIX_FMT_P010 || srcFormat == AV_PIX_FMT_P016) &&
+        dstFormat == AV_PIX_FMT_NV12) {
+        c->swscale = p01xToNv12Wrapper;
+    }
+    /* yuv420p1x_to_nv12 */
+    if ((srcFormat == AV_PIX_FMT_YUV420P9  || srcFormat == AV_PIX_FMT_YUV420P10 ||
+         srcFormat == AV_PIX_FMT_YUV420P12 || srcFormat == AV_PIX_FMT_YUV420P14 ||
+         srcFormat == AV_PIX_FMT_YUV420P16) &&
+        dstFormat == AV_PIX_FMT_NV12) {
+        c->swscale = planarToNv12DitherWrapper;
+    }
+    /* nv12_to_rgb */
+    if ((srcFormat == AV_PIX_FMT_NV12 || srcFormat == AV_PIX_FMT_NV21) &&
+        (dstFormat == AV_PIX_FMT_RGB32 || dstFormat == AV_PIX_FMT_BGR32 ||
+         dstFormat == AV_PIX_FMT_RGB24 || dstFormat == AV_PIX_FMT_BGR24) &&
+        !(flags & SWS_ACCURATE_RND) && (c->dither == SWS_DITHER_BAYER || c->dither == SWS_DITHER_AUTO) && !(dstH & 1)) {
+        c->yuv420_to_rgb = ff_yuv2rgb_get_func_ptr(c);
+        if (c->yuv420_to_rgb)
+            c->swscale = nv12ToRgbWrapper;
+    }
+    /* rgb32_to_nv12 */
+    if ((srcFormat == AV_PIX_FMT_RGB32 || srcFormat == AV_PIX_FMT_BGR32 ||
+         srcFormat == AV_PIX_FMT_RGB32_1 || srcFormat == AV_PIX_FMT_BGR32_1 ||
+         srcFormat == AV_PIX_FMT_0RGB || srcFormat == AV_PIX_FMT_0BGR ||
+         srcFormat == AV_PIX_FMT_RGB0 || srcFormat == AV_PIX_FMT_BGR0) &&
+        dstFormat == AV_PIX_FMT_NV12 && !c->dstRange &&
+        !(flags & (SWS_ACCURATE_RND | SWS_BITEXACT))) {
+        c->swscale = rgb32ToNv12Wrapper;
+    }
     /* yuv420p_to_p01xle */
     if ((srcFormat == AV_PIX_FMT_YUV420P || srcFormat == AV_PIX_FMT_YUVA420P) &&
         (dstFormat == AV_PIX_FMT_P010LE || dstFormat == AV_PIX_FMT_P016LE)) {
@@ -2143,6 +2423,8 @@ void ff_get_unscaled_swscale(SwsContext *c)
     if (srcFormat == AV_PIX_FMT_YUYV422 &&
        (dstFormat == AV_PIX_FMT_YUV420P || dstFormat == AV_PIX_FMT_YUVA420P))
         c->swscale = yuyvToYuv420Wrapper;
+    if (srcFormat == AV_PIX_FMT_YUYV422 && dstFormat == AV_PIX_FMT_NV12)
+        c->swscale = yuyvToNv12Wrapper;
     if (srcFormat == AV_PIX_FMT_UYVY422 &&
        (dstFormat == AV_PIX_FMT_YUV420P || dstFormat == AV_PIX_FMT_YUVA420P))
         c->swscale = uyvyToYuv420Wrapper;
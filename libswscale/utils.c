@@ -871,6 +871,15 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i, ret;
+
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        ret = sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange,
+                                       table, dstRange,
+                                       brightness, contrast, saturation);
+        if (ret < 0)
+            return ret;
+    }
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -926,7 +935,6 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
             int srcH = c->srcH;
             int dstW = c->dstW;
             int dstH = c->dstH;
-            int ret;
             av_log(c, AV_LOG_VERBOSE, "YUV color matrix differs for YUV->YUV, using intermediate RGB to convert\n");
 
             if (isNBPS(c->dstFormat) || is16BPS(c->dstFormat)) {
@@ -1171,8 +1179,8 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int sws_init_single_context(SwsContext *c, SwsFilter *srcFilter,
+                                           SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1883,6 +1891,77 @@ fail: // FIXME replace things by appropriate error codes
     return ret;
 }
 
+static av_cold int context_init_threaded(SwsContext *c, const SwsContext *opts,
+                                         SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    int i, nb_threads, ret;
+
+    nb_threads = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                           NULL, c->nb_threads);
+    if (nb_threads == AVERROR(ENOSYS))
+        return 0;
+    if (nb_threads < 0)
+        return nb_threads;
+    if (nb_threads == 1) {
+        avpriv_slicethread_free(&c->slicethread);
+        return 0;
+    }
+
+    c->slice_ctx = av_calloc(nb_threads, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *slice = sws_alloc_context();
+
+        if (!slice)
+            return AVERROR(ENOMEM);
+        c->slice_ctx[c->nb_slice_ctx++] = slice;
+
+        ret = av_opt_copy(slice, (void *)opts);
+        if (ret < 0)
+            return ret;
+
+        ret = sws_init_single_context(slice, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    SwsContext *opts = NULL;
+    int ret;
+
+    /* keep the options as set by the user, the child contexts used for
+     * slice threading are initialized from them */
+    if (c->nb_threads != 1) {
+        opts = sws_alloc_context();
+        if (!opts)
+            return AVERROR(ENOMEM);
+        ret = av_opt_copy(opts, c);
+        if (ret < 0)
+            goto end;
+        opts->nb_threads = 1;
+    }
+
+    ret = sws_init_single_context(c, srcFilter, dstFilter);
+    if (ret < 0 || !opts)
+        goto end;
+
+    /* only the generic scaler can output a band of the picture, and error
+     * diffusion carries state from one line to the next */
+    if (c->desc && !c->cascaded_context[0] && c->dither != SWS_DITHER_ED)
+        ret = context_init_threaded(c, opts, srcFilter, dstFilter);
+
+end:
+    sws_freeContext(opts);
+    return ret;
+}
+
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
                                int dstW, int dstH, enum AVPixelFormat dstFormat,
                                int flags, const double *param)
@@ -2373,6 +2452,12 @@ void sws_freeContext(SwsContext *c)
     av_freep(&c->yuvTable);
     av_freep(&c->formatConvBuffer);
 
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+
     sws_freeContext(c->cascaded_context[0]);
     sws_freeContext(c->cascaded_context[1]);
     sws_freeContext(c->cascaded_context[2]);
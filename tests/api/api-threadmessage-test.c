@@ -52,6 +52,8 @@ struct message {
 
 #define MAGIC 0xdeadc0de
 
+static unsigned queue_flags;
+
 static void free_frame(void *arg)
 {
     struct message *msg = arg;
@@ -66,7 +68,9 @@ static void *sender_thread(void *arg)
 
     av_log(NULL, AV_LOG_INFO, "sender #%d: workload=%d\n", wd->id, wd->workload);
     for (i = 0; i < wd->workload; i++) {
-        if (rand() % wd->workload < wd->workload / 10) {
+        /* with a single consumer, only the receiver may flush */
+        if (!(queue_flags & AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER) &&
+            rand() % wd->workload < wd->workload / 10) {
             av_log(NULL, AV_LOG_INFO, "sender #%d: flushing the queue\n", wd->id);
             av_thread_message_flush(wd->queue);
         } else {
@@ -171,10 +175,11 @@ int main(int ac, char **av)
     struct receiver_data *receivers;
     AVThreadMessageQueue *queue = NULL;
 
-    if (ac != 8) {
+    if (ac != 8 && ac != 9) {
         av_log(NULL, AV_LOG_ERROR, "%s <max_queue_size> "
                "<nb_senders> <sender_min_send> <sender_max_send> "
-               "<nb_receivers> <receiver_min_recv> <receiver_max_recv>\n", av[0]);
+               "<nb_receivers> <receiver_min_recv> <receiver_max_recv> "
+               "[queue_flags]\n", av[0]);
         return 1;
     }
 
@@ -185,6 +190,7 @@ int main(int ac, char **av)
     nb_receivers      = atoi(av[5]);
     receiver_min_load = atoi(av[6]);
     receiver_max_load = atoi(av[7]);
+    queue_flags       = ac > 8 ? atoi(av[8]) : 0;
 
     if (max_queue_size <= 0 ||
         nb_senders <= 0 || sender_min_load <= 0 || sender_max_load <= 0 ||
@@ -193,6 +199,12 @@ int main(int ac, char **av)
         return 1;
     }
 
+    if ((queue_flags & AV_THREAD_MESSAGE_QUEUE_SINGLE_CONSUMER && nb_receivers > 1) ||
+        (queue_flags & AV_THREAD_MESSAGE_QUEUE_SINGLE_PRODUCER && nb_senders > 1)) {
+        av_log(NULL, AV_LOG_ERROR, "too many threads for the queue flags\n");
+        return 1;
+    }
+
     av_log(NULL, AV_LOG_INFO, "qsize:%d / %d senders sending [%d-%d] / "
            "%d receivers receiving [%d-%d]\n", max_queue_size,
            nb_senders, sender_min_load, sender_max_load,
@@ -205,7 +217,8 @@ int main(int ac, char **av)
         goto end;
     }
 
-    ret = av_thread_message_queue_alloc(&queue, max_queue_size, sizeof(struct message));
+    ret = av_thread_message_queue_alloc2(&queue, max_queue_size, sizeof(struct message),
+                                         queue_flags);
     if (ret < 0)
         goto end;
 
@@ -0,0 +1,335 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/float_dsp.h"
+#include "libavutil/mem.h"
+
+#include "libavfilter/dnn/dnn_backend_native.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_conv2d.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_depth2space.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_mathbinary.h"
+
+#include "checkasm.h"
+
+#define WIDTH  32
+#define HEIGHT 32
+#define MAX_CHANNELS 16
+
+#define EPS 0.0001
+
+static void randomize_floats(float *buf, int len, float range)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (int32_t)rnd() / (float)(1U << 31) * range;
+}
+
+static void init_operand(DnnOperand *oprd, int height, int width, int channels,
+                         float *data)
+{
+    memset(oprd, 0, sizeof(*oprd));
+    oprd->dims[0]   = 1;
+    oprd->dims[1]   = height;
+    oprd->dims[2]   = width;
+    oprd->dims[3]   = channels;
+    oprd->data_type = DNN_FLOAT;
+    oprd->isNHWC    = 1;
+    oprd->data      = data;
+    oprd->length    = height * width * channels * sizeof(*data);
+}
+
+static int compare_outputs(const DnnOperand *a, const DnnOperand *b)
+{
+    const float *fa = a->data, *fb = b->data;
+    int i, count;
+
+    if (memcmp(a->dims, b->dims, sizeof(a->dims)))
+        return 1;
+    count = calculate_operand_dims_count(a);
+    for (i = 0; i < count; i++) {
+        if (!float_near_abs_eps(fa[i], fb[i], EPS)) {
+            fprintf(stderr, "%d: %- .12f != %- .12f\n", i, fa[i], fb[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const struct {
+    int input_num, output_num, kernel_size, dilation;
+    DNNConvPaddingParam padding_method;
+    DNNActivationFunc activation;
+    int has_bias;
+} conv2d_configs[] = {
+    {  1, 16, 5, 1, SAME,               RELU,       1 },
+    { 16,  8, 3, 1, SAME_CLAMP_TO_EDGE, TANH,       1 },
+    {  8,  4, 3, 2, VALID,              SIGMOID,    0 },
+    {  3,  3, 3, 1, SAME_REFLECT,       LEAKY_RELU, 1 },
+    {  4,  4, 3, 2, SAME_SYMMETRIC,     NONE,       0 },
+};
+
+static const char *const padding_names[] = {
+    [VALID]              = "valid",
+    [SAME]               = "same",
+    [SAME_CLAMP_TO_EDGE] = "clamp",
+    [SAME_REFLECT]       = "reflect",
+    [SAME_SYMMETRIC]     = "symmetric",
+};
+
+/*
+ * The only cpu specific part of conv2d is the dot product of the float dsp,
+ * which is what gets registered; the whole layer is then run with the
+ * reference and the new dot product, and benchmarked.
+ */
+static void check_conv2d(void)
+{
+    AVFloatDSPContext *fdsp = avpriv_float_dsp_alloc(0);
+    AVFloatDSPContext ref_fdsp;
+    NativeContext ref_ctx = { 0 }, new_ctx = { 0 };
+    float *input  = av_malloc(WIDTH * HEIGHT * MAX_CHANNELS * sizeof(*input));
+    float *kernel = av_malloc(MAX_CHANNELS * MAX_CHANNELS * 25 * sizeof(*kernel));
+    float biases[MAX_CHANNELS];
+    int i;
+
+    declare_func(int, DnnOperand *operands, const int32_t *input_operand_indexes,
+                 int32_t output_operand_index, const void *parameters,
+                 NativeContext *ctx);
+
+    if (!fdsp || !input || !kernel) {
+        fail();
+        goto end;
+    }
+    ref_fdsp = *fdsp;
+    ref_ctx.fdsp = &ref_fdsp;
+    new_ctx.fdsp = fdsp;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(conv2d_configs); i++) {
+        ConvolutionalParams params = {
+            .input_num      = conv2d_configs[i].input_num,
+            .output_num     = conv2d_configs[i].output_num,
+            .kernel_size    = conv2d_configs[i].kernel_size,
+            .activation     = conv2d_configs[i].activation,
+            .padding_method = conv2d_configs[i].padding_method,
+            .dilation       = conv2d_configs[i].dilation,
+            .has_bias       = conv2d_configs[i].has_bias,
+            .kernel         = kernel,
+            .biases         = biases,
+        };
+
+        if (check_func(fdsp->scalarproduct_float, "conv2d_%dx%d_%dto%d_%s",
+                       params.kernel_size, params.kernel_size,
+                       params.input_num, params.output_num,
+                       padding_names[params.padding_method])) {
+            DnnOperand ref_ops[2], new_ops[2];
+            const int32_t input_index = 0;
+
+            ref_fdsp.scalarproduct_float = (void *)func_ref;
+            func_ref = func_new = dnn_execute_layer_conv2d;
+
+            randomize_floats(input, WIDTH * HEIGHT * params.input_num, 1.0f);
+            randomize_floats(kernel, params.output_num * params.input_num *
+                             params.kernel_size * params.kernel_size, 0.25f);
+            randomize_floats(biases, params.output_num, 0.5f);
+            init_operand(&ref_ops[0], HEIGHT, WIDTH, params.input_num, input);
+            init_operand(&new_ops[0], HEIGHT, WIDTH, params.input_num, input);
+            memset(&ref_ops[1], 0, sizeof(ref_ops[1]));
+            memset(&new_ops[1], 0, sizeof(new_ops[1]));
+
+            if (call_ref(ref_ops, &input_index, 1, &params, &ref_ctx) ||
+                call_new(new_ops, &input_index, 1, &params, &new_ctx) ||
+                compare_outputs(&ref_ops[1], &new_ops[1]))
+                fail();
+            bench_new(new_ops, &input_index, 1, &params, &new_ctx);
+
+            av_freep(&ref_ops[1].data);
+            av_freep(&new_ops[1].data);
+        }
+    }
+
+end:
+    av_free(fdsp);
+    av_free(input);
+    av_free(kernel);
+}
+
+/*
+ * depth2space and mathbinary have no cpu specific versions yet, they are
+ * checked against straightforward implementations and benchmarked in C.
+ */
+static int compare_depth2space(const float *input, const float *output,
+                               int channels, int block_size)
+{
+    int new_channels = channels / (block_size * block_size);
+    int x, y, c;
+
+    for (y = 0; y < HEIGHT * block_size; y++) {
+        for (x = 0; x < WIDTH * block_size; x++) {
+            for (c = 0; c < new_channels; c++) {
+                int in_c = ((y % block_size) * block_size + x % block_size) * new_channels + c;
+                float ref = input[((y / block_size) * WIDTH + x / block_size) * channels + in_c];
+                float out = output[(y * WIDTH * block_size + x) * new_channels + c];
+                if (out != ref) {
+                    fprintf(stderr, "%d,%d,%d: %- .12f != %- .12f\n", x, y, c, out, ref);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void check_depth2space(void)
+{
+    float *input = av_malloc(WIDTH * HEIGHT * MAX_CHANNELS * sizeof(*input));
+    int block_size;
+
+    declare_func(int, DnnOperand *operands, const int32_t *input_operand_indexes,
+                 int32_t output_operand_index, const void *parameters,
+                 NativeContext *ctx);
+
+    if (!input) {
+        fail();
+        return;
+    }
+
+    for (block_size = 2; block_size <= 4; block_size += 2) {
+        if (check_func(dnn_execute_layer_depth2space, "depth2space_%d", block_size)) {
+            DepthToSpaceParams params = { .block_size = block_size };
+            int channels = MAX_CHANNELS;
+            DnnOperand ops[2];
+            const int32_t input_index = 0;
+
+            randomize_floats(input, WIDTH * HEIGHT * channels, 1.0f);
+            init_operand(&ops[0], HEIGHT, WIDTH, channels, input);
+            memset(&ops[1], 0, sizeof(ops[1]));
+
+            if (call_new(ops, &input_index, 1, &params, NULL) ||
+                compare_depth2space(input, ops[1].data, channels, block_size))
+                fail();
+            bench_new(ops, &input_index, 1, &params, NULL);
+            av_freep(&ops[1].data);
+        }
+    }
+
+    av_free(input);
+}
+
+static float math_binary_ref(DNNMathBinaryOperation op, float a, float b)
+{
+    switch (op) {
+    case DMBO_SUB:     return a - b;
+    case DMBO_ADD:     return a + b;
+    case DMBO_MUL:     return a * b;
+    case DMBO_REALDIV: return a / b;
+    case DMBO_MINIMUM: return FFMIN(a, b);
+    }
+    return 0;
+}
+
+static void check_math_binary(void)
+{
+    static const char *const op_names[DMBO_COUNT] = {
+        [DMBO_SUB]     = "sub",
+        [DMBO_ADD]     = "add",
+        [DMBO_MUL]     = "mul",
+        [DMBO_REALDIV] = "realdiv",
+        [DMBO_MINIMUM] = "minimum",
+    };
+    static const char *const broadcast_names[3] = { "", "_broadcast0", "_broadcast1" };
+    int len = WIDTH * HEIGHT * MAX_CHANNELS;
+    float *input0 = av_malloc(len * sizeof(*input0));
+    float *input1 = av_malloc(len * sizeof(*input1));
+    int op, broadcast, i;
+
+    declare_func(int, DnnOperand *operands, const int32_t *input_operand_indexes,
+                 int32_t output_operand_index, const void *parameters,
+                 NativeContext *ctx);
+
+    if (!input0 || !input1) {
+        fail();
+        goto end;
+    }
+
+    for (op = 0; op < DMBO_COUNT; op++) {
+        for (broadcast = 0; broadcast < 3; broadcast++) {
+            if (check_func(dnn_execute_layer_math_binary, "math_binary_%s%s",
+                           op_names[op], broadcast_names[broadcast])) {
+                DnnLayerMathBinaryParams params = {
+                    .bin_op           = op,
+                    .input0_broadcast = broadcast == 1,
+                    .input1_broadcast = broadcast == 2,
+                    .v                = 0.75f,
+                };
+                DnnOperand ops[3];
+                const int32_t input_indexes[2] = { 0, 1 };
+                const float *output;
+
+                /* keep the divisors away from zero */
+                randomize_floats(input0, len, 1.0f);
+                randomize_floats(input1, len, 1.0f);
+                for (i = 0; i < len; i++) {
+                    input0[i] += input0[i] < 0 ? -0.5f : 0.5f;
+                    input1[i] += input1[i] < 0 ? -0.5f : 0.5f;
+                }
+                init_operand(&ops[0], HEIGHT, WIDTH, MAX_CHANNELS, input0);
+                init_operand(&ops[1], HEIGHT, WIDTH, MAX_CHANNELS, input1);
+                memset(&ops[2], 0, sizeof(ops[2]));
+
+                if (call_new(ops, input_indexes, 2, &params, NULL)) {
+                    fail();
+                    av_freep(&ops[2].data);
+                    continue;
+                }
+                output = ops[2].data;
+                for (i = 0; i < len; i++) {
+                    float a = broadcast == 1 ? params.v : input0[i];
+                    float b = broadcast == 1 ? input0[i] :
+                              broadcast == 2 ? params.v  : input1[i];
+                    float ref = math_binary_ref(op, a, b);
+                    if (!float_near_abs_eps(output[i], ref, EPS)) {
+                        fprintf(stderr, "%d: %- .12f != %- .12f\n", i, output[i], ref);
+                        fail();
+                        break;
+                    }
+                }
+                bench_new(ops, input_indexes, 2, &params, NULL);
+                av_freep(&ops[2].data);
+            }
+        }
+    }
+
+end:
+    av_free(input0);
+    av_free(input1);
+}
+
+void checkasm_check_dnn_layers(void)
+{
+    check_conv2d();
+    report("conv2d");
+
+    check_depth2space();
+    report("depth2space");
+
+    check_math_binary();
+    report("math_binary");
+}
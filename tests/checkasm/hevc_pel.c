@@ -0,0 +1,233 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/intreadwrite.h"
+
+#include "libavcodec/hevcdsp.h"
+
+#include "checkasm.h"
+
+static const uint32_t pixel_mask[3] = { 0xffffffff, 0x03ff03ff, 0x0fff0fff };
+static const int sizes[10] = { 2, 4, 6, 8, 12, 16, 24, 32, 48, 64 };
+static const char *const filter_names[2][2] = {
+    { "pixels", "h" },
+    { "v",      "hv" },
+};
+
+#define SIZEOF_PIXEL ((bit_depth + 7) / 8)
+#define SRC_EXTRA    8 // interpolation taps around the block
+#define SRC_STRIDE   ((MAX_PB_SIZE + 2 * SRC_EXTRA) * 2)
+#define SRC_BUF_SIZE (SRC_STRIDE * (MAX_PB_SIZE + 2 * SRC_EXTRA))
+#define DST_STRIDE   (MAX_PB_SIZE * 2)
+#define DST_BUF_SIZE (DST_STRIDE * MAX_PB_SIZE)
+
+#define randomize_buffers(buf0, buf1, size)                 \
+    do {                                                    \
+        uint32_t mask = pixel_mask[(bit_depth - 8) >> 1];   \
+        int k;                                              \
+        for (k = 0; k < size; k += 4) {                     \
+            uint32_t r = rnd() & mask;                      \
+            AV_WN32A(buf0 + k, r);                          \
+            AV_WN32A(buf1 + k, r);                          \
+        }                                                   \
+    } while (0)
+
+/* intermediate samples have 14 bits of precision at every bit depth */
+#define randomize_buffers_int16(buf, size)                  \
+    do {                                                    \
+        int k;                                              \
+        for (k = 0; k < size; k++)                          \
+            buf[k] = rnd() & 0x3fff;                        \
+    } while (0)
+
+/* fractional positions: qpel uses 1..3, epel 1..7 */
+static void random_mv(int is_epel, int idx2, int idx3, intptr_t *mx, intptr_t *my)
+{
+    int mask = is_epel ? 7 : 3;
+    *mx = idx3 ? 1 + rnd() % mask : 0;
+    *my = idx2 ? 1 + rnd() % mask : 0;
+}
+
+static void check_put_hevc_pel(HEVCDSPContext *h, int bit_depth, int is_epel)
+{
+    LOCAL_ALIGNED_32(uint8_t, src0, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, src1, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(int16_t, dst0, [MAX_PB_SIZE * MAX_PB_SIZE]);
+    LOCAL_ALIGNED_32(int16_t, dst1, [MAX_PB_SIZE * MAX_PB_SIZE]);
+    const int offset = SRC_EXTRA * SRC_STRIDE + SRC_EXTRA * SIZEOF_PIXEL;
+    const char *type = is_epel ? "epel" : "qpel";
+    int idx, idx2, idx3;
+
+    declare_func(void, int16_t *dst, uint8_t *src, ptrdiff_t srcstride,
+                 int height, intptr_t mx, intptr_t my, int width);
+
+    for (idx = 0; idx < 10; idx++) {
+        for (idx2 = 0; idx2 < 2; idx2++) {
+            for (idx3 = 0; idx3 < 2; idx3++) {
+                int size = sizes[idx];
+                intptr_t mx, my;
+
+                if (!check_func(is_epel ? h->put_hevc_epel[idx][idx2][idx3]
+                                        : h->put_hevc_qpel[idx][idx2][idx3],
+                                "put_hevc_%s_%s%d_%d", type,
+                                filter_names[idx2][idx3], size, bit_depth))
+                    continue;
+
+                random_mv(is_epel, idx2, idx3, &mx, &my);
+                randomize_buffers(src0, src1, SRC_BUF_SIZE);
+                memset(dst0, 0, MAX_PB_SIZE * MAX_PB_SIZE * sizeof(*dst0));
+                memset(dst1, 0, MAX_PB_SIZE * MAX_PB_SIZE * sizeof(*dst1));
+
+                call_ref(dst0, src0 + offset, SRC_STRIDE, size, mx, my, size);
+                call_new(dst1, src1 + offset, SRC_STRIDE, size, mx, my, size);
+                if (memcmp(dst0, dst1, MAX_PB_SIZE * MAX_PB_SIZE * sizeof(*dst0)))
+                    fail();
+                bench_new(dst1, src1 + offset, SRC_STRIDE, size, mx, my, size);
+            }
+        }
+    }
+}
+
+static void check_put_hevc_pel_uni_w(HEVCDSPContext *h, int bit_depth, int is_epel)
+{
+    LOCAL_ALIGNED_32(uint8_t, src0, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, src1, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_BUF_SIZE]);
+    const int offset = SRC_EXTRA * SRC_STRIDE + SRC_EXTRA * SIZEOF_PIXEL;
+    const char *type = is_epel ? "epel" : "qpel";
+    int idx, idx2, idx3;
+
+    declare_func(void, uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                 int height, int denom, int wx, int ox, intptr_t mx, intptr_t my, int width);
+
+    for (idx = 0; idx < 10; idx++) {
+        for (idx2 = 0; idx2 < 2; idx2++) {
+            for (idx3 = 0; idx3 < 2; idx3++) {
+                int size = sizes[idx];
+                int denom = rnd() % 8;
+                int wx    = (1 << denom) + (int8_t)rnd();
+                int ox    = (int8_t)rnd();
+                intptr_t mx, my;
+
+                if (!check_func(is_epel ? h->put_hevc_epel_uni_w[idx][idx2][idx3]
+                                        : h->put_hevc_qpel_uni_w[idx][idx2][idx3],
+                                "put_hevc_%s_uni_w_%s%d_%d", type,
+                                filter_names[idx2][idx3], size, bit_depth))
+                    continue;
+
+                random_mv(is_epel, idx2, idx3, &mx, &my);
+                randomize_buffers(src0, src1, SRC_BUF_SIZE);
+                randomize_buffers(dst0, dst1, DST_BUF_SIZE);
+
+                call_ref(dst0, DST_STRIDE, src0 + offset, SRC_STRIDE,
+                         size, denom, wx, ox, mx, my, size);
+                call_new(dst1, DST_STRIDE, src1 + offset, SRC_STRIDE,
+                         size, denom, wx, ox, mx, my, size);
+                if (memcmp(dst0, dst1, DST_BUF_SIZE))
+                    fail();
+                bench_new(dst1, DST_STRIDE, src1 + offset, SRC_STRIDE,
+                          size, denom, wx, ox, mx, my, size);
+            }
+        }
+    }
+}
+
+static void check_put_hevc_pel_bi_w(HEVCDSPContext *h, int bit_depth, int is_epel)
+{
+    LOCAL_ALIGNED_32(uint8_t, src0, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, src1, [SRC_BUF_SIZE]);
+    LOCAL_ALIGNED_32(int16_t, src2, [MAX_PB_SIZE * MAX_PB_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_BUF_SIZE]);
+    const int offset = SRC_EXTRA * SRC_STRIDE + SRC_EXTRA * SIZEOF_PIXEL;
+    const char *type = is_epel ? "epel" : "qpel";
+    int idx, idx2, idx3;
+
+    declare_func(void, uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                 int16_t *src2, int height, int denom, int wx0, int wx1,
+                 int ox0, int ox1, intptr_t mx, intptr_t my, int width);
+
+    for (idx = 0; idx < 10; idx++) {
+        for (idx2 = 0; idx2 < 2; idx2++) {
+            for (idx3 = 0; idx3 < 2; idx3++) {
+                int size = sizes[idx];
+                int denom = rnd() % 8;
+                int wx0   = (1 << denom) + (int8_t)rnd();
+                int wx1   = (1 << denom) + (int8_t)rnd();
+                int ox0   = (int8_t)rnd();
+                int ox1   = (int8_t)rnd();
+                intptr_t mx, my;
+
+                if (!check_func(is_epel ? h->put_hevc_epel_bi_w[idx][idx2][idx3]
+                                        : h->put_hevc_qpel_bi_w[idx][idx2][idx3],
+                                "put_hevc_%s_bi_w_%s%d_%d", type,
+                                filter_names[idx2][idx3], size, bit_depth))
+                    continue;
+
+                random_mv(is_epel, idx2, idx3, &mx, &my);
+                randomize_buffers(src0, src1, SRC_BUF_SIZE);
+                randomize_buffers(dst0, dst1, DST_BUF_SIZE);
+                randomize_buffers_int16(src2, MAX_PB_SIZE * MAX_PB_SIZE);
+
+                call_ref(dst0, DST_STRIDE, src0 + offset, SRC_STRIDE, src2,
+                         size, denom, wx0, wx1, ox0, ox1, mx, my, size);
+                call_new(dst1, DST_STRIDE, src1 + offset, SRC_STRIDE, src2,
+                         size, denom, wx0, wx1, ox0, ox1, mx, my, size);
+                if (memcmp(dst0, dst1, DST_BUF_SIZE))
+                    fail();
+                bench_new(dst1, DST_STRIDE, src1 + offset, SRC_STRIDE, src2,
+                          size, denom, wx0, wx1, ox0, ox1, mx, my, size);
+            }
+        }
+    }
+}
+
+void checkasm_check_hevc_pel(void)
+{
+    int bit_depth, is_epel;
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        HEVCDSPContext h;
+
+        ff_hevc_dsp_init(&h, bit_depth);
+        for (is_epel = 0; is_epel < 2; is_epel++)
+            check_put_hevc_pel(&h, bit_depth, is_epel);
+    }
+    report("put_hevc_pel");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        HEVCDSPContext h;
+
+        ff_hevc_dsp_init(&h, bit_depth);
+        for (is_epel = 0; is_epel < 2; is_epel++)
+            check_put_hevc_pel_uni_w(&h, bit_depth, is_epel);
+    }
+    report("put_hevc_pel_uni_w");
+
+    for (bit_depth = 8; bit_depth <= 12; bit_depth += 2) {
+        HEVCDSPContext h;
+
+        ff_hevc_dsp_init(&h, bit_depth);
+        for (is_epel = 0; is_epel < 2; is_epel++)
+            check_put_hevc_pel_bi_w(&h, bit_depth, is_epel);
+    }
+    report("put_hevc_pel_bi_w");
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavcodec/me_cmp.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+
+#define STRIDE 64
+#define BUF_SIZE (STRIDE * 17)
+
+static void randomize_buffers(uint8_t *buf1, uint8_t *buf2, int extreme)
+{
+    for (int i = 0; i < BUF_SIZE; i++) {
+        if (extreme) {
+            /* the largest differences the functions have to handle */
+            buf1[i] = rnd() & 1 ? 255 : 0;
+            buf2[i] = 255 - buf1[i];
+        } else {
+            buf1[i] = rnd();
+            buf2[i] = rnd();
+        }
+    }
+}
+
+static void check_cmp(me_cmp_func func, const char *name)
+{
+    LOCAL_ALIGNED_16(uint8_t, buf1, [BUF_SIZE]);
+    LOCAL_ALIGNED_16(uint8_t, buf2, [BUF_SIZE]);
+    static const int heights[] = { 8, 16 };
+
+    declare_func_emms(AV_CPU_FLAG_MMX, int, struct MpegEncContext *c,
+                      uint8_t *blk1, uint8_t *blk2, ptrdiff_t stride, int h);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(heights); i++) {
+        int h = heights[i];
+
+        if (!check_func(func, "%s_%d", name, h))
+            continue;
+
+        for (int extreme = 0; extreme < 2; extreme++) {
+            for (int offset = 0; offset < 3; offset++) {
+                int res0, res1;
+
+                randomize_buffers(buf1, buf2, extreme);
+                /* the blocks need not be aligned */
+                res0 = call_ref(NULL, buf1 + offset, buf2 + 2 * offset, STRIDE, h);
+                res1 = call_new(NULL, buf1 + offset, buf2 + 2 * offset, STRIDE, h);
+                if (res0 != res1)
+                    fail();
+            }
+        }
+        bench_new(NULL, buf1, buf2, STRIDE, h);
+    }
+}
+
+void checkasm_check_me_cmp(void)
+{
+    MECmpContext c;
+    AVCodecContext avctx = { 0 };
+
+    ff_me_cmp_init(&c, &avctx);
+
+    check_cmp(c.sse[0], "sse16");
+    report("sse");
+
+    check_cmp(c.nsse[0], "nsse16");
+    report("nsse");
+
+    check_cmp(c.hadamard8_diff[0], "hadamard8_diff16");
+    report("hadamard8_diff");
+}
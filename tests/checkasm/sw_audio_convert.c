@@ -0,0 +1,188 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/samplefmt.h"
+
+#include "libswresample/audioconvert.h"
+
+#include "checkasm.h"
+
+/* the SIMD versions process multiples of 16 samples from aligned buffers */
+#define LEN 256
+#define MAX_CH 8
+
+static const struct {
+    enum AVSampleFormat out_fmt, in_fmt;
+    int channels;
+} conversions[] = {
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_S16,  2 },
+    { AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_S16P, 2 },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S32,  2 },
+    { AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, 2 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S16,  2 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S32,  2 },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_FLT,  2 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_FLT,  2 },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S16P, 2 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_S32P, 2 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_S16P, 2 },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S32P, 2 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S16P, 2 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S32P, 2 },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_FLTP, 2 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_FLTP, 2 },
+    { AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S16,  2 },
+    { AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_S32,  2 },
+    { AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_S16,  2 },
+    { AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32,  2 },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16,  2 },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S32,  2 },
+    { AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_FLT,  2 },
+    { AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLT,  2 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_FLTP, 6 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S32P, 6 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_FLTP, 6 },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT,  6 },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S32,  6 },
+    { AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLT,  6 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_FLTP, 8 },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S32P, 8 },
+    { AV_SAMPLE_FMT_S32,  AV_SAMPLE_FMT_FLTP, 8 },
+};
+
+/*
+ * The C converters work on one channel at a time with explicit strides, so
+ * they are wrapped into the calling convention of the SIMD ones, with the
+ * layout of the conversion under test kept here.
+ */
+static struct {
+    const AudioConvert *ctx;
+    int in_planar, out_planar;
+    int in_bps, out_bps;
+} c_conv;
+
+static void convert_c(uint8_t **dst, const uint8_t **src, int len)
+{
+    int ch;
+
+    if (c_conv.in_planar == c_conv.out_planar) {
+        /* called once per plane, packed samples are converted as one channel */
+        c_conv.ctx->conv_f(dst[0], src[0], c_conv.in_bps, c_conv.out_bps,
+                           dst[0] + len * c_conv.out_bps);
+        return;
+    }
+    for (ch = 0; ch < c_conv.ctx->channels; ch++) {
+        int is = (c_conv.in_planar  ? 1 : c_conv.ctx->channels) * c_conv.in_bps;
+        int os = (c_conv.out_planar ? 1 : c_conv.ctx->channels) * c_conv.out_bps;
+        const uint8_t *pi = c_conv.in_planar  ? src[ch] : src[0] + ch * c_conv.in_bps;
+        uint8_t       *po = c_conv.out_planar ? dst[ch] : dst[0] + ch * c_conv.out_bps;
+        c_conv.ctx->conv_f(po, pi, is, os, po + len * os);
+    }
+}
+
+static void randomize_buffer(uint8_t *buf, enum AVSampleFormat fmt, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        switch (av_get_packed_sample_fmt(fmt)) {
+        case AV_SAMPLE_FMT_S16: ((int16_t *)buf)[i] = rnd(); break;
+        case AV_SAMPLE_FMT_S32: ((int32_t *)buf)[i] = rnd(); break;
+        /* stay clear of full scale, where the float to int32 rounding overflows */
+        case AV_SAMPLE_FMT_FLT: ((float *)buf)[i] = ((int32_t)rnd() >> 1) / (float)(1U << 30) * 0.99f; break;
+        }
+    }
+}
+
+/* call the converter the way swri_audio_convert() does */
+#define CALL(call, dst, src)                                                  \
+    do {                                                                      \
+        if (in_planar == out_planar) {                                        \
+            int planes = out_planar ? channels : 1;                           \
+            for (p = 0; p < planes; p++)                                      \
+                call(dst + p, (const uint8_t **)src + p,                      \
+                     LEN * (out_planar ? 1 : channels));                      \
+        } else {                                                              \
+            call(dst, (const uint8_t **)src, LEN);                            \
+        }                                                                     \
+    } while (0)
+
+static void check_conversion(enum AVSampleFormat out_fmt,
+                             enum AVSampleFormat in_fmt, int channels)
+{
+    int in_planar  = av_sample_fmt_is_planar(in_fmt);
+    int out_planar = av_sample_fmt_is_planar(out_fmt);
+    int in_bps  = av_get_bytes_per_sample(in_fmt);
+    int out_bps = av_get_bytes_per_sample(out_fmt);
+    int size = LEN * MAX_CH * 4;
+    LOCAL_ALIGNED_32(uint8_t, src_buf,  [LEN * MAX_CH * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst0_buf, [LEN * MAX_CH * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst1_buf, [LEN * MAX_CH * 4]);
+    uint8_t *src[MAX_CH] = { NULL }, *dst0[MAX_CH] = { NULL }, *dst1[MAX_CH] = { NULL };
+    AudioConvert *ctx;
+    int p;
+
+    declare_func(void, uint8_t **dst, const uint8_t **src, int len);
+
+    ctx = swri_audio_convert_alloc(out_fmt, in_fmt, channels, NULL, 0);
+    if (!ctx) {
+        fail();
+        return;
+    }
+
+    for (p = 0; p < channels; p++) {
+        src[p]  = src_buf  + (in_planar  ? p * LEN * in_bps  : 0);
+        dst0[p] = dst0_buf + (out_planar ? p * LEN * out_bps : 0);
+        dst1[p] = dst1_buf + (out_planar ? p * LEN * out_bps : 0);
+    }
+
+    c_conv.ctx        = ctx;
+    c_conv.in_planar  = in_planar;
+    c_conv.out_planar = out_planar;
+    c_conv.in_bps     = in_bps;
+    c_conv.out_bps    = out_bps;
+
+    if (check_func(ctx->simd_f ? ctx->simd_f : convert_c, "%s_to_%s_%dch",
+                   av_get_sample_fmt_name(in_fmt), av_get_sample_fmt_name(out_fmt),
+                   channels)) {
+        randomize_buffer(src_buf, in_fmt, LEN * channels);
+        memset(dst0_buf, 0, size);
+        memset(dst1_buf, 0, size);
+        CALL(call_ref, dst0, src);
+        CALL(call_new, dst1, src);
+        if (memcmp(dst0_buf, dst1_buf, size))
+            fail();
+        bench_new(dst1, (const uint8_t **)src, LEN);
+    }
+
+    swri_audio_convert_free(&ctx);
+}
+
+void checkasm_check_sw_audio_convert(void)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(conversions); i++)
+        check_conversion(conversions[i].out_fmt, conversions[i].in_fmt,
+                         conversions[i].channels);
+    report("convert");
+}
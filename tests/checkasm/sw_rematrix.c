@@ -0,0 +1,180 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/samplefmt.h"
+
+#include "libswresample/swresample.h"
+#include "libswresample/swresample_internal.h"
+
+#include "checkasm.h"
+
+/* the SIMD versions process multiples of 16 samples from aligned buffers */
+#define LEN 256
+
+static const enum AVSampleFormat formats[] = {
+    AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP,
+};
+
+static void randomize_buffer(uint8_t *buf, enum AVSampleFormat fmt)
+{
+    int i;
+
+    for (i = 0; i < LEN; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: ((int16_t *)buf)[i] = rnd();                           break;
+        case AV_SAMPLE_FMT_S32P: ((int32_t *)buf)[i] = rnd();                           break;
+        case AV_SAMPLE_FMT_FLTP: ((float   *)buf)[i] = (int32_t)rnd() / (float)(1U << 31);  break;
+        case AV_SAMPLE_FMT_DBLP: ((double  *)buf)[i] = (int32_t)rnd() / (double)(1U << 31); break;
+        }
+    }
+}
+
+static int compare_buffers(const uint8_t *dst0, const uint8_t *dst1,
+                           enum AVSampleFormat fmt)
+{
+    int i;
+
+    switch (fmt) {
+    case AV_SAMPLE_FMT_S16P:
+    case AV_SAMPLE_FMT_S32P:
+        return memcmp(dst0, dst1, LEN * av_get_bytes_per_sample(fmt));
+    case AV_SAMPLE_FMT_FLTP:
+        for (i = 0; i < LEN; i++) {
+            const float *a = (const float *)dst0, *b = (const float *)dst1;
+            if (!float_near_abs_eps(a[i], b[i], 4 * FLT_EPSILON)) {
+                fprintf(stderr, "%d: %- .12f != %- .12f\n", i, a[i], b[i]);
+                return 1;
+            }
+        }
+        return 0;
+    case AV_SAMPLE_FMT_DBLP:
+        for (i = 0; i < LEN; i++) {
+            const double *a = (const double *)dst0, *b = (const double *)dst1;
+            if (!double_near_abs_eps(a[i], b[i], 4 * DBL_EPSILON)) {
+                fprintf(stderr, "%d: %- .12f != %- .12f\n", i, a[i], b[i]);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * The SIMD versions get their coefficients from native_simd_matrix, which
+ * has a different layout from the native_matrix of the C versions, so the
+ * reference is always computed with the C function of the context.
+ * Without SIMD, the C function itself is checked and benchmarked.
+ */
+static void check_mix_1_1(SwrContext *s, enum AVSampleFormat fmt)
+{
+    int bps = av_get_bytes_per_sample(fmt);
+    void *matrix = s->mix_1_1_simd ? s->native_simd_matrix : s->native_matrix;
+    LOCAL_ALIGNED_32(uint8_t, src,  [LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [LEN * 8]);
+
+    declare_func(void, void *out, const void *in, void *coeffp,
+                 integer index, integer len);
+
+    if (check_func(s->mix_1_1_simd ? s->mix_1_1_simd : s->mix_1_1_f,
+                   "mix_1_1_%s", av_get_sample_fmt_name(fmt))) {
+        int index;
+
+        randomize_buffer(src, fmt);
+        for (index = 0; index < 4; index++) {
+            memset(dst0, 0, LEN * bps);
+            memset(dst1, 0, LEN * bps);
+            s->mix_1_1_f(dst0, src, s->native_matrix, index, LEN);
+            call_new(dst1, src, matrix, index, LEN);
+            if (compare_buffers(dst0, dst1, fmt))
+                fail();
+        }
+        bench_new(dst1, src, matrix, 0, LEN);
+    }
+}
+
+static void check_mix_2_1(SwrContext *s, enum AVSampleFormat fmt)
+{
+    int bps = av_get_bytes_per_sample(fmt);
+    void *matrix = s->mix_2_1_simd ? s->native_simd_matrix : s->native_matrix;
+    LOCAL_ALIGNED_32(uint8_t, src0, [LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, src1, [LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [LEN * 8]);
+
+    declare_func(void, void *out, const void *in1, const void *in2,
+                 void *coeffp, integer index1, integer index2, integer len);
+
+    if (check_func(s->mix_2_1_simd ? s->mix_2_1_simd : s->mix_2_1_f,
+                   "mix_2_1_%s", av_get_sample_fmt_name(fmt))) {
+        int out_i;
+
+        randomize_buffer(src0, fmt);
+        randomize_buffer(src1, fmt);
+        for (out_i = 0; out_i < 2; out_i++) {
+            memset(dst0, 0, LEN * bps);
+            memset(dst1, 0, LEN * bps);
+            s->mix_2_1_f(dst0, src0, src1, s->native_matrix, 2 * out_i, 2 * out_i + 1, LEN);
+            call_new(dst1, src0, src1, matrix, 2 * out_i, 2 * out_i + 1, LEN);
+            if (compare_buffers(dst0, dst1, fmt))
+                fail();
+        }
+        bench_new(dst1, src0, src1, matrix, 0, 1, LEN);
+    }
+}
+
+void checkasm_check_sw_rematrix(void)
+{
+    int i, j;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++) {
+        enum AVSampleFormat fmt = formats[i];
+        SwrContext *s;
+        double matrix[4];
+
+        s = swr_alloc_set_opts(NULL, AV_CH_LAYOUT_STEREO, fmt, 48000,
+                                     AV_CH_LAYOUT_STEREO, fmt, 48000, 0, NULL);
+        if (!s) {
+            fail();
+            continue;
+        }
+        av_opt_set_sample_fmt(s, "internal_sample_fmt", fmt, 0);
+
+        /* keep the sum of each row below 1, so the output never clips */
+        for (j = 0; j < 4; j++)
+            matrix[j] = ((int)(rnd() % 1801) - 900) / 2000.0;
+        if (swr_set_matrix(s, matrix, 2) < 0 || swr_init(s) < 0) {
+            fail();
+            swr_free(&s);
+            continue;
+        }
+
+        check_mix_1_1(s, fmt);
+        check_mix_2_1(s, fmt);
+        swr_free(&s);
+    }
+    report("mix");
+}
@@ -0,0 +1,206 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/samplefmt.h"
+
+#include "libswresample/resample.h"
+
+#include "checkasm.h"
+
+#define DST_LEN 256
+#define SRC_LEN 4096
+
+static const enum AVSampleFormat formats[] = {
+    AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP,
+};
+
+static const struct {
+    int in_rate, out_rate;
+    int filter_size, phase_shift, exact_rational;
+} configs[] = {
+    { 44100, 48000, 32, 10, 1 },
+    { 48000, 44100, 32, 10, 1 },
+    {  8000, 48000, 16,  8, 0 },
+    { 48000,  8000, 16, 10, 0 },
+    { 22050, 96000, 64, 12, 1 },
+};
+
+static const enum SwrFilterType filter_types[] = {
+    SWR_FILTER_TYPE_CUBIC, SWR_FILTER_TYPE_BLACKMAN_NUTTALL, SWR_FILTER_TYPE_KAISER,
+};
+
+static void randomize_src(uint8_t *src, enum AVSampleFormat fmt)
+{
+    int i;
+
+    for (i = 0; i < SRC_LEN; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P:
+            /* leave headroom, the SIMD versions accumulate in 32 bits */
+            ((int16_t *)src)[i] = (int16_t)rnd() >> 1;
+            break;
+        case AV_SAMPLE_FMT_S32P:
+            ((int32_t *)src)[i] = (int32_t)rnd() >> 1;
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            ((float *)src)[i] = (int32_t)rnd() / (float)(1U << 31);
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            ((double *)src)[i] = (int32_t)rnd() / (double)(1U << 31);
+            break;
+        }
+    }
+}
+
+static int compare_dst(const uint8_t *dst0, const uint8_t *dst1,
+                       enum AVSampleFormat fmt, int filter_length)
+{
+    int i;
+
+    for (i = 0; i < DST_LEN; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: {
+            int a = ((const int16_t *)dst0)[i], b = ((const int16_t *)dst1)[i];
+            /* the linear interpolation may be rounded differently */
+            if (abs(a - b) > 1) {
+                fprintf(stderr, "%d: %d != %d\n", i, a, b);
+                return 1;
+            }
+            break;
+        }
+        case AV_SAMPLE_FMT_S32P: {
+            int64_t a = ((const int32_t *)dst0)[i], b = ((const int32_t *)dst1)[i];
+            if (FFABS(a - b) > 1) {
+                fprintf(stderr, "%d: %"PRId64" != %"PRId64"\n", i, a, b);
+                return 1;
+            }
+            break;
+        }
+        case AV_SAMPLE_FMT_FLTP: {
+            float a = ((const float *)dst0)[i], b = ((const float *)dst1)[i];
+            if (!float_near_abs_eps(a, b, 4 * filter_length * FLT_EPSILON)) {
+                fprintf(stderr, "%d: %- .12f != %- .12f\n", i, a, b);
+                return 1;
+            }
+            break;
+        }
+        case AV_SAMPLE_FMT_DBLP: {
+            double a = ((const double *)dst0)[i], b = ((const double *)dst1)[i];
+            if (!double_near_abs_eps(a, b, 4 * filter_length * DBL_EPSILON)) {
+                fprintf(stderr, "%d: %- .12f != %- .12f\n", i, a, b);
+                return 1;
+            }
+            break;
+        }
+        }
+    }
+    return 0;
+}
+
+static void check_resample(enum AVSampleFormat fmt, int linear)
+{
+    const char *fmt_name = av_get_sample_fmt_name(fmt);
+    int bps = av_get_bytes_per_sample(fmt);
+    uint8_t *src  = av_malloc(SRC_LEN * bps);
+    uint8_t *dst0 = av_malloc(DST_LEN * bps);
+    uint8_t *dst1 = av_malloc(DST_LEN * bps);
+    ResampleContext *probe;
+
+    declare_func(int, ResampleContext *c, void *dst, const void *src,
+                 int n, int update_ctx);
+
+    /* the dsp functions only depend on the format and the cpu flags */
+    probe = swri_resampler.init(NULL, 48000, 44100, 16, 10, linear, 0, fmt,
+                                SWR_FILTER_TYPE_KAISER, 9, 20, 0, 1);
+    if (!src || !dst0 || !dst1 || !probe) {
+        fail();
+        goto end;
+    }
+
+    if (check_func(linear ? probe->dsp.resample_linear : probe->dsp.resample_common,
+                   "resample_%s_%s", linear ? "linear" : "common", fmt_name)) {
+        ResampleContext *bench_ctx = NULL;
+        int c, t, ret0, ret1;
+
+        randomize_src(src, fmt);
+        for (c = 0; c < FF_ARRAY_ELEMS(configs); c++) {
+            for (t = 0; t < FF_ARRAY_ELEMS(filter_types); t++) {
+                ResampleContext *ctx = swri_resampler.init(NULL, configs[c].out_rate, configs[c].in_rate,
+                                                           configs[c].filter_size, configs[c].phase_shift,
+                                                           linear, 0, fmt, filter_types[t], 9, 20, 0,
+                                                           configs[c].exact_rational);
+                ResampleContext ref, new;
+
+                if (!ctx) {
+                    fail();
+                    continue;
+                }
+                ctx->index = rnd() % ctx->phase_count;
+                ctx->frac  = rnd() % ctx->src_incr;
+                ref = new = *ctx;
+
+                memset(dst0, 0, DST_LEN * bps);
+                memset(dst1, 0, DST_LEN * bps);
+                ret0 = call_ref(&ref, dst0, src, DST_LEN, 1);
+                ret1 = call_new(&new, dst1, src, DST_LEN, 1);
+                if (ret0 != ret1 || ref.index != new.index || ref.frac != new.frac ||
+                    compare_dst(dst0, dst1, fmt, ctx->filter_length)) {
+                    fprintf(stderr, "resample %d -> %d, filter type %d: consumed %d/%d, index %d/%d, frac %d/%d\n",
+                            configs[c].in_rate, configs[c].out_rate, filter_types[t],
+                            ret0, ret1, ref.index, new.index, ref.frac, new.frac);
+                    fail();
+                }
+
+                if (!bench_ctx)
+                    bench_ctx = ctx;
+                else
+                    swri_resampler.free(&ctx);
+            }
+        }
+        if (bench_ctx) {
+            ResampleContext new = *bench_ctx;
+            bench_new(&new, dst1, src, DST_LEN, 0);
+            swri_resampler.free(&bench_ctx);
+        }
+    }
+
+end:
+    swri_resampler.free(&probe);
+    av_free(src);
+    av_free(dst0);
+    av_free(dst1);
+}
+
+void checkasm_check_sw_resample(void)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        check_resample(formats[i], 0);
+    report("resample_common");
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        check_resample(formats[i], 1);
+    report("resample_linear");
+}
@@ -0,0 +1,306 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Writes a small model in the native format to the given path, then checks
+ * that the model gives the same output whether its layers are fused at load
+ * time or not, and that the memory planned for its operands is shared by
+ * the operands which are not alive at the same time, and only by them. The
+ * model is written in the current format, whose conv2d kernels are used in
+ * place from the mapping of the file, and in the previous one, whose kernels
+ * are read, and all the outputs must be the same. The model is also used by
+ * the dnn_processing filter test.
+ *
+ * The layers are: a reflect pad and a VALID 3x3 conv2d, which are folded into
+ * one conv2d, a maximum with 0 fused into it as its relu, a SAME 3x3 conv2d
+ * and a multiplication by 0.5 fused into its kernel, and a 1x1 conv2d. The
+ * weights are multiples of 1/16, and scaling them by a power of two is exact,
+ * so both outputs are bit-identical.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "libavutil/intfloat.h"
+#include "libavutil/mem.h"
+#include "libavfilter/dnn/dnn_backend_native.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_conv2d.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_mathbinary.h"
+#include "libavfilter/dnn/dnn_backend_native_layer_pad.h"
+
+#define WIDTH  9
+#define HEIGHT 7
+
+static void put_le32(FILE *f, uint32_t v)
+{
+    uint8_t buf[4] = { v, v >> 8, v >> 16, v >> 24 };
+    fwrite(buf, 1, sizeof(buf), f);
+}
+
+static void put_float(FILE *f, float v)
+{
+    put_le32(f, av_float2int(v));
+}
+
+static void put_conv2d(FILE *f, int aligned, int padding, int input_num, int output_num,
+                       int kernel_size, int seed, int input, int output)
+{
+    int nb_weights = output_num * kernel_size * kernel_size * input_num;
+
+    put_le32(f, DLT_CONV2D);
+    put_le32(f, 1);                 // dilation
+    put_le32(f, padding);
+    put_le32(f, NONE);              // activation
+    put_le32(f, input_num);
+    put_le32(f, output_num);
+    put_le32(f, kernel_size);
+    put_le32(f, 1);                 // has_bias
+    // the kernel is aligned in the file for the mapping
+    while (aligned && ftell(f) % NATIVE_WEIGHT_ALIGN)
+        fputc(0, f);
+    for (int i = 0; i < nb_weights; i++)
+        put_float(f, ((i * 7 + seed) % 17 - 8) / 16.0f);
+    for (int i = 0; i < output_num; i++)
+        put_float(f, ((i * 5 + seed) % 9 - 4) / 16.0f);
+    put_le32(f, input);
+    put_le32(f, output);
+}
+
+static void put_operand(FILE *f, int index, const char *name, DNNOperandType type)
+{
+    put_le32(f, index);
+    put_le32(f, strlen(name));
+    fwrite(name, 1, strlen(name), f);
+    put_le32(f, type);
+    put_le32(f, DNN_FLOAT);
+    put_le32(f, 1);
+    put_le32(f, -1);
+    put_le32(f, -1);
+    put_le32(f, 1);
+}
+
+static int write_model(const char *filename, int aligned)
+{
+    FILE *f = fopen(filename, "wb");
+
+    if (!f)
+        return -1;
+
+    fwrite("FFMPEGDNNNATIVE", 1, 15, f);
+    put_le32(f, 1);
+    put_le32(f, NATIVE_ALIGNED_MINOR_VERSION - !aligned);
+
+    put_le32(f, DLT_MIRROR_PAD);
+    put_le32(f, LPMP_REFLECT);
+    for (int i = 0; i < 4; i++) {
+        put_le32(f, i == 1 || i == 2);
+        put_le32(f, i == 1 || i == 2);
+    }
+    put_le32(f, 0);
+    put_le32(f, 1);
+
+    put_conv2d(f, aligned, VALID, 1, 4, 3, 1, 1, 2);
+
+    put_le32(f, DLT_MAXIMUM);
+    put_float(f, 0.0f);
+    put_le32(f, 2);
+    put_le32(f, 3);
+
+    put_conv2d(f, aligned, SAME, 4, 4, 3, 2, 3, 4);
+
+    put_le32(f, DLT_MATH_BINARY);
+    put_le32(f, DMBO_MUL);
+    put_le32(f, 0);
+    put_le32(f, 4);
+    put_le32(f, 1);
+    put_float(f, 0.5f);
+    put_le32(f, 5);
+
+    put_conv2d(f, aligned, SAME, 4, 1, 1, 3, 5, 6);
+
+    put_operand(f, 0, "x",     DOT_INPUT);
+    put_operand(f, 1, "pad",   DOT_INTERMEDIATE);
+    put_operand(f, 2, "conv1", DOT_INTERMEDIATE);
+    put_operand(f, 3, "relu",  DOT_INTERMEDIATE);
+    put_operand(f, 4, "conv2", DOT_INTERMEDIATE);
+    put_operand(f, 5, "mul",   DOT_INTERMEDIATE);
+    put_operand(f, 6, "y",     DOT_OUTPUT);
+
+    put_le32(f, 6);                 // layers_num
+    put_le32(f, 7);                 // operands_num
+
+    return fclose(f) ? -1 : 0;
+}
+
+// Returns 0 if the operands alive at the same time have disjoint buffers and
+// at least two operands share a slot of the arena.
+static int check_arena(const ConvolutionalNetwork *network, const char *options)
+{
+    const int32_t *lengths = network->ctx.planned_lengths;
+    int shared = 0;
+
+    if (!lengths || !network->arena) {
+        printf("no memory plan with %s\n", options);
+        return 1;
+    }
+
+    for (int32_t i = 0; i < network->operands_num; i++) {
+        const uint8_t *a = network->operands[i].data;
+
+        if (lengths[i] < 0)
+            continue;
+        for (int32_t j = i + 1; j < network->operands_num; j++) {
+            const uint8_t *b = network->operands[j].data;
+            int alive = network->operand_first[i] <= network->operand_last[j] &&
+                        network->operand_first[j] <= network->operand_last[i];
+
+            if (lengths[j] < 0 || a >= b + lengths[j] || b >= a + lengths[i])
+                continue;
+            if (alive) {
+                printf("operands %d and %d overlap while alive with %s\n", i, j, options);
+                return 1;
+            }
+            shared = 1;
+        }
+    }
+
+    if (!shared) {
+        printf("no arena slot is reused with %s\n", options);
+        return 1;
+    }
+    return 0;
+}
+
+static float *run_model(const char *filename, const char *options, int expected_layers,
+                        int expected_mapped)
+{
+    DNNModel *model = ff_dnn_load_model_native(filename, options);
+    ConvolutionalNetwork *network;
+    const char *output_name = "y";
+    DNNData input, output;
+    float *result = NULL;
+    int nb_mapped = 0;
+
+    if (!model) {
+        printf("could not load the model with %s\n", options);
+        return NULL;
+    }
+    network = model->model;
+    if (network->layers_num != expected_layers) {
+        printf("%d layers with %s, expected %d\n", network->layers_num, options, expected_layers);
+        goto end;
+    }
+    for (int32_t i = 0; i < network->layers_num; i++) {
+        const Layer *layer = &network->layers[i];
+        if (layer->type == DLT_CONV2D)
+            nb_mapped += ((const ConvolutionalParams *)layer->params)->kernel_mapped;
+    }
+    if (nb_mapped != expected_mapped) {
+        printf("%d mapped kernels with %s, expected %d\n", nb_mapped, options, expected_mapped);
+        goto end;
+    }
+
+    input.width    = WIDTH;
+    input.height   = HEIGHT;
+    input.channels = 1;
+    input.dt       = DNN_FLOAT;
+    if (model->set_input_output(network, &input, "x", &output_name, 1) != DNN_SUCCESS) {
+        printf("could not set the input and output with %s\n", options);
+        goto end;
+    }
+
+    // the second execution runs on the planned memory
+    for (int run = 0; run < 2; run++) {
+        for (int i = 0; i < WIDTH * HEIGHT; i++)
+            ((float *)input.data)[i] = (i * 11 % 32) / 32.0f;
+        if (ff_dnn_execute_model_native(model, &output, 1) != DNN_SUCCESS) {
+            printf("could not execute the model with %s\n", options);
+            av_freep(&result);
+            goto end;
+        }
+        if (output.width != WIDTH || output.height != HEIGHT || output.channels != 1) {
+            printf("output is %dx%dx%d with %s\n", output.width, output.height,
+                   output.channels, options);
+            av_freep(&result);
+            goto end;
+        }
+        if (result && memcmp(result, output.data, WIDTH * HEIGHT * sizeof(float))) {
+            printf("the second execution differs with %s\n", options);
+            av_freep(&result);
+            goto end;
+        }
+        if (!result)
+            result = av_memdup(output.data, WIDTH * HEIGHT * sizeof(float));
+        if (!result)
+            goto end;
+    }
+
+    if (check_arena(network, options))
+        av_freep(&result);
+
+end:
+    ff_dnn_free_model_native(&model);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    // the kernels are only used in place on little-endian systems,
+    // and the one scaled by the fusion is copied
+    int mapped = !HAVE_BIGENDIAN;
+    float *outputs[4] = { NULL };
+    int ret = 1;
+
+    if (argc < 2) {
+        printf("usage: %s model\n", argv[0]);
+        return 1;
+    }
+
+    // the model is left in the current format for the filter test
+    for (int aligned = 0; aligned < 2; aligned++) {
+        const char *format = aligned ? "the current format" : "the previous format";
+
+        if (write_model(argv[1], aligned) < 0) {
+            printf("could not write %s\n", argv[1]);
+            goto end;
+        }
+        outputs[2 * aligned]     = run_model(argv[1], "optimize=0", 6, aligned ? 3 * mapped : 0);
+        outputs[2 * aligned + 1] = run_model(argv[1], "optimize=1", 3, aligned ? 2 * mapped : 0);
+        if (!outputs[2 * aligned] || !outputs[2 * aligned + 1]) {
+            printf("the model failed in %s\n", format);
+            goto end;
+        }
+    }
+
+    ret = 0;
+    for (int j = 1; j < 4 && !ret; j++) {
+        for (int i = 0; i < WIDTH * HEIGHT; i++) {
+            if (outputs[j][i] != outputs[0][i]) {
+                printf("run %d at index %d, output: %f, expected_output: %f\n",
+                       j, i, outputs[j][i], outputs[0][i]);
+                ret = 1;
+                break;
+            }
+        }
+    }
+
+end:
+    for (int j = 0; j < 4; j++)
+        av_free(outputs[j]);
+    return ret;
+}
@@ -371,6 +371,26 @@ refcmp_metadata(){
         -f null /dev/null | awk -v ref=${ref} -v fuzz=${fuzz} -f ${base}/refcmp-metadata.awk -
 }
 
+dnn_processing_optimize(){
+    model="${outdir}/${test}.model"
+    cleanfiles="$cleanfiles $model ${outdir}/${test}.0 ${outdir}/${test}.1"
+    run tests/dnn/dnn-native-model-test${EXECSUF} $(target_path $model) || return
+    for optimize in 0 1; do
+        framemd5 -f lavfi -i testsrc2=size=64x48:rate=5:duration=1,format=yuv420p \
+            -vf dnn_processing=dnn_backend=native:model=$(target_path $model):input=x:output=y:backend_configs=optimize=$optimize \
+            > ${outdir}/${test}.$optimize || return
+    done
+    # the fused layers must not change the output
+    cmp ${outdir}/${test}.0 ${outdir}/${test}.1
+}
+
+loudnorm_measure(){
+    # the measurements are logged once the whole input was read, a zero
+    # target offset may be printed with either sign
+    ffmpeg -i $1 -af loudnorm=measure=1:print_format=json -f null - 2>&1 |
+        sed -n -e 's/"-0\.00"/"0.00"/' -e '/^{/,/^}/p'
+}
+
 pixfmt_conversion(){
     conversion="${test#pixfmt-}"
     outdir="tests/data/pixfmt"
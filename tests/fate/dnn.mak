@@ -28,6 +28,17 @@ fate-dnn-layer-mathunary: $(DNNTESTSDIR)/dnn-layer-mathunary-test$(EXESUF)
 fate-dnn-layer-mathunary: CMD = run $(DNNTESTSDIR)/dnn-layer-mathunary-test$(EXESUF)
 fate-dnn-layer-mathunary: CMP = null
 
+FATE_DNN += fate-dnn-native-model
+fate-dnn-native-model: $(DNNTESTSDIR)/dnn-native-model-test$(EXESUF)
+fate-dnn-native-model: CMD = run $(DNNTESTSDIR)/dnn-native-model-test$(EXESUF) $(TARGET_PATH)/tests/data/fate/dnn-native-model.model
+fate-dnn-native-model: CMP = null
+
+FATE_DNN_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER DNN_PROCESSING_FILTER) += fate-dnn-processing-optimize
+fate-dnn-processing-optimize: $(DNNTESTSDIR)/dnn-native-model-test$(EXESUF)
+fate-dnn-processing-optimize: CMD = dnn_processing_optimize
+fate-dnn-processing-optimize: CMP = null
+
 FATE-yes += $(FATE_DNN)
+FATE_FFMPEG += $(FATE_DNN_FFMPEG-yes)
 
-fate-dnn: $(FATE_DNN)
+fate-dnn: $(FATE_DNN) $(FATE_DNN_FFMPEG-yes)
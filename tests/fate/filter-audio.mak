@@ -300,6 +300,11 @@ fate-filter-join: CMD = md5 -i $(SRC1) -i $(SRC2) -filter_complex join=channel_l
 fate-filter-join: CMP = oneline
 fate-filter-join: REF = 88b0d24a64717ba8635b29e8dac6ecd8
 
+FATE_AFILTER-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER LOUDNORM_FILTER NULL_MUXER) += fate-filter-loudnorm-measure
+fate-filter-loudnorm-measure: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-filter-loudnorm-measure: tests/data/asynth-44100-2.wav
+fate-filter-loudnorm-measure: CMD = loudnorm_measure $(SRC)
+
 FATE_AFILTER-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER PCM_S16LE_ENCODER PCM_S16LE_MUXER APERMS_FILTER VOLUME_FILTER) += fate-filter-volume
 fate-filter-volume: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
 fate-filter-volume: tests/data/asynth-44100-2.wav
@@ -445,6 +445,21 @@ fate-filter-concat: CMD = framecrc -filter_complex_script $(TARGET_PATH)/tests/d
 fate-filter-concat-vfr: tests/data/filtergraphs/concat-vfr
 fate-filter-concat-vfr: CMD = framecrc -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/concat-vfr
 
+SCALE_MULTI_SRC = testsrc=s=640x480:r=5:d=1,format=yuv420p
+SCALE_MULTI_SIZES = 320x240|160x120|80x60
+
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER SCALE_MULTI_FILTER) += fate-filter-scale-multi fate-filter-scale-multi-cascade
+fate-filter-scale-multi: CMD = framecrc -lavfi "$(SCALE_MULTI_SRC),scale_multi=sizes=$(SCALE_MULTI_SIZES):cascade=0"
+fate-filter-scale-multi-cascade: CMD = framecrc -lavfi "$(SCALE_MULTI_SRC),scale_multi=sizes=$(SCALE_MULTI_SIZES):cascade=1"
+
+# without cascading, scale_multi must match one scale filter per output
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER FORMAT_FILTER SPLIT_FILTER SCALE_FILTER SCALE_MULTI_FILTER) += fate-filter-scale-multi-split
+fate-filter-scale-multi-split: CMD = framecrc -lavfi "$(SCALE_MULTI_SRC),split=3[a][b][c];[a]scale=320x240:flags=bilinear;[b]scale=160x120:flags=bilinear;[c]scale=80x60:flags=bilinear"
+fate-filter-scale-multi-split: REF = $(SRC_PATH)/tests/ref/fate/filter-scale-multi
+
+FATE_FILTER-$(call ALLYES, TESTSRC_FILTER SPLIT_FILTER HFLIP_FILTER NEGATE_FILTER OVERLAY_FILTER FPS_FILTER) += fate-filter-pipeline-threads
+fate-filter-pipeline-threads: CMD = framecrc -filter_pipeline_threads 3 -lavfi "testsrc=r=5:d=2,split[a][b];[a]hflip[c];[b]negate[d];[c][d]overlay=x=W/4,fps=7"
+
 FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER FPS_FILTER MPDECIMATE_FILTER) += fate-filter-mpdecimate
 fate-filter-mpdecimate: CMD = framecrc -lavfi testsrc2=r=2:d=10,fps=3,mpdecimate -r 3 -pix_fmt yuv420p
 
@@ -855,6 +870,15 @@ fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) QUALITY_FILTER) += fate-filter-refcmp-quality-rgb
+fate-filter-refcmp-quality-rgb: CMD = refcmp_metadata quality=metrics=psnr+ssim rgb24 0.015
+
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) QUALITY_FILTER) += fate-filter-refcmp-quality-yuv
+fate-filter-refcmp-quality-yuv: CMD = refcmp_metadata quality=metrics=psnr+ssim yuv422p 0.015
+
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) QUALITY_FILTER) += fate-filter-refcmp-quality-vmafmotion
+fate-filter-refcmp-quality-vmafmotion: CMD = refcmp_metadata quality=metrics=vmafmotion yuv420p 0.015
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
@@ -254,6 +254,8 @@ fate-vsynth%-mpeg1b:             FMT     = mpeg1video
 
 FATE_MPEG2 = mpeg2                                                      \
              mpeg2-422                                                  \
+             mpeg2-bstrat                                               \
+             mpeg2-bstrat-thread                                        \
              mpeg2-idct-int                                             \
              mpeg2-ilace                                                \
              mpeg2-ivlc-qprd                                            \
@@ -274,6 +276,8 @@ fate-vsynth%-mpeg2-422:          ENCOPTS = -b:v 1000k                   \
                                            -intra_vlc 1                 \
                                            -mbd rd                      \
                                            -pix_fmt yuv422p
+fate-vsynth%-mpeg2-bstrat:       ENCOPTS = -qscale 10 -bf 2 -b_strategy 2
+fate-vsynth%-mpeg2-bstrat-thread: ENCOPTS = -qscale 10 -bf 2 -b_strategy 2 -threads 4 -slices 1
 fate-vsynth%-mpeg2-idct-int:     ENCOPTS = -qscale 10 -idct int -dct int
 fate-vsynth%-mpeg2-ilace:        ENCOPTS = -qscale 10 -flags +ildct+ilme
 fate-vsynth%-mpeg2-ivlc-qprd:    ENCOPTS = -b:v 500k                    \
@@ -463,7 +467,10 @@ FATE_VCODEC-$(call ENCDEC, ZLIB, AVI) += zlib
 FATE_VCODEC += $(FATE_VCODEC-yes)
 FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
-FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
+# No references yet, they can only be generated with the FATE samples
+VSYNTH_LENA_OFF = mpeg2-bstrat mpeg2-bstrat-thread
+FATE_VCODEC_LENA = $(filter-out $(VSYNTH_LENA_OFF),$(FATE_VCODEC))
+FATE_VSYNTH_LENA = $(FATE_VCODEC_LENA:%=fate-vsynth_lena-%)
 # Redundant tests because they just resize the input
 RESIZE_OFF   = dnxhd-720p dnxhd-720p-rd dnxhd-720p-10bit dnxhd-1080i \
                dv dv-411 dv-50 avui snow snow-hpel snow-ll vc2-420p \
@@ -0,0 +1,1471 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Whole-component throughput benchmarks: decoders, filters, swscale,
+ * swresample, the DNN backends and (de)muxers, run on synthetic input and
+ * written as JSON. Built and run by "make bench".
+ *
+ * Every benchmark runs its workload -r times and reports the fastest run,
+ * setup (opening codecs, configuring graphs, encoding the decoder input)
+ * is not timed.
+ */
+
+#include "config.h"
+#if HAVE_UNISTD_H
+#include <unistd.h>             /* getopt */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
+#include "libavutil/file.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libswresample/swresample.h"
+#include "libswscale/swscale.h"
+
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define MAX_THREADS     16
+#define MAX_MODELS      16
+#define SAMPLE_RATE     48000
+#define AUDIO_FRAME     1024
+#define DNN_MAX_FRAMES  10
+#define MUX_MIN_SIZE    (32 << 20)
+#define IO_BUFFER_SIZE  32768
+
+typedef struct BenchContext {
+    FILE *out;
+    int nb_results;
+    const char *groups;
+    const char *pattern;
+    int width, height;
+    int nb_frames;
+    int runs;
+    int threads[MAX_THREADS];
+    int nb_threads;
+    const char *models[MAX_MODELS];
+    int nb_models;
+    char *native_model;
+
+    AVFrame **video;    ///< the synthetic yuv420p source
+    AVFrame **audio;    ///< the synthetic fltp stereo source
+    int nb_audio;
+} BenchContext;
+
+typedef struct BenchResult {
+    const char *group;
+    char name[256];
+    int threads;
+    int64_t frames;     ///< frames (or packets) processed by one run
+    int64_t bytes;      ///< bytes processed by one run, 0 if meaningless
+    int64_t time;       ///< fastest run, in microseconds
+} BenchResult;
+
+static int group_enabled(const BenchContext *bc, const char *group)
+{
+    const char *p = bc->groups;
+    size_t len = strlen(group);
+
+    if (!p)
+        return 1;
+    while ((p = strstr(p, group))) {
+        if ((p == bc->groups || p[-1] == ',') && (!p[len] || p[len] == ','))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+static int name_enabled(const BenchContext *bc, const char *name)
+{
+    return !bc->pattern || strstr(name, bc->pattern);
+}
+
+static void print_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(out, "\\u%04x", *s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void report(BenchContext *bc, const BenchResult *res)
+{
+    double seconds = FFMAX(res->time, 1) / 1000000.0;
+    double fps     = res->frames / seconds;
+    double mbps    = res->bytes  / seconds / (1 << 20);
+
+    fprintf(bc->out, "%s\n        { \"group\": ", bc->nb_results ? "," : "");
+    print_json_string(bc->out, res->group);
+    fprintf(bc->out, ", \"name\": ");
+    print_json_string(bc->out, res->name);
+    fprintf(bc->out, ", \"threads\": %d, \"frames\": %"PRId64", \"bytes\": %"PRId64
+            ", \"seconds\": %.6f, \"fps\": %.2f, \"mb_per_s\": %.2f }",
+            res->threads, res->frames, res->bytes, seconds, fps, mbps);
+    fflush(bc->out);
+    bc->nb_results++;
+
+    fprintf(stderr, "%-7s %-48s %2d threads %10.2f fps %10.2f MB/s\n",
+            res->group, res->name, res->threads, fps, mbps);
+}
+
+static void report_error(const BenchResult *res, int err)
+{
+    av_log(NULL, AV_LOG_ERROR, "%s %s with %d threads failed: %s\n",
+           res->group, res->name, res->threads, av_err2str(err));
+}
+
+/**
+ * Keep the fastest of the runs, start is the av_gettime_relative() value
+ * taken when the run started.
+ */
+static void update_time(BenchResult *res, int64_t start)
+{
+    int64_t t = av_gettime_relative() - start;
+    if (!res->time || t < res->time)
+        res->time = t;
+}
+
+/* Synthetic input */
+
+static AVFrame *alloc_video_frame(enum AVPixelFormat pix_fmt, int width, int height)
+{
+    AVFrame *frame = av_frame_alloc();
+
+    if (!frame)
+        return NULL;
+    frame->format = pix_fmt;
+    frame->width  = width;
+    frame->height = height;
+    frame->sample_aspect_ratio = (AVRational){ 1, 1 };
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+/**
+ * A moving pattern with some noise on top, so that the encoders neither
+ * collapse it to nothing nor see pure noise.
+ */
+static void fill_video_frame(AVFrame *frame, int idx, AVLFG *lfg)
+{
+    for (int y = 0; y < frame->height; y++) {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; x++) {
+            int v = ((x + 2 * idx) ^ (y + idx)) + (x * y >> 10);
+            row[x] = v + (av_lfg_get(lfg) & 7);
+        }
+    }
+    for (int p = 1; p < 3; p++) {
+        for (int y = 0; y < AV_CEIL_RSHIFT(frame->height, 1); y++) {
+            uint8_t *row = frame->data[p] + y * frame->linesize[p];
+            for (int x = 0; x < AV_CEIL_RSHIFT(frame->width, 1); x++)
+                row[x] = 128 + ((p == 1 ? x : y) + idx) % 64 - 32;
+        }
+    }
+}
+
+static void fill_audio_frame(AVFrame *frame, int64_t offset, AVLFG *lfg)
+{
+    enum AVSampleFormat fmt = av_get_packed_sample_fmt(frame->format);
+    int planar   = av_sample_fmt_is_planar(frame->format);
+    int channels = frame->channels;
+
+    for (int i = 0; i < frame->nb_samples; i++) {
+        int64_t t = offset + i;
+        for (int ch = 0; ch < channels; ch++) {
+            /* a chirp per channel, with a little noise */
+            double f = 200.0 * (ch + 1) + (t % SAMPLE_RATE) / 10.0;
+            double v = 0.5 * sin(2 * M_PI * f * t / SAMPLE_RATE) +
+                       ((int)(av_lfg_get(lfg) & 0xFF) - 128) / 4096.0;
+            int idx = planar ? i : i * channels + ch;
+            uint8_t *dst = frame->extended_data[planar ? ch : 0];
+
+            switch (fmt) {
+            case AV_SAMPLE_FMT_U8:  dst[idx] = 128 + lrint(v * 127); break;
+            case AV_SAMPLE_FMT_S16: ((int16_t *)dst)[idx] = lrint(v * 32767); break;
+            case AV_SAMPLE_FMT_S32: ((int32_t *)dst)[idx] = lrint(v * 2147483647.0); break;
+            case AV_SAMPLE_FMT_FLT: ((float   *)dst)[idx] = v; break;
+            case AV_SAMPLE_FMT_DBL: ((double  *)dst)[idx] = v; break;
+            default: break;
+            }
+        }
+    }
+}
+
+static AVFrame *alloc_audio_frame(enum AVSampleFormat fmt, uint64_t layout,
+                                  int nb_samples)
+{
+    AVFrame *frame = av_frame_alloc();
+
+    if (!frame)
+        return NULL;
+    frame->format         = fmt;
+    frame->channel_layout = layout;
+    frame->channels       = av_get_channel_layout_nb_channels(layout);
+    frame->sample_rate    = SAMPLE_RATE;
+    frame->nb_samples     = nb_samples;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
+static void free_frames(AVFrame ***frames, int nb_frames)
+{
+    if (!*frames)
+        return;
+    for (int i = 0; i < nb_frames; i++)
+        av_frame_free(&(*frames)[i]);
+    av_freep(frames);
+}
+
+static int init_sources(BenchContext *bc)
+{
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0x46464246);
+
+    bc->video = av_calloc(bc->nb_frames, sizeof(*bc->video));
+    if (!bc->video)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < bc->nb_frames; i++) {
+        bc->video[i] = alloc_video_frame(AV_PIX_FMT_YUV420P, bc->width, bc->height);
+        if (!bc->video[i])
+            return AVERROR(ENOMEM);
+        fill_video_frame(bc->video[i], i, &lfg);
+        bc->video[i]->pts = i;
+    }
+
+    /* as long as the video, at 25 fps */
+    bc->nb_audio = av_rescale(bc->nb_frames, SAMPLE_RATE, 25 * AUDIO_FRAME);
+    bc->nb_audio = FFMAX(bc->nb_audio, 1);
+    bc->audio = av_calloc(bc->nb_audio, sizeof(*bc->audio));
+    if (!bc->audio)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < bc->nb_audio; i++) {
+        bc->audio[i] = alloc_audio_frame(AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_STEREO,
+                                         AUDIO_FRAME);
+        if (!bc->audio[i])
+            return AVERROR(ENOMEM);
+        fill_audio_frame(bc->audio[i], (int64_t)i * AUDIO_FRAME, &lfg);
+        bc->audio[i]->pts = (int64_t)i * AUDIO_FRAME;
+    }
+    return 0;
+}
+
+/**
+ * Convert the synthetic video to another format and size, frames must be
+ * freed with free_frames().
+ */
+static int convert_video(const BenchContext *bc, AVFrame ***out,
+                         enum AVPixelFormat pix_fmt, int width, int height)
+{
+    struct SwsContext *sws;
+    int ret = 0;
+
+    sws = sws_getContext(bc->width, bc->height, AV_PIX_FMT_YUV420P,
+                         width, height, pix_fmt, SWS_BICUBIC, NULL, NULL, NULL);
+    *out = av_calloc(bc->nb_frames, sizeof(**out));
+    if (!sws || !*out) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < bc->nb_frames; i++) {
+        const AVFrame *src = bc->video[i];
+        AVFrame *dst = (*out)[i] = alloc_video_frame(pix_fmt, width, height);
+        if (!dst) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        sws_scale(sws, (const uint8_t * const *)src->data, src->linesize,
+                  0, src->height, dst->data, dst->linesize);
+        dst->pts = src->pts;
+    }
+
+end:
+    sws_freeContext(sws);
+    return ret;
+}
+
+/* Decoders */
+
+typedef struct CodecBench {
+    const char *encoder;
+    const char *decoder;
+    int format;                 ///< pixel or sample format of the encoder input
+    const char *options;        ///< encoder options
+} CodecBench;
+
+static const CodecBench codec_benches[] = {
+    { "mpeg2video", "mpeg2video", AV_PIX_FMT_YUV420P,     "b=8M:g=12:bf=2" },
+    { "mpeg4",      "mpeg4",      AV_PIX_FMT_YUV420P,     "b=4M:g=12:bf=2" },
+    { "mjpeg",      "mjpeg",      AV_PIX_FMT_YUVJ420P,    "b=30M" },
+    { "ffv1",       "ffv1",       AV_PIX_FMT_YUV420P,     "level=3:slices=16" },
+    { "huffyuv",    "huffyuv",    AV_PIX_FMT_YUV422P,     "pred=median" },
+    { "prores_ks",  "prores",     AV_PIX_FMT_YUV422P10,   "profile=2" },
+    { "dnxhd",      "dnxhd",      AV_PIX_FMT_YUV422P,     "profile=dnxhr_sq" },
+    { "aac",        "aac",        AV_SAMPLE_FMT_FLTP,     "b=192k" },
+    { "ac3",        "ac3",        AV_SAMPLE_FMT_FLTP,     "b=448k" },
+    { "mp2",        "mp2",        AV_SAMPLE_FMT_S16,      "b=384k" },
+    { "flac",       "flac",       AV_SAMPLE_FMT_S16,      NULL },
+    { "alac",       "alac",       AV_SAMPLE_FMT_S16P,     NULL },
+};
+
+typedef struct PacketList {
+    AVPacket **pkts;
+    int nb_pkts;
+    int64_t bytes;
+} PacketList;
+
+static void free_packets(PacketList *list)
+{
+    for (int i = 0; i < list->nb_pkts; i++)
+        av_packet_free(&list->pkts[i]);
+    av_freep(&list->pkts);
+    list->nb_pkts = 0;
+    list->bytes   = 0;
+}
+
+static int receive_packets(AVCodecContext *enc, PacketList *list)
+{
+    int ret;
+
+    for (;;) {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt)
+            return AVERROR(ENOMEM);
+        ret = avcodec_receive_packet(enc, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+        }
+        ret = av_dynarray_add_nofree(&list->pkts, &list->nb_pkts, pkt);
+        if (ret < 0) {
+            av_packet_free(&pkt);
+            return ret;
+        }
+        list->bytes += pkt->size;
+    }
+}
+
+/**
+ * Encode the synthetic source with cb's encoder. On success, *penc is the
+ * still open encoder, so that its parameters can be passed on.
+ */
+static int encode_source(const BenchContext *bc, const CodecBench *cb,
+                         AVCodecContext **penc, PacketList *list)
+{
+    const AVCodec *codec = avcodec_find_encoder_by_name(cb->encoder);
+    AVDictionary *opts = NULL;
+    AVCodecContext *enc;
+    AVFrame **frames = NULL, *frame = NULL;
+    int nb_frames = 0, ret;
+
+    enc = avcodec_alloc_context3(codec);
+    if (!enc)
+        return AVERROR(ENOMEM);
+
+    if (codec->type == AVMEDIA_TYPE_VIDEO) {
+        enc->pix_fmt   = cb->format;
+        enc->width     = bc->width;
+        enc->height    = bc->height;
+        enc->time_base = (AVRational){ 1, 25 };
+        enc->framerate = (AVRational){ 25, 1 };
+        enc->sample_aspect_ratio = (AVRational){ 1, 1 };
+    } else {
+        enc->sample_fmt     = cb->format;
+        enc->sample_rate    = SAMPLE_RATE;
+        enc->channel_layout = AV_CH_LAYOUT_STEREO;
+        enc->channels       = 2;
+        enc->time_base      = (AVRational){ 1, SAMPLE_RATE };
+    }
+    if (cb->options)
+        av_dict_parse_string(&opts, cb->options, "=", ":", 0);
+    ret = avcodec_open2(enc, codec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    if (codec->type == AVMEDIA_TYPE_VIDEO) {
+        ret = convert_video(bc, &frames, enc->pix_fmt, enc->width, enc->height);
+        if (ret < 0)
+            goto end;
+        nb_frames = bc->nb_frames;
+        for (int i = 0; i < nb_frames && ret >= 0; i++) {
+            ret = avcodec_send_frame(enc, frames[i]);
+            if (ret >= 0)
+                ret = receive_packets(enc, list);
+        }
+    } else {
+        int frame_size = enc->frame_size ? enc->frame_size : AUDIO_FRAME;
+        int64_t total  = (int64_t)bc->nb_audio * AUDIO_FRAME;
+        AVLFG lfg;
+
+        av_lfg_init(&lfg, 0x46464246);
+        for (int64_t pos = 0; pos < total && ret >= 0; pos += frame_size) {
+            frame = alloc_audio_frame(enc->sample_fmt, enc->channel_layout,
+                                      FFMIN(frame_size, total - pos));
+            if (!frame) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            fill_audio_frame(frame, pos, &lfg);
+            frame->pts = pos;
+            ret = avcodec_send_frame(enc, frame);
+            if (ret >= 0)
+                ret = receive_packets(enc, list);
+            av_frame_free(&frame);
+        }
+    }
+    if (ret < 0)
+        goto end;
+    ret = avcodec_send_frame(enc, NULL);
+    if (ret >= 0)
+        ret = receive_packets(enc, list);
+
+end:
+    free_frames(&frames, nb_frames);
+    if (ret < 0) {
+        avcodec_free_context(&enc);
+        free_packets(list);
+    }
+    *penc = enc;
+    return ret;
+}
+
+static int decode_packets(AVCodecContext *dec, AVFrame *frame, const PacketList *list)
+{
+    int ret;
+
+    for (int i = 0; i <= list->nb_pkts; i++) {
+        ret = avcodec_send_packet(dec, i < list->nb_pkts ? list->pkts[i] : NULL);
+        if (ret < 0)
+            return ret;
+        while ((ret = avcodec_receive_frame(dec, frame)) >= 0)
+            av_frame_unref(frame);
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            return ret;
+    }
+    return 0;
+}
+
+static void bench_decode(BenchContext *bc)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(codec_benches); i++) {
+        const CodecBench *cb = &codec_benches[i];
+        const AVCodec *codec = avcodec_find_decoder_by_name(cb->decoder);
+        AVCodecContext *enc = NULL;
+        AVCodecParameters *par = NULL;
+        AVFrame *frame = NULL;
+        PacketList list = { 0 };
+        int ret;
+
+        if (!codec || !avcodec_find_encoder_by_name(cb->encoder) ||
+            !name_enabled(bc, cb->decoder))
+            continue;
+
+        ret = encode_source(bc, cb, &enc, &list);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Encoding with %s failed: %s\n",
+                   cb->encoder, av_err2str(ret));
+            continue;
+        }
+        frame = av_frame_alloc();
+        par   = avcodec_parameters_alloc();
+        if (!frame || !par || avcodec_parameters_from_context(par, enc) < 0)
+            goto next;
+
+        for (int t = 0; t < bc->nb_threads; t++) {
+            BenchResult res = {
+                .group   = "decode",
+                .threads = bc->threads[t],
+                .frames  = list.nb_pkts,
+                .bytes   = list.bytes,
+            };
+            av_strlcpy(res.name, cb->decoder, sizeof(res.name));
+
+            if (codec->type == AVMEDIA_TYPE_AUDIO && t)
+                break;
+            if (codec->type == AVMEDIA_TYPE_AUDIO)
+                res.threads = 1;
+
+            for (int r = 0; r < bc->runs; r++) {
+                AVCodecContext *dec = avcodec_alloc_context3(codec);
+                int64_t start;
+
+                if (!dec) {
+                    ret = AVERROR(ENOMEM);
+                    break;
+                }
+                ret = avcodec_parameters_to_context(dec, par);
+                if (ret < 0) {
+                    avcodec_free_context(&dec);
+                    break;
+                }
+                dec->thread_count = res.threads;
+                ret = avcodec_open2(dec, codec, NULL);
+                if (ret >= 0) {
+                    start = av_gettime_relative();
+                    ret = decode_packets(dec, frame, &list);
+                    update_time(&res, start);
+                }
+                avcodec_free_context(&dec);
+                if (ret < 0)
+                    break;
+            }
+            if (ret < 0)
+                report_error(&res, ret);
+            else
+                report(bc, &res);
+        }
+
+next:
+        avcodec_parameters_free(&par);
+        av_frame_free(&frame);
+        avcodec_free_context(&enc);
+        free_packets(&list);
+    }
+}
+
+/* Filters and DNN */
+
+typedef struct FilterBench {
+    enum AVMediaType type;
+    const char *graph;
+} FilterBench;
+
+static const FilterBench filter_benches[] = {
+    { AVMEDIA_TYPE_VIDEO, "hflip" },
+    { AVMEDIA_TYPE_VIDEO, "transpose=clock" },
+    { AVMEDIA_TYPE_VIDEO, "crop=iw/2:ih/2,pad=iw*2:ih*2" },
+    { AVMEDIA_TYPE_VIDEO, "lut=y=negval" },
+    { AVMEDIA_TYPE_VIDEO, "eq=contrast=1.2:brightness=0.05" },
+    { AVMEDIA_TYPE_VIDEO, "boxblur=5" },
+    { AVMEDIA_TYPE_VIDEO, "gblur=sigma=4" },
+    { AVMEDIA_TYPE_VIDEO, "unsharp" },
+    { AVMEDIA_TYPE_VIDEO, "hqdn3d" },
+    { AVMEDIA_TYPE_VIDEO, "yadif" },
+    { AVMEDIA_TYPE_VIDEO, "bwdif" },
+    { AVMEDIA_TYPE_VIDEO, "edgedetect" },
+    { AVMEDIA_TYPE_VIDEO, "tblend=all_mode=average" },
+    { AVMEDIA_TYPE_VIDEO, "colorspace=all=bt709:iall=bt601-6-625:fast=1" },
+    { AVMEDIA_TYPE_VIDEO, "format=rgb24" },
+    { AVMEDIA_TYPE_AUDIO, "volume=0.5" },
+    { AVMEDIA_TYPE_AUDIO, "aresample=44100" },
+    { AVMEDIA_TYPE_AUDIO, "atempo=1.25" },
+    { AVMEDIA_TYPE_AUDIO, "highpass=f=200" },
+    { AVMEDIA_TYPE_AUDIO, "equalizer=f=1000:t=q:w=1:g=5" },
+    { AVMEDIA_TYPE_AUDIO, "aecho=0.8:0.9:40:0.5" },
+    { AVMEDIA_TYPE_AUDIO, "compand" },
+    { AVMEDIA_TYPE_AUDIO, "dynaudnorm" },
+};
+
+/**
+ * Check that all the filters named in desc exist, so that benchmarks of
+ * filters which are not built are skipped quietly.
+ */
+static int graph_available(const char *desc)
+{
+    char name[64];
+
+    while (*desc) {
+        size_t len = strcspn(desc, "=,");
+        av_strlcpy(name, desc, FFMIN(len + 1, sizeof(name)));
+        if (!avfilter_get_by_name(name))
+            return 0;
+        desc += len;
+        desc += strcspn(desc, ",");
+        desc += !!*desc;
+    }
+    return 1;
+}
+
+static int init_graph(AVFilterGraph **pgraph, AVFilterContext **psrc,
+                      AVFilterContext **psink, const AVFrame *first,
+                      enum AVMediaType type, const char *desc, int threads)
+{
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    char args[256];
+    int ret;
+
+    if (!graph)
+        return AVERROR(ENOMEM);
+    graph->nb_threads = threads;
+
+    if (type == AVMEDIA_TYPE_VIDEO) {
+        snprintf(args, sizeof(args),
+                 "video_size=%dx%d:pix_fmt=%d:time_base=1/25:pixel_aspect=1/1",
+                 first->width, first->height, first->format);
+        ret = avfilter_graph_create_filter(psrc, avfilter_get_by_name("buffer"),
+                                           "in", args, NULL, graph);
+        if (ret >= 0)
+            ret = avfilter_graph_create_filter(psink, avfilter_get_by_name("buffersink"),
+                                               "out", NULL, NULL, graph);
+    } else {
+        snprintf(args, sizeof(args),
+                 "sample_rate=%d:sample_fmt=%s:channel_layout=0x%"PRIx64":time_base=1/%d",
+                 first->sample_rate, av_get_sample_fmt_name(first->format),
+                 first->channel_layout, first->sample_rate);
+        ret = avfilter_graph_create_filter(psrc, avfilter_get_by_name("abuffer"),
+                                           "in", args, NULL, graph);
+        if (ret >= 0)
+            ret = avfilter_graph_create_filter(psink, avfilter_get_by_name("abuffersink"),
+                                               "out", NULL, NULL, graph);
+    }
+    if (ret < 0)
+        goto end;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = *psrc;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = *psink;
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avfilter_graph_parse_ptr(graph, desc, &inputs, &outputs, NULL);
+    if (ret >= 0)
+        ret = avfilter_graph_config(graph, NULL);
+
+end:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0)
+        avfilter_graph_free(&graph);
+    *pgraph = graph;
+    return ret;
+}
+
+static int drain_sink(AVFilterContext *sink, AVFrame *frame)
+{
+    int ret;
+
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0)
+        av_frame_unref(frame);
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/**
+ * Time frames through the graph desc, setup is done again for each run to
+ * start from the same state.
+ */
+static void bench_graph(BenchContext *bc, const char *group, const char *name,
+                        enum AVMediaType type, const char *desc,
+                        AVFrame **frames, int nb_frames, int threads)
+{
+    BenchResult res = {
+        .group   = group,
+        .threads = threads,
+        .frames  = nb_frames,
+    };
+    AVFrame *frame = av_frame_alloc();
+    int ret = frame ? 0 : AVERROR(ENOMEM);
+
+    av_strlcpy(res.name, name, sizeof(res.name));
+    if (type == AVMEDIA_TYPE_VIDEO)
+        res.bytes = av_image_get_buffer_size(frames[0]->format, frames[0]->width,
+                                             frames[0]->height, 1);
+    else
+        res.bytes = av_samples_get_buffer_size(NULL, frames[0]->channels,
+                                               frames[0]->nb_samples,
+                                               frames[0]->format, 1);
+    res.bytes *= nb_frames;
+
+    for (int r = 0; r < bc->runs && ret >= 0; r++) {
+        AVFilterGraph *graph;
+        AVFilterContext *src, *sink;
+        int64_t start;
+
+        ret = init_graph(&graph, &src, &sink, frames[0], type, desc, threads);
+        if (ret < 0)
+            break;
+
+        start = av_gettime_relative();
+        for (int i = 0; i < nb_frames && ret >= 0; i++) {
+            ret = av_buffersrc_write_frame(src, frames[i]);
+            if (ret >= 0)
+                ret = drain_sink(sink, frame);
+        }
+        if (ret >= 0)
+            ret = av_buffersrc_add_frame(src, NULL);
+        if (ret >= 0)
+            ret = drain_sink(sink, frame);
+        update_time(&res, start);
+
+        avfilter_graph_free(&graph);
+    }
+
+    if (ret < 0)
+        report_error(&res, ret);
+    else
+        report(bc, &res);
+    av_frame_free(&frame);
+}
+
+static void bench_filter(BenchContext *bc)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(filter_benches); i++) {
+        const FilterBench *fb = &filter_benches[i];
+
+        if (!graph_available(fb->graph) || !name_enabled(bc, fb->graph))
+            continue;
+
+        if (fb->type == AVMEDIA_TYPE_AUDIO) {
+            bench_graph(bc, "filter", fb->graph, fb->type, fb->graph,
+                        bc->audio, bc->nb_audio, 1);
+            continue;
+        }
+        for (int t = 0; t < bc->nb_threads; t++)
+            bench_graph(bc, "filter", fb->graph, fb->type, fb->graph,
+                        bc->video, bc->nb_frames, bc->threads[t]);
+    }
+}
+
+static void write_conv2d(AVIOContext *pb, int activation, int in, int out,
+                         int kernel, int input, int output, AVLFG *lfg)
+{
+    avio_wl32(pb, 1);           /* DLT_CONV2D */
+    avio_wl32(pb, 1);           /* dilation */
+    avio_wl32(pb, 1);           /* SAME padding */
+    avio_wl32(pb, activation);
+    avio_wl32(pb, in);
+    avio_wl32(pb, out);
+    avio_wl32(pb, kernel);
+    avio_wl32(pb, 1);           /* has_bias */
+    for (int i = 0; i < in * out * kernel * kernel; i++)
+        avio_wl32(pb, av_float2int((av_lfg_get(lfg) % 2001 - 1000) / (1000.0f * in * kernel)));
+    for (int i = 0; i < out; i++)
+        avio_wl32(pb, av_float2int(0.01f * i));
+    avio_wl32(pb, input);
+    avio_wl32(pb, output);
+}
+
+static void write_operand(AVIOContext *pb, int index, const char *name, int type,
+                          int channels)
+{
+    avio_wl32(pb, index);
+    avio_wl32(pb, strlen(name));
+    avio_write(pb, name, strlen(name));
+    avio_wl32(pb, type);
+    avio_wl32(pb, 1);           /* DNN_FLOAT */
+    avio_wl32(pb, 1);
+    avio_wl32(pb, -1);
+    avio_wl32(pb, -1);
+    avio_wl32(pb, channels);
+}
+
+/**
+ * Write a small model for the native backend: three 3x3 convolutions on the
+ * luma plane, of the kind used by the super-resolution filters.
+ */
+static int write_native_model(BenchContext *bc)
+{
+    AVIOContext *pb;
+    AVLFG lfg;
+    int fd, ret;
+
+    fd = av_tempfile("ffbench", &bc->native_model, 0, NULL);
+    if (fd < 0)
+        return fd;
+    close(fd);
+
+    ret = avio_open(&pb, bc->native_model, AVIO_FLAG_WRITE);
+    if (ret < 0)
+        return ret;
+
+    av_lfg_init(&lfg, 0x444e4e);
+    avio_write(pb, "FFMPEGDNNNATIVE", 15);
+    avio_wl32(pb, 1);           /* major version */
+    avio_wl32(pb, 2);           /* minor version */
+    write_conv2d(pb, 0, 1, 16, 3, 0, 1, &lfg);  /* ReLU */
+    write_conv2d(pb, 0, 16, 8, 3, 1, 2, &lfg);  /* ReLU */
+    write_conv2d(pb, 2, 8, 1, 3, 2, 3, &lfg);   /* sigmoid */
+    write_operand(pb, 0, "x",  1, 1);           /* DOT_INPUT */
+    write_operand(pb, 1, "h1", 3, 16);          /* DOT_INTERMEDIATE */
+    write_operand(pb, 2, "h2", 3, 8);
+    write_operand(pb, 3, "y",  2, 1);           /* DOT_OUTPUT */
+    avio_wl32(pb, 3);           /* layers */
+    avio_wl32(pb, 4);           /* operands */
+
+    return avio_closep(&pb);
+}
+
+static void bench_dnn(BenchContext *bc)
+{
+    int nb_frames = FFMIN(bc->nb_frames, DNN_MAX_FRAMES);
+    char desc[1024];
+
+    if (!avfilter_get_by_name("dnn_processing"))
+        return;
+
+    /* the native backend with a model of our own, its own threads only */
+    if (name_enabled(bc, "native")) {
+        int ret = write_native_model(bc);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Could not write the native model: %s\n",
+                   av_err2str(ret));
+        } else {
+            for (int t = 0; t < bc->nb_threads; t++) {
+                snprintf(desc, sizeof(desc), "dnn_processing=dnn_backend=native:"
+                         "model=%s:input=x:output=y:backend_configs=threads=%d",
+                         bc->native_model, bc->threads[t]);
+                bench_graph(bc, "dnn", "native 3x3 conv x3", AVMEDIA_TYPE_VIDEO,
+                            desc, bc->video, nb_frames, bc->threads[t]);
+            }
+        }
+    }
+
+    /* the models given with -m, which also select the backend */
+    for (int i = 0; i < bc->nb_models; i++) {
+        if (!name_enabled(bc, bc->models[i]))
+            continue;
+        snprintf(desc, sizeof(desc), "dnn_processing=%s", bc->models[i]);
+        bench_graph(bc, "dnn", bc->models[i], AVMEDIA_TYPE_VIDEO,
+                    desc, bc->video, nb_frames, 1);
+    }
+}
+
+/* swscale and swresample */
+
+typedef struct ScaleBench {
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int dst_num, dst_den;       ///< output size relative to the input
+    int flags;
+} ScaleBench;
+
+static const ScaleBench scale_benches[] = {
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB24,    1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_BGRA,     1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_RGB24,       AV_PIX_FMT_YUV420P,  1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_BGRA,        AV_PIX_FMT_YUV420P,  1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV420P,  1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV422P,  1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV422P10,   AV_PIX_FMT_YUV420P,  1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P10, 1, 1, SWS_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,  1, 2, SWS_FAST_BILINEAR },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,  1, 2, SWS_BICUBIC },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,  3, 2, SWS_BICUBIC },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P,  3, 2, SWS_LANCZOS },
+    { AV_PIX_FMT_RGB24,       AV_PIX_FMT_RGB24,    1, 2, SWS_AREA },
+};
+
+static const char *sws_flags_name(int flags)
+{
+    switch (flags) {
+    case SWS_FAST_BILINEAR: return "fast_bilinear";
+    case SWS_BILINEAR:      return "bilinear";
+    case SWS_BICUBIC:       return "bicubic";
+    case SWS_AREA:          return "area";
+    case SWS_LANCZOS:       return "lanczos";
+    default:                return "unknown";
+    }
+}
+
+static void bench_sws(BenchContext *bc)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(scale_benches); i++) {
+        const ScaleBench *sb = &scale_benches[i];
+        int dst_w = av_rescale(bc->width,  sb->dst_num, sb->dst_den) & ~1;
+        int dst_h = av_rescale(bc->height, sb->dst_num, sb->dst_den) & ~1;
+        AVFrame **src = NULL, *dst = NULL;
+        char name[256];
+        int ret;
+
+        snprintf(name, sizeof(name), "%s %dx%d -> %s %dx%d %s",
+                 av_get_pix_fmt_name(sb->src_fmt), bc->width, bc->height,
+                 av_get_pix_fmt_name(sb->dst_fmt), dst_w, dst_h,
+                 sws_flags_name(sb->flags));
+        if (!name_enabled(bc, name))
+            continue;
+
+        ret = convert_video(bc, &src, sb->src_fmt, bc->width, bc->height);
+        if (ret >= 0) {
+            dst = alloc_video_frame(sb->dst_fmt, dst_w, dst_h);
+            if (!dst)
+                ret = AVERROR(ENOMEM);
+        }
+
+        for (int t = 0; t < bc->nb_threads; t++) {
+            BenchResult res = {
+                .group   = "sws",
+                .threads = bc->threads[t],
+                .frames  = bc->nb_frames,
+                .bytes   = (int64_t)bc->nb_frames *
+                           av_image_get_buffer_size(sb->src_fmt, bc->width, bc->height, 1),
+            };
+            av_strlcpy(res.name, name, sizeof(res.name));
+
+            for (int r = 0; r < bc->runs && ret >= 0; r++) {
+                struct SwsContext *sws = sws_alloc_context();
+                int64_t start;
+
+                if (!sws) {
+                    ret = AVERROR(ENOMEM);
+                    break;
+                }
+                av_opt_set_int(sws, "srcw",       bc->width,    0);
+                av_opt_set_int(sws, "srch",       bc->height,   0);
+                av_opt_set_int(sws, "src_format", sb->src_fmt,  0);
+                av_opt_set_int(sws, "dstw",       dst_w,        0);
+                av_opt_set_int(sws, "dsth",       dst_h,        0);
+                av_opt_set_int(sws, "dst_format", sb->dst_fmt,  0);
+                av_opt_set_int(sws, "sws_flags",  sb->flags,    0);
+                av_opt_set_int(sws, "threads",    res.threads,  0);
+                ret = sws_init_context(sws, NULL, NULL);
+                if (ret >= 0) {
+                    start = av_gettime_relative();
+                    for (int j = 0; j < bc->nb_frames; j++)
+                        sws_scale(sws, (const uint8_t * const *)src[j]->data,
+                                  src[j]->linesize, 0, bc->height,
+                                  dst->data, dst->linesize);
+                    update_time(&res, start);
+                }
+                sws_freeContext(sws);
+            }
+            if (ret < 0) {
+                report_error(&res, ret);
+                break;
+            }
+            report(bc, &res);
+        }
+
+        free_frames(&src, bc->nb_frames);
+        av_frame_free(&dst);
+    }
+}
+
+typedef struct ResampleBench {
+    enum AVSampleFormat in_fmt, out_fmt;
+    int in_rate, out_rate;
+    uint64_t in_layout, out_layout;
+} ResampleBench;
+
+static const ResampleBench resample_benches[] = {
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16,  48000, 44100, AV_CH_LAYOUT_STEREO,  AV_CH_LAYOUT_STEREO },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_FLTP, 44100, 48000, AV_CH_LAYOUT_STEREO,  AV_CH_LAYOUT_STEREO },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLTP, 48000, 96000, AV_CH_LAYOUT_STEREO,  AV_CH_LAYOUT_STEREO },
+    { AV_SAMPLE_FMT_S16,  AV_SAMPLE_FMT_S16,  48000,  8000, AV_CH_LAYOUT_STEREO,  AV_CH_LAYOUT_MONO },
+    { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16,  48000, 48000, AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_STEREO },
+    { AV_SAMPLE_FMT_FLT,  AV_SAMPLE_FMT_S32P, 48000, 48000, AV_CH_LAYOUT_STEREO,  AV_CH_LAYOUT_STEREO },
+};
+
+static void bench_swr(BenchContext *bc)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(resample_benches); i++) {
+        const ResampleBench *rb = &resample_benches[i];
+        int in_ch  = av_get_channel_layout_nb_channels(rb->in_layout);
+        int out_ch = av_get_channel_layout_nb_channels(rb->out_layout);
+        int out_samples = av_rescale_rnd(AUDIO_FRAME, rb->out_rate, rb->in_rate,
+                                         AV_ROUND_UP) + 64;
+        BenchResult res = {
+            .group   = "swr",
+            .threads = 1,
+            .frames  = bc->nb_audio,
+            .bytes   = (int64_t)bc->nb_audio * AUDIO_FRAME * in_ch *
+                       av_get_bytes_per_sample(rb->in_fmt),
+        };
+        AVFrame **src = NULL, *dst = NULL;
+        AVLFG lfg;
+        int ret = 0;
+
+        snprintf(res.name, sizeof(res.name), "%s %dHz %dch -> %s %dHz %dch",
+                 av_get_sample_fmt_name(rb->in_fmt), rb->in_rate, in_ch,
+                 av_get_sample_fmt_name(rb->out_fmt), rb->out_rate, out_ch);
+        if (!name_enabled(bc, res.name))
+            continue;
+
+        av_lfg_init(&lfg, 0x46464246);
+        src = av_calloc(bc->nb_audio, sizeof(*src));
+        dst = alloc_audio_frame(rb->out_fmt, rb->out_layout, out_samples);
+        if (!src || !dst)
+            ret = AVERROR(ENOMEM);
+        for (int j = 0; j < bc->nb_audio && ret >= 0; j++) {
+            src[j] = alloc_audio_frame(rb->in_fmt, rb->in_layout, AUDIO_FRAME);
+            if (!src[j]) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            src[j]->sample_rate = rb->in_rate;
+            fill_audio_frame(src[j], (int64_t)j * AUDIO_FRAME, &lfg);
+        }
+
+        for (int r = 0; r < bc->runs && ret >= 0; r++) {
+            SwrContext *swr = swr_alloc_set_opts(NULL, rb->out_layout, rb->out_fmt,
+                                                 rb->out_rate, rb->in_layout,
+                                                 rb->in_fmt, rb->in_rate, 0, NULL);
+            int64_t start;
+
+            if (!swr) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            ret = swr_init(swr);
+            if (ret >= 0) {
+                start = av_gettime_relative();
+                for (int j = 0; j <= bc->nb_audio && ret >= 0; j++)
+                    ret = swr_convert(swr, dst->extended_data, out_samples,
+                                      j < bc->nb_audio ? (const uint8_t **)src[j]->extended_data : NULL,
+                                      j < bc->nb_audio ? AUDIO_FRAME : 0);
+                update_time(&res, start);
+            }
+            swr_free(&swr);
+        }
+
+        if (ret < 0)
+            report_error(&res, ret);
+        else
+            report(bc, &res);
+        if (src)
+            free_frames(&src, bc->nb_audio);
+        av_frame_free(&dst);
+    }
+}
+
+/* Muxers and demuxers */
+
+static const char * const mux_formats[] = {
+    "matroska", "mp4", "mov", "mpegts", "nut", "avi",
+};
+
+/**
+ * A growable, seekable buffer behind the AVIOContexts, so that the
+ * benchmarks do not measure the file system.
+ */
+typedef struct MemBuffer {
+    uint8_t *data;
+    int64_t size, pos;
+    unsigned allocated;
+} MemBuffer;
+
+static int mem_read(void *opaque, uint8_t *buf, int size)
+{
+    MemBuffer *mb = opaque;
+
+    size = FFMIN(size, mb->size - mb->pos);
+    if (size <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, mb->data + mb->pos, size);
+    mb->pos += size;
+    return size;
+}
+
+static int mem_write(void *opaque, uint8_t *buf, int size)
+{
+    MemBuffer *mb = opaque;
+
+    if (mb->pos + size > mb->allocated) {
+        uint8_t *data = av_fast_realloc(mb->data, &mb->allocated, mb->pos + size);
+        if (!data)
+            return AVERROR(ENOMEM);
+        mb->data = data;
+    }
+    memcpy(mb->data + mb->pos, buf, size);
+    mb->pos += size;
+    mb->size = FFMAX(mb->size, mb->pos);
+    return size;
+}
+
+static int64_t mem_seek(void *opaque, int64_t offset, int whence)
+{
+    MemBuffer *mb = opaque;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return mb->size;
+    case SEEK_SET:                      break;
+    case SEEK_CUR:    offset += mb->pos;  break;
+    case SEEK_END:    offset += mb->size; break;
+    default:          return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > mb->size)
+        return AVERROR(EINVAL);
+    mb->pos = offset;
+    return offset;
+}
+
+static AVIOContext *mem_open(MemBuffer *mb, int write)
+{
+    uint8_t *buf = av_malloc(IO_BUFFER_SIZE);
+    AVIOContext *pb;
+
+    if (!buf)
+        return NULL;
+    pb = avio_alloc_context(buf, IO_BUFFER_SIZE, write, mb,
+                            write ? NULL : mem_read, write ? mem_write : NULL,
+                            mem_seek);
+    if (!pb)
+        av_free(buf);
+    return pb;
+}
+
+static void mem_close(AVIOContext **pb)
+{
+    if (*pb)
+        av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+}
+
+static int mux_packets(const char *format, AVCodecContext *enc, const PacketList *list,
+                       int loops, MemBuffer *mb)
+{
+    AVFormatContext *oc = NULL;
+    AVStream *st;
+    AVPacket *pkt = av_packet_alloc();
+    int64_t duration = list->nb_pkts;
+    int ret;
+
+    mb->size = mb->pos = 0;
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    ret = avformat_alloc_output_context2(&oc, NULL, format, NULL);
+    if (ret < 0)
+        goto end;
+    oc->pb = mem_open(mb, 1);
+    st = avformat_new_stream(oc, NULL);
+    if (!oc->pb || !st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ret = avcodec_parameters_from_context(st->codecpar, enc);
+    if (ret < 0)
+        goto end;
+    st->time_base = enc->time_base;
+
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0)
+        goto end;
+    for (int l = 0; l < loops && ret >= 0; l++) {
+        for (int i = 0; i < list->nb_pkts && ret >= 0; i++) {
+            ret = av_packet_ref(pkt, list->pkts[i]);
+            if (ret < 0)
+                break;
+            pkt->pts += l * duration;
+            pkt->dts += l * duration;
+            av_packet_rescale_ts(pkt, enc->time_base, st->time_base);
+            pkt->stream_index = 0;
+            ret = av_interleaved_write_frame(oc, pkt);
+        }
+    }
+    if (ret >= 0)
+        ret = av_write_trailer(oc);
+    else
+        av_write_trailer(oc);
+
+end:
+    if (oc)
+        mem_close(&oc->pb);
+    avformat_free_context(oc);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int demux_packets(MemBuffer *mb, int64_t *nb_pkts)
+{
+    AVFormatContext *ic = avformat_alloc_context();
+    AVIOContext *pb = mem_open(mb, 0);
+    AVPacket *pkt = av_packet_alloc();
+    int ret;
+
+    *nb_pkts = 0;
+    mb->pos = 0;
+    if (!ic || !pb || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ic->pb     = pb;
+    ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    /* frees ic on failure */
+    ret = avformat_open_input(&ic, NULL, NULL, NULL);
+    if (ret < 0)
+        goto end;
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        (*nb_pkts)++;
+        av_packet_unref(pkt);
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    avformat_close_input(&ic);
+    mem_close(&pb);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static void bench_mux(BenchContext *bc)
+{
+    const CodecBench *cb = NULL;
+    AVCodecContext *enc = NULL;
+    PacketList list = { 0 };
+    MemBuffer mb = { 0 };
+    int loops, ret;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(codec_benches); i++)
+        if (!strcmp(codec_benches[i].encoder, "mpeg4"))
+            cb = &codec_benches[i];
+    if (!cb || !avcodec_find_encoder_by_name(cb->encoder))
+        return;
+    ret = encode_source(bc, cb, &enc, &list);
+    if (ret < 0 || !list.nb_pkts) {
+        av_log(NULL, AV_LOG_ERROR, "Encoding the mux input failed\n");
+        goto end;
+    }
+    /* enough data for the timing to mean something */
+    loops = FFMAX(MUX_MIN_SIZE / FFMAX(list.bytes, 1), 1);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(mux_formats); i++) {
+        const char *format = mux_formats[i];
+        const AVOutputFormat *ofmt = av_guess_format(format, NULL, NULL);
+        BenchResult mux = {
+            .group   = "mux",
+            .threads = 1,
+            .frames  = (int64_t)loops * list.nb_pkts,
+            .bytes   = (int64_t)loops * list.bytes,
+        };
+        BenchResult demux = {
+            .group   = "demux",
+            .threads = 1,
+        };
+
+        if (!ofmt || !name_enabled(bc, format) ||
+            !avformat_query_codec(ofmt, enc->codec_id, FF_COMPLIANCE_NORMAL))
+            continue;
+        av_strlcpy(mux.name,   format, sizeof(mux.name));
+        av_strlcpy(demux.name, format, sizeof(demux.name));
+
+        for (int r = 0; r < bc->runs && ret >= 0; r++) {
+            int64_t start = av_gettime_relative();
+            ret = mux_packets(format, enc, &list, loops, &mb);
+            update_time(&mux, start);
+        }
+        if (ret < 0) {
+            report_error(&mux, ret);
+            ret = 0;
+            continue;
+        }
+        report(bc, &mux);
+
+        demux.bytes = mb.size;
+        for (int r = 0; r < bc->runs && ret >= 0; r++) {
+            int64_t start = av_gettime_relative();
+            ret = demux_packets(&mb, &demux.frames);
+            update_time(&demux, start);
+        }
+        if (ret < 0) {
+            report_error(&demux, ret);
+            ret = 0;
+            continue;
+        }
+        report(bc, &demux);
+    }
+
+end:
+    av_freep(&mb.data);
+    avcodec_free_context(&enc);
+    free_packets(&list);
+}
+
+static int parse_threads(BenchContext *bc, const char *arg)
+{
+    char *end;
+
+    bc->nb_threads = 0;
+    while (*arg && bc->nb_threads < MAX_THREADS) {
+        long t = strtol(arg, &end, 10);
+        if (end == arg || t <= 0 || t > INT_MAX)
+            return AVERROR(EINVAL);
+        bc->threads[bc->nb_threads++] = t;
+        arg = end + (*end == ',');
+    }
+    return bc->nb_threads ? 0 : AVERROR(EINVAL);
+}
+
+static void usage(void)
+{
+    printf("Throughput benchmarks of the FFmpeg libraries, written as JSON\n"
+           "usage: ffbench [OPTIONS]\n"
+           "\n"
+           "Options:\n"
+           "-g GROUPS     comma separated groups to run, among decode, filter, dnn,\n"
+           "              sws, swr and mux (which also runs demux), all if omitted\n"
+           "-f PATTERN    only run the benchmarks whose name contains PATTERN\n"
+           "-h            print this help\n"
+           "-m OPTIONS    dnn_processing options of a model to run, e.g.\n"
+           "              dnn_backend=tensorflow:model=srcnn.pb:input=x:output=y,\n"
+           "              may be given several times\n"
+           "-n FRAMES     number of video frames, 50 if omitted\n"
+           "-o OUTFILE    set OUTFILE as output file, stdout if omitted\n"
+           "-r RUNS       number of runs of each benchmark, the fastest is kept, 3 if omitted\n"
+           "-s SIZE       video size, 1280x720 if omitted\n"
+           "-t THREADS    comma separated thread counts, 1 and the CPU count if omitted\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchContext bc = {
+        .width     = 1280,
+        .height    = 720,
+        .nb_frames = 50,
+        .runs      = 3,
+    };
+    const char *outfilename = NULL;
+    int c, ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    bc.threads[bc.nb_threads++] = 1;
+    if (av_cpu_count() > 1)
+        bc.threads[bc.nb_threads++] = av_cpu_count();
+
+    while ((c = getopt(argc, argv, "f:g:hm:n:o:r:s:t:")) != -1) {
+        switch (c) {
+        case 'f':
+            bc.pattern = optarg;
+            break;
+        case 'g':
+            bc.groups = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        case 'm':
+            if (bc.nb_models == MAX_MODELS) {
+                fprintf(stderr, "Too many models\n");
+                return 1;
+            }
+            bc.models[bc.nb_models++] = optarg;
+            break;
+        case 'n':
+            bc.nb_frames = atoi(optarg);
+            if (bc.nb_frames <= 0) {
+                fprintf(stderr, "Invalid number of frames '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            outfilename = optarg;
+            break;
+        case 'r':
+            bc.runs = atoi(optarg);
+            if (bc.runs <= 0) {
+                fprintf(stderr, "Invalid number of runs '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            if (av_parse_video_size(&bc.width, &bc.height, optarg) < 0 ||
+                bc.width & 1 || bc.height & 1) {
+                fprintf(stderr, "Invalid video size '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 't':
+            if (parse_threads(&bc, optarg) < 0) {
+                fprintf(stderr, "Invalid thread counts '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case '?':
+            return 1;
+        }
+    }
+
+    if (!outfilename || !strcmp(outfilename, "-")) {
+        outfilename = "stdout";
+        bc.out = stdout;
+    } else {
+        bc.out = fopen(outfilename, "w");
+    }
+    if (!bc.out) {
+        fprintf(stderr, "Impossible to open output file '%s': %s\n", outfilename, strerror(errno));
+        return 1;
+    }
+
+    ret = init_sources(&bc);
+    if (ret < 0) {
+        fprintf(stderr, "Could not create the synthetic input: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    fprintf(bc.out, "{\n    \"version\": ");
+    print_json_string(bc.out, av_version_info());
+    fprintf(bc.out, ",\n    \"cpu_count\": %d,\n    \"cpu_flags\": %d,\n"
+            "    \"width\": %d,\n    \"height\": %d,\n    \"frames\": %d,\n"
+            "    \"runs\": %d,\n    \"results\": [",
+            av_cpu_count(), av_get_cpu_flags(), bc.width, bc.height,
+            bc.nb_frames, bc.runs);
+
+    if (group_enabled(&bc, "decode"))
+        bench_decode(&bc);
+    if (group_enabled(&bc, "filter"))
+        bench_filter(&bc);
+    if (group_enabled(&bc, "dnn"))
+        bench_dnn(&bc);
+    if (group_enabled(&bc, "sws"))
+        bench_sws(&bc);
+    if (group_enabled(&bc, "swr"))
+        bench_swr(&bc);
+    if (group_enabled(&bc, "mux"))
+        bench_mux(&bc);
+
+    fprintf(bc.out, "\n    ]\n}\n");
+
+end:
+    if (bc.native_model) {
+        unlink(bc.native_model);
+        av_freep(&bc.native_model);
+    }
+    free_frames(&bc.video, bc.nb_frames);
+    free_frames(&bc.audio, bc.nb_audio);
+    if (bc.out != stdout)
+        fclose(bc.out);
+    return ret < 0;
+}
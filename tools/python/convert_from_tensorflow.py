@@ -159,6 +159,7 @@ class TFConverter:
 
         has_bias = 1
         np.array([self.op2code[node.op], dilation, padding, self.conv_activations[activation], in_channels, out_channels, filter_height, has_bias], dtype=np.uint32).tofile(f)
+        self.dump_weight_padding(f)
         kernel.tofile(f)
 
         btensor = bnode.attr['value'].tensor
@@ -178,6 +179,12 @@ class TFConverter:
         np.array([input_operand_index, output_operand_index], dtype=np.uint32).tofile(f)
 
 
+    def dump_weight_padding(self, f):
+        # pad the file offset to a multiple of 64 bytes, so that
+        # the weights can be used in place from a mapping of the file
+        f.write(bytes(-f.tell() % 64))
+
+
     def dump_simple_conv2d_to_file(self, node, f):
         assert(node.op == 'Conv2D')
         self.layer_number = self.layer_number + 1
@@ -209,6 +216,7 @@ class TFConverter:
         padding = node.attr['padding'].s.decode("utf-8")
         np.array([self.op2code[node.op], dilation, self.conv_paddings[padding], self.conv_activations['None'],
                   in_channels, out_channels, filter_height, has_bias], dtype=np.uint32).tofile(f)
+        self.dump_weight_padding(f)
         kernel.tofile(f)
 
         input_operand_index = self.add_operand(input_name, Operand.IOTYPE_INPUT)
@@ -0,0 +1,154 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Write the sidecar seek index of an existing file, in the format read by
+ * libavformat/seekindex.c.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavformat/avformat.h"
+
+typedef struct Keyframe {
+    int stream_index;
+    int64_t dts;
+    int64_t pos;
+    int gop_size;
+} Keyframe;
+
+static void usage(void)
+{
+    fprintf(stderr, "Write the seek index of the video streams of a file.\n");
+    fprintf(stderr, "usage: seekindex input [output]\n");
+    fprintf(stderr, "The output defaults to input.ffindex, which is picked up\n"
+                    "automatically when seeking in mpegts, h264 and hevc files.\n");
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *ic = NULL;
+    Keyframe *kfs = NULL;
+    int64_t *first_dts = NULL;
+    int64_t size, mtime = -1;
+    int *last = NULL;
+    unsigned kfs_size = 0;
+    int nb_kfs = 0, i, ret;
+    char *output = NULL;
+    const char *filename;
+    AVPacket pkt;
+    struct stat st;
+    FILE *f;
+
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    output = argc > 2 ? av_strdup(argv[2]) : av_asprintf("%s.ffindex", argv[1]);
+    if (!output)
+        return 1;
+
+    if ((ret = avformat_open_input(&ic, argv[1], NULL, NULL)) < 0 ||
+        (ret = avformat_find_stream_info(ic, NULL)) < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", argv[1], av_err2str(ret));
+        goto end;
+    }
+
+    // the index is ignored when the size or the modification time of the file change
+    size = avio_size(ic->pb);
+    filename = argv[1];
+    av_strstart(filename, "file:", &filename);
+    if (!stat(filename, &st))
+        mtime = st.st_mtime;
+
+    first_dts = av_malloc_array(ic->nb_streams, sizeof(*first_dts));
+    last      = av_malloc_array(ic->nb_streams, sizeof(*last));
+    if (!first_dts || !last) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < ic->nb_streams; i++) {
+        first_dts[i] = AV_NOPTS_VALUE;
+        last[i]      = -1;
+    }
+
+    while ((ret = av_read_frame(ic, &pkt)) >= 0) {
+        int idx = pkt.stream_index;
+        int64_t dts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+
+        if (idx >= ic->nb_streams ||
+            ic->streams[idx]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+        if (first_dts[idx] == AV_NOPTS_VALUE)
+            first_dts[idx] = dts;
+
+        if ((pkt.flags & AV_PKT_FLAG_KEY) && dts != AV_NOPTS_VALUE && pkt.pos >= 0) {
+            Keyframe *k = av_fast_realloc(kfs, &kfs_size, (nb_kfs + 1) * sizeof(*kfs));
+            if (!k) {
+                av_packet_unref(&pkt);
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            kfs = k;
+            kfs[nb_kfs] = (Keyframe){ idx, dts, pkt.pos, 1 };
+            last[idx] = nb_kfs++;
+        } else if (last[idx] >= 0) {
+            kfs[last[idx]].gop_size++;
+        }
+        av_packet_unref(&pkt);
+    }
+    if (ret != AVERROR_EOF) {
+        fprintf(stderr, "Error reading %s: %s\n", argv[1], av_err2str(ret));
+        goto end;
+    }
+
+    f = fopen(output, "w");
+    if (!f) {
+        fprintf(stderr, "Could not open %s\n", output);
+        ret = AVERROR(errno);
+        goto end;
+    }
+    fprintf(f, "ffseekindex 2 %"PRId64" %"PRId64"\n", size < 0 ? -1 : size, mtime);
+    for (i = 0; i < ic->nb_streams; i++)
+        if (last[i] >= 0)
+            fprintf(f, "stream %d %d/%d %"PRId64"\n", i,
+                    ic->streams[i]->time_base.num, ic->streams[i]->time_base.den,
+                    first_dts[i]);
+    for (i = 0; i < nb_kfs; i++)
+        fprintf(f, "%d %"PRId64" %"PRId64" %d\n",
+                kfs[i].stream_index, kfs[i].dts, kfs[i].pos, kfs[i].gop_size);
+    ret = fclose(f) ? AVERROR(errno) : 0;
+    if (!ret)
+        printf("%d keyframes written to %s\n", nb_kfs, output);
+
+end:
+    avformat_close_input(&ic);
+    av_free(kfs);
+    av_free(first_dts);
+    av_free(last);
+    av_free(output);
+    return ret < 0;
+}
@@ -0,0 +1,630 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Build an index of MPEG-7 video signatures and look up signatures in it.
+ *
+ * The signatures are the binary exports of the signature filter. The index
+ * stores them verbatim together with an inverted index which maps every
+ * word value of the coarse signatures to the segments containing it, so a
+ * lookup only runs the fine matching of the signature filter against the
+ * assets sharing enough coarse words with the query.
+ *
+ * sigindex build library.idx a.bin b.bin ...
+ * sigindex query [-ratio r] [-candidates n] library.idx query.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/file.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavfilter/signature_lookup.c"
+
+#define INDEX_TAG     MKBETAG('S', 'I', 'G', 'X')
+#define INDEX_VERSION 1
+#define NB_KEYS       (5 * 243) /* 5 words with 243 values each */
+
+typedef struct BitReader {
+    const uint8_t *buf;
+    size_t size;
+    uint64_t pos;
+} BitReader;
+
+typedef struct Signature {
+    StreamContext sc;
+    FineSignature *fine;
+    CoarseSignature *coarse;
+    uint32_t nb_frames;
+    uint32_t nb_segments;
+} Signature;
+
+typedef struct Asset {
+    char *name;
+    uint32_t first_segment;
+    uint32_t nb_segments;
+    uint64_t offset;
+    uint32_t size;
+    double score;
+} Asset;
+
+typedef struct Index {
+    Asset *assets;
+    uint32_t nb_assets;
+    uint32_t nb_segments;
+    uint32_t *postings[NB_KEYS];
+    int nb_postings[NB_KEYS];
+} Index;
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s build index file1 [file2 ...]\n", argv0);
+    fprintf(stderr, "%s query [-ratio r] [-candidates n] index file\n", argv0);
+    return ret;
+}
+
+/* n <= 32 */
+static uint32_t read_bits(BitReader *br, int n)
+{
+    uint64_t v = 0;
+    size_t byte = br->pos >> 3;
+    int i;
+
+    for (i = 0; i < 5; i++)
+        v = v << 8 | (byte + i < br->size ? br->buf[byte + i] : 0);
+    v >>= 40 - (br->pos & 7) - n;
+    br->pos += n;
+
+    return v & (n == 32 ? 0xFFFFFFFF : (1U << n) - 1);
+}
+
+static void free_signature(Signature *sig)
+{
+    av_freep(&sig->fine);
+    av_freep(&sig->coarse);
+}
+
+/* the reverse of binary_export() in vf_signature.c */
+static int parse_signature(Signature *sig, const uint8_t *buf, size_t size)
+{
+    StreamContext *sc = &sig->sc;
+    BitReader br = { buf, size };
+    unsigned timeunit;
+    uint64_t bits;
+    uint32_t i, j, k;
+
+    memset(sig, 0, sizeof(*sig));
+
+    if (read_bits(&br, 32) != 1) /* NumOfSpatialRegions */
+        return AVERROR_INVALIDDATA;
+    read_bits(&br, 1);  /* SpatialLocationFlag */
+    read_bits(&br, 32); /* PixelX,1 PixelY,1 */
+    sc->w = read_bits(&br, 16) + 1;
+    sc->h = read_bits(&br, 16) + 1;
+    read_bits(&br, 32); /* StartFrameOfSpatialRegion */
+    sig->nb_frames = read_bits(&br, 32);
+    timeunit = read_bits(&br, 16);
+    sc->time_base = av_make_q(1, FFMAX(timeunit, 1));
+    read_bits(&br, 1);  /* MediaTimeFlagOfSpatialRegion */
+    read_bits(&br, 32); /* StartMediaTimeOfSpatialRegion */
+    read_bits(&br, 32); /* EndMediaTimeOfSpatialRegion */
+    sig->nb_segments = read_bits(&br, 32);
+
+    if (!sig->nb_frames || sig->nb_segments != (sig->nb_frames + 44ULL) / 45)
+        return AVERROR_INVALIDDATA;
+    bits = br.pos + 1 +
+           (uint64_t)sig->nb_segments * (4 * 32 + 1 + 5 * 243) +
+           (uint64_t)sig->nb_frames * (1 + 32 + 8 + 5 * 8 + SIGELEM_SIZE/5 * 8);
+    if (bits > 8ULL * size)
+        return AVERROR_INVALIDDATA;
+
+    sig->fine   = av_calloc(sig->nb_frames,   sizeof(*sig->fine));
+    sig->coarse = av_calloc(sig->nb_segments, sizeof(*sig->coarse));
+    if (!sig->fine || !sig->coarse) {
+        free_signature(sig);
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < sig->nb_segments; i++) {
+        CoarseSignature *cs = &sig->coarse[i];
+        uint32_t first = read_bits(&br, 32); /* StartFrameOfSegment */
+        uint32_t last  = read_bits(&br, 32); /* EndFrameOfSegment */
+
+        if (first > last || last >= sig->nb_frames) {
+            free_signature(sig);
+            return AVERROR_INVALIDDATA;
+        }
+        cs->first = &sig->fine[first];
+        cs->last  = &sig->fine[last];
+        cs->next  = i + 1 < sig->nb_segments ? &sig->coarse[i + 1] : NULL;
+        read_bits(&br, 1);  /* MediaTimeFlagOfSegment */
+        read_bits(&br, 32); /* StartMediaTimeOfSegment */
+        read_bits(&br, 32); /* EndMediaTimeOfSegment */
+        for (j = 0; j < 5; j++) {
+            for (k = 0; k < 30; k++)
+                cs->data[j][k] = read_bits(&br, 8);
+            cs->data[j][30] = read_bits(&br, 3) << 5;
+        }
+    }
+
+    if (read_bits(&br, 1)) { /* CompressionFlag */
+        free_signature(sig);
+        return AVERROR_PATCHWELCOME;
+    }
+    for (i = 0; i < sig->nb_frames; i++) {
+        FineSignature *fs = &sig->fine[i];
+
+        fs->next  = i + 1 < sig->nb_frames ? &sig->fine[i + 1] : NULL;
+        fs->prev  = i ? &sig->fine[i - 1] : NULL;
+        fs->index = i;
+        read_bits(&br, 1); /* MediaTimeFlagOfFrame */
+        fs->pts = read_bits(&br, 32);
+        fs->confidence = read_bits(&br, 8);
+        for (j = 0; j < 5; j++)
+            fs->words[j] = read_bits(&br, 8);
+        for (j = 0; j < SIGELEM_SIZE/5; j++)
+            fs->framesig[j] = read_bits(&br, 8);
+    }
+
+    sc->finesiglist   = sig->fine;
+    sc->coarsesiglist = sig->coarse;
+    sc->coarseend     = &sig->coarse[sig->nb_segments - 1];
+    sc->lastindex     = sig->nb_frames;
+
+    return 0;
+}
+
+
+static int load_signature(Signature *sig, const char *filename, size_t *size)
+{
+    uint8_t *buf;
+    int ret;
+
+    ret = av_file_map(filename, &buf, size, 0, NULL);
+    if (ret < 0)
+        return ret;
+    ret = parse_signature(sig, buf, *size);
+    av_file_unmap(buf, *size);
+
+    return ret;
+}
+
+static void free_index(Index *idx)
+{
+    int i;
+
+    for (i = 0; idx->assets && i < idx->nb_assets; i++)
+        av_freep(&idx->assets[i].name);
+    av_freep(&idx->assets);
+    for (i = 0; i < NB_KEYS; i++)
+        av_freep(&idx->postings[i]);
+}
+
+static int write_u32(FILE *f, uint32_t v)
+{
+    uint8_t buf[4];
+
+    AV_WB32(buf, v);
+    return fwrite(buf, 1, 4, f) == 4 ? 0 : AVERROR(EIO);
+}
+
+static int read_u32(FILE *f, uint32_t *v)
+{
+    uint8_t buf[4];
+
+    if (fread(buf, 1, 4, f) != 4)
+        return AVERROR_INVALIDDATA;
+    *v = AV_RB32(buf);
+    return 0;
+}
+
+static int add_postings(Index *idx, const CoarseSignature *cs, uint32_t seg)
+{
+    int i, v;
+
+    for (i = 0; i < 5; i++) {
+        for (v = 0; v < 243; v++) {
+            int key = i * 243 + v;
+
+            if (!(cs->data[i][v >> 3] & (0x80 >> (v & 7))))
+                continue;
+            if (!av_dynarray2_add((void **)&idx->postings[key], &idx->nb_postings[key],
+                                  sizeof(*idx->postings[key]), (const uint8_t *)&seg))
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return 0;
+}
+
+static int write_index(Index *idx, FILE *f)
+{
+    uint64_t offset;
+    int i, j, ret;
+
+    /* header, asset table and postings come before the signatures */
+    offset = 4 * 4;
+    for (i = 0; i < idx->nb_assets; i++)
+        offset += 6 * 4 + strlen(idx->assets[i].name);
+    for (i = 0; i < NB_KEYS; i++)
+        offset += 4 + 4 * idx->nb_postings[i];
+
+    if ((ret = write_u32(f, INDEX_TAG))        < 0 ||
+        (ret = write_u32(f, INDEX_VERSION))    < 0 ||
+        (ret = write_u32(f, idx->nb_assets))   < 0 ||
+        (ret = write_u32(f, idx->nb_segments)) < 0)
+        return ret;
+
+    for (i = 0; i < idx->nb_assets; i++) {
+        Asset *a = &idx->assets[i];
+        size_t len = strlen(a->name);
+
+        a->offset = offset;
+        offset += a->size;
+        if ((ret = write_u32(f, a->first_segment)) < 0 ||
+            (ret = write_u32(f, a->nb_segments))   < 0 ||
+            (ret = write_u32(f, a->offset >> 32))  < 0 ||
+            (ret = write_u32(f, a->offset))        < 0 ||
+            (ret = write_u32(f, a->size))          < 0 ||
+            (ret = write_u32(f, len))              < 0)
+            return ret;
+        if (fwrite(a->name, 1, len, f) != len)
+            return AVERROR(EIO);
+    }
+
+    for (i = 0; i < NB_KEYS; i++) {
+        if ((ret = write_u32(f, idx->nb_postings[i])) < 0)
+            return ret;
+        for (j = 0; j < idx->nb_postings[i]; j++)
+            if ((ret = write_u32(f, idx->postings[i][j])) < 0)
+                return ret;
+    }
+
+    for (i = 0; i < idx->nb_assets; i++) {
+        Asset *a = &idx->assets[i];
+        uint8_t *buf;
+        size_t size;
+
+        ret = av_file_map(a->name, &buf, &size, 0, NULL);
+        if (ret < 0)
+            return ret;
+        if (size != a->size || fwrite(buf, 1, size, f) != size)
+            ret = AVERROR(EIO);
+        av_file_unmap(buf, size);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int build_index(const char *filename, char **files, int nb_files)
+{
+    Index idx = { 0 };
+    FILE *f;
+    int i, ret = 0;
+
+    idx.assets = av_calloc(nb_files, sizeof(*idx.assets));
+    if (!idx.assets)
+        return AVERROR(ENOMEM);
+    idx.nb_assets = nb_files;
+
+    for (i = 0; i < nb_files; i++) {
+        Asset *a = &idx.assets[i];
+        CoarseSignature *cs;
+        Signature sig;
+        uint32_t seg;
+        size_t size;
+
+        a->name = av_strdup(files[i]);
+        if (!a->name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = load_signature(&sig, files[i], &size);
+        if (ret < 0 || size > UINT32_MAX) {
+            fprintf(stderr, "Unable to read the signature %s\n", files[i]);
+            ret = ret < 0 ? ret : AVERROR_INVALIDDATA;
+            goto end;
+        }
+        a->size          = size;
+        a->first_segment = idx.nb_segments;
+        a->nb_segments   = sig.nb_segments;
+        for (cs = sig.sc.coarsesiglist, seg = a->first_segment; cs; cs = cs->next, seg++)
+            if ((ret = add_postings(&idx, cs, seg)) < 0)
+                break;
+        idx.nb_segments += sig.nb_segments;
+        free_signature(&sig);
+        if (ret < 0)
+            goto end;
+    }
+
+    f = fopen(filename, "wb");
+    if (!f) {
+        ret = AVERROR(errno);
+        fprintf(stderr, "Unable to open %s\n", filename);
+        goto end;
+    }
+    ret = write_index(&idx, f);
+    if (fclose(f) && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        fprintf(stderr, "Unable to write the index %s\n", filename);
+
+end:
+    free_index(&idx);
+    return ret;
+}
+
+static int read_index(Index *idx, FILE *f)
+{
+    uint32_t tag, version, nb_assets, hi, lo, len, count;
+    int i, j, ret;
+
+    if ((ret = read_u32(f, &tag))               < 0 ||
+        (ret = read_u32(f, &version))           < 0 ||
+        (ret = read_u32(f, &nb_assets))         < 0 ||
+        (ret = read_u32(f, &idx->nb_segments))  < 0)
+        return ret;
+    if (tag != INDEX_TAG || version != INDEX_VERSION || nb_assets > INT_MAX)
+        return AVERROR_INVALIDDATA;
+
+    idx->assets = av_calloc(nb_assets, sizeof(*idx->assets));
+    if (!idx->assets)
+        return AVERROR(ENOMEM);
+    idx->nb_assets = nb_assets;
+
+    for (i = 0; i < idx->nb_assets; i++) {
+        Asset *a = &idx->assets[i];
+
+        if ((ret = read_u32(f, &a->first_segment)) < 0 ||
+            (ret = read_u32(f, &a->nb_segments))   < 0 ||
+            (ret = read_u32(f, &hi))               < 0 ||
+            (ret = read_u32(f, &lo))               < 0 ||
+            (ret = read_u32(f, &a->size))          < 0 ||
+            (ret = read_u32(f, &len))              < 0)
+            return ret;
+        if (a->first_segment > idx->nb_segments ||
+            a->nb_segments > idx->nb_segments - a->first_segment)
+            return AVERROR_INVALIDDATA;
+        a->offset = (uint64_t)hi << 32 | lo;
+        a->name = av_malloc(len + 1);
+        if (!a->name)
+            return AVERROR(ENOMEM);
+        if (fread(a->name, 1, len, f) != len)
+            return AVERROR_INVALIDDATA;
+        a->name[len] = 0;
+    }
+
+    for (i = 0; i < NB_KEYS; i++) {
+        if ((ret = read_u32(f, &count)) < 0)
+            return ret;
+        if (count > idx->nb_segments)
+            return AVERROR_INVALIDDATA;
+        idx->postings[i] = av_malloc_array(count, sizeof(*idx->postings[i]));
+        if (!idx->postings[i] && count)
+            return AVERROR(ENOMEM);
+        idx->nb_postings[i] = count;
+        for (j = 0; j < count; j++) {
+            if ((ret = read_u32(f, &idx->postings[i][j])) < 0)
+                return ret;
+            if (idx->postings[i][j] >= idx->nb_segments)
+                return AVERROR_INVALIDDATA;
+        }
+    }
+
+    return 0;
+}
+
+static int find_asset(const Index *idx, uint32_t seg)
+{
+    int lo = 0, hi = idx->nb_assets - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi + 1) >> 1;
+        if (idx->assets[mid].first_segment <= seg)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+static const Index *sort_index;
+
+static int cmp_score(const void *a, const void *b)
+{
+    double sa = sort_index->assets[*(const int *)a].score;
+    double sb = sort_index->assets[*(const int *)b].score;
+    return (sa < sb) - (sa > sb);
+}
+
+/**
+ * Score every asset with the largest fraction of the coarse words of a query
+ * segment found in one of its segments, walking only the posting lists of
+ * the words present in the query.
+ */
+static int score_assets(Index *idx, const Signature *query)
+{
+    uint16_t *votes;
+    uint32_t *touched;
+    const CoarseSignature *cs;
+    int i, j, v;
+
+    votes   = av_calloc(idx->nb_segments, sizeof(*votes));
+    touched = av_malloc_array(idx->nb_segments, sizeof(*touched));
+    if (!votes || !touched) {
+        av_free(votes);
+        av_free(touched);
+        return AVERROR(ENOMEM);
+    }
+
+    for (cs = query->sc.coarsesiglist; cs; cs = cs->next) {
+        int nb_touched = 0, nb_words = 0;
+
+        for (i = 0; i < 5; i++) {
+            for (v = 0; v < 243; v++) {
+                int key = i * 243 + v;
+
+                if (!(cs->data[i][v >> 3] & (0x80 >> (v & 7))))
+                    continue;
+                nb_words++;
+                for (j = 0; j < idx->nb_postings[key]; j++) {
+                    uint32_t seg = idx->postings[key][j];
+                    if (!votes[seg]++)
+                        touched[nb_touched++] = seg;
+                }
+            }
+        }
+
+        for (j = 0; j < nb_touched; j++) {
+            uint32_t seg = touched[j];
+            Asset *a = &idx->assets[find_asset(idx, seg)];
+
+            a->score = FFMAX(a->score, votes[seg] / (double)nb_words);
+            votes[seg] = 0;
+        }
+    }
+
+    av_free(votes);
+    av_free(touched);
+    return 0;
+}
+
+static int query_index(const char *filename, const char *query_name,
+                       double min_ratio, int max_candidates)
+{
+    SignatureContext sic = {
+        .thworddist   = 9000,
+        .thcomposdist = 60000,
+        .thl1         = 116,
+    };
+    Index idx = { 0 };
+    Signature query, sig;
+    int *candidates = NULL;
+    int i, nb_candidates = 0, nb_matches = 0, ret;
+    uint8_t *buf = NULL;
+    size_t size;
+    FILE *f;
+
+    ret = load_signature(&query, query_name, &size);
+    if (ret < 0) {
+        fprintf(stderr, "Unable to read the signature %s\n", query_name);
+        return ret;
+    }
+
+    f = fopen(filename, "rb");
+    if (!f) {
+        ret = AVERROR(errno);
+        fprintf(stderr, "Unable to open %s\n", filename);
+        goto end;
+    }
+    ret = read_index(&idx, f);
+    if (ret < 0) {
+        fprintf(stderr, "Unable to read the index %s\n", filename);
+        goto end;
+    }
+
+    if ((ret = score_assets(&idx, &query)) < 0)
+        goto end;
+
+    candidates = av_malloc_array(FFMAX(idx.nb_assets, 1), sizeof(*candidates));
+    if (!candidates) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < idx.nb_assets; i++)
+        if (idx.assets[i].score >= min_ratio)
+            candidates[nb_candidates++] = i;
+    sort_index = &idx;
+    qsort(candidates, nb_candidates, sizeof(*candidates), cmp_score);
+    nb_candidates = FFMIN(nb_candidates, max_candidates);
+
+    /* stage 2 and 3 of the signature filter on the candidates only */
+    for (i = 0; i < nb_candidates; i++) {
+        Asset *a = &idx.assets[candidates[i]];
+        MatchingInfo match;
+
+        buf = av_realloc(buf, FFMAX(a->size, 1));
+        if (!buf) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if (fseeko(f, a->offset, SEEK_SET) || fread(buf, 1, a->size, f) != a->size ||
+            parse_signature(&sig, buf, a->size) < 0) {
+            fprintf(stderr, "Unable to read the signature of %s from the index\n", a->name);
+            ret = AVERROR_INVALIDDATA;
+            goto end;
+        }
+
+        match = lookup_signatures(NULL, &sic, &query.sc, &sig.sc, MODE_FAST);
+        if (match.score != 0) {
+            printf("%s: matching at %f and %f, %d frames matching%s\n", a->name,
+                   (double)match.first->pts  * query.sc.time_base.num / query.sc.time_base.den,
+                   (double)match.second->pts * sig.sc.time_base.num   / sig.sc.time_base.den,
+                   match.matchframes, match.whole ? ", whole video" : "");
+            nb_matches++;
+        }
+        free_signature(&sig);
+    }
+    fprintf(stderr, "%d of %d candidates matching, %u assets in the index\n",
+            nb_matches, nb_candidates, idx.nb_assets);
+
+end:
+    if (f)
+        fclose(f);
+    av_free(buf);
+    av_free(candidates);
+    free_index(&idx);
+    free_signature(&query);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    double min_ratio = 0.5;
+    int max_candidates = 16;
+    int i;
+
+    if (argc < 2)
+        return usage(argv[0], 1);
+
+    if (!strcmp(argv[1], "build")) {
+        if (argc < 4)
+            return usage(argv[0], 1);
+        return build_index(argv[2], argv + 3, argc - 3) < 0;
+    }
+
+    if (strcmp(argv[1], "query"))
+        return usage(argv[0], 1);
+    for (i = 2; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-ratio")) {
+            min_ratio = strtod(argv[i + 1], NULL);
+        } else if (!strcmp(argv[i], "-candidates")) {
+            max_candidates = strtol(argv[i + 1], NULL, 0);
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (argc - i != 2)
+        return usage(argv[0], 1);
+
+    return query_index(argv[i], argv[i + 1], min_ratio, max_candidates) < 0;
+}